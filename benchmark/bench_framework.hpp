@@ -6,18 +6,28 @@
 #include <mapnik/params.hpp>
 #include <mapnik/value/types.hpp>
 #include <mapnik/safe_cast.hpp>
+#include <mapnik/boolean.hpp>
 #include "../test/cleanup.hpp"
 
 // stl
+#include <algorithm>
 #include <chrono>
-#include <cmath> // log10, round
+#include <cmath> // log10, round, ceil
 #include <cstdio> // snprintf
+#include <fstream>
 #include <iostream>
+#include <mutex>
 #include <set>
 #include <sstream>
+#include <string>
 #include <thread>
 #include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace benchmark {
 
 template <typename T>
@@ -50,6 +60,12 @@ public:
     {
         return params_;
     }
+    // Bytes one iteration processes, when throughput in MB/s means more
+    // than iterations per second; 0 leaves it unreported.
+    virtual std::size_t bytes_per_iteration() const
+    {
+        return 0;
+    }
     virtual bool validate() const = 0;
     virtual bool operator()() const = 0;
 };
@@ -163,6 +179,201 @@ struct big_number_fmt
     }
 };
 
+// latency samples of one run, one per call of the test case
+struct run_result
+{
+    std::string name;
+    std::size_t threads = 0;
+    std::size_t iterations = 0; // per sample
+    std::size_t total_iters = 0;
+    double elapsed_ms = 0.0;
+    std::vector<double> samples_ms;
+};
+
+// nearest-rank percentile of sorted samples
+inline double percentile(std::vector<double> const& sorted, double p)
+{
+    if (sorted.empty()) return 0.0;
+    std::size_t rank = static_cast<std::size_t>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1)) - 1];
+}
+
+// pins the calling thread to a cpu, where supported
+inline void pin_thread(std::size_t index)
+{
+#ifdef __linux__
+    unsigned num_cpus = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(index % num_cpus, &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+    {
+        std::clog << "could not pin thread to cpu " << (index % num_cpus) << "\n";
+    }
+#else
+    (void)index;
+#endif
+}
+
+inline std::string json_escape(std::string const& str)
+{
+    std::string escaped;
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        escaped += c;
+    }
+    return escaped;
+}
+
+inline std::string to_json(run_result const& result, std::vector<double> const& sorted)
+{
+    double per_iter = result.iterations > 0 ? 1.0 / result.iterations : 1.0;
+    std::ostringstream s;
+    s.precision(6);
+    s << std::fixed
+      << "{\"name\":\"" << json_escape(result.name) << "\""
+      << ",\"threads\":" << result.threads
+      << ",\"iterations\":" << result.total_iters
+      << ",\"samples\":" << sorted.size()
+      << ",\"elapsed_ms\":" << result.elapsed_ms
+      << ",\"p50_ms\":" << percentile(sorted, 50) * per_iter
+      << ",\"p95_ms\":" << percentile(sorted, 95) * per_iter
+      << ",\"p99_ms\":" << percentile(sorted, 99) * per_iter
+      << ",\"max_ms\":" << (sorted.empty() ? 0.0 : sorted.back()) * per_iter
+      << "}";
+    return s.str();
+}
+
+// value of a "key":<number> field of a json object written by to_json
+inline bool json_number(std::string const& json, std::string const& key, double & value)
+{
+    std::string pattern = "\"" + key + "\":";
+    std::size_t pos = json.find(pattern);
+    if (pos == std::string::npos) return false;
+    std::istringstream s(json.substr(pos + pattern.size()));
+    return static_cast<bool>(s >> value);
+}
+
+// p50 per iteration latency of the same benchmark and thread count in a
+// baseline written through --json
+inline bool baseline_p50(std::string const& file, std::string const& name,
+                         std::size_t threads, double & p50)
+{
+    std::ifstream in(file);
+    std::string line;
+    std::string name_field = "\"name\":\"" + json_escape(name) + "\"";
+    bool found = false;
+    while (std::getline(in, line))
+    {
+        double line_threads;
+        if (line.find(name_field) == std::string::npos ||
+            !json_number(line, "threads", line_threads) ||
+            static_cast<std::size_t>(line_threads) != threads)
+        {
+            continue;
+        }
+        // the last matching entry wins
+        found = json_number(line, "p50_ms", p50) || found;
+    }
+    return found;
+}
+
+template <typename T>
+run_result run_timed(T const& test_runner, std::string const& name,
+                     std::size_t num_threads, std::size_t num_samples, bool pin)
+{
+    using clock = std::chrono::high_resolution_clock;
+    run_result result;
+    result.name = name;
+    result.threads = num_threads;
+    result.iterations = test_runner.iterations();
+
+    clock::time_point start;
+    clock::duration elapsed;
+    auto opt_min_duration = test_runner.params().template get<double>("min-duration", 0.0);
+    std::chrono::duration<double> min_seconds(*opt_min_duration);
+    auto min_duration = std::chrono::duration_cast<decltype(elapsed)>(min_seconds);
+    auto num_iters = test_runner.iterations();
+
+    auto timed_call = [](T const& test, std::vector<double> & samples)
+    {
+        auto call_start = clock::now();
+        test();
+        samples.push_back(milliseconds<double>(clock::now() - call_start).count());
+    };
+
+    if (num_threads > 0)
+    {
+        std::mutex mtx_ready;
+        std::unique_lock<std::mutex> lock_ready(mtx_ready);
+        std::vector<std::vector<double>> samples(num_threads);
+
+        auto stub = [&](T const& test_copy, std::size_t index)
+        {
+            if (pin) pin_thread(index);
+            samples[index].reserve(num_samples);
+            // workers will wait on this mutex until the main thread
+            // constructs all of them and starts measuring time
+            std::unique_lock<std::mutex> my_lock(mtx_ready);
+            my_lock.unlock();
+            for (std::size_t i = 0; i < num_samples; ++i)
+            {
+                timed_call(test_copy, samples[index]);
+            }
+        };
+
+        std::vector<std::thread> tg;
+        tg.reserve(num_threads);
+        for (auto i = num_threads; i-- > 0; )
+        {
+            tg.emplace_back(stub, test_runner, i);
+        }
+        start = clock::now();
+        lock_ready.unlock();
+        // wait for all workers to finish
+        for (auto & t : tg)
+        {
+            if (t.joinable())
+                t.join();
+        }
+        elapsed = clock::now() - start;
+        // this is actually per-thread count, not total, but I think
+        // reporting average 'iters/thread/second' is more useful
+        // than 'iters/second' multiplied by the number of threads
+        result.total_iters += num_iters * num_samples;
+        for (auto const& thread_samples : samples)
+        {
+            result.samples_ms.insert(result.samples_ms.end(), thread_samples.begin(), thread_samples.end());
+        }
+    }
+    else
+    {
+        if (pin) pin_thread(0);
+        start = clock::now();
+        do {
+            timed_call(test_runner, result.samples_ms);
+            elapsed = clock::now() - start;
+            result.total_iters += num_iters;
+        } while (elapsed < min_duration || result.samples_ms.size() < num_samples);
+    }
+    result.elapsed_ms = milliseconds<double>(elapsed).count();
+    return result;
+}
+
+// Runs a test case and reports its throughput, and the p50/p95/p99/max
+// latency of one iteration over every call of the test case. Options:
+//   --warmup N       untimed calls before timing, besides the validating one
+//   --samples N      timed calls per thread (at least, without threads)
+//   --max-threads N  run with 1 to N threads instead of --threads
+//   --pin-cpus true  pin each thread to a cpu (linux)
+//   --json FILE      append one json result per line to FILE
+//   --compare FILE   flag p50 regressions against a --json baseline
+//   --tolerance F    allowed p50 slowdown over the baseline, default 0.05
+//   --min-scaling F  with --max-threads, fail when the throughput at the
+//                    most threads is below F times the single thread
+//                    throughput per thread
 template <typename T>
 int run(T const& test_runner, std::string const& name)
 {
@@ -180,75 +391,113 @@ int run(T const& test_runner, std::string const& name)
             return 2;
         }
 
-        std::chrono::high_resolution_clock::time_point start;
-        std::chrono::high_resolution_clock::duration elapsed;
-        auto opt_min_duration = test_runner.params().template get<double>("min-duration", 0.0);
-        std::chrono::duration<double> min_seconds(*opt_min_duration);
-        auto min_duration = std::chrono::duration_cast<decltype(elapsed)>(min_seconds);
-        auto num_iters = test_runner.iterations();
-        auto num_threads = test_runner.threads();
-        auto total_iters = 0;
+        mapnik::parameters const& params = test_runner.params();
+        auto warmup = mapnik::safe_cast<std::size_t>(*params.get<mapnik::value_integer>("warmup", 0));
+        for (std::size_t i = 0; i < warmup; ++i)
+        {
+            test_runner();
+        }
+        auto num_samples = std::max<std::size_t>(1,
+            mapnik::safe_cast<std::size_t>(*params.get<mapnik::value_integer>("samples", 1)));
+        bool pin = *params.get<mapnik::boolean_type>("pin-cpus", false);
+        auto max_threads = mapnik::safe_cast<std::size_t>(*params.get<mapnik::value_integer>("max-threads", 0));
+        std::vector<std::size_t> thread_counts;
+        if (max_threads > 0)
+        {
+            for (std::size_t n = 1; n <= max_threads; ++n) thread_counts.push_back(n);
+        }
+        else
+        {
+            thread_counts.push_back(test_runner.threads());
+        }
+        auto json_file = params.get<std::string>("json");
+        auto compare_file = params.get<std::string>("compare");
+        double tolerance = *params.get<double>("tolerance", 0.05);
+        double min_scaling = *params.get<double>("min-scaling", 0.0);
 
-        if (num_threads > 0)
+        int status = 0;
+        double single_thread_ips = 0.0;
+        for (std::size_t num_threads : thread_counts)
         {
-            std::mutex mtx_ready;
-            std::unique_lock<std::mutex> lock_ready(mtx_ready);
+            run_result result = run_timed(test_runner, name, num_threads, num_samples, pin);
 
-            auto stub = [&](T const& test_copy)
+            char msg[200];
+            auto elapsed_nonzero = std::max(result.elapsed_ms, 1e-6);
+            big_number_fmt itersf(4, result.total_iters);
+            big_number_fmt ips(5, result.total_iters / (elapsed_nonzero / 1000.0));
+
+            std::snprintf(msg, sizeof(msg),
+                    "%-43s %3zu threads %*.0f%s iters %6.0f milliseconds %*.0f%s i/s\n",
+                    name.c_str(),
+                    num_threads,
+                    itersf.w, itersf.v, itersf.u,
+                    result.elapsed_ms,
+                    ips.w, ips.v, ips.u
+                    );
+            std::clog << msg;
+
+            double throughput = result.total_iters / (elapsed_nonzero / 1000.0);
+            if (std::size_t bytes = test_runner.bytes_per_iteration())
             {
-                // workers will wait on this mutex until the main thread
-                // constructs all of them and starts measuring time
-                std::unique_lock<std::mutex> my_lock(mtx_ready);
-                my_lock.unlock();
-                test_copy();
-            };
-
-            std::vector<std::thread> tg;
-            tg.reserve(num_threads);
-            for (auto i = num_threads; i-- > 0; )
+                std::snprintf(msg, sizeof(msg),
+                        "%-43s %.1f MB/s\n",
+                        "",
+                        throughput * bytes / (1024.0 * 1024.0));
+                std::clog << msg;
+            }
+            if (num_threads == 1)
             {
-                tg.emplace_back(stub, test_runner);
+                single_thread_ips = throughput;
             }
-            start = std::chrono::high_resolution_clock::now();
-            lock_ready.unlock();
-            // wait for all workers to finish
-            for (auto & t : tg)
+            else if (single_thread_ips > 0.0)
             {
-                if (t.joinable())
-                    t.join();
+                // parallel efficiency, 1.0 when each thread is as fast as one alone
+                double efficiency = throughput / (num_threads * single_thread_ips);
+                bool poor = min_scaling > 0.0 && num_threads == thread_counts.back() && efficiency < min_scaling;
+                std::snprintf(msg, sizeof(msg),
+                        "%-43s scaling %.0f%% of linear%s\n",
+                        "",
+                        efficiency * 100.0,
+                        poor ? " BELOW MINIMUM" : "");
+                std::clog << msg;
+                if (poor) status |= 16;
             }
-            elapsed = std::chrono::high_resolution_clock::now() - start;
-            // this is actually per-thread count, not total, but I think
-            // reporting average 'iters/thread/second' is more useful
-            // than 'iters/second' multiplied by the number of threads
-            total_iters += num_iters;
-        }
-        else
-        {
-            start = std::chrono::high_resolution_clock::now();
-            do {
-                test_runner();
-                elapsed = std::chrono::high_resolution_clock::now() - start;
-                total_iters += num_iters;
-            } while (elapsed < min_duration);
-        }
 
-        char msg[200];
-        double dur_total = milliseconds<double>(elapsed).count();
-        auto elapsed_nonzero = std::max(elapsed, decltype(elapsed){1});
-        big_number_fmt itersf(4, total_iters);
-        big_number_fmt ips(5, total_iters / seconds<double>(elapsed_nonzero).count());
-
-        std::snprintf(msg, sizeof(msg),
-                "%-43s %3zu threads %*.0f%s iters %6.0f milliseconds %*.0f%s i/s\n",
-                name.c_str(),
-                num_threads,
-                itersf.w, itersf.v, itersf.u,
-                dur_total,
-                ips.w, ips.v, ips.u
-                );
-        std::clog << msg;
-        return 0;
+            std::vector<double> sorted(result.samples_ms);
+            std::sort(sorted.begin(), sorted.end());
+            double per_iter = result.iterations > 0 ? 1.0 / result.iterations : 1.0;
+            double p50 = percentile(sorted, 50) * per_iter;
+            std::snprintf(msg, sizeof(msg),
+                    "%-43s ms/iter p50 %.4g p95 %.4g p99 %.4g max %.4g (%zu samples)\n",
+                    "",
+                    p50,
+                    percentile(sorted, 95) * per_iter,
+                    percentile(sorted, 99) * per_iter,
+                    sorted.empty() ? 0.0 : sorted.back() * per_iter,
+                    sorted.size()
+                    );
+            std::clog << msg;
+
+            if (json_file)
+            {
+                std::ofstream out(*json_file, std::ios::app);
+                out << to_json(result, sorted) << "\n";
+            }
+            double base_p50;
+            if (compare_file && baseline_p50(*compare_file, name, num_threads, base_p50) && base_p50 > 0.0)
+            {
+                double change = p50 / base_p50 - 1.0;
+                bool regressed = change > tolerance;
+                std::snprintf(msg, sizeof(msg),
+                        "%-43s p50 %+.1f%% against baseline%s\n",
+                        "",
+                        change * 100.0,
+                        regressed ? " REGRESSION" : "");
+                std::clog << msg;
+                if (regressed) status = 8;
+            }
+        }
+        return status;
     }
     catch (std::exception const& ex)
     {
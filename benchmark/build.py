@@ -29,11 +29,11 @@ benchmarks = [
     #"test_array_allocation.cpp",
     #"test_png_encoding1.cpp",
     #"test_png_encoding2.cpp",
-    #"test_to_string1.cpp",
+    "test_to_string1.cpp",
     #"test_to_string2.cpp",
     #"test_to_bool.cpp",
-    #"test_to_double.cpp",
-    #"test_to_int.cpp",
+    "test_to_double.cpp",
+    "test_to_int.cpp",
     #"test_utf_encoding.cpp"
     "test_polygon_clipping.cpp",
     #"test_polygon_clipping_rendering.cpp",
@@ -46,8 +46,13 @@ benchmarks = [
     "test_offset_converter.cpp",
     "test_marker_cache.cpp",
     "test_quad_tree.cpp",
+    "test_label_collision.cpp",
     "test_noop_rendering.cpp",
     "test_getline.cpp",
+    "test_datasource_query.cpp",
+    "test_image_kernels.cpp",
+    "test_text_pipeline.cpp",
+    "test_image_codecs.cpp",
 #    "test_numeric_cast_vs_static_cast.cpp",
 ]
 for cpp_test in benchmarks:
@@ -0,0 +1,161 @@
+#include "bench_framework.hpp"
+#include <mapnik/datasource.hpp>
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/raster.hpp>
+#include <mapnik/util/fs.hpp>
+#include <boost/algorithm/string.hpp>
+#include <atomic>
+#include <ctime>
+#include <random>
+#include <stdexcept>
+
+// Queries a datasource and pulls every feature, measuring the datasource
+// alone. Datasource parameters are given as --ds.<name>=<value>, e.g.
+// --ds.type=csv --ds.file=data.csv; --reopen=true creates the datasource
+// in every iteration, --window=<fraction> queries random windows of that
+// fraction of the envelope instead of --bbox (the envelope by default)
+// and --properties is "all" (default), "none" or a comma separated list.
+class test : public benchmark::test_case
+{
+    mapnik::parameters ds_params_;
+    mapnik::datasource_ptr ds_;
+    bool reopen_;
+    double window_;
+    mapnik::box2d<double> bbox_;
+    std::vector<std::string> properties_;
+    mutable std::atomic<std::size_t> features_;
+public:
+    test(mapnik::parameters const& params)
+     : test_case(params),
+       ds_params_(),
+       ds_(),
+       reopen_(*params.get<mapnik::boolean_type>("reopen", false)),
+       window_(*params.get<double>("window", 0.0)),
+       bbox_(),
+       properties_(),
+       features_(0)
+    {
+        for (auto const& kv : params)
+        {
+            if (boost::algorithm::starts_with(kv.first, "ds."))
+            {
+                ds_params_[kv.first.substr(3)] = kv.second;
+            }
+        }
+        if (!ds_params_.get<std::string>("type"))
+        {
+            throw std::runtime_error("please provide a --ds.type=<plugin> arg");
+        }
+        ds_ = mapnik::datasource_cache::instance().create(ds_params_);
+        boost::optional<std::string> bbox = params.get<std::string>("bbox");
+        if (bbox && !bbox_.from_string(*bbox))
+        {
+            throw std::runtime_error("could not parse `bbox` string " + *bbox);
+        }
+        if (!bbox_.valid()) bbox_ = ds_->envelope();
+        std::string properties = *params.get<std::string>("properties", "all");
+        if (properties == "all")
+        {
+            for (auto const& desc : ds_->get_descriptor().get_descriptors())
+            {
+                properties_.push_back(desc.get_name());
+            }
+        }
+        else if (properties != "none")
+        {
+            boost::algorithm::split(properties_, properties, boost::algorithm::is_any_of(","));
+        }
+    }
+
+    test(test const& rhs)
+     : test_case(rhs),
+       ds_params_(rhs.ds_params_),
+       ds_(rhs.ds_),
+       reopen_(rhs.reopen_),
+       window_(rhs.window_),
+       bbox_(rhs.bbox_),
+       properties_(rhs.properties_),
+       features_(0)
+    {}
+
+    std::size_t query(mapnik::datasource const& ds, mapnik::box2d<double> const& box) const
+    {
+        mapnik::query q(box);
+        for (std::string const& name : properties_)
+        {
+            q.add_property_name(name);
+        }
+        std::size_t count = 0;
+        mapnik::featureset_ptr fs = ds.features(q);
+        if (!fs) return count;
+        mapnik::feature_ptr feature;
+        while ((feature = fs->next()))
+        {
+            // touch the data like a renderer would
+            if (feature->get_raster()) count += feature->get_raster()->data_.width() > 0;
+            else count += !feature->get_geometry().is<mapnik::geometry::geometry_empty>();
+        }
+        return count;
+    }
+
+    bool validate() const
+    {
+        std::size_t count = query(*ds_, bbox_);
+        std::time_t mtime;
+        std::uintmax_t size = 0;
+        boost::optional<std::string> file = ds_params_.get<std::string>("file");
+        if (file) mapnik::util::file_stat(*file, mtime, size);
+        std::clog << "datasource " << *ds_params_.get<std::string>("type")
+                  << ": " << count << " features, " << size << " bytes per full query\n";
+        return count > 0;
+    }
+
+    bool operator()() const
+    {
+        std::mt19937 engine(static_cast<unsigned>(features_.load()));
+        std::uniform_real_distribution<double> uniform(0.0, 1.0 - window_);
+        for (std::size_t i = 0; i < iterations_; ++i)
+        {
+            mapnik::datasource_ptr ds = reopen_ ? mapnik::datasource_cache::instance().create(ds_params_) : ds_;
+            mapnik::box2d<double> box = bbox_;
+            if (window_ > 0.0 && window_ < 1.0)
+            {
+                double x = bbox_.minx() + uniform(engine) * bbox_.width();
+                double y = bbox_.miny() + uniform(engine) * bbox_.height();
+                box = mapnik::box2d<double>(x, y, x + window_ * bbox_.width(), y + window_ * bbox_.height());
+            }
+            features_ += query(*ds, box);
+        }
+        return true;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    int return_value = 0;
+    try
+    {
+        mapnik::parameters params;
+        benchmark::handle_args(argc,argv,params);
+        boost::optional<std::string> name = params.get<std::string>("name");
+        if (!name)
+        {
+            std::clog << "please provide a name for this test\n";
+            return -1;
+        }
+        mapnik::datasource_cache::instance().register_datasources("./plugins/input/");
+        {
+            test test_runner(params);
+            return_value = run(test_runner,*name);
+        }
+    }
+    catch (std::exception const& ex)
+    {
+        std::clog << ex.what() << "\n";
+        return -1;
+    }
+    return return_value;
+}
@@ -3,14 +3,23 @@
 #include <mapnik/attribute.hpp>
 #include <mapnik/expression.hpp>
 #include <mapnik/expression_string.hpp>
+#include <mapnik/parse_cache.hpp>
+#include <mapnik/boolean.hpp>
 
+// --cached true: parse through the parse_cache instead of the grammar
 class test : public benchmark::test_case
 {
     std::string expr_;
 public:
     test(mapnik::parameters const& params)
      : test_case(params),
-       expr_("((([mapnik::geometry_type]=2) and ([oneway]=1)) and ([class]='path'))") {}
+       expr_("((([mapnik::geometry_type]=2) and ([oneway]=1)) and ([class]='path'))")
+    {
+        if (!*params.get<mapnik::boolean_type>("cached", false))
+        {
+            mapnik::parse_cache::instance().set_max_entries(0);
+        }
+    }
     bool validate() const
     {
         mapnik::expression_ptr expr = mapnik::parse_expression(expr_);
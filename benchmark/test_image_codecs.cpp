@@ -0,0 +1,207 @@
+#include "bench_framework.hpp"
+#include <mapnik/image.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/image_reader.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+
+// --tile sparse|dense|satellite|hillshade|overlay (default: dense)
+// --image FILE       encode FILE instead of a generated tile
+// --format FORMAT    any save_to_string format, e.g. png8:m=h, png8:m=o,
+//                    png32:z=1, jpeg85, webp:quality=80, webp:lossless=1, tiff
+// --decode true      time image_reader on the encoded tile instead
+// --size N           width and height of generated tiles (default: 256)
+// MB/s are of the rgba pixels going in or coming out.
+namespace {
+
+std::uint32_t rgba(unsigned r, unsigned g, unsigned b, unsigned a)
+{
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+// stand-ins for the tiles a server encodes, from nearly empty to noisy
+mapnik::image_rgba8 make_tile(std::string const& type, std::size_t size)
+{
+    mapnik::image_rgba8 im(size, size);
+    std::default_random_engine engine(42);
+    std::uniform_int_distribution<unsigned> byte(0, 255);
+    if (type == "sparse")
+    {
+        // transparent but for a few roads
+        for (std::size_t road = 0; road < 6; ++road)
+        {
+            double slope = (byte(engine) - 128) / 64.0;
+            double offset = byte(engine) * size / 256.0;
+            std::uint32_t color = rgba(200 + byte(engine) % 56, 180, 120, 255);
+            for (std::size_t x = 0; x < size; ++x)
+            {
+                long y = static_cast<long>(offset + slope * x);
+                for (long dy = 0; dy < 3; ++dy)
+                {
+                    if (y + dy >= 0 && y + dy < static_cast<long>(size)) im(x, y + dy) = color;
+                }
+            }
+        }
+    }
+    else if (type == "dense")
+    {
+        // buildings and landuse in a small palette over an opaque ground
+        std::uint32_t palette[8];
+        for (auto & c : palette) c = rgba(byte(engine), byte(engine), byte(engine), 255);
+        std::fill(im.begin(), im.end(), rgba(242, 239, 233, 255));
+        for (std::size_t n = 0; n < size * 2; ++n)
+        {
+            std::size_t x0 = byte(engine) * size / 256;
+            std::size_t y0 = byte(engine) * size / 256;
+            std::size_t w = 2 + byte(engine) % 24;
+            std::size_t h = 2 + byte(engine) % 24;
+            std::uint32_t color = palette[n % 8];
+            for (std::size_t y = y0; y < std::min(y0 + h, size); ++y)
+            {
+                for (std::size_t x = x0; x < std::min(x0 + w, size); ++x) im(x, y) = color;
+            }
+        }
+    }
+    else if (type == "satellite")
+    {
+        // smooth ground colors with per pixel noise
+        for (std::size_t y = 0; y < size; ++y)
+        {
+            for (std::size_t x = 0; x < size; ++x)
+            {
+                double base = 90 + 40 * std::sin(x / 17.0) * std::cos(y / 23.0);
+                unsigned noise = byte(engine) % 32;
+                im(x, y) = rgba(static_cast<unsigned>(base) + noise,
+                                static_cast<unsigned>(base * 1.1) + noise,
+                                static_cast<unsigned>(base * 0.7) + noise, 255);
+            }
+        }
+    }
+    else if (type == "hillshade")
+    {
+        // grey relief, smooth with little noise
+        for (std::size_t y = 0; y < size; ++y)
+        {
+            for (std::size_t x = 0; x < size; ++x)
+            {
+                double z = std::sin(x / 31.0) + std::cos(y / 19.0) + 0.5 * std::sin((x + y) / 11.0);
+                unsigned grey = static_cast<unsigned>(128 + 50 * z) % 256;
+                im(x, y) = rgba(grey, grey, grey, 255);
+            }
+        }
+    }
+    else if (type == "overlay")
+    {
+        // translucent shading of one color, alpha varying across the tile
+        for (std::size_t y = 0; y < size; ++y)
+        {
+            for (std::size_t x = 0; x < size; ++x)
+            {
+                unsigned alpha = static_cast<unsigned>(96 + 80 * std::sin(x / 40.0) * std::sin(y / 40.0));
+                im(x, y) = rgba(30, 60, 160, alpha);
+            }
+        }
+    }
+    else
+    {
+        throw std::runtime_error("unknown tile: " + type);
+    }
+    return im;
+}
+
+mapnik::image_rgba8 load_tile(std::string const& filename)
+{
+    std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(filename));
+    if (!reader) throw std::runtime_error("cannot read " + filename);
+    mapnik::image_rgba8 im(reader->width(), reader->height());
+    reader->read(0, 0, im);
+    return im;
+}
+
+}
+
+class test : public benchmark::test_case
+{
+    mapnik::image_rgba8 im_;
+    std::string format_;
+    bool decode_;
+    std::string encoded_;
+public:
+    test(mapnik::parameters const& params)
+     : test_case(params),
+       im_(params.get<std::string>("image")
+           ? load_tile(*params.get<std::string>("image"))
+           : make_tile(*params.get<std::string>("tile", "dense"),
+                       mapnik::safe_cast<std::size_t>(*params.get<mapnik::value_integer>("size", 256)))),
+       format_(*params.get<std::string>("format", "png8:m=h")),
+       decode_(*params.get<mapnik::boolean_type>("decode", false)),
+       encoded_(mapnik::save_to_string(im_, format_)) {}
+
+    std::size_t encoded_size() const
+    {
+        return encoded_.size();
+    }
+
+    std::size_t bytes_per_iteration() const
+    {
+        return im_.size();
+    }
+
+    bool validate() const
+    {
+        std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(encoded_.data(), encoded_.size()));
+        return reader && reader->width() == im_.width() && reader->height() == im_.height();
+    }
+
+    bool operator()() const
+    {
+        if (decode_)
+        {
+            mapnik::image_rgba8 im(im_.width(), im_.height());
+            for (std::size_t i = 0; i < iterations_; ++i)
+            {
+                std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(encoded_.data(), encoded_.size()));
+                reader->read(0, 0, im);
+            }
+        }
+        else
+        {
+            for (std::size_t i = 0; i < iterations_; ++i)
+            {
+                std::string out = mapnik::save_to_string(im_, format_);
+                if (out.empty()) return false;
+            }
+        }
+        return true;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        mapnik::parameters params;
+        benchmark::handle_args(argc, argv, params);
+        test test_runner(params);
+        std::string tile = params.get<std::string>("image")
+            ? *params.get<std::string>("image")
+            : *params.get<std::string>("tile", "dense");
+        std::string name = (*params.get<mapnik::boolean_type>("decode", false) ? "decode " : "encode ")
+            + *params.get<std::string>("format", "png8:m=h") + " " + tile;
+        int status = run(test_runner, name);
+        char msg[200];
+        std::snprintf(msg, sizeof(msg), "%-43s output %zu bytes, %.2f bits/pixel\n", "",
+                      test_runner.encoded_size(),
+                      8.0 * test_runner.encoded_size() / (test_runner.bytes_per_iteration() / 4));
+        std::clog << msg;
+        return status;
+    }
+    catch (std::exception const& ex)
+    {
+        std::clog << ex.what() << "\n";
+        return -1;
+    }
+}
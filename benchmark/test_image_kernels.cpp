@@ -0,0 +1,95 @@
+#include "bench_framework.hpp"
+#include <mapnik/image_kernels.hpp>
+#include <vector>
+#include <cstdint>
+
+// --kernel premultiply|demultiply|apply_opacity|all_equal|set_color_to_alpha
+// --isa scalar|sse2|avx2|neon (default: the best one supported)
+class test : public benchmark::test_case
+{
+    std::string kernel_;
+    mapnik::simd::rgba8_kernels const* kernels_;
+    std::vector<std::uint32_t> pixels_;
+public:
+    test(mapnik::parameters const& params)
+     : test_case(params),
+       kernel_(*params.get<std::string>("kernel", "premultiply")),
+       kernels_(&mapnik::simd::rgba8()),
+       pixels_(512 * 512)
+    {
+        using mapnik::simd::isa;
+        boost::optional<std::string> name = params.get<std::string>("isa");
+        if (name)
+        {
+            isa id = isa::scalar;
+            if (*name == "sse2") id = isa::sse2;
+            else if (*name == "avx2") id = isa::avx2;
+            else if (*name == "neon") id = isa::neon;
+            if (!mapnik::simd::supported(id))
+            {
+                throw std::runtime_error(*name + " kernels are not supported here");
+            }
+            kernels_ = &mapnik::simd::rgba8(id);
+        }
+        for (std::size_t i = 0; i < pixels_.size(); ++i)
+        {
+            pixels_[i] = static_cast<std::uint32_t>(i * 2654435761u);
+        }
+    }
+
+    bool validate() const
+    {
+        auto const& scalar = mapnik::simd::rgba8(mapnik::simd::isa::scalar);
+        std::vector<std::uint32_t> expected = pixels_;
+        std::vector<std::uint32_t> actual = pixels_;
+        run(scalar, expected);
+        run(*kernels_, actual);
+        return expected == actual;
+    }
+
+    bool operator()() const
+    {
+        std::vector<std::uint32_t> pixels = pixels_;
+        for (std::size_t i = 0; i < iterations_; ++i)
+        {
+            run(*kernels_, pixels);
+        }
+        return true;
+    }
+
+private:
+    void run(mapnik::simd::rgba8_kernels const& kernels, std::vector<std::uint32_t> & pixels) const
+    {
+        if (kernel_ == "premultiply")
+        {
+            kernels.premultiply(pixels.data(), pixels.size());
+        }
+        else if (kernel_ == "demultiply")
+        {
+            kernels.demultiply(pixels.data(), pixels.size());
+        }
+        else if (kernel_ == "apply_opacity")
+        {
+            kernels.apply_opacity(pixels.data(), pixels.size(), 0.99f);
+        }
+        else if (kernel_ == "all_equal")
+        {
+            // a solid image is the worst case, every pixel is read
+            std::fill(pixels.begin(), pixels.end(), pixels_[1]);
+            if (!kernels.all_equal(pixels.data(), pixels.size(), pixels_[1]))
+            {
+                throw std::runtime_error("all_equal failed");
+            }
+        }
+        else if (kernel_ == "set_color_to_alpha")
+        {
+            kernels.set_color_to_alpha(pixels.data(), pixels.size(), pixels_[7]);
+        }
+        else
+        {
+            throw std::runtime_error("unknown kernel: " + kernel_);
+        }
+    }
+};
+
+BENCHMARK(test,"rgba8 image kernels")
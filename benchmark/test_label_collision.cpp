@@ -0,0 +1,64 @@
+#include "bench_framework.hpp"
+#include <mapnik/quad_tree.hpp>
+#include <mapnik/bucket_grid.hpp>
+#include <random>
+
+// simulates text placement on a dense tile: every candidate box is
+// checked for collisions and inserted if it does not collide
+template <typename Index>
+class test : public benchmark::test_case
+{
+public:
+    test(mapnik::parameters const& params)
+     : test_case(params) {}
+
+    bool validate() const
+    {
+        Index index(mapnik::box2d<double>(0, 0, 100, 100));
+        index.insert(1, mapnik::box2d<double>(10, 10, 20, 20));
+        index.insert(2, mapnik::box2d<double>(60, 60, 70, 70));
+        std::size_t count = 0;
+        for (auto itr = index.query_in_box(mapnik::box2d<double>(15, 15, 25, 25)); itr != index.query_end(); ++itr)
+        {
+            if (itr->get() == 1) ++count;
+        }
+        return count == 1;
+    }
+
+    bool operator()() const
+    {
+        std::default_random_engine engine(42);
+        std::uniform_real_distribution<double> pos(-128, 1152);
+        std::uniform_real_distribution<double> length(20, 120);
+        Index index(mapnik::box2d<double>(-128, -128, 1152, 1152));
+        for (std::size_t run = 0; run < 10; ++run)
+        {
+            index.clear();
+            for (std::size_t i = 0; i < iterations_; ++i)
+            {
+                double x = pos(engine);
+                double y = pos(engine);
+                mapnik::box2d<double> box(x, y, x + length(engine), y + 12);
+                bool collision = false;
+                for (auto itr = index.query_in_box(box); itr != index.query_end(); ++itr)
+                {
+                    if (itr->get() % 2 == 0) // touch the value
+                    {
+                        collision = true;
+                        break;
+                    }
+                }
+                if (!collision) index.insert(i, box);
+            }
+        }
+        return true;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    return benchmark::sequencer(argc, argv)
+        .run<test<mapnik::quad_tree<std::size_t>>>("label collision quad_tree")
+        .run<test<mapnik::bucket_grid<std::size_t>>>("label collision bucket_grid")
+        .done();
+}
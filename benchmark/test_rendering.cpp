@@ -5,7 +5,36 @@
 #include <mapnik/agg_renderer.hpp>
 #include <mapnik/datasource_cache.hpp>
 #include <mapnik/font_engine_freetype.hpp>
+#include <cmath>
+#include <sstream>
 #include <stdexcept>
+#include <vector>
+
+// spherical mercator tile grid
+static const double merc_max = 20037508.342789244;
+
+// the extents of a block of about num_tiles tiles at zoom around a center
+// given in spherical mercator meters
+std::vector<mapnik::box2d<double>> tile_block(double cx, double cy, int zoom, std::size_t num_tiles)
+{
+    double size = 2.0 * merc_max / std::pow(2.0, zoom);
+    long max_index = (1L << zoom) - 1;
+    long side = static_cast<long>(std::ceil(std::sqrt(static_cast<double>(std::max<std::size_t>(num_tiles, 1)))));
+    long x0 = static_cast<long>(std::floor((cx + merc_max) / size)) - side / 2;
+    long y0 = static_cast<long>(std::floor((merc_max - cy) / size)) - side / 2;
+    std::vector<mapnik::box2d<double>> tiles;
+    for (long y = y0; y < y0 + side && tiles.size() < num_tiles; ++y)
+    {
+        for (long x = x0; x < x0 + side && tiles.size() < num_tiles; ++x)
+        {
+            long tx = std::min(std::max(x, 0L), max_index);
+            long ty = std::min(std::max(y, 0L), max_index);
+            tiles.emplace_back(-merc_max + tx * size, merc_max - (ty + 1) * size,
+                               -merc_max + (tx + 1) * size, merc_max - ty * size);
+        }
+    }
+    return tiles;
+}
 
 class test : public benchmark::test_case
 {
@@ -15,15 +44,22 @@ class test : public benchmark::test_case
     mapnik::value_integer height_;
     double scale_factor_;
     std::string preview_;
+    // encode every image when set, e.g. png8:m=h
+    std::string format_;
+    // with tiles every iteration renders the next one instead of extent
+    std::vector<mapnik::box2d<double>> tiles_;
 public:
-    test(mapnik::parameters const& params)
+    test(mapnik::parameters const& params,
+         std::vector<mapnik::box2d<double>> const& tiles = std::vector<mapnik::box2d<double>>())
      : test_case(params),
        xml_(),
        extent_(),
        width_(*params.get<mapnik::value_integer>("width",256)),
        height_(*params.get<mapnik::value_integer>("height",256)),
        scale_factor_(*params.get<mapnik::value_double>("scale_factor",1.0)),
-       preview_(*params.get<std::string>("preview",""))
+       preview_(*params.get<std::string>("preview","")),
+       format_(*params.get<std::string>("format","")),
+       tiles_(tiles)
       {
         boost::optional<std::string> map = params.get<std::string>("map");
         if (!map)
@@ -45,18 +81,27 @@ public:
         }*/
 
       }
-    bool validate() const
+    void zoom(mapnik::Map & m, std::size_t i) const
     {
-        mapnik::Map m(width_,height_);
-        mapnik::load_map(m,xml_,true);
-        if (extent_.valid()) {
+        if (!tiles_.empty()) {
+            m.zoom_to_box(tiles_[i % tiles_.size()]);
+        } else if (extent_.valid()) {
             m.zoom_to_box(extent_);
         } else {
             m.zoom_all();
         }
+    }
+    bool validate() const
+    {
+        mapnik::Map m(width_,height_);
+        mapnik::load_map(m,xml_,true);
+        zoom(m, 0);
         mapnik::image_rgba8 im(m.width(),m.height());
         mapnik::agg_renderer<mapnik::image_rgba8> ren(m,im,scale_factor_);
         ren.apply();
+        if (!format_.empty() && mapnik::save_to_string(im,format_).empty()) {
+            return false;
+        }
         if (!preview_.empty()) {
             std::clog << "preview available at " << preview_ << "\n";
             mapnik::save_to_file(im,preview_);
@@ -70,16 +115,16 @@ public:
         }
         mapnik::Map m(width_,height_);
         mapnik::load_map(m,xml_);
-        if (extent_.valid()) {
-            m.zoom_to_box(extent_);
-        } else {
-            m.zoom_all();
-        }
+        zoom(m, 0);
         for (unsigned i=0;i<iterations_;++i)
         {
+            if (!tiles_.empty()) zoom(m, i);
             mapnik::image_rgba8 im(m.width(),m.height());
             mapnik::agg_renderer<mapnik::image_rgba8> ren(m,im,scale_factor_);
             ren.apply();
+            if (!format_.empty()) {
+                mapnik::save_to_string(im,format_);
+            }
         }
         return true;
     }
@@ -101,6 +146,30 @@ int main(int argc, char** argv)
         }
         mapnik::freetype_engine::register_fonts("./fonts/",true);
         mapnik::datasource_cache::instance().register_datasources("./plugins/input/");
+        // --zooms 10-17 --center <x,y> renders a block of --tiles tiles per
+        // zoom around the center, in spherical mercator, reported per zoom
+        boost::optional<std::string> zooms = params.get<std::string>("zooms");
+        if (zooms)
+        {
+            int min_zoom = 0, max_zoom = 0;
+            char dash = 0;
+            std::istringstream zoom_range(*zooms);
+            zoom_range >> min_zoom;
+            if (!(zoom_range >> dash >> max_zoom)) max_zoom = min_zoom;
+            mapnik::box2d<double> center;
+            boost::optional<std::string> center_str = params.get<std::string>("center");
+            if (!center_str || !center.from_string(*center_str + "," + *center_str))
+            {
+                throw std::runtime_error("please provide a --center=<x,y> arg in spherical mercator");
+            }
+            std::size_t num_tiles = mapnik::safe_cast<std::size_t>(*params.get<mapnik::value_integer>("tiles",16));
+            for (int z = min_zoom; z <= max_zoom; ++z)
+            {
+                test test_runner(params, tile_block(center.minx(), center.miny(), z, num_tiles));
+                return_value |= run(test_runner, *name + " z" + std::to_string(z));
+            }
+        }
+        else
         {
             test test_runner(params);
             return_value = run(test_runner,*name);
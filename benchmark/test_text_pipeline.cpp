@@ -0,0 +1,240 @@
+#include "bench_framework.hpp"
+#include <mapnik/map.hpp>
+#include <mapnik/load_map.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/view_transform.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/label_collision_detector.hpp>
+#include <mapnik/font_engine_freetype.hpp>
+#include <mapnik/text/font_library.hpp>
+#include <mapnik/text/itemizer.hpp>
+#include <mapnik/text/text_line.hpp>
+#include <mapnik/text/text_layout.hpp>
+#include <mapnik/text/harfbuzz_shaper.hpp>
+#include <mapnik/text/placements/base.hpp>
+#include <mapnik/text/symbolizer_helpers.hpp>
+#include <mapnik/text/renderer.hpp>
+#include <map>
+#include <random>
+#include <cmath>
+
+// One stage of the text pipeline at a time:
+// --stage itemize|shape|layout|point|line|collision|render
+// --script latin|cjk|arabic|mixed
+// --halo <radius> (render only, default 2)
+// Faces come from ./fonts and are all put in one fontset, so scripts the
+// first face lacks fall back as they do in a style with a fontset.
+class test : public benchmark::test_case
+{
+    std::string stage_;
+    mapnik::value_unicode_string text_;
+    mapnik::Map map_;
+    mapnik::font_set fontset_;
+    mapnik::text_symbolizer sym_;
+public:
+    test(mapnik::parameters const& params)
+     : test_case(params),
+       stage_(*params.get<std::string>("stage", "shape")),
+       text_(),
+       map_(1024, 1024),
+       fontset_("all"),
+       sym_()
+    {
+        std::string script = *params.get<std::string>("script", "latin");
+        std::string text;
+        if (script == "latin") text = u8"Rue du Faubourg Saint-Honoré, Champs-Élysées";
+        else if (script == "cjk") text = u8"北京市朝阳区建国门外大街 東京都千代田区丸の内";
+        else if (script == "arabic") text = u8"شارع الملك فيصل بن عبد العزيز الرياض";
+        else if (script == "mixed") text = u8"Avenue 建国门 شارع الملك Straße 丸の内";
+        else throw std::runtime_error("unknown script: " + script);
+        text_ = mapnik::transcoder("utf-8").transcode(text.c_str());
+
+        std::string placement = stage_ == "line" ? "line" : "point";
+        double halo = *params.get<mapnik::value_double>("halo", 2.0);
+        std::string xml = "<Map><FontSet name='all'>";
+        for (std::string const& name : mapnik::freetype_engine::face_names())
+        {
+            fontset_.add_face_name(name);
+            xml += "<Font face-name='" + name + "'/>";
+        }
+        xml += "</FontSet><Style name='text'><Rule>"
+            "<TextSymbolizer fontset-name='all' size='14' wrap-width='120' spacing='200'"
+            " placement='" + placement + "' halo-radius='" + std::to_string(halo) + "'>[name]</TextSymbolizer>"
+            "</Rule></Style></Map>";
+        mapnik::load_map_string(map_, xml);
+        auto style = map_.find_style("text");
+        sym_ = style->get_rules().front().get_symbolizers().front().get<mapnik::text_symbolizer>();
+    }
+
+    bool validate() const
+    {
+        mapnik::font_library library;
+        mapnik::freetype_engine::font_file_mapping_type mapping;
+        mapnik::freetype_engine::font_memory_cache_type cache;
+        mapnik::face_manager_freetype fm(library, mapping, cache);
+        return shape(fm) > 0 && place(fm, stage_ == "line").size() > 0;
+    }
+
+    bool operator()() const
+    {
+        mapnik::font_library library;
+        mapnik::freetype_engine::font_file_mapping_type mapping;
+        mapnik::freetype_engine::font_memory_cache_type cache;
+        mapnik::face_manager_freetype fm(library, mapping, cache);
+        if (stage_ == "itemize")
+        {
+            mapnik::text_itemizer itemizer;
+            auto format = evaluated_format();
+            for (std::size_t i = 0; i < iterations_; ++i)
+            {
+                itemizer.clear();
+                itemizer.add_text(text_, format);
+                itemizer.itemize();
+            }
+        }
+        else if (stage_ == "shape")
+        {
+            for (std::size_t i = 0; i < iterations_; ++i) shape(fm);
+        }
+        else if (stage_ == "layout")
+        {
+            auto feature = make_feature(false);
+            mapnik::attributes vars;
+            auto const& placements = mapnik::get<mapnik::text_placements_ptr>(sym_, mapnik::keys::text_placements_);
+            mapnik::text_symbolizer_properties const& props = placements->defaults;
+            for (std::size_t i = 0; i < iterations_; ++i)
+            {
+                mapnik::text_layout layout(fm, *feature, vars, 1.0, props, props.layout_defaults, props.format_tree());
+                layout.layout();
+            }
+        }
+        else if (stage_ == "point" || stage_ == "line")
+        {
+            for (std::size_t i = 0; i < iterations_; ++i) place(fm, stage_ == "line");
+        }
+        else if (stage_ == "collision")
+        {
+            // a crowded tile: most candidates collide with a label already placed
+            std::default_random_engine engine(42);
+            std::uniform_real_distribution<double> pos(0, 1024);
+            auto feature = make_feature(false);
+            mapnik::attributes vars;
+            mapnik::projection proj("+init=epsg:3857", true);
+            mapnik::proj_transform prj_trans(proj, proj);
+            mapnik::view_transform t(1024, 1024, mapnik::box2d<double>(0, 0, 1024, 1024));
+            mapnik::box2d<double> extent(0, 0, 1024, 1024);
+            for (std::size_t i = 0; i < iterations_; ++i)
+            {
+                mapnik::label_collision_detector4 detector(extent);
+                for (std::size_t n = 0; n < 200; ++n)
+                {
+                    feature->set_geometry(mapnik::geometry::point<double>(pos(engine), pos(engine)));
+                    mapnik::text_symbolizer_helper helper(sym_, *feature, vars, prj_trans, 1024, 1024, 1.0, t,
+                                                          fm, detector, extent, agg::trans_affine());
+                    helper.get();
+                }
+            }
+        }
+        else if (stage_ == "render")
+        {
+            mapnik::label_collision_detector4 detector(mapnik::box2d<double>(0, 0, 1024, 1024));
+            mapnik::projection proj("+init=epsg:3857", true);
+            mapnik::proj_transform prj_trans(proj, proj);
+            mapnik::view_transform t(1024, 1024, mapnik::box2d<double>(0, 0, 1024, 1024));
+            auto feature = make_feature(false);
+            mapnik::attributes vars;
+            mapnik::text_symbolizer_helper helper(sym_, *feature, vars, prj_trans, 1024, 1024, 1.0, t,
+                                                  fm, detector, mapnik::box2d<double>(0, 0, 1024, 1024),
+                                                  agg::trans_affine());
+            mapnik::placements_list const& placements = helper.get();
+            mapnik::image_rgba8 im(1024, 1024);
+            mapnik::agg_text_renderer<mapnik::image_rgba8> ren(im, mapnik::HALO_RASTERIZER_FULL,
+                                                               mapnik::src_over, mapnik::src_over,
+                                                               1.0, fm.get_stroker());
+            for (std::size_t i = 0; i < iterations_; ++i)
+            {
+                for (auto const& glyphs : placements) ren.render(*glyphs);
+            }
+        }
+        else
+        {
+            throw std::runtime_error("unknown stage: " + stage_);
+        }
+        return true;
+    }
+
+private:
+    mapnik::evaluated_format_properties_ptr evaluated_format() const
+    {
+        auto format = std::make_unique<mapnik::detail::evaluated_format_properties>();
+        format->fontset = fontset_;
+        format->text_size = 14;
+        return format;
+    }
+
+    mapnik::feature_ptr make_feature(bool line) const
+    {
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+        feature->put_new("name", text_);
+        if (line)
+        {
+            // a gentle curve across the tile
+            mapnik::geometry::line_string<double> path;
+            for (int x = 0; x <= 1024; x += 16)
+            {
+                path.emplace_back(x, 512 + 100 * std::sin(x / 160.0));
+            }
+            feature->set_geometry(std::move(path));
+        }
+        else
+        {
+            feature->set_geometry(mapnik::geometry::point<double>(512, 512));
+        }
+        return feature;
+    }
+
+    std::size_t shape(mapnik::face_manager_freetype & fm) const
+    {
+        mapnik::text_itemizer itemizer;
+        itemizer.add_text(text_, evaluated_format());
+        std::map<unsigned, double> width_map;
+        mapnik::text_line line(0, text_.length());
+        mapnik::harfbuzz_shaper::shape_text(line, itemizer, width_map, fm, 1.0);
+        return line.size();
+    }
+
+    std::size_t place(mapnik::face_manager_freetype & fm, bool line) const
+    {
+        auto feature = make_feature(line);
+        mapnik::attributes vars;
+        mapnik::projection proj("+init=epsg:3857", true);
+        mapnik::proj_transform prj_trans(proj, proj);
+        mapnik::view_transform t(1024, 1024, mapnik::box2d<double>(0, 0, 1024, 1024));
+        mapnik::box2d<double> extent(0, 0, 1024, 1024);
+        mapnik::label_collision_detector4 detector(extent);
+        mapnik::text_symbolizer_helper helper(sym_, *feature, vars, prj_trans, 1024, 1024, 1.0, t,
+                                              fm, detector, extent, agg::trans_affine());
+        return helper.get().size();
+    }
+};
+
+int main(int argc, char** argv)
+{
+    mapnik::parameters params;
+    benchmark::handle_args(argc, argv, params);
+    if (!mapnik::freetype_engine::register_fonts("./fonts", true))
+    {
+        std::clog << "warning, did not register any new fonts!\n";
+        return -1;
+    }
+    test test_runner(params);
+    return run(test_runner, "text pipeline: " + *params.get<std::string>("stage", "shape")
+               + " " + *params.get<std::string>("script", "latin"));
+}
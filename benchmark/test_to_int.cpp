@@ -1,29 +1,47 @@
 #include "bench_framework.hpp"
 #include <mapnik/util/conversions.hpp>
+#include <mapnik/boolean.hpp>
 
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/spirit/home/x3.hpp>
+#pragma GCC diagnostic pop
+
+// --value <integer> (default 123456789)
+// --x3 true: run the x3 integer parser string2int used to be, for comparison
 class test : public benchmark::test_case
 {
     std::string value_;
+    bool x3_;
 public:
     test(mapnik::parameters const& params)
      : test_case(params),
-       value_("123456789") {}
+       value_(*params.get<std::string>("value", "123456789")),
+       x3_(*params.get<mapnik::boolean_type>("x3", false)) {}
+    bool parse(char const* itr, char const* end, mapnik::value_integer & result) const
+    {
+        if (!x3_) return mapnik::util::string2int(itr, end, result);
+        namespace x3 = boost::spirit::x3;
+        static x3::int_parser<mapnik::value_integer, 10, 1, -1> const integer;
+        return x3::phrase_parse(itr, end, integer, x3::ascii::space, result) && itr == end;
+    }
     bool validate() const
     {
+        mapnik::value_integer expected = std::stoll(value_);
         mapnik::value_integer result = 0;
-        if (!mapnik::util::string2int(value_.data(),value_.data()+value_.size(),result)) return false;
-        if (result != 123456789) return false;
+        if (!parse(value_.data(),value_.data()+value_.size(),result)) return false;
+        if (result != expected) return false;
         result = 0;
         if (!mapnik::util::string2int(value_,result)) return false;
-        if (result != 123456789) return false;
+        if (result != expected) return false;
         return true;
     }
     bool operator()() const
     {
         for (std::size_t i=0;i<iterations_;++i) {
             mapnik::value_integer result = 0;
-            mapnik::util::string2int(value_,result);
-            mapnik::util::string2int(value_.data(),value_.data()+value_.size(),result);
+            parse(value_.data(),value_.data()+value_.size(),result);
+            parse(value_.data(),value_.data()+value_.size(),result);
         }
         return true;
     }
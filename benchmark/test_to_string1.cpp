@@ -1,25 +1,44 @@
 #include "bench_framework.hpp"
 #include <mapnik/util/conversions.hpp>
+#include <mapnik/boolean.hpp>
+#include <cstdio>
 
+// --value <number> (default -0.1234)
+// --printf true: format with snprintf("%g") as to_string used to, for comparison
 class test : public benchmark::test_case
 {
     double value_;
+    bool printf_;
 public:
     test(mapnik::parameters const& params)
      : test_case(params),
-       value_(-0.1234) {}
+       value_(*params.get<double>("value", -0.1234)),
+       printf_(*params.get<mapnik::boolean_type>("printf", false)) {}
+    void format(std::string & out, double value) const
+    {
+        if (!printf_)
+        {
+            mapnik::util::to_string(out, value);
+            return;
+        }
+        char buffer[32];
+        int size = std::snprintf(buffer, sizeof(buffer), "%g", value);
+        out.assign(buffer, static_cast<std::size_t>(size));
+    }
     bool validate() const
     {
+        char expected[32];
+        std::snprintf(expected, sizeof(expected), "%g", value_);
         std::string s;
-        mapnik::util::to_string(s,value_);
-        return (s == "-0.1234");
+        format(s, value_);
+        return (s == expected);
     }
     bool operator()() const
     {
         std::string out;
         for (std::size_t i=0;i<iterations_;++i) {
             out.clear();
-            mapnik::util::to_string(out,value_);
+            format(out,value_);
         }
         return true;
     }
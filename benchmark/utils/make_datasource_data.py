@@ -0,0 +1,76 @@
+#!/usr/bin/env python
+"""
+Generates the data of the datasource benchmarks (benchmark/run_datasources)
+into benchmark/data/datasources: line features with a few attributes at
+several sizes, as csv, geojson and topojson. Shapefile, sqlite and geobuf
+copies are made by run_datasources from the geojson when ogr2ogr and
+json2geobuf are available.
+"""
+
+import argparse
+import json
+import os
+import random
+
+
+def lines(rnd, count, vertices):
+    for fid in range(count):
+        x, y = rnd.uniform(-179, 179), rnd.uniform(-85, 85)
+        points = []
+        for _ in range(vertices):
+            x = min(180.0, max(-180.0, x + rnd.uniform(-0.01, 0.01)))
+            y = min(85.0, max(-85.0, y + rnd.uniform(-0.01, 0.01)))
+            points.append([round(x, 6), round(y, 6)])
+        yield fid, points, {
+            'name': 'feature %d' % fid,
+            'class': rnd.choice(['motorway', 'primary', 'secondary', 'residential']),
+            'lanes': rnd.randint(1, 6),
+            'speed': round(rnd.uniform(10, 130), 1)}
+
+
+def write_csv(path, features):
+    with open(path, 'w') as out:
+        out.write('WKT,fid,name,class,lanes,speed\n')
+        for fid, points, props in features:
+            out.write('"LINESTRING (%s)",%d,%s,%s,%d,%s\n' % (
+                ','.join('%s %s' % (p[0], p[1]) for p in points), fid,
+                props['name'], props['class'], props['lanes'], props['speed']))
+
+
+def write_geojson(path, features):
+    with open(path, 'w') as out:
+        json.dump({'type': 'FeatureCollection', 'features': [
+            {'type': 'Feature', 'id': fid, 'properties': props,
+             'geometry': {'type': 'LineString', 'coordinates': points}}
+            for fid, points, props in features]}, out)
+
+
+def write_topojson(path, features):
+    arcs, geometries = [], []
+    for fid, points, props in features:
+        geometries.append({'type': 'LineString', 'arcs': [len(arcs)], 'id': fid, 'properties': props})
+        arcs.append(points)
+    with open(path, 'w') as out:
+        json.dump({'type': 'Topology', 'arcs': arcs,
+                   'objects': {'lines': {'type': 'GeometryCollection', 'geometries': geometries}}}, out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--sizes', default='1000,10000,100000')
+    parser.add_argument('--vertices', type=int, default=20)
+    parser.add_argument('--out', default=os.path.join(os.path.dirname(__file__), '..', 'data', 'datasources'))
+    args = parser.parse_args()
+    if not os.path.isdir(args.out):
+        os.makedirs(args.out)
+    for size in [int(s) for s in args.sizes.split(',')]:
+        features = list(lines(random.Random(args.seed), size, args.vertices))
+        base = os.path.join(args.out, 'lines-%d' % size)
+        write_csv(base + '.csv', features)
+        write_geojson(base + '.geojson', features)
+        write_topojson(base + '.topojson', features)
+
+
+if __name__ == '__main__':
+    main()
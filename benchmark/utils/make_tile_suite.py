@@ -0,0 +1,118 @@
+#!/usr/bin/env python
+"""
+Generates the data of the tile rendering suite (benchmark/run_tile_suite)
+into benchmark/data/suite: an OSM shaped street network with names, a
+label heavy set of city center places and large landuse polygons, all in
+spherical mercator around the suite's center. The output only depends on
+--seed, so timings from different machines compare.
+"""
+
+import argparse
+import json
+import math
+import os
+import random
+
+CENTER = (1478500.0, 6891500.0)
+
+CLASSES = [
+    # class, spacing (m), half extent (m), vertices per km, jitter (m)
+    ('motorways', 8000.0, 40000.0, 20, 120.0),
+    ('mainroads', 1000.0, 20000.0, 30, 25.0),
+    ('minorroads', 120.0, 5000.0, 40, 6.0),
+]
+
+SYLLABLES = ['ber', 'lin', 'stra', 'sse', 'weg', 'platz', 'allee', 'dam',
+             'kir', 'chen', 'gar', 'ten', 'ufer', 'ring', 'hof', 'wald']
+
+
+def name(rnd, parts):
+    return ''.join(rnd.choice(SYLLABLES) for _ in range(parts)).capitalize()
+
+
+def wkt_line(points):
+    return 'LINESTRING (%s)' % ','.join('%.2f %.2f' % p for p in points)
+
+
+def streets(rnd, path):
+    fid = 0
+    with open(path, 'w') as out:
+        out.write('WKT,fid,class,name,bridge,z_order\n')
+        for cls, spacing, half, per_km, jitter in CLASSES:
+            count = int(2 * half / spacing) + 1
+            steps = max(2, int(2 * half / 1000.0 * per_km))
+            for axis in (0, 1):
+                for i in range(count):
+                    offset = -half + i * spacing
+                    phase = rnd.random() * math.pi * 2
+                    points = []
+                    for s in range(steps + 1):
+                        t = -half + 2 * half * s / steps
+                        wobble = math.sin(t / (spacing * 2.0) + phase) * jitter * 3
+                        wobble += rnd.uniform(-jitter, jitter)
+                        along, across = t, offset + wobble
+                        x, y = (along, across) if axis == 0 else (across, along)
+                        points.append((CENTER[0] + x, CENTER[1] + y))
+                    fid += 1
+                    out.write('"%s",%d,%s,%s,%d,%d\n' % (
+                        wkt_line(points), fid, cls, name(rnd, 2) + 'strasse',
+                        1 if rnd.random() < 0.02 else 0,
+                        {'motorways': 3, 'mainroads': 2, 'minorroads': 1}[cls]))
+
+
+def places(rnd, path, count):
+    with open(path, 'w') as out:
+        out.write('x,y,name,population\n')
+        for _ in range(count):
+            # denser towards the center, like a city
+            r = abs(rnd.gauss(0, 4000.0))
+            a = rnd.random() * math.pi * 2
+            out.write('%.2f,%.2f,%s,%d\n' % (
+                CENTER[0] + r * math.cos(a), CENTER[1] + r * math.sin(a),
+                name(rnd, rnd.randint(2, 4)), int(rnd.paretovariate(1.2) * 100)))
+
+
+def ring(rnd, cx, cy, radius, vertices):
+    points = []
+    for i in range(vertices):
+        a = 2 * math.pi * i / vertices
+        r = radius * (0.75 + 0.25 * math.sin(a * 5 + cx) + rnd.uniform(-0.05, 0.05))
+        points.append([round(cx + r * math.cos(a), 2), round(cy + r * math.sin(a), 2)])
+    points.append(points[0])
+    return points
+
+
+def landuse(rnd, path, cells, vertices):
+    features = []
+    size = 60000.0 / cells
+    kinds = ['forest', 'water', 'residential', 'park', 'industrial']
+    for i in range(cells):
+        for j in range(cells):
+            cx = CENTER[0] - 30000.0 + (i + 0.5) * size
+            cy = CENTER[1] - 30000.0 + (j + 0.5) * size
+            exterior = ring(rnd, cx, cy, size * 0.7, vertices)
+            hole = list(reversed(ring(rnd, cx, cy, size * 0.2, vertices // 4)))
+            features.append({
+                'type': 'Feature',
+                'properties': {'kind': rnd.choice(kinds), 'id': i * cells + j},
+                'geometry': {'type': 'Polygon', 'coordinates': [exterior, hole]}})
+    with open(path, 'w') as out:
+        json.dump({'type': 'FeatureCollection', 'features': features}, out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--places', type=int, default=20000)
+    parser.add_argument('--landuse-cells', type=int, default=40)
+    parser.add_argument('--landuse-vertices', type=int, default=400)
+    parser.add_argument('--out', default=os.path.join(os.path.dirname(__file__), '..', 'data', 'suite'))
+    args = parser.parse_args()
+    rnd = random.Random(args.seed)
+    streets(rnd, os.path.join(args.out, 'streets.csv'))
+    places(rnd, os.path.join(args.out, 'places.csv'), args.places)
+    landuse(rnd, os.path.join(args.out, 'landuse.geojson'), args.landuse_cells, args.landuse_vertices)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,159 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_AGG_PIXFMT_RGBA_HPP
+#define MAPNIK_AGG_PIXFMT_RGBA_HPP
+
+#ifdef SSE_MATH
+#include <mapnik/sse.hpp>
+#endif
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_pixfmt_rgba.h"
+#pragma GCC diagnostic pop
+
+// stl
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace mapnik {
+
+// agg::pixfmt_custom_blend_rgba with dedicated src-over loops for premultiplied
+// rgba8, which is what polygon and line fills end up in. Other comp-ops and
+// color types go through the agg comp_op table as before. Results are
+// identical to agg::comp_op_rgba_src_over, under SSE_MATH two pixels are
+// blended per 128 bit register.
+template <typename Blender, typename RenBuf>
+class pixfmt_comp_rgba_pre : public agg::pixfmt_custom_blend_rgba<Blender, RenBuf>
+{
+    using base_type = agg::pixfmt_custom_blend_rgba<Blender, RenBuf>;
+    static constexpr bool rgba8_pre = std::is_same<Blender,
+        agg::comp_op_adaptor_rgba_pre<agg::rgba8, agg::order_rgba>>::value;
+
+public:
+    using color_type = typename base_type::color_type;
+    using value_type = typename base_type::value_type;
+
+    explicit pixfmt_comp_rgba_pre(typename base_type::rbuf_type & rb, unsigned comp_op = 3)
+        : base_type(rb, comp_op) {}
+
+    void copy_hline(int x, int y, unsigned len, color_type const& c)
+    {
+        if (!fast_path()) return base_type::copy_hline(x, y, len, c);
+        solid_span(row(x, y), len, c, nullptr, 255);
+    }
+
+    void blend_hline(int x, int y, unsigned len, color_type const& c, agg::int8u cover)
+    {
+        if (!fast_path()) return base_type::blend_hline(x, y, len, c, cover);
+        solid_span(row(x, y), len, c, nullptr, cover);
+    }
+
+    void blend_solid_hspan(int x, int y, unsigned len, color_type const& c, agg::int8u const* covers)
+    {
+        if (!fast_path()) return base_type::blend_solid_hspan(x, y, len, c, covers);
+        solid_span(row(x, y), len, c, covers, 255);
+    }
+
+private:
+    bool fast_path() const
+    {
+        return rgba8_pre && this->comp_op() == agg::comp_op_src_over;
+    }
+
+    std::uint8_t * row(int x, int y)
+    {
+        return this->row_ptr(y) + x * 4;
+    }
+
+    // dst = src * cover + dst * (1 - src_alpha * cover) per pixel,
+    // covers may be null for a uniform cover
+    static void solid_span(std::uint8_t * p, unsigned len, color_type const& c,
+                           agg::int8u const* covers, unsigned cover)
+    {
+        // a fully transparent source leaves the destination untouched
+        if ((c.r | c.g | c.b | c.a) == 0) return;
+        unsigned x = 0;
+        if (c.a == 255 && !covers && cover == 255)
+        {
+            // opaque fill replaces the destination
+            std::uint32_t pixel;
+            std::uint8_t const rgba[4] = { static_cast<std::uint8_t>(c.r), static_cast<std::uint8_t>(c.g),
+                                           static_cast<std::uint8_t>(c.b), static_cast<std::uint8_t>(c.a) };
+            std::memcpy(&pixel, rgba, 4);
+            for (; x < len; ++x)
+            {
+                std::memcpy(p + x * 4, &pixel, 4);
+            }
+            return;
+        }
+#ifdef SSE_MATH
+        __m128i const zero = _mm_setzero_si128();
+        __m128i const base_mask = _mm_set1_epi16(255);
+        __m128i const src = _mm_set_epi16(c.a, c.b, c.g, c.r, c.a, c.b, c.g, c.r);
+        // (a * b + 255) >> 8 as used by agg::comp_op_rgba_src_over
+        auto mul_255 = [&](__m128i a, __m128i b) {
+            return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, b), base_mask), 8);
+        };
+        auto blend = [&](__m128i d, __m128i cover_16) {
+            __m128i s = mul_255(src, cover_16);
+            __m128i sa = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            return _mm_and_si128(_mm_add_epi16(s, mul_255(d, _mm_sub_epi16(base_mask, sa))), base_mask);
+        };
+        __m128i const uniform = _mm_set1_epi16(static_cast<short>(cover));
+        for (; x + 4 <= len; x += 4)
+        {
+            __m128i cover_lo = uniform;
+            __m128i cover_hi = uniform;
+            if (covers)
+            {
+                std::uint32_t packed;
+                std::memcpy(&packed, covers + x, 4);
+                if (packed == 0) continue;
+                // c0 c1 c2 c3 -> c0 x4 c1 x4 | c2 x4 c3 x4
+                __m128i cv = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(packed)), zero);
+                cv = _mm_unpacklo_epi16(cv, cv);
+                cover_lo = _mm_unpacklo_epi32(cv, cv);
+                cover_hi = _mm_unpackhi_epi32(cv, cv);
+            }
+            __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + x * 4));
+            __m128i lo = blend(_mm_unpacklo_epi8(d, zero), cover_lo);
+            __m128i hi = blend(_mm_unpackhi_epi8(d, zero), cover_hi);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p + x * 4), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; x < len; ++x)
+        {
+            unsigned pixel_cover = covers ? covers[x] : cover;
+            if (pixel_cover == 0) continue;
+            agg::comp_op_rgba_src_over<agg::rgba8, agg::order_rgba>::blend_pix(
+                p + x * 4, c.r, c.g, c.b, c.a, pixel_cover);
+        }
+    }
+};
+
+} // namespace mapnik
+
+#endif // MAPNIK_AGG_PIXFMT_RGBA_HPP
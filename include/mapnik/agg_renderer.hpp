@@ -36,7 +36,11 @@
 #include <mapnik/symbolizer_enumerations.hpp>
 #include <mapnik/renderer_common.hpp>
 #include <mapnik/image_util.hpp>
+#include <mapnik/layer_image_cache.hpp>
 // stl
+#include <algorithm>
+#include <deque>
+#include <map>
 #include <memory>
 #include <stack>
 
@@ -53,6 +57,10 @@ namespace mapnik {
   class color;
   struct marker;
   class proj_transform;
+  class compiled_symbolizer_cache;
+  class line_path_cache;
+  class label_phase;
+  class marker_sprite_cache;
   struct rasterizer;
   struct rgba8_t;
   template<typename T> class image;
@@ -60,6 +68,25 @@ namespace mapnik {
 
 namespace mapnik {
 
+// Makes the part of buffer inside box (exclusive max corner) transparent.
+template <typename T>
+void clear_region(T & buffer, box2d<int> const& box)
+{
+    if (!box.valid()) return;
+    if (box.minx() == 0 && box.miny() == 0 &&
+        box.maxx() == static_cast<int>(buffer.width()) &&
+        box.maxy() == static_cast<int>(buffer.height()))
+    {
+        mapnik::fill(buffer, 0);
+        return;
+    }
+    for (int y = box.miny(); y < box.maxy(); ++y)
+    {
+        typename T::pixel_type * row = buffer.get_row(static_cast<std::size_t>(y));
+        std::fill(row + box.minx(), row + box.maxx(), typename T::pixel_type(0));
+    }
+}
+
 template <typename T>
 class buffer_stack
 {
@@ -72,6 +99,20 @@ public:
     {
     }
 
+    // releases all buffers for reuse, keeping them if the size is unchanged
+    void reset(std::size_t width, std::size_t height)
+    {
+        if (width != width_ || height != height_)
+        {
+            buffers_.clear();
+            width_ = width;
+            height_ = height;
+        }
+        position_ = buffers_.end();
+    }
+
+    // a transparent buffer, reused ones only get the part they were
+    // painted in cleared
     T & push()
     {
         if (position_ == buffers_.begin())
@@ -82,9 +123,10 @@ public:
         else
         {
             position_--;
-            mapnik::fill(*position_, 0); // fill with transparent colour
+            clear_region(position_->buffer, position_->painted);
         }
-        return *position_;
+        position_->painted = box2d<int>(0, 0, static_cast<int>(width_), static_cast<int>(height_));
+        return position_->buffer;
     }
 
     void pop()
@@ -97,14 +139,64 @@ public:
 
     T & top() const
     {
-        return *position_;
+        return position_->buffer;
+    }
+
+    // narrows the part of the top buffer to clear on reuse, which is
+    // all of it unless set
+    void set_painted(box2d<int> const& box)
+    {
+        position_->painted = box;
     }
 
 private:
-    const std::size_t width_;
-    const std::size_t height_;
-    std::deque<T> buffers_;
-    typename std::deque<T>::iterator position_;
+    struct entry
+    {
+        entry(std::size_t width, std::size_t height)
+            : buffer(width, height),
+              painted() {}
+        T buffer;
+        box2d<int> painted;
+    };
+    std::size_t width_;
+    std::size_t height_;
+    std::deque<entry> buffers_;
+    typename std::deque<entry>::iterator position_;
+};
+
+template <typename T0, typename T1>
+class agg_renderer;
+
+// Scratch state handed to successive agg_renderers so steady state
+// rendering reuses it instead of allocating per renderer: the rasterizer
+// cells and its gamma table, the style/layer buffers, the inflated buffer
+// for image filters, the placement detector and the marker sprites. A
+// context must only be used by one renderer at a time, e.g. keep one per
+// thread.
+template <typename T0, typename T1=label_collision_detector4>
+class MAPNIK_DECL agg_render_context : private util::noncopyable
+{
+public:
+    agg_render_context();
+    ~agg_render_context();
+
+    // an empty placement detector over extent, the previous one is
+    // recycled when nothing else holds on to it
+    std::shared_ptr<T1> detector(box2d<double> const& extent);
+
+private:
+    friend class agg_renderer<T0, T1>;
+    buffer_stack<T0> internal_buffers_;
+    std::unique_ptr<T0> inflated_buffer_;
+    // part of the inflated buffer to clear on reuse
+    box2d<int> inflated_painted_;
+    std::unique_ptr<rasterizer> ras_ptr_;
+    std::shared_ptr<T1> detector_;
+    gamma_method_enum gamma_method_;
+    double gamma_;
+    // made once a renderer draws marker sprites
+    std::unique_ptr<marker_sprite_cache> marker_sprites_;
+    std::unique_ptr<rasterizer> sprite_ras_;
 };
 
 template <typename T0, typename T1=label_collision_detector4>
@@ -116,6 +208,7 @@ public:
     using buffer_type = T0;
     using processor_impl_type = agg_renderer<T0>;
     using detector_type = T1;
+    using context_type = agg_render_context<T0, T1>;
     // create with default, empty placement detector
     agg_renderer(Map const& m, buffer_type & pixmap, double scale_factor=1.0, unsigned offset_x=0, unsigned offset_y=0);
     // create with external placement detector, possibly non-empty
@@ -123,11 +216,18 @@ public:
                  double scale_factor=1.0, unsigned offset_x=0, unsigned offset_y=0);
     // pass in mapnik::request object to provide the mutable things per render
     agg_renderer(Map const& m, request const& req, attributes const& vars, buffer_type & pixmap, double scale_factor=1.0, unsigned offset_x=0, unsigned offset_y=0);
+    // reuse the buffers, rasterizer and placement detector kept in context
+    agg_renderer(Map const& m, buffer_type & pixmap, context_type & context,
+                 double scale_factor=1.0, unsigned offset_x=0, unsigned offset_y=0);
+    agg_renderer(Map const& m, request const& req, attributes const& vars, buffer_type & pixmap,
+                 context_type & context, double scale_factor=1.0, unsigned offset_x=0, unsigned offset_y=0);
     ~agg_renderer();
     void start_map_processing(Map const& map);
     void end_map_processing(Map const& map);
     void start_layer_processing(layer const& lay, box2d<double> const& query_extent);
     void end_layer_processing(layer const& lay);
+    bool prepare_cached_layer(Map const& m, layer const& lay);
+    void render_cached_layer(layer const& lay);
 
     void start_style_processing(feature_type_style const& st);
     void end_style_processing(feature_type_style const& st);
@@ -175,6 +275,8 @@ public:
                  mapnik::feature_impl & feature,
                  proj_transform const& prj_trans);
 
+    void start_feature(feature_ptr const& feature);
+
     inline bool process(rule::symbolizers const&,
                         mapnik::feature_impl&,
                         proj_transform const& )
@@ -185,6 +287,8 @@ public:
 
     void painted(bool painted);
     bool painted();
+    // fraction of the placement detector extent covered by labels
+    double label_coverage() const;
 
     inline eAttributeCollectionPolicy attribute_collection_policy() const
     {
@@ -200,6 +304,136 @@ public:
     {
         return common_.vars_;
     }
+
+    // Maximum number of threads used to run the per pixel image filters
+    // of a style on large images, defaults to 1.
+    void set_filter_threads(unsigned threads)
+    {
+        filter_threads_ = threads;
+    }
+
+    unsigned filter_threads() const
+    {
+        return filter_threads_;
+    }
+
+    // Maximum number of threads used to warp reprojected rasters,
+    // defaults to 1.
+    void set_raster_threads(unsigned threads)
+    {
+        raster_threads_ = threads;
+    }
+
+    unsigned raster_threads() const
+    {
+        return raster_threads_;
+    }
+
+    // Draw SVG markers from sprites rasterized once per shape, style,
+    // scale, rotation and quarter pixel offset and kept in the context,
+    // for markers whose quantized transform is off by no more than
+    // tolerance pixels; others are still rasterized. Only markers drawn
+    // with src-over are affected. Defaults to 0, never using sprites.
+    void set_marker_sprite_tolerance(double tolerance)
+    {
+        marker_sprite_tolerance_ = tolerance;
+    }
+
+    double marker_sprite_tolerance() const
+    {
+        return marker_sprite_tolerance_;
+    }
+
+    // Draw dashed lines whose dash array repeats in less than threshold
+    // pixels as solid lines, with the opacity scaled by the part of the
+    // array covered by dashes, instead of stroking every dash. Defaults
+    // to 0, always stroking dashes.
+    void set_dash_collapse_threshold(double threshold)
+    {
+        dash_collapse_threshold_ = threshold;
+    }
+
+    double dash_collapse_threshold() const
+    {
+        return dash_collapse_threshold_;
+    }
+
+    // Which symbolizers are drawn, by whether they are placed with the
+    // placement detector (see uses_placement_detector()), for renders
+    // splitting a map into passes. Defaults to all symbolizers.
+    enum symbolizer_pass
+    {
+        all_symbolizers,
+        geometry_symbolizers,
+        label_symbolizers
+    };
+
+    void set_symbolizer_pass(symbolizer_pass pass)
+    {
+        symbolizer_pass_ = pass;
+    }
+
+    symbolizer_pass get_symbolizer_pass() const
+    {
+        return symbolizer_pass_;
+    }
+
+    bool draws_symbolizer(symbolizer const& sym) const
+    {
+        return symbolizer_pass_ == all_symbolizers ||
+            (symbolizer_pass_ == label_symbolizers) == uses_placement_detector(sym);
+    }
+
+    // Place text and shield symbolizers on a thread of their own while the
+    // following styles are rasterized, see label_phase. Labels are placed
+    // in the order scheduled labels are, at the end of their style, and
+    // drawn above everything else once the map is done, without the
+    // comp-op, opacity or filters of their layer and style. Off by default.
+    void set_label_phase(bool label_phase)
+    {
+        label_phase_enabled_ = label_phase;
+    }
+
+    bool label_phase() const
+    {
+        return label_phase_enabled_;
+    }
+
+    bool defers_labels() const
+    {
+        return static_cast<bool>(label_phase_);
+    }
+
+    // Whether the map is drawn over an opaque background with comp-ops
+    // that keep it opaque. The finished image is then marked opaque() and
+    // its alpha is neither demultiplied nor written by the encoders.
+    bool opaque() const
+    {
+        return opaque_;
+    }
+
+    // Maximum number of threads rendering the styles of a layer with
+    // cache-features at once, defaults to 1. Styles drawn into a buffer of
+    // their own (with a comp-op, image filters or opacity), not inflated
+    // and with no symbolizer using the placement detector, are rasterized
+    // concurrently and composited in the style order.
+    void set_style_threads(unsigned threads)
+    {
+        style_threads_ = threads;
+    }
+
+    unsigned style_threads() const
+    {
+        return style_threads_;
+    }
+
+    bool renders_style_apart(feature_type_style const& st) const;
+    std::unique_ptr<agg_renderer> make_style_worker(Map const& m, feature_type_style const& st);
+    void end_style_worker(feature_type_style const& st, agg_renderer & worker);
+
+    void defer_labels(std::vector<scheduled_label> & labels,
+                      proj_transform const& prj_trans,
+                      double max_coverage);
 protected:
     template <typename R>
     void debug_draw_box(R& buf, box2d<double> const& extent,
@@ -209,16 +443,59 @@ protected:
     void draw_geo_extent(box2d<double> const& extent,mapnik::color const& color);
 
 private:
+    // a worker drawing a style of parent into a buffer of its own
+    agg_renderer(Map const& m, agg_renderer const& parent);
+    // filters style_buffer and composites it onto target, returns the part
+    // of style_buffer left to clear
+    box2d<int> composite_style(feature_type_style const& st,
+                               buffer_type & style_buffer,
+                               buffer_type & target);
+
     std::stack<std::reference_wrapper<buffer_type>> buffers_;
-    buffer_stack<buffer_type> internal_buffers_;
-    std::unique_ptr<buffer_type> inflated_buffer_;
-    const std::unique_ptr<rasterizer> ras_ptr;
-    gamma_method_enum gamma_method_;
-    double gamma_;
+    // set when no context is passed in
+    const std::unique_ptr<context_type> own_context_;
+    buffer_stack<buffer_type> & internal_buffers_;
+    std::unique_ptr<buffer_type> & inflated_buffer_;
+    box2d<int> & inflated_painted_;
+    std::unique_ptr<rasterizer> const& ras_ptr;
+    gamma_method_enum & gamma_method_;
+    double & gamma_;
     renderer_common common_;
+    unsigned filter_threads_;
+    unsigned raster_threads_;
+    unsigned style_threads_;
+    std::unique_ptr<marker_sprite_cache> & marker_sprites_;
+    std::unique_ptr<rasterizer> & sprite_ras_;
+    double marker_sprite_tolerance_;
+    double dash_collapse_threshold_;
+    symbolizer_pass symbolizer_pass_;
+    bool label_phase_enabled_;
+    bool opaque_;
+    // set from start to end of map processing with the label phase on
+    std::unique_ptr<mapnik::label_phase> label_phase_;
+    void draw_label_phase();
+    // constant properties of polygon and line symbolizers, made on first use
+    std::unique_ptr<compiled_symbolizer_cache> compiled_symbolizers_;
+    compiled_symbolizer_cache & compiled_symbolizers();
+    // converted geometries of the line symbolizers, made on first use
+    std::unique_ptr<line_path_cache> line_paths_;
+    line_path_cache & line_paths();
+    // cache-image layers drawn from layer_image_cache, and the keys of
+    // those to be stored there once rendered, each with its label boxes
+    struct layer_image
+    {
+        layer_image_cache::image_ptr image;
+        layer_image_cache::key_type key;
+        layer_image_cache::label_boxes labels;
+    };
+    std::map<layer const*, layer_image> cached_layer_images_;
+    std::map<layer const*, layer_image> pending_layer_images_;
+    // the buffer a style worker draws into, null for other renderers
+    std::unique_ptr<buffer_type> style_pixmap_;
     void setup(Map const & m, buffer_type & pixmap);
 };
 
+extern template class MAPNIK_DECL agg_render_context<image<rgba8_t>>;
 extern template class MAPNIK_DECL agg_renderer<image<rgba8_t>>;
 
 } // namespace mapnik
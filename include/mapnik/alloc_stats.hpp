@@ -0,0 +1,112 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_ALLOC_STATS_HPP
+#define MAPNIK_ALLOC_STATS_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+
+// stl
+#include <array>
+#include <cstddef>
+
+namespace mapnik
+{
+
+// Rendering phases heap allocations are attributed to, matching the
+// timings of render_stats.
+enum class alloc_phase : unsigned
+{
+    other = 0,      // anything outside the phases below
+    query,          // datasource queries and featureset construction
+    fetch,          // featureset iteration: features, geometries, values
+    filter,         // rule selection and filter evaluation
+    symbolizers,    // symbolizer processing, text layout included
+    labels,         // deferred label placement
+    compositing,    // style and layer buffers, compositing
+    count
+};
+
+struct alloc_counters
+{
+    std::size_t allocations = 0;
+    std::size_t bytes = 0;
+};
+
+using alloc_phase_counters = std::array<alloc_counters, static_cast<std::size_t>(alloc_phase::count)>;
+
+// Counting of the heap allocations of the calling thread by phase. When
+// built with ENABLE_ALLOC_STATS (MAPNIK_ALLOC_STATS) libmapnik replaces
+// the global operator new and delete, which then prefix every block
+// with its size; otherwise nothing is counted and the phase scopes
+// compile away.
+namespace alloc_stats {
+
+MAPNIK_DECL bool enabled();
+// the counters of the calling thread since it started
+MAPNIK_DECL alloc_phase_counters counters();
+// bytes currently allocated by the calling thread, and the most it held
+// since reset_peak()
+MAPNIK_DECL std::ptrdiff_t live_bytes();
+MAPNIK_DECL std::ptrdiff_t peak_bytes();
+MAPNIK_DECL void reset_peak();
+
+#ifdef MAPNIK_ALLOC_STATS
+MAPNIK_DECL alloc_phase set_phase(alloc_phase phase);
+
+// Attributes the allocations of the calling thread to a phase until
+// destroyed, does nothing when not active.
+class phase_scope
+{
+public:
+    phase_scope(alloc_phase phase, bool active = true)
+        : active_(active),
+          previous_(active ? set_phase(phase) : alloc_phase::other) {}
+
+    ~phase_scope()
+    {
+        if (active_) set_phase(previous_);
+    }
+
+    phase_scope(phase_scope const&) = delete;
+    phase_scope & operator=(phase_scope const&) = delete;
+private:
+    bool active_;
+    alloc_phase previous_;
+};
+#else
+class phase_scope
+{
+public:
+    phase_scope(alloc_phase, bool = true) {}
+    phase_scope(phase_scope const&) = delete;
+    phase_scope & operator=(phase_scope const&) = delete;
+};
+#endif
+
+}
+
+}
+
+#endif // MAPNIK_ALLOC_STATS_HPP
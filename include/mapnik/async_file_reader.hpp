@@ -0,0 +1,154 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_ASYNC_FILE_READER_HPP
+#define MAPNIK_ASYNC_FILE_READER_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/util/noncopyable.hpp>
+#include <mapnik/util/spatial_index.hpp>
+
+// stl
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace mapnik
+{
+
+namespace detail { struct file_read; struct read_file; }
+
+// Reads ranges of a file on the query_scheduler's threads (key "file_io"),
+// so that featuresets can ask for the records they need next while they
+// decode the current ones. Reads go through pread() on a descriptor shared
+// by all of them, or a stream of their own where it is missing. Without
+// scheduler threads a read is done when it is first waited for.
+class MAPNIK_DECL async_file_reader : util::noncopyable
+{
+public:
+    // Pending or completed read, the data stay valid as long as the handle
+    class MAPNIK_DECL handle
+    {
+    public:
+        handle() = default;
+        explicit handle(std::shared_ptr<detail::file_read> const& read);
+
+        bool valid() const { return static_cast<bool>(read_); }
+        std::uint64_t offset() const;
+        // bytes asked for
+        std::size_t size() const;
+        // Waits for the read, nullptr when the range could not be read
+        // in full.
+        char const* get();
+        // Drops a read that has not started, the handle becomes invalid.
+        void cancel();
+
+    private:
+        std::shared_ptr<detail::file_read> read_;
+    };
+
+    explicit async_file_reader(std::string const& filename);
+    ~async_file_reader();
+
+    bool is_open() const;
+    // starts reading size bytes at offset
+    handle read(std::uint64_t offset, std::size_t size);
+
+private:
+    std::shared_ptr<detail::read_file> file_;
+};
+
+// Reads the records located through an index in offset order, grouped
+// into the blocks of util::index_record_reader. The read of the block
+// following the current one is started as soon as the current one is
+// served so that I/O overlaps decoding.
+class async_record_reader : util::noncopyable
+{
+public:
+    explicit async_record_reader(std::string const& filename)
+        : file_(filename),
+          current_(),
+          next_() {}
+
+    ~async_record_reader()
+    {
+        next_.cancel();
+    }
+
+    bool is_open() const { return file_.is_open(); }
+
+    // The record at itr, [itr, end) being the records still to be read;
+    // nullptr when the file could not be read.
+    template <typename Iterator>
+    char const* read(Iterator itr, Iterator end)
+    {
+        std::uint64_t off = itr->off;
+        std::uint64_t last = off + itr->size;
+        if (!contains(current_, off, last))
+        {
+            if (contains(next_, off, last))
+            {
+                current_ = std::move(next_);
+                next_ = async_file_reader::handle();
+            }
+            else
+            {
+                next_.cancel();
+                current_ = file_.read(off, block_size(itr, end));
+            }
+            if (!current_.get()) return nullptr;
+            // start reading what comes after the current block
+            std::uint64_t block_end = current_.offset() + current_.size();
+            auto following = itr;
+            while (following != end && following->off + following->size <= block_end) ++following;
+            if (following != end && !next_.valid())
+            {
+                next_ = file_.read(following->off, block_size(following, end));
+            }
+        }
+        char const* data = current_.get();
+        return data ? data + (off - current_.offset()) : nullptr;
+    }
+
+private:
+    static bool contains(async_file_reader::handle const& block, std::uint64_t off, std::uint64_t last)
+    {
+        return block.valid() && off >= block.offset() && last <= block.offset() + block.size();
+    }
+
+    template <typename Iterator>
+    static std::size_t block_size(Iterator itr, Iterator end)
+    {
+        return static_cast<std::size_t>(util::index_record_reader::block_end(itr, end) - itr->off);
+    }
+
+    async_file_reader file_;
+    async_file_reader::handle current_;
+    async_file_reader::handle next_;
+};
+
+}
+
+#endif // MAPNIK_ASYNC_FILE_READER_HPP
@@ -28,6 +28,8 @@
 #include <mapnik/value.hpp>
 #include <mapnik/util/geometry_to_ds_type.hpp>
 // stl
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 
@@ -37,15 +39,69 @@ struct attribute
 {
     std::string name_;
     explicit attribute(std::string const& _name)
-        : name_(_name) {}
+        : name_(_name),
+          slot_(0) {}
+
+    attribute(attribute const& rhs)
+        : name_(rhs.name_),
+          slot_(0) {}
+
+    attribute(attribute && rhs) noexcept
+        : name_(std::move(rhs.name_)),
+          slot_(0) {}
+
+    attribute & operator=(attribute const& rhs)
+    {
+        name_ = rhs.name_;
+        slot_.store(0, std::memory_order_relaxed);
+        return *this;
+    }
+
+    attribute & operator=(attribute && rhs) noexcept
+    {
+        name_ = std::move(rhs.name_);
+        slot_.store(0, std::memory_order_relaxed);
+        return *this;
+    }
 
     template <typename V ,typename F>
     V const& value(F const& f) const
     {
-        return f.get(name_);
+        return f.get(slot(f.get_context()));
+    }
+
+    // Slot index of this attribute in features of ctx. Resolved by name
+    // once per context version and cached, so repeated evaluation over a
+    // featureset indexes the feature data directly. The cache is a single
+    // atomic word, nodes may be shared by concurrent renders. Versions and
+    // slots too large to pack in it are resolved by name every time.
+    template <typename C>
+    typename C::size_type slot(C const& ctx) const
+    {
+        std::uint64_t version = ctx.version();
+        std::uint64_t cached = slot_.load(std::memory_order_relaxed);
+        if (version <= max_version && (cached >> slot_bits) == version)
+        {
+            std::uint64_t index = cached & no_slot;
+            return index == no_slot ? C::npos : static_cast<typename C::size_type>(index);
+        }
+        typename C::size_type index = ctx.index_of(name_);
+        if (version <= max_version && (index == C::npos || index < no_slot))
+        {
+            std::uint64_t packed = index == C::npos ? no_slot : static_cast<std::uint64_t>(index);
+            slot_.store((version << slot_bits) | packed, std::memory_order_relaxed);
+        }
+        return index;
     }
 
     std::string const& name() const { return name_;}
+
+private:
+    static constexpr unsigned slot_bits = 16;
+    static constexpr std::uint64_t no_slot = (std::uint64_t(1) << slot_bits) - 1;
+    static constexpr std::uint64_t max_version = (std::uint64_t(1) << (64 - slot_bits)) - 1;
+    // context version in the high 48 bits, slot index in the low 16
+    mutable std::atomic<std::uint64_t> slot_;
 };
 
 struct geometry_type_attribute
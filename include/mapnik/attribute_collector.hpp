@@ -216,9 +216,10 @@ private:
     expression_attributes<std::set<std::string> > f_attr;
 public:
 
-    attribute_collector(std::set<std::string>& names)
+    // filter_factor is kept unless a raster symbolizer sets it
+    attribute_collector(std::set<std::string>& names, double filter_factor = 1.0)
         : names_(names),
-          filter_factor_(1.0),
+          filter_factor_(filter_factor),
           f_attr(names) {}
     template <typename RuleType>
     void operator() (RuleType const& r)
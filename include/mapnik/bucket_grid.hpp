@@ -0,0 +1,193 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_BUCKET_GRID_HPP
+#define MAPNIK_BUCKET_GRID_HPP
+
+// mapnik
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace mapnik
+{
+
+// Uniform grid of buckets holding indices into a flat value array.
+// Drop-in alternative to quad_tree for workloads with many small,
+// evenly distributed boxes (label placements). All storage lives in
+// a few vectors and clear() keeps their capacity, so a detector that
+// is reused across renders stops allocating once it has warmed up.
+template <typename T0, typename T1 = box2d<double>>
+class bucket_grid : util::noncopyable
+{
+    using value_type = T0;
+    using bbox_type = T1;
+    using index_type = std::uint32_t;
+    using bucket_type = std::vector<index_type>;
+
+public:
+    using result_type = typename std::vector<std::reference_wrapper<value_type> >;
+    using query_iterator = typename result_type::iterator;
+
+    explicit bucket_grid(bbox_type const& ext, double cell_size = 64.0)
+        : extent_(ext),
+          cols_(num_cells(ext.width(), cell_size)),
+          rows_(num_cells(ext.height(), cell_size)),
+          cell_width_(ext.width() > 0 ? ext.width() / cols_ : 1.0),
+          cell_height_(ext.height() > 0 ? ext.height() / rows_ : 1.0),
+          buckets_(cols_ * rows_),
+          values_(),
+          boxes_(),
+          stamps_(),
+          used_buckets_(),
+          stamp_(0),
+          query_result_() {}
+
+    void insert(value_type const& data, bbox_type const& box)
+    {
+        index_type index = static_cast<index_type>(values_.size());
+        values_.push_back(data);
+        boxes_.push_back(box);
+        stamps_.push_back(0);
+        unsigned x0, y0, x1, y1;
+        cell_range(box, x0, y0, x1, y1);
+        for (unsigned y = y0; y <= y1; ++y)
+        {
+            for (unsigned x = x0; x <= x1; ++x)
+            {
+                bucket_type & bucket = buckets_[y * cols_ + x];
+                if (bucket.empty()) used_buckets_.push_back(y * cols_ + x);
+                bucket.push_back(index);
+            }
+        }
+    }
+
+    query_iterator query_in_box(bbox_type const& box)
+    {
+        query_result_.clear();
+        if (++stamp_ == 0)
+        {
+            // wrapped around, forget all previous stamps
+            std::fill(stamps_.begin(), stamps_.end(), 0);
+            stamp_ = 1;
+        }
+        unsigned x0, y0, x1, y1;
+        cell_range(box, x0, y0, x1, y1);
+        for (unsigned y = y0; y <= y1; ++y)
+        {
+            for (unsigned x = x0; x <= x1; ++x)
+            {
+                for (index_type index : buckets_[y * cols_ + x])
+                {
+                    if (stamps_[index] != stamp_)
+                    {
+                        stamps_[index] = stamp_;
+                        if (boxes_[index].intersects(box))
+                        {
+                            query_result_.push_back(std::ref(values_[index]));
+                        }
+                    }
+                }
+            }
+        }
+        return query_result_.begin();
+    }
+
+    query_iterator query_end()
+    {
+        return query_result_.end();
+    }
+
+    void clear()
+    {
+        for (unsigned bucket : used_buckets_)
+        {
+            buckets_[bucket].clear();
+        }
+        used_buckets_.clear();
+        values_.clear();
+        boxes_.clear();
+        stamps_.clear();
+        query_result_.clear();
+    }
+
+    bbox_type const& extent() const
+    {
+        return extent_;
+    }
+
+    int count_items() const
+    {
+        return static_cast<int>(values_.size());
+    }
+
+private:
+    static unsigned num_cells(double length, double cell_size)
+    {
+        if (!(length > 0) || !(cell_size > 0)) return 1;
+        // cap the grid size to keep empty grids cheap for huge extents
+        return static_cast<unsigned>(std::min(1024.0, std::max(1.0, std::ceil(length / cell_size))));
+    }
+
+    unsigned cell_x(double x) const
+    {
+        double pos = std::floor((x - extent_.minx()) / cell_width_);
+        return static_cast<unsigned>(std::min(static_cast<double>(cols_ - 1), std::max(0.0, pos)));
+    }
+
+    unsigned cell_y(double y) const
+    {
+        double pos = std::floor((y - extent_.miny()) / cell_height_);
+        return static_cast<unsigned>(std::min(static_cast<double>(rows_ - 1), std::max(0.0, pos)));
+    }
+
+    // boxes outside of the extent are clamped into the border cells
+    void cell_range(bbox_type const& box, unsigned & x0, unsigned & y0, unsigned & x1, unsigned & y1) const
+    {
+        x0 = cell_x(box.minx());
+        y0 = cell_y(box.miny());
+        x1 = cell_x(box.maxx());
+        y1 = cell_y(box.maxy());
+    }
+
+    bbox_type extent_;
+    unsigned cols_;
+    unsigned rows_;
+    double cell_width_;
+    double cell_height_;
+    std::vector<bucket_type> buckets_;
+    std::vector<value_type> values_;
+    std::vector<bbox_type> boxes_;
+    std::vector<index_type> stamps_;
+    std::vector<unsigned> used_buckets_;
+    index_type stamp_;
+    result_type query_result_;
+};
+}
+
+#endif // MAPNIK_BUCKET_GRID_HPP
@@ -44,6 +44,7 @@
 #pragma GCC diagnostic pop
 
 // stl
+#include <array>
 #include <memory>
 #include <map>
 #include <stdexcept>
@@ -51,11 +52,13 @@
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore_agg.hpp>
 #include "agg_basics.h"
+#include "agg_trans_affine.h"
 #pragma GCC diagnostic pop
 
 namespace mapnik {
 
 template <typename T> class box2d;
+struct marker;
 
 using ErrorStatus = cairo_status_t;
 
@@ -109,6 +112,8 @@ private:
 
 using cairo_face_ptr = std::shared_ptr<cairo_face>;
 
+// Looks cairo faces up in a cache kept per thread, as the faces of the
+// face_manager are, so renderers on a thread create each cairo face once.
 class cairo_face_manager : private util::noncopyable
 {
 public:
@@ -117,8 +122,11 @@ public:
 
 private:
     using cairo_face_cache = std::map<face_ptr,cairo_face_ptr>;
+    // the cache is emptied when it grows over this many faces
+    static constexpr std::size_t max_faces = 256;
+    static cairo_face_cache & thread_cache();
     std::shared_ptr<font_library> font_library_;
-    cairo_face_cache cache_;
+    cairo_face_cache & cache_;
 };
 
 class cairo_pattern : private util::noncopyable
@@ -184,6 +192,16 @@ public:
         cairo_pattern_set_filter(pattern_, filter);
     }
 
+    // back to the matrix, extend and filter of a new pattern
+    void reset()
+    {
+        cairo_matrix_t matrix;
+        cairo_matrix_init_identity(&matrix);
+        cairo_pattern_set_matrix(pattern_, &matrix);
+        cairo_pattern_set_extend(pattern_, CAIRO_EXTEND_NONE);
+        cairo_pattern_set_filter(pattern_, CAIRO_FILTER_GOOD);
+    }
+
     cairo_pattern_t * pattern() const
     {
         return pattern_;
@@ -194,6 +212,51 @@ private:
     cairo_pattern_t *  pattern_;
 };
 
+// Patterns made of marker_cache images, kept per thread so that renders
+// repeating the same styles, such as the pages of a PDF batch, convert
+// each image once. Entries hold on to their marker; the cache is emptied
+// when the images it holds grow over max_bytes.
+class MAPNIK_DECL cairo_pattern_cache : private util::noncopyable
+{
+public:
+    using marker_ptr = std::shared_ptr<marker const>;
+    using pattern_ptr = std::shared_ptr<cairo_pattern>;
+    static constexpr std::size_t max_bytes = 64 * 1024 * 1024;
+
+    static cairo_pattern_cache & instance();
+
+    // pattern of data, an image of owner, returned reset
+    pattern_ptr get(marker_ptr const& owner, image_rgba8 const& data, double opacity);
+
+    // pattern of owner drawn with tr, render() returning the image drawn
+    template <typename Render>
+    pattern_ptr get(marker_ptr const& owner, agg::trans_affine const& tr,
+                    double opacity, Render render)
+    {
+        key_type key = make_key(owner, tr, opacity);
+        if (pattern_ptr pattern = find(key)) return pattern;
+        return insert(key, owner, render(), opacity);
+    }
+
+    void clear();
+
+private:
+    using key_type = std::pair<marker const*, std::array<double, 7> >;
+    struct entry
+    {
+        marker_ptr owner;
+        pattern_ptr pattern;
+    };
+
+    static key_type make_key(marker_ptr const& owner, agg::trans_affine const& tr, double opacity);
+    pattern_ptr find(key_type const& key) const;
+    pattern_ptr insert(key_type const& key, marker_ptr const& owner,
+                       image_rgba8 const& data, double opacity);
+
+    std::map<key_type, entry> cache_;
+    std::size_t bytes_ = 0;
+};
+
 
 class cairo_gradient : private util::noncopyable
 {
@@ -151,6 +151,9 @@ public:
         // nothing to do
     }
 
+    // fraction of the placement detector extent covered by labels
+    double label_coverage() const;
+
     inline eAttributeCollectionPolicy attribute_collection_policy() const
     {
         return DEFAULT;
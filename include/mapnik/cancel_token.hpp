@@ -0,0 +1,110 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_CANCEL_TOKEN_HPP
+#define MAPNIK_CANCEL_TOKEN_HPP
+
+// stl
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace mapnik {
+
+/*!
+ * \brief cooperative cancellation of a render, explicit or by deadline
+ *
+ * Shared between the thread requesting the cancellation and the renderer,
+ * which checks cancelled() between layers, features and labels and
+ * forwards the token to datasources through the query. Work already
+ * started when the token trips finishes, the render then stops early and
+ * leaves a partial image.
+ */
+class cancel_token
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    cancel_token()
+        : cancelled_(false),
+          deadline_(clock::time_point::max().time_since_epoch().count()) {}
+
+    explicit cancel_token(clock::duration timeout)
+        : cancelled_(false),
+          deadline_((clock::now() + timeout).time_since_epoch().count()) {}
+
+    cancel_token(cancel_token const&) = delete;
+    cancel_token& operator=(cancel_token const&) = delete;
+
+    // may be called from any thread
+    void cancel()
+    {
+        cancelled_.store(true, std::memory_order_relaxed);
+    }
+
+    void set_deadline(clock::time_point deadline)
+    {
+        deadline_.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    void set_timeout(clock::duration timeout)
+    {
+        set_deadline(clock::now() + timeout);
+    }
+
+    clock::time_point deadline() const
+    {
+        return clock::time_point(clock::duration(deadline_.load(std::memory_order_relaxed)));
+    }
+
+    // true once cancel() was called or the deadline passed, costs a clock
+    // read when a deadline is set
+    bool cancelled() const
+    {
+        if (cancelled_.load(std::memory_order_relaxed)) return true;
+        clock::rep deadline = deadline_.load(std::memory_order_relaxed);
+        if (deadline != clock::time_point::max().time_since_epoch().count() &&
+            clock::now().time_since_epoch().count() >= deadline)
+        {
+            cancelled_.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    mutable std::atomic<bool> cancelled_;
+    std::atomic<clock::rep> deadline_;
+};
+
+using cancel_token_ptr = std::shared_ptr<cancel_token>;
+
+// null tokens never trip
+inline bool cancelled(cancel_token_ptr const& token)
+{
+    return token && token->cancelled();
+}
+
+}
+
+#endif // MAPNIK_CANCEL_TOKEN_HPP
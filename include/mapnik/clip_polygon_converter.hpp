@@ -0,0 +1,257 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_CLIP_POLYGON_CONVERTER_HPP
+#define MAPNIK_CLIP_POLYGON_CONVERTER_HPP
+
+// mapnik
+#include <mapnik/vertex.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/geometry/point.hpp>
+
+// stl
+#include <cstddef>
+#include <vector>
+
+namespace mapnik
+{
+
+namespace detail
+{
+
+// One Sutherland-Hodgman pass: the part of ring on the inside of a clip
+// box edge, with the vertices where it crosses the edge. Repeated points,
+// as when a ring passes through a box corner, are only kept once.
+template <typename Inside, typename Intersect>
+void clip_ring_edge(std::vector<geometry::point<double>> const& ring,
+                    std::vector<geometry::point<double>> & out,
+                    Inside inside, Intersect intersect)
+{
+    out.clear();
+    if (ring.empty()) return;
+    auto push = [&out](geometry::point<double> const& pt) {
+        if (out.empty() || out.back().x != pt.x || out.back().y != pt.y) out.push_back(pt);
+    };
+    geometry::point<double> prev = ring.back();
+    bool prev_inside = inside(prev);
+    for (auto const& pt : ring)
+    {
+        bool pt_inside = inside(pt);
+        if (pt_inside)
+        {
+            if (!prev_inside) push(intersect(prev, pt));
+            push(pt);
+        }
+        else if (prev_inside)
+        {
+            push(intersect(prev, pt));
+        }
+        prev = pt;
+        prev_inside = pt_inside;
+    }
+    if (out.size() > 1 && out.front().x == out.back().x && out.front().y == out.back().y)
+    {
+        out.pop_back();
+    }
+}
+
+}
+
+// Clips polygon rings to a box. Each ring's envelope is tested first:
+// rings within the box are passed on unchanged and rings missing it are
+// dropped, so only those crossing its border go through a Sutherland-
+// Hodgman clipper, and only against the edges they cross. Clipped rings
+// follow the box border where they leave it, as agg::conv_clip_polygon's do.
+template <typename Geometry>
+struct clip_polygon_converter
+{
+    using coord_type = geometry::point<double>;
+
+    clip_polygon_converter(Geometry & geom)
+        : geom_(geom),
+          clip_box_(0, 0, 1, 1),
+          rings_(),
+          coords_(),
+          ring_(),
+          scratch_(),
+          current_ring_(0),
+          current_index_(0) {}
+
+    void clip_box(double x0, double y0, double x1, double y1)
+    {
+        clip_box_.init(x0, y0, x1, y1);
+    }
+
+    unsigned type() const
+    {
+        return static_cast<unsigned>(geom_.type());
+    }
+
+    void rewind(unsigned)
+    {
+        rings_.clear();
+        coords_.clear();
+        current_ring_ = 0;
+        current_index_ = 0;
+        geom_.rewind(0);
+        ring_.clear();
+        box2d<double> envelope;
+        double x = 0, y = 0;
+        unsigned cmd;
+        while ((cmd = geom_.vertex(&x, &y)) != SEG_END)
+        {
+            if (cmd == SEG_MOVETO)
+            {
+                add_ring(envelope, false);
+                ring_.emplace_back(x, y);
+                envelope.init(x, y, x, y);
+            }
+            else if (cmd == SEG_LINETO)
+            {
+                if (ring_.empty()) envelope.init(x, y, x, y);
+                else envelope.expand_to_include(x, y);
+                ring_.emplace_back(x, y);
+            }
+            else if ((cmd & SEG_CLOSE) == SEG_CLOSE)
+            {
+                add_ring(envelope, true);
+            }
+        }
+        add_ring(envelope, false);
+    }
+
+    unsigned vertex(double * x, double * y)
+    {
+        while (current_ring_ < rings_.size())
+        {
+            ring_info const& ring = rings_[current_ring_];
+            std::size_t size = ring.end - ring.begin;
+            if (current_index_ < size)
+            {
+                coord_type const& pt = coords_[ring.begin + current_index_];
+                *x = pt.x;
+                *y = pt.y;
+                return (current_index_++ == 0) ? SEG_MOVETO : SEG_LINETO;
+            }
+            ++current_ring_;
+            bool closed = ring.closed;
+            current_index_ = 0;
+            if (closed)
+            {
+                *x = 0;
+                *y = 0;
+                return SEG_CLOSE;
+            }
+        }
+        return SEG_END;
+    }
+
+private:
+    struct ring_info
+    {
+        std::size_t begin;
+        std::size_t end;
+        bool closed;
+    };
+
+    void add_ring(box2d<double> const& envelope, bool closed)
+    {
+        if (ring_.empty()) return;
+        std::size_t begin = coords_.size();
+        if (clip_box_.contains(envelope))
+        {
+            coords_.insert(coords_.end(), ring_.begin(), ring_.end());
+        }
+        else if (ring_.size() > 2 && clip_box_.intersects(envelope))
+        {
+            clip_ring(envelope);
+            // a ring crossing the border is closed along it
+            closed = true;
+        }
+        ring_.clear();
+        if (coords_.size() - begin > 2)
+        {
+            rings_.push_back(ring_info{begin, coords_.size(), closed});
+        }
+        else
+        {
+            coords_.resize(begin);
+        }
+    }
+
+    void clip_ring(box2d<double> const& envelope)
+    {
+        double minx = clip_box_.minx();
+        double miny = clip_box_.miny();
+        double maxx = clip_box_.maxx();
+        double maxy = clip_box_.maxy();
+        if (envelope.minx() < minx)
+        {
+            detail::clip_ring_edge(ring_, scratch_,
+                [minx](coord_type const& p) { return p.x >= minx; },
+                [minx](coord_type const& a, coord_type const& b) {
+                    return coord_type(minx, a.y + (b.y - a.y) * (minx - a.x) / (b.x - a.x)); });
+            ring_.swap(scratch_);
+        }
+        if (envelope.maxx() > maxx)
+        {
+            detail::clip_ring_edge(ring_, scratch_,
+                [maxx](coord_type const& p) { return p.x <= maxx; },
+                [maxx](coord_type const& a, coord_type const& b) {
+                    return coord_type(maxx, a.y + (b.y - a.y) * (maxx - a.x) / (b.x - a.x)); });
+            ring_.swap(scratch_);
+        }
+        if (envelope.miny() < miny)
+        {
+            detail::clip_ring_edge(ring_, scratch_,
+                [miny](coord_type const& p) { return p.y >= miny; },
+                [miny](coord_type const& a, coord_type const& b) {
+                    return coord_type(a.x + (b.x - a.x) * (miny - a.y) / (b.y - a.y), miny); });
+            ring_.swap(scratch_);
+        }
+        if (envelope.maxy() > maxy)
+        {
+            detail::clip_ring_edge(ring_, scratch_,
+                [maxy](coord_type const& p) { return p.y <= maxy; },
+                [maxy](coord_type const& a, coord_type const& b) {
+                    return coord_type(a.x + (b.x - a.x) * (maxy - a.y) / (b.y - a.y), maxy); });
+            ring_.swap(scratch_);
+        }
+        coords_.insert(coords_.end(), ring_.begin(), ring_.end());
+    }
+
+    Geometry & geom_;
+    box2d<double> clip_box_;
+    std::vector<ring_info> rings_;
+    // the output rings, one after the other
+    std::vector<coord_type> coords_;
+    // the ring being read and its clipped copy
+    std::vector<coord_type> ring_;
+    std::vector<coord_type> scratch_;
+    std::size_t current_ring_;
+    std::size_t current_index_;
+};
+
+}
+
+#endif // MAPNIK_CLIP_POLYGON_CONVERTER_HPP
@@ -33,6 +33,11 @@ namespace mapnik {
 
 MAPNIK_DECL mapnik::color parse_color(std::string const& str);
 
+// parse_color() for colors evaluated per feature, through a small per
+// thread cache of the strings parsed last, so thematic layers don't run
+// the grammar for every feature. Failed parses throw and are not cached.
+MAPNIK_DECL mapnik::color parse_color_cached(std::string const& str);
+
 }
 
 #endif // MAPNIK_COLOR_FACTORY_HPP
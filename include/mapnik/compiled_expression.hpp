@@ -0,0 +1,129 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_COMPILED_EXPRESSION_HPP
+#define MAPNIK_COMPILED_EXPRESSION_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/expression_node.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/feature.hpp>
+
+// stl
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mapnik
+{
+
+struct expression_compiler;
+
+// Expression flattened into postfix bytecode for a small value stack
+// machine. Produces the same results as the evaluate visitor, but walks
+// a flat instruction array and reads attributes by context slot index,
+// resolved once per feature context instead of once per access.
+// Comparisons of an attribute with a literal, the usual rule filter,
+// are fused into a single instruction that copies no values.
+//
+// An instance is not modified by evaluating it, so it can be shared by
+// several threads; the state an evaluation works in is kept by callers.
+class MAPNIK_DECL compiled_expression
+{
+    friend struct expression_compiler;
+public:
+    // What an evaluation works in: the value stack and the context slots
+    // of the attributes read. Reusing one for many features of the same
+    // context saves resolving the slots and reallocating. A scratch
+    // serves a single expression and must not be used by two evaluations
+    // at once.
+    struct scratch
+    {
+        scratch()
+            : bound_version(0),
+              slots(),
+              stack() {}
+
+        std::uint64_t bound_version;
+        std::vector<std::size_t> slots;
+        std::vector<value_type> stack;
+    };
+
+    explicit compiled_expression(expression_ptr const& expr);
+
+    value_type evaluate(feature_impl const& feature, attributes const& vars, scratch & s) const;
+
+    // Evaluates with a scratch of its own, for one off evaluations.
+    value_type evaluate(feature_impl const& feature, attributes const& vars) const;
+
+    // Number of instructions.
+    std::size_t size() const { return code_.size(); }
+
+    enum class opcode : std::uint8_t
+    {
+        push_constant,      // a: constant
+        push_attribute,     // a: attribute name
+        push_global,        // a: global name
+        push_geometry_type,
+        negate,
+        logical_not,
+        and_jump,           // short circuit 'and', a: jump target
+        or_jump,            // short circuit 'or', a: jump target
+        to_bool,
+        plus, minus, mult, div, mod,
+        less, less_equal, greater, greater_equal, equal_to, not_equal_to,
+        // attribute a compared with constant b
+        attribute_less, attribute_less_equal, attribute_greater,
+        attribute_greater_equal, attribute_equal_to, attribute_not_equal_to,
+        regex_match,        // a: node
+        regex_replace,      // a: node
+        unary_call,         // a: node
+        binary_call         // a: node
+    };
+
+private:
+    struct instruction
+    {
+        opcode op;
+        std::uint32_t a;
+        std::uint32_t b;
+    };
+
+    void bind(context_type const& ctx, scratch & s) const;
+
+    // keeps the nodes referenced by node instructions alive
+    expression_ptr expr_;
+    std::vector<instruction> code_;
+    std::vector<value_type> constants_;
+    std::vector<std::string> names_;
+    std::vector<std::string> globals_;
+    std::vector<regex_match_node const*> regex_match_nodes_;
+    std::vector<regex_replace_node const*> regex_replace_nodes_;
+    std::vector<unary_function_call const*> unary_calls_;
+    std::vector<binary_function_call const*> binary_calls_;
+};
+
+}
+
+#endif // MAPNIK_COMPILED_EXPRESSION_HPP
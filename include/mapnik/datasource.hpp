@@ -33,11 +33,16 @@
 #include <mapnik/util/noncopyable.hpp>
 #include <mapnik/feature_style_processor_context.hpp>
 #include <mapnik/datasource_geometry_type.hpp>
+#include <mapnik/query_scheduler.hpp>
+#include <mapnik/datasource_stats.hpp>
 
 // stl
+#include <cstddef>
+#include <cstdint>
 #include <map>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace mapnik {
 
@@ -58,6 +63,9 @@ private:
     std::string message_;
 };
 
+// a number no other datasource created by this process is given
+MAPNIK_DECL std::uint64_t next_datasource_id();
+
 class MAPNIK_DECL datasource : private util::noncopyable
 {
 public:
@@ -67,7 +75,8 @@ public:
     };
 
     datasource (parameters const& _params)
-       : params_(_params) {}
+       : params_(_params),
+         id_(next_datasource_id()) {}
 
     /*!
      * @brief Get the configuration parameters of the data source.
@@ -86,6 +95,15 @@ public:
         return params_;
     }
 
+    /*!
+     * @brief Identifies this instance, unlike its address it is never
+     * reused by a datasource created later.
+     */
+    std::uint64_t id() const
+    {
+        return id_;
+    }
+
     bool operator==(datasource const& rhs) const
     {
         return params_ == rhs.params();
@@ -107,14 +125,90 @@ public:
         // default implementation without context use features method
         return features(q);
     }
+    /*!
+     * @brief Start a query without waiting for its featureset.
+     *
+     * The default implementation runs features_with_context() on the
+     * query_scheduler threads, within the budget of this datasource's type.
+     * The datasource must stay alive until the handle is consumed with
+     * get() or dropped with cancel().
+     */
+    virtual query_handle features_async(query const& q, processor_context_ptr ctx) const
+    {
+        return query_scheduler::instance().submit(*params_.get<std::string>("type", ""),
+                                                  [this, q, ctx]() { return features_with_context(q, ctx); });
+    }
+    /*!
+     * @brief Estimate the number of features a query returns.
+     *
+     * Meant to be cheap next to the query itself, e.g. answered from a spatial
+     * index or the database planner; boost::none (the default) when unknown.
+     * Used by renders keeping a layer's feature budget.
+     */
+    virtual boost::optional<std::size_t> estimate_features(query const& /*q*/) const
+    {
+        return boost::none;
+    }
     virtual boost::optional<datasource_geometry_t> get_geometry_type() const = 0;
     virtual featureset_ptr features(query const& q) const = 0;
     virtual featureset_ptr features_at_point(coord2d const& pt, double tol = 0) const = 0;
+    /*!
+     * @brief Query the features near several points at once.
+     *
+     * Returns a featureset per point, as features_at_point() would.
+     * Datasources reading from files override it to look up the index and
+     * read each record once for all points.
+     */
+    virtual std::vector<featureset_ptr> features_at_points(std::vector<coord2d> const& pts, double tol = 0) const
+    {
+        std::vector<featureset_ptr> result;
+        result.reserve(pts.size());
+        for (coord2d const& pt : pts)
+        {
+            result.push_back(features_at_point(pt, tol));
+        }
+        return result;
+    }
     virtual box2d<double> envelope() const = 0;
     virtual layer_descriptor get_descriptor() const = 0;
+    /*!
+     * @brief Estimate the heap memory the datasource holds, in bytes.
+     *
+     * Features, indexes and parsed sources kept in memory; files mapped
+     * through mapped_memory_cache are counted there. 0 (the default) for
+     * datasources keeping little or not knowing. See memory_report.
+     */
+    virtual std::size_t memory_usage() const
+    {
+        return 0;
+    }
+    /*!
+     * @brief What the featuresets of the datasource did since it was
+     * created or reset_stats() was called.
+     *
+     * Counted by the datasources that support it, among them shape,
+     * postgis and pgraster; all zero for the others. Featuresets add
+     * their counts when done, so queries still being read are left out.
+     */
+    datasource_stats stats() const
+    {
+        return counters_.snapshot();
+    }
+    void reset_stats()
+    {
+        counters_.clear();
+    }
+    // for the featuresets of the datasource to count into
+    datasource_counters & counters() const
+    {
+        return counters_;
+    }
     virtual ~datasource() {}
 protected:
     parameters params_;
+private:
+    std::uint64_t id_;
+    mutable datasource_counters counters_;
 };
 
 using datasource_name = const char* (*)();
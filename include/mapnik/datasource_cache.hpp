@@ -34,6 +34,7 @@
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <string>
 
 namespace mapnik {
 
@@ -51,12 +52,42 @@ public:
     std::string plugin_directories();
     bool register_datasources(std::string const& path, bool recurse = false);
     bool register_datasource(std::string const& path);
+    // Registers the plugins listed in a manifest, one per line as either
+    // "<name> <path>" or "<path>" to a <name>.input file, with relative
+    // paths resolved against the manifest's directory. Blank lines and
+    // lines starting with '#' are ignored. Plugins are not opened until
+    // the first create() of their type.
+    bool register_datasource_manifest(std::string const& manifest);
+    // With lazy loading register_datasources() and register_datasource()
+    // record <name>.input files by name and defer opening them to the first
+    // create() of their type. Off by default.
+    void set_lazy_loading(bool lazy);
+    bool lazy_loading();
     std::shared_ptr<datasource> create(parameters const& params);
+    // With sharing on create() returns the datasource it made before for
+    // the same parameters while anything still holds it, rather than
+    // opening the source again, so layers and maps reading the same
+    // shapefile or table share one connection pool, index or parsed file.
+    // Off by default.
+    void set_sharing(bool share);
+    bool sharing();
+    // number of datasources create() could currently hand out again
+    std::size_t shared_count();
 private:
+    std::shared_ptr<datasource> create_instance(parameters const& params);
+    bool register_lazy_datasource(std::string const& name, std::string const& path);
+    bool load_lazy_datasource(std::string const& name);
     datasource_cache();
     ~datasource_cache();
     std::map<std::string,std::shared_ptr<PluginInfo> > plugins_;
     std::set<std::string> plugin_directories_;
+    // plugins registered by name but not opened yet
+    std::map<std::string,std::string> lazy_plugins_;
+    bool lazy_loading_;
+    // datasources handed out while sharing, by parameters
+    std::map<std::string,std::weak_ptr<datasource> > shared_;
+    bool sharing_;
+    std::mutex shared_mutex_;
     // the singleton has a mutex protecting the instance pointer,
     // but the instance also needs its own mutex to protect the
     // plugins_ and plugin_directories_ members which are potentially
@@ -0,0 +1,106 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_DATASOURCE_METADATA_CACHE_HPP
+#define MAPNIK_DATASOURCE_METADATA_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/params.hpp>
+#include <mapnik/attribute_descriptor.hpp>
+#include <mapnik/datasource_geometry_type.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/optional.hpp>
+#pragma GCC diagnostic pop
+
+// stl
+#include <map>
+#include <string>
+#include <vector>
+
+namespace mapnik
+{
+
+// What a datasource learns about its source when it is created, so
+// the next one created with the same parameters can skip asking.
+struct datasource_metadata
+{
+    // cheap fingerprint of the source, e.g. file size and modification
+    // time; entries with a different stamp are stale
+    std::string stamp;
+    std::string encoding;
+    std::vector<attribute_descriptor> descriptors;
+    boost::optional<box2d<double>> extent;
+    boost::optional<datasource_geometry_t> geometry_type;
+    // plugin specific values, e.g. key field or srid
+    std::map<std::string, std::string> extra;
+};
+
+// Process wide store of datasource metadata keyed by datasource
+// parameters. Plugins look their metadata up before introspecting the
+// source and insert what they found; load() and save() persist the
+// entries to a file, so workers and restarts share what one process
+// learned.
+// The cache is disabled, finding and keeping nothing, until
+// set_enabled() turns it on.
+class MAPNIK_DECL datasource_metadata_cache :
+        public singleton<datasource_metadata_cache, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<datasource_metadata_cache>;
+public:
+    // the parameters identifying a source, passwords left out
+    static std::string make_key(parameters const& params);
+
+    void set_enabled(bool enabled);
+    bool enabled() const;
+
+    boost::optional<datasource_metadata> find(std::string const& key, std::string const& stamp) const;
+    void insert(std::string const& key, datasource_metadata const& metadata);
+    void erase(std::string const& key);
+    std::size_t size() const;
+    void clear();
+
+    // Adds the entries of a file written by save(), returns false if it
+    // can't be read.
+    bool load(std::string const& filename);
+    // Writes all entries, replacing the file at once.
+    bool save(std::string const& filename) const;
+
+private:
+    datasource_metadata_cache();
+
+    std::map<std::string, datasource_metadata> entries_;
+    bool enabled_;
+};
+
+extern template class MAPNIK_DECL singleton<datasource_metadata_cache, CreateStatic>;
+
+}
+
+#endif // MAPNIK_DATASOURCE_METADATA_CACHE_HPP
@@ -0,0 +1,204 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_DATASOURCE_STATS_HPP
+#define MAPNIK_DATASOURCE_STATS_HPP
+
+// stl
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace mapnik
+{
+
+// What the featuresets of a datasource did, see datasource::stats().
+struct datasource_stats
+{
+    using clock = std::chrono::steady_clock;
+    using duration = std::chrono::nanoseconds;
+
+    // featuresets made by features() and the like
+    std::uint64_t queries = 0;
+    // features the featuresets returned
+    std::uint64_t features = 0;
+    // records read but left out, e.g. outside the query box
+    std::uint64_t filtered = 0;
+    // bytes read from files or received from a database
+    std::uint64_t bytes_read = 0;
+    // spatial index entries or nodes looked at to answer queries
+    std::uint64_t index_nodes = 0;
+    // turning records into features: geometries and attributes
+    duration decode = duration::zero();
+    // waiting for a connection from a pool, for database datasources
+    duration wait = duration::zero();
+
+    datasource_stats & operator+=(datasource_stats const& rhs)
+    {
+        queries += rhs.queries;
+        features += rhs.features;
+        filtered += rhs.filtered;
+        bytes_read += rhs.bytes_read;
+        index_nodes += rhs.index_nodes;
+        decode += rhs.decode;
+        wait += rhs.wait;
+        return *this;
+    }
+
+    // the counting done since an earlier snapshot
+    datasource_stats operator-(datasource_stats const& rhs) const
+    {
+        datasource_stats diff;
+        diff.queries = queries - rhs.queries;
+        diff.features = features - rhs.features;
+        diff.filtered = filtered - rhs.filtered;
+        diff.bytes_read = bytes_read - rhs.bytes_read;
+        diff.index_nodes = index_nodes - rhs.index_nodes;
+        diff.decode = decode - rhs.decode;
+        diff.wait = wait - rhs.wait;
+        return diff;
+    }
+};
+
+// The running counters of a datasource, shared by the featuresets of
+// concurrent queries. Featuresets count into a datasource_stats of their
+// own and add() it when done or every so often, rather than touching the
+// shared counters for every record.
+class datasource_counters
+{
+public:
+    void add(datasource_stats const& stats)
+    {
+        queries_.fetch_add(stats.queries, std::memory_order_relaxed);
+        features_.fetch_add(stats.features, std::memory_order_relaxed);
+        filtered_.fetch_add(stats.filtered, std::memory_order_relaxed);
+        bytes_read_.fetch_add(stats.bytes_read, std::memory_order_relaxed);
+        index_nodes_.fetch_add(stats.index_nodes, std::memory_order_relaxed);
+        decode_.fetch_add(stats.decode.count(), std::memory_order_relaxed);
+        wait_.fetch_add(stats.wait.count(), std::memory_order_relaxed);
+    }
+
+    datasource_stats snapshot() const
+    {
+        datasource_stats stats;
+        stats.queries = queries_.load(std::memory_order_relaxed);
+        stats.features = features_.load(std::memory_order_relaxed);
+        stats.filtered = filtered_.load(std::memory_order_relaxed);
+        stats.bytes_read = bytes_read_.load(std::memory_order_relaxed);
+        stats.index_nodes = index_nodes_.load(std::memory_order_relaxed);
+        stats.decode = datasource_stats::duration(decode_.load(std::memory_order_relaxed));
+        stats.wait = datasource_stats::duration(wait_.load(std::memory_order_relaxed));
+        return stats;
+    }
+
+    void clear()
+    {
+        queries_ = 0;
+        features_ = 0;
+        filtered_ = 0;
+        bytes_read_ = 0;
+        index_nodes_ = 0;
+        decode_ = 0;
+        wait_ = 0;
+    }
+
+private:
+    std::atomic<std::uint64_t> queries_{0};
+    std::atomic<std::uint64_t> features_{0};
+    std::atomic<std::uint64_t> filtered_{0};
+    std::atomic<std::uint64_t> bytes_read_{0};
+    std::atomic<std::uint64_t> index_nodes_{0};
+    std::atomic<std::int64_t> decode_{0};
+    std::atomic<std::int64_t> wait_{0};
+};
+
+// The counting of one featureset, added to the datasource's counters by
+// flush() and on destruction. Counts nothing without counters.
+class datasource_stats_batch
+{
+public:
+    explicit datasource_stats_batch(datasource_counters * counters)
+        : counters_(counters),
+          stats_() {}
+
+    datasource_stats_batch(datasource_stats_batch const&) = delete;
+    datasource_stats_batch & operator=(datasource_stats_batch const&) = delete;
+
+    ~datasource_stats_batch()
+    {
+        flush();
+    }
+
+    explicit operator bool() const
+    {
+        return counters_ != nullptr;
+    }
+
+    datasource_stats & operator*()
+    {
+        return stats_;
+    }
+
+    datasource_stats * operator->()
+    {
+        return &stats_;
+    }
+
+    void flush()
+    {
+        if (counters_)
+        {
+            counters_->add(stats_);
+            stats_ = datasource_stats();
+        }
+    }
+
+private:
+    datasource_counters * counters_;
+    datasource_stats stats_;
+};
+
+// Adds the time from its construction to its destruction to a duration,
+// does nothing without one.
+class datasource_stats_timer
+{
+public:
+    explicit datasource_stats_timer(datasource_stats::duration * target)
+        : target_(target),
+          start_(target ? datasource_stats::clock::now() : datasource_stats::clock::time_point()) {}
+
+    ~datasource_stats_timer()
+    {
+        if (target_)
+        {
+            *target_ += std::chrono::duration_cast<datasource_stats::duration>(datasource_stats::clock::now() - start_);
+        }
+    }
+
+private:
+    datasource_stats::duration * target_;
+    datasource_stats::clock::time_point start_;
+};
+
+}
+
+#endif // MAPNIK_DATASOURCE_STATS_HPP
@@ -35,9 +35,9 @@
 #include <iosfwd>
 #include <string>
 #include <unordered_map>
+#include <atomic>
 #ifdef MAPNIK_THREADSAFE
 #include <mutex>
-#include <atomic>
 #endif
 
 namespace mapnik {
@@ -70,11 +70,24 @@ public:
     static void set_severity(severity_type severity_level)
     {
         severity_level_ = severity_level;
+        ++generation_;
+    }
+
+    // changes whenever a severity level is set, invalidating the levels
+    // cached by the logging call sites
+    static unsigned generation()
+    {
+        return generation_.load(std::memory_order_acquire);
     }
 
     // per object security levels
     static severity_type get_object_severity(std::string const& object_name)
     {
+        // the map is only looked up, under the lock, once a level was set
+        if (object_name.empty() || !has_object_severity_)
+        {
+            return severity_level_;
+        }
 #ifdef MAPNIK_THREADSAFE
         std::lock_guard<std::mutex> lock(severity_mutex_);
 #endif
@@ -98,6 +111,8 @@ public:
             std::lock_guard<std::mutex> lock(severity_mutex_);
 #endif
             object_severity_level_[object_name] = security_level;
+            has_object_severity_ = true;
+            ++generation_;
         }
     }
 
@@ -108,6 +123,8 @@ public:
 #endif
 
         object_severity_level_.clear();
+        has_object_severity_ = false;
+        ++generation_;
     }
 
     // format
@@ -137,23 +154,57 @@ private:
     static std::ofstream file_output_;
     static std::string file_name_;
     static std::streambuf* saved_buf_;
+    static std::atomic<unsigned> generation_;
 
 #ifdef MAPNIK_THREADSAFE
     static std::atomic<severity_type> severity_level_;
     static std::atomic<bool> severity_env_check_;
     static std::atomic<bool> format_env_check_;
+    static std::atomic<bool> has_object_severity_;
     static std::mutex severity_mutex_;
     static std::mutex format_mutex_;
 #else
     static severity_type severity_level_;
     static bool severity_env_check_;
     static bool format_env_check_;
+    static bool has_object_severity_;
 #endif
 };
 
 
 namespace detail {
 
+// The severity threshold of the object of one logging call site, looked
+// up again only after the logger's levels changed, so that checking a
+// filtered out message costs two atomic loads and no lock.
+class log_site : private util::noncopyable
+{
+public:
+    explicit log_site(const char* object_name)
+        : object_name_(object_name),
+          generation_(logger::generation() - 1),
+          threshold_(logger::none) {}
+
+    bool enabled(logger::severity_type severity)
+    {
+        unsigned generation = logger::generation();
+        if (generation_.load(std::memory_order_acquire) != generation)
+        {
+            threshold_.store(logger::get_object_severity(object_name_), std::memory_order_relaxed);
+            generation_.store(generation, std::memory_order_release);
+        }
+        return severity >= threshold_.load(std::memory_order_relaxed);
+    }
+
+private:
+    const char* object_name_;
+    std::atomic<unsigned> generation_;
+    std::atomic<logger::severity_type> threshold_;
+};
+
+// Tags loggers built by the logging macros, which checked their severity
+struct severity_checked {};
+
 // Default sink, it regulates access to clog
 
 template<class Ch, class Tr, class A>
@@ -197,16 +248,23 @@ public:
             object_name_ = object_name;
         }
     }
+
+    base_log(const char* /*object_name*/, severity_checked)
+        : checked_(true) {}
 #else
     base_log(const char* /*object_name*/)
     {
     }
+
+    base_log(const char* /*object_name*/, severity_checked)
+    {
+    }
 #endif
 
     ~base_log()
     {
 #ifdef MAPNIK_LOG
-        if (check_severity())
+        if (checked_ || check_severity())
         {
             output_policy()(Severity, streambuf_);
         }
@@ -238,6 +296,7 @@ private:
 
     typename output_policy::stream_buffer streambuf_;
     std::string object_name_;
+    bool checked_ = false;
 #endif
 };
 
@@ -266,9 +325,12 @@ public:
         }
     }
 
+    base_log_always(const char* /*object_name*/, severity_checked)
+        : checked_(true) {}
+
     ~base_log_always()
     {
-        if (check_severity())
+        if (checked_ || check_severity())
         {
             output_policy()(Severity, streambuf_);
         }
@@ -289,9 +351,18 @@ private:
 
     typename output_policy::stream_buffer streambuf_;
     std::string object_name_;
+    bool checked_ = false;
 };
 
 
+// Turns a streamed log message into void, so the logging macros can skip
+// it in the other branch of a conditional; binds looser than operator<<.
+struct log_voidify
+{
+    template <typename T>
+    void operator&(T const&) const {}
+};
+
 using base_log_debug = base_log<clog_sink, logger::debug>;
 using base_log_warn = base_log<clog_sink, logger::warn>;
 using base_log_error = base_log_always<clog_sink, logger::error>;
@@ -305,6 +376,7 @@ class MAPNIK_DECL warn : public detail::base_log_warn
 public:
     warn() : detail::base_log_warn() {}
     warn(const char* object_name) : detail::base_log_warn(object_name) {}
+    warn(const char* object_name, detail::severity_checked tag) : detail::base_log_warn(object_name, tag) {}
 };
 
 class MAPNIK_DECL debug : public detail::base_log_debug
@@ -312,6 +384,7 @@ class MAPNIK_DECL debug : public detail::base_log_debug
 public:
     debug() : detail::base_log_debug() {}
     debug(const char* object_name) : detail::base_log_debug(object_name) {}
+    debug(const char* object_name, detail::severity_checked tag) : detail::base_log_debug(object_name, tag) {}
 };
 
 class MAPNIK_DECL error : public detail::base_log_error
@@ -319,12 +392,23 @@ class MAPNIK_DECL error : public detail::base_log_error
 public:
     error() : detail::base_log_error() {}
     error(const char* object_name) : detail::base_log_error(object_name) {}
+    error(const char* object_name, detail::severity_checked tag) : detail::base_log_error(object_name, tag) {}
 };
 
-// logging helpers
+// logging helpers, the severity is checked against a threshold cached per
+// call site before the logger is built or the streamed arguments evaluated
+#define MAPNIK_LOG_SITE(s) ([]() -> mapnik::detail::log_site & { static mapnik::detail::log_site site(#s); return site; }())
+#define MAPNIK_LOG_CHECKED(s, severity, type) \
+    !MAPNIK_LOG_SITE(s).enabled(mapnik::logger::severity) ? (void)0 : \
+    mapnik::detail::log_voidify() & mapnik::type(#s, mapnik::detail::severity_checked())
+#ifdef MAPNIK_LOG
+#define MAPNIK_LOG_DEBUG(s) MAPNIK_LOG_CHECKED(s, debug, debug)
+#define MAPNIK_LOG_WARN(s) MAPNIK_LOG_CHECKED(s, warn, warn)
+#else
 #define MAPNIK_LOG_DEBUG(s) mapnik::debug(#s)
 #define MAPNIK_LOG_WARN(s) mapnik::warn(#s)
-#define MAPNIK_LOG_ERROR(s) mapnik::error(#s)
+#endif
+#define MAPNIK_LOG_ERROR(s) MAPNIK_LOG_CHECKED(s, error, error)
 }
 
 #endif // MAPNIK_DEBUG_HPP
@@ -0,0 +1,68 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_DENSITY_AGGREGATOR_HPP
+#define MAPNIK_DENSITY_AGGREGATOR_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <string>
+
+namespace mapnik
+{
+
+// Bins the features of a layer with aggregate="density" into a float
+// grid over the layer's extent, one cell per rendered pixel. Each feature
+// adds 1, or the value of the weight field, to the cell holding each of
+// its points, or its centroid for lines and polygons. The grid is handed
+// to the styles as the raster of a single feature, empty cells being its
+// nodata.
+class MAPNIK_DECL density_aggregator : private util::noncopyable
+{
+public:
+    density_aggregator(box2d<double> const& extent, unsigned width, unsigned height,
+                       std::string const& weight);
+
+    void add(feature_impl const& feature);
+    // the feature holding the grid, the aggregator is empty afterwards
+    feature_ptr release();
+
+private:
+    void add(double x, double y, float weight);
+
+    box2d<double> extent_;
+    double scale_x_;
+    double scale_y_;
+    std::string weight_;
+    image_gray32f grid_;
+};
+
+}
+
+#endif // MAPNIK_DENSITY_AGGREGATOR_HPP
@@ -0,0 +1,162 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_EXECUTOR_HPP
+#define MAPNIK_EXECUTOR_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#ifdef MAPNIK_THREADSAFE
+#include <thread>
+#endif
+
+namespace mapnik
+{
+
+// Runs the work mapnik spreads over threads: async queries, style and
+// strip rendering, image decoding, filtering and encoding. All of it is
+// scheduled onto one executor so that a server running its own render
+// threads is not oversubscribed, and a host with a thread pool of its own
+// can install it with set_executor().
+class MAPNIK_DECL executor : private util::noncopyable
+{
+public:
+    using task_type = std::function<void()>;
+
+    virtual ~executor();
+    // Runs task on some thread, later. Must not wait for the task. Tasks
+    // do not throw.
+    virtual void post(task_type task) = 0;
+    // Number of threads tasks run on, 0 if they run inside post().
+    virtual std::size_t concurrency() const = 0;
+};
+
+// Work-stealing pool: every worker pops tasks it posted itself from the
+// back of its own queue and steals from the front of the others when
+// that runs dry. On NUMA machines workers are spread over the nodes and
+// bound to them, tasks posted from other threads are dealt round robin
+// to the workers of the poster's node, and steals look there first.
+// Without MAPNIK_THREADSAFE it has no threads and runs tasks in post().
+class MAPNIK_DECL thread_pool_executor : public executor
+{
+public:
+    explicit thread_pool_executor(std::size_t threads);
+    ~thread_pool_executor();
+    void post(task_type task) override;
+    std::size_t concurrency() const override;
+
+private:
+    struct queue
+    {
+        std::mutex mutex;
+        std::deque<task_type> tasks;
+    };
+
+    bool pop(std::size_t index, task_type & task);
+    bool steal(std::size_t index, bool same_node, task_type & task);
+    void worker(std::size_t index);
+
+    std::vector<std::unique_ptr<queue>> queues_;
+    // worker i runs on node i % nodes_
+    std::size_t nodes_;
+    std::atomic<std::size_t> next_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::size_t queued_;
+    bool stop_;
+#ifdef MAPNIK_THREADSAFE
+    std::vector<std::thread> threads_;
+#endif
+};
+
+// The executor mapnik schedules onto: the one installed last, or a
+// process wide thread_pool_executor with a thread per core but one.
+MAPNIK_DECL std::shared_ptr<executor> get_executor();
+// Installs ex for work scheduled from now on, nullptr restores the
+// built-in pool. Work already posted stays on the previous executor.
+MAPNIK_DECL void set_executor(std::shared_ptr<executor> ex);
+
+// The executor blocking I/O runs on: queries started by the
+// query_scheduler and postgis background connects. Kept apart from
+// get_executor() so that threads waiting on a database take none from
+// rendering, and a host executor running tasks inside post() does not
+// turn them synchronous. The built-in pool has a thread per core, at
+// least 4. Nothing is posted to an I/O executor without threads: queries
+// are then run by the callers waiting on them, and connections are
+// opened in place.
+MAPNIK_DECL std::shared_ptr<executor> get_io_executor();
+// Installs ex for I/O scheduled from now on, nullptr restores the
+// built-in pool.
+MAPNIK_DECL void set_io_executor(std::shared_ptr<executor> ex);
+
+// Tasks run on an executor and waited for together. wait() runs the
+// tasks no thread has picked up yet on the calling thread, so waiting
+// from inside a task of a busy executor cannot deadlock.
+class MAPNIK_DECL task_group : private util::noncopyable
+{
+public:
+    task_group();
+    explicit task_group(std::shared_ptr<executor> ex);
+    // waits, dropping exceptions
+    ~task_group();
+
+    void run(executor::task_type task);
+    // Returns once all tasks have run, rethrowing the first exception
+    // one of them threw.
+    void wait();
+
+private:
+    struct state;
+    struct item;
+
+    std::shared_ptr<executor> executor_;
+    std::shared_ptr<state> state_;
+    std::vector<std::shared_ptr<item>> items_;
+};
+
+// Calls func(i) for every i in [0, count) on up to `threads` threads,
+// the calling one included. Indices are claimed one at a time, so items
+// of uneven cost balance out. After func throws no further items start;
+// the first exception is rethrown once the started ones have returned.
+MAPNIK_DECL void parallel_for(std::size_t count, std::size_t threads,
+                              std::function<void(std::size_t)> const& func);
+
+// Splits rows [0, height) into up to `bands` bands of even height and
+// calls func(y0, y1) for each of them through parallel_for.
+MAPNIK_DECL void parallel_bands(std::size_t height, std::size_t bands,
+                                std::function<void(std::size_t, std::size_t)> const& func);
+
+}
+
+#endif // MAPNIK_EXECUTOR_HPP
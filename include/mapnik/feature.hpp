@@ -30,11 +30,15 @@
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/geometry.hpp>
 #include <mapnik/geometry/envelope.hpp>
+#include <mapnik/geometry/geometry_type.hpp>
+#include <mapnik/geometry/interior.hpp>
 //
 #include <mapnik/feature_kv_iterator.hpp>
 #include <mapnik/util/noncopyable.hpp>
 
 // stl
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <map>
@@ -50,6 +54,20 @@ class feature_impl;
 
 using raster_ptr = std::shared_ptr<raster>;
 
+namespace detail {
+
+// Process wide, never zero stamp identifying a context's current set of
+// names. Lets attribute lookups cache slot indices per context without
+// holding on to it. 64 bits so that it does not wrap around in the life
+// of a server, a wrapped stamp would match the slots of another context.
+inline std::uint64_t next_context_version()
+{
+    static std::atomic<std::uint64_t> counter(0);
+    return ++counter;
+}
+
+}
+
 template <typename T>
 class context : private util::noncopyable
 
@@ -64,29 +82,51 @@ public:
     using iterator = typename map_type::iterator;
     using const_iterator = typename map_type::const_iterator;
 
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
     context()
-        : mapping_() {}
+        : mapping_(),
+          version_(detail::next_context_version()) {}
 
     inline size_type push(key_type const& name)
     {
         size_type index = mapping_.size();
         mapping_.emplace(name, index);
+        version_ = detail::next_context_version();
         return index;
     }
 
     inline void add(key_type const& name, size_type index)
     {
         mapping_.emplace(name, index);
+        version_ = detail::next_context_version();
     }
 
     inline size_type size() const { return mapping_.size(); }
+    inline const_iterator find(key_type const& name) const { return mapping_.find(name); }
+
+    // Slot of name in features of this context, npos if absent.
+    // feature_impl::get(npos) yields the default value.
+    inline size_type index_of(key_type const& name) const
+    {
+        auto itr = mapping_.find(name);
+        return itr != mapping_.end() ? itr->second : npos;
+    }
+
+    // Changes whenever names are added, slots resolved against an
+    // older version may be stale.
+    inline std::uint64_t version() const { return version_; }
     inline const_iterator begin() const { return mapping_.begin();}
     inline const_iterator end() const { return mapping_.end();}
 
 private:
     map_type mapping_;
+    std::uint64_t version_;
 };
 
+template <typename T>
+constexpr typename context<T>::size_type context<T>::npos;
+
 using context_type = context<std::map<std::string,std::size_t> >;
 using context_ptr = std::shared_ptr<context_type>;
 
@@ -106,7 +146,16 @@ public:
         ctx_(ctx),
         data_(ctx_->mapping_.size()),
         geom_(geometry::geometry_empty()),
-        raster_() {}
+        raster_(),
+        envelope_(),
+        geometry_type_(geometry::geometry_types::Unknown),
+        bounds_state_(bounds_empty),
+        interiors_(nullptr) {}
+
+    ~feature_impl()
+    {
+        clear_interiors();
+    }
 
     inline mapnik::value_integer id() const { return id_;}
     inline void set_id(mapnik::value_integer _id) { id_ = _id;}
@@ -193,14 +242,36 @@ public:
         return ctx_;
     }
 
+    // Same as context() without touching the reference count.
+    inline context_type const& get_context() const
+    {
+        return *ctx_;
+    }
+
     inline void set_geometry(geometry::geometry<double> && geom)
     {
         geom_ = std::move(geom);
+        clear_interiors();
+        bounds_state_.store(bounds_empty, std::memory_order_relaxed);
+    }
+
+    // For datasources knowing the envelope of the geometry already, e.g.
+    // from a record header. It may be looser than the vertices, never
+    // tighter.
+    inline void set_geometry(geometry::geometry<double> && geom, box2d<double> const& envelope)
+    {
+        geom_ = std::move(geom);
+        clear_interiors();
+        envelope_ = envelope;
+        geometry_type_ = geometry::geometry_type(geom_);
+        bounds_state_.store(bounds_ready, std::memory_order_relaxed);
     }
 
     inline void set_geometry_copy(geometry::geometry<double> const& geom)
     {
         geom_ = geom;
+        clear_interiors();
+        bounds_state_.store(bounds_empty, std::memory_order_relaxed);
     }
 
     inline geometry::geometry<double> const& get_geometry() const
@@ -208,14 +279,71 @@ public:
         return geom_;
     }
 
+    // For code changing the geometry, which calls reset_bounds() after;
+    // the interior points found so far are dropped. Readers, which may
+    // share a cached feature with other threads, use the const overload.
     inline geometry::geometry<double> & get_geometry()
     {
+        clear_interiors();
         return geom_;
     }
 
+    // Envelope and type of the geometry, worked out on first use and kept
+    // for the bbox tests, clipping and placement reading them after.
     inline box2d<double> envelope() const
     {
-        return mapnik::geometry::envelope(geom_);
+        if (bounds_state_.load(std::memory_order_acquire) != bounds_ready)
+        {
+            box2d<double> box;
+            geometry::geometry_types type;
+            cache_bounds(box, type);
+            return box;
+        }
+        return envelope_;
+    }
+
+    inline geometry::geometry_types geometry_type() const
+    {
+        if (bounds_state_.load(std::memory_order_acquire) != bounds_ready)
+        {
+            box2d<double> box;
+            geometry::geometry_types type;
+            cache_bounds(box, type);
+            return type;
+        }
+        return geometry_type_;
+    }
+
+    inline void reset_bounds()
+    {
+        bounds_state_.store(bounds_empty, std::memory_order_relaxed);
+    }
+
+    // Interior point of one of the polygons of this feature's geometry,
+    // remembered so the symbolizers placing labels and markers inside the
+    // same polygon at the same precision search for it once. Cached
+    // features may be rendered by several threads at a time: the points
+    // are kept in a list only ever prepended to, threads racing for the
+    // same polygon may both add it.
+    inline bool interior(geometry::polygon<double> const& poly, double precision,
+                         geometry::point<double> & pt) const
+    {
+        for (interior_entry const* entry = interiors_.load(std::memory_order_acquire);
+             entry != nullptr; entry = entry->next)
+        {
+            if (entry->poly == &poly && entry->precision == precision)
+            {
+                pt = entry->pt;
+                return true;
+            }
+        }
+        if (!geometry::interior(poly, precision, pt)) return false;
+        interior_entry * entry = new interior_entry{&poly, precision, pt,
+                                                    interiors_.load(std::memory_order_relaxed)};
+        while (!interiors_.compare_exchange_weak(entry->next, entry,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed)) {}
+        return true;
     }
 
     inline raster_ptr const& get_raster() const
@@ -262,11 +390,58 @@ public:
     }
 
 private:
+    enum bounds_state : int
+    {
+        bounds_empty,
+        bounds_busy,
+        bounds_ready
+    };
+
+    // Cached features may be rendered by several threads at a time, the
+    // one claiming the empty bounds stores them and the others use what
+    // they worked out themselves.
+    void cache_bounds(box2d<double> & box, geometry::geometry_types & type) const
+    {
+        box = geometry::envelope(geom_);
+        type = geometry::geometry_type(geom_);
+        int expected = bounds_empty;
+        if (bounds_state_.compare_exchange_strong(expected, bounds_busy, std::memory_order_acquire))
+        {
+            envelope_ = box;
+            geometry_type_ = type;
+            bounds_state_.store(bounds_ready, std::memory_order_release);
+        }
+    }
+
+    // only while no other thread reads the feature
+    void clear_interiors()
+    {
+        interior_entry const* entry = interiors_.exchange(nullptr, std::memory_order_relaxed);
+        while (entry != nullptr)
+        {
+            interior_entry const* next = entry->next;
+            delete entry;
+            entry = next;
+        }
+    }
+
+    struct interior_entry
+    {
+        geometry::polygon<double> const* poly;
+        double precision;
+        geometry::point<double> pt;
+        interior_entry const* next;
+    };
+
     mapnik::value_integer id_;
     context_ptr ctx_;
     cont_type data_;
     geometry::geometry<double> geom_;
     raster_ptr raster_;
+    mutable box2d<double> envelope_;
+    mutable geometry::geometry_types geometry_type_;
+    mutable std::atomic<int> bounds_state_;
+    mutable std::atomic<interior_entry const*> interiors_;
 };
 
 
@@ -0,0 +1,129 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_FEATURE_ARENA_HPP
+#define MAPNIK_FEATURE_ARENA_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace mapnik {
+
+// Block allocator for the features of one query. Allocations are carved
+// out of 64k blocks; a block is recycled once everything allocated from it
+// has been released, and all blocks are freed together with the arena.
+// Only one thread may allocate, memory can be released from any thread.
+class MAPNIK_DECL feature_arena : private util::noncopyable
+{
+public:
+    static const std::size_t block_size = 64 * 1024;
+    // larger requests bypass the arena
+    static const std::size_t max_size = block_size / 8;
+
+    feature_arena();
+    ~feature_arena();
+
+    void * allocate(std::size_t size);
+    static void deallocate(void * p);
+
+    std::size_t num_blocks() const { return blocks_.size(); }
+
+private:
+    struct block;
+    block * new_block();
+
+    std::vector<std::unique_ptr<block>> blocks_;
+    std::deque<block*> retired_;
+    block * current_;
+    std::size_t offset_;
+};
+
+using feature_arena_ptr = std::shared_ptr<feature_arena>;
+
+// std allocator over a feature_arena, copies keep the arena alive
+template <typename T>
+class arena_allocator
+{
+public:
+    using value_type = T;
+
+    explicit arena_allocator(feature_arena_ptr const& arena)
+        : arena_(arena) {}
+
+    template <typename U>
+    arena_allocator(arena_allocator<U> const& other)
+        : arena_(other.arena()) {}
+
+    T * allocate(std::size_t n)
+    {
+        std::size_t size = n * sizeof(T);
+        if (size > feature_arena::max_size || alignof(T) > alignof(std::max_align_t))
+        {
+            return static_cast<T*>(::operator new(size));
+        }
+        return static_cast<T*>(arena_->allocate(size));
+    }
+
+    void deallocate(T * p, std::size_t n)
+    {
+        if (n * sizeof(T) > feature_arena::max_size || alignof(T) > alignof(std::max_align_t))
+        {
+            ::operator delete(p);
+        }
+        else
+        {
+            feature_arena::deallocate(p);
+        }
+    }
+
+    feature_arena_ptr const& arena() const
+    {
+        return arena_;
+    }
+
+private:
+    feature_arena_ptr arena_;
+};
+
+template <typename T, typename U>
+bool operator==(arena_allocator<T> const& lhs, arena_allocator<U> const& rhs)
+{
+    return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(arena_allocator<T> const& lhs, arena_allocator<U> const& rhs)
+{
+    return !(lhs == rhs);
+}
+
+}
+
+#endif // MAPNIK_FEATURE_ARENA_HPP
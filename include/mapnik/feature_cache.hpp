@@ -0,0 +1,114 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_FEATURE_CACHE_HPP
+#define MAPNIK_FEATURE_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/featureset.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace mapnik
+{
+
+class datasource;
+class query;
+
+// Process wide cache of query results for layers with cache-features
+// enabled, so neighbouring tiles at the same scale reuse the features of
+// low zoom layers. Entries are keyed by datasource, quantized query bbox,
+// scale denominator, filter factor, property names and filter; the least
+// recently used ones are evicted once more than max_features() features
+// are held.
+// The cache is disabled until set_max_features() is given a budget.
+class MAPNIK_DECL feature_cache :
+        public singleton<feature_cache, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<feature_cache>;
+public:
+    using features_type = std::vector<feature_ptr>;
+    using features_ptr = std::shared_ptr<features_type const>;
+
+    // 0 disables the cache and drops all entries
+    void set_max_features(std::size_t max_features);
+    std::size_t max_features() const;
+    // entries older than this are not returned, 0 keeps them until evicted
+    void set_ttl(std::chrono::milliseconds ttl);
+    std::chrono::milliseconds ttl() const;
+
+    features_ptr find(std::shared_ptr<datasource> const& ds, query const& q);
+    void insert(std::shared_ptr<datasource> const& ds, query const& q, features_ptr const& features);
+    std::size_t size() const;
+    void clear();
+
+    // Grows a query bbox to the enclosing cells of a power of two grid
+    // sized to it, so every query falling into the same cells shares a key.
+    static box2d<double> quantize(box2d<double> const& box);
+
+private:
+    feature_cache();
+
+    // datasource, bbox, scale denominator, filter factor, property names,
+    // filter and the variables, which datasources may substitute into
+    // their queries
+    using key_type = std::tuple<datasource const*, double, double, double, double,
+                                double, double, std::set<std::string>, std::string, std::string>;
+    struct entry
+    {
+        std::weak_ptr<datasource> ds;
+        features_ptr features;
+        std::chrono::steady_clock::time_point created;
+        std::list<key_type>::iterator lru;
+    };
+
+    static key_type make_key(std::shared_ptr<datasource> const& ds, query const& q);
+    void evict();
+
+    std::map<key_type, entry> entries_;
+    // most recently used first
+    std::list<key_type> lru_;
+    std::size_t max_features_;
+    std::size_t num_features_;
+    std::chrono::milliseconds ttl_;
+};
+
+extern template class MAPNIK_DECL singleton<feature_cache, CreateStatic>;
+
+}
+
+#endif // MAPNIK_FEATURE_CACHE_HPP
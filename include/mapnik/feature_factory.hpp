@@ -25,6 +25,7 @@
 
 // mapnik
 #include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
 #include <mapnik/value/types.hpp>
 
 // boost
@@ -40,6 +41,17 @@ struct feature_factory
         //return boost::allocate_shared<feature_impl>(boost::fast_pool_allocator<feature_impl>(),fid);
         return std::make_shared<feature_impl>(ctx,fid);
     }
+
+    // allocates the feature from arena when there is one
+    static std::shared_ptr<feature_impl> create (context_ptr const& ctx, mapnik::value_integer fid,
+                                                 feature_arena_ptr const& arena)
+    {
+        if (arena)
+        {
+            return std::allocate_shared<feature_impl>(arena_allocator<feature_impl>(arena), ctx, fid);
+        }
+        return std::make_shared<feature_impl>(ctx,fid);
+    }
 };
 }
 
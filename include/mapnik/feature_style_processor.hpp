@@ -28,8 +28,15 @@
 #include <mapnik/featureset.hpp>
 #include <mapnik/config.hpp>
 #include <mapnik/feature_style_processor_context.hpp>
+#include <mapnik/request.hpp>
+#include <mapnik/render_stats.hpp>
+#include <mapnik/cancel_token.hpp>
+#include <mapnik/symbolizer_base.hpp>
 
 // stl
+#include <atomic>
+#include <cstddef>
+#include <memory>
 #include <vector>
 #include <set>
 #include <string>
@@ -44,6 +51,16 @@ class proj_transform;
 class feature_type_style;
 class rule_cache;
 struct layer_rendering_material;
+struct feature_budget;
+class featureset_buffer;
+
+// Label symbolizer deferred by render_style
+struct scheduled_label
+{
+    double priority;
+    feature_ptr feature;
+    symbolizer const* sym;
+};
 
 enum eAttributeCollectionPolicy
 {
@@ -57,6 +74,13 @@ class MAPNIK_DECL feature_style_processor
 public:
     explicit feature_style_processor(Map const& m,
                                      double scale_factor = 1.0);
+    /*!
+     * \brief render the style graph of a shared map with the size, extent and
+     * buffer size of a request, without copying the map.
+     */
+    feature_style_processor(Map const& m,
+                            request const& req,
+                            double scale_factor = 1.0);
 
     /*!
      * \brief apply renderer to all map layers.
@@ -84,7 +108,184 @@ public:
                         int buffer_size,
                         std::set<std::string>& names);
 
+    /*!
+     * \brief set the maximum number of threads used to query datasources.
+     *
+     * With a value greater than one every layer is queried through
+     * datasource::features_async() while the layers are prepared, on the
+     * query_scheduler threads (at least max_threads - 1 of them) and within
+     * each datasource type's budget. Painting still happens in layer order
+     * and waits for each layer's featuresets, so the output is unchanged;
+     * queries not consumed when rendering stops are cancelled.
+     * The datasources involved must then support concurrent queries.
+     * The default of 1 queries every layer just before it is rendered.
+     */
+    void set_query_threads(std::size_t max_threads)
+    {
+        query_threads_ = max_threads;
+    }
+
+    std::size_t query_threads() const
+    {
+        return query_threads_;
+    }
+
+    /*!
+     * \brief build the features of every layer query in a feature_arena
+     *
+     * Datasources supporting it (shape, postgis, geojson, csv) then carve
+     * their features out of per featureset memory blocks instead of one
+     * heap allocation each. Off by default.
+     */
+    void set_feature_arena(bool arena)
+    {
+        feature_arena_ = arena;
+    }
+
+    bool feature_arena() const
+    {
+        return feature_arena_;
+    }
+
+    /*!
+     * \brief collect the timings and counts of every apply() into stats
+     *
+     * The stats must outlive the rendering, a null pointer (the default)
+     * stops collecting. Each timed phase costs two clock reads, per batch
+     * of features or per symbolizer processed.
+     */
+    void set_stats(render_stats * stats)
+    {
+        stats_ = stats;
+    }
+
+    render_stats * stats() const
+    {
+        return stats_;
+    }
+
+    /*!
+     * \brief stop rendering once the token trips
+     *
+     * The token is checked before each layer, feature and deferred label
+     * and passed to the datasources with every query, pending queries are
+     * cancelled. Layers and styles already started are still ended, so the
+     * output holds what was drawn so far; interrupted() tells whether the
+     * last render stopped early. A null token (the default) renders all.
+     */
+    void set_cancel_token(cancel_token_ptr const& token)
+    {
+        cancel_ = token;
+    }
+
+    cancel_token_ptr const& get_cancel_token() const
+    {
+        return cancel_;
+    }
+
+    /*!
+     * \brief whether the last render was cut short by the cancel token,
+     * its output being partial then.
+     */
+    bool interrupted() const
+    {
+        return interrupted_;
+    }
+
+    /*!
+     * \brief hooks for renderers reusing the output of cache-image layers
+     *
+     * When prepare_cached_layer() returns true the layer is neither queried
+     * nor rendered; render_cached_layer() is called in its place instead.
+     * Processors keeping no such cache inherit these defaults.
+     */
+    bool prepare_cached_layer(Map const&, layer const&)
+    {
+        return false;
+    }
+
+    void render_cached_layer(layer const&) {}
+
+    /*!
+     * \brief hook for processors drawing only some of the symbolizers
+     *
+     * Symbolizers for which it returns false are skipped, rules still
+     * match as usual. Processors drawing all symbolizers inherit this.
+     */
+    template <typename Symbolizer>
+    bool draws_symbolizer(Symbolizer const&) const
+    {
+        return true;
+    }
+
+    /*!
+     * \brief hooks for processors placing labels in a phase of their own
+     *
+     * When defers_labels() is true the text and shield symbolizers of each
+     * style are collected, highest priority first, and handed over to
+     * defer_labels() once the style's other symbolizers were processed,
+     * instead of being processed themselves.
+     */
+    bool defers_labels() const
+    {
+        return false;
+    }
+
+    void defer_labels(std::vector<scheduled_label> &, proj_transform const&, double) {}
+
+    /*!
+     * \brief hook for processors keeping state per feature
+     *
+     * Called with each feature before the symbolizers of its matching
+     * rules are processed, labels processed at the end of the style
+     * excepted.
+     */
+    void start_feature(feature_ptr const&) {}
+
+    /*!
+     * \brief hook for processors whose output records every layer
+     *
+     * Layers without features are skipped, with no start_layer_processing()
+     * or style calls, when this returns true and their styles composite
+     * nothing without features. Processors writing a group per layer
+     * return false to keep the empty groups.
+     */
+    bool skips_empty_layers() const
+    {
+        return true;
+    }
+
+    /*!
+     * \brief hooks for processors rendering styles concurrently
+     *
+     * The styles of a layer rendered from cached features, for which
+     * renders_style_apart() is true, are rendered by processors from
+     * make_style_worker() on up to style_threads() threads, the calling
+     * one included. end_style_worker() is then called in the style order
+     * in place of rendering the style, to composite what the worker drew.
+     * Processors rendering styles in turn inherit these defaults.
+     */
+    unsigned style_threads() const
+    {
+        return 1;
+    }
+
+    bool renders_style_apart(feature_type_style const&) const
+    {
+        return false;
+    }
+
+    std::unique_ptr<Processor> make_style_worker(Map const&, feature_type_style const&)
+    {
+        return std::unique_ptr<Processor>();
+    }
+
+    void end_style_worker(feature_type_style const&, Processor &) {}
+
 private:
+    // number of features pulled from a featureset at a time
+    static constexpr std::size_t feature_batch_size = 256;
+
     /*!
      * \brief renders a featureset with the given styles.
      */
@@ -92,7 +293,9 @@ private:
                       feature_type_style const* style,
                       rule_cache const& rules,
                       featureset_ptr features,
-                      proj_transform const& prj_trans);
+                      proj_transform const& prj_trans,
+                      render_stats::style_stats * stats,
+                      feature_budget const* budget);
 
     void prepare_layers(layer_rendering_material & parent_mat,
                         std::vector<layer> const & layers,
@@ -117,10 +320,38 @@ private:
     /*!
      * \brief render features list queued when they are available.
      */
-    void render_material(layer_rendering_material const & mat, Processor & p );
-    void render_submaterials(layer_rendering_material const & mat, Processor & p);
+    void render_material(layer_rendering_material & mat, Processor & p );
+
+    // renders the styles of a layer off the features cached for all of
+    // them, concurrently for the styles the processor renders apart
+    void render_cached_styles(layer_rendering_material & mat,
+                              Processor & p,
+                              std::shared_ptr<featureset_buffer> const& cache,
+                              proj_transform const& prj_trans,
+                              feature_budget const* budget);
+
+    // resolves the queries started through features_async() into featuresets
+    void wait_queries(layer_rendering_material & mat);
+
+    /*!
+     * \brief whether the layer can be skipped altogether: none of its
+     * featuresets has a feature and drawing its styles without features
+     * would leave the output unchanged.
+     */
+    bool skip_empty_material(layer_rendering_material & mat, Processor & p);
+    void render_submaterials(layer_rendering_material & mat, Processor & p);
+
+    // checks the cancel token, remembering that the render was interrupted
+    bool cancelled();
 
     Map const& m_;
+    std::size_t query_threads_;
+    bool feature_arena_;
+    render_stats * stats_;
+    cancel_token_ptr cancel_;
+    // set from the style worker threads too
+    std::atomic<bool> interrupted_;
+    request req_;
 };
 }
 
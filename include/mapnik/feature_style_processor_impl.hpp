@@ -32,23 +32,47 @@
 #include <mapnik/feature_style_processor.hpp>
 #include <mapnik/query.hpp>
 #include <mapnik/datasource.hpp>
+#include <mapnik/feature_cache.hpp>
+#include <mapnik/geometry_pyramid.hpp>
 #include <mapnik/feature_type_style.hpp>
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/layer.hpp>
 #include <mapnik/rule.hpp>
 #include <mapnik/rule_cache.hpp>
+#include <mapnik/rule_bands.hpp>
 #include <mapnik/attribute_collector.hpp>
 #include <mapnik/expression_evaluator.hpp>
 #include <mapnik/scale_denominator.hpp>
 #include <mapnik/projection.hpp>
 #include <mapnik/proj_transform.hpp>
+#include <mapnik/projection_cache.hpp>
+#include <mapnik/query_scheduler.hpp>
+#include <mapnik/executor.hpp>
+#include <mapnik/density_aggregator.hpp>
 #include <mapnik/util/featureset_buffer.hpp>
 #include <mapnik/util/variant.hpp>
 #include <mapnik/symbolizer_dispatch.hpp>
+#include <mapnik/symbolizer_utils.hpp>
+#include <mapnik/render_stats.hpp>
+#include <mapnik/trace.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/optional.hpp>
+#pragma GCC diagnostic pop
 
 // stl
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <vector>
 #include <stdexcept>
+#include <utility>
+#ifdef MAPNIK_THREADSAFE
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#endif
 
 namespace mapnik
 {
@@ -58,31 +82,271 @@ struct layer_rendering_material
 {
     layer const& lay_;
     projection const& proj0_;
-    projection proj1_;
+    projection const& proj1_;
     box2d<double> layer_ext2_;
     std::vector<feature_type_style const*> active_styles_;
     std::vector<featureset_ptr> featureset_ptr_list_;
-    std::vector<rule_cache> rule_caches_;
+    std::vector<std::shared_ptr<rule_cache const>> rule_caches_;
     std::vector<layer_rendering_material> materials_;
+    // queries started through datasource::features_async(), resolved
+    // into featureset_ptr_list_ when the material is rendered
+    std::vector<query_handle> query_handles_;
+    // set when the processor draws a cached image of the layer instead
+    bool cached_image_ = false;
+    // features found in the cross render feature_cache, or the query
+    // whose features are to be stored there once read
+    feature_cache::features_ptr cached_features_;
+    boost::optional<query> cache_query_;
+    // the datasource cache_query_ is run on, the layer's or a pyramid level
+    datasource_ptr cache_ds_;
+    // index of the layer's entry in the processor's render_stats
+    std::size_t stats_index_ = static_cast<std::size_t>(-1);
+    // the queried datasource and its counters before the queries
+    datasource_ptr stats_ds_;
+    datasource_stats stats_ds_start_;
+    // with the sample budget policy, every budget_stride_-th feature is drawn
+    std::size_t budget_stride_ = 1;
+    // pixels across layer_ext2_ of a layer with aggregate="density"
+    unsigned aggregate_width_ = 0;
+    unsigned aggregate_height_ = 0;
 
     layer_rendering_material(layer const& lay, projection const& dest)
         :
         lay_(lay),
         proj0_(dest),
-        proj1_(lay.srs(),true) {}
+        proj1_(projection_cache::instance().get(lay.srs())) {}
 
     layer_rendering_material(layer_rendering_material && rhs) = default;
 };
 
+// The feature budget of a layer while its styles are rendered, from the
+// layer's maximum-* properties; the render time is shared by the styles.
+struct feature_budget
+{
+    explicit feature_budget(layer_rendering_material const& mat)
+        : max_features(mat.lay_.maximum_features()),
+          max_vertices(mat.lay_.maximum_vertices()),
+          stride(mat.budget_stride_),
+          timed(mat.lay_.maximum_render_time() > 0.0),
+          deadline(timed ? render_stats::clock::now() +
+                   std::chrono::duration_cast<render_stats::clock::duration>(
+                       std::chrono::duration<double, std::milli>(mat.lay_.maximum_render_time()))
+                   : render_stats::clock::time_point())
+    {}
+
+    // true once a style drew as many features or vertices as allowed, or
+    // the layer's time is up
+    bool exhausted(std::size_t features, std::size_t vertices) const
+    {
+        return (max_features > 0 && features >= max_features) ||
+            (max_vertices > 0 && vertices >= max_vertices) ||
+            (timed && render_stats::clock::now() >= deadline);
+    }
+
+    std::size_t max_features;
+    std::size_t max_vertices;
+    std::size_t stride;
+    bool timed;
+    render_stats::clock::time_point deadline;
+};
+
+// whether compositing a transparent image with the mode leaves the
+// destination as it is, so that a layer or style drawing nothing may be
+// skipped; modes scaling the destination by the source alpha don't
+inline bool composites_transparent_as_noop(boost::optional<composite_mode_e> const& comp_op)
+{
+    if (!comp_op) return true;
+    switch (*comp_op)
+    {
+    case src_over:
+    case dst:
+    case dst_over:
+    case dst_out:
+    case src_atop:
+    case _xor:
+    case plus:
+    case multiply:
+    case screen:
+    case overlay:
+    case darken:
+    case lighten:
+    case color_dodge:
+    case color_burn:
+    case hard_light:
+    case soft_light:
+    case difference:
+    case exclusion:
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline render_stats::layer_stats * material_stats(render_stats * stats,
+                                                  layer_rendering_material const& mat)
+{
+    if (!stats || mat.stats_index_ >= stats->layers.size()) return nullptr;
+    return &stats->layers[mat.stats_index_];
+}
+
+inline render_stats::style_stats * material_style_stats(render_stats * stats,
+                                                        layer_rendering_material const& mat,
+                                                        std::size_t i)
+{
+    render_stats::layer_stats * lstats = material_stats(stats, mat);
+    if (!lstats || i >= lstats->styles.size()) return nullptr;
+    return &lstats->styles[i];
+}
+
+// Adds the time from its construction to its destruction to a duration
+// and attributes the allocations made meanwhile to a phase, does nothing
+// without a duration.
+struct stats_timer
+{
+    stats_timer(render_stats::duration * target, alloc_phase phase)
+        : target_(target),
+          start_(target ? render_stats::clock::now() : render_stats::clock::time_point()),
+          phase_(phase, target != nullptr) {}
+
+    ~stats_timer()
+    {
+        if (target_)
+        {
+            *target_ += std::chrono::duration_cast<render_stats::duration>(render_stats::clock::now() - start_);
+        }
+    }
+
+    render_stats::duration * target_;
+    render_stats::clock::time_point start_;
+    alloc_stats::phase_scope phase_;
+};
+
+// Adds what the datasource of a layer counted since the layer was queried
+// to the layer's stats on destruction.
+struct datasource_stats_tracker
+{
+    datasource_stats_tracker(render_stats * stats, layer_rendering_material const& mat)
+        : stats_(stats),
+          mat_(mat) {}
+
+    ~datasource_stats_tracker()
+    {
+        render_stats::layer_stats * lstats = material_stats(stats_, mat_);
+        if (lstats && mat_.stats_ds_)
+        {
+            lstats->datasource += mat_.stats_ds_->stats() - mat_.stats_ds_start_;
+        }
+    }
+
+    render_stats * stats_;
+    layer_rendering_material const& mat_;
+};
+
+// Adds the allocations of the calling thread from its construction to its
+// destruction to the stats, when built with allocation counting.
+struct stats_alloc_tracker
+{
+    explicit stats_alloc_tracker(render_stats * stats)
+        : stats_(stats && alloc_stats::enabled() ? stats : nullptr),
+          start_(),
+          start_live_(0)
+    {
+        if (stats_)
+        {
+            start_ = alloc_stats::counters();
+            start_live_ = alloc_stats::live_bytes();
+            alloc_stats::reset_peak();
+        }
+    }
+
+    ~stats_alloc_tracker()
+    {
+        if (!stats_) return;
+        alloc_phase_counters end = alloc_stats::counters();
+        for (std::size_t i = 0; i < end.size(); ++i)
+        {
+            stats_->allocations[i].allocations += end[i].allocations - start_[i].allocations;
+            stats_->allocations[i].bytes += end[i].bytes - start_[i].bytes;
+        }
+        stats_->peak_bytes = std::max(stats_->peak_bytes, alloc_stats::peak_bytes() - start_live_);
+    }
+
+    render_stats * stats_;
+    alloc_phase_counters start_;
+    std::ptrdiff_t start_live_;
+};
+
+// Cancels the queries of a material tree that were not rendered, e.g.
+// when painting an earlier layer threw.
+struct query_cancel_guard
+{
+    explicit query_cancel_guard(layer_rendering_material & mat)
+        : mat_(mat) {}
+
+    ~query_cancel_guard()
+    {
+        cancel(mat_);
+    }
+
+    static void cancel(layer_rendering_material & mat)
+    {
+        for (query_handle & handle : mat.query_handles_)
+        {
+            handle.cancel();
+        }
+        mat.query_handles_.clear();
+        for (layer_rendering_material & child : mat.materials_)
+        {
+            cancel(child);
+        }
+    }
+
+    layer_rendering_material & mat_;
+};
+
 template <typename Processor>
 feature_style_processor<Processor>::feature_style_processor(Map const& m, double scale_factor)
-    : m_(m)
+    : m_(m),
+      query_threads_(1),
+      feature_arena_(false),
+      stats_(nullptr),
+      cancel_(),
+      interrupted_(false),
+      req_(m.width(), m.height(), m.get_current_extent())
 {
     // https://github.com/mapnik/mapnik/issues/1100
     if (scale_factor <= 0)
     {
         throw std::runtime_error("scale_factor must be greater than 0.0");
     }
+    req_.set_buffer_size(m.buffer_size());
+}
+
+template <typename Processor>
+feature_style_processor<Processor>::feature_style_processor(Map const& m, request const& req, double scale_factor)
+    : m_(m),
+      query_threads_(1),
+      feature_arena_(false),
+      stats_(nullptr),
+      cancel_(),
+      interrupted_(false),
+      req_(req)
+{
+    // https://github.com/mapnik/mapnik/issues/1100
+    if (scale_factor <= 0)
+    {
+        throw std::runtime_error("scale_factor must be greater than 0.0");
+    }
+}
+
+template <typename Processor>
+bool feature_style_processor<Processor>::cancelled()
+{
+    if (!interrupted_ && mapnik::cancelled(cancel_))
+    {
+        interrupted_ = true;
+    }
+    return interrupted_;
 }
 
 template <typename Processor>
@@ -94,20 +358,36 @@ void feature_style_processor<Processor>::prepare_layers(layer_rendering_material
 {
     for (layer const& lyr : layers)
     {
+        if (cancelled()) break;
         if (lyr.visible(scale_denom))
         {
             std::set<std::string> names;
             layer_rendering_material mat(lyr, parent_mat.proj0_);
 
+            // child layers render into their parent's image, so only leaves are cached
+            if (lyr.cache_image() && lyr.layers().empty() && p.prepare_cached_layer(m_, lyr))
+            {
+                mat.cached_image_ = true;
+                if (stats_)
+                {
+                    mat.stats_index_ = stats_->layers.size();
+                    stats_->layers.emplace_back();
+                    stats_->layers.back().name = lyr.name();
+                    stats_->layers.back().cached = true;
+                }
+                parent_mat.materials_.emplace_back(std::move(mat));
+                continue;
+            }
+
             prepare_layer(mat,
                           ctx_map,
                           p,
-                          m_.scale(),
+                          req_.scale(),
                           scale_denom,
-                          m_.width(),
-                          m_.height(),
-                          m_.get_current_extent(),
-                          m_.buffer_size(),
+                          req_.width(),
+                          req_.height(),
+                          req_.extent(),
+                          req_.buffer_size(),
                           names);
 
             // Store active material
@@ -124,11 +404,14 @@ template <typename Processor>
 void feature_style_processor<Processor>::apply(double scale_denom)
 {
     Processor & p = static_cast<Processor&>(*this);
+    stats_alloc_tracker alloc_tracker(stats_);
+    stats_timer total_timer(stats_ ? &stats_->total : nullptr, alloc_phase::other);
+    interrupted_ = false;
     p.start_map_processing(m_);
 
-    projection proj(m_.srs(),true);
+    projection const& proj = projection_cache::instance().get(m_.srs());
     if (scale_denom <= 0.0)
-        scale_denom = mapnik::scale_denominator(m_.scale(),proj.is_geographic());
+        scale_denom = mapnik::scale_denominator(req_.scale(),proj.is_geographic());
     scale_denom *= p.scale_factor(); // FIXME - we might want to comment this out
 
     // Asynchronous query supports:
@@ -144,6 +427,7 @@ void feature_style_processor<Processor>::apply(double scale_denom)
     if (!m_.layers().empty())
     {
         layer_rendering_material root_mat(m_.layers().front(), proj);
+        query_cancel_guard guard(root_mat);
         prepare_layers(root_mat, m_.layers(), ctx_map, p, scale_denom);
 
         render_submaterials(root_mat, p);
@@ -158,10 +442,13 @@ void feature_style_processor<Processor>::apply(mapnik::layer const& lyr,
                                                double scale_denom)
 {
     Processor & p = static_cast<Processor&>(*this);
+    stats_alloc_tracker alloc_tracker(stats_);
+    stats_timer total_timer(stats_ ? &stats_->total : nullptr, alloc_phase::other);
+    interrupted_ = false;
     p.start_map_processing(m_);
-    projection proj(m_.srs(),true);
+    projection const& proj = projection_cache::instance().get(m_.srs());
     if (scale_denom <= 0.0)
-        scale_denom = mapnik::scale_denominator(m_.scale(),proj.is_geographic());
+        scale_denom = mapnik::scale_denominator(req_.scale(),proj.is_geographic());
     scale_denom *= p.scale_factor();
 
     if (lyr.visible(scale_denom))
@@ -169,12 +456,12 @@ void feature_style_processor<Processor>::apply(mapnik::layer const& lyr,
         apply_to_layer(lyr,
                        p,
                        proj,
-                       m_.scale(),
+                       req_.scale(),
                        scale_denom,
-                       m_.width(),
-                       m_.height(),
-                       m_.get_current_extent(),
-                       m_.buffer_size(),
+                       req_.width(),
+                       req_.height(),
+                       req_.extent(),
+                       req_.buffer_size(),
                        names);
     }
     p.end_map_processing(m_);
@@ -197,6 +484,7 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay,
 {
     feature_style_context_map ctx_map;
     layer_rendering_material  mat(lay, proj0);
+    query_cancel_guard guard(mat);
 
     prepare_layer(mat,
                   ctx_map,
@@ -211,13 +499,20 @@ void feature_style_processor<Processor>::apply_to_layer(layer const& lay,
 
     prepare_layers(mat, lay.layers(), ctx_map, p, scale_denom);
 
-    if (!mat.active_styles_.empty())
+    if (!mat.active_styles_.empty() && !cancelled() && !skip_empty_material(mat, p))
     {
-        p.start_layer_processing(mat.lay_, mat.layer_ext2_);
+        render_stats::layer_stats * lstats = material_stats(stats_, mat);
+        trace::scope layer_trace("render", "layer", mat.lay_.name());
+        stats_timer render_timer(lstats ? &lstats->render : nullptr, alloc_phase::other);
+        {
+            alloc_stats::phase_scope phase(alloc_phase::compositing, lstats != nullptr);
+            p.start_layer_processing(mat.lay_, mat.layer_ext2_);
+        }
 
         render_material(mat,p);
         render_submaterials(mat, p);
 
+        stats_timer compositing_timer(lstats ? &lstats->compositing : nullptr, alloc_phase::compositing);
         p.end_layer_processing(mat.lay_);
     }
 }
@@ -255,7 +550,7 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
     }
 
     processor_context_ptr current_ctx = ds->get_context(ctx_map);
-    proj_transform prj_trans(mat.proj0_,mat.proj1_);
+    proj_transform const& prj_trans = projection_cache::instance().get(mat.proj0_.params(), mat.proj1_.params());
 
     box2d<double> query_ext = extent; // unbuffered
     box2d<double> buffered_query_ext(query_ext);  // buffered
@@ -367,8 +662,11 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
         }
     }
 
-    std::vector<rule_cache> & rule_caches = mat.rule_caches_;
-    attribute_collector collector(names);
+    std::vector<std::shared_ptr<rule_cache const>> & rule_caches = mat.rule_caches_;
+    double filter_factor = 1.0;
+    // matched by every feature the styles draw, handed to the datasource
+    expression_ptr query_filter;
+    bool filter_query = true;
 
     // iterate through all named styles collecting active styles and attribute names
     for (std::string const& style_name : style_names)
@@ -383,21 +681,23 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
             continue;
         }
 
-        std::vector<rule> const& style_rules = style->get_rules();
-        bool active_rules = false;
-        rule_cache rc;
-        for(rule const& r : style_rules)
+        // made once per band of scales in which the same rules are active
+        std::shared_ptr<rule_band const> band = style->rule_band_at(scale_denom, p.variables());
+        if (band->active)
         {
-            if (r.active(scale_denom))
+            names.insert(band->names.begin(), band->names.end());
+            if (band->filter_factor) filter_factor = *band->filter_factor;
+            if (!band->filter)
             {
-                rc.add_rule(r);
-                active_rules = true;
-                collector(r);
+                filter_query = false;
             }
-        }
-        if (active_rules)
-        {
-            rule_caches.push_back(std::move(rc));
+            else if (filter_query)
+            {
+                query_filter = query_filter
+                    ? std::make_shared<expr_node>(binary_node<tags::logical_or>(*query_filter, *band->filter))
+                    : band->filter;
+            }
+            rule_caches.emplace_back(band, &band->rules);
             active_styles.push_back(&(*style));
         }
     }
@@ -408,6 +708,44 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
         return;
     }
 
+    if (stats_)
+    {
+        mat.stats_index_ = stats_->layers.size();
+        stats_->layers.emplace_back();
+        render_stats::layer_stats & lstats = stats_->layers.back();
+        lstats.name = lay.name();
+        for (std::string const& style_name : style_names)
+        {
+            boost::optional<feature_type_style const&> style = m_.find_style(style_name);
+            if (style && std::find(active_styles.begin(), active_styles.end(), &(*style)) != active_styles.end())
+            {
+                lstats.styles.emplace_back();
+                lstats.styles.back().name = style_name;
+            }
+        }
+    }
+
+    std::string const& group_by = lay.group_by();
+    bool aggregate = lay.aggregate() == AGGREGATE_DENSITY;
+    if (aggregate)
+    {
+        // a grid cell per pixel of the rendered layer extent
+        box2d<double> map_ext = layer_ext2;
+        if (prj_trans.backward(map_ext, PROJ_ENVELOPE_POINTS) && query_ext.width() > 0 && query_ext.height() > 0)
+        {
+            mat.aggregate_width_ = static_cast<unsigned>(std::ceil(map_ext.width() * width / query_ext.width()));
+            mat.aggregate_height_ = static_cast<unsigned>(std::ceil(map_ext.height() * height / query_ext.height()));
+        }
+    }
+    // only features built on the heap may outlive this render
+    bool shared_cache = lay.cache_features() && group_by.empty() && !aggregate && !feature_arena_ &&
+        feature_cache::instance().max_features() > 0;
+    if (shared_cache)
+    {
+        layer_ext = feature_cache::quantize(layer_ext);
+        layer_ext.clip(lay.envelope());
+    }
+
     double qw = query_ext.width()>0 ? query_ext.width() : 1;
     double qh = query_ext.height()>0 ? query_ext.height() : 1;
     query::resolution_type res(width/qw,
@@ -415,6 +753,8 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
 
     query q(layer_ext,res,scale_denom,extent);
     q.set_variables(p.variables());
+    q.set_feature_arena(feature_arena_);
+    q.set_cancel_token(cancel_);
 
     if (p.attribute_collection_policy() == COLLECT_ALL)
     {
@@ -431,25 +771,91 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
             q.add_property_name(name);
         }
     }
-    q.set_filter_factor(collector.get_filter_factor());
+    q.set_filter_factor(filter_factor);
 
-    // Also query the group by attribute
-    std::string const& group_by = lay.group_by();
+    // Also query the group by attribute, and ask for the features in
+    // its order so that every group arrives in one run
     if (!group_by.empty())
     {
         q.add_property_name(group_by);
+        q.set_order_by(group_by);
+    }
+
+    if (aggregate && !lay.aggregate_weight().empty())
+    {
+        q.add_property_name(lay.aggregate_weight());
+    }
+
+    // the rules of an aggregated layer draw the aggregate, which all the
+    // features make up
+    if (filter_query && query_filter && !aggregate)
+    {
+        q.set_filter(query_filter);
+    }
+
+    bool simplify = lay.geometry_pyramid();
+    std::size_t max_features = lay.maximum_features();
+    if (max_features > 0 && lay.budget_policy() != BUDGET_STOP)
+    {
+        boost::optional<std::size_t> estimate = ds->estimate_features(q);
+        if (estimate && *estimate > max_features)
+        {
+            if (lay.budget_policy() == BUDGET_SAMPLE)
+            {
+                mat.budget_stride_ = (*estimate + max_features - 1) / max_features;
+            }
+            else
+            {
+                simplify = true;
+            }
+        }
+    }
+
+    if (simplify)
+    {
+        datasource_ptr level = geometry_pyramid::instance().level(ds, std::get<0>(res));
+        if (level) ds = level;
+    }
+
+    // keyed on the queried datasource, a pyramid level's simplified
+    // features are never served for the full detail datasource
+    if (shared_cache)
+    {
+        mat.cached_features_ = feature_cache::instance().find(ds, q);
+        if (mat.cached_features_)
+        {
+            if (render_stats::layer_stats * lstats = material_stats(stats_, mat)) lstats->cached = true;
+            return;
+        }
+        mat.cache_query_ = q;
+        mat.cache_ds_ = ds;
     }
 
     bool cache_features = lay.cache_features() && active_styles.size() > 1;
 
+    render_stats::layer_stats * lstats = material_stats(stats_, mat);
+    stats_timer query_timer(lstats ? &lstats->query : nullptr, alloc_phase::query);
+    if (lstats)
+    {
+        mat.stats_ds_ = ds;
+        mat.stats_ds_start_ = ds->stats();
+    }
+    trace::scope query_trace("render", "query", lay.name());
     std::vector<featureset_ptr> & featureset_ptr_list = mat.featureset_ptr_list_;
-    if (!group_by.empty() || cache_features)
+    std::size_t num_featuresets = (!group_by.empty() || cache_features || shared_cache || aggregate) ? 1 : active_styles.size();
+    if (query_threads_ > 1)
     {
-        featureset_ptr_list.push_back(ds->features_with_context(q,current_ctx));
+        // Start the queries right away, later layers are prepared (and
+        // earlier ones rendered) while they run.
+        query_scheduler::instance().reserve_threads(query_threads_ - 1);
+        for (std::size_t i = 0; i < num_featuresets; ++i)
+        {
+            mat.query_handles_.push_back(ds->features_async(q, current_ctx));
+        }
     }
     else
     {
-        for(std::size_t i = 0; i < active_styles.size(); ++i)
+        for (std::size_t i = 0; i < num_featuresets; ++i)
         {
             featureset_ptr_list.push_back(ds->features_with_context(q,current_ctx));
         }
@@ -457,29 +863,112 @@ void feature_style_processor<Processor>::prepare_layer(layer_rendering_material
 }
 
 template <typename Processor>
-void feature_style_processor<Processor>::render_submaterials(layer_rendering_material const & parent_mat,
+void feature_style_processor<Processor>::render_submaterials(layer_rendering_material & parent_mat,
                                                              Processor & p)
 {
-    for (layer_rendering_material const & mat : parent_mat.materials_)
+    for (layer_rendering_material & mat : parent_mat.materials_)
     {
-        if (!mat.active_styles_.empty())
+        if (cancelled()) break;
+        if (mat.cached_image_)
         {
-            p.start_layer_processing(mat.lay_, mat.layer_ext2_);
+            p.render_cached_layer(mat.lay_);
+        }
+        else if (!mat.active_styles_.empty() && !skip_empty_material(mat, p))
+        {
+            render_stats::layer_stats * lstats = material_stats(stats_, mat);
+            trace::scope layer_trace("render", "layer", mat.lay_.name());
+            stats_timer render_timer(lstats ? &lstats->render : nullptr, alloc_phase::other);
+            {
+                alloc_stats::phase_scope phase(alloc_phase::compositing, lstats != nullptr);
+                p.start_layer_processing(mat.lay_, mat.layer_ext2_);
+            }
 
             render_material(mat, p);
             render_submaterials(mat, p);
 
+            stats_timer compositing_timer(lstats ? &lstats->compositing : nullptr, alloc_phase::compositing);
             p.end_layer_processing(mat.lay_);
         }
     }
 }
 
 template <typename Processor>
-void feature_style_processor<Processor>::render_material(layer_rendering_material const & mat,
+void feature_style_processor<Processor>::wait_queries(layer_rendering_material & mat)
+{
+    if (!mat.query_handles_.empty())
+    {
+        render_stats::layer_stats * lstats = material_stats(stats_, mat);
+        stats_timer query_timer(lstats ? &lstats->query : nullptr, alloc_phase::query);
+        trace::scope query_trace("render", "wait_query", mat.lay_.name());
+        for (query_handle & handle : mat.query_handles_)
+        {
+            mat.featureset_ptr_list_.push_back(handle.get());
+        }
+        mat.query_handles_.clear();
+    }
+}
+
+template <typename Processor>
+bool feature_style_processor<Processor>::skip_empty_material(layer_rendering_material & mat,
+                                                             Processor & p)
+{
+    layer const& lay = mat.lay_;
+    // child layers, label cache clearing and cached images all need the
+    // layer processed; so do filters, which may draw on empty buffers
+    if (!p.skips_empty_layers() || !mat.materials_.empty() ||
+        lay.clear_label_cache() || lay.cache_image() ||
+        !composites_transparent_as_noop(lay.comp_op()))
+    {
+        return false;
+    }
+    for (feature_type_style const* style : mat.active_styles_)
+    {
+        if (!style->image_filters().empty() || !style->direct_image_filters().empty() ||
+            !composites_transparent_as_noop(style->comp_op()))
+        {
+            return false;
+        }
+    }
+    if (mat.cached_features_)
+    {
+        return mat.cached_features_->empty();
+    }
+    wait_queries(mat);
+    // the features read ahead are handed out again when the layer renders
+    for (featureset_ptr & features : mat.featureset_ptr_list_)
+    {
+        if (!features) continue;
+        std::shared_ptr<lookahead_featureset> lookahead = std::make_shared<lookahead_featureset>(features);
+        features = lookahead;
+        if (!lookahead->empty()) return false;
+    }
+    return true;
+}
+
+template <typename Processor>
+void feature_style_processor<Processor>::render_material(layer_rendering_material & mat,
                                                          Processor & p)
 {
+    datasource_stats_tracker ds_stats(stats_, mat);
+    wait_queries(mat);
+
+    // the budget's time starts once the layer's features are available
+    boost::optional<feature_budget> budget;
+    if (mat.lay_.has_budget()) budget.emplace(mat);
+
     std::vector<feature_type_style const*> const & active_styles = mat.active_styles_;
     std::vector<featureset_ptr> const & featureset_ptr_list = mat.featureset_ptr_list_;
+    if (mat.cached_features_)
+    {
+        proj_transform const& prj_trans = projection_cache::instance().get(mat.proj0_.params(), mat.proj1_.params());
+        std::shared_ptr<featureset_buffer> cache = std::make_shared<featureset_buffer>();
+        for (feature_ptr const& feature : *mat.cached_features_)
+        {
+            cache->push(feature);
+        }
+        render_cached_styles(mat, p, cache, prj_trans, budget.get_ptr());
+        return;
+    }
     if (featureset_ptr_list.empty())
     {
         // The datasource wasn't queried because of early return
@@ -494,26 +983,51 @@ void feature_style_processor<Processor>::render_material(layer_rendering_materia
 
     layer const& lay = mat.lay_;
 
-    std::vector<rule_cache> const & rule_caches = mat.rule_caches_;
+    std::vector<std::shared_ptr<rule_cache const>> const & rule_caches = mat.rule_caches_;
 
-    proj_transform prj_trans(mat.proj0_,mat.proj1_);
+    proj_transform const& prj_trans = projection_cache::instance().get(mat.proj0_.params(), mat.proj1_.params());
 
-    bool cache_features = lay.cache_features() && active_styles.size() > 1;
+    bool cache_features = (lay.cache_features() && active_styles.size() > 1) || mat.cache_query_;
 
     datasource_ptr ds = lay.datasource();
     std::string group_by = lay.group_by();
 
+    if (lay.aggregate() == AGGREGATE_DENSITY)
+    {
+        // The styles draw the density grid of all the features instead
+        density_aggregator aggregator(mat.layer_ext2_, mat.aggregate_width_, mat.aggregate_height_,
+                                      lay.aggregate_weight());
+        featureset_ptr features = *featureset_ptr_list.begin();
+        if (features)
+        {
+            feature_ptr feature;
+            while (!cancelled() && (feature = features->next()))
+            {
+                aggregator.add(*feature);
+            }
+        }
+        std::shared_ptr<featureset_buffer> cache = std::make_shared<featureset_buffer>();
+        cache->push(aggregator.release());
+        std::size_t i = 0;
+        for (feature_type_style const* style : active_styles)
+        {
+            cache->prepare();
+            render_style(p, style, *rule_caches[i], cache, prj_trans,
+                         material_style_stats(stats_, mat, i), nullptr);
+            ++i;
+        }
+    }
     // Render incrementally when the column that we group by changes value.
-    if (!group_by.empty())
+    else if (!group_by.empty())
     {
         featureset_ptr features = *featureset_ptr_list.begin();
         if (features)
         {
-            // Cache all features into the memory_datasource before rendering.
+            // Only the features of the current group are buffered.
             std::shared_ptr<featureset_buffer> cache = std::make_shared<featureset_buffer>();
             feature_ptr feature, prev;
 
-            while ((feature = features->next()))
+            while (!cancelled() && (feature = features->next()))
             {
                 if (prev && prev->get(group_by) != feature->get(group_by))
                 {
@@ -525,9 +1039,10 @@ void feature_style_processor<Processor>::render_material(layer_rendering_materia
 
                         cache->prepare();
                         render_style(p, style,
-                                     rule_caches[i],
+                                     *rule_caches[i],
                                      cache,
-                                     prj_trans);
+                                     prj_trans,
+                                     material_style_stats(stats_, mat, i), budget.get_ptr());
                         ++i;
                     }
                     cache->clear();
@@ -540,7 +1055,8 @@ void feature_style_processor<Processor>::render_material(layer_rendering_materia
             for (feature_type_style const* style : active_styles)
             {
                 cache->prepare();
-                render_style(p, style, rule_caches[i], cache, prj_trans);
+                render_style(p, style, *rule_caches[i], cache, prj_trans,
+                             material_style_stats(stats_, mat, i), budget.get_ptr());
                 ++i;
             }
             cache->clear();
@@ -554,21 +1070,18 @@ void feature_style_processor<Processor>::render_material(layer_rendering_materia
         {
             // Cache all features into the memory_datasource before rendering.
             feature_ptr feature;
-            while ((feature = features->next()))
+            while (!cancelled() && (feature = features->next()))
             {
-
                 cache->push(feature);
             }
         }
-        std::size_t i = 0;
-        for (feature_type_style const* style : active_styles)
+        // a read cut short by the cancel token is not the query's result
+        if (mat.cache_query_ && !cancelled())
         {
-            cache->prepare();
-            render_style(p, style,
-                         rule_caches[i],
-                         cache, prj_trans);
-            ++i;
+            feature_cache::instance().insert(mat.cache_ds_, *mat.cache_query_,
+                std::make_shared<feature_cache::features_type const>(cache->features()));
         }
+        render_cached_styles(mat, p, cache, prj_trans, budget.get_ptr());
     }
     // We only have a single style and no grouping.
     else
@@ -579,92 +1092,455 @@ void feature_style_processor<Processor>::render_material(layer_rendering_materia
         {
             featureset_ptr features = *featuresets++;
             render_style(p, style,
-                         rule_caches[i],
+                         *rule_caches[i],
                          features,
-                         prj_trans);
+                         prj_trans,
+                         material_style_stats(stats_, mat, i), budget.get_ptr());
             ++i;
         }
     }
 }
 
+template <typename Processor>
+void feature_style_processor<Processor>::render_cached_styles(layer_rendering_material & mat,
+                                                              Processor & p,
+                                                              std::shared_ptr<featureset_buffer> const& cache,
+                                                              proj_transform const& prj_trans,
+                                                              feature_budget const* budget)
+{
+    std::vector<feature_type_style const*> const& active_styles = mat.active_styles_;
+    std::size_t num_styles = active_styles.size();
+#ifdef MAPNIK_THREADSAFE
+    // the styles rendered apart are claimed in order by the worker threads,
+    // or by this thread once it gets to them, the others are rendered here
+    // in turn
+    unsigned threads = p.style_threads();
+    std::vector<std::unique_ptr<Processor>> workers(num_styles);
+    std::vector<std::size_t> apart;
+    if (threads > 1 && num_styles > 1)
+    {
+        for (std::size_t i = 0; i < num_styles; ++i)
+        {
+            if (p.renders_style_apart(*active_styles[i]))
+            {
+                workers[i] = p.make_style_worker(m_, *active_styles[i]);
+                if (workers[i]) apart.push_back(i);
+            }
+        }
+    }
+    if (!apart.empty())
+    {
+        struct job
+        {
+            std::atomic<bool> claimed{false};
+            bool done = false;
+            std::exception_ptr error;
+        };
+        std::vector<job> jobs(num_styles);
+        std::mutex mutex;
+        std::condition_variable done_cond;
+        auto run = [&](std::size_t i)
+        {
+            std::exception_ptr error;
+            try
+            {
+                render_style(*workers[i], active_styles[i], *mat.rule_caches_[i],
+                             std::make_shared<featureset_buffer_reader>(cache), prj_trans,
+                             material_style_stats(stats_, mat, i), budget);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs[i].error = error;
+            jobs[i].done = true;
+            done_cond.notify_all();
+        };
+        auto work = [&]()
+        {
+            for (std::size_t i : apart)
+            {
+                if (!jobs[i].claimed.exchange(true)) run(i);
+            }
+        };
+        // styles no executor thread gets to are rendered here
+        task_group pool;
+        auto join = [&]()
+        {
+            for (std::size_t i : apart) jobs[i].claimed = true;
+            pool.wait();
+        };
+        for (std::size_t t = 1; t < threads && t <= apart.size(); ++t)
+        {
+            pool.run(work);
+        }
+        try
+        {
+            for (std::size_t i = 0; i < num_styles; ++i)
+            {
+                feature_type_style const* style = active_styles[i];
+                if (!workers[i])
+                {
+                    cache->prepare();
+                    render_style(p, style, *mat.rule_caches_[i], cache, prj_trans,
+                                 material_style_stats(stats_, mat, i), budget);
+                    continue;
+                }
+                if (!jobs[i].claimed.exchange(true)) run(i);
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    done_cond.wait(lock, [&]() { return jobs[i].done; });
+                }
+                if (jobs[i].error) std::rethrow_exception(jobs[i].error);
+                render_stats::style_stats * stats = material_style_stats(stats_, mat, i);
+                stats_timer compositing_timer(stats ? &stats->compositing : nullptr, alloc_phase::compositing);
+                p.end_style_worker(*style, *workers[i]);
+                workers[i].reset();
+            }
+        }
+        catch (...)
+        {
+            join();
+            throw;
+        }
+        join();
+        return;
+    }
+#endif
+    for (std::size_t i = 0; i < num_styles; ++i)
+    {
+        cache->prepare();
+        render_style(p, active_styles[i], *mat.rule_caches_[i], cache, prj_trans,
+                     material_style_stats(stats_, mat, i), budget);
+    }
+}
+
 template <typename Processor>
 void feature_style_processor<Processor>::render_style(
     Processor & p,
     feature_type_style const* style,
     rule_cache const& rc,
     featureset_ptr features,
-    proj_transform const& prj_trans)
+    proj_transform const& prj_trans,
+    render_stats::style_stats * stats,
+    feature_budget const* budget)
 {
-    p.start_style_processing(*style);
+    static std::string const unnamed;
+    trace::scope style_trace("render", "style", stats ? stats->name : unnamed);
+    {
+        alloc_stats::phase_scope phase(alloc_phase::compositing, stats != nullptr);
+        p.start_style_processing(*style);
+    }
     if (!features)
     {
+        stats_timer compositing_timer(stats ? &stats->compositing : nullptr, alloc_phase::compositing);
         p.end_style_processing(*style);
         return;
     }
     mapnik::attributes vars = p.variables();
     feature_ptr feature;
     bool was_painted = false;
-    while ((feature = features->next()))
+    rule_cache::rule_ptrs const& if_rules = rc.get_if_rules();
+    rule_cache::filters const& if_filters = rc.get_if_filters();
+    rule_cache::rule_indices candidates;
+    // labels deferred to the end of the style, or handed to the processor then
+    bool defer_labels = p.defers_labels();
+    bool schedule_labels = style->schedule_labels() || defer_labels;
+    std::vector<scheduled_label> labels;
+    // symbolizer processing time per symbolizer type, named when done
+    std::vector<std::pair<symbolizer const*, render_stats::symbolizer_stats>> sym_stats;
+    rules const& style_rules = style->get_rules();
+    if (stats && stats->rules.size() < style_rules.size())
     {
-        bool do_else = true;
-        bool do_also = false;
-        for (rule const* r : rc.get_if_rules() )
+        stats->rules.resize(style_rules.size());
+        for (std::size_t i = 0; i < style_rules.size(); ++i)
         {
-            expression_ptr const& expr = r->get_filter();
-            value_type result = util::apply_visitor(evaluate<feature_impl,value_type,attributes>(*feature,vars),*expr);
-            if (result.to_bool())
+            render_stats::rule_stats & rstats = stats->rules[i];
+            rstats.name = style_rules[i].get_name();
+            rstats.symbolizers.clear();
+            for (symbolizer const& sym : style_rules[i].get_symbolizers())
             {
-                was_painted = true;
-                do_else=false;
-                do_also=true;
-                rule::symbolizers const& symbols = r->get_symbolizers();
-                if(!p.process(symbols,*feature,prj_trans))
+                rstats.symbolizers.emplace_back(symbolizer_name(sym), render_stats::symbolizer_stats());
+            }
+        }
+    }
+    // the stats of the style rule r was added to the rule cache from
+    auto stats_of_rule = [&](rule const& r) -> render_stats::rule_stats *
+    {
+        if (!stats || style_rules.empty()) return nullptr;
+        rule const* origin = &rc.origin(r);
+        if (origin < style_rules.data() || origin >= style_rules.data() + style_rules.size()) return nullptr;
+        return &stats->rules[static_cast<std::size_t>(origin - style_rules.data())];
+    };
+    render_stats::rule_stats * rstats = nullptr;
+    std::size_t feature_vertices = 0;
+    // the symbolizers of each rule the processor draws, resolved to their
+    // process functions once per style rather than visited per feature
+    using symbolizer_entries = std::vector<symbolizer_entry<Processor>>;
+    auto resolve = [&](rule const& r)
+    {
+        symbolizer_entries entries;
+        rule::symbolizers const& symbols = r.get_symbolizers();
+        for (std::size_t i = 0; i < symbols.size(); ++i)
+        {
+            if (p.draws_symbolizer(symbols[i])) entries.emplace_back(symbols[i], i);
+        }
+        return entries;
+    };
+    auto resolve_all = [&](rule_cache::rule_ptrs const& rules)
+    {
+        std::vector<symbolizer_entries> result;
+        result.reserve(rules.size());
+        for (rule const* r : rules) result.push_back(resolve(*r));
+        return result;
+    };
+    std::vector<symbolizer_entries> const if_entries = resolve_all(if_rules);
+    std::vector<symbolizer_entries> const else_entries = resolve_all(rc.get_else_rules());
+    std::vector<symbolizer_entries> const also_entries = resolve_all(rc.get_also_rules());
+    auto dispatch = [&](symbolizer_entry<Processor> const& sym_entry)
+    {
+        if (!stats)
+        {
+            sym_entry(p, *feature, prj_trans);
+            return;
+        }
+        std::size_t index = static_cast<std::size_t>(sym_entry.sym->which());
+        if (index >= sym_stats.size()) sym_stats.resize(index + 1);
+        auto & entry = sym_stats[index];
+        entry.first = sym_entry.sym;
+        ++entry.second.count;
+        render_stats::duration before = entry.second.time;
+        {
+            stats_timer timer(&entry.second.time, alloc_phase::symbolizers);
+            sym_entry(p, *feature, prj_trans);
+        }
+        if (rstats && sym_entry.position < rstats->symbolizers.size())
+        {
+            render_stats::symbolizer_stats & sstats = rstats->symbolizers[sym_entry.position].second;
+            render_stats::duration elapsed = entry.second.time - before;
+            ++sstats.count;
+            sstats.time += elapsed;
+            rstats->time += elapsed;
+        }
+    };
+    auto process_symbolizers = [&](rule const& r, symbolizer_entries const& entries)
+    {
+        rstats = stats_of_rule(r);
+        if (rstats)
+        {
+            ++rstats->features;
+            rstats->vertices += feature_vertices;
+        }
+        if (schedule_labels)
+        {
+            double priority = 0.0;
+            bool evaluated = false;
+            for (auto const& sym_entry : entries)
+            {
+                symbolizer const& sym = *sym_entry.sym;
+                if (sym.is<text_symbolizer>() || sym.is<shield_symbolizer>())
                 {
-                    for (symbolizer const& sym : symbols)
+                    if (!evaluated && style->label_priority())
                     {
-                        util::apply_visitor(symbolizer_dispatch<Processor>(p,*feature,prj_trans),sym);
+                        priority = util::apply_visitor(evaluate<feature_impl, value_type, attributes>(*feature, vars),
+                                                       *style->label_priority()).to_double();
+                        evaluated = true;
                     }
+                    labels.push_back(scheduled_label{priority, feature, &sym});
                 }
-                if (style->get_filter_mode() == FILTER_FIRST)
+                else
                 {
-                    // Stop iterating over rules and proceed with next feature.
-                    do_also=false;
-                    break;
+                    dispatch(sym_entry);
                 }
             }
         }
-        if (do_else)
+        else if (!p.process(r.get_symbolizers(),*feature,prj_trans))
         {
-            for( rule const* r : rc.get_else_rules() )
+            for (auto const& sym_entry : entries)
             {
-                was_painted = true;
-                rule::symbolizers const& symbols = r->get_symbolizers();
-                if(!p.process(symbols,*feature,prj_trans))
+                dispatch(sym_entry);
+            }
+        }
+    };
+    // Features are pulled in batches and the filters of the if rules are
+    // evaluated one rule at a time over a batch, the symbolizers are then
+    // processed per feature in the original order. Exclusive rules are
+    // tried most often matched first and a feature is done with them once
+    // one matches; the number of matches is counted for that.
+    bool filter_first = style->get_filter_mode() == FILTER_FIRST;
+    bool stop_at_match = filter_first || rc.exclusive();
+    std::size_t num_rules = if_rules.size();
+    rule_cache::rule_indices order;
+    std::vector<std::size_t> rule_matches(num_rules, 0);
+    // the filters are shared with concurrent renders, what evaluating
+    // them works in is this render's
+    std::vector<compiled_expression::scratch> filter_scratch(num_rules);
+    feature_batch batch;
+    batch.reserve(feature_batch_size);
+    // 1 for the if rules matching each feature, feature major
+    std::vector<std::uint8_t> matches;
+    std::vector<std::uint8_t> matched;
+    // vertices of each feature, counted with stats
+    std::vector<std::size_t> vertices;
+    std::size_t size;
+    // features read, and features and vertices drawn within the budget
+    std::size_t read = 0;
+    std::size_t drawn = 0;
+    std::size_t drawn_vertices = 0;
+    bool over_budget = false;
+    auto next_batch = [&]()
+    {
+        stats_timer timer(stats ? &stats->fetch : nullptr, alloc_phase::fetch);
+        trace::scope fetch_trace("render", "fetch");
+        return features->next_batch(batch, feature_batch_size);
+    };
+    while (!cancelled() && (size = next_batch()) > 0)
+    {
+        if (stats)
+        {
+            stats->features += size;
+            vertices.resize(size);
+            for (std::size_t f = 0; f < size; ++f)
+            {
+                vertices[f] = render_stats::vertex_count(static_cast<feature_impl const&>(*batch[f]).get_geometry());
+                stats->vertices += vertices[f];
+            }
+        }
+        boost::optional<stats_timer> filter_timer;
+        if (stats) filter_timer.emplace(&stats->filter, alloc_phase::filter);
+        matches.assign(size * num_rules, 0);
+        matched.assign(size, 0);
+        for (std::size_t f = 0; f < size; ++f)
+        {
+            std::uint8_t * row = matches.data() + f * num_rules;
+            if (rc.select_if_rules(*batch[f], candidates))
+            {
+                for (std::size_t i : candidates) row[i] = 1;
+            }
+            else
+            {
+                std::fill(row, row + num_rules, 1);
+            }
+        }
+        rc.evaluation_order(order);
+        for (std::size_t i : order)
+        {
+            for (std::size_t f = 0; f < size; ++f)
+            {
+                std::uint8_t & match = matches[f * num_rules + i];
+                if (!match) continue;
+                if (stop_at_match && matched[f])
                 {
-                    for (symbolizer const& sym : symbols)
-                    {
-                        util::apply_visitor(symbolizer_dispatch<Processor>(p,*feature,prj_trans),sym);
-                    }
+                    // only the first matching rule is rendered, or no
+                    // other one can match
+                    match = 0;
+                    continue;
                 }
+                match = if_filters[i].evaluate(*batch[f], vars, filter_scratch[i]).to_bool() ? 1 : 0;
+                matched[f] |= match;
+                rule_matches[i] += match;
             }
         }
-        if (do_also)
+        rc.record_matches(rule_matches);
+        std::fill(rule_matches.begin(), rule_matches.end(), 0);
+        filter_timer = boost::none;
+        for (std::size_t f = 0; f < size; ++f)
         {
-            for( rule const* r : rc.get_also_rules() )
+            if (cancelled()) break;
+            if (budget)
             {
-                was_painted = true;
-                rule::symbolizers const& symbols = r->get_symbolizers();
-                if(!p.process(symbols,*feature,prj_trans))
+                if (read++ % budget->stride != 0) continue;
+                if (budget->exhausted(drawn, drawn_vertices))
                 {
-                    for (symbolizer const& sym : symbols)
-                    {
-                        util::apply_visitor(symbolizer_dispatch<Processor>(p,*feature,prj_trans),sym);
-                    }
+                    over_budget = true;
+                    break;
+                }
+                ++drawn;
+                if (budget->max_vertices > 0)
+                {
+                    drawn_vertices += render_stats::vertex_count(static_cast<feature_impl const&>(*batch[f]).get_geometry());
+                }
+            }
+            feature = batch[f];
+            if (stats) feature_vertices = vertices[f];
+            p.start_feature(feature);
+            std::uint8_t const* row = matches.data() + f * num_rules;
+            for (std::size_t i = 0; i < num_rules; ++i)
+            {
+                if (row[i])
+                {
+                    was_painted = true;
+                    process_symbolizers(*if_rules[i], if_entries[i]);
+                }
+            }
+            if (!matched[f])
+            {
+                for (std::size_t i = 0; i < else_entries.size(); ++i)
+                {
+                    was_painted = true;
+                    process_symbolizers(*rc.get_else_rules()[i], else_entries[i]);
+                }
+            }
+            else if (!filter_first)
+            {
+                for (std::size_t i = 0; i < also_entries.size(); ++i)
+                {
+                    was_painted = true;
+                    process_symbolizers(*rc.get_also_rules()[i], also_entries[i]);
                 }
             }
         }
+        batch.clear();
+        if (over_budget || size < feature_batch_size) break;
+    }
+    if (over_budget)
+    {
+        MAPNIK_LOG_DEBUG(feature_style_processor)
+            << "feature_style_processor: Feature budget exceeded, drew " << drawn << " features";
+        if (stats) stats->over_budget = true;
+    }
+    feature.reset();
+    if (!labels.empty())
+    {
+        stats_timer labels_timer(stats ? &stats->labels : nullptr, alloc_phase::labels);
+        trace::scope labels_trace("render", "labels");
+        // highest priority first, ties keep the feature order
+        if (style->label_priority())
+        {
+            std::stable_sort(labels.begin(), labels.end(),
+                             [](scheduled_label const& lhs, scheduled_label const& rhs)
+                             { return lhs.priority > rhs.priority; });
+        }
+        double max_coverage = style->label_coverage();
+        if (defer_labels)
+        {
+            p.defer_labels(labels, prj_trans, max_coverage);
+        }
+        else
+        {
+            for (scheduled_label const& label : labels)
+            {
+                // once the tile is saturated the remaining labels can't fit
+                // anyway, skip their shaping and placement
+                if (max_coverage < 1.0 && p.label_coverage() >= max_coverage) break;
+                if (cancelled()) break;
+                symbolizer_entry<Processor>(*label.sym)(p, *label.feature, prj_trans);
+            }
+        }
     }
     p.painted(p.painted() | was_painted);
+    if (stats)
+    {
+        for (auto const& entry : sym_stats)
+        {
+            if (!entry.first) continue;
+            render_stats::symbolizer_stats & total = stats->symbolizers[symbolizer_name(*entry.first)];
+            total.time += entry.second.time;
+            total.count += entry.second.count;
+        }
+    }
+    stats_timer compositing_timer(stats ? &stats->compositing : nullptr, alloc_phase::compositing);
     p.end_style_processing(*style);
 }
 
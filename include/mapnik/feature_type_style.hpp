@@ -28,6 +28,8 @@
 #include <mapnik/enumeration.hpp>
 #include <mapnik/image_filter_types.hpp>
 #include <mapnik/image_compositing.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/attribute.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -37,11 +39,14 @@
 // stl
 #include <vector>
 #include <cstddef>
+#include <memory>
 
 namespace mapnik
 {
 
 class rule;
+struct rule_band;
+class rule_bands;
 
 enum filter_mode_enum {
     FILTER_ALL,
@@ -65,6 +70,11 @@ private:
     boost::optional<composite_mode_e> comp_op_;
     float opacity_;
     bool image_filters_inflate_;
+    // label scheduling
+    expression_ptr label_priority_;
+    double label_coverage_;
+    // made from rules_ and label_priority_, dropped when they change
+    std::unique_ptr<rule_bands> bands_;
     friend void swap(feature_type_style& lhs, feature_type_style & rhs);
 public:
     // ctor
@@ -78,10 +88,18 @@ public:
 
     void add_rule(rule && rule);
     rules const& get_rules() const;
+    // Drops the rule bands made so far. Edit the rules before the next
+    // render and call again for later edits: a band made after the call
+    // does not see rules changed in place through the old reference.
     rules& get_rules_nonconst();
 
     bool active(double scale_denom) const;
 
+    // The rules active at scale_denom in a rule_cache, with the attributes
+    // they read, shared by the renders within the same band of scales and
+    // variables. Renders changing the rules meanwhile must not overlap.
+    std::shared_ptr<rule_band const> rule_band_at(double scale_denom, attributes const& vars) const;
+
     void set_filter_mode(filter_mode_e mode);
     filter_mode_e get_filter_mode() const;
 
@@ -97,12 +115,19 @@ public:
     float get_opacity() const;
     void set_image_filters_inflate(bool inflate);
     bool image_filters_inflate() const;
-    inline void reserve(std::size_t size)
-    {
-        rules_.reserve(size);
-    }
-
-    ~feature_type_style() {}
+    // text and shield symbolizers are placed after the other symbolizers
+    // of the style, highest priority first
+    void set_label_priority(expression_ptr const& priority);
+    expression_ptr const& label_priority() const;
+    // labels are skipped once this fraction of the collision detector
+    // extent is covered, 1.0 never skips; clamped to [0, 1], NaN being 1
+    void set_label_coverage(double coverage);
+    double label_coverage() const;
+    // true if labels are deferred to the end of the style
+    bool schedule_labels() const;
+    void reserve(std::size_t size);
+
+    ~feature_type_style();
 
 };
 }
@@ -27,17 +27,35 @@
 #include <mapnik/config.hpp>
 #include <mapnik/util/noncopyable.hpp>
 
-// boost
+// stl
+#include <cstddef>
 #include <memory>
+#include <vector>
 
 namespace mapnik {
 
 class feature_impl;
 using feature_ptr = std::shared_ptr<feature_impl>;
+using feature_batch = std::vector<feature_ptr>;
 
 struct MAPNIK_DECL Featureset : private util::noncopyable
 {
     virtual feature_ptr next() = 0;
+
+    // Appends up to max_size features to batch and returns how many were
+    // added, fewer than max_size once the featureset is exhausted.
+    virtual std::size_t next_batch(feature_batch & batch, std::size_t max_size)
+    {
+        std::size_t count = 0;
+        for (; count < max_size; ++count)
+        {
+            feature_ptr feature = next();
+            if (!feature) break;
+            batch.push_back(std::move(feature));
+        }
+        return count;
+    }
+
     virtual ~Featureset() {}
 };
 
@@ -62,6 +80,40 @@ inline bool is_valid(featureset_ptr const& ptr)
     return (dynamic_cast<invalid_featureset*>(ptr.get()) == nullptr) ? true : false;
 }
 
+// Reads the first feature of a featureset ahead, to tell whether it is
+// empty before anything is drawn, and hands it out again first.
+struct MAPNIK_DECL lookahead_featureset final : Featureset
+{
+    explicit lookahead_featureset(featureset_ptr const& features)
+        : features_(features),
+          first_(features ? features->next() : feature_ptr()) {}
+
+    bool empty() const
+    {
+        return !first_;
+    }
+
+    feature_ptr next()
+    {
+        if (first_) return std::move(first_);
+        return features_ ? features_->next() : feature_ptr();
+    }
+
+    std::size_t next_batch(feature_batch & batch, std::size_t max_size)
+    {
+        if (!first_) return features_ ? features_->next_batch(batch, max_size) : 0;
+        if (max_size == 0) return 0;
+        batch.push_back(std::move(first_));
+        return features_->next_batch(batch, max_size - 1) + 1;
+    }
+
+    ~lookahead_featureset() {}
+
+private:
+    featureset_ptr features_;
+    feature_ptr first_;
+};
+
 }
 
 #endif // MAPNIK_FEATURESET_HPP
@@ -31,8 +31,14 @@
 #include <mapnik/text/font_library.hpp>
 
 // stl
+#include <cstdint>
+#include <ctime>
 #include <memory>
 #include <map>
+#ifdef MAPNIK_THREADSAFE
+#include <mutex>
+#endif
+#include <string>
 #include <utility> // pair
 #include <vector>
 
@@ -63,6 +69,17 @@ public:
     static std::vector<std::string> face_names();
     static font_file_mapping_type const& get_mapping();
     static font_memory_cache_type & get_cache();
+    // Persistent catalog of the faces found in font files, so registering
+    // an unchanged file (same size and modification time) doesn't open it.
+    // The catalog is read here and rewritten after registrations that
+    // changed it. An empty name disables the catalog.
+    static void set_font_catalog(std::string const& file_name);
+    // create a face for the given face index of a font file, loading
+    // the file into global_memory_fonts unless it can be memory mapped
+    static face_ptr create_file_face(std::string const& file_name,
+                                     int face_index,
+                                     font_library & library,
+                                     font_memory_cache_type & global_memory_fonts);
     static bool can_open(std::string const& face_name,
                          font_library & library,
                          font_file_mapping_type const& font_file_mapping,
@@ -75,6 +92,15 @@ public:
                                 font_file_mapping_type const& global_font_file_mapping,
                                 freetype_engine::font_memory_cache_type & global_memory_fonts);
 private:
+    using font_faces_type = std::vector<std::pair<int, std::string>>;
+    struct font_catalog_entry
+    {
+        std::time_t mtime;
+        std::uintmax_t size;
+        font_faces_type faces;
+    };
+    using font_catalog_type = std::map<std::string, font_catalog_entry>;
+
     bool is_font_file_impl(std::string const& file_name);
     std::vector<std::string> face_names_impl();
     font_file_mapping_type const& get_mapping_impl();
@@ -101,8 +127,26 @@ private:
                              font_library & libary,
                              font_file_mapping_type & font_file_mapping,
                              bool recurse = false);
+    face_ptr create_file_face_impl(std::string const& file_name,
+                                   int face_index,
+                                   font_library & library,
+                                   freetype_engine::font_memory_cache_type & global_memory_fonts);
+    char const* node_font_data(std::string const& file_name, char const* data, std::size_t size);
+    void set_font_catalog_impl(std::string const& file_name);
+    bool cached_font_faces(std::string const& file_name, font_faces_type & faces);
+    void cache_font_faces(std::string const& file_name, font_faces_type const& faces);
+    void save_font_catalog();
     font_file_mapping_type global_font_file_mapping_;
     font_memory_cache_type global_memory_fonts_;
+    // copies of font data per NUMA node, see node_font_data
+    std::vector<font_memory_cache_type> node_memory_fonts_;
+    std::string catalog_file_;
+    font_catalog_type catalog_;
+    bool catalog_dirty_ = false;
+#ifdef MAPNIK_THREADSAFE
+    // Map::register_fonts doesn't take the engine lock
+    std::mutex catalog_mutex_;
+#endif
 };
 
 class MAPNIK_DECL face_manager
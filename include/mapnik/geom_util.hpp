@@ -29,6 +29,8 @@
 #include <mapnik/vertex.hpp>
 #include <mapnik/geometry/geometry_types.hpp>
 #include <mapnik/geometry/point.hpp>
+#include <mapnik/geometry/polygon.hpp>
+#include <mapnik/geometry/interior.hpp>
 
 // stl
 #include <cmath>
@@ -239,6 +241,35 @@ struct at_point_filter
 
 using filter_at_point = at_point_filter<double>;
 
+// Passes extents intersecting any of several boxes, for a batch of point
+// queries run as one. box_ is their union, for indexes able to test a
+// single box only.
+template <typename T>
+struct any_box_filter
+{
+    using value_type = T;
+    box2d<value_type> box_;
+    std::vector<box2d<value_type>> boxes_;
+
+    explicit any_box_filter(std::vector<box2d<value_type>> const& boxes)
+        : box_(),
+          boxes_(boxes)
+    {
+        for (auto const& box : boxes_)
+        {
+            if (box_.valid()) box_.expand_to_include(box);
+            else box_ = box;
+        }
+    }
+
+    bool pass(box2d<value_type> const& extent) const
+    {
+        if (!extent.intersects(box_)) return false;
+        return std::any_of(boxes_.begin(), boxes_.end(),
+                           [&extent](box2d<value_type> const& box) { return extent.intersects(box); });
+    }
+};
+
 ////////////////////////////////////////////////////////////////////////////
 template <typename PathType>
 double path_length(PathType & path)
@@ -537,77 +568,36 @@ bool hit_test(PathType & path, double x, double y, double tol)
     return inside;
 }
 
+// Pole of inaccessibility of a polygon path, see geometry::interior. The
+// precision is in path units and defaults to a pixel for paths already
+// transformed to the map.
 template <typename PathType>
-bool interior_position(PathType & path, double & x, double & y)
+bool interior_position(PathType & path, double & x, double & y, double precision = 1.0)
 {
-    // start with the centroid
-    if (!label::centroid(path, x,y))
-        return false;
-
-    // otherwise we find a horizontal line across the polygon and then return the
-    // center of the widest intersection between the polygon and the line.
-
-    std::vector<double> intersections; // only need to store the X as we know the y
-    geometry::point<double> p0, p1, move_to;
+    geometry::polygon<double> poly;
+    geometry::point<double> pt;
     unsigned command = SEG_END;
 
     path.rewind(0);
 
-    while (SEG_END != (command = path.vertex(&p0.x, &p0.y)))
+    while (SEG_END != (command = path.vertex(&pt.x, &pt.y)))
     {
         switch (command)
         {
             case SEG_MOVETO:
-                move_to = p0;
+                poly.emplace_back();
+                poly.back().push_back(pt);
                 break;
-            case SEG_CLOSE:
-                p0 = move_to;
             case SEG_LINETO:
-                // if the segments overlap
-                if (p0.y == p1.y)
-                {
-                    if (p0.y == y)
-                    {
-                        double xi = (p0.x + p1.x) / 2.0;
-                        intersections.push_back(xi);
-                    }
-                }
-                // if the path segment crosses the bisector
-                else if ((p0.y <= y && p1.y >= y) ||
-                         (p0.y >= y && p1.y <= y))
-                {
-                    // then calculate the intersection
-                    double xi = p0.x;
-                    if (p0.x != p1.x)
-                    {
-                        double m = (p1.y - p0.y) / (p1.x - p0.x);
-                        double c = p0.y - m * p0.x;
-                        xi = (y - c) / m;
-                    }
-
-                    intersections.push_back(xi);
-                }
+                if (!poly.empty()) poly.back().push_back(pt);
                 break;
         }
-        p1 = p0;
     }
 
-    // no intersections we just return the default
-    if (intersections.empty())
-        return true;
-    std::sort(intersections.begin(), intersections.end());
-    double max_width = 0;
-    for (unsigned ii = 1; ii < intersections.size(); ii += 2)
-    {
-        double xlow = intersections[ii-1];
-        double xhigh = intersections[ii];
-        double width = xhigh - xlow;
-        if (width > max_width)
-        {
-            x = (xlow + xhigh) / 2.0;
-            max_width = width;
-        }
-    }
+    if (!geometry::interior(poly, precision, pt))
+        return false;
+    x = pt.x;
+    y = pt.y;
     return true;
 }
 
@@ -0,0 +1,42 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_GEOMETRY_INTERIOR_HPP
+#define MAPNIK_GEOMETRY_INTERIOR_HPP
+
+#include <mapnik/config.hpp>
+#include <mapnik/geometry/point.hpp>
+#include <mapnik/geometry/polygon.hpp>
+
+namespace mapnik { namespace geometry {
+
+// Pole of inaccessibility of a polygon: the interior point farthest from
+// its outline, found to within precision (in polygon units) by refining a
+// priority queue of grid cells. Non positive precisions use 1% of the
+// polygon size. Returns false for polygons without an exterior ring.
+template <typename T>
+MAPNIK_DECL bool interior(polygon<T> const& polygon, double precision, point<T> & pt);
+
+}}
+
+#endif // MAPNIK_GEOMETRY_INTERIOR_HPP
@@ -82,16 +82,13 @@ polygon<T> reproject_internal(polygon<T> const& poly, proj_transform const& proj
 template <typename T>
 multi_point<T> reproject_internal(multi_point<T> const & mp, proj_transform const& proj_trans, unsigned int & n_err)
 {
-    multi_point<T> new_mp;
-    if (proj_trans.is_known())
-    {
-        // If the projection is known we do them all at once because it is faster
-        // since we know that no point will fail reprojection
-        new_mp.assign(mp.begin(), mp.end());
-        proj_trans.forward(new_mp);
-    }
-    else
+    multi_point<T> new_mp(mp.begin(), mp.end());
+    // All points are done at once because it is faster, only when some of
+    // them fail are they redone one by one to drop those. Points never
+    // fail a known projection.
+    if (proj_trans.forward(new_mp) > 0)
     {
+        new_mp.clear();
         new_mp.reserve(mp.size());
         for (auto const& p : mp)
         {
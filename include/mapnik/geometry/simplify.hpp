@@ -0,0 +1,149 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_GEOMETRY_SIMPLIFY_HPP
+#define MAPNIK_GEOMETRY_SIMPLIFY_HPP
+
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry/boost_adapters.hpp>
+#include <mapnik/util/variant.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/geometry/algorithms/simplify.hpp>
+#pragma GCC diagnostic pop
+
+namespace mapnik { namespace geometry {
+
+namespace detail {
+
+// Douglas-Peucker simplification of lines and rings, points are kept as
+// they are. A ring that would collapse is kept unsimplified instead, so
+// small polygons don't disappear.
+template <typename T>
+struct geometry_simplify
+{
+    using result_type = geometry<T>;
+
+    explicit geometry_simplify(double tolerance)
+        : tolerance_(tolerance) {}
+
+    result_type operator() (geometry<T> const& geom) const
+    {
+        return mapnik::util::apply_visitor(*this, geom);
+    }
+
+    result_type operator() (geometry_empty const& empty) const
+    {
+        return empty;
+    }
+
+    result_type operator() (point<T> const& pt) const
+    {
+        return pt;
+    }
+
+    result_type operator() (multi_point<T> const& multi_pt) const
+    {
+        return multi_pt;
+    }
+
+    result_type operator() (line_string<T> const& line) const
+    {
+        return simplify_line(line);
+    }
+
+    result_type operator() (multi_line_string<T> const& multi_line) const
+    {
+        multi_line_string<T> result;
+        result.reserve(multi_line.size());
+        for (auto const& line : multi_line)
+        {
+            result.push_back(simplify_line(line));
+        }
+        return result;
+    }
+
+    result_type operator() (polygon<T> const& poly) const
+    {
+        return simplify_polygon(poly);
+    }
+
+    result_type operator() (multi_polygon<T> const& multi_poly) const
+    {
+        multi_polygon<T> result;
+        result.reserve(multi_poly.size());
+        for (auto const& poly : multi_poly)
+        {
+            result.push_back(simplify_polygon(poly));
+        }
+        return result;
+    }
+
+    result_type operator() (geometry_collection<T> const& collection) const
+    {
+        geometry_collection<T> result;
+        result.reserve(collection.size());
+        for (auto const& geom : collection)
+        {
+            result.push_back((*this)(geom));
+        }
+        return result;
+    }
+
+private:
+    line_string<T> simplify_line(line_string<T> const& line) const
+    {
+        if (line.size() <= 2) return line;
+        line_string<T> result;
+        boost::geometry::simplify(line, result, tolerance_);
+        return result;
+    }
+
+    polygon<T> simplify_polygon(polygon<T> const& poly) const
+    {
+        polygon<T> result;
+        result.reserve(poly.size());
+        for (auto const& ring : poly)
+        {
+            linear_ring<T> simplified;
+            if (ring.size() > 4) boost::geometry::simplify(ring, simplified, tolerance_);
+            result.push_back(simplified.size() < 4 ? ring : std::move(simplified));
+        }
+        return result;
+    }
+
+    double tolerance_;
+};
+
+}
+
+template <typename T>
+inline geometry<T> simplify(geometry<T> const& geom, double tolerance)
+{
+    return detail::geometry_simplify<T>(tolerance)(geom);
+}
+
+}}
+
+#endif // MAPNIK_GEOMETRY_SIMPLIFY_HPP
@@ -0,0 +1,85 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_GEOMETRY_PYRAMID_HPP
+#define MAPNIK_GEOMETRY_PYRAMID_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cstddef>
+#include <map>
+#include <memory>
+
+namespace mapnik
+{
+
+class datasource;
+
+// Process wide cache of simplified copies of file based vector datasources
+// (shape, geojson, csv, geobuf, topojson) for layers with geometry-pyramid
+// enabled. Level n holds every feature of the datasource simplified with a
+// tolerance of 2^n map units, and is built by the first query whose pixels
+// are at least twice that size; levels finer than max_pixels() cells across
+// the datasource envelope are never built, those queries use the
+// datasource itself.
+class MAPNIK_DECL geometry_pyramid :
+        public singleton<geometry_pyramid, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<geometry_pyramid>;
+public:
+    void set_max_pixels(double max_pixels);
+    double max_pixels() const;
+
+    // The level of ds matching a query resolution (pixels per map unit),
+    // or a null pointer when ds should be queried directly.
+    std::shared_ptr<datasource> level(std::shared_ptr<datasource> const& ds, double resolution);
+    std::size_t size() const;
+    void clear();
+
+    static bool supported(datasource const& ds);
+
+private:
+    geometry_pyramid();
+
+    struct entry
+    {
+        std::weak_ptr<datasource> ds;
+        std::map<int, std::shared_ptr<datasource>> levels;
+    };
+
+    static std::shared_ptr<datasource> build(datasource const& ds, double tolerance);
+
+    std::map<datasource const*, entry> entries_;
+    double max_pixels_;
+};
+
+extern template class MAPNIK_DECL singleton<geometry_pyramid, CreateStatic>;
+
+}
+
+#endif // MAPNIK_GEOMETRY_PYRAMID_HPP
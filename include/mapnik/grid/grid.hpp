@@ -58,6 +58,7 @@ public:
     static const value_type base_mask;
 
 private:
+    unsigned resolution_;
     std::size_t width_;
     std::size_t height_;
     std::string key_;
@@ -71,7 +72,15 @@ private:
 
 public:
 
-    hit_grid(std::size_t width, std::size_t height, std::string const& key);
+    /*!
+     * \brief a grid of the features rendered into a width x height area
+     *
+     * With a resolution above 1 only every resolution-th pixel of every
+     * resolution-th row is kept, as UTFGrid encoding samples them, the data
+     * then being (width / resolution) x (height / resolution) rounded up.
+     * Renderers write the sampled pixels directly, no full size grid is kept.
+     */
+    hit_grid(std::size_t width, std::size_t height, std::string const& key, unsigned resolution = 1);
 
     hit_grid(hit_grid<T> const& rhs);
 
@@ -89,6 +98,12 @@ public:
         return painted_;
     }
 
+    // pixels of the rendered area per grid cell, along both axes
+    inline unsigned resolution() const
+    {
+        return resolution_;
+    }
+
     inline std::string const& key_name() const
     {
         return id_name_;
@@ -167,13 +182,16 @@ private:
     hit_grid& operator=(const hit_grid&);
 
 public:
+    // x and y are in rendered pixels, those off the sampled ones are dropped
     inline void setPixel(std::size_t x, std::size_t y, value_type feature_id)
     {
-        if (checkBounds(x, y))
+        if (x % resolution_ == 0 && y % resolution_ == 0 &&
+            checkBounds(x / resolution_, y / resolution_))
         {
-            data_(x, y) = feature_id;
+            data_(x / resolution_, y / resolution_) = feature_id;
         }
     }
+    // size of the grid data, in cells
     inline std::size_t width() const
     {
         return width_;
@@ -186,24 +204,26 @@ public:
 
     inline void set_rectangle(value_type id, image_rgba8 const& data, std::size_t x0, std::size_t y0)
     {
-        box2d<int> ext0(0, 0, width_, height_);
+        int res = static_cast<int>(resolution_);
+        box2d<int> ext0(0, 0, width_ * res, height_ * res);
         box2d<int> ext1(x0, y0, x0 + data.width(), y0 + data.height());
 
         if (ext0.intersects(ext1))
         {
             box2d<int> box = ext0.intersect(ext1);
-            std::size_t miny = safe_cast<std::size_t>(box.miny());
-            std::size_t maxy = safe_cast<std::size_t>(box.maxy());
-            std::size_t minx = safe_cast<std::size_t>(box.minx());
-            std::size_t maxx = safe_cast<std::size_t>(box.maxx());
+            // first and past the last sampled pixel of the box, in cells
+            std::size_t miny = safe_cast<std::size_t>((box.miny() + res - 1) / res);
+            std::size_t maxy = safe_cast<std::size_t>((box.maxy() + res - 1) / res);
+            std::size_t minx = safe_cast<std::size_t>((box.minx() + res - 1) / res);
+            std::size_t maxx = safe_cast<std::size_t>((box.maxx() + res - 1) / res);
             for (std::size_t y = miny; y < maxy; ++y)
             {
                 value_type* row_to =  data_.get_row(y);
-                image_rgba8::pixel_type const * row_from = data.get_row(y - y0);
+                image_rgba8::pixel_type const * row_from = data.get_row(y * res - y0);
 
                 for (std::size_t x = minx; x < maxx; ++x)
                 {
-                    image_rgba8::pixel_type rgba = row_from[x - x0];
+                    image_rgba8::pixel_type rgba = row_from[x * res - x0];
                     unsigned a = (rgba >> 24) & 0xff;
                     // if the pixel is more than a tenth
                     // opaque then burn in the feature id
@@ -643,6 +643,108 @@ private:
     rbuf_type* m_rbuf;
 };
 
+//=======================================================pixfmt_sampled_gray
+// Pixel format writing feature ids into a grid_sampled_buffer, binary like
+// the one above: colors are copied and covers ignored.
+template<typename ColorT>
+class pixfmt_sampled_gray
+{
+public:
+    using rbuf_type = mapnik::grid_sampled_buffer;
+    using color_type = ColorT;
+    using order_type = int; // A fake one
+    using value_type = typename color_type::value_type;
+    enum base_scale_e
+    {
+        base_shift = color_type::base_shift,
+        base_scale = color_type::base_scale,
+        base_mask  = color_type::base_mask,
+        pix_width  = sizeof(value_type)
+    };
+
+    explicit pixfmt_sampled_gray(rbuf_type& rb) :
+        m_rbuf(&rb)
+    {}
+    void attach(rbuf_type& rb) { m_rbuf = &rb; }
+
+    AGG_INLINE unsigned width()  const { return m_rbuf->width();  }
+    AGG_INLINE unsigned height() const { return m_rbuf->height(); }
+
+    AGG_INLINE color_type pixel(int x, int y) const
+    {
+        value_type const* p = m_rbuf->sample(x, y);
+        return p ? color_type(*p) : color_type::no_color();
+    }
+
+    AGG_INLINE void copy_pixel(int x, int y, const color_type& c)
+    {
+        value_type* p = m_rbuf->sample(x, y);
+        if (p) *p = c.v;
+    }
+
+    AGG_INLINE void blend_pixel(int x, int y, const color_type& c, agg::int8u /*cover*/)
+    {
+        copy_pixel(x, y, c);
+    }
+
+    AGG_INLINE void copy_hline(int x, int y, unsigned len, const color_type& c)
+    {
+        m_rbuf->fill_hline(x, y, len, c.v);
+    }
+
+    AGG_INLINE void copy_vline(int x, int y, unsigned len, const color_type& c)
+    {
+        m_rbuf->fill_vline(x, y, len, c.v);
+    }
+
+    void blend_hline(int x, int y, unsigned len, const color_type& c, agg::int8u /*cover*/)
+    {
+        m_rbuf->fill_hline(x, y, len, c.v);
+    }
+
+    void blend_vline(int x, int y, unsigned len, const color_type& c, agg::int8u /*cover*/)
+    {
+        m_rbuf->fill_vline(x, y, len, c.v);
+    }
+
+    void blend_solid_hspan(int x, int y, unsigned len, const color_type& c,
+                           const agg::int8u* /*covers*/)
+    {
+        m_rbuf->fill_hline(x, y, len, c.v);
+    }
+
+    void blend_solid_vspan(int x, int y, unsigned len, const color_type& c,
+                           const agg::int8u* /*covers*/)
+    {
+        m_rbuf->fill_vline(x, y, len, c.v);
+    }
+
+    void copy_color_hspan(int x, int y, unsigned len, const color_type* colors)
+    {
+        m_rbuf->copy_hspan(x, y, len, colors);
+    }
+
+    void copy_color_vspan(int x, int y, unsigned len, const color_type* colors)
+    {
+        m_rbuf->copy_vspan(x, y, len, colors);
+    }
+
+    void blend_color_hspan(int x, int y, unsigned len, const color_type* colors,
+                           const agg::int8u* /*covers*/, agg::int8u /*cover*/)
+    {
+        m_rbuf->copy_hspan(x, y, len, colors);
+    }
+
+    void blend_color_vspan(int x, int y, unsigned len, const color_type* colors,
+                           const agg::int8u* /*covers*/, agg::int8u /*cover*/)
+    {
+        m_rbuf->copy_vspan(x, y, len, colors);
+    }
+
+private:
+    rbuf_type* m_rbuf;
+};
+
 using blender_gray16 = blender_gray<gray16>;
 
 using pixfmt_gray16 =  pixfmt_alpha_blend_gray<blender_gray16,
@@ -658,6 +760,9 @@ using blender_gray64 = blender_gray<gray64>;
 using pixfmt_gray64 = pixfmt_alpha_blend_gray<blender_gray64,
                                               mapnik::grid_rendering_buffer>;     //----pixfmt_gray64
 
+using pixfmt_sampled_gray32 = pixfmt_sampled_gray<gray32>;
+using pixfmt_sampled_gray64 = pixfmt_sampled_gray<gray64>;
+
 }
 
 #endif
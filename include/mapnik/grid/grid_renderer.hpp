@@ -129,6 +129,9 @@ public:
         pixmap_.painted(_painted);
     }
 
+    // fraction of the placement detector extent covered by labels
+    double label_coverage() const;
+
     inline eAttributeCollectionPolicy attribute_collection_policy() const
     {
         return DEFAULT;
@@ -33,9 +33,9 @@
 namespace mapnik {
 
 #ifdef BIGINT
-using grid_renderer_base_type = agg::renderer_base<mapnik::pixfmt_gray64>;
+using grid_renderer_base_type = agg::renderer_base<mapnik::pixfmt_sampled_gray64>;
 #else
-using grid_renderer_base_type = agg::renderer_base<mapnik::pixfmt_gray32>;
+using grid_renderer_base_type = agg::renderer_base<mapnik::pixfmt_sampled_gray32>;
 #endif
 
 }
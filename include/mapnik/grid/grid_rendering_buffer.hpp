@@ -25,6 +25,9 @@
 
 #include <mapnik/grid/grid.hpp>
 
+// stl
+#include <algorithm>
+
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore_agg.hpp>
 #include "agg_rendering_buffer.h"
@@ -34,6 +37,84 @@ namespace mapnik {
 
 using grid_rendering_buffer = agg::row_ptr_cache<mapnik::grid::value_type>;
 
+// Rendering buffer of a hit_grid keeping every resolution-th pixel of every
+// resolution-th row of the width x height area rendered; spans are written
+// to the sampled cells they cover straight away, the others are skipped.
+class grid_sampled_buffer
+{
+public:
+    using value_type = mapnik::grid::value_type;
+
+    grid_sampled_buffer(mapnik::grid & pixmap, unsigned width, unsigned height)
+        : data_(pixmap.raw_data()),
+          stride_(static_cast<unsigned>(pixmap.width())),
+          resolution_(pixmap.resolution()),
+          width_(std::min<std::size_t>(width, pixmap.width() * resolution_)),
+          height_(std::min<std::size_t>(height, pixmap.height() * resolution_)) {}
+
+    unsigned width() const { return width_; }
+    unsigned height() const { return height_; }
+    unsigned resolution() const { return resolution_; }
+
+    // the cell of pixel x,y when it is a sampled one, nullptr otherwise
+    value_type * sample(int x, int y) const
+    {
+        if (x % resolution_ != 0 || y % resolution_ != 0) return nullptr;
+        return data_ + (y / resolution_) * stride_ + x / resolution_;
+    }
+
+    void fill_hline(int x, int y, unsigned len, value_type v)
+    {
+        if (y % resolution_ != 0) return;
+        value_type * row = data_ + (y / resolution_) * stride_;
+        unsigned last = (x + len - 1) / resolution_;
+        for (unsigned i = (x + resolution_ - 1) / resolution_; i <= last; ++i)
+        {
+            row[i] = v;
+        }
+    }
+
+    void fill_vline(int x, int y, unsigned len, value_type v)
+    {
+        if (x % resolution_ != 0) return;
+        value_type * col = data_ + x / resolution_;
+        unsigned last = (y + len - 1) / resolution_;
+        for (unsigned i = (y + resolution_ - 1) / resolution_; i <= last; ++i)
+        {
+            col[i * stride_] = v;
+        }
+    }
+
+    template <typename Color>
+    void copy_hspan(int x, int y, unsigned len, Color const* colors)
+    {
+        if (y % resolution_ != 0) return;
+        value_type * row = data_ + (y / resolution_) * stride_;
+        for (unsigned i = (resolution_ - x % resolution_) % resolution_; i < len; i += resolution_)
+        {
+            row[(x + i) / resolution_] = colors[i].v;
+        }
+    }
+
+    template <typename Color>
+    void copy_vspan(int x, int y, unsigned len, Color const* colors)
+    {
+        if (x % resolution_ != 0) return;
+        value_type * col = data_ + x / resolution_;
+        for (unsigned i = (resolution_ - y % resolution_) % resolution_; i < len; i += resolution_)
+        {
+            col[((y + i) / resolution_) * stride_] = colors[i].v;
+        }
+    }
+
+private:
+    value_type * data_;
+    unsigned stride_;
+    unsigned resolution_;
+    unsigned width_;
+    unsigned height_;
+};
+
 }
 
 #endif //MAPNIK_AGG_RASTERIZER_HPP
@@ -0,0 +1,153 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_HISTOGRAM_QUANTIZER_HPP
+#define MAPNIK_HISTOGRAM_QUANTIZER_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/palette.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mapnik {
+
+namespace detail {
+
+// Open addressing color histogram. Colors are bucketed on their top
+// (8 - shift) bits per channel; the table grows up to max_bits and past
+// that the precision is lowered instead, so memory use stays bounded.
+class MAPNIK_DECL color_histogram
+{
+public:
+    static const unsigned min_bits = 10;
+    static const unsigned max_bits = 16;
+    static const unsigned max_shift = 5;
+
+    struct entry
+    {
+        std::uint32_t key;
+        std::uint32_t count;
+        std::uint64_t r;
+        std::uint64_t g;
+        std::uint64_t b;
+        std::uint64_t a;
+        unsigned index;
+    };
+
+    color_histogram();
+
+    // pixels must be preprocessed, 0 marks a pixel left out of the palette
+    // (fully transparent)
+    void insert(std::uint32_t const* pixels, std::size_t size);
+    void merge(color_histogram const& other);
+    entry const* find(std::uint32_t val) const;
+
+    std::uint32_t mask() const { return mask_; }
+    std::size_t size() const { return size_; }
+    std::uint64_t holes() const { return holes_; }
+    std::vector<entry> const& entries() const { return table_; }
+    std::vector<entry> & entries() { return table_; }
+
+private:
+    void add(std::uint32_t key, std::uint32_t count,
+             std::uint64_t r, std::uint64_t g, std::uint64_t b, std::uint64_t a);
+    std::size_t slot(std::uint32_t key) const;
+    void rehash(unsigned bits, unsigned shift);
+
+    std::vector<entry> table_;
+    std::size_t size_;
+    std::uint64_t holes_;
+    unsigned bits_;
+    unsigned shift_;
+    std::uint32_t mask_;
+};
+
+}
+
+// Median cut quantizer over a color histogram, a faster alternative to
+// hextree/octree for png8 output. The palette can be reused to quantize
+// other images (e.g. all tiles of a metatile); colors not seen by insert()
+// are matched to the nearest palette entry.
+// quantize() caches those matches, so it is only safe to call from
+// several threads at once for colors insert() has seen.
+class MAPNIK_DECL histogram_quantizer : private util::noncopyable
+{
+public:
+    static const unsigned MIN_ALPHA = 5;
+    static const unsigned MAX_ALPHA = 250;
+
+    explicit histogram_quantizer(unsigned max_colors = 256);
+
+    void set_trans_mode(int trans_mode);
+    void set_gamma(double gamma);
+    // number of threads sharing the histogram of large images,
+    // ignored without MAPNIK_THREADSAFE
+    void set_threads(unsigned threads);
+
+    template <typename Image>
+    void insert(Image const& image)
+    {
+        std::vector<std::uint32_t const*> rows;
+        rows.reserve(image.height());
+        for (std::size_t y = 0; y < image.height(); ++y)
+        {
+            rows.push_back(reinterpret_cast<std::uint32_t const*>(image.get_row(y)));
+        }
+        insert_rows(rows, image.width(), image.get_premultiplied());
+    }
+    // premultiplied rows are demultiplied a row at a time as they go in
+    void insert_rows(std::vector<std::uint32_t const*> const& rows, std::size_t width,
+                     bool premultiplied = false);
+
+    void create_palette();
+    bool has_palette() const { return !palette_.empty(); }
+    std::size_t histogram_size() const { return histogram_.size(); }
+
+    std::vector<rgb> const& palette() const { return palette_; }
+    std::vector<unsigned> const& alpha_table() const { return alpha_table_; }
+
+    unsigned char quantize(unsigned val) const;
+
+private:
+    std::uint32_t preprocess(std::uint32_t val) const;
+    void preprocess_row(std::uint32_t const* row, std::uint32_t * out, std::size_t width) const;
+    unsigned char nearest(std::uint32_t val) const;
+
+    unsigned max_colors_;
+    int trans_mode_;
+    double gamma_;
+    unsigned threads_;
+    detail::color_histogram histogram_;
+    int holes_index_;
+    std::vector<rgb> palette_;
+    std::vector<unsigned> alpha_table_;
+    mutable rgba_hash_table color_hashmap_;
+};
+
+}
+
+#endif // MAPNIK_HISTOGRAM_QUANTIZER_HPP
@@ -29,11 +29,24 @@
 
 namespace mapnik {
 
+// Where the pixels of an image live. mapped and huge_pages images get
+// anonymous memory mappings of their own, zeroed by the system and
+// returned to it on destruction; huge_pages asks for 2MB pages, falling
+// back to transparent huge pages. Both are heap allocations on Windows.
+// external images use memory owned by the caller.
+enum class image_storage
+{
+    heap,
+    mapped,
+    huge_pages,
+    external
+};
+
 namespace detail {
 
 struct MAPNIK_DECL buffer
 {
-    explicit buffer(std::size_t size);
+    explicit buffer(std::size_t size, image_storage storage = image_storage::heap);
     explicit buffer(unsigned char* data, std::size_t size);
     buffer(buffer && rhs) noexcept;
     buffer(buffer const& rhs);
@@ -43,11 +56,14 @@ struct MAPNIK_DECL buffer
     inline unsigned char* data() {return data_;}
     inline unsigned char const* data() const {return data_;}
     inline std::size_t size() const {return size_;}
+    inline image_storage storage() const {return storage_;}
 private:
+    void allocate();
+    void deallocate();
     void swap(buffer & rhs);
     std::size_t size_;
     unsigned char* data_;
-    bool owns_;
+    image_storage storage_;
 };
 
 template <std::size_t max_size>
@@ -80,6 +96,7 @@ private:
     double scaling_;
     bool premultiplied_alpha_;
     bool painted_;
+    bool opaque_;
 public:
     image();
     image(int width,
@@ -87,6 +104,13 @@ public:
           bool initialize = true,
           bool premultiplied = false,
           bool painted = false);
+    image(int width,
+          int height,
+          image_storage storage,
+          bool initialize = true,
+          bool premultiplied = false,
+          bool painted = false);
+    // pixels written to and read from data, which must outlive the image
     image(int width,
           int height,
           unsigned char* data,
@@ -130,7 +154,15 @@ public:
     void set_premultiplied(bool set);
     void painted(bool painted);
     bool painted() const;
+    // Every pixel is known to have full alpha, so that the premultiplied
+    // and straight pixels are the same and encoders may leave alpha out.
+    // Set by renderers drawing a map over an opaque background, cleared
+    // by set() and the image_util functions changing alpha; whoever writes
+    // translucent pixels otherwise clears it too.
+    void set_opaque(bool opaque);
+    bool opaque() const;
     image_dtype get_dtype() const;
+    image_storage storage() const;
 };
 
 using image_null = image<null_t>;
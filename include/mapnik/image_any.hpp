@@ -81,6 +81,23 @@ MAPNIK_DECL image_any create_image_any(int width,
                                        bool premultiplied = false,
                                        bool painted = false);
 
+// pixels in storage, see image_storage
+MAPNIK_DECL image_any create_image_any(int width,
+                                       int height,
+                                       image_dtype type,
+                                       image_storage storage,
+                                       bool initialize = true,
+                                       bool premultiplied = false,
+                                       bool painted = false);
+
+// pixels in data, owned by the caller, which must outlive the image
+MAPNIK_DECL image_any create_image_any(int width,
+                                       int height,
+                                       image_dtype type,
+                                       unsigned char* data,
+                                       bool premultiplied = false,
+                                       bool painted = false);
+
 } // end mapnik ns
 
 #endif // MAPNIK_IMAGE_ANY_HPP
@@ -37,6 +37,8 @@
 namespace mapnik
 {
 
+template <typename T> class box2d;
+
 // Compositing modes
 // http://www.w3.org/TR/2009/WD-SVGCompositing-20090430/
 
@@ -91,5 +93,23 @@ MAPNIK_DECL void composite(T & dst, T const& src,
                            int dx=0,
                            int dy=0);
 
+// Composites only the pixels of src inside src_box (exclusive max corner),
+// for a source that is transparent everywhere else.
+MAPNIK_DECL void composite(image_rgba8 & dst, image_rgba8 const& src,
+                           box2d<int> const& src_box,
+                           composite_mode_e mode,
+                           float opacity=1,
+                           int dx=0,
+                           int dy=0);
+
+// True if compositing a transparent source pixel leaves the destination
+// unchanged, so that a source can be composited by its painted part only.
+MAPNIK_DECL bool composite_keeps_destination(composite_mode_e mode);
+
+// True if compositing any source pixel onto an opaque destination pixel
+// leaves it opaque, so that a map drawn with the mode over an opaque
+// background stays opaque.
+MAPNIK_DECL bool composite_keeps_opaque(composite_mode_e mode);
+
 }
 #endif // MAPNIK_IMAGE_COMPOSITING_HPP
@@ -27,6 +27,7 @@
 //mapnik
 #include <mapnik/image_filter_types.hpp>
 #include <mapnik/image_util.hpp>
+#include <mapnik/executor.hpp>
 #include <mapnik/util/hsl.hpp>
 
 #pragma GCC diagnostic push
@@ -46,7 +47,12 @@
 #pragma GCC diagnostic pop
 
 // stl
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
 
 // 8-bit YUV
 //Y = ( (  66 * R + 129 * G +  25 * B + 128) >> 8) +  16
@@ -419,24 +425,41 @@ inline uint8_t apply_alpha_shift(double source, double match, double alpha)
     return static_cast<uint8_t>(std::floor((source*255.0)+.5));
 }
 
-template <typename Src>
-void apply_filter(Src & src, color_to_alpha const& op, double /*scale_factor*/)
+namespace detail {
+
+// Filters that only look at one pixel at a time work on a row of rgba8
+// pixels, so that consecutive ones can share a single pass over the image.
+// `premultiplied` tells if the row is premultiplied, the row is always
+// left premultiplied.
+struct row_filter
 {
-    using namespace boost::gil;
-    bool premultiplied = src.get_premultiplied();
-    rgba8_view_t src_view = rgba8_view(src);
-    double cr = static_cast<double>(op.color.red())/255.0;
-    double cg = static_cast<double>(op.color.green())/255.0;
-    double cb = static_cast<double>(op.color.blue())/255.0;
-    for (std::ptrdiff_t y = 0; y < src_view.height(); ++y)
+    std::function<void(std::uint8_t * row, std::size_t width, bool premultiplied)> apply;
+    // premultiply the row before apply()
+    bool needs_premultiplied;
+};
+
+inline void premultiply_row(std::uint8_t * row, std::size_t width)
+{
+    agg::rendering_buffer buffer(row, static_cast<unsigned>(width), 1, static_cast<int>(width * 4));
+    agg::pixfmt_rgba32 pixf(buffer);
+    pixf.premultiply();
+}
+
+struct color_to_alpha_row
+{
+    explicit color_to_alpha_row(color_to_alpha const& op)
+        : cr(static_cast<double>(op.color.red())/255.0),
+          cg(static_cast<double>(op.color.green())/255.0),
+          cb(static_cast<double>(op.color.blue())/255.0) {}
+
+    void operator() (std::uint8_t * row, std::size_t width, bool premultiplied) const
     {
-        rgba8_view_t::x_iterator src_it = src_view.row_begin(static_cast<long>(y));
-        for (std::ptrdiff_t x = 0; x < src_view.width(); ++x)
+        for (std::size_t x = 0; x < width; ++x)
         {
-            uint8_t & r = get_color(src_it[x], red_t());
-            uint8_t & g = get_color(src_it[x], green_t());
-            uint8_t & b = get_color(src_it[x], blue_t());
-            uint8_t & a = get_color(src_it[x], alpha_t());
+            std::uint8_t & r = row[4 * x];
+            std::uint8_t & g = row[4 * x + 1];
+            std::uint8_t & b = row[4 * x + 2];
+            std::uint8_t & a = row[4 * x + 3];
             double sr = static_cast<double>(r)/255.0;
             double sg = static_cast<double>(g)/255.0;
             double sb = static_cast<double>(b)/255.0;
@@ -476,227 +499,165 @@ void apply_filter(Src & src, color_to_alpha const& op, double /*scale_factor*/)
             }
         }
     }
-    // set as premultiplied
-    set_premultiplied_alpha(src, true);
-}
 
-template <typename Src>
-void apply_filter(Src & src, colorize_alpha const& op, double /*scale_factor*/)
+    double cr;
+    double cg;
+    double cb;
+};
+
+struct colorize_alpha_row
 {
-    using namespace boost::gil;
-    std::ptrdiff_t size = op.size();
-    if (op.size() == 1)
+    explicit colorize_alpha_row(mapnik::color const& c)
+        : stop(c),
+          lut() {}
+
+    explicit colorize_alpha_row(std::shared_ptr<agg::gradient_lut<agg::color_interpolator<agg::rgba8> > > const& grad_lut)
+        : stop(),
+          lut(grad_lut) {}
+
+    void operator() (std::uint8_t * row, std::size_t width, bool /*premultiplied*/) const
     {
-        // no interpolation if only one stop
-        mapnik::filter::color_stop const& stop = op[0];
-        mapnik::color const& c = stop.color;
-        rgba8_view_t src_view = rgba8_view(src);
-        for (std::ptrdiff_t y = 0; y < src_view.height(); ++y)
+        if (!lut)
         {
-            rgba8_view_t::x_iterator src_it = src_view.row_begin(static_cast<long>(y));
-            for (std::ptrdiff_t x = 0; x < src_view.width(); ++x)
+            // no interpolation if only one stop
+            for (std::size_t x = 0; x < width; ++x)
             {
-                uint8_t & r = get_color(src_it[x], red_t());
-                uint8_t & g = get_color(src_it[x], green_t());
-                uint8_t & b = get_color(src_it[x], blue_t());
-                uint8_t & a = get_color(src_it[x], alpha_t());
+                std::uint8_t & r = row[4 * x];
+                std::uint8_t & g = row[4 * x + 1];
+                std::uint8_t & b = row[4 * x + 2];
+                std::uint8_t & a = row[4 * x + 3];
                 if ( a > 0)
                 {
-                    a = (c.alpha() * a + 255) >> 8;
-                    r = (c.red() * a + 255) >> 8;
-                    g = (c.green() * a + 255) >> 8;
-                    b = (c.blue() * a + 255) >> 8;
+                    a = (stop.alpha() * a + 255) >> 8;
+                    r = (stop.red() * a + 255) >> 8;
+                    g = (stop.green() * a + 255) >> 8;
+                    b = (stop.blue() * a + 255) >> 8;
                 }
             }
         }
-        // set as premultiplied
-        set_premultiplied_alpha(src, true);
-    }
-    else if (size > 1)
-    {
-        // interpolate multiple stops
-        agg::gradient_lut<agg::color_interpolator<agg::rgba8> > grad_lut;
-        double step = 1.0/(size-1);
-        double offset = 0.0;
-        for ( mapnik::filter::color_stop const& stop : op)
-        {
-            mapnik::color const& c = stop.color;
-            double stop_offset = stop.offset;
-            if (stop_offset == 0)
-            {
-                stop_offset = offset;
-            }
-            grad_lut.add_color(stop_offset, agg::rgba(c.red()/255.0,
-                                                      c.green()/255.0,
-                                                      c.blue()/255.0,
-                                                      c.alpha()/255.0));
-            offset += step;
-        }
-        if (grad_lut.build_lut())
+        else
         {
-            rgba8_view_t src_view = rgba8_view(src);
-            for (std::ptrdiff_t y = 0; y < src_view.height(); ++y)
+            for (std::size_t x = 0; x < width; ++x)
             {
-                rgba8_view_t::x_iterator src_it = src_view.row_begin(static_cast<long>(y));
-                for (std::ptrdiff_t x = 0; x < src_view.width(); ++x)
+                std::uint8_t & r = row[4 * x];
+                std::uint8_t & g = row[4 * x + 1];
+                std::uint8_t & b = row[4 * x + 2];
+                std::uint8_t & a = row[4 * x + 3];
+                if ( a > 0)
                 {
-                    uint8_t & r = get_color(src_it[x], red_t());
-                    uint8_t & g = get_color(src_it[x], green_t());
-                    uint8_t & b = get_color(src_it[x], blue_t());
-                    uint8_t & a = get_color(src_it[x], alpha_t());
-                    if ( a > 0)
-                    {
-                        agg::rgba8 c = grad_lut[a];
-                        a = (c.a * a + 255) >> 8;
-                        r = (c.r * a + 255) >> 8;
-                        g = (c.g * a + 255) >> 8;
-                        b = (c.b * a + 255) >> 8;
-        #if 0
-                        // rainbow
-                        r = 0;
-                        g = 0;
-                        b = 0;
-                        if (a < 64)
-                        {
-                            g = a * 4;
-                            b = 255;
-                        }
-                        else if (a >= 64 && a < 128)
-                        {
-                            g = 255;
-                            b = 255 - ((a - 64) * 4);
-                        }
-                        else if (a >= 128 && a < 192)
-                        {
-                            r = (a - 128) * 4;
-                            g = 255;
-                        }
-                        else // >= 192
-                        {
-                            r = 255;
-                            g = 255 - ((a - 192) * 4);
-                        }
-                        r = (r * a + 255) >> 8;
-                        g = (g * a + 255) >> 8;
-                        b = (b * a + 255) >> 8;
-        #endif
-                    }
+                    agg::rgba8 c = (*lut)[a];
+                    a = (c.a * a + 255) >> 8;
+                    r = (c.r * a + 255) >> 8;
+                    g = (c.g * a + 255) >> 8;
+                    b = (c.b * a + 255) >> 8;
                 }
             }
         }
-        // set as premultiplied
-        set_premultiplied_alpha(src, true);
     }
-}
 
-template <typename Src>
-void apply_filter(Src & src, scale_hsla const& transform, double /*scale_factor*/)
-{
-    using namespace boost::gil;
-    bool tinting = !transform.is_identity();
-    bool set_alpha = !transform.is_alpha_identity();
-    // todo - filters be able to report if they
-    // should be run to avoid overhead of temp buffer
-    if (tinting || set_alpha)
+    mapnik::color stop;
+    std::shared_ptr<agg::gradient_lut<agg::color_interpolator<agg::rgba8> > > lut;
+};
+
+struct scale_hsla_row
+{
+    explicit scale_hsla_row(scale_hsla const& op)
+        : transform(op),
+          tinting(!op.is_identity()),
+          set_alpha(!op.is_alpha_identity()) {}
+
+    void operator() (std::uint8_t * row, std::size_t width, bool premultiplied) const
     {
-        bool premultiplied = src.get_premultiplied();
-        rgba8_view_t src_view = rgba8_view(src);
-        for (std::ptrdiff_t y = 0; y < src_view.height(); ++y)
+        for (std::size_t x = 0; x < width; ++x)
         {
-            rgba8_view_t::x_iterator src_it = src_view.row_begin(static_cast<long>(y));
-            for (std::ptrdiff_t x = 0; x < src_view.width(); ++x)
+            std::uint8_t & r = row[4 * x];
+            std::uint8_t & g = row[4 * x + 1];
+            std::uint8_t & b = row[4 * x + 2];
+            std::uint8_t & a = row[4 * x + 3];
+            double r2 = static_cast<double>(r)/255.0;
+            double g2 = static_cast<double>(g)/255.0;
+            double b2 = static_cast<double>(b)/255.0;
+            double a2 = static_cast<double>(a)/255.0;
+            // demultiply
+            if (a2 <= 0.0)
+            {
+                r = g = b = 0;
+                continue;
+            }
+            else if (premultiplied)
             {
-                uint8_t & r = get_color(src_it[x], red_t());
-                uint8_t & g = get_color(src_it[x], green_t());
-                uint8_t & b = get_color(src_it[x], blue_t());
-                uint8_t & a = get_color(src_it[x], alpha_t());
-                double r2 = static_cast<double>(r)/255.0;
-                double g2 = static_cast<double>(g)/255.0;
-                double b2 = static_cast<double>(b)/255.0;
-                double a2 = static_cast<double>(a)/255.0;
-                // demultiply
-                if (a2 <= 0.0)
+                r2 /= a2;
+                g2 /= a2;
+                b2 /= a2;
+            }
+
+            if (set_alpha)
+            {
+                a2 = transform.a0 + (a2 * (transform.a1 - transform.a0));
+                if (a2 <= 0)
                 {
-                    r = g = b = 0;
+                    r = g = b = a = 0;
                     continue;
                 }
-                else if (premultiplied)
+                else if (a2 > 1)
                 {
-                    r2 /= a2;
-                    g2 /= a2;
-                    b2 /= a2;
+                    a2 = 1;
+                    a = 255;
                 }
-
-                if (set_alpha)
-                {
-                    a2 = transform.a0 + (a2 * (transform.a1 - transform.a0));
-                    if (a2 <= 0)
-                    {
-                        r = g = b = a = 0;
-                        continue;
-                    }
-                    else if (a2 > 1)
-                    {
-                        a2 = 1;
-                        a = 255;
-                    }
-                    else
-                    {
-                        a = static_cast<uint8_t>(std::floor((a2 * 255.0) +.5));
-                    }
-                }
-                if (tinting)
+                else
                 {
-                    double h;
-                    double s;
-                    double l;
-                    rgb2hsl(r2,g2,b2,h,s,l);
-                    double h2 = transform.h0 + (h * (transform.h1 - transform.h0));
-                    double s2 = transform.s0 + (s * (transform.s1 - transform.s0));
-                    double l2 = transform.l0 + (l * (transform.l1 - transform.l0));
-                    if (h2 > 1) { h2 = 1; }
-                    else if (h2 < 0) { h2 = 0; }
-                    if (s2 > 1) { s2 = 1; }
-                    else if (s2 < 0) { s2 = 0; }
-                    if (l2 > 1) { l2 = 1; }
-                    else if (l2 < 0) { l2 = 0; }
-                    hsl2rgb(h2,s2,l2,r2,g2,b2);
+                    a = static_cast<uint8_t>(std::floor((a2 * 255.0) +.5));
                 }
-                // premultiply
-                r2 *= a2;
-                g2 *= a2;
-                b2 *= a2;
-                r = static_cast<uint8_t>(std::floor((r2*255.0)+.5));
-                g = static_cast<uint8_t>(std::floor((g2*255.0)+.5));
-                b = static_cast<uint8_t>(std::floor((b2*255.0)+.5));
-                // all color values must be <= alpha
-                if (r>a) r=a;
-                if (g>a) g=a;
-                if (b>a) b=a;
             }
+            if (tinting)
+            {
+                double h;
+                double s;
+                double l;
+                rgb2hsl(r2,g2,b2,h,s,l);
+                double h2 = transform.h0 + (h * (transform.h1 - transform.h0));
+                double s2 = transform.s0 + (s * (transform.s1 - transform.s0));
+                double l2 = transform.l0 + (l * (transform.l1 - transform.l0));
+                if (h2 > 1) { h2 = 1; }
+                else if (h2 < 0) { h2 = 0; }
+                if (s2 > 1) { s2 = 1; }
+                else if (s2 < 0) { s2 = 0; }
+                if (l2 > 1) { l2 = 1; }
+                else if (l2 < 0) { l2 = 0; }
+                hsl2rgb(h2,s2,l2,r2,g2,b2);
+            }
+            // premultiply
+            r2 *= a2;
+            g2 *= a2;
+            b2 *= a2;
+            r = static_cast<uint8_t>(std::floor((r2*255.0)+.5));
+            g = static_cast<uint8_t>(std::floor((g2*255.0)+.5));
+            b = static_cast<uint8_t>(std::floor((b2*255.0)+.5));
+            // all color values must be <= alpha
+            if (r>a) r=a;
+            if (g>a) g=a;
+            if (b>a) b=a;
         }
-        // set as premultiplied
-        set_premultiplied_alpha(src, true);
     }
-}
 
-template <typename Src, typename ColorBlindFilter>
-void apply_color_blind_filter(Src & src, ColorBlindFilter const& op)
+    scale_hsla transform;
+    bool tinting;
+    bool set_alpha;
+};
+
+struct color_blind_row
 {
-    using namespace boost::gil;
-    rgba8_view_t src_view = rgba8_view(src);
-    bool premultiplied = src.get_premultiplied();
+    explicit color_blind_row(color_blind_filter const& filter)
+        : op(filter) {}
 
-    for (std::ptrdiff_t y = 0; y < src_view.height(); ++y)
+    void operator() (std::uint8_t * row, std::size_t width, bool premultiplied) const
     {
-        rgba8_view_t::x_iterator src_it = src_view.row_begin(static_cast<long>(y));
-        for (std::ptrdiff_t x = 0; x < src_view.width(); ++x)
+        for (std::size_t x = 0; x < width; ++x)
         {
-            // formula taken from boost/gil/color_convert.hpp:rgb_to_luminance
-            uint8_t & r = get_color(src_it[x], red_t());
-            uint8_t & g = get_color(src_it[x], green_t());
-            uint8_t & b = get_color(src_it[x], blue_t());
-            uint8_t & a = get_color(src_it[x], alpha_t());
+            std::uint8_t & r = row[4 * x];
+            std::uint8_t & g = row[4 * x + 1];
+            std::uint8_t & b = row[4 * x + 2];
+            std::uint8_t & a = row[4 * x + 3];
             double dr = static_cast<double>(r)/255.0;
             double dg = static_cast<double>(g)/255.0;
             double db = static_cast<double>(b)/255.0;
@@ -797,51 +758,229 @@ void apply_color_blind_filter(Src & src, ColorBlindFilter const& op)
             b = static_cast<uint8_t>(db * 255.0);
         }
     }
-    // set as premultiplied
+
+    color_blind_filter op;
+};
+
+struct gray_row
+{
+    void operator() (std::uint8_t * row, std::size_t width, bool /*premultiplied*/) const
+    {
+        for (std::size_t x = 0; x < width; ++x)
+        {
+            // formula taken from boost/gil/color_convert.hpp:rgb_to_luminance
+            std::uint8_t * p = row + 4 * x;
+            std::uint8_t v = std::uint8_t((4915 * p[0] + 9667 * p[1] + 1802 * p[2] + 8192) >> 14);
+            p[0] = p[1] = p[2] = v;
+        }
+    }
+};
+
+struct invert_row
+{
+    void operator() (std::uint8_t * row, std::size_t width, bool /*premultiplied*/) const
+    {
+        for (std::size_t x = 0; x < width; ++x)
+        {
+            // we only work with premultiplied source,
+            // thus all color values must be <= alpha
+            std::uint8_t * p = row + 4 * x;
+            p[0] = p[3] - p[0];
+            p[1] = p[3] - p[1];
+            p[2] = p[3] - p[2];
+        }
+    }
+};
+
+// Collects the row filter for a filter, returns false for filters
+// that need neighbouring pixels.
+struct row_filter_visitor
+{
+    explicit row_filter_visitor(std::vector<row_filter> & filters)
+        : filters_(filters) {}
+
+    template <typename T>
+    bool operator() (T const& /*filter*/) const
+    {
+        return false;
+    }
+
+    bool operator() (color_to_alpha const& op) const
+    {
+        filters_.push_back(row_filter{color_to_alpha_row(op), false});
+        return true;
+    }
+
+    bool operator() (colorize_alpha const& op) const
+    {
+        std::size_t size = op.size();
+        if (size == 1)
+        {
+            filters_.push_back(row_filter{colorize_alpha_row(op[0].color), false});
+        }
+        else if (size > 1)
+        {
+            // interpolate multiple stops
+            auto grad_lut = std::make_shared<agg::gradient_lut<agg::color_interpolator<agg::rgba8> > >();
+            double step = 1.0/(size-1);
+            double offset = 0.0;
+            for ( mapnik::filter::color_stop const& stop : op)
+            {
+                mapnik::color const& c = stop.color;
+                double stop_offset = stop.offset;
+                if (stop_offset == 0)
+                {
+                    stop_offset = offset;
+                }
+                grad_lut->add_color(stop_offset, agg::rgba(c.red()/255.0,
+                                                           c.green()/255.0,
+                                                           c.blue()/255.0,
+                                                           c.alpha()/255.0));
+                offset += step;
+            }
+            if (grad_lut->build_lut())
+            {
+                filters_.push_back(row_filter{colorize_alpha_row(grad_lut), false});
+            }
+            else
+            {
+                // nothing to apply but the image is still marked premultiplied
+                filters_.push_back(row_filter{[](std::uint8_t *, std::size_t, bool) {}, false});
+            }
+        }
+        return true;
+    }
+
+    bool operator() (scale_hsla const& op) const
+    {
+        // todo - filters be able to report if they
+        // should be run to avoid overhead of temp buffer
+        if (!op.is_identity() || !op.is_alpha_identity())
+        {
+            filters_.push_back(row_filter{scale_hsla_row(op), false});
+        }
+        return true;
+    }
+
+    bool operator() (color_blind_protanope const& op) const
+    {
+        filters_.push_back(row_filter{color_blind_row(op), false});
+        return true;
+    }
+
+    bool operator() (color_blind_deuteranope const& op) const
+    {
+        filters_.push_back(row_filter{color_blind_row(op), false});
+        return true;
+    }
+
+    bool operator() (color_blind_tritanope const& op) const
+    {
+        filters_.push_back(row_filter{color_blind_row(op), false});
+        return true;
+    }
+
+    bool operator() (gray const&) const
+    {
+        filters_.push_back(row_filter{gray_row(), true});
+        return true;
+    }
+
+    bool operator() (invert const&) const
+    {
+        filters_.push_back(row_filter{invert_row(), true});
+        return true;
+    }
+
+    std::vector<row_filter> & filters_;
+};
+
+// Applies all filters to each row in turn, with rows split between
+// up to `threads` threads on large images.
+template <typename Src>
+void apply_row_filters(Src & src, std::vector<row_filter> const& filters, unsigned threads = 1)
+{
+    if (filters.empty()) return;
+    bool premultiplied = src.get_premultiplied();
+    std::size_t width = src.width();
+    std::size_t height = src.height();
+    auto apply_rows = [&](std::size_t y0, std::size_t y1) {
+        for (std::size_t y = y0; y < y1; ++y)
+        {
+            std::uint8_t * row = reinterpret_cast<std::uint8_t *>(src.get_row(y));
+            bool row_premultiplied = premultiplied;
+            for (row_filter const& filter : filters)
+            {
+                if (filter.needs_premultiplied && !row_premultiplied)
+                {
+                    premultiply_row(row, width);
+                }
+                filter.apply(row, width, row_premultiplied);
+                row_premultiplied = true;
+            }
+        }
+    };
+    // below this many pixels a thread costs more than it saves
+    std::size_t const min_pixels_per_thread = 256 * 256;
+    parallel_bands(height, std::min(static_cast<std::size_t>(threads),
+                                    width * height / min_pixels_per_thread), apply_rows);
     set_premultiplied_alpha(src, true);
 }
 
+template <typename Src, typename Filter>
+void apply_row_filter(Src & src, Filter const& op)
+{
+    std::vector<row_filter> filters;
+    row_filter_visitor visitor(filters);
+    visitor(op);
+    apply_row_filters(src, filters);
+}
+
+}
+
+template <typename Src>
+void apply_filter(Src & src, color_to_alpha const& op, double /*scale_factor*/)
+{
+    detail::apply_row_filter(src, op);
+}
+
+template <typename Src>
+void apply_filter(Src & src, colorize_alpha const& op, double /*scale_factor*/)
+{
+    detail::apply_row_filter(src, op);
+}
+
+template <typename Src>
+void apply_filter(Src & src, scale_hsla const& op, double /*scale_factor*/)
+{
+    detail::apply_row_filter(src, op);
+}
+
 template <typename Src>
 void apply_filter(Src & src, color_blind_protanope const& op, double /*scale_factor*/)
 {
-    apply_color_blind_filter(src, op);
+    detail::apply_row_filter(src, op);
 }
 
 template <typename Src>
 void apply_filter(Src & src, color_blind_deuteranope const& op, double /*scale_factor*/)
 {
-    apply_color_blind_filter(src, op);
+    detail::apply_row_filter(src, op);
 }
 
 template <typename Src>
 void apply_filter(Src & src, color_blind_tritanope const& op, double /*scale_factor*/)
 {
-    apply_color_blind_filter(src, op);
+    detail::apply_row_filter(src, op);
 }
 
 template <typename Src>
-void apply_filter(Src & src, gray const& /*op*/, double /*scale_factor*/)
+void apply_filter(Src & src, gray const& op, double /*scale_factor*/)
 {
-    premultiply_alpha(src);
-    using namespace boost::gil;
-
-    rgba8_view_t src_view = rgba8_view(src);
-
-    for (std::ptrdiff_t y = 0; y < src_view.height(); ++y)
-    {
-        rgba8_view_t::x_iterator src_it = src_view.row_begin(static_cast<long>(y));
-        for (std::ptrdiff_t x = 0; x < src_view.width(); ++x)
-        {
-            // formula taken from boost/gil/color_convert.hpp:rgb_to_luminance
-            uint8_t & r = get_color(src_it[x], red_t());
-            uint8_t & g = get_color(src_it[x], green_t());
-            uint8_t & b = get_color(src_it[x], blue_t());
-            uint8_t   v = uint8_t((4915 * r + 9667 * g + 1802 * b + 8192) >> 14);
-            r = g = b = v;
-        }
-    }
+    detail::apply_row_filter(src, op);
 }
 
+
 template <typename Src, typename Dst>
 void x_gradient_impl(Src const& src_view, Dst const& dst_view)
 {
@@ -888,29 +1027,9 @@ void apply_filter(Src & src, y_gradient const& /*op*/, double /*scale_factor*/)
 }
 
 template <typename Src>
-void apply_filter(Src & src, invert const& /*op*/, double /*scale_factor*/)
+void apply_filter(Src & src, invert const& op, double /*scale_factor*/)
 {
-    premultiply_alpha(src);
-    using namespace boost::gil;
-
-    rgba8_view_t src_view = rgba8_view(src);
-
-    for (std::ptrdiff_t y = 0; y < src_view.height(); ++y)
-    {
-        rgba8_view_t::x_iterator src_it = src_view.row_begin(static_cast<long>(y));
-        for (std::ptrdiff_t x = 0; x < src_view.width(); ++x)
-        {
-            // we only work with premultiplied source,
-            // thus all color values must be <= alpha
-            uint8_t   a = get_color(src_it[x], alpha_t());
-            uint8_t & r = get_color(src_it[x], red_t());
-            uint8_t & g = get_color(src_it[x], green_t());
-            uint8_t & b = get_color(src_it[x], blue_t());
-            r = a - r;
-            g = a - g;
-            b = a - b;
-        }
-    }
+    detail::apply_row_filter(src, op);
 }
 
 template <typename Src>
@@ -945,6 +1064,71 @@ struct filter_radius_visitor
     }
 };
 
+// How far a filter can spread painted pixels into transparent ones, none
+// for filters that paint transparent pixels out of any painted pixel's reach.
+struct filter_spread_visitor
+{
+    explicit filter_spread_visitor(double scale_factor)
+        : scale_factor_(scale_factor) {}
+
+    // pixel by pixel filters keep transparent pixels transparent
+    template <typename T>
+    boost::optional<int> operator() (T const& /*filter*/) const { return 0; }
+
+    boost::optional<int> operator() (blur const&) const { return 1; }
+    boost::optional<int> operator() (emboss const&) const { return 1; }
+    boost::optional<int> operator() (sharpen const&) const { return 1; }
+    boost::optional<int> operator() (edge_detect const&) const { return 1; }
+    boost::optional<int> operator() (sobel const&) const { return 1; }
+    boost::optional<int> operator() (x_gradient const&) const { return boost::none; }
+    boost::optional<int> operator() (y_gradient const&) const { return boost::none; }
+
+    boost::optional<int> operator() (agg_stack_blur const& op) const
+    {
+        return static_cast<int>(std::ceil(std::max(op.rx, op.ry) * scale_factor_));
+    }
+
+    double scale_factor_;
+};
+
+// Margin around the painted part of an image that filters need to give
+// the same result there as on the whole image.
+inline boost::optional<int> filters_spread(std::vector<filter_type> const& filters,
+                                           double scale_factor = 1.0)
+{
+    int spread = 0;
+    for (filter_type const& filter_tag : filters)
+    {
+        boost::optional<int> s = util::apply_visitor(filter_spread_visitor(scale_factor), filter_tag);
+        if (!s) return boost::none;
+        spread += *s;
+    }
+    // keeps a transparent border around the spread for the edge handling
+    // of the neighbourhood filters
+    return filters.empty() ? 0 : spread + 1;
+}
+
+// Applies filters in order. Consecutive filters that work pixel by pixel
+// are applied together in a single pass, split between up to `threads`
+// threads on large images.
+template <typename Src>
+void apply_filters(Src & src, std::vector<filter_type> const& filters,
+                   double scale_factor = 1.0, unsigned threads = 1)
+{
+    filter_visitor<Src> visitor(src, scale_factor);
+    std::vector<detail::row_filter> row_filters;
+    for (filter_type const& filter_tag : filters)
+    {
+        if (!util::apply_visitor(detail::row_filter_visitor(row_filters), filter_tag))
+        {
+            detail::apply_row_filters(src, row_filters, threads);
+            row_filters.clear();
+            util::apply_visitor(visitor, filter_tag);
+        }
+    }
+    detail::apply_row_filters(src, row_filters, threads);
+}
+
 template<typename Src>
 void filter_image(Src & src, std::string const& filter, double scale_factor=1)
 {
@@ -953,11 +1137,7 @@ void filter_image(Src & src, std::string const& filter, double scale_factor=1)
     {
         throw std::runtime_error("Failed to parse filter argument in filter_image: '" + filter + "'");
     }
-    filter_visitor<Src> visitor(src, scale_factor);
-    for (filter_type const& filter_tag : filter_vector)
-    {
-        util::apply_visitor(visitor, filter_tag);
-    }
+    apply_filters(src, filter_vector, scale_factor);
 }
 
 template<typename Src>
@@ -969,11 +1149,7 @@ Src filter_image(Src const& src, std::string const& filter, double scale_factor=
         throw std::runtime_error("Failed to parse filter argument in filter_image: '" + filter + "'");
     }
     Src new_src(src);
-    filter_visitor<Src> visitor(new_src, scale_factor);
-    for (filter_type const& filter_tag : filter_vector)
-    {
-        util::apply_visitor(visitor, filter_tag);
-    }
+    apply_filters(new_src, filter_vector, scale_factor);
     return new_src;
 }
 
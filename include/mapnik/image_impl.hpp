@@ -65,17 +65,19 @@ image<T>::image()
       offset_(0.0),
       scaling_(1.0),
       premultiplied_alpha_(false),
-      painted_(false)
+      painted_(false),
+      opaque_(false)
 {}
 
 template <typename T>
 image<T>::image(int width, int height, unsigned char* data, bool premultiplied, bool painted)
     : dimensions_(width, height),
-      buffer_(data, width * height * sizeof(pixel_size)),
+      buffer_(data, dimensions_.width() * dimensions_.height() * pixel_size),
       offset_(0.0),
       scaling_(1.0),
       premultiplied_alpha_(premultiplied),
-      painted_(painted) {}
+      painted_(painted),
+      opaque_(false) {}
 
 template <typename T>
 image<T>::image(int width, int height, bool initialize, bool premultiplied, bool painted)
@@ -84,7 +86,8 @@ image<T>::image(int width, int height, bool initialize, bool premultiplied, bool
       offset_(0.0),
       scaling_(1.0),
       premultiplied_alpha_(premultiplied),
-      painted_(painted)
+      painted_(painted),
+      opaque_(false)
 {
     if (initialize)
     {
@@ -92,6 +95,23 @@ image<T>::image(int width, int height, bool initialize, bool premultiplied, bool
     }
 }
 
+template <typename T>
+image<T>::image(int width, int height, image_storage storage, bool initialize, bool premultiplied, bool painted)
+    : dimensions_(width, height),
+      buffer_(dimensions_.width() * dimensions_.height() * pixel_size, storage),
+      offset_(0.0),
+      scaling_(1.0),
+      premultiplied_alpha_(premultiplied),
+      painted_(painted),
+      opaque_(false)
+{
+    // mappings come zeroed
+    if (initialize && buffer_.storage() == image_storage::heap)
+    {
+        std::fill(begin(), end(), 0);
+    }
+}
+
 template <typename T>
 image<T>::image(image<T> const& rhs)
     : dimensions_(rhs.dimensions_),
@@ -99,7 +119,8 @@ image<T>::image(image<T> const& rhs)
       offset_(rhs.offset_),
       scaling_(rhs.scaling_),
       premultiplied_alpha_(rhs.premultiplied_alpha_),
-      painted_(rhs.painted_) {}
+      painted_(rhs.painted_),
+      opaque_(rhs.opaque_) {}
 
 template <typename T>
 image<T>::image(image<T> && rhs) noexcept
@@ -108,7 +129,8 @@ image<T>::image(image<T> && rhs) noexcept
       offset_(rhs.offset_),
       scaling_(rhs.scaling_),
       premultiplied_alpha_(rhs.premultiplied_alpha_),
-      painted_(rhs.painted_)
+      painted_(rhs.painted_),
+      opaque_(rhs.opaque_)
 {
     rhs.dimensions_ = { 0, 0 };
 }
@@ -141,6 +163,7 @@ void image<T>::swap(image<T> & rhs)
     std::swap(scaling_, rhs.scaling_);
     std::swap(premultiplied_alpha_, rhs.premultiplied_alpha_);
     std::swap(painted_, rhs.painted_);
+    std::swap(opaque_, rhs.opaque_);
 }
 
 template <typename T>
@@ -185,6 +208,7 @@ template <typename T>
 inline void image<T>::set(pixel_type const& t)
 {
     std::fill(begin(), end(), t);
+    opaque_ = false;
 }
 
 template <typename T>
@@ -317,10 +341,28 @@ inline bool image<T>::painted() const
     return painted_;
 }
 
+template <typename T>
+inline void image<T>::set_opaque(bool opaque)
+{
+    opaque_ = opaque;
+}
+
+template <typename T>
+inline bool image<T>::opaque() const
+{
+    return opaque_;
+}
+
 template <typename T>
 inline image_dtype image<T>::get_dtype()  const
 {
     return dtype;
 }
 
+template <typename T>
+inline image_storage image<T>::storage() const
+{
+    return buffer_.storage();
+}
+
 } // end ns
@@ -0,0 +1,81 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_IMAGE_KERNELS_HPP
+#define MAPNIK_IMAGE_KERNELS_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+
+// stl
+#include <cstdint>
+#include <cstddef>
+
+namespace mapnik { namespace simd {
+
+enum class isa : int
+{
+    scalar,
+    sse2,
+    avx2,
+    neon
+};
+
+// Pixel loops over packed rgba8 pixels (r in the low byte, a in the high one).
+// Every variant gives the very same bytes as the scalar one, which matches agg.
+struct rgba8_kernels
+{
+    isa id;
+    char const* name;
+    // agg multiplier_rgba premultiply / demultiply
+    void (*premultiply)(std::uint32_t * pixels, std::size_t count);
+    void (*demultiply)(std::uint32_t * pixels, std::size_t count);
+    // alpha = alpha * opacity, opacity in [0, 1], non premultiplied pixels
+    void (*apply_opacity)(std::uint32_t * pixels, std::size_t count, float opacity);
+    // whether all pixels equal value
+    bool (*all_equal)(std::uint32_t const* pixels, std::size_t count, std::uint32_t value);
+    // zeroes the pixels whose rgb (alpha ignored) equal the low 24 bits of rgb
+    void (*set_color_to_alpha)(std::uint32_t * pixels, std::size_t count, std::uint32_t rgb);
+};
+
+/*!
+ * \brief the kernels in use, the best ones the running cpu supports unless
+ * select() changed them.
+ */
+MAPNIK_DECL rgba8_kernels const& rgba8();
+
+// the kernels of one instruction set, the scalar ones when it is not supported
+MAPNIK_DECL rgba8_kernels const& rgba8(isa id);
+
+// whether this build has the instruction set and the running cpu supports it
+MAPNIK_DECL bool supported(isa id);
+
+/*!
+ * \brief switch the kernels rgba8() returns, for benchmarks and tests.
+ * Returns false and changes nothing when the instruction set is not supported.
+ */
+MAPNIK_DECL bool select(isa id);
+
+}}
+
+#endif // MAPNIK_IMAGE_KERNELS_HPP
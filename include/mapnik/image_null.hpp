@@ -68,6 +68,8 @@ public:
     void set_premultiplied(bool) {}
     void painted(bool) {}
     bool painted() const { return false; }
+    void set_opaque(bool) {}
+    bool opaque() const { return false; }
     image_dtype get_dtype() const { return dtype; }
 };
 
@@ -66,6 +66,30 @@ struct MAPNIK_DECL image_reader : private util::noncopyable
     virtual boost::optional<box2d<double> > bounding_box() const = 0;
     virtual void read(unsigned x,unsigned y,image_rgba8& image) = 0;
     virtual image_any read(unsigned x, unsigned y, unsigned width, unsigned height) = 0;
+    // Number of threads a reader may use to decode a single read() call,
+    // readers that cannot decode in parallel ignore it.
+    virtual void set_decode_threads(unsigned) {}
+    // Makes read() return rgba8 pixels premultiplied and marked so. Rows
+    // are premultiplied as they are decoded, opaque images only marked.
+    // Readers that cannot leave their pixels straight.
+    virtual void set_premultiply(bool) {}
+    // Largest power of two, with every smaller one, the reader can divide
+    // the image size by while decoding, at a fraction of the cost of a full
+    // size read().
+    virtual unsigned max_reduction() const { return 1; }
+    // Whether the reductions are copies stored in the file, as the overviews
+    // of a cloud optimized GeoTIFF, rather than made while decoding. Reading
+    // them is cheaper still and loses nothing against resampling.
+    virtual bool has_overviews() const { return false; }
+    // Reads a window of the image reduced to ceil(width() / reduction) x
+    // ceil(height() / reduction) pixels, the window being given in reduced
+    // pixels. A reduction of 1 reads like read().
+    virtual image_any read_reduced(unsigned x, unsigned y, unsigned width, unsigned height,
+                                   unsigned reduction)
+    {
+        if (reduction != 1) throw image_reader_exception("image reader: reduced reads are not supported");
+        return read(x, y, width, height);
+    }
     virtual ~image_reader() {}
 };
 
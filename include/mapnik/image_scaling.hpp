@@ -63,6 +63,8 @@ enum scaling_method_e
 MAPNIK_DECL boost::optional<scaling_method_e> scaling_method_from_string(std::string const& name);
 MAPNIK_DECL boost::optional<std::string> scaling_method_to_string(scaling_method_e scaling_method);
 
+// Rows are split between up to `threads` threads for large targets,
+// the result does not depend on the thread count.
 template <typename T>
 MAPNIK_DECL void scale_image_agg(T & target, T const& source,
                                  scaling_method_e scaling_method,
@@ -71,7 +73,8 @@ MAPNIK_DECL void scale_image_agg(T & target, T const& source,
                                  double x_off_f,
                                  double y_off_f,
                                  double filter_factor,
-                                 boost::optional<double> const & nodata_value);
+                                 boost::optional<double> const & nodata_value,
+                                 unsigned threads = 1);
 template <typename T>
 inline void scale_image_agg(T & target, T const& source,
                                  scaling_method_e scaling_method,
@@ -0,0 +1,113 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_IMAGE_TILE_CACHE_HPP
+#define MAPNIK_IMAGE_TILE_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/image_any.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+
+namespace mapnik
+{
+
+// Process wide cache of decoded image files, keyed by file name, format,
+// modification time and size, so raster sources tiled over many files
+// decode each of them once for all the map tiles overlapping it. The least
+// recently used images are evicted once more than max_bytes() of pixels
+// are held; a budget of 0 (the default) disables the cache.
+class MAPNIK_DECL image_tile_cache :
+        public singleton<image_tile_cache, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<image_tile_cache>;
+public:
+    using image_ptr = std::shared_ptr<image_any const>;
+    // file, format, mtime and size
+    using key_type = std::tuple<std::string, std::string, std::time_t, std::uintmax_t>;
+
+    // most prefetch() decodes queued at once
+    static constexpr std::size_t max_pending = 64;
+
+    void set_max_bytes(std::size_t max_bytes);
+    std::size_t max_bytes() const;
+
+    // Returns the decoded image of file, decoding it when it is not cached.
+    // Null when no reader handles format, throws what the reader throws.
+    image_ptr get(std::string const& file, std::string const& format,
+                  unsigned decode_threads = 1);
+    // Decodes file into the cache on a query_scheduler thread, unless it is
+    // cached or queued already. A no-op without a budget or worker threads.
+    void prefetch(std::string const& file, std::string const& format,
+                  unsigned decode_threads = 1);
+
+    // copy of the width x height window of image at x, y
+    static image_any window(image_any const& image, std::size_t x, std::size_t y,
+                            std::size_t width, std::size_t height);
+
+    std::size_t size() const;
+    std::size_t size_bytes() const;
+    std::size_t hits() const;
+    std::size_t misses() const;
+    void clear();
+
+private:
+    image_tile_cache();
+    image_ptr find(key_type const& key);
+    void insert(key_type const& key, image_ptr const& image);
+    void evict();
+
+    struct entry
+    {
+        image_ptr image;
+        std::list<key_type>::iterator lru;
+    };
+
+    std::map<key_type, entry> entries_;
+    // most recently used first
+    std::list<key_type> lru_;
+    // keys queued by prefetch()
+    std::set<key_type> pending_;
+    std::size_t max_bytes_;
+    std::size_t num_bytes_;
+    std::size_t hits_;
+    std::size_t misses_;
+};
+
+extern template class MAPNIK_DECL singleton<image_tile_cache, CreateStatic>;
+
+}
+
+#endif // MAPNIK_IMAGE_TILE_CACHE_HPP
@@ -37,6 +37,7 @@
 // stl
 #include <string>
 #include <exception>
+#include <vector>
 
 namespace mapnik {
 
@@ -46,6 +47,7 @@ struct image_any;
 template <typename T> class image;
 struct image_view_any;
 template <typename T> class image_view;
+template <typename T> class box2d;
 class color;
 
 class image_writer_exception : public std::exception
@@ -85,6 +87,8 @@ MAPNIK_DECL void save_to_file(T const& image,
                               std::string const& filename,
                               rgba_palette const& palette);
 
+// Solid rgba8 images are encoded once per format, size and color and then
+// served from the solid_tile_cache, as by save_to_buffer below.
 template <typename T>
 MAPNIK_DECL std::string save_to_string(T const& image,
                                        std::string const& type);
@@ -94,6 +98,26 @@ MAPNIK_DECL std::string save_to_string(T const& image,
                                        std::string const& type,
                                        rgba_palette const& palette);
 
+// Appends the encoding of image to buffer. png, jpeg and webp are written
+// straight into the string, so a buffer kept across calls reuses its
+// capacity; other formats go through a std::ostringstream.
+template <typename T>
+MAPNIK_DECL void save_to_buffer(T const& image,
+                                std::string & buffer,
+                                std::string const& type);
+
+// Encodes the tiles of a tile_width x tile_height grid over image, e.g.
+// the slices of a metatile, on up to `threads` threads. Buffers come back
+// row by row, tiles on the right and bottom edges are clipped to the image.
+// With share_palette all tiles of a paletted png format get one palette
+// built from the whole image (by the m=hist quantizer).
+MAPNIK_DECL std::vector<std::string> save_tiles_to_string(image<rgba8_t> const& image,
+                                                          std::string const& type,
+                                                          unsigned tile_width,
+                                                          unsigned tile_height,
+                                                          unsigned threads = 1,
+                                                          bool share_palette = false);
+
 template <typename T>
 MAPNIK_DECL void save_to_stream
 (
@@ -136,6 +160,11 @@ MAPNIK_DECL bool is_solid (image_view_any const& image);
 template <typename T>
 MAPNIK_DECL bool is_solid (T const& image);
 
+// PAINTED EXTENT
+// Bounding box of the pixels that are not fully transparent black, with
+// exclusive max corner, an invalid box if there are none.
+MAPNIK_DECL box2d<int> painted_extent (image<rgba8_t> const& image);
+
 // APPLY OPACITY
 MAPNIK_DECL void apply_opacity (image_any & image, float opacity);
 
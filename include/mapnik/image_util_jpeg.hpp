@@ -43,6 +43,11 @@ struct jpeg_saver
     std::string const& t_;
 };
 
+// Appends the jpeg encoding of image to out without a std::ostream in
+// between. Defined for image_rgba8 and image_view_rgba8.
+template <typename T>
+MAPNIK_DECL void save_to_jpeg_string(T const& image, std::string & out, std::string const& type);
+
 } // end ns
 
 #endif // MAPNIK_IMAGE_UTIL_JPEG_HPP
@@ -24,8 +24,11 @@
 #define MAPNIK_IMAGE_UTIL_PNG_HPP
 
 #include <mapnik/palette.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/image_view.hpp>
 
 // stl
+#include <functional>
 #include <string>
 #include <iostream>
 
@@ -52,6 +55,23 @@ struct png_saver
     std::string const& t_;
 };
 
+// Appends the png encoding of image to out without a std::ostream in
+// between; type takes the same options as save_to_stream(), e.g.
+// "png8:e=deflate". Defined for image_rgba8 and image_view_rgba8.
+template <typename T>
+MAPNIK_DECL void save_to_png_string(T const& image, std::string & out, std::string const& type);
+
+template <typename T>
+MAPNIK_DECL void save_to_png_string(T const& image, std::string & out, std::string const& type,
+                                    rgba_palette const& palette);
+
+// Returns an encoder appending views into image as png to a string, all
+// with one palette built from the whole of image. Safe to call from
+// several threads at once. Returns an empty function when type is not
+// a paletted png format.
+MAPNIK_DECL std::function<void(image_view_rgba8 const&, std::string &)>
+make_png_tile_encoder(image_rgba8 const& image, std::string const& type);
+
 } // end ns
 
 #endif // MAPNIK_IMAGE_UTIL_PNG_HPP
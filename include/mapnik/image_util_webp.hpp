@@ -23,6 +23,8 @@
 #ifndef MAPNIK_IMAGE_UTIL_WEBP_HPP
 #define MAPNIK_IMAGE_UTIL_WEBP_HPP
 
+#include <mapnik/config.hpp>
+
 // stl
 #include <string>
 #include <iostream>
@@ -39,6 +41,11 @@ struct webp_saver
     std::string const& t_;
 };
 
+// Appends the webp encoding of image to out without a std::ostream in
+// between. Defined for image_rgba8 and image_view_rgba8.
+template <typename T>
+MAPNIK_DECL void save_to_webp_string(T const& image, std::string & out, std::string const& type);
+
 } // end ns
 
 #endif // MAPNIK_IMAGE_UTIL_WEBP_HPP
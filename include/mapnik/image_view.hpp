@@ -52,6 +52,7 @@ public:
     pixel_type const* get_row(std::size_t row, std::size_t x0) const;
     T const& data() const;
     bool get_premultiplied() const;
+    bool opaque() const;
     double get_offset() const;
     double get_scaling() const;
     image_dtype get_dtype() const;
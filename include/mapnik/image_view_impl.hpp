@@ -120,6 +120,12 @@ inline bool image_view<T>::get_premultiplied() const
     return data_.get_premultiplied();
 }
 
+template <typename T>
+inline bool image_view<T>::opaque() const
+{
+    return data_.opaque();
+}
+
 template <typename T>
 inline double image_view<T>::get_offset() const
 {
@@ -55,6 +55,7 @@ public:
     const pixel_type* get_row(std::size_t) const { return nullptr; }
     const pixel_type* get_row(std::size_t, std::size_t) const { return nullptr; }
     bool get_premultiplied() const { return false; }
+    bool opaque() const { return false; }
     double get_offset() const { return 0.0; }
     double get_scaling() const { return 1.0; }
     image_dtype get_dtype() const { return dtype; }
@@ -25,9 +25,15 @@
 
 #if defined(HAVE_JPEG)
 
-#include <new>
-#include <ostream>
+// mapnik
+#include <mapnik/image_util.hpp>
+
+// stl
+#include <algorithm>
 #include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
 
 extern "C"
 {
@@ -58,7 +64,9 @@ inline boolean empty_output_buffer (j_compress_ptr cinfo)
 {
     dest_mgr * dest = reinterpret_cast<dest_mgr*>(cinfo->dest);
     dest->out->write((char*)dest->buffer, BUFFER_SIZE);
-    if (!*(dest->out)) return boolean(0);
+    // returning false would suspend the compressor, which save_as_jpeg
+    // does not resume
+    if (!*(dest->out)) throw mapnik::image_writer_exception("JPEG Writer: failed to write to stream");
     dest->pub.next_output_byte = dest->buffer;
     dest->pub.free_in_buffer = BUFFER_SIZE;
     return boolean(1);
@@ -73,42 +81,151 @@ inline void term_destination( j_compress_ptr cinfo)
         dest->out->write((char*)dest->buffer, size);
     }
     dest->out->flush();
+    if (!*(dest->out)) throw mapnik::image_writer_exception("JPEG Writer: failed to write to stream");
+}
+
+// compresses straight into the tail of a std::string, growing it as needed
+typedef struct
+{
+    struct jpeg_destination_mgr pub;
+    std::string * out;
+    std::size_t start;
+} string_dest_mgr;
+
+inline void init_string_destination(j_compress_ptr cinfo)
+{
+    string_dest_mgr * dest = reinterpret_cast<string_dest_mgr*>(cinfo->dest);
+    dest->start = dest->out->size();
+    dest->out->resize(dest->start + BUFFER_SIZE);
+    dest->pub.next_output_byte = reinterpret_cast<JOCTET*>(&(*dest->out)[dest->start]);
+    dest->pub.free_in_buffer = BUFFER_SIZE;
+}
+
+inline boolean empty_string_buffer(j_compress_ptr cinfo)
+{
+    string_dest_mgr * dest = reinterpret_cast<string_dest_mgr*>(cinfo->dest);
+    std::size_t used = dest->out->size();
+    dest->out->resize(used + std::max<std::size_t>(used - dest->start, BUFFER_SIZE));
+    dest->pub.next_output_byte = reinterpret_cast<JOCTET*>(&(*dest->out)[used]);
+    dest->pub.free_in_buffer = dest->out->size() - used;
+    return boolean(1);
+}
+
+inline void term_string_destination(j_compress_ptr cinfo)
+{
+    string_dest_mgr * dest = reinterpret_cast<string_dest_mgr*>(cinfo->dest);
+    dest->out->resize(dest->out->size() - dest->pub.free_in_buffer);
+}
+
+inline void on_error(j_common_ptr cinfo)
+{
+    char buffer[JMSG_LENGTH_MAX];
+    (*cinfo->err->format_message)(cinfo, buffer);
+    throw mapnik::image_writer_exception(std::string("JPEG Writer: libjpeg could not write image: ") + buffer);
+}
+
+// Setting up a jpeg_compress_struct allocates its memory pools and
+// tables, so each thread keeps one and reuses it for every image.
+struct compressor
+{
+    compressor()
+    {
+        cinfo.err = jpeg_std_error(&jerr);
+        jerr.error_exit = on_error;
+        jpeg_create_compress(&cinfo);
+        stream_dest.pub.init_destination = init_destination;
+        stream_dest.pub.empty_output_buffer = empty_output_buffer;
+        stream_dest.pub.term_destination = term_destination;
+        string_dest.pub.init_destination = init_string_destination;
+        string_dest.pub.empty_output_buffer = empty_string_buffer;
+        string_dest.pub.term_destination = term_string_destination;
+    }
+
+    ~compressor()
+    {
+        jpeg_destroy_compress(&cinfo);
+    }
+
+    compressor(compressor const&) = delete;
+    compressor & operator=(compressor const&) = delete;
+
+    void set_destination(std::ostream & out)
+    {
+        stream_dest.out = &out;
+        cinfo.dest = &stream_dest.pub;
+    }
+
+    void set_destination(std::string & out)
+    {
+        string_dest.out = &out;
+        cinfo.dest = &string_dest.pub;
+    }
+
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    dest_mgr stream_dest;
+    string_dest_mgr string_dest;
+    std::vector<JSAMPLE> row;
+};
+
+inline compressor & thread_compressor()
+{
+    static thread_local compressor instance;
+    return instance;
 }
 
+// Aborts the compression under way unless finished() was called, so a
+// thread's compressor is ready for its next image after a failed one.
+class abort_guard
+{
+public:
+    explicit abort_guard(jpeg_compress_struct & cinfo)
+        : cinfo_(cinfo),
+          finished_(false) {}
+
+    ~abort_guard()
+    {
+        if (!finished_) jpeg_abort_compress(&cinfo_);
+    }
+
+    abort_guard(abort_guard const&) = delete;
+    abort_guard & operator=(abort_guard const&) = delete;
+
+    void finished() { finished_ = true; }
+
+private:
+    jpeg_compress_struct & cinfo_;
+    bool finished_;
+};
+
 }
 
 namespace mapnik {
 
+// T1 is a std::ostream or a std::string to append to
 template <typename T1, typename T2>
 void save_as_jpeg(T1 & file,int quality, T2 const& image)
 {
-    struct jpeg_compress_struct cinfo;
-    struct jpeg_error_mgr jerr;
+    jpeg_detail::compressor & comp = jpeg_detail::thread_compressor();
+    struct jpeg_compress_struct & cinfo = comp.cinfo;
 
     int width = static_cast<int>(image.width());
     int height = static_cast<int>(image.height());
 
-    cinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_compress(&cinfo);
-
-    cinfo.dest = (struct jpeg_destination_mgr *)(*cinfo.mem->alloc_small)
-        ((j_common_ptr) &cinfo, JPOOL_PERMANENT, sizeof(jpeg_detail::dest_mgr));
-    jpeg_detail::dest_mgr * dest = reinterpret_cast<jpeg_detail::dest_mgr*>(cinfo.dest);
-    dest->pub.init_destination = jpeg_detail::init_destination;
-    dest->pub.empty_output_buffer = jpeg_detail::empty_output_buffer;
-    dest->pub.term_destination = jpeg_detail::term_destination;
-    dest->out = &file;
+    comp.set_destination(file);
 
     //jpeg_stdio_dest(&cinfo, fp);
     cinfo.image_width = width;
     cinfo.image_height = height;
     cinfo.input_components = 3;
     cinfo.in_color_space = JCS_RGB;
+    jpeg_detail::abort_guard guard(cinfo);
     jpeg_set_defaults(&cinfo);
     jpeg_set_quality(&cinfo, quality, boolean(1));
     jpeg_start_compress(&cinfo, boolean(1));
     JSAMPROW row_pointer[1];
-    JSAMPLE* row=reinterpret_cast<JSAMPLE*>( ::operator new (sizeof(JSAMPLE) * width*3));
+    comp.row.resize(width * 3);
+    JSAMPLE* row = comp.row.data();
     while (cinfo.next_scanline < cinfo.image_height)
     {
         const unsigned* imageRow=image.get_row(cinfo.next_scanline);
@@ -122,10 +239,9 @@ void save_as_jpeg(T1 & file,int quality, T2 const& image)
         row_pointer[0] = &row[0];
         (void) jpeg_write_scanlines(&cinfo, row_pointer, 1);
     }
-    ::operator delete(row);
 
     jpeg_finish_compress(&cinfo);
-    jpeg_destroy_compress(&cinfo);
+    guard.finished();
 }
 }
 
@@ -224,8 +224,21 @@ auto const assign_collection = [] (auto const& ctx)
     std::get<2>(_val(ctx)) = std::move(_attr(ctx));
 };
 
+// without a properties_tag every property is kept
+inline bool keep_property(x3::unused_type, std::string const&)
+{
+    return true;
+}
+
+inline bool keep_property(std::reference_wrapper<property_names const> names, std::string const& name)
+{
+    return names.get().count(name) != 0;
+}
+
 auto assign_property = [](auto const& ctx)
 {
+    // skipped properties are never transcoded
+    if (!keep_property(x3::get<grammar::properties_tag>(ctx), std::get<0>(_attr(ctx)))) return;
     mapnik::feature_impl & feature = x3::get<grammar::feature_tag>(ctx);
     mapnik::transcoder const& tr = x3::get<grammar::transcoder_tag>(ctx);
     feature.put_new(std::get<0>(_attr(ctx)),
@@ -0,0 +1,110 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_JSON_GEOJSON_STREAM_READER_HPP
+#define MAPNIK_JSON_GEOJSON_STREAM_READER_HPP
+
+// mapnik
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mapnik { namespace json {
+
+/*!
+ * \brief reads the features of a GeoJSON document one at a time
+ *
+ * The input is pulled in chunks and scanned for the structure of the
+ * document only: each element of the "features" array of a top-level
+ * FeatureCollection, or a top-level Feature, is handed out as its own json
+ * text, ready for parse_feature(). Memory is bounded by the chunk and the
+ * largest feature, whatever the size of the document, so piped or inline
+ * sources need not be held whole.
+ *
+ * Top-level documents may follow each other (GeoJSON text sequences),
+ * other top-level objects yield no features. Structural errors (unbalanced
+ * brackets, truncated input) throw std::runtime_error, the features
+ * themselves are not validated.
+ */
+class geojson_stream_reader : private util::noncopyable
+{
+public:
+    // fills the buffer with up to size bytes, returns 0 at the end of the input
+    using read_function = std::function<std::size_t(char * buffer, std::size_t size)>;
+
+    static constexpr std::size_t default_chunk_size = 65536;
+
+    explicit geojson_stream_reader(read_function read,
+                                   std::size_t chunk_size = default_chunk_size);
+    // reads the file from its current position, the file is not closed
+    explicit geojson_stream_reader(std::FILE * file,
+                                   std::size_t chunk_size = default_chunk_size);
+    // the range must outlive the reader
+    geojson_stream_reader(char const* start, char const* end,
+                          std::size_t chunk_size = default_chunk_size);
+
+    /*!
+     * \brief the next feature as json text
+     *
+     * Returns false once the input is exhausted, feature is left empty then.
+     */
+    bool next(std::string & feature);
+
+    // bytes consumed from the input so far
+    std::size_t position() const { return offset_ + pos_; }
+
+private:
+    bool fill();
+    bool consume(char c, std::string & feature);
+
+    read_function read_;
+    std::vector<char> chunk_;
+    std::size_t pos_ = 0;
+    std::size_t size_ = 0;
+    std::size_t offset_ = 0;
+    bool done_ = false;
+    // structure of the document
+    std::size_t depth_ = 0;
+    bool in_string_ = false;
+    bool escape_ = false;
+    bool expect_value_ = false;
+    bool in_features_ = false;
+    bool capture_ = false;
+    bool capture_top_ = false;
+    // short strings of the top-level object: member names and the type
+    std::string string_;
+    std::string last_string_;
+    std::string key_;
+    std::string type_;
+    // the top-level object, until it is known not to be a Feature
+    std::string top_;
+};
+
+}}
+
+#endif // MAPNIK_JSON_GEOJSON_STREAM_READER_HPP
@@ -0,0 +1,49 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_JSON_GEOJSON_WRITER_HPP
+#define MAPNIK_JSON_GEOJSON_WRITER_HPP
+
+// mapnik
+#include <mapnik/geometry.hpp>
+#include <mapnik/feature.hpp>
+// stl
+#include <iosfwd>
+#include <string>
+
+namespace mapnik { namespace json {
+
+// Write GeoJSON straight to the output, appending to a string or writing
+// to a stream, without intermediate strings or per feature allocations.
+// Coordinates and floating point properties are written as the shortest
+// text reading back as the same double; geometry_empty as null.
+void write_geojson(std::string & json, mapnik::geometry::geometry<double> const& geom);
+void write_geojson(std::ostream & out, mapnik::geometry::geometry<double> const& geom);
+
+// A Feature object: id, geometry and the properties which are not null.
+void write_geojson(std::string & json, mapnik::feature_impl const& feature);
+void write_geojson(std::ostream & out, mapnik::feature_impl const& feature);
+
+}}
+
+#endif // MAPNIK_JSON_GEOJSON_WRITER_HPP
@@ -34,6 +34,10 @@
 #include <boost/assign/list_of.hpp>
 #pragma GCC diagnostic pop
 
+// stl
+#include <set>
+#include <string>
+
 namespace mapnik { namespace json {
 
 enum well_known_names
@@ -82,6 +86,10 @@ namespace grammar {
 struct keys_tag;
 struct transcoder_tag;
 struct feature_tag;
+struct properties_tag;
+
+// names of the properties to build, others are skipped
+using property_names = std::set<std::string>;
 
 namespace x3 = boost::spirit::x3;
 using space_type = x3::standard::space_type;
@@ -105,6 +113,14 @@ using feature_context_const_type = x3::with_context<feature_tag,
                                                                      std::reference_wrapper<mapnik::transcoder const> const,
                                                                      phrase_parse_context_type>::type>::type;
 
+using feature_properties_context_type = x3::with_context<feature_tag,
+                                                         std::reference_wrapper<mapnik::feature_impl> const,
+                                                         x3::with_context<transcoder_tag,
+                                                                          std::reference_wrapper<mapnik::transcoder const> const,
+                                                                          x3::with_context<properties_tag,
+                                                                                           std::reference_wrapper<property_names const> const,
+                                                                                           phrase_parse_context_type>::type>::type>::type;
+
 // helper macro
 #define BOOST_SPIRIT_INSTANTIATE_UNUSED(rule_type, Iterator, Context)   \
     template bool parse_rule<Iterator, Context, boost::spirit::x3::unused_type const>( \
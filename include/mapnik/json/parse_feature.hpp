@@ -27,11 +27,21 @@
 #include <mapnik/feature.hpp>
 #include <mapnik/unicode.hpp>
 
+// stl
+#include <set>
+#include <string>
+
 namespace mapnik { namespace json {
 
 template <typename Iterator>
 void parse_feature(Iterator start, Iterator end, feature_impl& feature, mapnik::transcoder const& tr = mapnik::transcoder("utf8"));
 
+// Only builds the properties listed in names, the rest are parsed and
+// dropped without being converted to values.
+template <typename Iterator>
+void parse_feature(Iterator start, Iterator end, feature_impl& feature, mapnik::transcoder const& tr,
+                   std::set<std::string> const& names);
+
 template <typename Iterator>
 void parse_geometry(Iterator start, Iterator end, feature_impl& feature);
 
@@ -32,13 +32,75 @@
 #include <mapnik/geometry/boost_adapters.hpp>
 #include <mapnik/geometry/correct.hpp>
 
+// stl
+#include <memory>
+#include <vector>
+
 namespace mapnik { namespace topojson {
 
+// Arcs of a topology decoded once, with the quantization transform
+// applied when there is one, stored back to back together with their
+// bounding boxes. Shared by the visitors below across features.
+class decoded_arcs
+{
+public:
+    explicit decoded_arcs(topology const& topo)
+    {
+        std::size_t num_points = 0;
+        for (auto const& arc : topo.arcs) num_points += arc.coordinates.size();
+        coords_.reserve(num_points);
+        offsets_.reserve(topo.arcs.size() + 1);
+        extents_.reserve(topo.arcs.size());
+        offsets_.push_back(0);
+        for (auto const& arc : topo.arcs)
+        {
+            box2d<double> extent;
+            double px = 0, py = 0;
+            for (auto const& pt : arc.coordinates)
+            {
+                double x = pt.x;
+                double y = pt.y;
+                if (topo.tr)
+                {
+                    transform const& tr = *topo.tr;
+                    x =  (px += x) * tr.scale_x + tr.translate_x;
+                    y =  (py += y) * tr.scale_y + tr.translate_y;
+                }
+                coords_.push_back(coordinate{x, y});
+                if (extent.valid()) extent.expand_to_include(x, y);
+                else extent.init(x, y, x, y);
+            }
+            offsets_.push_back(coords_.size());
+            extents_.push_back(extent);
+        }
+    }
+
+    std::size_t size() const { return extents_.size(); }
+    coordinate const* begin(std::size_t arc) const { return coords_.data() + offsets_[arc]; }
+    coordinate const* end(std::size_t arc) const { return coords_.data() + offsets_[arc + 1]; }
+    std::size_t num_points(std::size_t arc) const { return offsets_[arc + 1] - offsets_[arc]; }
+    box2d<double> const& extent(std::size_t arc) const { return extents_[arc]; }
+
+private:
+    std::vector<coordinate> coords_;
+    std::vector<std::size_t> offsets_;
+    std::vector<box2d<double>> extents_;
+};
+
+using decoded_arcs_ptr = std::shared_ptr<decoded_arcs const>;
+
 struct bounding_box_visitor
 {
     bounding_box_visitor(topology const& topo)
         : topo_(topo),
-          num_arcs_(topo_.arcs.size()) {}
+          owned_arcs_(std::make_shared<decoded_arcs>(topo)),
+          arcs_(*owned_arcs_),
+          num_arcs_(arcs_.size()) {}
+
+    bounding_box_visitor(topology const& topo, decoded_arcs const& arcs)
+        : topo_(topo),
+          arcs_(arcs),
+          num_arcs_(arcs_.size()) {}
 
     box2d<double> operator() (mapnik::topojson::empty const&) const
     {
@@ -87,79 +149,16 @@ struct bounding_box_visitor
     box2d<double> operator() (mapnik::topojson::linestring const& line) const
     {
         box2d<double> bbox;
-        bool first = true;
-        if (num_arcs_ > 0)
-        {
-            for (auto index : line.rings)
-            {
-                index_type arc_index = index < 0 ? std::abs(index) - 1 : index;
-                if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
-                {
-
-                    double px = 0, py = 0;
-                    auto const& arcs = topo_.arcs[arc_index];
-                    for (auto pt : arcs.coordinates)
-                    {
-                        double x = pt.x;
-                        double y = pt.y;
-                        if (topo_.tr)
-                        {
-                            x =  (px += x) * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                            y =  (py += y) * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-                        }
-                        if (first)
-                        {
-                            first = false;
-                            bbox.init(x, y, x, y);
-                        }
-                        else
-                        {
-                            bbox.expand_to_include(x, y);
-                        }
-                    }
-                }
-            }
-        }
+        expand(bbox, line.rings);
         return bbox;
     }
 
     box2d<double> operator() (mapnik::topojson::multi_linestring const& multi_line) const
     {
         box2d<double> bbox;
-        if (num_arcs_ > 0)
+        for (auto const& line : multi_line.lines)
         {
-            bool first = true;
-            for (auto const& line : multi_line.lines)
-            {
-                for (auto index : line)
-                {
-                    index_type arc_index = index < 0 ? std::abs(index) - 1 : index;
-                    if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
-                    {
-                        double px = 0, py = 0;
-                        auto const& arcs = topo_.arcs[arc_index];
-                        for (auto pt : arcs.coordinates)
-                        {
-                            double x = pt.x;
-                            double y = pt.y;
-                            if (topo_.tr)
-                            {
-                                x =  (px += x) * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                                y =  (py += y) * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-                            }
-                            if (first)
-                            {
-                                first = false;
-                                bbox.init(x, y, x, y);
-                            }
-                            else
-                            {
-                                bbox.expand_to_include(x, y);
-                            }
-                        }
-                    }
-                }
-            }
+            expand(bbox, line);
         }
         return bbox;
     }
@@ -167,42 +166,9 @@ struct bounding_box_visitor
     box2d<double> operator() (mapnik::topojson::polygon const& poly) const
     {
         box2d<double> bbox;
-        if (num_arcs_ > 0)
+        for (auto const& ring : poly.rings)
         {
-            bool first = true;
-            for (auto const& ring : poly.rings)
-            {
-                for (auto index : ring)
-                {
-                    index_type arc_index = index < 0 ? std::abs(index) - 1 : index;
-                    if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
-                    {
-                        double px = 0, py = 0;
-                        auto const& arcs = topo_.arcs[arc_index];
-                        for (auto const& pt : arcs.coordinates)
-                        {
-                            double x = pt.x;
-                            double y = pt.y;
-
-                            if (topo_.tr)
-                            {
-                                x =  (px += x) * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                                y =  (py += y) * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-                            }
-
-                            if (first)
-                            {
-                                first = false;
-                                bbox.init( x, y, x, y);
-                            }
-                            else
-                            {
-                                bbox.expand_to_include(x, y);
-                            }
-                        }
-                    }
-                }
-            }
+            expand(bbox, ring);
         }
         return bbox;
     }
@@ -210,50 +176,34 @@ struct bounding_box_visitor
     box2d<double> operator() (mapnik::topojson::multi_polygon const& multi_poly) const
     {
         box2d<double> bbox;
-        if (num_arcs_ > 0)
+        for (auto const& poly : multi_poly.polygons)
         {
-            bool first = true;
-            for (auto const& poly : multi_poly.polygons)
+            for (auto const& ring : poly)
             {
-                for (auto const& ring : poly)
-                {
-                    for (auto index : ring)
-                    {
-                        index_type arc_index = index < 0 ? std::abs(index) - 1 : index;
-                        if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
-                        {
-                            double px = 0, py = 0;
-                            auto const& arcs = topo_.arcs[arc_index];
-                            for (auto const& pt : arcs.coordinates)
-                            {
-                                double x = pt.x;
-                                double y = pt.y;
-
-                                if (topo_.tr)
-                                {
-                                    x =  (px += x) * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                                    y =  (py += y) * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-                                }
-
-                                if (first)
-                                {
-                                    first = false;
-                                    bbox.init( x, y, x, y);
-                                }
-                                else
-                                {
-                                    bbox.expand_to_include(x, y);
-                                }
-                            }
-                        }
-                    }
-                }
+                expand(bbox, ring);
             }
         }
         return bbox;
     }
 private:
+    void expand(box2d<double> & bbox, std::vector<index_type> const& indices) const
+    {
+        for (auto index : indices)
+        {
+            index_type arc_index = index < 0 ? std::abs(index) - 1 : index;
+            if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
+            {
+                box2d<double> const& extent = arcs_.extent(arc_index);
+                if (!extent.valid()) continue;
+                if (bbox.valid()) bbox.expand_to_include(extent);
+                else bbox = extent;
+            }
+        }
+    }
+
     topology const& topo_;
+    decoded_arcs_ptr owned_arcs_;
+    decoded_arcs const& arcs_;
     std::size_t num_arcs_;
 };
 
@@ -280,7 +230,18 @@ struct feature_generator
         : ctx_(ctx),
           tr_(tr),
           topo_(topo),
-          num_arcs_(topo.arcs.size()),
+          owned_arcs_(std::make_shared<decoded_arcs>(topo)),
+          arcs_(*owned_arcs_),
+          num_arcs_(arcs_.size()),
+          feature_id_(feature_id) {}
+
+    feature_generator(Context & ctx,  mapnik::transcoder const& tr, topology const& topo,
+                      decoded_arcs const& arcs, std::size_t feature_id)
+        : ctx_(ctx),
+          tr_(tr),
+          topo_(topo),
+          arcs_(arcs),
+          num_arcs_(arcs_.size()),
           feature_id_(feature_id) {}
 
     feature_ptr operator() (point const& pt) const
@@ -326,28 +287,7 @@ struct feature_generator
         if (num_arcs_ > 0)
         {
             mapnik::geometry::line_string<double> line_string;
-
-            for (auto index : line.rings)
-            {
-                index_type arc_index = index < 0 ? std::abs(index) - 1 : index;
-                if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
-                {
-                    auto const& arcs = topo_.arcs[arc_index];
-                    double px = 0, py = 0;
-                    line_string.reserve(line_string.size() + arcs.coordinates.size());
-                    for (auto pt : arcs.coordinates)
-                    {
-                        double x = pt.x;
-                        double y = pt.y;
-                        if (topo_.tr)
-                        {
-                            x =  (px += x) * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                            y =  (py += y) * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-                        }
-                        line_string.emplace_back(x,y);
-                    }
-                }
-            }
+            append_line(line_string, line.rings);
             feature->set_geometry(std::move(line_string));
             assign_properties(*feature, line, tr_);
         }
@@ -360,34 +300,12 @@ struct feature_generator
         if (num_arcs_ > 0)
         {
             mapnik::geometry::multi_line_string<double> multi_line_string;
+            multi_line_string.reserve(multi_line.lines.size());
             bool hit = false;
             for (auto const& line : multi_line.lines)
             {
-                multi_line_string.reserve(multi_line_string.size() + line.size());
                 mapnik::geometry::line_string<double> line_string;
-                for (auto index : line)
-                {
-                    index_type arc_index = index < 0 ? std::abs(index) - 1 : index;
-                    if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
-                    {
-                        hit = true;
-                        double px = 0, py = 0;
-                        auto const& arcs = topo_.arcs[arc_index];
-                        line_string.reserve(line_string.size() + arcs.coordinates.size());
-                        for (auto pt : arcs.coordinates)
-                        {
-                            double x = pt.x;
-                            double y = pt.y;
-                            if (topo_.tr)
-                            {
-                                x =  (px += x) * (*topo_.tr).scale_x + (*topo_.tr).translate_x;
-                                y =  (py += y) * (*topo_.tr).scale_y + (*topo_.tr).translate_y;
-                            }
-                            line_string.emplace_back(x, y);
-                        }
-
-                    }
-                }
+                hit = append_line(line_string, line) || hit;
                 multi_line_string.push_back(std::move(line_string));
             }
             if (hit)
@@ -404,55 +322,13 @@ struct feature_generator
         mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
         if (num_arcs_ > 0)
         {
-            std::vector<mapnik::topojson::coordinate> processed_coords;
             mapnik::geometry::polygon<double> polygon;
             polygon.reserve(poly.rings.size());
             bool hit = false;
             for (auto const& ring : poly.rings)
             {
                 mapnik::geometry::linear_ring<double> linear_ring;
-                for (auto const& index : ring)
-                {
-                    double px = 0, py = 0;
-                    bool reverse = index < 0;
-                    index_type arc_index = reverse ? std::abs(index) - 1 : index;
-                    if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
-                    {
-                        hit = true;
-                        auto const& arcs = topo_.arcs[arc_index];
-                        auto const& coords = arcs.coordinates;
-                        processed_coords.clear();
-                        processed_coords.reserve(coords.size());
-                        for (auto const& pt : coords )
-                        {
-                            double x = pt.x;
-                            double y = pt.y;
-
-                            if (topo_.tr)
-                            {
-                                transform const& tr = *topo_.tr;
-                                x =  (px += x) * tr.scale_x + tr.translate_x;
-                                y =  (py += y) * tr.scale_y + tr.translate_y;
-                            }
-                            processed_coords.emplace_back(coordinate{x,y});
-                        }
-                        linear_ring.reserve(linear_ring.size() + processed_coords.size());
-                        if (reverse)
-                        {
-                            for (auto const& c : processed_coords | boost::adaptors::reversed)
-                            {
-                                linear_ring.emplace_back(c.x, c.y);
-                            }
-                        }
-                        else
-                        {
-                            for (auto const& c : processed_coords)
-                            {
-                                linear_ring.emplace_back(c.x, c.y);
-                            }
-                        }
-                    }
-                }
+                hit = append_ring(linear_ring, ring) || hit;
                 polygon.push_back(std::move(linear_ring));
             }
             if (hit)
@@ -470,7 +346,6 @@ struct feature_generator
         mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_,feature_id_));
         if (num_arcs_ > 0)
         {
-            std::vector<mapnik::topojson::coordinate> processed_coords;
             mapnik::geometry::multi_polygon<double> multi_polygon;
             multi_polygon.reserve(multi_poly.polygons.size());
             bool hit = false;
@@ -478,54 +353,10 @@ struct feature_generator
             {
                 mapnik::geometry::polygon<double> polygon;
                 polygon.reserve(poly.size());
-
                 for (auto const& ring : poly)
                 {
                     mapnik::geometry::linear_ring<double> linear_ring;
-                    for (auto const& index : ring)
-                    {
-                        double px = 0, py = 0;
-                        bool reverse = index < 0;
-                        index_type arc_index = reverse ? std::abs(index) - 1 : index;
-                        if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
-                        {
-                            hit = true;
-                            auto const& arcs = topo_.arcs[arc_index];
-                            auto const& coords = arcs.coordinates;
-                            processed_coords.clear();
-                            processed_coords.reserve(coords.size());
-                            for (auto const& pt : coords )
-                            {
-                                double x = pt.x;
-                                double y = pt.y;
-
-                                if (topo_.tr)
-                                {
-                                    transform const& tr = *topo_.tr;
-                                    x =  (px += x) * tr.scale_x + tr.translate_x;
-                                    y =  (py += y) * tr.scale_y + tr.translate_y;
-                                }
-                                processed_coords.emplace_back(coordinate{x,y});
-                            }
-
-                            using namespace boost::adaptors;
-                            linear_ring.reserve(linear_ring.size() + processed_coords.size());
-                            if (reverse)
-                            {
-                                for (auto const& c : (processed_coords | reversed))
-                                {
-                                    linear_ring.emplace_back(c.x, c.y);
-                                }
-                            }
-                            else
-                            {
-                                for (auto const& c : processed_coords)
-                                {
-                                    linear_ring.emplace_back(c.x, c.y);
-                                }
-                            }
-                        }
-                    }
+                    hit = append_ring(linear_ring, ring) || hit;
                     polygon.push_back(std::move(linear_ring));
                 }
                 multi_polygon.push_back(std::move(polygon));
@@ -546,9 +377,67 @@ struct feature_generator
         return feature_ptr();
     }
 
+private:
+    // lines take arcs as they are
+    bool append_line(mapnik::geometry::line_string<double> & line_string, std::vector<index_type> const& indices) const
+    {
+        bool hit = false;
+        for (auto index : indices)
+        {
+            index_type arc_index = index < 0 ? std::abs(index) - 1 : index;
+            if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
+            {
+                hit = true;
+                line_string.reserve(line_string.size() + arcs_.num_points(arc_index));
+                for (auto itr = arcs_.begin(arc_index), end = arcs_.end(arc_index); itr != end; ++itr)
+                {
+                    line_string.emplace_back(itr->x, itr->y);
+                }
+            }
+        }
+        return hit;
+    }
+
+    // rings follow negative indices backwards
+    bool append_ring(mapnik::geometry::linear_ring<double> & linear_ring, std::vector<index_type> const& indices) const
+    {
+        bool hit = false;
+        for (auto index : indices)
+        {
+            bool reverse = index < 0;
+            index_type arc_index = reverse ? std::abs(index) - 1 : index;
+            if (arc_index >= 0 && arc_index < static_cast<int>(num_arcs_))
+            {
+                hit = true;
+                coordinate const* begin = arcs_.begin(arc_index);
+                coordinate const* end = arcs_.end(arc_index);
+                linear_ring.reserve(linear_ring.size() + (end - begin));
+                if (reverse)
+                {
+                    while (end != begin)
+                    {
+                        --end;
+                        linear_ring.emplace_back(end->x, end->y);
+                    }
+                }
+                else
+                {
+                    for (; begin != end; ++begin)
+                    {
+                        linear_ring.emplace_back(begin->x, begin->y);
+                    }
+                }
+            }
+        }
+        return hit;
+    }
+
+public:
     Context & ctx_;
     mapnik::transcoder const& tr_;
     topology const& topo_;
+    decoded_arcs_ptr owned_arcs_;
+    decoded_arcs const& arcs_;
     std::size_t num_arcs_;
     std::size_t feature_id_;
 };
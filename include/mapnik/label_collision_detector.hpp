@@ -25,6 +25,7 @@
 
 // mapnik
 #include <mapnik/quad_tree.hpp>
+#include <mapnik/bucket_grid.hpp>
 #include <mapnik/util/noncopyable.hpp>
 #include <mapnik/value/types.hpp>
 
@@ -34,6 +35,10 @@
 #pragma GCC diagnostic pop
 
 // stl
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 namespace mapnik
@@ -127,31 +132,153 @@ public:
 };
 
 
-//quad tree based label collision detector so labels dont appear within a given distance
+// spatial index used by label_collision_detector4, selected at compile time
+#if defined(MAPNIK_LABEL_COLLISION_GRID)
+template <typename T>
+using label_index = bucket_grid<T>;
+#else
+template <typename T>
+using label_index = quad_tree<T>;
+#endif
+
+// Coarse bitmap of the cells lying wholly inside some placed label. A box
+// touching such a cell collides for sure, so most candidates in dense
+// areas are turned down on a few bit tests before the spatial index is
+// queried. Cells only partly covered are left clear and decide nothing.
+class label_occupancy_grid
+{
+public:
+    explicit label_occupancy_grid(box2d<double> const& extent, double cell_size = 8.0)
+        : extent_(extent),
+          cell_size_(cell_size),
+          cols_(std::max(1, static_cast<int>(std::ceil(extent.width() / cell_size)))),
+          rows_(std::max(1, static_cast<int>(std::ceil(extent.height() / cell_size)))),
+          words_per_row_((cols_ + 63) / 64),
+          bits_(static_cast<std::size_t>(words_per_row_) * rows_, 0) {}
+
+    void insert(box2d<double> const& box)
+    {
+        int c0 = clamp(std::ceil((box.minx() - extent_.minx()) / cell_size_), cols_);
+        int c1 = clamp(std::floor((box.maxx() - extent_.minx()) / cell_size_), cols_) - 1;
+        int r0 = clamp(std::ceil((box.miny() - extent_.miny()) / cell_size_), rows_);
+        int r1 = clamp(std::floor((box.maxy() - extent_.miny()) / cell_size_), rows_) - 1;
+        for (int r = r0; r <= r1; ++r)
+        {
+            std::uint64_t * row = &bits_[static_cast<std::size_t>(r) * words_per_row_];
+            for (int c = c0; c <= c1; ++c)
+            {
+                row[c >> 6] |= std::uint64_t(1) << (c & 63);
+            }
+        }
+    }
+
+    // whether the box touches a cell covered by a label
+    bool occupied(box2d<double> const& box) const
+    {
+        if (!box.intersects(extent_)) return false;
+        int c0 = clamp(std::floor((box.minx() - extent_.minx()) / cell_size_), cols_ - 1);
+        int c1 = clamp(std::floor((box.maxx() - extent_.minx()) / cell_size_), cols_ - 1);
+        int r0 = clamp(std::floor((box.miny() - extent_.miny()) / cell_size_), rows_ - 1);
+        int r1 = clamp(std::floor((box.maxy() - extent_.miny()) / cell_size_), rows_ - 1);
+        int w0 = c0 >> 6;
+        int w1 = c1 >> 6;
+        std::uint64_t first = ~std::uint64_t(0) << (c0 & 63);
+        std::uint64_t last = ~std::uint64_t(0) >> (63 - (c1 & 63));
+        for (int r = r0; r <= r1; ++r)
+        {
+            std::uint64_t const* row = &bits_[static_cast<std::size_t>(r) * words_per_row_];
+            for (int w = w0; w <= w1; ++w)
+            {
+                std::uint64_t mask = ~std::uint64_t(0);
+                if (w == w0) mask &= first;
+                if (w == w1) mask &= last;
+                if (row[w] & mask) return true;
+            }
+        }
+        return false;
+    }
+
+    void clear()
+    {
+        std::fill(bits_.begin(), bits_.end(), 0);
+    }
+
+private:
+    // clamped before converting, boxes may reach far outside the extent
+    static int clamp(double value, int max)
+    {
+        return static_cast<int>(std::min(std::max(value, 0.0), static_cast<double>(max)));
+    }
+
+    box2d<double> extent_;
+    double cell_size_;
+    int cols_;
+    int rows_;
+    int words_per_row_;
+    std::vector<std::uint64_t> bits_;
+};
+
+//quad tree (or bucket grid) based label collision detector so labels dont appear within a given distance
 class label_collision_detector4 : util::noncopyable
 {
 public:
     struct label
     {
-        label(box2d<double> const& b) : box(b), text() {}
-        label(box2d<double> const& b, mapnik::value_unicode_string const& t) : box(b), text(t) {}
+        label(box2d<double> const& b) : box(b), text_id(0) {}
+        label(box2d<double> const& b, unsigned id) : box(b), text_id(id) {}
 
         box2d<double> box;
-        mapnik::value_unicode_string text;
+        // interned text of the label, 0 for labels without text
+        unsigned text_id;
     };
 
 private:
-    using tree_t = quad_tree< label >;
+    using tree_t = label_index< label >;
     tree_t tree_;
+    label_occupancy_grid occupancy_;
+    // summed area of the inserted boxes within the extent
+    double covered_area_;
+    // where inserted boxes are copied to while recording
+    std::vector<box2d<double>> * recorded_;
+
+    struct text_hash
+    {
+        std::size_t operator()(mapnik::value_unicode_string const& text) const
+        {
+            return static_cast<std::size_t>(text.hashCode());
+        }
+    };
+    // Label texts are interned until the detector is cleared, and the boxes
+    // of the labels with each text are kept apart, indexed by id - 1, so
+    // repeat checks look at the labels with the same text only.
+    std::unordered_map<mapnik::value_unicode_string, unsigned, text_hash> text_ids_;
+    std::vector<std::vector<box2d<double>>> text_boxes_;
+
+    unsigned intern(mapnik::value_unicode_string const& text)
+    {
+        if (text.length() == 0) return 0;
+        auto result = text_ids_.emplace(text, static_cast<unsigned>(text_boxes_.size() + 1));
+        if (result.second) text_boxes_.emplace_back();
+        return result.first->second;
+    }
+
+    void add_coverage(box2d<double> const& box)
+    {
+        box2d<double> covered = tree_.extent().intersect(box);
+        if (covered.valid()) covered_area_ += covered.area();
+        occupancy_.insert(box);
+        if (recorded_) recorded_->push_back(box);
+    }
 
 public:
     using query_iterator = tree_t::query_iterator;
 
     explicit label_collision_detector4(box2d<double> const& _extent)
-        : tree_(_extent) {}
+        : tree_(_extent), occupancy_(_extent), covered_area_(0.0), recorded_(nullptr) {}
 
     bool has_placement(box2d<double> const& box)
     {
+        if (occupancy_.occupied(box)) return false;
         tree_t::query_iterator tree_itr = tree_.query_in_box(box);
         tree_t::query_iterator tree_end = tree_.query_end();
 
@@ -169,6 +296,7 @@ public:
                                                ? box2d<double>(box.minx() - margin, box.miny() - margin,
                                                                box.maxx() + margin, box.maxy() + margin)
                                                : box);
+        if (occupancy_.occupied(margin_box)) return false;
 
         tree_t::query_iterator tree_itr = tree_.query_in_box(margin_box);
         tree_t::query_iterator tree_end = tree_.query_end();
@@ -190,25 +318,18 @@ public:
             return has_placement(box, margin);
         }
 
-        box2d<double> repeat_box(box.minx() - repeat_distance, box.miny() - repeat_distance,
-                                 box.maxx() + repeat_distance, box.maxy() + repeat_distance);
-
-        box2d<double> const& margin_box = (margin > 0
-                                               ? box2d<double>(box.minx() - margin, box.miny() - margin,
-                                                               box.maxx() + margin, box.maxy() + margin)
-                                               : box);
+        if (!has_placement(box, margin)) return false;
 
-        tree_t::query_iterator tree_itr = tree_.query_in_box(repeat_box);
-        tree_t::query_iterator tree_end = tree_.query_end();
+        // a text never placed cannot repeat
+        auto itr = text_ids_.find(text);
+        if (itr == text_ids_.end()) return true;
 
-        for ( ;tree_itr != tree_end; ++tree_itr)
+        box2d<double> repeat_box(box.minx() - repeat_distance, box.miny() - repeat_distance,
+                                 box.maxx() + repeat_distance, box.maxy() + repeat_distance);
+        for (box2d<double> const& other : text_boxes_[itr->second - 1])
         {
-            if (tree_itr->get().box.intersects(margin_box) || (text == tree_itr->get().text && tree_itr->get().box.intersects(repeat_box)))
-            {
-                return false;
-            }
+            if (other.intersects(repeat_box)) return false;
         }
-
         return true;
     }
 
@@ -217,6 +338,7 @@ public:
         if (tree_.extent().intersects(box))
         {
             tree_.insert(label(box), box);
+            add_coverage(box);
         }
     }
 
@@ -224,13 +346,36 @@ public:
     {
         if (tree_.extent().intersects(box))
         {
-            tree_.insert(label(box, text), box);
+            unsigned id = intern(text);
+            tree_.insert(label(box, id), box);
+            if (id > 0) text_boxes_[id - 1].push_back(box);
+            add_coverage(box);
         }
     }
 
     void clear()
     {
         tree_.clear();
+        occupancy_.clear();
+        covered_area_ = 0.0;
+        recorded_ = nullptr;
+        text_ids_.clear();
+        text_boxes_.clear();
+    }
+
+    // Boxes inserted from now on are appended to boxes as well, until
+    // record() is called with null or the detector is cleared.
+    void record(std::vector<box2d<double>> * boxes)
+    {
+        recorded_ = boxes;
+    }
+
+    // fraction of the extent covered by placements, overlapping
+    // placements are counted twice
+    double coverage() const
+    {
+        double area = tree_.extent().area();
+        return area > 0.0 ? std::min(1.0, covered_area_ / area) : 1.0;
     }
 
     box2d<double> const& extent() const
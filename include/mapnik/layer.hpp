@@ -27,10 +27,12 @@
 #include <mapnik/well_known_srs.hpp>
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/image_compositing.hpp>
+#include <mapnik/enumeration.hpp>
 
 // stl
 #include <vector>
 #include <memory>
+#include <cstddef>
 
 namespace mapnik
 {
@@ -38,6 +40,25 @@ namespace mapnik
 class datasource;
 using datasource_ptr = std::shared_ptr<datasource>;
 
+// What a render does with a layer whose features go over its budget
+enum budget_policy_enum {
+    BUDGET_STOP,     // stop drawing the layer's styles at the limit
+    BUDGET_SAMPLE,   // draw an even sample when the estimate is over the limit
+    BUDGET_SIMPLIFY, // read geometry_pyramid levels when the estimate is over the limit
+    budget_policy_enum_MAX
+};
+
+DEFINE_ENUM( budget_policy_e, budget_policy_enum );
+
+// How a render draws the features of a layer
+enum aggregate_mode_enum {
+    AGGREGATE_NONE,    // every feature goes through the styles
+    AGGREGATE_DENSITY, // features are binned into one float raster feature
+    aggregate_mode_enum_MAX
+};
+
+DEFINE_ENUM( aggregate_mode_e, aggregate_mode_enum );
+
 /*!
  * @brief A Mapnik map layer.
  *
@@ -109,6 +130,11 @@ public:
 
     std::vector<layer> const& layers() const;
 
+    /*!
+     * @return the child layers (non-const version).
+     */
+    std::vector<layer> & layers();
+
     /*!
      * @param minimum_scale_denom The minimum scale denominator
      */
@@ -175,6 +201,7 @@ public:
 
     /*!
      * @param cache_features Set whether this layer's features should be cached if used by multiple styles.
+     *        Once feature_cache has a budget, they are also kept across renders.
      */
     void set_cache_features(bool cache_features);
 
@@ -183,6 +210,104 @@ public:
      */
     bool cache_features() const;
 
+    /*!
+     * @param cache_image Set whether renderers keeping a layer_image_cache may reuse this
+     *        layer's rendered image for the same view and styles instead of rendering it.
+     *        Meant for static layers; cached layers place no labels in the collision detector.
+     */
+    void set_cache_image(bool cache_image);
+
+    /*!
+     * @return whether this layer's rendered image may be cached across renders
+     */
+    bool cache_image() const;
+
+    /*!
+     * @param geometry_pyramid Set whether queries at low resolutions read simplified
+     *        copies of the datasource's geometries from the geometry_pyramid instead of
+     *        the full resolution ones. Applies to file based vector datasources only.
+     */
+    void set_geometry_pyramid(bool geometry_pyramid);
+
+    /*!
+     * @return whether low resolution queries of this layer use the geometry_pyramid
+     */
+    bool geometry_pyramid() const;
+
+    /*!
+     * @param max_features Set the most features drawn per style of this layer in a
+     *        render, 0 (the default) for no limit.
+     */
+    void set_maximum_features(std::size_t max_features);
+
+    /*!
+     * @return the most features drawn per style of this layer in a render
+     */
+    std::size_t maximum_features() const;
+
+    /*!
+     * @param max_vertices Set the most geometry vertices drawn per style of this layer
+     *        in a render, 0 (the default) for no limit.
+     */
+    void set_maximum_vertices(std::size_t max_vertices);
+
+    /*!
+     * @return the most geometry vertices drawn per style of this layer in a render
+     */
+    std::size_t maximum_vertices() const;
+
+    /*!
+     * @param milliseconds Set the time after which drawing this layer's features stops,
+     *        0 (the default) for no limit.
+     */
+    void set_maximum_render_time(double milliseconds);
+
+    /*!
+     * @return the time after which drawing this layer's features stops, in milliseconds
+     */
+    double maximum_render_time() const;
+
+    /*!
+     * @param policy Set how the budget above is kept. BUDGET_SAMPLE and BUDGET_SIMPLIFY
+     *        ask the datasource for an estimate first and sample or simplify when it is
+     *        over the feature limit; the limits stop drawing in every case.
+     */
+    void set_budget_policy(budget_policy_e policy);
+
+    /*!
+     * @return how the feature budget of this layer is kept
+     */
+    budget_policy_e budget_policy() const;
+
+    /*!
+     * @return whether any of the budget limits is set
+     */
+    bool has_budget() const;
+
+    /*!
+     * @param mode Set how this layer's features are drawn. With AGGREGATE_DENSITY the
+     *        features are counted into a float grid with a cell per rendered pixel,
+     *        and the styles draw that grid as the single raster feature of the layer,
+     *        typically through a raster-colorizer.
+     */
+    void set_aggregate(aggregate_mode_e mode);
+
+    /*!
+     * @return how this layer's features are drawn
+     */
+    aggregate_mode_e aggregate() const;
+
+    /*!
+     * @param column Set the field each feature adds to its density cell, empty (the
+     *        default) to count features.
+     */
+    void set_aggregate_weight(std::string const& column);
+
+    /*!
+     * @return the field each feature adds to its density cell
+     */
+    std::string const& aggregate_weight() const;
+
     /*!
      * @param column Set the field rendering of this layer is grouped by.
      */
@@ -232,6 +357,14 @@ private:
     bool queryable_;
     bool clear_label_cache_;
     bool cache_features_;
+    bool cache_image_;
+    bool geometry_pyramid_;
+    std::size_t maximum_features_;
+    std::size_t maximum_vertices_;
+    double maximum_render_time_;
+    budget_policy_e budget_policy_;
+    aggregate_mode_e aggregate_;
+    std::string aggregate_weight_;
     std::string group_by_;
     std::vector<std::string> styles_;
     std::vector<layer> layers_;
@@ -0,0 +1,119 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_LAYER_IMAGE_CACHE_HPP
+#define MAPNIK_LAYER_IMAGE_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace mapnik
+{
+
+class Map;
+class layer;
+
+// Process wide cache of rendered, premultiplied layer images for layers
+// with cache-image enabled, keyed by layer name, a fingerprint of its
+// styles and datasource, and the view (extent, size and scale factor).
+// The least recently used images are evicted once more than max_bytes()
+// are held. The cache is disabled until set_max_bytes() is given a budget.
+// Each image keeps the boxes of the labels its layer placed, so a map can
+// be rendered again with only the layers invalidated since redrawn.
+class MAPNIK_DECL layer_image_cache :
+        public singleton<layer_image_cache, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<layer_image_cache>;
+public:
+    using image_ptr = std::shared_ptr<image_rgba8 const>;
+    using label_boxes = std::vector<box2d<double>>;
+    // layer name, fingerprint, extent, size, scale factor and pixel offset
+    using key_type = std::tuple<std::string, std::size_t,
+                                double, double, double, double,
+                                unsigned, unsigned, double, double, double>;
+
+    // 0 disables the cache and drops all images
+    void set_max_bytes(std::size_t max_bytes);
+    std::size_t max_bytes() const;
+
+    // labels, when given, is set to the label boxes stored with the image
+    image_ptr find(key_type const& key, label_boxes * labels = nullptr);
+    void insert(key_type const& key, image_ptr const& image,
+                label_boxes labels = label_boxes());
+    std::size_t size() const;
+    void clear();
+
+    // Drops the images of the named layer, for edits the fingerprint does
+    // not see such as features changed in its datasource. Images of other
+    // layers whose labels overlap the dropped ones are dropped as well,
+    // their labels were placed around labels that may now move. Returns
+    // the number of images dropped.
+    std::size_t invalidate(std::string const& layer_name);
+
+    // Hash of everything in the map that the layer's image depends on
+    // besides the view: its styles, rules, symbolizers, image filters with
+    // their arguments, datasource, the map and layer srs and the render
+    // variables. Editing any of
+    // them yields a new fingerprint. The datasource is identified by its
+    // id() and parameters, so a new one opened at the address of a freed
+    // one does not hit the images of the old.
+    static std::size_t fingerprint(Map const& map, layer const& lay, attributes const& vars);
+
+private:
+    layer_image_cache();
+    void evict();
+
+    struct entry
+    {
+        image_ptr image;
+        label_boxes labels;
+        std::list<key_type>::iterator lru;
+    };
+
+    std::map<key_type, entry> entries_;
+    // most recently used first
+    std::list<key_type> lru_;
+    std::size_t max_bytes_;
+    std::size_t num_bytes_;
+};
+
+extern template class MAPNIK_DECL singleton<layer_image_cache, CreateStatic>;
+
+}
+
+#endif // MAPNIK_LAYER_IMAGE_CACHE_HPP
@@ -35,6 +35,17 @@ class Map;
 
 MAPNIK_DECL void load_map(Map & map, std::string const& filename, bool strict = false, std::string base_path="");
 MAPNIK_DECL void load_map_string(Map & map, std::string const& str, bool strict = false, std::string base_path="");
+
+// Load into map like load_map() and load_map_string(), but the layers whose
+// datasource parameters equal those of a layer of previous share that
+// layer's datasource instead of creating one, keeping its connections,
+// indexes and cached features. previous is left alone, so renders still
+// running on it finish undisturbed. To switch new renders over at once,
+// hold the maps in shared_ptrs and std::atomic_store the reloaded one.
+MAPNIK_DECL void reload_map(Map & map, Map const& previous, std::string const& filename,
+                            bool strict = false, std::string base_path="");
+MAPNIK_DECL void reload_map_string(Map & map, Map const& previous, std::string const& str,
+                                   bool strict = false, std::string base_path="");
 }
 
 #endif // MAPNIK_LOAD_MAP_HPP
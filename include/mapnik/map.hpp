@@ -29,6 +29,7 @@
 #include <mapnik/font_set.hpp>
 #include <mapnik/enumeration.hpp>
 #include <mapnik/geometry/box2d.hpp>
+#include <mapnik/coord.hpp>
 #include <mapnik/params.hpp>
 #include <mapnik/well_known_srs.hpp>
 #include <mapnik/image_compositing.hpp>
@@ -325,6 +326,10 @@ public:
      */
     boost::optional<color> const& background() const;
 
+    /*! \brief Remove the map background color.
+     */
+    void reset_background();
+
     /*! \brief Set the map background image filename.
      *  @param image_filename Background image filename.
      */
@@ -439,6 +444,19 @@ public:
      */
     featureset_ptr query_point(unsigned index, double x, double y) const;
 
+    /*!
+     * @brief Query a Map layer (by layer index) for the features at
+     * several points, in the coordinates of map projection.
+     *
+     * Same as query_point() for each point, but the layer's datasource
+     * is asked for all of them at once, see datasource::features_at_points().
+     *
+     * @param index The index of the layer to query from.
+     * @param pts The points where to query.
+     * @return A Mapnik Featureset per point.
+     */
+    std::vector<featureset_ptr> query_points(unsigned index, std::vector<coord2d> const& pts) const;
+
     /*!
      * @brief Query a Map layer (by layer index) for features
      *
@@ -28,9 +28,17 @@
 #include <mapnik/util/singleton.hpp>
 #include <mapnik/util/noncopyable.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#ifdef MAPNIK_THREADSAFE
+#include <shared_mutex>
+#endif
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -45,16 +53,78 @@ namespace mapnik
 
 using mapped_region_ptr = std::shared_ptr<boost::interprocess::mapped_region>;
 
+// How a mapped file is going to be read, passed to madvise() when the
+// file is mapped. Later lookups share the mapping and its advice.
+enum class mapped_access
+{
+    normal,
+    sequential, // read front to back once, e.g. to build an in-memory index
+    random,     // records picked through an index
+    will_need   // small and read in full, e.g. a spatial index
+};
+
+// Keeps mapped files across queries. Lookups of mapped files share the
+// lock and only touch their own entry. With a byte budget the least
+// recently used mappings are dropped when a file is mapped; regions
+// still in use stay mapped until released. With a check interval the
+// files looked up are stat()ed at most once per interval and remapped
+// when their modification time or size changed.
 class MAPNIK_DECL mapped_memory_cache :
         public singleton<mapped_memory_cache, CreateStatic>,
         private util::noncopyable
 {
     friend class CreateStatic<mapped_memory_cache>;
-    std::unordered_map<std::string,mapped_region_ptr> cache_;
+    struct entry
+    {
+        entry(mapped_region_ptr const& region, std::time_t mtime, std::uintmax_t size, std::int64_t now);
+        mapped_region_ptr region;
+        std::time_t mtime;
+        std::uintmax_t size;
+        // steady clock ticks of the last lookup and of the last stat()
+        std::atomic<std::int64_t> used;
+        std::atomic<std::int64_t> checked;
+        std::atomic<std::size_t> hits;
+    };
+    std::unordered_map<std::string, entry> cache_;
+#ifdef MAPNIK_THREADSAFE
+    // lookups of already mapped files, the common case while rendering,
+    // share the lock; files are mapped without holding it
+    std::shared_timed_mutex cache_mutex_;
+#endif
+    std::atomic<std::size_t> max_bytes_;
+    std::atomic<std::int64_t> check_interval_;
+    std::size_t bytes_;
+    // hits of the entries no longer cached
+    std::atomic<std::size_t> hits_;
+    std::atomic<std::size_t> misses_;
+    std::atomic<std::size_t> evictions_;
+    std::atomic<std::size_t> invalidations_;
+
+    mapped_memory_cache();
+    bool stale(std::string const& key, entry & e, std::int64_t now);
+    void erase(std::unordered_map<std::string, entry>::iterator itr);
+    void evict(std::string const& keep);
 public:
     bool insert(std::string const& key, mapped_region_ptr);
-    boost::optional<mapped_region_ptr> find(std::string const& key, bool update_cache = false);
+    boost::optional<mapped_region_ptr> find(std::string const& key, bool update_cache = false,
+                                            mapped_access access = mapped_access::normal);
     void clear();
+
+    // Bytes of mappings to keep, 0 (the default) keeps every file mapped.
+    void set_max_bytes(std::size_t max_bytes);
+    std::size_t max_bytes() const { return max_bytes_; }
+    // How often the cached files are checked for changes, 0 (the default)
+    // never checks them.
+    void set_check_interval(std::chrono::milliseconds interval);
+    std::chrono::milliseconds check_interval() const;
+
+    std::size_t size();
+    std::size_t size_bytes();
+    std::size_t hits();
+    std::size_t misses() const { return misses_; }
+    // mappings dropped for the budget and because their file changed
+    std::size_t evictions() const { return evictions_; }
+    std::size_t invalidations() const { return invalidations_; }
 };
 
 extern template class MAPNIK_DECL singleton<mapped_memory_cache, CreateStatic>;
@@ -28,27 +28,80 @@
 #include <mapnik/config.hpp>
 #include <mapnik/util/noncopyable.hpp>
 
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <list>
 #include <unordered_map>
 #include <memory>
 #include <string>
+#include <vector>
+#ifdef MAPNIK_THREADSAFE
+#include <mutex>
+#include <shared_mutex>
+#endif
 
 namespace mapnik
 {
 
 struct marker;
+class Map;
 
+// Markers are kept in independently locked shards and decoded outside of
+// any lock, so concurrent renderers only contend on short map lookups.
+// The cache is unbounded by default and lookups then share their shard's
+// lock; with a byte budget each shard evicts its least recently used
+// markers, which takes the lock exclusively to update the order. Built-in
+// shape:// and image:// markers are never evicted. Parsed SVGs keep the
+// flattened_paths of their renders, which the byte budget doesn't count.
+// On NUMA machines every node has its own set of shards: a marker missing
+// from the caller's node is copied from another node's replica rather
+// than decoded again, and the budget applies to each node.
 class MAPNIK_DECL marker_cache :
         public singleton <marker_cache, CreateUsingNew>,
         private util::noncopyable
 {
     friend class CreateUsingNew<marker_cache>;
 private:
+    static constexpr std::size_t num_shards = 16;
+    using list_type = std::list<std::string>;
+    struct entry
+    {
+        std::shared_ptr<mapnik::marker const> marker;
+        std::size_t bytes;
+        bool pinned;
+        list_type::iterator lru_pos;
+    };
+    struct shard
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::shared_timed_mutex mutex;
+#endif
+        std::unordered_map<std::string, entry> entries;
+        list_type lru; // most recently used first, unpinned entries only
+        std::size_t bytes = 0;
+        // counted per shard, so that hits don't all write one cache line
+        std::atomic<std::size_t> hits{0};
+    };
+
+    using shard_set = std::array<shard, num_shards>;
+
     marker_cache();
     ~marker_cache();
+    shard & get_shard(std::string const& key);
+    shard & get_shard(shard_set & node, std::string const& key);
+    std::shared_ptr<mapnik::marker const> find_replica(std::string const& uri);
     bool insert_marker(std::string const& key, marker && path);
-    std::unordered_map<std::string, std::shared_ptr<mapnik::marker const> > marker_cache_;
+    std::shared_ptr<mapnik::marker const> insert(std::string const& key,
+                                                 std::shared_ptr<mapnik::marker const> const& mark);
+    void evict(shard & s);
+    std::shared_ptr<mapnik::marker const> load(std::string const& uri, bool strict);
+    // one set per NUMA node, see numa::current_node()
+    std::vector<std::unique_ptr<shard_set>> nodes_;
     bool insert_svg(std::string const& name, std::string const& svg_string);
     std::unordered_map<std::string,std::string> svg_cache_;
+    std::atomic<std::size_t> max_bytes_;
+    std::atomic<std::size_t> misses_;
 public:
     std::string known_svg_prefix_;
     std::string known_image_prefix_;
@@ -57,6 +110,19 @@ public:
     bool is_image_uri(std::string const& path);
     std::shared_ptr<marker const> find(std::string const& key, bool update_cache = false, bool strict = false);
     void clear();
+
+    // Load and cache all markers referenced by constant file paths in the styles of a map.
+    // Returns the number of markers now in the cache for those paths.
+    std::size_t preload(Map const& map, bool strict = false);
+
+    // Approximate memory budget for cached markers, 0 (default) means unbounded.
+    void set_max_bytes(std::size_t bytes);
+    std::size_t max_bytes() const { return max_bytes_; }
+
+    std::size_t size();
+    std::size_t size_bytes();
+    std::size_t hits() const;
+    std::size_t misses() const { return misses_; }
 };
 
 }
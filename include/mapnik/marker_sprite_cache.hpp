@@ -0,0 +1,159 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_MARKER_SPRITE_CACHE_HPP
+#define MAPNIK_MARKER_SPRITE_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/marker.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_color_rgba.h"
+#include "agg_trans_affine.h"
+#pragma GCC diagnostic pop
+
+// stl
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace mapnik
+{
+
+// SVG markers rasterized once per shape, style, scale, rotation and
+// quarter pixel offset into premultiplied sprites, so that repeated
+// markers are blended from an image instead of rasterized again. A
+// transform is only drawn from a sprite when the quantized one moves no
+// point of the marker by more than the tolerance in pixels. When more
+// than max_bytes() are held the sprites are all dropped. Not thread
+// safe, like the agg_render_context keeping it.
+class MAPNIK_DECL marker_sprite_cache : private util::noncopyable
+{
+public:
+    // subpixel positions per pixel and axis
+    static constexpr int phase_steps = 4;
+    // rotations per turn and scales per doubling
+    static constexpr int angle_steps = 4096;
+    static constexpr int scale_steps = 256;
+
+    // the per feature fill and stroke overrides of a path of the shape
+    struct path_style
+    {
+        agg::rgba8 fill_color;
+        double fill_opacity;
+        agg::rgba8 stroke_color;
+        double stroke_width;
+        double stroke_opacity;
+        unsigned flags;
+
+        bool operator==(path_style const& rhs) const;
+    };
+
+    struct key_type
+    {
+        void const* shape = nullptr;
+        // empty when drawn with the shape's own attributes
+        std::vector<path_style> style;
+        int angle = 0;
+        int scale = 0;
+        int phase_x = 0;
+        int phase_y = 0;
+        unsigned opacity = 0;
+        double gamma = 1.0;
+        int gamma_method = 0;
+
+        bool operator==(key_type const& rhs) const;
+    };
+
+    struct sprite
+    {
+        image_rgba8 image;
+        // of the image's top left pixel from the marker's whole pixel position
+        int x = 0;
+        int y = 0;
+    };
+
+    // the geometric part of a marker transform as drawn from a sprite
+    struct placement
+    {
+        // sprite transform, translated by the subpixel phase only
+        agg::trans_affine transform;
+        // whole pixel position of the marker
+        int x = 0;
+        int y = 0;
+    };
+
+    explicit marker_sprite_cache(std::size_t max_bytes = 16 * 1024 * 1024);
+
+    void set_max_bytes(std::size_t max_bytes);
+    std::size_t max_bytes() const;
+
+    sprite const* find(key_type const& key) const;
+    // keeps the shape alive so its address stays a unique key
+    sprite const& insert(key_type const& key, svg_path_ptr const& shape, sprite && s);
+    std::size_t size() const;
+    std::size_t bytes() const;
+    void clear();
+
+    // Fills the angle, scale and phase of key and the placement for a
+    // marker transform, false when it is no rotation and uniform scale
+    // within tolerance pixels over bbox.
+    static bool quantize(agg::trans_affine const& tr,
+                         box2d<double> const& bbox,
+                         double tolerance,
+                         key_type & key,
+                         placement & place);
+
+    // The per feature fill and stroke overrides of attrs, which otherwise
+    // match the shape's own attributes.
+    static std::vector<path_style> style(svg_attribute_type const& attrs);
+
+    // How far strokes of attrs may reach out of the shape's bounding box,
+    // in shape units.
+    static double stroke_margin(svg_attribute_type const& attrs);
+
+private:
+    struct key_hash
+    {
+        std::size_t operator()(key_type const& key) const;
+    };
+
+    struct entry
+    {
+        svg_path_ptr shape;
+        sprite data;
+    };
+
+    std::unordered_map<key_type, entry, key_hash> entries_;
+    std::size_t max_bytes_;
+    std::size_t num_bytes_;
+};
+
+}
+
+#endif // MAPNIK_MARKER_SPRITE_CACHE_HPP
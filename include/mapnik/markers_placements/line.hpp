@@ -43,6 +43,7 @@ public:
         : point_placement(locator, detector, params),
             first_point_(true),
             spacing_(0.0),
+            position_(0.0),
             marker_width_((params.size * params.tr).width()),
             path_(locator)
     {
@@ -67,8 +68,6 @@ public:
             return point_placement::get_point(x, y, angle, ignore_placement);
         }
 
-        double move = spacing_;
-
         if (first_point_)
         {
             if (!path_.next_subpath())
@@ -77,16 +76,21 @@ public:
                 return false;
             }
             first_point_ = false;
-            move = spacing_ / 2.0;
+            position_ = spacing_ / 2.0;
+        }
+        else
+        {
+            position_ += spacing_;
         }
 
-        while (path_.forward(move))
+        // every candidate is looked up from the start of the path, so
+        // retries don't walk back and forth along it
+        for (; position_ < path_.length(); position_ += spacing_)
         {
             tolerance_iterator tolerance_offset(spacing_ * this->params_.max_error, 0.0);
             while (tolerance_offset.next())
             {
-                vertex_cache::scoped_state state(path_);
-                if (path_.move(tolerance_offset.get()) && (path_.linear_position() + marker_width_ / 2.0) < path_.length())
+                if (path_.seek(position_ + tolerance_offset.get()) && (path_.linear_position() + marker_width_ / 2.0) < path_.length())
                 {
                     pixel_position pos = path_.current_position();
                     x = pos.x;
@@ -113,6 +117,8 @@ public:
 private:
     bool first_point_;
     double spacing_;
+    // linear position of the marker being placed, without its offset
+    double position_;
     double marker_width_;
     vertex_cache path_;
 };
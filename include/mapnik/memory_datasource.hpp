@@ -29,6 +29,11 @@
 
 // stl
 #include <deque>
+#include <memory>
+#include <vector>
+#ifdef MAPNIK_THREADSAFE
+#include <mutex>
+#endif
 
 namespace mapnik {
 
@@ -42,15 +47,24 @@ public:
     virtual datasource::datasource_t type() const;
     virtual featureset_ptr features(query const& q) const;
     virtual featureset_ptr features_at_point(coord2d const& pt, double tol = 0) const;
+    virtual std::vector<featureset_ptr> features_at_points(std::vector<coord2d> const& pts, double tol = 0) const;
+    virtual boost::optional<std::size_t> estimate_features(query const& q) const;
     virtual box2d<double> envelope() const;
     virtual boost::optional<datasource_geometry_t> get_geometry_type() const;
     virtual layer_descriptor get_descriptor() const;
+    virtual std::size_t memory_usage() const;
     //
     void push(feature_ptr feature);
     void set_envelope(box2d<double> const& box);
     size_t size() const;
     void clear();
 private:
+    struct spatial_index;
+    featureset_ptr indexed_features(box2d<double> const& box) const;
+    std::vector<featureset_ptr> indexed_features(std::vector<box2d<double>> const& boxes) const;
+    // with index_mutex_ held
+    void build_index() const;
+
     std::deque<feature_ptr> features_;
     mapnik::layer_descriptor desc_;
     datasource::datasource_t type_;
@@ -58,6 +72,13 @@ private:
     bool type_set_;
     mutable box2d<double> extent_;
     mutable bool dirty_extent_ = true;
+    // with spatial_index=true an R-tree over the feature boxes is built
+    // by the first query after a push; point queries always use it
+    bool use_index_;
+    mutable std::unique_ptr<spatial_index> index_;
+#ifdef MAPNIK_THREADSAFE
+    mutable std::mutex index_mutex_;
+#endif
 };
 
 }
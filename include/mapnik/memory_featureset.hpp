@@ -78,8 +78,7 @@ public:
                 }
                 else
                 {
-                    geometry::geometry<double> const& geom = (*pos_)->get_geometry();
-                    if (bbox_.intersects(geometry::envelope(geom)))
+                    if (bbox_.intersects((*pos_)->envelope()))
                     {
                         return *pos_++;
                     }
@@ -90,6 +89,18 @@ public:
         return feature_ptr();
     }
 
+    std::size_t next_batch(feature_batch & batch, std::size_t max_size)
+    {
+        std::size_t count = 0;
+        for (; count < max_size; ++count)
+        {
+            feature_ptr feature = memory_featureset::next();
+            if (!feature) break;
+            batch.push_back(std::move(feature));
+        }
+        return count;
+    }
+
 private:
     box2d<double> bbox_;
     std::deque<feature_ptr>::const_iterator pos_;
@@ -0,0 +1,75 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_MEMORY_REPORT_HPP
+#define MAPNIK_MEMORY_REPORT_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+
+// stl
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace mapnik
+{
+
+class Map;
+class feature_impl;
+
+// Estimated heap bytes of a feature: the feature, its attributes and its
+// geometry. Datasources keeping features in memory add it up.
+MAPNIK_DECL std::size_t estimate_memory(feature_impl const& feature);
+
+// Estimated bytes of a boost rtree, whose nodes run about two thirds full.
+template <typename Tree>
+std::size_t estimate_tree_memory(Tree const& tree)
+{
+    return tree.size() * sizeof(typename Tree::value_type) * 3 / 2;
+}
+
+struct memory_usage_entry
+{
+    std::string name;
+    std::size_t bytes;
+};
+
+// Where the memory of a render process goes, as estimates rather than
+// exact counts: the styles of a map with their rules, symbolizers and
+// parsed expressions, its layers with their parameters and datasources,
+// and the process wide caches. A datasource shared by several layers is
+// counted with the first of them.
+struct MAPNIK_DECL memory_report
+{
+    std::vector<memory_usage_entry> styles;
+    std::vector<memory_usage_entry> layers;
+    std::vector<memory_usage_entry> caches;
+
+    std::size_t total() const;
+};
+
+MAPNIK_DECL memory_report make_memory_report(Map const& map);
+
+}
+
+#endif // MAPNIK_MEMORY_REPORT_HPP
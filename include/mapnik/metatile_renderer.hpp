@@ -0,0 +1,83 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_METATILE_RENDERER_HPP
+#define MAPNIK_METATILE_RENDERER_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <vector>
+
+namespace mapnik {
+
+class Map;
+
+/*!
+ * \brief renders a metatile as a grid of separate tiles.
+ *
+ * The map's current extent and size define the metatile. Every vector
+ * layer is queried once for the union of all (buffered) tile extents and
+ * the features are bucketed per tile by bounding box. Each tile is then
+ * rendered into its own image with its own label collision detector, so
+ * the tile buffer controls label behaviour at tile edges. Raster layers
+ * are queried per tile.
+ */
+class MAPNIK_DECL metatile_renderer : private util::noncopyable
+{
+public:
+    metatile_renderer(Map const& m,
+                      unsigned cols,
+                      unsigned rows,
+                      double scale_factor = 1.0);
+
+    unsigned cols() const { return cols_; }
+    unsigned rows() const { return rows_; }
+    unsigned tile_width() const { return tile_width_; }
+    unsigned tile_height() const { return tile_height_; }
+
+    /*!
+     * \brief geographic extent of a tile, in map projection.
+     */
+    box2d<double> tile_extent(unsigned col, unsigned row) const;
+
+    /*!
+     * \brief render all tiles, stored row by row in tiles.
+     */
+    void apply(std::vector<image_rgba8> & tiles, double scale_denom = 0.0) const;
+
+private:
+    Map const& m_;
+    unsigned cols_;
+    unsigned rows_;
+    unsigned tile_width_;
+    unsigned tile_height_;
+    double scale_factor_;
+};
+
+}
+
+#endif // MAPNIK_METATILE_RENDERER_HPP
@@ -0,0 +1,78 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_MULTISCALE_RENDERER_HPP
+#define MAPNIK_MULTISCALE_RENDERER_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <vector>
+
+namespace mapnik {
+
+class Map;
+
+/*!
+ * \brief renders the map's extent at several scale factors, e.g. the @1x
+ * and @2x variants of a tile.
+ *
+ * The map gives the extent and the size at scale factor 1; the image for
+ * scale factor f is f times that size. Every vector layer is queried once,
+ * at the resolution of the largest scale factor and with the buffer of the
+ * smallest, which reaches furthest. Each image is then rendered from the
+ * shared features by its own agg_renderer, with its own label collision
+ * detector, as if the map was resized and rendered on its own. Raster
+ * layers are queried per image.
+ */
+class MAPNIK_DECL multiscale_renderer : private util::noncopyable
+{
+public:
+    multiscale_renderer(Map const& m, std::vector<double> const& scale_factors);
+
+    std::vector<double> const& scale_factors() const { return scale_factors_; }
+
+    /*!
+     * \brief width and height of the image for a scale factor.
+     */
+    unsigned width(double scale_factor) const;
+    unsigned height(double scale_factor) const;
+
+    /*!
+     * \brief render one image per scale factor, in the same order.
+     *
+     * scale_denom, when given, is the scale denominator at scale factor 1.
+     */
+    void apply(std::vector<image_rgba8> & images, double scale_denom = 0.0) const;
+
+private:
+    Map const& m_;
+    std::vector<double> scale_factors_;
+};
+
+}
+
+#endif // MAPNIK_MULTISCALE_RENDERER_HPP
@@ -0,0 +1,50 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_NUMA_HPP
+#define MAPNIK_NUMA_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+
+// stl
+#include <cstddef>
+
+namespace mapnik { namespace numa {
+
+// NUMA topology as far as caches and thread placement care: nodes with
+// CPUs, numbered densely from 0. Read once from sysfs on Linux; elsewhere,
+// or with MAPNIK_NUMA_NODES=1 in the environment, there is a single node.
+// Caches keep a replica of read-mostly data per node, filled by threads
+// of that node so that its pages are allocated there.
+
+// number of nodes, at least 1
+MAPNIK_DECL std::size_t node_count();
+// node of the CPU the calling thread is running on
+MAPNIK_DECL std::size_t current_node();
+// Restricts the calling thread to the CPUs of node. Returns false if
+// the platform does not support it or node is out of range.
+MAPNIK_DECL bool bind_thread(std::size_t node);
+
+}}
+
+#endif // MAPNIK_NUMA_HPP
@@ -44,6 +44,8 @@ template <typename Geometry>
 struct offset_converter
 {
     using size_type = std::size_t;
+    // vertices searched for a self-intersection of the offset line
+    static constexpr size_type max_lookahead = 256;
 
     offset_converter(Geometry & geom)
         : geom_(geom)
@@ -112,7 +114,7 @@ struct offset_converter
         }
 
         pre_ = (pos_ ? cur_ : pre_first_);
-        cur_ = vertices_.at(pos_++);
+        cur_ = vertices_[pos_++];
 
         if (pos_ == vertices_.size())
         {
@@ -124,7 +126,10 @@ struct offset_converter
         double t = 1.0;
         double vt, ut;
 
-        for (size_t i = pos_; i+1 < vertices_.size(); ++i)
+        // self-intersections are looked for within check_dist, and no more
+        // than max_lookahead vertices ahead on dense lines
+        size_t const end = std::min(vertices_.size(), pos_ + max_lookahead + 1);
+        for (size_t i = pos_; i+1 < end; ++i)
         {
             //break; // uncomment this to see all the curls
 
@@ -235,30 +240,42 @@ private:
     }
 
     /**
-     *  @brief  Translate (vx, vy) by rotated (dx, dy).
+     *  @brief  Cosine and sine of the direction of (dx, dy), that of
+     *          atan2(dy, dx) without the trigonometry.
      */
-    static void displace(vertex2d & v, double dx, double dy, double a)
+    static void direction(double dx, double dy, double & c, double & s)
     {
-        v.x += dx * std::cos(a) - dy * std::sin(a);
-        v.y += dx * std::sin(a) + dy * std::cos(a);
+        double const length = std::sqrt(dx * dx + dy * dy);
+        if (length > 0.0)
+        {
+            c = dx / length;
+            s = dy / length;
+        }
+        else
+        {
+            c = 1.0;
+            s = 0.0;
+        }
     }
 
     /**
-     *  @brief  Translate (vx, vy) by rotated (0, -offset).
+     *  @brief  Translate (vx, vy) by (0, -offset) rotated to the
+     *          direction with cosine c and sine s.
      */
-    void displace(vertex2d & v, double a) const
+    void displace(vertex2d & v, double c, double s) const
     {
-        v.x -= offset_ * std::sin(a);
-        v.y += offset_ * std::cos(a);
+        v.x -= offset_ * s;
+        v.y += offset_ * c;
     }
 
     /**
-     *  @brief  (vx, vy) := (ux, uy) + rotated (0, -offset)
+     *  @brief  (vx, vy) := (ux, uy) + (0, -offset) rotated to the
+     *          direction with cosine c and sine s.
      */
-    void displace(vertex2d & v, vertex2d const& u, double a) const
+    void displace(vertex2d & v, vertex2d const& u, double c, double s) const
     {
-        v.x = u.x - offset_ * std::sin(a);
-        v.y = u.y + offset_ * std::cos(a);
+        v.x = u.x - offset_ * s;
+        v.y = u.y + offset_ * c;
         v.cmd = u.cmd;
     }
 
@@ -270,10 +287,11 @@ private:
         return 0;
     }
 
-    void displace2(vertex2d & v1, vertex2d const& v0, vertex2d const& v2, double a, double b) const
+    void displace2(vertex2d & v1, vertex2d const& v0, vertex2d const& v2, double a, double b,
+                   double cos_a, double sin_a) const
     {
-        double sa = offset_ * std::sin(a);
-        double ca = offset_ * std::cos(a);
+        double sa = offset_ * sin_a;
+        double ca = offset_ * cos_a;
         double h = std::tan(0.5 * (b - a));
         double hsa = h * sa;
         double hca = h * ca;
@@ -331,6 +349,18 @@ private:
         }
     }
 
+    // Whether the joint at v1 of the vectors from v1 to v0 and to v2 is an
+    // outside turn on the offset side, from the signs of their determinant
+    // and dot product rather than from the angle between them.
+    bool outside_turn(double dot, double det) const
+    {
+        if (offset_ > 0.0)
+        {
+            return det > 0.0 || (det == 0.0 && dot >= 0.0);
+        }
+        return det < 0.0;
+    }
+
     status init_vertices()
     {
         if (status_ != initial) // already initialized
@@ -343,8 +373,10 @@ private:
         vertex2d w(vertex2d::no_init);
         vertex2d start(vertex2d::no_init);
         vertex2d start_v2(vertex2d::no_init);
-        std::vector<vertex2d> points;
-        std::vector<vertex2d> close_points;
+        std::vector<vertex2d> & points = points_;
+        std::vector<vertex2d> & close_points = close_points_;
+        points.clear();
+        close_points.clear();
         bool is_polygon = false;
         std::size_t cpt = 0;
         v0.cmd = geom_.vertex(&v0.x, &v0.y);
@@ -386,6 +418,8 @@ private:
         }
         // Push SEG_END
         points.push_back(vertex2d(v0.x,v0.y,SEG_END));
+        // one offset vertex per source vertex, more at outside turns
+        vertices_.reserve(points.size() + points.size() / 2);
         std::size_t i = 0;
         v1 = points[i++];
         v2 = points[i++];
@@ -405,6 +439,10 @@ private:
         // The vector parts from v1 to v2;
         double v_x1x2 = v2.x - v1.x;
         double v_y1y2 = v2.y - v1.y;
+        // cosine and sine of angle_a, angle_b
+        double cos_a = 1;
+        double sin_a = 0;
+        double cos_b, sin_b;
 
         if (is_polygon)
         {
@@ -412,20 +450,20 @@ private:
             v_y1y0 = close_points[cpt].y - v1.y;
             cpt++;
             angle_a = std::atan2(-v_y1y0, -v_x1x0);
+            direction(-v_x1x0, -v_y1y0, cos_a, sin_a);
         }
         // dot product
         double dot;
         // determinate
         double det;
         double angle_b = std::atan2(v_y1y2, v_x1x2);
-        // Angle between the two vectors
-        double joint_angle;
-        double curve_angle;
+        direction(v_x1x2, v_y1y2, cos_b, sin_b);
+        double curve_angle = 0;
 
         if (!is_polygon)
         {
             // first vertex
-            displace(v1, angle_b);
+            displace(v1, cos_b, sin_b);
             push_vertex(v1);
         }
         else
@@ -433,18 +471,9 @@ private:
             dot = v_x1x0 * v_x1x2 + v_y1y0 * v_y1y2;      // dot product
             det = v_x1x0 * v_y1y2 - v_y1y0 * v_x1x2;      // determinant
 
-            joint_angle = std::atan2(det, dot);  // atan2(y, x) or atan2(sin, cos)
-            if (joint_angle < 0) joint_angle = joint_angle + 2 * M_PI;
-            joint_angle = std::fmod(joint_angle, 2 * M_PI);
-
-            if (offset_ > 0.0)
-            {
-                joint_angle = 2 * M_PI - joint_angle;
-            }
-
             int bulge_steps = 0;
 
-            if (std::abs(joint_angle) > M_PI)
+            if (outside_turn(dot, det))
             {
                 curve_angle = explement_reflex_angle(angle_b - angle_a);
                 // Bulge steps should be determined by the inverse of the joint angle.
@@ -454,12 +483,12 @@ private:
 
             if (bulge_steps == 0)
             {
-                displace2(v1, v0, v2, angle_a, angle_b);
+                displace2(v1, v0, v2, angle_a, angle_b, cos_a, sin_a);
                 push_vertex(v1);
             }
             else
             {
-                displace(v1, angle_b);
+                displace(v1, cos_b, sin_b);
                 push_vertex(v1);
             }
         }
@@ -471,7 +500,8 @@ private:
         if (!is_polygon)
         {
             pre_first_ = v1;
-            displace(pre_first_, -2 * std::fabs(offset_), 0, angle_b);
+            pre_first_.x -= 2 * std::fabs(offset_) * cos_b;
+            pre_first_.y -= 2 * std::fabs(offset_) * sin_b;
             start_ = pre_first_;
         }
         else
@@ -486,6 +516,9 @@ private:
 
         while (i < points.size())
         {
+            // the direction of v1 to v2 so far is the one of the last segment,
+            // unless a ring starts over
+            bool new_direction = false;
             v1 = v2;
             v2 = points[i++];
             if (v1.cmd == SEG_MOVETO)
@@ -498,6 +531,7 @@ private:
                     {
                         v_x1x2 = v1.x - close_points[cpt].x;
                         v_y1y2 = v1.y - close_points[cpt].y;
+                        new_direction = true;
                         cpt++;
                     }
                     start_v2.x = v2.x;
@@ -526,30 +560,32 @@ private:
             // Switch the previous vector's direction as the origin has changed
             v_x1x0 = -v_x1x2;
             v_y1y0 = -v_y1y2;
-            // Calculate new angle_a
-            angle_a = std::atan2(v_y1y2, v_x1x2);
+            // The new angle_a is the last angle_b
+            if (new_direction)
+            {
+                angle_a = std::atan2(v_y1y2, v_x1x2);
+                direction(v_x1x2, v_y1y2, cos_a, sin_a);
+            }
+            else
+            {
+                angle_a = angle_b;
+                cos_a = cos_b;
+                sin_a = sin_b;
+            }
 
             // Calculate the new vector
             v_x1x2 = v2.x - v1.x;
             v_y1y2 = v2.y - v1.y;
             // Calculate the new angle_b
             angle_b = std::atan2(v_y1y2, v_x1x2);
+            direction(v_x1x2, v_y1y2, cos_b, sin_b);
 
             dot = v_x1x0 * v_x1x2 + v_y1y0 * v_y1y2;      // dot product
             det = v_x1x0 * v_y1y2 - v_y1y0 * v_x1x2;      // determinant
 
-            joint_angle = std::atan2(det, dot);  // atan2(y, x) or atan2(sin, cos)
-            if (joint_angle < 0) joint_angle = joint_angle + 2 * M_PI;
-            joint_angle = std::fmod(joint_angle, 2 * M_PI);
-
-            if (offset_ > 0.0)
-            {
-                joint_angle = 2 * M_PI - joint_angle;
-            }
-
             int bulge_steps = 0;
 
-            if (std::abs(joint_angle) > M_PI)
+            if (outside_turn(dot, det))
             {
                 curve_angle = explement_reflex_angle(angle_b - angle_a);
                 // Bulge steps should be determined by the inverse of the joint angle.
@@ -562,15 +598,13 @@ private:
             {
                 // inside turn (sharp/obtuse angle)
                 MAPNIK_LOG_DEBUG(ctrans) << "offset_converter:"
-                    << " Sharp joint [<< inside turn " << int(joint_angle*180/M_PI)
-                    << " degrees >>]";
+                    << " Sharp joint [<< inside turn >>]";
             }
             else
             {
                 // outside turn (reflex angle)
                 MAPNIK_LOG_DEBUG(ctrans) << "offset_converter:"
-                    << " Bulge joint >)) outside turn " << int(joint_angle*180/M_PI)
-                    << " degrees ((< with " << bulge_steps << " segments";
+                    << " Bulge joint >)) outside turn ((< with " << bulge_steps << " segments";
             }
             #endif
             tmp_prev.cmd = v1.cmd;
@@ -581,12 +615,12 @@ private:
             {
                 if (bulge_steps == 0)
                 {
-                    displace2(v1, v0, v2, angle_a, angle_b);
+                    displace2(v1, v0, v2, angle_a, angle_b, cos_a, sin_a);
                     push_vertex(v1);
                 }
                 else
                 {
-                    displace(v1, angle_b);
+                    displace(v1, cos_b, sin_b);
                     push_vertex(v1);
                 }
             }
@@ -594,21 +628,30 @@ private:
             {
                 if (bulge_steps == 0)
                 {
-                    displace2(v1, v0, v2, angle_a, angle_b);
+                    displace2(v1, v0, v2, angle_a, angle_b, cos_a, sin_a);
                     push_vertex(v1);
                 }
                 else
                 {
-                    displace(w, v1, angle_a);
+                    displace(w, v1, cos_a, sin_a);
                     w.cmd = SEG_LINETO;
                     push_vertex(w);
+                    // the bulge directions, turned step by step from angle_a
+                    double const step = curve_angle / bulge_steps;
+                    double const cos_step = std::cos(step);
+                    double const sin_step = std::sin(step);
+                    double cos_s = cos_a;
+                    double sin_s = sin_a;
                     for (int s = 0; ++s < bulge_steps;)
                     {
-                        displace(w, v1, angle_a + (curve_angle * s) / bulge_steps);
+                        double const c = cos_s * cos_step - sin_s * sin_step;
+                        sin_s = sin_s * cos_step + cos_s * sin_step;
+                        cos_s = c;
+                        displace(w, v1, cos_s, sin_s);
                         w.cmd = SEG_LINETO;
                         push_vertex(w);
                     }
-                    displace(v1, angle_b);
+                    displace(v1, cos_b, sin_b);
                     push_vertex(v1);
                 }
             }
@@ -620,7 +663,7 @@ private:
         // last vertex
         if (!is_polygon)
         {
-            displace(v1, angle_b);
+            displace(v1, cos_b, sin_b);
             push_vertex(v1);
         }
         // initialization finished
@@ -650,6 +693,9 @@ private:
     status                  status_;
     size_t                  pos_;
     std::vector<vertex2d>   vertices_;
+    // source vertices and ring ends, kept for their capacity
+    std::vector<vertex2d>   points_;
+    std::vector<vertex2d>   close_points_;
     vertex2d                start_;
     vertex2d                pre_first_;
     vertex2d                pre_;
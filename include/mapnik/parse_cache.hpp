@@ -0,0 +1,107 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_PARSE_CACHE_HPP
+#define MAPNIK_PARSE_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/path_expression.hpp>
+#include <mapnik/symbolizer_base.hpp> // for transform_list_ptr
+
+// stl
+#include <cstddef>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace mapnik
+{
+
+// Process wide cache of parsed expressions, transforms and path expressions
+// keyed by their source strings (and encoding for transforms), so maps built
+// over and over from the same styles stop running the grammars for every
+// filter. parse_expression, parse_transform and parse_path look it up first;
+// what they return is shared between callers and must not be modified.
+// Failed parses are not cached. Each kind keeps up to max_entries() results,
+// dropping the least recently used ones; a limit of 0 disables the cache.
+class MAPNIK_DECL parse_cache :
+        public singleton<parse_cache, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<parse_cache>;
+public:
+    static constexpr std::size_t default_max_entries = 4096;
+
+    void set_max_entries(std::size_t max_entries);
+    std::size_t max_entries() const;
+
+    expression_ptr find_expression(std::string const& str);
+    void insert_expression(std::string const& str, expression_ptr const& expr);
+    transform_list_ptr find_transform(std::string const& str, std::string const& encoding);
+    void insert_transform(std::string const& str, std::string const& encoding, transform_list_ptr const& trans);
+    path_expression_ptr find_path(std::string const& str);
+    void insert_path(std::string const& str, path_expression_ptr const& path);
+
+    // entries held, all kinds together
+    std::size_t size() const;
+    void clear();
+
+private:
+    parse_cache();
+
+    template <typename Key, typename Value>
+    struct table
+    {
+        struct entry
+        {
+            Value value;
+            typename std::list<Key>::iterator lru;
+        };
+
+        Value find(Key const& key);
+        void insert(Key const& key, Value const& value, std::size_t max_entries);
+        void evict(std::size_t max_entries);
+        void clear();
+
+        std::map<Key, entry> entries;
+        // most recently used first
+        std::list<Key> lru;
+    };
+
+    table<std::string, expression_ptr> expressions_;
+    // keyed by encoding and source
+    table<std::pair<std::string, std::string>, transform_list_ptr> transforms_;
+    table<std::string, path_expression_ptr> paths_;
+    std::size_t max_entries_;
+};
+
+extern template class MAPNIK_DECL singleton<parse_cache, CreateStatic>;
+
+}
+
+#endif // MAPNIK_PARSE_CACHE_HPP
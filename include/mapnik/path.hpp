@@ -84,6 +84,12 @@ public:
     {
         return cont_.size();
     }
+
+    void clear()
+    {
+        cont_.clear();
+    }
+
     void push_vertex(coordinate_type x, coordinate_type y, CommandType c)
     {
         cont_.push_back(x,y,c);
@@ -27,7 +27,11 @@
 #include <mapnik/palette.hpp>
 #include <mapnik/octree.hpp>
 #include <mapnik/hextree.hpp>
+#include <mapnik/histogram_quantizer.hpp>
 #include <mapnik/image.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/image_kernels.hpp>
+#include <mapnik/util/noncopyable.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -39,13 +43,33 @@ extern "C"
 {
 #include <png.h>
 }
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
 #include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #pragma GCC diagnostic pop
 
 #define MAX_OCTREE_LEVELS 4
 
 namespace mapnik {
 
+enum png_quantizer_e : std::uint8_t
+{
+    PNG_QUANTIZER_OCTREE = 0,
+    PNG_QUANTIZER_HEXTREE,
+    PNG_QUANTIZER_HISTOGRAM
+};
+
+enum png_encoder_e : std::uint8_t
+{
+    PNG_ENCODER_LIBPNG = 0,
+    // filters and deflates into the output buffer directly, without libpng
+    PNG_ENCODER_DEFLATE
+};
+
 struct png_options {
     int colors;
     int filters;
@@ -54,7 +78,13 @@ struct png_options {
     int trans_mode;
     double gamma;
     bool paletted;
+    // deprecated and ignored, quantizer picks the palette builder; kept
+    // so code setting it still compiles
     bool use_hextree;
+    png_quantizer_e quantizer;
+    png_encoder_e encoder;
+    // threads building the histogram of large images (m=hist only)
+    unsigned threads;
 
     png_options() :
         colors(256),
@@ -64,7 +94,10 @@ struct png_options {
         trans_mode(-1),
         gamma(-1),
         paletted(true),
-        use_hextree(true) {}
+        use_hextree(true),
+        quantizer(PNG_QUANTIZER_HEXTREE),
+        encoder(PNG_ENCODER_LIBPNG),
+        threads(1) {}
 };
 
 template <typename T>
@@ -81,12 +114,361 @@ void flush_data (png_structp png_ptr)
     out->flush();
 }
 
+// a std::string output is appended to directly
+template <>
+inline void write_data<std::string> (png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    std::string * out = static_cast<std::string*>(png_get_io_ptr(png_ptr));
+    out->append(reinterpret_cast<char*>(data), length);
+}
+
+template <>
+inline void flush_data<std::string> (png_structp) {}
+
+namespace detail {
+
+inline void append_png_uint32(std::string & out, std::uint32_t val)
+{
+    char bytes[4] = { static_cast<char>(val >> 24), static_cast<char>(val >> 16),
+                      static_cast<char>(val >> 8), static_cast<char>(val) };
+    out.append(bytes, 4);
+}
+
+// chunk data must already follow the 8 byte header at out[pos]
+inline void finish_png_chunk(std::string & out, std::size_t pos)
+{
+    std::uint32_t size = static_cast<std::uint32_t>(out.size() - pos - 8);
+    for (unsigned i = 0; i < 4; ++i)
+    {
+        out[pos + i] = static_cast<char>(size >> (24 - 8 * i));
+    }
+    uLong crc = crc32(0L, reinterpret_cast<Bytef const*>(out.data() + pos + 4), size + 4);
+    append_png_uint32(out, static_cast<std::uint32_t>(crc));
+}
+
+inline std::size_t start_png_chunk(std::string & out, char const* type)
+{
+    std::size_t pos = out.size();
+    append_png_uint32(out, 0);
+    out.append(type, 4);
+    return pos;
+}
+
+inline unsigned char png_paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return static_cast<unsigned char>(a);
+    if (pb <= pc) return static_cast<unsigned char>(b);
+    return static_cast<unsigned char>(c);
+}
+
+// writes the filter type byte and the filtered scanline to out
+inline void png_filter_row(unsigned char const* row, unsigned char const* prev,
+                           std::size_t size, unsigned bpp, int filter, unsigned char * out)
+{
+    unsigned char * dst = out + 1;
+    switch (filter)
+    {
+    case PNG_FILTER_SUB:
+        out[0] = PNG_FILTER_VALUE_SUB;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            dst[i] = row[i] - (i >= bpp ? row[i - bpp] : 0);
+        }
+        break;
+    case PNG_FILTER_UP:
+        out[0] = PNG_FILTER_VALUE_UP;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            dst[i] = row[i] - (prev ? prev[i] : 0);
+        }
+        break;
+    case PNG_FILTER_AVG:
+        out[0] = PNG_FILTER_VALUE_AVG;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            unsigned left = i >= bpp ? row[i - bpp] : 0;
+            unsigned up = prev ? prev[i] : 0;
+            dst[i] = row[i] - static_cast<unsigned char>((left + up) >> 1);
+        }
+        break;
+    case PNG_FILTER_PAETH:
+        out[0] = PNG_FILTER_VALUE_PAETH;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            int left = i >= bpp ? row[i - bpp] : 0;
+            int up = prev ? prev[i] : 0;
+            int up_left = (prev && i >= bpp) ? prev[i - bpp] : 0;
+            dst[i] = row[i] - png_paeth(left, up, up_left);
+        }
+        break;
+    default:
+        out[0] = PNG_FILTER_VALUE_NONE;
+        std::copy(row, row + size, dst);
+        break;
+    }
+}
+
+// Reads the rows of an rgba8 image the way they are encoded: rows of a
+// premultiplied image are demultiplied one at a time into a scratch
+// buffer, so no encoder copies the whole image. Opaque images are read
+// in place, their pixels are the same either way. The last two rows
+// returned stay valid, the filters look back one row.
+template <typename T>
+class demultiplied_rows
+{
+public:
+    using pixel_type = typename T::pixel_type;
+
+    explicit demultiplied_rows(T const& image)
+        : image_(image),
+          scratch_(image.get_premultiplied() && !image.opaque() ? 2 * image.width() : 0) {}
+
+    std::size_t width() const { return image_.width(); }
+    std::size_t height() const { return image_.height(); }
+    bool get_premultiplied() const { return false; }
+
+    pixel_type const* get_row(std::size_t y) const
+    {
+        pixel_type const* row = image_.get_row(y);
+        if (scratch_.empty()) return row;
+        std::size_t width = image_.width();
+        pixel_type * out = scratch_.data() + (y & 1) * width;
+        std::copy(row, row + width, out);
+        simd::rgba8().demultiply(reinterpret_cast<std::uint32_t*>(out), width);
+        return out;
+    }
+
+private:
+    T const& image_;
+    mutable std::vector<pixel_type> scratch_;
+};
+
+// Filters the scanlines and deflates them straight into the IDAT chunk
+// of out, which grows as needed. Rows go to zlib in batches of about 32k,
+// feeding it the whole image at once turned out slower. With more than
+// one filter in opts.filters each row takes the one with the smallest sum
+// of absolute differences, the heuristic libpng uses.
+template <typename Row>
+void write_png_idat(std::string & out, unsigned height, std::size_t row_size, unsigned bpp,
+                    Row get_row, png_options const& opts)
+{
+    static const int filter_list[] = { PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP,
+                                       PNG_FILTER_AVG, PNG_FILTER_PAETH };
+    std::vector<int> filters;
+    for (int f : filter_list)
+    {
+        if (opts.filters & f) filters.push_back(f);
+    }
+    if (filters.empty()) filters.push_back(PNG_FILTER_NONE);
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if (deflateInit2(&stream, opts.compression, Z_DEFLATED, 15, 8, opts.strategy) != Z_OK)
+    {
+        throw image_writer_exception("png: could not initialize deflate");
+    }
+    std::size_t const pos = start_png_chunk(out, "IDAT");
+    std::size_t const data_pos = out.size();
+    auto compress = [&](unsigned char * data, std::size_t size, int flush)
+    {
+        stream.next_in = data;
+        stream.avail_in = static_cast<uInt>(size);
+        int ret = Z_OK;
+        do
+        {
+            std::size_t used = data_pos + stream.total_out;
+            if (used == out.size())
+            {
+                out.resize(used + std::max<std::size_t>(used - data_pos, 16384));
+            }
+            stream.next_out = reinterpret_cast<Bytef*>(&out[used]);
+            stream.avail_out = static_cast<uInt>(out.size() - used);
+            ret = deflate(&stream, flush);
+            if (ret == Z_STREAM_ERROR)
+            {
+                deflateEnd(&stream);
+                out.resize(pos);
+                throw image_writer_exception("png: deflate failed");
+            }
+        }
+        while (stream.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+    };
+
+    std::size_t const stride = row_size + 1;
+    std::size_t const batch_rows = std::max<std::size_t>(1, 32768 / stride);
+    std::vector<unsigned char> batch(batch_rows * stride);
+    std::vector<unsigned char> trial(filters.size() > 1 ? stride : 0);
+    unsigned char const* prev = nullptr;
+    std::size_t rows = 0;
+    for (unsigned y = 0; y < height; ++y)
+    {
+        unsigned char const* row = get_row(y);
+        unsigned char * dst = batch.data() + rows * stride;
+        if (filters.size() == 1)
+        {
+            png_filter_row(row, prev, row_size, bpp, filters.front(), dst);
+        }
+        else
+        {
+            std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+            for (int f : filters)
+            {
+                png_filter_row(row, prev, row_size, bpp, f, trial.data());
+                std::uint64_t sum = 0;
+                for (std::size_t i = 1; i < stride; ++i)
+                {
+                    sum += trial[i] < 128 ? trial[i] : 256 - trial[i];
+                }
+                if (sum < best)
+                {
+                    best = sum;
+                    std::copy(trial.begin(), trial.end(), dst);
+                }
+            }
+        }
+        prev = row;
+        if (++rows == batch_rows)
+        {
+            compress(batch.data(), rows * stride, Z_NO_FLUSH);
+            rows = 0;
+        }
+    }
+    compress(batch.data(), rows * stride, Z_FINISH);
+    std::size_t compressed = stream.total_out;
+    deflateEnd(&stream);
+    out.resize(data_pos + compressed);
+    finish_png_chunk(out, pos);
+}
+
+inline void write_png_header(std::string & out, unsigned width, unsigned height,
+                             unsigned depth, unsigned color_type)
+{
+    static const char signature[] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+    out.append(signature, 8);
+    std::size_t pos = start_png_chunk(out, "IHDR");
+    append_png_uint32(out, width);
+    append_png_uint32(out, height);
+    out.push_back(static_cast<char>(depth));
+    out.push_back(static_cast<char>(color_type));
+    out.push_back(0); // compression
+    out.push_back(0); // filter
+    out.push_back(0); // interlace
+    finish_png_chunk(out, pos);
+}
+
+inline void write_png_end(std::string & out)
+{
+    finish_png_chunk(out, start_png_chunk(out, "IEND"));
+}
+
+// the deflate encoder builds the whole file in a std::string, other
+// outputs get it with a single write
+template <typename T, typename Encode>
+void write_png_buffer(T & file, Encode encode)
+{
+    std::string buffer;
+    encode(buffer);
+    file.write(buffer.data(), buffer.size());
+}
+
+template <typename Encode>
+void write_png_buffer(std::string & out, Encode encode)
+{
+    encode(out);
+}
+
+template <typename T>
+void save_as_png_deflate(std::string & out, T const& image, png_options const& opts)
+{
+    unsigned width = image.width();
+    unsigned height = image.height();
+    bool alpha = opts.trans_mode != 0;
+    demultiplied_rows<T> rows(image);
+    write_png_header(out, width, height, 8, alpha ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB);
+    if (alpha)
+    {
+        write_png_idat(out, height, width * 4, 4, [&rows](unsigned y) {
+                return reinterpret_cast<unsigned char const*>(rows.get_row(y));
+            }, opts);
+    }
+    else
+    {
+        // strip the alpha channel while filtering
+        std::vector<unsigned char> rgb(width * 3 * 2);
+        write_png_idat(out, height, width * 3, 3, [&rows, &rgb, width](unsigned y) {
+                unsigned char const* src = reinterpret_cast<unsigned char const*>(rows.get_row(y));
+                // alternate halves so the previous row stays valid for the filters
+                unsigned char * dst = rgb.data() + (y & 1) * width * 3;
+                for (unsigned x = 0; x < width; ++x)
+                {
+                    dst[3 * x] = src[4 * x];
+                    dst[3 * x + 1] = src[4 * x + 1];
+                    dst[3 * x + 2] = src[4 * x + 2];
+                }
+                return static_cast<unsigned char const*>(dst);
+            }, opts);
+    }
+    write_png_end(out);
+}
+
+inline void save_as_png_deflate(std::string & out, std::vector<mapnik::rgb> const& palette,
+                                mapnik::image_gray8 const& image,
+                                unsigned width, unsigned height, unsigned color_depth,
+                                std::vector<unsigned> const& alpha,
+                                png_options const& opts)
+{
+    write_png_header(out, width, height, color_depth, PNG_COLOR_TYPE_PALETTE);
+    std::size_t pos = start_png_chunk(out, "PLTE");
+    for (auto const& c : palette)
+    {
+        out.push_back(static_cast<char>(c.r));
+        out.push_back(static_cast<char>(c.g));
+        out.push_back(static_cast<char>(c.b));
+    }
+    finish_png_chunk(out, pos);
+    // truncate to nonopaque values
+    std::size_t alpha_size = 0;
+    for (std::size_t i = 0; i < alpha.size(); ++i)
+    {
+        if (alpha[i] < 255) alpha_size = i + 1;
+    }
+    if (alpha_size > 0)
+    {
+        pos = start_png_chunk(out, "tRNS");
+        for (std::size_t i = 0; i < alpha_size; ++i)
+        {
+            out.push_back(static_cast<char>(alpha[i]));
+        }
+        finish_png_chunk(out, pos);
+    }
+    std::size_t row_size = (static_cast<std::size_t>(width) * color_depth + 7) / 8;
+    write_png_idat(out, height, row_size, 1, [&image](unsigned y) {
+            return static_cast<unsigned char const*>(image.get_row(y));
+        }, opts);
+    write_png_end(out);
+}
+
+}
+
 template <typename T1, typename T2>
 void save_as_png(T1 & file,
                 T2 const& image,
                 png_options const& opts)
 
 {
+    if (opts.encoder == PNG_ENCODER_DEFLATE)
+    {
+        detail::write_png_buffer(file, [&](std::string & out) {
+                detail::save_as_png_deflate(out, image, opts);
+            });
+        return;
+    }
     png_voidp error_ptr=0;
     png_structp png_ptr=png_create_write_struct(PNG_LIBPNG_VER_STRING,
                                                 error_ptr,0, 0);
@@ -122,16 +504,103 @@ void save_as_png(T1 & file,
     png_set_IHDR(png_ptr, info_ptr,image.width(),image.height(),8,
                  (opts.trans_mode == 0) ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_RGB_ALPHA,PNG_INTERLACE_NONE,
                  PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
-    const std::unique_ptr<png_bytep[]> row_pointers(new png_bytep[image.height()]);
-    for (unsigned int i = 0; i < image.height(); ++i)
+    png_write_info(png_ptr, info_ptr);
+    if (opts.trans_mode == 0)
     {
-        row_pointers[i] = const_cast<png_bytep>(reinterpret_cast<const unsigned char *>(image.get_row(i)));
+        png_set_filler(png_ptr, 0, PNG_FILLER_AFTER);
     }
-    png_set_rows(png_ptr, info_ptr, row_pointers.get());
-    png_write_png(png_ptr, info_ptr, (opts.trans_mode == 0) ? PNG_TRANSFORM_STRIP_FILLER_AFTER : PNG_TRANSFORM_IDENTITY, nullptr);
+    // row by row, libpng keeps its own copy of the previous row
+    detail::demultiplied_rows<T2> rows(image);
+    for (unsigned i = 0; i < image.height(); ++i)
+    {
+        png_write_row(png_ptr, const_cast<png_bytep>(reinterpret_cast<const unsigned char *>(rows.get_row(i))));
+    }
+    png_write_end(png_ptr, info_ptr);
     png_destroy_write_struct(&png_ptr, &info_ptr);
 }
 
+// Writes an rgba8 PNG of a known size a band of rows at a time, as the
+// bands are rendered, for images too large to hold whole. Always uses
+// libpng, which keeps only the previous row; the options otherwise are
+// those of save_as_png. The file is complete once all rows are written
+// and finish() was called.
+template <typename T>
+class png_row_writer : private util::noncopyable
+{
+public:
+    png_row_writer(T & file, unsigned width, unsigned height, png_options const& opts)
+        : png_ptr_(png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0)),
+          info_ptr_(nullptr),
+          width_(width),
+          height_(height),
+          row_(0),
+          finished_(false)
+    {
+        if (!png_ptr_) throw std::runtime_error("png_row_writer: could not create the libpng writer");
+        info_ptr_ = png_create_info_struct(png_ptr_);
+        if (!info_ptr_)
+        {
+            png_destroy_write_struct(&png_ptr_, static_cast<png_infopp>(0));
+            throw std::runtime_error("png_row_writer: could not create the libpng writer");
+        }
+        png_set_filter(png_ptr_, PNG_FILTER_TYPE_BASE, opts.filters);
+        png_set_write_fn(png_ptr_, &file, &write_data<T>, &flush_data<T>);
+        png_set_compression_level(png_ptr_, opts.compression);
+        png_set_compression_strategy(png_ptr_, opts.strategy);
+        png_set_compression_buffer_size(png_ptr_, 32768);
+        png_set_IHDR(png_ptr_, info_ptr_, width, height, 8,
+                     (opts.trans_mode == 0) ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+                     PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+        png_write_info(png_ptr_, info_ptr_);
+        if (opts.trans_mode == 0)
+        {
+            png_set_filler(png_ptr_, 0, PNG_FILLER_AFTER);
+        }
+    }
+
+    ~png_row_writer()
+    {
+        png_destroy_write_struct(&png_ptr_, &info_ptr_);
+    }
+
+    unsigned rows_written() const { return row_; }
+
+    // appends the rows of band, which is as wide as the image
+    template <typename Image>
+    void write_rows(Image const& band)
+    {
+        if (band.width() != width_ || row_ + band.height() > height_ || finished_)
+        {
+            throw std::runtime_error("png_row_writer: band does not fit the image");
+        }
+        detail::demultiplied_rows<Image> rows(band);
+        for (std::size_t y = 0; y < band.height(); ++y)
+        {
+            png_write_row(png_ptr_, const_cast<png_bytep>(reinterpret_cast<const unsigned char *>(rows.get_row(y))));
+        }
+        row_ += static_cast<unsigned>(band.height());
+    }
+
+    void finish()
+    {
+        if (finished_) return;
+        if (row_ != height_)
+        {
+            throw std::runtime_error("png_row_writer: " + std::to_string(height_ - row_) + " rows missing");
+        }
+        png_write_end(png_ptr_, info_ptr_);
+        finished_ = true;
+    }
+
+private:
+    png_structp png_ptr_;
+    png_infop info_ptr_;
+    unsigned width_;
+    unsigned height_;
+    unsigned row_;
+    bool finished_;
+};
+
 template <typename T>
 void reduce_8(T const& in,
               image_gray8 & out,
@@ -258,6 +727,13 @@ void save_as_png(T & file, std::vector<mapnik::rgb> const& palette,
                  std::vector<unsigned> const& alpha,
                  png_options const& opts)
 {
+    if (opts.encoder == PNG_ENCODER_DEFLATE)
+    {
+        detail::write_png_buffer(file, [&](std::string & out) {
+                detail::save_as_png_deflate(out, palette, image, width, height, color_depth, alpha, opts);
+            });
+        return;
+    }
     png_voidp error_ptr=0;
     png_structp png_ptr=png_create_write_struct(PNG_LIBPNG_VER_STRING,
                                                 error_ptr,0, 0);
@@ -339,6 +815,7 @@ void save_as_png8_oct(T1 & file,
     const unsigned TRANSPARENCY_LEVELS = (opts.trans_mode==2||opts.trans_mode<0)?MAX_OCTREE_LEVELS:2;
     unsigned width = image.width();
     unsigned height = image.height();
+    detail::demultiplied_rows<T2> rows(image);
     unsigned alphaHist[256];//transparency histogram
     unsigned semiCount = 0;//sum of semitransparent pixels
     unsigned meanAlpha = 0;
@@ -355,9 +832,11 @@ void save_as_png8_oct(T1 & file,
         }
         for (unsigned y = 0; y < height; ++y)
         {
+            // alpha is the same either way, skip demultiplying
+            typename T2::pixel_type const * row = image.get_row(y);
             for (unsigned x = 0; x < width; ++x)
             {
-                unsigned val = U2ALPHA(static_cast<unsigned>(image.get_row(y)[x]));
+                unsigned val = U2ALPHA(static_cast<unsigned>(row[x]));
                 ++alphaHist[val];
                 meanAlpha += val;
                 if (val>0 && val<255)
@@ -475,7 +954,7 @@ void save_as_png8_oct(T1 & file,
     }
     for (unsigned y = 0; y < height; ++y)
     {
-        typename T2::pixel_type const * row = image.get_row(y);
+        typename T2::pixel_type const * row = rows.get_row(y);
         for (unsigned x = 0; x < width; ++x)
         {
             unsigned val = row[x];
@@ -529,7 +1008,7 @@ void save_as_png8_oct(T1 & file,
     {
         // >16 && <=256 colors -> write 8-bit color depth
         image_gray8 reduced_image(width,height);
-        reduce_8(image, reduced_image, trees, limits, TRANSPARENCY_LEVELS, alpha_table);
+        reduce_8(rows, reduced_image, trees, limits, TRANSPARENCY_LEVELS, alpha_table);
         save_as_png(file,palette,reduced_image,width,height,8,alpha_table,opts);
     }
     else if (palette.size() == 1)
@@ -538,7 +1017,7 @@ void save_as_png8_oct(T1 & file,
         unsigned image_width  = ((width + 15) >> 3) & ~1U; // 1-bit image, round up to 16-bit boundary
         unsigned image_height = height;
         image_gray8 reduced_image(image_width,image_height);
-        reduce_1(image,reduced_image,trees, limits, alpha_table);
+        reduce_1(rows,reduced_image,trees, limits, alpha_table);
         if (meanAlpha<255 && cols[0]==0)
         {
             alpha_table.resize(1);
@@ -552,7 +1031,7 @@ void save_as_png8_oct(T1 & file,
         unsigned image_width  = ((width + 7) >> 1) & ~3U; // 4-bit image, round up to 32-bit boundary
         unsigned image_height = height;
         image_gray8 reduced_image(image_width,image_height);
-        reduce_4(image, reduced_image, trees, limits, TRANSPARENCY_LEVELS, alpha_table);
+        reduce_4(rows, reduced_image, trees, limits, TRANSPARENCY_LEVELS, alpha_table);
         save_as_png(file,palette,reduced_image,width,height,4,alpha_table,opts);
     }
 }
@@ -568,6 +1047,7 @@ void save_as_png8(T1 & file,
 {
     unsigned width = image.width();
     unsigned height = image.height();
+    detail::demultiplied_rows<T2> rows(image);
 
     if (palette.size() > 16 )
     {
@@ -575,7 +1055,7 @@ void save_as_png8(T1 & file,
         image_gray8 reduced_image(width, height);
         for (unsigned y = 0; y < height; ++y)
         {
-            mapnik::image_rgba8::pixel_type const * row = image.get_row(y);
+            mapnik::image_rgba8::pixel_type const * row = rows.get_row(y);
             mapnik::image_gray8::pixel_type  * row_out = reduced_image.get_row(y);
             for (unsigned x = 0; x < width; ++x)
             {
@@ -601,7 +1081,7 @@ void save_as_png8(T1 & file,
         image_gray8 reduced_image(image_width, image_height);
         for (unsigned y = 0; y < height; ++y)
         {
-            mapnik::image_rgba8::pixel_type const * row = image.get_row(y);
+            mapnik::image_rgba8::pixel_type const * row = rows.get_row(y);
             mapnik::image_gray8::pixel_type  * row_out = reduced_image.get_row(y);
             std::uint8_t index = 0;
             for (unsigned x = 0; x < width; ++x)
@@ -626,6 +1106,7 @@ void save_as_png8_hex(T1 & file,
 {
     unsigned width = image.width();
     unsigned height = image.height();
+    detail::demultiplied_rows<T2> rows(image);
 
     if (width + height > 3) // at least 3 pixels (hextree implementation requirement)
     {
@@ -642,7 +1123,7 @@ void save_as_png8_hex(T1 & file,
 
         for (unsigned y = 0; y < height; ++y)
         {
-            typename T2::pixel_type const * row = image.get_row(y);
+            typename T2::pixel_type const * row = rows.get_row(y);
             for (unsigned x = 0; x < width; ++x)
             {
                 unsigned val = row[x];
@@ -671,7 +1152,7 @@ void save_as_png8_hex(T1 & file,
         std::set<mapnik::rgba> colors;
         for (unsigned y = 0; y < height; ++y)
         {
-            typename T2::pixel_type const * row = image.get_row(y);
+            typename T2::pixel_type const * row = rows.get_row(y);
 
             for (unsigned x = 0; x < width; ++x)
             {
@@ -692,6 +1173,32 @@ void save_as_png8_hex(T1 & file,
     }
 }
 
+// Quantizes with a palette built earlier, e.g. from the whole metatile
+// when saving its tiles.
+template <typename T1, typename T2>
+void save_as_png8_hist(T1 & file,
+                       T2 const& image,
+                       histogram_quantizer const& quantizer,
+                       png_options const& opts)
+{
+    save_as_png8<T1, T2, histogram_quantizer>(file, image, quantizer,
+                                              quantizer.palette(), quantizer.alpha_table(), opts);
+}
+
+template <typename T1, typename T2>
+void save_as_png8_hist(T1 & file,
+                       T2 const& image,
+                       png_options const& opts)
+{
+    histogram_quantizer quantizer(opts.colors);
+    quantizer.set_trans_mode(opts.trans_mode);
+    quantizer.set_gamma(opts.gamma);
+    quantizer.set_threads(opts.threads);
+    quantizer.insert(image);
+    quantizer.create_palette();
+    save_as_png8_hist(file, image, quantizer, opts);
+}
+
 template <typename T1, typename T2>
 void save_as_png8_pal(T1 & file,
                       T2 const& image,
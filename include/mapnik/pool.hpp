@@ -34,73 +34,147 @@
 
 // stl
 #include <algorithm> // std::max
+#include <chrono>
+#include <cstdint>
 #include <deque>
+#include <thread>
+#include <vector>
 
 namespace mapnik
 {
+
+struct pool_stats
+{
+    std::size_t size = 0;           // objects currently held by the pool
+    std::size_t checkouts = 0;      // successful borrowObject() calls
+    std::size_t affinity_hits = 0;  // ... handing back the calling thread's last object
+    std::size_t created = 0;        // objects opened by the pool, including warm up
+    std::size_t exhausted = 0;      // borrowObject() calls that returned nothing
+    std::uint64_t wait_us = 0;      // total time spent waiting for the pool lock
+};
+
 template <typename T,template <typename> class Creator>
 class Pool : private util::noncopyable
 {
     using HolderType = std::shared_ptr<T>;
-    using ContType = std::deque<HolderType>;
+    // an object is free while the pool holds the only reference to it,
+    // owner is the thread that borrowed it last
+    struct entry
+    {
+        HolderType obj;
+        std::thread::id owner;
+    };
+    using ContType = std::deque<entry>;
 
     Creator<T> creator_;
     unsigned initialSize_;
     unsigned maxSize_;
     ContType pool_;
+    pool_stats stats_;
 #ifdef MAPNIK_THREADSAFE
     mutable std::mutex mutex_;
 #endif
 public:
 
+    // No objects are opened here, call warm_up() (possibly from another
+    // thread) to open the initial ones ahead of the first borrowObject().
     Pool(const Creator<T>& creator,unsigned initialSize, unsigned maxSize)
         :creator_(creator),
          initialSize_(initialSize),
-         maxSize_(maxSize)
-    {
-        for (unsigned i=0; i < initialSize_; ++i)
-        {
-            HolderType conn(creator_());
-            if (conn->isOK())
-                pool_.push_back(conn);
-        }
-    }
+         maxSize_(maxSize),
+         pool_(),
+         stats_() {}
 
     HolderType borrowObject()
     {
 #ifdef MAPNIK_THREADSAFE
+        auto start = std::chrono::steady_clock::now();
         std::lock_guard<std::mutex> lock(mutex_);
+        stats_.wait_us += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
 #endif
-
-        typename ContType::iterator itr=pool_.begin();
-        while ( itr!=pool_.end())
+        std::thread::id const self = std::this_thread::get_id();
+        // indices before the current one stay valid across erase()
+        std::size_t const none = static_cast<std::size_t>(-1);
+        std::size_t found = none;
+        std::size_t index = 0;
+        while (index < pool_.size())
         {
-            if (!itr->unique())
+            entry & e = pool_[index];
+            if (!e.obj.unique())
             {
-                ++itr;
+                ++index;
             }
-            else if ((*itr)->isOK())
+            else if (e.obj->isOK())
             {
-                return *itr;
+                // prefer the object this thread used last
+                if (e.owner == self)
+                {
+                    ++stats_.affinity_hits;
+                    found = index;
+                    break;
+                }
+                if (found == none) found = index;
+                ++index;
             }
             else
             {
-                itr=pool_.erase(itr);
+                pool_.erase(pool_.begin() + index);
             }
         }
+        if (found != none)
+        {
+            pool_[found].owner = self;
+            ++stats_.checkouts;
+            return pool_[found].obj;
+        }
         // all connection have been taken, check if we allowed to grow pool
         if (pool_.size() < maxSize_)
         {
             HolderType conn(creator_());
+            ++stats_.created;
             if (conn->isOK())
             {
-                pool_.push_back(conn);
+                pool_.push_back(entry{conn, self});
+                ++stats_.checkouts;
                 return conn;
             }
         }
+        ++stats_.exhausted;
         return HolderType();
     }
 
+    // Opens objects until the pool holds initial_size() of them. They are
+    // created without holding the pool lock, so concurrent borrowers are
+    // not blocked while connecting.
+    void warm_up()
+    {
+        unsigned missing = 0;
+        {
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::mutex> lock(mutex_);
+#endif
+            if (pool_.size() < initialSize_) missing = initialSize_ - pool_.size();
+        }
+        std::vector<HolderType> fresh;
+        fresh.reserve(missing);
+        for (unsigned i = 0; i < missing; ++i)
+        {
+            HolderType conn(creator_());
+            if (conn->isOK()) fresh.push_back(conn);
+        }
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        stats_.created += missing;
+        for (HolderType & conn : fresh)
+        {
+            // borrowers may have grown the pool in the meantime
+            if (pool_.size() >= maxSize_) break;
+            pool_.push_back(entry{conn, std::thread::id()});
+        }
+    }
+
     unsigned size() const
     {
 #ifdef MAPNIK_THREADSAFE
@@ -109,6 +183,16 @@ public:
         return pool_.size();
     }
 
+    pool_stats stats() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        pool_stats result = stats_;
+        result.size = pool_.size();
+        return result;
+    }
+
     unsigned max_size() const
     {
 #ifdef MAPNIK_THREADSAFE
@@ -133,28 +217,13 @@ public:
         return initialSize_;
     }
 
+    // call warm_up() afterwards to open the additional objects
     void set_initial_size(unsigned size)
     {
 #ifdef MAPNIK_THREADSAFE
         std::lock_guard<std::mutex> lock(mutex_);
 #endif
-        if (size > initialSize_)
-        {
-            initialSize_ = size;
-            unsigned total_size = pool_.size();
-            // ensure we don't have ghost obj's in the pool.
-            if (total_size < initialSize_)
-            {
-                unsigned grow_size = initialSize_ - total_size ;
-
-                for (unsigned i=0; i < grow_size; ++i)
-                {
-                    HolderType conn(creator_());
-                    if (conn->isOK())
-                        pool_.push_back(conn);
-                }
-            }
-        }
+        initialSize_ = std::max(initialSize_, size);
     }
 };
 
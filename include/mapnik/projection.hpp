@@ -69,6 +69,10 @@ public:
 
 private:
     void swap (projection& rhs);
+    // With the PROJ 6 API, the transformation from this projection to
+    // dest, made once per thread and pair and owned by the thread, null
+    // if there is none. Null without the PROJ 6 API.
+    void * pipeline(projection const& dest) const;
 
 private:
     std::string params_;
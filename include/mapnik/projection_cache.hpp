@@ -0,0 +1,72 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_PROJECTION_CACHE_HPP
+#define MAPNIK_PROJECTION_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace mapnik {
+
+class projection;
+class proj_transform;
+
+// Initialized projections and transforms keyed by their srs strings, so
+// renders stop parsing the same proj4 definitions for every layer. Each
+// thread has its own cache and therefore its own proj4 contexts; returned
+// references stay valid until clear() is called on that thread.
+class MAPNIK_DECL projection_cache : private util::noncopyable
+{
+public:
+    static projection_cache & instance();
+
+    projection const& get(std::string const& srs);
+    proj_transform const& get(std::string const& source, std::string const& dest);
+    std::size_t size() const;
+    void clear();
+
+private:
+    projection_cache();
+    ~projection_cache();
+
+    struct pair_hash
+    {
+        std::size_t operator()(std::pair<std::string, std::string> const& key) const;
+    };
+
+    std::unordered_map<std::string, std::unique_ptr<projection>> projections_;
+    std::unordered_map<std::pair<std::string, std::string>,
+                       std::unique_ptr<proj_transform>, pair_hash> transforms_;
+};
+
+}
+
+#endif // MAPNIK_PROJECTION_CACHE_HPP
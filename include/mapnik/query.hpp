@@ -26,6 +26,8 @@
 //mapnik
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/attribute.hpp>
+#include <mapnik/cancel_token.hpp>
+#include <mapnik/expression.hpp>
 
 // stl
 #include <set>
@@ -49,7 +51,11 @@ public:
           filter_factor_(1.0),
           unbuffered_bbox_(unbuffered_bbox),
           names_(),
-          vars_()
+          vars_(),
+          feature_arena_(false),
+          cancel_(),
+          filter_(),
+          order_by_()
     {}
 
     query(box2d<double> const& bbox,
@@ -61,7 +67,11 @@ public:
           filter_factor_(1.0),
           unbuffered_bbox_(bbox),
           names_(),
-          vars_()
+          vars_(),
+          feature_arena_(false),
+          cancel_(),
+          filter_(),
+          order_by_()
     {}
 
     query(box2d<double> const& bbox)
@@ -71,7 +81,11 @@ public:
           filter_factor_(1.0),
           unbuffered_bbox_(bbox),
           names_(),
-          vars_()
+          vars_(),
+          feature_arena_(false),
+          cancel_(),
+          filter_(),
+          order_by_()
     {}
 
     query(query const& other)
@@ -81,7 +95,11 @@ public:
           filter_factor_(other.filter_factor_),
           unbuffered_bbox_(other.unbuffered_bbox_),
           names_(other.names_),
-          vars_(other.vars_)
+          vars_(other.vars_),
+          feature_arena_(other.feature_arena_),
+          cancel_(other.cancel_),
+          filter_(other.filter_),
+          order_by_(other.order_by_)
     {}
 
     query& operator=(query const& other)
@@ -94,6 +112,10 @@ public:
         unbuffered_bbox_=other.unbuffered_bbox_;
         names_=other.names_;
         vars_=other.vars_;
+        feature_arena_=other.feature_arena_;
+        cancel_=other.cancel_;
+        filter_=other.filter_;
+        order_by_=other.order_by_;
         return *this;
     }
 
@@ -157,6 +179,58 @@ public:
         return vars_;
     }
 
+    // ask datasources that support it to build the features of each
+    // featureset in a feature_arena, freed at once with the featureset
+    // and its features
+    void set_feature_arena(bool arena)
+    {
+        feature_arena_ = arena;
+    }
+
+    bool feature_arena() const
+    {
+        return feature_arena_;
+    }
+
+    // the cancellation of the render issuing the query, datasources
+    // supporting it stop reading once it trips
+    void set_cancel_token(cancel_token_ptr const& token)
+    {
+        cancel_ = token;
+    }
+
+    cancel_token_ptr const& get_cancel_token() const
+    {
+        return cancel_;
+    }
+
+    // a filter matched by every feature the render draws, evaluated with
+    // variables(); datasources may leave out the features not matching
+    // it, or return them anyway. Null (the default) asks for all.
+    void set_filter(expression_ptr const& filter)
+    {
+        filter_ = filter;
+    }
+
+    expression_ptr const& get_filter() const
+    {
+        return filter_;
+    }
+
+    // the attribute the render groups features by: datasources able to
+    // sort cheaply return the features ordered by it, so that each group
+    // arrives in one run. Others may ignore it. Empty (the default) asks
+    // for no order.
+    void set_order_by(std::string const& name)
+    {
+        order_by_ = name;
+    }
+
+    std::string const& order_by() const
+    {
+        return order_by_;
+    }
+
 private:
     box2d<double> bbox_;
     resolution_type resolution_;
@@ -165,6 +239,10 @@ private:
     box2d<double> unbuffered_bbox_;
     std::set<std::string> names_;
     attributes vars_;
+    bool feature_arena_;
+    cancel_token_ptr cancel_;
+    expression_ptr filter_;
+    std::string order_by_;
 };
 
 }
@@ -0,0 +1,122 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_QUERY_SCHEDULER_HPP
+#define MAPNIK_QUERY_SCHEDULER_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/featureset.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mapnik
+{
+
+namespace detail { struct query_task; }
+
+// Handle to a featureset requested through datasource::features_async().
+class MAPNIK_DECL query_handle
+{
+public:
+    query_handle() = default;
+    explicit query_handle(std::shared_ptr<detail::query_task> const& task);
+
+    bool valid() const { return static_cast<bool>(task_); }
+    // true once the query has finished, successfully or not
+    bool ready() const;
+    // Waits for the query and returns its featureset, rethrowing what the
+    // query threw. A query no worker has picked up yet runs on the
+    // calling thread as soon as its budget allows.
+    featureset_ptr get();
+    // Drops a query that has not started, waits for a running one to
+    // finish and discards its result.
+    void cancel();
+
+private:
+    std::shared_ptr<detail::query_task> task_;
+};
+
+// Process wide queue of queries, run on the I/O executor. Queries are
+// keyed by datasource pool (e.g. plugin name) and at most budget(key)
+// queries of a key run at once, whichever renders they belong to.
+class MAPNIK_DECL query_scheduler :
+        public singleton<query_scheduler, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<query_scheduler>;
+    friend class query_handle;
+public:
+    query_handle submit(std::string const& key, std::function<featureset_ptr()> func);
+
+    // maximum number of concurrent queries for key, 0 (the default) for no limit
+    void set_budget(std::string const& key, std::size_t max_in_flight);
+    std::size_t budget(std::string const& key) const;
+    std::size_t in_flight(std::string const& key) const;
+
+    // lets at least count queries run on I/O executor threads at once, on
+    // top of those run by callers waiting for them; a no-op without
+    // MAPNIK_THREADSAFE
+    void reserve_threads(std::size_t count);
+    // threads queries run on, at most as many as the I/O executor has
+    std::size_t threads() const;
+
+private:
+    using task_ptr = std::shared_ptr<detail::query_task>;
+
+    query_scheduler();
+    ~query_scheduler();
+    bool can_start(detail::query_task const& task) const;
+    void start(task_ptr const& task);
+    void run(task_ptr const& task, std::unique_lock<std::mutex> & lock);
+    void dispatch(std::unique_lock<std::mutex> & lock);
+    void execute();
+
+    mutable std::mutex mutex_;
+    std::condition_variable done_cond_;
+    std::deque<task_ptr> pending_;
+    std::map<std::string, std::size_t> budgets_;
+    std::map<std::string, std::size_t> in_flight_;
+    // executor tasks not finished, those not yet running, and how many
+    // may be posted at once
+    std::size_t posted_;
+    std::size_t waiting_;
+    std::size_t slots_;
+    bool stop_;
+};
+
+extern template class MAPNIK_DECL singleton<query_scheduler, CreateStatic>;
+
+}
+
+#endif // MAPNIK_QUERY_SCHEDULER_HPP
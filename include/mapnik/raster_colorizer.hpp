@@ -191,15 +191,21 @@ public:
     bool add_stop(colorizer_stop const& stop);
 
     //! \brief Set the list of stops
-    //! \param[in] stops The list of stops
+    //! \param[in] stops The list of stops, in ascending order of value
     void set_stops(colorizer_stops const& stops) { stops_ = stops; }
 
     //! \brief Get the list of stops
     //! \return The list of stops
     colorizer_stops const& get_stops() const { return stops_; }
 
+    //! \brief Colorize a raster band
+    //!
+    //! 8 and 16 bit integer bands go through a table with a color for every
+    //! possible value, rows are split between up to `threads` threads on
+    //! large images.
     template <typename T>
-    void colorize(image_rgba8 & out, T const& in, boost::optional<double>const& nodata, feature_impl const& f) const;
+    void colorize(image_rgba8 & out, T const& in, boost::optional<double>const& nodata, feature_impl const& f,
+                  unsigned threads = 1) const;
 
     //! \brief Perform the translation of input to output
     //!
@@ -0,0 +1,129 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_RENDER_STATS_HPP
+#define MAPNIK_RENDER_STATS_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/alloc_stats.hpp>
+#include <mapnik/datasource_stats.hpp>
+
+// stl
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mapnik
+{
+
+// Timings and counts of a render, collected by a feature_style_processor
+// given one through set_stats(). Every apply() appends the layers it
+// renders, in rendering order, and adds to total, so the same object may
+// aggregate several renders; clear() it between them otherwise.
+struct MAPNIK_DECL render_stats
+{
+    using clock = std::chrono::steady_clock;
+    using duration = std::chrono::nanoseconds;
+
+    struct symbolizer_stats
+    {
+        duration time = duration::zero();
+        std::size_t count = 0;
+    };
+
+    struct rule_stats
+    {
+        // empty for unnamed rules
+        std::string name;
+        // processing the rule's symbolizers, labels placed at the end of
+        // the style excepted
+        duration time = duration::zero();
+        // features the rule was drawn for, and their vertices
+        std::size_t features = 0;
+        std::size_t vertices = 0;
+        // per symbolizer of the rule, in rule order, by type
+        std::vector<std::pair<std::string, symbolizer_stats>> symbolizers;
+    };
+
+    struct style_stats
+    {
+        std::string name;
+        // pulling features from the featureset, including the datasource's own work
+        duration fetch = duration::zero();
+        // selecting rules and evaluating their filters
+        duration filter = duration::zero();
+        // placing the labels of styles with label-priority or label-coverage
+        duration labels = duration::zero();
+        // end_style_processing(), compositing the style image for agg
+        duration compositing = duration::zero();
+        std::size_t features = 0;
+        std::size_t vertices = 0;
+        // set when the layer's feature budget stopped the style early
+        bool over_budget = false;
+        // processing time per symbolizer type, e.g. "TextSymbolizer"
+        std::map<std::string, symbolizer_stats> symbolizers;
+        // per rule of the style, in style order
+        std::vector<rule_stats> rules;
+    };
+
+    struct layer_stats
+    {
+        std::string name;
+        // issuing the datasource queries and waiting for asynchronous ones
+        duration query = duration::zero();
+        // rendering the layer and its child layers
+        duration render = duration::zero();
+        // end_layer_processing(), compositing the layer image for agg
+        duration compositing = duration::zero();
+        // set when the features or the image came from a cross render cache
+        bool cached = false;
+        // what the layer's datasource counted from the layer's queries to
+        // the end of its rendering; includes the queries of concurrent
+        // renders sharing the datasource
+        datasource_stats datasource;
+        std::vector<style_stats> styles;
+    };
+
+    std::vector<layer_stats> layers;
+    duration total = duration::zero();
+    // heap allocations of the rendering thread by phase, and the most bytes
+    // it held at once above those held when a render started; only counted
+    // when built with ENABLE_ALLOC_STATS, see alloc_stats.hpp
+    alloc_phase_counters allocations;
+    std::ptrdiff_t peak_bytes = 0;
+
+    void clear();
+    std::size_t features() const;
+    std::size_t vertices() const;
+
+    static std::size_t vertex_count(geometry::geometry<double> const& geom);
+};
+
+}
+
+#endif // MAPNIK_RENDER_STATS_HPP
@@ -35,6 +35,7 @@ namespace mapnik {
   class label_collision_detector4;
   class Map;
   class request;
+  class group_layout_cache;
 //  class attributes;
 }
 
@@ -51,6 +52,9 @@ struct renderer_common : private util::noncopyable
                        detector_ptr detector);
     renderer_common(Map const &m, request const &req, attributes const& vars, unsigned offset_x, unsigned offset_y,
                        unsigned width, unsigned height, double scale_factor);
+    renderer_common(Map const &m, request const &req, attributes const& vars, unsigned offset_x, unsigned offset_y,
+                       unsigned width, unsigned height, double scale_factor,
+                       detector_ptr detector);
     ~renderer_common();
 
     unsigned width_;
@@ -64,6 +68,9 @@ struct renderer_common : private util::noncopyable
     box2d<double> query_extent_;
     view_transform t_;
     detector_ptr detector_;
+    // group symbolizer layouts of this render, made on first use and not
+    // shared with copies
+    std::shared_ptr<group_layout_cache> group_layouts_;
 
 protected:
     // it's desirable to keep this class implicitly noncopyable to prevent
@@ -0,0 +1,161 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_RENDERER_COMMON_COMPILED_SYMBOLIZER_HPP
+#define MAPNIK_RENDERER_COMMON_COMPILED_SYMBOLIZER_HPP
+
+// mapnik
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/symbolizer_default_values.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <unordered_map>
+
+namespace mapnik {
+
+// A symbolizer property resolved once per symbolizer: constant values are
+// extracted up front and only expressions are evaluated per feature.
+template <typename T, keys Key>
+class compiled_property
+{
+public:
+    explicit compiled_property(symbolizer_base const& sym)
+        : value_(symbolizer_default<T, Key>::value()),
+          expr_(nullptr)
+    {
+        auto itr = sym.properties.find(Key);
+        if (itr != sym.properties.end())
+        {
+            if (itr->second.template is<expression_ptr>() || itr->second.template is<path_expression_ptr>())
+            {
+                expr_ = &itr->second;
+            }
+            else
+            {
+                value_ = util::apply_visitor(extract_raw_value<T>(), itr->second);
+            }
+        }
+    }
+
+    T get(feature_impl const& feature, attributes const& vars) const
+    {
+        if (expr_) return util::apply_visitor(extract_value<T>(feature, vars), *expr_);
+        return value_;
+    }
+
+    bool is_constant() const { return expr_ == nullptr; }
+
+private:
+    T value_;
+    symbolizer_base::value_type const* expr_;
+};
+
+// Properties of the hot symbolizers, the symbolizer they are compiled
+// from must outlive them.
+struct compiled_polygon_symbolizer
+{
+    explicit compiled_polygon_symbolizer(polygon_symbolizer const& sym)
+        : geometry_transform(get_optional<transform_type>(sym, keys::geometry_transform)),
+          clip(sym), simplify_tolerance(sym), smooth(sym), fill(sym), fill_opacity(sym),
+          gamma(sym), gamma_method(sym), comp_op(sym) {}
+
+    boost::optional<transform_type> geometry_transform;
+    compiled_property<value_bool, keys::clip> clip;
+    compiled_property<value_double, keys::simplify_tolerance> simplify_tolerance;
+    compiled_property<value_double, keys::smooth> smooth;
+    compiled_property<color, keys::fill> fill;
+    compiled_property<value_double, keys::fill_opacity> fill_opacity;
+    compiled_property<value_double, keys::gamma> gamma;
+    compiled_property<gamma_method_enum, keys::gamma_method> gamma_method;
+    compiled_property<composite_mode_e, keys::comp_op> comp_op;
+};
+
+struct compiled_line_symbolizer
+{
+    explicit compiled_line_symbolizer(line_symbolizer const& sym)
+        : geometry_transform(get_optional<transform_type>(sym, keys::geometry_transform)),
+          has_dasharray(has_key(sym, keys::stroke_dasharray)),
+          stroke(sym), stroke_gamma(sym), stroke_gamma_method(sym), comp_op(sym), clip(sym),
+          stroke_width(sym), stroke_opacity(sym), offset(sym), simplify_tolerance(sym),
+          simplify_algorithm(sym), simplify_prefilter(sym), smooth(sym), line_rasterizer(sym) {}
+
+    boost::optional<transform_type> geometry_transform;
+    bool has_dasharray;
+    compiled_property<color, keys::stroke> stroke;
+    compiled_property<value_double, keys::stroke_gamma> stroke_gamma;
+    compiled_property<gamma_method_enum, keys::stroke_gamma_method> stroke_gamma_method;
+    compiled_property<composite_mode_e, keys::comp_op> comp_op;
+    compiled_property<value_bool, keys::clip> clip;
+    compiled_property<value_double, keys::stroke_width> stroke_width;
+    compiled_property<value_double, keys::stroke_opacity> stroke_opacity;
+    compiled_property<value_double, keys::offset> offset;
+    compiled_property<value_double, keys::simplify_tolerance> simplify_tolerance;
+    compiled_property<simplify_algorithm_e, keys::simplify_algorithm> simplify_algorithm;
+    compiled_property<value_bool, keys::simplify_prefilter> simplify_prefilter;
+    compiled_property<value_double, keys::smooth> smooth;
+    compiled_property<line_rasterizer_enum, keys::line_rasterizer> line_rasterizer;
+};
+
+// Compiled symbolizers of one layer, keyed by the address of the
+// symbolizers which don't move while the layer is rendered.
+class compiled_symbolizer_cache : util::noncopyable
+{
+public:
+    compiled_polygon_symbolizer const& get(polygon_symbolizer const& sym)
+    {
+        return get(polygons_, sym);
+    }
+
+    compiled_line_symbolizer const& get(line_symbolizer const& sym)
+    {
+        return get(lines_, sym);
+    }
+
+    std::size_t size() const { return polygons_.size() + lines_.size(); }
+
+    void clear()
+    {
+        polygons_.clear();
+        lines_.clear();
+    }
+
+private:
+    template <typename Map, typename Symbolizer>
+    static typename Map::mapped_type const& get(Map & map, Symbolizer const& sym)
+    {
+        auto itr = map.find(&sym);
+        if (itr == map.end())
+        {
+            itr = map.emplace(&sym, typename Map::mapped_type(sym)).first;
+        }
+        return itr->second;
+    }
+
+    std::unordered_map<polygon_symbolizer const*, compiled_polygon_symbolizer> polygons_;
+    std::unordered_map<line_symbolizer const*, compiled_line_symbolizer> lines_;
+};
+
+} // namespace mapnik
+
+#endif // MAPNIK_RENDERER_COMMON_COMPILED_SYMBOLIZER_HPP
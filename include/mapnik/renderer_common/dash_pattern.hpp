@@ -0,0 +1,63 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_DASH_PATTERN_HPP
+#define MAPNIK_DASH_PATTERN_HPP
+
+#include <mapnik/symbolizer_base.hpp>
+
+namespace mapnik {
+
+// Length of one repetition of a dash array and the part of it
+// covered by dashes, in the units of the array.
+struct dash_pattern
+{
+    explicit dash_pattern(dash_array const& dash)
+        : period(0.0), coverage(0.0)
+    {
+        for (auto const& d : dash)
+        {
+            period += d.first + d.second;
+            coverage += d.first;
+        }
+    }
+
+    // Whether dashes repeating every period * scale pixels are too fine
+    // to tell apart from a solid line drawn at coverage / period of the
+    // opacity; a zero threshold never collapses.
+    bool collapses(double scale, double threshold) const
+    {
+        return period > 0.0 && period * scale < threshold;
+    }
+
+    double opacity() const
+    {
+        return period > 0.0 ? coverage / period : 1.0;
+    }
+
+    double period;
+    double coverage;
+};
+
+} // namespace mapnik
+
+#endif // MAPNIK_DASH_PATTERN_HPP
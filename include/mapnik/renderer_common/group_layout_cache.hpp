@@ -0,0 +1,103 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_RENDERER_COMMON_GROUP_LAYOUT_CACHE_HPP
+#define MAPNIK_RENDERER_COMMON_GROUP_LAYOUT_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/value.hpp>
+#include <mapnik/renderer_common/render_thunk.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace mapnik {
+
+class proj_transform;
+struct renderer_common;
+struct virtual_renderer_common;
+
+// The render thunks and bounding box of group symbolizer members laid out
+// so far in a render, keyed by the matched group rule and the sub feature
+// id and values it was laid out with. Members repeating across features, like
+// the shields of a route network, are then placed from these instead of
+// laid out again. Kept by renderer_common, the cache lives as long as a
+// renderer; past max_entries it starts over.
+class MAPNIK_DECL group_layout_cache : private util::noncopyable
+{
+public:
+    struct key_type
+    {
+        void const* rule = nullptr;
+        proj_transform const* prj_trans = nullptr;
+        // the column index, read by [mapnik::feature_id]
+        value_integer id = 0;
+        std::vector<value> values;
+
+        bool operator==(key_type const& rhs) const;
+    };
+
+    struct layout
+    {
+        box2d<double> bounds;
+        render_thunk_list thunks;
+        // the thunks may refer to the sub feature they were made for
+        feature_ptr feature;
+    };
+
+    using layout_ptr = std::shared_ptr<layout const>;
+
+    static constexpr std::size_t max_entries = 4096;
+
+    group_layout_cache();
+    ~group_layout_cache();
+
+    layout_ptr find(key_type const& key) const;
+    layout_ptr insert(key_type && key, box2d<double> const& bounds,
+                      render_thunk_list && thunks, feature_ptr const& feature);
+    std::size_t size() const;
+
+    // the renderer laying out members, with a detector of its own; it
+    // outlives the thunks extracted with it
+    virtual_renderer_common & virtual_renderer(renderer_common const& common);
+
+private:
+    struct key_hash
+    {
+        std::size_t operator()(key_type const& key) const;
+    };
+
+    std::unordered_map<key_type, layout_ptr, key_hash> layouts_;
+    std::unique_ptr<virtual_renderer_common> virtual_renderer_;
+};
+
+} // namespace mapnik
+
+#endif // MAPNIK_RENDERER_COMMON_GROUP_LAYOUT_CACHE_HPP
@@ -0,0 +1,67 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_RENDERER_COMMON_INTERIOR_POSITION_HPP
+#define MAPNIK_RENDERER_COMMON_INTERIOR_POSITION_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/geometry/envelope.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/view_transform.hpp>
+
+// stl
+#include <algorithm>
+
+namespace mapnik {
+
+// Interior point of one of the feature's polygons, in the feature's own
+// coordinates, searched to within about a pixel of the rendered map and
+// shared with the other symbolizers placed inside the same polygon.
+inline bool interior_position(feature_impl const& feature,
+                              geometry::polygon<double> const& poly,
+                              proj_transform const& prj_trans,
+                              view_transform const& t,
+                              double & x, double & y)
+{
+    box2d<double> ext = geometry::envelope(poly);
+    box2d<double> map_ext(ext);
+    double precision = 0.0;
+    if (prj_trans.backward(map_ext, PROJ_ENVELOPE_POINTS))
+    {
+        double pixels = std::max(map_ext.width() * t.scale_x(), map_ext.height() * t.scale_y());
+        if (pixels > 0.0) precision = std::max(ext.width(), ext.height()) / pixels;
+    }
+    geometry::point<double> pt;
+    if (!feature.interior(poly, precision, pt)) return false;
+    x = pt.x;
+    y = pt.y;
+    return true;
+}
+
+} // namespace mapnik
+
+#endif // MAPNIK_RENDERER_COMMON_INTERIOR_POSITION_HPP
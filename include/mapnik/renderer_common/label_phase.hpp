@@ -0,0 +1,123 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_RENDERER_COMMON_LABEL_PHASE_HPP
+#define MAPNIK_RENDERER_COMMON_LABEL_PHASE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/font_engine_freetype.hpp>
+#include <mapnik/symbolizer_base.hpp>
+#include <mapnik/text/font_library.hpp>
+#include <mapnik/text/glyph_positions.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <functional>
+#include <memory>
+#include <vector>
+#ifdef MAPNIK_THREADSAFE
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace mapnik {
+
+class Map;
+class proj_transform;
+struct renderer_common;
+
+// Places the text and shield symbolizers of a render apart from the
+// rasterization of its geometries. The labels of a style are queued once
+// the style is done and placed, in order, on a thread of their own while
+// the renderer goes on with the next styles; the glyphs are drawn by
+// draw() when the map is done. The thread owns the placement detector of
+// common until then, so the renderer must wait() before using it. Without
+// MAPNIK_THREADSAFE labels are placed when queued.
+class MAPNIK_DECL label_phase : private util::noncopyable
+{
+public:
+    struct candidate
+    {
+        feature_ptr feature;
+        symbolizer const* sym;
+    };
+
+    struct placed_label
+    {
+        feature_impl const& feature;
+        symbolizer_base const& sym;
+        bool shield;
+        placements_list const& placements;
+    };
+
+    using draw_function = std::function<void(placed_label const&, face_manager_freetype &)>;
+
+    label_phase(renderer_common & common, Map const& m);
+    ~label_phase();
+
+    // queues the labels of a style, placed until the detector coverage
+    // reaches max_coverage
+    void place(std::vector<candidate> && candidates,
+               proj_transform const& prj_trans,
+               double max_coverage);
+
+    // blocks until every queued label is placed
+    void wait();
+
+    // calls draw for every placed label in order, on the placement thread
+    // which holds the fonts, and stops that thread
+    void draw(draw_function const& draw);
+
+private:
+    struct batch;
+    void place_batch(batch & b);
+    void draw_batches(draw_function const& draw);
+#ifdef MAPNIK_THREADSAFE
+    void run();
+#endif
+
+    renderer_common & common_;
+    Map const& map_;
+    font_library font_library_;
+    // made on the placement thread, the faces belong to it
+    std::unique_ptr<face_manager_freetype> font_manager_;
+    std::vector<std::unique_ptr<batch>> batches_;
+    std::size_t placed_;
+#ifdef MAPNIK_THREADSAFE
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    draw_function const* draw_;
+    bool drawn_;
+    bool stop_;
+    std::exception_ptr error_;
+    std::thread thread_;
+#endif
+};
+
+} // namespace mapnik
+
+#endif // MAPNIK_RENDERER_COMMON_LABEL_PHASE_HPP
@@ -0,0 +1,68 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_RENDERER_COMMON_LAYER_BUCKETS_HPP
+#define MAPNIK_RENDERER_COMMON_LAYER_BUCKETS_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/geometry/box2d.hpp>
+
+// stl
+#include <memory>
+#include <vector>
+
+namespace mapnik {
+
+class Map;
+class layer;
+class memory_datasource;
+
+namespace detail {
+
+using bucket_list = std::vector<std::shared_ptr<memory_datasource>>;
+
+// the features of a vector layer split into one memory datasource per
+// extent, for renderers sharing a layer query between several views
+struct layer_buckets
+{
+    layer * lay;
+    bucket_list buckets;
+};
+
+// Queries every visible vector layer below layers once for the union of
+// the (buffered) extents and buckets the features by bounding box, in
+// depth first layer order. Layers which cannot be bucketed, such as
+// raster layers, are left out and keep their datasource.
+MAPNIK_DECL void bucket_layers(Map const& m,
+                               std::vector<layer> & layers,
+                               std::vector<box2d<double>> const& extents,
+                               double scale_denom,
+                               std::vector<layer_buckets> & result,
+                               bool spatial_index = false);
+
+} // namespace detail
+
+} // namespace mapnik
+
+#endif // MAPNIK_RENDERER_COMMON_LAYER_BUCKETS_HPP
@@ -0,0 +1,199 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_RENDERER_COMMON_LINE_PATH_CACHE_HPP
+#define MAPNIK_RENDERER_COMMON_LINE_PATH_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/simplify.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_basics.h"
+#pragma GCC diagnostic pop
+
+// stl
+#include <array>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace mapnik {
+
+// Vertices of a line once transformed, clipped, simplified, smoothed and
+// offset, in pixels, ready to be dashed and stroked. Every part of the
+// geometry is recorded as a path of its own.
+class line_path
+{
+public:
+    struct node
+    {
+        double x;
+        double y;
+        unsigned cmd;
+    };
+
+    // vertex source replaying one recorded part
+    class part
+    {
+    public:
+        part(node const* begin, node const* end)
+            : begin_(begin), end_(end), pos_(begin) {}
+
+        void rewind(unsigned)
+        {
+            pos_ = begin_;
+        }
+
+        unsigned vertex(double * x, double * y)
+        {
+            if (pos_ == end_) return agg::path_cmd_stop;
+            *x = pos_->x;
+            *y = pos_->y;
+            return (pos_++)->cmd;
+        }
+
+    private:
+        node const* begin_;
+        node const* end_;
+        node const* pos_;
+    };
+
+    // records a part, the processor of a vertex_converter
+    template <typename Path>
+    void add_path(Path & path)
+    {
+        path.rewind(0);
+        double x, y;
+        unsigned cmd;
+        while ((cmd = path.vertex(&x, &y)) != agg::path_cmd_stop)
+        {
+            nodes_.push_back(node{x, y, cmd});
+        }
+        ends_.push_back(nodes_.size());
+    }
+
+    template <typename Func>
+    void for_each_part(Func && func) const
+    {
+        std::size_t begin = 0;
+        for (std::size_t end : ends_)
+        {
+            part p(nodes_.data() + begin, nodes_.data() + end);
+            func(p);
+            begin = end;
+        }
+    }
+
+    void clear()
+    {
+        nodes_.clear();
+        ends_.clear();
+    }
+
+private:
+    std::vector<node> nodes_;
+    std::vector<std::size_t> ends_;
+};
+
+// What the converters producing a line_path depend on besides the
+// feature, the layer and the clip box.
+struct line_path_key
+{
+    std::array<double, 6> affine;
+    double offset;
+    double simplify_tolerance;
+    double smooth;
+    simplify_algorithm_e simplify_algorithm;
+    bool simplify_prefilter;
+    bool clip;
+
+    bool operator==(line_path_key const& rhs) const
+    {
+        return affine == rhs.affine &&
+            offset == rhs.offset &&
+            simplify_tolerance == rhs.simplify_tolerance &&
+            smooth == rhs.smooth &&
+            simplify_algorithm == rhs.simplify_algorithm &&
+            simplify_prefilter == rhs.simplify_prefilter &&
+            clip == rhs.clip;
+    }
+};
+
+// The line_paths of the feature being drawn, so the casing, fill and
+// centerline of a road convert its geometry once and only stroke it
+// again. Only the feature passed to start_feature() is cached, holding
+// on to it so its address can't be taken by another feature meanwhile.
+class MAPNIK_DECL line_path_cache : util::noncopyable
+{
+public:
+    line_path_cache();
+
+    // Whether the paths of a feature are kept once the next one starts,
+    // for layers drawing the same features with several styles.
+    void retain(bool retain);
+
+    void start_feature(feature_ptr const& feature);
+
+    void clear();
+
+    // The path recorded for the feature with the same key and a clip box
+    // holding clip_box, the same box when exact; nullptr if there is none.
+    line_path const* find(feature_impl const& feature, line_path_key const& key,
+                          box2d<double> const& clip_box, bool exact) const;
+
+    // An empty path to record for the feature, replacing the one with the
+    // same key; nullptr when the feature isn't the one started.
+    line_path * insert(feature_impl const& feature, line_path_key const& key,
+                       box2d<double> const& clip_box);
+
+private:
+    struct entry
+    {
+        line_path_key key;
+        box2d<double> clip_box;
+        line_path path;
+    };
+
+    struct feature_paths
+    {
+        feature_ptr feature;
+        // the first size entries are in use, the others keep their storage
+        std::vector<entry> entries;
+        std::size_t size = 0;
+    };
+
+    bool retain_;
+    feature_ptr started_;
+    // the paths of the started feature, if any
+    feature_paths * current_;
+    feature_paths recent_;
+    std::unordered_map<feature_impl const*, feature_paths> features_;
+};
+
+} // namespace mapnik
+
+#endif // MAPNIK_RENDERER_COMMON_LINE_PATH_CACHE_HPP
@@ -29,18 +29,47 @@
 #include <mapnik/path.hpp>
 
 #include <algorithm>
-#include <deque>
+#include <utility>
+#include <vector>
 
 namespace mapnik {
 
 namespace detail {
 
+// Scratch storage of make_building, kept per thread so each building
+// reuses the segments and vertex blocks of the one before it.
+struct building_buffers
+{
+    std::vector<segment_t> segments;
+    path_type faces{path_type::types::Polygon};
+    path_type frame{path_type::types::LineString};
+    path_type roof{path_type::types::Polygon};
+};
+
+inline building_buffers & thread_building_buffers()
+{
+    static thread_local building_buffers buffers;
+    return buffers;
+}
+
+// Walls are handed to face_func back to front, one at a time, or all in
+// one path when batch_faces is set. Batched walls are wound the same way
+// so overlapping ones are filled once rather than cancelling out, which
+// only matches drawing them one by one for opaque fills.
 template <typename F1, typename F2, typename F3>
-void make_building(geometry::polygon<double> const& poly, double height, F1 const& face_func, F2 const& frame_func, F3 const& roof_func)
+void make_building(geometry::polygon<double> const& poly, double height, bool batch_faces,
+                   F1 const& face_func, F2 const& frame_func, F3 const& roof_func)
 {
-    path_type frame(path_type::types::LineString);
-    path_type roof(path_type::types::Polygon);
-    std::deque<segment_t> face_segments;
+    building_buffers & buffers = thread_building_buffers();
+    std::vector<segment_t> & face_segments = buffers.segments;
+    path_type & faces = buffers.faces;
+    path_type & frame = buffers.frame;
+    path_type & roof = buffers.roof;
+    face_segments.clear();
+    faces.clear();
+    frame.clear();
+    roof.clear();
+
     double ring_begin_x, ring_begin_y;
     double x0 = 0;
     double y0 = 0;
@@ -76,17 +105,32 @@ void make_building(geometry::polygon<double> const& poly, double height, F1 cons
     std::sort(face_segments.begin(),face_segments.end(), y_order);
     for (auto const& seg : face_segments)
     {
-        path_type faces(path_type::types::Polygon);
-        faces.move_to(std::get<0>(seg),std::get<1>(seg));
-        faces.line_to(std::get<2>(seg),std::get<3>(seg));
-        faces.line_to(std::get<2>(seg),std::get<3>(seg) + height);
-        faces.line_to(std::get<0>(seg),std::get<1>(seg) + height);
-
-        face_func(faces);
+        double sx0 = std::get<0>(seg);
+        double sy0 = std::get<1>(seg);
+        double sx1 = std::get<2>(seg);
+        double sy1 = std::get<3>(seg);
+        if (batch_faces && sx1 < sx0)
+        {
+            std::swap(sx0, sx1);
+            std::swap(sy0, sy1);
+        }
+        faces.move_to(sx0, sy0);
+        faces.line_to(sx1, sy1);
+        faces.line_to(sx1, sy1 + height);
+        faces.line_to(sx0, sy0 + height);
+        if (!batch_faces)
+        {
+            face_func(faces);
+            faces.clear();
+        }
         //
         frame.move_to(std::get<0>(seg),std::get<1>(seg));
         frame.line_to(std::get<0>(seg),std::get<1>(seg)+height);
     }
+    if (faces.size() > 0)
+    {
+        face_func(faces);
+    }
 
     va.rewind(0);
     for (unsigned cm = va.vertex(&x, &y); cm != SEG_END;
@@ -117,7 +161,7 @@ void make_building(geometry::polygon<double> const& poly, double height, F1 cons
 
 template <typename F1, typename F2, typename F3>
 void render_building_symbolizer(mapnik::feature_impl const& feature,
-                                double height,
+                                double height, bool batch_faces,
                                 F1 face_func, F2 frame_func, F3 roof_func)
 {
 
@@ -125,14 +169,14 @@ void render_building_symbolizer(mapnik::feature_impl const& feature,
     if (geom.is<geometry::polygon<double> >())
     {
         auto const& poly = geom.get<geometry::polygon<double> >();
-        detail::make_building(poly, height, face_func, frame_func, roof_func);
+        detail::make_building(poly, height, batch_faces, face_func, frame_func, roof_func);
     }
     else if (geom.is<geometry::multi_polygon<double> >())
     {
         auto const& multi_poly = geom.get<geometry::multi_polygon<double> >();
         for (auto const& poly : multi_poly)
         {
-            detail::make_building(poly, height, face_func, frame_func, roof_func);
+            detail::make_building(poly, height, batch_faces, face_func, frame_func, roof_func);
         }
     }
 }
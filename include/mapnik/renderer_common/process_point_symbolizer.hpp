@@ -34,6 +34,7 @@
 #include <mapnik/geometry/geometry_types.hpp>
 #include <mapnik/vertex_adapters.hpp>
 #include <mapnik/geom_util.hpp>
+#include <mapnik/renderer_common/interior_position.hpp>
 
 namespace mapnik {
 
@@ -67,7 +68,7 @@ void render_point_symbolizer(point_symbolizer const &sym,
         agg::trans_affine recenter_tr = recenter * tr;
         box2d<double> label_ext = bbox * recenter_tr * agg::trans_affine_scaling(common.scale_factor_);
 
-        mapnik::geometry::geometry<double> const& geometry = feature.get_geometry();
+        mapnik::geometry::geometry<double> const& geometry = static_cast<feature_impl const&>(feature).get_geometry();
         mapnik::geometry::point<double> pt;
         geometry::geometry_types type = geometry::geometry_type(geometry);
         if (placement == CENTROID_POINT_PLACEMENT ||
@@ -79,8 +80,7 @@ void render_point_symbolizer(point_symbolizer const &sym,
         else if (type == mapnik::geometry::geometry_types::Polygon)
         {
             auto const& poly = mapnik::util::get<geometry::polygon<double> >(geometry);
-            geometry::polygon_vertex_adapter<double> va(poly);
-            if (!label::interior_position(va ,pt.x, pt.y))
+            if (!interior_position(feature, poly, prj_trans, common.t_, pt.x, pt.y))
                 return;
         }
         else
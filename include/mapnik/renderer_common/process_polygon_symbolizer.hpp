@@ -30,11 +30,13 @@
 
 #include <mapnik/feature.hpp>
 #include <mapnik/renderer_common/apply_vertex_converter.hpp>
+#include <mapnik/renderer_common/compiled_symbolizer.hpp>
 
 namespace mapnik {
 
 template <typename vertex_converter_type, typename rasterizer_type, typename F>
 void render_polygon_symbolizer(polygon_symbolizer const &sym,
+                               compiled_polygon_symbolizer const& props,
                                mapnik::feature_impl & feature,
                                proj_transform const& prj_trans,
                                renderer_common & common,
@@ -43,18 +45,17 @@ void render_polygon_symbolizer(polygon_symbolizer const &sym,
                                F fill_func)
 {
     agg::trans_affine tr;
-    auto transform = get_optional<transform_type>(sym, keys::geometry_transform);
-    if (transform) evaluate_transform(tr, feature, common.vars_, *transform, common.scale_factor_);
+    if (props.geometry_transform) evaluate_transform(tr, feature, common.vars_, *props.geometry_transform, common.scale_factor_);
 
-    value_bool clip = get<value_bool,keys::clip>(sym, feature, common.vars_);
-    value_double simplify_tolerance = get<value_double,keys::simplify_tolerance>(sym, feature, common.vars_);
-    value_double smooth = get<value_double,keys::smooth>(sym, feature, common.vars_);
-    value_double opacity = get<value_double,keys::fill_opacity>(sym, feature, common.vars_);
+    value_bool clip = props.clip.get(feature, common.vars_);
+    value_double simplify_tolerance = props.simplify_tolerance.get(feature, common.vars_);
+    value_double smooth = props.smooth.get(feature, common.vars_);
+    value_double opacity = props.fill_opacity.get(feature, common.vars_);
 
     vertex_converter_type converter(clip_box, sym, common.t_, prj_trans, tr,
                                     feature,common.vars_,common.scale_factor_);
 
-    if (prj_trans.equal() && clip) converter.template set<clip_poly_tag>();
+    if ((prj_trans.equal() || prj_trans.is_known()) && clip) converter.template set<clip_poly_tag>();
     converter.template set<transform_tag>(); //always transform
     converter.template set<affine_transform_tag>();
     if (simplify_tolerance > 0.0) converter.template set<simplify_tag>(); // optional simplify converter
@@ -63,12 +64,28 @@ void render_polygon_symbolizer(polygon_symbolizer const &sym,
     using apply_vertex_converter_type = detail::apply_vertex_converter<vertex_converter_type, rasterizer_type>;
     using vertex_processor_type = geometry::vertex_processor<apply_vertex_converter_type>;
     apply_vertex_converter_type apply(converter, ras);
-    mapnik::util::apply_visitor(vertex_processor_type(apply),feature.get_geometry());
+    if (!converter.clipped_away(feature))
+    {
+        mapnik::util::apply_visitor(vertex_processor_type(apply),static_cast<feature_impl const&>(feature).get_geometry());
+    }
 
-    color const& fill = get<mapnik::color, keys::fill>(sym, feature, common.vars_);
+    color const& fill = props.fill.get(feature, common.vars_);
     fill_func(fill, opacity);
 }
 
+template <typename vertex_converter_type, typename rasterizer_type, typename F>
+void render_polygon_symbolizer(polygon_symbolizer const &sym,
+                               mapnik::feature_impl & feature,
+                               proj_transform const& prj_trans,
+                               renderer_common & common,
+                               box2d<double> const& clip_box,
+                               rasterizer_type & ras,
+                               F fill_func)
+{
+    render_polygon_symbolizer<vertex_converter_type>(sym, compiled_polygon_symbolizer(sym), feature, prj_trans,
+                                                     common, clip_box, ras, fill_func);
+}
+
 } // namespace mapnik
 
 #endif // MAPNIK_RENDERER_COMMON_PROCESS_POLYGON_SYMBOLIZER_HPP
@@ -57,7 +57,8 @@ struct image_dispatcher
                           scaling_method_e method, double filter_factor,
                           double opacity, composite_mode_e comp_op,
                           raster_symbolizer const& sym, feature_impl const& feature,
-                          F & composite, boost::optional<double> const& nodata, bool need_scaling)
+                          F & composite, boost::optional<double> const& nodata, bool need_scaling,
+                          unsigned threads)
         : start_x_(start_x),
           start_y_(start_y),
           width_(width),
@@ -74,7 +75,8 @@ struct image_dispatcher
           feature_(feature),
           composite_(composite),
           nodata_(nodata),
-          need_scaling_(need_scaling) {}
+          need_scaling_(need_scaling),
+          threads_(threads) {}
 
     void operator() (image_null const&) const {}  //no-op
     void operator() (image_rgba8 const& data_in) const
@@ -82,7 +84,7 @@ struct image_dispatcher
         if (need_scaling_)
         {
             image_rgba8 data_out(width_, height_, true, true);
-            scale_image_agg(data_out, data_in,  method_, scale_x_, scale_y_, offset_x_, offset_y_, filter_factor_, nodata_);
+            scale_image_agg(data_out, data_in,  method_, scale_x_, scale_y_, offset_x_, offset_y_, filter_factor_, nodata_, threads_);
             composite_(data_out, comp_op_, opacity_, start_x_, start_y_);
         }
         else
@@ -100,12 +102,12 @@ struct image_dispatcher
         if (need_scaling_)
         {
             image_type data_out(width_, height_);
-            scale_image_agg(data_out, data_in,  method_, scale_x_, scale_y_, offset_x_, offset_y_, filter_factor_, nodata_);
-            if (colorizer) colorizer->colorize(dst, data_out, nodata_, feature_);
+            scale_image_agg(data_out, data_in,  method_, scale_x_, scale_y_, offset_x_, offset_y_, filter_factor_, nodata_, threads_);
+            if (colorizer) colorizer->colorize(dst, data_out, nodata_, feature_, threads_);
         }
         else
         {
-            if (colorizer) colorizer->colorize(dst, data_in, nodata_, feature_);
+            if (colorizer) colorizer->colorize(dst, data_in, nodata_, feature_, threads_);
         }
         premultiply_alpha(dst);
         composite_(dst, comp_op_, opacity_, start_x_, start_y_);
@@ -128,6 +130,7 @@ private:
     composite_function & composite_;
     boost::optional<double> const& nodata_;
     bool need_scaling_;
+    unsigned threads_;
 };
 
 template <typename F>
@@ -139,7 +142,8 @@ struct image_warp_dispatcher
                                box2d<double> const& target_ext, box2d<double> const& source_ext,
                                double offset_x, double offset_y, unsigned mesh_size, scaling_method_e scaling_method,
                                double filter_factor, double opacity, composite_mode_e comp_op,
-                               raster_symbolizer const& sym, feature_impl const& feature, F & composite, boost::optional<double> const& nodata)
+                               raster_symbolizer const& sym, feature_impl const& feature, F & composite, boost::optional<double> const& nodata,
+                               unsigned threads)
         : prj_trans_(prj_trans),
         start_x_(start_x),
         start_y_(start_y),
@@ -157,14 +161,15 @@ struct image_warp_dispatcher
         sym_(sym),
         feature_(feature),
         composite_(composite),
-        nodata_(nodata) {}
+        nodata_(nodata),
+        threads_(threads) {}
 
     void operator() (image_null const&) const {} //no-op
 
     void operator() (image_rgba8 const& data_in) const
     {
         image_rgba8 data_out(width_, height_, true, true);
-        warp_image(data_out, data_in, prj_trans_, target_ext_, source_ext_, offset_x_, offset_y_, mesh_size_, scaling_method_, filter_factor_, nodata_);
+        warp_image(data_out, data_in, prj_trans_, target_ext_, source_ext_, offset_x_, offset_y_, mesh_size_, scaling_method_, filter_factor_, nodata_, threads_);
         composite_(data_out, comp_op_, opacity_, start_x_, start_y_);
     }
 
@@ -174,10 +179,10 @@ struct image_warp_dispatcher
         using image_type = T;
         image_type data_out(width_, height_);
         if (nodata_) data_out.set(*nodata_);
-        warp_image(data_out, data_in, prj_trans_, target_ext_, source_ext_, offset_x_, offset_y_, mesh_size_, scaling_method_, filter_factor_, nodata_);
+        warp_image(data_out, data_in, prj_trans_, target_ext_, source_ext_, offset_x_, offset_y_, mesh_size_, scaling_method_, filter_factor_, nodata_, threads_);
         image_rgba8 dst(width_, height_);
         raster_colorizer_ptr colorizer = get<raster_colorizer_ptr>(sym_, keys::colorizer);
-        if (colorizer) colorizer->colorize(dst, data_out, nodata_, feature_);
+        if (colorizer) colorizer->colorize(dst, data_out, nodata_, feature_, threads_);
         premultiply_alpha(dst);
         composite_(dst, comp_op_, opacity_, start_x_, start_y_);
     }
@@ -200,6 +205,7 @@ private:
     feature_impl const& feature_;
     composite_function & composite_;
     boost::optional<double> const& nodata_;
+    unsigned threads_;
 };
 
 }
@@ -209,7 +215,8 @@ void render_raster_symbolizer(raster_symbolizer const& sym,
                               mapnik::feature_impl& feature,
                               proj_transform const& prj_trans,
                               renderer_common& common,
-                              F composite)
+                              F composite,
+                              unsigned threads = 1)
 {
     raster_ptr const& source = feature.get_raster();
     if (source)
@@ -253,7 +260,8 @@ void render_raster_symbolizer(raster_symbolizer const& sym,
                 detail::image_warp_dispatcher<F> dispatcher(prj_trans, start_x, start_y, raster_width, raster_height,
                                                                  target_query_ext, source->ext_, offset_x, offset_y, mesh_size,
                                                                  scaling_method, source->get_filter_factor(),
-                                                                 opacity, comp_op, sym, feature, composite, source->nodata());
+                                                                 opacity, comp_op, sym, feature, composite, source->nodata(),
+                                                                 threads);
                 util::apply_visitor(dispatcher, source->data_);
             }
             else
@@ -271,7 +279,8 @@ void render_raster_symbolizer(raster_symbolizer const& sym,
                                                             image_ratio_x, image_ratio_y,
                                                             offset_x, offset_y,
                                                             scaling_method, source->get_filter_factor(),
-                                                            opacity, comp_op, sym, feature, composite, source->nodata(), scale);
+                                                            opacity, comp_op, sym, feature, composite, source->nodata(), scale,
+                                                            threads);
                 util::apply_visitor(dispatcher, source->data_);
             }
         }
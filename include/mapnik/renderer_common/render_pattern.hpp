@@ -23,8 +23,16 @@
 #ifndef MAPNIK_RENDER_PATTERN_HPP
 #define MAPNIK_RENDER_PATTERN_HPP
 
+#include <mapnik/config.hpp>
 #include <mapnik/image.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <array>
+#include <cstddef>
+#include <map>
 #include <memory>
+#include <utility>
 
 // fwd decl
 namespace agg {
@@ -36,6 +44,7 @@ namespace mapnik {
 // fwd decl
 struct rasterizer;
 struct marker_svg;
+struct marker;
 
 template <typename T>
 void render_pattern(rasterizer & ras,
@@ -44,6 +53,49 @@ void render_pattern(rasterizer & ras,
                     double opacity,
                     T & image);
 
+// Pattern images rasterized from SVG markers, kept per thread so that the
+// polygons and lines of a style, and the renders following, draw the same
+// pattern from one image. Entries are keyed by marker, transform (which
+// includes the scale factor) and opacity and hold on to their marker; the
+// cache is emptied when the images it holds grow over max_bytes.
+class MAPNIK_DECL pattern_image_cache : private util::noncopyable
+{
+public:
+    using marker_ptr = std::shared_ptr<marker const>;
+    using image_ptr = std::shared_ptr<image_rgba8 const>;
+    static constexpr std::size_t max_bytes = 64 * 1024 * 1024;
+
+    static pattern_image_cache & instance();
+
+    // image of owner drawn with tr, render() returning the image drawn
+    template <typename Render>
+    image_ptr get(marker_ptr const& owner, agg::trans_affine const& tr,
+                  double opacity, Render render)
+    {
+        key_type key = make_key(owner, tr, opacity);
+        if (image_ptr image = find(key)) return image;
+        return insert(key, owner, render());
+    }
+
+    std::size_t size() const;
+    void clear();
+
+private:
+    using key_type = std::pair<marker const*, std::array<double, 7> >;
+    struct entry
+    {
+        marker_ptr owner;
+        image_ptr image;
+    };
+
+    static key_type make_key(marker_ptr const& owner, agg::trans_affine const& tr, double opacity);
+    image_ptr find(key_type const& key) const;
+    image_ptr insert(key_type const& key, marker_ptr const& owner, image_rgba8 && image);
+
+    std::map<key_type, entry> cache_;
+    std::size_t bytes_ = 0;
+};
+
 } // namespace mapnik
 
 
@@ -0,0 +1,108 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_RULE_BANDS_HPP
+#define MAPNIK_RULE_BANDS_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/rule_cache.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/optional.hpp>
+#pragma GCC diagnostic pop
+
+// stl
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace mapnik
+{
+
+class feature_type_style;
+
+// The rules of a style active in a band of scale denominators, ready for
+// rendering: their rule_cache and the attributes they read.
+struct rule_band
+{
+    rule_band()
+        : rules(),
+          names(),
+          filter_factor(),
+          filter(),
+          vars(),
+          active(false) {}
+
+    rule_cache rules;
+    std::set<std::string> names;
+    // set by the last raster symbolizer of the rules asking for one
+    boost::optional<double> filter_factor;
+    // matched by every feature some rule draws, null when that can't be
+    // told from the filters
+    expression_ptr filter;
+    // the variables the rule properties were evaluated against
+    attributes vars;
+    // false when no rule is active in the band
+    bool active;
+};
+
+// The rule_bands of a style, made on first use of each band and kept
+// until the rules change, so renders at the same scale only look theirs
+// up. Safe to use from several renders at once.
+//
+// Bands point into the rules of the style. They are dropped by the style
+// calls that may change the rules, and by get() when the rules were
+// added to or moved since; edits in place through a reference kept from
+// feature_type_style::get_rules_nonconst() are not seen.
+class MAPNIK_DECL rule_bands : util::noncopyable
+{
+public:
+    using band_ptr = std::shared_ptr<rule_band const>;
+
+    rule_bands();
+
+    band_ptr get(feature_type_style const& style, double scale_denom, attributes const& vars);
+
+    void clear();
+
+private:
+    std::mutex mutex_;
+    bool ready_;
+    // the rules the bands were made from
+    rule const* first_rule_;
+    std::size_t num_rules_;
+    // sorted scale denominators where rules start or stop being active,
+    // band i lies between limits_[i - 1] and limits_[i]
+    std::vector<double> limits_;
+    std::vector<band_ptr> bands_;
+};
+
+}
+
+#endif // MAPNIK_RULE_BANDS_HPP
@@ -24,36 +24,75 @@
 #define MAPNIK_RULE_CACHE_HPP
 
 // mapnik
+#include <mapnik/config.hpp>
 #include <mapnik/rule.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/compiled_expression.hpp>
 #include <mapnik/util/noncopyable.hpp>
 
 // stl
+#include <atomic>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <type_traits>
 
 namespace mapnik
 {
 
-class rule_cache : private util::noncopyable
+class MAPNIK_DECL rule_cache : private util::noncopyable
 {
 public:
     using rule_ptrs = std::vector<rule const*>;
+    using filters = std::vector<compiled_expression>;
+    using rule_indices = std::vector<std::size_t>;
+
+    // smallest number of if rules keyed on one attribute worth indexing
+    static constexpr std::size_t min_indexed_rules = 4;
+
     rule_cache()
         : if_rules_(),
+          if_filters_(),
           else_rules_(),
-          also_rules_() {}
+          also_rules_(),
+          index_key_(),
+          string_rules_(),
+          integer_rules_(),
+          unkeyed_rules_(),
+          evaluated_rules_(),
+          origins_(),
+          exclusive_(false),
+          matches_() {}
 
     rule_cache(rule_cache && rhs) // move ctor
         :  if_rules_(std::move(rhs.if_rules_)),
+           if_filters_(std::move(rhs.if_filters_)),
            else_rules_(std::move(rhs.else_rules_)),
-           also_rules_(std::move(rhs.also_rules_))
+           also_rules_(std::move(rhs.also_rules_)),
+           index_key_(std::move(rhs.index_key_)),
+           string_rules_(std::move(rhs.string_rules_)),
+           integer_rules_(std::move(rhs.integer_rules_)),
+           unkeyed_rules_(std::move(rhs.unkeyed_rules_)),
+           evaluated_rules_(std::move(rhs.evaluated_rules_)),
+           origins_(std::move(rhs.origins_)),
+           exclusive_(rhs.exclusive_),
+           matches_(std::move(rhs.matches_))
     {}
 
     rule_cache& operator=(rule_cache && rhs) // move assign
     {
         std::swap(if_rules_, rhs.if_rules_);
+        std::swap(if_filters_, rhs.if_filters_);
         std::swap(else_rules_,rhs.else_rules_);
         std::swap(also_rules_, rhs.also_rules_);
+        std::swap(index_key_, rhs.index_key_);
+        std::swap(string_rules_, rhs.string_rules_);
+        std::swap(integer_rules_, rhs.integer_rules_);
+        std::swap(unkeyed_rules_, rhs.unkeyed_rules_);
+        std::swap(evaluated_rules_, rhs.evaluated_rules_);
+        std::swap(origins_, rhs.origins_);
+        std::swap(exclusive_, rhs.exclusive_);
+        std::swap(matches_, rhs.matches_);
         return *this;
     }
 
@@ -70,14 +109,72 @@ public:
         else
         {
             if_rules_.push_back(&r);
+            if_filters_.emplace_back(r.get_filter());
         }
     }
 
+    // Adds r with the symbolizer properties that don't depend on the
+    // feature evaluated once against vars. Rules with such properties are
+    // copied, the copies live as long as the cache.
+    void add_rule(rule const& r, attributes const& vars);
+
+    // Number of rules copied by add_rule(r, vars).
+    std::size_t num_evaluated_rules() const { return evaluated_rules_.size(); }
+
+    // The rule r was added from: r itself unless add_rule(r, vars)
+    // copied it.
+    rule const& origin(rule const& r) const
+    {
+        auto itr = origins_.find(&r);
+        return itr != origins_.end() ? *itr->second : r;
+    }
+
     rule_ptrs const& get_if_rules() const
     {
         return if_rules_;
     }
 
+    // compiled filters of the if rules, in the same order
+    filters const& get_if_filters() const
+    {
+        return if_filters_;
+    }
+
+    // Analyzes the if rule filters once all rules are added. When enough
+    // of them are equality tests, or 'or' chains of equality tests, of
+    // one attribute against string or integer literals, a table from
+    // literal to rules is built so that select_if_rules can skip rules
+    // that cannot match. Also finds out whether the if rules are
+    // exclusive.
+    void build_index();
+
+    bool indexed() const { return static_cast<bool>(index_key_); }
+
+    // name of the attribute rules are dispatched on, empty if none
+    std::string index_attribute() const;
+
+    // Fills candidates with the indices, in rule order, of the if rules
+    // whose filter may match feature; the filters still need evaluating.
+    // Returns false when there is no index and all if rules need testing.
+    bool select_if_rules(feature_impl const& feature, rule_indices & candidates) const;
+
+    // True when no feature can match more than one if rule: every filter
+    // tests the same attribute for equality with literals or for lying in
+    // a numeric range, and no two rules share a literal or overlapping
+    // range. Such filters need no evaluating once one has matched, in
+    // whichever order they are tried.
+    bool exclusive() const { return exclusive_; }
+
+    // Adds counts[i] to the number of features if rule i was seen to
+    // match. Safe to call from concurrent renders sharing the cache.
+    void record_matches(std::vector<std::size_t> const& counts) const;
+
+    // Fills order with the indices of the if rules in the order their
+    // filters are best evaluated: most often matched first for exclusive
+    // rules, so that features stop at their rule sooner, rule order
+    // otherwise.
+    void evaluation_order(rule_indices & order) const;
+
     rule_ptrs const& get_else_rules() const
     {
         return else_rules_;
@@ -90,8 +187,29 @@ public:
 
 private:
     rule_ptrs if_rules_;
+    filters if_filters_;
     rule_ptrs else_rules_;
     rule_ptrs also_rules_;
+
+    struct unicode_string_hash
+    {
+        std::size_t operator()(value_unicode_string const& str) const
+        {
+            return static_cast<std::size_t>(str.hashCode());
+        }
+    };
+
+    std::unique_ptr<attribute> index_key_;
+    std::unordered_map<value_unicode_string, rule_indices, unicode_string_hash> string_rules_;
+    std::unordered_map<value_integer, rule_indices> integer_rules_;
+    // rules not keyed on index_key_, candidates for every feature
+    rule_indices unkeyed_rules_;
+    std::vector<std::unique_ptr<rule>> evaluated_rules_;
+    // copied rule to the rule it was copied from
+    std::unordered_map<rule const*, rule const*> origins_;
+    bool exclusive_;
+    // features matched per if rule by all renders using the cache
+    mutable std::unique_ptr<std::atomic<std::size_t>[]> matches_;
 };
 
 }
@@ -0,0 +1,91 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_SOLID_TILE_CACHE_HPP
+#define MAPNIK_SOLID_TILE_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+
+namespace mapnik
+{
+
+// Process wide cache of encoded solid rgba8 images, keyed by format string
+// (with its options, e.g. "png8:z=1"), size, pixel value and whether the
+// pixel is premultiplied. save_to_string and save_to_buffer hand out these
+// buffers instead of encoding solid tiles (ocean, empty land) over again.
+// The least recently used buffers are evicted once more than max_bytes()
+// are held; a budget of 0 disables the cache.
+class MAPNIK_DECL solid_tile_cache :
+        public singleton<solid_tile_cache, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<solid_tile_cache>;
+public:
+    using buffer_ptr = std::shared_ptr<std::string const>;
+    // format, width, height, pixel and premultiplied
+    using key_type = std::tuple<std::string, std::size_t, std::size_t, std::uint32_t, bool>;
+
+    static constexpr std::size_t default_max_bytes = 4 * 1024 * 1024;
+
+    void set_max_bytes(std::size_t max_bytes);
+    std::size_t max_bytes() const;
+
+    buffer_ptr find(key_type const& key);
+    void insert(key_type const& key, std::string const& buffer);
+    std::size_t size() const;
+    void clear();
+
+private:
+    solid_tile_cache();
+    void evict();
+
+    struct entry
+    {
+        buffer_ptr buffer;
+        std::list<key_type>::iterator lru;
+    };
+
+    std::map<key_type, entry> entries_;
+    // most recently used first
+    std::list<key_type> lru_;
+    std::size_t max_bytes_;
+    std::size_t num_bytes_;
+};
+
+extern template class MAPNIK_DECL singleton<solid_tile_cache, CreateStatic>;
+
+}
+
+#endif // MAPNIK_SOLID_TILE_CACHE_HPP
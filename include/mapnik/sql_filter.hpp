@@ -0,0 +1,50 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_SQL_FILTER_HPP
+#define MAPNIK_SQL_FILTER_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/expression_node_types.hpp>
+#include <mapnik/feature_layer_desc.hpp>
+
+// stl
+#include <string>
+
+namespace mapnik { namespace sql_utils {
+
+// Translates the parts of a query filter an SQL WHERE clause can test
+// into a condition on the columns of desc, for datasources leaving out
+// the rows no rule draws. Every row whose feature matches the filter
+// matches the condition: parts that can't be told exactly, such as
+// comparisons between different types, regular expressions or 'not',
+// are widened to match everything. Global attributes are read from
+// vars. Returns an empty string when nothing is left to test.
+MAPNIK_DECL std::string filter_to_sql(expr_node const& filter,
+                                      layer_descriptor const& desc,
+                                      attributes const& vars);
+
+}}
+
+#endif // MAPNIK_SQL_FILTER_HPP
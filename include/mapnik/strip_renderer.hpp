@@ -0,0 +1,115 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_STRIP_RENDERER_HPP
+#define MAPNIK_STRIP_RENDERER_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <functional>
+
+namespace mapnik {
+
+class Map;
+
+/*!
+ * \brief renders a large map as horizontal strips on several threads.
+ *
+ * Every vector layer is queried once, serially, for the whole (buffered)
+ * map extent. Each strip is then rendered on its own thread with its own
+ * agg_renderer and rasterizer, straight into its rows of the output image,
+ * drawing only the symbolizers which don't use the placement detector.
+ * The labels, and the point and markers symbolizers checking for
+ * collisions, are placed afterwards in a serial pass over the whole image
+ * with a single detector, so they are drawn above the other symbolizers
+ * of all layers.
+ *
+ * Raster layers are queried per strip and their datasources must support
+ * concurrent queries. Maps whose output does not stitch, those with image
+ * filters, a background image or polygon patterns, are rendered in a
+ * single pass instead, see splittable().
+ *
+ * For outputs too large to hold, such as print exports, the strips can
+ * instead be rendered one after another into a strip sized image and
+ * handed to a sink, e.g. a png_row_writer, see apply(band_sink).
+ */
+class MAPNIK_DECL strip_renderer : private util::noncopyable
+{
+public:
+    // receives the rows of a strip, starting at map row `row`
+    using band_sink = std::function<void(image_rgba8 const& band, unsigned row)>;
+
+    strip_renderer(Map const& m,
+                   unsigned strips,
+                   double scale_factor = 1.0);
+
+    unsigned strips() const { return strips_; }
+
+    /*!
+     * \brief first row of a strip, strips() gives the map height.
+     */
+    unsigned strip_row(unsigned strip) const;
+
+    /*!
+     * \brief geographic extent of a strip, in map projection.
+     */
+    box2d<double> strip_extent(unsigned strip) const;
+
+    /*!
+     * \brief whether the map can be rendered in strips.
+     */
+    static bool splittable(Map const& m);
+
+    /*!
+     * \brief render the map into image, resized to the map size.
+     */
+    void apply(image_rgba8 & image, double scale_denom = 0.0) const;
+
+    /*!
+     * \brief render the map a strip at a time, top to bottom, passing
+     * each to sink.
+     *
+     * Only one strip sized image is allocated, so memory is bounded by
+     * the strip size rather than the map size. Layers are queried per
+     * strip for the geometry symbolizers. The labels are placed for the
+     * whole map, as by apply(image_rgba8&), and the placement is replayed
+     * for each strip, drawing only what falls inside it, so labels across
+     * strip edges are drawn whole and in the same positions. Maps which
+     * are not splittable() are rendered whole and handed out in strips.
+     */
+    void apply(band_sink const& sink, double scale_denom = 0.0) const;
+
+private:
+    Map const& m_;
+    unsigned strips_;
+    double scale_factor_;
+};
+
+}
+
+#endif // MAPNIK_STRIP_RENDERER_HPP
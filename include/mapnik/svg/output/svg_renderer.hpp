@@ -76,6 +76,11 @@ public:
     void end_map_processing(Map const& map);
     void start_layer_processing(layer const& lay, box2d<double> const& query_extent);
     void end_layer_processing(layer const& lay);
+    // every layer keeps its group, empty or not
+    bool skips_empty_layers() const
+    {
+        return false;
+    }
     void start_style_processing(feature_type_style const& /*st*/) {}
     void end_style_processing(feature_type_style const& /*st*/) {}
 
@@ -136,6 +141,9 @@ public:
         painted_ = _painted;
     }
 
+    // fraction of the placement detector extent covered by labels
+    double label_coverage() const;
+
     inline eAttributeCollectionPolicy attribute_collection_policy() const
     {
         return DEFAULT;
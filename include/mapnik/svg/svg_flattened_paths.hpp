@@ -0,0 +1,260 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_SVG_FLATTENED_PATHS_HPP
+#define MAPNIK_SVG_FLATTENED_PATHS_HPP
+
+// mapnik
+#include <mapnik/svg/svg_path_adapter.hpp>
+#include <mapnik/svg/svg_path_attributes.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_basics.h"
+#include "agg_conv_curve.h"
+#include "agg_conv_stroke.h"
+#pragma GCC diagnostic pop
+
+// stl
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#ifdef MAPNIK_THREADSAFE
+#include <mutex>
+#endif
+
+namespace mapnik {
+namespace svg {
+
+// Vertex source reading back flattened vertices from the start
+class flat_vertex_source
+{
+public:
+    explicit flat_vertex_source(svg_path_storage const& vertices)
+        : vertices_(vertices),
+          pos_(0) {}
+
+    void rewind(unsigned)
+    {
+        pos_ = 0;
+    }
+
+    unsigned vertex(double * x, double * y)
+    {
+        if (pos_ >= vertices_.size()) return agg::path_cmd_stop;
+        auto const& v = vertices_[pos_++];
+        *x = v.x;
+        *y = v.y;
+        return v.cmd;
+    }
+
+private:
+    svg_path_storage const& vertices_;
+    std::size_t pos_;
+};
+
+// The paths of a parsed SVG with their curves flattened by agg::conv_curve,
+// and the outlines of their undashed strokes, made once per approximation
+// scale and shared by every render of the SVG. Scales are rounded up to
+// one of eight steps per octave, so the vertices are at least as fine as
+// asked for. Strokes are outlined before the transform, so outlines hold
+// for any transform of the same scale. Past max_entries or max_vertices
+// new results are handed out without being kept.
+class flattened_paths : util::noncopyable
+{
+public:
+    using vertices_ptr = std::shared_ptr<svg_path_storage const>;
+    static constexpr int steps_per_octave = 8;
+    static constexpr std::size_t max_entries = 256;
+    static constexpr std::size_t max_vertices = 1 << 20;
+
+    flattened_paths()
+        : vertices_(0) {}
+
+    // path path_id of source with conv_curve applied, angle_tolerance
+    // being 0.2 with cusps and 0 otherwise as svg_renderer_agg sets it
+    template <typename VertexSource>
+    vertices_ptr curve(VertexSource & source, unsigned path_id, double scale, bool cusps)
+    {
+        key_type key(path_id, bucket(scale), cusps);
+        if (vertices_ptr found = find(key)) return found;
+        return insert(key, flatten(source, path_id, bucket_scale(key.bucket), cusps));
+    }
+
+    // outline of the curve above stroked with the attributes' width, joins
+    // and caps; dashes are not taken into account
+    template <typename VertexSource>
+    vertices_ptr stroke(VertexSource & source, path_attributes const& attr, double scale, bool cusps)
+    {
+        key_type key(attr.index, bucket(scale), cusps);
+        key.stroke = true;
+        key.width = attr.stroke_width;
+        key.miter_limit = attr.miter_limit;
+        key.line_join = attr.line_join;
+        key.line_cap = attr.line_cap;
+        if (vertices_ptr found = find(key)) return found;
+        vertices_ptr centerline = curve(source, attr.index, scale, cusps);
+        flat_vertex_source flat(*centerline);
+        agg::conv_stroke<flat_vertex_source> stroked(flat);
+        stroked.width(attr.stroke_width);
+        stroked.line_join(attr.line_join);
+        stroked.line_cap(attr.line_cap);
+        stroked.miter_limit(attr.miter_limit);
+        stroked.inner_join(agg::inner_round);
+        stroked.approximation_scale(bucket_scale(key.bucket));
+        return insert(key, collect(stroked, 0));
+    }
+
+    std::size_t size() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        return entries_.size();
+    }
+
+private:
+    struct key_type
+    {
+        key_type(unsigned path_id_, int bucket_, bool cusps_)
+            : path_id(path_id_),
+              bucket(bucket_),
+              cusps(cusps_),
+              stroke(false),
+              width(0.0),
+              miter_limit(0.0),
+              line_join(agg::miter_join),
+              line_cap(agg::butt_cap) {}
+
+        bool operator==(key_type const& other) const
+        {
+            return path_id == other.path_id && bucket == other.bucket &&
+                cusps == other.cusps && stroke == other.stroke &&
+                width == other.width && miter_limit == other.miter_limit &&
+                line_join == other.line_join && line_cap == other.line_cap;
+        }
+
+        unsigned path_id;
+        int bucket;
+        bool cusps;
+        bool stroke;
+        double width;
+        double miter_limit;
+        agg::line_join_e line_join;
+        agg::line_cap_e line_cap;
+    };
+
+    struct key_hash
+    {
+        std::size_t operator()(key_type const& key) const
+        {
+            std::size_t seed = std::hash<unsigned>()(key.path_id);
+            auto combine = [&seed](std::size_t value)
+            {
+                seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            };
+            combine(std::hash<int>()(key.bucket));
+            combine((key.cusps ? 1u : 0u) | (key.stroke ? 2u : 0u) |
+                    (static_cast<unsigned>(key.line_join) << 2) |
+                    (static_cast<unsigned>(key.line_cap) << 5));
+            combine(std::hash<double>()(key.width));
+            combine(std::hash<double>()(key.miter_limit));
+            return seed;
+        }
+    };
+
+    static int bucket(double scale)
+    {
+        if (!(scale > 0.0)) return -64;
+        double steps = std::ceil(std::log2(scale) * steps_per_octave);
+        if (steps < -64.0) return -64;
+        if (steps > 256.0) return 256;
+        return static_cast<int>(steps);
+    }
+
+    static double bucket_scale(int b)
+    {
+        return std::exp2(static_cast<double>(b) / steps_per_octave);
+    }
+
+    template <typename VertexSource>
+    static std::shared_ptr<svg_path_storage> collect(VertexSource & source, unsigned path_id)
+    {
+        auto vertices = std::make_shared<svg_path_storage>();
+        double x = 0;
+        double y = 0;
+        source.rewind(path_id);
+        for (unsigned cmd = source.vertex(&x, &y); !agg::is_stop(cmd); cmd = source.vertex(&x, &y))
+        {
+            vertices->emplace_back(x, y, cmd);
+        }
+        vertices->shrink_to_fit();
+        return vertices;
+    }
+
+    template <typename VertexSource>
+    static std::shared_ptr<svg_path_storage> flatten(VertexSource & source, unsigned path_id,
+                                                     double scale, bool cusps)
+    {
+        agg::conv_curve<VertexSource> curved(source);
+        curved.approximation_scale(scale);
+        curved.angle_tolerance(cusps ? 0.2 : 0.0);
+        return collect(curved, path_id);
+    }
+
+    vertices_ptr find(key_type const& key) const
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        auto itr = entries_.find(key);
+        return itr != entries_.end() ? itr->second : vertices_ptr();
+    }
+
+    vertices_ptr insert(key_type const& key, vertices_ptr vertices)
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        if (entries_.size() >= max_entries || vertices_ + vertices->size() > max_vertices)
+        {
+            return vertices;
+        }
+        auto result = entries_.emplace(key, vertices);
+        if (result.second) vertices_ += vertices->size();
+        return result.first->second;
+    }
+
+#ifdef MAPNIK_THREADSAFE
+    mutable std::mutex mutex_;
+#endif
+    std::unordered_map<key_type, vertices_ptr, key_hash> entries_;
+    std::size_t vertices_;
+};
+
+}}
+
+#endif // MAPNIK_SVG_FLATTENED_PATHS_HPP
@@ -25,6 +25,7 @@
 
 // mapnik
 #include <mapnik/svg/svg_path_attributes.hpp>
+#include <mapnik/svg/svg_flattened_paths.hpp>
 #include <mapnik/gradient.hpp>
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/value/types.hpp>
@@ -128,9 +129,17 @@ public:
           curved_dashed_(curved_),
           curved_stroked_(curved_),
           curved_dashed_stroked_(curved_dashed_),
-          attributes_(attributes) {}
+          attributes_(attributes),
+          flattened_(nullptr) {}
 
-    template <typename Rasterizer, typename Scanline, typename Renderer>
+    // Take the curves and stroke outlines of render() from the shared
+    // flattened paths of the SVG storage holding the source, if any.
+    void set_flattened_paths(flattened_paths * paths)
+    {
+        flattened_ = paths;
+    }
+
+    template <typename Rasterizer, typename Scanline, typename Renderer, typename BoundsSource>
     void render_gradient(Rasterizer& ras,
                          Scanline& sl,
                          Renderer& ren,
@@ -138,7 +147,7 @@ public:
                          agg::trans_affine const& mtx,
                          double opacity,
                          box2d<double> const& symbol_bbox,
-                         curved_trans_type & curved_trans,
+                         BoundsSource & curved_trans,
                          unsigned path_id)
     {
         using gamma_lut_type = agg::gamma_lut<agg::int8u, agg::int8u>;
@@ -275,6 +284,11 @@ public:
             transform = attr.transform;
 
             transform *= mtx;
+            if (flattened_)
+            {
+                render_flattened(ras, sl, ren, attr, transform, opacity, symbol_bbox);
+                continue;
+            }
             double scl = transform.scale();
             //curved_.approximation_method(curve_inc);
             curved_.approximation_scale(scl);
@@ -481,6 +495,110 @@ public:
     inline VertexSource & source() const { return source_;}
     inline AttributeSource const& attributes() const { return attributes_;}
 private:
+    template <typename Rasterizer, typename Scanline, typename Renderer>
+    void render_solid(Rasterizer& ras,
+                      Scanline& sl,
+                      Renderer& ren,
+                      agg::rgba8 const& attr_color,
+                      double opacity,
+                      bool even_odd)
+    {
+        ras.filling_rule(even_odd ? agg::fill_even_odd : agg::fill_non_zero);
+        typename PixelFormat::color_type color = attr_color;
+        color.opacity(color.opacity() * opacity);
+        ScanlineRenderer ren_s(ren);
+        color.premultiply();
+        ren_s.color(color);
+        agg::render_scanlines(ras, sl, ren_s);
+    }
+
+    // render() of one path through flattened_, drawing the same as the
+    // conv_curve pipelines at the flattened_paths scale step
+    template <typename Rasterizer, typename Scanline, typename Renderer>
+    void render_flattened(Rasterizer& ras,
+                          Scanline& sl,
+                          Renderer& ren,
+                          mapnik::svg::path_attributes const& attr,
+                          agg::trans_affine & transform,
+                          double opacity,
+                          box2d<double> const& symbol_bbox)
+    {
+        using flat_trans_type = agg::conv_transform<flat_vertex_source>;
+        double scl = transform.scale();
+        bool fill_gradient = attr.fill_gradient.get_gradient_type() != NO_GRADIENT;
+        bool stroke_gradient = attr.stroke_gradient.get_gradient_type() != NO_GRADIENT;
+        bool stroke = attr.stroke_flag || stroke_gradient;
+        flattened_paths::vertices_ptr curve;
+        if (attr.fill_flag || fill_gradient || stroke_gradient)
+        {
+            curve = flattened_->curve(source_, attr.index, scl, false);
+        }
+        if (attr.fill_flag || fill_gradient)
+        {
+            flat_vertex_source flat(*curve);
+            flat_trans_type flat_trans(flat, transform);
+            ras.reset();
+            ras.add_path(flat_trans);
+            if (fill_gradient)
+            {
+                render_gradient(ras, sl, ren, attr.fill_gradient, transform,
+                                attr.fill_opacity * attr.opacity * opacity, symbol_bbox, flat_trans, 0);
+            }
+            else
+            {
+                render_solid(ras, sl, ren, attr.fill_color,
+                             attr.fill_opacity * attr.opacity * opacity, attr.even_odd_flag);
+            }
+        }
+        if (!stroke)
+        {
+            return;
+        }
+        // If the *visual* line width is considerable we
+        // turn on processing of curve cusps.
+        bool cusps = attr.stroke_width * scl > 1.0;
+        ras.reset();
+        if (attr.dash.size() > 0)
+        {
+            flattened_paths::vertices_ptr centerline = flattened_->curve(source_, attr.index, scl, cusps);
+            flat_vertex_source flat(*centerline);
+            agg::conv_dash<flat_vertex_source> dashed(flat);
+            for (auto d : attr.dash)
+            {
+                dashed.add_dash(std::get<0>(d), std::get<1>(d));
+            }
+            dashed.dash_start(attr.dash_offset);
+            agg::conv_stroke<agg::conv_dash<flat_vertex_source>> stroked(dashed);
+            stroked.width(attr.stroke_width);
+            stroked.line_join(attr.line_join);
+            stroked.line_cap(attr.line_cap);
+            stroked.miter_limit(attr.miter_limit);
+            stroked.inner_join(agg::inner_round);
+            stroked.approximation_scale(scl);
+            agg::conv_transform<agg::conv_stroke<agg::conv_dash<flat_vertex_source>>> stroked_trans(stroked, transform);
+            ras.add_path(stroked_trans);
+        }
+        else
+        {
+            flattened_paths::vertices_ptr outline = flattened_->stroke(source_, attr, scl, cusps);
+            flat_vertex_source flat(*outline);
+            flat_trans_type outline_trans(flat, transform);
+            ras.add_path(outline_trans);
+        }
+        if (stroke_gradient)
+        {
+            flat_vertex_source flat(*curve);
+            flat_trans_type flat_trans(flat, transform);
+            render_gradient(ras, sl, ren, attr.stroke_gradient, transform,
+                            attr.stroke_opacity * attr.opacity * opacity, symbol_bbox, flat_trans, 0);
+        }
+        else
+        {
+            render_solid(ras, sl, ren, attr.stroke_color,
+                         attr.stroke_opacity * attr.opacity * opacity, false);
+        }
+    }
+
 
     VertexSource &         source_;
     curved_type            curved_;
@@ -488,6 +606,7 @@ private:
     curved_stroked_type    curved_stroked_;
     curved_dashed_stroked_type curved_dashed_stroked_;
     AttributeSource const& attributes_;
+    flattened_paths * flattened_;
 };
 
 }}
@@ -26,6 +26,11 @@
 // mapnik
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/util/noncopyable.hpp>
+#include <mapnik/svg/svg_flattened_paths.hpp>
+#include <mapnik/make_unique.hpp>
+
+// stl
+#include <memory>
 
 namespace mapnik {
 namespace svg {
@@ -79,6 +84,19 @@ public:
         svg_height_ = h;
     }
 
+    // Keep the flattened paths of this SVG across renders, for storages
+    // which are shared and no longer modified, like cached markers.
+    void enable_flattened_paths()
+    {
+        flattened_ = std::make_unique<flattened_paths>();
+    }
+
+    // nullptr unless enabled; the cache fills as renders use it
+    flattened_paths * get_flattened_paths() const
+    {
+        return flattened_.get();
+    }
+
 private:
 
     VertexSource source_;
@@ -86,7 +104,7 @@ private:
     box2d<double> bounding_box_;
     double svg_width_;
     double svg_height_;
-
+    std::unique_ptr<flattened_paths> flattened_;
 };
 
 }}
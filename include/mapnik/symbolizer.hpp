@@ -34,6 +34,7 @@
 #include <mapnik/path_expression.hpp>
 #include <mapnik/parse_path.hpp>
 #include <mapnik/color.hpp>
+#include <mapnik/color_factory.hpp>
 #include <mapnik/symbolizer_keys.hpp>
 #include <mapnik/attribute.hpp>
 #include <mapnik/symbolizer_base.hpp>
@@ -294,7 +295,7 @@ struct evaluate_expression_wrapper<mapnik::color>
     {
         mapnik::value_type val = util::apply_visitor(mapnik::evaluate<T2,mapnik::value_type,T3>(feature,vars), expr);
         if (val.is_null()) return mapnik::color(0,0,0,0); // transparent
-        return mapnik::color(val.to_string());
+        return mapnik::parse_color_cached(val.to_string());
     }
 };
 
@@ -490,6 +491,11 @@ boost::optional<T> get_optional(symbolizer_base const& sym, keys key)
     return boost::optional<T>{};
 }
 
+// true if drawing the symbolizer may check or fill the placement
+// detector: labels, and point or markers symbolizers unless both
+// allow-overlap and ignore-placement are set to true
+MAPNIK_DECL bool uses_placement_detector(symbolizer const& sym);
+
 }
 
 #endif // MAPNIK_SYMBOLIZER_HPP
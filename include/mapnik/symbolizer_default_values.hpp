@@ -376,6 +376,13 @@ struct symbolizer_default<value_double, keys::extend>
     static value_double value() { return 0.0; }
 };
 
+// simplify-prefilter
+template <>
+struct symbolizer_default<value_bool, keys::simplify_prefilter>
+{
+    static value_bool value() { return false; }
+};
+
 } // namespace mapnik
 
 #endif // MAPNIK_SYMBOLIZER_DEFAULT_VALUES_HPP
@@ -27,8 +27,12 @@
 #include <mapnik/feature.hpp>
 #include <mapnik/proj_transform.hpp>
 #include <mapnik/feature_style_processor.hpp>
+#include <mapnik/symbolizer_base.hpp>
 #include <mapnik/util/variant.hpp>
 
+// stl
+#include <cstddef>
+
 namespace mapnik
 {
 
@@ -87,6 +91,59 @@ struct symbolizer_dispatch
     proj_transform const& prj_trans_;
 };
 
+namespace detail {
+
+template <typename Processor, typename Variant>
+struct symbolizer_table;
+
+template <typename Processor, typename... Types>
+struct symbolizer_table<Processor, util::variant<Types...>>
+{
+    using function_type = void (*)(Processor &, symbolizer const&,
+                                   mapnik::feature_impl &, proj_transform const&);
+
+    template <typename T>
+    static void call(Processor & output, symbolizer const& sym,
+                     mapnik::feature_impl & f, proj_transform const& prj_trans)
+    {
+        process_impl<has_process<Processor,T>::value>::process(output, sym.template get<T>(), f, prj_trans);
+    }
+
+    // in the order of the variant's types, as which() counts them
+    static constexpr function_type functions[sizeof...(Types)] = { &call<Types>... };
+};
+
+template <typename Processor, typename... Types>
+constexpr typename symbolizer_table<Processor, util::variant<Types...>>::function_type
+symbolizer_table<Processor, util::variant<Types...>>::functions[sizeof...(Types)];
+
+}
+
+/** Processing entry of a symbolizer, resolved once for a processor type
+ * so that drawing a feature calls it directly instead of visiting the
+ * symbolizer variant.
+ */
+template <typename Processor>
+struct symbolizer_entry
+{
+    using function_type = typename detail::symbolizer_table<Processor, symbolizer>::function_type;
+
+    explicit symbolizer_entry(symbolizer const& s, std::size_t pos = 0)
+        : process(detail::symbolizer_table<Processor, symbolizer>::functions[s.which()]),
+          sym(&s),
+          position(pos) {}
+
+    void operator() (Processor & output, mapnik::feature_impl & f, proj_transform const& prj_trans) const
+    {
+        process(output, *sym, f, prj_trans);
+    }
+
+    function_type process;
+    symbolizer const* sym;
+    // index of the symbolizer in its rule
+    std::size_t position;
+};
+
 using no_tag = char (&)[1];
 using yes_tag = char (&)[2];
 
@@ -392,7 +392,16 @@ struct set_symbolizer_property_impl<Symbolizer,transform_type,false>
     static void apply(Symbolizer & sym, keys key, std::string const& name, xml_node const & node)
     {
         boost::optional<std::string> transform = node.get_opt_attr<std::string>(name);
-        if (transform) put(sym, key, mapnik::parse_transform(*transform));
+        if (transform)
+        {
+            auto & cache = node.get_tree().transform_cache_;
+            auto itr = cache.find(*transform);
+            if (itr == cache.end())
+            {
+                itr = cache.emplace(*transform, mapnik::parse_transform(*transform)).first;
+            }
+            put(sym, key, itr->second);
+        }
     }
 };
 
@@ -463,7 +472,7 @@ struct set_symbolizer_property_impl<Symbolizer, T, true>
                         boost::optional<value_type> enum_val2 = detail::enum_traits<value_type>::from_string(std::get<0>(result).to_string());
                         if (enum_val2)
                         {
-                            put(sym, key, *enum_val);
+                            put(sym, key, *enum_val2);
                         }
                         else
                         {
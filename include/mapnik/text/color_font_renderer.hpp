@@ -64,6 +64,14 @@ void composite_color_glyph(T & pixmap,
 
 struct glyph_t;
 
+// Scales and rotates a colour glyph bitmap into an image of its own,
+// offset is set to its top left corner relative to the pen position.
+image_rgba8 render_glyph_image(FT_Bitmap const& bitmap,
+                               agg::trans_affine const& tr,
+                               double angle,
+                               box2d<double> const& bbox,
+                               pixel_position & offset);
+
 image_rgba8 render_glyph_image(glyph_t const& glyph,
                                FT_Bitmap const& bitmap,
                                agg::trans_affine const& tr,
@@ -0,0 +1,56 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_TEXT_DISTANCE_FIELD_HPP
+#define MAPNIK_TEXT_DISTANCE_FIELD_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/text/glyph_cache.hpp>
+
+// stl
+#include <array>
+
+namespace mapnik
+{
+
+// halos wider than this are stroked instead
+static constexpr unsigned max_distance_field_spread = 128;
+
+// Distance field of a glyph coverage bitmap, padded by `spread` pixels on
+// every side. Each byte holds how far the pixel lies outside the glyph
+// edge: 255 on and inside the edge, falling linearly to 0 at `spread`
+// pixels away. A halo of any radius up to `spread` is drawn from it, so
+// one bitmap per glyph and spread serves every halo-radius.
+MAPNIK_DECL glyph_bitmap make_distance_field(glyph_bitmap const& coverage, unsigned spread);
+
+// The spread the distance field for a halo of `radius` pixels is built
+// with: the power of two reaching past the halo's antialiased edge, at
+// least 4. Returns 0 past max_distance_field_spread.
+MAPNIK_DECL unsigned distance_field_spread(double radius);
+
+// Maps distance field bytes to the coverage of a halo of `radius` pixels.
+MAPNIK_DECL std::array<unsigned char, 256> distance_field_halo(unsigned spread, double radius);
+
+}
+
+#endif // MAPNIK_TEXT_DISTANCE_FIELD_HPP
@@ -40,8 +40,11 @@ extern "C"
 #pragma GCC diagnostic pop
 
 //stl
+#include <bitset>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace mapnik
@@ -51,6 +54,8 @@ class MAPNIK_DECL font_face : util::noncopyable
 {
 public:
     font_face(FT_Face face);
+    // keeps the memory backing a face created with FT_New_Memory_Face alive
+    font_face(FT_Face face, std::shared_ptr<void> memory);
 
     std::string family_name() const
     {
@@ -72,6 +77,10 @@ public:
 
     bool glyph_dimensions(glyph_info &glyph) const;
 
+    // Whether the face maps the codepoint to a glyph. Coverage is looked up
+    // a block of 256 codepoints at a time and kept as a bitmap per block.
+    bool has_glyph(std::uint32_t codepoint) const;
+
     inline bool is_color() const { return color_font_;}
 
     ~font_face();
@@ -81,6 +90,8 @@ private:
 
     FT_Face face_;
     const bool color_font_;
+    std::shared_ptr<void> memory_;
+    mutable std::unordered_map<std::uint32_t, std::bitset<256>> coverage_;
 };
 using face_ptr = std::shared_ptr<font_face>;
 
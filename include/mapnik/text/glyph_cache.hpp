@@ -0,0 +1,134 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_GLYPH_CACHE_HPP
+#define MAPNIK_GLYPH_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mapnik
+{
+
+// 8-bit coverage bitmap of a rasterized glyph (or its stroked halo, or
+// its distance field).
+// left/top follow FreeType conventions: offsets in pixels from the
+// integer pen position, top pointing up. Colour glyphs are kept as
+// premultiplied rgba, 4 bytes a pixel, with left/top the offset of the
+// top left corner from the pen position in image coordinates.
+struct glyph_bitmap
+{
+    int left = 0;
+    int top = 0;
+    unsigned width = 0;
+    unsigned rows = 0;
+    std::vector<unsigned char> buffer;
+};
+
+using glyph_bitmap_ptr = std::shared_ptr<glyph_bitmap const>;
+
+struct glyph_cache_key
+{
+    std::string face_name;   // family and style name, faces are per renderer
+    unsigned glyph_index;
+    long size;               // 26.6 pixel size
+    long xx, xy, yx, yy;     // 16.16 combined rotation and transform
+    int offset_x, offset_y;  // quantized 26.6 subpixel offset
+    long halo_radius;        // 26.6 stroke radius, 0 for the plain glyph
+    unsigned distance_spread; // spread of a distance field, 0 for coverage
+
+    bool operator==(glyph_cache_key const& rhs) const
+    {
+        return glyph_index == rhs.glyph_index &&
+            size == rhs.size &&
+            xx == rhs.xx && xy == rhs.xy && yx == rhs.yx && yy == rhs.yy &&
+            offset_x == rhs.offset_x && offset_y == rhs.offset_y &&
+            halo_radius == rhs.halo_radius &&
+            distance_spread == rhs.distance_spread &&
+            face_name == rhs.face_name;
+    }
+};
+
+struct glyph_cache_key_hash
+{
+    std::size_t operator()(glyph_cache_key const& key) const;
+};
+
+// Process wide, bounded LRU cache of rasterized glyphs shared by all
+// text renderers. Disabled (capacity 0) by default since subpixel glyph
+// offsets are quantized to a quarter pixel when it is in use.
+class MAPNIK_DECL glyph_cache :
+        public singleton<glyph_cache, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<glyph_cache>;
+public:
+    // subpixel quantization step in 26.6 units
+    static constexpr int subpixel_step = 16;
+
+    glyph_bitmap_ptr find(glyph_cache_key const& key);
+    void insert(glyph_cache_key const& key, glyph_bitmap_ptr const& bitmap);
+
+    // maximum number of bitmap bytes kept, 0 disables the cache
+    void set_capacity(std::size_t bytes);
+    std::size_t capacity() const { return capacity_; }
+    bool enabled() const { return capacity_ > 0; }
+
+    std::size_t size() const;
+    std::size_t size_bytes() const;
+    std::size_t hits() const { return hits_; }
+    std::size_t misses() const { return misses_; }
+    void clear();
+
+private:
+    glyph_cache();
+    ~glyph_cache();
+    void evict();
+
+    using entry_type = std::pair<glyph_cache_key, glyph_bitmap_ptr>;
+    using list_type = std::list<entry_type>;
+    list_type entries_;
+    std::unordered_map<glyph_cache_key, list_type::iterator, glyph_cache_key_hash> index_;
+    std::atomic<std::size_t> capacity_;
+    std::size_t size_bytes_;
+    std::atomic<std::size_t> hits_;
+    std::atomic<std::size_t> misses_;
+};
+
+extern template class MAPNIK_DECL singleton<glyph_cache, CreateStatic>;
+
+}
+
+#endif // MAPNIK_GLYPH_CACHE_HPP
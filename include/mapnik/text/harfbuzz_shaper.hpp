@@ -33,8 +33,10 @@
 #include <mapnik/font_engine_freetype.hpp>
 
 // stl
+#include <algorithm>
 #include <list>
 #include <type_traits>
+#include <vector>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -42,6 +44,8 @@
 #include <harfbuzz/hb-ft.h>
 #include <unicode/uvernum.h>
 #include <unicode/uscript.h>
+#include <unicode/uchar.h>
+#include <unicode/utf16.h>
 #pragma GCC diagnostic pop
 
 namespace mapnik { namespace detail {
@@ -128,6 +132,76 @@ static hb_language_t script_to_language(hb_script_t script)
     }
 }
 
+// Characters in [start, end) of a text item drawn with one face
+struct face_run
+{
+    face_ptr face;
+    unsigned start;
+    unsigned end;
+};
+
+// Whether a character is drawn with the face of the one before it: marks,
+// joiners and selectors must stay in the cluster they modify.
+static inline bool follows_previous_face(UChar32 c)
+{
+    switch (u_charType(c))
+    {
+    case U_NON_SPACING_MARK:
+    case U_ENCLOSING_MARK:
+    case U_COMBINING_SPACING_MARK:
+    case U_FORMAT_CHAR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Splits [start, end) into runs of characters taken from the first face of
+// the set having glyphs for them, using the coverage bitmaps of the faces.
+// Characters no face covers are drawn with the first one.
+static void split_face_runs(value_unicode_string const& text, unsigned start, unsigned end,
+                            font_face_set & face_set, std::vector<face_run> & runs)
+{
+    if (face_set.size() == 1)
+    {
+        runs.push_back({ *face_set.begin(), start, end });
+        return;
+    }
+    UChar const* buffer = text.getBuffer();
+    int32_t length = static_cast<int32_t>(end);
+    int32_t i = static_cast<int32_t>(start);
+    while (i < length)
+    {
+        unsigned char_start = static_cast<unsigned>(i);
+        UChar32 c;
+        U16_NEXT(buffer, i, length, c);
+        if (!runs.empty() &&
+            (follows_previous_face(c) ||
+             (u_isUWhiteSpace(c) && runs.back().face->has_glyph(c))))
+        {
+            runs.back().end = static_cast<unsigned>(i);
+            continue;
+        }
+        auto face = face_set.begin();
+        for (auto itr = face_set.begin(); itr != face_set.end(); ++itr)
+        {
+            if ((*itr)->has_glyph(c))
+            {
+                face = itr;
+                break;
+            }
+        }
+        if (!runs.empty() && runs.back().face == *face)
+        {
+            runs.back().end = static_cast<unsigned>(i);
+        }
+        else
+        {
+            runs.push_back({ *face, char_start, static_cast<unsigned>(i) });
+        }
+    }
+}
+
 } // ns detail
 
 struct harfbuzz_shaper
@@ -151,41 +225,39 @@ static void shape_text(text_line & line,
     const std::unique_ptr<hb_buffer_t, decltype(hb_buffer_deleter)> buffer(hb_buffer_create(), hb_buffer_deleter);
     hb_buffer_pre_allocate(buffer.get(), safe_cast<int>(length));
     mapnik::value_unicode_string const& text = itemizer.text();
+    std::vector<detail::face_run> runs;
     for (auto const& text_item : list)
     {
         face_set_ptr face_set = font_manager.get_face_set(text_item.format_->face_name, text_item.format_->fontset);
+        if (face_set->size() == 0) continue;
         double size = text_item.format_->text_size * scale_factor;
         face_set->set_unscaled_character_sizes();
-        std::size_t num_faces = face_set->size();
 
         font_feature_settings const& ff_settings = text_item.format_->ff_settings;
         int ff_count = safe_cast<int>(ff_settings.count());
+        auto script = detail::_icu_script_to_script(text_item.script);
+        auto language = detail::script_to_language(script);
 
-        // rendering information for a single glyph
-        struct glyph_face_info
+        // each character is assigned its fallback face up front, so every
+        // run is shaped once with the face that draws it
+        runs.clear();
+        detail::split_face_runs(text, text_item.start, text_item.end, *face_set, runs);
+        if (text_item.dir == UBIDI_RTL)
         {
-            face_ptr face;
-            hb_glyph_info_t glyph;
-            hb_glyph_position_t position;
-        };
-
-        // this table is filled with information for rendering each glyph, so that
-        // several font faces can be used in a single text_item
-        std::size_t pos = 0;
-        std::vector<std::vector<glyph_face_info>> glyphinfos;
+            // harfbuzz returns the glyphs of a right to left run in visual order
+            std::reverse(runs.begin(), runs.end());
+        }
 
-        glyphinfos.resize(text.length());
-        for (auto const& face : *face_set)
+        double max_glyph_height = 0;
+        for (auto const& run : runs)
         {
-            ++pos;
+            face_ptr const& face = run.face;
             hb_buffer_clear_contents(buffer.get());
-            hb_buffer_add_utf16(buffer.get(), detail::uchar_to_utf16(text.getBuffer()), text.length(), text_item.start, static_cast<int>(text_item.end - text_item.start));
+            hb_buffer_add_utf16(buffer.get(), detail::uchar_to_utf16(text.getBuffer()), text.length(), run.start, static_cast<int>(run.end - run.start));
             hb_buffer_set_direction(buffer.get(), (text_item.dir == UBIDI_RTL) ? HB_DIRECTION_RTL : HB_DIRECTION_LTR);
 
             hb_font_t *font(hb_ft_font_create(face->get_face(), nullptr));
-            auto script = detail::_icu_script_to_script(text_item.script);
-            auto language = detail::script_to_language(script);
-            MAPNIK_LOG_DEBUG(harfbuzz_shaper) << "RUN:[" << text_item.start << "," << text_item.end << "]"
+            MAPNIK_LOG_DEBUG(harfbuzz_shaper) << "RUN:[" << run.start << "," << run.end << "]"
                                               << " LANGUAGE:" << hb_language_to_string(language)
                                               << " SCRIPT:" << script << "(" << text_item.script << ") " << uscript_getShortName(text_item.script)
                                               << " FONT:" << face->family_name();
@@ -208,93 +280,31 @@ static void shape_text(text_line & line,
             hb_glyph_info_t *glyphs = hb_buffer_get_glyph_infos(buffer.get(), &num_glyphs);
             hb_glyph_position_t *positions = hb_buffer_get_glyph_positions(buffer.get(), &num_glyphs);
 
-            unsigned cluster = 0;
-            bool in_cluster = false;
-            std::vector<unsigned> clusters;
-
             for (unsigned i = 0; i < num_glyphs; ++i)
             {
-                if (i == 0)
-                {
-                    cluster = glyphs[0].cluster;
-                    clusters.push_back(cluster);
-                }
-                if (cluster != glyphs[i].cluster)
-                {
-                    cluster = glyphs[i].cluster;
-                    clusters.push_back(cluster);
-                    in_cluster = false;
-                }
-                else if (i != 0)
-                {
-                    in_cluster = true;
-                }
-                if (glyphinfos.size() <= cluster)
-                {
-                    glyphinfos.resize(cluster + 1);
-                }
-                auto & c = glyphinfos[cluster];
-                if (c.empty())
-                {
-                    c.push_back({face, glyphs[i], positions[i]});
-                }
-                else if (c.front().glyph.codepoint == 0)
-                {
-                    c.front() = { face, glyphs[i], positions[i] };
-                }
-                else if (in_cluster)
-                {
-                    c.push_back({ face, glyphs[i], positions[i] });
-                }
-            }
-            bool all_set = true;
-            for (auto c_id : clusters)
-            {
-                auto const& c = glyphinfos[c_id];
-                if (c.empty() || c.front().glyph.codepoint == 0)
-                {
-                    all_set = false;
-                    break;
-                }
-            }
-            if (!all_set && (pos < num_faces))
-            {
-                //Try next font in fontset
-                continue;
-            }
-            double max_glyph_height = 0;
-            for (auto const& c_id : clusters)
-            {
-                auto const& c = glyphinfos[c_id];
-                for (auto const& info : c)
+                auto const& gpos = positions[i];
+                unsigned char_index = glyphs[i].cluster;
+                glyph_info g(glyphs[i].codepoint, char_index, text_item.format_);
+                g.face = face;
+                if (g.face->glyph_dimensions(g))
                 {
-                    auto const& gpos = info.position;
-                    auto const& glyph = info.glyph;
-                    unsigned char_index = glyph.cluster;
-                    glyph_info g(glyph.codepoint,char_index,text_item.format_);
-                    if (info.glyph.codepoint != 0) g.face = info.face;
-                    else g.face = face;
-                    if (g.face->glyph_dimensions(g))
+                    g.scale_multiplier = g.face->get_face()->units_per_EM > 0 ?
+                        (size / g.face->get_face()->units_per_EM) : (size / 2048.0) ;
+                    //Overwrite default advance with better value provided by HarfBuzz
+                    g.unscaled_advance = gpos.x_advance;
+                    g.offset.set(gpos.x_offset * g.scale_multiplier, gpos.y_offset * g.scale_multiplier);
+                    double tmp_height = g.height();
+                    if (g.face->is_color())
                     {
-                        g.scale_multiplier = g.face->get_face()->units_per_EM > 0 ?
-                            (size / g.face->get_face()->units_per_EM) : (size / 2048.0) ;
-                        //Overwrite default advance with better value provided by HarfBuzz
-                        g.unscaled_advance = gpos.x_advance;
-                        g.offset.set(gpos.x_offset * g.scale_multiplier, gpos.y_offset * g.scale_multiplier);
-                        double tmp_height = g.height();
-                        if (g.face->is_color())
-                        {
-                            tmp_height = g.ymax();
-                        }
-                        if (tmp_height > max_glyph_height) max_glyph_height = tmp_height;
-                        width_map[char_index] += g.advance();
-                        line.add_glyph(std::move(g), scale_factor);
+                        tmp_height = g.ymax();
                     }
+                    if (tmp_height > max_glyph_height) max_glyph_height = tmp_height;
+                    width_map[char_index] += g.advance();
+                    line.add_glyph(std::move(g), scale_factor);
                 }
             }
-            line.update_max_char_height(max_glyph_height);
-            break; //When we reach this point the current font had all glyphs.
         }
+        line.update_max_char_height(max_glyph_height);
     }
 }
 };
@@ -86,6 +86,12 @@ public:
     // Only forced line breaks with \n characters are handled here.
     std::pair<unsigned, unsigned> line(unsigned i) const;
     unsigned num_lines() const;
+    // Calls func(start, end, format) for each format run, sorted by char index.
+    template <typename Func>
+    void for_each_format_run(Func && func) const
+    {
+        for (auto const& r : format_runs_) func(r.start, r.end, r.data);
+    }
 private:
     template<typename T> struct run : util::noncopyable
     {
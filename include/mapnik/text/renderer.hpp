@@ -30,6 +30,7 @@
 #include <mapnik/util/noncopyable.hpp>
 #include <mapnik/pixel_position.hpp>
 #include <mapnik/text/color_font_renderer.hpp>
+#include <mapnik/text/glyph_cache.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -55,19 +56,26 @@ namespace mapnik
 
 struct glyph_t
 {
+    // nullptr when the glyph is rendered through the glyph_cache
     FT_Glyph image;
+    font_face * face;
+    unsigned glyph_index;
     detail::evaluated_format_properties const& properties;
     pixel_position pos;
     rotation rot;
     double size;
     box2d<double> bbox;
     glyph_t(FT_Glyph image_,
+            font_face * face_,
+            unsigned glyph_index_,
             detail::evaluated_format_properties const& properties_,
             pixel_position const& pos_,
             rotation const& rot_,
             double size_,
             box2d<double> const& bbox_)
         : image(image_),
+          face(face_),
+          glyph_index(glyph_index_),
           properties(properties_),
           pos(pos_),
           rot(rot_),
@@ -115,6 +123,24 @@ public:
 protected:
     using glyph_vector = std::vector<glyph_t>;
     void prepare_glyphs(glyph_positions const& positions);
+    // Rasterizes a glyph prepared for the glyph_cache under the given
+    // transform and start position, stroked when stroke_radius > 0, or
+    // as a distance field reaching distance_spread pixels when that is
+    // set. Bitmap placement is returned in left/top (FreeType coordinates).
+    glyph_bitmap_ptr cached_bitmap(glyph_t const& glyph,
+                                   agg::trans_affine const& tr,
+                                   FT_Vector const& start,
+                                   double stroke_radius,
+                                   int & left,
+                                   int & top,
+                                   unsigned distance_spread = 0) const;
+    // Renders a colour glyph prepared for the glyph_cache from its nearest
+    // strike, scaled and rotated under tr, as premultiplied rgba pixels.
+    // render_pos is moved from the base point to the image's top left
+    // corner, as by render_glyph_image().
+    glyph_bitmap_ptr cached_color_bitmap(glyph_t const& glyph,
+                                         agg::trans_affine const& tr,
+                                         pixel_position & render_pos) const;
     halo_rasterizer_e rasterizer_;
     composite_mode_e comp_op_;
     composite_mode_e halo_comp_op_;
@@ -140,7 +166,7 @@ private:
     pixmap_type & pixmap_;
 
     template <std::size_t PixelWidth>
-    void render_halo(unsigned char *buffer,
+    void render_halo(unsigned char const* buffer,
                      unsigned width,
                      unsigned height,
                      unsigned rgba, int x, int y,
@@ -161,7 +187,7 @@ private:
     pixmap_type & pixmap_;
 
     template <std::size_t PixelWidth>
-    void render_halo_id(unsigned char *buffer,
+    void render_halo_id(unsigned char const* buffer,
                         unsigned width,
                         unsigned height,
                         mapnik::value_integer feature_id,
@@ -0,0 +1,161 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef MAPNIK_SHAPING_CACHE_HPP
+#define MAPNIK_SHAPING_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/pixel_position.hpp>
+#include <mapnik/value/types.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <unicode/unistr.h>
+#pragma GCC diagnostic pop
+
+// stl
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mapnik
+{
+
+// Everything harfbuzz_shaper::shape_text needs to know about a format run.
+struct shaping_format_run
+{
+    unsigned start;
+    unsigned end;
+    std::string face_name;
+    std::vector<std::string> fontset; // face names, empty without a fontset
+    double text_size;
+    std::string features;
+
+    bool operator==(shaping_format_run const& rhs) const
+    {
+        return start == rhs.start && end == rhs.end &&
+            text_size == rhs.text_size &&
+            face_name == rhs.face_name &&
+            fontset == rhs.fontset &&
+            features == rhs.features;
+    }
+};
+
+// The shaped range [first_char, last_char) of a line depends on the
+// whole string, since scripts of neutral characters are resolved
+// from their neighbours.
+struct shaping_cache_key
+{
+    value_unicode_string text;
+    unsigned first_char;
+    unsigned last_char;
+    double scale_factor;
+    std::vector<shaping_format_run> runs;
+
+    bool operator==(shaping_cache_key const& rhs) const
+    {
+        return first_char == rhs.first_char &&
+            last_char == rhs.last_char &&
+            scale_factor == rhs.scale_factor &&
+            text == rhs.text &&
+            runs == rhs.runs;
+    }
+};
+
+struct shaping_cache_key_hash
+{
+    std::size_t operator()(shaping_cache_key const& key) const;
+};
+
+// Font independent copy of a shaped glyph_info. Faces are stored by
+// name and resolved through the face_manager of the current renderer.
+struct shaped_glyph
+{
+    unsigned glyph_index;
+    unsigned char_index;
+    unsigned face;  // index into shaped_line::faces
+    double unscaled_ymin;
+    double unscaled_ymax;
+    double unscaled_advance;
+    double unscaled_line_height;
+    double scale_multiplier;
+    pixel_position offset;
+};
+
+struct shaped_line
+{
+    std::vector<std::string> faces;
+    std::vector<shaped_glyph> glyphs;
+    double max_char_height = 0.0;
+};
+
+using shaped_line_ptr = std::shared_ptr<shaped_line const>;
+
+// Process wide, bounded LRU cache of shaped text lines, so that labels
+// repeated across features and renders are itemized and shaped once.
+// Disabled (capacity 0) by default.
+class MAPNIK_DECL shaping_cache :
+        public singleton<shaping_cache, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<shaping_cache>;
+public:
+    shaped_line_ptr find(shaping_cache_key const& key);
+    void insert(shaping_cache_key const& key, shaped_line_ptr const& line);
+
+    // maximum number of lines kept, 0 disables the cache
+    void set_capacity(std::size_t lines);
+    std::size_t capacity() const { return capacity_; }
+    bool enabled() const { return capacity_ > 0; }
+
+    std::size_t size() const;
+    std::size_t hits() const { return hits_; }
+    std::size_t misses() const { return misses_; }
+    void clear();
+
+private:
+    shaping_cache();
+    ~shaping_cache();
+    void evict();
+
+    using entry_type = std::pair<shaping_cache_key, shaped_line_ptr>;
+    using list_type = std::list<entry_type>;
+    list_type entries_;
+    std::unordered_map<shaping_cache_key, list_type::iterator, shaping_cache_key_hash> index_;
+    std::atomic<std::size_t> capacity_;
+    std::atomic<std::size_t> hits_;
+    std::atomic<std::size_t> misses_;
+};
+
+extern template class MAPNIK_DECL singleton<shaping_cache, CreateStatic>;
+
+}
+
+#endif // MAPNIK_SHAPING_CACHE_HPP
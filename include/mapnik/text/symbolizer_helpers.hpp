@@ -26,10 +26,14 @@
 #include <mapnik/text/placement_finder.hpp>
 #include <mapnik/text/placements/base.hpp>
 #include <mapnik/vertex_converters.hpp>
+#include <mapnik/vertex_cache.hpp>
 #include <mapnik/geometry.hpp>
 #include <mapnik/text/glyph_positions.hpp>
 #include <mapnik/text/text_properties.hpp>
 
+// stl
+#include <map>
+
 namespace mapnik {
 
 class feature_impl;
@@ -159,6 +163,9 @@ protected:
 
     placement_finder_adapter<placement_finder> adapter_;
     mutable vertex_converter_type converter_;
+    // Converted paths of the remaining geometries, built on first use and
+    // reused for every placement alternative.
+    mutable std::map<geometry_cref const*, vertex_cache_ptr> line_paths_;
     //ShieldSymbolizer only
     void init_marker() const;
 };
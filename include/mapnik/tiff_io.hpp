@@ -24,6 +24,7 @@
 #define MAPNIK_TIFF_IO_HPP
 
 #include <mapnik/global.hpp>
+#include <mapnik/executor.hpp>
 #include <mapnik/image_util.hpp>
 #include <mapnik/image_any.hpp>
 #include <mapnik/util/variant.hpp>
@@ -43,6 +44,9 @@ extern "C"
 
 //std
 #include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #define TIFF_WRITE_SCANLINE 0
 #define TIFF_WRITE_STRIPPED 1
@@ -175,7 +179,8 @@ struct tiff_config
         tile_width(0),
         tile_height(0),
         rows_per_strip(0),
-        method(TIFF_WRITE_STRIPPED) {}
+        method(TIFF_WRITE_STRIPPED),
+        threads(1) {}
 
     int compression;
     int zlevel;
@@ -183,6 +188,7 @@ struct tiff_config
     int tile_height; // Tile height of zero means tile the height of the image
     int rows_per_strip;
     int method; // The method to use to write the TIFF.
+    unsigned threads; // Threads compressing strips or tiles.
 
 };
 
@@ -392,6 +398,96 @@ inline void set_tiff_config(TIFF* output, tiff_config const& config)
     }
 }
 
+namespace detail {
+
+struct tiff_guard
+{
+    explicit tiff_guard(TIFF * tif)
+        : tif_(tif) {}
+
+    ~tiff_guard()
+    {
+        if (tif_) RealTIFFClose(tif_);
+    }
+    TIFF * tif_;
+};
+
+// the bytes libtiff wrote for strip or tile index of tif into buffer
+inline std::string encoded_chunk(TIFF * tif, std::ostringstream const& buffer,
+                                 std::size_t index, bool tiled)
+{
+#if defined(TIFFLIB_VERSION) && TIFFLIB_VERSION >= 20111221
+    uint64 * offsets = nullptr;
+    uint64 * byte_counts = nullptr;
+#else
+    uint32 * offsets = nullptr;
+    uint32 * byte_counts = nullptr;
+#endif
+    if (!TIFFGetField(tif, tiled ? TIFFTAG_TILEOFFSETS : TIFFTAG_STRIPOFFSETS, &offsets) ||
+        !TIFFGetField(tif, tiled ? TIFFTAG_TILEBYTECOUNTS : TIFFTAG_STRIPBYTECOUNTS, &byte_counts))
+    {
+        throw image_writer_exception("Could not write TIFF - no encoded data");
+    }
+    return buffer.str().substr(static_cast<std::size_t>(offsets[index]),
+                               static_cast<std::size_t>(byte_counts[index]));
+}
+
+// Compresses the count strips or tiles of output on up to `threads`
+// threads and writes them in order. libtiff encodes each one itself into
+// a scratch TIFF set up like output, the bytes are then copied over raw,
+// so the file is the same as one encoded on a single thread. A few chunks
+// per thread are held at a time.
+template <typename Setup, typename Encode>
+void write_encoded_chunks(TIFF * output, std::size_t count, bool tiled, unsigned threads,
+                          Setup setup, Encode encode)
+{
+    std::size_t const batch = 4 * threads;
+    std::vector<std::string> chunks(std::min(batch, count));
+    for (std::size_t first = 0; first < count; first += batch)
+    {
+        std::size_t size = std::min(batch, count - first);
+        parallel_for(size, threads, [&](std::size_t i)
+        {
+            std::ostringstream buffer;
+            // the procs take a std::ostream
+            std::ostream * stream = &buffer;
+            TIFF * scratch = RealTIFFOpen("mapnik_tiff_scratch",
+                                          "wm",
+                                          (thandle_t)stream,
+                                          tiff_dummy_read_proc,
+                                          tiff_write_proc,
+                                          tiff_seek_proc,
+                                          tiff_close_proc,
+                                          tiff_size_proc,
+                                          tiff_dummy_map_proc,
+                                          tiff_dummy_unmap_proc);
+            if (!scratch)
+            {
+                throw image_writer_exception("Could not write TIFF");
+            }
+            tiff_guard guard(scratch);
+            setup(scratch);
+            if (encode(scratch, first + i) == -1)
+            {
+                throw image_writer_exception("Could not write TIFF - TIFF Tile Write failed");
+            }
+            chunks[i] = encoded_chunk(scratch, buffer, first + i, tiled);
+        });
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            tdata_t data = const_cast<char*>(chunks[i].data());
+            tsize_t length = static_cast<tsize_t>(chunks[i].size());
+            if ((tiled ? TIFFWriteRawTile(output, first + i, data, length)
+                       : TIFFWriteRawStrip(output, first + i, data, length)) == -1)
+            {
+                throw image_writer_exception("Could not write TIFF - TIFF Tile Write failed");
+            }
+        }
+    }
+}
+
+}
+
 template <typename T1, typename T2>
 void save_as_tiff(T1 & file, T2 const& image, tiff_config const& config)
 {
@@ -415,14 +511,20 @@ void save_as_tiff(T1 & file, T2 const& image, tiff_config const& config)
         throw image_writer_exception("Could not write TIFF");
     }
 
-    TIFFSetField(output, TIFFTAG_IMAGEWIDTH, width);
-    TIFFSetField(output, TIFFTAG_IMAGELENGTH, height);
-    TIFFSetField(output, TIFFTAG_IMAGEDEPTH, 1);
-    set_tiff_config(output, config);
+    // Tags of the whole image, also given to the scratch TIFFs strips and
+    // tiles are compressed into on other threads.
+    auto set_image_tags = [&](TIFF * tif)
+    {
+        TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, width);
+        TIFFSetField(tif, TIFFTAG_IMAGELENGTH, height);
+        TIFFSetField(tif, TIFFTAG_IMAGEDEPTH, 1);
+        set_tiff_config(tif, config);
 
-    // Set tags that vary based on the type of data being provided.
-    tag_setter set(output, config);
-    set(image);
+        // Set tags that vary based on the type of data being provided.
+        tag_setter set(tif, config);
+        set(image);
+    };
+    set_image_tags(output);
 
     // Use specific types of writing methods.
     if (TIFF_WRITE_SCANLINE == config.method)
@@ -448,18 +550,42 @@ void save_as_tiff(T1 & file, T2 const& image, tiff_config const& config)
         }
         TIFFSetField(output, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
         std::size_t strip_size = width * rows_per_strip;
-        std::unique_ptr<pixel_type[]> strip_buffer(new pixel_type[strip_size]);
-        for (int y=0; y < height; y+=rows_per_strip)
+        auto write_strip = [&](TIFF * tif, std::size_t strip, pixel_type * strip_buffer)
         {
+            int y = static_cast<int>(strip * rows_per_strip);
             int ty1 = std::min(height, static_cast<int>(y + rows_per_strip)) - y;
             int row = y;
             for (int ty = 0; ty < ty1; ++ty, ++row)
             {
-                std::copy(image.get_row(row), image.get_row(row) + width, strip_buffer.get() + ty * width);
+                std::copy(image.get_row(row), image.get_row(row) + width, strip_buffer + ty * width);
             }
-            if (TIFFWriteEncodedStrip(output, TIFFComputeStrip(output, y, 0), strip_buffer.get(), strip_size * sizeof(pixel_type)) == -1)
+            // the last strip holds the rows left only
+            return TIFFWriteEncodedStrip(tif, TIFFComputeStrip(tif, y, 0), strip_buffer, ty1 * width * sizeof(pixel_type));
+        };
+        std::size_t strips = (height + rows_per_strip - 1) / rows_per_strip;
+        if (config.threads > 1 && strips > 1)
+        {
+            detail::write_encoded_chunks(output, strips, false, config.threads,
+                [&](TIFF * tif)
+                {
+                    set_image_tags(tif);
+                    TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rows_per_strip);
+                },
+                [&](TIFF * tif, std::size_t strip)
+                {
+                    std::unique_ptr<pixel_type[]> strip_buffer(new pixel_type[strip_size]);
+                    return write_strip(tif, strip, strip_buffer.get());
+                });
+        }
+        else
+        {
+            std::unique_ptr<pixel_type[]> strip_buffer(new pixel_type[strip_size]);
+            for (std::size_t strip = 0; strip < strips; ++strip)
             {
-                throw image_writer_exception("Could not write TIFF - TIFF Tile Write failed");
+                if (write_strip(output, strip, strip_buffer.get()) == -1)
+                {
+                    throw image_writer_exception("Could not write TIFF - TIFF Tile Write failed");
+                }
             }
         }
     }
@@ -484,31 +610,53 @@ void save_as_tiff(T1 & file, T2 const& image, tiff_config const& config)
                 tile_width = width + 16 - (width % 16);
             }
         }
-        TIFFSetField(output, TIFFTAG_TILEWIDTH, tile_width);
-        TIFFSetField(output, TIFFTAG_TILELENGTH, tile_height);
-        TIFFSetField(output, TIFFTAG_TILEDEPTH, 1);
+        auto set_tile_tags = [&](TIFF * tif)
+        {
+            TIFFSetField(tif, TIFFTAG_TILEWIDTH, tile_width);
+            TIFFSetField(tif, TIFFTAG_TILELENGTH, tile_height);
+            TIFFSetField(tif, TIFFTAG_TILEDEPTH, 1);
+        };
+        set_tile_tags(output);
         std::size_t tile_size = tile_width * tile_height;
-        std::unique_ptr<pixel_type[]> image_out (new pixel_type[tile_size]);
-        int end_y = (height / tile_height + 1) * tile_height;
-        int end_x = (width / tile_width + 1) * tile_width;
-        end_y = std::min(end_y, height);
-        end_x = std::min(end_x, width);
-
-        for (int y = 0; y < end_y; y += tile_height)
+        int tiles_across = (width + tile_width - 1) / tile_width;
+        int tiles_down = (height + tile_height - 1) / tile_height;
+        // tiles are numbered row by row, the way TIFFComputeTile does
+        auto write_tile = [&](TIFF * tif, std::size_t tile, pixel_type * image_out)
         {
+            int y = static_cast<int>(tile / tiles_across) * tile_height;
+            int x = static_cast<int>(tile % tiles_across) * tile_width;
             int ty1 = std::min(height, y + tile_height) - y;
-
-            for (int x = 0; x < end_x; x += tile_width)
+            // Prefill the entire array with zeros.
+            std::fill(image_out, image_out + tile_size, 0);
+            int tx1 = std::min(width, x + tile_width);
+            int row = y;
+            for (int ty = 0; ty < ty1; ++ty, ++row)
             {
-                // Prefill the entire array with zeros.
-                std::fill(image_out.get(), image_out.get() + tile_size, 0);
-                int tx1 = std::min(width, x + tile_width);
-                int row = y;
-                for (int ty = 0; ty < ty1; ++ty, ++row)
+                std::copy(image.get_row(row, x), image.get_row(row, tx1), image_out + ty * tile_width);
+            }
+            return TIFFWriteEncodedTile(tif, TIFFComputeTile(tif, x, y, 0, 0), image_out, tile_size * sizeof(pixel_type));
+        };
+        std::size_t tiles = static_cast<std::size_t>(tiles_across) * tiles_down;
+        if (config.threads > 1 && tiles > 1)
+        {
+            detail::write_encoded_chunks(output, tiles, true, config.threads,
+                [&](TIFF * tif)
                 {
-                    std::copy(image.get_row(row, x), image.get_row(row, tx1), image_out.get() + ty * tile_width);
-                }
-                if (TIFFWriteEncodedTile(output, TIFFComputeTile(output, x, y, 0, 0), image_out.get(), tile_size * sizeof(pixel_type)) == -1)
+                    set_image_tags(tif);
+                    set_tile_tags(tif);
+                },
+                [&](TIFF * tif, std::size_t tile)
+                {
+                    std::unique_ptr<pixel_type[]> image_out(new pixel_type[tile_size]);
+                    return write_tile(tif, tile, image_out.get());
+                });
+        }
+        else
+        {
+            std::unique_ptr<pixel_type[]> image_out (new pixel_type[tile_size]);
+            for (std::size_t tile = 0; tile < tiles; ++tile)
+            {
+                if (write_tile(output, tile, image_out.get()) == -1)
                 {
                     throw image_writer_exception("Could not write TIFF - TIFF Tile Write failed");
                 }
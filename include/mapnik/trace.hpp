@@ -0,0 +1,110 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_TRACE_HPP
+#define MAPNIK_TRACE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+
+// stl
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+namespace mapnik { namespace trace {
+
+// Timeline of scoped events for debugging slow renders, off by default.
+// Every thread records into its own ring buffer of buffer_size() events,
+// overwriting the oldest, without locking; write_chrome_json() dumps the
+// events of all threads in the Chrome trace event format, which
+// chrome://tracing and Perfetto open. Dump while the traced threads are
+// idle, events recorded meanwhile may come out garbled.
+
+MAPNIK_DECL extern std::atomic<bool> enabled_flag;
+
+inline bool enabled()
+{
+    return enabled_flag.load(std::memory_order_relaxed);
+}
+
+MAPNIK_DECL void set_enabled(bool enabled);
+// applies to the ring buffers of threads recording their first event
+// afterwards, 65536 by default
+MAPNIK_DECL void set_buffer_size(std::size_t events);
+MAPNIK_DECL std::size_t buffer_size();
+MAPNIK_DECL void write_chrome_json(std::ostream & out);
+MAPNIK_DECL void clear();
+
+using clock = std::chrono::steady_clock;
+
+// category and name must be string literals or otherwise outlive the
+// trace, the detail is copied (and truncated)
+MAPNIK_DECL void record(char const* category, char const* name, char const* detail,
+                        std::size_t detail_size, clock::time_point start, clock::time_point end);
+
+// Records an event spanning its lifetime when tracing is enabled at construction.
+class scope
+{
+public:
+    scope(char const* category, char const* name)
+        : category_(category),
+          name_(name),
+          detail_(nullptr),
+          detail_size_(0),
+          active_(enabled())
+    {
+        if (active_) start_ = clock::now();
+    }
+
+    scope(char const* category, char const* name, std::string const& detail)
+        : category_(category),
+          name_(name),
+          detail_(detail.data()),
+          detail_size_(detail.size()),
+          active_(enabled())
+    {
+        if (active_) start_ = clock::now();
+    }
+
+    ~scope()
+    {
+        if (active_) record(category_, name_, detail_, detail_size_, start_, clock::now());
+    }
+
+    scope(scope const&) = delete;
+    scope & operator=(scope const&) = delete;
+private:
+    char const* category_;
+    char const* name_;
+    char const* detail_;
+    std::size_t detail_size_;
+    bool active_;
+    clock::time_point start_;
+};
+
+}}
+
+#endif // MAPNIK_TRACE_HPP
@@ -27,6 +27,7 @@
 #include <mapnik/vertex.hpp>
 #include <mapnik/config.hpp>
 
+#include <cmath>
 #include <cstddef>
 
 namespace mapnik  {
@@ -61,16 +62,25 @@ struct transform_path_adapter
                            proj_transform const& prj_trans)
         : t_(&_t),
           geom_(_geom),
-          prj_trans_(&prj_trans)  {}
+          prj_trans_(&prj_trans),
+          project_(!prj_trans.equal()),
+          inv_cell_(0.0),
+          cell_x_(0.0),
+          cell_y_(0.0) {}
 
     explicit transform_path_adapter(Geometry & _geom)
         : t_(0),
           geom_(_geom),
-          prj_trans_(0)  {}
+          prj_trans_(0),
+          project_(false),
+          inv_cell_(0.0),
+          cell_x_(0.0),
+          cell_y_(0.0) {}
 
     void set_proj_trans(proj_transform const& prj_trans)
     {
         prj_trans_ = &prj_trans;
+        project_ = !prj_trans.equal();
     }
 
     void set_trans(Transform  const& t)
@@ -78,29 +88,32 @@ struct transform_path_adapter
         t_ = &t;
     }
 
+    // Drop the line vertices landing in the same cell of a grid of the
+    // given size, in output units, as the vertex before them, so that
+    // later stages are not fed runs of vertices all within a pixel.
+    // Kept vertices move by less than a cell diagonal. 0 keeps them all.
+    void set_pixel_filter(double cell_size)
+    {
+        inv_cell_ = cell_size > 0.0 ? 1.0 / cell_size : 0.0;
+    }
+
     unsigned vertex(double *x, double *y) const
     {
-        unsigned command;
-        bool ok = false;
-        bool skipped_points = false;
-        while (!ok)
+        unsigned command = transform_vertex(x, y);
+        if (inv_cell_ > 0.0)
         {
-            command = geom_.vertex(x,y);
-            if (command == SEG_END || command == SEG_CLOSE)
+            while (command == SEG_LINETO &&
+                   std::floor(*x * inv_cell_) == cell_x_ &&
+                   std::floor(*y * inv_cell_) == cell_y_)
             {
-                return command;
+                command = transform_vertex(x, y);
             }
-            double z=0;
-            ok = prj_trans_->backward(*x, *y, z);
-            if (!ok) {
-                skipped_points = true;
+            if (command == SEG_MOVETO || command == SEG_LINETO)
+            {
+                cell_x_ = std::floor(*x * inv_cell_);
+                cell_y_ = std::floor(*y * inv_cell_);
             }
         }
-        if (skipped_points && (command == SEG_LINETO))
-        {
-            command = SEG_MOVETO;
-        }
-        t_->forward(x,y);
         return command;
     }
 
@@ -120,9 +133,42 @@ struct transform_path_adapter
     }
 
 private:
+    unsigned transform_vertex(double *x, double *y) const
+    {
+        unsigned command;
+        bool ok = false;
+        bool skipped_points = false;
+        while (!ok)
+        {
+            command = geom_.vertex(x,y);
+            if (command == SEG_END || command == SEG_CLOSE)
+            {
+                return command;
+            }
+            // most layers share the map srs, skip the call per vertex then
+            if (!project_) break;
+            double z=0;
+            ok = prj_trans_->backward(*x, *y, z);
+            if (!ok) {
+                skipped_points = true;
+            }
+        }
+        if (skipped_points && (command == SEG_LINETO))
+        {
+            command = SEG_MOVETO;
+        }
+        t_->forward(x,y);
+        return command;
+    }
+
     Transform const* t_;
     Geometry & geom_;
     proj_transform const* prj_trans_;
+    bool project_;
+    double inv_cell_;
+    // grid cell of the last vertex passed on
+    mutable double cell_x_;
+    mutable double cell_y_;
 };
 
 
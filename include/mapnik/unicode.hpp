@@ -43,14 +43,25 @@ struct UConverter;
 
 namespace mapnik {
 
+// Converts strings from an encoding to value_unicode_string. Short strings
+// (attribute values like "residential", which repeat from feature to
+// feature) are interned in a small per thread table, so repeated values
+// are converted once and then share the converted copy.
 class MAPNIK_DECL transcoder : private util::noncopyable
 {
 public:
+    // longest string, in bytes, looked up in the intern table
+    static constexpr std::int32_t max_interned_length = 64;
+
     explicit transcoder (std::string const& encoding);
     mapnik::value_unicode_string transcode(const char* data, std::int32_t length = -1) const;
     ~transcoder();
 private:
+    mapnik::value_unicode_string convert(const char* data, std::int32_t length) const;
+
     UConverter * conv_;
+    // tells the interned strings of different encodings apart
+    std::size_t encoding_id_;
 };
 
 // convinience method
@@ -28,6 +28,7 @@
 #include <mapnik/value/types.hpp>
 
 // stl
+#include <cstddef>
 #include <iosfwd>
 #include <string>
 
@@ -64,6 +65,16 @@ MAPNIK_DECL bool to_string(std::string & str, unsigned value);
 MAPNIK_DECL bool to_string(std::string & str, bool value);
 MAPNIK_DECL bool to_string(std::string & str, double value);
 
+// The shortest text reading back as value, in fixed notation for
+// 1e-6 <= |value| < 1e21 and with an exponent ("1.5e-7") otherwise, the
+// same in every locale; "nan", "inf" and "-inf" for those. The digits are
+// shortest in all but rare cases, where one more is written.
+constexpr std::size_t max_shortest_chars = 25;
+// writes at most max_shortest_chars characters, returns their count
+MAPNIK_DECL std::size_t to_shortest_chars(char * buffer, double value);
+// appends to str
+MAPNIK_DECL bool to_shortest_string(std::string & str, double value);
+
 }}
 
 #endif // MAPNIK_UTIL_CONVERSIONS_HPP
@@ -0,0 +1,743 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_UTIL_FEATURE_STORE_HPP
+#define MAPNIK_UTIL_FEATURE_STORE_HPP
+
+// mapnik
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/featureset.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/geometry/is_empty.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/value.hpp>
+#include <mapnik/util/file_io.hpp>
+#include <mapnik/util/noncopyable.hpp>
+#include <mapnik/util/packed_spatial_index.hpp>
+#include <mapnik/util/spatial_index.hpp>
+#include <mapnik/util/variant.hpp>
+
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#pragma GCC diagnostic pop
+#include <mapnik/mapped_memory_cache.hpp>
+#endif
+
+// stl
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace mapnik { namespace util {
+
+// Binary feature cache written next to a GeoJSON or TopoJSON source as
+// <file>.features. Features are stored decoded, geometries as packed
+// coordinates and attributes as tagged values, followed by a table of
+// attribute names and a packed R-tree over the records. The file is
+// read in place, so a memory mapping is shared by every process that
+// opens it.
+//
+//   0  char[16] "mapnik-features"
+//  16  uint32   version
+//  20  uint32   num_names
+//  24  uint64   num_features
+//  32  uint64   names_offset
+//  40  uint64   index_offset   (16 byte aligned)
+//  48  uint64   index_size
+//  56  uint64   reserved
+//  64  double   extent minx, miny, maxx, maxy
+//  96  records, each a uint32 size followed by
+//        int64  id, geometry, uint32 num_props,
+//        num_props x (uint32 name, uint8 type, payload)
+//      names, each a uint32 size followed by utf-8 bytes
+//      packed_rtree<index_record> (see packed_spatial_index.hpp)
+//
+// A geometry is a uint8 type (0 empty, 1 point, 2 line_string,
+// 3 polygon, 4 multi_point, 5 multi_line_string, 6 multi_polygon,
+// 7 collection) and its parts; points are two doubles and every
+// sequence is a uint32 count followed by its elements. Parts of multi
+// geometries carry no type, members of collections do. Values are
+// null (0), bool (1, uint8), integer (2, int64), double (3) or string
+// (4, uint32 size and utf-8 bytes). Numbers use the host byte order.
+namespace feature_file {
+
+constexpr char magic[] = "mapnik-features";
+constexpr std::size_t magic_size = 16;
+constexpr std::uint32_t version = 1;
+constexpr std::size_t header_size = 96;
+
+enum geometry_tag : std::uint8_t
+{
+    empty_tag = 0,
+    point_tag,
+    line_string_tag,
+    polygon_tag,
+    multi_point_tag,
+    multi_line_string_tag,
+    multi_polygon_tag,
+    collection_tag
+};
+
+enum value_tag : std::uint8_t
+{
+    null_tag = 0,
+    bool_tag,
+    integer_tag,
+    double_tag,
+    string_tag
+};
+
+struct alignas(16) aligned_block
+{
+    char bytes[16];
+};
+
+inline bool check_header(char const* header)
+{
+    return std::memcmp(header, magic, magic_size) == 0;
+}
+
+struct encoder
+{
+    explicit encoder(std::string & buffer)
+        : buffer_(buffer) {}
+
+    template <typename T>
+    void put(T val)
+    {
+        buffer_.append(reinterpret_cast<char const*>(&val), sizeof(T));
+    }
+
+    void put_count(std::size_t count)
+    {
+        if (count > std::numeric_limits<std::uint32_t>::max())
+        {
+            throw std::runtime_error("feature_store: sequence too long");
+        }
+        put(static_cast<std::uint32_t>(count));
+    }
+
+    void put_string(std::string const& str)
+    {
+        put_count(str.size());
+        buffer_.append(str);
+    }
+
+    void coords(geometry::point<double> const& pt)
+    {
+        put(pt.x);
+        put(pt.y);
+    }
+
+    template <typename Points>
+    void points(Points const& pts)
+    {
+        put_count(pts.size());
+        for (auto const& pt : pts) coords(pt);
+    }
+
+    void rings(geometry::polygon<double> const& poly)
+    {
+        put_count(poly.size());
+        for (auto const& ring : poly) points(ring);
+    }
+
+    void operator() (geometry::geometry_empty const&)
+    {
+        put(empty_tag);
+    }
+
+    void operator() (geometry::point<double> const& pt)
+    {
+        put(point_tag);
+        coords(pt);
+    }
+
+    void operator() (geometry::line_string<double> const& line)
+    {
+        put(line_string_tag);
+        points(line);
+    }
+
+    void operator() (geometry::polygon<double> const& poly)
+    {
+        put(polygon_tag);
+        rings(poly);
+    }
+
+    void operator() (geometry::multi_point<double> const& multi)
+    {
+        put(multi_point_tag);
+        points(multi);
+    }
+
+    void operator() (geometry::multi_line_string<double> const& multi)
+    {
+        put(multi_line_string_tag);
+        put_count(multi.size());
+        for (auto const& line : multi) points(line);
+    }
+
+    void operator() (geometry::multi_polygon<double> const& multi)
+    {
+        put(multi_polygon_tag);
+        put_count(multi.size());
+        for (auto const& poly : multi) rings(poly);
+    }
+
+    void operator() (geometry::geometry_collection<double> const& collection)
+    {
+        put(collection_tag);
+        put_count(collection.size());
+        for (auto const& geom : collection) util::apply_visitor(*this, geom);
+    }
+
+    void operator() (value_null const&)
+    {
+        put(null_tag);
+    }
+
+    void operator() (value_bool val)
+    {
+        put(bool_tag);
+        put(static_cast<std::uint8_t>(val ? 1 : 0));
+    }
+
+    void operator() (value_integer val)
+    {
+        put(integer_tag);
+        put(static_cast<std::int64_t>(val));
+    }
+
+    void operator() (value_double val)
+    {
+        put(double_tag);
+        put(static_cast<double>(val));
+    }
+
+    void operator() (value_unicode_string const& val)
+    {
+        std::string utf8;
+        to_utf8(val, utf8);
+        put(string_tag);
+        put_string(utf8);
+    }
+
+    std::string & buffer_;
+};
+
+// bounds checked reads from a record
+struct decoder
+{
+    decoder(char const* begin, char const* end)
+        : pos_(begin), end_(end) {}
+
+    template <typename T>
+    T get()
+    {
+        require(sizeof(T));
+        T val;
+        std::memcpy(&val, pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return val;
+    }
+
+    std::uint32_t get_count(std::size_t element_size)
+    {
+        std::uint32_t count = get<std::uint32_t>();
+        require(static_cast<std::size_t>(count) * element_size);
+        return count;
+    }
+
+    char const* get_bytes(std::size_t size)
+    {
+        require(size);
+        char const* bytes = pos_;
+        pos_ += size;
+        return bytes;
+    }
+
+    void coords(geometry::point<double> & pt)
+    {
+        pt.x = get<double>();
+        pt.y = get<double>();
+    }
+
+    template <typename Points>
+    void points(Points & pts)
+    {
+        std::uint32_t count = get_count(2 * sizeof(double));
+        pts.resize(count);
+        for (auto & pt : pts) coords(pt);
+    }
+
+    void rings(geometry::polygon<double> & poly)
+    {
+        std::uint32_t count = get_count(sizeof(std::uint32_t));
+        poly.resize(count);
+        for (auto & ring : poly) points(ring);
+    }
+
+    geometry::geometry<double> geom()
+    {
+        switch (get<std::uint8_t>())
+        {
+        case empty_tag:
+            return geometry::geometry_empty();
+        case point_tag:
+        {
+            geometry::point<double> pt;
+            coords(pt);
+            return pt;
+        }
+        case line_string_tag:
+        {
+            geometry::line_string<double> line;
+            points(line);
+            return line;
+        }
+        case polygon_tag:
+        {
+            geometry::polygon<double> poly;
+            rings(poly);
+            return poly;
+        }
+        case multi_point_tag:
+        {
+            geometry::multi_point<double> multi;
+            points(multi);
+            return multi;
+        }
+        case multi_line_string_tag:
+        {
+            geometry::multi_line_string<double> multi;
+            multi.resize(get_count(sizeof(std::uint32_t)));
+            for (auto & line : multi) points(line);
+            return multi;
+        }
+        case multi_polygon_tag:
+        {
+            geometry::multi_polygon<double> multi;
+            multi.resize(get_count(sizeof(std::uint32_t)));
+            for (auto & poly : multi) rings(poly);
+            return multi;
+        }
+        case collection_tag:
+        {
+            geometry::geometry_collection<double> collection;
+            collection.resize(get_count(sizeof(std::uint8_t)));
+            for (auto & g : collection) g = geom();
+            return collection;
+        }
+        }
+        throw std::runtime_error("feature_store: unknown geometry type");
+    }
+
+    value val(transcoder const& tr)
+    {
+        switch (get<std::uint8_t>())
+        {
+        case null_tag:
+            return value_null();
+        case bool_tag:
+            return value_bool(get<std::uint8_t>() != 0);
+        case integer_tag:
+            return value_integer(get<std::int64_t>());
+        case double_tag:
+            return value_double(get<double>());
+        case string_tag:
+        {
+            std::uint32_t size = get_count(1);
+            return tr.transcode(get_bytes(size), static_cast<std::int32_t>(size));
+        }
+        }
+        throw std::runtime_error("feature_store: unknown value type");
+    }
+
+    void require(std::size_t size) const
+    {
+        if (static_cast<std::size_t>(end_ - pos_) < size)
+        {
+            throw std::runtime_error("feature_store: truncated record");
+        }
+    }
+
+    char const* pos_;
+    char const* end_;
+};
+
+template <typename T>
+void store(char * data, std::size_t offset, T val)
+{
+    std::memcpy(data + offset, &val, sizeof(T));
+}
+
+template <typename T>
+T load(char const* data, std::size_t offset)
+{
+    T val;
+    std::memcpy(&val, data + offset, sizeof(T));
+    return val;
+}
+
+} // feature_file
+
+// Appends features to a seekable stream, finish() writes the names,
+// the index and the header.
+class feature_store_writer : util::noncopyable
+{
+public:
+    explicit feature_store_writer(std::ostream & out)
+        : out_(out),
+          offset_(feature_file::header_size),
+          num_features_(0),
+          names_(),
+          name_index_(),
+          tree_(),
+          extent_(),
+          buffer_()
+    {
+        char header[feature_file::header_size] = {};
+        out_.write(header, sizeof(header));
+    }
+
+    void add(feature_impl const& feature)
+    {
+        buffer_.clear();
+        feature_file::encoder enc(buffer_);
+        enc.put(static_cast<std::int64_t>(feature.id()));
+        util::apply_visitor(enc, feature.get_geometry());
+        std::size_t count_pos = buffer_.size();
+        enc.put(std::uint32_t(0));
+        std::uint32_t num_props = 0;
+        for (auto const& kv : feature)
+        {
+            enc.put(name(std::get<0>(kv)));
+            util::apply_visitor(enc, std::get<1>(kv));
+            ++num_props;
+        }
+        std::memcpy(&buffer_[count_pos], &num_props, sizeof(num_props));
+
+        std::uint32_t size = static_cast<std::uint32_t>(buffer_.size());
+        out_.write(reinterpret_cast<char const*>(&size), sizeof(size));
+        out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        std::uint64_t off = offset_ + sizeof(size);
+        offset_ = off + buffer_.size();
+        ++num_features_;
+
+        box2d<double> box = feature.envelope();
+        if (box.valid())
+        {
+            index_record rec = { off, size, packed_index::to_float_box(box) };
+            tree_.insert(rec, box);
+            if (extent_.valid()) extent_.expand_to_include(box);
+            else extent_ = box;
+        }
+    }
+
+    std::uint64_t count() const { return num_features_; }
+    box2d<double> const& extent() const { return extent_; }
+
+    void finish()
+    {
+        std::uint64_t names_offset = offset_;
+        for (auto const& n : names_)
+        {
+            std::uint32_t size = static_cast<std::uint32_t>(n.size());
+            out_.write(reinterpret_cast<char const*>(&size), sizeof(size));
+            out_.write(n.data(), static_cast<std::streamsize>(n.size()));
+            offset_ += sizeof(size) + n.size();
+        }
+        std::uint64_t index_offset = packed_index::align16(offset_);
+        std::string padding(index_offset - offset_, '\0');
+        out_.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+        std::ostringstream index(std::ios::binary);
+        tree_.write(index);
+        std::string const& index_data = index.str();
+        out_.write(index_data.data(), static_cast<std::streamsize>(index_data.size()));
+        offset_ = index_offset + index_data.size();
+
+        char header[feature_file::header_size] = {};
+        std::memcpy(header, feature_file::magic, feature_file::magic_size);
+        feature_file::store(header, 16, feature_file::version);
+        feature_file::store(header, 20, static_cast<std::uint32_t>(names_.size()));
+        feature_file::store(header, 24, num_features_);
+        feature_file::store(header, 32, names_offset);
+        feature_file::store(header, 40, index_offset);
+        feature_file::store(header, 48, static_cast<std::uint64_t>(index_data.size()));
+        feature_file::store(header, 64, extent_.minx());
+        feature_file::store(header, 72, extent_.miny());
+        feature_file::store(header, 80, extent_.maxx());
+        feature_file::store(header, 88, extent_.maxy());
+        out_.seekp(0);
+        out_.write(header, sizeof(header));
+        out_.flush();
+    }
+
+private:
+    std::uint32_t name(std::string const& key)
+    {
+        auto itr = name_index_.find(key);
+        if (itr != name_index_.end()) return itr->second;
+        std::uint32_t index = static_cast<std::uint32_t>(names_.size());
+        names_.push_back(key);
+        name_index_.emplace(key, index);
+        return index;
+    }
+
+    std::ostream & out_;
+    std::uint64_t offset_;
+    std::uint64_t num_features_;
+    std::vector<std::string> names_;
+    std::map<std::string, std::uint32_t> name_index_;
+    packed_rtree<index_record> tree_;
+    box2d<double> extent_;
+    std::string buffer_;
+};
+
+// Read only view of a feature store held in memory, owner keeps the
+// buffer alive and the buffer must be 16 byte aligned.
+class feature_store : util::noncopyable
+{
+public:
+    feature_store(char const* data, std::size_t size, std::shared_ptr<void const> owner = nullptr)
+        : data_(data),
+          size_(size),
+          owner_(std::move(owner)),
+          num_features_(0),
+          names_(),
+          extent_(),
+          index_()
+    {
+        if (size < feature_file::header_size || !feature_file::check_header(data))
+        {
+            throw std::runtime_error("Invalid feature store (regenerate with mapnik-index)");
+        }
+        std::uint32_t file_version = feature_file::load<std::uint32_t>(data, 16);
+        std::uint32_t num_names = feature_file::load<std::uint32_t>(data, 20);
+        num_features_ = feature_file::load<std::uint64_t>(data, 24);
+        std::uint64_t names_offset = feature_file::load<std::uint64_t>(data, 32);
+        std::uint64_t index_offset = feature_file::load<std::uint64_t>(data, 40);
+        std::uint64_t index_size = feature_file::load<std::uint64_t>(data, 48);
+        if (file_version != feature_file::version)
+        {
+            throw std::runtime_error("Unsupported feature store (regenerate with mapnik-index)");
+        }
+        if (names_offset < feature_file::header_size || names_offset > index_offset ||
+            index_offset > size || index_size > size - index_offset || index_offset % 16 != 0)
+        {
+            throw std::runtime_error("Truncated feature store (regenerate with mapnik-index)");
+        }
+        extent_.init(feature_file::load<double>(data, 64), feature_file::load<double>(data, 72),
+                     feature_file::load<double>(data, 80), feature_file::load<double>(data, 88));
+        feature_file::decoder dec(data + names_offset, data + index_offset);
+        names_.reserve(num_names);
+        for (std::uint32_t i = 0; i < num_names; ++i)
+        {
+            std::uint32_t length = dec.get_count(1);
+            names_.emplace_back(dec.get_bytes(length), length);
+        }
+        records_end_ = names_offset;
+        index_ = std::make_unique<packed_rtree_view<index_record>>(data + index_offset, index_size);
+    }
+
+    std::uint64_t count() const { return num_features_; }
+    box2d<double> const& extent() const { return extent_; }
+    std::vector<std::string> const& names() const { return names_; }
+
+    // Records of the features whose boxes intersect box, in file order.
+    template <typename T>
+    void query(box2d<T> const& box, std::vector<index_record> & records) const
+    {
+        index_->query(box, records);
+        std::sort(records.begin(), records.end(),
+                  [](index_record const& lhs, index_record const& rhs) { return lhs.off < rhs.off; });
+    }
+
+    // Records of the first count features, including empty ones.
+    void first(std::size_t count, std::vector<index_record> & records) const
+    {
+        std::uint64_t off = feature_file::header_size;
+        for (std::size_t i = 0; i < count && off + sizeof(std::uint32_t) <= records_end_; ++i)
+        {
+            std::uint32_t size = feature_file::load<std::uint32_t>(data_, off);
+            off += sizeof(size);
+            if (size > records_end_ - off) break;
+            records.push_back({ off, size, box2d<float>() });
+            off += size;
+        }
+    }
+
+    // Fills feature with the record; ctx must hold names() in order.
+    void read(index_record const& rec, feature_impl & feature, transcoder const& tr) const
+    {
+        if (rec.off > records_end_ || rec.size > records_end_ - rec.off)
+        {
+            throw std::runtime_error("feature_store: record out of range");
+        }
+        feature_file::decoder dec(data_ + rec.off, data_ + rec.off + rec.size);
+        feature.set_id(dec.get<std::int64_t>());
+        feature.set_geometry(dec.geom());
+        std::uint32_t num_props = dec.get<std::uint32_t>();
+        for (std::uint32_t i = 0; i < num_props; ++i)
+        {
+            std::uint32_t name = dec.get<std::uint32_t>();
+            if (name >= names_.size())
+            {
+                throw std::runtime_error("feature_store: unknown attribute");
+            }
+            feature.put(names_[name], dec.val(tr));
+        }
+    }
+
+    context_ptr make_context() const
+    {
+        context_ptr ctx = std::make_shared<context_type>();
+        for (auto const& name : names_) ctx->push(name);
+        return ctx;
+    }
+
+private:
+    char const* data_;
+    std::size_t size_;
+    std::shared_ptr<void const> owner_;
+    std::uint64_t num_features_;
+    std::uint64_t records_end_ = 0;
+    std::vector<std::string> names_;
+    box2d<double> extent_;
+    std::unique_ptr<packed_rtree_view<index_record>> index_;
+};
+
+using feature_store_ptr = std::shared_ptr<feature_store const>;
+
+// Maps filename, or reads it when memory mapped files are disabled.
+inline feature_store_ptr open_feature_store(std::string const& filename)
+{
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    boost::optional<mapped_region_ptr> mapped_region = mapped_memory_cache::instance().find(filename, true);
+    if (!mapped_region)
+    {
+        throw std::runtime_error("could not get file mapping for " + filename);
+    }
+    char const* data = static_cast<char const*>((*mapped_region)->get_address());
+    return std::make_shared<feature_store>(data, (*mapped_region)->get_size(), *mapped_region);
+#else
+    file f(filename);
+    if (!f)
+    {
+        throw std::runtime_error("could not open " + filename);
+    }
+    // 16 byte aligned copy
+    auto buffer = std::make_shared<std::vector<feature_file::aligned_block>>((f.size() + 15) / 16);
+    if (f.size() > 0 && std::fread(buffer->data(), f.size(), 1, f.get()) != 1)
+    {
+        throw std::runtime_error("could not read " + filename);
+    }
+    return std::make_shared<feature_store>(reinterpret_cast<char const*>(buffer->data()), f.size(), buffer);
+#endif
+}
+
+// Writes a store to filename through a uniquely named temporary file
+// beside it, so concurrent writers never share one; fill is called
+// with the feature_store_writer.
+template <typename Fill>
+void write_feature_store(std::string const& filename, Fill && fill)
+{
+    std::string tmp = temp_filename(filename);
+    try
+    {
+        std::ofstream out(tmp.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!out)
+        {
+            throw std::runtime_error("could not open " + tmp + " for writing");
+        }
+        out.exceptions(std::ios::failbit | std::ios::badbit);
+        feature_store_writer writer(out);
+        fill(writer);
+        writer.finish();
+    }
+    catch (...)
+    {
+        std::remove(tmp.c_str());
+        throw;
+    }
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+    {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("could not rename " + tmp + " to " + filename);
+    }
+}
+
+class feature_store_featureset : public Featureset
+{
+public:
+    feature_store_featureset(feature_store_ptr const& store, box2d<double> const& box, bool feature_arena = false)
+        : store_(store),
+          ctx_(store->make_context()),
+          tr_("utf8"),
+          arena_(feature_arena ? std::make_shared<mapnik::feature_arena>() : nullptr),
+          records_(),
+          index_(0)
+    {
+        store_->query(box, records_);
+    }
+
+    feature_ptr next()
+    {
+        while (index_ < records_.size())
+        {
+            feature_ptr feature = feature_factory::create(ctx_, 0, arena_);
+            store_->read(records_[index_++], *feature, tr_);
+            // skip empty geometries
+            if (geometry::is_empty(feature->get_geometry())) continue;
+            return feature;
+        }
+        return feature_ptr();
+    }
+
+private:
+    feature_store_ptr store_;
+    context_ptr ctx_;
+    transcoder tr_;
+    feature_arena_ptr arena_;
+    std::vector<index_record> records_;
+    std::size_t index_;
+};
+
+}} // mapnik/util
+
+#endif // MAPNIK_UTIL_FEATURE_STORE_HPP
@@ -25,7 +25,11 @@
 
 // mapnik
 #include <mapnik/featureset.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/geometry/box2d.hpp>
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 
 namespace mapnik {
@@ -50,6 +54,14 @@ public:
         return feature_ptr();
     }
 
+    std::size_t next_batch(feature_batch & batch, std::size_t max_size)
+    {
+        std::size_t count = std::min(max_size, static_cast<std::size_t>(end_ - pos_));
+        batch.insert(batch.end(), pos_, pos_ + count);
+        pos_ += count;
+        return count;
+    }
+
     void push(feature_ptr const& feature)
     {
         features_.push_back(feature);
@@ -66,12 +78,87 @@ public:
         features_.clear();
     }
 
+    std::vector<feature_ptr> const& features() const
+    {
+        return features_;
+    }
+
 private:
     std::vector<feature_ptr> features_;
     std::vector<feature_ptr>::iterator pos_;
     std::vector<feature_ptr>::iterator end_;
 };
 
+// Reads the features of a featureset_buffer with a position of its own,
+// for styles rendered concurrently from the same buffer. The buffer must
+// not be changed meanwhile.
+class featureset_buffer_reader : public Featureset
+{
+public:
+    explicit featureset_buffer_reader(std::shared_ptr<featureset_buffer const> const& buffer)
+      : buffer_(buffer),
+        pos_(buffer->features().begin()),
+        end_(buffer->features().end())
+    {}
+
+    virtual ~featureset_buffer_reader() {}
+
+    feature_ptr next()
+    {
+        if (pos_ != end_)
+        {
+            return *pos_++;
+        }
+        return feature_ptr();
+    }
+
+    std::size_t next_batch(feature_batch & batch, std::size_t max_size)
+    {
+        std::size_t count = std::min(max_size, static_cast<std::size_t>(end_ - pos_));
+        batch.insert(batch.end(), pos_, pos_ + count);
+        pos_ += count;
+        return count;
+    }
+
+private:
+    std::shared_ptr<featureset_buffer const> buffer_;
+    std::vector<feature_ptr>::const_iterator pos_;
+    std::vector<feature_ptr>::const_iterator end_;
+};
+
+// Reads fs once and returns a featureset per box with the features whose
+// envelope intersects it, in the order read. Lets a batch of queries
+// share a single pass over a file.
+inline std::vector<featureset_ptr> split_features(featureset_ptr const& fs,
+                                                  std::vector<box2d<double>> const& boxes)
+{
+    std::vector<std::shared_ptr<featureset_buffer>> buffers;
+    buffers.reserve(boxes.size());
+    for (std::size_t i = 0; i < boxes.size(); ++i)
+    {
+        buffers.push_back(std::make_shared<featureset_buffer>());
+    }
+    if (fs && is_valid(fs))
+    {
+        while (feature_ptr feature = fs->next())
+        {
+            box2d<double> box = feature->envelope();
+            for (std::size_t i = 0; i < boxes.size(); ++i)
+            {
+                if (boxes[i].intersects(box)) buffers[i]->push(feature);
+            }
+        }
+    }
+    std::vector<featureset_ptr> result;
+    result.reserve(buffers.size());
+    for (auto & buffer : buffers)
+    {
+        buffer->prepare();
+        result.push_back(std::move(buffer));
+    }
+    return result;
+}
+
 }
 
 #endif // MAPNIK_FEATURESET_BUFFER_HPP
@@ -30,9 +30,18 @@
 
 // stl
 #include <cstdio>
+#include <iomanip>
 #include <memory>
+#include <random>
+#include <sstream>
 #include <string>
 
+#ifdef _WINDOWS
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace mapnik { namespace util {
 
 class file : public util::noncopyable
@@ -92,6 +101,22 @@ private:
     std::size_t size_;
 };
 
+// A name next to filename that no other process or thread writing the
+// same file will pick, for writing aside and renaming over filename.
+inline std::string temp_filename(std::string const& filename)
+{
+#ifdef _WINDOWS
+    long pid = static_cast<long>(_getpid());
+#else
+    long pid = static_cast<long>(::getpid());
+#endif
+    std::random_device rd;
+    std::ostringstream s;
+    s << filename << '.' << pid << '.' << std::hex << std::setfill('0')
+      << std::setw(8) << rd() << std::setw(8) << rd() << ".tmp";
+    return s.str();
+}
+
 }}
 
 
@@ -27,6 +27,8 @@
 #include <mapnik/config.hpp>
 
 // stl
+#include <cstdint>
+#include <ctime>
 #include <string>
 #include <vector>
 
@@ -42,6 +44,8 @@ MAPNIK_DECL std::string make_absolute(std::string const& filepath, std::string c
 MAPNIK_DECL std::string dirname(std::string const& value);
 MAPNIK_DECL std::string basename(std::string const& value);
 MAPNIK_DECL std::vector<std::string> list_directory(std::string const& value);
+// return false, without throwing, when the file can not be inspected
+MAPNIK_DECL bool file_stat(std::string const& value, std::time_t & mtime, std::uintmax_t & size);
 
 }}
 
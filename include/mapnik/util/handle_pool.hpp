@@ -0,0 +1,119 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_UTIL_HANDLE_POOL_HPP
+#define MAPNIK_UTIL_HANDLE_POOL_HPP
+
+// mapnik
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#ifdef MAPNIK_THREADSAFE
+#include <mutex>
+#endif
+
+namespace mapnik { namespace util {
+
+// Pool of handles that can't be used from two threads at once, such as
+// GDAL datasets. acquire() hands out an idle handle, or opens one, for
+// the sole use of its caller; it goes back to the pool when the last
+// copy of the returned pointer is gone, so the next query reuses it
+// with its caches warm. Up to max_idle handles are kept, the rest are
+// closed. Handed out handles keep the pool alive.
+template <typename T, typename Deleter = std::default_delete<T>>
+class handle_pool : public std::enable_shared_from_this<handle_pool<T, Deleter>>,
+                    private noncopyable
+{
+public:
+    using handle_type = std::unique_ptr<T, Deleter>;
+    using open_type = std::function<handle_type()>;
+
+    handle_pool(open_type open, std::size_t max_idle)
+        : open_(std::move(open)),
+          max_idle_(max_idle),
+          idle_() {}
+
+    // adds an already open handle, e.g. the one a datasource was
+    // introspected with
+    void add(handle_type && handle)
+    {
+        if (handle) release(handle.release());
+    }
+
+    // throws what opening a handle throws, returns null if it fails
+    std::shared_ptr<T> acquire()
+    {
+        handle_type handle;
+        {
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::mutex> lock(mutex_);
+#endif
+            if (!idle_.empty())
+            {
+                handle = std::move(idle_.back());
+                idle_.pop_back();
+            }
+        }
+        if (!handle) handle = open_();
+        if (!handle) return std::shared_ptr<T>();
+        auto self = this->shared_from_this();
+        return std::shared_ptr<T>(handle.release(), [self](T * ptr) { self->release(ptr); });
+    }
+
+    std::size_t idle() const
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        return idle_.size();
+    }
+
+private:
+    void release(T * ptr)
+    {
+        // destroyed after the lock, so surplus handles close unlocked
+        handle_type handle(ptr);
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        if (idle_.size() < max_idle_)
+        {
+            idle_.push_back(std::move(handle));
+        }
+    }
+
+    open_type open_;
+    std::size_t max_idle_;
+    std::vector<handle_type> idle_;
+#ifdef MAPNIK_THREADSAFE
+    mutable std::mutex mutex_;
+#endif
+};
+
+}}
+
+#endif // MAPNIK_UTIL_HANDLE_POOL_HPP
@@ -0,0 +1,637 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_UTIL_PACKED_SPATIAL_INDEX_HPP
+#define MAPNIK_UTIL_PACKED_SPATIAL_INDEX_HPP
+
+// mapnik
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+#ifdef SSE_MATH
+#include <xmmintrin.h>
+#endif
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ios>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace mapnik { namespace util {
+
+// Version 2 of the .index format: a static, packed Hilbert R-tree.
+//
+// Items are sorted along a Hilbert curve through their box centres and
+// grouped bottom-up into nodes of node_size entries, so nearby records
+// end up next to each other both in the tree and in the value array.
+// Node boxes are stored as four contiguous float arrays (all minx, all
+// miny, ...) followed by each internal node's first child and the values,
+// every section 16 byte aligned. The file can be queried in place from a
+// memory mapping.
+//
+//   0  char[12] "mapnik-rtree"   (readers of the quad tree format reject it)
+//  12  uint32   version
+//  16  uint32   node_size, value_size, num_levels, reserved
+//  32  uint64   num_items, num_nodes
+//  48  float    extent minx, miny, maxx, maxy
+//  64  uint64   level_bounds[num_levels]   end of each level, leaves first
+//      float    minx[num_nodes], miny[], maxx[], maxy[]
+//      uint64   first_child[num_nodes - num_items]
+//      Value    values[num_items]
+namespace packed_index {
+
+constexpr char magic[] = "mapnik-rtree";
+constexpr std::size_t magic_size = 12;
+constexpr std::uint32_t version = 1;
+constexpr std::uint32_t default_node_size = 16;
+constexpr std::size_t header_size = 64;
+
+inline bool check_header(char const* header)
+{
+    return std::strncmp(header, magic, magic_size) == 0;
+}
+
+inline std::size_t align16(std::size_t size)
+{
+    return (size + 15) & ~std::size_t(15);
+}
+
+struct layout
+{
+    layout(std::uint32_t num_levels, std::uint64_t num_items, std::uint64_t num_nodes, std::size_t value_size)
+    {
+        std::size_t coords = align16(static_cast<std::size_t>(num_nodes) * sizeof(float));
+        boxes = align16(header_size + num_levels * sizeof(std::uint64_t));
+        children = boxes + 4 * coords;
+        values = align16(children + static_cast<std::size_t>(num_nodes - num_items) * sizeof(std::uint64_t));
+        size = values + static_cast<std::size_t>(num_items) * value_size;
+        stride = coords;
+    }
+    std::size_t boxes;    // offset of the minx array
+    std::size_t stride;   // bytes between the coordinate arrays
+    std::size_t children;
+    std::size_t values;
+    std::size_t size;
+};
+
+// Position of (x, y) in [0, 65535]^2 along a Hilbert curve, see
+// "Fast Hilbert curve generation, sorting, and range queries"
+// (rawrunprotected, public domain).
+inline std::uint32_t hilbert(std::uint32_t x, std::uint32_t y)
+{
+    std::uint32_t a = x ^ y;
+    std::uint32_t b = 0xFFFF ^ a;
+    std::uint32_t c = 0xFFFF ^ (x | y);
+    std::uint32_t d = x & (y ^ 0xFFFF);
+
+    std::uint32_t A = a | (b >> 1);
+    std::uint32_t B = (a >> 1) ^ a;
+    std::uint32_t C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    std::uint32_t D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+    B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+    C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+    D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+    B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+    C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+    D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+    a = A; b = B; c = C; d = D;
+    C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+    D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    std::uint32_t i0 = x ^ y;
+    std::uint32_t i1 = b | (0xFFFF ^ (i0 | a));
+
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+    return (i1 << 1) | i0;
+}
+
+// Position of the centre of box along the hilbert curve over extent
+inline std::uint32_t hilbert_code(box2d<float> const& box, box2d<float> const& extent)
+{
+    double width = extent.width() > 0 ? extent.width() : 1.0;
+    double height = extent.height() > 0 ? extent.height() : 1.0;
+    auto c = box.center();
+    auto x = static_cast<std::uint32_t>(std::max(0.0, 65535.0 * (c.x - extent.minx()) / width));
+    auto y = static_cast<std::uint32_t>(std::max(0.0, 65535.0 * (c.y - extent.miny()) / height));
+    return hilbert(std::min(x, 65535u), std::min(y, 65535u));
+}
+
+// End of each level of a tree over num_items, leaves first
+inline std::vector<std::uint64_t> level_bounds(std::uint64_t num_items, std::uint32_t node_size)
+{
+    std::vector<std::uint64_t> bounds;
+    std::uint64_t n = num_items;
+    std::uint64_t num_nodes = n;
+    bounds.push_back(n);
+    if (n > 0)
+    {
+        do
+        {
+            n = (n + node_size - 1) / node_size;
+            num_nodes += n;
+            bounds.push_back(num_nodes);
+        }
+        while (n != 1);
+    }
+    return bounds;
+}
+
+// Fills the header_size bytes of the header followed by the level bounds
+inline void write_header(char * data, std::uint32_t node_size, std::uint32_t value_size,
+                         std::vector<std::uint64_t> const& bounds, std::uint64_t num_items,
+                         box2d<float> const& extent)
+{
+    std::uint32_t num_levels = static_cast<std::uint32_t>(bounds.size());
+    std::uint64_t num_nodes = bounds.back();
+    std::uint32_t reserved = 0;
+    float ext[4] = { extent.minx(), extent.miny(), extent.maxx(), extent.maxy() };
+    std::memcpy(data, magic, magic_size);
+    std::memcpy(data + 12, &version, 4);
+    std::memcpy(data + 16, &node_size, 4);
+    std::memcpy(data + 20, &value_size, 4);
+    std::memcpy(data + 24, &num_levels, 4);
+    std::memcpy(data + 28, &reserved, 4);
+    std::memcpy(data + 32, &num_items, 8);
+    std::memcpy(data + 40, &num_nodes, 8);
+    std::memcpy(data + 48, ext, sizeof(ext));
+    std::memcpy(data + header_size, bounds.data(), num_levels * sizeof(std::uint64_t));
+}
+
+// float box containing box, rounded outwards
+template <typename T>
+box2d<float> to_float_box(box2d<T> const& box)
+{
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    float minx = static_cast<float>(box.minx());
+    float miny = static_cast<float>(box.miny());
+    float maxx = static_cast<float>(box.maxx());
+    float maxy = static_cast<float>(box.maxy());
+    if (minx > box.minx()) minx = std::nextafter(minx, -inf);
+    if (miny > box.miny()) miny = std::nextafter(miny, -inf);
+    if (maxx < box.maxx()) maxx = std::nextafter(maxx, inf);
+    if (maxy < box.maxy()) maxy = std::nextafter(maxy, inf);
+    return box2d<float>(minx, miny, maxx, maxy);
+}
+
+} // packed_index
+
+// Collects values and boxes, write() sorts and packs them.
+template <typename Value>
+class packed_rtree : util::noncopyable
+{
+public:
+    using value_type = Value;
+    using bbox_type = box2d<float>;
+
+    explicit packed_rtree(std::uint32_t node_size = packed_index::default_node_size)
+        : node_size_(std::max(2u, node_size)),
+          values_(),
+          boxes_(),
+          extent_() {}
+
+    template <typename T>
+    void insert(value_type const& value, box2d<T> const& box)
+    {
+        bbox_type box_f = packed_index::to_float_box(box);
+        values_.push_back(value);
+        boxes_.push_back(box_f);
+        if (extent_.valid()) extent_.expand_to_include(box_f);
+        else extent_ = box_f;
+    }
+
+    std::size_t count_items() const { return values_.size(); }
+    bbox_type const& extent() const { return extent_; }
+
+    template <typename OutputStream>
+    void write(OutputStream & out) const
+    {
+        static_assert(std::is_standard_layout<value_type>::value,
+                      "Values stored in packed spatial index must be standard layout types to allow serialisation");
+        std::uint64_t num_items = values_.size();
+        std::vector<std::uint64_t> level_bounds = packed_index::level_bounds(num_items, node_size_);
+        std::uint64_t num_nodes = level_bounds.back();
+
+        // sort items along the hilbert curve
+        std::vector<std::size_t> order(num_items);
+        std::iota(order.begin(), order.end(), 0);
+        {
+            std::vector<std::uint32_t> codes(num_items);
+            for (std::size_t i = 0; i < num_items; ++i)
+            {
+                codes[i] = packed_index::hilbert_code(boxes_[i], extent_);
+            }
+            std::stable_sort(order.begin(), order.end(),
+                             [&codes](std::size_t lhs, std::size_t rhs) { return codes[lhs] < codes[rhs]; });
+        }
+
+        std::vector<float> minx(num_nodes), miny(num_nodes), maxx(num_nodes), maxy(num_nodes);
+        std::vector<std::uint64_t> first_child(num_nodes - num_items);
+        for (std::size_t i = 0; i < num_items; ++i)
+        {
+            bbox_type const& box = boxes_[order[i]];
+            minx[i] = box.minx(); miny[i] = box.miny();
+            maxx[i] = box.maxx(); maxy[i] = box.maxy();
+        }
+        std::uint64_t pos = num_items;
+        for (std::size_t level = 0; level + 1 < level_bounds.size(); ++level)
+        {
+            std::uint64_t begin = level == 0 ? 0 : level_bounds[level - 1];
+            std::uint64_t end = level_bounds[level];
+            for (std::uint64_t i = begin; i < end; i += node_size_, ++pos)
+            {
+                std::uint64_t last = std::min(i + node_size_, end);
+                float x0 = minx[i], y0 = miny[i], x1 = maxx[i], y1 = maxy[i];
+                for (std::uint64_t j = i + 1; j < last; ++j)
+                {
+                    x0 = std::min(x0, minx[j]); y0 = std::min(y0, miny[j]);
+                    x1 = std::max(x1, maxx[j]); y1 = std::max(y1, maxy[j]);
+                }
+                minx[pos] = x0; miny[pos] = y0; maxx[pos] = x1; maxy[pos] = y1;
+                first_child[pos - num_items] = i;
+            }
+        }
+
+        std::uint32_t num_levels = static_cast<std::uint32_t>(level_bounds.size());
+        packed_index::layout lay(num_levels, num_items, num_nodes, sizeof(value_type));
+        std::vector<char> buffer(lay.size, 0);
+        char * data = buffer.data();
+        packed_index::write_header(data, node_size_, sizeof(value_type), level_bounds, num_items, extent_);
+        std::size_t coords = num_nodes * sizeof(float);
+        std::memcpy(data + lay.boxes, minx.data(), coords);
+        std::memcpy(data + lay.boxes + lay.stride, miny.data(), coords);
+        std::memcpy(data + lay.boxes + 2 * lay.stride, maxx.data(), coords);
+        std::memcpy(data + lay.boxes + 3 * lay.stride, maxy.data(), coords);
+        std::memcpy(data + lay.children, first_child.data(), first_child.size() * sizeof(std::uint64_t));
+        for (std::size_t i = 0; i < num_items; ++i)
+        {
+            std::memcpy(data + lay.values + i * sizeof(value_type), &values_[order[i]], sizeof(value_type));
+        }
+        out.write(data, static_cast<std::streamsize>(buffer.size()));
+    }
+
+private:
+    std::uint32_t node_size_;
+    std::vector<value_type> values_;
+    std::vector<bbox_type> boxes_;
+    bbox_type extent_;
+};
+
+// Writes the same index as packed_rtree::write() from items handed over
+// in hilbert order, keeping only the internal nodes in memory. Items are
+// buffered and written to their sections in place, the header once all
+// num_items were pushed; out must be a seekable file stream.
+template <typename Value, typename OutputStream>
+class packed_rtree_writer : util::noncopyable
+{
+public:
+    using value_type = Value;
+    using bbox_type = box2d<float>;
+
+    packed_rtree_writer(OutputStream & out, std::uint64_t num_items,
+                        std::uint32_t node_size = packed_index::default_node_size,
+                        std::size_t buffer_items = 1 << 16)
+        : out_(out),
+          node_size_(std::max(2u, node_size)),
+          num_items_(num_items),
+          level_bounds_(packed_index::level_bounds(num_items, node_size_)),
+          layout_(static_cast<std::uint32_t>(level_bounds_.size()), num_items,
+                  level_bounds_.back(), sizeof(value_type)),
+          buffer_items_(std::max<std::size_t>(1, buffer_items)),
+          count_(0),
+          flushed_(0),
+          coords_(),
+          values_(),
+          nodes_(),
+          extent_()
+    {
+        static_assert(std::is_standard_layout<value_type>::value,
+                      "Values stored in packed spatial index must be standard layout types to allow serialisation");
+        for (auto & coords : coords_) coords.reserve(std::min<std::uint64_t>(buffer_items_, num_items));
+        values_.reserve(std::min<std::uint64_t>(buffer_items_, num_items) * sizeof(value_type));
+        nodes_.reserve(level_bounds_.back() - num_items);
+    }
+
+    void push(value_type const& value, bbox_type const& box)
+    {
+        if (count_ == num_items_)
+        {
+            throw std::runtime_error("packed_rtree_writer: more items than announced");
+        }
+        coords_[0].push_back(box.minx());
+        coords_[1].push_back(box.miny());
+        coords_[2].push_back(box.maxx());
+        coords_[3].push_back(box.maxy());
+        char const* bytes = reinterpret_cast<char const*>(&value);
+        values_.insert(values_.end(), bytes, bytes + sizeof(value_type));
+        // parents of the leaves fill up as the items come in
+        if (count_ % node_size_ == 0) nodes_.push_back(box);
+        else nodes_.back().expand_to_include(box);
+        if (extent_.valid()) extent_.expand_to_include(box);
+        else extent_ = box;
+        if (++count_ - flushed_ == buffer_items_) flush();
+    }
+
+    std::uint64_t count_items() const { return count_; }
+    bbox_type const& extent() const { return extent_; }
+
+    void finish()
+    {
+        if (count_ != num_items_)
+        {
+            throw std::runtime_error("packed_rtree_writer: fewer items than announced");
+        }
+        flush();
+        std::uint64_t num_nodes = level_bounds_.back();
+        std::vector<std::uint64_t> first_child;
+        first_child.reserve(num_nodes - num_items_);
+        for (std::uint64_t i = 0; i < nodes_.size(); ++i)
+        {
+            first_child.push_back(i * node_size_);
+        }
+        for (std::size_t level = 1; level + 1 < level_bounds_.size(); ++level)
+        {
+            std::uint64_t begin = level_bounds_[level - 1];
+            std::uint64_t end = level_bounds_[level];
+            for (std::uint64_t i = begin; i < end; i += node_size_)
+            {
+                std::uint64_t last = std::min(i + node_size_, end);
+                bbox_type box = nodes_[i - num_items_];
+                for (std::uint64_t j = i + 1; j < last; ++j)
+                {
+                    box.expand_to_include(nodes_[j - num_items_]);
+                }
+                nodes_.push_back(box);
+                first_child.push_back(i);
+            }
+        }
+        std::vector<float> coords(nodes_.size());
+        for (std::size_t k = 0; k < 4; ++k)
+        {
+            for (std::size_t i = 0; i < nodes_.size(); ++i)
+            {
+                bbox_type const& box = nodes_[i];
+                coords[i] = k == 0 ? box.minx() : k == 1 ? box.miny() : k == 2 ? box.maxx() : box.maxy();
+            }
+            write_at(layout_.boxes + k * layout_.stride + num_items_ * sizeof(float),
+                     reinterpret_cast<char const*>(coords.data()), coords.size() * sizeof(float));
+        }
+        write_at(layout_.children, reinterpret_cast<char const*>(first_child.data()),
+                 first_child.size() * sizeof(std::uint64_t));
+        std::vector<char> header(layout_.boxes, 0);
+        packed_index::write_header(header.data(), node_size_, sizeof(value_type), level_bounds_, num_items_, extent_);
+        write_at(0, header.data(), header.size());
+        // pad to the full size, the values section may be empty
+        out_.seekp(0, std::ios::end);
+        std::size_t end = static_cast<std::size_t>(out_.tellp());
+        if (end < layout_.size)
+        {
+            std::vector<char> padding(layout_.size - end, 0);
+            out_.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+        }
+    }
+
+private:
+    void flush()
+    {
+        std::size_t n = static_cast<std::size_t>(count_ - flushed_);
+        if (n == 0) return;
+        for (std::size_t k = 0; k < 4; ++k)
+        {
+            write_at(layout_.boxes + k * layout_.stride + flushed_ * sizeof(float),
+                     reinterpret_cast<char const*>(coords_[k].data()), n * sizeof(float));
+            coords_[k].clear();
+        }
+        write_at(layout_.values + flushed_ * sizeof(value_type), values_.data(), values_.size());
+        values_.clear();
+        flushed_ = count_;
+    }
+
+    void write_at(std::size_t offset, char const* data, std::size_t size)
+    {
+        out_.seekp(static_cast<std::streamoff>(offset), std::ios::beg);
+        out_.write(data, static_cast<std::streamsize>(size));
+    }
+
+    OutputStream & out_;
+    std::uint32_t node_size_;
+    std::uint64_t num_items_;
+    std::vector<std::uint64_t> level_bounds_;
+    packed_index::layout layout_;
+    std::size_t buffer_items_;
+    std::uint64_t count_;
+    std::uint64_t flushed_;
+    std::vector<float> coords_[4];
+    std::vector<char> values_;
+    // internal nodes in file order, the parents of the leaves first
+    std::vector<bbox_type> nodes_;
+    bbox_type extent_;
+};
+
+// Queries a packed index held in memory, typically a mapped file; the
+// buffer must outlive the view and be 16 byte aligned.
+template <typename Value>
+class packed_rtree_view
+{
+public:
+    using value_type = Value;
+    using bbox_type = box2d<float>;
+
+    packed_rtree_view(char const* data, std::size_t size)
+        : data_(data),
+          node_size_(0),
+          num_levels_(0),
+          num_items_(0),
+          num_nodes_(0),
+          level_bounds_(),
+          minx_(nullptr), miny_(nullptr), maxx_(nullptr), maxy_(nullptr),
+          first_child_(nullptr),
+          values_(nullptr),
+          extent_()
+    {
+        if (size < packed_index::header_size || !packed_index::check_header(data))
+        {
+            throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+        }
+        std::uint32_t file_version, value_size;
+        std::memcpy(&file_version, data + 12, 4);
+        std::memcpy(&node_size_, data + 16, 4);
+        std::memcpy(&value_size, data + 20, 4);
+        std::memcpy(&num_levels_, data + 24, 4);
+        std::memcpy(&num_items_, data + 32, 8);
+        std::memcpy(&num_nodes_, data + 40, 8);
+        if (file_version != packed_index::version || value_size != sizeof(value_type) ||
+            node_size_ < 2 || num_levels_ == 0 || num_nodes_ < num_items_ ||
+            size < packed_index::header_size + num_levels_ * sizeof(std::uint64_t))
+        {
+            throw std::runtime_error("Unsupported index file (regenerate with shapeindex)");
+        }
+        float ext[4];
+        std::memcpy(ext, data + 48, sizeof(ext));
+        extent_.init(ext[0], ext[1], ext[2], ext[3]);
+        level_bounds_.resize(num_levels_);
+        std::memcpy(level_bounds_.data(), data + packed_index::header_size, num_levels_ * sizeof(std::uint64_t));
+        packed_index::layout lay(num_levels_, num_items_, num_nodes_, sizeof(value_type));
+        if (size < lay.size || level_bounds_.back() != num_nodes_)
+        {
+            throw std::runtime_error("Truncated index file (regenerate with shapeindex)");
+        }
+        minx_ = reinterpret_cast<float const*>(data + lay.boxes);
+        miny_ = reinterpret_cast<float const*>(data + lay.boxes + lay.stride);
+        maxx_ = reinterpret_cast<float const*>(data + lay.boxes + 2 * lay.stride);
+        maxy_ = reinterpret_cast<float const*>(data + lay.boxes + 3 * lay.stride);
+        first_child_ = reinterpret_cast<std::uint64_t const*>(data + lay.children);
+        values_ = data + lay.values;
+    }
+
+    bbox_type const& extent() const { return extent_; }
+    std::uint64_t count_items() const { return num_items_; }
+
+    // Appends the values of all items whose box intersects box, in index
+    // (hilbert) order, stopping once results holds max_count values.
+    template <typename T>
+    void query(box2d<T> const& box, std::vector<value_type> & results,
+               std::size_t max_count = std::numeric_limits<std::size_t>::max()) const
+    {
+        if (num_items_ == 0 || results.size() >= max_count) return;
+        float qx0 = static_cast<float>(box.minx());
+        float qy0 = static_cast<float>(box.miny());
+        float qx1 = static_cast<float>(box.maxx());
+        float qy1 = static_cast<float>(box.maxy());
+        // stack of (node, level), children are on level - 1
+        std::vector<std::pair<std::uint64_t, std::uint32_t>> stack;
+        std::vector<std::uint64_t> hits;
+        hits.reserve(node_size_);
+        std::uint64_t root = num_nodes_ - 1;
+        if (!intersects(root, qx0, qy0, qx1, qy1)) return;
+        stack.emplace_back(root, num_levels_ - 1);
+        while (!stack.empty())
+        {
+            std::uint64_t node = stack.back().first;
+            std::uint32_t level = stack.back().second;
+            stack.pop_back();
+            std::uint64_t first = first_child_[node - num_items_];
+            std::uint64_t last = std::min(first + node_size_, level_bounds_[level - 1]);
+            hits.clear();
+            scan(first, last, qx0, qy0, qx1, qy1, hits);
+            if (level == 1)
+            {
+                for (std::uint64_t item : hits)
+                {
+                    value_type value;
+                    std::memcpy(&value, values_ + item * sizeof(value_type), sizeof(value_type));
+                    results.push_back(std::move(value));
+                    if (results.size() >= max_count) return;
+                }
+            }
+            else
+            {
+                // visit children in order
+                for (auto itr = hits.rbegin(); itr != hits.rend(); ++itr)
+                {
+                    stack.emplace_back(*itr, level - 1);
+                }
+            }
+        }
+    }
+
+private:
+    bool intersects(std::uint64_t i, float qx0, float qy0, float qx1, float qy1) const
+    {
+        return minx_[i] <= qx1 && maxx_[i] >= qx0 && miny_[i] <= qy1 && maxy_[i] >= qy0;
+    }
+
+    // Tests the boxes of entries [first, last) against the query box,
+    // four boxes per step with SSE.
+    void scan(std::uint64_t first, std::uint64_t last,
+              float qx0, float qy0, float qx1, float qy1,
+              std::vector<std::uint64_t> & hits) const
+    {
+        std::uint64_t i = first;
+#ifdef SSE_MATH
+        __m128 const x0 = _mm_set1_ps(qx0);
+        __m128 const y0 = _mm_set1_ps(qy0);
+        __m128 const x1 = _mm_set1_ps(qx1);
+        __m128 const y1 = _mm_set1_ps(qy1);
+        for (; i + 4 <= last; i += 4)
+        {
+            __m128 m = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minx_ + i), x1),
+                                  _mm_cmpge_ps(_mm_loadu_ps(maxx_ + i), x0));
+            m = _mm_and_ps(m, _mm_cmple_ps(_mm_loadu_ps(miny_ + i), y1));
+            m = _mm_and_ps(m, _mm_cmpge_ps(_mm_loadu_ps(maxy_ + i), y0));
+            int mask = _mm_movemask_ps(m);
+            for (int k = 0; mask != 0; ++k, mask >>= 1)
+            {
+                if (mask & 1) hits.push_back(i + k);
+            }
+        }
+#endif
+        for (; i < last; ++i)
+        {
+            if (intersects(i, qx0, qy0, qx1, qy1)) hits.push_back(i);
+        }
+    }
+
+    char const* data_;
+    std::uint32_t node_size_;
+    std::uint32_t num_levels_;
+    std::uint64_t num_items_;
+    std::uint64_t num_nodes_;
+    std::vector<std::uint64_t> level_bounds_;
+    float const* minx_;
+    float const* miny_;
+    float const* maxx_;
+    float const* maxy_;
+    std::uint64_t const* first_child_;
+    char const* values_;
+    bbox_type extent_;
+};
+
+}} // mapnik/util
+
+#endif // MAPNIK_UTIL_PACKED_SPATIAL_INDEX_HPP
@@ -28,9 +28,15 @@
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/query.hpp>
 #include <mapnik/geom_util.hpp>
+#include <mapnik/util/packed_spatial_index.hpp>
 // stl
+#include <algorithm>
+#include <cstdio>
 #include <type_traits>
 #include <cstring>
+#include <ios>
+#include <iterator>
+#include <vector>
 
 using mapnik::box2d;
 using mapnik::query;
@@ -44,13 +50,126 @@ struct index_record
     box2d<float> box;
 };
 
+// Reads the records located through an index, in offset order, from a
+// file. Records lying close together are fetched in a single read, so the
+// features of spatially sorted files (mapnik-index --sort) come in a few
+// large sequential reads instead of one seek per feature.
+class index_record_reader
+{
+public:
+    // bytes read in vain between two records of one read, and the most
+    // bytes read at once unless a single record is larger
+    static constexpr std::uint64_t max_gap = 16384;
+    static constexpr std::uint64_t max_block = 1 << 20;
+
+    index_record_reader()
+        : block_(),
+          block_off_(0) {}
+
+    // The record at itr, following ones in [itr, end) may be read along;
+    // nullptr when the file could not be read.
+    template <typename Iterator>
+    char const* read(std::FILE * file, Iterator itr, Iterator end)
+    {
+        std::uint64_t off = itr->off;
+        std::uint64_t last = off + itr->size;
+        if (off >= block_off_ && last <= block_off_ + block_.size())
+        {
+            return block_.data() + (off - block_off_);
+        }
+        last = block_end(itr, end);
+        block_off_ = off;
+        block_.resize(static_cast<std::size_t>(last - off));
+        if (std::fseek(file, static_cast<long>(off), SEEK_SET) != 0 ||
+            std::fread(block_.data(), block_.size(), 1, file) != 1)
+        {
+            block_.clear();
+            return nullptr;
+        }
+        return block_.data();
+    }
+
+    // end offset of the block read for the record at itr
+    template <typename Iterator>
+    static std::uint64_t block_end(Iterator itr, Iterator end)
+    {
+        std::uint64_t off = itr->off;
+        std::uint64_t last = off + itr->size;
+        for (auto next = std::next(itr); next != end; ++next)
+        {
+            if (next->off > last + max_gap) break;
+            std::uint64_t next_last = std::max(last, next->off + next->size);
+            if (next_last - off > max_block) break;
+            last = next_last;
+        }
+        return last;
+    }
+
+private:
+    std::vector<char> block_;
+    std::uint64_t block_off_;
+};
+
+enum class spatial_index_format
+{
+    invalid,
+    quad_tree,   // "mapnik-index", nodes read one at a time
+    packed       // "mapnik-rtree", see packed_spatial_index.hpp
+};
+
 template <typename InputStream>
-bool check_spatial_index(InputStream& in)
+spatial_index_format read_spatial_index_format(InputStream& in)
 {
-    char header[17]; // mapnik-index
+    char header[17];
     std::memset(header, 0, 17);
     in.read(header,16);
-    return (std::strncmp(header, "mapnik-index",12) == 0);
+    if (std::strncmp(header, "mapnik-index",12) == 0) return spatial_index_format::quad_tree;
+    if (packed_index::check_header(header)) return spatial_index_format::packed;
+    return spatial_index_format::invalid;
+}
+
+template <typename InputStream>
+bool check_spatial_index(InputStream& in)
+{
+    return read_spatial_index_format(in) != spatial_index_format::invalid;
+}
+
+namespace detail {
+
+// whole index in memory: memory mapped streams expose their buffer,
+// other streams are read into storage
+template <typename InputStream>
+auto index_buffer(InputStream& in, std::vector<char> &, std::size_t & size, int)
+    -> decltype(in.buffer().first, static_cast<char const*>(nullptr))
+{
+    size = in.buffer().second;
+    return in.buffer().first;
+}
+
+template <typename InputStream>
+char const* index_buffer(InputStream& in, std::vector<char> & storage, std::size_t & size, long)
+{
+    in.clear();
+    in.seekg(0, std::ios::end);
+    size = static_cast<std::size_t>(in.tellg());
+    in.seekg(0, std::ios::beg);
+    storage.resize(size);
+    in.read(storage.data(), static_cast<std::streamsize>(size));
+    return storage.data();
+}
+
+template <typename Value, typename InputStream, typename Func>
+void with_packed_index(InputStream& in, Func && func)
+{
+    std::vector<char> storage;
+    std::size_t size = 0;
+    char const* data = index_buffer(in, storage, size, 0);
+    packed_rtree_view<Value> view(data, size);
+    func(view);
+    in.clear();
+    in.seekg(0, std::ios::beg);
+}
+
 }
 
 template <typename Value, typename Filter, typename InputStream, typename BBox = box2d<double> >
@@ -76,7 +195,18 @@ template <typename Value, typename Filter, typename InputStream, typename BBox>
 BBox spatial_index<Value, Filter, InputStream, BBox>::bounding_box(InputStream& in)
 {
     static_assert(std::is_standard_layout<Value>::value, "Values stored in quad-tree must be standard layout type");
-    if (!check_spatial_index(in)) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    spatial_index_format format = read_spatial_index_format(in);
+    if (format == spatial_index_format::invalid) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    if (format == spatial_index_format::packed)
+    {
+        BBox box;
+        detail::with_packed_index<Value>(in, [&box](packed_rtree_view<Value> const& view)
+        {
+            auto const& ext = view.extent();
+            box.init(ext.minx(), ext.miny(), ext.maxx(), ext.maxy());
+        });
+        return box;
+    }
     in.seekg(16 + 4, std::ios::beg);
     typename spatial_index<Value, Filter, InputStream, BBox>::bbox_type box;
     read_envelope(in, box);
@@ -88,7 +218,17 @@ template <typename Value, typename Filter, typename InputStream, typename BBox>
 void spatial_index<Value, Filter, InputStream, BBox>::query(Filter const& filter, InputStream& in, std::vector<Value>& results)
 {
     static_assert(std::is_standard_layout<Value>::value, "Values stored in quad-tree must be standard layout type");
-    if (!check_spatial_index(in)) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    spatial_index_format format = read_spatial_index_format(in);
+    if (format == spatial_index_format::invalid) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    if (format == spatial_index_format::packed)
+    {
+        // whole node boxes are tested against the filter box at once
+        detail::with_packed_index<Value>(in, [&](packed_rtree_view<Value> const& view)
+        {
+            view.query(filter.box_, results);
+        });
+        return;
+    }
     in.seekg(16, std::ios::beg);
     query_node(filter, in, results);
 }
@@ -124,7 +264,16 @@ template <typename Value, typename Filter, typename InputStream, typename BBox>
 void spatial_index<Value, Filter, InputStream, BBox>::query_first_n(Filter const& filter, InputStream& in, std::vector<Value>& results, std::size_t count)
 {
     static_assert(std::is_standard_layout<Value>::value, "Values stored in quad-tree must be standard layout type");
-    if (!check_spatial_index(in)) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    spatial_index_format format = read_spatial_index_format(in);
+    if (format == spatial_index_format::invalid) throw std::runtime_error("Invalid index file (regenerate with shapeindex)");
+    if (format == spatial_index_format::packed)
+    {
+        detail::with_packed_index<Value>(in, [&](packed_rtree_view<Value> const& view)
+        {
+            view.query(filter.box_, results, count);
+        });
+        return;
+    }
     in.seekg(16, std::ios::beg);
     query_first_n_impl(filter, in, results, count);
 }
@@ -0,0 +1,94 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_UTIL_TEXT_SINK_HPP
+#define MAPNIK_UTIL_TEXT_SINK_HPP
+
+// mapnik
+#include <mapnik/util/conversions.hpp>
+// stl
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace mapnik { namespace util {
+
+// Character outputs for the text writers: appending to a string or
+// writing to a stream, the number formatting done on the stack.
+
+struct string_sink
+{
+    explicit string_sink(std::string & str)
+        : str_(str) {}
+
+    void put(char c) { str_.push_back(c); }
+    void write(char const* s, std::size_t size) { str_.append(s, size); }
+    template <std::size_t N>
+    void literal(char const (&s)[N]) { str_.append(s, N - 1); }
+private:
+    std::string & str_;
+};
+
+struct stream_sink
+{
+    explicit stream_sink(std::ostream & out)
+        : out_(out) {}
+
+    void put(char c) { out_.put(c); }
+    void write(char const* s, std::size_t size) { out_.write(s, static_cast<std::streamsize>(size)); }
+    template <std::size_t N>
+    void literal(char const (&s)[N]) { out_.write(s, N - 1); }
+private:
+    std::ostream & out_;
+};
+
+// shortest round trip text of value
+template <typename Sink>
+inline void write_number(Sink & sink, double value)
+{
+    char buffer[max_shortest_chars];
+    sink.write(buffer, to_shortest_chars(buffer, value));
+}
+
+template <typename Sink>
+inline void write_number(Sink & sink, std::int64_t value)
+{
+    char buffer[20];
+    char * end = buffer + sizeof(buffer);
+    char * start = end;
+    std::uint64_t magnitude = static_cast<std::uint64_t>(value);
+    if (value < 0) magnitude = 0 - magnitude;
+    do
+    {
+        *--start = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    }
+    while (magnitude != 0);
+    if (value < 0) sink.put('-');
+    sink.write(start, static_cast<std::size_t>(end - start));
+}
+
+}}
+
+#endif // MAPNIK_UTIL_TEXT_SINK_HPP
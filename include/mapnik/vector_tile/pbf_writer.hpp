@@ -0,0 +1,136 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_VECTOR_TILE_PBF_WRITER_HPP
+#define MAPNIK_VECTOR_TILE_PBF_WRITER_HPP
+
+// stl
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace mapnik { namespace vector_tile {
+
+// Minimal protocol buffers encoder, appending the fields of one message
+// to a string; nested messages are encoded on their own and added whole.
+class pbf_writer
+{
+public:
+    enum wire_type : std::uint32_t
+    {
+        varint = 0,
+        fixed64 = 1,
+        length_delimited = 2,
+        fixed32 = 5
+    };
+
+    explicit pbf_writer(std::string & data)
+        : data_(data) {}
+
+    static std::uint32_t zigzag(std::int32_t n)
+    {
+        return (static_cast<std::uint32_t>(n) << 1) ^ static_cast<std::uint32_t>(n >> 31);
+    }
+
+    static std::uint64_t zigzag(std::int64_t n)
+    {
+        return (static_cast<std::uint64_t>(n) << 1) ^ static_cast<std::uint64_t>(n >> 63);
+    }
+
+    void add_varint(std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            data_ += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        data_ += static_cast<char>(value);
+    }
+
+    void add_tag(std::uint32_t field, wire_type type)
+    {
+        add_varint((static_cast<std::uint64_t>(field) << 3) | type);
+    }
+
+    void add_uint(std::uint32_t field, std::uint64_t value)
+    {
+        add_tag(field, varint);
+        add_varint(value);
+    }
+
+    void add_int(std::uint32_t field, std::int64_t value)
+    {
+        add_tag(field, varint);
+        add_varint(static_cast<std::uint64_t>(value));
+    }
+
+    void add_sint(std::uint32_t field, std::int64_t value)
+    {
+        add_tag(field, varint);
+        add_varint(zigzag(value));
+    }
+
+    void add_bool(std::uint32_t field, bool value)
+    {
+        add_tag(field, varint);
+        data_ += static_cast<char>(value ? 1 : 0);
+    }
+
+    void add_double(std::uint32_t field, double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        add_tag(field, fixed64);
+        for (int i = 0; i < 8; ++i)
+        {
+            data_ += static_cast<char>((bits >> (8 * i)) & 0xff);
+        }
+    }
+
+    // strings, bytes and encoded messages
+    void add_bytes(std::uint32_t field, std::string const& bytes)
+    {
+        add_tag(field, length_delimited);
+        add_varint(bytes.size());
+        data_ += bytes;
+    }
+
+    void add_packed_uint(std::uint32_t field, std::vector<std::uint32_t> const& values)
+    {
+        std::string packed;
+        pbf_writer writer(packed);
+        for (auto value : values)
+        {
+            writer.add_varint(value);
+        }
+        add_bytes(field, packed);
+    }
+
+private:
+    std::string & data_;
+};
+
+}}
+
+#endif // MAPNIK_VECTOR_TILE_PBF_WRITER_HPP
@@ -0,0 +1,182 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_VECTOR_TILE_RENDERER_HPP
+#define MAPNIK_VECTOR_TILE_RENDERER_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/feature_style_processor.hpp>
+#include <mapnik/util/noncopyable.hpp>
+#include <mapnik/rule.hpp>              // for rule, symbolizers
+#include <mapnik/geometry/box2d.hpp>     // for box2d
+#include <mapnik/request.hpp>
+#include <mapnik/renderer_common.hpp>
+
+// stl
+#include <memory>
+#include <string>
+#include <vector>
+
+// fwd declarations to speed up compile
+namespace mapnik {
+  class Map;
+  class feature_impl;
+  class feature_type_style;
+  class layer;
+  class proj_transform;
+}
+
+namespace mapnik
+{
+
+/*!
+ * \brief renders a map into a Mapbox vector tile (MVT version 2)
+ *
+ * Each layer drawing features becomes a tile layer of the same name. The
+ * features matched by a rule are written once per layer (features sharing
+ * an id but not their geometry are all written), with the attributes
+ * their query returned, which hold the fields the styles use.
+ * Geometries go through the clipping, transform and simplification
+ * converters of the raster renderers. Then they are quantized to a grid
+ * of extent units across the map's width and height. The buffer_size of
+ * the map keeps the features around the tile.
+ * The encoded tile is appended to the output string by apply().
+ */
+class MAPNIK_DECL vector_tile_renderer : public feature_style_processor<vector_tile_renderer>,
+                                         private util::noncopyable
+{
+public:
+    using processor_impl_type = vector_tile_renderer;
+    vector_tile_renderer(Map const& m, std::string & output, unsigned extent = 4096, double scale_factor = 1.0);
+    vector_tile_renderer(Map const& m, request const& req, attributes const& vars, std::string & output,
+                         unsigned extent = 4096, double scale_factor = 1.0);
+    ~vector_tile_renderer();
+
+    void start_map_processing(Map const& /*map*/) {}
+    void end_map_processing(Map const& /*map*/) {}
+    void start_layer_processing(layer const& lay, box2d<double> const& query_extent);
+    void end_layer_processing(layer const& lay);
+    void start_style_processing(feature_type_style const& /*st*/) {}
+    void end_style_processing(feature_type_style const& /*st*/) {}
+
+    /*!
+     * @brief Overloads writing the feature of each kind of symbolizer.
+     */
+    void process(point_symbolizer const& sym,
+                 mapnik::feature_impl & feature,
+                 proj_transform const& prj_trans);
+    void process(line_symbolizer const& sym,
+                 mapnik::feature_impl & feature,
+                 proj_transform const& prj_trans);
+    void process(line_pattern_symbolizer const& sym,
+                 mapnik::feature_impl & feature,
+                 proj_transform const& prj_trans);
+    void process(polygon_symbolizer const& sym,
+                 mapnik::feature_impl & feature,
+                 proj_transform const& prj_trans);
+    void process(polygon_pattern_symbolizer const& sym,
+                 mapnik::feature_impl & feature,
+                 proj_transform const& prj_trans);
+    void process(shield_symbolizer const& sym,
+                 mapnik::feature_impl & feature,
+                 proj_transform const& prj_trans);
+    void process(text_symbolizer const& sym,
+                 mapnik::feature_impl & feature,
+                 proj_transform const& prj_trans);
+    void process(building_symbolizer const& sym,
+                 mapnik::feature_impl & feature,
+                 proj_transform const& prj_trans);
+    void process(markers_symbolizer const& sym,
+                 mapnik::feature_impl & feature,
+                 proj_transform const& prj_trans);
+    void process(group_symbolizer const& sym,
+                 mapnik::feature_impl & feature,
+                 proj_transform const& prj_trans);
+    // no vector geometry to write
+    void process(raster_symbolizer const&,
+                 mapnik::feature_impl &,
+                 proj_transform const&) {}
+    void process(debug_symbolizer const&,
+                 mapnik::feature_impl &,
+                 proj_transform const&) {}
+
+    inline bool process(rule::symbolizers const& /*syms*/,
+                        mapnik::feature_impl & /*feature*/,
+                        proj_transform const& /*prj_trans*/)
+    {
+        return false;
+    }
+
+    bool painted() const
+    {
+        return painted_;
+    }
+
+    void painted(bool _painted)
+    {
+        painted_ = _painted;
+    }
+
+    // fraction of the placement detector extent covered by labels
+    double label_coverage() const;
+
+    inline eAttributeCollectionPolicy attribute_collection_policy() const
+    {
+        return DEFAULT;
+    }
+
+    inline double scale_factor() const
+    {
+        return common_.scale_factor_;
+    }
+
+    inline attributes const& variables() const
+    {
+        return common_.vars_;
+    }
+
+    // size of the tile in grid units
+    inline unsigned extent() const
+    {
+        return extent_;
+    }
+
+private:
+    struct layer_builder;
+
+    void add_feature(symbolizer_base const& sym,
+                     mapnik::feature_impl & feature,
+                     proj_transform const& prj_trans);
+
+    std::string & output_;
+    unsigned extent_;
+    bool painted_;
+    renderer_common common_;
+    // the layers started, nested ones last
+    std::vector<std::unique_ptr<layer_builder> > layers_;
+};
+
+}
+
+#endif // MAPNIK_VECTOR_TILE_RENDERER_HPP
@@ -49,9 +49,12 @@ class MAPNIK_DECL vertex_cache : util::noncopyable
 {
     struct segment
     {
-        segment(double x, double y, double _length) : pos(x, y), length(_length) {}
+        segment(double x, double y, double _length, double _distance)
+            : pos(x, y), length(_length), distance(_distance) {}
         pixel_position pos; //Last point of this segment, first point is implicitly defined by the previous segement in this vector
         double length;
+        // Distance from the start of the subpath to pos.
+        double distance;
     };
 
     // The first segment always has the length 0 and just defines the starting point.
@@ -60,7 +63,7 @@ class MAPNIK_DECL vertex_cache : util::noncopyable
         segment_vector() : vector(), length(0.) {}
         void add_segment(double x, double y, double len) {
             if (len == 0. && !vector.empty()) return; //Don't add zero length segments
-            vector.emplace_back(x, y, len);
+            vector.emplace_back(x, y, len, length + len);
             length += len;
         }
         using iterator = std::vector<segment>::iterator;
@@ -125,6 +128,10 @@ public:
     bool move(double length);
     // Move to given distance.
     bool move_to_distance(double distance);
+    // Go to the given linear position on the current subpath, found by a
+    // binary search rather than by walking there. Returns false, leaving
+    // the position as it was, if it is not on the subpath.
+    bool seek(double position);
     // Work on next subpath. Returns false if the is no next subpath.
     bool next_subpath();
 
@@ -37,6 +37,9 @@
 #include <mapnik/symbolizer_keys.hpp>
 #include <mapnik/symbolizer.hpp>
 #include <mapnik/extend_converter.hpp>
+#include <mapnik/clip_polygon_converter.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/geometry/envelope.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore_agg.hpp>
@@ -109,7 +112,7 @@ struct converter_traits<T, mapnik::clip_line_tag>
     template <typename Args>
     static void setup(geometry_type & geom, Args const& args)
     {
-        auto const& box = args.bbox;
+        auto const& box = args.source_bbox;
         geom.clip_box(box.minx(),box.miny(),box.maxx(),box.maxy());
     }
 };
@@ -198,11 +201,11 @@ template <typename T>
 struct converter_traits<T,mapnik::clip_poly_tag>
 {
     using geometry_type = T;
-    using conv_type = typename agg::conv_clip_polygon<geometry_type>;
+    using conv_type = clip_polygon_converter<geometry_type>;
     template <typename Args>
     static void setup(geometry_type & geom, Args const& args)
     {
-        auto const& box = args.bbox;
+        auto const& box = args.source_bbox;
         geom.clip_box(box.minx(),box.miny(),box.maxx(),box.maxy());
     }
 };
@@ -218,6 +221,12 @@ struct converter_traits<T,mapnik::transform_tag>
     {
         geom.set_proj_trans(args.prj_trans);
         geom.set_trans(args.tr);
+        // quarter pixel cells, unless a geometry transform rescales them later
+        if (get<value_bool, keys::simplify_prefilter>(args.sym, args.feature, args.vars) &&
+            args.affine_trans.is_identity())
+        {
+            geom.set_pixel_filter(0.25);
+        }
     }
 };
 
@@ -312,6 +321,17 @@ struct converters_helper<Dispatcher, Current, ConverterTypes...>
         }
     }
 
+    template <typename Converter>
+    static bool is_set(Dispatcher const& disp)
+    {
+        if (std::is_same<Converter,Current>::value)
+        {
+            constexpr std::size_t index = sizeof...(ConverterTypes) ;
+            return disp.vec_[index] == 1;
+        }
+        return converters_helper<Dispatcher,ConverterTypes...>:: template is_set<Converter>(disp);
+    }
+
     template <typename Geometry, typename Processor>
     static void forward(Dispatcher & disp, Geometry & geom, Processor & proc,
                         typename std::enable_if<detail::is_switchable<Geometry,Current>::value>::type* = 0)
@@ -345,6 +365,8 @@ struct converters_helper<Dispatcher>
 {
     template <typename Converter>
     static void set(Dispatcher &, std::size_t) {}
+    template <typename Converter>
+    static bool is_set(Dispatcher const&) { return false; }
     template <typename Geometry, typename Processor>
     static void forward(Dispatcher &, Geometry & geom, Processor & proc)
     {
@@ -376,15 +398,26 @@ struct arguments : util::noncopyable
               proj_transform const& _prj_trans, agg::trans_affine const& _affine_trans, feature_impl const& _feature,
               attributes const& _vars, double _scale_factor)
         : bbox(_bbox),
+          source_bbox(_bbox),
           sym(_sym),
           tr(_tr),
           prj_trans(_prj_trans),
           affine_trans(_affine_trans),
           feature(_feature),
           vars(_vars),
-          scale_factor(_scale_factor) {}
+          scale_factor(_scale_factor)
+    {
+        // the clip converters run before reprojection, so they need the
+        // box in the layer's coordinates. Only the well known transforms
+        // map boxes onto boxes; otherwise callers must not clip.
+        if (prj_trans.is_known())
+        {
+            prj_trans.forward(source_bbox);
+        }
+    }
 
     box2d<double> const& bbox;
+    box2d<double> source_bbox;
     symbolizer_base const& sym;
     view_transform const& tr;
     proj_transform const& prj_trans;
@@ -436,7 +469,41 @@ struct vertex_converter : private util::noncopyable
         detail::converters_helper<dispatcher_type, ConverterTypes...>:: template set<Converter>(disp_, 0);
     }
 
+    template <typename Converter>
+    bool is_set() const
+    {
+        return detail::converters_helper<dispatcher_type, ConverterTypes...>:: template is_set<Converter>(disp_);
+    }
+
+    // True when clipping is on and the geometry's envelope misses the clip
+    // box, so clipping would drop every vertex anyway. Tested in the layer's
+    // coordinates before anything is reprojected.
+    template <typename Geometry>
+    bool clipped_away(Geometry const& geom) const
+    {
+        return clip_set() && clipped_away(geometry::envelope(geom));
+    }
+
+    // same for the whole geometry of a feature, from its cached envelope
+    bool clipped_away(feature_impl const& feature) const
+    {
+        return clip_set() && clipped_away(feature.envelope());
+    }
+
+    bool clipped_away(box2d<double> const& envelope) const
+    {
+        if (!clip_set()) return false;
+        if (!disp_.args_.prj_trans.equal() && !disp_.args_.prj_trans.is_known()) return false;
+        return envelope.valid() && !envelope.intersects(disp_.args_.source_bbox);
+    }
+
     dispatcher_type disp_;
+
+private:
+    bool clip_set() const
+    {
+        return is_set<clip_line_tag>() || is_set<clip_poly_tag>();
+    }
 };
 
 }
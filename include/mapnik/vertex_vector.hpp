@@ -88,6 +88,12 @@ public:
         return pos_;
     }
 
+    // drops the vertices, keeping the blocks for reuse
+    void clear()
+    {
+        pos_ = 0;
+    }
+
     void push_back (coordinate_type x,coordinate_type y,command_size command)
     {
         size_type block = pos_ >> block_shift;
@@ -28,6 +28,9 @@
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/proj_transform.hpp>
 
+// stl
+#include <cstddef>
+
 namespace mapnik
 {
 
@@ -109,6 +112,34 @@ public:
         *y = extent_.maxy() - (*y + (offset_y_ - offset_)) / sy_;
     }
 
+    // point_count coordinates, `stride` doubles apart: 1 for separate x[]
+    // and y[] arrays, 2 for interleaved points
+    inline void forward(double *x, double *y, std::size_t point_count, std::size_t stride = 1) const
+    {
+        double const minx = extent_.minx();
+        double const maxy = extent_.maxy();
+        double const dx = offset_x_ - offset_;
+        double const dy = offset_y_ - offset_;
+        for (std::size_t i = 0, n = point_count * stride; i < n; i += stride)
+        {
+            x[i] = (x[i] - minx) * sx_ - dx;
+            y[i] = (maxy - y[i]) * sy_ - dy;
+        }
+    }
+
+    inline void backward(double *x, double *y, std::size_t point_count, std::size_t stride = 1) const
+    {
+        double const minx = extent_.minx();
+        double const maxy = extent_.maxy();
+        double const dx = offset_x_ - offset_;
+        double const dy = offset_y_ - offset_;
+        for (std::size_t i = 0, n = point_count * stride; i < n; i += stride)
+        {
+            x[i] = minx + (x[i] + dx) / sx_;
+            y[i] = maxy - (y[i] + dy) / sy_;
+        }
+    }
+
     inline coord2d& forward(coord2d& c) const
     {
         forward(&c.x, &c.y);
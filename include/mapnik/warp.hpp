@@ -39,7 +39,8 @@ MAPNIK_DECL void reproject_and_scale_raster(raster & target,
                                             double offset_x, double offset_y,
                                             unsigned mesh_size,
                                             scaling_method_e scaling_method,
-                                            boost::optional<double> const & nodata_value);
+                                            boost::optional<double> const & nodata_value,
+                                            unsigned threads = 1);
 
 MAPNIK_DECL void reproject_and_scale_raster(raster & target, raster const& source,
                                             proj_transform const& prj_trans,
@@ -47,11 +48,13 @@ MAPNIK_DECL void reproject_and_scale_raster(raster & target, raster const& sourc
                                             unsigned mesh_size,
                                             scaling_method_e scaling_method);
 
+// The target rows are split between up to `threads` threads on large
+// images. The reprojected mesh comes from warp_mesh_cache.
 template <typename T>
 MAPNIK_DECL void warp_image (T & target, T const& source, proj_transform const& prj_trans,
                              box2d<double> const& target_ext, box2d<double> const& source_ext,
                              double offset_x, double offset_y, unsigned mesh_size, scaling_method_e scaling_method, double filter_factor,
-                             boost::optional<double> const & nodata_value);
+                             boost::optional<double> const & nodata_value, unsigned threads = 1);
 }
 
 #endif // MAPNIK_WARP_HPP
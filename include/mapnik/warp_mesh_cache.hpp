@@ -0,0 +1,96 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_WARP_MESH_CACHE_HPP
+#define MAPNIK_WARP_MESH_CACHE_HPP
+
+// mapnik
+#include <mapnik/config.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/util/singleton.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace mapnik {
+
+class proj_transform;
+
+// Source pixel grid of a raster reprojected into target coordinates, one
+// point every mesh_size pixels.
+struct warp_mesh
+{
+    warp_mesh(std::size_t nx, std::size_t ny)
+        : xs(nx, ny, false),
+          ys(nx, ny, false) {}
+
+    image_gray64f xs;
+    image_gray64f ys;
+};
+
+using warp_mesh_ptr = std::shared_ptr<warp_mesh const>;
+
+// LRU cache of warp meshes keyed by source size, extent, mesh size and
+// projection pair, so rasters warped the same way again skip proj. With a
+// directory set, meshes are also stored there and survive the process.
+class MAPNIK_DECL warp_mesh_cache :
+        public singleton<warp_mesh_cache, CreateStatic>,
+        private util::noncopyable
+{
+    friend class CreateStatic<warp_mesh_cache>;
+public:
+    warp_mesh_ptr get(std::size_t width, std::size_t height,
+                      box2d<double> const& source_ext, unsigned mesh_size,
+                      proj_transform const& prj_trans);
+    void set_capacity(std::size_t capacity);
+    std::size_t capacity() const;
+    std::size_t size() const;
+    // empty to keep meshes in memory only
+    void set_directory(std::string const& directory);
+    std::string directory() const;
+    void clear();
+
+private:
+    warp_mesh_cache();
+    // given the directory read under the lock, as they run outside it
+    static warp_mesh_ptr load(std::string const& directory, std::string const& key);
+    static void store(std::string const& directory, std::string const& key, warp_mesh const& mesh);
+    static std::string filename(std::string const& directory, std::string const& key);
+
+    using entry_type = std::pair<std::string, warp_mesh_ptr>;
+    std::list<entry_type> entries_; // most recently used first
+    std::unordered_map<std::string, std::list<entry_type>::iterator> index_;
+    std::size_t capacity_;
+    std::string directory_;
+};
+
+extern template class MAPNIK_DECL singleton<warp_mesh_cache, CreateStatic>;
+
+}
+
+#endif // MAPNIK_WARP_MESH_CACHE_HPP
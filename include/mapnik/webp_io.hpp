@@ -25,6 +25,7 @@
 
 // mapnik
 #include <mapnik/image.hpp>
+#include <mapnik/image_kernels.hpp>
 #include <mapnik/util/conversions.hpp>
 
 #pragma GCC diagnostic push
@@ -39,6 +40,7 @@ extern "C"
 #include <algorithm>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace mapnik {
 
@@ -50,6 +52,23 @@ int webp_stream_write(const uint8_t* data, size_t data_size, const WebPPicture*
     return true;
 }
 
+// a std::string output is appended to directly
+template <>
+inline int webp_stream_write<std::string>(const uint8_t* data, size_t data_size, const WebPPicture* picture)
+{
+    std::string * out = static_cast<std::string*>(picture->custom_ptr);
+    out->append(reinterpret_cast<const char*>(data), data_size);
+    return true;
+}
+
+template <typename T>
+void webp_flush(T & out)
+{
+    out.flush();
+}
+
+inline void webp_flush(std::string &) {}
+
 std::string webp_encoding_error(WebPEncodingError error)
 {
     std::string os;
@@ -71,75 +90,107 @@ std::string webp_encoding_error(WebPEncodingError error)
     return os;
 }
 
+inline int import_rgba(WebPPicture & pic, unsigned char const* bytes, std::size_t stride, bool alpha)
+{
+    if (alpha)
+    {
+        return WebPPictureImportRGBA(&pic, bytes, static_cast<int>(stride));
+    }
+    else
+    {
+#if (WEBP_ENCODER_ABI_VERSION >> 8) >= 1
+        return WebPPictureImportRGBX(&pic, bytes, static_cast<int>(stride));
+#else
+        return WebPPictureImportRGBA(&pic, bytes, static_cast<int>(stride));
+#endif
+    }
+}
+
+// pixels libwebp can import in place, nullptr if they need a copy
+inline unsigned char const* contiguous_bytes(image_rgba8 const& im)
+{
+    return im.get_premultiplied() && !im.opaque() ? nullptr : im.bytes();
+}
+
 template <typename T2>
-inline int import_image(T2 const& im_in,
-                             WebPPicture & pic,
-                             bool alpha)
+inline unsigned char const* contiguous_bytes(T2 const& im_in)
 {
     image<typename T2::pixel> const& data = im_in.data();
-    std::size_t width = im_in.width();
-    std::size_t height = im_in.height();
-    std::size_t stride = sizeof(typename T2::pixel_type) * width;
-    if (data.width() == width &&
-        data.height() == height)
+    if ((im_in.get_premultiplied() && !im_in.opaque()) ||
+        data.width() != im_in.width() ||
+        data.height() != im_in.height())
     {
-        if (alpha)
-        {
-            return WebPPictureImportRGBA(&pic, data.bytes(), static_cast<int>(stride));
-        }
-        else
-        {
-    #if (WEBP_ENCODER_ABI_VERSION >> 8) >= 1
-            return WebPPictureImportRGBX(&pic, data.bytes(), static_cast<int>(stride));
-    #else
-            return WebPPictureImportRGBA(&pic, data.bytes(), static_cast<int>(stride));
-    #endif
-        }
+        return nullptr;
     }
-    else
+    return data.bytes();
+}
+
+// Copies row of width pixels to out, demultiplied if premultiplied.
+template <typename Pixel>
+inline void copy_webp_row(Pixel const* row, std::size_t width, bool premultiplied, Pixel * out)
+{
+    std::copy(row, row + width, out);
+    if (premultiplied)
     {
-        // need to copy: https://github.com/mapnik/mapnik/issues/2024
-        image_rgba8 im(width,height);
-        for (unsigned y = 0; y < height; ++y)
-        {
-            typename T2::pixel_type const * row_from = im_in.get_row(y);
-            image_rgba8::pixel_type * row_to = im.get_row(y);
-            std::copy(row_from, row_from + width, row_to);
-        }
-        if (alpha)
-        {
-            return WebPPictureImportRGBA(&pic, im.bytes(), static_cast<int>(stride));
-        }
-        else
-        {
-    #if (WEBP_ENCODER_ABI_VERSION >> 8) >= 1
-            return WebPPictureImportRGBX(&pic, im.bytes(), static_cast<int>(stride));
-    #else
-            return WebPPictureImportRGBA(&pic, im.bytes(), static_cast<int>(stride));
-    #endif
-        }
+        simd::rgba8().demultiply(reinterpret_cast<std::uint32_t*>(out), width);
     }
 }
 
-template <>
-inline int import_image(image_rgba8 const& im,
+template <typename T2>
+inline int import_image(T2 const& im_in,
                              WebPPicture & pic,
                              bool alpha)
 {
-    std::size_t stride = sizeof(image_rgba8::pixel_type) * im.width();
-    if (alpha)
+    std::size_t width = im_in.width();
+    std::size_t height = im_in.height();
+    std::size_t stride = sizeof(typename T2::pixel_type) * width;
+    if (unsigned char const* bytes = contiguous_bytes(im_in))
     {
-        return WebPPictureImportRGBA(&pic, im.bytes(), static_cast<int>(stride));
+        return import_rgba(pic, bytes, stride, alpha);
     }
-    else
+    // need to copy: https://github.com/mapnik/mapnik/issues/2024
+    image_rgba8 im(width,height);
+    for (unsigned y = 0; y < height; ++y)
     {
+        copy_webp_row(im_in.get_row(y), width, im_in.get_premultiplied() && !im_in.opaque(), im.get_row(y));
+    }
+    return import_rgba(pic, im.bytes(), stride, alpha);
+}
+
 #if (WEBP_ENCODER_ABI_VERSION >> 8) >= 1
-        return WebPPictureImportRGBX(&pic, im.bytes(), static_cast<int>(stride));
-#else
-        return WebPPictureImportRGBA(&pic, im.bytes(), static_cast<int>(stride));
-#endif
+// Fills the argb buffer of pic a row at a time, premultiplied rows are
+// demultiplied in a scratch row on the way. For lossy output libwebp
+// converts the buffer to YUV itself.
+template <typename T2>
+inline int import_argb(T2 const& image, WebPPicture & pic, bool alpha)
+{
+    pic.use_argb = 1;
+    pic.colorspace = static_cast<WebPEncCSP>(pic.colorspace | WEBP_CSP_ALPHA_BIT);
+    if (!WebPPictureAlloc(&pic)) return 0;
+    const int width = pic.width;
+    const int height = pic.height;
+    bool premultiplied = image.get_premultiplied() && !image.opaque();
+    std::vector<typename T2::pixel_type> scratch(premultiplied ? width : 0);
+    for (int y = 0; y < height; ++y) {
+        typename T2::pixel_type const * row = image.get_row(y);
+        if (premultiplied)
+        {
+            copy_webp_row(row, width, true, scratch.data());
+            row = scratch.data();
+        }
+        for (int x = 0; x < width; ++x) {
+            const unsigned rgba = row[x];
+            unsigned a = alpha ? (rgba >> 24) & 0xff : 0xff;
+            unsigned r = rgba & 0xff;
+            unsigned g = (rgba >> 8 ) & 0xff;
+            unsigned b = (rgba >> 16) & 0xff;
+            const uint32_t argb = (a << 24) | (r << 16) | (g << 8) | (b);
+            pic.argb[x + y * pic.argb_stride] = argb;
+        }
     }
+    return 1;
 }
+#endif
 
 template <typename T1, typename T2>
 void save_as_webp(T1& file,
@@ -159,35 +210,17 @@ void save_as_webp(T1& file,
     }
     pic.width = image.width();
     pic.height = image.height();
+    // opaque images are encoded without an alpha plane
+    if (image.opaque()) alpha = false;
     int ok = 0;
 #if (WEBP_ENCODER_ABI_VERSION >> 8) >= 1
-    pic.use_argb = !!config.lossless;
-    // lossless fast track
-    if (pic.use_argb)
+    // lossless fast track, lossy output imports in place when it can
+    if (config.lossless || !contiguous_bytes(image))
     {
-        pic.colorspace = static_cast<WebPEncCSP>(pic.colorspace | WEBP_CSP_ALPHA_BIT);
-        if (WebPPictureAlloc(&pic)) {
-            ok = 1;
-            const int width = pic.width;
-            const int height = pic.height;
-            for (int y = 0; y < height; ++y) {
-                typename T2::pixel_type const * row = image.get_row(y);
-                for (int x = 0; x < width; ++x) {
-                    const unsigned rgba = row[x];
-                    unsigned a = (rgba >> 24) & 0xff;
-                    unsigned r = rgba & 0xff;
-                    unsigned g = (rgba >> 8 ) & 0xff;
-                    unsigned b = (rgba >> 16) & 0xff;
-                    const uint32_t argb = (a << 24) | (r << 16) | (g << 8) | (b);
-                    pic.argb[x + y * pic.argb_stride] = argb;
-                }
-            }
-        }
+        ok = import_argb(image, pic, alpha || (config.lossless && !image.opaque()));
     }
     else
     {
-        // different approach for lossy since ImportYUVAFromRGBA is needed
-        // to prepare WebPPicture and working with view pixels is not viable
         ok = import_image(image,pic,alpha);
     }
 #else
@@ -206,7 +239,7 @@ void save_as_webp(T1& file,
     {
         throw std::runtime_error(webp_encoding_error(pic.error_code));
     }
-    file.flush();
+    webp_flush(file);
 }
 }
 
@@ -33,6 +33,10 @@
 #include <boost/optional.hpp>
 #pragma GCC diagnostic pop
 
+#ifdef SSE_MATH
+#include <emmintrin.h>
+#endif
+
 // stl
 #include <cmath>
 #include <vector>
@@ -64,9 +68,11 @@ boost::optional<well_known_srs_e> is_well_known_srs(std::string const& srs);
 
 boost::optional<bool> is_known_geographic(std::string const& srs);
 
-static inline bool lonlat2merc(double * x, double * y, std::size_t point_count)
+// The kernels below take coordinates `stride` doubles apart: 1 for separate
+// x[] and y[] arrays, 2 for interleaved points.
+static inline bool lonlat2merc_exact(double * x, double * y, std::size_t point_count, std::size_t stride = 1)
 {
-    for (std::size_t i = 0; i < point_count; ++i)
+    for (std::size_t i = 0, n = point_count * stride; i < n; i += stride)
     {
         if (x[i] > 180) x[i] = 180;
         else if (x[i] < -180) x[i] = -180;
@@ -78,9 +84,9 @@ static inline bool lonlat2merc(double * x, double * y, std::size_t point_count)
     return true;
 }
 
-static inline bool merc2lonlat(double * x, double * y, std::size_t point_count)
+static inline bool merc2lonlat_exact(double * x, double * y, std::size_t point_count, std::size_t stride = 1)
 {
-    for(std::size_t i = 0; i < point_count; ++i)
+    for (std::size_t i = 0, n = point_count * stride; i < n; i += stride)
     {
         if (x[i] > MAXEXTENT) x[i] = MAXEXTENT;
         else if (x[i] < -MAXEXTENT) x[i] = -MAXEXTENT;
@@ -93,34 +99,240 @@ static inline bool merc2lonlat(double * x, double * y, std::size_t point_count)
     return true;
 }
 
-static inline bool lonlat2merc(std::vector<geometry::point<double>> & ls)
+#ifdef SSE_MATH
+namespace detail {
+
+// Two points at a time with SSE2. The transcendentals are evaluated
+// without range reduction over the clamped mercator domain:
+//   y = R * log(tan(pi/4 + lat/2)) = R * log((1 + sin(lat)) / cos(lat))
+//   lat = 2 * atan(tanh(y/R / 2)) = 2 * atan((exp(y/R) - 1) / (exp(y/R) + 1))
+// Results stay within 5e-8 m (projected) and 1e-13 degrees (geographic)
+// of the exact kernels.
+
+// sin(x) and cos(x) for |x| <= MAX_LATITUDE in radians, Taylor series
+// to x^19 and x^20
+static inline __m128d merc_sin(__m128d x)
+{
+    __m128d const z = _mm_mul_pd(x, x);
+    __m128d p = _mm_set1_pd(1.0 / 121645100408832000.0);
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 355687428096000.0));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 1307674368000.0));
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 6227020800.0));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 39916800.0));
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 362880.0));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 5040.0));
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 120.0));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 6.0));
+    return _mm_sub_pd(x, _mm_mul_pd(_mm_mul_pd(x, z), p));
+}
+
+static inline __m128d merc_cos(__m128d x)
+{
+    __m128d const z = _mm_mul_pd(x, x);
+    __m128d p = _mm_set1_pd(1.0 / 2432902008176640000.0);
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 6402373705728000.0));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 20922789888000.0));
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 87178291200.0));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 479001600.0));
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 3628800.0));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 40320.0));
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 720.0));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 24.0));
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(0.5));
+    return _mm_add_pd(_mm_set1_pd(1.0), _mm_mul_pd(z, p));
+}
+
+// log(x) for positive normal x: x = m * 2^e with m in [sqrt(1/2), sqrt(2)),
+// log(m) = 2 * atanh(s), s = (m - 1) / (m + 1), series to s^21
+static inline __m128d merc_log(__m128d x)
+{
+    __m128i const bits = _mm_castpd_si128(x);
+    // 2^52 + biased exponent, read back as a double
+    __m128d e = _mm_sub_pd(
+        _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(bits, 52), _mm_set1_epi64x(0x4330000000000000LL))),
+        _mm_set1_pd(4503599627370496.0 + 1023.0));
+    __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                                              _mm_set1_epi64x(0x3FF0000000000000LL)));
+    __m128d const big = _mm_cmpgt_pd(m, _mm_set1_pd(1.4142135623730951));
+    m = _mm_or_pd(_mm_and_pd(big, _mm_mul_pd(m, _mm_set1_pd(0.5))), _mm_andnot_pd(big, m));
+    e = _mm_add_pd(e, _mm_and_pd(big, _mm_set1_pd(1.0)));
+    __m128d const one = _mm_set1_pd(1.0);
+    __m128d const s = _mm_div_pd(_mm_sub_pd(m, one), _mm_add_pd(m, one));
+    __m128d const z = _mm_mul_pd(s, s);
+    __m128d p = _mm_set1_pd(1.0 / 21);
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 19));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 17));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 15));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 13));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 11));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 9));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 7));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 5));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 3));
+    __m128d const log_m = _mm_mul_pd(_mm_set1_pd(2.0), _mm_add_pd(s, _mm_mul_pd(_mm_mul_pd(s, z), p)));
+    // e * log(2) split in two parts to keep the sum exact
+    return _mm_add_pd(_mm_add_pd(_mm_mul_pd(e, _mm_set1_pd(1.42860682030941723212e-6)), log_m),
+                      _mm_mul_pd(e, _mm_set1_pd(6.93145751953125e-1)));
+}
+
+// exp(x) for |x| <= pi: x = k * log(2) + r, |r| <= log(2)/2, series to r^13
+static inline __m128d merc_exp(__m128d x)
+{
+    __m128d const magic = _mm_set1_pd(6755399441055744.0); // 1.5 * 2^52
+    __m128d const k_magic = _mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(1.4426950408889634)), magic);
+    __m128d const k = _mm_sub_pd(k_magic, magic);
+    __m128d const r = _mm_sub_pd(_mm_sub_pd(x, _mm_mul_pd(k, _mm_set1_pd(6.93145751953125e-1))),
+                                 _mm_mul_pd(k, _mm_set1_pd(1.42860682030941723212e-6)));
+    __m128d p = _mm_set1_pd(1.0 / 6227020800.0);
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.0 / 479001600.0));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.0 / 39916800.0));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.0 / 3628800.0));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.0 / 362880.0));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.0 / 40320.0));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.0 / 5040.0));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.0 / 720.0));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.0 / 120.0));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.0 / 24.0));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.0 / 6.0));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(0.5));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.0));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.0));
+    // the low mantissa bits of k_magic hold k, build 2^k from them
+    __m128i const scale = _mm_slli_epi64(_mm_add_epi64(_mm_castpd_si128(k_magic), _mm_set1_epi64x(1023)), 52);
+    return _mm_mul_pd(p, _mm_castsi128_pd(scale));
+}
+
+// atan(x) for |x| < 1: reduced to |x| <= tan(pi/8) with
+// atan(x) = pi/4 + atan((x - 1) / (x + 1)), then two half angle steps
+// atan(x) = 2 * atan(x / (1 + sqrt(1 + x^2))) and a series to x^19
+static inline __m128d merc_atan(__m128d x)
+{
+    __m128d const one = _mm_set1_pd(1.0);
+    __m128d const sign = _mm_and_pd(x, _mm_set1_pd(-0.0));
+    __m128d a = _mm_xor_pd(x, sign);
+    __m128d const big = _mm_cmpgt_pd(a, _mm_set1_pd(0.41421356237309503));
+    a = _mm_or_pd(_mm_and_pd(big, _mm_div_pd(_mm_sub_pd(a, one), _mm_add_pd(a, one))), _mm_andnot_pd(big, a));
+    a = _mm_div_pd(a, _mm_add_pd(one, _mm_sqrt_pd(_mm_add_pd(one, _mm_mul_pd(a, a)))));
+    a = _mm_div_pd(a, _mm_add_pd(one, _mm_sqrt_pd(_mm_add_pd(one, _mm_mul_pd(a, a)))));
+    __m128d const z = _mm_mul_pd(a, a);
+    __m128d p = _mm_set1_pd(1.0 / 19);
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 17));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 15));
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 13));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 11));
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 9));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 7));
+    p = _mm_sub_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 5));
+    p = _mm_add_pd(_mm_mul_pd(p, z), _mm_set1_pd(1.0 / 3));
+    __m128d r = _mm_mul_pd(_mm_set1_pd(4.0), _mm_sub_pd(a, _mm_mul_pd(_mm_mul_pd(a, z), p)));
+    r = _mm_add_pd(r, _mm_and_pd(big, _mm_set1_pd(M_PI / 4)));
+    return _mm_or_pd(r, sign);
+}
+
+static inline void lonlat2merc(__m128d & x, __m128d & y)
+{
+    // x is the second operand so NaN passes through like the scalar code
+    x = _mm_min_pd(_mm_set1_pd(180.0), _mm_max_pd(_mm_set1_pd(-180.0), x));
+    y = _mm_min_pd(_mm_set1_pd(MAX_LATITUDE), _mm_max_pd(_mm_set1_pd(-MAX_LATITUDE), y));
+    x = _mm_mul_pd(x, _mm_set1_pd(MAXEXTENTby180));
+    // odd in lat, evaluated for |lat| where 1 + sin(lat) does not cancel
+    __m128d const sign = _mm_and_pd(y, _mm_set1_pd(-0.0));
+    __m128d const lat = _mm_mul_pd(_mm_xor_pd(y, sign), _mm_set1_pd(D2R));
+    y = merc_log(_mm_div_pd(_mm_add_pd(_mm_set1_pd(1.0), merc_sin(lat)), merc_cos(lat)));
+    y = _mm_or_pd(_mm_mul_pd(y, _mm_set1_pd(R2D * MAXEXTENTby180)), sign);
+}
+
+static inline void merc2lonlat(__m128d & x, __m128d & y)
 {
-    for (auto& p : ls)
+    x = _mm_min_pd(_mm_set1_pd(MAXEXTENT), _mm_max_pd(_mm_set1_pd(-MAXEXTENT), x));
+    y = _mm_min_pd(_mm_set1_pd(MAXEXTENT), _mm_max_pd(_mm_set1_pd(-MAXEXTENT), y));
+    x = _mm_mul_pd(_mm_div_pd(x, _mm_set1_pd(MAXEXTENT)), _mm_set1_pd(180.0));
+    __m128d const one = _mm_set1_pd(1.0);
+    __m128d const t = merc_exp(_mm_mul_pd(_mm_div_pd(y, _mm_set1_pd(MAXEXTENT)), _mm_set1_pd(M_PI)));
+    y = merc_atan(_mm_div_pd(_mm_sub_pd(t, one), _mm_add_pd(t, one)));
+    y = _mm_mul_pd(y, _mm_set1_pd(2.0 * R2D));
+}
+
+// every point goes through Kernel, a trailing odd point in the low lane,
+// so single points and batches give identical results
+template <void (*Kernel)(__m128d &, __m128d &)>
+static inline void merc_batch(double * x, double * y, std::size_t point_count, std::size_t stride)
+{
+    std::size_t i = 0;
+    if (stride == 1)
     {
-        if (p.x > 180) p.x = 180;
-        else if (p.x < -180) p.x = -180;
-        if (p.y > MAX_LATITUDE) p.y = MAX_LATITUDE;
-        else if (p.y < -MAX_LATITUDE) p.y = -MAX_LATITUDE;
-        p.x = p.x * MAXEXTENTby180;
-        p.y = std::log(std::tan((90 + p.y) * M_PIby360)) * R2D;
-        p.y = p.y * MAXEXTENTby180;
+        for (; i + 2 <= point_count; i += 2)
+        {
+            __m128d vx = _mm_loadu_pd(x + i);
+            __m128d vy = _mm_loadu_pd(y + i);
+            Kernel(vx, vy);
+            _mm_storeu_pd(x + i, vx);
+            _mm_storeu_pd(y + i, vy);
+        }
     }
+    else
+    {
+        for (; i + 2 <= point_count; i += 2)
+        {
+            double * x0 = x + i * stride;
+            double * y0 = y + i * stride;
+            __m128d vx = _mm_loadh_pd(_mm_load_sd(x0), x0 + stride);
+            __m128d vy = _mm_loadh_pd(_mm_load_sd(y0), y0 + stride);
+            Kernel(vx, vy);
+            _mm_storel_pd(x0, vx);
+            _mm_storeh_pd(x0 + stride, vx);
+            _mm_storel_pd(y0, vy);
+            _mm_storeh_pd(y0 + stride, vy);
+        }
+    }
+    if (i < point_count)
+    {
+        __m128d vx = _mm_load_sd(x + i * stride);
+        __m128d vy = _mm_load_sd(y + i * stride);
+        Kernel(vx, vy);
+        _mm_store_sd(x + i * stride, vx);
+        _mm_store_sd(y + i * stride, vy);
+    }
+}
+
+} // namespace detail
+#endif
+
+// Kernels used by proj_transform. The SSE2 polynomial approximations of
+// detail:: above, whose results differ from the std:: functions within
+// the precision given there, are opt-in: they are used when SSE_MERCATOR
+// is defined along with SSE_MATH. The *_exact kernels always use the
+// std:: functions.
+static inline bool lonlat2merc(double * x, double * y, std::size_t point_count, std::size_t stride = 1)
+{
+#if defined(SSE_MATH) && defined(SSE_MERCATOR)
+    detail::merc_batch<detail::lonlat2merc>(x, y, point_count, stride);
     return true;
+#else
+    return lonlat2merc_exact(x, y, point_count, stride);
+#endif
 }
 
-static inline bool merc2lonlat(std::vector<geometry::point<double>> & ls)
+static inline bool merc2lonlat(double * x, double * y, std::size_t point_count, std::size_t stride = 1)
 {
-    for (auto & p : ls)
-    {
-        if (p.x > MAXEXTENT) p.x = MAXEXTENT;
-        else if (p.x < -MAXEXTENT) p.x = -MAXEXTENT;
-        if (p.y > MAXEXTENT) p.y = MAXEXTENT;
-        else if (p.y < -MAXEXTENT) p.y = -MAXEXTENT;
-        p.x = (p.x / MAXEXTENT) * 180;
-        p.y = (p.y / MAXEXTENT) * 180;
-        p.y = R2D * (2 * std::atan(std::exp(p.y * D2R)) - M_PI_by2);
-    }
+#if defined(SSE_MATH) && defined(SSE_MERCATOR)
+    detail::merc_batch<detail::merc2lonlat>(x, y, point_count, stride);
     return true;
+#else
+    return merc2lonlat_exact(x, y, point_count, stride);
+#endif
+}
+
+static inline bool lonlat2merc(std::vector<geometry::point<double>> & ls)
+{
+    if (ls.empty()) return true;
+    return lonlat2merc(&ls.front().x, &ls.front().y, ls.size(), sizeof(geometry::point<double>) / sizeof(double));
+}
+
+static inline bool merc2lonlat(std::vector<geometry::point<double>> & ls)
+{
+    if (ls.empty()) return true;
+    return merc2lonlat(&ls.front().x, &ls.front().y, ls.size(), sizeof(geometry::point<double>) / sizeof(double));
 }
 
 }
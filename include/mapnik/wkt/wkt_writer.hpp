@@ -0,0 +1,48 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_WKT_WKT_WRITER_HPP
+#define MAPNIK_WKT_WKT_WRITER_HPP
+
+// mapnik
+#include <mapnik/geometry.hpp>
+// stl
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace mapnik { namespace wkt {
+
+// Write WKT straight to the output, appending to a string or writing to a
+// stream, without intermediate strings. Floating point coordinates are
+// written as the shortest text reading back as the same double. Empty
+// rings and parts are left out, geometries without any as EMPTY and
+// geometry_empty as POINT EMPTY.
+void write_wkt(std::string & wkt, mapnik::geometry::geometry<double> const& geom);
+void write_wkt(std::ostream & out, mapnik::geometry::geometry<double> const& geom);
+void write_wkt(std::string & wkt, mapnik::geometry::geometry<std::int64_t> const& geom);
+void write_wkt(std::ostream & out, mapnik::geometry::geometry<std::int64_t> const& geom);
+
+}}
+
+#endif // MAPNIK_WKT_WKT_WRITER_HPP
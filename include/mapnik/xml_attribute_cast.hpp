@@ -181,9 +181,19 @@ struct do_xml_attribute_cast<mapnik::enumeration<T,MAX> >
 template <>
 struct do_xml_attribute_cast<mapnik::color>
 {
-    static inline boost::optional<mapnik::color> xml_attribute_cast_impl(xml_tree const&, std::string const& source)
+    static inline boost::optional<mapnik::color> xml_attribute_cast_impl(xml_tree const& tree, std::string const& source)
     {
-        return parse_color(source);
+        std::map<std::string,mapnik::color>::const_iterator itr = tree.color_cache_.find(source);
+        if (itr != tree.color_cache_.end())
+        {
+            return itr->second;
+        }
+        else
+        {
+            mapnik::color c = parse_color(source);
+            tree.color_cache_.emplace(source,c);
+            return c;
+        }
     }
 };
 
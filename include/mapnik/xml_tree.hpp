@@ -26,13 +26,23 @@
 // mapnik
 #include <mapnik/xml_node.hpp>
 #include <mapnik/expression.hpp>
+#include <mapnik/color.hpp>
+#include <mapnik/path_expression.hpp>
 
 //stl
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace mapnik
 {
 
+// fwd declares, see transform/transform_expression.hpp
+namespace detail { struct transform_node; }
+using transform_list = std::vector<detail::transform_node>;
+using transform_list_ptr = std::shared_ptr<transform_list>;
+
 class MAPNIK_DECL xml_tree
 {
 public:
@@ -46,6 +56,11 @@ private:
     std::string file_;
 public:
     mutable std::map<std::string,mapnik::expression_ptr> expr_cache_;
+    // large styles repeat the same colors, transforms and file paths
+    // across many rules, so these are parsed once per tree as well
+    mutable std::map<std::string,mapnik::color> color_cache_;
+    mutable std::map<std::string,mapnik::transform_list_ptr> transform_cache_;
+    mutable std::map<std::string,mapnik::path_expression_ptr> path_cache_;
 };
 
 } //ns mapnik
@@ -45,6 +45,7 @@
 #include <mapnik/make_unique.hpp>
 #include <mapnik/util/spatial_index.hpp>
 #include <mapnik/geom_util.hpp>
+#include <mapnik/memory_report.hpp>
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -52,6 +53,7 @@
 #include <boost/interprocess/streams/bufferstream.hpp>
 #pragma GCC diagnostic pop
 #include <mapnik/mapped_memory_cache.hpp>
+#include <mapnik/trace.hpp>
 #endif
 
 // stl
@@ -125,7 +127,7 @@ csv_datasource::csv_datasource(parameters const& params)
         file_source_type in;
         mapnik::mapped_region_ptr mapped_region;
         boost::optional<mapnik::mapped_region_ptr> memory =
-            mapnik::mapped_memory_cache::instance().find(filename_, true);
+            mapnik::mapped_memory_cache::instance().find(filename_, true, mapnik::mapped_access::sequential);
         if (memory)
         {
             mapped_region = *memory;
@@ -274,6 +276,14 @@ mapnik::layer_descriptor csv_datasource::get_descriptor() const
     return desc_;
 }
 
+std::size_t csv_datasource::memory_usage() const
+{
+    // features are parsed again from the inline string or file on query
+    std::size_t bytes = inline_string_.capacity();
+    if (tree_) bytes += mapnik::estimate_tree_memory(*tree_);
+    return bytes;
+}
+
 boost::optional<mapnik::datasource_geometry_t>
 csv_datasource::get_geometry_type_impl(std::istream & stream) const
 {
@@ -387,6 +397,7 @@ boost::optional<mapnik::datasource_geometry_t> csv_datasource::get_geometry_type
 
 mapnik::featureset_ptr csv_datasource::features(mapnik::query const& q) const
 {
+    mapnik::trace::scope query_trace("datasource", "csv.features");
     for (auto const& name : q.property_names())
     {
         bool found_name = false;
@@ -421,23 +432,34 @@ mapnik::featureset_ptr csv_datasource::features(mapnik::query const& q) const
                       });
             if (inline_string_.empty())
             {
-                return std::make_shared<csv_featureset>(filename_, locator_, separator_, quote_, headers_, ctx_, std::move(index_array));
+                return std::make_shared<csv_featureset>(filename_, locator_, separator_, quote_, headers_, ctx_, std::move(index_array),
+                                                        q.property_names(), q.feature_arena());
             }
             else
             {
-                return std::make_shared<csv_inline_featureset>(inline_string_, locator_, separator_, quote_, headers_, ctx_, std::move(index_array));
+                return std::make_shared<csv_inline_featureset>(inline_string_, locator_, separator_, quote_, headers_, ctx_, std::move(index_array), q.feature_arena());
             }
         }
         else if (has_disk_index_)
         {
             auto const& bbox = q.get_bbox();
             mapnik::bounding_box_filter<float> const filter(mapnik::box2d<float>(bbox.minx(), bbox.miny(), bbox.maxx(), bbox.maxy()));
-            return std::make_shared<csv_index_featureset>(filename_, filter, locator_, separator_, quote_, headers_, ctx_);
+            return std::make_shared<csv_index_featureset>(filename_, filter, locator_, separator_, quote_, headers_, ctx_,
+                                                          q.property_names(), q.feature_arena());
         }
     }
     return mapnik::make_invalid_featureset();
 }
 
+boost::optional<std::size_t> csv_datasource::estimate_features(mapnik::query const& q) const
+{
+    mapnik::box2d<double> const& box = q.get_bbox();
+    if (!extent_.intersects(box)) return std::size_t(0);
+    if (!tree_) return boost::none;
+    return static_cast<std::size_t>(std::distance(tree_->qbegin(boost::geometry::index::intersects(box)),
+                                                  tree_->qend()));
+}
+
 mapnik::featureset_ptr csv_datasource::features_at_point(mapnik::coord2d const& pt, double tol) const
 {
     mapnik::box2d<double> query_bbox(pt, pt);
@@ -82,8 +82,10 @@ public:
     static const char * name();
     mapnik::featureset_ptr features(mapnik::query const& q) const;
     mapnik::featureset_ptr features_at_point(mapnik::coord2d const& pt, double tol = 0) const;
+    boost::optional<std::size_t> estimate_features(mapnik::query const& q) const;
     mapnik::box2d<double> envelope() const;
     mapnik::layer_descriptor get_descriptor() const;
+    std::size_t memory_usage() const;
     boost::optional<mapnik::datasource_geometry_t> get_geometry_type() const;
 private:
     void parse_csv(std::istream & );
@@ -32,7 +32,8 @@
 #include <deque>
 
 csv_featureset::csv_featureset(std::string const& filename, locator_type const& locator, char separator, char quote,
-                               std::vector<std::string> const& headers, mapnik::context_ptr const& ctx, array_type && index_array)
+                               std::vector<std::string> const& headers, mapnik::context_ptr const& ctx, array_type && index_array,
+                               std::set<std::string> const& names, bool feature_arena)
     :
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
     //
@@ -49,11 +50,13 @@ csv_featureset::csv_featureset(std::string const& filename, locator_type const&
     index_end_(index_array_.end()),
     ctx_(ctx),
     locator_(locator),
-    tr_("utf8")
+    tr_("utf8"),
+    arena_(feature_arena ? std::make_shared<mapnik::feature_arena>() : nullptr),
+    selected_(csv_utils::selected_columns(headers, names))
 {
 #if defined (MAPNIK_MEMORY_MAPPED_FILE)
     boost::optional<mapnik::mapped_region_ptr> memory =
-            mapnik::mapped_memory_cache::instance().find(filename, true);
+            mapnik::mapped_memory_cache::instance().find(filename, true, mapnik::mapped_access::sequential);
     if (memory)
     {
         mapped_region_ = *memory;
@@ -75,9 +78,9 @@ mapnik::feature_ptr csv_featureset::parse_feature(char const* beg, char const* e
     auto geom = csv_utils::extract_geometry(values, locator_);
     if (!geom.is<mapnik::geometry::geometry_empty>())
     {
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, ++feature_id_));
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, ++feature_id_, arena_));
         feature->set_geometry(std::move(geom));
-        csv_utils::process_properties(*feature, headers_, values, locator_, tr_);
+        csv_utils::process_properties(*feature, headers_, values, locator_, tr_, selected_);
         return feature;
     }
     return mapnik::feature_ptr();
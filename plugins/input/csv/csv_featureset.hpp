@@ -24,6 +24,7 @@
 #define CSV_FEATURESET_HPP
 
 #include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
 #include <mapnik/unicode.hpp>
 #include "csv_utils.hpp"
 #include "csv_datasource.hpp"
@@ -49,7 +50,9 @@ public:
                    char quote,
                    std::vector<std::string> const& headers,
                    mapnik::context_ptr const& ctx,
-                   array_type && index_array);
+                   array_type && index_array,
+                   std::set<std::string> const& names = std::set<std::string>(),
+                   bool feature_arena = false);
     ~csv_featureset();
     mapnik::feature_ptr next();
 private:
@@ -71,6 +74,9 @@ private:
     mapnik::value_integer feature_id_ = 0;
     locator_type const& locator_;
     mapnik::transcoder tr_;
+    mapnik::feature_arena_ptr arena_;
+    // columns named in the query, empty for all
+    std::vector<bool> selected_;
 };
 
 
@@ -23,9 +23,16 @@
 #ifndef MAPNIK_CSV_GETLINE_HPP
 #define MAPNIK_CSV_GETLINE_HPP
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <istream>
 #include <streambuf>
+#include <vector>
+
+#ifdef SSE_MATH
+#include <emmintrin.h>
+#endif
 
 namespace csv_utils
 {
@@ -67,6 +74,130 @@ std::basic_istream<CharT, Traits>& getline_csv(std::istream& is, std::basic_stri
     return is;
 }
 
+// End of the record starting at p: the first newline outside quotes, or
+// end. in_quote carries the quoting state across calls. Sixteen bytes
+// without a newline or quote (just a quote while quoted) are skipped
+// at a time.
+inline char const* find_record_end(char const* p, char const* end, char newline, char quote, bool & in_quote)
+{
+#ifdef SSE_MATH
+    __m128i const newlines = _mm_set1_epi8(newline);
+    __m128i const quotes = _mm_set1_epi8(quote);
+#endif
+    while (p != end)
+    {
+#ifdef SSE_MATH
+        if (end - p >= 16)
+        {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+            __m128i hits = _mm_cmpeq_epi8(block, quotes);
+            if (!in_quote) hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, newlines));
+            int mask = _mm_movemask_epi8(hits);
+            if (mask == 0)
+            {
+                p += 16;
+                continue;
+            }
+            for (; (mask & 1) == 0; mask >>= 1) ++p;
+        }
+#endif
+        char c = *p;
+        if (c == quote) in_quote = !in_quote;
+        else if (c == newline && !in_quote) return p;
+        ++p;
+    }
+    return end;
+}
+
+// Splits a stream into records like getline_csv, reading it in large
+// blocks instead of a character at a time. Records are returned as
+// spans into the block buffer, valid until the next call.
+class csv_line_reader
+{
+public:
+    csv_line_reader(std::istream & is, char newline, char quote, std::size_t block_size = 1 << 16)
+        : is_(is),
+          newline_(newline),
+          quote_(quote),
+          buffer_(block_size > 0 ? block_size : 1),
+          begin_(0),
+          end_(0),
+          base_(0),
+          offset_(0),
+          eof_(false) {}
+
+    // Next record without its newline, false once the stream is exhausted.
+    bool next(char const*& record_begin, char const*& record_end)
+    {
+        std::size_t scanned = begin_;
+        bool in_quote = false;
+        for (;;)
+        {
+            char const* data = buffer_.data();
+            char const* found = find_record_end(data + scanned, data + end_, newline_, quote_, in_quote);
+            if (found != data + end_)
+            {
+                record_begin = data + begin_;
+                record_end = found;
+                offset_ = base_ + begin_;
+                begin_ = static_cast<std::size_t>(found - data) + 1;
+                return true;
+            }
+            scanned = end_;
+            std::size_t shift = begin_;
+            if (!fill())
+            {
+                if (begin_ == end_) return false;
+                // last record is not terminated
+                record_begin = buffer_.data() + begin_;
+                record_end = buffer_.data() + end_;
+                offset_ = base_ + begin_;
+                begin_ = end_;
+                return true;
+            }
+            scanned -= shift - begin_;
+        }
+    }
+
+    // Stream offset of the record last returned.
+    std::uint64_t offset() const { return offset_; }
+
+private:
+    // Moves pending data to the front of the buffer, growing it when
+    // full, and appends the next block, false at the end of the stream.
+    bool fill()
+    {
+        if (eof_) return false;
+        if (begin_ > 0)
+        {
+            std::copy(buffer_.begin() + begin_, buffer_.begin() + end_, buffer_.begin());
+            base_ += begin_;
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        if (end_ == buffer_.size()) buffer_.resize(buffer_.size() * 2);
+        is_.read(buffer_.data() + end_, static_cast<std::streamsize>(buffer_.size() - end_));
+        std::size_t count = static_cast<std::size_t>(is_.gcount());
+        if (count == 0)
+        {
+            eof_ = true;
+            return false;
+        }
+        end_ += count;
+        return true;
+    }
+
+    std::istream & is_;
+    char newline_;
+    char quote_;
+    std::vector<char> buffer_;
+    std::size_t begin_;
+    std::size_t end_;
+    std::uint64_t base_;
+    std::uint64_t offset_;
+    bool eof_;
+};
+
 }
 
 #endif // MAPNIK_CSV_GETLINE_HPP
@@ -40,25 +40,25 @@ csv_index_featureset::csv_index_featureset(std::string const& filename,
                                            char separator,
                                            char quote,
                                            std::vector<std::string> const& headers,
-                                           mapnik::context_ptr const& ctx)
+                                           mapnik::context_ptr const& ctx,
+                                           std::set<std::string> const& names,
+                                           bool feature_arena)
     : separator_(separator),
       quote_(quote),
       headers_(headers),
       ctx_(ctx),
       locator_(locator),
-      tr_("utf8")
-#if defined(MAPNIK_MEMORY_MAPPED_FILE)
-      //
-#elif defined( _WINDOWS)
-    ,file_(_wfopen(mapnik::utf8_to_utf16(filename).c_str(), L"rb"), std::fclose)
-#else
-    ,file_(std::fopen(filename.c_str(),"rb"), std::fclose)
+      tr_("utf8"),
+      arena_(feature_arena ? std::make_shared<mapnik::feature_arena>() : nullptr),
+    selected_(csv_utils::selected_columns(headers, names))
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE)
+    ,reader_(filename)
 #endif
 
 {
 #if defined (MAPNIK_MEMORY_MAPPED_FILE)
     boost::optional<mapnik::mapped_region_ptr> memory =
-        mapnik::mapped_memory_cache::instance().find(filename, true);
+        mapnik::mapped_memory_cache::instance().find(filename, true, mapnik::mapped_access::random);
     if (memory)
     {
         mapped_region_ = *memory;
@@ -68,16 +68,29 @@ csv_index_featureset::csv_index_featureset(std::string const& filename,
         throw std::runtime_error("could not create file mapping for " + filename);
     }
 #else
-    if (!file_) throw mapnik::datasource_exception("CSV Plugin: can't open file " + filename);
+    if (!reader_.is_open()) throw mapnik::datasource_exception("CSV Plugin: can't open file " + filename);
 #endif
 
     std::string indexname = filename + ".index";
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    // packed indexes are queried in place
+    boost::optional<mapnik::mapped_region_ptr> index_memory =
+        mapnik::mapped_memory_cache::instance().find(indexname, true, mapnik::mapped_access::will_need);
+    if (!index_memory) throw mapnik::datasource_exception("CSV Plugin: can't open index file " + indexname);
+    boost::interprocess::ibufferstream index(static_cast<char const*>((*index_memory)->get_address()),
+                                             (*index_memory)->get_size());
+    mapnik::util::spatial_index<value_type,
+                                mapnik::bounding_box_filter<float>,
+                                boost::interprocess::ibufferstream,
+                                mapnik::box2d<float>>::query(filter, index, positions_);
+#else
     std::ifstream index(indexname.c_str(), std::ios::binary);
     if (!index) throw mapnik::datasource_exception("CSV Plugin: can't open index file " + indexname);
     mapnik::util::spatial_index<value_type,
                                 mapnik::bounding_box_filter<float>,
                                 std::ifstream,
                                 mapnik::box2d<float>>::query(filter, index, positions_);
+#endif
     positions_.erase(std::remove_if(positions_.begin(),
                                     positions_.end(),
                                     [&](value_type const& pos)
@@ -96,9 +109,9 @@ mapnik::feature_ptr csv_index_featureset::parse_feature(char const* beg, char co
     auto geom = csv_utils::extract_geometry(values, locator_);
     if (!geom.is<mapnik::geometry::geometry_empty>())
     {
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, ++feature_id_));
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, ++feature_id_, arena_));
         feature->set_geometry(std::move(geom));
-        csv_utils::process_properties(*feature, headers_, values, locator_, tr_);
+        csv_utils::process_properties(*feature, headers_, values, locator_, tr_, selected_);
         return feature;
     }
     return mapnik::feature_ptr();
@@ -115,20 +128,18 @@ mapnik::feature_ptr csv_index_featureset::next()
 
     while( itr_ != positions_.end())
     {
-        auto pos = *itr_++;
+        auto current = itr_++;
+        auto const& pos = *current;
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
         char const* start = (char const*)mapped_region_->get_address() + pos.off;
         char const*  end = start + pos.size;
 #else
-        std::fseek(file_.get(), pos.off, SEEK_SET);
-        std::vector<char> record;
-        record.resize(pos.second);
-        if (std::fread(record.data(), pos.size, 1, file_.get()) != 1)
+        char const* start = reader_.read(current, positions_.end());
+        if (!start)
         {
             return mapnik::feature_ptr();
         }
-        auto const* start = record.data();
-        auto const*  end = start + record.size();
+        char const* end = start + pos.size;
 #endif
         auto feature = parse_feature(start, end);
         if (feature) return feature;
@@ -24,9 +24,11 @@
 #define CSV_INDEX_FEATURESET_HPP
 
 #include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
 #include <mapnik/unicode.hpp>
 #include <mapnik/geom_util.hpp>
 #include <mapnik/util/spatial_index.hpp>
+#include <mapnik/async_file_reader.hpp>
 #include "csv_utils.hpp"
 #include "csv_datasource.hpp"
 
@@ -51,7 +53,9 @@ public:
                          char separator,
                          char quote,
                          std::vector<std::string> const& headers,
-                         mapnik::context_ptr const& ctx);
+                         mapnik::context_ptr const& ctx,
+                         std::set<std::string> const& names = std::set<std::string>(),
+                         bool feature_arena = false);
     ~csv_index_featureset();
     mapnik::feature_ptr next();
 private:
@@ -63,12 +67,15 @@ private:
     mapnik::value_integer feature_id_ = 0;
     locator_type const& locator_;
     mapnik::transcoder tr_;
+    mapnik::feature_arena_ptr arena_;
+    // columns named in the query, empty for all
+    std::vector<bool> selected_;
 #if defined (MAPNIK_MEMORY_MAPPED_FILE)
     using file_source_type = boost::interprocess::ibufferstream;
     mapnik::mapped_region_ptr mapped_region_;
 #else
-    using file_ptr = std::unique_ptr<std::FILE, int (*)(std::FILE *)>;
-    file_ptr file_;
+    // reads the next block of records while the current one is parsed
+    mapnik::async_record_reader reader_;
 #endif
     std::vector<value_type> positions_;
     std::vector<value_type>::iterator itr_;
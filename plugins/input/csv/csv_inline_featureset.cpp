@@ -38,7 +38,8 @@ csv_inline_featureset::csv_inline_featureset(std::string const& inline_string,
                                              char quote,
                                              std::vector<std::string> const& headers,
                                              mapnik::context_ptr const& ctx,
-                                             array_type && index_array)
+                                             array_type && index_array,
+                                             bool feature_arena)
     : inline_string_(inline_string),
       separator_(separator),
       quote_(quote),
@@ -48,7 +49,8 @@ csv_inline_featureset::csv_inline_featureset(std::string const& inline_string,
       index_end_(index_array_.end()),
       ctx_(ctx),
       locator_(locator),
-      tr_("utf8") {}
+      tr_("utf8"),
+      arena_(feature_arena ? std::make_shared<mapnik::feature_arena>() : nullptr) {}
 
 csv_inline_featureset::~csv_inline_featureset() {}
 
@@ -60,7 +62,7 @@ mapnik::feature_ptr csv_inline_featureset::parse_feature(std::string const& str)
     auto geom = csv_utils::extract_geometry(values, locator_);
     if (!geom.is<mapnik::geometry::geometry_empty>())
     {
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, ++feature_id_));
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, ++feature_id_, arena_));
         feature->set_geometry(std::move(geom));
         csv_utils::process_properties(*feature, headers_, values, locator_, tr_);
         return feature;
@@ -24,6 +24,7 @@
 #define CSV_INLINE_FEATURESET_HPP
 
 #include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
 #include <mapnik/unicode.hpp>
 #include "csv_utils.hpp"
 #include "csv_datasource.hpp"
@@ -40,7 +41,8 @@ public:
                           char quote,
                           std::vector<std::string> const& headers,
                           mapnik::context_ptr const& ctx,
-                          array_type && index_array);
+                          array_type && index_array,
+                          bool feature_arena = false);
     ~csv_inline_featureset();
     mapnik::feature_ptr next();
 private:
@@ -56,6 +58,7 @@ private:
     mapnik::value_integer feature_id_ = 0;
     locator_type const& locator_;
     mapnik::transcoder tr_;
+    mapnik::feature_arena_ptr arena_;
 };
 
 
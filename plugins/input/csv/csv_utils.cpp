@@ -38,6 +38,7 @@
 #include <fstream>
 #include <string>
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
 
 namespace csv_utils {
@@ -216,6 +217,46 @@ mapnik::csv_line parse_line(std::string const& line_str, char separator, char qu
     return parse_line(start, end, separator, quote, 0);
 }
 
+namespace {
+
+// Splits a line without quotes the way csv_line_grammar does: leading
+// spaces of every column are skipped, trailing ones are kept. Lines with
+// quotes, or a space separator (which interacts with the skipper), are
+// left to the grammar.
+bool split_unquoted(char const* start, char const* end, char separator, char quote, mapnik::csv_line & values)
+{
+    std::size_t length = static_cast<std::size_t>(end - start);
+    if (separator == ' ' || std::memchr(start, quote, length) != nullptr) return false;
+    auto skip_spaces = [end](char const* p) { while (p != end && *p == ' ') ++p; return p; };
+    start = skip_spaces(start);
+    if (start != end && *start == '\r') start = skip_spaces(start + 1);
+    if (start != end && *start == '\n') ++start;
+    std::size_t n = 0;
+    for (;;)
+    {
+        start = skip_spaces(start);
+        char const* sep = static_cast<char const*>(std::memchr(start, separator, static_cast<std::size_t>(end - start)));
+        char const* column_end = sep ? sep : end;
+        if (n < values.size()) values[n].assign(start, column_end);
+        else values.emplace_back(start, column_end);
+        ++n;
+        if (!sep) break;
+        start = sep + 1;
+    }
+    values.resize(n);
+    return true;
+}
+
+}
+
+void parse_line(char const* start, char const* end, char separator, char quote, mapnik::csv_line & values)
+{
+    if (!split_unquoted(start, end, separator, quote, values))
+    {
+        values = parse_line(start, end, separator, quote, values.size());
+    }
+}
+
 
 bool is_likely_number(std::string const& value)
 {
@@ -268,6 +309,9 @@ void csv_file_parser::parse_csv_and_boxes(std::istream & csv_file, T & boxes)
     std::string csv_line;
     csv_utils::getline_csv(csv_file, csv_line, newline, quote_);
     csv_file.seekg(0, std::ios::beg);
+    csv_utils::csv_line_reader reader(csv_file, newline, quote_);
+    char const* line_start = nullptr;
+    char const* line_end = nullptr;
     int line_number = 0;
     if (!manual_headers_.empty())
     {
@@ -282,8 +326,9 @@ void csv_file_parser::parse_csv_and_boxes(std::istream & csv_file, T & boxes)
     }
     else // parse first line as headers
     {
-        while (csv_utils::getline_csv(csv_file, csv_line, newline, quote_))
+        while (reader.next(line_start, line_end))
         {
+            csv_line.assign(line_start, line_end);
             try
             {
                 auto headers = csv_utils::parse_line(csv_line, separator_, quote_);
@@ -348,22 +393,18 @@ void csv_file_parser::parse_csv_and_boxes(std::istream & csv_file, T & boxes)
     }
 
     mapnik::value_integer feature_count = 0;
-    auto pos = csv_file.tellg();
     // handle rare case of a single line of data and user-provided headers
-    // where a lack of a newline will mean that csv_utils::getline_csv returns false
+    // where a lack of a newline will mean that there is no further record
     bool is_first_row = false;
 
-    if (!has_newline)
+    if (!has_newline && !csv_line.empty())
     {
-        csv_file.setstate(std::ios::failbit);
-        pos = 0;
-        if (!csv_line.empty())
-        {
-            is_first_row = true;
-        }
+        is_first_row = true;
     }
 
-    while (is_first_row || csv_utils::getline_csv(csv_file, csv_line, newline, quote_))
+    // reused across rows
+    mapnik::csv_line values;
+    while (is_first_row || (has_newline && reader.next(line_start, line_end)))
     {
         ++line_number;
         if ((row_limit_ > 0) && (line_number > row_limit_))
@@ -371,15 +412,23 @@ void csv_file_parser::parse_csv_and_boxes(std::istream & csv_file, T & boxes)
             MAPNIK_LOG_DEBUG(csv) << "csv_datasource: row limit hit, exiting at feature: " << feature_count;
             break;
         }
-        auto record_offset = pos;
-        auto record_size = csv_line.length();
-        pos = csv_file.tellg();
+        std::uint64_t record_offset = 0;
+        if (is_first_row)
+        {
+            line_start = csv_line.data();
+            line_end = line_start + csv_line.size();
+        }
+        else
+        {
+            record_offset = reader.offset();
+        }
+        std::size_t record_size = static_cast<std::size_t>(line_end - line_start);
         is_first_row = false;
 
         // skip blank lines
         if (record_size <= 10)
         {
-            std::string trimmed = csv_line;
+            std::string trimmed(line_start, line_end);
             boost::trim_if(trimmed, boost::algorithm::is_any_of("\",'\r\n "));
             if (trimmed.empty())
             {
@@ -390,9 +439,7 @@ void csv_file_parser::parse_csv_and_boxes(std::istream & csv_file, T & boxes)
 
         try
         {
-            auto const* line_start = csv_line.data();
-            auto const* line_end = line_start + csv_line.size();
-            auto values = csv_utils::parse_line(line_start, line_end, separator_, quote_, num_headers);
+            csv_utils::parse_line(line_start, line_end, separator_, quote_, values);
             unsigned num_fields = values.size();
             if (num_fields != num_headers)
             {
@@ -421,7 +468,7 @@ void csv_file_parser::parse_csv_and_boxes(std::istream & csv_file, T & boxes)
                     else
                         extent_ = box;
                 }
-                boxes.emplace_back(box_type(box), make_pair(record_offset, record_size));
+                boxes.emplace_back(box_type(box), std::make_pair(record_offset, static_cast<std::uint64_t>(record_size)));
                 add_feature(++feature_count, values);
             }
             else
@@ -445,7 +492,7 @@ void csv_file_parser::parse_csv_and_boxes(std::istream & csv_file, T & boxes)
         {
             std::ostringstream s;
             s << "CSV Plugin: unexpected error parsing line: " << line_number
-              << " - found " << headers_.size() << " with values like: " << csv_line << "\n"
+              << " - found " << headers_.size() << " with values like: " << std::string(line_start, line_end) << "\n"
               << " and got error like: " << ex.what();
             if (strict_)
             {
@@ -461,6 +508,17 @@ void csv_file_parser::parse_csv_and_boxes(std::istream & csv_file, T & boxes)
     }
 }
 
+std::vector<bool> selected_columns(std::vector<std::string> const& headers, std::set<std::string> const& names)
+{
+    std::vector<bool> selected;
+    if (names.empty()) return selected;
+    selected.reserve(headers.size());
+    for (auto const& header : headers)
+    {
+        selected.push_back(names.count(header) != 0);
+    }
+    return selected;
+}
 
 mapnik::geometry::geometry<double> extract_geometry(std::vector<std::string> const& row, geometry_column_locator const& locator)
 {
@@ -33,6 +33,7 @@
 
 // std
 #include <iosfwd>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -40,6 +41,8 @@ namespace csv_utils {
 
 mapnik::csv_line parse_line(char const* start, char const* end, char separator, char quote, std::size_t num_columns);
 mapnik::csv_line parse_line(std::string const& line_str, char separator, char quote);
+// Parses into values, reusing its storage; lines without quotes skip the grammar.
+void parse_line(char const* start, char const* end, char separator, char quote, mapnik::csv_line & values);
 
 bool is_likely_number(std::string const& value);
 
@@ -58,8 +61,14 @@ struct geometry_column_locator
 
 mapnik::geometry::geometry<double> extract_geometry(std::vector<std::string> const& row, geometry_column_locator const& locator);
 
+// Flags the headers listed in names, empty (every column) when names is empty.
+std::vector<bool> selected_columns(std::vector<std::string> const& headers, std::set<std::string> const& names);
+
+// Columns not flagged in selected are left unset, an empty selected
+// converts every column.
 template <typename Feature, typename Headers, typename Values, typename Locator, typename Transcoder>
-void process_properties(Feature & feature, Headers const& headers, Values const& values, Locator const& locator, Transcoder const& tr)
+void process_properties(Feature & feature, Headers const& headers, Values const& values, Locator const& locator, Transcoder const& tr,
+                        std::vector<bool> const& selected = std::vector<bool>())
 {
     auto val_beg = values.begin();
     auto val_end = values.end();
@@ -67,6 +76,11 @@ void process_properties(Feature & feature, Headers const& headers, Values const&
     for (std::size_t i = 0; i < num_headers; ++i)
     {
         std::string const& fld_name = headers.at(i);
+        if (!selected.empty() && !selected[i])
+        {
+            if (val_beg != val_end) ++val_beg;
+            continue;
+        }
         if (val_beg == val_end)
         {
             feature.put(fld_name,tr.transcode(""));
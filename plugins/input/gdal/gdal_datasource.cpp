@@ -32,6 +32,9 @@
 
 #include <gdal_version.h>
 
+// stl
+#include <thread>
+
 using mapnik::datasource;
 using mapnik::parameters;
 
@@ -57,6 +60,7 @@ extern "C" MAPNIK_EXP void on_plugin_load()
 gdal_datasource::gdal_datasource(parameters const& params)
     : datasource(params),
       dataset_(nullptr, &GDALClose),
+      pool_(),
       desc_(gdal_datasource::name(), "utf-8"),
       nodata_value_(params.get<double>("nodata")),
       nodata_tolerance_(*params.get<double>("nodata_tolerance",1e-12))
@@ -187,6 +191,21 @@ gdal_datasource::gdal_datasource(parameters const& params)
     MAPNIK_LOG_DEBUG(gdal) << "gdal_datasource: Raster Size=" << width_ << "," << height_;
     MAPNIK_LOG_DEBUG(gdal) << "gdal_datasource: Raster Extent=" << extent_;
 
+    if (!shared_dataset_)
+    {
+        // one dataset per concurrent query, the first being the one
+        // read above
+        unsigned threads = std::thread::hardware_concurrency();
+        mapnik::value_integer pool_size = *params.get<mapnik::value_integer>("pool_size", threads > 0 ? threads : 1);
+        std::string name = dataset_name_;
+        pool_ = std::make_shared<gdal_dataset_pool>([name]() {
+                auto ds = GDALOpen(name.c_str(), GA_ReadOnly);
+                if (!ds) throw datasource_exception(CPLGetLastErrorMsg());
+                return gdal_dataset_pool::handle_type(static_cast<GDALDataset*>(ds));
+            }, pool_size > 0 ? static_cast<std::size_t>(pool_size) : 1);
+        pool_->add(gdal_dataset_pool::handle_type(dataset_.release()));
+    }
+
 }
 
 gdal_datasource::~gdal_datasource()
@@ -219,13 +238,20 @@ layer_descriptor gdal_datasource::get_descriptor() const
     return desc_;
 }
 
+std::shared_ptr<GDALDataset> gdal_datasource::dataset() const
+{
+    if (pool_) return pool_->acquire();
+    // a shared dataset belongs to the datasource
+    return std::shared_ptr<GDALDataset>(dataset_.get(), [](GDALDataset *) {});
+}
+
 featureset_ptr gdal_datasource::features(query const& q) const
 {
 #ifdef MAPNIK_STATS
     mapnik::progress_timer __stats__(std::clog, "gdal_datasource::features");
 #endif
 
-    return std::make_shared<gdal_featureset>(*dataset_,
+    return std::make_shared<gdal_featureset>(dataset(),
                                               band_,
                                               gdal_query(q),
                                               extent_,
@@ -244,7 +270,7 @@ featureset_ptr gdal_datasource::features_at_point(coord2d const& pt, double tol)
     mapnik::progress_timer __stats__(std::clog, "gdal_datasource::features_at_point");
 #endif
 
-    return std::make_shared<gdal_featureset>(*dataset_,
+    return std::make_shared<gdal_featureset>(dataset(),
                                               band_,
                                               gdal_query(pt),
                                               extent_,
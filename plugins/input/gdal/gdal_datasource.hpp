@@ -31,6 +31,7 @@
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/coord.hpp>
 #include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/util/handle_pool.hpp>
 
 // boost
 #include <boost/optional.hpp>
@@ -42,6 +43,16 @@
 // gdal
 #include <gdal_priv.h>
 
+struct gdal_dataset_closer
+{
+    void operator()(GDALDataset * dataset) const
+    {
+        GDALClose(dataset);
+    }
+};
+
+using gdal_dataset_pool = mapnik::util::handle_pool<GDALDataset, gdal_dataset_closer>;
+
 class gdal_datasource : public mapnik::datasource
 {
 public:
@@ -55,7 +66,12 @@ public:
     boost::optional<mapnik::datasource_geometry_t> get_geometry_type() const;
     mapnik::layer_descriptor get_descriptor() const;
 private:
+    std::shared_ptr<GDALDataset> dataset() const;
+
     std::unique_ptr<GDALDataset, decltype(&GDALClose)> dataset_;
+    // datasets aren't thread safe, so unless shared each featureset
+    // reads one of these
+    std::shared_ptr<gdal_dataset_pool> pool_;
     mapnik::box2d<double> extent_;
     std::string dataset_name_;
     int band_;
@@ -31,7 +31,9 @@
 #include <mapnik/feature_factory.hpp>
 
 // stl
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <memory>
 #include <sstream>
 
@@ -44,6 +46,40 @@ using mapnik::view_transform;
 using mapnik::datasource_exception;
 using mapnik::feature_factory;
 
+namespace {
+
+// Sets the alpha of every pixel from its first byte, transparent where it
+// is within tolerance of nodata, through a table of the 256 byte values.
+void apply_nodata_alpha(mapnik::image_rgba8 & image, double nodata, double tolerance)
+{
+    std::uint32_t alpha[256];
+    for (unsigned v = 0; v < 256; ++v)
+    {
+        alpha[v] = std::fabs(nodata - v) < tolerance ? 0 : 0xff000000;
+    }
+    std::uint32_t * pixels = image.data();
+    std::size_t len = image.width() * image.height();
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        std::uint32_t p = pixels[i];
+        pixels[i] = (p & 0x00ffffff) | alpha[p & 0xff];
+    }
+}
+
+// Copies the grey value read into the first byte to green and blue.
+void spread_grey(mapnik::image_rgba8 & image)
+{
+    std::uint32_t * pixels = image.data();
+    std::size_t len = image.width() * image.height();
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        std::uint32_t p = pixels[i];
+        pixels[i] = (p & 0xff000000) | ((p & 0xff) * 0x010101);
+    }
+}
+
+} // anonymous ns
+
 #ifdef MAPNIK_LOG
 namespace {
 
@@ -79,7 +115,7 @@ void get_overview_meta(GDALRasterBand* band)
 }
 } // anonymous ns
 #endif
-gdal_featureset::gdal_featureset(GDALDataset& dataset,
+gdal_featureset::gdal_featureset(std::shared_ptr<GDALDataset> const& dataset,
                                  int band,
                                  gdal_query q,
                                  mapnik::box2d<double> extent,
@@ -90,7 +126,8 @@ gdal_featureset::gdal_featureset(GDALDataset& dataset,
                                  double dy,
                                  boost::optional<double> const& nodata,
                                  double nodata_tolerance)
-    : dataset_(dataset),
+    : dataset_ptr_(dataset),
+      dataset_(*dataset),
       ctx_(std::make_shared<mapnik::context_type>()),
       band_(band),
       gquery_(q),
@@ -122,6 +159,31 @@ feature_ptr gdal_featureset::next()
     return feature_ptr();
 }
 
+double gdal_featureset::select_overview_factor(mapnik::query const& q) const
+{
+    // size of an output pixel in source pixels
+    double output_factor = std::min(1.0 / (std::fabs(dx_) * std::get<0>(q.resolution())),
+                                    1.0 / (std::fabs(dy_) * std::get<1>(q.resolution())));
+    if (!(output_factor > 1.0)) return 1.0;
+    GDALRasterBand * band = dataset_.GetRasterBand(band_ > 0 ? band_ : 1);
+    if (band == nullptr) return 1.0;
+    double factor = 1.0;
+    int count = band->GetOverviewCount();
+    for (int i = 0; i < count; ++i)
+    {
+        GDALRasterBand * overview = band->GetOverview(i);
+        if (overview == nullptr || overview->GetXSize() <= 0 || overview->GetYSize() <= 0) continue;
+        double overview_factor = std::max(static_cast<double>(raster_width_) / overview->GetXSize(),
+                                          static_cast<double>(raster_height_) / overview->GetYSize());
+        if (overview_factor <= output_factor && overview_factor > factor)
+        {
+            factor = overview_factor;
+        }
+    }
+    MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Overview factor=" << factor << " for output factor=" << output_factor;
+    return factor;
+}
+
 feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
 {
     feature_ptr feature = feature_factory::create(ctx_,1);
@@ -192,6 +254,22 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
     box2d<double> feature_raster_extent(x_off, y_off, x_off + width, y_off + height);
     feature_raster_extent = t.backward(feature_raster_extent);
 
+    // When zoomed out, read the window at the resolution of the coarsest
+    // overview that is still at least as fine as the output. Passing the
+    // smaller buffer size to RasterIO makes GDAL read from that overview
+    // instead of decimating the full resolution blocks.
+    int im_width = width;
+    int im_height = height;
+    if (width > 0 && height > 0)
+    {
+        double overview_factor = select_overview_factor(q);
+        if (overview_factor > 1.0)
+        {
+            im_width = std::max(1, static_cast<int>(std::ceil(width / overview_factor)));
+            im_height = std::max(1, static_cast<int>(std::ceil(height / overview_factor)));
+        }
+    }
+
     MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Raster extent=" << raster_extent_;
     MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: View extent=" << intersect;
     MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Query resolution=" << std::get<0>(q.resolution()) << "," << std::get<1>(q.resolution());
@@ -199,7 +277,7 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
 
     if (width > 0 && height > 0)
     {
-        MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Image Size=(" << width << "," << height << ")";
+        MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Image Size=(" << im_width << "," << im_height << ")";
         MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Reading band=" << band_;
         if (band_ > 0) // we are querying a single band
         {
@@ -215,7 +293,7 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
             {
             case GDT_Byte:
             {
-                mapnik::image_gray8 image(width, height);
+                mapnik::image_gray8 image(im_width, im_height);
                 image.set(std::numeric_limits<std::uint8_t>::max());
                 raster_nodata = band->GetNoDataValue(&raster_has_nodata);
                 raster_io_error = band->RasterIO(GF_Read, x_off, y_off, width, height,
@@ -235,7 +313,7 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
             case GDT_Float64:
             case GDT_Float32:
             {
-                mapnik::image_gray32f image(width, height);
+                mapnik::image_gray32f image(im_width, im_height);
                 image.set(std::numeric_limits<float>::max());
                 raster_nodata = band->GetNoDataValue(&raster_has_nodata);
                 raster_io_error = band->RasterIO(GF_Read, x_off, y_off, width, height,
@@ -254,7 +332,7 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
             }
             case GDT_UInt16:
             {
-                mapnik::image_gray16 image(width, height);
+                mapnik::image_gray16 image(im_width, im_height);
                 image.set(std::numeric_limits<std::uint16_t>::max());
                 raster_nodata = band->GetNoDataValue(&raster_has_nodata);
                 raster_io_error = band->RasterIO(GF_Read, x_off, y_off, width, height,
@@ -274,7 +352,7 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
             default:
             case GDT_Int16:
             {
-                mapnik::image_gray16s image(width, height);
+                mapnik::image_gray16s image(im_width, im_height);
                 image.set(std::numeric_limits<std::int16_t>::max());
                 raster_nodata = band->GetNoDataValue(&raster_has_nodata);
                 raster_io_error = band->RasterIO(GF_Read, x_off, y_off, width, height,
@@ -295,7 +373,7 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
         }
         else // working with all bands
         {
-            mapnik::image_rgba8 image(width, height);
+            mapnik::image_rgba8 image(im_width, im_height);
             image.set(std::numeric_limits<std::uint32_t>::max());
             for (int i = 0; i < nbands_; ++i)
             {
@@ -370,97 +448,36 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
                     break;
                 }
             }
+            // bands go straight into the interleaved rgba pixels with one
+            // RasterIO, so every block of the file is decoded once
+            int const line_space = 4 * image.width();
+            bool alpha_read = false;
             if (red && green && blue)
             {
                 MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: Processing rgb bands...";
                 raster_nodata = red->GetNoDataValue(&raster_has_nodata);
                 GDALColorTable *color_table = red->GetColorTable();
                 bool has_nodata = nodata_value_ || raster_has_nodata;
+                int band_map[4] = { red->GetBand(), green->GetBand(), blue->GetBand(),
+                                    alpha ? alpha->GetBand() : 0 };
+                raster_io_error = dataset_.RasterIO(GF_Read, x_off, y_off, width, height,
+                                                    image.bytes(),
+                                                    image.width(), image.height(), GDT_Byte,
+                                                    alpha ? 4 : 3, band_map,
+                                                    4, line_space, 1);
+                if (raster_io_error == CE_Failure) {
+                    throw datasource_exception(CPLGetLastErrorMsg());
+                }
+                alpha_read = alpha != nullptr;
 
-                // we can deduce the alpha channel from nodata in the Byte case
-                // by reusing the reading of R,G,B bands directly
-                if (has_nodata && !color_table && red->GetRasterDataType() == GDT_Byte)
+                // we can deduce the alpha channel from nodata in the Byte case,
+                // an alpha band wins over the nodata value of the file
+                if (has_nodata && !color_table && red->GetRasterDataType() == GDT_Byte
+                    && (!alpha || !raster_has_nodata))
                 {
-                    double apply_nodata = nodata_value_ ? *nodata_value_ : raster_nodata;
-                    // read the data in and create an alpha channel from the nodata values
                     // TODO - we assume here the nodata value for the red band applies to all bands
                     // more details about this at http://trac.osgeo.org/gdal/ticket/2734
-                    float* imageData = (float*)image.bytes();
-                    raster_io_error = red->RasterIO(GF_Read, x_off, y_off, width, height,
-                                                    imageData, image.width(), image.height(),
-                                                    GDT_Float32, 0, 0);
-                    if (raster_io_error == CE_Failure) {
-                        throw datasource_exception(CPLGetLastErrorMsg());
-                    }
-                    int len = image.width() * image.height();
-                    for (int i = 0; i < len; ++i)
-                    {
-                        if (std::fabs(apply_nodata - imageData[i]) < nodata_tolerance_)
-                        {
-                            *reinterpret_cast<unsigned *>(&imageData[i]) = 0;
-                        }
-                        else
-                        {
-                            *reinterpret_cast<unsigned *>(&imageData[i]) = 0xFFFFFFFF;
-                        }
-                    }
-                }
-
-                /* Use dataset RasterIO in priority in 99.9% of the cases */
-                if( red->GetBand() == 1 && green->GetBand() == 2 && blue->GetBand() == 3 )
-                {
-                    int nBandsToRead = 3;
-                    if( alpha != nullptr && alpha->GetBand() == 4 && !raster_has_nodata )
-                    {
-                        nBandsToRead = 4;
-                        alpha = nullptr; // to avoid reading it again afterwards
-                    }
-                    raster_io_error = dataset_.RasterIO(GF_Read, x_off, y_off, width, height,
-                                                        image.bytes(),
-                                                        image.width(), image.height(), GDT_Byte,
-                                                        nBandsToRead, nullptr,
-                                                        4, 4 * image.width(), 1);
-                    if (raster_io_error == CE_Failure) {
-                        throw datasource_exception(CPLGetLastErrorMsg());
-                    }
-                }
-                else
-                {
-                    raster_io_error = red->RasterIO(GF_Read, x_off, y_off, width, height, image.bytes() + 0,
-                                                    image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
-                    if (raster_io_error == CE_Failure) {
-                        throw datasource_exception(CPLGetLastErrorMsg());
-                    }
-                    raster_io_error = green->RasterIO(GF_Read, x_off, y_off, width, height, image.bytes() + 1,
-                                                    image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
-                    if (raster_io_error == CE_Failure) {
-                        throw datasource_exception(CPLGetLastErrorMsg());
-                    }
-                    raster_io_error = blue->RasterIO(GF_Read, x_off, y_off, width, height, image.bytes() + 2,
-                                                    image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
-                    if (raster_io_error == CE_Failure) {
-                        throw datasource_exception(CPLGetLastErrorMsg());
-                    }
-                }
-
-                // In the case we skipped initializing the alpha channel
-                if (has_nodata && !color_table && red->GetRasterDataType() == GDT_Byte)
-                {
-                    double apply_nodata = nodata_value_ ? *nodata_value_ : raster_nodata;
-                    if( apply_nodata >= 0 && apply_nodata <= 255 )
-                    {
-                        int len = image.width() * image.height();
-                        GByte* pabyBytes = (GByte*) image.bytes();
-                        for (int i = 0; i < len; ++i)
-                        {
-                            // TODO - we assume here the nodata value for the red band applies to all bands
-                            // more details about this at http://trac.osgeo.org/gdal/ticket/2734
-                            if (std::fabs(apply_nodata - pabyBytes[4*i]) < nodata_tolerance_)
-                                pabyBytes[4*i + 3] = 0;
-                            else
-                                pabyBytes[4*i + 3] = 255;
-                        }
-                    }
+                    apply_nodata_alpha(image, nodata_value_ ? *nodata_value_ : raster_nodata, nodata_tolerance_);
                 }
             }
             else if (grey)
@@ -469,7 +486,9 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
                 raster_nodata = grey->GetNoDataValue(&raster_has_nodata);
                 GDALColorTable* color_table = grey->GetColorTable();
                 bool has_nodata = nodata_value_ || raster_has_nodata;
-                if (!color_table && has_nodata)
+                // nodata is a band value, which the Byte read loses for other types
+                bool byte_nodata = grey->GetRasterDataType() == GDT_Byte;
+                if (!color_table && has_nodata && !byte_nodata)
                 {
                     double apply_nodata = nodata_value_ ? *nodata_value_ : raster_nodata;
                     MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: applying nodata value for layer=" << apply_nodata;
@@ -496,27 +515,20 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
                     }
                 }
 
-                raster_io_error = grey->RasterIO(GF_Read, x_off, y_off, width, height, image.bytes() + 0,
-                                                 image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
-                if (raster_io_error == CE_Failure)
-                {
-                    throw datasource_exception(CPLGetLastErrorMsg());
-                }
-
-                raster_io_error = grey->RasterIO(GF_Read,x_off, y_off, width, height, image.bytes() + 1,
-                                                 image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
-                if (raster_io_error == CE_Failure)
-                {
-                    throw datasource_exception(CPLGetLastErrorMsg());
-                }
-
-                raster_io_error = grey->RasterIO(GF_Read,x_off, y_off, width, height, image.bytes() + 2,
-                                                 image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
-
+                // the alpha band, unless nodata sets transparency or the colour
+                // table replaces whole pixels, is read along into the fourth byte
+                bool read_alpha = alpha && !raster_has_nodata && !color_table;
+                int band_map[2] = { grey->GetBand(), read_alpha ? alpha->GetBand() : 0 };
+                raster_io_error = dataset_.RasterIO(GF_Read, x_off, y_off, width, height,
+                                                    image.bytes(),
+                                                    image.width(), image.height(), GDT_Byte,
+                                                    read_alpha ? 2 : 1, band_map,
+                                                    4, line_space, 3);
                 if (raster_io_error == CE_Failure)
                 {
                     throw datasource_exception(CPLGetLastErrorMsg());
                 }
+                alpha_read = read_alpha;
 
                 if (color_table)
                 {
@@ -541,11 +553,23 @@ feature_ptr gdal_featureset::get_feature(mapnik::query const& q)
                         }
                     }
                 }
+                else
+                {
+                    if (has_nodata && byte_nodata && !read_alpha)
+                    {
+                        apply_nodata_alpha(image, nodata_value_ ? *nodata_value_ : raster_nodata, nodata_tolerance_);
+                    }
+                    spread_grey(image);
+                }
             }
             if (alpha)
             {
                 MAPNIK_LOG_DEBUG(gdal) << "gdal_featureset: processing alpha band...";
-                if (!raster_has_nodata || (red && green && blue))
+                if (alpha_read)
+                {
+                    // read along with the colour bands
+                }
+                else if (!raster_has_nodata || (red && green && blue))
                 {
                     raster_io_error = alpha->RasterIO(GF_Read, x_off, y_off, width, height, image.bytes() + 3,
                                                       image.width(), image.height(), GDT_Byte, 4, 4 * image.width());
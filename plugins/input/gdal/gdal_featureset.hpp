@@ -56,7 +56,7 @@ class gdal_featureset : public mapnik::Featureset
     };
 
 public:
-    gdal_featureset(GDALDataset& dataset,
+    gdal_featureset(std::shared_ptr<GDALDataset> const& dataset,
                     int band,
                     gdal_query q,
                     mapnik::box2d<double> extent,
@@ -72,7 +72,11 @@ public:
 
 private:
     mapnik::feature_ptr get_feature(mapnik::query const& q);
+    // source pixels per pixel of the overview to read q from, 1 for full resolution
+    double select_overview_factor(mapnik::query const& q) const;
     mapnik::feature_ptr get_feature_at_point(mapnik::coord2d const& p);
+    // held for the featureset's lifetime, then handed back to the pool
+    std::shared_ptr<GDALDataset> dataset_ptr_;
     GDALDataset & dataset_;
     mapnik::context_ptr ctx_;
     int band_;
@@ -28,6 +28,7 @@
 #include <mapnik/unicode.hpp>
 #include <mapnik/feature.hpp>
 #include <mapnik/feature_factory.hpp>
+#include <mapnik/geometry/envelope.hpp>
 #include <mapnik/util/noncopyable.hpp>
 #include <cmath>
 #include <cassert>
@@ -86,6 +87,8 @@ struct geobuf : util::noncopyable
     std::size_t lengths = 0;
     std::vector<std::string> keys_;
     std::vector<value_type> values_;
+    char const* buf_;
+    std::size_t size_;
     protozero::pbf_reader reader_;
     FeatureCallback & callback_;
     context_ptr ctx_;
@@ -93,7 +96,9 @@ struct geobuf : util::noncopyable
 public:
     //ctor
     geobuf (char const* buf, std::size_t size, FeatureCallback & callback)
-        : reader_(buf, size),
+        : buf_(buf),
+          size_(size),
+          reader_(buf, size),
           callback_(callback),
           ctx_(std::make_shared<context_type>()),
           tr_(new transcoder("utf8")) {}
@@ -102,55 +107,146 @@ public:
     {
         while (reader_.next())
         {
+            if (read_header_field()) continue;
             switch (reader_.tag())
             {
-            case 1: // keys
+            case 4:
             {
-                keys_.push_back(reader_.get_string());
+                auto feature_collection = reader_.get_message();
+                read_feature_collection(feature_collection);
                 break;
             }
-            case 2:
+            case 5:
             {
-                dim = reader_.get_uint32();
+                // standalone Feature
+                auto message = reader_.get_message();
+                read_feature(message);
                 break;
             }
-            case 3:
+            case 6:
             {
-                precision = std::pow(10,reader_.get_uint32());
+                // standalone Geometry
+                auto feature = feature_factory::create(ctx_,1);
+                auto message = reader_.get_message();
+                feature->set_geometry(std::move(read_geometry(message)));
+                callback_(feature);
                 break;
             }
+            default:
+                MAPNIK_LOG_DEBUG(geobuf) << "Unsupported tag=" << reader_.tag();
+                reader_.skip();
+                break;
+            }
+        }
+    }
+
+    // Reads keys, dimensions and precision only, features are decoded
+    // later on with read_feature(data, size).
+    void read_header()
+    {
+        while (reader_.next())
+        {
+            if (!read_header_field()) reader_.skip();
+        }
+    }
+
+    // Calls index_callback(box, offset, size) with the bounding box and
+    // location in the buffer of every feature, decoding geometries only.
+    // A standalone Feature or Geometry is located as the whole buffer.
+    template <typename IndexCallback>
+    void index(IndexCallback & index_callback)
+    {
+        while (reader_.next())
+        {
+            if (read_header_field()) continue;
+            switch (reader_.tag())
+            {
             case 4:
             {
                 auto feature_collection = reader_.get_message();
-                read_feature_collection(feature_collection);
+                while (feature_collection.next())
+                {
+                    if (feature_collection.tag() == 1)
+                    {
+                        auto view = feature_collection.get_view();
+                        protozero::pbf_reader message(view);
+                        index_callback(geometry::envelope(read_feature_geometry(message)),
+                                       static_cast<std::size_t>(view.data() - buf_), view.size());
+                    }
+                    else
+                    {
+                        feature_collection.skip();
+                    }
+                }
                 break;
             }
             case 5:
             {
-                // standalone Feature
                 auto message = reader_.get_message();
-                read_feature(message);
+                index_callback(geometry::envelope(read_feature_geometry(message)), 0, size_);
                 break;
             }
             case 6:
             {
-                // standalone Geometry
-                auto feature = feature_factory::create(ctx_,1);
                 auto message = reader_.get_message();
-                feature->set_geometry(std::move(read_geometry(message)));
-                callback_(feature);
+                index_callback(geometry::envelope(read_geometry(message)), 0, size_);
                 break;
             }
             default:
-                MAPNIK_LOG_DEBUG(geobuf) << "Unsupported tag=" << reader_.tag();
                 reader_.skip();
                 break;
             }
+            values_.clear();
         }
     }
 
+    // Decodes the Feature message at data, located by index()
+    void read_feature(char const* data, std::size_t size)
+    {
+        protozero::pbf_reader message(data, size);
+        read_feature(message);
+    }
+
 private:
 
+    bool read_header_field()
+    {
+        switch (reader_.tag())
+        {
+        case 1: // keys
+            keys_.push_back(reader_.get_string());
+            return true;
+        case 2:
+            dim = reader_.get_uint32();
+            return true;
+        case 3:
+            precision = std::pow(10,reader_.get_uint32());
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    template <typename T>
+    geometry::geometry<double> read_feature_geometry(T & reader)
+    {
+        geometry::geometry<double> geom = geometry::geometry_empty();
+        while (reader.next())
+        {
+            if (reader.tag() == 1)
+            {
+                auto message = reader.get_message();
+                geom = read_geometry(message);
+            }
+            else
+            {
+                reader.skip();
+            }
+        }
+        values_.clear();
+        return geom;
+    }
+
     double transform(std::int64_t input)
     {
         return (transformed) ? (static_cast<double>(input)) : (input/precision);
@@ -22,6 +22,7 @@
 
 #include "geobuf_datasource.hpp"
 #include "geobuf_featureset.hpp"
+#include "geobuf_index_featureset.hpp"
 #include "geobuf.hpp"
 
 #include <fstream>
@@ -45,6 +46,15 @@
 #include <mapnik/util/file_io.hpp>
 #include <mapnik/make_unique.hpp>
 #include <mapnik/geometry/boost_adapters.hpp>
+#include <mapnik/boolean.hpp>
+#include <mapnik/memory_report.hpp>
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#pragma GCC diagnostic pop
+#include <mapnik/mapped_memory_cache.hpp>
+#endif
 
 using mapnik::datasource;
 using mapnik::parameters;
@@ -108,6 +118,34 @@ geobuf_datasource::geobuf_datasource(parameters const& params)
     else
         filename_ = *file;
 
+    cache_features_ = *params.get<mapnik::boolean_type>("cache_features", true);
+    if (!cache_features_)
+    {
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+        boost::optional<mapnik::mapped_region_ptr> mapped_region =
+            mapnik::mapped_memory_cache::instance().find(filename_, true, mapnik::mapped_access::sequential);
+        if (!mapped_region)
+        {
+            throw mapnik::datasource_exception("Geobuf Plugin: could not get file mapping for '" + filename_ + "'");
+        }
+        buffer_ = static_cast<char const*>((*mapped_region)->get_address());
+        buffer_size_ = (*mapped_region)->get_size();
+        buffer_owner_ = *mapped_region;
+#else
+        mapnik::util::file in(filename_);
+        if (!in.is_open())
+        {
+            throw mapnik::datasource_exception("Geobuf Plugin: could not open: '" + filename_ + "'");
+        }
+        auto geobuf = std::make_shared<std::vector<char>>(in.size());
+        std::fread(geobuf->data(), in.size(), 1, in.get());
+        buffer_ = geobuf->data();
+        buffer_size_ = geobuf->size();
+        buffer_owner_ = geobuf;
+#endif
+        index_geobuf();
+        return;
+    }
 
     mapnik::util::file in(filename_);
     if (!in.is_open())
@@ -134,6 +172,29 @@ struct push_feature
     }
     features_container & features_;
 };
+
+template <typename T>
+struct push_record
+{
+    using values_container = T;
+    push_record(values_container & values, mapnik::box2d<double> & extent,
+                std::vector<std::pair<std::size_t, std::size_t>> & sample)
+        : values_(values),
+          extent_(extent),
+          sample_(sample) {}
+
+    void operator() (mapnik::box2d<double> const& box, std::size_t offset, std::size_t size)
+    {
+        if (!box.valid()) return;
+        if (values_.empty()) extent_ = box;
+        else extent_.expand_to_include(box);
+        values_.emplace_back(box, std::make_pair(offset, size));
+        if (sample_.size() < 5) sample_.emplace_back(offset, size);
+    }
+    values_container & values_;
+    mapnik::box2d<double> & extent_;
+    std::vector<std::pair<std::size_t, std::size_t>> & sample_;
+};
 }
 
 
@@ -175,6 +236,47 @@ void geobuf_datasource::parse_geobuf(char const* data, std::size_t size)
     tree_ = std::make_unique<spatial_index_type>(values);
 }
 
+void geobuf_datasource::index_geobuf()
+{
+    using values_container = std::vector< std::pair<box_type, std::pair<std::size_t, std::size_t>>>;
+    values_container values;
+    push_record<values_container> index_callback(values, extent_, sample_);
+    geobuf_feature_holder holder;
+    mapnik::util::geobuf<geobuf_feature_holder> buf(buffer_, buffer_size_, holder);
+    buf.index(index_callback);
+    if (!sample_.empty())
+    {
+        mapnik::feature_ptr feature = read_record(sample_.front());
+        if (feature)
+        {
+            for ( auto const& kv : *feature)
+            {
+                desc_.add_descriptor(mapnik::attribute_descriptor(std::get<0>(kv),
+                                                                  mapnik::util::apply_visitor(attr_value_converter(),
+                                                                                              std::get<1>(kv))));
+            }
+        }
+    }
+    // packing algorithm
+    tree_ = std::make_unique<spatial_index_type>(values);
+}
+
+mapnik::feature_ptr geobuf_datasource::read_record(std::pair<std::size_t, std::size_t> const& record) const
+{
+    geobuf_feature_holder holder;
+    mapnik::util::geobuf<geobuf_feature_holder> buf(buffer_, buffer_size_, holder);
+    if (record.first == 0 && record.second == buffer_size_)
+    {
+        buf.read();
+    }
+    else
+    {
+        buf.read_header();
+        buf.read_feature(buffer_ + record.first, record.second);
+    }
+    return holder.feature;
+}
+
 geobuf_datasource::~geobuf_datasource() {}
 
 const char * geobuf_datasource::name()
@@ -186,10 +288,12 @@ boost::optional<mapnik::datasource_geometry_t> geobuf_datasource::get_geometry_t
 {
     boost::optional<mapnik::datasource_geometry_t> result;
     int multi_type = 0;
-    unsigned num_features = features_.size();
+    unsigned num_features = cache_features_ ? features_.size() : sample_.size();
     for (unsigned i = 0; i < num_features && i < 5; ++i)
     {
-        result = mapnik::util::to_ds_type(features_[i]->get_geometry());
+        mapnik::feature_ptr feature = cache_features_ ? features_[i] : read_record(sample_[i]);
+        if (!feature) continue;
+        result = mapnik::util::to_ds_type(static_cast<mapnik::feature_impl const&>(*feature).get_geometry());
         if (result)
         {
             int type = static_cast<int>(*result);
@@ -219,6 +323,18 @@ mapnik::layer_descriptor geobuf_datasource::get_descriptor() const
     return desc_;
 }
 
+std::size_t geobuf_datasource::memory_usage() const
+{
+    std::size_t bytes = features_.capacity() * sizeof(mapnik::feature_ptr)
+        + sample_.capacity() * sizeof(sample_.front());
+    for (auto const& feature : features_)
+    {
+        bytes += mapnik::estimate_memory(*feature);
+    }
+    if (tree_) bytes += mapnik::estimate_tree_memory(*tree_);
+    return bytes;
+}
+
 mapnik::featureset_ptr geobuf_datasource::features(mapnik::query const& q) const
 {
     // if the query box intersects our world extent then query for features
@@ -229,6 +345,16 @@ mapnik::featureset_ptr geobuf_datasource::features(mapnik::query const& q) const
         if (tree_)
         {
             tree_->query(boost::geometry::index::intersects(box), std::back_inserter(index_array));
+            if (!cache_features_)
+            {
+                // decode in file order
+                std::sort(index_array.begin(), index_array.end(),
+                          [](item_type const& item0, item_type const& item1)
+                          {
+                              return item0.second.first < item1.second.first;
+                          });
+                return std::make_shared<geobuf_index_featureset>(buffer_, buffer_size_, buffer_owner_, std::move(index_array));
+            }
             return std::make_shared<geobuf_featureset>(features_, std::move(index_array));
         }
     }
@@ -89,15 +89,27 @@ public:
     mapnik::featureset_ptr features_at_point(mapnik::coord2d const& pt, double tol = 0) const;
     mapnik::box2d<double> envelope() const;
     mapnik::layer_descriptor get_descriptor() const;
+    std::size_t memory_usage() const;
     boost::optional<mapnik::datasource_geometry_t> get_geometry_type() const;
     void parse_geobuf(char const* buffer, std::size_t size);
+    void index_geobuf();
 private:
+    mapnik::feature_ptr read_record(std::pair<std::size_t, std::size_t> const& record) const;
+
     mapnik::datasource::datasource_t type_;
     mapnik::layer_descriptor desc_;
     std::string filename_;
     mapnik::box2d<double> extent_;
     std::vector<mapnik::feature_ptr> features_;
     std::unique_ptr<spatial_index_type> tree_;
+    bool cache_features_ = true;
+    // with cache_features=false features are decoded from the file
+    // buffer on demand, the tree holds their offsets and sizes
+    std::shared_ptr<void const> buffer_owner_;
+    char const* buffer_ = nullptr;
+    std::size_t buffer_size_ = 0;
+    // first few records, for the descriptor and geometry type
+    std::vector<std::pair<std::size_t, std::size_t>> sample_;
 };
 
 
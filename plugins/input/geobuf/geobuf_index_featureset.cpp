@@ -0,0 +1,71 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/feature.hpp>
+// stl
+#include <string>
+#include <deque>
+
+#include "geobuf_index_featureset.hpp"
+
+geobuf_index_featureset::geobuf_index_featureset(char const* buffer, std::size_t size,
+                                                 std::shared_ptr<void const> const& owner,
+                                                 array_type && index_array)
+    : owner_(owner),
+      buffer_(buffer),
+      size_(size),
+      holder_(),
+      geobuf_(buffer, size, holder_),
+      header_read_(false),
+      index_array_(std::move(index_array)),
+      index_itr_(index_array_.begin()),
+      index_end_(index_array_.end()) {}
+
+geobuf_index_featureset::~geobuf_index_featureset() {}
+
+mapnik::feature_ptr geobuf_index_featureset::next()
+{
+    while (index_itr_ != index_end_)
+    {
+        geobuf_datasource::item_type const& item = *index_itr_++;
+        std::size_t offset = item.second.first;
+        std::size_t size = item.second.second;
+        holder_.feature.reset();
+        if (offset == 0 && size == size_)
+        {
+            // standalone Feature or Geometry
+            geobuf_.read();
+        }
+        else if (offset + size <= size_)
+        {
+            if (!header_read_)
+            {
+                geobuf_.read_header();
+                header_read_ = true;
+            }
+            geobuf_.read_feature(buffer_ + offset, size);
+        }
+        if (holder_.feature) return holder_.feature;
+    }
+    return mapnik::feature_ptr();
+}
@@ -0,0 +1,67 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef GEOBUF_INDEX_FEATURESET_HPP
+#define GEOBUF_INDEX_FEATURESET_HPP
+
+#include <mapnik/feature.hpp>
+#include "geobuf_datasource.hpp"
+#include "geobuf.hpp"
+
+#include <memory>
+#include <deque>
+
+// keeps the last feature decoded by mapnik::util::geobuf
+struct geobuf_feature_holder
+{
+    void operator() (mapnik::feature_ptr const& f)
+    {
+        feature = f;
+    }
+    mapnik::feature_ptr feature;
+};
+
+// Decodes features straight from the geobuf buffer, the index array
+// holds their offsets and sizes.
+class geobuf_index_featureset : public mapnik::Featureset
+{
+public:
+    typedef std::deque<geobuf_datasource::item_type> array_type;
+    geobuf_index_featureset(char const* buffer, std::size_t size,
+                            std::shared_ptr<void const> const& owner,
+                            array_type && index_array);
+    virtual ~geobuf_index_featureset();
+    mapnik::feature_ptr next();
+
+private:
+    std::shared_ptr<void const> owner_;
+    char const* buffer_;
+    std::size_t size_;
+    geobuf_feature_holder holder_;
+    mapnik::util::geobuf<geobuf_feature_holder> geobuf_;
+    bool header_read_;
+    const array_type index_array_;
+    array_type::const_iterator index_itr_;
+    array_type::const_iterator index_end_;
+};
+
+#endif // GEOBUF_INDEX_FEATURESET_HPP
@@ -24,6 +24,7 @@
 #include "geojson_featureset.hpp"
 #include "geojson_index_featureset.hpp"
 #include "geojson_memory_index_featureset.hpp"
+#include "geojson_stream_featureset.hpp"
 #include <fstream>
 #include <algorithm>
 
@@ -51,9 +52,12 @@
 #include <mapnik/geometry/boost_adapters.hpp>
 #include <mapnik/util/fs.hpp>
 #include <mapnik/util/spatial_index.hpp>
+#include <mapnik/util/feature_store.hpp>
 #include <mapnik/geom_util.hpp>
 #include <mapnik/json/parse_feature.hpp>
 #include <mapnik/json/extract_bounding_boxes_x3.hpp>
+#include <mapnik/executor.hpp>
+#include <mapnik/memory_report.hpp>
 
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
 #pragma GCC diagnostic push
@@ -61,6 +65,7 @@
 #include <boost/interprocess/mapped_region.hpp>
 #pragma GCC diagnostic pop
 #include <mapnik/mapped_memory_cache.hpp>
+#include <mapnik/trace.hpp>
 #endif
 
 using mapnik::datasource;
@@ -116,9 +121,13 @@ geojson_datasource::geojson_datasource(parameters const& params)
       extent_(),
       features_(),
       tree_(nullptr),
-      num_features_to_query_(std::max(mapnik::value_integer(1), *params.get<mapnik::value_integer>("num_features_to_query", 5)))
+      store_(),
+      num_features_to_query_(std::max(mapnik::value_integer(1), *params.get<mapnik::value_integer>("num_features_to_query", 5))),
+      parse_threads_(std::max(mapnik::value_integer(1), *params.get<mapnik::value_integer>("parse_threads", 1)))
 {
     boost::optional<std::string> inline_string = params.get<std::string>("inline");
+    stream_ = *params.get<mapnik::boolean_type>("stream", false);
+    bool has_feature_store = false;
     if (!inline_string)
     {
         boost::optional<std::string> file = params.get<std::string>("file");
@@ -129,20 +138,37 @@ geojson_datasource::geojson_datasource(parameters const& params)
             filename_ = *base + "/" + *file;
         else
             filename_ = *file;
-        has_disk_index_ = mapnik::util::exists(filename_ + ".index");
+        has_feature_store = mapnik::util::exists(filename_ + ".features");
+        has_disk_index_ = !has_feature_store && mapnik::util::exists(filename_ + ".index");
     }
 
     if (inline_string)
     {
         from_inline_string_ = true;
-        char const* start = inline_string->c_str();
-        char const* end = start + inline_string->size();
-        parse_geojson(start, end);
+        if (stream_)
+        {
+            inline_data_ = std::make_shared<std::string const>(std::move(*inline_string));
+            initialise_stream();
+        }
+        else
+        {
+            char const* start = inline_string->c_str();
+            char const* end = start + inline_string->size();
+            parse_geojson(start, end);
+        }
+    }
+    else if (has_feature_store)
+    {
+        initialise_feature_store(filename_ + ".features");
     }
     else if (has_disk_index_)
     {
         initialise_disk_index(filename_);
     }
+    else if (stream_)
+    {
+        initialise_stream();
+    }
     else
     {
         cache_features_ = *params.get<mapnik::boolean_type>("cache_features", true);
@@ -160,7 +186,7 @@ geojson_datasource::geojson_datasource(parameters const& params)
         char const* end = (count == 1) ? start + file_buffer.length() : start;
 #else
         boost::optional<mapnik::mapped_region_ptr> mapped_region =
-            mapnik::mapped_memory_cache::instance().find(filename_, false);
+            mapnik::mapped_memory_cache::instance().find(filename_, false, mapnik::mapped_access::sequential);
         if (!mapped_region)
         {
             throw std::runtime_error("could not get file mapping for "+ filename_);
@@ -172,6 +198,10 @@ geojson_datasource::geojson_datasource(parameters const& params)
         if (cache_features_)
         {
             parse_geojson(start, end);
+            if (*params.get<mapnik::boolean_type>("feature_store", false))
+            {
+                write_feature_store(filename_ + ".features");
+            }
         }
         else
         {
@@ -186,6 +216,7 @@ using box_type = box2d<double>;
 using boxes_type = std::vector<std::pair<box_type, std::pair<std::uint64_t, std::uint64_t>>>;
 using base_iterator_type = char const*;
 const mapnik::transcoder geojson_datasource_static_tr("utf8");
+const std::size_t min_features_per_thread = 1024;
 
 }
 
@@ -245,6 +276,79 @@ void geojson_datasource::initialise_disk_index(std::string const& filename)
     desc_.order_by_name();
 }
 
+void geojson_datasource::initialise_feature_store(std::string const& filename)
+{
+    try
+    {
+        store_ = mapnik::util::open_feature_store(filename);
+    }
+    catch (std::exception const& ex)
+    {
+        throw mapnik::datasource_exception("GeoJSON Plugin: " + std::string(ex.what()));
+    }
+    extent_ = store_->extent();
+    std::vector<mapnik::util::index_record> records;
+    store_->first(num_features_to_query_, records);
+    mapnik::context_ptr ctx = store_->make_context();
+    for (auto const& rec : records)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, -1));
+        store_->read(rec, *feature, geojson_datasource_static_tr);
+        initialise_descriptor(feature);
+    }
+    desc_.order_by_name();
+}
+
+void geojson_datasource::initialise_stream()
+{
+    // one pass over the source for the extent and the attributes schema,
+    // queries read it again; nothing but the current feature is kept
+    std::size_t feature_count = 0;
+    try
+    {
+        geojson_stream_featureset features(filename_, inline_data_, mapnik::box2d<double>());
+        for (mapnik::feature_ptr feature = features.next(); feature; feature = features.next())
+        {
+            mapnik::box2d<double> box = feature->envelope();
+            if (!extent_.valid()) extent_ = box;
+            else extent_.expand_to_include(box);
+            if (feature_count++ < num_features_to_query_)
+            {
+                initialise_descriptor(feature);
+            }
+        }
+    }
+    catch (std::exception const& ex)
+    {
+        if (from_inline_string_) throw mapnik::datasource_exception("geojson_datasource: Failed to stream GeoJSON from in-memory string: "
+                                                                    + std::string(ex.what()));
+        else throw mapnik::datasource_exception("geojson_datasource: Failed to stream GeoJSON file '" + filename_ + "': "
+                                                + std::string(ex.what()));
+    }
+    if (feature_count == 0)
+    {
+        if (from_inline_string_) throw mapnik::datasource_exception("geojson_datasource: no features in in-memory string");
+        else throw mapnik::datasource_exception("geojson_datasource: no features in GeoJSON file '" + filename_ + "'");
+    }
+    desc_.order_by_name();
+}
+
+void geojson_datasource::write_feature_store(std::string const& filename) const
+{
+    try
+    {
+        mapnik::util::write_feature_store(filename, [this](mapnik::util::feature_store_writer & writer)
+                                          {
+                                              for (auto const& feature : features_) writer.add(*feature);
+                                          });
+    }
+    catch (std::exception const& ex)
+    {
+        // the source has been loaded, carry on without the cache
+        MAPNIK_LOG_ERROR(geojson) << "geojson_datasource: could not write '" << filename << "': " << ex.what();
+    }
+}
+
 namespace mapnik { namespace json {
 
 template <typename Iterator>
@@ -367,18 +471,43 @@ void geojson_datasource::parse_geojson(Iterator start, Iterator end)
         boxes_type boxes;
         mapnik::json::extract_bounding_boxes(itr, end, boxes);
         if (itr != end || boxes.empty()) throw std::exception(); //ensure we've consumed all input and we extracted at least one bbox;
-        for (auto const& item : boxes)
+        features_.resize(boxes.size());
+        auto parse_range = [&](std::size_t first, std::size_t last,
+                               mapnik::context_ptr const& context, mapnik::transcoder const& tr)
         {
-            auto const& geometry_index = std::get<1>(item);
-            Iterator itr2 = start + geometry_index.first;
-            Iterator end2 = itr2 + geometry_index.second;
-            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, start_id++));
-            mapnik::json::parse_feature(itr2, end2, *feature, geojson_datasource_static_tr);
-            features_.push_back(std::move(feature));
-        }
+            for (std::size_t i = first; i < last; ++i)
+            {
+                auto const& geometry_index = std::get<1>(boxes[i]);
+                Iterator itr2 = start + geometry_index.first;
+                Iterator end2 = itr2 + geometry_index.second;
+                mapnik::feature_ptr feature(mapnik::feature_factory::create(context, start_id + i));
+                mapnik::json::parse_feature(itr2, end2, *feature, tr);
+                features_[i] = std::move(feature);
+            }
+        };
+        // features are delimited by the bounding box pass, each chunk is
+        // parsed with its own context and transcoder, neither of which can
+        // be shared between threads; the first one uses the datasource's
+        std::size_t num_chunks = std::max(std::size_t(1),
+                                          std::min(parse_threads_, boxes.size() / min_features_per_thread));
+        std::size_t chunk = (boxes.size() + num_chunks - 1) / num_chunks;
+        mapnik::parallel_for(num_chunks, num_chunks, [&](std::size_t i)
+        {
+            std::size_t first = std::min(i * chunk, boxes.size());
+            std::size_t last = std::min(first + chunk, boxes.size());
+            if (i == 0)
+            {
+                parse_range(first, last, ctx, geojson_datasource_static_tr);
+                return;
+            }
+            mapnik::context_ptr context = std::make_shared<mapnik::context_type>();
+            mapnik::transcoder tr("utf8");
+            parse_range(first, last, context, tr);
+        });
     }
     catch (...)
     {
+        features_.clear();
         itr = start;
         // try parsing as single Feature or single Geometry JSON
         mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, start_id)); // single feature
@@ -446,11 +575,64 @@ mapnik::layer_descriptor geojson_datasource::get_descriptor() const
     return desc_;
 }
 
+std::size_t geojson_datasource::memory_usage() const
+{
+    std::size_t bytes = features_.capacity() * sizeof(mapnik::feature_ptr);
+    for (auto const& feature : features_)
+    {
+        bytes += mapnik::estimate_memory(*feature);
+    }
+    if (tree_) bytes += mapnik::estimate_tree_memory(*tree_);
+    if (inline_data_) bytes += inline_data_->capacity();
+    return bytes;
+}
+
 boost::optional<mapnik::datasource_geometry_t> geojson_datasource::get_geometry_type() const
 {
     boost::optional<mapnik::datasource_geometry_t> result;
     int multi_type = 0;
-    if (has_disk_index_)
+    if (stream_)
+    {
+        geojson_stream_featureset features(filename_, inline_data_, mapnik::box2d<double>());
+        mapnik::feature_ptr feature = features.next();
+        for (std::size_t count = 0; feature && count < num_features_to_query_; ++count, feature = features.next())
+        {
+            result = mapnik::util::to_ds_type(static_cast<mapnik::feature_impl const&>(*feature).get_geometry());
+            if (result)
+            {
+                int type = static_cast<int>(*result);
+                if (multi_type > 0 && multi_type != type)
+                {
+                    result.reset(mapnik::datasource_geometry_t::Collection);
+                    return result;
+                }
+                multi_type = type;
+            }
+        }
+    }
+    else if (store_)
+    {
+        std::vector<mapnik::util::index_record> records;
+        store_->first(num_features_to_query_, records);
+        mapnik::context_ptr ctx = store_->make_context();
+        for (auto const& rec : records)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, -1)); // temp feature
+            store_->read(rec, *feature, geojson_datasource_static_tr);
+            result = mapnik::util::to_ds_type(static_cast<mapnik::feature_impl const&>(*feature).get_geometry());
+            if (result)
+            {
+                int type = static_cast<int>(*result);
+                if (multi_type > 0 && multi_type != type)
+                {
+                    result.reset(mapnik::datasource_geometry_t::Collection);
+                    return result;
+                }
+                multi_type = type;
+            }
+        }
+    }
+    else if (has_disk_index_)
     {
         using value_type = mapnik::util::index_record;
         std::ifstream index(filename_ + ".index", std::ios::binary);
@@ -483,7 +665,7 @@ boost::optional<mapnik::datasource_geometry_t> geojson_datasource::get_geometry_
             {
                 throw std::runtime_error("Failed to parse geojson feature");
             }
-            result = mapnik::util::to_ds_type(feature->get_geometry());
+            result = mapnik::util::to_ds_type(static_cast<mapnik::feature_impl const&>(*feature).get_geometry());
             if (result)
             {
                 int type = static_cast<int>(*result);
@@ -501,7 +683,7 @@ boost::optional<mapnik::datasource_geometry_t> geojson_datasource::get_geometry_
         std::size_t num_features = features_.size();
         for (std::size_t i = 0; i < num_features && i < num_features_to_query_; ++i)
         {
-            result = mapnik::util::to_ds_type(features_[i]->get_geometry());
+            result = mapnik::util::to_ds_type(static_cast<mapnik::feature_impl const&>(*features_[i]).get_geometry());
             if (result)
             {
                 int type = static_cast<int>(*result);
@@ -548,7 +730,7 @@ boost::optional<mapnik::datasource_geometry_t> geojson_datasource::get_geometry_
                 throw std::runtime_error("Failed to parse geojson feature");
             }
 
-            result = mapnik::util::to_ds_type(feature->get_geometry());
+            result = mapnik::util::to_ds_type(static_cast<mapnik::feature_impl const&>(*feature).get_geometry());
             if (result)
             {
                 int type = static_cast<int>(*result);
@@ -566,10 +748,16 @@ boost::optional<mapnik::datasource_geometry_t> geojson_datasource::get_geometry_
 
 mapnik::featureset_ptr geojson_datasource::features(mapnik::query const& q) const
 {
+    mapnik::trace::scope query_trace("datasource", "geojson.features");
     // if the query box intersects our world extent then query for features
     mapnik::box2d<double> const& box = q.get_bbox();
     if (extent_.intersects(box))
     {
+        if (stream_)
+        {
+            return std::make_shared<geojson_stream_featureset>(filename_, inline_data_, box,
+                                                               q.property_names(), q.feature_arena());
+        }
         geojson_featureset::array_type index_array;
         if (tree_)
         {
@@ -586,20 +774,34 @@ mapnik::featureset_ptr geojson_datasource::features(mapnik::query const& q) cons
             }
             else
             {
-                return std::make_shared<geojson_memory_index_featureset>(filename_, std::move(index_array));
+                return std::make_shared<geojson_memory_index_featureset>(filename_, std::move(index_array),
+                                                                         q.property_names(), q.feature_arena());
             }
         }
+        else if (store_)
+        {
+            return std::make_shared<mapnik::util::feature_store_featureset>(store_, box, q.feature_arena());
+        }
         else if (has_disk_index_)
         {
             auto const& bbox = q.get_bbox();
             mapnik::bounding_box_filter<float> const filter(mapnik::box2d<float>(bbox.minx(), bbox.miny(), bbox.maxx(), bbox.maxy()));
-            return std::make_shared<geojson_index_featureset>(filename_, filter);
+            return std::make_shared<geojson_index_featureset>(filename_, filter, q.property_names(), q.feature_arena());
         }
     }
     // otherwise return an empty featureset
     return mapnik::make_invalid_featureset();
 }
 
+boost::optional<std::size_t> geojson_datasource::estimate_features(mapnik::query const& q) const
+{
+    mapnik::box2d<double> const& box = q.get_bbox();
+    if (!extent_.intersects(box)) return std::size_t(0);
+    if (!tree_) return boost::none;
+    return static_cast<std::size_t>(std::distance(tree_->qbegin(boost::geometry::index::intersects(box)),
+                                                  tree_->qend()));
+}
+
 mapnik::featureset_ptr geojson_datasource::features_at_point(mapnik::coord2d const& pt, double tol) const
 {
     mapnik::box2d<double> query_bbox(pt, pt);
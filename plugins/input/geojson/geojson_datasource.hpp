@@ -71,6 +71,8 @@ struct options_type<geojson_linear<Max,Min> >
 
 }}}}}
 
+namespace mapnik { namespace util { class feature_store; }}
+
 class geojson_datasource : public mapnik::datasource
 {
 public:
@@ -84,16 +86,21 @@ public:
     static const char * name();
     mapnik::featureset_ptr features(mapnik::query const& q) const;
     mapnik::featureset_ptr features_at_point(mapnik::coord2d const& pt, double tol = 0) const;
+    boost::optional<std::size_t> estimate_features(mapnik::query const& q) const;
     mapnik::box2d<double> envelope() const;
     mapnik::layer_descriptor get_descriptor() const;
+    std::size_t memory_usage() const;
     boost::optional<mapnik::datasource_geometry_t> get_geometry_type() const;
     template <typename Iterator>
     void parse_geojson(Iterator start, Iterator end);
     template <typename Iterator>
     void initialise_index(Iterator start, Iterator end);
     void initialise_disk_index(std::string const& filename);
+    void initialise_feature_store(std::string const& filename);
+    void initialise_stream();
 private:
     void initialise_descriptor(mapnik::feature_ptr const&);
+    void write_feature_store(std::string const& filename) const;
     mapnik::datasource::datasource_t type_;
     mapnik::layer_descriptor desc_;
     std::string filename_;
@@ -101,9 +108,16 @@ private:
     mapnik::box2d<double> extent_;
     std::vector<mapnik::feature_ptr> features_;
     std::unique_ptr<spatial_index_type> tree_;
+    // <file>.features, queried in place
+    std::shared_ptr<mapnik::util::feature_store const> store_;
     bool cache_features_ = true;
     bool has_disk_index_ = false;
+    // features are read through a geojson_stream_reader on every query
+    bool stream_ = false;
+    std::shared_ptr<std::string const> inline_data_;
     const std::size_t num_features_to_query_;
+    // threads used to parse cached features
+    const std::size_t parse_threads_;
 };
 
 #endif // GEOJSON_DATASOURCE_HPP
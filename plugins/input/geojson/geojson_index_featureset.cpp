@@ -35,21 +35,21 @@
 #include <fstream>
 #include <algorithm>
 
-geojson_index_featureset::geojson_index_featureset(std::string const& filename, mapnik::bounding_box_filter<float> const& filter)
+geojson_index_featureset::geojson_index_featureset(std::string const& filename, mapnik::bounding_box_filter<float> const& filter,
+                                                   std::set<std::string> const& names,
+                                                   bool feature_arena)
     :
-#if defined(MAPNIK_MEMORY_MAPPED_FILE)
-    //
-#elif defined _WINDOWS
-    file_(_wfopen(mapnik::utf8_to_utf16(filename).c_str(), L"rb"), std::fclose),
-#else
-    file_(std::fopen(filename.c_str(),"rb"), std::fclose),
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE)
+    reader_(filename),
 #endif
-    ctx_(std::make_shared<mapnik::context_type>())
+    ctx_(std::make_shared<mapnik::context_type>()),
+    arena_(feature_arena ? std::make_shared<mapnik::feature_arena>() : nullptr),
+    names_(names)
 {
 
 #if defined (MAPNIK_MEMORY_MAPPED_FILE)
     boost::optional<mapnik::mapped_region_ptr> memory =
-        mapnik::mapped_memory_cache::instance().find(filename, true);
+        mapnik::mapped_memory_cache::instance().find(filename, true, mapnik::mapped_access::random);
     if (memory)
     {
         mapped_region_ = *memory;
@@ -59,15 +59,28 @@ geojson_index_featureset::geojson_index_featureset(std::string const& filename,
         throw std::runtime_error("could not create file mapping for " + filename);
     }
 #else
-    if (!file_) throw std::runtime_error("Can't open " + filename);
+    if (!reader_.is_open()) throw std::runtime_error("Can't open " + filename);
 #endif
     std::string indexname = filename + ".index";
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    // packed indexes are queried in place
+    boost::optional<mapnik::mapped_region_ptr> index_memory =
+        mapnik::mapped_memory_cache::instance().find(indexname, true, mapnik::mapped_access::will_need);
+    if (!index_memory) throw mapnik::datasource_exception("GeoJSON Plugin: can't open index file " + indexname);
+    boost::interprocess::ibufferstream index(static_cast<char const*>((*index_memory)->get_address()),
+                                             (*index_memory)->get_size());
+    mapnik::util::spatial_index<value_type,
+                                mapnik::bounding_box_filter<float>,
+                                boost::interprocess::ibufferstream,
+                                mapnik::box2d<float>>::query(filter, index, positions_);
+#else
     std::ifstream index(indexname.c_str(), std::ios::binary);
     if (!index) throw mapnik::datasource_exception("GeoJSON Plugin: can't open index file " + indexname);
     mapnik::util::spatial_index<value_type,
                                 mapnik::bounding_box_filter<float>,
                                 std::ifstream,
                                 mapnik::box2d<float>>::query(filter, index, positions_);
+#endif
 
     positions_.erase(std::remove_if(positions_.begin(),
                                     positions_.end(),
@@ -86,22 +99,21 @@ mapnik::feature_ptr geojson_index_featureset::next()
 {
     while( itr_ != positions_.end())
     {
-        auto pos = *itr_++;
+        auto current = itr_++;
+        auto const& pos = *current;
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
         char const* start = (char const*)mapped_region_->get_address() + pos.off;
         char const*  end = start + pos.size;
 #else
-        std::fseek(file_.get(), pos.off, SEEK_SET);
-        std::vector<char> record;
-        record.resize(pos.second);
-        auto count = std::fread(record.data(), pos.size, 1, file_.get());
-        auto const* start = record.data();
-        auto const*  end = (count == 1) ? start + record.size() : start;
+        char const* start = reader_.read(current, positions_.end());
+        char const* end = start ? start + pos.size : start;
 #endif
         static const mapnik::transcoder tr("utf8");
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, feature_id_++));
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, feature_id_++, arena_));
         using mapnik::json::grammar::iterator_type;
-        mapnik::json::parse_feature(start, end, *feature, tr); // throw on failure
+        // throw on failure
+        if (names_.empty()) mapnik::json::parse_feature(start, end, *feature, tr);
+        else mapnik::json::parse_feature(start, end, *feature, tr, names_);
         // skip empty geometries
         if (mapnik::geometry::is_empty(feature->get_geometry())) continue;
         return feature;
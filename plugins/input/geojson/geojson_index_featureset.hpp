@@ -25,8 +25,10 @@
 
 #include "geojson_datasource.hpp"
 #include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
 #include <mapnik/geom_util.hpp>
 #include <mapnik/util/spatial_index.hpp>
+#include <mapnik/async_file_reader.hpp>
 
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
 #pragma GCC diagnostic push
@@ -39,12 +41,17 @@
 
 #include <deque>
 #include <cstdio>
+#include <set>
+#include <string>
 
 class geojson_index_featureset : public mapnik::Featureset
 {
     using value_type = mapnik::util::index_record;
 public:
-    geojson_index_featureset(std::string const& filename, mapnik::bounding_box_filter<float> const& filter);
+    // properties not in names are skipped, all are read when it is empty
+    geojson_index_featureset(std::string const& filename, mapnik::bounding_box_filter<float> const& filter,
+                             std::set<std::string> const& names = std::set<std::string>(),
+                             bool feature_arena = false);
     virtual ~geojson_index_featureset();
     mapnik::feature_ptr next();
 
@@ -53,11 +60,13 @@ private:
     using file_source_type = boost::interprocess::ibufferstream;
     mapnik::mapped_region_ptr mapped_region_;
 #else
-    using file_ptr = std::unique_ptr<std::FILE, int (*)(std::FILE *)>;
-    file_ptr file_;
+    // reads the next block of records while the current one is parsed
+    mapnik::async_record_reader reader_;
 #endif
     mapnik::value_integer feature_id_ = 1;
     mapnik::context_ptr ctx_;
+    mapnik::feature_arena_ptr arena_;
+    std::set<std::string> names_;
     std::vector<value_type> positions_;
     std::vector<value_type>::iterator itr_;
 };
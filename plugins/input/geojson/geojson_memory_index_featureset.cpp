@@ -34,7 +34,9 @@
 #include <vector>
 
 geojson_memory_index_featureset::geojson_memory_index_featureset(std::string const& filename,
-                                                   array_type && index_array)
+                                                   array_type && index_array,
+                                                   std::set<std::string> const& names,
+                                                   bool feature_arena)
 :
 #ifdef _WINDOWS
     file_(_wfopen(mapnik::utf8_to_utf16(filename).c_str(), L"rb"), std::fclose),
@@ -44,7 +46,10 @@ geojson_memory_index_featureset::geojson_memory_index_featureset(std::string con
     index_array_(std::move(index_array)),
     index_itr_(index_array_.begin()),
     index_end_(index_array_.end()),
-    ctx_(std::make_shared<mapnik::context_type>())
+    ctx_(std::make_shared<mapnik::context_type>()),
+    arena_(feature_arena ? std::make_shared<mapnik::feature_arena>() : nullptr),
+    names_(names),
+    json_()
 {
     if (!file_) throw std::runtime_error("Can't open " + filename);
 }
@@ -59,15 +64,16 @@ mapnik::feature_ptr geojson_memory_index_featureset::next()
         std::size_t file_offset = item.second.first;
         std::size_t size = item.second.second;
         std::fseek(file_.get(), file_offset, SEEK_SET);
-        std::vector<char> json;
-        json.resize(size);
-        auto count = std::fread(json.data(), size, 1, file_.get());
+        json_.resize(size);
+        auto count = std::fread(json_.data(), size, 1, file_.get());
         using chr_iterator_type = char const*;
-        chr_iterator_type start = json.data();
-        chr_iterator_type end = (count == 1) ? start + json.size() : start;
+        chr_iterator_type start = json_.data();
+        chr_iterator_type end = (count == 1) ? start + json_.size() : start;
         static const mapnik::transcoder tr("utf8");
-        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, feature_id_++));
-        mapnik::json::parse_feature(start, end, *feature, tr); // throw on failure
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, feature_id_++, arena_));
+        // throw on failure
+        if (names_.empty()) mapnik::json::parse_feature(start, end, *feature, tr);
+        else mapnik::json::parse_feature(start, end, *feature, tr, names_);
         // skip empty geometries
         if (mapnik::geometry::is_empty(feature->get_geometry()))
             continue;
@@ -24,10 +24,14 @@
 #define GEOJSON_MEMORY_INDEX_FEATURESET_HPP
 
 #include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
 #include "geojson_datasource.hpp"
 
 #include <deque>
+#include <vector>
 #include <cstdio>
+#include <set>
+#include <string>
 
 class geojson_memory_index_featureset : public mapnik::Featureset
 {
@@ -35,8 +39,11 @@ public:
     using array_type = std::deque<geojson_datasource::item_type>;
     using file_ptr = std::unique_ptr<std::FILE, int (*)(std::FILE *)>;
 
+    // properties not in names are skipped, all are read when it is empty
     geojson_memory_index_featureset(std::string const& filename,
-                             array_type && index_array);
+                             array_type && index_array,
+                             std::set<std::string> const& names = std::set<std::string>(),
+                             bool feature_arena = false);
     virtual ~geojson_memory_index_featureset();
     mapnik::feature_ptr next();
 
@@ -47,6 +54,10 @@ private:
     array_type::const_iterator index_itr_;
     array_type::const_iterator index_end_;
     mapnik::context_ptr ctx_;
+    mapnik::feature_arena_ptr arena_;
+    std::set<std::string> names_;
+    // record buffer reused across features
+    std::vector<char> json_;
 };
 
 #endif // GEOJSON_MEMORY_INDEX_FEATURESET_HPP
@@ -0,0 +1,85 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include "geojson_stream_featureset.hpp"
+
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/make_unique.hpp>
+#include <mapnik/geometry/is_empty.hpp>
+#include <mapnik/json/parse_feature.hpp>
+
+// stl
+#include <stdexcept>
+#include <string>
+
+geojson_stream_featureset::geojson_stream_featureset(std::string const& filename,
+                                                     std::shared_ptr<std::string const> const& inline_data,
+                                                     mapnik::box2d<double> const& box,
+                                                     std::set<std::string> const& names,
+                                                     bool feature_arena)
+    : file_(),
+      inline_data_(inline_data),
+      reader_(),
+      box_(box),
+      ctx_(std::make_shared<mapnik::context_type>()),
+      arena_(feature_arena ? std::make_shared<mapnik::feature_arena>() : nullptr),
+      names_(names),
+      json_()
+{
+    if (inline_data_)
+    {
+        char const* start = inline_data_->data();
+        reader_ = std::make_unique<mapnik::json::geojson_stream_reader>(start, start + inline_data_->size());
+    }
+    else
+    {
+        file_ = std::make_unique<mapnik::util::file>(filename);
+        if (!*file_) throw std::runtime_error("Can't open " + filename);
+        reader_ = std::make_unique<mapnik::json::geojson_stream_reader>(file_->get());
+    }
+}
+
+geojson_stream_featureset::~geojson_stream_featureset() {}
+
+mapnik::feature_ptr geojson_stream_featureset::next()
+{
+    static const mapnik::transcoder tr("utf8");
+    while (reader_->next(json_))
+    {
+        char const* start = json_.data();
+        char const* end = start + json_.size();
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx_, feature_id_++, arena_));
+        // throw on failure
+        if (names_.empty()) mapnik::json::parse_feature(start, end, *feature, tr);
+        else mapnik::json::parse_feature(start, end, *feature, tr, names_);
+        // skip empty geometries
+        if (mapnik::geometry::is_empty(feature->get_geometry()))
+            continue;
+        if (box_.valid() && !box_.intersects(feature->envelope()))
+            continue;
+        return feature;
+    }
+    return mapnik::feature_ptr();
+}
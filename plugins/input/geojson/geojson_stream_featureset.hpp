@@ -0,0 +1,66 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef GEOJSON_STREAM_FEATURESET_HPP
+#define GEOJSON_STREAM_FEATURESET_HPP
+
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/util/file_io.hpp>
+#include <mapnik/json/geojson_stream_reader.hpp>
+
+#include <memory>
+#include <set>
+#include <string>
+
+// Reads the features of the source anew through a geojson_stream_reader,
+// keeping one feature in memory at a time
+class geojson_stream_featureset : public mapnik::Featureset
+{
+public:
+    // reads filename unless inline_data is set, an invalid box selects all
+    // features; properties not in names are skipped, all are read when it is empty
+    geojson_stream_featureset(std::string const& filename,
+                              std::shared_ptr<std::string const> const& inline_data,
+                              mapnik::box2d<double> const& box,
+                              std::set<std::string> const& names = std::set<std::string>(),
+                              bool feature_arena = false);
+    virtual ~geojson_stream_featureset();
+    mapnik::feature_ptr next();
+
+private:
+    std::unique_ptr<mapnik::util::file> file_;
+    std::shared_ptr<std::string const> inline_data_;
+    std::unique_ptr<mapnik::json::geojson_stream_reader> reader_;
+    mapnik::box2d<double> box_;
+    // counts every feature of the source, so ids do not depend on the box
+    mapnik::value_integer feature_id_ = 1;
+    mapnik::context_ptr ctx_;
+    mapnik::feature_arena_ptr arena_;
+    std::set<std::string> names_;
+    // feature text reused across features
+    std::string json_;
+};
+
+#endif // GEOJSON_STREAM_FEATURESET_HPP
@@ -41,8 +41,10 @@
 
 // stl
 #include <fstream>
+#include <set>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
 
 using mapnik::datasource;
 using mapnik::parameters;
@@ -61,6 +63,46 @@ using mapnik::filter_at_point;
 
 static std::once_flag once_flag;
 
+namespace {
+
+// Pushes the requested fields into the feature context and returns their
+// indices. OGR is told to ignore the other fields (and the style string)
+// so drivers like GeoPackage don't decode columns nobody reads.
+std::vector<int> select_fields(OGRLayer & layer,
+                               std::set<std::string> const& names,
+                               mapnik::context_ptr const& ctx)
+{
+    std::vector<int> fields;
+    std::vector<char const*> ignored;
+    OGRFeatureDefn* def = layer.GetLayerDefn();
+    const int fld_count = def->GetFieldCount();
+    for (int i = 0; i < fld_count; ++i)
+    {
+        char const* fld_name = def->GetFieldDefn(i)->GetNameRef();
+        if (names.count(fld_name) > 0)
+        {
+            ctx->push(fld_name);
+            fields.push_back(i);
+        }
+        else
+        {
+            ignored.push_back(fld_name);
+        }
+    }
+#if GDAL_VERSION_NUM >= 1800
+    // the list replaces the one set by a previous query
+    ignored.push_back("OGR_STYLE");
+    ignored.push_back(nullptr);
+    if (layer.SetIgnoredFields(ignored.data()) != OGRERR_NONE)
+    {
+        MAPNIK_LOG_DEBUG(ogr) << "ogr_datasource: driver does not support ignoring fields";
+    }
+#endif
+    return fields;
+}
+
+}
+
 extern "C" MAPNIK_EXP void on_plugin_load()
 {
     // initialize ogr formats
@@ -84,11 +126,36 @@ ogr_datasource::~ogr_datasource()
 {
     // free layer before destroying the datasource
     layer_.free_layer();
+    close_dataset(dataset_);
+}
+
+gdal_dataset_type ogr_datasource::open_dataset(std::string const& name, std::string const& driver)
+{
+    gdal_dataset_type dataset = nullptr;
+    if (! driver.empty())
+    {
 #if GDAL_VERSION_MAJOR >= 2
-    GDALClose(( GDALDatasetH) dataset_);
+        unsigned int nOpenFlags = GDAL_OF_READONLY | GDAL_OF_VECTOR;
+        const char* papszAllowedDrivers[] = { driver.c_str(), nullptr };
+        dataset = reinterpret_cast<gdal_dataset_type>(GDALOpenEx(name.c_str(),nOpenFlags,papszAllowedDrivers, nullptr, nullptr));
 #else
-    OGRDataSource::DestroyDataSource (dataset_);
+        OGRSFDriver * ogr_driver = OGRSFDriverRegistrar::GetRegistrar()->GetDriverByName(driver.c_str());
+        if (ogr_driver && ogr_driver != nullptr)
+        {
+            dataset = ogr_driver->Open((name).c_str(), false);
+        }
 #endif
+    }
+    else
+    {
+        // open ogr driver
+#if GDAL_VERSION_MAJOR >= 2
+        dataset = reinterpret_cast<gdal_dataset_type>(OGROpen(name.c_str(), false, nullptr));
+#else
+        dataset = OGRSFDriverRegistrar::Open(name.c_str(), false);
+#endif
+    }
+    return dataset;
 }
 
 void ogr_datasource::init(mapnik::parameters const& params)
@@ -123,30 +190,7 @@ void ogr_datasource::init(mapnik::parameters const& params)
     }
 
     std::string driver = *params.get<std::string>("driver","");
-
-    if (! driver.empty())
-    {
-#if GDAL_VERSION_MAJOR >= 2
-        unsigned int nOpenFlags = GDAL_OF_READONLY | GDAL_OF_VECTOR;
-        const char* papszAllowedDrivers[] = { driver.c_str(), nullptr };
-        dataset_ = reinterpret_cast<gdal_dataset_type>(GDALOpenEx(dataset_name_.c_str(),nOpenFlags,papszAllowedDrivers, nullptr, nullptr));
-#else
-        OGRSFDriver * ogr_driver = OGRSFDriverRegistrar::GetRegistrar()->GetDriverByName(driver.c_str());
-        if (ogr_driver && ogr_driver != nullptr)
-        {
-            dataset_ = ogr_driver->Open((dataset_name_).c_str(), false);
-        }
-#endif
-    }
-    else
-    {
-        // open ogr driver
-#if GDAL_VERSION_MAJOR >= 2
-        dataset_ = reinterpret_cast<gdal_dataset_type>(OGROpen(dataset_name_.c_str(), false, nullptr));
-#else
-        dataset_ = OGRSFDriverRegistrar::Open(dataset_name_.c_str(), false);
-#endif
-    }
+    dataset_ = open_dataset(dataset_name_, driver);
 
     if (! dataset_)
     {
@@ -205,6 +249,7 @@ void ogr_datasource::init(mapnik::parameters const& params)
 
         layer_.layer_by_sql(dataset_, *layer_by_sql);
         layer_name_ = layer_.layer_name();
+        layer_sql_ = *layer_by_sql;
     }
     else
     {
@@ -259,6 +304,25 @@ void ogr_datasource::init(mapnik::parameters const& params)
         throw datasource_exception(s.str());
     }
 
+    // featuresets read through handles of their own, reused across
+    // queries; the datasource's own handle is kept for introspection
+    unsigned threads = std::thread::hardware_concurrency();
+    mapnik::value_integer pool_size = *params.get<mapnik::value_integer>("pool_size", threads > 0 ? threads : 1);
+    std::string name = dataset_name_;
+    std::string layer_name = layer_name_;
+    std::string layer_sql = layer_sql_;
+    pool_ = std::make_shared<ogr_handle_pool>([name, driver, layer_name, layer_sql]() {
+            gdal_dataset_type dataset = open_dataset(name, driver);
+            if (! dataset)
+            {
+                throw datasource_exception("OGR Plugin: connection failed: " + name);
+            }
+            auto handle = std::make_unique<ogr_handle>(dataset);
+            if (layer_sql.empty()) handle->layer.layer_by_name(dataset, layer_name);
+            else handle->layer.layer_by_sql(dataset, layer_sql);
+            return handle;
+        }, pool_size > 0 ? static_cast<std::size_t>(pool_size) : 1);
+
     // work with real OGR layer
     OGRLayer* layer = layer_.layer();
 
@@ -486,6 +550,13 @@ layer_descriptor ogr_datasource::get_descriptor() const
     return desc_;
 }
 
+std::shared_ptr<OGRLayer> ogr_datasource::acquire_layer() const
+{
+    std::shared_ptr<ogr_handle> handle = pool_->acquire();
+    if (!handle || !handle->layer.is_valid()) return std::shared_ptr<OGRLayer>();
+    return std::shared_ptr<OGRLayer>(handle, handle->layer.layer());
+}
+
 void validate_attribute_names(query const& q, std::vector<attribute_descriptor> const& names )
 {
     std::set<std::string> const& attribute_names = q.property_names();
@@ -529,24 +600,21 @@ featureset_ptr ogr_datasource::features(query const& q) const
         // First we validate query fields: https://github.com/mapnik/mapnik/issues/792
 
         std::vector<attribute_descriptor> const& desc_ar = desc_.get_descriptors();
-        // feature context (schema)
-        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
-
-        for (auto const& attr_info : desc_ar)
-        {
-            ctx->push(attr_info.get_name()); // TODO only push query attributes
-        }
-
         validate_attribute_names(q, desc_ar);
 
-        OGRLayer* layer = layer_.layer();
+        std::shared_ptr<OGRLayer> layer = acquire_layer();
+        if (!layer) return mapnik::make_invalid_featureset();
+        // feature context (schema)
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        std::vector<int> fields = select_fields(*layer, q.property_names(), ctx);
 
         if (indexed_)
         {
             filter_in_box filter(q.get_bbox());
 
             return featureset_ptr(new ogr_index_featureset<filter_in_box>(ctx,
-                                                                          *layer,
+                                                                          layer,
+                                                                          fields,
                                                                           filter,
                                                                           index_name_,
                                                                           desc_.get_encoding()));
@@ -554,7 +622,8 @@ featureset_ptr ogr_datasource::features(query const& q) const
         else
         {
             return featureset_ptr(new ogr_featureset(ctx,
-                                                      *layer,
+                                                      layer,
+                                                      fields,
                                                       q.get_bbox(),
                                                       desc_.get_encoding()));
         }
@@ -571,23 +640,26 @@ featureset_ptr ogr_datasource::features_at_point(coord2d const& pt, double tol)
 
     if (dataset_ && layer_.is_valid())
     {
-        std::vector<attribute_descriptor> const& desc_ar = desc_.get_descriptors();
-        // feature context (schema)
-        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
-
-        for (auto const& attr_info : desc_ar)
+        // all attributes are returned when querying at a point
+        std::set<std::string> names;
+        for (auto const& attr_info : desc_.get_descriptors())
         {
-            ctx->push(attr_info.get_name()); // TODO only push query attributes
+            names.insert(attr_info.get_name());
         }
 
-        OGRLayer* layer = layer_.layer();
+        std::shared_ptr<OGRLayer> layer = acquire_layer();
+        if (!layer) return mapnik::make_invalid_featureset();
+        // feature context (schema)
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        std::vector<int> fields = select_fields(*layer, names, ctx);
 
         if (indexed_)
         {
             filter_at_point filter(pt, tol);
 
             return featureset_ptr(new ogr_index_featureset<filter_at_point> (ctx,
-                                                                             *layer,
+                                                                             layer,
+                                                                             fields,
                                                                              filter,
                                                                              index_name_,
                                                                              desc_.get_encoding()));
@@ -597,7 +669,8 @@ featureset_ptr ogr_datasource::features_at_point(coord2d const& pt, double tol)
             mapnik::box2d<double> bbox(pt, pt);
             bbox.pad(tol);
             return featureset_ptr(new ogr_featureset (ctx,
-                                                      *layer,
+                                                      layer,
+                                                      fields,
                                                       bbox,
                                                       desc_.get_encoding()));
         }
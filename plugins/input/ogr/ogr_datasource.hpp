@@ -31,6 +31,7 @@
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/coord.hpp>
 #include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/util/handle_pool.hpp>
 
 // boost
 #include <boost/optional.hpp>
@@ -46,6 +47,8 @@
 #pragma GCC diagnostic pop
 #include "ogr_layer_ptr.hpp"
 
+using ogr_handle_pool = mapnik::util::handle_pool<ogr_handle>;
+
 class ogr_datasource : public mapnik::datasource
 {
 public:
@@ -61,6 +64,8 @@ public:
 
 private:
     void init(mapnik::parameters const& params);
+    static gdal_dataset_type open_dataset(std::string const& name, std::string const& driver);
+    std::shared_ptr<OGRLayer> acquire_layer() const;
     mapnik::box2d<double> extent_;
     mapnik::datasource::datasource_t type_;
     std::string dataset_name_;
@@ -68,6 +73,8 @@ private:
     gdal_dataset_type dataset_;
     ogr_layer_ptr layer_;
     std::string layer_name_;
+    std::string layer_sql_;
+    std::shared_ptr<ogr_handle_pool> pool_;
     mapnik::layer_descriptor desc_;
     bool indexed_;
 };
@@ -46,12 +46,15 @@ using mapnik::feature_factory;
 
 
 ogr_featureset::ogr_featureset(mapnik::context_ptr const & ctx,
-                               OGRLayer & layer,
+                               std::shared_ptr<OGRLayer> const& layer,
+                               std::vector<int> const& fields,
                                OGRGeometry & extent,
                                std::string const& encoding)
     : ctx_(ctx),
-      layer_(layer),
-      layerdef_(layer.GetLayerDefn()),
+      layer_ptr_(layer),
+      layer_(*layer),
+      layerdef_(layer->GetLayerDefn()),
+      fields_(fields),
       tr_(new transcoder(encoding)),
       fidcolumn_(layer_.GetFIDColumn ()),
       count_(0)
@@ -61,12 +64,15 @@ ogr_featureset::ogr_featureset(mapnik::context_ptr const & ctx,
 }
 
 ogr_featureset::ogr_featureset(mapnik::context_ptr const& ctx,
-                               OGRLayer & layer,
+                               std::shared_ptr<OGRLayer> const& layer,
+                               std::vector<int> const& fields,
                                mapnik::box2d<double> const& extent,
                                std::string const& encoding)
     : ctx_(ctx),
-      layer_(layer),
-      layerdef_(layer.GetLayerDefn()),
+      layer_ptr_(layer),
+      layer_(*layer),
+      layerdef_(layer->GetLayerDefn()),
+      fields_(fields),
       tr_(new transcoder(encoding)),
       fidcolumn_(layer_.GetFIDColumn()), // TODO - unused
       count_(0)
@@ -115,8 +121,7 @@ feature_ptr ogr_featureset::next()
 
         ++count_;
 
-        int fld_count = layerdef_->GetFieldCount();
-        for (int i = 0; i < fld_count; i++)
+        for (int i : fields_)
         {
             OGRFieldDefn* fld = layerdef_->GetFieldDefn(i);
             const OGRFieldType type_oid = fld->GetType();
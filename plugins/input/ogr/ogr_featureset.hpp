@@ -29,6 +29,10 @@
 #include <mapnik/unicode.hpp>
 #include <mapnik/geom_util.hpp>
 
+// stl
+#include <memory>
+#include <vector>
+
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
 #include <ogrsf_frmts.h>
@@ -38,12 +42,14 @@ class ogr_featureset : public mapnik::Featureset
 {
 public:
     ogr_featureset(mapnik::context_ptr const& ctx,
-                   OGRLayer & layer,
+                   std::shared_ptr<OGRLayer> const& layer,
+                   std::vector<int> const& fields,
                    OGRGeometry & extent,
                    std::string const& encoding);
 
     ogr_featureset(mapnik::context_ptr const& ctx,
-                   OGRLayer & layer,
+                   std::shared_ptr<OGRLayer> const& layer,
+                   std::vector<int> const& fields,
                    mapnik::box2d<double> const& extent,
                    std::string const& encoding);
 
@@ -51,8 +57,12 @@ public:
     mapnik::feature_ptr next();
 private:
     mapnik::context_ptr ctx_;
+    // held for the featureset's lifetime, then handed back to the pool
+    std::shared_ptr<OGRLayer> layer_ptr_;
     OGRLayer& layer_;
     OGRFeatureDefn* layerdef_;
+    // indices of the fields converted into mapnik attributes
+    const std::vector<int> fields_;
     const std::unique_ptr<mapnik::transcoder> tr_;
     const char* fidcolumn_;
     mutable int count_;
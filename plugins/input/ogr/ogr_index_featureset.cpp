@@ -31,6 +31,7 @@
 #include <mapnik/unicode.hpp>
 #include <mapnik/feature_factory.hpp>
 #include <mapnik/geometry/correct.hpp>
+#include <mapnik/util/spatial_index.hpp>
 
 // boost
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
@@ -45,7 +46,6 @@
 // ogr
 #include "ogr_index_featureset.hpp"
 #include "ogr_converter.hpp"
-#include "ogr_index.hpp"
 
 #include <gdal_version.h>
 
@@ -58,13 +58,16 @@ using mapnik::feature_factory;
 
 template <typename filterT>
 ogr_index_featureset<filterT>::ogr_index_featureset(mapnik::context_ptr const & ctx,
-                                                    OGRLayer & layer,
+                                                    std::shared_ptr<OGRLayer> const& layer,
+                                                    std::vector<int> const& fields,
                                                     filterT const& filter,
                                                     std::string const& index_file,
                                                     std::string const& encoding)
     : ctx_(ctx),
-      layer_(layer),
-      layerdef_(layer.GetLayerDefn()),
+      layer_ptr_(layer),
+      layer_(*layer),
+      layerdef_(layer->GetLayerDefn()),
+      fields_(fields),
       filter_(filter),
       tr_(new transcoder(encoding)),
       fidcolumn_(layer_.GetFIDColumn()),
@@ -72,11 +75,11 @@ ogr_index_featureset<filterT>::ogr_index_featureset(mapnik::context_ptr const &
 {
 
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
-    boost::optional<mapnik::mapped_region_ptr> memory = mapnik::mapped_memory_cache::instance().find(index_file, true);
+    boost::optional<mapnik::mapped_region_ptr> memory = mapnik::mapped_memory_cache::instance().find(index_file, true, mapnik::mapped_access::will_need);
     if (memory)
     {
         boost::interprocess::ibufferstream file(static_cast<char*>((*memory)->get_address()),(*memory)->get_size());
-        ogr_index<filterT,boost::interprocess::ibufferstream >::query(filter,file,ids_);
+        mapnik::util::spatial_index<int, filterT, boost::interprocess::ibufferstream>::query(filter, file, ids_);
     }
 #else
   #if defined (WINDOWS)
@@ -84,7 +87,7 @@ ogr_index_featureset<filterT>::ogr_index_featureset(mapnik::context_ptr const &
   #else
       std::ifstream file(index_file.c_str(), std::ios::in | std::ios::binary);
   #endif
-      ogr_index<filterT,std::ifstream>::query(filter,file,ids_);
+      mapnik::util::spatial_index<int, filterT, std::ifstream>::query(filter, file, ids_);
 #endif
 
     std::sort(ids_.begin(),ids_.end());
@@ -137,8 +140,7 @@ feature_ptr ogr_index_featureset<filterT>::next()
             continue;
         }
 
-        int fld_count = layerdef_->GetFieldCount();
-        for (int i = 0; i < fld_count; i++)
+        for (int i : fields_)
         {
             OGRFieldDefn* fld = layerdef_->GetFieldDefn (i);
             OGRFieldType type_oid = fld->GetType ();
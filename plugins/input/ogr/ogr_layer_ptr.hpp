@@ -193,4 +193,32 @@ private:
     bool is_valid_;
 };
 
+inline void close_dataset(gdal_dataset_type dataset)
+{
+#if GDAL_VERSION_MAJOR >= 2
+    GDALClose(( GDALDatasetH) dataset);
+#else
+    OGRDataSource::DestroyDataSource (dataset);
+#endif
+}
+
+// a dataset with its layer selected; layers keep a read cursor and a
+// spatial filter, so every featureset reads through one of its own
+struct ogr_handle
+{
+    explicit ogr_handle(gdal_dataset_type dataset_)
+        : dataset(dataset_),
+          layer() {}
+
+    ~ogr_handle()
+    {
+        // free layer before destroying the datasource
+        layer.free_layer();
+        close_dataset(dataset);
+    }
+
+    gdal_dataset_type dataset;
+    ogr_layer_ptr layer;
+};
+
 #endif // OGR_LAYER_PTR_HPP
@@ -33,6 +33,7 @@
 #include <mapnik/debug.hpp>
 #include <mapnik/global.hpp> // for byte
 #include <mapnik/boolean.hpp>
+#include <mapnik/datasource_metadata_cache.hpp>
 #include <mapnik/sql_utils.hpp>
 #include <mapnik/util/conversions.hpp>
 #include <mapnik/timer.hpp>
@@ -76,6 +77,7 @@ pgraster_datasource::pgraster_datasource(parameters const& params)
       band_(*params.get<value_integer>("band", 0)),
       extent_initialized_(false),
       prescale_rasters_(*params.get<mapnik::boolean_type>("prescale_rasters", false)),
+      prescale_algorithm_(*params.get<std::string>("prescale_algorithm", "NearestNeighbour")),
       use_overviews_(*params.get<mapnik::boolean_type>("use_overviews", false)),
       clip_rasters_(*params.get<mapnik::boolean_type>("clip_rasters", false)),
       desc_(*params.get<std::string>("type"), "utf-8"),
@@ -110,6 +112,14 @@ pgraster_datasource::pgraster_datasource(parameters const& params)
         extent_initialized_ = extent_.from_string(*ext);
     }
 
+    if (prescale_algorithm_ != "NearestNeighbour" && prescale_algorithm_ != "NearestNeighbor" &&
+        prescale_algorithm_ != "Bilinear" && prescale_algorithm_ != "Cubic" &&
+        prescale_algorithm_ != "CubicSpline" && prescale_algorithm_ != "Lanczos")
+    {
+        throw mapnik::datasource_exception("Pgraster Plugin: unknown prescale_algorithm '" +
+                                           prescale_algorithm_ + "'");
+    }
+
     // NOTE: In multithread environment, pool_max_size_ should be
     // max_async_connections_ * num_threads
     if(max_async_connections_ > 1)
@@ -130,6 +140,8 @@ pgraster_datasource::pgraster_datasource(parameters const& params)
     ConnectionManager::instance().registerPool(creator_, *initial_size, pool_max_size_);
     CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
     if (!pool) return;
+    // pools are created empty, open the initial_size connections
+    pool->warm_up();
 
     shared_ptr<Connection> conn = pool->borrowObject();
     if (!conn) return;
@@ -172,69 +184,128 @@ pgraster_datasource::pgraster_datasource(parameters const& params)
                 (raster_table_, parsed_schema_, parsed_table_);
         }
 
-        // If we do not know either the geometry_field or the srid or we
-        // want to use overviews but do not know about schema, or
-        // no extent was specified, then attempt to fetch the missing
-        // information from a raster_columns entry.
-        //
-        // This will return no records if we are querying a bogus table returned
-        // from the simplistic table parsing in table_from_sql() or if
-        // the table parameter references a table, view, or subselect not
-        // registered in the geometry columns.
-        //
-        geometryColumn_ = mapnik::sql_utils::unquote_copy('"', raster_field_);
-        if (!parsed_table_.empty() && (
-              geometryColumn_.empty() || srid_ == 0 ||
-              (parsed_schema_.empty() && use_overviews_) ||
-              ! extent_initialized_
-           ))
+        auto & metadata_cache = mapnik::datasource_metadata_cache::instance();
+        std::string metadata_key = mapnik::datasource_metadata_cache::make_key(params);
+        std::string metadata_stamp;
+        if (metadata_cache.enabled())
+        {
+            metadata_stamp = relation_stamp(*conn, parsed_schema_, parsed_table_);
+        }
+        boost::optional<mapnik::datasource_metadata> metadata =
+            metadata_cache.find(metadata_key, metadata_stamp);
+        if (metadata)
+        {
+            // learned by an earlier datasource with the same parameters,
+            // about the relation as it still is
+            apply_metadata(*metadata);
+        }
+        else
         {
+            // If we do not know either the geometry_field or the srid or we
+            // want to use overviews but do not know about schema, or
+            // no extent was specified, then attempt to fetch the missing
+            // information from a raster_columns entry.
+            //
+            // This will return no records if we are querying a bogus table returned
+            // from the simplistic table parsing in table_from_sql() or if
+            // the table parameter references a table, view, or subselect not
+            // registered in the geometry columns.
+            //
+            geometryColumn_ = mapnik::sql_utils::unquote_copy('"', raster_field_);
+            if (!parsed_table_.empty() && (
+                  geometryColumn_.empty() || srid_ == 0 ||
+                  (parsed_schema_.empty() && use_overviews_) ||
+                  ! extent_initialized_
+               ))
+            {
 #ifdef MAPNIK_STATS
-            mapnik::progress_timer __stats2__(std::clog, "pgraster_datasource::init(get_srid_and_geometry_column)");
+                mapnik::progress_timer __stats2__(std::clog, "pgraster_datasource::init(get_srid_and_geometry_column)");
 #endif
-            std::ostringstream s;
+                std::ostringstream s;
 
-            try
-            {
-                s << "SELECT r_raster_column col, srid, r_table_schema";
-                if ( ! extent_initialized_ ) {
-                    s << ", st_xmin(extent) xmin, st_ymin(extent) ymin"
-                      << ", st_xmax(extent) xmax, st_ymax(extent) ymax";
-                }
-                s << " FROM " << RASTER_COLUMNS
-                  << " WHERE r_table_name=" << literal(parsed_table_);
-                if (!parsed_schema_.empty())
-                {
-                    s << " AND r_table_schema=" << literal(parsed_schema_);
-                }
-                if (!geometryColumn_.empty())
-                {
-                    s << " AND r_raster_column=" << literal(geometryColumn_);
-                }
-                MAPNIK_LOG_DEBUG(pgraster) <<
-                  "pgraster_datasource: running query " << s.str();
-                shared_ptr<ResultSet> rs = conn->executeQuery(s.str());
-                if (rs->next())
+                try
                 {
-                    geometryColumn_ = rs->getValue("col");
-                    if ( ! extent_initialized_ )
+                    s << "SELECT r_raster_column col, srid, r_table_schema";
+                    if ( ! extent_initialized_ ) {
+                        s << ", st_xmin(extent) xmin, st_ymin(extent) ymin"
+                          << ", st_xmax(extent) xmax, st_ymax(extent) ymax";
+                    }
+                    s << " FROM " << RASTER_COLUMNS
+                      << " WHERE r_table_name=" << literal(parsed_table_);
+                    if (!parsed_schema_.empty())
+                    {
+                        s << " AND r_table_schema=" << literal(parsed_schema_);
+                    }
+                    if (!geometryColumn_.empty())
                     {
-                        double lox, loy, hix, hiy;
-                        if (mapnik::util::string2double(rs->getValue("xmin"), lox) &&
-                            mapnik::util::string2double(rs->getValue("ymin"), loy) &&
-                            mapnik::util::string2double(rs->getValue("xmax"), hix) &&
-                            mapnik::util::string2double(rs->getValue("ymax"), hiy))
+                        s << " AND r_raster_column=" << literal(geometryColumn_);
+                    }
+                    MAPNIK_LOG_DEBUG(pgraster) <<
+                      "pgraster_datasource: running query " << s.str();
+                    shared_ptr<ResultSet> rs = conn->executeQuery(s.str());
+                    if (rs->next())
+                    {
+                        geometryColumn_ = rs->getValue("col");
+                        if ( ! extent_initialized_ )
                         {
-                            extent_.init(lox, loy, hix, hiy);
-                            extent_initialized_ = true;
-                            MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: Layer extent=" << extent_;
+                            double lox, loy, hix, hiy;
+                            if (mapnik::util::string2double(rs->getValue("xmin"), lox) &&
+                                mapnik::util::string2double(rs->getValue("ymin"), loy) &&
+                                mapnik::util::string2double(rs->getValue("xmax"), hix) &&
+                                mapnik::util::string2double(rs->getValue("ymax"), hiy))
+                            {
+                                extent_.init(lox, loy, hix, hiy);
+                                extent_initialized_ = true;
+                                MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: Layer extent=" << extent_;
+                            }
+                            else
+                            {
+                                MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: Could not determine extent from query: " << s.str();
+                            }
                         }
-                        else
+                        if (srid_ == 0)
+                        {
+                            const char* srid_c = rs->getValue("srid");
+                            if (srid_c != nullptr)
+                            {
+                                int result = 0;
+                                const char * end = srid_c + std::strlen(srid_c);
+                                if (mapnik::util::string2int(srid_c, end, result))
+                                {
+                                    srid_ = result;
+                                }
+                            }
+                        }
+                        if (parsed_schema_.empty())
                         {
-                            MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: Could not determine extent from query: " << s.str();
+                            parsed_schema_ = rs->getValue("r_table_schema");
                         }
                     }
-                    if (srid_ == 0)
+                    else
+                    {
+                        MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: no response from metadata query " << s.str();
+                    }
+                    rs->close();
+                }
+                catch (mapnik::datasource_exception const& ex) {
+                    // let this pass on query error and use the fallback below
+                    MAPNIK_LOG_WARN(pgraster) << "pgraster_datasource: metadata query failed: " << ex.what();
+                }
+
+                // If we still do not know the srid then we can try to fetch
+                // it from the 'table_' parameter, which should work even if it is
+                // a subselect as long as we know the geometry_field to query
+                if (! geometryColumn_.empty() && srid_ <= 0)
+                {
+                    s.str("");
+
+                    s << "SELECT ST_SRID(" << identifier(geometryColumn_)
+                      << ") AS srid FROM " << populate_tokens(table_)
+                      << " WHERE " << identifier(geometryColumn_)
+                      << " IS NOT NULL LIMIT 1";
+
+                    shared_ptr<ResultSet> rs = conn->executeQuery(s.str());
+                    if (rs->next())
                     {
                         const char* srid_c = rs->getValue("srid");
                         if (srid_c != nullptr)
@@ -247,314 +318,335 @@ pgraster_datasource::pgraster_datasource(parameters const& params)
                             }
                         }
                     }
-                    if (parsed_schema_.empty())
-                    {
-                        parsed_schema_ = rs->getValue("r_table_schema");
-                    }
-                }
-                else
-                {
-                    MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: no response from metadata query " << s.str();
+                    rs->close();
                 }
-                rs->close();
-            }
-            catch (mapnik::datasource_exception const& ex) {
-                // let this pass on query error and use the fallback below
-                MAPNIK_LOG_WARN(pgraster) << "pgraster_datasource: metadata query failed: " << ex.what();
             }
 
-            // If we still do not know the srid then we can try to fetch
-            // it from the 'table_' parameter, which should work even if it is
-            // a subselect as long as we know the geometry_field to query
-            if (! geometryColumn_.empty() && srid_ <= 0)
+            // If overviews were requested, take note of the max scale
+            // of each available overview, sorted by scale descending
+            if ( use_overviews_ )
             {
-                s.str("");
-
-                s << "SELECT ST_SRID(" << identifier(geometryColumn_)
-                  << ") AS srid FROM " << populate_tokens(table_)
-                  << " WHERE " << identifier(geometryColumn_)
-                  << " IS NOT NULL LIMIT 1";
+                std::ostringstream err;
+                if (parsed_schema_.empty())
+                {
+                    err << "Pgraster Plugin: unable to lookup available table"
+                        << " overviews due to unknown schema";
+                    throw mapnik::datasource_exception(err.str());
+                }
+                if (geometryColumn_.empty())
+                {
+                    err << "Pgraster Plugin: unable to lookup available table"
+                        << " overviews due to unknown column name";
+                    throw mapnik::datasource_exception(err.str());
+                }
 
+                std::ostringstream s;
+                s << "select "
+                     "r.r_table_schema sch, "
+                     "r.r_table_name tab, "
+                     "r.r_raster_column col, "
+                     "greatest(abs(r.scale_x), abs(r.scale_y)) scl "
+                     "from"
+                     " raster_overviews o,"
+                     " raster_columns r "
+                     "where"
+                     " o.r_table_schema = " << literal(parsed_schema_)
+                  << " and o.r_table_name = " << literal(parsed_table_)
+                  << " and o.r_raster_column = " << literal(geometryColumn_)
+                  << " and r.r_table_schema = o.o_table_schema"
+                     " and r.r_table_name = o.o_table_name"
+                     " and r.r_raster_column = o.o_raster_column"
+                     " ORDER BY scl ASC";
+                MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: running query " << s.str();
                 shared_ptr<ResultSet> rs = conn->executeQuery(s.str());
-                if (rs->next())
+                while (rs->next())
                 {
-                    const char* srid_c = rs->getValue("srid");
-                    if (srid_c != nullptr)
-                    {
-                        int result = 0;
-                        const char * end = srid_c + std::strlen(srid_c);
-                        if (mapnik::util::string2int(srid_c, end, result))
-                        {
-                            srid_ = result;
-                        }
-                    }
-                }
-                rs->close();
-            }
-        }
+                    pgraster_overview ov = pgraster_overview();
 
-        // If overviews were requested, take note of the max scale
-        // of each available overview, sorted by scale descending
-        if ( use_overviews_ )
-        {
-            std::ostringstream err;
-            if (parsed_schema_.empty())
-            {
-                err << "Pgraster Plugin: unable to lookup available table"
-                    << " overviews due to unknown schema";
-                throw mapnik::datasource_exception(err.str());
-            }
-            if (geometryColumn_.empty())
-            {
-                err << "Pgraster Plugin: unable to lookup available table"
-                    << " overviews due to unknown column name";
-                throw mapnik::datasource_exception(err.str());
-            }
+                    ov.schema = rs->getValue("sch");
+                    ov.table = rs->getValue("tab");
+                    ov.column = rs->getValue("col");
+                    ov.scale = atof(rs->getValue("scl"));
 
-            std::ostringstream s;
-            s << "select "
-                 "r.r_table_schema sch, "
-                 "r.r_table_name tab, "
-                 "r.r_raster_column col, "
-                 "greatest(abs(r.scale_x), abs(r.scale_y)) scl "
-                 "from"
-                 " raster_overviews o,"
-                 " raster_columns r "
-                 "where"
-                 " o.r_table_schema = " << literal(parsed_schema_)
-              << " and o.r_table_name = " << literal(parsed_table_)
-              << " and o.r_raster_column = " << literal(geometryColumn_)
-              << " and r.r_table_schema = o.o_table_schema"
-                 " and r.r_table_name = o.o_table_name"
-                 " and r.r_raster_column = o.o_raster_column"
-                 " ORDER BY scl ASC";
-            MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: running query " << s.str();
-            shared_ptr<ResultSet> rs = conn->executeQuery(s.str());
-            while (rs->next())
-            {
-                pgraster_overview ov = pgraster_overview();
+                    if(ov.scale == 0.0f)
+                    {
+                        MAPNIK_LOG_WARN(pgraster) << "pgraster_datasource: found invalid overview "
+                          << ov.schema << "." << ov.table << "." << ov.column << " with scale " << ov.scale;
+                        continue;
+                    }
 
-                ov.schema = rs->getValue("sch");
-                ov.table = rs->getValue("tab");
-                ov.column = rs->getValue("col");
-                ov.scale = atof(rs->getValue("scl"));
+                    overviews_.push_back(ov);
 
-                if(ov.scale == 0.0f)
-                {
-                    MAPNIK_LOG_WARN(pgraster) << "pgraster_datasource: found invalid overview "
+                    MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: found overview "
                       << ov.schema << "." << ov.table << "." << ov.column << " with scale " << ov.scale;
-                    continue;
                 }
-
-                overviews_.push_back(ov);
-
-                MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: found overview "
-                  << ov.schema << "." << ov.table << "." << ov.column << " with scale " << ov.scale;
-            }
-            rs->close();
-            if ( overviews_.empty() ) {
-                MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: no overview found for "
-                  << parsed_schema_ << "." << parsed_table_ << "." << geometryColumn_;
+                rs->close();
+                if ( overviews_.empty() ) {
+                    MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: no overview found for "
+                      << parsed_schema_ << "." << parsed_table_ << "." << geometryColumn_;
+                }
             }
-        }
 
-        // detect primary key
-        if (*autodetect_key_field && key_field_.empty())
-        {
+            // detect primary key
+            if (*autodetect_key_field && key_field_.empty())
+            {
 #ifdef MAPNIK_STATS
-            mapnik::progress_timer __stats2__(std::clog, "pgraster_datasource::bind(get_primary_key)");
+                mapnik::progress_timer __stats2__(std::clog, "pgraster_datasource::bind(get_primary_key)");
 #endif
 
-            std::ostringstream s;
-            s << "SELECT a.attname, a.attnum, t.typname, t.typname in ('int2','int4','int8') "
-                "AS is_int FROM pg_class c, pg_attribute a, pg_type t, pg_namespace n, pg_index i "
-                "WHERE a.attnum > 0 AND a.attrelid = c.oid "
-                "AND a.atttypid = t.oid AND c.relnamespace = n.oid "
-                "AND c.oid = i.indrelid AND i.indisprimary = 't' "
-                "AND t.typname !~ '^geom' AND c.relname = " << literal(parsed_table_) << " "
-                //"AND a.attnum = ANY (i.indkey) " // postgres >= 8.1
-              << "AND (i.indkey[0]=a.attnum OR i.indkey[1]=a.attnum OR i.indkey[2]=a.attnum "
-                "OR i.indkey[3]=a.attnum OR i.indkey[4]=a.attnum OR i.indkey[5]=a.attnum "
-                "OR i.indkey[6]=a.attnum OR i.indkey[7]=a.attnum OR i.indkey[8]=a.attnum "
-                "OR i.indkey[9]=a.attnum) ";
-            if (!parsed_schema_.empty())
-            {
-                s << "AND n.nspname=" << literal(parsed_schema_) << ' ';
-            }
-            s << "ORDER BY a.attnum";
+                std::ostringstream s;
+                s << "SELECT a.attname, a.attnum, t.typname, t.typname in ('int2','int4','int8') "
+                    "AS is_int FROM pg_class c, pg_attribute a, pg_type t, pg_namespace n, pg_index i "
+                    "WHERE a.attnum > 0 AND a.attrelid = c.oid "
+                    "AND a.atttypid = t.oid AND c.relnamespace = n.oid "
+                    "AND c.oid = i.indrelid AND i.indisprimary = 't' "
+                    "AND t.typname !~ '^geom' AND c.relname = " << literal(parsed_table_) << " "
+                    //"AND a.attnum = ANY (i.indkey) " // postgres >= 8.1
+                  << "AND (i.indkey[0]=a.attnum OR i.indkey[1]=a.attnum OR i.indkey[2]=a.attnum "
+                    "OR i.indkey[3]=a.attnum OR i.indkey[4]=a.attnum OR i.indkey[5]=a.attnum "
+                    "OR i.indkey[6]=a.attnum OR i.indkey[7]=a.attnum OR i.indkey[8]=a.attnum "
+                    "OR i.indkey[9]=a.attnum) ";
+                if (!parsed_schema_.empty())
+                {
+                    s << "AND n.nspname=" << literal(parsed_schema_) << ' ';
+                }
+                s << "ORDER BY a.attnum";
 
-            shared_ptr<ResultSet> rs_key = conn->executeQuery(s.str());
-            if (rs_key->next())
-            {
-                unsigned int result_rows = rs_key->size();
-                if (result_rows == 1)
+                shared_ptr<ResultSet> rs_key = conn->executeQuery(s.str());
+                if (rs_key->next())
                 {
-                    bool is_int = (std::string(rs_key->getValue(3)) == "t");
-                    if (is_int)
+                    unsigned int result_rows = rs_key->size();
+                    if (result_rows == 1)
                     {
-                        const char* key_field_string = rs_key->getValue(0);
-                        if (key_field_string)
+                        bool is_int = (std::string(rs_key->getValue(3)) == "t");
+                        if (is_int)
                         {
-                            key_field_ = std::string(key_field_string);
+                            const char* key_field_string = rs_key->getValue(0);
+                            if (key_field_string)
+                            {
+                                key_field_ = std::string(key_field_string);
 
-                            MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: auto-detected key field of '"
-                                                       << key_field_ << "' on table '" << parsed_table_ << "'";
+                                MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: auto-detected key field of '"
+                                                           << key_field_ << "' on table '" << parsed_table_ << "'";
+                            }
+                        }
+                        else
+                        {
+                            // throw for cases like a numeric primary key, which is invalid
+                            // as it should be floating point (int numerics are useless)
+                            std::ostringstream err;
+                            err << "PostGIS Plugin: Error: '"
+                                << rs_key->getValue(0)
+                                << "' on table '"
+                                << parsed_table_
+                                << "' is not a valid integer primary key field\n";
+                            throw mapnik::datasource_exception(err.str());
                         }
                     }
-                    else
+                    else if (result_rows > 1)
                     {
-                        // throw for cases like a numeric primary key, which is invalid
-                        // as it should be floating point (int numerics are useless)
                         std::ostringstream err;
                         err << "PostGIS Plugin: Error: '"
-                            << rs_key->getValue(0)
-                            << "' on table '"
-                            << parsed_table_
-                            << "' is not a valid integer primary key field\n";
+                            << "multi column primary key detected but is not supported";
                         throw mapnik::datasource_exception(err.str());
                     }
                 }
-                else if (result_rows > 1)
-                {
-                    std::ostringstream err;
-                    err << "PostGIS Plugin: Error: '"
-                        << "multi column primary key detected but is not supported";
-                    throw mapnik::datasource_exception(err.str());
-                }
+                rs_key->close();
             }
-            rs_key->close();
-        }
 
-        // if a globally unique key field/primary key is required
-        // but still not known at this point, then throw
-        if (*autodetect_key_field && key_field_.empty())
-        {
-            throw mapnik::datasource_exception(
-                "PostGIS Plugin: Error: primary key required"
-                " but could not be detected for table '"
-                + parsed_table_ + "', please supply 'key_field'"
-                " option to specify field to use for primary key");
-        }
+            // if a globally unique key field/primary key is required
+            // but still not known at this point, then throw
+            if (*autodetect_key_field && key_field_.empty())
+            {
+                throw mapnik::datasource_exception(
+                    "PostGIS Plugin: Error: primary key required"
+                    " but could not be detected for table '"
+                    + parsed_table_ + "', please supply 'key_field'"
+                    " option to specify field to use for primary key");
+            }
 
-        if (srid_ == 0)
-        {
-            srid_ = -1;
+            if (srid_ == 0)
+            {
+                srid_ = -1;
 
-            MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: Table " << table_ << " is using SRID=" << srid_;
-        }
+                MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: Table " << table_ << " is using SRID=" << srid_;
+            }
 
-        // At this point the geometry_field may still not be known
-        // but we'll catch that where more useful...
-        MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: Using SRID=" << srid_;
-        MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: Using geometry_column=" << geometryColumn_;
+            // At this point the geometry_field may still not be known
+            // but we'll catch that where more useful...
+            MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: Using SRID=" << srid_;
+            MAPNIK_LOG_DEBUG(pgraster) << "pgraster_datasource: Using geometry_column=" << geometryColumn_;
 
-        // collect attribute desc
+            // collect attribute desc
 #ifdef MAPNIK_STATS
-        mapnik::progress_timer __stats2__(std::clog, "pgraster_datasource::bind(get_column_description)");
+            mapnik::progress_timer __stats2__(std::clog, "pgraster_datasource::bind(get_column_description)");
 #endif
 
-        std::ostringstream s;
-        s << "SELECT * FROM " << populate_tokens(table_) << " LIMIT 0";
-
-        shared_ptr<ResultSet> rs = conn->executeQuery(s.str());
-        int count = rs->getNumFields();
-        bool found_key_field = false;
-        for (int i = 0; i < count; ++i)
-        {
-            std::string fld_name = rs->getFieldName(i);
-            int type_oid = rs->getTypeOID(i);
+            std::ostringstream s;
+            s << "SELECT * FROM " << populate_tokens(table_) << " LIMIT 0";
 
-            // validate type of key_field
-            if (! found_key_field && ! key_field_.empty() && fld_name == key_field_)
+            shared_ptr<ResultSet> rs = conn->executeQuery(s.str());
+            int count = rs->getNumFields();
+            bool found_key_field = false;
+            for (int i = 0; i < count; ++i)
             {
-                if (type_oid == 20 || type_oid == 21 || type_oid == 23)
-                {
-                    found_key_field = true;
-                    desc_.add_descriptor(attribute_descriptor(fld_name, mapnik::Integer));
-                }
-                else
-                {
-                    std::ostringstream error_s;
-                    error_s << "invalid type '";
+                std::string fld_name = rs->getFieldName(i);
+                int type_oid = rs->getTypeOID(i);
 
-                    std::ostringstream type_s;
-                    type_s << "SELECT oid, typname FROM pg_type WHERE oid = " << type_oid;
-
-                    shared_ptr<ResultSet> rs_oid = conn->executeQuery(type_s.str());
-                    if (rs_oid->next())
+                // validate type of key_field
+                if (! found_key_field && ! key_field_.empty() && fld_name == key_field_)
+                {
+                    if (type_oid == 20 || type_oid == 21 || type_oid == 23)
                     {
-                        error_s << rs_oid->getValue("typname")
-                                << "' (oid:" << rs_oid->getValue("oid") << ")";
+                        found_key_field = true;
+                        desc_.add_descriptor(attribute_descriptor(fld_name, mapnik::Integer));
                     }
                     else
                     {
-                        error_s << "oid:" << type_oid << "'";
-                    }
+                        std::ostringstream error_s;
+                        error_s << "invalid type '";
 
-                    rs_oid->close();
-                    error_s << " for key_field '" << fld_name << "' - "
-                            << "must be an integer primary key";
+                        std::ostringstream type_s;
+                        type_s << "SELECT oid, typname FROM pg_type WHERE oid = " << type_oid;
 
-                    rs->close();
-                    throw mapnik::datasource_exception(error_s.str());
+                        shared_ptr<ResultSet> rs_oid = conn->executeQuery(type_s.str());
+                        if (rs_oid->next())
+                        {
+                            error_s << rs_oid->getValue("typname")
+                                    << "' (oid:" << rs_oid->getValue("oid") << ")";
+                        }
+                        else
+                        {
+                            error_s << "oid:" << type_oid << "'";
+                        }
+
+                        rs_oid->close();
+                        error_s << " for key_field '" << fld_name << "' - "
+                                << "must be an integer primary key";
+
+                        rs->close();
+                        throw mapnik::datasource_exception(error_s.str());
+                    }
                 }
-            }
-            else
-            {
-                switch (type_oid)
+                else
                 {
-                case 16:    // bool
-                    desc_.add_descriptor(attribute_descriptor(fld_name, mapnik::Boolean));
-                    break;
-                case 20:    // int8
-                case 21:    // int2
-                case 23:    // int4
-                    desc_.add_descriptor(attribute_descriptor(fld_name, mapnik::Integer));
-                    break;
-                case 700:   // float4
-                case 701:   // float8
-                case 1700:  // numeric
-                    desc_.add_descriptor(attribute_descriptor(fld_name, mapnik::Double));
-                    break;
-                case 1042:  // bpchar
-                case 1043:  // varchar
-                case 25:    // text
-                case 705:   // literal
-                    desc_.add_descriptor(attribute_descriptor(fld_name, mapnik::String));
-                    break;
-                default: // should not get here
+                    switch (type_oid)
+                    {
+                    case 16:    // bool
+                        desc_.add_descriptor(attribute_descriptor(fld_name, mapnik::Boolean));
+                        break;
+                    case 20:    // int8
+                    case 21:    // int2
+                    case 23:    // int4
+                        desc_.add_descriptor(attribute_descriptor(fld_name, mapnik::Integer));
+                        break;
+                    case 700:   // float4
+                    case 701:   // float8
+                    case 1700:  // numeric
+                        desc_.add_descriptor(attribute_descriptor(fld_name, mapnik::Double));
+                        break;
+                    case 1042:  // bpchar
+                    case 1043:  // varchar
+                    case 25:    // text
+                    case 705:   // literal
+                        desc_.add_descriptor(attribute_descriptor(fld_name, mapnik::String));
+                        break;
+                    default: // should not get here
 #ifdef MAPNIK_LOG
-                    s.str("");
-                    s << "SELECT oid, typname FROM pg_type WHERE oid = " << type_oid;
+                        s.str("");
+                        s << "SELECT oid, typname FROM pg_type WHERE oid = " << type_oid;
 
-                    shared_ptr<ResultSet> rs_oid = conn->executeQuery(s.str());
-                    if (rs_oid->next())
-                    {
-                        std::string typname(rs_oid->getValue("typname"));
-                        if (typname != "geometry" && typname != "raster")
+                        shared_ptr<ResultSet> rs_oid = conn->executeQuery(s.str());
+                        if (rs_oid->next())
                         {
-                            MAPNIK_LOG_WARN(pgraster) << "pgraster_datasource: Unknown type=" << typname
-                                                     << " (oid:" << rs_oid->getValue("oid") << ")";
+                            std::string typname(rs_oid->getValue("typname"));
+                            if (typname != "geometry" && typname != "raster")
+                            {
+                                MAPNIK_LOG_WARN(pgraster) << "pgraster_datasource: Unknown type=" << typname
+                                                         << " (oid:" << rs_oid->getValue("oid") << ")";
+                            }
                         }
-                    }
-                    else
-                    {
-                        MAPNIK_LOG_WARN(pgraster) << "pgraster_datasource: Unknown type_oid=" << type_oid;
-                    }
-                    rs_oid->close();
+                        else
+                        {
+                            MAPNIK_LOG_WARN(pgraster) << "pgraster_datasource: Unknown type_oid=" << type_oid;
+                        }
+                        rs_oid->close();
 #endif
-                    break;
+                        break;
+                    }
                 }
             }
-        }
 
-        rs->close();
+            rs->close();
+
+            metadata_cache.insert(metadata_key, make_metadata(metadata_stamp));
+        }
     }
 
     // Close explicitly the connection so we can 'fork()' without sharing open connections
     conn->close();
 }
 
+mapnik::datasource_metadata pgraster_datasource::make_metadata(std::string const& stamp) const
+{
+    mapnik::datasource_metadata metadata;
+    metadata.stamp = stamp;
+    metadata.encoding = desc_.get_encoding();
+    metadata.descriptors = desc_.get_descriptors();
+    if (extent_initialized_)
+    {
+        metadata.extent = extent_;
+    }
+    metadata.extra["geometry_column"] = geometryColumn_;
+    metadata.extra["key_field"] = key_field_;
+    metadata.extra["schema"] = parsed_schema_;
+    metadata.extra["srid"] = std::to_string(srid_);
+    for (std::size_t i = 0; i < overviews_.size(); ++i)
+    {
+        pgraster_overview const& ov = overviews_[i];
+        std::ostringstream s;
+        s << std::setprecision(9) << ov.scale;
+        // zero padded so that the overviews come back in order
+        std::ostringstream name;
+        name << "overview:" << std::setw(4) << std::setfill('0') << i;
+        metadata.extra[name.str()] = ov.schema + '\n' + ov.table + '\n' + ov.column + '\n' + s.str();
+    }
+    return metadata;
+}
+
+void pgraster_datasource::apply_metadata(mapnik::datasource_metadata const& metadata)
+{
+    desc_.set_encoding(metadata.encoding);
+    for (auto const& attr : metadata.descriptors)
+    {
+        desc_.add_descriptor(attr);
+    }
+    for (auto const& kv : metadata.extra)
+    {
+        if (kv.first == "geometry_column") geometryColumn_ = kv.second;
+        else if (kv.first == "key_field") key_field_ = kv.second;
+        else if (kv.first == "schema") parsed_schema_ = kv.second;
+        else if (kv.first == "srid") mapnik::util::string2int(kv.second, srid_);
+        else if (boost::algorithm::starts_with(kv.first, "overview:"))
+        {
+            std::vector<std::string> parts;
+            boost::algorithm::split(parts, kv.second, boost::algorithm::is_any_of("\n"));
+            if (parts.size() != 4) continue;
+            pgraster_overview ov = pgraster_overview();
+            ov.schema = parts[0];
+            ov.table = parts[1];
+            ov.column = parts[2];
+            ov.scale = atof(parts[3].c_str());
+            overviews_.push_back(ov);
+        }
+    }
+    if (metadata.extent && !extent_initialized_)
+    {
+        extent_ = *metadata.extent;
+        extent_initialized_ = true;
+    }
+}
+
 pgraster_datasource::~pgraster_datasource()
 {
     if (! persist_connection_)
@@ -803,6 +895,7 @@ featureset_ptr pgraster_datasource::features_with_context(query const& q,process
     if (pool)
     {
         shared_ptr<Connection> conn;
+        mapnik::datasource_stats wait_stats;
 
         if ( asynchronous_request_ )
         {
@@ -810,6 +903,7 @@ featureset_ptr pgraster_datasource::features_with_context(query const& q,process
             std::shared_ptr<postgis_processor_context> pgis_ctxt = std::static_pointer_cast<postgis_processor_context>(proc_ctx);
             if ( pgis_ctxt->num_async_requests_ < max_async_connections_ )
             {
+                mapnik::datasource_stats_timer wait_timer(&wait_stats.wait);
                 conn = pool->borrowObject();
                 pgis_ctxt->num_async_requests_++;
             }
@@ -817,12 +911,16 @@ featureset_ptr pgraster_datasource::features_with_context(query const& q,process
         else
         {
             // Always get a connection in synchronous mode
-            conn = pool->borrowObject();
+            {
+                mapnik::datasource_stats_timer wait_timer(&wait_stats.wait);
+                conn = pool->borrowObject();
+            }
             if(!conn )
             {
                 throw mapnik::datasource_exception("Pgraster Plugin: Null connection");
             }
         }
+        counters().add(wait_stats);
 
 
         if (geometryColumn_.empty())
@@ -910,13 +1008,13 @@ featureset_ptr pgraster_datasource::features_with_context(query const& q,process
         }
 
         if (prescale_rasters_) {
-          const double scale = std::min(px_gw, px_gh);
+          // each axis down to the output resolution, never up
           s << ", least(1.0, abs(ST_ScaleX(" << identifier(col)
-            << "))::float8/" << scale
+            << "))::float8/" << px_gw
             << "), least(1.0, abs(ST_ScaleY(" << identifier(col)
-            << "))::float8/" << scale << "))";
-          // TODO: if band_ is given, we'll interpret as indexed so
-          //       the rescaling must NOT ruin it (use algorithm mode!)
+            << "))::float8/" << px_gh << "), "
+            // a band is interpreted as indexed, its values must not be blended
+            << literal(band_ ? std::string("NearestNeighbour") : prescale_algorithm_) << ")";
         }
 
         if (band_) s << ", " << band_ << ")";
@@ -964,10 +1062,10 @@ featureset_ptr pgraster_datasource::features_with_context(query const& q,process
         std::shared_ptr<IResultSet> rs = get_resultset(conn, s.str(), pool, proc_ctx);
         return std::make_shared<pgraster_featureset>(rs, ctx,
                   desc_.get_encoding(), !key_field_.empty(),
-                  band_ ? 1 : 0 // whatever band number is given we'd have
-                                // extracted with ST_Band above so it becomes
-                                // band number 1
-               );
+                  band_ ? 1 : 0, // whatever band number is given we'd have
+                                 // extracted with ST_Band above so it becomes
+                                 // band number 1
+                  &counters());
 
     }
 
@@ -983,7 +1081,13 @@ featureset_ptr pgraster_datasource::features_at_point(coord2d const& pt, double
     CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
     if (pool)
     {
-        shared_ptr<Connection> conn = pool->borrowObject();
+        mapnik::datasource_stats wait_stats;
+        shared_ptr<Connection> conn;
+        {
+            mapnik::datasource_stats_timer wait_timer(&wait_stats.wait);
+            conn = pool->borrowObject();
+        }
+        counters().add(wait_stats);
         if (!conn) return mapnik::make_invalid_featureset();
 
         if (conn->isOK())
@@ -1052,7 +1156,7 @@ featureset_ptr pgraster_datasource::features_at_point(coord2d const& pt, double
             }
 
             std::shared_ptr<IResultSet> rs = get_resultset(conn, s.str(), pool);
-            return std::make_shared<pgraster_featureset>(rs, ctx, desc_.get_encoding(), !key_field_.empty());
+            return std::make_shared<pgraster_featureset>(rs, ctx, desc_.get_encoding(), !key_field_.empty(), 0, &counters());
         }
     }
 
@@ -37,6 +37,7 @@
 #include <mapnik/feature_layer_desc.hpp>
 #include <mapnik/unicode.hpp>
 #include <mapnik/value/types.hpp>
+#include <mapnik/datasource_metadata_cache.hpp>
 
 // boost
 #include <boost/optional.hpp>
@@ -50,6 +51,7 @@
 #include "../postgis/connection_manager.hpp"
 #include "../postgis/resultset.hpp"
 #include "../postgis/cursorresultset.hpp"
+#include "../postgis/relation_stamp.hpp"
 
 using mapnik::transcoder;
 using mapnik::datasource;
@@ -98,6 +100,8 @@ private:
                                 bool intersect = true) const;
     std::string populate_tokens(std::string const& sql) const;
     std::shared_ptr<IResultSet> get_resultset(std::shared_ptr<Connection> &conn, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx= processor_context_ptr()) const;
+    mapnik::datasource_metadata make_metadata(std::string const& stamp) const;
+    void apply_metadata(mapnik::datasource_metadata const& metadata);
     static const std::string RASTER_COLUMNS;
     static const std::string RASTER_OVERVIEWS;
     static const std::string SPATIAL_REF_SYS;
@@ -128,6 +132,8 @@ private:
     mutable bool extent_initialized_;
     mutable mapnik::box2d<double> extent_;
     bool prescale_rasters_;
+    // ST_Resize algorithm of prescale_rasters
+    std::string prescale_algorithm_;
     bool use_overviews_;
     bool clip_rasters_;
     layer_descriptor desc_;
@@ -53,20 +53,25 @@ using mapnik::context_ptr;
 pgraster_featureset::pgraster_featureset(std::shared_ptr<IResultSet> const& rs,
                                        context_ptr const& ctx,
                                        std::string const& encoding,
-                                       bool key_field, int bandno)
+                                       bool key_field, int bandno,
+                                       mapnik::datasource_counters * counters)
     : rs_(rs),
       ctx_(ctx),
       tr_(new transcoder(encoding)),
       feature_id_(1),
       key_field_(key_field),
-      band_(bandno)
+      band_(bandno),
+      stats_(counters)
 {
+    stats_->queries = 1;
 }
 
 feature_ptr pgraster_featureset::next()
 {
     while (rs_->next())
     {
+        // fetching the rows is left out of the decoding time
+        mapnik::datasource_stats_timer decode_timer(stats_ ? &stats_->decode : nullptr);
         // new feature
         unsigned pos = 1;
         feature_ptr feature;
@@ -79,6 +84,7 @@ feature_ptr pgraster_featureset::next()
             if (rs_->isNull(pos))
             {
                 MAPNIK_LOG_WARN(pgraster) << "pgraster_featureset: null value encountered for key_field: " << name;
+                ++stats_->filtered;
                 continue;
             }
             // create feature with user driven id from attribute
@@ -123,18 +129,21 @@ feature_ptr pgraster_featureset::next()
         if (rs_->isNull(0))
         {
             MAPNIK_LOG_WARN(pgraster) << "pgraster_featureset: null value encountered for raster";
+            ++stats_->filtered;
             continue;
         }
 
         // parse geometry
         int size = rs_->getFieldLength(0);
         const uint8_t *data = (const uint8_t*)rs_->getValue(0);
+        stats_->bytes_read += size;
 
         mapnik::raster_ptr raster = pgraster_wkb_reader::read(data, size, band_);
         if (!raster)
         {
             MAPNIK_LOG_WARN(pgraster) << "pgraster_featureset: could not parse raster wkb";
             // TODO: throw an exception ?
+            ++stats_->filtered;
             continue;
         }
         MAPNIK_LOG_WARN(pgraster) << "pgraster_featureset: raster of " << raster->data_.width() << "x" << raster->data_.height() << " pixels covering extent " << raster->ext_;
@@ -151,6 +160,7 @@ feature_ptr pgraster_featureset::next()
             {
                 const char* buf = rs_->getValue(pos);
                 const int oid = rs_->getTypeOID(pos);
+                stats_->bytes_read += rs_->getFieldLength(pos);
                 switch (oid)
                 {
                     case 16: //bool
@@ -228,8 +238,10 @@ feature_ptr pgraster_featureset::next()
                 }
             }
         }
+        ++stats_->features;
         return feature;
     }
+    stats_.flush();
     return feature_ptr();
 }
 
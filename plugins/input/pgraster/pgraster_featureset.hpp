@@ -32,6 +32,7 @@
 #include <mapnik/datasource.hpp>
 #include <mapnik/feature.hpp>
 #include <mapnik/unicode.hpp>
+#include <mapnik/datasource_stats.hpp>
 
 // stl
 #include <memory>
@@ -55,7 +56,8 @@ public:
                        context_ptr const& ctx,
                        std::string const& encoding,
                        bool key_field = false,
-                       int bandno = 0);
+                       int bandno = 0,
+                       mapnik::datasource_counters * counters = nullptr);
     feature_ptr next();
     ~pgraster_featureset();
 
@@ -66,6 +68,7 @@ private:
     mapnik::value_integer feature_id_;
     bool key_field_;
     int band_;
+    mapnik::datasource_stats_batch stats_;
 };
 
 #endif // PGRASTER_FEATURESET_HPP
@@ -36,9 +36,8 @@
 #include <mapnik/util/conversions.hpp>
 #include <mapnik/util/trim.hpp>
 #include <mapnik/geometry/box2d.hpp> // for box2d
-#include <functional>
-
 #include <cstdint>
+#include <utility>
 
 namespace {
 
@@ -174,6 +173,30 @@ typedef enum {
 #define BANDTYPE_HAS_NODATA(x) ((x)&BANDTYPE_FLAG_HASNODATA)
 #define BANDTYPE_IS_NODATA(x) ((x)&BANDTYPE_FLAG_ISNODATA)
 
+// bytes per value of a band, 0 for unknown types
+std::size_t pixel_size(int pixtype)
+{
+    switch (pixtype) {
+      case PT_1BB:
+      case PT_2BUI:
+      case PT_4BUI:
+      case PT_8BSI:
+      case PT_8BUI:
+        return 1;
+      case PT_16BSI:
+      case PT_16BUI:
+        return 2;
+      case PT_32BSI:
+      case PT_32BUI:
+      case PT_32BF:
+        return 4;
+      case PT_64BF:
+        return 8;
+      default:
+        return 0;
+    }
+}
+
 }
 
 template<typename T>
@@ -191,7 +214,7 @@ mapnik::raster_ptr read_data_band(mapnik::box2d<double> const& bbox,
       data[off] = val;
     }
   }
-  mapnik::raster_ptr raster = std::make_shared<mapnik::raster>(bbox, image, 1.0);
+  mapnik::raster_ptr raster = std::make_shared<mapnik::raster>(bbox, std::move(image), 1.0);
   if ( hasnodata ) raster->set_nodata(nodataval);
   return raster;
 }
@@ -215,6 +238,12 @@ mapnik::raster_ptr pgraster_wkb_reader::read_indexed(mapnik::box2d<double> const
     return mapnik::raster_ptr();
   }
 
+  // nodata value and pixels
+  if ( ! available((1 + std::size_t(width_) * height_) * pixel_size(pixtype)) ) {
+    MAPNIK_LOG_WARN(pgraster) << "pgraster_wkb_reader: truncated band";
+    return mapnik::raster_ptr();
+  }
+
   MAPNIK_LOG_DEBUG(pgraster) << "pgraster_wkb_reader: reading " << height_ << "x" << width_ << " pixels";
 
   switch (pixtype) {
@@ -226,27 +255,27 @@ mapnik::raster_ptr pgraster_wkb_reader::read_indexed(mapnik::box2d<double> const
       // mapnik does not support signed anyway
     case PT_8BUI:
       return read_data_band(bbox, width_, height_, hasnodata,
-                     std::bind(read_uint8, &ptr_));
+                     [this]() { return read_uint8(&ptr_); });
       break;
     case PT_16BSI:
       // mapnik does not support signed anyway
     case PT_16BUI:
       return read_data_band(bbox, width_, height_, hasnodata,
-                     std::bind(read_uint16, &ptr_, endian_));
+                     [this]() { return read_uint16(&ptr_, endian_); });
       break;
     case PT_32BSI:
       // mapnik does not support signed anyway
     case PT_32BUI:
       return read_data_band(bbox, width_, height_, hasnodata,
-                     std::bind(read_uint32, &ptr_, endian_));
+                     [this]() { return read_uint32(&ptr_, endian_); });
       break;
     case PT_32BF:
       return read_data_band(bbox, width_, height_, hasnodata,
-                     std::bind(read_float32, &ptr_, endian_));
+                     [this]() { return read_float32(&ptr_, endian_); });
       break;
     case PT_64BF:
       return read_data_band(bbox, width_, height_, hasnodata,
-                     std::bind(read_float64, &ptr_, endian_));
+                     [this]() { return read_float64(&ptr_, endian_); });
       break;
     default:
       std::ostringstream err;
@@ -294,7 +323,7 @@ mapnik::raster_ptr read_grayscale_band(mapnik::box2d<double> const& bbox,
       }
     }
   }
-  mapnik::raster_ptr raster = std::make_shared<mapnik::raster>(bbox, image, 1.0);
+  mapnik::raster_ptr raster = std::make_shared<mapnik::raster>(bbox, std::move(image), 1.0);
   if ( hasnodata ) raster->set_nodata(nodataval);
   return raster;
 }
@@ -318,6 +347,12 @@ mapnik::raster_ptr pgraster_wkb_reader::read_grayscale(mapnik::box2d<double> con
     return mapnik::raster_ptr();
   }
 
+  // nodata value and pixels
+  if ( ! available((1 + std::size_t(width_) * height_) * pixel_size(pixtype)) ) {
+    MAPNIK_LOG_WARN(pgraster) << "pgraster_wkb_reader: truncated band";
+    return mapnik::raster_ptr();
+  }
+
   switch (pixtype) {
     case PT_1BB:
     case PT_2BUI:
@@ -327,19 +362,19 @@ mapnik::raster_ptr pgraster_wkb_reader::read_grayscale(mapnik::box2d<double> con
       // mapnik does not support signed anyway
     case PT_8BUI:
       return read_grayscale_band(bbox, width_, height_, hasnodata,
-                          std::bind(read_uint8, &ptr_));
+                          [this]() { return read_uint8(&ptr_); });
       break;
     case PT_16BSI:
       // mapnik does not support signed anyway
     case PT_16BUI:
       return read_grayscale_band(bbox, width_, height_, hasnodata,
-                          std::bind(read_uint16, &ptr_, endian_));
+                          [this]() { return read_uint16(&ptr_, endian_); });
       break;
     case PT_32BSI:
       // mapnik does not support signed anyway
     case PT_32BUI:
       return read_grayscale_band(bbox, width_, height_, hasnodata,
-                          std::bind(read_uint32, &ptr_, endian_));
+                          [this]() { return read_uint32(&ptr_, endian_); });
       break;
     default:
       std::ostringstream err;
@@ -382,6 +417,11 @@ mapnik::raster_ptr pgraster_wkb_reader::read_rgba(mapnik::box2d<double> const& b
       continue;
     }
 
+    if ( ! available(1 + std::size_t(width_) * height_) ) {
+      MAPNIK_LOG_WARN(pgraster) << "pgraster_wkb_reader: truncated band " << bn;
+      return mapnik::raster_ptr();
+    }
+
     uint8_t tmp = read_uint8(&ptr_);
     if ( ! bn ) nodataval = tmp;
     else if ( tmp != nodataval ) {
@@ -389,20 +429,15 @@ mapnik::raster_ptr pgraster_wkb_reader::read_rgba(mapnik::box2d<double> const& b
             << " nodataval " << tmp << " != band 0 nodataval " << nodataval;
     }
 
-    int ps = 4; // sizeof(image::pixel_type)
-    uint8_t * image_data = im.bytes();
-    for (int y=0; y<height_; ++y) {
-      for (int x=0; x<width_; ++x) {
-        uint8_t val = read_uint8(&ptr_);
-        // y * width_ * ps is the row (ps is pixel size)
-        // x * ps is the column
-        int off = y * width_ * ps + x * ps;
-        // Pixel space is RGBA
-        image_data[off+bn] = val;
-      }
+    // Pixel space is RGBA, the band goes to byte bn of every pixel
+    std::size_t ps = 4; // sizeof(image::pixel_type)
+    uint8_t * image_data = im.bytes() + bn;
+    uint8_t const* band_end = ptr_ + std::size_t(width_) * height_;
+    for (; ptr_ != band_end; image_data += ps) {
+      *image_data = *ptr_++;
     }
   }
-  mapnik::raster_ptr raster = std::make_shared<mapnik::raster>(bbox, im, 1.0);
+  mapnik::raster_ptr raster = std::make_shared<mapnik::raster>(bbox, std::move(im), 1.0);
   raster->set_nodata(0xffffffff);
   return raster;
 }
@@ -410,6 +445,12 @@ mapnik::raster_ptr pgraster_wkb_reader::read_rgba(mapnik::box2d<double> const& b
 mapnik::raster_ptr
 pgraster_wkb_reader::get_raster() {
 
+    // endianness, version, number of bands, 6 doubles, srid, width and height
+    if ( ! available(61) ) {
+      MAPNIK_LOG_WARN(pgraster) << "pgraster_wkb_reader: truncated raster header";
+      return mapnik::raster_ptr();
+    }
+
     /* Read endianness */
     endian_ = *ptr_;
     ptr_ += 1;
@@ -31,6 +31,10 @@
 #include <mapnik/feature.hpp> // for raster_ptr
 #include <mapnik/geometry/box2d.hpp>
 
+// stl
+#include <cstddef>
+#include <cstdint>
+
 enum pgraster_color_interp {
   // Automatic color interpretation:
   // uses grayscale for single band, rgb for 3 bands
@@ -48,7 +52,7 @@ class pgraster_wkb_reader
 public:
 
   pgraster_wkb_reader(const uint8_t* wkb, int size, int bnd=0)
-    : ptr_(wkb), bandno_(bnd)
+    : ptr_(wkb), end_(wkb + (size > 0 ? size : 0)), bandno_(bnd)
   {}
 
   mapnik::raster_ptr get_raster();
@@ -69,11 +73,17 @@ private:
   mapnik::raster_ptr read_indexed(mapnik::box2d<double> const& bbox, uint16_t width, uint16_t height);
   mapnik::raster_ptr read_grayscale(mapnik::box2d<double> const& bbox, uint16_t width, uint16_t height);
   mapnik::raster_ptr read_rgba(mapnik::box2d<double> const& bbox, uint16_t width, uint16_t height);
+  // whether at least bytes are left to read
+  bool available(std::size_t bytes) const
+  {
+    return static_cast<std::size_t>(end_ - ptr_) >= bytes;
+  }
 
   //int wkbsize_;
   //const uint8_t* wkb_;
   //const uint8_t* wkbend_;
   const uint8_t* ptr_;
+  const uint8_t* end_;
   uint8_t endian_;
   int bandno_;
   uint16_t numBands_;
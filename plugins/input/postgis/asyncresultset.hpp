@@ -39,11 +39,13 @@ class AsyncResultSet : public IResultSet, private mapnik::util::noncopyable
 public:
     AsyncResultSet(postgis_processor_context_ptr const& ctx,
                      std::shared_ptr< Pool<Connection,ConnectionCreator> > const& pool,
-                     std::shared_ptr<Connection> const& conn, std::string const& sql )
+                     std::shared_ptr<Connection> const& conn, std::string const& sql,
+                     mapnik::cancel_token_ptr const& cancel = mapnik::cancel_token_ptr())
         : ctx_(ctx),
           pool_(pool),
           conn_(conn),
           sql_(sql),
+          cancel_(cancel),
           is_closed_(false)
     {
     }
@@ -97,6 +99,13 @@ public:
             // Ensure connection is valid
             if (conn_ && conn_->isOK())
             {
+                if (cancel_ && !conn_->waitResult(*cancel_))
+                {
+                    // the render was cancelled, end the featureset
+                    close();
+                    prepare_next();
+                    return false;
+                }
                 rs_ = conn_->getAsyncResult();
             }
             else
@@ -165,6 +174,7 @@ private:
     std::shared_ptr< Pool<Connection,ConnectionCreator> > pool_;
     std::shared_ptr<Connection> conn_;
     std::string sql_;
+    mapnik::cancel_token_ptr cancel_;
     std::shared_ptr<ResultSet> rs_;
     bool is_closed_;
 
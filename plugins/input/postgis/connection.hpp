@@ -27,12 +27,17 @@
 #include <mapnik/debug.hpp>
 #include <mapnik/datasource.hpp>
 #include <mapnik/timer.hpp>
+#include <mapnik/cancel_token.hpp>
 
 // std
 #include <memory>
 #include <sstream>
 #include <iostream>
 
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
 extern "C" {
 #include "libpq-fe.h"
 }
@@ -191,6 +196,50 @@ public:
         return result;
     }
 
+    // Waits for the pending query to produce a result, polling the
+    // connection so that a tripped cancel token is noticed. Returns false,
+    // having asked the server to cancel the query, once it trips.
+    bool waitResult(mapnik::cancel_token const& token)
+    {
+#ifndef _WIN32
+        while (PQisBusy(conn_))
+        {
+            if (token.cancelled())
+            {
+                cancel();
+                return false;
+            }
+            pollfd pfd;
+            pfd.fd = PQsocket(conn_);
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (pfd.fd < 0 || poll(&pfd, 1, 50) < 0 || PQconsumeInput(conn_) != 1)
+            {
+                // let PQgetResult report the broken connection
+                break;
+            }
+        }
+#endif
+        return !token.cancelled();
+    }
+
+    // Asks the server to stop the running query, the connection is closed
+    // since its pending results are of no further use.
+    void cancel()
+    {
+        if (closed_) return;
+        if (PGcancel * handle = PQgetCancel(conn_))
+        {
+            char err_msg[256];
+            if (PQcancel(handle, err_msg, sizeof(err_msg)) != 1)
+            {
+                MAPNIK_LOG_DEBUG(postgis) << "postgis_connection: cancel failed - " << err_msg;
+            }
+            PQfreeCancel(handle);
+        }
+        close();
+    }
+
     std::shared_ptr<ResultSet> getNextAsyncResult()
     {
         PGresult *result = getResult();
@@ -225,6 +274,38 @@ public:
         return std::make_shared<ResultSet>(result);
     }
 
+    // Starts a COPY ... TO STDOUT, its data is then read with getCopyData().
+    bool startCopy(std::string const& sql)
+    {
+        PGresult *result = PQexec(conn_, sql.c_str());
+        bool ok = (result && (PQresultStatus(result) == PGRES_COPY_OUT));
+        if ( result ) PQclear(result);
+        return ok;
+    }
+
+    // Appends the next message of the copy started to data. Returns false
+    // once all of it was read, throws if the copy failed.
+    bool getCopyData(std::string & data)
+    {
+        char * buffer = nullptr;
+        int size = PQgetCopyData(conn_, &buffer, 0);
+        if (size > 0)
+        {
+            data.append(buffer, size);
+            PQfreemem(buffer);
+            return true;
+        }
+        PGresult *result = PQgetResult(conn_);
+        bool ok = (size == -1 && result && (PQresultStatus(result) == PGRES_COMMAND_OK));
+        std::string err_msg = ok ? std::string() : status();
+        clearAsyncResult(result);
+        if ( ! ok )
+        {
+            throw mapnik::datasource_exception("Postgis Plugin: COPY failed: " + err_msg);
+        }
+        return false;
+    }
+
     std::string client_encoding() const
     {
         return PQparameterStatus(conn_, "client_encoding");
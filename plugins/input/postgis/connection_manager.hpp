@@ -113,6 +113,8 @@ private:
 
 public:
 
+    // Pools are created empty, call PoolType::warm_up() on the result of
+    // getPool() to open the initial connections.
     bool registerPool(ConnectionCreator<Connection> const& creator,unsigned initialSize,unsigned maxSize)
     {
         ContType::const_iterator itr = pools_.find(creator.id());
@@ -30,10 +30,14 @@
 #include <mapnik/debug.hpp>
 #include <mapnik/global.hpp>
 #include <mapnik/boolean.hpp>
+#include <mapnik/datasource_metadata_cache.hpp>
+#include <mapnik/sql_filter.hpp>
 #include <mapnik/sql_utils.hpp>
 #include <mapnik/util/conversions.hpp>
 #include <mapnik/timer.hpp>
 #include <mapnik/value/types.hpp>
+#include <mapnik/trace.hpp>
+#include <mapnik/executor.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -71,6 +75,7 @@ postgis_datasource::postgis_datasource(parameters const& params)
       srid_(*params.get<mapnik::value_integer>("srid", 0)),
       extent_initialized_(false),
       simplify_geometries_(false),
+      reduce_geometries_(false),
       desc_(postgis_datasource::name(), "utf-8"),
       creator_(params.get<std::string>("host"),
              params.get<std::string>("port"),
@@ -84,6 +89,7 @@ postgis_datasource::postgis_datasource(parameters const& params)
       max_async_connections_(*params_.get<mapnik::value_integer>("max_async_connection", 1)),
       asynchronous_request_(false),
       twkb_encoding_(false),
+      background_decode_(false),
       twkb_rounding_adjustment_(*params_.get<mapnik::value_double>("twkb_rounding_adjustment", 0.0)),
       simplify_snap_ratio_(*params_.get<mapnik::value_double>("simplify_snap_ratio", 1.0/40.0)),
       // 1/20 of pixel seems to be a good compromise to avoid
@@ -132,31 +138,98 @@ postgis_datasource::postgis_datasource(parameters const& params)
     boost::optional<mapnik::boolean_type> autodetect_key_field = params.get<mapnik::boolean_type>("autodetect_key_field", false);
     boost::optional<mapnik::boolean_type> estimate_extent = params.get<mapnik::boolean_type>("estimate_extent", false);
     estimate_extent_ = estimate_extent && *estimate_extent;
+    // reduce_geometries snaps, simplifies and clips every geometry to the
+    // query's resolution and buffered bbox, without hand written tokens
+    boost::optional<mapnik::boolean_type> reduce_opt = params.get<mapnik::boolean_type>("reduce_geometries", false);
+    reduce_geometries_ = reduce_opt && *reduce_opt;
     boost::optional<mapnik::boolean_type> simplify_opt = params.get<mapnik::boolean_type>("simplify_geometries", false);
-    simplify_geometries_ = simplify_opt && *simplify_opt;
+    simplify_geometries_ = (simplify_opt && *simplify_opt) || reduce_geometries_;
 
-    boost::optional<mapnik::boolean_type> twkb_opt = params.get<mapnik::boolean_type>("twkb_encoding", false);
-    twkb_encoding_ = twkb_opt && *twkb_opt;
+    boost::optional<std::string> geometry_encoding = params.get<std::string>("geometry_encoding");
+    if (geometry_encoding)
+    {
+        if (*geometry_encoding == "twkb")
+        {
+            twkb_encoding_ = true;
+        }
+        else if (*geometry_encoding != "wkb")
+        {
+            throw mapnik::datasource_exception("Postgis Plugin: unknown geometry_encoding '"
+                                               + *geometry_encoding + "', expected 'wkb' or 'twkb'");
+        }
+    }
+    else
+    {
+        // older spelling of geometry_encoding=twkb
+        boost::optional<mapnik::boolean_type> twkb_opt = params.get<mapnik::boolean_type>("twkb_encoding", false);
+        twkb_encoding_ = twkb_opt && *twkb_opt;
+    }
+
+    // asynchronous result sets share the processor context with the
+    // render thread, so only plain and cursor queries decode in the background
+    boost::optional<mapnik::boolean_type> background_decode_opt = params.get<mapnik::boolean_type>("background_decode", false);
+    background_decode_ = background_decode_opt && *background_decode_opt && !asynchronous_request_;
 
-    boost::optional<mapnik::boolean_type> simplify_preserve_opt = params.get<mapnik::boolean_type>("simplify_dp_preserve", false);
-    simplify_dp_preserve_ = simplify_preserve_opt && *simplify_preserve_opt;
+    // reduced geometries keep the features collapsing below a pixel,
+    // unless asked otherwise
+    boost::optional<mapnik::boolean_type> simplify_preserve_opt = params.get<mapnik::boolean_type>("simplify_dp_preserve");
+    simplify_dp_preserve_ = simplify_preserve_opt ? bool(*simplify_preserve_opt) : reduce_geometries_;
+
+    boost::optional<mapnik::boolean_type> background_connect = params.get<mapnik::boolean_type>("background_connect", false);
+    metadata_key_ = mapnik::datasource_metadata_cache::make_key(params);
 
     ConnectionManager::instance().registerPool(creator_, *initial_size, pool_max_size_);
     CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
     if (pool)
     {
+#ifdef MAPNIK_THREADSAFE
+        std::shared_ptr<mapnik::executor> io = mapnik::get_io_executor();
+        if (background_connect && *background_connect && io->concurrency() > 0)
+        {
+            // open the remaining initial_size connections without
+            // holding up datasource creation, nor rendering threads
+            io->post([pool]() {
+                try
+                {
+                    pool->warm_up();
+                }
+                catch (std::exception const& ex)
+                {
+                    MAPNIK_LOG_ERROR(postgis) << "postgis_datasource: background connect failed: " << ex.what();
+                }
+            });
+        }
+        else
+#endif
+        {
+            pool->warm_up();
+        }
+
         shared_ptr<Connection> conn = pool->borrowObject();
         if (!conn) return;
 
-        if (conn->isOK())
+        mapnik::sql_utils::table_from_sql(
+                geometry_table_.empty() ? table_ : geometry_table_,
+                parsed_schema_, parsed_table_);
+
+        auto & metadata_cache = mapnik::datasource_metadata_cache::instance();
+        if (metadata_cache.enabled() && conn->isOK())
+        {
+            metadata_stamp_ = relation_stamp(*conn, parsed_schema_, parsed_table_);
+        }
+        boost::optional<mapnik::datasource_metadata> metadata =
+            metadata_cache.find(metadata_key_, metadata_stamp_);
+        if (metadata)
+        {
+            // learned by an earlier datasource with the same parameters,
+            // about the relation as it still is
+            apply_metadata(*metadata);
+        }
+        else if (conn->isOK())
         {
 
             desc_.set_encoding(conn->client_encoding());
 
-            mapnik::sql_utils::table_from_sql(
-                    geometry_table_.empty() ? table_ : geometry_table_,
-                    parsed_schema_, parsed_table_);
-
             // NOTE: parsed_table_ now should ideally be a table name, but
             // there are known edge cases where this will break down and
             // it may even be empty: https://github.com/mapnik/mapnik/issues/2718
@@ -412,7 +485,10 @@ postgis_datasource::postgis_datasource(parameters const& params)
                         break;
                     case 700:   // float4
                     case 701:   // float8
+                        desc_.add_descriptor(attribute_descriptor(fld_name, mapnik::Double));
+                        break;
                     case 1700:  // numeric
+                        numeric_fields_.insert(fld_name);
                         desc_.add_descriptor(attribute_descriptor(fld_name, mapnik::Double));
                         break;
                     case 1042:  // bpchar
@@ -449,6 +525,7 @@ postgis_datasource::postgis_datasource(parameters const& params)
 
             rs->close();
 
+            metadata_cache.insert(metadata_key_, make_metadata());
         }
 
         // Close explicitly the connection so we can 'fork()' without sharing open connections
@@ -465,6 +542,47 @@ postgis_datasource::postgis_datasource(parameters const& params)
     }
 }
 
+mapnik::datasource_metadata postgis_datasource::make_metadata() const
+{
+    mapnik::datasource_metadata metadata;
+    metadata.stamp = metadata_stamp_;
+    metadata.encoding = desc_.get_encoding();
+    metadata.descriptors = desc_.get_descriptors();
+    if (extent_initialized_)
+    {
+        metadata.extent = extent_;
+    }
+    metadata.extra["geometry_column"] = geometryColumn_;
+    metadata.extra["key_field"] = key_field_;
+    metadata.extra["srid"] = std::to_string(srid_);
+    for (std::string const& name : numeric_fields_)
+    {
+        metadata.extra["numeric:" + name] = name;
+    }
+    return metadata;
+}
+
+void postgis_datasource::apply_metadata(mapnik::datasource_metadata const& metadata)
+{
+    desc_.set_encoding(metadata.encoding);
+    for (auto const& attr : metadata.descriptors)
+    {
+        desc_.add_descriptor(attr);
+    }
+    for (auto const& kv : metadata.extra)
+    {
+        if (kv.first == "geometry_column") geometryColumn_ = kv.second;
+        else if (kv.first == "key_field") key_field_ = kv.second;
+        else if (kv.first == "srid") mapnik::util::string2int(kv.second, srid_);
+        else if (boost::algorithm::starts_with(kv.first, "numeric:")) numeric_fields_.insert(kv.second);
+    }
+    if (metadata.extent && !extent_initialized_)
+    {
+        extent_ = *metadata.extent;
+        extent_initialized_ = true;
+    }
+}
+
 postgis_datasource::~postgis_datasource()
 {
     if (! persist_connection_)
@@ -502,7 +620,20 @@ mapnik::datasource::datasource_t postgis_datasource::type() const
 
 layer_descriptor postgis_datasource::get_descriptor() const
 {
-    return desc_;
+    layer_descriptor desc(desc_);
+    CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
+    if (pool)
+    {
+        mapnik::pool_stats stats = pool->stats();
+        mapnik::parameters & extra_params = desc.get_extra_parameters();
+        extra_params["pool_size"] = mapnik::value_integer(stats.size);
+        extra_params["pool_checkouts"] = mapnik::value_integer(stats.checkouts);
+        extra_params["pool_affinity_hits"] = mapnik::value_integer(stats.affinity_hits);
+        extra_params["pool_created"] = mapnik::value_integer(stats.created);
+        extra_params["pool_exhausted"] = mapnik::value_integer(stats.exhausted);
+        extra_params["pool_wait_us"] = mapnik::value_integer(stats.wait_us);
+    }
+    return desc;
 }
 
 std::string postgis_datasource::sql_bbox(box2d<double> const& env) const
@@ -541,7 +672,8 @@ std::string postgis_datasource::populate_tokens(
                                 double pixel_width,
                                 double pixel_height,
                                 mapnik::attributes const& vars,
-                                bool intersect) const
+                                bool intersect,
+                                std::string const& filter) const
 {
     std::ostringstream populated_sql;
     std::cmatch m;
@@ -593,6 +725,7 @@ std::string postgis_datasource::populate_tokens(
 
     populated_sql.write(start, end - start);
 
+    bool where = false;
     if (intersect)
     {
         if (intersect_min_scale_ > 0 && (scale_denom <= intersect_min_scale_))
@@ -600,6 +733,7 @@ std::string postgis_datasource::populate_tokens(
             populated_sql << " WHERE ST_Intersects("
                           << identifier(geometryColumn_) << ", "
                           << sql_bbox(env) << ")";
+            where = true;
         }
         else if (intersect_max_scale_ > 0 && (scale_denom >= intersect_max_scale_))
         {
@@ -610,12 +744,40 @@ std::string postgis_datasource::populate_tokens(
             populated_sql << " WHERE "
                           << identifier(geometryColumn_) << " && "
                           << sql_bbox(env);
+            where = true;
         }
     }
 
+    if (!filter.empty())
+    {
+        populated_sql << (where ? " AND (" : " WHERE (") << filter << ")";
+    }
+
     return populated_sql.str();
 }
 
+void postgis_datasource::append_attribute(std::ostream & os, std::string const& name) const
+{
+    os << ',' << identifier(name);
+    if (numeric_fields_.count(name) > 0)
+    {
+        // the server casts into the binary float8 the featureset
+        // reads directly, rather than shipping numeric digits for
+        // the client to convert through a string
+        os << "::float8 AS " << identifier(name);
+    }
+}
+
+void postgis_datasource::append_order_by(std::ostream & os, std::string const& name) const
+{
+    // the server sorts the rows of the groups the render asks for, unless
+    // the table sql orders them itself
+    if (!name.empty() && !boost::algorithm::icontains(table_, "order by"))
+    {
+        os << " ORDER BY " << identifier(name);
+    }
+}
+
 void postgis_datasource::append_geometry_table(std::ostream & os) const
 {
     if (!geometry_table_.empty())
@@ -636,7 +798,8 @@ void postgis_datasource::append_geometry_table(std::ostream & os) const
     }
 }
 
-std::shared_ptr<IResultSet> postgis_datasource::get_resultset(std::shared_ptr<Connection> &conn, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx) const
+std::shared_ptr<IResultSet> postgis_datasource::get_resultset(std::shared_ptr<Connection> &conn, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx,
+                                                              mapnik::cancel_token_ptr const& cancel) const
 {
 
     if (!ctx)
@@ -673,12 +836,12 @@ std::shared_ptr<IResultSet> postgis_datasource::get_resultset(std::shared_ptr<Co
         {
             // lauch async req & create asyncresult with conn
             conn->executeAsyncQuery(sql, 1);
-            return std::make_shared<AsyncResultSet>(pgis_ctxt, pool, conn, sql);
+            return std::make_shared<AsyncResultSet>(pgis_ctxt, pool, conn, sql, cancel);
         }
         else
         {
             // create asyncresult  with  null connection
-            std::shared_ptr<AsyncResultSet> res = std::make_shared<AsyncResultSet>(pgis_ctxt, pool,  conn, sql);
+            std::shared_ptr<AsyncResultSet> res = std::make_shared<AsyncResultSet>(pgis_ctxt, pool,  conn, sql, cancel);
             pgis_ctxt->add_request(res);
             return res;
         }
@@ -706,6 +869,7 @@ processor_context_ptr postgis_datasource::get_context(feature_style_context_map
 
 featureset_ptr postgis_datasource::features(query const& q) const
 {
+    mapnik::trace::scope query_trace("datasource", "postgis.features");
     // if the driver is in asynchronous mode, return the appropriate fetaures
     if (asynchronous_request_ )
     {
@@ -733,6 +897,7 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
     if (pool)
     {
         shared_ptr<Connection> conn;
+        mapnik::datasource_stats wait_stats;
 
         if ( asynchronous_request_ )
         {
@@ -740,6 +905,7 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
             std::shared_ptr<postgis_processor_context> pgis_ctxt = std::static_pointer_cast<postgis_processor_context>(proc_ctx);
             if ( pgis_ctxt->num_async_requests_ < max_async_connections_ )
             {
+                mapnik::datasource_stats_timer wait_timer(&wait_stats.wait);
                 conn = pool->borrowObject();
                 pgis_ctxt->num_async_requests_++;
             }
@@ -747,12 +913,16 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
         else
         {
             // Always get a connection in synchronous mode
-            conn = pool->borrowObject();
+            {
+                mapnik::datasource_stats_timer wait_timer(&wait_stats.wait);
+                conn = pool->borrowObject();
+            }
             if(!conn )
             {
                 throw mapnik::datasource_exception("Postgis Plugin: Null connection");
             }
         }
+        counters().add(wait_stats);
 
 
         if (geometryColumn_.empty())
@@ -773,6 +943,7 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
         const double px_gw = 1.0 / std::get<0>(q.resolution());
         const double px_gh = 1.0 / std::get<1>(q.resolution());
         const double px_sz = std::min(px_gw, px_gh);
+        const bool clip = reduce_geometries_ || (simplify_clip_resolution_ > 0.0 && simplify_clip_resolution_ > px_sz);
 
         if (twkb_encoding_)
         {
@@ -790,14 +961,14 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
             s << "ST_Simplify(";
             s << "ST_RemoveRepeatedPoints(";
 
-            if (simplify_clip_resolution_ > 0.0 && simplify_clip_resolution_ > px_sz)
+            if (clip)
             {
                 s << "ST_ClipByBox2D(";
             }
             s << identifier(geometryColumn_);
 
             // ! ST_ClipByBox2D()
-            if (simplify_clip_resolution_ > 0.0 && simplify_clip_resolution_ > px_sz)
+            if (clip)
             {
                 s << "," << sql_bbox(box) << ")";
             }
@@ -816,7 +987,7 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
             {
                 s << "ST_Simplify(";
             }
-            if (simplify_clip_resolution_ > 0.0 && simplify_clip_resolution_ > px_sz)
+            if (clip)
             {
                 s << "ST_ClipByBox2D(";
             }
@@ -836,7 +1007,7 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
             }
 
             // ! ST_ClipByBox2D()
-            if (simplify_clip_resolution_ > 0.0 && simplify_clip_resolution_ > px_sz)
+            if (clip)
             {
                 s << "," << sql_bbox(box) << ")";
             }
@@ -874,7 +1045,7 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
             {
                 if (*pos != key_field_)
                 {
-                    s << ',' << identifier(*pos);
+                    append_attribute(s, *pos);
                     ctx->push(*pos);
                 }
             }
@@ -883,23 +1054,34 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
         {
             for (; pos != end; ++pos)
             {
-                s << ',' << identifier(*pos);
+                append_attribute(s, *pos);
                 ctx->push(*pos);
             }
         }
 
-        std::string table_with_bbox = populate_tokens(table_, scale_denom, box, px_gw, px_gh, q.variables());
+        // leave out the rows none of the rules drawing the layer match
+        std::string filter;
+        if (q.get_filter())
+        {
+            filter = mapnik::sql_utils::filter_to_sql(*q.get_filter(), desc_, q.variables());
+        }
+
+        std::string table_with_bbox = populate_tokens(table_, scale_denom, box, px_gw, px_gh,
+                                                      q.variables(), true, filter);
 
         s << " FROM " << table_with_bbox;
 
+        append_order_by(s, q.order_by());
+
         if (row_limit_ > 0)
         {
             s << " LIMIT " << row_limit_;
         }
 
-        std::shared_ptr<IResultSet> rs = get_resultset(conn, s.str(), pool, proc_ctx);
+        std::shared_ptr<IResultSet> rs = get_resultset(conn, s.str(), pool, proc_ctx, q.get_cancel_token());
         return std::make_shared<postgis_featureset>(rs, ctx, desc_.get_encoding(), !key_field_.empty(),
-                                                    key_field_as_attribute_, twkb_encoding_);
+                                                    key_field_as_attribute_, twkb_encoding_,
+                                                    background_decode_, q.feature_arena(), &counters());
 
     }
 
@@ -907,6 +1089,51 @@ featureset_ptr postgis_datasource::features_with_context(query const& q,processo
 }
 
 
+boost::optional<std::size_t> postgis_datasource::estimate_features(query const& q) const
+{
+    // the planner's row estimate for the query's table and bbox
+    if (geometryColumn_.empty()) return boost::none;
+    CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
+    if (!pool) return boost::none;
+    shared_ptr<Connection> conn = pool->borrowObject();
+    if (!conn || !conn->isOK()) return boost::none;
+
+    const double px_gw = 1.0 / std::get<0>(q.resolution());
+    const double px_gh = 1.0 / std::get<1>(q.resolution());
+    // restricted to the bbox and filter as features_with_context does, a
+    // plain table name would otherwise be estimated whole
+    std::string filter;
+    if (q.get_filter())
+    {
+        filter = mapnik::sql_utils::filter_to_sql(*q.get_filter(), desc_, q.variables());
+    }
+    std::ostringstream s;
+    s << "EXPLAIN SELECT 1 FROM "
+      << populate_tokens(table_, q.scale_denominator(), q.get_bbox(), px_gw, px_gh,
+                         q.variables(), true, filter);
+    try
+    {
+        shared_ptr<ResultSet> rs = conn->executeQuery(s.str());
+        if (!rs->next()) return boost::none;
+        // e.g. "Index Scan using ... (cost=0.28..8.29 rows=1 width=4)"
+        std::string plan(rs->getValue(0));
+        std::string::size_type pos = plan.find(" rows=");
+        if (pos == std::string::npos) return boost::none;
+        pos += 6;
+        std::string::size_type end = plan.find_first_not_of("0123456789", pos);
+        mapnik::value_integer rows = 0;
+        if (!mapnik::util::string2int(plan.substr(pos, end - pos), rows) || rows < 0) return boost::none;
+        std::size_t count = static_cast<std::size_t>(rows);
+        if (row_limit_ > 0) count = std::min(count, static_cast<std::size_t>(row_limit_));
+        return count;
+    }
+    catch (mapnik::datasource_exception const& ex)
+    {
+        MAPNIK_LOG_DEBUG(postgis) << "postgis_datasource: estimate failed - " << ex.what();
+        return boost::none;
+    }
+}
+
 featureset_ptr postgis_datasource::features_at_point(coord2d const& pt, double tol) const
 {
 #ifdef MAPNIK_STATS
@@ -915,7 +1142,13 @@ featureset_ptr postgis_datasource::features_at_point(coord2d const& pt, double t
     CnxPool_ptr pool = ConnectionManager::instance().getPool(creator_.id());
     if (pool)
     {
-        shared_ptr<Connection> conn = pool->borrowObject();
+        mapnik::datasource_stats wait_stats;
+        shared_ptr<Connection> conn;
+        {
+            mapnik::datasource_stats_timer wait_timer(&wait_stats.wait);
+            conn = pool->borrowObject();
+        }
+        counters().add(wait_stats);
         if (!conn) return mapnik::make_invalid_featureset();
 
         if (conn->isOK())
@@ -952,7 +1185,7 @@ featureset_ptr postgis_datasource::features_at_point(coord2d const& pt, double t
                     std::string const& name = attr_info.get_name();
                     if (name != key_field_)
                     {
-                        s << ',' << identifier(name);
+                        append_attribute(s, name);
                         ctx->push(name);
                     }
                 }
@@ -962,7 +1195,7 @@ featureset_ptr postgis_datasource::features_at_point(coord2d const& pt, double t
                 for (auto const& attr_info : desc)
                 {
                     std::string const& name = attr_info.get_name();
-                    s << ',' << identifier(name);
+                    append_attribute(s, name);
                     ctx->push(name);
                 }
             }
@@ -979,8 +1212,9 @@ featureset_ptr postgis_datasource::features_at_point(coord2d const& pt, double t
             }
 
             std::shared_ptr<IResultSet> rs = get_resultset(conn, s.str(), pool);
+            // point queries always select ST_AsBinary
             return std::make_shared<postgis_featureset>(rs, ctx, desc_.get_encoding(), !key_field_.empty(),
-                                                        key_field_as_attribute_, twkb_encoding_);
+                                                        key_field_as_attribute_, false, false, false, &counters());
         }
     }
 
@@ -1060,6 +1294,12 @@ box2d<double> postgis_datasource::envelope() const
                 {
                     extent_.init(lox, loy, hix, hiy);
                     extent_initialized_ = true;
+                    auto & cache = mapnik::datasource_metadata_cache::instance();
+                    if (auto metadata = cache.find(metadata_key_, metadata_stamp_))
+                    {
+                        metadata->extent = extent_;
+                        cache.insert(metadata_key_, *metadata);
+                    }
                 }
                 else
                 {
@@ -1074,6 +1314,23 @@ box2d<double> postgis_datasource::envelope() const
 }
 
 boost::optional<mapnik::datasource_geometry_t> postgis_datasource::get_geometry_type() const
+{
+    auto & cache = mapnik::datasource_metadata_cache::instance();
+    boost::optional<mapnik::datasource_metadata> metadata = cache.find(metadata_key_, metadata_stamp_);
+    if (metadata && metadata->geometry_type)
+    {
+        return metadata->geometry_type;
+    }
+    boost::optional<mapnik::datasource_geometry_t> result = detect_geometry_type();
+    if (metadata && result)
+    {
+        metadata->geometry_type = result;
+        cache.insert(metadata_key_, *metadata);
+    }
+    return result;
+}
+
+boost::optional<mapnik::datasource_geometry_t> postgis_datasource::detect_geometry_type() const
 {
     boost::optional<mapnik::datasource_geometry_t> result;
 
@@ -34,6 +34,7 @@
 #include <mapnik/unicode.hpp>
 #include <mapnik/value/types.hpp>
 #include <mapnik/attribute.hpp>
+#include <mapnik/datasource_metadata_cache.hpp>
 
 // boost
 #include <boost/optional.hpp>
@@ -41,12 +42,14 @@
 // stl
 #include <memory>
 #include <regex>
+#include <set>
 #include <vector>
 #include <string>
 
 #include "connection_manager.hpp"
 #include "resultset.hpp"
 #include "cursorresultset.hpp"
+#include "relation_stamp.hpp"
 
 using mapnik::transcoder;
 using mapnik::datasource;
@@ -73,6 +76,7 @@ public:
     featureset_ptr features_with_context(query const& q, processor_context_ptr ctx) const;
     featureset_ptr features(query const& q) const;
     featureset_ptr features_at_point(coord2d const& pt, double tol = 0) const;
+    boost::optional<std::size_t> estimate_features(query const& q) const;
     mapnik::box2d<double> envelope() const;
     boost::optional<mapnik::datasource_geometry_t> get_geometry_type() const;
     layer_descriptor get_descriptor() const;
@@ -85,10 +89,17 @@ private:
                                 double pixel_width,
                                 double pixel_height,
                                 mapnik::attributes const& vars,
-                                bool intersect = true) const;
+                                bool intersect = true,
+                                std::string const& filter = std::string()) const;
     std::string populate_tokens(std::string const& sql) const;
+    boost::optional<mapnik::datasource_geometry_t> detect_geometry_type() const;
+    mapnik::datasource_metadata make_metadata() const;
+    void apply_metadata(mapnik::datasource_metadata const& metadata);
     void append_geometry_table(std::ostream & os) const;
-    std::shared_ptr<IResultSet> get_resultset(std::shared_ptr<Connection> &conn, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx= processor_context_ptr()) const;
+    void append_attribute(std::ostream & os, std::string const& name) const;
+    void append_order_by(std::ostream & os, std::string const& name) const;
+    std::shared_ptr<IResultSet> get_resultset(std::shared_ptr<Connection> &conn, std::string const& sql, CnxPool_ptr const& pool, processor_context_ptr ctx= processor_context_ptr(),
+                                              mapnik::cancel_token_ptr const& cancel = mapnik::cancel_token_ptr()) const;
     static const std::string GEOMETRY_COLUMNS;
     static const std::string SPATIAL_REF_SYS;
 
@@ -109,6 +120,7 @@ private:
     mutable bool extent_initialized_;
     mutable mapnik::box2d<double> extent_;
     bool simplify_geometries_;
+    bool reduce_geometries_;
     layer_descriptor desc_;
     ConnectionCreator<Connection> creator_;
     int pool_max_size_;
@@ -118,6 +130,7 @@ private:
     int max_async_connections_;
     bool asynchronous_request_;
     bool twkb_encoding_;
+    bool background_decode_;
     mapnik::value_double twkb_rounding_adjustment_;
     mapnik::value_double simplify_snap_ratio_;
     mapnik::value_double simplify_dp_ratio_;
@@ -128,6 +141,12 @@ private:
     int intersect_min_scale_;
     int intersect_max_scale_;
     bool key_field_as_attribute_;
+    // numeric columns, fetched as float8 instead of the variable length numeric format
+    std::set<std::string> numeric_fields_;
+    // what the constructor queries, shared through the metadata cache
+    std::string metadata_key_;
+    // relation_stamp() of the table, empty unless the cache is enabled
+    std::string metadata_stamp_;
 };
 
 #endif // POSTGIS_DATASOURCE_HPP
@@ -45,12 +45,25 @@ using mapnik::geometry_utils;
 using mapnik::feature_factory;
 using mapnik::context_ptr;
 
+#ifdef MAPNIK_THREADSAFE
+namespace {
+
+// features decoded per hand off, and how far the worker may run ahead
+constexpr std::size_t decode_batch_size = 256;
+constexpr std::size_t max_queued_batches = 4;
+
+}
+#endif
+
 postgis_featureset::postgis_featureset(std::shared_ptr<IResultSet> const& rs,
                                        context_ptr const& ctx,
                                        std::string const& encoding,
                                        bool key_field,
                                        bool key_field_as_attribute,
-                                       bool twkb_encoding)
+                                       bool twkb_encoding,
+                                       bool background_decode,
+                                       bool feature_arena,
+                                       mapnik::datasource_counters * counters)
     : rs_(rs),
       ctx_(ctx),
       tr_(new transcoder(encoding)),
@@ -58,14 +71,120 @@ postgis_featureset::postgis_featureset(std::shared_ptr<IResultSet> const& rs,
       feature_id_(1),
       key_field_(key_field),
       key_field_as_attribute_(key_field_as_attribute),
-      twkb_encoding_(twkb_encoding)
+      twkb_encoding_(twkb_encoding),
+      arena_(feature_arena ? std::make_shared<mapnik::feature_arena>() : nullptr),
+      stats_(counters)
+#ifdef MAPNIK_THREADSAFE
+      ,batch_(),
+      batch_pos_(0),
+      worker_(),
+      mutex_(),
+      queue_cond_(),
+      queue_(),
+      error_(),
+      done_(false),
+      stop_(false)
+#endif
 {
+    stats_->queries = 1;
+#ifdef MAPNIK_THREADSAFE
+    if (background_decode)
+    {
+        worker_ = std::thread(&postgis_featureset::decode_loop, this);
+    }
+#else
+    (void)background_decode;
+#endif
 }
 
 feature_ptr postgis_featureset::next()
+{
+#ifdef MAPNIK_THREADSAFE
+    if (worker_.joinable())
+    {
+        if (batch_pos_ == batch_.size())
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_cond_.wait(lock, [this] { return !queue_.empty() || done_; });
+            if (queue_.empty())
+            {
+                if (error_)
+                {
+                    std::exception_ptr error = error_;
+                    error_ = nullptr;
+                    std::rethrow_exception(error);
+                }
+                return feature_ptr();
+            }
+            batch_ = std::move(queue_.front());
+            queue_.pop_front();
+            batch_pos_ = 0;
+            lock.unlock();
+            queue_cond_.notify_all();
+        }
+        // queued batches are never empty
+        return std::move(batch_[batch_pos_++]);
+    }
+#endif
+    return decode_next();
+}
+
+#ifdef MAPNIK_THREADSAFE
+void postgis_featureset::decode_loop()
+{
+    try
+    {
+        bool more = true;
+        while (more)
+        {
+            std::vector<feature_ptr> batch;
+            batch.reserve(decode_batch_size);
+            while (batch.size() < decode_batch_size)
+            {
+                feature_ptr feature = decode_next();
+                if (!feature)
+                {
+                    more = false;
+                    break;
+                }
+                batch.push_back(std::move(feature));
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_cond_.wait(lock, [this] { return queue_.size() < max_queued_batches || stop_; });
+            if (stop_) break;
+            if (!batch.empty()) queue_.push_back(std::move(batch));
+            done_ = !more;
+            lock.unlock();
+            queue_cond_.notify_all();
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+        done_ = true;
+    }
+    queue_cond_.notify_all();
+}
+
+void postgis_featureset::stop_decoding()
+{
+    if (!worker_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    queue_cond_.notify_all();
+    worker_.join();
+}
+#endif
+
+feature_ptr postgis_featureset::decode_next()
 {
     while (rs_->next())
     {
+        // fetching the rows is left out of the decoding time
+        mapnik::datasource_stats_timer decode_timer(stats_ ? &stats_->decode : nullptr);
         // new feature
         unsigned pos = 1;
         feature_ptr feature;
@@ -78,6 +197,7 @@ feature_ptr postgis_featureset::next()
             if (rs_->isNull(pos))
             {
                 MAPNIK_LOG_WARN(postgis) << "postgis_featureset: null value encountered for key_field: " << name;
+                ++stats_->filtered;
                 continue;
             }
             // create feature with user driven id from attribute
@@ -100,7 +220,7 @@ feature_ptr postgis_featureset::next()
                 val = int4net(buf);
             }
 
-            feature = feature_factory::create(ctx_, val);
+            feature = feature_factory::create(ctx_, val, arena_);
             if (key_field_as_attribute_)
             {
                 feature->put<mapnik::value_integer>(name,val);
@@ -110,7 +230,7 @@ feature_ptr postgis_featureset::next()
         else
         {
             // fallback to auto-incrementing id
-            feature = feature_factory::create(ctx_, feature_id_);
+            feature = feature_factory::create(ctx_, feature_id_, arena_);
             ++feature_id_;
         }
 
@@ -118,6 +238,7 @@ feature_ptr postgis_featureset::next()
         if (rs_->isNull(0))
         {
             MAPNIK_LOG_WARN(postgis) << "postgis_featureset: null value encountered for geometry";
+            ++stats_->filtered;
             continue;
         }
 
@@ -135,6 +256,7 @@ feature_ptr postgis_featureset::next()
         }
 
         totalGeomSize_ += size;
+        stats_->bytes_read += size;
         unsigned num_attrs = ctx_->size() + 1;
         if (!key_field_as_attribute_)
         {
@@ -150,6 +272,7 @@ feature_ptr postgis_featureset::next()
             {
                 const char* buf = rs_->getValue(pos);
                 const int oid = rs_->getTypeOID(pos);
+                stats_->bytes_read += rs_->getFieldLength(pos);
                 switch (oid)
                 {
                     case 16: //bool
@@ -227,13 +350,19 @@ feature_ptr postgis_featureset::next()
                 }
             }
         }
+        ++stats_->features;
         return feature;
     }
+    stats_.flush();
     return feature_ptr();
 }
 
 
 postgis_featureset::~postgis_featureset()
 {
+#ifdef MAPNIK_THREADSAFE
+    // the worker may still be fetching from rs_
+    stop_decoding();
+#endif
     rs_->close();
 }
@@ -27,7 +27,19 @@
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/datasource.hpp>
 #include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
 #include <mapnik/unicode.hpp>
+#include <mapnik/datasource_stats.hpp>
+
+// stl
+#ifdef MAPNIK_THREADSAFE
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
 
 using mapnik::Featureset;
 using mapnik::box2d;
@@ -45,11 +57,20 @@ public:
                        std::string const& encoding,
                        bool key_field,
                        bool key_field_as_attribute,
-                       bool twkb_encoding);
+                       bool twkb_encoding,
+                       bool background_decode = false,
+                       bool feature_arena = false,
+                       mapnik::datasource_counters * counters = nullptr);
     feature_ptr next();
     ~postgis_featureset();
 
 private:
+    feature_ptr decode_next();
+#ifdef MAPNIK_THREADSAFE
+    void decode_loop();
+    void stop_decoding();
+#endif
+
     std::shared_ptr<IResultSet> rs_;
     context_ptr ctx_;
     const std::unique_ptr<mapnik::transcoder> tr_;
@@ -58,6 +79,23 @@ private:
     bool key_field_;
     bool key_field_as_attribute_;
     bool twkb_encoding_;
+    // features are only ever built on one thread, next()'s or the worker's
+    mapnik::feature_arena_ptr arena_;
+    // counted on the thread decoding features
+    mapnik::datasource_stats_batch stats_;
+#ifdef MAPNIK_THREADSAFE
+    // background decoding: a worker thread drains rs_ (fetching further
+    // cursor batches as needed) and queues decoded features for next()
+    std::vector<feature_ptr> batch_;
+    std::size_t batch_pos_;
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable queue_cond_;
+    std::deque<std::vector<feature_ptr>> queue_;
+    std::exception_ptr error_;
+    bool done_;
+    bool stop_;
+#endif
 };
 
 #endif // POSTGIS_FEATURESET_HPP
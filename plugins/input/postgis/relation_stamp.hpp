@@ -0,0 +1,81 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef POSTGIS_RELATION_STAMP_HPP
+#define POSTGIS_RELATION_STAMP_HPP
+
+#include "connection.hpp"
+
+// mapnik
+#include <mapnik/debug.hpp>
+#include <mapnik/sql_utils.hpp>
+
+// stl
+#include <memory>
+#include <sstream>
+#include <string>
+
+// Stamp of a relation for the datasource metadata cache: its oid, storage
+// file and columns. A table dropped and recreated, rewritten or altered
+// gets a new stamp, and reading it is a single catalog lookup. Empty when
+// the relation can't be found, e.g. for tables parsed out of subqueries
+// that are not plain table names.
+inline std::string relation_stamp(Connection & conn, std::string const& schema, std::string const& table)
+{
+    using mapnik::sql_utils::identifier;
+    using mapnik::sql_utils::literal;
+    if (table.empty()) return std::string();
+    std::ostringstream name;
+    if (!schema.empty())
+    {
+        name << identifier(schema) << '.';
+    }
+    name << identifier(table);
+    std::string const qualified = name.str();
+    std::ostringstream s;
+    s << "SELECT c.oid::text || ':' || c.relfilenode::text || ':' || "
+         "md5(coalesce(string_agg(a.attname || ' ' || format_type(a.atttypid, a.atttypmod), ',' "
+         "ORDER BY a.attnum), '')) AS stamp"
+         " FROM pg_class c LEFT JOIN pg_attribute a"
+         " ON a.attrelid = c.oid AND a.attnum > 0 AND NOT a.attisdropped"
+         " WHERE c.oid = to_regclass(" << literal(qualified) << ")"
+         " GROUP BY c.oid, c.relfilenode";
+    try
+    {
+        std::shared_ptr<ResultSet> rs = conn.executeQuery(s.str());
+        std::string stamp;
+        if (rs->next())
+        {
+            stamp = rs->getValue("stamp");
+        }
+        rs->close();
+        return stamp;
+    }
+    catch (mapnik::datasource_exception const& ex)
+    {
+        // servers before 9.4 lack to_regclass
+        MAPNIK_LOG_DEBUG(postgis) << "relation_stamp: lookup failed - " << ex.what();
+        return std::string();
+    }
+}
+
+#endif // POSTGIS_RELATION_STAMP_HPP
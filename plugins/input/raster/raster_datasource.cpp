@@ -28,12 +28,17 @@
 #include <mapnik/view_transform.hpp>
 #include <mapnik/image_util.hpp>
 #include <mapnik/image_reader.hpp>
+#include <mapnik/image_tile_cache.hpp>
 #include <mapnik/boolean.hpp>
 
 #include "raster_featureset.hpp"
 #include "raster_info.hpp"
 #include "raster_datasource.hpp"
 
+// stl
+#include <algorithm>
+#include <thread>
+
 using mapnik::layer_descriptor;
 using mapnik::featureset_ptr;
 using mapnik::query;
@@ -64,6 +69,27 @@ raster_datasource::raster_datasource(parameters const& params)
     multi_tiles_ = *params.get<mapnik::boolean_type>("multi", false);
     tile_size_ = *params.get<mapnik::value_integer>("tile_size", 1024);
     tile_stride_ = *params.get<mapnik::value_integer>("tile_stride", 1);
+    mapnik::value_integer decode_threads = *params.get<mapnik::value_integer>("decode_threads", 1);
+    if (decode_threads < 1)
+    {
+        throw datasource_exception("Raster Plugin: <decode_threads> must be at least 1");
+    }
+    // more decoders than cores only contend for them
+    mapnik::value_integer cores = std::max(1u, std::thread::hardware_concurrency());
+    decode_threads_ = static_cast<unsigned>(std::min(decode_threads, cores));
+    tile_cache_ = *params.get<mapnik::boolean_type>("tile_cache", true);
+    decode_ahead_ = *params.get<mapnik::value_integer>("decode_ahead", 0);
+    decode_reduced_ = *params.get<mapnik::boolean_type>("decode_reduced", false);
+    // readers premultiply while decoding instead of the raster symbolizer
+    // afterwards; not for files holding premultiplied data already
+    decode_premultiplied_ = *params.get<mapnik::boolean_type>("decode_premultiplied", false);
+    // overviews of the file (tiff) are read when the map needs less detail;
+    // opt-in as they need not hold the same pixels as the full image
+    overviews_ = *params.get<mapnik::boolean_type>("overviews", false);
+    // multi tiles in a pyramid, level ${z} of the file pattern being 2^z
+    // times smaller; x_width and y_width should divide by 2^(levels - 1)
+    levels_ = *params.get<mapnik::value_integer>("levels", 1);
+    if (levels_ < 1) levels_ = 1;
 
     boost::optional<std::string> format_from_filename = mapnik::type_from_filename(*file);
     format_ = *params.get<std::string>("format",format_from_filename?(*format_from_filename) : "tiff");
@@ -197,9 +223,25 @@ featureset_ptr raster_datasource::features(query const& q) const
     {
         MAPNIK_LOG_DEBUG(raster) << "raster_datasource: Multi-Tiled policy";
 
-        tiled_multi_file_policy policy(filename_, format_, tile_size_, extent_, q.get_bbox(), width_, height_, tile_stride_);
+        mapnik::image_tile_cache & cache = mapnik::image_tile_cache::instance();
+        bool tile_cache = tile_cache_ && cache.max_bytes() > 0;
+        // the level with the fewest source pixels still covering a rendered one
+        unsigned level = 0;
+        if (levels_ > 1)
+        {
+            double ratio = width_ / (extent_.width() * std::get<0>(q.resolution())) / q.get_filter_factor();
+            while (level + 1 < levels_ && double(1u << (level + 1)) <= ratio) ++level;
+        }
+        MAPNIK_LOG_DEBUG(raster) << "raster_datasource: Pyramid level=" << level;
+        tiled_multi_file_policy policy(filename_, format_, tile_size_, extent_, q.get_bbox(),
+                                       width_ >> level, height_ >> level, tile_stride_,
+                                       tile_cache, tile_cache ? decode_ahead_ : 0, level);
+        for (std::string const& file : policy.neighbours())
+        {
+            cache.prefetch(file, format_, decode_threads_);
+        }
 
-        return std::make_shared<raster_featureset<tiled_multi_file_policy> >(policy, extent_, q);
+        return std::make_shared<raster_featureset<tiled_multi_file_policy> >(policy, extent_, q, decode_threads_, decode_reduced_, decode_premultiplied_, overviews_);
     }
     else if (width * height > static_cast<int>(tile_size_ * tile_size_ << 2))
     {
@@ -207,7 +249,7 @@ featureset_ptr raster_datasource::features(query const& q) const
 
         tiled_file_policy policy(filename_, format_, tile_size_, extent_, q.get_bbox(), width_, height_);
 
-        return std::make_shared<raster_featureset<tiled_file_policy> >(policy, extent_, q);
+        return std::make_shared<raster_featureset<tiled_file_policy> >(policy, extent_, q, decode_threads_, decode_reduced_, decode_premultiplied_, overviews_);
     }
     else
     {
@@ -216,7 +258,7 @@ featureset_ptr raster_datasource::features(query const& q) const
         raster_info info(filename_, format_, extent_, width_, height_);
         single_file_policy policy(info);
 
-        return std::make_shared<raster_featureset<single_file_policy> >(policy, extent_, q);
+        return std::make_shared<raster_featureset<single_file_policy> >(policy, extent_, q, decode_threads_, decode_reduced_, decode_premultiplied_, overviews_);
     }
 }
 
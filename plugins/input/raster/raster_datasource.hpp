@@ -64,6 +64,13 @@ private:
     bool multi_tiles_;
     unsigned tile_size_;
     unsigned tile_stride_;
+    unsigned decode_threads_;
+    bool tile_cache_;
+    unsigned decode_ahead_;
+    bool decode_reduced_;
+    bool decode_premultiplied_;
+    bool overviews_;
+    unsigned levels_;
     unsigned width_;
     unsigned height_;
 };
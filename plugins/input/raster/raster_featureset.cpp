@@ -26,6 +26,7 @@
 #include <mapnik/raster.hpp>
 #include <mapnik/view_transform.hpp>
 #include <mapnik/image_reader.hpp>
+#include <mapnik/image_tile_cache.hpp>
 #include <mapnik/image_util.hpp>
 #include <mapnik/feature_factory.hpp>
 #include <mapnik/util/variant.hpp>
@@ -38,6 +39,10 @@
 
 #include "raster_featureset.hpp"
 
+// stl
+#include <algorithm>
+#include <string>
+
 using mapnik::query;
 using mapnik::image_reader;
 using mapnik::feature_ptr;
@@ -48,7 +53,11 @@ using mapnik::feature_factory;
 template <typename LookupPolicy>
 raster_featureset<LookupPolicy>::raster_featureset(LookupPolicy const& policy,
                                                    box2d<double> const& extent,
-                                                   query const& q)
+                                                   query const& q,
+                                                   unsigned decode_threads,
+                                                   bool decode_reduced,
+                                                   bool decode_premultiplied,
+                                                   bool overviews)
     : policy_(policy),
       feature_id_(1),
       ctx_(std::make_shared<mapnik::context_type>()),
@@ -56,7 +65,12 @@ raster_featureset<LookupPolicy>::raster_featureset(LookupPolicy const& policy,
       bbox_(q.get_bbox()),
       curIter_(policy_.begin()),
       endIter_(policy_.end()),
-      filter_factor_(q.get_filter_factor())
+      filter_factor_(q.get_filter_factor()),
+      decode_threads_(decode_threads),
+      decode_reduced_(decode_reduced),
+      decode_premultiplied_(decode_premultiplied),
+      overviews_(overviews),
+      resolution_(q.resolution())
 {
 }
 
@@ -74,15 +88,42 @@ feature_ptr raster_featureset<LookupPolicy>::next()
 
         try
         {
-            std::unique_ptr<image_reader> reader(mapnik::get_image_reader(curIter_->file(),curIter_->format()));
+            std::unique_ptr<image_reader> reader;
+            mapnik::image_tile_cache::image_ptr tile;
+            if (policy_.tile_cache())
+            {
+                tile = mapnik::image_tile_cache::instance().get(curIter_->file(), curIter_->format(), decode_threads_);
+            }
+            else
+            {
+                reader.reset(mapnik::get_image_reader(curIter_->file(),curIter_->format()));
+            }
 
             MAPNIK_LOG_DEBUG(raster) << "raster_featureset: Reader=" << curIter_->format() << "," << curIter_->file()
                                      << ",size(" << curIter_->width() << "," << curIter_->height() << ")";
 
-            if (reader.get())
+            if (reader || tile)
             {
-                int image_width = policy_.img_width(reader->width());
-                int image_height = policy_.img_height(reader->height());
+                if (reader)
+                {
+                    reader->set_decode_threads(decode_threads_);
+                    reader->set_premultiply(decode_premultiplied_);
+                }
+                int image_width = policy_.img_width(reader ? reader->width() : tile->width());
+                int image_height = policy_.img_height(reader ? reader->height() : tile->height());
+                unsigned reduction = 1;
+                // overviews stored in the file and reductions made while
+                // decoding are only read when asked for
+                bool reduce = reader && (decode_reduced_ || (overviews_ && reader->has_overviews()));
+                if (reduce && policy_.reduced_reads() && image_width > 0 && image_height > 0)
+                {
+                    // source pixels per rendered pixel, keeping what the scaling filter samples
+                    double ratio = std::min(image_width / (extent_.width() * std::get<0>(resolution_)),
+                                            image_height / (extent_.height() * std::get<1>(resolution_))) / filter_factor_;
+                    while (reduction * 2 <= reader->max_reduction() && reduction * 2 <= ratio) reduction *= 2;
+                    image_width = (image_width + reduction - 1) / reduction;
+                    image_height = (image_height + reduction - 1) / reduction;
+                }
 
                 if (image_width > 0 && image_height > 0)
                 {
@@ -115,7 +156,9 @@ feature_ptr raster_featureset<LookupPolicy>::next()
                                                         rem.maxx() + x_off + width,
                                                         rem.maxy() + y_off + height);
                     feature_raster_extent = t.backward(feature_raster_extent);
-                    mapnik::image_any data = reader->read(x_off, y_off, width, height);
+                    mapnik::image_any data = !reader ? mapnik::image_tile_cache::window(*tile, x_off, y_off, width, height)
+                        : reduction > 1 ? reader->read_reduced(x_off, y_off, width, height, reduction)
+                        : reader->read(x_off, y_off, width, height);
                     mapnik::raster_ptr raster = std::make_shared<mapnik::raster>(feature_raster_extent, intersect, std::move(data), filter_factor_);
                     feature->set_raster(raster);
                 }
@@ -151,6 +194,7 @@ std::string tiled_multi_file_policy::interpolate(std::string const& pattern, int
     std::string rv(pattern);
     boost::algorithm::replace_all(rv, "${x}", xs);
     boost::algorithm::replace_all(rv, "${y}", ys);
+    boost::algorithm::replace_all(rv, "${z}", std::to_string(level_));
     return rv;
 }
 
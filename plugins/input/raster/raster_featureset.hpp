@@ -31,6 +31,9 @@
 #include <mapnik/debug.hpp>
 
 // stl
+#include <algorithm>
+#include <cmath>
+#include <string>
 #include <vector>
 
 // boost
@@ -115,6 +118,16 @@ public:
     {
         return box2d<double>(0, 0, 0, 0);
     }
+
+    inline bool tile_cache() const
+    {
+        return false;
+    }
+
+    inline bool reduced_reads() const
+    {
+        return true;
+    }
 };
 
 class tiled_file_policy
@@ -190,6 +203,16 @@ public:
         return box2d<double>(0, 0, 0, 0);
     }
 
+    inline bool tile_cache() const
+    {
+        return false;
+    }
+
+    inline bool reduced_reads() const
+    {
+        return true;
+    }
+
 private:
 
     std::vector<raster_info> infos_;
@@ -208,11 +231,16 @@ public:
                             box2d<double> bbox,
                             unsigned width,
                             unsigned height,
-                            unsigned tile_stride)
+                            unsigned tile_stride,
+                            bool tile_cache = false,
+                            unsigned decode_ahead = 0,
+                            unsigned level = 0)
         : image_width_(width),
           image_height_(height),
           tile_size_(tile_size),
-          tile_stride_(tile_stride)
+          tile_stride_(tile_stride),
+          level_(level),
+          tile_cache_(tile_cache)
     {
         double lox = extent.minx();
         double loy = extent.miny();
@@ -255,6 +283,24 @@ public:
             }
         }
 
+        // files of the rings of tiles around the query, within the mosaic
+        if (decode_ahead > 0 && x_min < x_max && y_min < y_max)
+        {
+            const int max_x = int(std::ceil(double(width) / double(tile_size)));
+            const int max_y = int(std::ceil(double(height) / double(tile_size)));
+            const int ring = int(decode_ahead);
+            for (int x = std::max(0, x_min - ring); x < std::min(max_x, x_max + ring); ++x)
+            {
+                for (int y = std::max(0, y_min - ring); y < std::min(max_y, y_max + ring); ++y)
+                {
+                    if (x < x_min || x >= x_max || y < y_min || y >= y_max)
+                    {
+                        neighbours_.push_back(interpolate(file_pattern, x, y));
+                    }
+                }
+            }
+        }
+
         MAPNIK_LOG_DEBUG(raster) << "tiled_multi_file_policy: Raster Plugin INFO SIZE=" << infos_.size() << " " << file_pattern;
     }
 
@@ -293,12 +339,34 @@ public:
         return rem;
     }
 
+    // whether the tiles are read through the image_tile_cache
+    inline bool tile_cache() const
+    {
+        return tile_cache_;
+    }
+
+    // the tile offsets are in full size pixels
+    inline bool reduced_reads() const
+    {
+        return false;
+    }
+
+    // files of the tiles around the queried ones, to decode ahead
+    std::vector<std::string> const& neighbours() const
+    {
+        return neighbours_;
+    }
+
 private:
 
     std::string interpolate(std::string const& pattern, int x, int y) const;
 
     unsigned int image_width_, image_height_, tile_size_, tile_stride_;
+    // pyramid level of the tiles, ${z} in the file pattern
+    unsigned level_;
+    bool tile_cache_;
     std::vector<raster_info> infos_;
+    std::vector<std::string> neighbours_;
 };
 
 template <typename LookupPolicy>
@@ -309,7 +377,11 @@ class raster_featureset : public mapnik::Featureset
 public:
     raster_featureset(LookupPolicy const& policy,
                       box2d<double> const& exttent,
-                      mapnik::query const& q);
+                      mapnik::query const& q,
+                      unsigned decode_threads = 1,
+                      bool decode_reduced = false,
+                      bool decode_premultiplied = false,
+                      bool overviews = false);
     virtual ~raster_featureset();
     mapnik::feature_ptr next();
 
@@ -322,6 +394,11 @@ private:
     iterator_type curIter_;
     iterator_type endIter_;
     double filter_factor_;
+    unsigned decode_threads_;
+    bool decode_reduced_;
+    bool decode_premultiplied_;
+    bool overviews_;
+    mapnik::query::resolution_type resolution_;
 };
 
 #endif // RASTER_FEATURESET_HPP
@@ -25,6 +25,7 @@
 #include <mapnik/util/utf_conv_win.hpp>
 #include <mapnik/unicode.hpp>
 #include <mapnik/util/trim.hpp>
+#include <mapnik/util/conversions.hpp>
 
 #include "dbfile.hpp"
 
@@ -38,11 +39,23 @@
 #pragma GCC diagnostic pop
 
 // stl
+#include <algorithm>
 #include <cstdint>
 #include <string>
 #include <cstring>
 #include <stdexcept>
 
+namespace {
+
+// numeric fields are padded with spaces, usually on the left
+void trim_padding(const char *& itr, const char *& end)
+{
+    while (itr != end && *itr == ' ') ++itr;
+    while (end != itr && *(end - 1) == ' ') --end;
+}
+
+}
+
 dbf_file::dbf_file()
     : num_records_(0),
       num_fields_(0),
@@ -84,7 +97,9 @@ dbf_file::dbf_file(std::string const& file_name)
 
 dbf_file::~dbf_file()
 {
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE)
     ::operator delete(record_);
+#endif
 }
 
 
@@ -109,20 +124,34 @@ int dbf_file::num_fields() const
 }
 
 
+void dbf_file::reset()
+{
+    file_.clear();
+}
+
 void dbf_file::move_to(int index)
 {
     if (index>0 && index<=num_records_)
     {
         std::streampos pos=(num_fields_<<5)+34+(index-1)*(record_length_+1);
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+        // no copy, fields are decoded straight from the mapping
+        std::size_t offset = static_cast<std::size_t>(pos);
+        if (offset + record_length_ <= file_.buffer().second)
+        {
+            record_ = file_.buffer().first + offset;
+        }
+#else
         file_.seekg(pos,std::ios::beg);
         file_.read(record_,record_length_);
+#endif
     }
 }
 
 
 std::string dbf_file::string_value(int col) const
 {
-    if (col>=0 && col<num_fields_)
+    if (col>=0 && col<num_fields_ && record_)
     {
         return std::string(record_+fields_[col].offset_,fields_[col].length_);
     }
@@ -141,7 +170,7 @@ void dbf_file::add_attribute(int col, mapnik::transcoder const& tr, mapnik::feat
 {
     using namespace boost::spirit;
 
-    if (col>=0 && col<num_fields_)
+    if (col>=0 && col<num_fields_ && record_)
     {
         std::string const& name=fields_[col].name_;
 
@@ -151,10 +180,14 @@ void dbf_file::add_attribute(int col, mapnik::transcoder const& tr, mapnik::feat
         case 'C':
         case 'D':
         {
-            // FIXME - avoid constructing std::string on stack
-            std::string str(record_+fields_[col].offset_,fields_[col].length_);
-            mapnik::util::trim(str);
-            f.put(name,tr.transcode(str.c_str()));
+            // trim in place and transcode without an intermediate std::string
+            const char *itr = record_+fields_[col].offset_;
+            const char *end = itr + fields_[col].length_;
+            // stop at an embedded nul like the c string conversion did
+            end = std::find(itr, end, '\0');
+            itr = std::find_if(itr, end, mapnik::util::not_whitespace);
+            while (end != itr && !mapnik::util::not_whitespace(*(end - 1))) --end;
+            f.put(name,tr.transcode(itr, static_cast<std::int32_t>(end - itr)));
             break;
         }
         case 'L':
@@ -187,9 +220,12 @@ void dbf_file::add_attribute(int col, mapnik::transcoder const& tr, mapnik::feat
                 double val = 0.0;
                 const char *itr = record_+fields_[col].offset_;
                 const char *end = itr + fields_[col].length_;
+                trim_padding(itr, end);
                 x3::ascii::space_type space;
                 static x3::double_type double_;
-                if (x3::phrase_parse(itr,end,double_,space,val))
+                // anything after the number is ignored
+                if (mapnik::util::string2double(itr, end, val) ||
+                    x3::phrase_parse(itr,end,double_,space,val))
                 {
                     f.put(name,val);
                 }
@@ -199,9 +235,11 @@ void dbf_file::add_attribute(int col, mapnik::transcoder const& tr, mapnik::feat
                 mapnik::value_integer val = 0;
                 const char *itr = record_+fields_[col].offset_;
                 const char *end = itr + fields_[col].length_;
+                trim_padding(itr, end);
                 x3::ascii::space_type space;
                 static x3::int_parser<mapnik::value_integer,10,1,-1> numeric_parser;
-                if (x3::phrase_parse(itr, end, numeric_parser, space, val))
+                if (mapnik::util::string2int(itr, end, val) ||
+                    x3::phrase_parse(itr, end, numeric_parser, space, val))
                 {
                     f.put(name,val);
                 }
@@ -247,10 +285,12 @@ void dbf_file::read_header()
             fields_.push_back(desc);
         }
         record_length_=offset;
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE)
         if (record_length_>0)
         {
             record_=static_cast<char*>(::operator new (sizeof(char)*record_length_));
         }
+#endif
     }
 }
 
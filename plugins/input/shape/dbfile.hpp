@@ -63,10 +63,12 @@ private:
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
     boost::interprocess::ibufferstream file_;
     mapnik::mapped_region_ptr mapped_region_;
+    // current record, points into the mapped region
+    const char* record_;
 #else
     std::ifstream file_;
-#endif
     char* record_;
+#endif
 public:
     dbf_file();
     dbf_file(std::string const& file_name);
@@ -76,6 +78,8 @@ public:
     int num_fields() const;
     field_descriptor const& descriptor(int col) const;
     void move_to(int index);
+    // drops the read state, so a reused file starts like a fresh one
+    void reset();
     std::string string_value(int col) const;
     void add_attribute(int col, mapnik::transcoder const& tr, mapnik::feature_impl & f) const;
 private:
@@ -28,6 +28,9 @@
 #include <mapnik/warning_ignore.hpp>
 #include <boost/version.hpp>
 #include <boost/algorithm/string.hpp>
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+#include <boost/interprocess/streams/bufferstream.hpp>
+#endif
 #pragma GCC diagnostic pop
 
 // mapnik
@@ -41,10 +44,16 @@
 #include <mapnik/geom_util.hpp>
 #include <mapnik/timer.hpp>
 #include <mapnik/value/types.hpp>
+#include <mapnik/trace.hpp>
+#include <mapnik/util/spatial_index.hpp>
+#include <mapnik/util/featureset_buffer.hpp>
 
 // stl
+#include <algorithm>
 #include <fstream>
 #include <sstream>
+#include <cstdint>
+#include <ctime>
 #include <stdexcept>
 
 DATASOURCE_PLUGIN(shape_datasource)
@@ -58,13 +67,36 @@ using mapnik::filter_in_box;
 using mapnik::filter_at_point;
 using mapnik::attribute_descriptor;
 
+namespace {
+
+// modification times and sizes of the files a shape_io opens, empty
+// fields for missing ones
+std::string files_stamp(std::string const& shape_name)
+{
+    std::ostringstream s;
+    for (std::string const* ext : { &shape_io::SHP, &shape_io::SHX, &shape_io::DBF, &shape_io::INDEX })
+    {
+        std::time_t mtime = 0;
+        std::uintmax_t size = 0;
+        if (mapnik::util::file_stat(shape_name + *ext, mtime, size))
+        {
+            s << mtime << ' ' << size;
+        }
+        s << ';';
+    }
+    return s.str();
+}
+
+}
+
 shape_datasource::shape_datasource(parameters const& params)
     : datasource (params),
       type_(datasource::Vector),
       file_length_(0),
       indexed_(false),
       row_limit_(*params.get<mapnik::value_integer>("row_limit",0)),
-      desc_(shape_datasource::name(), *params.get<std::string>("encoding","utf-8"))
+      desc_(shape_datasource::name(), *params.get<std::string>("encoding","utf-8")),
+      pool_size_(static_cast<std::size_t>(std::max<mapnik::value_integer>(0, *params.get<mapnik::value_integer>("pool_size", 2))))
 {
 #ifdef MAPNIK_STATS
     mapnik::progress_timer __stats__(std::clog, "shape_datasource::init");
@@ -156,6 +188,28 @@ shape_datasource::shape_datasource(parameters const& params)
         throw;
     }
 
+    // ring roles precomputed by shapeindex --rings, shared by all readers
+    std::shared_ptr<shape_rings const> rings;
+    if (shape_type_ == shape_io::shape_polygon || shape_type_ == shape_io::shape_polygonm ||
+        shape_type_ == shape_io::shape_polygonz)
+    {
+        rings = shape_rings::load(shape_name_ + shape_io::RINGS, static_cast<std::int32_t>(file_length_));
+        MAPNIK_LOG_DEBUG(shape) << "shape_datasource: Ring roles=" << (rings ? "yes" : "no");
+    }
+    readers_stamp_ = files_stamp(shape_name_);
+    readers_ = make_readers(rings);
+}
+
+std::shared_ptr<mapnik::util::handle_pool<shape_io>> shape_datasource::make_readers(std::shared_ptr<shape_rings const> rings) const
+{
+    std::string shape_name = shape_name_;
+    mapnik::datasource_counters * counters = &this->counters();
+    return std::make_shared<mapnik::util::handle_pool<shape_io>>([shape_name, rings, counters]() {
+            auto shape = std::make_unique<shape_io>(shape_name);
+            shape->rings_ = rings;
+            shape->counters_ = counters;
+            return shape;
+        }, pool_size_);
 }
 
 void shape_datasource::init(shape_io& shape)
@@ -230,8 +284,34 @@ layer_descriptor shape_datasource::get_descriptor() const
     return desc_;
 }
 
+std::shared_ptr<shape_io> shape_datasource::reader() const
+{
+    std::string stamp = files_stamp(shape_name_);
+    std::shared_ptr<mapnik::util::handle_pool<shape_io>> readers;
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(readers_mutex_);
+#endif
+        if (stamp != readers_stamp_)
+        {
+            // the shapefile was replaced: readers still out keep the old
+            // pool alive until they are done, new ones read the new files.
+            // The .rings file was made for the old ones, so ring roles
+            // are worked out from the geometry again.
+            MAPNIK_LOG_DEBUG(shape) << "shape_datasource: Reopening changed shapefile=" << shape_name_;
+            readers_ = make_readers(nullptr);
+            readers_stamp_ = stamp;
+        }
+        readers = readers_;
+    }
+    std::shared_ptr<shape_io> shape = readers->acquire();
+    shape->reset();
+    return shape;
+}
+
 featureset_ptr shape_datasource::features(query const& q) const
 {
+    mapnik::trace::scope query_trace("datasource", "shape.features");
 #ifdef MAPNIK_STATS
     mapnik::progress_timer __stats__(std::clog, "shape_datasource::features");
 #endif
@@ -240,27 +320,58 @@ featureset_ptr shape_datasource::features(query const& q) const
 
     if (indexed_)
     {
-        std::unique_ptr<shape_io> shape_ptr = std::make_unique<shape_io>(shape_name_);
         mapnik::bounding_box_filter<float> filter(mapnik::box2d<float>(query_box.minx(), query_box.miny(), query_box.maxx(), query_box.maxy()));
         return featureset_ptr
             (new shape_index_featureset<mapnik::bounding_box_filter<float>>(filter,
-                                                                            std::move(shape_ptr),
+                                                                            reader(),
                                                                             q.property_names(),
                                                                             desc_.get_encoding(),
                                                                             shape_name_,
-                                                                            row_limit_));
+                                                                            row_limit_,
+                                                                            q.feature_arena(),
+                                                                            q.get_filter(),
+                                                                            q.variables()));
     }
     else
     {
         mapnik::bounding_box_filter<double> filter(q.get_bbox());
         return std::make_shared<shape_featureset< mapnik::bounding_box_filter<double>>>(filter,
+                                                                  reader(),
                                                                   shape_name_,
                                                                   q.property_names(),
                                                                   desc_.get_encoding(),
-                                                                  row_limit_);
+                                                                  row_limit_,
+                                                                  q.feature_arena());
     }
 }
 
+boost::optional<std::size_t> shape_datasource::estimate_features(query const& q) const
+{
+    // counts the index entries a query would read, without opening the records
+    if (!indexed_) return boost::none;
+    std::shared_ptr<shape_io> shape = reader();
+    auto index = shape->index();
+    if (!index) return boost::none;
+    auto const& query_box = q.get_bbox();
+    mapnik::bounding_box_filter<float> filter(mapnik::box2d<float>(query_box.minx(), query_box.miny(), query_box.maxx(), query_box.maxy()));
+    std::vector<mapnik::detail::node> positions;
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    mapnik::util::spatial_index<mapnik::detail::node,
+                                mapnik::bounding_box_filter<float>,
+                                boost::interprocess::ibufferstream,
+                                mapnik::box2d<float>>::query(filter, index->file(), positions);
+#else
+    mapnik::util::spatial_index<mapnik::detail::node,
+                                mapnik::bounding_box_filter<float>,
+                                std::ifstream,
+                                mapnik::box2d<float>>::query(filter, index->file(), positions);
+#endif
+    std::size_t count = std::count_if(positions.begin(), positions.end(),
+                                      [&](mapnik::detail::node const& pos) { return pos.box.intersects(filter.box_); });
+    if (row_limit_ > 0) count = std::min(count, static_cast<std::size_t>(row_limit_));
+    return count;
+}
+
 featureset_ptr shape_datasource::features_at_point(coord2d const& pt, double tol) const
 {
 #ifdef MAPNIK_STATS
@@ -279,11 +390,10 @@ featureset_ptr shape_datasource::features_at_point(coord2d const& pt, double tol
 
     if (indexed_)
     {
-        std::unique_ptr<shape_io> shape_ptr = std::make_unique<shape_io>(shape_name_);
-        mapnik::at_point_filter<float> filter(mapnik::coord2f(pt.x, pt.y));
+        mapnik::at_point_filter<float> filter(mapnik::coord2f(pt.x, pt.y), tol);
         return featureset_ptr
             (new shape_index_featureset<mapnik::at_point_filter<float>>(filter,
-                                                                        std::move(shape_ptr),
+                                                                        reader(),
                                                                         names,
                                                                         desc_.get_encoding(),
                                                                         shape_name_,
@@ -293,6 +403,7 @@ featureset_ptr shape_datasource::features_at_point(coord2d const& pt, double tol
     {
         filter_at_point filter(pt,tol);
         return std::make_shared<shape_featureset<filter_at_point> >(filter,
+                                                                    reader(),
                                                                     shape_name_,
                                                                     names,
                                                                     desc_.get_encoding(),
@@ -300,6 +411,60 @@ featureset_ptr shape_datasource::features_at_point(coord2d const& pt, double tol
     }
 }
 
+std::vector<featureset_ptr> shape_datasource::features_at_points(std::vector<coord2d> const& pts, double tol) const
+{
+#ifdef MAPNIK_STATS
+    mapnik::progress_timer __stats__(std::clog, "shape_datasource::features_at_points");
+#endif
+    // the row limit counts the records read, so it is applied per point
+    if (row_limit_ > 0) return datasource::features_at_points(pts, tol);
+
+    auto const& desc = desc_.get_descriptors();
+    std::set<std::string> names;
+    for (auto const& attr_info : desc)
+    {
+        names.insert(attr_info.get_name());
+    }
+
+    // the index is searched and every record read once for all points,
+    // then the features are handed to the points they are near
+    std::vector<box2d<double>> boxes;
+    boxes.reserve(pts.size());
+    for (coord2d const& pt : pts)
+    {
+        boxes.emplace_back(pt, pt);
+        boxes.back().pad(tol);
+    }
+    featureset_ptr fs;
+    if (indexed_)
+    {
+        std::vector<box2d<float>> index_boxes;
+        index_boxes.reserve(boxes.size());
+        for (auto const& box : boxes)
+        {
+            index_boxes.emplace_back(box.minx(), box.miny(), box.maxx(), box.maxy());
+        }
+        mapnik::any_box_filter<float> filter(index_boxes);
+        fs = std::make_shared<shape_index_featureset<mapnik::any_box_filter<float>>>(filter,
+                                                                                    reader(),
+                                                                                    names,
+                                                                                    desc_.get_encoding(),
+                                                                                    shape_name_,
+                                                                                    0);
+    }
+    else
+    {
+        mapnik::any_box_filter<double> filter(boxes);
+        fs = std::make_shared<shape_featureset<mapnik::any_box_filter<double>>>(filter,
+                                                                               reader(),
+                                                                               shape_name_,
+                                                                               names,
+                                                                               desc_.get_encoding(),
+                                                                               0);
+    }
+    return mapnik::split_features(fs, boxes);
+}
+
 box2d<double> shape_datasource::envelope() const
 {
     return extent_;
@@ -32,14 +32,19 @@
 #include <mapnik/coord.hpp>
 #include <mapnik/feature_layer_desc.hpp>
 #include <mapnik/value/types.hpp>
+#include <mapnik/util/handle_pool.hpp>
 
 // boost
 #include <boost/optional.hpp>
 #include <memory>
 
 // stl
+#include <cstddef>
 #include <vector>
 #include <string>
+#ifdef MAPNIK_THREADSAFE
+#include <mutex>
+#endif
 
 #include "shape_io.hpp"
 
@@ -59,11 +64,15 @@ public:
     static const char * name();
     featureset_ptr features(query const& q) const;
     featureset_ptr features_at_point(coord2d const& pt, double tol = 0) const;
+    std::vector<featureset_ptr> features_at_points(std::vector<coord2d> const& pts, double tol = 0) const;
+    boost::optional<std::size_t> estimate_features(query const& q) const;
     box2d<double> envelope() const;
     boost::optional<mapnik::datasource_geometry_t> get_geometry_type() const;
     layer_descriptor get_descriptor() const;
 private:
     void init(shape_io& shape);
+    std::shared_ptr<shape_io> reader() const;
+    std::shared_ptr<mapnik::util::handle_pool<shape_io>> make_readers(std::shared_ptr<shape_rings const> rings) const;
 
     datasource::datasource_t type_;
     std::string shape_name_;
@@ -73,6 +82,18 @@ private:
     bool indexed_;
     const int row_limit_;
     layer_descriptor desc_;
+    // idle readers kept, pool_size parameter. Each holds the .shp, .shx,
+    // .dbf and .index files open, so the default is 2; 0 reopens the
+    // files for every query.
+    std::size_t pool_size_;
+    // open readers reused across queries instead of reopening the files,
+    // replaced by a new pool once the files on disk no longer match
+    // readers_stamp_
+    mutable std::shared_ptr<mapnik::util::handle_pool<shape_io>> readers_;
+    mutable std::string readers_stamp_;
+#ifdef MAPNIK_THREADSAFE
+    mutable std::mutex readers_mutex_;
+#endif
 };
 
 #endif //SHAPE_HPP
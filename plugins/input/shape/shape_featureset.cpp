@@ -38,20 +38,26 @@ using mapnik::context_ptr;
 
 template <typename filterT>
 shape_featureset<filterT>::shape_featureset(filterT const& filter,
+                                            std::shared_ptr<shape_io> const& shape,
                                             std::string const& shape_name,
                                             std::set<std::string> const& attribute_names,
                                             std::string const& encoding,
-                                            int row_limit)
+                                            int row_limit,
+                                            bool feature_arena)
     : filter_(filter),
-      shape_(shape_name, false),
+      shape_ptr_(shape),
+      shape_(*shape),
       query_ext_(),
       feature_bbox_(),
       tr_(new transcoder(encoding)),
       shx_file_length_(0),
       row_limit_(row_limit),
       count_(0),
-      ctx_(std::make_shared<mapnik::context_type>())
+      ctx_(std::make_shared<mapnik::context_type>()),
+      arena_(feature_arena ? std::make_shared<mapnik::feature_arena>() : nullptr),
+      stats_(shape->counters_)
 {
+    stats_->queries = 1;
     if (!shape_.shx().is_open())
     {
         throw mapnik::datasource_exception("Shape Plugin: can't open '" + shape_name + ".shx' file");
@@ -81,12 +87,15 @@ feature_ptr shape_featureset<filterT>::next()
         assert(record_length == shape_.reclength_);
         shape_file::record_type record(record_length * 2);
         shape_.shp().read_record(record);
+        stats_->bytes_read += record_length * 2;
+        mapnik::datasource_stats::clock::time_point decode_start;
+        if (stats_) decode_start = mapnik::datasource_stats::clock::now();
         int type = record.read_ndr_integer();
 
         // skip null shapes
         if (type == shape_io::shape_null) continue;
 
-        feature_ptr feature(feature_factory::create(ctx_, feature_id));
+        feature_ptr feature(feature_factory::create(ctx_, feature_id, arena_));
         switch (type)
         {
         case shape_io::shape_point:
@@ -96,7 +105,10 @@ feature_ptr shape_featureset<filterT>::next()
             double x = record.read_double();
             double y = record.read_double();
             if (!filter_.pass(mapnik::box2d<double>(x,y,x,y)))
+            {
+                ++stats_->filtered;
                 continue;
+            }
             feature->set_geometry(mapnik::geometry::point<double>(x,y));
             break;
         }
@@ -105,7 +117,11 @@ feature_ptr shape_featureset<filterT>::next()
         case shape_io::shape_multipointz:
         {
             shape_io::read_bbox(record, feature_bbox_);
-            if (!filter_.pass(feature_bbox_)) continue;
+            if (!filter_.pass(feature_bbox_))
+            {
+                ++stats_->filtered;
+                continue;
+            }
             int num_points = record.read_ndr_integer();
             mapnik::geometry::multi_point<double> multi_point;
             for (int i = 0; i < num_points; ++i)
@@ -114,7 +130,8 @@ feature_ptr shape_featureset<filterT>::next()
                 double y = record.read_double();
                 multi_point.emplace_back(mapnik::geometry::point<double>(x, y));
             }
-            feature->set_geometry(std::move(multi_point));
+            // the record header holds the envelope
+            feature->set_geometry(std::move(multi_point), feature_bbox_);
             break;
         }
 
@@ -123,8 +140,12 @@ feature_ptr shape_featureset<filterT>::next()
         case shape_io::shape_polylinez:
         {
             shape_io::read_bbox(record, feature_bbox_);
-            if (!filter_.pass(feature_bbox_)) continue;
-            feature->set_geometry(shape_io::read_polyline(record));
+            if (!filter_.pass(feature_bbox_))
+            {
+                ++stats_->filtered;
+                continue;
+            }
+            feature->set_geometry(shape_io::read_polyline(record), feature_bbox_);
             break;
         }
         case shape_io::shape_polygon:
@@ -132,8 +153,12 @@ feature_ptr shape_featureset<filterT>::next()
         case shape_io::shape_polygonz:
         {
             shape_io::read_bbox(record, feature_bbox_);
-            if (!filter_.pass(feature_bbox_)) continue;
-            feature->set_geometry(shape_io::read_polygon(record));
+            if (!filter_.pass(feature_bbox_))
+            {
+                ++stats_->filtered;
+                continue;
+            }
+            feature->set_geometry(shape_io::read_polygon(record, shape_.rings(), shape_.id()), feature_bbox_);
             break;
         }
         default :
@@ -157,10 +182,17 @@ feature_ptr shape_featureset<filterT>::next()
             }
         }
         ++count_;
+        ++stats_->features;
+        if (stats_)
+        {
+            stats_->decode += std::chrono::duration_cast<mapnik::datasource_stats::duration>(
+                mapnik::datasource_stats::clock::now() - decode_start);
+        }
         return feature;
     }
 
     MAPNIK_LOG_DEBUG(shape) << "shape_featureset: Total shapes read=" << count_;
+    stats_.flush();
     return feature_ptr();
 }
 
@@ -169,3 +201,4 @@ shape_featureset<filterT>::~shape_featureset() {}
 
 template class shape_featureset<mapnik::filter_in_box>;
 template class shape_featureset<mapnik::filter_at_point>;
+template class shape_featureset<mapnik::any_box_filter<double>>;
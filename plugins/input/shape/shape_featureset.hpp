@@ -27,6 +27,7 @@
 #include <mapnik/datasource.hpp>
 #include <mapnik/geom_util.hpp>
 #include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
 #include <mapnik/unicode.hpp>
 #include <mapnik/value/types.hpp>
 
@@ -47,16 +48,20 @@ class shape_featureset : public Featureset
 {
 public:
     shape_featureset(filterT const& filter,
+                     std::shared_ptr<shape_io> const& shape,
                      std::string const& shape_file,
                      std::set<std::string> const& attribute_names,
                      std::string const& encoding,
-                     int row_limit);
+                     int row_limit,
+                     bool feature_arena = false);
     virtual ~shape_featureset();
     feature_ptr next();
 
 private:
     filterT filter_;
-    shape_io shape_;
+    // borrowed from the datasource's readers until the featureset is done
+    std::shared_ptr<shape_io> shape_ptr_;
+    shape_io & shape_;
     box2d<double> query_ext_;
     mutable box2d<double> feature_bbox_;
     const std::unique_ptr<transcoder> tr_;
@@ -65,6 +70,8 @@ private:
     mapnik::value_integer row_limit_;
     mutable int count_;
     context_ptr ctx_;
+    mapnik::feature_arena_ptr arena_;
+    mapnik::datasource_stats_batch stats_;
 };
 
 #endif //SHAPE_FEATURESET_HPP
@@ -26,6 +26,8 @@
 // mapnik
 #include <mapnik/debug.hpp>
 #include <mapnik/feature_factory.hpp>
+#include <mapnik/expression_evaluator.hpp>
+#include <mapnik/expression_string.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -41,24 +43,57 @@
 
 using mapnik::feature_factory;
 
+namespace {
+
+// records whose starts are at most max_step bytes apart are read at once,
+// in runs of up to max_run bytes plus record_tail for the last record
+constexpr std::uint64_t max_step = 65536;
+constexpr std::uint64_t max_run = 1 << 20;
+constexpr std::uint64_t record_tail = 4096;
+// bytes of upcoming runs hinted to the file
+constexpr std::uint64_t prefetch_bytes = 8 << 20;
+
+// the filter is tested before the geometry is read, so it can't look at it
+mapnik::expression_ptr filter_before_geometry(mapnik::expression_ptr const& filter)
+{
+    if (filter && mapnik::to_expression_string(*filter).find("[mapnik::geometry_type]") == std::string::npos)
+    {
+        return filter;
+    }
+    return mapnik::expression_ptr();
+}
+
+}
+
 template <typename filterT>
 shape_index_featureset<filterT>::shape_index_featureset(filterT const& filter,
-                                                        std::unique_ptr<shape_io> && shape_ptr,
+                                                        std::shared_ptr<shape_io> const& shape_ptr,
                                                         std::set<std::string> const& attribute_names,
                                                         std::string const& encoding,
                                                         std::string const& shape_name,
-                                                        int row_limit)
+                                                        int row_limit,
+                                                        bool feature_arena,
+                                                        mapnik::expression_ptr const& rule_filter,
+                                                        mapnik::attributes const& vars)
     : filter_(filter),
       ctx_(std::make_shared<mapnik::context_type>()),
-      shape_ptr_(std::move(shape_ptr)),
+      shape_ptr_(shape_ptr),
       tr_(new mapnik::transcoder(encoding)),
       positions_(),
       itr_(),
       attr_ids_(),
       row_limit_(row_limit),
       count_(0),
-      feature_bbox_()
+      feature_bbox_(),
+      arena_(feature_arena ? std::make_shared<mapnik::feature_arena>() : nullptr),
+      rule_filter_(filter_before_geometry(rule_filter)),
+      vars_(vars),
+      runs_(),
+      run_(0),
+      hinted_(0),
+      stats_(shape_ptr->counters_)
 {
+    stats_->queries = 1;
     shape_ptr_->shp().skip(100);
     setup_attributes(ctx_, attribute_names, shape_name, *shape_ptr_, attr_ids_);
 
@@ -77,15 +112,32 @@ shape_index_featureset<filterT>::shape_index_featureset(filterT const& filter,
                                     mapnik::box2d<typename filterT::value_type>>::query(filter, index->file(), positions_);
 #endif
     }
+    // entries of the index leaves the query box overlaps
+    stats_->index_nodes = positions_.size();
     // filter
     positions_.erase(std::remove_if(positions_.begin(),
                                     positions_.end(),
                                     [&](mapnik::detail::node const& pos)
-                                    { return !pos.box.intersects(filter.box_);}),
+                                    { return !filter.pass(pos.box);}),
                      positions_.end());
+    stats_->filtered = stats_->index_nodes - positions_.size();
     std::sort(positions_.begin(), positions_.end(), [](mapnik::detail::node const& n0, mapnik::detail::node const& n1)
               {return n0.offset != n1.offset ? n0.offset < n1.offset : n0.start < n1.start;});
-    MAPNIK_LOG_DEBUG(shape) << "shape_index_featureset: Query size=" << positions_.size();
+    std::uint64_t last = 0;
+    for (auto const& pos : positions_)
+    {
+        if (!runs_.empty() && pos.offset == last) continue;
+        if (runs_.empty() || pos.offset - last > max_step || pos.offset + record_tail - runs_.back().first > max_run)
+        {
+            runs_.emplace_back(pos.offset, pos.offset + record_tail);
+        }
+        else
+        {
+            runs_.back().second = pos.offset + record_tail;
+        }
+        last = pos.offset;
+    }
+    MAPNIK_LOG_DEBUG(shape) << "shape_index_featureset: Query size=" << positions_.size() << " runs=" << runs_.size();
     itr_ = positions_.begin();
 }
 
@@ -100,6 +152,18 @@ feature_ptr shape_index_featureset<filterT>::next()
     while ( itr_ != positions_.end())
     {
         std::uint64_t offset = itr_->offset;
+        if (run_ < runs_.size() && offset >= runs_[run_].first)
+        {
+            auto const& run = runs_[run_++];
+            for (; hinted_ < runs_.size() && runs_[hinted_].first < run.second + prefetch_bytes; ++hinted_)
+            {
+                if (hinted_ >= run_)
+                {
+                    shape_ptr_->shp().will_need(runs_[hinted_].first, runs_[hinted_].second - runs_[hinted_].first);
+                }
+            }
+            shape_ptr_->shp().read_ahead(run.first, run.second - run.first);
+        }
         shape_ptr_->move_to(offset);
         std::vector<std::pair<int,int>> parts;
         while (itr_ != positions_.end() && itr_->offset == offset)
@@ -110,8 +174,21 @@ feature_ptr shape_index_featureset<filterT>::next()
         mapnik::value_integer feature_id = shape_ptr_->id();
         shape_file::record_type record(shape_ptr_->reclength_ * 2);
         shape_ptr_->shp().read_record(record);
+        stats_->bytes_read += shape_ptr_->reclength_ * 2;
+        mapnik::datasource_stats::clock::time_point decode_start;
+        if (stats_) decode_start = mapnik::datasource_stats::clock::now();
         int type = record.read_ndr_integer();
-        feature_ptr feature(feature_factory::create(ctx_, feature_id));
+        feature_ptr feature(feature_factory::create(ctx_, feature_id, arena_));
+        if (rule_filter_)
+        {
+            read_attributes(*feature);
+            if (!mapnik::util::apply_visitor(mapnik::evaluate<mapnik::feature_impl, mapnik::value_type, mapnik::attributes>(*feature, vars_),
+                                             *rule_filter_).to_bool())
+            {
+                ++stats_->filtered;
+                continue;
+            }
+        }
 
         switch (type)
         {
@@ -138,7 +215,8 @@ feature_ptr shape_index_featureset<filterT>::next()
                 double y = record.read_double();
                 multi_point.emplace_back(mapnik::geometry::point<double>(x, y));
             }
-            feature->set_geometry(std::move(multi_point));
+            // the record header holds the envelope, of all parts
+            feature->set_geometry(std::move(multi_point), feature_bbox_);
             break;
         }
         case shape_io::shape_polyline:
@@ -147,7 +225,7 @@ feature_ptr shape_index_featureset<filterT>::next()
         {
             shape_io::read_bbox(record, feature_bbox_);
             //if (!filter_.pass(feature_bbox_)) continue;
-            if (parts.size() < 2) feature->set_geometry(shape_io::read_polyline(record));
+            if (parts.size() < 2) feature->set_geometry(shape_io::read_polyline(record), feature_bbox_);
             else feature->set_geometry(shape_io::read_polyline_parts(record, parts));
             break;
         }
@@ -157,8 +235,8 @@ feature_ptr shape_index_featureset<filterT>::next()
         {
             shape_io::read_bbox(record, feature_bbox_);
             //if (!filter_.pass(feature_bbox_)) continue;
-            if (parts.size() < 2) feature->set_geometry(shape_io::read_polygon(record));
-            else feature->set_geometry(shape_io::read_polygon_parts(record, parts));
+            if (parts.size() < 2) feature->set_geometry(shape_io::read_polygon(record, shape_ptr_->rings(), shape_ptr_->id()), feature_bbox_);
+            else feature->set_geometry(shape_io::read_polygon_parts(record, parts, shape_ptr_->rings(), shape_ptr_->id()));
             break;
         }
         default :
@@ -166,32 +244,46 @@ feature_ptr shape_index_featureset<filterT>::next()
             return feature_ptr();
         }
 
-        if (attr_ids_.size())
+        if (!rule_filter_) read_attributes(*feature);
+        ++count_;
+        ++stats_->features;
+        if (stats_)
         {
-            shape_ptr_->dbf().move_to(shape_ptr_->id_);
-            try
-            {
-                for (auto id : attr_ids_)
-                {
-                    shape_ptr_->dbf().add_attribute(id, *tr_, *feature);
-                }
-            }
-            catch (...)
-            {
-                MAPNIK_LOG_ERROR(shape) << "Shape Plugin: error processing attributes";
-            }
+            stats_->decode += std::chrono::duration_cast<mapnik::datasource_stats::duration>(
+                mapnik::datasource_stats::clock::now() - decode_start);
         }
-        ++count_;
         return feature;
     }
 
     MAPNIK_LOG_DEBUG(shape) << "shape_index_featureset: " << count_ << " features";
+    stats_.flush();
     return feature_ptr();
 }
 
 
+template <typename filterT>
+void shape_index_featureset<filterT>::read_attributes(mapnik::feature_impl & feature) const
+{
+    if (attr_ids_.size())
+    {
+        shape_ptr_->dbf().move_to(shape_ptr_->id_);
+        try
+        {
+            for (auto id : attr_ids_)
+            {
+                shape_ptr_->dbf().add_attribute(id, *tr_, feature);
+            }
+        }
+        catch (...)
+        {
+            MAPNIK_LOG_ERROR(shape) << "Shape Plugin: error processing attributes";
+        }
+    }
+}
+
 template <typename filterT>
 shape_index_featureset<filterT>::~shape_index_featureset() {}
 
 template class shape_index_featureset<mapnik::bounding_box_filter<float>>;
 template class shape_index_featureset<mapnik::at_point_filter<float>>;
+template class shape_index_featureset<mapnik::any_box_filter<float>>;
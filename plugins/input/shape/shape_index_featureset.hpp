@@ -30,6 +30,9 @@
 // mapnik
 #include <mapnik/geom_util.hpp>
 #include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/expression.hpp>
 #include <mapnik/unicode.hpp>
 #include <mapnik/value/types.hpp>
 
@@ -67,18 +70,24 @@ class shape_index_featureset : public Featureset
 {
 public:
     shape_index_featureset(filterT const& filter,
-                           std::unique_ptr<shape_io> && shape_ptr,
+                           std::shared_ptr<shape_io> const& shape_ptr,
                            std::set<std::string> const& attribute_names,
                            std::string const& encoding,
                            std::string const& shape_name,
-                           int row_limit);
+                           int row_limit,
+                           bool feature_arena = false,
+                           mapnik::expression_ptr const& rule_filter = mapnik::expression_ptr(),
+                           mapnik::attributes const& vars = mapnik::attributes());
     virtual ~shape_index_featureset();
     feature_ptr next();
 
 private:
+    void read_attributes(mapnik::feature_impl & feature) const;
+
     filterT filter_;
     context_ptr ctx_;
-    std::unique_ptr<shape_io> shape_ptr_;
+    // borrowed from the datasource's readers until the featureset is done
+    std::shared_ptr<shape_io> shape_ptr_;
     const std::unique_ptr<mapnik::transcoder> tr_;
     std::vector<mapnik::detail::node> positions_;
     std::vector<mapnik::detail::node>::iterator itr_;
@@ -86,6 +95,16 @@ private:
     mapnik::value_integer row_limit_;
     mutable int count_;
     mutable box2d<double> feature_bbox_;
+    mapnik::feature_arena_ptr arena_;
+    // records no rule matches are skipped before their geometry is read
+    mapnik::expression_ptr rule_filter_;
+    mapnik::attributes vars_;
+    // file ranges holding records close together, read at once
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> runs_;
+    std::size_t run_;
+    // runs up to here were hinted to the file
+    std::size_t hinted_;
+    mapnik::datasource_stats_batch stats_;
 };
 
 #endif // SHAPE_INDEX_FEATURESET_HPP
@@ -29,11 +29,42 @@
 #include <mapnik/util/is_clockwise.hpp>
 #include <mapnik/geometry/correct.hpp>
 
+// stl
+#include <algorithm>
+
 using mapnik::datasource_exception;
 const std::string shape_io::SHP = ".shp";
 const std::string shape_io::SHX = ".shx";
 const std::string shape_io::DBF = ".dbf";
 const std::string shape_io::INDEX = ".index";
+const std::string shape_io::RINGS = ".rings";
+
+namespace {
+
+// adds ring to the polygons as the flags say
+void add_ring(mapnik::geometry::linear_ring<double> && ring, std::uint8_t flags,
+              mapnik::geometry::polygon<double> & poly,
+              mapnik::geometry::multi_polygon<double> & multi_poly)
+{
+    if (flags & shape_rings::open) ring.push_back(ring.front());
+    if (flags & shape_rings::reversed) std::reverse(ring.begin(), ring.end());
+    if ((flags & shape_rings::starts_polygon) && !poly.empty())
+    {
+        multi_poly.emplace_back(std::move(poly));
+        poly.clear();
+    }
+    poly.push_back(std::move(ring));
+}
+
+mapnik::geometry::geometry<double> finish_polygon(mapnik::geometry::polygon<double> && poly,
+                                                  mapnik::geometry::multi_polygon<double> && multi_poly)
+{
+    if (multi_poly.empty()) return mapnik::geometry::geometry<double>(std::move(poly));
+    multi_poly.emplace_back(std::move(poly));
+    return mapnik::geometry::geometry<double>(std::move(multi_poly));
+}
+
+}
 
 shape_io::shape_io(std::string const& shape_name, bool open_index)
     : type_(shape_null),
@@ -68,6 +99,17 @@ shape_io::shape_io(std::string const& shape_name, bool open_index)
 
 shape_io::~shape_io() {}
 
+void shape_io::reset()
+{
+    shp_.reset();
+    shx_.reset();
+    dbf_.reset();
+    if (index_) index_->reset();
+    type_ = shape_null;
+    reclength_ = 0;
+    id_ = 0;
+}
+
 void shape_io::move_to(std::streampos pos)
 {
     shp_.seek(pos);
@@ -182,11 +224,12 @@ mapnik::geometry::geometry<double> shape_io::read_polyline_parts(shape_file::rec
 }
 
 
-mapnik::geometry::geometry<double> shape_io::read_polygon(shape_file::record_type & record)
+mapnik::geometry::geometry<double> shape_io::read_polygon(shape_file::record_type & record, shape_rings const* rings, int id)
 {
     mapnik::geometry::geometry<double> geom; // default empty
     int num_parts = record.read_ndr_integer();
     int num_points = record.read_ndr_integer();
+    std::uint8_t const* ring_flags = rings ? rings->find(id, num_parts) : nullptr;
 
     std::vector<int> parts;
     parts.resize(num_parts);
@@ -208,7 +251,11 @@ mapnik::geometry::geometry<double> shape_io::read_polygon(shape_file::record_typ
             double y = record.read_double();
             ring.emplace_back(x, y);
         }
-        if (k == 0)
+        if (ring_flags)
+        {
+            add_ring(std::move(ring), ring_flags[k], poly, multi_poly);
+        }
+        else if (k == 0)
         {
             poly.push_back(std::move(ring));
         }
@@ -224,6 +271,8 @@ mapnik::geometry::geometry<double> shape_io::read_polygon(shape_file::record_typ
         }
     }
 
+    // rings read as flagged are corrected already
+    if (ring_flags) return finish_polygon(std::move(poly), std::move(multi_poly));
     if (multi_poly.size() > 0) // multi
     {
         multi_poly.emplace_back(std::move(poly));
@@ -237,10 +286,20 @@ mapnik::geometry::geometry<double> shape_io::read_polygon(shape_file::record_typ
     return geom;
 }
 
-mapnik::geometry::geometry<double> shape_io::read_polygon_parts(shape_file::record_type & record, std::vector<std::pair<int,int>> const& parts)
+mapnik::geometry::geometry<double> shape_io::read_polygon_parts(shape_file::record_type & record, std::vector<std::pair<int,int>> const& parts,
+                                                                shape_rings const* rings, int id)
 {
     mapnik::geometry::geometry<double> geom; // default empty
     int total_num_parts = record.read_ndr_integer();
+    std::uint8_t const* ring_flags = rings ? rings->find(id, total_num_parts) : nullptr;
+    // first points of all rings of the record, to find the flags of a part
+    std::vector<int> ring_starts;
+    if (ring_flags)
+    {
+        record.skip(4);
+        ring_starts.resize(total_num_parts);
+        for (int & start : ring_starts) start = record.read_ndr_integer();
+    }
     mapnik::geometry::polygon<double> poly;
     mapnik::geometry::multi_polygon<double> multi_poly;
     int num_parts = parts.size();
@@ -258,7 +317,15 @@ mapnik::geometry::geometry<double> shape_io::read_polygon_parts(shape_file::reco
             double y = record.read_double();
             ring.emplace_back(x, y);
         }
-        if (k == 0)
+        if (ring_flags)
+        {
+            auto itr = std::lower_bound(ring_starts.begin(), ring_starts.end(), start);
+            std::uint8_t flags = itr != ring_starts.end() ? ring_flags[itr - ring_starts.begin()] : 0;
+            // the first part indexed together starts a polygon
+            if (k == 0) flags |= shape_rings::starts_polygon;
+            add_ring(std::move(ring), flags, poly, multi_poly);
+        }
+        else if (k == 0)
         {
             poly.push_back(std::move(ring));
         }
@@ -274,6 +341,7 @@ mapnik::geometry::geometry<double> shape_io::read_polygon_parts(shape_file::reco
         }
     }
 
+    if (ring_flags) return finish_polygon(std::move(poly), std::move(multi_poly));
     if (multi_poly.size() > 0) // multi
     {
         multi_poly.emplace_back(std::move(poly));
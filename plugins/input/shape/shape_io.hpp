@@ -30,11 +30,13 @@
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/util/noncopyable.hpp>
 #include <mapnik/util/spatial_index.hpp>
+#include <mapnik/datasource_stats.hpp>
 // boost
 #include <boost/optional.hpp>
 //
 #include "dbfile.hpp"
 #include "shapefile.hpp"
+#include "shape_rings.hpp"
 
 struct shape_io : mapnik::util::noncopyable
 {
@@ -83,17 +85,30 @@ public:
 
     inline int id() const { return id_;}
     void move_to(std::streampos pos);
+    // rewinds a reader handed back to the datasource's pool
+    void reset();
     static void read_bbox(shape_file::record_type & record, mapnik::box2d<double> & bbox);
     static mapnik::geometry::geometry<double> read_polyline(shape_file::record_type & record);
-    static mapnik::geometry::geometry<double> read_polygon(shape_file::record_type & record);
+    // With the ring flags of record id from a .rings file, polygons are
+    // assembled without testing the orientation of their rings.
+    static mapnik::geometry::geometry<double> read_polygon(shape_file::record_type & record,
+                                                           shape_rings const* rings = nullptr, int id = 0);
     static mapnik::geometry::geometry<double> read_polyline_parts(shape_file::record_type & record,std::vector<std::pair<int,int>> const& parts);
-    static mapnik::geometry::geometry<double> read_polygon_parts(shape_file::record_type & record, std::vector<std::pair<int,int>> const& parts);
+    static mapnik::geometry::geometry<double> read_polygon_parts(shape_file::record_type & record, std::vector<std::pair<int,int>> const& parts,
+                                                                 shape_rings const* rings = nullptr, int id = 0);
+
+    // null without a .rings file
+    inline shape_rings const* rings() const { return rings_.get(); }
 
     shapeType type_;
     shape_file shp_;
     shape_file shx_;
     dbf_file   dbf_;
     std::unique_ptr<shape_file> index_;
+    // shared by the readers of a datasource
+    std::shared_ptr<shape_rings const> rings_;
+    // those of the datasource handing out the reader, null otherwise
+    mapnik::datasource_counters * counters_ = nullptr;
     int reclength_;
     int id_;
     box2d<double> cur_extent_;
@@ -102,6 +117,7 @@ public:
     static const std::string SHX;
     static const std::string DBF;
     static const std::string INDEX;
+    static const std::string RINGS;
 };
 
 #endif //SHAPE_IO_HPP
@@ -0,0 +1,147 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#ifndef SHAPE_RINGS_HPP
+#define SHAPE_RINGS_HPP
+
+// stl
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+// mapnik
+#include <mapnik/global.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// The roles of the rings of a polygon shapefile, written by shapeindex
+// --rings next to the .shp, so polygons are assembled without testing
+// ring orientations. The file holds the magic, the .shp file length it
+// was made for and the number of records, then the index of each record's
+// first ring and the total, and a byte of flags per ring. Integers are
+// little endian.
+class shape_rings : mapnik::util::noncopyable
+{
+public:
+    enum ring_flags : std::uint8_t
+    {
+        // the first ring of a polygon, the rest are its holes
+        starts_polygon = 1,
+        // wound the wrong way for its role
+        reversed = 2,
+        // last point not equal to the first
+        open = 4
+    };
+
+    // flags of a ring as read from the shapefile, which starts a polygon
+    // when it is the first of the record or is wound clockwise
+    template <typename Ring>
+    static std::uint8_t flags(Ring const& ring, bool first)
+    {
+        if (ring.empty()) return first ? starts_polygon : 0;
+        double area = 0.0;
+        std::size_t num_points = ring.size();
+        for (std::size_t i = 0; i < num_points; ++i)
+        {
+            auto const& p0 = ring[i];
+            auto const& p1 = ring[(i + 1) % num_points];
+            area += (p0.x - ring[0].x) * (p1.y - ring[0].y) - (p1.x - ring[0].x) * (p0.y - ring[0].y);
+        }
+        std::uint8_t result = 0;
+        bool exterior = first || area < 0.0;
+        if (exterior) result |= starts_polygon;
+        // exteriors are counterclockwise and holes clockwise once read
+        if (exterior ? area < 0.0 : area > 0.0) result |= reversed;
+        if (ring.front().x != ring.back().x || ring.front().y != ring.back().y) result |= open;
+        return result;
+    }
+
+    static void write(std::ostream & out, std::int32_t shp_length,
+                      std::vector<std::uint32_t> const& first_rings,
+                      std::vector<std::uint8_t> const& flags)
+    {
+        out.write(magic(), magic_size);
+        write_uint32(out, static_cast<std::uint32_t>(shp_length));
+        write_uint32(out, static_cast<std::uint32_t>(first_rings.size()));
+        for (std::uint32_t first : first_rings) write_uint32(out, first);
+        write_uint32(out, static_cast<std::uint32_t>(flags.size()));
+        out.write(reinterpret_cast<char const*>(flags.data()), static_cast<std::streamsize>(flags.size()));
+    }
+
+    // null unless the file exists and was made for a .shp of shp_length
+    static std::shared_ptr<shape_rings const> load(std::string const& file_name, std::int32_t shp_length)
+    {
+        std::ifstream in(file_name.c_str(), std::ios::in | std::ios::binary);
+        if (!in) return nullptr;
+        char head[magic_size + 8];
+        if (!in.read(head, sizeof(head)) || std::memcmp(head, magic(), magic_size) != 0) return nullptr;
+        std::int32_t length, num_records;
+        mapnik::read_int32_ndr(head + magic_size, length);
+        mapnik::read_int32_ndr(head + magic_size + 4, num_records);
+        if (length != shp_length || num_records < 0) return nullptr;
+        auto rings = std::make_shared<shape_rings>();
+        std::vector<char> buffer(4 * (static_cast<std::size_t>(num_records) + 1));
+        if (!in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()))) return nullptr;
+        rings->first_rings_.resize(static_cast<std::size_t>(num_records) + 1);
+        for (std::size_t i = 0; i < rings->first_rings_.size(); ++i)
+        {
+            std::int32_t first;
+            mapnik::read_int32_ndr(&buffer[4 * i], first);
+            rings->first_rings_[i] = static_cast<std::uint32_t>(first);
+        }
+        rings->flags_.resize(rings->first_rings_.back());
+        if (!in.read(reinterpret_cast<char*>(rings->flags_.data()),
+                     static_cast<std::streamsize>(rings->flags_.size())))
+        {
+            return nullptr;
+        }
+        return rings;
+    }
+
+    // flags of the rings of record id, counted from 1 as in the .shp, or
+    // null unless the record has num_rings
+    std::uint8_t const* find(int id, int num_rings) const
+    {
+        if (id < 1 || static_cast<std::size_t>(id) >= first_rings_.size()) return nullptr;
+        std::uint32_t first = first_rings_[id - 1];
+        std::uint32_t last = first_rings_[id];
+        if (last < first || last > flags_.size() || last - first != static_cast<std::uint32_t>(num_rings)) return nullptr;
+        return flags_.data() + first;
+    }
+
+private:
+    static constexpr std::size_t magic_size = 12;
+    static char const* magic() { return "mapnik-rings"; }
+
+    static void write_uint32(std::ostream & out, std::uint32_t val)
+    {
+        char b[4] = { static_cast<char>(val & 0xff), static_cast<char>((val >> 8) & 0xff),
+                      static_cast<char>((val >> 16) & 0xff), static_cast<char>((val >> 24) & 0xff) };
+        out.write(b, 4);
+    }
+
+    std::vector<std::uint32_t> first_rings_;
+    std::vector<std::uint8_t> flags_;
+};
+
+#endif // SHAPE_RINGS_HPP
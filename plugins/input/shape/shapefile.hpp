@@ -24,10 +24,13 @@
 #define SHAPEFILE_HPP
 
 // stl
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 #include <stdexcept>
 #include <cstdint>
+#include <string>
+#include <vector>
 
 // mapnik
 #include <mapnik/global.hpp>
@@ -44,6 +47,12 @@
 #endif
 #include <mapnik/util/noncopyable.hpp>
 
+#if !defined(_WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 using mapnik::box2d;
 using mapnik::read_int32_ndr;
 using mapnik::read_int32_xdr;
@@ -165,7 +174,8 @@ public:
 #elif defined (_WINDOWS)
         file_(mapnik::utf8_to_utf16(file_name), std::ios::in | std::ios::binary)
 #else
-        file_(file_name.c_str(), std::ios::in | std::ios::binary)
+        file_(file_name.c_str(), std::ios::in | std::ios::binary),
+        file_name_(file_name)
 #endif
     {
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
@@ -184,7 +194,12 @@ public:
 #endif
     }
 
-    ~shape_file() {}
+    ~shape_file()
+    {
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE) && !defined(_WINDOWS)
+        if (advice_fd_ >= 0) ::close(advice_fd_);
+#endif
+    }
 
     inline file_source_type& file()
     {
@@ -206,14 +221,14 @@ public:
         rec.set_data(file_.buffer().first + file_.tellg());
         file_.seekg(rec.size, std::ios::cur);
 #else
-        file_.read(rec.get_data(), rec.size);
+        read(rec.get_data(), rec.size);
 #endif
     }
 
     inline int read_xdr_integer()
     {
         char b[4];
-        file_.read(b, 4);
+        read(b, 4);
         std::int32_t val;
         read_int32_xdr(b, val);
         return val;
@@ -222,7 +237,7 @@ public:
     inline int read_ndr_integer()
     {
         char b[4];
-        file_.read(b, 4);
+        read(b, 4);
         std::int32_t val;
         read_int32_ndr(b, val);
         return val;
@@ -231,17 +246,24 @@ public:
     inline double read_double()
     {
         double val;
-        file_.read(reinterpret_cast<char*>(&val), 8);
+        read(reinterpret_cast<char*>(&val), 8);
         return val;
     }
 
     inline void read_envelope(box2d<double>& envelope)
     {
-        file_.read(reinterpret_cast<char*>(&envelope), sizeof(envelope));
+        read(reinterpret_cast<char*>(&envelope), sizeof(envelope));
     }
 
     inline void skip(std::streampos bytes)
     {
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE)
+        if (in_window_)
+        {
+            seek(pos() + bytes);
+            return;
+        }
+#endif
         file_.seekg(bytes, std::ios::cur);
     }
 
@@ -250,25 +272,133 @@ public:
         seek(100);
     }
 
+    // drops the read state, so a reused file starts like a fresh one
+    inline void reset()
+    {
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE)
+        in_window_ = false;
+        window_.clear();
+        window_begin_ = 0;
+        window_pos_ = 0;
+#endif
+        file_.clear();
+        file_.seekg(0, std::ios::beg);
+    }
+
     inline void seek(std::streampos pos)
     {
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE)
+        std::streamoff offset = pos - window_begin_;
+        if (offset >= 0 && offset < static_cast<std::streamoff>(window_.size()))
+        {
+            in_window_ = true;
+            window_pos_ = static_cast<std::size_t>(offset);
+            return;
+        }
+        in_window_ = false;
+#endif
         file_.seekg(pos, std::ios::beg);
     }
 
     inline std::streampos pos()
     {
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE)
+        if (in_window_) return window_begin_ + static_cast<std::streamoff>(window_pos_);
+#endif
         return file_.tellg();
     }
 
     inline bool is_eof()
     {
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE)
+        if (in_window_) return false;
+#endif
         return file_.eof();
     }
 
     inline bool is_good()
     {
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE)
+        if (in_window_) return true;
+#endif
         return file_.good();
     }
+
+    // Reads size bytes from begin at once, the reads and seeks within them
+    // are then served from memory; mappings are asked to page them in.
+    inline void read_ahead(std::streampos begin, std::size_t size)
+    {
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+        will_need(begin, size);
+#else
+        in_window_ = false;
+        window_.resize(size);
+        file_.clear();
+        file_.seekg(begin, std::ios::beg);
+        file_.read(window_.data(), static_cast<std::streamsize>(size));
+        window_.resize(static_cast<std::size_t>(file_.gcount()));
+        file_.clear();
+        window_begin_ = begin;
+        seek(begin);
+#endif
+    }
+
+    // Hints that size bytes from begin will be read soon
+    inline void will_need(std::streampos begin, std::size_t size)
+    {
+#if !defined(_WINDOWS)
+        std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        std::size_t offset = static_cast<std::size_t>(begin);
+        std::size_t aligned = offset - offset % page;
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+        std::size_t file_size = file_.buffer().second;
+        if (aligned >= file_size) return;
+        std::size_t length = std::min(offset + size, file_size) - aligned;
+        ::madvise(static_cast<char*>(mapped_region_->get_address()) + aligned, length, MADV_WILLNEED);
+#elif defined(POSIX_FADV_WILLNEED)
+        if (advice_fd_ == -1) advice_fd_ = ::open(file_name_.c_str(), O_RDONLY);
+        if (advice_fd_ >= 0)
+        {
+            ::posix_fadvise(advice_fd_, static_cast<off_t>(aligned),
+                            static_cast<off_t>(offset + size - aligned), POSIX_FADV_WILLNEED);
+        }
+#endif
+#endif
+    }
+
+private:
+#if !defined(MAPNIK_MEMORY_MAPPED_FILE)
+    inline void read(char * data, std::size_t size)
+    {
+        if (in_window_)
+        {
+            if (window_pos_ + size <= window_.size())
+            {
+                std::memcpy(data, window_.data() + window_pos_, size);
+                window_pos_ += size;
+                return;
+            }
+            // continue past the window from the file
+            in_window_ = false;
+            file_.clear();
+            file_.seekg(window_begin_ + static_cast<std::streamoff>(window_pos_), std::ios::beg);
+        }
+        file_.read(data, static_cast<std::streamsize>(size));
+    }
+
+    std::string file_name_;
+    // descriptor given the posix_fadvise() hints, opened on first use
+    int advice_fd_ = -1;
+    std::vector<char> window_;
+    std::streampos window_begin_ = 0;
+    std::size_t window_pos_ = 0;
+    bool in_window_ = false;
+#else
+    inline void read(char * data, std::size_t size)
+    {
+        file_.read(data, static_cast<std::streamsize>(size));
+    }
+#endif
 };
 
 #endif // SHAPEFILE_HPP
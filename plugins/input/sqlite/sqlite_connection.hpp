@@ -26,11 +26,17 @@
 // stl
 #include <string.h>
 #include <memory>
+#include <unordered_map>
+#ifdef MAPNIK_THREADSAFE
+#include <mutex>
+#endif
 
 // mapnik
 #include <mapnik/datasource.hpp>
 #include <mapnik/params.hpp>
 #include <mapnik/timer.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/util/noncopyable.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -47,13 +53,77 @@ extern "C" {
 
 //==============================================================================
 
+// Prepared statements of a connection that are currently not in use,
+// keyed by their sql. Shared with the result sets handing statements
+// back, so it outlives the connection if they do.
+class sqlite_statement_cache : mapnik::util::noncopyable
+{
+public:
+    static constexpr std::size_t max_size = 32;
+
+    sqlite_statement_cache()
+        : statements_(),
+          closed_(false) {}
+
+    sqlite3_stmt* take(std::string const& sql)
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        auto itr = statements_.find(sql);
+        if (itr == statements_.end()) return nullptr;
+        sqlite3_stmt* stmt = itr->second;
+        statements_.erase(itr);
+        return stmt;
+    }
+
+    void put(std::string const& sql, sqlite3_stmt* stmt)
+    {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        {
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::mutex> lock(mutex_);
+#endif
+            if (!closed_ && statements_.size() < max_size)
+            {
+                statements_.emplace(sql, stmt);
+                return;
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    // finalizes all cached statements, later ones are finalized when put back
+    void close()
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        for (auto & item : statements_)
+        {
+            sqlite3_finalize(item.second);
+        }
+        statements_.clear();
+        closed_ = true;
+    }
+
+private:
+    std::unordered_multimap<std::string, sqlite3_stmt*> statements_;
+    bool closed_;
+#ifdef MAPNIK_THREADSAFE
+    std::mutex mutex_;
+#endif
+};
+
 class sqlite_connection
 {
 public:
 
     sqlite_connection (std::string const& file)
         : db_(0),
-          file_(file)
+          file_(file),
+          statements_(std::make_shared<sqlite_statement_cache>())
     {
 #if SQLITE_VERSION_NUMBER >= 3005000
         int mode = SQLITE_OPEN_READWRITE;
@@ -83,7 +153,8 @@ public:
 
     sqlite_connection (std::string const& file, int flags)
         : db_(0),
-          file_(file)
+          file_(file),
+          statements_(std::make_shared<sqlite_statement_cache>())
     {
 #if SQLITE_VERSION_NUMBER >= 3005000
         const int rc = sqlite3_open_v2 (file_.c_str(), &db_, flags, 0);
@@ -101,6 +172,7 @@ public:
 
     virtual ~sqlite_connection ()
     {
+        statements_->close();
         if (db_)
         {
             sqlite3_close (db_);
@@ -138,6 +210,41 @@ public:
         return std::make_shared<sqlite_resultset>(stmt);
     }
 
+    // Like execute_query() but reuses a statement prepared earlier for the
+    // same sql. When the statement has parameters ?1 to ?4 they are bound
+    // to minx, maxx, miny and maxy of bbox.
+    std::shared_ptr<sqlite_resultset> execute_prepared(std::string const& sql,
+                                                       mapnik::box2d<double> const& bbox)
+    {
+#ifdef MAPNIK_STATS
+        mapnik::progress_timer __stats__(std::clog, std::string("sqlite_resultset::execute_prepared ") + sql);
+#endif
+        sqlite3_stmt* stmt = statements_->take(sql);
+        if (!stmt)
+        {
+            const int rc = sqlite3_prepare_v2 (db_, sql.c_str(), -1, &stmt, 0);
+            if (rc != SQLITE_OK)
+            {
+                throw_sqlite_error(sql);
+            }
+        }
+        std::shared_ptr<sqlite_statement_cache> statements = statements_;
+        auto rs = std::make_shared<sqlite_resultset>(stmt, [statements, sql](sqlite3_stmt* s) {
+            statements->put(sql, s);
+        });
+        if (sqlite3_bind_parameter_count(stmt) >= 4)
+        {
+            if ((sqlite3_bind_double(stmt, 1, bbox.minx()) != SQLITE_OK) ||
+                (sqlite3_bind_double(stmt, 2, bbox.maxx()) != SQLITE_OK) ||
+                (sqlite3_bind_double(stmt, 3, bbox.miny()) != SQLITE_OK) ||
+                (sqlite3_bind_double(stmt, 4, bbox.maxy()) != SQLITE_OK))
+            {
+                throw_sqlite_error(sql);
+            }
+        }
+        return rs;
+    }
+
     void execute(std::string const& sql)
     {
 #ifdef MAPNIK_STATS
@@ -177,6 +284,7 @@ private:
 
     sqlite3* db_;
     std::string file_;
+    std::shared_ptr<sqlite_statement_cache> statements_;
 };
 
 #endif // MAPNIK_SQLITE_CONNECTION_HPP
@@ -28,6 +28,7 @@
 // mapnik
 #include <mapnik/debug.hpp>
 #include <mapnik/boolean.hpp>
+#include <mapnik/sql_filter.hpp>
 #include <mapnik/sql_utils.hpp>
 #include <mapnik/util/geometry_to_ds_type.hpp>
 #include <mapnik/timer.hpp>
@@ -528,7 +529,8 @@ featureset_ptr sqlite_datasource::features(query const& q) const
                                                key_field_,
                                                index_table_,
                                                geometry_table_,
-                                               intersects_token_);
+                                               intersects_token_,
+                                               true);
         }
         else
         {
@@ -537,6 +539,27 @@ featureset_ptr sqlite_datasource::features(query const& q) const
 
         s << query ;
 
+        // leave out the rows none of the rules drawing the layer match;
+        // the filter tests the selected columns, so the select is wrapped
+        std::string filter;
+        if (q.get_filter())
+        {
+            filter = mapnik::sql_utils::filter_to_sql(*q.get_filter(), desc_, q.variables());
+        }
+        if (!filter.empty())
+        {
+            std::string const select = s.str();
+            s.str(std::string());
+            s << "SELECT * FROM (" << select << ") WHERE " << filter;
+        }
+
+        // sort the groups the render asks for, unless the table sql
+        // orders the rows itself
+        if (!q.order_by().empty() && !boost::algorithm::icontains(table_, "order by"))
+        {
+            s << " ORDER BY [" << q.order_by() << "]";
+        }
+
         if (row_limit_ > 0)
         {
             s << " LIMIT " << row_limit_;
@@ -549,7 +572,9 @@ featureset_ptr sqlite_datasource::features(query const& q) const
 
         MAPNIK_LOG_DEBUG(sqlite) << "sqlite_datasource: " << s.str();
 
-        std::shared_ptr<sqlite_resultset> rs(dataset_->execute_query(s.str()));
+        // the sql only depends on the requested properties, so its
+        // statement is prepared once and reused with the bbox bound
+        std::shared_ptr<sqlite_resultset> rs(dataset_->execute_prepared(s.str(), e));
 
         return std::make_shared<sqlite_featureset>(rs,
                                                      ctx,
@@ -609,7 +634,8 @@ featureset_ptr sqlite_datasource::features_at_point(coord2d const& pt, double to
                                                key_field_,
                                                index_table_,
                                                geometry_table_,
-                                               intersects_token_);
+                                               intersects_token_,
+                                               true);
         }
         else
         {
@@ -630,7 +656,9 @@ featureset_ptr sqlite_datasource::features_at_point(coord2d const& pt, double to
 
         MAPNIK_LOG_DEBUG(sqlite) << "sqlite_datasource: " << s.str();
 
-        std::shared_ptr<sqlite_resultset> rs(dataset_->execute_query(s.str()));
+        // the sql only depends on the requested properties, so its
+        // statement is prepared once and reused with the bbox bound
+        std::shared_ptr<sqlite_resultset> rs(dataset_->execute_prepared(s.str(), e));
 
         return std::make_shared<sqlite_featureset>(rs,
                                                      ctx,
@@ -30,6 +30,7 @@
 
 // stl
 #include <string.h>
+#include <functional>
 
 // sqlite
 extern "C" {
@@ -44,8 +45,19 @@ class sqlite_resultset
 {
 public:
 
+    using release_type = std::function<void(sqlite3_stmt*)>;
+
     sqlite_resultset (sqlite3_stmt* stmt)
-        : stmt_(stmt)
+        : stmt_(stmt),
+          release_()
+    {
+    }
+
+    // release takes ownership of the statement once the results are
+    // no longer needed, instead of it being finalized
+    sqlite_resultset (sqlite3_stmt* stmt, release_type const& release)
+        : stmt_(stmt),
+          release_(release)
     {
     }
 
@@ -53,7 +65,8 @@ public:
     {
         if (stmt_)
         {
-            sqlite3_finalize (stmt_);
+            if (release_) release_(stmt_);
+            else sqlite3_finalize (stmt_);
         }
     }
 
@@ -140,6 +153,7 @@ public:
 private:
 
     sqlite3_stmt* stmt_;
+    release_type release_;
 };
 
 #endif // MAPNIK_SQLITE_RESULTSET_HPP
@@ -30,6 +30,9 @@
 #include <boost/algorithm/string.hpp>
 
 // mapnik
+#include <mapnik/boolean.hpp>
+#include <mapnik/debug.hpp>
+#include <mapnik/feature_factory.hpp>
 #include <mapnik/unicode.hpp>
 #include <mapnik/value/types.hpp>
 #include <mapnik/geometry/box2d.hpp>
@@ -38,6 +41,9 @@
 #include <mapnik/json/topojson_utils.hpp>
 #include <mapnik/util/variant.hpp>
 #include <mapnik/util/file_io.hpp>
+#include <mapnik/util/fs.hpp>
+#include <mapnik/util/geometry_to_ds_type.hpp>
+#include <mapnik/util/feature_store.hpp>
 #include <mapnik/make_unique.hpp>
 
 using mapnik::datasource;
@@ -140,7 +146,8 @@ topojson_datasource::topojson_datasource(parameters const& params)
     inline_string_(),
     extent_(),
     tr_(new mapnik::transcoder(*params.get<std::string>("encoding","utf-8"))),
-    tree_(nullptr)
+    tree_(nullptr),
+    store_()
 {
     boost::optional<std::string> inline_string = params.get<std::string>("inline");
     if (inline_string)
@@ -162,6 +169,10 @@ topojson_datasource::topojson_datasource(parameters const& params)
     {
         parse_topojson(inline_string_.c_str());
     }
+    else if (mapnik::util::exists(filename_ + ".features"))
+    {
+        initialise_feature_store(filename_ + ".features");
+    }
     else
     {
         mapnik::util::file file(filename_);
@@ -172,7 +183,67 @@ topojson_datasource::topojson_datasource(parameters const& params)
         std::string file_buffer;
         file_buffer.resize(file.size());
         auto count = std::fread(&file_buffer[0], file.size(), 1, file.get());
-        if (count == 1) parse_topojson(file_buffer.c_str());
+        if (count == 1)
+        {
+            parse_topojson(file_buffer.c_str());
+            if (*params.get<mapnik::boolean_type>("feature_store", false))
+            {
+                write_feature_store(filename_ + ".features");
+            }
+        }
+    }
+}
+
+void topojson_datasource::initialise_feature_store(std::string const& filename)
+{
+    try
+    {
+        store_ = mapnik::util::open_feature_store(filename);
+    }
+    catch (std::exception const& ex)
+    {
+        throw mapnik::datasource_exception("TopoJSON Plugin: " + std::string(ex.what()));
+    }
+    extent_ = store_->extent();
+    // attributes of the first feature, as for the source
+    std::vector<mapnik::util::index_record> records;
+    store_->first(1, records);
+    mapnik::context_ptr ctx = store_->make_context();
+    mapnik::transcoder tr("utf8");
+    for (auto const& rec : records)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, -1));
+        store_->read(rec, *feature, tr);
+        for (auto const& kv : *feature)
+        {
+            desc_.add_descriptor(mapnik::attribute_descriptor(std::get<0>(kv),
+                                                              mapnik::util::apply_visitor(attr_value_converter(),
+                                                                                          std::get<1>(kv))));
+        }
+    }
+}
+
+void topojson_datasource::write_feature_store(std::string const& filename) const
+{
+    try
+    {
+        mapnik::util::write_feature_store(filename, [this](mapnik::util::feature_store_writer & writer)
+            {
+                mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+                std::size_t feature_id = 1;
+                for (auto const& geom : topo_.geometries)
+                {
+                    mapnik::feature_ptr feature = mapnik::util::apply_visitor(
+                        mapnik::topojson::feature_generator<mapnik::context_ptr>(ctx, *tr_, topo_, *arcs_, feature_id++),
+                        geom);
+                    if (feature) writer.add(*feature);
+                }
+            });
+    }
+    catch (std::exception const& ex)
+    {
+        // the source has been loaded, carry on without the cache
+        MAPNIK_LOG_ERROR(topojson) << "topojson_datasource: could not write '" << filename << "': " << ex.what();
     }
 }
 
@@ -195,15 +266,20 @@ void topojson_datasource::parse_topojson(T const& buffer)
         throw mapnik::datasource_exception("topojson_datasource: Failed parse TopoJSON file '" + filename_ + "'");
     }
 
+    arcs_ = std::make_shared<mapnik::topojson::decoded_arcs>(topo_);
+    topo_.arcs.clear();
+    topo_.arcs.shrink_to_fit();
+
     using values_container = std::vector< std::pair<box_type, std::size_t> >;
     values_container values;
     values.reserve(topo_.geometries.size());
+    mapnik::topojson::bounding_box_visitor bbox_visitor(topo_, *arcs_);
 
     std::size_t geometry_index = 0;
     bool first = true;
     for (auto const& geom : topo_.geometries)
     {
-        mapnik::box2d<double> box = mapnik::util::apply_visitor(mapnik::topojson::bounding_box_visitor(topo_), geom);
+        mapnik::box2d<double> box = mapnik::util::apply_visitor(bbox_visitor, geom);
         if (box.valid())
         {
             if (first)
@@ -237,6 +313,30 @@ boost::optional<mapnik::datasource_geometry_t> topojson_datasource::get_geometry
 {
     boost::optional<mapnik::datasource_geometry_t> result;
     int multi_type = 0;
+    if (store_)
+    {
+        std::vector<mapnik::util::index_record> records;
+        store_->first(5, records);
+        mapnik::context_ptr ctx = store_->make_context();
+        mapnik::transcoder tr("utf8");
+        for (auto const& rec : records)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, -1));
+            store_->read(rec, *feature, tr);
+            result = mapnik::util::to_ds_type(static_cast<mapnik::feature_impl const&>(*feature).get_geometry());
+            if (result)
+            {
+                int type = static_cast<int>(*result);
+                if (multi_type > 0 && multi_type != type)
+                {
+                    result.reset(mapnik::datasource_geometry_t::Collection);
+                    return result;
+                }
+                multi_type = type;
+            }
+        }
+        return result;
+    }
     std::size_t num_features = topo_.geometries.size();
     for (std::size_t i = 0; i < num_features && i < 5; ++i)
     {
@@ -284,7 +384,11 @@ mapnik::featureset_ptr topojson_datasource::features(mapnik::query const& q) con
         if (tree_)
         {
             tree_->query(boost::geometry::index::intersects(box),std::back_inserter(index_array));
-            return std::make_shared<topojson_featureset>(topo_, *tr_, std::move(index_array));
+            return std::make_shared<topojson_featureset>(topo_, arcs_, *tr_, std::move(index_array));
+        }
+        else if (store_)
+        {
+            return std::make_shared<mapnik::util::feature_store_featureset>(store_, box, q.feature_arena());
         }
     }
     // otherwise return an empty featureset pointer
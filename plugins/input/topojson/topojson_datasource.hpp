@@ -50,6 +50,9 @@
 #include <deque>
 #include <memory>
 
+namespace mapnik { namespace util { class feature_store; }}
+namespace mapnik { namespace topojson { class decoded_arcs; }}
+
 class topojson_datasource : public mapnik::datasource
 {
 public:
@@ -71,6 +74,8 @@ public:
     template <typename T>
     void parse_topojson(T const& buffer);
 private:
+    void initialise_feature_store(std::string const& filename);
+    void write_feature_store(std::string const& filename) const;
     mapnik::datasource::datasource_t type_;
     std::map<std::string, mapnik::parameters> statistics_;
     mapnik::layer_descriptor desc_;
@@ -79,7 +84,12 @@ private:
     mapnik::box2d<double> extent_;
     std::unique_ptr<mapnik::transcoder> tr_;
     mapnik::topojson::topology topo_;
+    // arcs decoded once and shared with the featuresets, topo_.arcs is
+    // released once they are
+    std::shared_ptr<mapnik::topojson::decoded_arcs const> arcs_;
     std::unique_ptr<spatial_index_type> tree_;
+    // <file>.features, queried in place
+    std::shared_ptr<mapnik::util::feature_store const> store_;
 };
 
 
@@ -28,18 +28,15 @@
 #include <vector>
 #include <fstream>
 
-#pragma GCC diagnostic push
-#include <mapnik/warning_ignore.hpp>
-#include <boost/range/adaptor/reversed.hpp>
-#pragma GCC diagnostic pop
-
 #include "topojson_featureset.hpp"
 
 topojson_featureset::topojson_featureset(mapnik::topojson::topology const& topo,
+                                         std::shared_ptr<mapnik::topojson::decoded_arcs const> const& arcs,
                                          mapnik::transcoder const& tr,
                                          array_type && index_array)
     : ctx_(std::make_shared<mapnik::context_type>()),
       topo_(topo),
+      arcs_(arcs),
       tr_(tr),
       index_array_(std::move(index_array)),
       index_itr_(index_array_.begin()),
@@ -58,7 +55,7 @@ mapnik::feature_ptr topojson_featureset::next()
         {
             mapnik::topojson::geometry const& geom = topo_.geometries[index];
             mapnik::feature_ptr feature = mapnik::util::apply_visitor(
-                mapnik::topojson::feature_generator<mapnik::context_ptr>(ctx_, tr_, topo_, feature_id_++),
+                mapnik::topojson::feature_generator<mapnik::context_ptr>(ctx_, tr_, topo_, *arcs_, feature_id_++),
                 geom);
             return feature;
         }
@@ -34,6 +34,7 @@ class topojson_featureset : public mapnik::Featureset
 public:
     typedef std::deque<topojson_datasource::item_type> array_type;
     topojson_featureset(mapnik::topojson::topology const& topo,
+                        std::shared_ptr<mapnik::topojson::decoded_arcs const> const& arcs,
                         mapnik::transcoder const& tr,
                         array_type && index_array);
 
@@ -44,6 +45,7 @@ private:
     mapnik::context_ptr ctx_;
     mapnik::box2d<double> box_;
     mapnik::topojson::topology const& topo_;
+    std::shared_ptr<mapnik::topojson::decoded_arcs const> arcs_;
     mapnik::transcoder const& tr_;
     const array_type index_array_;
     array_type::const_iterator index_itr_;
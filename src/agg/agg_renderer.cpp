@@ -25,12 +25,14 @@
 #include <mapnik/agg_rasterizer.hpp>
 #include <mapnik/agg_helpers.hpp>
 #include <mapnik/rule.hpp>
+#include <mapnik/symbolizer.hpp>
 #include <mapnik/debug.hpp>
 #include <mapnik/layer.hpp>
 #include <mapnik/label_collision_detector.hpp>
 #include <mapnik/feature_type_style.hpp>
 #include <mapnik/marker.hpp>
 #include <mapnik/marker_cache.hpp>
+#include <mapnik/marker_sprite_cache.hpp>
 #include <mapnik/unicode.hpp>
 #include <mapnik/font_set.hpp>
 #include <mapnik/parse_path.hpp>
@@ -43,6 +45,10 @@
 #include <mapnik/image_filter.hpp>
 #include <mapnik/image_any.hpp>
 #include <mapnik/make_unique.hpp>
+#include <mapnik/renderer_common/compiled_symbolizer.hpp>
+#include <mapnik/renderer_common/line_path_cache.hpp>
+#include <mapnik/renderer_common/label_phase.hpp>
+#include <mapnik/text/renderer.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore_agg.hpp>
@@ -69,29 +75,84 @@ namespace mapnik
 {
 
 template <typename T0, typename T1>
-agg_renderer<T0,T1>::agg_renderer(Map const& m, T0 & pixmap, double scale_factor, unsigned offset_x, unsigned offset_y)
-    : feature_style_processor<agg_renderer>(m, scale_factor),
-      buffers_(),
-      internal_buffers_(m.width(), m.height()),
+agg_render_context<T0,T1>::agg_render_context()
+    : internal_buffers_(0, 0),
       inflated_buffer_(),
-      ras_ptr(new rasterizer),
+      inflated_painted_(),
+      ras_ptr_(new rasterizer),
+      detector_(),
       gamma_method_(GAMMA_POWER),
       gamma_(1.0),
-      common_(m, attributes(), offset_x, offset_y, m.width(), m.height(), scale_factor)
+      marker_sprites_(),
+      sprite_ras_() {}
+
+template <typename T0, typename T1>
+agg_render_context<T0,T1>::~agg_render_context() {}
+
+template <typename T0, typename T1>
+std::shared_ptr<T1> agg_render_context<T0,T1>::detector(box2d<double> const& extent)
+{
+    if (detector_ && detector_.use_count() == 1 && detector_->extent() == extent)
+    {
+        detector_->clear();
+    }
+    else
+    {
+        detector_ = std::make_shared<T1>(extent);
+    }
+    return detector_;
+}
+
+template <typename T0, typename T1>
+agg_renderer<T0,T1>::agg_renderer(Map const& m, T0 & pixmap, double scale_factor, unsigned offset_x, unsigned offset_y)
+    : feature_style_processor<agg_renderer>(m, scale_factor),
+      buffers_(),
+      own_context_(std::make_unique<context_type>()),
+      internal_buffers_(own_context_->internal_buffers_),
+      inflated_buffer_(own_context_->inflated_buffer_),
+      inflated_painted_(own_context_->inflated_painted_),
+      ras_ptr(own_context_->ras_ptr_),
+      gamma_method_(own_context_->gamma_method_),
+      gamma_(own_context_->gamma_),
+      common_(m, attributes(), offset_x, offset_y, m.width(), m.height(), scale_factor),
+      filter_threads_(1),
+      raster_threads_(1),
+      style_threads_(1),
+      marker_sprites_(own_context_->marker_sprites_),
+      sprite_ras_(own_context_->sprite_ras_),
+      marker_sprite_tolerance_(0.0),
+      dash_collapse_threshold_(0.0),
+      symbolizer_pass_(all_symbolizers),
+      label_phase_enabled_(false),
+      opaque_(false),
+      style_pixmap_()
 {
     setup(m, pixmap);
 }
 
 template <typename T0, typename T1>
 agg_renderer<T0,T1>::agg_renderer(Map const& m, request const& req, attributes const& vars, T0 & pixmap, double scale_factor, unsigned offset_x, unsigned offset_y)
-    : feature_style_processor<agg_renderer>(m, scale_factor),
+    : feature_style_processor<agg_renderer>(m, req, scale_factor),
       buffers_(),
-      internal_buffers_(req.width(), req.height()),
-      inflated_buffer_(),
-      ras_ptr(new rasterizer),
-      gamma_method_(GAMMA_POWER),
-      gamma_(1.0),
-      common_(m, req, vars, offset_x, offset_y, req.width(), req.height(), scale_factor)
+      own_context_(std::make_unique<context_type>()),
+      internal_buffers_(own_context_->internal_buffers_),
+      inflated_buffer_(own_context_->inflated_buffer_),
+      inflated_painted_(own_context_->inflated_painted_),
+      ras_ptr(own_context_->ras_ptr_),
+      gamma_method_(own_context_->gamma_method_),
+      gamma_(own_context_->gamma_),
+      common_(m, req, vars, offset_x, offset_y, req.width(), req.height(), scale_factor),
+      filter_threads_(1),
+      raster_threads_(1),
+      style_threads_(1),
+      marker_sprites_(own_context_->marker_sprites_),
+      sprite_ras_(own_context_->sprite_ras_),
+      marker_sprite_tolerance_(0.0),
+      dash_collapse_threshold_(0.0),
+      symbolizer_pass_(all_symbolizers),
+      label_phase_enabled_(false),
+      opaque_(false),
+      style_pixmap_()
 {
     setup(m, pixmap);
 }
@@ -101,16 +162,135 @@ agg_renderer<T0,T1>::agg_renderer(Map const& m, T0 & pixmap, std::shared_ptr<T1>
                               double scale_factor, unsigned offset_x, unsigned offset_y)
     : feature_style_processor<agg_renderer>(m, scale_factor),
       buffers_(),
-      internal_buffers_(m.width(), m.height()),
-      inflated_buffer_(),
-      ras_ptr(new rasterizer),
-      gamma_method_(GAMMA_POWER),
-      gamma_(1.0),
-      common_(m, attributes(), offset_x, offset_y, m.width(), m.height(), scale_factor, detector)
+      own_context_(std::make_unique<context_type>()),
+      internal_buffers_(own_context_->internal_buffers_),
+      inflated_buffer_(own_context_->inflated_buffer_),
+      inflated_painted_(own_context_->inflated_painted_),
+      ras_ptr(own_context_->ras_ptr_),
+      gamma_method_(own_context_->gamma_method_),
+      gamma_(own_context_->gamma_),
+      common_(m, attributes(), offset_x, offset_y, m.width(), m.height(), scale_factor, detector),
+      filter_threads_(1),
+      raster_threads_(1),
+      style_threads_(1),
+      marker_sprites_(own_context_->marker_sprites_),
+      sprite_ras_(own_context_->sprite_ras_),
+      marker_sprite_tolerance_(0.0),
+      dash_collapse_threshold_(0.0),
+      symbolizer_pass_(all_symbolizers),
+      label_phase_enabled_(false),
+      opaque_(false),
+      style_pixmap_()
 {
     setup(m, pixmap);
 }
 
+template <typename T0, typename T1>
+agg_renderer<T0,T1>::agg_renderer(Map const& m, T0 & pixmap, context_type & context,
+                                  double scale_factor, unsigned offset_x, unsigned offset_y)
+    : feature_style_processor<agg_renderer>(m, scale_factor),
+      buffers_(),
+      own_context_(),
+      internal_buffers_(context.internal_buffers_),
+      inflated_buffer_(context.inflated_buffer_),
+      inflated_painted_(context.inflated_painted_),
+      ras_ptr(context.ras_ptr_),
+      gamma_method_(context.gamma_method_),
+      gamma_(context.gamma_),
+      common_(m, attributes(), offset_x, offset_y, m.width(), m.height(), scale_factor,
+              context.detector(box2d<double>(-m.buffer_size(), -m.buffer_size(),
+                                             m.width() + m.buffer_size(), m.height() + m.buffer_size()))),
+      filter_threads_(1),
+      raster_threads_(1),
+      style_threads_(1),
+      marker_sprites_(context.marker_sprites_),
+      sprite_ras_(context.sprite_ras_),
+      marker_sprite_tolerance_(0.0),
+      dash_collapse_threshold_(0.0),
+      symbolizer_pass_(all_symbolizers),
+      label_phase_enabled_(false),
+      opaque_(false),
+      style_pixmap_()
+{
+    setup(m, pixmap);
+}
+
+template <typename T0, typename T1>
+agg_renderer<T0,T1>::agg_renderer(Map const& m, request const& req, attributes const& vars, T0 & pixmap,
+                                  context_type & context, double scale_factor, unsigned offset_x, unsigned offset_y)
+    : feature_style_processor<agg_renderer>(m, req, scale_factor),
+      buffers_(),
+      own_context_(),
+      internal_buffers_(context.internal_buffers_),
+      inflated_buffer_(context.inflated_buffer_),
+      inflated_painted_(context.inflated_painted_),
+      ras_ptr(context.ras_ptr_),
+      gamma_method_(context.gamma_method_),
+      gamma_(context.gamma_),
+      common_(m, req, vars, offset_x, offset_y, req.width(), req.height(), scale_factor,
+              context.detector(box2d<double>(-req.buffer_size(), -req.buffer_size(),
+                                             req.width() + req.buffer_size(), req.height() + req.buffer_size()))),
+      filter_threads_(1),
+      raster_threads_(1),
+      style_threads_(1),
+      marker_sprites_(context.marker_sprites_),
+      sprite_ras_(context.sprite_ras_),
+      marker_sprite_tolerance_(0.0),
+      dash_collapse_threshold_(0.0),
+      symbolizer_pass_(all_symbolizers),
+      label_phase_enabled_(false),
+      opaque_(false),
+      style_pixmap_()
+{
+    setup(m, pixmap);
+}
+
+namespace detail {
+
+// the request a view transform was made from
+inline request transform_request(view_transform const& t)
+{
+    return request(static_cast<unsigned>(t.width()), static_cast<unsigned>(t.height()), t.extent());
+}
+
+}
+
+template <typename T0, typename T1>
+agg_renderer<T0,T1>::agg_renderer(Map const& m, agg_renderer const& parent)
+    : feature_style_processor<agg_renderer>(m, parent.common_.scale_factor_),
+      buffers_(),
+      own_context_(std::make_unique<context_type>()),
+      internal_buffers_(own_context_->internal_buffers_),
+      inflated_buffer_(own_context_->inflated_buffer_),
+      inflated_painted_(own_context_->inflated_painted_),
+      ras_ptr(own_context_->ras_ptr_),
+      gamma_method_(own_context_->gamma_method_),
+      gamma_(own_context_->gamma_),
+      common_(m, detail::transform_request(parent.common_.t_), parent.common_.vars_,
+              static_cast<unsigned>(parent.common_.t_.offset_x()),
+              static_cast<unsigned>(parent.common_.t_.offset_y()),
+              parent.common_.width_, parent.common_.height_, parent.common_.scale_factor_,
+              parent.common_.detector_),
+      filter_threads_(parent.filter_threads_),
+      raster_threads_(parent.raster_threads_),
+      style_threads_(1),
+      marker_sprites_(own_context_->marker_sprites_),
+      sprite_ras_(own_context_->sprite_ras_),
+      marker_sprite_tolerance_(parent.marker_sprite_tolerance_),
+      dash_collapse_threshold_(parent.dash_collapse_threshold_),
+      symbolizer_pass_(parent.symbolizer_pass_),
+      label_phase_enabled_(false),
+      opaque_(false),
+      style_pixmap_(std::make_unique<buffer_type>(parent.common_.width_, parent.common_.height_))
+{
+    common_.query_extent_ = parent.common_.query_extent_;
+    buffers_.emplace(*style_pixmap_);
+    internal_buffers_.reset(common_.width_, common_.height_);
+    ras_ptr->reset();
+    ras_ptr->filling_rule(agg::fill_non_zero);
+    mapnik::set_premultiplied_alpha(*style_pixmap_, true);
+}
+
 template <typename buffer_type>
 struct setup_agg_bg_visitor
 {
@@ -153,12 +333,64 @@ struct setup_agg_bg_visitor
     double opacity_;
 };
 
+namespace {
+
+bool keeps_opaque(boost::optional<composite_mode_e> const& comp_op)
+{
+    return !comp_op || composite_keeps_opaque(*comp_op);
+}
+
+bool layers_keep_opaque(std::vector<layer> const& layers)
+{
+    for (layer const& lay : layers)
+    {
+        if (!keeps_opaque(lay.comp_op()) || !layers_keep_opaque(lay.layers())) return false;
+    }
+    return true;
+}
+
+// Whether nothing drawn on m can make a pixel of its opaque background
+// translucent again. Group symbolizers are not looked into.
+bool renders_opaque(Map const& m)
+{
+    boost::optional<color> const& bg = m.background();
+    if (!bg || bg->alpha() < 255) return false;
+    if (m.background_image() && !composite_keeps_opaque(m.background_image_comp_op())) return false;
+    if (!layers_keep_opaque(m.layers())) return false;
+    for (auto const& item : m.styles())
+    {
+        feature_type_style const& st = item.second;
+        if (!keeps_opaque(st.comp_op()) || !st.direct_image_filters().empty()) return false;
+        for (rule const& r : st.get_rules())
+        {
+            for (symbolizer const& sym : r.get_symbolizers())
+            {
+                if (sym.is<group_symbolizer>()) return false;
+                bool keeps = util::apply_visitor([](auto const& s) {
+                        return keeps_opaque(get_optional<composite_mode_e>(s, keys::comp_op)) &&
+                            keeps_opaque(get_optional<composite_mode_e>(s, keys::halo_comp_op));
+                    }, sym);
+                if (!keeps) return false;
+            }
+        }
+    }
+    return true;
+}
+
+}
+
 template <typename T0, typename T1>
 void agg_renderer<T0,T1>::setup(Map const &m, buffer_type & pixmap)
 {
     buffers_.emplace(pixmap);
+    // drop whatever a previous renderer left in a shared context
+    internal_buffers_.reset(common_.width_, common_.height_);
+    ras_ptr->reset();
+    ras_ptr->filling_rule(agg::fill_non_zero);
 
     mapnik::set_premultiplied_alpha(pixmap, true);
+    pixmap.set_opaque(false);
+    opaque_ = renders_opaque(m);
     boost::optional<color> const& bg = m.background();
     if (bg)
     {
@@ -193,17 +425,60 @@ void agg_renderer<T0,T1>::setup(Map const &m, buffer_type & pixmap)
 template <typename T0, typename T1>
 agg_renderer<T0,T1>::~agg_renderer() {}
 
+template <typename T0, typename T1>
+compiled_symbolizer_cache & agg_renderer<T0,T1>::compiled_symbolizers()
+{
+    if (!compiled_symbolizers_)
+    {
+        compiled_symbolizers_ = std::make_unique<compiled_symbolizer_cache>();
+    }
+    return *compiled_symbolizers_;
+}
+
+template <typename T0, typename T1>
+line_path_cache & agg_renderer<T0,T1>::line_paths()
+{
+    if (!line_paths_)
+    {
+        line_paths_ = std::make_unique<line_path_cache>();
+    }
+    return *line_paths_;
+}
+
+template <typename T0, typename T1>
+void agg_renderer<T0,T1>::start_feature(feature_ptr const& feature)
+{
+    if (line_paths_) line_paths_->start_feature(feature);
+}
+
 template <typename T0, typename T1>
 void agg_renderer<T0,T1>::start_map_processing(Map const& map)
 {
     MAPNIK_LOG_DEBUG(agg_renderer) << "agg_renderer: Start map processing bbox=" << map.get_current_extent();
     ras_ptr->clip_box(0,0,common_.width_,common_.height_);
+    if (label_phase_enabled_)
+    {
+        label_phase_ = std::make_unique<mapnik::label_phase>(common_, map);
+    }
 }
 
 template <typename T0, typename T1>
 void agg_renderer<T0,T1>::end_map_processing(Map const& map)
 {
-    mapnik::demultiply_alpha(buffers_.top().get());
+    if (label_phase_)
+    {
+        draw_label_phase();
+    }
+    if (opaque_)
+    {
+        // demultiplying opaque pixels leaves them as they are
+        buffers_.top().get().set_premultiplied(false);
+        buffers_.top().get().set_opaque(true);
+    }
+    else
+    {
+        mapnik::demultiply_alpha(buffers_.top().get());
+    }
     MAPNIK_LOG_DEBUG(agg_renderer) << "agg_renderer: End map processing";
 }
 
@@ -216,8 +491,15 @@ void agg_renderer<T0,T1>::start_layer_processing(layer const& lay, box2d<double>
 
     if (lay.clear_label_cache())
     {
+        if (label_phase_) label_phase_->wait();
         common_.detector_->clear();
     }
+    // rules with pre-evaluated properties are copied for each layer, and a
+    // copy may take the address of a symbolizer from a previous layer
+    if (compiled_symbolizers_) compiled_symbolizers_->clear();
+    // the line paths of a feature are kept for the next styles when the
+    // layer keeps its features for them anyway
+    line_paths().retain(lay.cache_features() && lay.styles().size() > 1 && lay.group_by().empty());
 
     common_.query_extent_ = query_extent;
     boost::optional<box2d<double> > const& maximum_extent = lay.maximum_extent();
@@ -226,7 +508,15 @@ void agg_renderer<T0,T1>::start_layer_processing(layer const& lay, box2d<double>
         common_.query_extent_.clip(*maximum_extent);
     }
 
-    if (lay.comp_op() || lay.get_opacity() < 1.0)
+    // layers to be cached render into a buffer of their own and note the
+    // labels they place
+    auto pending = pending_layer_images_.find(&lay);
+    if (pending != pending_layer_images_.end())
+    {
+        if (label_phase_) label_phase_->wait();
+        common_.detector_->record(&pending->second.labels);
+    }
+    if (lay.comp_op() || lay.get_opacity() < 1.0 || pending != pending_layer_images_.end())
     {
         buffers_.emplace(internal_buffers_.push());
         set_premultiplied_alpha(buffers_.top().get(), true);
@@ -242,24 +532,120 @@ void agg_renderer<T0,T1>::end_layer_processing(layer const& lyr)
 {
     MAPNIK_LOG_DEBUG(agg_renderer) << "agg_renderer: End layer processing";
 
+    if (line_paths_) line_paths_->clear();
+
     buffer_type & current_buffer = buffers_.top().get();
     buffers_.pop();
     buffer_type & previous_buffer = buffers_.top().get();
 
     if (&current_buffer != &previous_buffer)
     {
+        auto itr = pending_layer_images_.find(&lyr);
+        if (itr != pending_layer_images_.end())
+        {
+            // labels placed in the background belong to this layer too
+            if (label_phase_) label_phase_->wait();
+            common_.detector_->record(nullptr);
+            layer_image_cache::instance().insert(itr->second.key,
+                std::make_shared<image_rgba8 const>(current_buffer),
+                std::move(itr->second.labels));
+            pending_layer_images_.erase(itr);
+        }
         composite_mode_e comp_op = lyr.comp_op() ? *lyr.comp_op() : src_over;
-        composite(previous_buffer, current_buffer,
-                  comp_op, lyr.get_opacity(), 0, 0);
+        box2d<int> painted = painted_extent(current_buffer);
+        if (composite_keeps_destination(comp_op))
+        {
+            composite(previous_buffer, current_buffer, painted,
+                      comp_op, lyr.get_opacity(), 0, 0);
+        }
+        else
+        {
+            composite(previous_buffer, current_buffer,
+                      comp_op, lyr.get_opacity(), 0, 0);
+        }
+        internal_buffers_.set_painted(painted);
         internal_buffers_.pop();
     }
 }
 
+template <typename T0, typename T1>
+bool agg_renderer<T0,T1>::prepare_cached_layer(Map const& m, layer const& lay)
+{
+    layer_image_cache & cache = layer_image_cache::instance();
+    if (cache.max_bytes() == 0) return false;
+    box2d<double> const& extent = common_.t_.extent();
+    layer_image_cache::key_type key(lay.name(),
+                                    layer_image_cache::fingerprint(m, lay, common_.vars_),
+                                    extent.minx(), extent.miny(), extent.maxx(), extent.maxy(),
+                                    common_.width_, common_.height_, common_.scale_factor_,
+                                    common_.t_.offset_x(), common_.t_.offset_y());
+    layer_image_cache::label_boxes labels;
+    layer_image_cache::image_ptr image = cache.find(key, &labels);
+    if (image)
+    {
+        cached_layer_images_[&lay] = layer_image{image, std::move(key), std::move(labels)};
+        return true;
+    }
+    pending_layer_images_[&lay] = layer_image{nullptr, std::move(key), {}};
+    return false;
+}
+
+template <typename T0, typename T1>
+void agg_renderer<T0,T1>::render_cached_layer(layer const& lay)
+{
+    MAPNIK_LOG_DEBUG(agg_renderer) << "agg_renderer: Using cached image of layer=" << lay.name();
+
+    auto itr = cached_layer_images_.find(&lay);
+    if (itr == cached_layer_images_.end()) return;
+    if (lay.clear_label_cache())
+    {
+        if (label_phase_) label_phase_->wait();
+        common_.detector_->clear();
+    }
+    // the labels drawn into the image still keep later layers' labels away
+    if (label_phase_) label_phase_->wait();
+    for (box2d<double> const& box : itr->second.labels)
+    {
+        common_.detector_->insert(box);
+    }
+    composite_mode_e comp_op = lay.comp_op() ? *lay.comp_op() : src_over;
+    composite(buffers_.top().get(), *itr->second.image,
+              comp_op, lay.get_opacity(), 0, 0);
+    cached_layer_images_.erase(itr);
+}
+
 template <typename T0, typename T1>
 void agg_renderer<T0,T1>::start_style_processing(feature_type_style const& st)
 {
     MAPNIK_LOG_DEBUG(agg_renderer) << "agg_renderer: Start processing style";
 
+    if (style_pixmap_)
+    {
+        // style workers draw straight into their buffer
+        common_.t_.set_offset(0);
+        ras_ptr->clip_box(0,0,common_.width_,common_.height_);
+        buffers_.emplace(buffers_.top().get());
+        return;
+    }
+
+    if (label_phase_)
+    {
+        // symbolizers other than text and shield use the detector inline
+        bool inline_detector = false;
+        for (rule const& r : st.get_rules())
+        {
+            for (symbolizer const& sym : r)
+            {
+                if (!sym.is<text_symbolizer>() && !sym.is<shield_symbolizer>() &&
+                    draws_symbolizer(sym) && uses_placement_detector(sym))
+                {
+                    inline_detector = true;
+                }
+            }
+        }
+        if (inline_detector) label_phase_->wait();
+    }
+
     if (st.comp_op() || st.image_filters().size() > 0 || st.get_opacity() < 1)
     {
         if (st.image_filters_inflate())
@@ -287,8 +673,10 @@ void agg_renderer<T0,T1>::start_style_processing(feature_type_style const& st)
             }
             else
             {
-                mapnik::fill(*inflated_buffer_, 0); // fill with transparent colour
+                clear_region(*inflated_buffer_, inflated_painted_);
             }
+            inflated_painted_ = box2d<int>(0, 0, static_cast<int>(inflated_buffer_->width()),
+                                           static_cast<int>(inflated_buffer_->height()));
             buffers_.emplace(*inflated_buffer_);
         }
         else
@@ -312,50 +700,142 @@ void agg_renderer<T0,T1>::end_style_processing(feature_type_style const& st)
 {
     buffer_type & current_buffer = buffers_.top().get();
     buffers_.pop();
+    if (style_pixmap_)
+    {
+        // composited by the parent in end_style_worker()
+        return;
+    }
     buffer_type & previous_buffer = buffers_.top().get();
     if (&current_buffer != &previous_buffer)
     {
-        bool blend_from = false;
-        if (st.image_filters().size() > 0)
+        box2d<int> painted = composite_style(st, current_buffer, previous_buffer);
+        if (&current_buffer == inflated_buffer_.get())
         {
-            blend_from = true;
-            mapnik::filter::filter_visitor<buffer_type> visitor(current_buffer, common_.scale_factor_);
-            for (mapnik::filter::filter_type const& filter_tag : st.image_filters())
-            {
-                util::apply_visitor(visitor, filter_tag);
-            }
-            mapnik::premultiply_alpha(current_buffer);
+            inflated_painted_ = painted;
         }
-        if (st.comp_op())
+        else if (&current_buffer == &internal_buffers_.top())
         {
-            composite(previous_buffer, current_buffer,
-                      *st.comp_op(), st.get_opacity(),
-                      -common_.t_.offset(),
-                      -common_.t_.offset());
+            internal_buffers_.set_painted(painted);
+            internal_buffers_.pop();
         }
-        else if (blend_from || st.get_opacity() < 1.0)
+    }
+    if (st.direct_image_filters().size() > 0)
+    {
+        // apply any 'direct' image filters
+        mapnik::filter::apply_filters(previous_buffer, st.direct_image_filters(), common_.scale_factor_, filter_threads_);
+        mapnik::premultiply_alpha(previous_buffer);
+    }
+    MAPNIK_LOG_DEBUG(agg_renderer) << "agg_renderer: End processing style";
+}
+
+template <typename T0, typename T1>
+box2d<int> agg_renderer<T0,T1>::composite_style(feature_type_style const& st,
+                                                buffer_type & style_buffer,
+                                                buffer_type & target)
+{
+    // the style buffer started out transparent, filters and compositing
+    // only need to go over the part it was painted in when they leave
+    // transparent pixels alone
+    box2d<int> painted = painted_extent(style_buffer);
+    int offset = common_.t_.offset();
+    bool filtered = st.image_filters().size() > 0;
+    composite_mode_e comp_op = st.comp_op() ? *st.comp_op() : src_over;
+    boost::optional<int> spread = mapnik::filter::filters_spread(st.image_filters(), common_.scale_factor_);
+    if (spread && composite_keeps_destination(comp_op))
+    {
+        if (painted.valid())
         {
-            composite(previous_buffer, current_buffer,
-                      src_over, st.get_opacity(),
-                      -common_.t_.offset(),
-                      -common_.t_.offset());
+            box2d<int> region(painted);
+            region.pad(*spread);
+            region.clip(box2d<int>(0, 0, static_cast<int>(style_buffer.width()),
+                                   static_cast<int>(style_buffer.height())));
+            if (filtered)
+            {
+                // filters run on a copy of the region, the buffer
+                // itself keeps its painted extent
+                buffer_type part(static_cast<std::size_t>(region.width()),
+                                 static_cast<std::size_t>(region.height()));
+                for (int y = region.miny(); y < region.maxy(); ++y)
+                {
+                    typename buffer_type::pixel_type const* row = style_buffer.get_row(static_cast<std::size_t>(y));
+                    std::copy(row + region.minx(), row + region.maxx(),
+                              part.get_row(static_cast<std::size_t>(y - region.miny())));
+                }
+                set_premultiplied_alpha(part, true);
+                mapnik::filter::apply_filters(part, st.image_filters(), common_.scale_factor_, filter_threads_);
+                mapnik::premultiply_alpha(part);
+                composite(target, part,
+                          comp_op, st.get_opacity(),
+                          region.minx() - offset,
+                          region.miny() - offset);
+            }
+            else
+            {
+                composite(target, style_buffer, region,
+                          comp_op, st.get_opacity(),
+                          -offset, -offset);
+            }
         }
-        if (&current_buffer == &internal_buffers_.top())
+    }
+    else
+    {
+        if (filtered)
         {
-            internal_buffers_.pop();
+            mapnik::filter::apply_filters(style_buffer, st.image_filters(), common_.scale_factor_, filter_threads_);
+            mapnik::premultiply_alpha(style_buffer);
+            painted = box2d<int>(0, 0, static_cast<int>(style_buffer.width()),
+                                 static_cast<int>(style_buffer.height()));
         }
+        composite(target, style_buffer,
+                  comp_op, st.get_opacity(),
+                  -offset, -offset);
     }
-    if (st.direct_image_filters().size() > 0)
+    return painted;
+}
+
+template <typename T0, typename T1>
+bool agg_renderer<T0,T1>::renders_style_apart(feature_type_style const& st) const
+{
+    if (style_threads_ < 2 || style_pixmap_ || st.image_filters_inflate())
     {
-        // apply any 'direct' image filters
-        mapnik::filter::filter_visitor<buffer_type> visitor(previous_buffer, common_.scale_factor_);
-        for (mapnik::filter::filter_type const& filter_tag : st.direct_image_filters())
+        return false;
+    }
+    // styles without a buffer of their own draw into the one below, in order
+    if (!(st.comp_op() || st.image_filters().size() > 0 || st.get_opacity() < 1))
+    {
+        return false;
+    }
+    for (rule const& r : st.get_rules())
+    {
+        for (symbolizer const& sym : r)
         {
-            util::apply_visitor(visitor, filter_tag);
+            if (draws_symbolizer(sym) && uses_placement_detector(sym))
+            {
+                return false;
+            }
         }
-        mapnik::premultiply_alpha(previous_buffer);
     }
-    MAPNIK_LOG_DEBUG(agg_renderer) << "agg_renderer: End processing style";
+    return true;
+}
+
+template <typename T0, typename T1>
+std::unique_ptr<agg_renderer<T0,T1>> agg_renderer<T0,T1>::make_style_worker(Map const& m, feature_type_style const&)
+{
+    return std::unique_ptr<agg_renderer>(new agg_renderer(m, *this));
+}
+
+template <typename T0, typename T1>
+void agg_renderer<T0,T1>::end_style_worker(feature_type_style const& st, agg_renderer & worker)
+{
+    // as end_style_processing() would for the style drawn by the worker
+    common_.t_.set_offset(0);
+    buffer_type & target = buffers_.top().get();
+    composite_style(st, *worker.style_pixmap_, target);
+    if (st.direct_image_filters().size() > 0)
+    {
+        mapnik::filter::apply_filters(target, st.direct_image_filters(), common_.scale_factor_, filter_threads_);
+        mapnik::premultiply_alpha(target);
+    }
 }
 
 template <typename buffer_type>
@@ -424,6 +904,7 @@ struct agg_render_marker_visitor
                          renderer_type,
                          pixfmt_comp_type> svg_renderer(svg_path,
                                                         marker.get_data()->attributes());
+        svg_renderer.set_flattened_paths(marker.get_data()->get_flattened_paths());
 
         // https://github.com/mapnik/mapnik/issues/1316
         // https://github.com/mapnik/mapnik/issues/1866
@@ -572,6 +1053,81 @@ void agg_renderer<T0,T1>::painted(bool painted)
     buffers_.top().get().painted(painted);
 }
 
+template <typename T0, typename T1>
+double agg_renderer<T0,T1>::label_coverage() const
+{
+    if (label_phase_) label_phase_->wait();
+    return common_.detector_->coverage();
+}
+
+template <typename T0, typename T1>
+void agg_renderer<T0,T1>::defer_labels(std::vector<scheduled_label> & labels,
+                                       proj_transform const& prj_trans,
+                                       double max_coverage)
+{
+    std::vector<mapnik::label_phase::candidate> candidates;
+    candidates.reserve(labels.size());
+    for (scheduled_label const& label : labels)
+    {
+        candidates.push_back(mapnik::label_phase::candidate{label.feature, label.sym});
+    }
+    label_phase_->place(std::move(candidates), prj_trans, max_coverage);
+}
+
+template <typename T0, typename T1>
+void agg_renderer<T0,T1>::draw_label_phase()
+{
+    // the placement thread draws, this one waits
+    buffer_type & pixmap = buffers_.top().get();
+    mapnik::label_phase::draw_function draw = [&](mapnik::label_phase::placed_label const& label,
+                                          face_manager_freetype & font_manager)
+    {
+        symbolizer_base const& sym = label.sym;
+        feature_impl const& feature = label.feature;
+        halo_rasterizer_enum halo_rasterizer = get<halo_rasterizer_enum>(sym, keys::halo_rasterizer, feature, common_.vars_, HALO_RASTERIZER_FULL);
+        composite_mode_e comp_op = get<composite_mode_e>(sym, keys::comp_op, feature, common_.vars_, src_over);
+        composite_mode_e halo_comp_op = get<composite_mode_e>(sym, keys::halo_comp_op, feature, common_.vars_, src_over);
+        agg_text_renderer<T0> ren(pixmap,
+                                  halo_rasterizer,
+                                  comp_op,
+                                  halo_comp_op,
+                                  common_.scale_factor_,
+                                  font_manager.get_stroker());
+        if (label.shield)
+        {
+            double opacity = get<double>(sym, keys::opacity, feature, common_.vars_, 1.0);
+            for (auto const& glyphs : label.placements)
+            {
+                marker_info_ptr mark = glyphs->get_marker();
+                if (mark)
+                {
+                    render_marker(glyphs->marker_pos(),
+                                  *mark->marker_,
+                                  mark->transform_,
+                                  opacity, comp_op);
+                }
+                ren.render(*glyphs);
+            }
+        }
+        else
+        {
+            auto halo_transform = get_optional<transform_type>(sym, keys::halo_transform);
+            if (halo_transform)
+            {
+                agg::trans_affine halo_affine_transform;
+                evaluate_transform(halo_affine_transform, feature, common_.vars_, *halo_transform, common_.scale_factor_);
+                ren.set_halo_transform(halo_affine_transform);
+            }
+            for (auto const& glyphs : label.placements)
+            {
+                ren.render(*glyphs);
+            }
+        }
+    };
+    std::unique_ptr<mapnik::label_phase> phase = std::move(label_phase_);
+    phase->draw(draw);
+}
+
 template <typename T0, typename T1>
 void agg_renderer<T0,T1>::debug_draw_box(box2d<double> const& box,
                                      double x, double y, double angle)
@@ -643,6 +1199,7 @@ void agg_renderer<T0,T1>::draw_geo_extent(box2d<double> const& extent, mapnik::c
     }
 }
 
+template class agg_render_context<image_rgba8>;
 template class agg_renderer<image_rgba8>;
 template void agg_renderer<image_rgba8>::debug_draw_box<agg::rendering_buffer>(
                 agg::rendering_buffer& buf,
@@ -0,0 +1,111 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/metatile_renderer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/scale_denominator.hpp>
+#include <mapnik/renderer_common/layer_buckets.hpp>
+#include <mapnik/debug.hpp>
+
+// stl
+#include <stdexcept>
+
+namespace mapnik {
+
+metatile_renderer::metatile_renderer(Map const& m,
+                                     unsigned cols,
+                                     unsigned rows,
+                                     double scale_factor)
+    : m_(m),
+      cols_(cols),
+      rows_(rows),
+      tile_width_(cols > 0 ? m.width() / cols : 0),
+      tile_height_(rows > 0 ? m.height() / rows : 0),
+      scale_factor_(scale_factor)
+{
+    if (cols == 0 || rows == 0 || m.width() % cols != 0 || m.height() % rows != 0)
+    {
+        throw std::runtime_error("metatile_renderer: map size must be a multiple of the grid size");
+    }
+}
+
+box2d<double> metatile_renderer::tile_extent(unsigned col, unsigned row) const
+{
+    box2d<double> const& ext = m_.get_current_extent();
+    double tile_w = ext.width() / cols_;
+    double tile_h = ext.height() / rows_;
+    double minx = ext.minx() + col * tile_w;
+    double maxy = ext.maxy() - row * tile_h;
+    return box2d<double>(minx, maxy - tile_h, minx + tile_w, maxy);
+}
+
+void metatile_renderer::apply(std::vector<image_rgba8> & tiles, double scale_denom) const
+{
+    if (scale_denom <= 0.0)
+    {
+        projection proj(m_.srs(), true);
+        scale_denom = scale_denominator(m_.scale(), proj.is_geographic());
+    }
+
+    std::vector<box2d<double>> tile_extents;
+    tile_extents.reserve(cols_ * rows_);
+    for (unsigned row = 0; row < rows_; ++row)
+    {
+        for (unsigned col = 0; col < cols_; ++col)
+        {
+            tile_extents.push_back(tile_extent(col, row));
+        }
+    }
+
+    // one working copy of the map, its layers point at per tile buckets
+    Map tile_map(m_);
+    std::vector<detail::layer_buckets> buckets;
+    // rules are selected with the scale factor applied, as in feature_style_processor::apply
+    detail::bucket_layers(m_, tile_map.layers(), tile_extents, scale_denom * scale_factor_, buckets);
+
+    MAPNIK_LOG_DEBUG(metatile_renderer) << "metatile_renderer: Bucketed " << buckets.size()
+                                        << " layers into " << tile_extents.size() << " tiles";
+
+    tiles.clear();
+    tiles.reserve(tile_extents.size());
+    tile_map.resize(tile_width_, tile_height_);
+    // tiles are rendered one after another, so they can share scratch buffers
+    agg_render_context<image_rgba8> context;
+    for (std::size_t i = 0; i < tile_extents.size(); ++i)
+    {
+        for (detail::layer_buckets & lb : buckets)
+        {
+            lb.lay->set_datasource(lb.buckets[i]);
+        }
+        tile_map.zoom_to_box(tile_extents[i]);
+        tiles.emplace_back(tile_width_, tile_height_);
+        agg_renderer<image_rgba8> ren(tile_map, tiles.back(), context, scale_factor_);
+        ren.apply(scale_denom);
+    }
+}
+
+}
@@ -0,0 +1,147 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/multiscale_renderer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/request.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/scale_denominator.hpp>
+#include <mapnik/renderer_common/layer_buckets.hpp>
+#include <mapnik/debug.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace mapnik {
+
+namespace {
+
+// widens the buffers layers set of their own by factor
+void scale_buffer_sizes(std::vector<layer> & layers, double factor)
+{
+    for (layer & lay : layers)
+    {
+        boost::optional<int> const& buffer_size = lay.buffer_size();
+        if (buffer_size)
+        {
+            lay.set_buffer_size(static_cast<int>(std::ceil(*buffer_size * factor)));
+        }
+        scale_buffer_sizes(lay.layers(), factor);
+    }
+}
+
+// hands the datasources of layers to the same layers of a copy of their map
+void copy_datasources(std::vector<layer> const& from, std::vector<layer> & to)
+{
+    for (std::size_t i = 0; i < from.size() && i < to.size(); ++i)
+    {
+        to[i].set_datasource(from[i].datasource());
+        copy_datasources(from[i].layers(), to[i].layers());
+    }
+}
+
+}
+
+multiscale_renderer::multiscale_renderer(Map const& m, std::vector<double> const& scale_factors)
+    : m_(m),
+      scale_factors_(scale_factors)
+{
+    if (scale_factors_.empty())
+    {
+        throw std::runtime_error("multiscale_renderer: at least one scale factor is needed");
+    }
+    for (double scale_factor : scale_factors_)
+    {
+        if (scale_factor <= 0.0 || width(scale_factor) == 0 || height(scale_factor) == 0)
+        {
+            throw std::runtime_error("multiscale_renderer: scale factors must give images of at least one pixel");
+        }
+    }
+}
+
+unsigned multiscale_renderer::width(double scale_factor) const
+{
+    return static_cast<unsigned>(std::lround(m_.width() * scale_factor));
+}
+
+unsigned multiscale_renderer::height(double scale_factor) const
+{
+    return static_cast<unsigned>(std::lround(m_.height() * scale_factor));
+}
+
+void multiscale_renderer::apply(std::vector<image_rgba8> & images, double scale_denom) const
+{
+    box2d<double> const& extent = m_.get_current_extent();
+    // rules are selected with the scale factor applied, as in
+    // feature_style_processor::apply, which gives the same denominator
+    // for every image
+    double base_scale_denom = scale_denom;
+    if (base_scale_denom <= 0.0)
+    {
+        projection proj(m_.srs(), true);
+        base_scale_denom = scale_denominator(m_.scale(), proj.is_geographic());
+    }
+
+    // queried at the finest resolution, with buffers widened to those of
+    // the coarsest image
+    double min_factor = *std::min_element(scale_factors_.begin(), scale_factors_.end());
+    double max_factor = *std::max_element(scale_factors_.begin(), scale_factors_.end());
+    double spread = max_factor / min_factor;
+    Map query_map(m_);
+    query_map.resize(width(max_factor), height(max_factor));
+    query_map.zoom_to_box(extent);
+    query_map.set_buffer_size(static_cast<int>(std::ceil(m_.buffer_size() * spread)));
+    scale_buffer_sizes(query_map.layers(), spread);
+    std::vector<detail::layer_buckets> buckets;
+    std::vector<box2d<double>> extents(1, query_map.get_current_extent());
+    detail::bucket_layers(query_map, query_map.layers(), extents, base_scale_denom, buckets);
+    for (detail::layer_buckets & lb : buckets)
+    {
+        lb.lay->set_datasource(lb.buckets.front());
+    }
+    Map render_map(m_);
+    copy_datasources(query_map.layers(), render_map.layers());
+
+    MAPNIK_LOG_DEBUG(multiscale_renderer) << "multiscale_renderer: Rendering " << scale_factors_.size()
+                                          << " scale factors, " << buckets.size() << " layers queried once";
+
+    images.clear();
+    images.reserve(scale_factors_.size());
+    // images are rendered one after another, so they can share scratch buffers
+    agg_render_context<image_rgba8> context;
+    for (double scale_factor : scale_factors_)
+    {
+        images.emplace_back(width(scale_factor), height(scale_factor));
+        request req(images.back().width(), images.back().height(), extent);
+        req.set_buffer_size(m_.buffer_size());
+        agg_renderer<image_rgba8> ren(render_map, req, attributes(), images.back(), context, scale_factor);
+        ren.apply(scale_denom > 0.0 ? scale_denom / scale_factor : 0.0);
+    }
+}
+
+}
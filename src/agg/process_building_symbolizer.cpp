@@ -88,8 +88,11 @@ void agg_renderer<T0,T1>::process(building_symbolizer const& sym,
 
     double height = get<double, keys::height>(sym, feature, common_.vars_) * common_.scale_factor_;
 
+    // opaque walls are filled in one pass
+    bool batch_faces = int(a * opacity) >= 255;
+
     render_building_symbolizer(
-        feature, height,
+        feature, height, batch_faces,
         [&,r,g,b,a,opacity](path_type const& faces)
         {
             vertex_adapter va(faces);
@@ -23,6 +23,7 @@
 // mapnik
 #include <mapnik/feature.hpp>
 #include <mapnik/agg_renderer.hpp>
+#include <mapnik/agg_pixfmt_rgba.hpp>
 #include <mapnik/image_any.hpp>
 #include <mapnik/symbolizer.hpp>
 #include <mapnik/label_collision_detector.hpp>
@@ -108,7 +109,7 @@ struct RingRenderer {
     using color_type = agg::rgba8;
     using order_type = agg::order_rgba;
     using blender_type = agg::comp_op_adaptor_rgba_pre<color_type, order_type>; // comp blender
-    using pixfmt_comp_type = agg::pixfmt_custom_blend_rgba<blender_type, agg::rendering_buffer>;
+    using pixfmt_comp_type = pixfmt_comp_rgba_pre<blender_type, agg::rendering_buffer>;
     using renderer_base = agg::renderer_base<pixfmt_comp_type>;
     using renderer_type = agg::renderer_scanline_aa_solid<renderer_base>;
 
@@ -236,7 +237,7 @@ void agg_renderer<T0,T1>::process(debug_symbolizer const& sym,
     {
         RingRenderer<buffer_type> renderer(*ras_ptr, buffers_.top().get(), common_.t_, prj_trans);
         render_ring_visitor<buffer_type> apply(renderer);
-        mapnik::util::apply_visitor(apply,feature.get_geometry());
+        mapnik::util::apply_visitor(apply,static_cast<feature_impl const&>(feature).get_geometry());
     }
     else if (mode == DEBUG_SYM_MODE_COLLISION)
     {
@@ -249,7 +250,7 @@ void agg_renderer<T0,T1>::process(debug_symbolizer const& sym,
     {
         using apply_vertex_mode = apply_vertex_mode<buffer_type>;
         apply_vertex_mode apply(buffers_.top().get(), common_.t_, prj_trans);
-        util::apply_visitor(geometry::vertex_processor<apply_vertex_mode>(apply), feature.get_geometry());
+        util::apply_visitor(geometry::vertex_processor<apply_vertex_mode>(apply), static_cast<feature_impl const&>(feature).get_geometry());
     }
 }
 
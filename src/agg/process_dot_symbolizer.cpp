@@ -23,6 +23,7 @@
 // mapnik
 #include <mapnik/feature.hpp>
 #include <mapnik/agg_renderer.hpp>
+#include <mapnik/agg_pixfmt_rgba.hpp>
 #include <mapnik/agg_rasterizer.hpp>
 #include <mapnik/symbolizer.hpp>
 #include <mapnik/symbolizer_keys.hpp>
@@ -32,6 +33,13 @@
 #include <mapnik/renderer_common.hpp>
 #include <mapnik/proj_transform.hpp>
 #include <mapnik/image_compositing.hpp>
+#include <mapnik/make_unique.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <cmath>
+#include <memory>
+#include <vector>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore_agg.hpp>
@@ -42,42 +50,156 @@
 #include "agg_renderer_scanline.h"
 #include "agg_color_rgba.h"
 #include "agg_renderer_base.h"
+#include "agg_rasterizer_scanline_aa.h"
 #pragma GCC diagnostic pop
 
 namespace mapnik { namespace detail {
 
-template <typename Rasterizer, typename Renderer, typename Common, typename ProjTransform>
-struct render_dot_symbolizer : util::noncopyable
+// Antialiased coverage of a dot rasterized once per size and sub pixel
+// position, blended into the image as spans at every point it is drawn.
+struct dot_stamp
 {
-    render_dot_symbolizer(double rx, double ry, Rasterizer & ras, Renderer & ren, Common & common, ProjTransform const& prj_trans)
-        : ras_(ras),
-          ren_(ren),
-          common_(common),
-          prj_trans_(prj_trans),
-          rx_(rx),
-          ry_(ry),
-          el_(0, 0, rx, ry) {}
+    struct span
+    {
+        int x;
+        int y;
+        int len;
+        std::size_t offset;
+    };
+    std::vector<span> spans;
+    std::vector<agg::int8u> covers;
+};
+
+// The stamps of the dot size drawn last on this thread. Positions are
+// rounded to 1/subpixel_steps of a pixel.
+class dot_stamp_cache : util::noncopyable
+{
+public:
+    static constexpr int subpixel_steps = 8;
+    // larger dots are drawn through the rasterizer
+    static constexpr double max_radius = 32.0;
+
+    dot_stamp const& get(double rx, double ry, int sx, int sy)
+    {
+        if (rx != rx_ || ry != ry_)
+        {
+            rx_ = rx;
+            ry_ = ry;
+            for (auto & stamp : stamps_) stamp.reset();
+        }
+        std::unique_ptr<dot_stamp> & stamp = stamps_[sy * subpixel_steps + sx];
+        if (!stamp)
+        {
+            stamp = std::make_unique<dot_stamp>();
+            rasterize(*stamp, static_cast<double>(sx) / subpixel_steps, static_cast<double>(sy) / subpixel_steps);
+        }
+        return *stamp;
+    }
+
+private:
+    void rasterize(dot_stamp & stamp, double cx, double cy)
+    {
+        agg::ellipse el(cx, cy, rx_, ry_);
+        ras_.reset();
+        ras_.add_path(el);
+        if (!ras_.rewind_scanlines()) return;
+        sl_.reset(ras_.min_x(), ras_.max_x());
+        while (ras_.sweep_scanline(sl_))
+        {
+            auto span = sl_.begin();
+            for (unsigned n = sl_.num_spans(); n > 0; --n, ++span)
+            {
+                stamp.spans.push_back({span->x, sl_.y(), span->len, stamp.covers.size()});
+                stamp.covers.insert(stamp.covers.end(), span->covers, span->covers + span->len);
+            }
+        }
+    }
+
+    double rx_ = 0.0;
+    double ry_ = 0.0;
+    std::unique_ptr<dot_stamp> stamps_[subpixel_steps * subpixel_steps];
+    agg::rasterizer_scanline_aa<> ras_;
+    agg::scanline_u8 sl_;
+};
+
+// Collects the points of a geometry and transforms them in one go
+struct dot_points : util::noncopyable
+{
+    explicit dot_points(std::vector<geometry::point<double>> & points)
+        : points_(points) {}
 
     template <typename Adapter>
     void operator() (Adapter const& va)
     {
-        double x,y,z = 0;
+        double x, y;
         unsigned cmd = SEG_END;
         va.rewind(0);
         while ((cmd = va.vertex(&x, &y)) != mapnik::SEG_END)
         {
             if (cmd == SEG_CLOSE) continue;
-            prj_trans_.backward(x, y, z);
-            common_.t_.forward(&x, &y);
-            el_.init(x, y, rx_, ry_, el_.num_steps());
+            points_.emplace_back(x, y);
+        }
+    }
+
+    std::vector<geometry::point<double>> & points_;
+};
+
+// Draws dots at points already transformed to the image
+template <typename Rasterizer, typename RendererBase, typename Renderer>
+struct render_dot_symbolizer : util::noncopyable
+{
+    render_dot_symbolizer(double rx, double ry, Rasterizer & ras, RendererBase & renb, Renderer & ren)
+        : ras_(ras),
+          renb_(renb),
+          ren_(ren),
+          rx_(rx),
+          ry_(ry),
+          el_(0, 0, rx, ry) {}
+
+    void operator() (std::vector<geometry::point<double>> const& points)
+    {
+        bool stamped = rx_ > 0.0 && ry_ > 0.0 &&
+            rx_ <= dot_stamp_cache::max_radius && ry_ <= dot_stamp_cache::max_radius;
+        if (stamped)
+        {
+            static thread_local dot_stamp_cache cache;
+            auto const& color = ren_.color();
+            // points off the image are skipped before they overflow int
+            double minx = renb_.xmin() - rx_ - 1.0;
+            double miny = renb_.ymin() - ry_ - 1.0;
+            double maxx = renb_.xmax() + rx_ + 1.0;
+            double maxy = renb_.ymax() + ry_ + 1.0;
+            for (auto const& pt : points)
+            {
+                if (!(pt.x >= minx && pt.x <= maxx && pt.y >= miny && pt.y <= maxy)) continue;
+                double fx = std::floor(pt.x);
+                double fy = std::floor(pt.y);
+                int sx = static_cast<int>(std::lround((pt.x - fx) * dot_stamp_cache::subpixel_steps));
+                int sy = static_cast<int>(std::lround((pt.y - fy) * dot_stamp_cache::subpixel_steps));
+                int ix = static_cast<int>(fx) + sx / dot_stamp_cache::subpixel_steps;
+                int iy = static_cast<int>(fy) + sy / dot_stamp_cache::subpixel_steps;
+                dot_stamp const& stamp = cache.get(rx_, ry_,
+                                                   sx % dot_stamp_cache::subpixel_steps,
+                                                   sy % dot_stamp_cache::subpixel_steps);
+                for (auto const& span : stamp.spans)
+                {
+                    renb_.blend_solid_hspan(ix + span.x, iy + span.y, span.len, color,
+                                            &stamp.covers[span.offset]);
+                }
+            }
+            return;
+        }
+        for (auto const& pt : points)
+        {
+            el_.init(pt.x, pt.y, rx_, ry_, el_.num_steps());
             ras_.add_path(el_);
             agg::render_scanlines(ras_, sl_, ren_);
         }
     }
+
     Rasterizer & ras_;
+    RendererBase & renb_;
     Renderer & ren_;
-    Common & common_;
-    ProjTransform const& prj_trans_;
     double rx_;
     double ry_;
     agg::ellipse el_;
@@ -122,7 +244,7 @@ void agg_renderer<T0,T1>::process(dot_symbolizer const& sym,
     buffer_type & current_buffer = buffers_.top().get();
     agg::rendering_buffer buf(current_buffer.bytes(), current_buffer.width(), current_buffer.height(), current_buffer.row_size());
     using blender_type = agg::comp_op_adaptor_rgba_pre<agg::rgba8, agg::order_rgba>;
-    using pixfmt_comp_type = agg::pixfmt_custom_blend_rgba<blender_type, agg::rendering_buffer>;
+    using pixfmt_comp_type = pixfmt_comp_rgba_pre<blender_type, agg::rendering_buffer>;
     using renderer_base = agg::renderer_base<pixfmt_comp_type>;
     using renderer_type = agg::renderer_scanline_aa_solid<renderer_base>;
     pixfmt_comp_type pixf(buf);
@@ -131,9 +253,18 @@ void agg_renderer<T0,T1>::process(dot_symbolizer const& sym,
     renderer_type ren(renb);
 
     ren.color(agg::rgba8_pre(fill.red(), fill.green(), fill.blue(), int(fill.alpha() * opacity)));
-    using render_dot_symbolizer_type = detail::render_dot_symbolizer<rasterizer, renderer_type, renderer_common, proj_transform>;
-    render_dot_symbolizer_type apply(rx, ry, *ras_ptr, ren, common_, prj_trans);
-    mapnik::util::apply_visitor(geometry::vertex_processor<render_dot_symbolizer_type>(apply), feature.get_geometry());
+    // points are projected and transformed to the image all at once
+    static thread_local std::vector<geometry::point<double>> points;
+    points.clear();
+    detail::dot_points collect(points);
+    mapnik::util::apply_visitor(geometry::vertex_processor<detail::dot_points>(collect), static_cast<feature_impl const&>(feature).get_geometry());
+    if (points.empty()) return;
+    prj_trans.backward(points);
+    common_.t_.forward(&points.front().x, &points.front().y, points.size(), 2);
+
+    using render_dot_symbolizer_type = detail::render_dot_symbolizer<rasterizer, renderer_base, renderer_type>;
+    render_dot_symbolizer_type apply(rx, ry, *ras_ptr, renb, ren);
+    apply(points);
 }
 
 template void agg_renderer<image_rgba8>::process(dot_symbolizer const&,
@@ -87,6 +87,7 @@ struct thunk_renderer<image_rgba8> : render_thunk_list_dispatch
         svg::vertex_stl_adapter<svg::svg_path_storage> stl_storage(thunk.src_->source());
         svg_path_adapter svg_path(stl_storage);
         svg_renderer_type svg_renderer(svg_path, thunk.attrs_);
+        svg_renderer.set_flattened_paths(thunk.src_->get_flattened_paths());
 
         agg::trans_affine offset_tr = thunk.tr_;
         offset_tr.translate(offset_.x, offset_.y);
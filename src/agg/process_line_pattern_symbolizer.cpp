@@ -65,13 +65,15 @@ struct agg_renderer_process_visitor_l
                                  std::unique_ptr<rasterizer> const& ras_ptr,
                                  line_pattern_symbolizer const& sym,
                                  mapnik::feature_impl & feature,
-                                 proj_transform const& prj_trans)
+                                 proj_transform const& prj_trans,
+                                 std::shared_ptr<mapnik::marker const> const& owner)
         : common_(common),
           current_buffer_(current_buffer),
           ras_ptr_(ras_ptr),
           sym_(sym),
           feature_(feature),
-          prj_trans_(prj_trans) {}
+          prj_trans_(prj_trans),
+          owner_(owner) {}
 
     void operator() (marker_null const&) const {}
 
@@ -80,10 +82,14 @@ struct agg_renderer_process_visitor_l
         agg::trans_affine image_tr = agg::trans_affine_scaling(common_.scale_factor_);
         auto image_transform = get_optional<transform_type>(sym_, keys::image_transform);
         if (image_transform) evaluate_transform(image_tr, feature_, common_.vars_, *image_transform, common_.scale_factor_);
-        mapnik::box2d<double> const& bbox_image = marker.get_data()->bounding_box() * image_tr;
-        image_rgba8 image(bbox_image.width(), bbox_image.height());
-        render_pattern<buffer_type>(*ras_ptr_, marker, image_tr, 1.0, image);
-        render(image, marker.width(), marker.height());
+        auto image = pattern_image_cache::instance().get(owner_, image_tr, 1.0, [&]
+        {
+            mapnik::box2d<double> const& bbox_image = marker.get_data()->bounding_box() * image_tr;
+            image_rgba8 image(bbox_image.width(), bbox_image.height());
+            render_pattern<buffer_type>(*ras_ptr_, marker, image_tr, 1.0, image);
+            return image;
+        });
+        render(*image, marker.width(), marker.height());
     }
 
     void operator() (marker_rgba8 const& marker) const
@@ -157,7 +163,10 @@ private:
         using apply_vertex_converter_type = detail::apply_vertex_converter<vertex_converter_type, rasterizer_type>;
         using vertex_processor_type = geometry::vertex_processor<apply_vertex_converter_type>;
         apply_vertex_converter_type apply(converter, ras);
-        mapnik::util::apply_visitor(vertex_processor_type(apply), feature_.get_geometry());
+        if (!converter.clipped_away(feature_))
+        {
+            mapnik::util::apply_visitor(vertex_processor_type(apply), static_cast<feature_impl const&>(feature_).get_geometry());
+        }
     }
 
     renderer_common & common_;
@@ -166,6 +175,7 @@ private:
     line_pattern_symbolizer const& sym_;
     mapnik::feature_impl & feature_;
     proj_transform const& prj_trans_;
+    std::shared_ptr<mapnik::marker const> const& owner_;
 };
 
 template <typename T0, typename T1>
@@ -190,7 +200,8 @@ void  agg_renderer<T0,T1>::process(line_pattern_symbolizer const& sym,
                                          ras_ptr,
                                          sym,
                                          feature,
-                                         prj_trans);
+                                         prj_trans,
+                                         marker);
     util::apply_visitor(visitor, *marker);
 }
 
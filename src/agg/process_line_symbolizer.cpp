@@ -25,12 +25,16 @@
 #include <mapnik/image_any.hpp>
 #include <mapnik/agg_helpers.hpp>
 #include <mapnik/agg_renderer.hpp>
+#include <mapnik/agg_pixfmt_rgba.hpp>
 #include <mapnik/agg_rasterizer.hpp>
 #include <mapnik/symbolizer.hpp>
 #include <mapnik/vertex_converters.hpp>
 #include <mapnik/vertex_processor.hpp>
 #include <mapnik/renderer_common/clipping_extent.hpp>
 #include <mapnik/renderer_common/apply_vertex_converter.hpp>
+#include <mapnik/renderer_common/compiled_symbolizer.hpp>
+#include <mapnik/renderer_common/dash_pattern.hpp>
+#include <mapnik/renderer_common/line_path_cache.hpp>
 #include <mapnik/geometry/geometry_type.hpp>
 
 #pragma GCC diagnostic push
@@ -95,14 +99,15 @@ void agg_renderer<T0,T1>::process(line_symbolizer const& sym,
                               proj_transform const& prj_trans)
 
 {
-    color const& col = get<color, keys::stroke>(sym, feature, common_.vars_);
+    compiled_line_symbolizer const& props = compiled_symbolizers().get(sym);
+    color const& col = props.stroke.get(feature, common_.vars_);
     unsigned r=col.red();
     unsigned g=col.green();
     unsigned b=col.blue();
     unsigned a=col.alpha();
 
-    double gamma = get<value_double, keys::stroke_gamma>(sym, feature, common_.vars_);
-    gamma_method_enum gamma_method = get<gamma_method_enum, keys::stroke_gamma_method>(sym, feature, common_.vars_);
+    double gamma = props.stroke_gamma.get(feature, common_.vars_);
+    gamma_method_enum gamma_method = props.stroke_gamma_method.get(feature, common_.vars_);
     ras_ptr->reset();
 
     if (gamma != gamma_ || gamma_method != gamma_method_)
@@ -118,26 +123,36 @@ void agg_renderer<T0,T1>::process(line_symbolizer const& sym,
     using color_type = agg::rgba8;
     using order_type = agg::order_rgba;
     using blender_type = agg::comp_op_adaptor_rgba_pre<color_type, order_type>; // comp blender
-    using pixfmt_comp_type = agg::pixfmt_custom_blend_rgba<blender_type, agg::rendering_buffer>;
+    using pixfmt_comp_type = pixfmt_comp_rgba_pre<blender_type, agg::rendering_buffer>;
     using renderer_base = agg::renderer_base<pixfmt_comp_type>;
 
     pixfmt_comp_type pixf(buf);
-    pixf.comp_op(static_cast<agg::comp_op_e>(get<composite_mode_e, keys::comp_op>(sym, feature, common_.vars_)));
+    pixf.comp_op(static_cast<agg::comp_op_e>(props.comp_op.get(feature, common_.vars_)));
     renderer_base renb(pixf);
 
     agg::trans_affine tr;
-    auto transform = get_optional<transform_type>(sym, keys::geometry_transform);
-    if (transform) evaluate_transform(tr, feature, common_.vars_, *transform, common_.scale_factor_);
+    if (props.geometry_transform) evaluate_transform(tr, feature, common_.vars_, *props.geometry_transform, common_.scale_factor_);
 
     box2d<double> clip_box = clipping_extent(common_);
 
-    value_bool clip = get<value_bool, keys::clip>(sym, feature, common_.vars_);
-    value_double width = get<value_double, keys::stroke_width>(sym, feature, common_.vars_);
-    value_double opacity = get<value_double,keys::stroke_opacity>(sym,feature, common_.vars_);
-    value_double offset = get<value_double, keys::offset>(sym, feature, common_.vars_);
-    value_double simplify_tolerance = get<value_double, keys::simplify_tolerance>(sym, feature, common_.vars_);
-    value_double smooth = get<value_double, keys::smooth>(sym, feature, common_.vars_);
-    line_rasterizer_enum rasterizer_e = get<line_rasterizer_enum, keys::line_rasterizer>(sym, feature, common_.vars_);
+    value_bool clip = props.clip.get(feature, common_.vars_);
+    value_double width = props.stroke_width.get(feature, common_.vars_);
+    value_double opacity = props.stroke_opacity.get(feature, common_.vars_);
+    value_double offset = props.offset.get(feature, common_.vars_);
+    value_double simplify_tolerance = props.simplify_tolerance.get(feature, common_.vars_);
+    value_double smooth = props.smooth.get(feature, common_.vars_);
+    line_rasterizer_enum rasterizer_e = props.line_rasterizer.get(feature, common_.vars_);
+    bool dashed = props.has_dasharray;
+    if (dashed)
+    {
+        auto dash = get_optional<dash_array>(sym, keys::stroke_dasharray, feature, common_.vars_);
+        if (dash)
+        {
+            dash_pattern pattern(*dash);
+            dashed = !pattern.collapses(common_.scale_factor_ * tr.scale(), dash_collapse_threshold_);
+            if (!dashed) opacity *= pattern.opacity();
+        }
+    }
     if (clip)
     {
         double padding = static_cast<double>(common_.query_extent_.width() / common_.width_);
@@ -159,16 +174,20 @@ void agg_renderer<T0,T1>::process(line_symbolizer const& sym,
         //draw_geo_extent(inverse,mapnik::color("red"));
     }
 
-    if (rasterizer_e == RASTERIZER_FAST)
+    // the geometry is converted once per feature and key, the casing and
+    // fill of a road only stroke it again
+    line_path_key key{{{tr.sx, tr.shy, tr.shx, tr.sy, tr.tx, tr.ty}},
+                      offset, simplify_tolerance, smooth,
+                      props.simplify_algorithm.get(feature, common_.vars_),
+                      props.simplify_prefilter.get(feature, common_.vars_),
+                      clip};
+    // a wider clip box gives the same pixels, unless simplified along
+    line_path const* path = line_paths().find(feature, key, clip_box, simplify_tolerance > 0.0);
+    line_path local_path;
+    if (!path)
     {
-        using renderer_type = agg::renderer_outline_aa<renderer_base>;
-        using rasterizer_type = agg::rasterizer_outline_aa<renderer_type>;
-        agg::line_profile_aa profile(width * common_.scale_factor_, agg::gamma_power(gamma));
-        renderer_type ren(renb, profile);
-        ren.color(agg::rgba8_pre(r, g, b, int(a * opacity)));
-        rasterizer_type ras(ren);
-        set_join_caps_aa(sym, ras, feature, common_.vars_);
-
+        line_path * recorded = line_paths().insert(feature, key, clip_box);
+        if (!recorded) recorded = &local_path;
         using vertex_converter_type = vertex_converter<clip_line_tag, clip_poly_tag, transform_tag,
                                                        affine_transform_tag,
                                                        simplify_tag, smooth_tag,
@@ -176,7 +195,7 @@ void agg_renderer<T0,T1>::process(line_symbolizer const& sym,
         vertex_converter_type converter(clip_box,sym,common_.t_,prj_trans,tr,feature,common_.vars_,common_.scale_factor_);
         if (clip)
         {
-            geometry::geometry_types type = geometry::geometry_type(feature.get_geometry());
+            geometry::geometry_types type = feature.geometry_type();
             if (type == geometry::geometry_types::Polygon || type == geometry::geometry_types::MultiPolygon)
                 converter.template set<clip_poly_tag>();
             else if (type == geometry::geometry_types::LineString || type == geometry::geometry_types::MultiLineString)
@@ -188,40 +207,35 @@ void agg_renderer<T0,T1>::process(line_symbolizer const& sym,
         if (simplify_tolerance > 0.0) converter.set<simplify_tag>(); // optional simplify converter
         if (smooth > 0.0) converter.set<smooth_tag>(); // optional smooth converter
 
-        using apply_vertex_converter_type = detail::apply_vertex_converter<vertex_converter_type, rasterizer_type>;
+        using apply_vertex_converter_type = detail::apply_vertex_converter<vertex_converter_type, line_path>;
         using vertex_processor_type = geometry::vertex_processor<apply_vertex_converter_type>;
-        apply_vertex_converter_type apply(converter, ras);
-        mapnik::util::apply_visitor(vertex_processor_type(apply),feature.get_geometry());
+        apply_vertex_converter_type apply(converter, *recorded);
+        if (!converter.clipped_away(feature))
+        {
+            mapnik::util::apply_visitor(vertex_processor_type(apply),static_cast<feature_impl const&>(feature).get_geometry());
+        }
+        path = recorded;
+    }
+
+    if (rasterizer_e == RASTERIZER_FAST)
+    {
+        using renderer_type = agg::renderer_outline_aa<renderer_base>;
+        using rasterizer_type = agg::rasterizer_outline_aa<renderer_type>;
+        agg::line_profile_aa profile(width * common_.scale_factor_, agg::gamma_power(gamma));
+        renderer_type ren(renb, profile);
+        ren.color(agg::rgba8_pre(r, g, b, int(a * opacity)));
+        rasterizer_type ras(ren);
+        set_join_caps_aa(sym, ras, feature, common_.vars_);
+        path->for_each_part([&ras](line_path::part & part) { ras.add_path(part); });
     }
     else
     {
-        using vertex_converter_type = vertex_converter<clip_line_tag, clip_poly_tag, transform_tag,
-                                                       affine_transform_tag,
-                                                       simplify_tag, smooth_tag,
-                                                       offset_transform_tag,
-                                                       dash_tag, stroke_tag>;
+        using vertex_converter_type = vertex_converter<dash_tag, stroke_tag>;
         vertex_converter_type converter(clip_box, sym,common_.t_,prj_trans,tr,feature,common_.vars_,common_.scale_factor_);
-        if (clip)
-        {
-            geometry::geometry_types type = geometry::geometry_type(feature.get_geometry());
-            if (type == geometry::geometry_types::Polygon || type == geometry::geometry_types::MultiPolygon)
-                converter.template set<clip_poly_tag>();
-            else if (type == geometry::geometry_types::LineString || type == geometry::geometry_types::MultiLineString)
-                converter.template set<clip_line_tag>();
-        }
-        converter.set<transform_tag>(); // always transform
-        if (std::fabs(offset) > 0.0) converter.set<offset_transform_tag>(); // parallel offset
-        converter.set<affine_transform_tag>(); // optional affine transform
-        if (simplify_tolerance > 0.0) converter.set<simplify_tag>(); // optional simplify converter
-        if (smooth > 0.0) converter.set<smooth_tag>(); // optional smooth converter
-        if (has_key(sym, keys::stroke_dasharray))
+        if (dashed)
             converter.set<dash_tag>();
         converter.set<stroke_tag>(); //always stroke
-
-        using apply_vertex_converter_type = detail::apply_vertex_converter<vertex_converter_type, rasterizer>;
-        using vertex_processor_type = geometry::vertex_processor<apply_vertex_converter_type>;
-        apply_vertex_converter_type apply(converter, *ras_ptr);
-        mapnik::util::apply_visitor(vertex_processor_type(apply),feature.get_geometry());
+        path->for_each_part([&](line_path::part & part) { converter.apply(part, *ras_ptr); });
 
         using renderer_type = agg::renderer_scanline_aa_solid<renderer_base>;
         renderer_type ren(renb);
@@ -23,8 +23,11 @@
 // mapnik
 #include <mapnik/agg_helpers.hpp>
 #include <mapnik/agg_renderer.hpp>
+#include <mapnik/agg_pixfmt_rgba.hpp>
 #include <mapnik/agg_rasterizer.hpp>
 #include <mapnik/agg_render_marker.hpp>
+#include <mapnik/marker_sprite_cache.hpp>
+#include <mapnik/make_unique.hpp>
 #include <mapnik/svg/svg_renderer_agg.hpp>
 #include <mapnik/svg/svg_storage.hpp>
 #include <mapnik/svg/svg_path_adapter.hpp>
@@ -47,6 +50,9 @@
 #include "agg_conv_transform.h"
 #pragma GCC diagnostic pop
 
+// stl
+#include <cmath>
+
 namespace mapnik {
 
 namespace detail {
@@ -66,10 +72,27 @@ struct agg_markers_renderer_context : markers_renderer_context
       : buf_(buf),
         pixf_(buf_),
         renb_(pixf_),
-        ras_(ras)
+        ras_(ras),
+        comp_op_(get<composite_mode_e, keys::comp_op>(sym, feature, vars)),
+        sprites_(nullptr),
+        sprite_ras_(nullptr),
+        sprite_tolerance_(0.0),
+        gamma_(1.0),
+        gamma_method_(GAMMA_POWER)
     {
-        auto comp_op = get<composite_mode_e, keys::comp_op>(sym, feature, vars);
-        pixf_.comp_op(static_cast<agg::comp_op_e>(comp_op));
+        pixf_.comp_op(static_cast<agg::comp_op_e>(comp_op_));
+    }
+
+    // draw SVG markers from the sprites in cache when the transform is
+    // within tolerance, rasterizing new ones with sprite_ras
+    void use_sprites(marker_sprite_cache & cache, RasterizerType & sprite_ras,
+                     double tolerance, double gamma, gamma_method_enum gamma_method)
+    {
+        sprites_ = &cache;
+        sprite_ras_ = &sprite_ras;
+        sprite_tolerance_ = tolerance;
+        gamma_ = gamma;
+        gamma_method_ = gamma_method;
     }
 
     virtual void render_marker(svg_path_ptr const& src,
@@ -78,7 +101,12 @@ struct agg_markers_renderer_context : markers_renderer_context
                                markers_dispatch_params const& params,
                                agg::trans_affine const& marker_tr)
     {
+        if (sprites_ && render_sprite(src, path, attrs, params, marker_tr))
+        {
+            return;
+        }
         SvgRenderer svg_renderer(path, attrs);
+        svg_renderer.set_flattened_paths(src->get_flattened_paths());
         render_vector_marker(svg_renderer, ras_, renb_, src->bounding_box(),
                              marker_tr, params.opacity, params.snap_to_pixels);
     }
@@ -95,10 +123,98 @@ struct agg_markers_renderer_context : markers_renderer_context
     }
 
 private:
+    bool render_sprite(svg_path_ptr const& src,
+                       svg_path_adapter & path,
+                       svg_attribute_type const& attrs,
+                       markers_dispatch_params const& params,
+                       agg::trans_affine const& marker_tr)
+    {
+        // blending a whole sprite matches drawing its paths one by one
+        // only for src-over, which is associative
+        if (comp_op_ != src_over)
+        {
+            return false;
+        }
+        agg::trans_affine tr = marker_tr;
+        if (params.snap_to_pixels)
+        {
+            tr.tx = std::floor(tr.tx + .5);
+            tr.ty = std::floor(tr.ty + .5);
+        }
+        box2d<double> const& bbox = src->bounding_box();
+        marker_sprite_cache::key_type key;
+        marker_sprite_cache::placement place;
+        if (!marker_sprite_cache::quantize(tr, bbox, sprite_tolerance_, key, place))
+        {
+            return false;
+        }
+        key.shape = src.get();
+        if (&attrs != &src->attributes())
+        {
+            key.style = marker_sprite_cache::style(attrs);
+        }
+        key.opacity = static_cast<unsigned>(std::lround(255 * params.opacity));
+        key.gamma = gamma_;
+        key.gamma_method = gamma_method_;
+
+        marker_sprite_cache::sprite const* sprite = sprites_->find(key);
+        if (!sprite)
+        {
+            box2d<double> extent(bbox);
+            extent *= place.transform;
+            double margin = marker_sprite_cache::stroke_margin(attrs) * place.transform.scale() + 1.0;
+            extent.pad(margin);
+            int x0 = static_cast<int>(std::floor(extent.minx()));
+            int y0 = static_cast<int>(std::floor(extent.miny()));
+            int width = static_cast<int>(std::ceil(extent.maxx())) - x0;
+            int height = static_cast<int>(std::ceil(extent.maxy())) - y0;
+            // big sprites are seldom repeated often enough to pay off
+            if (width <= 0 || height <= 0 || width > 512 || height > 512)
+            {
+                return false;
+            }
+            marker_sprite_cache::sprite s;
+            s.image = image_rgba8(width, height);
+            s.x = x0;
+            s.y = y0;
+            agg::rendering_buffer sprite_buf(s.image.bytes(), s.image.width(),
+                                             s.image.height(), s.image.row_size());
+            pixfmt_type sprite_pixf(sprite_buf);
+            sprite_pixf.comp_op(agg::comp_op_src_over);
+            renderer_base sprite_renb(sprite_pixf);
+            agg::trans_affine sprite_tr = place.transform;
+            sprite_tr.tx -= x0;
+            sprite_tr.ty -= y0;
+            set_gamma_method(sprite_ras_, gamma_, gamma_method_);
+            sprite_ras_->reset();
+            sprite_ras_->clip_box(0, 0, width, height);
+            SvgRenderer svg_renderer(path, attrs);
+            svg_renderer.set_flattened_paths(src->get_flattened_paths());
+            agg::scanline_u8 sl;
+            svg_renderer.render(*sprite_ras_, sl, sprite_renb, sprite_tr, params.opacity, bbox);
+            sprite = &sprites_->insert(key, src, std::move(s));
+        }
+
+        using const_rendering_buffer = util::rendering_buffer<image_rgba8>;
+        using pixfmt_pre = agg::pixfmt_alpha_blend_rgba<agg::blender_rgba32_pre,
+                                                        const_rendering_buffer,
+                                                        agg::pixel32_type>;
+        const_rendering_buffer sprite_buffer(sprite->image);
+        pixfmt_pre sprite_pixf(sprite_buffer);
+        renb_.blend_from(sprite_pixf, 0, place.x + sprite->x, place.y + sprite->y, 255);
+        return true;
+    }
+
     BufferType & buf_;
     pixfmt_type pixf_;
     renderer_base renb_;
     RasterizerType & ras_;
+    composite_mode_e comp_op_;
+    marker_sprite_cache * sprites_;
+    RasterizerType * sprite_ras_;
+    double sprite_tolerance_;
+    double gamma_;
+    gamma_method_enum gamma_method_;
 };
 
 } // namespace detail
@@ -113,7 +229,7 @@ void agg_renderer<T0,T1>::process(markers_symbolizer const& sym,
     using order_type = agg::order_rgba;
     using blender_type = agg::comp_op_adaptor_rgba_pre<color_type, order_type>; // comp blender
     using buf_type = agg::rendering_buffer;
-    using pixfmt_comp_type = agg::pixfmt_custom_blend_rgba<blender_type, buf_type>;
+    using pixfmt_comp_type = pixfmt_comp_rgba_pre<blender_type, buf_type>;
     using renderer_base = agg::renderer_base<pixfmt_comp_type>;
     using renderer_type = agg::renderer_scanline_aa_solid<renderer_base>;
     using svg_renderer_type = svg_renderer_agg<svg_path_adapter,
@@ -140,6 +256,16 @@ void agg_renderer<T0,T1>::process(markers_symbolizer const& sym,
                                                               buf_type,
                                                               rasterizer>;
     renderer_context_type renderer_context(sym, feature, common_.vars_, render_buffer, *ras_ptr);
+    if (marker_sprite_tolerance_ > 0.0)
+    {
+        if (!marker_sprites_)
+        {
+            marker_sprites_ = std::make_unique<marker_sprite_cache>();
+            sprite_ras_ = std::make_unique<rasterizer>();
+        }
+        renderer_context.use_sprites(*marker_sprites_, *sprite_ras_,
+                                     marker_sprite_tolerance_, gamma, gamma_method);
+    }
 
     render_markers_symbolizer(
         sym, feature, prj_trans, common_, clip_box, renderer_context);
@@ -68,7 +68,8 @@ struct agg_renderer_process_visitor_p
                                    double & gamma,
                                    polygon_pattern_symbolizer const& sym,
                                    mapnik::feature_impl & feature,
-                                   proj_transform const& prj_trans)
+                                   proj_transform const& prj_trans,
+                                   std::shared_ptr<mapnik::marker const> const& owner)
     : common_(common),
         current_buffer_(current_buffer),
         ras_ptr_(ras_ptr),
@@ -76,7 +77,8 @@ struct agg_renderer_process_visitor_p
         gamma_(gamma),
         sym_(sym),
         feature_(feature),
-        prj_trans_(prj_trans) {}
+        prj_trans_(prj_trans),
+        owner_(owner) {}
 
     void operator() (marker_null const&) const {}
 
@@ -85,10 +87,14 @@ struct agg_renderer_process_visitor_p
         agg::trans_affine image_tr = agg::trans_affine_scaling(common_.scale_factor_);
         auto image_transform = get_optional<transform_type>(sym_, keys::image_transform);
         if (image_transform) evaluate_transform(image_tr, feature_, common_.vars_, *image_transform, common_.scale_factor_);
-        mapnik::box2d<double> const& bbox_image = marker.get_data()->bounding_box() * image_tr;
-        mapnik::image_rgba8 image(bbox_image.width(), bbox_image.height());
-        render_pattern<buffer_type>(*ras_ptr_, marker, image_tr, 1.0, image);
-        render(image);
+        auto image = pattern_image_cache::instance().get(owner_, image_tr, 1.0, [&]
+        {
+            mapnik::box2d<double> const& bbox_image = marker.get_data()->bounding_box() * image_tr;
+            mapnik::image_rgba8 image(bbox_image.width(), bbox_image.height());
+            render_pattern<buffer_type>(*ras_ptr_, marker, image_tr, 1.0, image);
+            return image;
+        });
+        render(*image);
     }
 
     void operator() (marker_rgba8 const& marker) const
@@ -156,7 +162,7 @@ private:
             double y0 = 0;
             using apply_local_alignment = detail::apply_local_alignment;
             apply_local_alignment apply(common_.t_,prj_trans_, clip_box, x0, y0);
-            util::apply_visitor(geometry::vertex_processor<apply_local_alignment>(apply), feature_.get_geometry());
+            util::apply_visitor(geometry::vertex_processor<apply_local_alignment>(apply), static_cast<feature_impl const&>(feature_).get_geometry());
 
             offset_x = unsigned(current_buffer_.width() - x0);
             offset_y = unsigned(current_buffer_.height() - y0);
@@ -178,7 +184,7 @@ private:
 
         vertex_converter_type converter(clip_box, sym_,common_.t_,prj_trans_,tr,feature_,common_.vars_,common_.scale_factor_);
 
-        if (prj_trans_.equal() && clip) converter.set<clip_poly_tag>();
+        if ((prj_trans_.equal() || prj_trans_.is_known()) && clip) converter.set<clip_poly_tag>();
         converter.set<transform_tag>(); //always transform
         converter.set<affine_transform_tag>(); // optional affine transform
         if (simplify_tolerance > 0.0) converter.set<simplify_tag>(); // optional simplify converter
@@ -187,7 +193,10 @@ private:
         using apply_vertex_converter_type = detail::apply_vertex_converter<vertex_converter_type, rasterizer>;
         using vertex_processor_type = geometry::vertex_processor<apply_vertex_converter_type>;
         apply_vertex_converter_type apply(converter, *ras_ptr_);
-        mapnik::util::apply_visitor(vertex_processor_type(apply),feature_.get_geometry());
+        if (!converter.clipped_away(feature_))
+        {
+            mapnik::util::apply_visitor(vertex_processor_type(apply),static_cast<feature_impl const&>(feature_).get_geometry());
+        }
         agg::scanline_u8 sl;
         ras_ptr_->filling_rule(agg::fill_even_odd);
         agg::render_scanlines(*ras_ptr_, sl, rp);
@@ -201,6 +210,7 @@ private:
     polygon_pattern_symbolizer const& sym_;
     mapnik::feature_impl & feature_;
     proj_transform const& prj_trans_;
+    std::shared_ptr<mapnik::marker const> const& owner_;
 };
 
 template <typename T0, typename T1>
@@ -218,7 +228,8 @@ void agg_renderer<T0,T1>::process(polygon_pattern_symbolizer const& sym,
                                                         gamma_,
                                                         sym,
                                                         feature,
-                                                        prj_trans);
+                                                        prj_trans,
+                                                        marker);
     util::apply_visitor(visitor, *marker);
 
 }
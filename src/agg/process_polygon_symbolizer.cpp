@@ -26,6 +26,7 @@
 // mapnik
 #include <mapnik/feature.hpp>
 #include <mapnik/agg_renderer.hpp>
+#include <mapnik/agg_pixfmt_rgba.hpp>
 #include <mapnik/agg_helpers.hpp>
 #include <mapnik/agg_rasterizer.hpp>
 #include <mapnik/symbolizer.hpp>
@@ -53,9 +54,10 @@ void agg_renderer<T0,T1>::process(polygon_symbolizer const& sym,
 {
     using vertex_converter_type = vertex_converter<clip_poly_tag,transform_tag,affine_transform_tag,simplify_tag,smooth_tag>;
 
+    compiled_polygon_symbolizer const& props = compiled_symbolizers().get(sym);
     ras_ptr->reset();
-    double gamma = get<value_double>(sym, keys::gamma, feature, common_.vars_, 1.0);
-    gamma_method_enum gamma_method = get<gamma_method_enum>(sym, keys::gamma_method, feature, common_.vars_, GAMMA_POWER);
+    double gamma = props.gamma.get(feature, common_.vars_);
+    gamma_method_enum gamma_method = props.gamma_method.get(feature, common_.vars_);
     if (gamma != gamma_ || gamma_method != gamma_method_)
     {
         set_gamma_method(ras_ptr, gamma, gamma_method);
@@ -68,7 +70,7 @@ void agg_renderer<T0,T1>::process(polygon_symbolizer const& sym,
 
     box2d<double> clip_box = clipping_extent(common_);
     render_polygon_symbolizer<vertex_converter_type>(
-        sym, feature, prj_trans, common_, clip_box, *ras_ptr,
+        sym, props, feature, prj_trans, common_, clip_box, *ras_ptr,
         [&](color const &fill, double opacity) {
             unsigned r=fill.red();
             unsigned g=fill.green();
@@ -77,11 +79,11 @@ void agg_renderer<T0,T1>::process(polygon_symbolizer const& sym,
             using color_type = agg::rgba8;
             using order_type = agg::order_rgba;
             using blender_type = agg::comp_op_adaptor_rgba_pre<color_type, order_type>; // comp blender
-            using pixfmt_comp_type = agg::pixfmt_custom_blend_rgba<blender_type, agg::rendering_buffer>;
+            using pixfmt_comp_type = pixfmt_comp_rgba_pre<blender_type, agg::rendering_buffer>;
             using renderer_base = agg::renderer_base<pixfmt_comp_type>;
             using renderer_type = agg::renderer_scanline_aa_solid<renderer_base>;
             pixfmt_comp_type pixf(buf);
-            pixf.comp_op(static_cast<agg::comp_op_e>(get<composite_mode_e>(sym, keys::comp_op, feature, common_.vars_, src_over)));
+            pixf.comp_op(static_cast<agg::comp_op_e>(props.comp_op.get(feature, common_.vars_)));
             renderer_base renb(pixf);
             renderer_type ren(renb);
             ren.color(agg::rgba8_pre(r, g, b, int(a * opacity)));
@@ -57,7 +57,8 @@ void agg_renderer<T0,T1>::process(raster_symbolizer const& sym,
             int start_x, int start_y) {
             composite(buffers_.top().get(), target,
                       comp_op, opacity, start_x, start_y);
-        }
+        },
+        raster_threads_
     );
 }
 
@@ -0,0 +1,290 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/strip_renderer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/label_collision_detector.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/request.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/scale_denominator.hpp>
+#include <mapnik/renderer_common/layer_buckets.hpp>
+#include <mapnik/executor.hpp>
+#include <mapnik/debug.hpp>
+
+// stl
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace mapnik {
+
+namespace {
+
+using renderer_type = agg_renderer<image_rgba8>;
+
+// whether a style of lay has a symbolizer drawn in the label pass, or
+// in the strips
+bool draws_in_pass(Map const& m, layer const& lay, bool labels)
+{
+    for (std::string const& style_name : lay.styles())
+    {
+        boost::optional<feature_type_style const&> style = m.find_style(style_name);
+        if (!style) continue;
+        for (rule const& r : style->get_rules())
+        {
+            for (symbolizer const& sym : r)
+            {
+                if (uses_placement_detector(sym) == labels) return true;
+            }
+        }
+    }
+    return false;
+}
+
+// turns off the layers drawing nothing in a pass, so they are not
+// queried by it, but keeps those clearing the labels of the label pass;
+// returns whether any layer is left
+bool prune_layers(Map const& m, std::vector<layer> & layers, bool labels)
+{
+    bool any = false;
+    for (layer & lay : layers)
+    {
+        bool children = prune_layers(m, lay.layers(), labels);
+        if (!children && !draws_in_pass(m, lay, labels) &&
+            !(labels && lay.clear_label_cache()))
+        {
+            lay.set_active(false);
+        }
+        any = any || lay.active();
+    }
+    return any;
+}
+
+double map_scale_denom(Map const& m, double scale_denom)
+{
+    if (scale_denom <= 0.0)
+    {
+        projection proj(m.srs(), true);
+        scale_denom = scale_denominator(m.scale(), proj.is_geographic());
+    }
+    return scale_denom;
+}
+
+}
+
+strip_renderer::strip_renderer(Map const& m,
+                               unsigned strips,
+                               double scale_factor)
+    : m_(m),
+      strips_(std::min(strips, m.height())),
+      scale_factor_(scale_factor)
+{
+    if (strips == 0)
+    {
+        throw std::runtime_error("strip_renderer: at least one strip is needed");
+    }
+}
+
+unsigned strip_renderer::strip_row(unsigned strip) const
+{
+    return static_cast<unsigned>(static_cast<std::uint64_t>(strip) * m_.height() / strips_);
+}
+
+box2d<double> strip_renderer::strip_extent(unsigned strip) const
+{
+    box2d<double> const& ext = m_.get_current_extent();
+    double row_h = ext.height() / m_.height();
+    double maxy = ext.maxy() - strip_row(strip) * row_h;
+    double miny = ext.maxy() - strip_row(strip + 1) * row_h;
+    return box2d<double>(ext.minx(), miny, ext.maxx(), maxy);
+}
+
+bool strip_renderer::splittable(Map const& m)
+{
+    if (m.background_image()) return false;
+    for (auto const& kv : m.styles())
+    {
+        feature_type_style const& style = kv.second;
+        if (!style.image_filters().empty() || !style.direct_image_filters().empty())
+        {
+            // filters read pixels across the strip edges
+            return false;
+        }
+        for (rule const& r : style.get_rules())
+        {
+            for (symbolizer const& sym : r)
+            {
+                // patterns are aligned to the image they are drawn into
+                if (sym.is<polygon_pattern_symbolizer>()) return false;
+            }
+        }
+    }
+    return true;
+}
+
+void strip_renderer::apply(image_rgba8 & image, double scale_denom) const
+{
+    scale_denom = map_scale_denom(m_, scale_denom);
+    if (image.width() != m_.width() || image.height() != m_.height())
+    {
+        image = image_rgba8(m_.width(), m_.height());
+    }
+    if (strips_ < 2 || !splittable(m_))
+    {
+        renderer_type ren(m_, image, scale_factor_);
+        ren.apply(scale_denom);
+        return;
+    }
+
+    // the strips and the label pass read the same features
+    Map strip_map(m_);
+    std::vector<detail::layer_buckets> buckets;
+    std::vector<box2d<double>> extents(1, m_.get_current_extent());
+    // rules are selected with the scale factor applied, as in feature_style_processor::apply
+    detail::bucket_layers(m_, strip_map.layers(), extents, scale_denom * scale_factor_, buckets, true);
+    for (detail::layer_buckets & lb : buckets)
+    {
+        lb.lay->set_datasource(lb.buckets.front());
+    }
+    Map label_map(strip_map);
+    label_map.reset_background();
+    bool labels = prune_layers(label_map, label_map.layers(), true);
+    prune_layers(strip_map, strip_map.layers(), false);
+
+    MAPNIK_LOG_DEBUG(strip_renderer) << "strip_renderer: Rendering " << strips_ << " strips, "
+                                     << buckets.size() << " layers queried once";
+
+    std::vector<char> painted(strips_, 0);
+    auto render_strip = [&](unsigned strip)
+    {
+        unsigned row0 = strip_row(strip);
+        unsigned rows = strip_row(strip + 1) - row0;
+        // a view of the strip's rows, drawn in place
+        image_rgba8 strip_image(image.width(), rows,
+                                reinterpret_cast<unsigned char*>(image.get_row(row0)));
+        request req(image.width(), rows, strip_extent(strip));
+        req.set_buffer_size(m_.buffer_size());
+        agg_render_context<image_rgba8> context;
+        renderer_type ren(strip_map, req, attributes(), strip_image, context, scale_factor_);
+        ren.set_symbolizer_pass(renderer_type::geometry_symbolizers);
+        ren.apply(scale_denom);
+        painted[strip] = strip_image.painted();
+    };
+
+    // a strip per executor thread, the rest are drawn here
+    parallel_for(strips_, strips_, [&](std::size_t strip) {
+        render_strip(static_cast<unsigned>(strip));
+    });
+
+    if (std::find(painted.begin(), painted.end(), 1) != painted.end())
+    {
+        image.painted(true);
+    }
+    if (labels)
+    {
+        renderer_type ren(label_map, image, scale_factor_);
+        ren.set_symbolizer_pass(renderer_type::label_symbolizers);
+        ren.apply(scale_denom);
+    }
+}
+
+void strip_renderer::apply(band_sink const& sink, double scale_denom) const
+{
+    scale_denom = map_scale_denom(m_, scale_denom);
+    if (!splittable(m_))
+    {
+        image_rgba8 image(m_.width(), m_.height());
+        renderer_type ren(m_, image, scale_factor_);
+        ren.apply(scale_denom);
+        for (unsigned strip = 0; strip < strips_; ++strip)
+        {
+            unsigned row0 = strip_row(strip);
+            image_rgba8 band(image.width(), strip_row(strip + 1) - row0,
+                             reinterpret_cast<unsigned char*>(image.get_row(row0)));
+            sink(band, row0);
+        }
+        return;
+    }
+
+    Map strip_map(m_);
+    prune_layers(strip_map, strip_map.layers(), false);
+    // the label features are read once and placed again for every strip
+    Map label_map(m_);
+    label_map.reset_background();
+    bool labels = prune_layers(label_map, label_map.layers(), true);
+    if (labels)
+    {
+        std::vector<detail::layer_buckets> buckets;
+        std::vector<box2d<double>> extents(1, m_.get_current_extent());
+        detail::bucket_layers(m_, label_map.layers(), extents, scale_denom * scale_factor_, buckets, true);
+        for (detail::layer_buckets & lb : buckets)
+        {
+            lb.lay->set_datasource(lb.buckets.front());
+        }
+    }
+
+    MAPNIK_LOG_DEBUG(strip_renderer) << "strip_renderer: Rendering " << strips_ << " strips in turn";
+
+    double buffer = m_.buffer_size();
+    unsigned max_rows = 0;
+    for (unsigned strip = 0; strip < strips_; ++strip)
+    {
+        max_rows = std::max(max_rows, strip_row(strip + 1) - strip_row(strip));
+    }
+    image_rgba8 buffer_image(m_.width(), max_rows);
+    agg_render_context<image_rgba8> context;
+    for (unsigned strip = 0; strip < strips_; ++strip)
+    {
+        unsigned row0 = strip_row(strip);
+        unsigned rows = strip_row(strip + 1) - row0;
+        // the top rows of the one buffer, cleared as a new image would be
+        image_rgba8 band(buffer_image.width(), rows, buffer_image.bytes());
+        band.set(0);
+        request req(band.width(), rows, strip_extent(strip));
+        req.set_buffer_size(m_.buffer_size());
+        {
+            renderer_type ren(strip_map, req, attributes(), band, context, scale_factor_);
+            ren.set_symbolizer_pass(renderer_type::geometry_symbolizers);
+            ren.apply(scale_denom);
+        }
+        if (labels)
+        {
+            // the map's own detector, moved along with the strip's rows
+            auto detector = std::make_shared<label_collision_detector4>(
+                box2d<double>(-buffer, -buffer - row0, m_.width() + buffer, m_.height() + buffer - row0));
+            renderer_type ren(label_map, band, detector, scale_factor_, 0, row0);
+            ren.set_symbolizer_pass(renderer_type::label_symbolizers);
+            ren.apply(scale_denom);
+        }
+        sink(band, row0);
+    }
+}
+
+}
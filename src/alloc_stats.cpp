@@ -0,0 +1,202 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/alloc_stats.hpp>
+
+#ifdef MAPNIK_ALLOC_STATS
+// stl
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace mapnik { namespace alloc_stats {
+
+#ifdef MAPNIK_ALLOC_STATS
+
+namespace {
+
+// plain thread local storage, constructing anything here would recurse
+// into operator new
+thread_local alloc_phase current_phase = alloc_phase::other;
+thread_local alloc_counters thread_counters[static_cast<std::size_t>(alloc_phase::count)];
+thread_local std::ptrdiff_t thread_live_bytes = 0;
+thread_local std::ptrdiff_t thread_peak_bytes = 0;
+
+// keeps the blocks handed out aligned for any type
+constexpr std::size_t header_size = alignof(std::max_align_t) > sizeof(std::size_t) ?
+    alignof(std::max_align_t) : sizeof(std::size_t);
+
+void * allocate(std::size_t size)
+{
+    void * block = std::malloc(size + header_size);
+    if (!block) return nullptr;
+    *static_cast<std::size_t*>(block) = size;
+    alloc_counters & counters = thread_counters[static_cast<std::size_t>(current_phase)];
+    ++counters.allocations;
+    counters.bytes += size;
+    thread_live_bytes += static_cast<std::ptrdiff_t>(size);
+    thread_peak_bytes = std::max(thread_peak_bytes, thread_live_bytes);
+    return static_cast<char*>(block) + header_size;
+}
+
+void deallocate(void * ptr)
+{
+    if (!ptr) return;
+    void * block = static_cast<char*>(ptr) - header_size;
+    // blocks freed by another thread than their allocating one skew both
+    // threads' live bytes, the totals stay right
+    thread_live_bytes -= static_cast<std::ptrdiff_t>(*static_cast<std::size_t*>(block));
+    std::free(block);
+}
+
+void * allocate_or_throw(std::size_t size)
+{
+    for (;;)
+    {
+        void * ptr = allocate(size);
+        if (ptr) return ptr;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+}
+
+bool enabled()
+{
+    return true;
+}
+
+alloc_phase set_phase(alloc_phase phase)
+{
+    alloc_phase previous = current_phase;
+    current_phase = phase;
+    return previous;
+}
+
+alloc_phase_counters counters()
+{
+    alloc_phase_counters result;
+    std::copy(std::begin(thread_counters), std::end(thread_counters), result.begin());
+    return result;
+}
+
+std::ptrdiff_t live_bytes()
+{
+    return thread_live_bytes;
+}
+
+std::ptrdiff_t peak_bytes()
+{
+    return thread_peak_bytes;
+}
+
+void reset_peak()
+{
+    thread_peak_bytes = thread_live_bytes;
+}
+
+#else
+
+bool enabled()
+{
+    return false;
+}
+
+alloc_phase_counters counters()
+{
+    return alloc_phase_counters();
+}
+
+std::ptrdiff_t live_bytes()
+{
+    return 0;
+}
+
+std::ptrdiff_t peak_bytes()
+{
+    return 0;
+}
+
+void reset_peak() {}
+
+#endif
+
+}}
+
+#ifdef MAPNIK_ALLOC_STATS
+
+void * operator new(std::size_t size)
+{
+    return mapnik::alloc_stats::allocate_or_throw(size);
+}
+
+void * operator new[](std::size_t size)
+{
+    return mapnik::alloc_stats::allocate_or_throw(size);
+}
+
+void * operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    return mapnik::alloc_stats::allocate(size);
+}
+
+void * operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    return mapnik::alloc_stats::allocate(size);
+}
+
+void operator delete(void * ptr) noexcept
+{
+    mapnik::alloc_stats::deallocate(ptr);
+}
+
+void operator delete[](void * ptr) noexcept
+{
+    mapnik::alloc_stats::deallocate(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept
+{
+    mapnik::alloc_stats::deallocate(ptr);
+}
+
+void operator delete[](void * ptr, std::size_t) noexcept
+{
+    mapnik::alloc_stats::deallocate(ptr);
+}
+
+void operator delete(void * ptr, std::nothrow_t const&) noexcept
+{
+    mapnik::alloc_stats::deallocate(ptr);
+}
+
+void operator delete[](void * ptr, std::nothrow_t const&) noexcept
+{
+    mapnik::alloc_stats::deallocate(ptr);
+}
+
+#endif
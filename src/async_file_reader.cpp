@@ -0,0 +1,179 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/async_file_reader.hpp>
+#include <mapnik/query_scheduler.hpp>
+#include <mapnik/util/utf_conv_win.hpp>
+
+// stl
+#include <vector>
+#ifdef _WINDOWS
+#include <fstream>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace mapnik
+{
+
+namespace detail
+{
+
+struct read_file
+{
+    explicit read_file(std::string const& filename)
+        : filename(filename)
+#ifndef _WINDOWS
+        , fd(::open(filename.c_str(), O_RDONLY))
+#endif
+    {}
+
+    ~read_file()
+    {
+#ifndef _WINDOWS
+        if (fd >= 0) ::close(fd);
+#endif
+    }
+
+    bool is_open() const
+    {
+#ifdef _WINDOWS
+        return std::ifstream(mapnik::utf8_to_utf16(filename), std::ios::binary).good();
+#else
+        return fd >= 0;
+#endif
+    }
+
+    bool read(std::uint64_t offset, char * data, std::size_t size) const
+    {
+#ifdef _WINDOWS
+        std::ifstream file(mapnik::utf8_to_utf16(filename), std::ios::binary);
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(data, static_cast<std::streamsize>(size));
+        return file.good();
+#else
+        while (size > 0)
+        {
+            ssize_t count = ::pread(fd, data, size, static_cast<off_t>(offset));
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) return false;
+            data += count;
+            size -= static_cast<std::size_t>(count);
+            offset += static_cast<std::uint64_t>(count);
+        }
+        return true;
+#endif
+    }
+
+    std::string filename;
+#ifndef _WINDOWS
+    int fd;
+#endif
+};
+
+struct file_read
+{
+    file_read(std::shared_ptr<read_file> const& file, std::uint64_t offset, std::size_t size)
+        : file(file),
+          offset(offset),
+          data(size),
+          done(false),
+          good(false) {}
+
+    void run()
+    {
+        good = file->read(offset, data.data(), data.size());
+        done = true;
+    }
+
+    std::shared_ptr<read_file> file;
+    std::uint64_t offset;
+    std::vector<char> data;
+    query_handle job;
+    bool done;
+    bool good;
+};
+
+}
+
+async_file_reader::handle::handle(std::shared_ptr<detail::file_read> const& read)
+    : read_(read) {}
+
+std::uint64_t async_file_reader::handle::offset() const
+{
+    return read_ ? read_->offset : 0;
+}
+
+std::size_t async_file_reader::handle::size() const
+{
+    return read_ ? read_->data.size() : 0;
+}
+
+char const* async_file_reader::handle::get()
+{
+    if (!read_) return nullptr;
+    if (read_->job.valid())
+    {
+        // runs the read here if no worker has picked it up yet
+        read_->job.get();
+        read_->job = query_handle();
+    }
+    if (!read_->done) read_->run();
+    return read_->good ? read_->data.data() : nullptr;
+}
+
+void async_file_reader::handle::cancel()
+{
+    if (read_ && read_->job.valid()) read_->job.cancel();
+    read_.reset();
+}
+
+async_file_reader::async_file_reader(std::string const& filename)
+    : file_(std::make_shared<detail::read_file>(filename)) {}
+
+async_file_reader::~async_file_reader() {}
+
+bool async_file_reader::is_open() const
+{
+    return file_->is_open();
+}
+
+async_file_reader::handle async_file_reader::read(std::uint64_t offset, std::size_t size)
+{
+    auto read = std::make_shared<detail::file_read>(file_, offset, size);
+    // without workers the read waits in the queue until get() anyway
+    if (query_scheduler::instance().threads() > 0)
+    {
+        std::weak_ptr<detail::file_read> weak = read;
+        read->job = query_scheduler::instance().submit("file_io", [weak] {
+                if (auto r = weak.lock()) r->run();
+                return featureset_ptr();
+            });
+    }
+    return handle(read);
+}
+
+}
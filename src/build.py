@@ -171,13 +171,16 @@ source = Split(
     debug.cpp
     geometry/box2d.cpp
     geometry/closest_point.cpp
+    geometry/interior.cpp
     geometry/reprojection.cpp
     geometry/envelope.cpp
     expression_node.cpp
     expression_string.cpp
     expression.cpp
+    compiled_expression.cpp
     transform_expression.cpp
     transform_expression_grammar_x3.cpp
+    feature_arena.cpp
     feature_kv_iterator.cpp
     feature_style_processor.cpp
     feature_type_style.cpp
@@ -195,6 +198,7 @@ source = Split(
     image_view_any.cpp
     image_any.cpp
     image_options.cpp
+    image_kernels.cpp
     image_util.cpp
     image_util_jpeg.cpp
     image_util_png.cpp
@@ -204,14 +208,36 @@ source = Split(
     map.cpp
     load_map.cpp
     palette.cpp
+    histogram_quantizer.cpp
     marker_helpers.cpp
+    marker_sprite_cache.cpp
     plugin.cpp
     rule.cpp
+    rule_cache.cpp
+    rule_bands.cpp
+    sql_filter.cpp
+    executor.cpp
+    numa.cpp
+    query_scheduler.cpp
+    async_file_reader.cpp
+    feature_cache.cpp
+    datasource_metadata_cache.cpp
+    layer_image_cache.cpp
+    solid_tile_cache.cpp
+    image_tile_cache.cpp
+    parse_cache.cpp
+    geometry_pyramid.cpp
+    density_aggregator.cpp
+    render_stats.cpp
+    alloc_stats.cpp
+    memory_report.cpp
+    trace.cpp
     save_map.cpp
     wkb.cpp
     twkb.cpp
     projection.cpp
     proj_transform.cpp
+    projection_cache.cpp
     scale_denominator.cpp
     simplify.cpp
     parse_transform.cpp
@@ -229,6 +255,7 @@ source = Split(
     svg/svg_transform_parser.cpp
     svg/svg_path_grammar_x3.cpp
     warp.cpp
+    warp_mesh_cache.cpp
     vertex_cache.cpp
     vertex_adapters.cpp
     text/font_library.cpp
@@ -241,6 +268,9 @@ source = Split(
     text/placement_finder.cpp
     text/properties_util.cpp
     text/renderer.cpp
+    text/glyph_cache.cpp
+    text/distance_field.cpp
+    text/shaping_cache.cpp
     text/color_font_renderer.cpp
     text/symbolizer_helpers.cpp
     text/text_properties.cpp
@@ -263,10 +293,14 @@ source = Split(
     config_error.cpp
     color_factory.cpp
     renderer_common.cpp
+    renderer_common/layer_buckets.cpp
+    renderer_common/label_phase.cpp
+    renderer_common/line_path_cache.cpp
     renderer_common/render_group_symbolizer.cpp
     renderer_common/render_markers_symbolizer.cpp
     renderer_common/render_pattern.cpp
     renderer_common/render_thunk_extractor.cpp
+    vector_tile/vector_tile_renderer.cpp
     math.cpp
     value.cpp
     """
@@ -359,6 +393,9 @@ source += Split(
     agg/process_markers_symbolizer.cpp
     agg/process_group_symbolizer.cpp
     agg/process_debug_symbolizer.cpp
+    agg/metatile_renderer.cpp
+    agg/strip_renderer.cpp
+    agg/multiscale_renderer.cpp
     """
     )
 
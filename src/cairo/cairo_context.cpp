@@ -508,10 +508,21 @@ void cairo_context::pop_group()
 }
 
 cairo_face_manager::cairo_face_manager(std::shared_ptr<font_library> font_library)
-  : font_library_(font_library)
+  : font_library_(font_library),
+    cache_(thread_cache())
 {
 }
 
+cairo_face_manager::cairo_face_cache & cairo_face_manager::thread_cache()
+{
+#ifdef MAPNIK_THREADSAFE
+    static thread_local cairo_face_cache cache;
+#else
+    static cairo_face_cache cache;
+#endif
+    return cache;
+}
+
 cairo_face_ptr cairo_face_manager::get_face(face_ptr face)
 {
     cairo_face_cache::iterator itr = cache_.find(face);
@@ -523,12 +534,71 @@ cairo_face_ptr cairo_face_manager::get_face(face_ptr face)
     }
     else
     {
+        // faces stay valid once dropped, their handle owns face and library
+        if (cache_.size() >= max_faces) cache_.clear();
         entry = std::make_shared<cairo_face>(font_library_, face);
         cache_.emplace(face, entry);
     }
     return entry;
 }
 
+cairo_pattern_cache & cairo_pattern_cache::instance()
+{
+#ifdef MAPNIK_THREADSAFE
+    static thread_local cairo_pattern_cache cache;
+#else
+    static cairo_pattern_cache cache;
+#endif
+    return cache;
+}
+
+cairo_pattern_cache::pattern_ptr cairo_pattern_cache::get(marker_ptr const& owner,
+                                                          image_rgba8 const& data,
+                                                          double opacity)
+{
+    key_type key = make_key(owner, agg::trans_affine(), opacity);
+    if (pattern_ptr pattern = find(key)) return pattern;
+    return insert(key, owner, data, opacity);
+}
+
+void cairo_pattern_cache::clear()
+{
+    cache_.clear();
+    bytes_ = 0;
+}
+
+cairo_pattern_cache::key_type cairo_pattern_cache::make_key(marker_ptr const& owner,
+                                                            agg::trans_affine const& tr,
+                                                            double opacity)
+{
+    return key_type(owner.get(), {{ tr.sx, tr.shy, tr.shx, tr.sy, tr.tx, tr.ty, opacity }});
+}
+
+cairo_pattern_cache::pattern_ptr cairo_pattern_cache::find(key_type const& key) const
+{
+    auto itr = cache_.find(key);
+    if (itr == cache_.end()) return pattern_ptr();
+    itr->second.pattern->reset();
+    return itr->second.pattern;
+}
+
+cairo_pattern_cache::pattern_ptr cairo_pattern_cache::insert(key_type const& key,
+                                                             marker_ptr const& owner,
+                                                             image_rgba8 const& data,
+                                                             double opacity)
+{
+    std::size_t bytes = data.size();
+    if (bytes_ + bytes > max_bytes) clear();
+    pattern_ptr pattern = std::make_shared<cairo_pattern>(data, opacity);
+    // a single image over the budget is drawn without being kept
+    if (bytes <= max_bytes)
+    {
+        cache_.emplace(key, entry{owner, pattern});
+        bytes_ += bytes;
+    }
+    return pattern;
+}
+
 } //ns mapnik
 
 #endif
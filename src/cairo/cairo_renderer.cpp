@@ -73,7 +73,7 @@ cairo_renderer<T>::cairo_renderer(Map const& m,
                                   double scale_factor,
                                   unsigned offset_x,
                                   unsigned offset_y)
-    : feature_style_processor<cairo_renderer>(m, scale_factor),
+    : feature_style_processor<cairo_renderer>(m, req, scale_factor),
       m_(m),
       context_(cairo),
       common_(m, req, vars, offset_x, offset_y, req.width(), req.height(), scale_factor),
@@ -177,6 +177,12 @@ void cairo_renderer<T>::end_map_processing(Map const&)
     MAPNIK_LOG_DEBUG(cairo_renderer) << "cairo_renderer: End map processing";
 }
 
+template <typename T>
+double cairo_renderer<T>::label_coverage() const
+{
+    return common_.detector_->coverage();
+}
+
 template <typename T>
 void cairo_renderer<T>::start_layer_processing(layer const& lay, box2d<double> const& query_extent)
 {
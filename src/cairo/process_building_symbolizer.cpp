@@ -53,8 +53,11 @@ void cairo_renderer<T>::process(building_symbolizer const& sym,
 
     context_.set_operator(comp_op);
 
+    // opaque walls composited over what is below are filled in one pass
+    bool batch_faces = comp_op == src_over && fill.alpha() * opacity >= 255.0;
+
     render_building_symbolizer(
-        feature, height,
+        feature, height, batch_faces,
         [&](path_type const& faces)
         {
             vertex_adapter va(faces);
@@ -43,11 +43,13 @@ namespace mapnik
 struct cairo_renderer_process_visitor_l
 {
     cairo_renderer_process_visitor_l(renderer_common const& common,
+                                   std::shared_ptr<mapnik::marker const> const& owner,
                                    line_pattern_symbolizer const& sym,
                                    mapnik::feature_impl & feature,
                                    std::size_t & width,
                                    std::size_t & height)
         : common_(common),
+          owner_(owner),
           sym_(sym),
           feature_(feature),
           width_(width),
@@ -66,21 +68,25 @@ struct cairo_renderer_process_visitor_l
         auto image_transform = get_optional<transform_type>(sym_, keys::image_transform);
         if (image_transform) evaluate_transform(image_tr, feature_, common_.vars_, *image_transform, common_.scale_factor_);
         mapnik::box2d<double> const& bbox_image = marker.get_data()->bounding_box() * image_tr;
-        mapnik::image_rgba8 image(bbox_image.width(), bbox_image.height());
-        render_pattern<image_rgba8>(ras, marker, image_tr, 1.0, image);
-        width_ = image.width();
-        height_ = image.height();
-        return std::make_shared<cairo_pattern>(image, opacity);
+        width_ = static_cast<std::size_t>(bbox_image.width());
+        height_ = static_cast<std::size_t>(bbox_image.height());
+        return cairo_pattern_cache::instance().get(owner_, image_tr, opacity, [&]
+        {
+            mapnik::image_rgba8 image(width_, height_);
+            render_pattern<image_rgba8>(ras, marker, image_tr, 1.0, image);
+            return image;
+        });
     }
 
     std::shared_ptr<cairo_pattern> operator() (mapnik::marker_rgba8 const& marker)
     {
         double opacity = get<value_double, keys::opacity>(sym_, feature_, common_.vars_);
-        return std::make_shared<cairo_pattern>(marker.get_data(), opacity);
+        return cairo_pattern_cache::instance().get(owner_, marker.get_data(), opacity);
     }
 
   private:
     renderer_common const& common_;
+    std::shared_ptr<mapnik::marker const> const& owner_;
     line_pattern_symbolizer const& sym_;
     mapnik::feature_impl & feature_;
     std::size_t & width_;
@@ -115,6 +121,7 @@ void cairo_renderer<T>::process(line_pattern_symbolizer const& sym,
     context_.set_operator(comp_op);
     // TODO - re-implement at renderer level like polygon_pattern symbolizer
     cairo_renderer_process_visitor_l visit(common_,
+                                           marker,
                                            sym,
                                            feature,
                                            width,
@@ -162,7 +169,10 @@ void cairo_renderer<T>::process(line_pattern_symbolizer const& sym,
     using apply_vertex_converter_type = detail::apply_vertex_converter<vertex_converter_type, rasterizer_type>;
     using vertex_processor_type = geometry::vertex_processor<apply_vertex_converter_type>;
     apply_vertex_converter_type apply(converter, ras);
-    mapnik::util::apply_visitor(vertex_processor_type(apply), feature.get_geometry());
+    if (!converter.clipped_away(feature))
+    {
+        mapnik::util::apply_visitor(vertex_processor_type(apply), static_cast<feature_impl const&>(feature).get_geometry());
+    }
 }
 
 template void cairo_renderer<cairo_ptr>::process(line_pattern_symbolizer const&,
@@ -93,7 +93,7 @@ void cairo_renderer<T>::process(line_symbolizer const& sym,
 
     if (clip)
     {
-        geometry::geometry_types type = geometry::geometry_type(feature.get_geometry());
+        geometry::geometry_types type = feature.geometry_type();
         if (type == geometry::geometry_types::Polygon || type == geometry::geometry_types::MultiPolygon)
             converter.template set<clip_poly_tag>();
         else if (type == geometry::geometry_types::LineString || type == geometry::geometry_types::MultiLineString)
@@ -107,7 +107,10 @@ void cairo_renderer<T>::process(line_symbolizer const& sym,
     using apply_vertex_converter_type = detail::apply_vertex_converter<vertex_converter_type, cairo_context>;
     using vertex_processor_type = geometry::vertex_processor<apply_vertex_converter_type>;
     apply_vertex_converter_type apply(converter, context_);
-    mapnik::util::apply_visitor(vertex_processor_type(apply),feature.get_geometry());
+    if (!converter.clipped_away(feature))
+    {
+        mapnik::util::apply_visitor(vertex_processor_type(apply),static_cast<feature_impl const&>(feature).get_geometry());
+    }
     // stroke
     context_.set_fill_rule(CAIRO_FILL_RULE_WINDING);
     context_.stroke();
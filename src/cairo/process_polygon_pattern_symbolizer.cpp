@@ -43,11 +43,13 @@ namespace mapnik
 struct cairo_renderer_process_visitor_p
 {
     cairo_renderer_process_visitor_p(cairo_context & context,
+                                   std::shared_ptr<mapnik::marker const> const& owner,
                                    agg::trans_affine & image_tr,
                                    unsigned offset_x,
                                    unsigned offset_y,
                                    float opacity)
         : context_(context),
+          owner_(owner),
           image_tr_(image_tr),
           offset_x_(offset_x),
           offset_y_(offset_y),
@@ -57,26 +59,30 @@ struct cairo_renderer_process_visitor_p
 
     void operator() (marker_svg const& marker)
     {
-        mapnik::rasterizer ras;
-        mapnik::box2d<double> const& bbox_image = marker.get_data()->bounding_box() * image_tr_;
-        mapnik::image_rgba8 image(bbox_image.width(), bbox_image.height());
-        render_pattern<image_rgba8>(ras, marker, image_tr_, 1.0, image);
-        cairo_pattern pattern(image, opacity_);
-        pattern.set_extend(CAIRO_EXTEND_REPEAT);
-        pattern.set_origin(offset_x_, offset_y_);
-        context_.set_pattern(pattern);
+        auto pattern = cairo_pattern_cache::instance().get(owner_, image_tr_, opacity_, [&]
+        {
+            mapnik::rasterizer ras;
+            mapnik::box2d<double> const& bbox_image = marker.get_data()->bounding_box() * image_tr_;
+            mapnik::image_rgba8 image(bbox_image.width(), bbox_image.height());
+            render_pattern<image_rgba8>(ras, marker, image_tr_, 1.0, image);
+            return image;
+        });
+        pattern->set_extend(CAIRO_EXTEND_REPEAT);
+        pattern->set_origin(offset_x_, offset_y_);
+        context_.set_pattern(*pattern);
     }
 
     void operator() (marker_rgba8 const& marker)
     {
-        cairo_pattern pattern(marker.get_data(), opacity_);
-        pattern.set_extend(CAIRO_EXTEND_REPEAT);
-        pattern.set_origin(offset_x_, offset_y_);
-        context_.set_pattern(pattern);
+        auto pattern = cairo_pattern_cache::instance().get(owner_, marker.get_data(), opacity_);
+        pattern->set_extend(CAIRO_EXTEND_REPEAT);
+        pattern->set_origin(offset_x_, offset_y_);
+        context_.set_pattern(*pattern);
     }
 
   private:
     cairo_context & context_;
+    std::shared_ptr<mapnik::marker const> const& owner_;
     agg::trans_affine & image_tr_;
     unsigned offset_x_;
     unsigned offset_y_;
@@ -114,12 +120,12 @@ void cairo_renderer<T>::process(polygon_pattern_symbolizer const& sym,
         double y0 = 0.0;
         using apply_local_alignment = detail::apply_local_alignment;
         apply_local_alignment apply(common_.t_, prj_trans, clip_box, x0, y0);
-        util::apply_visitor(geometry::vertex_processor<apply_local_alignment>(apply), feature.get_geometry());
+        util::apply_visitor(geometry::vertex_processor<apply_local_alignment>(apply), static_cast<feature_impl const&>(feature).get_geometry());
         offset_x = std::abs(clip_box.width() - x0);
         offset_y = std::abs(clip_box.height() - y0);
     }
 
-    util::apply_visitor(cairo_renderer_process_visitor_p(context_, image_tr, offset_x, offset_y, opacity), *marker);
+    util::apply_visitor(cairo_renderer_process_visitor_p(context_, marker, image_tr, offset_x, offset_y, opacity), *marker);
 
     agg::trans_affine tr;
     auto geom_transform = get_optional<transform_type>(sym, keys::geometry_transform);
@@ -131,7 +137,7 @@ void cairo_renderer<T>::process(polygon_pattern_symbolizer const& sym,
                                                    smooth_tag>;
 
     vertex_converter_type converter(clip_box,sym,common_.t_,prj_trans,tr,feature,common_.vars_,common_.scale_factor_);
-    if (prj_trans.equal() && clip) converter.set<clip_poly_tag>();
+    if ((prj_trans.equal() || prj_trans.is_known()) && clip) converter.set<clip_poly_tag>();
     converter.set<transform_tag>(); //always transform
     converter.set<affine_transform_tag>();
     if (simplify_tolerance > 0.0) converter.set<simplify_tag>(); // optional simplify converter
@@ -140,7 +146,10 @@ void cairo_renderer<T>::process(polygon_pattern_symbolizer const& sym,
     using apply_vertex_converter_type = detail::apply_vertex_converter<vertex_converter_type, cairo_context>;
     using vertex_processor_type = geometry::vertex_processor<apply_vertex_converter_type>;
     apply_vertex_converter_type apply(converter, context_);
-    mapnik::util::apply_visitor(vertex_processor_type(apply),feature.get_geometry());
+    if (!converter.clipped_away(feature))
+    {
+        mapnik::util::apply_visitor(vertex_processor_type(apply),static_cast<feature_impl const&>(feature).get_geometry());
+    }
     // fill polygon
     context_.set_fill_rule(CAIRO_FILL_RULE_EVEN_ODD);
     context_.fill();
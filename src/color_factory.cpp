@@ -26,8 +26,55 @@
 #include <mapnik/config_error.hpp>
 #include <mapnik/css_color_grammar_x3.hpp>
 
+// stl
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+
 namespace mapnik {
 
+namespace {
+
+// least recently used colors of a thread, keyed by their source string
+class color_lru
+{
+public:
+    static constexpr std::size_t max_entries = 256;
+
+    color const* find(std::string const& str)
+    {
+        auto itr = entries_.find(str);
+        if (itr == entries_.end()) return nullptr;
+        lru_.splice(lru_.begin(), lru_, itr->second.lru);
+        return &itr->second.value;
+    }
+
+    void insert(std::string const& str, color const& c)
+    {
+        if (entries_.size() >= max_entries)
+        {
+            entries_.erase(lru_.back());
+            lru_.pop_back();
+        }
+        lru_.push_front(str);
+        entries_.emplace(str, entry{c, lru_.begin()});
+    }
+
+private:
+    struct entry
+    {
+        color value;
+        std::list<std::string>::iterator lru;
+    };
+    std::unordered_map<std::string, entry> entries_;
+    // most recently used first
+    std::list<std::string> lru_;
+};
+
+constexpr std::size_t color_lru::max_entries;
+
+}
+
 color parse_color(std::string const& str)
 {
     // TODO - early return for @color?
@@ -48,4 +95,13 @@ color parse_color(std::string const& str)
     }
 }
 
+color parse_color_cached(std::string const& str)
+{
+    static thread_local color_lru cache;
+    if (color const* c = cache.find(str)) return *c;
+    color c = parse_color(str);
+    cache.insert(str, c);
+    return c;
+}
+
 }
@@ -0,0 +1,387 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/compiled_expression.hpp>
+#include <mapnik/expression_node.hpp>
+#include <mapnik/value.hpp>
+
+// stl
+#include <stdexcept>
+
+namespace mapnik
+{
+
+namespace {
+
+using opcode = compiled_expression::opcode;
+
+template <typename Tag> struct binary_opcode;
+template <> struct binary_opcode<tags::plus> { static constexpr opcode value = opcode::plus; };
+template <> struct binary_opcode<tags::minus> { static constexpr opcode value = opcode::minus; };
+template <> struct binary_opcode<tags::mult> { static constexpr opcode value = opcode::mult; };
+template <> struct binary_opcode<tags::div> { static constexpr opcode value = opcode::div; };
+template <> struct binary_opcode<tags::mod> { static constexpr opcode value = opcode::mod; };
+template <> struct binary_opcode<tags::less> { static constexpr opcode value = opcode::less; };
+template <> struct binary_opcode<tags::less_equal> { static constexpr opcode value = opcode::less_equal; };
+template <> struct binary_opcode<tags::greater> { static constexpr opcode value = opcode::greater; };
+template <> struct binary_opcode<tags::greater_equal> { static constexpr opcode value = opcode::greater_equal; };
+template <> struct binary_opcode<tags::equal_to> { static constexpr opcode value = opcode::equal_to; };
+template <> struct binary_opcode<tags::not_equal_to> { static constexpr opcode value = opcode::not_equal_to; };
+
+// offset from a comparison opcode to its fused attribute/constant form
+constexpr int fused_offset = static_cast<int>(opcode::attribute_less) - static_cast<int>(opcode::less);
+
+inline bool is_comparison(opcode op)
+{
+    return op >= opcode::less && op <= opcode::not_equal_to;
+}
+
+template <typename Tag>
+inline value_type apply_op(value_type const& lhs, value_type const& rhs)
+{
+    typename make_op<Tag>::type operation;
+    return operation(lhs, rhs);
+}
+
+inline value_type apply_binary(opcode op, value_type const& lhs, value_type const& rhs)
+{
+    switch (op)
+    {
+    case opcode::plus: return apply_op<tags::plus>(lhs, rhs);
+    case opcode::minus: return apply_op<tags::minus>(lhs, rhs);
+    case opcode::mult: return apply_op<tags::mult>(lhs, rhs);
+    case opcode::div: return apply_op<tags::div>(lhs, rhs);
+    case opcode::mod: return apply_op<tags::mod>(lhs, rhs);
+    case opcode::less: return apply_op<tags::less>(lhs, rhs);
+    case opcode::less_equal: return apply_op<tags::less_equal>(lhs, rhs);
+    case opcode::greater: return apply_op<tags::greater>(lhs, rhs);
+    case opcode::greater_equal: return apply_op<tags::greater_equal>(lhs, rhs);
+    case opcode::equal_to: return apply_op<tags::equal_to>(lhs, rhs);
+    case opcode::not_equal_to: return apply_op<tags::not_equal_to>(lhs, rhs);
+    default: break;
+    }
+    throw std::runtime_error("compiled_expression: not a binary operator");
+}
+
+template <typename T>
+inline std::uint32_t add_item(std::vector<T> & items, T const& item)
+{
+    items.push_back(item);
+    return static_cast<std::uint32_t>(items.size() - 1);
+}
+
+inline std::uint32_t add_name(std::vector<std::string> & names, std::string const& name)
+{
+    for (std::size_t i = 0; i < names.size(); ++i)
+    {
+        if (names[i] == name) return static_cast<std::uint32_t>(i);
+    }
+    return add_item(names, name);
+}
+
+struct is_literal
+{
+    template <typename T>
+    bool operator() (T const&) const { return false; }
+    bool operator() (value_null const&) const { return true; }
+    bool operator() (value_bool) const { return true; }
+    bool operator() (value_integer) const { return true; }
+    bool operator() (value_double) const { return true; }
+    bool operator() (value_unicode_string const&) const { return true; }
+};
+
+struct literal_value
+{
+    template <typename T>
+    value_type operator() (T const&) const { return value_type(); }
+    value_type operator() (value_null const& val) const { return val; }
+    value_type operator() (value_bool val) const { return val; }
+    value_type operator() (value_integer val) const { return val; }
+    value_type operator() (value_double val) const { return val; }
+    value_type operator() (value_unicode_string const& val) const { return val; }
+};
+
+} // anonymous ns
+
+struct expression_compiler
+{
+    using instruction = compiled_expression::instruction;
+
+    explicit expression_compiler(compiled_expression & prog)
+        : prog_(prog) {}
+
+    void emit(opcode op, std::uint32_t a = 0, std::uint32_t b = 0) const
+    {
+        prog_.code_.push_back(instruction { op, a, b });
+    }
+
+    void push_constant(value_type const& val) const
+    {
+        emit(opcode::push_constant, add_item(prog_.constants_, val));
+    }
+
+    void operator() (value_null const& val) const { push_constant(val); }
+    void operator() (value_bool val) const { push_constant(val); }
+    void operator() (value_integer val) const { push_constant(val); }
+    void operator() (value_double val) const { push_constant(val); }
+    void operator() (value_unicode_string const& val) const { push_constant(val); }
+
+    void operator() (attribute const& attr) const
+    {
+        emit(opcode::push_attribute, add_name(prog_.names_, attr.name()));
+    }
+
+    void operator() (global_attribute const& attr) const
+    {
+        emit(opcode::push_global, add_name(prog_.globals_, attr.name));
+    }
+
+    void operator() (geometry_type_attribute const&) const
+    {
+        emit(opcode::push_geometry_type);
+    }
+
+    void operator() (binary_node<tags::logical_and> const& x) const
+    {
+        short_circuit(opcode::and_jump, x);
+    }
+
+    void operator() (binary_node<tags::logical_or> const& x) const
+    {
+        short_circuit(opcode::or_jump, x);
+    }
+
+    template <typename Tag>
+    void operator() (binary_node<Tag> const& x) const
+    {
+        opcode op = binary_opcode<Tag>::value;
+        if (is_comparison(op) &&
+            x.left.template is<attribute>() &&
+            util::apply_visitor(is_literal(), x.right))
+        {
+            emit(static_cast<opcode>(static_cast<int>(op) + fused_offset),
+                 add_name(prog_.names_, x.left.template get<attribute>().name()),
+                 add_item(prog_.constants_, util::apply_visitor(literal_value(), x.right)));
+            return;
+        }
+        util::apply_visitor(*this, x.left);
+        util::apply_visitor(*this, x.right);
+        emit(op);
+    }
+
+    void operator() (unary_node<tags::negate> const& x) const
+    {
+        util::apply_visitor(*this, x.expr);
+        emit(opcode::negate);
+    }
+
+    void operator() (unary_node<tags::logical_not> const& x) const
+    {
+        util::apply_visitor(*this, x.expr);
+        emit(opcode::logical_not);
+    }
+
+    void operator() (regex_match_node const& x) const
+    {
+        util::apply_visitor(*this, x.expr);
+        emit(opcode::regex_match, add_item(prog_.regex_match_nodes_, &x));
+    }
+
+    void operator() (regex_replace_node const& x) const
+    {
+        util::apply_visitor(*this, x.expr);
+        emit(opcode::regex_replace, add_item(prog_.regex_replace_nodes_, &x));
+    }
+
+    void operator() (unary_function_call const& call) const
+    {
+        util::apply_visitor(*this, call.arg);
+        emit(opcode::unary_call, add_item(prog_.unary_calls_, &call));
+    }
+
+    void operator() (binary_function_call const& call) const
+    {
+        util::apply_visitor(*this, call.arg1);
+        util::apply_visitor(*this, call.arg2);
+        emit(opcode::binary_call, add_item(prog_.binary_calls_, &call));
+    }
+
+    template <typename Tag>
+    void short_circuit(opcode op, binary_node<Tag> const& x) const
+    {
+        util::apply_visitor(*this, x.left);
+        std::size_t jump = prog_.code_.size();
+        emit(op);
+        util::apply_visitor(*this, x.right);
+        emit(opcode::to_bool);
+        prog_.code_[jump].a = static_cast<std::uint32_t>(prog_.code_.size());
+    }
+
+    compiled_expression & prog_;
+};
+
+compiled_expression::compiled_expression(expression_ptr const& expr)
+    : expr_(expr),
+      code_(),
+      constants_(),
+      names_(),
+      globals_(),
+      regex_match_nodes_(),
+      regex_replace_nodes_(),
+      unary_calls_(),
+      binary_calls_()
+{
+    expression_compiler compiler(*this);
+    if (expr_)
+    {
+        util::apply_visitor(compiler, *expr_);
+    }
+    else
+    {
+        compiler.push_constant(value_bool(true));
+    }
+}
+
+void compiled_expression::bind(context_type const& ctx, scratch & s) const
+{
+    s.slots.resize(names_.size());
+    for (std::size_t i = 0; i < names_.size(); ++i)
+    {
+        s.slots[i] = ctx.index_of(names_[i]);
+    }
+    s.bound_version = ctx.version();
+}
+
+value_type compiled_expression::evaluate(feature_impl const& feature, attributes const& vars) const
+{
+    scratch s;
+    return evaluate(feature, vars, s);
+}
+
+value_type compiled_expression::evaluate(feature_impl const& feature, attributes const& vars, scratch & s) const
+{
+    context_type const& ctx = feature.get_context();
+    // contexts can grow while features are read, see feature_impl::put_new,
+    // and a scratch may be passed features of another context
+    if (ctx.version() != s.bound_version)
+    {
+        bind(ctx, s);
+    }
+    std::vector<std::size_t> const& slots = s.slots;
+    std::vector<value_type> & stack = s.stack;
+    stack.clear();
+    std::size_t const count = code_.size();
+    for (std::size_t pc = 0; pc < count; ++pc)
+    {
+        instruction const& ins = code_[pc];
+        switch (ins.op)
+        {
+        case opcode::push_constant:
+            stack.push_back(constants_[ins.a]);
+            break;
+        case opcode::push_attribute:
+            // get(context_type::npos) returns the default value
+            stack.push_back(feature.get(slots[ins.a]));
+            break;
+        case opcode::push_global:
+        {
+            auto itr = vars.find(globals_[ins.a]);
+            if (itr != vars.end()) stack.push_back(itr->second);
+            else stack.emplace_back();
+            break;
+        }
+        case opcode::push_geometry_type:
+            stack.push_back(geometry_type_attribute().value<value_type, feature_impl>(feature));
+            break;
+        case opcode::negate:
+            stack.back() = std::negate<value_type>()(stack.back());
+            break;
+        case opcode::logical_not:
+            stack.back() = value_bool(!stack.back().to_bool());
+            break;
+        case opcode::and_jump:
+            if (!stack.back().to_bool())
+            {
+                stack.back() = value_bool(false);
+                pc = ins.a - 1;
+            }
+            else stack.pop_back();
+            break;
+        case opcode::or_jump:
+            if (stack.back().to_bool())
+            {
+                stack.back() = value_bool(true);
+                pc = ins.a - 1;
+            }
+            else stack.pop_back();
+            break;
+        case opcode::to_bool:
+            stack.back() = value_bool(stack.back().to_bool());
+            break;
+        case opcode::attribute_less:
+            stack.emplace_back(value_bool(feature.get(slots[ins.a]) < constants_[ins.b]));
+            break;
+        case opcode::attribute_less_equal:
+            stack.emplace_back(value_bool(feature.get(slots[ins.a]) <= constants_[ins.b]));
+            break;
+        case opcode::attribute_greater:
+            stack.emplace_back(value_bool(feature.get(slots[ins.a]) > constants_[ins.b]));
+            break;
+        case opcode::attribute_greater_equal:
+            stack.emplace_back(value_bool(feature.get(slots[ins.a]) >= constants_[ins.b]));
+            break;
+        case opcode::attribute_equal_to:
+            stack.emplace_back(value_bool(feature.get(slots[ins.a]) == constants_[ins.b]));
+            break;
+        case opcode::attribute_not_equal_to:
+            stack.emplace_back(value_bool(feature.get(slots[ins.a]) != constants_[ins.b]));
+            break;
+        case opcode::regex_match:
+            stack.back() = regex_match_nodes_[ins.a]->apply(stack.back());
+            break;
+        case opcode::regex_replace:
+            stack.back() = regex_replace_nodes_[ins.a]->apply(stack.back());
+            break;
+        case opcode::unary_call:
+            stack.back() = unary_calls_[ins.a]->fun(stack.back());
+            break;
+        case opcode::binary_call:
+        {
+            value_type rhs = std::move(stack.back());
+            stack.pop_back();
+            stack.back() = binary_calls_[ins.a]->fun(stack.back(), rhs);
+            break;
+        }
+        default:
+        {
+            value_type rhs = std::move(stack.back());
+            stack.pop_back();
+            stack.back() = apply_binary(ins.op, stack.back(), rhs);
+            break;
+        }
+        }
+    }
+    return std::move(stack.back());
+}
+
+}
@@ -25,6 +25,9 @@
 #include <mapnik/value/types.hpp>
 
 #include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <limits>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -77,8 +80,132 @@ bool string2bool(const char* iter, const char* end, bool& result)
     return string2bool(val, result);
 }
 
+namespace {
+
+// Strict decimal numbers, [+-]?digits and [+-]?digits[.digits][(e|E)[+-]?digits]
+// without surrounding spaces, are converted here; anything else (spaces,
+// nan/inf, too many digits) goes to the x3 parsers, which also decide what
+// is rejected.
+
+template <typename T>
+bool parse_integer(char const* itr, char const* end, T & result, int max_digits)
+{
+    if (itr == end) return false;
+    bool negative = false;
+    if (*itr == '-' || *itr == '+')
+    {
+        negative = (*itr == '-');
+        if (++itr == end) return false;
+    }
+    if (end - itr > max_digits) return false;
+    T value = 0;
+    for (; itr != end; ++itr)
+    {
+        unsigned digit = static_cast<unsigned char>(*itr) - '0';
+        if (digit > 9) return false;
+        value = value * 10 + static_cast<T>(digit);
+    }
+    result = negative ? -value : value;
+    return true;
+}
+
+struct decimal
+{
+    std::uint64_t mantissa = 0;
+    int exponent = 0;
+    bool negative = false;
+};
+
+// at most 19 significant digits, so the mantissa cannot overflow
+constexpr int max_mantissa_digits = 19;
+
+bool parse_decimal(char const* itr, char const* end, decimal & dec)
+{
+    if (itr == end) return false;
+    if (*itr == '-' || *itr == '+')
+    {
+        dec.negative = (*itr == '-');
+        ++itr;
+    }
+    int num_digits = 0;
+    bool has_digits = false;
+    for (; itr != end; ++itr)
+    {
+        unsigned digit = static_cast<unsigned char>(*itr) - '0';
+        if (digit > 9) break;
+        has_digits = true;
+        if (dec.mantissa == 0 && digit == 0) continue;
+        if (++num_digits > max_mantissa_digits) return false;
+        dec.mantissa = dec.mantissa * 10 + digit;
+    }
+    if (itr != end && *itr == '.')
+    {
+        for (++itr; itr != end; ++itr)
+        {
+            unsigned digit = static_cast<unsigned char>(*itr) - '0';
+            if (digit > 9) break;
+            has_digits = true;
+            --dec.exponent;
+            if (dec.mantissa == 0 && digit == 0) continue;
+            if (++num_digits > max_mantissa_digits) return false;
+            dec.mantissa = dec.mantissa * 10 + digit;
+        }
+    }
+    if (!has_digits) return false;
+    if (itr != end && (*itr == 'e' || *itr == 'E'))
+    {
+        int exponent = 0;
+        if (!parse_integer(itr + 1, end, exponent, 4)) return false;
+        dec.exponent += exponent;
+        itr = end;
+    }
+    return itr == end;
+}
+
+// Clinger's fast path: mantissa and power of ten are both exact and the
+// single multiplication or division rounds correctly
+template <typename T>
+bool decimal_to_float(decimal const& dec, T & result)
+{
+#if FLT_EVAL_METHOD == 0
+    static const T powers_of_ten[] = { T(1e0), T(1e1), T(1e2), T(1e3), T(1e4), T(1e5), T(1e6),
+                                       T(1e7), T(1e8), T(1e9), T(1e10), T(1e11), T(1e12), T(1e13),
+                                       T(1e14), T(1e15), T(1e16), T(1e17), T(1e18), T(1e19), T(1e20),
+                                       T(1e21), T(1e22) };
+    constexpr int max_exponent = std::numeric_limits<T>::digits == 24 ? 10 : 22;
+    constexpr std::uint64_t max_mantissa = std::uint64_t(1) << std::numeric_limits<T>::digits;
+    if (dec.mantissa == 0)
+    {
+        result = dec.negative ? -T(0) : T(0);
+        return true;
+    }
+    if (dec.mantissa > max_mantissa || dec.exponent < -max_exponent || dec.exponent > max_exponent)
+    {
+        return false;
+    }
+    T value = static_cast<T>(dec.mantissa);
+    if (dec.exponent < 0) value /= powers_of_ten[-dec.exponent];
+    else value *= powers_of_ten[dec.exponent];
+    result = dec.negative ? -value : value;
+    return true;
+#else
+    // extended precision intermediates would round twice
+    return false;
+#endif
+}
+
+template <typename T>
+bool string2float_fast(char const* iter, char const* end, T & result)
+{
+    decimal dec;
+    return parse_decimal(iter, end, dec) && decimal_to_float(dec, result);
+}
+
+}
+
 bool string2int(const char* iter, const char* end, int& result)
 {
+    if (parse_integer(iter, end, result, std::numeric_limits<int>::digits10)) return true;
     x3::ascii::space_type space;
     bool r = x3::phrase_parse(iter, end, INTEGER, space, result);
     return r && (iter == end);
@@ -86,16 +213,13 @@ bool string2int(const char* iter, const char* end, int& result)
 
 bool string2int(std::string const& value, int& result)
 {
-    x3::ascii::space_type space;
-    std::string::const_iterator str_beg = value.begin();
-    std::string::const_iterator str_end = value.end();
-    bool r = x3::phrase_parse(str_beg, str_end, INTEGER, space, result);
-    return r && (str_beg == str_end);
+    return string2int(value.data(), value.data() + value.size(), result);
 }
 
 #ifdef BIGINT
 bool string2int(const char* iter, const char* end, mapnik::value_integer& result)
 {
+    if (parse_integer(iter, end, result, std::numeric_limits<mapnik::value_integer>::digits10)) return true;
     x3::ascii::space_type space;
     bool r = x3::phrase_parse(iter, end, x3::long_long, space, result);
     return r && (iter == end);
@@ -103,25 +227,18 @@ bool string2int(const char* iter, const char* end, mapnik::value_integer& result
 
 bool string2int(std::string const& value, mapnik::value_integer& result)
 {
-    x3::ascii::space_type space;
-    std::string::const_iterator str_beg = value.begin();
-    std::string::const_iterator str_end = value.end();
-    bool r = x3::phrase_parse(str_beg, str_end, x3::long_long, space, result);
-    return r && (str_beg == str_end);
+    return string2int(value.data(), value.data() + value.size(), result);
 }
 #endif
 
 bool string2double(std::string const& value, double& result)
 {
-    x3::ascii::space_type space;
-    std::string::const_iterator str_beg = value.begin();
-    std::string::const_iterator str_end = value.end();
-    bool r = x3::phrase_parse(str_beg, str_end, DOUBLE, space, result);
-    return r && (str_beg == str_end);
+    return string2double(value.data(), value.data() + value.size(), result);
 }
 
 bool string2double(const char* iter, const char* end, double& result)
 {
+    if (string2float_fast(iter, end, result)) return true;
     x3::ascii::space_type space;
     bool r = x3::phrase_parse(iter, end, DOUBLE, space, result);
     return r && (iter == end);
@@ -129,15 +246,12 @@ bool string2double(const char* iter, const char* end, double& result)
 
 bool string2float(std::string const& value, float& result)
 {
-    x3::ascii::space_type space;
-    std::string::const_iterator str_beg = value.begin();
-    std::string::const_iterator str_end = value.end();
-    bool r = x3::phrase_parse(str_beg, str_end, FLOAT, space, result);
-    return r && (str_beg == str_end);
+    return string2float(value.data(), value.data() + value.size(), result);
 }
 
 bool string2float(const char* iter, const char* end, float& result)
 {
+    if (string2float_fast(iter, end, result)) return true;
     x3::ascii::space_type space;
     bool r = x3::phrase_parse(iter, end, FLOAT, space, result);
     return r && (iter == end);
@@ -25,17 +25,11 @@
 #include <mapnik/value/types.hpp>
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
-
-// karma is used by default
-#define MAPNIK_KARMA_TO_STRING
-
-#pragma GCC diagnostic push
-#include <mapnik/warning_ignore.hpp>
-#ifdef MAPNIK_KARMA_TO_STRING
-#include <boost/spirit/include/karma.hpp>
-#endif
-#pragma GCC diagnostic pop
+#include <type_traits>
 
 #if _MSC_VER
 #define snprintf _snprintf
@@ -43,120 +37,446 @@
 
 namespace mapnik { namespace util {
 
-using namespace boost::spirit;
+namespace {
 
-// double conversion - here we use sprintf over karma to work
-// around https://github.com/mapnik/mapnik/issues/1741
-bool to_string(std::string& s, double val)
+constexpr char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// writes the digits of value, two at a time, backwards from end
+template <typename T>
+char * write_digits(char * end, T value)
 {
-    s.resize(s.capacity());
-    while (true)
+    while (value >= 100)
+    {
+        unsigned index = static_cast<unsigned>(value % 100) * 2;
+        value /= 100;
+        *--end = digit_pairs[index + 1];
+        *--end = digit_pairs[index];
+    }
+    if (value >= 10)
+    {
+        unsigned index = static_cast<unsigned>(value) * 2;
+        *--end = digit_pairs[index + 1];
+        *--end = digit_pairs[index];
+    }
+    else
+    {
+        *--end = static_cast<char>('0' + value);
+    }
+    return end;
+}
+
+template <typename T>
+bool append_integer(std::string & str, T value)
+{
+    using unsigned_type = typename std::make_unsigned<T>::type;
+    char buffer[24];
+    char * end = buffer + sizeof(buffer);
+    unsigned_type magnitude = static_cast<unsigned_type>(value);
+    bool negative = value < 0;
+    if (negative) magnitude = unsigned_type(0) - magnitude;
+    char * start = write_digits(end, magnitude);
+    if (negative) *--start = '-';
+    str.append(start, end);
+    return true;
+}
+
+#ifdef __SIZEOF_INT128__
+// "%g" for the values it prints in fixed notation, 1e-4 <= |val| < 1e6
+// once rounded to 6 significant digits. The rounding is done on the exact
+// binary value, ties to even as printf does; returns false for the values
+// left to printf (exponent notation, infinities and nan).
+bool format_g_fixed(double val, char * buffer, std::size_t & size)
+{
+    if (!std::isfinite(val)) return false;
+    char * out = buffer;
+    if (std::signbit(val)) *out++ = '-';
+    double abs_val = std::fabs(val);
+    if (abs_val == 0)
+    {
+        *out++ = '0';
+        size = static_cast<std::size_t>(out - buffer);
+        return true;
+    }
+    if (abs_val < 0.99e-4 || abs_val >= 1e6) return false;
+    // abs_val = mantissa / 2^shift exactly, 33 <= shift <= 66 in this range
+    int exp2 = 0;
+    double fraction = std::frexp(abs_val, &exp2);
+    std::uint64_t mantissa = static_cast<std::uint64_t>(std::ldexp(fraction, 53));
+    int shift = 53 - exp2;
+    static const std::uint64_t powers_of_ten[] = { 1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull,
+                                                   1000000ull, 10000000ull, 100000000ull,
+                                                   1000000000ull, 10000000000ull };
+    using uint128 = unsigned __int128;
+    uint128 const mask = (uint128(1) << shift) - 1;
+    // digits after the point, so that 1e5 <= abs_val * 10^decimals < 1e6
+    int decimals = 5 - static_cast<int>(std::floor(std::log10(abs_val)));
+    uint128 product = 0;
+    std::uint64_t digits = 0;
+    for (int pass = 0; pass < 3; ++pass)
+    {
+        if (decimals < 0 || decimals > 10) return false;
+        product = uint128(mantissa) * powers_of_ten[decimals];
+        digits = static_cast<std::uint64_t>(product >> shift);
+        if (digits >= 1000000) --decimals;
+        else if (digits < 100000) ++decimals;
+        else break;
+    }
+    if (digits < 100000 || digits >= 1000000) return false;
+    uint128 remainder = product & mask;
+    uint128 half = uint128(1) << (shift - 1);
+    if (remainder > half || (remainder == half && (digits & 1))) ++digits;
+    if (digits == 1000000)
+    {
+        digits = 100000;
+        --decimals;
+    }
+    if (decimals < 0 || decimals > 9) return false;
+    char text[6];
+    write_digits(text + 6, digits);
+    // trailing zeros of the fraction are dropped, as "%g" does
+    int length = 6;
+    while (length > 6 - decimals && text[length - 1] == '0') --length;
+    int integer_digits = 6 - decimals;
+    if (integer_digits > 0)
     {
-        size_t n2 = static_cast<size_t>(snprintf(&s[0], s.size() + 1, "%g", val));
-        if (n2 <= s.size())
+        std::memcpy(out, text, static_cast<std::size_t>(integer_digits));
+        out += integer_digits;
+        if (length > integer_digits)
         {
-            s.resize(n2);
-            break;
+            *out++ = '.';
+            std::memcpy(out, text + integer_digits, static_cast<std::size_t>(length - integer_digits));
+            out += length - integer_digits;
         }
-        s.resize(n2);
     }
+    else
+    {
+        *out++ = '0';
+        *out++ = '.';
+        for (int i = integer_digits; i < 0; ++i) *out++ = '0';
+        std::memcpy(out, text, static_cast<std::size_t>(length));
+        out += length;
+    }
+    size = static_cast<std::size_t>(out - buffer);
     return true;
 }
+#endif
 
-#ifdef MAPNIK_KARMA_TO_STRING
+// Shortest round trip formatting of doubles: Grisu2 (Florian Loitsch,
+// "Printing floating-point numbers quickly and accurately with integers",
+// PLDI 2010). The digits always read back as the same double and are the
+// shortest such in all but rare cases, where one digit more is written.
+namespace grisu {
 
-bool to_string(std::string& str, int value)
+struct diy_fp
 {
-    namespace karma = boost::spirit::karma;
-    std::back_insert_iterator<std::string> sink(str);
-    return karma::generate(sink, value);
+    std::uint64_t f;
+    int e;
+};
+
+constexpr std::uint64_t hidden_bit = 0x0010000000000000ull;
+constexpr std::uint64_t significand_mask = 0x000FFFFFFFFFFFFFull;
+
+inline diy_fp normalize(diy_fp v)
+{
+    while (!(v.f & 0x8000000000000000ull))
+    {
+        v.f <<= 1;
+        --v.e;
+    }
+    return v;
 }
 
-#ifdef BIGINT
-bool to_string(std::string& str, mapnik::value_integer value)
+// the upper 64 bits of the product, rounded
+inline diy_fp multiply(diy_fp const& x, diy_fp const& y)
 {
-    namespace karma = boost::spirit::karma;
-    std::back_insert_iterator<std::string> sink(str);
-    return karma::generate(sink, value);
+    std::uint64_t const mask = 0xFFFFFFFFull;
+    std::uint64_t a = x.f >> 32, b = x.f & mask;
+    std::uint64_t c = y.f >> 32, d = y.f & mask;
+    std::uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    std::uint64_t tmp = (bd >> 32) + (ad & mask) + (bc & mask);
+    tmp += 1u << 31;
+    return { ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
 }
-#endif
 
-bool to_string(std::string& str, unsigned value)
+// normalized 10^k for k = -348, -340, ..., 340
+inline diy_fp cached_power(int e, int & k)
 {
-    namespace karma = boost::spirit::karma;
-    std::back_insert_iterator<std::string> sink(str);
-    return karma::generate(sink, value);
+    static const std::uint64_t significands[] = {
+        0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull,
+        0xcf42894a5dce35eaull, 0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull,
+        0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full, 0xbe5691ef416bd60cull,
+        0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+        0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull,
+        0xc21094364dfb5637ull, 0x9096ea6f3848984full, 0xd77485cb25823ac7ull,
+        0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull, 0xb23867fb2a35b28eull,
+        0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+        0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull,
+        0xb5b5ada8aaff80b8ull, 0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull,
+        0x964e858c91ba2655ull, 0xdff9772470297ebdull, 0xa6dfbd9fb8e5b88full,
+        0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+        0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull,
+        0xaa242499697392d3ull, 0xfd87b5f28300ca0eull, 0xbce5086492111aebull,
+        0x8cbccc096f5088ccull, 0xd1b71758e219652cull, 0x9c40000000000000ull,
+        0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+        0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull,
+        0x9f4f2726179a2245ull, 0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull,
+        0x83c7088e1aab65dbull, 0xc45d1df942711d9aull, 0x924d692ca61be758ull,
+        0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+        0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull,
+        0x952ab45cfa97a0b3ull, 0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull,
+        0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull, 0x88fcf317f22241e2ull,
+        0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+        0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull,
+        0x8bab8eefb6409c1aull, 0xd01fef10a657842cull, 0x9b10a4e5e9913129ull,
+        0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull, 0x80444b5e7aa7cf85ull,
+        0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+        0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull,    };
+    static const std::int16_t exponents[] = {
+        -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+        -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+        -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+        -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+        -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+        109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+        375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+        641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+        907, 933, 960, 986, 1013, 1039, 1066,
+    };
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int ik = static_cast<int>(dk);
+    if (dk - ik > 0.0) ++ik;
+    unsigned index = static_cast<unsigned>((ik >> 3) + 1);
+    k = -(-348 + static_cast<int>(index) * 8);
+    return { significands[index], exponents[index] };
 }
 
-bool to_string(std::string& str, bool value)
+inline void round_weed(char * buffer, int length, std::uint64_t delta, std::uint64_t rest,
+                       std::uint64_t ten_kappa, std::uint64_t wp_w)
 {
-    namespace karma = boost::spirit::karma;
-    std::back_insert_iterator<std::string> sink(str);
-    return karma::generate(sink, value);
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w))
+    {
+        --buffer[length - 1];
+        rest += ten_kappa;
+    }
 }
 
-#else
+inline int count_digits(std::uint32_t n)
+{
+    int count = 1;
+    while (n >= 10)
+    {
+        n /= 10;
+        ++count;
+    }
+    return count;
+}
 
-bool to_string(std::string& s, int val)
+inline void generate_digits(diy_fp const& w, diy_fp const& mp, std::uint64_t delta,
+                            char * buffer, int & length, int & k)
 {
-    s.resize(s.capacity());
-    while (true)
+    static const std::uint32_t pow10_32[] = { 1, 10, 100, 1000, 10000, 100000, 1000000,
+                                              10000000, 100000000, 1000000000 };
+    diy_fp const one = { std::uint64_t(1) << -mp.e, mp.e };
+    std::uint64_t const wp_w = mp.f - w.f;
+    std::uint32_t p1 = static_cast<std::uint32_t>(mp.f >> -one.e);
+    std::uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = count_digits(p1);
+    length = 0;
+    while (kappa > 0)
     {
-        size_t n2 = static_cast<size_t>(snprintf(&s[0], s.size() + 1, "%d", val));
-        if (n2 <= s.size())
+        std::uint32_t divisor = pow10_32[kappa - 1];
+        std::uint32_t digit = p1 / divisor;
+        p1 %= divisor;
+        if (digit || length) buffer[length++] = static_cast<char>('0' + digit);
+        --kappa;
+        std::uint64_t rest = (static_cast<std::uint64_t>(p1) << -one.e) + p2;
+        if (rest <= delta)
         {
-            s.resize(n2);
-            break;
+            k += kappa;
+            round_weed(buffer, length, delta, rest, static_cast<std::uint64_t>(pow10_32[kappa]) << -one.e, wp_w);
+            return;
+        }
+    }
+    // 10^-kappa, while it fits
+    std::uint64_t unit = 1;
+    for (;;)
+    {
+        p2 *= 10;
+        delta *= 10;
+        unit = (kappa > -19) ? unit * 10 : 0;
+        char digit = static_cast<char>(p2 >> -one.e);
+        if (digit || length) buffer[length++] = static_cast<char>('0' + digit);
+        p2 &= one.f - 1;
+        --kappa;
+        if (p2 < delta)
+        {
+            k += kappa;
+            round_weed(buffer, length, delta, p2, one.f, wp_w * unit);
+            return;
         }
-        s.resize(n2);
     }
-    return true;
 }
 
-#ifdef BIGINT
-bool to_string(std::string& s, mapnik::value_integer val)
+// digits of a finite positive value, which is buffer * 10^k
+inline void shortest_digits(double value, char * buffer, int & length, int & k)
 {
-    s.resize(s.capacity());
-    while (true)
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    int biased_e = static_cast<int>((bits >> 52) & 0x7FF);
+    diy_fp v;
+    if (biased_e != 0) v = { (bits & significand_mask) + hidden_bit, biased_e - 1075 };
+    else v = { bits & significand_mask, 1 - 1075 };
+    // boundaries of the values reading back as v
+    diy_fp plus = normalize({ (v.f << 1) + 1, v.e - 1 });
+    diy_fp minus = (v.f == hidden_bit) ? diy_fp{ (v.f << 2) - 1, v.e - 2 } : diy_fp{ (v.f << 1) - 1, v.e - 1 };
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+    diy_fp c_mk = cached_power(plus.e, k);
+    diy_fp w = multiply(normalize(v), c_mk);
+    diy_fp wp = multiply(plus, c_mk);
+    diy_fp wm = multiply(minus, c_mk);
+    ++wm.f;
+    --wp.f;
+    generate_digits(w, wp, wp.f - wm.f, buffer, length, k);
+}
+
+}
+
+}
+
+// double conversion - formatted as sprintf's "%g" (not karma, see
+// https://github.com/mapnik/mapnik/issues/1741), the string is replaced
+bool to_string(std::string& s, double val)
+{
+    char buffer[32];
+    std::size_t size = 0;
+#ifdef __SIZEOF_INT128__
+    if (format_g_fixed(val, buffer, size))
     {
-        size_t n2 = static_cast<size_t>(snprintf(&s[0], s.size() + 1, "%lld", val));
-        if (n2 <= s.size())
-        {
-            s.resize(n2);
-            break;
-        }
-        s.resize(n2);
+        s.assign(buffer, size);
+        return true;
     }
+#endif
+    int n = snprintf(buffer, sizeof(buffer), "%g", val);
+    if (n < 0) return false;
+    s.assign(buffer, std::min(static_cast<std::size_t>(n), sizeof(buffer) - 1));
     return true;
 }
-#endif
 
-bool to_string(std::string& s, unsigned val)
+std::size_t to_shortest_chars(char * buffer, double value)
 {
-    s.resize(s.capacity());
-    while (true)
+    char * out = buffer;
+    if (std::isnan(value))
+    {
+        std::memcpy(out, "nan", 3);
+        return 3;
+    }
+    if (value < 0)
+    {
+        *out++ = '-';
+        value = -value;
+    }
+    if (std::isinf(value))
+    {
+        std::memcpy(out, "inf", 3);
+        return static_cast<std::size_t>(out + 3 - buffer);
+    }
+    if (value == 0)
+    {
+        buffer[0] = '0';
+        return 1;
+    }
+    char digits[20];
+    int length = 0;
+    int k = 0;
+    grisu::shortest_digits(value, digits, length, k);
+    // the value is 0.digits * 10^point
+    int point = length + k;
+    if (k >= 0 && point <= 21)
+    {
+        std::memcpy(out, digits, static_cast<std::size_t>(length));
+        out += length;
+        for (int i = 0; i < k; ++i) *out++ = '0';
+    }
+    else if (point > 0 && point <= 21)
+    {
+        std::memcpy(out, digits, static_cast<std::size_t>(point));
+        out += point;
+        *out++ = '.';
+        std::memcpy(out, digits + point, static_cast<std::size_t>(length - point));
+        out += length - point;
+    }
+    // fixed down to 1e-6, as conversions.hpp documents
+    else if (point > -6 && point <= 0)
+    {
+        *out++ = '0';
+        *out++ = '.';
+        for (int i = point; i < 0; ++i) *out++ = '0';
+        std::memcpy(out, digits, static_cast<std::size_t>(length));
+        out += length;
+    }
+    else
     {
-        size_t n2 = static_cast<size_t>(snprintf(&s[0], s.size() + 1, "%u", val));
-        if (n2 <= s.size())
+        *out++ = digits[0];
+        if (length > 1)
         {
-            s.resize(n2);
-            break;
+            *out++ = '.';
+            std::memcpy(out, digits + 1, static_cast<std::size_t>(length - 1));
+            out += length - 1;
         }
-        s.resize(n2);
+        *out++ = 'e';
+        int exponent = point - 1;
+        if (exponent < 0)
+        {
+            *out++ = '-';
+            exponent = -exponent;
+        }
+        out = std::copy(write_digits(digits + sizeof(digits), exponent), digits + sizeof(digits), out);
     }
-    return true;
+    return static_cast<std::size_t>(out - buffer);
 }
 
-bool to_string(std::string& s, bool val)
+bool to_shortest_string(std::string & str, double value)
 {
-    if (val)
-        s = "true";
-    else
-        s = "false";
+    char buffer[max_shortest_chars];
+    str.append(buffer, to_shortest_chars(buffer, value));
     return true;
 }
 
+// integers and booleans are appended
+bool to_string(std::string& str, int value)
+{
+    return append_integer(str, value);
+}
+
+#ifdef BIGINT
+bool to_string(std::string& str, mapnik::value_integer value)
+{
+    return append_integer(str, value);
+}
 #endif
 
+bool to_string(std::string& str, unsigned value)
+{
+    return append_integer(str, value);
+}
+
+bool to_string(std::string& str, bool value)
+{
+    str.append(value ? "true" : "false");
+    return true;
+}
+
 } // end namespace util
 }
@@ -37,7 +37,10 @@
 
 // stl
 #include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <map>
+#include <sstream>
 #include <stdexcept>
 
 namespace mapnik {
@@ -47,12 +50,38 @@ template class singleton<datasource_cache, CreateStatic>;
 extern datasource_ptr create_static_datasource(parameters const& params);
 extern std::vector<std::string> get_static_datasource_names();
 
+std::uint64_t next_datasource_id()
+{
+    static std::atomic<std::uint64_t> next(1);
+    return next++;
+}
+
 bool is_input_plugin(std::string const& filename)
 {
     return boost::algorithm::ends_with(filename,std::string(".input"));
 }
 
+namespace {
+
+// every parameter, as plugins read them
+std::string sharing_key(parameters const& params)
+{
+    std::ostringstream s;
+    for (auto const& kv : params)
+    {
+        boost::optional<std::string> value = params.get<std::string>(kv.first);
+        std::string const& str = value ? *value : std::string();
+        s << kv.first.size() << ':' << kv.first << str.size() << ':' << str;
+    }
+    return s.str();
+}
+
+}
+
 datasource_cache::datasource_cache()
+    : lazy_loading_(false),
+      shared_(),
+      sharing_(false)
 {
     PluginInfo::init();
 }
@@ -63,6 +92,65 @@ datasource_cache::~datasource_cache()
 }
 
 datasource_ptr datasource_cache::create(parameters const& params)
+{
+    std::string key;
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(shared_mutex_);
+#endif
+        if (!sharing_) return create_instance(params);
+        key = sharing_key(params);
+        auto itr = shared_.find(key);
+        if (itr != shared_.end())
+        {
+            if (datasource_ptr ds = itr->second.lock()) return ds;
+        }
+    }
+    // made unlocked so that different sources open concurrently, if
+    // another thread made one for the same parameters meanwhile that
+    // one is kept
+    datasource_ptr ds = create_instance(params);
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(shared_mutex_);
+#endif
+    for (auto itr = shared_.begin(); itr != shared_.end();)
+    {
+        if (itr->second.expired()) itr = shared_.erase(itr);
+        else ++itr;
+    }
+    std::weak_ptr<datasource> & entry = shared_[key];
+    if (datasource_ptr other = entry.lock()) return other;
+    entry = ds;
+    return ds;
+}
+
+void datasource_cache::set_sharing(bool share)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(shared_mutex_);
+#endif
+    sharing_ = share;
+    if (!sharing_) shared_.clear();
+}
+
+bool datasource_cache::sharing()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(shared_mutex_);
+#endif
+    return sharing_;
+}
+
+std::size_t datasource_cache::shared_count()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(shared_mutex_);
+#endif
+    return std::count_if(shared_.begin(), shared_.end(),
+                         [](auto const& item) { return !item.second.expired(); });
+}
+
+datasource_ptr datasource_cache::create_instance(parameters const& params)
 {
     boost::optional<std::string> type = params.get<std::string>("type");
     if (!type)
@@ -89,6 +177,10 @@ datasource_ptr datasource_cache::create(parameters const& params)
         std::lock_guard<std::recursive_mutex> lock(instance_mutex_);
 #endif
         itr = plugins_.find(*type);
+        if (itr == plugins_.end() && load_lazy_datasource(*type))
+        {
+            itr = plugins_.find(*type);
+        }
         if (itr == plugins_.end())
         {
             std::string s("Could not create datasource for type: '");
@@ -153,6 +245,10 @@ std::vector<std::string> datasource_cache::plugin_names()
     {
         names.push_back(itr->first);
     }
+    for (auto const& lazy : lazy_plugins_)
+    {
+        names.push_back(lazy.first);
+    }
 
     return names;
 }
@@ -219,6 +315,11 @@ bool datasource_cache::register_datasource(std::string const& filename)
                     << filename << "' (plugin does not exist)";
             return false;
         }
+        if (lazy_loading_ && is_input_plugin(filename))
+        {
+            std::string base_name = mapnik::util::basename(filename);
+            return register_lazy_datasource(base_name.substr(0, base_name.size() - 6), filename);
+        }
         std::shared_ptr<PluginInfo> plugin = std::make_shared<PluginInfo>(filename,"datasource_name");
         if (plugin->valid())
         {
@@ -255,4 +356,94 @@ bool datasource_cache::register_datasource(std::string const& filename)
     return false;
 }
 
+void datasource_cache::set_lazy_loading(bool lazy)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::recursive_mutex> lock(instance_mutex_);
+#endif
+    lazy_loading_ = lazy;
+}
+
+bool datasource_cache::lazy_loading()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::recursive_mutex> lock(instance_mutex_);
+#endif
+    return lazy_loading_;
+}
+
+bool datasource_cache::register_datasource_manifest(std::string const& manifest)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::recursive_mutex> lock(instance_mutex_);
+#endif
+    std::ifstream file(manifest);
+    if (!file)
+    {
+        MAPNIK_LOG_ERROR(datasource_cache)
+                << "Cannot read plugin manifest '" << manifest << "'";
+        return false;
+    }
+    bool success = false;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string first, second;
+        fields >> first >> second;
+        if (first.empty() || first[0] == '#') continue;
+        std::string name = first;
+        std::string path = second;
+        if (path.empty())
+        {
+            path = first;
+            name = mapnik::util::basename(first);
+            if (is_input_plugin(name)) name.erase(name.size() - 6);
+        }
+        if (path.front() != '/') path = mapnik::util::make_relative(path, manifest);
+        if (register_lazy_datasource(name, path))
+        {
+            success = true;
+        }
+    }
+    plugin_directories_.insert(manifest);
+    return success;
+}
+
+bool datasource_cache::register_lazy_datasource(std::string const& name, std::string const& path)
+{
+    if (name.empty() || plugins_.find(name) != plugins_.end())
+    {
+        return false;
+    }
+    if (lazy_plugins_.emplace(name, path).second)
+    {
+        MAPNIK_LOG_DEBUG(datasource_cache)
+                << "datasource_cache: Registered lazily="
+                << name;
+        return true;
+    }
+    return false;
+}
+
+// called with instance_mutex_ held
+bool datasource_cache::load_lazy_datasource(std::string const& name)
+{
+    auto itr = lazy_plugins_.find(name);
+    if (itr == lazy_plugins_.end()) return false;
+    std::string filename = itr->second;
+    lazy_plugins_.erase(itr);
+    bool lazy = lazy_loading_;
+    lazy_loading_ = false;
+    bool loaded = register_datasource(filename);
+    lazy_loading_ = lazy;
+    if (loaded && plugins_.find(name) == plugins_.end())
+    {
+        MAPNIK_LOG_ERROR(datasource_cache)
+                << "Plugin library '" << filename
+                << "' does not provide the '" << name << "' datasource";
+    }
+    return loaded;
+}
+
 }
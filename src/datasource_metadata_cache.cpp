@@ -0,0 +1,276 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/datasource_metadata_cache.hpp>
+#include <mapnik/debug.hpp>
+
+// stl
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace mapnik
+{
+
+template class singleton<datasource_metadata_cache, CreateStatic>;
+
+namespace {
+
+const char * metadata_file_magic = "mapnik-datasource-metadata-1";
+
+// strings are written with their length in front, so they may hold
+// any bytes
+void write_string(std::ostream & os, std::string const& str)
+{
+    os << str.size() << ' ' << str << '\n';
+}
+
+bool read_string(std::istream & is, std::string & str)
+{
+    std::size_t size = 0;
+    if (!(is >> size) || is.get() != ' ') return false;
+    str.resize(size);
+    if (size > 0) is.read(&str[0], size);
+    return static_cast<bool>(is);
+}
+
+void write_metadata(std::ostream & os, datasource_metadata const& metadata)
+{
+    write_string(os, metadata.stamp);
+    write_string(os, metadata.encoding);
+    os << metadata.descriptors.size() << '\n';
+    for (attribute_descriptor const& desc : metadata.descriptors)
+    {
+        write_string(os, desc.get_name());
+        os << desc.get_type() << ' ' << desc.get_size() << ' '
+           << desc.get_precision() << ' ' << desc.is_primary_key() << '\n';
+    }
+    if (metadata.extent)
+    {
+        box2d<double> const& ext = *metadata.extent;
+        os << "1 " << ext.minx() << ' ' << ext.miny() << ' '
+           << ext.maxx() << ' ' << ext.maxy() << '\n';
+    }
+    else
+    {
+        os << "0\n";
+    }
+    os << (metadata.geometry_type ? static_cast<int>(*metadata.geometry_type) : -1) << '\n';
+    os << metadata.extra.size() << '\n';
+    for (auto const& kv : metadata.extra)
+    {
+        write_string(os, kv.first);
+        write_string(os, kv.second);
+    }
+}
+
+bool read_metadata(std::istream & is, datasource_metadata & metadata)
+{
+    std::size_t count = 0;
+    if (!read_string(is, metadata.stamp) ||
+        !read_string(is, metadata.encoding) ||
+        !(is >> count)) return false;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::string name;
+        unsigned type = 0;
+        int size = -1, precision = -1;
+        bool primary_key = false;
+        if (!read_string(is, name) || !(is >> type >> size >> precision >> primary_key)) return false;
+        metadata.descriptors.emplace_back(name, type, primary_key, size, precision);
+    }
+    int has_extent = 0;
+    if (!(is >> has_extent)) return false;
+    if (has_extent)
+    {
+        double minx, miny, maxx, maxy;
+        if (!(is >> minx >> miny >> maxx >> maxy)) return false;
+        metadata.extent = box2d<double>(minx, miny, maxx, maxy);
+    }
+    int geometry_type = -1;
+    if (!(is >> geometry_type >> count)) return false;
+    if (geometry_type >= 0)
+    {
+        metadata.geometry_type = static_cast<datasource_geometry_t>(geometry_type);
+    }
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::string key, value;
+        if (!read_string(is, key) || !read_string(is, value)) return false;
+        metadata.extra.emplace(std::move(key), std::move(value));
+    }
+    return true;
+}
+
+}
+
+datasource_metadata_cache::datasource_metadata_cache()
+    : entries_(),
+      enabled_(false) {}
+
+void datasource_metadata_cache::set_enabled(bool enabled)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    enabled_ = enabled;
+}
+
+bool datasource_metadata_cache::enabled() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return enabled_;
+}
+
+std::string datasource_metadata_cache::make_key(parameters const& params)
+{
+    std::ostringstream s;
+    for (auto const& kv : params)
+    {
+        if (kv.first == "password") continue;
+        boost::optional<std::string> value = params.get<std::string>(kv.first);
+        write_string(s, kv.first);
+        write_string(s, value ? *value : std::string());
+    }
+    return s.str();
+}
+
+boost::optional<datasource_metadata> datasource_metadata_cache::find(std::string const& key,
+                                                                     std::string const& stamp) const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    if (!enabled_) return boost::none;
+    auto itr = entries_.find(key);
+    if (itr == entries_.end() || itr->second.stamp != stamp) return boost::none;
+    return itr->second;
+}
+
+void datasource_metadata_cache::insert(std::string const& key, datasource_metadata const& metadata)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    if (enabled_) entries_[key] = metadata;
+}
+
+void datasource_metadata_cache::erase(std::string const& key)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    entries_.erase(key);
+}
+
+std::size_t datasource_metadata_cache::size() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return entries_.size();
+}
+
+void datasource_metadata_cache::clear()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    entries_.clear();
+}
+
+bool datasource_metadata_cache::load(std::string const& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) return false;
+    std::string magic;
+    std::getline(file, magic);
+    std::size_t count = 0;
+    if (magic != metadata_file_magic || !(file >> count)) return false;
+    std::map<std::string, datasource_metadata> entries;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::string key;
+        datasource_metadata metadata;
+        if (!read_string(file, key) || !read_metadata(file, metadata))
+        {
+            MAPNIK_LOG_ERROR(datasource_metadata_cache) << "datasource_metadata_cache: corrupt file " << filename;
+            return false;
+        }
+        entries[std::move(key)] = std::move(metadata);
+    }
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    for (auto & kv : entries)
+    {
+        entries_[kv.first] = std::move(kv.second);
+    }
+    return true;
+}
+
+bool datasource_metadata_cache::save(std::string const& filename) const
+{
+    std::ostringstream s;
+    s.precision(std::numeric_limits<double>::max_digits10);
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        s << metadata_file_magic << '\n' << entries_.size() << '\n';
+        for (auto const& kv : entries_)
+        {
+            write_string(s, kv.first);
+            write_metadata(s, kv.second);
+        }
+    }
+    // written aside and renamed so other processes never read a partial file
+    std::ostringstream tmp;
+    tmp << filename << ".tmp" << std::hex << std::chrono::steady_clock::now().time_since_epoch().count()
+        << reinterpret_cast<std::uintptr_t>(this);
+    std::string tmp_name = tmp.str();
+    {
+        std::ofstream file(tmp_name, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+        file << s.str();
+        if (!file)
+        {
+            std::remove(tmp_name.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp_name.c_str(), filename.c_str()) != 0)
+    {
+        std::remove(tmp_name.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
@@ -51,12 +51,14 @@ std::mutex logger::format_mutex_;
 
 std::atomic<bool> logger::severity_env_check_ {true};
 std::atomic<bool> logger::format_env_check_ {true};
+std::atomic<bool> logger::has_object_severity_ {false};
 
 std::atomic<logger::severity_type> logger::severity_level_ {
 #else
 
 bool logger::severity_env_check_ {true};
 bool logger::format_env_check_ {true};
+bool logger::has_object_severity_ {false};
 
 logger::severity_type logger::severity_level_ {
 #endif
@@ -74,6 +76,7 @@ logger::severity_type logger::severity_level_ {
 };
 
 logger::severity_map logger::object_severity_level_ = logger::severity_map();
+std::atomic<unsigned> logger::generation_ {0};
 
 std::string logger::format_ = MAPNIK_STRINGIFY(MAPNIK_LOG_FORMAT);
 
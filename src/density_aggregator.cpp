@@ -0,0 +1,98 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/density_aggregator.hpp>
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry/centroid.hpp>
+#include <mapnik/raster.hpp>
+
+// stl
+#include <cmath>
+#include <memory>
+#include <utility>
+
+namespace mapnik
+{
+
+density_aggregator::density_aggregator(box2d<double> const& extent, unsigned width, unsigned height,
+                                       std::string const& weight)
+    : extent_(extent),
+      scale_x_(extent.width() > 0.0 ? width / extent.width() : 0.0),
+      scale_y_(extent.height() > 0.0 ? height / extent.height() : 0.0),
+      weight_(weight),
+      grid_(width, height)
+{
+}
+
+void density_aggregator::add(feature_impl const& feature)
+{
+    float weight = 1.0f;
+    if (!weight_.empty())
+    {
+        weight = static_cast<float>(feature.get(weight_).to_double());
+        if (weight == 0.0f) return;
+    }
+    geometry::geometry<double> const& geom = feature.get_geometry();
+    if (geom.is<geometry::point<double>>())
+    {
+        auto const& pt = geom.get<geometry::point<double>>();
+        add(pt.x, pt.y, weight);
+        return;
+    }
+    if (geom.is<geometry::multi_point<double>>())
+    {
+        for (auto const& pt : geom.get<geometry::multi_point<double>>())
+        {
+            add(pt.x, pt.y, weight);
+        }
+        return;
+    }
+    geometry::point<double> pt;
+    if (geometry::centroid(geom, pt))
+    {
+        add(pt.x, pt.y, weight);
+    }
+}
+
+void density_aggregator::add(double x, double y, float weight)
+{
+    double cx = std::floor((x - extent_.minx()) * scale_x_);
+    double cy = std::floor((extent_.maxy() - y) * scale_y_);
+    if (cx >= 0.0 && cx < grid_.width() && cy >= 0.0 && cy < grid_.height())
+    {
+        grid_(static_cast<std::size_t>(cx), static_cast<std::size_t>(cy)) += weight;
+    }
+}
+
+feature_ptr density_aggregator::release()
+{
+    feature_ptr feature = std::make_shared<feature_impl>(std::make_shared<context_type>(), 1);
+    auto grid = std::make_shared<raster>(extent_, std::move(grid_), 1.0);
+    grid->set_nodata(0.0);
+    feature->set_raster(grid);
+    grid_ = image_gray32f();
+    return feature;
+}
+
+}
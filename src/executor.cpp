@@ -0,0 +1,381 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/executor.hpp>
+#include <mapnik/numa.hpp>
+#include <mapnik/debug.hpp>
+
+// stl
+#include <algorithm>
+
+namespace mapnik
+{
+
+namespace {
+
+// the pool and queue of the worker running on this thread, if any
+thread_local thread_pool_executor const* current_pool = nullptr;
+thread_local std::size_t current_queue = 0;
+
+std::mutex executor_mutex;
+std::shared_ptr<executor> installed_executor;
+std::shared_ptr<executor> installed_io_executor;
+
+std::shared_ptr<executor> const& builtin_executor()
+{
+#ifdef MAPNIK_THREADSAFE
+    unsigned cores = std::thread::hardware_concurrency();
+    std::size_t threads = cores > 1 ? cores - 1 : 1;
+#else
+    std::size_t threads = 0;
+#endif
+    static std::shared_ptr<executor> pool = std::make_shared<thread_pool_executor>(threads);
+    return pool;
+}
+
+std::shared_ptr<executor> const& builtin_io_executor()
+{
+#ifdef MAPNIK_THREADSAFE
+    // threads mostly wait on sockets and disks, so more than there are cores
+    unsigned cores = std::thread::hardware_concurrency();
+    std::size_t threads = std::max(cores, 4u);
+#else
+    std::size_t threads = 0;
+#endif
+    static std::shared_ptr<executor> pool = std::make_shared<thread_pool_executor>(threads);
+    return pool;
+}
+
+}
+
+executor::~executor() {}
+
+thread_pool_executor::thread_pool_executor(std::size_t threads)
+    : queues_(),
+      nodes_(numa::node_count()),
+      next_(0),
+      mutex_(),
+      cond_(),
+      queued_(0),
+      stop_(false)
+#ifdef MAPNIK_THREADSAFE
+     ,threads_()
+#endif
+{
+#ifdef MAPNIK_THREADSAFE
+    for (std::size_t i = 0; i < threads; ++i)
+    {
+        queues_.emplace_back(new queue());
+    }
+    try
+    {
+        while (threads_.size() < threads)
+        {
+            threads_.emplace_back(&thread_pool_executor::worker, this, threads_.size());
+        }
+    }
+    catch (std::exception const&)
+    {
+        // could not spawn more threads, the queues left are stolen from
+    }
+#else
+    (void)threads;
+#endif
+}
+
+thread_pool_executor::~thread_pool_executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+#ifdef MAPNIK_THREADSAFE
+    // workers run what is queued before they leave
+    for (auto & t : threads_) t.join();
+#endif
+}
+
+void thread_pool_executor::post(task_type task)
+{
+#ifdef MAPNIK_THREADSAFE
+    if (!threads_.empty())
+    {
+        std::size_t index = current_pool == this ? current_queue : next_++ % threads_.size();
+        if (current_pool != this && nodes_ > 1)
+        {
+            // a worker of this node, if it has any
+            std::size_t node = numa::current_node() % nodes_;
+            std::size_t workers = (threads_.size() + nodes_ - 1 - node) / nodes_;
+            if (workers > 0) index = node + nodes_ * (index % workers);
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+            queues_[index]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++queued_;
+        }
+        cond_.notify_one();
+        return;
+    }
+#endif
+    task();
+}
+
+std::size_t thread_pool_executor::concurrency() const
+{
+#ifdef MAPNIK_THREADSAFE
+    return threads_.size();
+#else
+    return 0;
+#endif
+}
+
+bool thread_pool_executor::pop(std::size_t index, task_type & task)
+{
+    {
+        queue & own = *queues_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    return steal(index, true, task) || (nodes_ > 1 && steal(index, false, task));
+}
+
+bool thread_pool_executor::steal(std::size_t index, bool same_node, task_type & task)
+{
+    for (std::size_t k = 1; k < queues_.size(); ++k)
+    {
+        std::size_t other_index = (index + k) % queues_.size();
+        if ((other_index % nodes_ == index % nodes_) != same_node) continue;
+        queue & other = *queues_[other_index];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty())
+        {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void thread_pool_executor::worker(std::size_t index)
+{
+    current_pool = this;
+    current_queue = index;
+    if (nodes_ > 1) numa::bind_thread(index % nodes_);
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return queued_ > 0 || stop_; });
+            if (queued_ == 0) return;
+            // a task is pushed before it is counted, so one is there to pop
+            --queued_;
+        }
+        task_type task;
+        while (!pop(index, task)) {}
+        try
+        {
+            task();
+        }
+        catch (std::exception const& ex)
+        {
+            MAPNIK_LOG_ERROR(executor) << "executor: task threw: " << ex.what();
+        }
+        catch (...)
+        {
+            MAPNIK_LOG_ERROR(executor) << "executor: task threw";
+        }
+    }
+}
+
+std::shared_ptr<executor> get_executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(executor_mutex);
+        if (installed_executor) return installed_executor;
+    }
+    return builtin_executor();
+}
+
+void set_executor(std::shared_ptr<executor> ex)
+{
+    std::lock_guard<std::mutex> lock(executor_mutex);
+    installed_executor = std::move(ex);
+}
+
+std::shared_ptr<executor> get_io_executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(executor_mutex);
+        if (installed_io_executor) return installed_io_executor;
+    }
+    return builtin_io_executor();
+}
+
+void set_io_executor(std::shared_ptr<executor> ex)
+{
+    std::lock_guard<std::mutex> lock(executor_mutex);
+    installed_io_executor = std::move(ex);
+}
+
+struct task_group::item
+{
+    executor::task_type task;
+    std::atomic<bool> claimed{false};
+};
+
+struct task_group::state
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::size_t pending = 0;
+    std::exception_ptr error;
+
+    void execute(item & it)
+    {
+        std::exception_ptr err;
+        try
+        {
+            it.task();
+        }
+        catch (...)
+        {
+            err = std::current_exception();
+        }
+        it.task = nullptr;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (err && !error) error = err;
+        if (--pending == 0) cond.notify_all();
+    }
+};
+
+task_group::task_group()
+    : task_group(get_executor()) {}
+
+task_group::task_group(std::shared_ptr<executor> ex)
+    : executor_(std::move(ex)),
+      state_(std::make_shared<state>()),
+      items_() {}
+
+task_group::~task_group()
+{
+    try
+    {
+        wait();
+    }
+    catch (...)
+    {
+        // the owner is unwinding or did not care
+    }
+}
+
+void task_group::run(executor::task_type task)
+{
+    auto it = std::make_shared<item>();
+    it->task = std::move(task);
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        ++state_->pending;
+    }
+    items_.push_back(it);
+    std::shared_ptr<state> st = state_;
+    // whoever claims the item first runs it, a late worker finds it taken
+    executor_->post([st, it] {
+        if (!it->claimed.exchange(true)) st->execute(*it);
+    });
+}
+
+void task_group::wait()
+{
+    for (auto const& it : items_)
+    {
+        if (!it->claimed.exchange(true)) state_->execute(*it);
+    }
+    items_.clear();
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->cond.wait(lock, [this] { return state_->pending == 0; });
+        std::swap(error, state_->error);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void parallel_for(std::size_t count, std::size_t threads,
+                  std::function<void(std::size_t)> const& func)
+{
+    std::shared_ptr<executor> ex = get_executor();
+    std::size_t num_threads = std::min({threads, count, ex->concurrency() + 1});
+    if (num_threads <= 1)
+    {
+        for (std::size_t i = 0; i < count; ++i) func(i);
+        return;
+    }
+    std::atomic<std::size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto work = [&] {
+        std::size_t i;
+        while (!failed && (i = next++) < count)
+        {
+            try
+            {
+                func(i);
+            }
+            catch (...)
+            {
+                failed = true;
+                throw;
+            }
+        }
+    };
+    task_group group(ex);
+    for (std::size_t t = 1; t < num_threads; ++t)
+    {
+        group.run(work);
+    }
+    // if this throws the group still waits for the others on the way out
+    work();
+    group.wait();
+}
+
+void parallel_bands(std::size_t height, std::size_t bands,
+                    std::function<void(std::size_t, std::size_t)> const& func)
+{
+    bands = std::max(std::size_t(1), std::min(bands, height));
+    std::size_t band = (height + bands - 1) / bands;
+    parallel_for(bands, bands, [&](std::size_t i) {
+        std::size_t y0 = std::min(i * band, height);
+        func(y0, std::min(y0 + band, height));
+    });
+}
+
+}
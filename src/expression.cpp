@@ -26,11 +26,14 @@
 #include <mapnik/unicode.hpp>
 #include <mapnik/expression_node_types.hpp>
 #include <mapnik/expression_grammar_x3.hpp>
+#include <mapnik/parse_cache.hpp>
 
 namespace mapnik
 {
 
-expression_ptr parse_expression(std::string const& str)
+namespace {
+
+expression_ptr parse_expression_impl(std::string const& str)
 {
     auto node = std::make_shared<expr_node>();
     using boost::spirit::x3::ascii::space;
@@ -68,5 +71,18 @@ expression_ptr parse_expression(std::string const& str)
     }
 }
 
+}
+
+expression_ptr parse_expression(std::string const& str)
+{
+    parse_cache & cache = parse_cache::instance();
+    expression_ptr expr = cache.find_expression(str);
+    if (!expr)
+    {
+        expr = parse_expression_impl(str);
+        cache.insert_expression(str, expr);
+    }
+    return expr;
+}
 
 }
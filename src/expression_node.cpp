@@ -25,6 +25,11 @@
 #include <mapnik/util/noncopyable.hpp>
 #include <mapnik/safe_cast.hpp>
 
+// stl
+#include <cctype>
+#include <cstring>
+#include <string>
+
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
 #if defined(BOOST_REGEX_HAS_ICU)
@@ -45,32 +50,140 @@ static void fromUTF32toUTF8(std::basic_string<UChar32> const& src, std::string &
 }
 #endif
 
+namespace {
+
+// Patterns evaluated without running the regex engine
+enum class literal_kind
+{
+    none,
+    equals,
+    prefix,
+    suffix,
+    contains
+};
+
+// Appends the literal of pattern[begin, end) to text, false when it holds
+// anything else than plain characters and escaped punctuation.
+bool append_literal(std::string const& pattern, std::size_t begin, std::size_t end, std::string & text)
+{
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        char c = pattern[i];
+        if (c == '\\')
+        {
+            // \d, \w, \b, \n ... are classes, assertions or escapes
+            if (++i == end) return false;
+            unsigned char escaped = static_cast<unsigned char>(pattern[i]);
+            if (escaped >= 0x80 || std::isalnum(escaped)) return false;
+            text += pattern[i];
+        }
+        else if (std::strchr("^$.|?*+()[]{}", c) != nullptr)
+        {
+            return false;
+        }
+        else
+        {
+            text += c;
+        }
+    }
+    return true;
+}
+
+// How a .match() pattern reduces to a comparison with text
+literal_kind match_literal(std::string const& pattern, std::string & text)
+{
+    std::size_t begin = 0;
+    std::size_t end = pattern.size();
+    // the match is anchored at both ends anyway
+    if (begin < end && pattern[begin] == '^') ++begin;
+    if (end > begin && pattern[end - 1] == '$' && (end < 2 || pattern[end - 2] != '\\')) --end;
+    bool any_before = end - begin >= 2 && pattern.compare(begin, 2, ".*") == 0;
+    if (any_before) begin += 2;
+    bool any_after = end - begin >= 2 && pattern.compare(end - 2, 2, ".*") == 0 &&
+        (end - begin < 3 || pattern[end - 3] != '\\');
+    if (any_after) end -= 2;
+    text.clear();
+    if (!append_literal(pattern, begin, end, text)) return literal_kind::none;
+    if (any_before && any_after) return literal_kind::contains;
+    if (any_before) return literal_kind::suffix;
+    if (any_after) return literal_kind::prefix;
+    return literal_kind::equals;
+}
+
+// Whether a .replace() pattern and format are a plain search and replace
+bool replace_literal(std::string const& pattern, std::string const& format, std::string & text)
+{
+    text.clear();
+    return !pattern.empty() &&
+        append_literal(pattern, 0, pattern.size(), text) &&
+        format.find_first_of("$\\") == std::string::npos;
+}
+
+#if !defined(BOOST_REGEX_HAS_ICU)
+void replace_all(std::string & str, std::string const& from, std::string const& to)
+{
+    std::string result;
+    std::size_t pos = 0;
+    for (std::size_t found; (found = str.find(from, pos)) != std::string::npos; pos = found + from.size())
+    {
+        result.append(str, pos, found - pos);
+        result += to;
+    }
+    if (pos == 0) return;
+    result.append(str, pos, std::string::npos);
+    str.swap(result);
+}
+#endif
+
+}
+
 struct _regex_match_impl : util::noncopyable {
 #if defined(BOOST_REGEX_HAS_ICU)
-    _regex_match_impl(value_unicode_string const& ustr) :
-        pattern_(boost::make_u32regex(ustr)) {}
+    _regex_match_impl(transcoder const& tr, std::string const& ustr) :
+        pattern_(boost::make_u32regex(tr.transcode(ustr.c_str()))),
+        kind_(literal_kind::none)
+    {
+        std::string text;
+        kind_ = match_literal(ustr, text);
+        if (kind_ != literal_kind::none) literal_ = tr.transcode(text.c_str());
+    }
     boost::u32regex pattern_;
+    value_unicode_string literal_;
 #else
-    _regex_match_impl(std::string const& ustr) :
-        pattern_(ustr) {}
+    _regex_match_impl(transcoder const&, std::string const& ustr) :
+        pattern_(ustr),
+        kind_(match_literal(ustr, literal_)) {}
     boost::regex pattern_;
+    std::string literal_;
 #endif
+    literal_kind kind_;
 };
 
 struct _regex_replace_impl : util::noncopyable {
 #if defined(BOOST_REGEX_HAS_ICU)
-    _regex_replace_impl(value_unicode_string const& ustr, value_unicode_string const& f) :
-        pattern_(boost::make_u32regex(ustr)),
-        format_(f) {}
+    _regex_replace_impl(transcoder const& tr, std::string const& ustr, std::string const& f) :
+        pattern_(boost::make_u32regex(tr.transcode(ustr.c_str()))),
+        format_(tr.transcode(f.c_str())),
+        literal_(false)
+    {
+        std::string text;
+        literal_ = replace_literal(ustr, f, text);
+        if (literal_) search_ = tr.transcode(text.c_str());
+    }
     boost::u32regex pattern_;
     value_unicode_string format_;
+    value_unicode_string search_;
 #else
-    _regex_replace_impl(std::string const& ustr,std::string const& f) :
+    _regex_replace_impl(transcoder const&, std::string const& ustr, std::string const& f) :
         pattern_(ustr),
-        format_(f) {}
+        format_(f),
+        literal_(replace_literal(ustr, f, search_)) {}
     boost::regex pattern_;
     std::string format_;
+    std::string search_;
 #endif
+    // the pattern is search_ and the format is plain text
+    bool literal_;
 };
 
 
@@ -78,21 +191,50 @@ regex_match_node::regex_match_node(transcoder const& tr,
                                    expr_node const& a,
                                    std::string const& ustr)
     : expr(a),
-      impl_(new _regex_match_impl(
-#if defined(BOOST_REGEX_HAS_ICU)
-        tr.transcode(ustr.c_str())
-#else
-        ustr
-#endif
-        )) {}
+      impl_(new _regex_match_impl(tr, ustr)) {}
 
 value regex_match_node::apply(value const& v) const
 {
-    auto const& pattern = impl_.get()->pattern_;
+    _regex_match_impl const& impl = *impl_;
 #if defined(BOOST_REGEX_HAS_ICU)
-    return boost::u32regex_match(v.to_unicode(),pattern);
+    // strings are matched in place, other values converted
+    value_unicode_string converted;
+    value_unicode_string const* str = &converted;
+    if (v.is<value_unicode_string>()) str = &v.get<value_unicode_string>();
+    else converted = v.to_unicode();
+    value_unicode_string const& literal = impl.literal_;
+    switch (impl.kind_)
+    {
+    case literal_kind::equals:
+        return *str == literal;
+    case literal_kind::prefix:
+        return str->startsWith(literal) != 0;
+    case literal_kind::suffix:
+        return str->endsWith(literal) != 0;
+    case literal_kind::contains:
+        return str->indexOf(literal) >= 0;
+    case literal_kind::none:
+        break;
+    }
+    return boost::u32regex_match(*str, impl.pattern_);
 #else
-    return boost::regex_match(v.to_string(),pattern);
+    std::string str = v.to_string();
+    std::string const& literal = impl.literal_;
+    switch (impl.kind_)
+    {
+    case literal_kind::equals:
+        return str == literal;
+    case literal_kind::prefix:
+        return str.compare(0, literal.size(), literal) == 0;
+    case literal_kind::suffix:
+        return str.size() >= literal.size() &&
+            str.compare(str.size() - literal.size(), literal.size(), literal) == 0;
+    case literal_kind::contains:
+        return str.find(literal) != std::string::npos;
+    case literal_kind::none:
+        break;
+    }
+    return boost::regex_match(str, impl.pattern_);
 #endif
 }
 
@@ -115,26 +257,28 @@ regex_replace_node::regex_replace_node(transcoder const& tr,
                                        std::string const& ustr,
                                        std::string const& f)
     : expr(a),
-      impl_(new _regex_replace_impl(
-#if defined(BOOST_REGEX_HAS_ICU)
-                     tr.transcode(ustr.c_str()),
-                     tr.transcode(f.c_str())
-#else
-                     ustr,
-                     f
-#endif
-                     )) {}
+      impl_(new _regex_replace_impl(tr, ustr, f)) {}
 
 value regex_replace_node::apply(value const& v) const
 {
-    auto const& pattern = impl_.get()->pattern_;
-    auto const& format = impl_.get()->format_;
+    _regex_replace_impl const& impl = *impl_;
 #if defined(BOOST_REGEX_HAS_ICU)
-    return boost::u32regex_replace(v.to_unicode(), pattern, format);
+    if (impl.literal_)
+    {
+        value_unicode_string str = v.to_unicode();
+        str.findAndReplace(impl.search_, impl.format_);
+        return str;
+    }
+    if (v.is<value_unicode_string>())
+    {
+        return boost::u32regex_replace(v.get<value_unicode_string>(), impl.pattern_, impl.format_);
+    }
+    return boost::u32regex_replace(v.to_unicode(), impl.pattern_, impl.format_);
 #else
-    std::string repl = boost::regex_replace(v.to_string(), pattern, format);
-    transcoder tr_("utf8");
-    return tr_.transcode(repl.c_str());
+    std::string repl = v.to_string();
+    if (impl.literal_) replace_all(repl, impl.search_, impl.format_);
+    else repl = boost::regex_replace(repl, impl.pattern_, impl.format_);
+    return value_unicode_string::fromUTF8(repl);
 #endif
 }
 
@@ -0,0 +1,111 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/feature_arena.hpp>
+
+// stl
+#include <algorithm>
+#ifdef MAPNIK_THREADSAFE
+#include <atomic>
+#endif
+
+namespace mapnik {
+
+namespace {
+
+// every allocation is preceded by a pointer to its block, rounded up so
+// the returned memory stays maximally aligned
+const std::size_t alignment = alignof(std::max_align_t);
+const std::size_t header_size = (sizeof(void*) + alignment - 1) / alignment * alignment;
+
+inline std::size_t align_up(std::size_t size)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+}
+
+struct feature_arena::block
+{
+    // allocations not yet released
+#ifdef MAPNIK_THREADSAFE
+    std::atomic<std::size_t> live;
+#else
+    std::size_t live;
+#endif
+    std::unique_ptr<char[]> data;
+};
+
+feature_arena::feature_arena()
+    : blocks_(),
+      retired_(),
+      current_(nullptr),
+      offset_(block_size) {}
+
+feature_arena::~feature_arena() {}
+
+feature_arena::block * feature_arena::new_block()
+{
+    // any released block will do, one feature kept alive by a consumer
+    // must not keep the blocks retired after it from being reused
+    auto itr = std::find_if(retired_.begin(), retired_.end(),
+                            [](block const* b) { return b->live == 0; });
+    if (itr != retired_.end())
+    {
+        block * b = *itr;
+        retired_.erase(itr);
+        return b;
+    }
+    std::unique_ptr<block> b(new block);
+    b->live = 0;
+    b->data.reset(new char[block_size]);
+    blocks_.push_back(std::move(b));
+    return blocks_.back().get();
+}
+
+void * feature_arena::allocate(std::size_t size)
+{
+    std::size_t needed = header_size + align_up(size);
+    if (offset_ + needed > block_size)
+    {
+        if (current_)
+        {
+            retired_.push_back(current_);
+        }
+        current_ = new_block();
+        offset_ = 0;
+    }
+    char * p = current_->data.get() + offset_;
+    offset_ += needed;
+    ++current_->live;
+    *reinterpret_cast<block**>(p) = current_;
+    return p + header_size;
+}
+
+void feature_arena::deallocate(void * p)
+{
+    block * b = *reinterpret_cast<block**>(static_cast<char*>(p) - header_size);
+    --b->live;
+}
+
+}
@@ -0,0 +1,197 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/feature_cache.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/expression_string.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+
+namespace mapnik
+{
+
+template class singleton<feature_cache, CreateStatic>;
+
+feature_cache::feature_cache()
+    : entries_(),
+      lru_(),
+      max_features_(0),
+      num_features_(0),
+      ttl_(0) {}
+
+void feature_cache::set_max_features(std::size_t max_features)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    max_features_ = max_features;
+    evict();
+}
+
+std::size_t feature_cache::max_features() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return max_features_;
+}
+
+void feature_cache::set_ttl(std::chrono::milliseconds ttl)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    ttl_ = ttl;
+}
+
+std::chrono::milliseconds feature_cache::ttl() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return ttl_;
+}
+
+namespace {
+
+// the variables in name order, each value with its type
+std::string variables_string(attributes const& vars)
+{
+    std::map<std::string, value const*> sorted;
+    for (auto const& kv : vars)
+    {
+        sorted.emplace(kv.first, &kv.second);
+    }
+    std::string str;
+    for (auto const& kv : sorted)
+    {
+        std::string value_str = kv.second->to_string();
+        str += std::to_string(kv.first.size()) + ':' + kv.first;
+        str += std::to_string(kv.second->which()) + ':';
+        str += std::to_string(value_str.size()) + ':' + value_str;
+    }
+    return str;
+}
+
+}
+
+feature_cache::key_type feature_cache::make_key(std::shared_ptr<datasource> const& ds, query const& q)
+{
+    box2d<double> const& box = q.get_bbox();
+    return key_type(ds.get(), box.minx(), box.miny(), box.maxx(), box.maxy(),
+                    q.scale_denominator(), q.get_filter_factor(), q.property_names(),
+                    q.get_filter() ? to_expression_string(*q.get_filter()) : std::string(),
+                    variables_string(q.variables()));
+}
+
+feature_cache::features_ptr feature_cache::find(std::shared_ptr<datasource> const& ds, query const& q)
+{
+    key_type key = make_key(ds, q);
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    auto itr = entries_.find(key);
+    if (itr == entries_.end()) return features_ptr();
+    entry & e = itr->second;
+    // a datasource allocated where an expired one lived must not match
+    bool stale = e.ds.expired() ||
+        (ttl_.count() > 0 && std::chrono::steady_clock::now() - e.created > ttl_);
+    if (stale)
+    {
+        num_features_ -= e.features->size();
+        lru_.erase(e.lru);
+        entries_.erase(itr);
+        return features_ptr();
+    }
+    lru_.splice(lru_.begin(), lru_, e.lru);
+    return e.features;
+}
+
+void feature_cache::insert(std::shared_ptr<datasource> const& ds, query const& q, features_ptr const& features)
+{
+    key_type key = make_key(ds, q);
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    if (!features || features->size() > max_features_) return;
+    auto itr = entries_.find(key);
+    if (itr != entries_.end())
+    {
+        num_features_ -= itr->second.features->size();
+        lru_.erase(itr->second.lru);
+        entries_.erase(itr);
+    }
+    lru_.push_front(key);
+    entry e{ds, features, std::chrono::steady_clock::now(), lru_.begin()};
+    entries_.emplace(std::move(key), std::move(e));
+    num_features_ += features->size();
+    evict();
+}
+
+void feature_cache::evict()
+{
+    while (num_features_ > max_features_ && !lru_.empty())
+    {
+        auto itr = entries_.find(lru_.back());
+        num_features_ -= itr->second.features->size();
+        entries_.erase(itr);
+        lru_.pop_back();
+    }
+}
+
+std::size_t feature_cache::size() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return entries_.size();
+}
+
+void feature_cache::clear()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    entries_.clear();
+    lru_.clear();
+    num_features_ = 0;
+}
+
+box2d<double> feature_cache::quantize(box2d<double> const& box)
+{
+    double span = std::max(box.width(), box.height());
+    if (!(span > 0.0) || !std::isfinite(span)) return box;
+    double cell = std::exp2(std::ceil(std::log2(span)));
+    return box2d<double>(std::floor(box.minx() / cell) * cell,
+                         std::floor(box.miny() / cell) * cell,
+                         std::ceil(box.maxx() / cell) * cell,
+                         std::ceil(box.maxy() / cell) * cell);
+}
+
+}
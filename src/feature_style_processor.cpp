@@ -25,6 +25,7 @@
 #include <mapnik/feature_style_processor_impl.hpp>
 #include <mapnik/agg_renderer.hpp>
 #include <mapnik/image_any.hpp>
+#include <mapnik/vector_tile/vector_tile_renderer.hpp>
 
 #if defined(GRID_RENDERER)
 #include <mapnik/grid/grid_renderer.hpp>
@@ -56,5 +57,6 @@ template class MAPNIK_DECL feature_style_processor<grid_renderer<grid> >;
 #endif
 
 template class MAPNIK_DECL feature_style_processor<agg_renderer<image_rgba8> >;
+template class MAPNIK_DECL feature_style_processor<vector_tile_renderer>;
 
 }
@@ -22,10 +22,14 @@
 
 #include <mapnik/feature_type_style.hpp>
 #include <mapnik/rule.hpp>
+#include <mapnik/rule_bands.hpp>
 #include <mapnik/enumeration.hpp>
 
 // boost
 
+// stl
+#include <algorithm>
+#include <cmath>
 
 namespace mapnik
 {
@@ -46,7 +50,10 @@ feature_type_style::feature_type_style()
       direct_filters_(),
       comp_op_(),
       opacity_(1.0f),
-      image_filters_inflate_(false)
+      image_filters_inflate_(false),
+      label_priority_(),
+      label_coverage_(1.0),
+      bands_(std::make_unique<rule_bands>())
 {}
 
 feature_type_style::feature_type_style(feature_type_style const& rhs)
@@ -56,7 +63,10 @@ feature_type_style::feature_type_style(feature_type_style const& rhs)
       direct_filters_(rhs.direct_filters_),
       comp_op_(rhs.comp_op_),
       opacity_(rhs.opacity_),
-      image_filters_inflate_(rhs.image_filters_inflate_) {}
+      image_filters_inflate_(rhs.image_filters_inflate_),
+      label_priority_(rhs.label_priority_),
+      label_coverage_(rhs.label_coverage_),
+      bands_(std::make_unique<rule_bands>()) {}
 
 feature_type_style::feature_type_style(feature_type_style && rhs)
     : rules_(std::move(rhs.rules_)),
@@ -65,7 +75,13 @@ feature_type_style::feature_type_style(feature_type_style && rhs)
       direct_filters_(std::move(rhs.direct_filters_)),
       comp_op_(std::move(rhs.comp_op_)),
       opacity_(std::move(rhs.opacity_)),
-      image_filters_inflate_(std::move(rhs.image_filters_inflate_)) {}
+      image_filters_inflate_(std::move(rhs.image_filters_inflate_)),
+      label_priority_(std::move(rhs.label_priority_)),
+      label_coverage_(std::move(rhs.label_coverage_)),
+      bands_(std::make_unique<rule_bands>())
+{
+    rhs.bands_->clear();
+}
 
 feature_type_style& feature_type_style::operator=(feature_type_style rhs)
 {
@@ -77,9 +93,14 @@ feature_type_style& feature_type_style::operator=(feature_type_style rhs)
     std::swap(this->comp_op_, rhs.comp_op_);
     std::swap(this->opacity_, rhs.opacity_);
     std::swap(this->image_filters_inflate_, rhs.image_filters_inflate_);
+    std::swap(this->label_priority_, rhs.label_priority_);
+    std::swap(this->label_coverage_, rhs.label_coverage_);
+    std::swap(this->bands_, rhs.bands_);
     return *this;
 }
 
+feature_type_style::~feature_type_style() {}
+
 bool feature_type_style::operator==(feature_type_style const& rhs) const
 {
     return (rules_ == rhs.rules_) &&
@@ -88,11 +109,14 @@ bool feature_type_style::operator==(feature_type_style const& rhs) const
         (direct_filters_ == rhs.direct_filters_) &&
         (comp_op_ == rhs.comp_op_) &&
         (opacity_ == rhs.opacity_) &&
-        (image_filters_inflate_ == rhs.image_filters_inflate_);
+        (image_filters_inflate_ == rhs.image_filters_inflate_) &&
+        (label_priority_ == rhs.label_priority_) &&
+        (label_coverage_ == rhs.label_coverage_);
 }
 
 void feature_type_style::add_rule(rule && rule)
 {
+    bands_->clear();
     rules_.push_back(std::move(rule));
 }
 
@@ -103,9 +127,15 @@ rules const& feature_type_style::get_rules() const
 
 rules& feature_type_style::get_rules_nonconst()
 {
+    bands_->clear();
     return rules_;
 }
 
+std::shared_ptr<rule_band const> feature_type_style::rule_band_at(double scale_denom, attributes const& vars) const
+{
+    return bands_->get(*this, scale_denom, vars);
+}
+
 bool feature_type_style::active(double scale_denom) const
 {
     for (rule const& r : rules_)
@@ -178,4 +208,37 @@ bool feature_type_style::image_filters_inflate() const
     return image_filters_inflate_;
 }
 
+void feature_type_style::set_label_priority(expression_ptr const& priority)
+{
+    bands_->clear();
+    label_priority_ = priority;
+}
+
+expression_ptr const& feature_type_style::label_priority() const
+{
+    return label_priority_;
+}
+
+void feature_type_style::set_label_coverage(double coverage)
+{
+    if (std::isnan(coverage)) label_coverage_ = 1.0;
+    else label_coverage_ = std::max(0.0, std::min(coverage, 1.0));
+}
+
+double feature_type_style::label_coverage() const
+{
+    return label_coverage_;
+}
+
+void feature_type_style::reserve(std::size_t size)
+{
+    bands_->clear();
+    rules_.reserve(size);
+}
+
+bool feature_type_style::schedule_labels() const
+{
+    return label_priority_ || label_coverage_ < 1.0;
+}
+
 }
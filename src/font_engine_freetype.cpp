@@ -28,11 +28,18 @@
 #include <mapnik/util/fs.hpp>
 #include <mapnik/util/file_io.hpp>
 #include <mapnik/make_unique.hpp>
+#include <mapnik/numa.hpp>
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+#include <mapnik/mapped_memory_cache.hpp>
+#endif
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/optional.hpp>
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+#include <boost/interprocess/mapped_region.hpp>
+#endif
 
 // freetype2
 extern "C"
@@ -46,6 +53,10 @@ extern "C"
 
 // stl
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
 #include <stdexcept>
 
 
@@ -88,7 +99,9 @@ bool freetype_engine::register_font_impl(std::string const& file_name)
     std::lock_guard<std::mutex> lock(mutex_);
 #endif
     font_library library;
-    return register_font_impl(file_name, library, global_font_file_mapping_);
+    bool success = register_font_impl(file_name, library, global_font_file_mapping_);
+    save_font_catalog();
+    return success;
 }
 
 bool freetype_engine::register_font_impl(std::string const& file_name,
@@ -96,72 +109,192 @@ bool freetype_engine::register_font_impl(std::string const& file_name,
                                          freetype_engine::font_file_mapping_type & font_file_mapping)
 {
     MAPNIK_LOG_DEBUG(font_engine_freetype) << "registering: " << file_name;
-    mapnik::util::file file(file_name);
-    if (!file) return false;
-
-    FT_Face face = 0;
-    FT_Open_Args args;
-    FT_StreamRec streamRec;
-    memset(&args, 0, sizeof(args));
-    memset(&streamRec, 0, sizeof(streamRec));
-    streamRec.base = 0;
-    streamRec.pos = 0;
-    streamRec.size = file.size();
-    streamRec.descriptor.pointer = file.get();
-    streamRec.read  = ft_read_cb;
-    streamRec.close = nullptr;
-    args.flags = FT_OPEN_STREAM;
-    args.stream = &streamRec;
-    int num_faces = 0;
-    bool success = false;
-    // some font files have multiple fonts in a file
-    // the count is in the 'root' face library[0]
-    // see the FT_FaceRec in freetype.h
-    for ( int i = 0; face == 0 || i < num_faces; ++i )
+    font_faces_type faces;
+    if (!cached_font_faces(file_name, faces))
     {
-        // if face is null then this is the first face
-        FT_Error error = FT_Open_Face(library.get(), &args, i, &face);
-        if (error) break;
-        // store num_faces locally, after FT_Done_Face it can not be accessed any more
-        if (num_faces == 0)
-            num_faces = face->num_faces;
-        // some fonts can lack names, skip them
-        // http://www.freetype.org/freetype2/docs/reference/ft2-base_interface.html#FT_FaceRec
-        if (face->family_name && face->style_name)
+        mapnik::util::file file(file_name);
+        if (!file) return false;
+
+        FT_Face face = 0;
+        FT_Open_Args args;
+        FT_StreamRec streamRec;
+        memset(&args, 0, sizeof(args));
+        memset(&streamRec, 0, sizeof(streamRec));
+        streamRec.base = 0;
+        streamRec.pos = 0;
+        streamRec.size = file.size();
+        streamRec.descriptor.pointer = file.get();
+        streamRec.read  = ft_read_cb;
+        streamRec.close = nullptr;
+        args.flags = FT_OPEN_STREAM;
+        args.stream = &streamRec;
+        int num_faces = 0;
+        // some font files have multiple fonts in a file
+        // the count is in the 'root' face library[0]
+        // see the FT_FaceRec in freetype.h
+        for ( int i = 0; face == 0 || i < num_faces; ++i )
         {
-            std::string name = std::string(face->family_name) + " " + std::string(face->style_name);
-            // skip fonts with leading . in the name
-            if (!boost::algorithm::starts_with(name,"."))
+            // if face is null then this is the first face
+            FT_Error error = FT_Open_Face(library.get(), &args, i, &face);
+            if (error) break;
+            // store num_faces locally, after FT_Done_Face it can not be accessed any more
+            if (num_faces == 0)
+                num_faces = face->num_faces;
+            // some fonts can lack names, skip them
+            // http://www.freetype.org/freetype2/docs/reference/ft2-base_interface.html#FT_FaceRec
+            if (face->family_name && face->style_name)
             {
-                // http://stackoverflow.com/a/24795559/2333354
-                auto range = font_file_mapping.equal_range(name);
-                if (range.first == range.second) // the key was previously absent; insert a pair
+                std::string name = std::string(face->family_name) + " " + std::string(face->style_name);
+                // skip fonts with leading . in the name
+                if (!boost::algorithm::starts_with(name,"."))
                 {
-                    font_file_mapping.emplace_hint(range.first, name, std::make_pair(i,file_name));
-                }
-                else // the key was present, replace the associated value
-                { /* some action with value range.first->second about to be overwritten here */
-                    MAPNIK_LOG_WARN(font_engine_freetype) << "registering new " << name << " at '" << file_name << "'";
-                    range.first->second = std::make_pair(i,file_name); // replace value
+                    faces.emplace_back(i, std::move(name));
                 }
-                success = true;
             }
+            else
+            {
+                std::ostringstream s;
+                s << "Warning: unable to load font file '" << file_name << "' ";
+                if (!face->family_name && !face->style_name)
+                    s << "which lacks both a family name and style name";
+                else if (face->family_name)
+                    s << "which reports a family name of '" << std::string(face->family_name) << "' and lacks a style name";
+                else if (face->style_name)
+                    s << "which reports a style name of '" << std::string(face->style_name) << "' and lacks a family name";
+                MAPNIK_LOG_ERROR(font_engine_freetype) << "register_font: " << s.str();
+            }
+            if (face) FT_Done_Face(face);
         }
-        else
+        cache_font_faces(file_name, faces);
+    }
+    // faces are only opened once face_manager asks for them
+    for (auto const& face : faces)
+    {
+        std::string const& name = face.second;
+        // http://stackoverflow.com/a/24795559/2333354
+        auto range = font_file_mapping.equal_range(name);
+        if (range.first == range.second) // the key was previously absent; insert a pair
         {
-            std::ostringstream s;
-            s << "Warning: unable to load font file '" << file_name << "' ";
-            if (!face->family_name && !face->style_name)
-                s << "which lacks both a family name and style name";
-            else if (face->family_name)
-                s << "which reports a family name of '" << std::string(face->family_name) << "' and lacks a style name";
-            else if (face->style_name)
-                s << "which reports a style name of '" << std::string(face->style_name) << "' and lacks a family name";
-            MAPNIK_LOG_ERROR(font_engine_freetype) << "register_font: " << s.str();
+            font_file_mapping.emplace_hint(range.first, name, std::make_pair(face.first, file_name));
+        }
+        else // the key was present, replace the associated value
+        { /* some action with value range.first->second about to be overwritten here */
+            MAPNIK_LOG_WARN(font_engine_freetype) << "registering new " << name << " at '" << file_name << "'";
+            range.first->second = std::make_pair(face.first, file_name); // replace value
         }
-        if (face) FT_Done_Face(face);
     }
-    return success;
+    return !faces.empty();
+}
+
+void freetype_engine::set_font_catalog(std::string const& file_name)
+{
+    instance().set_font_catalog_impl(file_name);
+}
+
+void freetype_engine::set_font_catalog_impl(std::string const& file_name)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(catalog_mutex_);
+#endif
+    catalog_file_ = file_name;
+    catalog_.clear();
+    catalog_dirty_ = false;
+    if (file_name.empty()) return;
+    // one header line, then per font file a line of
+    // path, mtime, size and face count followed by a line per face
+    std::ifstream in(file_name.c_str());
+    std::string line;
+    if (!std::getline(in, line) || line != "mapnik-font-catalog 1") return;
+    while (std::getline(in, line))
+    {
+        std::istringstream entry_line(line);
+        std::string path;
+        font_catalog_entry entry;
+        std::size_t count = 0;
+        if (!std::getline(entry_line, path, '\t') ||
+            !(entry_line >> entry.mtime >> entry.size >> count))
+        {
+            break;
+        }
+        for (std::size_t i = 0; i < count && std::getline(in, line); ++i)
+        {
+            std::size_t tab = line.find('\t');
+            if (tab == std::string::npos) break;
+            entry.faces.emplace_back(std::atoi(line.c_str()), line.substr(tab + 1));
+        }
+        if (entry.faces.size() != count) break;
+        catalog_[path] = std::move(entry);
+    }
+}
+
+bool freetype_engine::cached_font_faces(std::string const& file_name, font_faces_type & faces)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(catalog_mutex_);
+#endif
+    if (catalog_file_.empty()) return false;
+    auto itr = catalog_.find(file_name);
+    if (itr == catalog_.end()) return false;
+    std::time_t mtime;
+    std::uintmax_t size;
+    if (!mapnik::util::file_stat(file_name, mtime, size) ||
+        mtime != itr->second.mtime || size != itr->second.size)
+    {
+        return false;
+    }
+    faces = itr->second.faces;
+    return true;
+}
+
+void freetype_engine::cache_font_faces(std::string const& file_name, font_faces_type const& faces)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(catalog_mutex_);
+#endif
+    if (catalog_file_.empty()) return;
+    font_catalog_entry entry;
+    if (!mapnik::util::file_stat(file_name, entry.mtime, entry.size)) return;
+    entry.faces = faces;
+    catalog_[file_name] = std::move(entry);
+    catalog_dirty_ = true;
+}
+
+void freetype_engine::save_font_catalog()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(catalog_mutex_);
+#endif
+    if (catalog_file_.empty() || !catalog_dirty_) return;
+    // written aside under a name of its own and renamed, so other processes
+    // never read a partial catalog nor write into the same temporary file
+    std::string temp_name = mapnik::util::temp_filename(catalog_file_);
+    {
+        std::ofstream out(temp_name.c_str(), std::ios::trunc);
+        out << "mapnik-font-catalog 1\n";
+        for (auto const& kv : catalog_)
+        {
+            out << kv.first << '\t' << kv.second.mtime << ' ' << kv.second.size
+                << ' ' << kv.second.faces.size() << '\n';
+            for (auto const& face : kv.second.faces)
+            {
+                out << face.first << '\t' << face.second << '\n';
+            }
+        }
+        if (!out)
+        {
+            MAPNIK_LOG_ERROR(font_engine_freetype) << "unable to write font catalog '" << temp_name << "'";
+            out.close();
+            mapnik::util::remove(temp_name);
+            return;
+        }
+    }
+    if (std::rename(temp_name.c_str(), catalog_file_.c_str()) != 0)
+    {
+        MAPNIK_LOG_ERROR(font_engine_freetype) << "unable to write font catalog '" << catalog_file_ << "'";
+        mapnik::util::remove(temp_name);
+        return;
+    }
+    catalog_dirty_ = false;
 }
 
 bool freetype_engine::register_fonts(std::string const& dir, bool recurse)
@@ -175,7 +308,9 @@ bool freetype_engine::register_fonts_impl(std::string const& dir, bool recurse)
     std::lock_guard<std::mutex> lock(mutex_);
 #endif
     font_library library;
-    return register_fonts_impl(dir, library, global_font_file_mapping_, recurse);
+    bool success = register_fonts_impl(dir, library, global_font_file_mapping_, recurse);
+    save_font_catalog();
+    return success;
 }
 
 bool freetype_engine::register_fonts_impl(std::string const& dir,
@@ -317,7 +452,6 @@ face_ptr freetype_engine::create_face_impl(std::string const& family_name,
                                            freetype_engine::font_file_mapping_type const& global_font_file_mapping,
                                            freetype_engine::font_memory_cache_type & global_memory_fonts)
 {
-    bool found_font_file = false;
     font_file_mapping_type::const_iterator itr = font_file_mapping.find(family_name);
     // look for font registered on specific map
     if (itr != font_file_mapping.end())
@@ -336,57 +470,124 @@ face_ptr freetype_engine::create_face_impl(std::string const& family_name,
         }
         // we don't add to cache here because the map and its font_cache
         // must be immutable during rendering for predictable thread safety
-        found_font_file = true;
+        return create_file_face_impl(itr->second.second, itr->second.first, library, global_memory_fonts);
     }
-    else
+    // otherwise search global registry
+    itr = global_font_file_mapping.find(family_name);
+    if (itr != global_font_file_mapping.end())
     {
-        // otherwise search global registry
-        itr = global_font_file_mapping.find(family_name);
-        if (itr != global_font_file_mapping.end())
+        return create_file_face_impl(itr->second.second, itr->second.first, library, global_memory_fonts);
+    }
+    return face_ptr();
+}
+
+face_ptr freetype_engine::create_file_face_impl(std::string const& file_name,
+                                                int face_index,
+                                                font_library & library,
+                                                freetype_engine::font_memory_cache_type & global_memory_fonts)
+{
+    {
+        // fonts are added to the memory cache under the same lock, this
+        // is only reached once per thread and face, see thread_face_registry
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        auto mem_font_itr = global_memory_fonts.find(file_name);
+        // if font already in memory, use it
+        if (mem_font_itr != global_memory_fonts.end())
         {
-            auto mem_font_itr = global_memory_fonts.find(itr->second.second);
-            // if font already in memory, use it
-            if (mem_font_itr != global_memory_fonts.end())
-            {
-                FT_Face face;
-                FT_Error error = FT_New_Memory_Face(library.get(),
-                                                    reinterpret_cast<FT_Byte const*>(mem_font_itr->second.first.get()), // data
-                                                    static_cast<FT_Long>(mem_font_itr->second.second), // size
-                                                    itr->second.first, // face index
-                                                    &face);
-                if (!error) return std::make_shared<font_face>(face);
-            }
-            found_font_file = true;
+            char const* data = node_font_data(file_name, mem_font_itr->second.first.get(),
+                                              mem_font_itr->second.second);
+            FT_Face face;
+            FT_Error error = FT_New_Memory_Face(library.get(),
+                                                reinterpret_cast<FT_Byte const*>(data),
+                                                static_cast<FT_Long>(mem_font_itr->second.second), // size
+                                                face_index,
+                                                &face);
+            if (!error) return std::make_shared<font_face>(face);
         }
     }
-    // if we found file file but it is not yet in memory
-    if (found_font_file)
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    // map the file read-only so its pages are shared with every other
+    // process using the same font, the region outlives the face
+    boost::optional<mapnik::mapped_region_ptr> memory =
+        mapnik::mapped_memory_cache::instance().find(file_name, true);
+    if (memory && numa::node_count() > 1)
     {
-        mapnik::util::file file(itr->second.second);
-        if (file)
+        // the page cache lives on one node, faces read a copy on theirs
+        mapnik::mapped_region_ptr const& region = *memory;
+        char const* data;
         {
 #ifdef MAPNIK_THREADSAFE
             std::lock_guard<std::mutex> lock(mutex_);
 #endif
-            auto result = global_memory_fonts.emplace(itr->second.second, std::make_pair(file.data(),file.size()));
-            FT_Face face;
-            FT_Error error = FT_New_Memory_Face(library.get(),
-                                                reinterpret_cast<FT_Byte const*>(result.first->second.first.get()), // data
-                                                static_cast<FT_Long>(result.first->second.second), // size
-                                                itr->second.first, // face index
-                                                &face);
-            if (error)
-            {
-                // we can't load font, erase it.
-                global_memory_fonts.erase(result.first);
-                return face_ptr();
-            }
-            return std::make_shared<font_face>(face);
+            data = node_font_data(file_name, static_cast<char const*>(region->get_address()),
+                                  region->get_size());
         }
+        FT_Face face;
+        FT_Error error = FT_New_Memory_Face(library.get(),
+                                            reinterpret_cast<FT_Byte const*>(data),
+                                            static_cast<FT_Long>(region->get_size()), // size
+                                            face_index,
+                                            &face);
+        if (!error) return std::make_shared<font_face>(face);
+    }
+    else if (memory)
+    {
+        mapnik::mapped_region_ptr const& region = *memory;
+        FT_Face face;
+        FT_Error error = FT_New_Memory_Face(library.get(),
+                                            reinterpret_cast<FT_Byte const*>(region->get_address()), // data
+                                            static_cast<FT_Long>(region->get_size()), // size
+                                            face_index,
+                                            &face);
+        if (!error) return std::make_shared<font_face>(face, region);
+    }
+    // fall back to reading the file into the heap
+#endif
+    mapnik::util::file file(file_name);
+    if (file)
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        auto result = global_memory_fonts.emplace(file_name, std::make_pair(file.data(),file.size()));
+        FT_Face face;
+        FT_Error error = FT_New_Memory_Face(library.get(),
+                                            reinterpret_cast<FT_Byte const*>(result.first->second.first.get()), // data
+                                            static_cast<FT_Long>(result.first->second.second), // size
+                                            face_index,
+                                            &face);
+        if (error)
+        {
+            // we can't load font, erase it.
+            global_memory_fonts.erase(result.first);
+            return face_ptr();
+        }
+        return std::make_shared<font_face>(face);
     }
     return face_ptr();
 }
 
+// requires mutex_; the copy is made by the calling thread, so that its
+// pages are allocated on the calling thread's node, and kept as long as
+// the engine
+char const* freetype_engine::node_font_data(std::string const& file_name, char const* data, std::size_t size)
+{
+    std::size_t nodes = numa::node_count();
+    if (nodes < 2) return data;
+    if (node_memory_fonts_.size() < nodes) node_memory_fonts_.resize(nodes);
+    font_memory_cache_type & fonts = node_memory_fonts_[numa::current_node() % nodes];
+    auto itr = fonts.find(file_name);
+    if (itr == fonts.end())
+    {
+        std::unique_ptr<char[]> copy(new char[size]);
+        std::copy(data, data + size, copy.get());
+        itr = fonts.emplace(file_name, std::make_pair(std::move(copy), size)).first;
+    }
+    return itr->second.first.get();
+}
+
 face_ptr freetype_engine::create_face(std::string const& family_name,
                                       font_library & library,
                                       freetype_engine::font_file_mapping_type const& font_file_mapping,
@@ -402,6 +603,58 @@ face_ptr freetype_engine::create_face(std::string const& family_name,
                                        global_memory_fonts);
 }
 
+face_ptr freetype_engine::create_file_face(std::string const& file_name,
+                                           int face_index,
+                                           font_library & library,
+                                           freetype_engine::font_memory_cache_type & global_memory_fonts)
+{
+    return instance().create_file_face_impl(file_name, face_index, library, global_memory_fonts);
+}
+
+namespace {
+
+// FT_Face objects are not thread safe, so faces outliving a single
+// render are kept per thread, together with the library owning them
+class thread_face_registry : util::noncopyable
+{
+public:
+    static thread_face_registry & instance()
+    {
+#ifdef MAPNIK_THREADSAFE
+        static thread_local thread_face_registry registry;
+#else
+        static thread_face_registry registry;
+#endif
+        return registry;
+    }
+
+    face_ptr get(std::string const& file_name, int face_index)
+    {
+        auto key = std::make_pair(file_name, face_index);
+        auto itr = faces_.find(key);
+        if (itr != faces_.end())
+        {
+            return itr->second;
+        }
+        face_ptr face = freetype_engine::create_file_face(file_name,
+                                                          face_index,
+                                                          library_,
+                                                          freetype_engine::get_cache());
+        if (face)
+        {
+            faces_.emplace(std::move(key), face);
+        }
+        return face;
+    }
+
+private:
+    // declared first, so faces are released before their library
+    font_library library_;
+    std::map<std::pair<std::string, int>, face_ptr> faces_;
+};
+
+}
+
 face_manager::face_manager(font_library & library,
                            freetype_engine::font_file_mapping_type const& font_file_mapping,
                            freetype_engine::font_memory_cache_type const& font_cache)
@@ -427,12 +680,38 @@ face_ptr face_manager::get_face(std::string const& name)
     }
     else
     {
-        face_ptr face = freetype_engine::create_face(name,
-                                                     library_,
-                                                     font_file_mapping_,
-                                                     font_memory_cache_,
-                                                     freetype_engine::instance().get_mapping(),
-                                                     freetype_engine::instance().get_cache());
+        face_ptr face;
+        auto mapping_itr = font_file_mapping_.find(name);
+        if (mapping_itr != font_file_mapping_.end() &&
+            font_memory_cache_.find(mapping_itr->second.second) != font_memory_cache_.end())
+        {
+            // faces backed by the map's own font memory die with the map
+            face = freetype_engine::create_face(name,
+                                                library_,
+                                                font_file_mapping_,
+                                                font_memory_cache_,
+                                                freetype_engine::instance().get_mapping(),
+                                                freetype_engine::instance().get_cache());
+        }
+        else
+        {
+            // each iterator is only compared with the end of its own map
+            if (mapping_itr != font_file_mapping_.end())
+            {
+                face = thread_face_registry::instance().get(mapping_itr->second.second,
+                                                            mapping_itr->second.first);
+            }
+            else
+            {
+                auto const& global_mapping = freetype_engine::instance().get_mapping();
+                auto global_itr = global_mapping.find(name);
+                if (global_itr != global_mapping.end())
+                {
+                    face = thread_face_registry::instance().get(global_itr->second.second,
+                                                                global_itr->second.first);
+                }
+            }
+        }
         if (face)
         {
             face_cache_->emplace(name, face);
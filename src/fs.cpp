@@ -137,6 +137,20 @@ namespace util {
         return listing;
     }
 
+    bool file_stat(std::string const& filepath, std::time_t & mtime, std::uintmax_t & size)
+    {
+#ifdef _WINDOWS
+        boost::filesystem::path path(mapnik::utf8_to_utf16(filepath));
+#else
+        boost::filesystem::path path(filepath);
+#endif
+        boost::system::error_code ec;
+        mtime = boost::filesystem::last_write_time(path, ec);
+        if (ec) return false;
+        size = boost::filesystem::file_size(path, ec);
+        return !ec;
+    }
+
 
 } // end namespace util
 
@@ -0,0 +1,304 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/geometry/interior.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <queue>
+#include <vector>
+
+namespace mapnik { namespace geometry {
+
+namespace detail {
+
+struct edge
+{
+    double x0;
+    double y0;
+    double x1;
+    double y1;
+};
+
+// The polygon edges bucketed into horizontal bands. Distance queries visit
+// the bands nearest to the query point first and stop once the remaining
+// bands are farther away than the closest edge found; the inside test only
+// needs the band holding the query point.
+class edge_index
+{
+public:
+    template <typename T>
+    explicit edge_index(polygon<T> const& poly)
+    {
+        std::vector<edge> edges;
+        for (auto const& ring : poly)
+        {
+            if (ring.size() < 2) continue;
+            for (std::size_t i = 1; i < ring.size(); ++i)
+            {
+                add(edges, ring[i - 1], ring[i]);
+            }
+            if (ring.front() != ring.back()) add(edges, ring.back(), ring.front());
+        }
+        if (edges.empty()) return;
+
+        miny_ = maxy_ = edges.front().y0;
+        for (auto const& e : edges)
+        {
+            miny_ = std::min(miny_, std::min(e.y0, e.y1));
+            maxy_ = std::max(maxy_, std::max(e.y0, e.y1));
+        }
+        bands_ = static_cast<std::size_t>(std::sqrt(static_cast<double>(edges.size())));
+        bands_ = std::max(std::size_t(1), std::min(bands_, std::size_t(1024)));
+        band_height_ = (maxy_ - miny_) / bands_;
+        if (!(band_height_ > 0.0)) bands_ = 1;
+
+        // lay out the bands one after the other in edges_
+        offsets_.assign(bands_ + 1, 0);
+        for (auto const& e : edges)
+        {
+            std::size_t last = band(std::max(e.y0, e.y1));
+            for (std::size_t b = band(std::min(e.y0, e.y1)); b <= last; ++b) ++offsets_[b + 1];
+        }
+        for (std::size_t b = 0; b < bands_; ++b) offsets_[b + 1] += offsets_[b];
+        edges_.resize(offsets_.back());
+        std::vector<std::size_t> next(offsets_.begin(), offsets_.end() - 1);
+        for (auto const& e : edges)
+        {
+            std::size_t last = band(std::max(e.y0, e.y1));
+            for (std::size_t b = band(std::min(e.y0, e.y1)); b <= last; ++b) edges_[next[b]++] = e;
+        }
+    }
+
+    // Distance from (x, y) to the polygon outline, negative outside
+    double signed_distance(double x, double y) const
+    {
+        if (edges_.empty()) return -std::numeric_limits<double>::infinity();
+        bool inside = false;
+        double best = std::numeric_limits<double>::max();
+        std::size_t b = band(y);
+        for (std::size_t i = offsets_[b]; i < offsets_[b + 1]; ++i)
+        {
+            edge const& e = edges_[i];
+            if ((e.y0 > y) != (e.y1 > y) &&
+                x < (e.x1 - e.x0) * (y - e.y0) / (e.y1 - e.y0) + e.x0)
+            {
+                inside = !inside;
+            }
+            best = std::min(best, segment_distance_squared(x, y, e));
+        }
+        for (std::size_t k = 1; k < bands_; ++k)
+        {
+            bool below = k <= b;
+            bool above = b + k < bands_;
+            if (!below && !above) break;
+            // nearest the remaining bands on either side can be
+            double reach = std::numeric_limits<double>::max();
+            if (below) reach = std::min(reach, y - (miny_ + (b - k + 1) * band_height_));
+            if (above) reach = std::min(reach, miny_ + (b + k) * band_height_ - y);
+            if (reach > 0.0 && reach * reach >= best) break;
+            if (below) best = std::min(best, band_distance_squared(b - k, x, y));
+            if (above) best = std::min(best, band_distance_squared(b + k, x, y));
+        }
+        return (inside ? 1.0 : -1.0) * std::sqrt(best);
+    }
+
+private:
+    template <typename Point>
+    static void add(std::vector<edge> & edges, Point const& p0, Point const& p1)
+    {
+        edges.push_back(edge{static_cast<double>(p0.x), static_cast<double>(p0.y),
+                             static_cast<double>(p1.x), static_cast<double>(p1.y)});
+    }
+
+    static double segment_distance_squared(double x, double y, edge const& e)
+    {
+        double px = e.x0;
+        double py = e.y0;
+        double dx = e.x1 - px;
+        double dy = e.y1 - py;
+        if (dx != 0.0 || dy != 0.0)
+        {
+            double t = ((x - px) * dx + (y - py) * dy) / (dx * dx + dy * dy);
+            if (t > 1.0)
+            {
+                px = e.x1;
+                py = e.y1;
+            }
+            else if (t > 0.0)
+            {
+                px += dx * t;
+                py += dy * t;
+            }
+        }
+        dx = x - px;
+        dy = y - py;
+        return dx * dx + dy * dy;
+    }
+
+    double band_distance_squared(std::size_t b, double x, double y) const
+    {
+        double best = std::numeric_limits<double>::max();
+        for (std::size_t i = offsets_[b]; i < offsets_[b + 1]; ++i)
+        {
+            best = std::min(best, segment_distance_squared(x, y, edges_[i]));
+        }
+        return best;
+    }
+
+    std::size_t band(double y) const
+    {
+        if (bands_ == 1 || !(y > miny_)) return 0;
+        std::size_t b = static_cast<std::size_t>((y - miny_) / band_height_);
+        return std::min(b, bands_ - 1);
+    }
+
+    std::vector<edge> edges_;
+    std::vector<std::size_t> offsets_;
+    std::size_t bands_ = 1;
+    double miny_ = 0.0;
+    double maxy_ = 0.0;
+    double band_height_ = 0.0;
+};
+
+struct cell
+{
+    cell(double x_, double y_, double h_, edge_index const& index)
+        : x(x_),
+          y(y_),
+          h(h_),
+          d(index.signed_distance(x_, y_)),
+          max(d + h_ * std::sqrt(2.0)) {}
+
+    double x;
+    double y;
+    // half the cell size
+    double h;
+    // distance from the cell center to the polygon
+    double d;
+    // farthest any point within the cell can be from the polygon
+    double max;
+};
+
+struct cell_order
+{
+    bool operator()(cell const& lhs, cell const& rhs) const
+    {
+        return lhs.max < rhs.max;
+    }
+};
+
+// Area centroid of the exterior ring, a good first guess for most shapes
+template <typename T>
+cell centroid_cell(linear_ring<T> const& ring, edge_index const& index)
+{
+    double area = 0.0;
+    double x = 0.0;
+    double y = 0.0;
+    point<T> const& origin = ring.front();
+    for (std::size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+    {
+        double ax = ring[i].x - origin.x;
+        double ay = ring[i].y - origin.y;
+        double bx = ring[j].x - origin.x;
+        double by = ring[j].y - origin.y;
+        double f = ax * by - bx * ay;
+        x += (ax + bx) * f;
+        y += (ay + by) * f;
+        area += f * 3.0;
+    }
+    if (area == 0.0) return cell(origin.x, origin.y, 0.0, index);
+    return cell(origin.x + x / area, origin.y + y / area, 0.0, index);
+}
+
+}
+
+template <typename T>
+bool interior(polygon<T> const& poly, double precision, point<T> & pt)
+{
+    if (poly.empty() || poly.front().empty()) return false;
+
+    linear_ring<T> const& exterior = poly.front();
+    double minx = exterior.front().x;
+    double miny = exterior.front().y;
+    double maxx = minx;
+    double maxy = miny;
+    for (auto const& p : exterior)
+    {
+        minx = std::min(minx, static_cast<double>(p.x));
+        miny = std::min(miny, static_cast<double>(p.y));
+        maxx = std::max(maxx, static_cast<double>(p.x));
+        maxy = std::max(maxy, static_cast<double>(p.y));
+    }
+    double width = maxx - minx;
+    double height = maxy - miny;
+    double cell_size = std::min(width, height);
+    if (!(cell_size > 0.0))
+    {
+        // a line or a point, there is no inside to search
+        pt.x = static_cast<T>(minx + width / 2.0);
+        pt.y = static_cast<T>(miny + height / 2.0);
+        return true;
+    }
+    if (!(precision > 0.0)) precision = std::max(width, height) / 100.0;
+
+    detail::edge_index index(poly);
+    std::priority_queue<detail::cell, std::vector<detail::cell>, detail::cell_order> queue;
+    double h = cell_size / 2.0;
+    for (double x = minx; x < maxx; x += cell_size)
+    {
+        for (double y = miny; y < maxy; y += cell_size)
+        {
+            queue.emplace(x + h, y + h, h, index);
+        }
+    }
+
+    detail::cell best = detail::centroid_cell(exterior, index);
+    detail::cell center(minx + width / 2.0, miny + height / 2.0, 0.0, index);
+    if (center.d > best.d) best = center;
+
+    while (!queue.empty())
+    {
+        detail::cell c = queue.top();
+        queue.pop();
+        if (c.d > best.d) best = c;
+        // no point within the cell can be meaningfully farther inside
+        if (c.max - best.d <= precision) continue;
+        h = c.h / 2.0;
+        queue.emplace(c.x - h, c.y - h, h, index);
+        queue.emplace(c.x + h, c.y - h, h, index);
+        queue.emplace(c.x - h, c.y + h, h, index);
+        queue.emplace(c.x + h, c.y + h, h, index);
+    }
+    pt.x = static_cast<T>(best.x);
+    pt.y = static_cast<T>(best.y);
+    return true;
+}
+
+template MAPNIK_DECL bool interior(polygon<double> const&, double, point<double> &);
+
+}}
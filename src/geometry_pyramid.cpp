@@ -0,0 +1,164 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/geometry_pyramid.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_layer_desc.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/geometry/simplify.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace mapnik
+{
+
+template class singleton<geometry_pyramid, CreateStatic>;
+
+geometry_pyramid::geometry_pyramid()
+    : entries_(),
+      max_pixels_(8192.0) {}
+
+void geometry_pyramid::set_max_pixels(double max_pixels)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    max_pixels_ = max_pixels;
+}
+
+double geometry_pyramid::max_pixels() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return max_pixels_;
+}
+
+bool geometry_pyramid::supported(datasource const& ds)
+{
+    if (ds.type() != datasource::Vector) return false;
+    boost::optional<std::string> type = ds.params().get<std::string>("type");
+    if (!type) return false;
+    return *type == "shape" || *type == "geojson" || *type == "csv" ||
+        *type == "geobuf" || *type == "topojson";
+}
+
+std::shared_ptr<datasource> geometry_pyramid::level(std::shared_ptr<datasource> const& ds, double resolution)
+{
+    if (!ds || !(resolution > 0.0) || !std::isfinite(resolution) || !supported(*ds))
+    {
+        return std::shared_ptr<datasource>();
+    }
+    box2d<double> ext = ds->envelope();
+    double span = std::max(ext.width(), ext.height());
+    if (!(span > 0.0) || !std::isfinite(span)) return std::shared_ptr<datasource>();
+    // keep the tolerance within half a pixel
+    int lvl = static_cast<int>(std::floor(std::log2(0.5 / resolution)));
+    double tolerance = std::exp2(lvl);
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        if (span / tolerance > max_pixels_) return std::shared_ptr<datasource>();
+        auto itr = entries_.find(ds.get());
+        if (itr != entries_.end())
+        {
+            // a datasource allocated where an expired one lived must not match
+            if (itr->second.ds.expired())
+            {
+                entries_.erase(itr);
+            }
+            else
+            {
+                auto level_itr = itr->second.levels.find(lvl);
+                if (level_itr != itr->second.levels.end()) return level_itr->second;
+            }
+        }
+    }
+    // built without holding the lock, a level built concurrently by
+    // another render is kept and this one dropped
+    std::shared_ptr<datasource> result = build(*ds, tolerance);
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    entry & e = entries_[ds.get()];
+    if (e.ds.expired())
+    {
+        e.ds = ds;
+        e.levels.clear();
+    }
+    return e.levels.emplace(lvl, result).first->second;
+}
+
+std::shared_ptr<datasource> geometry_pyramid::build(datasource const& ds, double tolerance)
+{
+    parameters params;
+    params["type"] = "memory";
+    params["spatial_index"] = true;
+    auto result = std::make_shared<memory_datasource>(params);
+    box2d<double> ext = ds.envelope();
+    query q(ext);
+    for (attribute_descriptor const& desc : ds.get_descriptor().get_descriptors())
+    {
+        q.add_property_name(desc.get_name());
+    }
+    featureset_ptr fs = ds.features(q);
+    if (fs)
+    {
+        feature_ptr f;
+        while ((f = fs->next()))
+        {
+            feature_ptr copy = feature_factory::create(f->context(), f->id());
+            copy->set_data(f->get_data());
+            copy->set_geometry(geometry::simplify(static_cast<feature_impl const&>(*f).get_geometry(), tolerance));
+            result->push(copy);
+        }
+    }
+    result->set_envelope(ext);
+    return result;
+}
+
+std::size_t geometry_pyramid::size() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return entries_.size();
+}
+
+void geometry_pyramid::clear()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    entries_.clear();
+}
+
+}
@@ -28,7 +28,8 @@
 #include <mapnik/feature.hpp>
 #include <mapnik/value.hpp>
 
-// boost
+// stl
+#include <algorithm>
 
 namespace mapnik
 {
@@ -37,11 +38,12 @@ template <typename T>
 const typename hit_grid<T>::value_type hit_grid<T>::base_mask = std::numeric_limits<typename T::type>::min();
 
 template <typename T>
-hit_grid<T>::hit_grid(std::size_t width, std::size_t height, std::string const& key)
-    : width_(width),
-      height_(height),
+hit_grid<T>::hit_grid(std::size_t width, std::size_t height, std::string const& key, unsigned resolution)
+    : resolution_(std::max(resolution, 1u)),
+      width_((width + resolution_ - 1) / resolution_),
+      height_((height + resolution_ - 1) / resolution_),
       key_(key),
-      data_(width,height),
+      data_(width_,height_),
       id_name_("__id__"),
       painted_(false),
       names_(),
@@ -55,7 +57,8 @@ hit_grid<T>::hit_grid(std::size_t width, std::size_t height, std::string const&
 
 template <typename T>
 hit_grid<T>::hit_grid(hit_grid<T> const& rhs)
-    : width_(rhs.width_),
+    : resolution_(rhs.resolution_),
+      width_(rhs.width_),
       height_(rhs.height_),
       key_(rhs.key_),
       data_(rhs.data_),
@@ -93,15 +96,6 @@ void hit_grid<T>::add_feature(mapnik::feature_impl const& feature)
         return;
     }
 
-    if (ctx_->size() == 0)
-    {
-        context_type::map_type::const_iterator itr = feature.context()->begin();
-        context_type::map_type::const_iterator end = feature.context()->end();
-        for ( ;itr!=end; ++itr)
-        {
-            ctx_->add(itr->first,itr->second);
-        }
-    }
     // NOTE: currently lookup keys must be strings,
     // but this should be revisited
     lookup_type lookup_value;
@@ -129,11 +123,25 @@ void hit_grid<T>::add_feature(mapnik::feature_impl const& feature)
         // if extra fields have been supplied, push them into grid memory
         if (!names_.empty())
         {
+            // only the requested fields are kept, the context of the first
+            // feature tells which of them the layer has
+            if (ctx_->size() == 0)
+            {
+                for (auto const& name : names_)
+                {
+                    if (feature.has_key(name)) ctx_->push(name);
+                }
+            }
             // it is ~ 2x faster to copy feature attributes compared
             // to building up a in-memory cache of feature_ptrs
             // https://github.com/mapnik/mapnik/issues/1198
+            feature_impl::cont_type data(ctx_->size());
+            for (auto const& kv : *ctx_)
+            {
+                data[kv.second] = feature.get(kv.first);
+            }
             mapnik::feature_ptr feature2(mapnik::feature_factory::create(ctx_,feature_id));
-            feature2->set_data(feature.get_data());
+            feature2->set_data(data);
             features_.emplace(lookup_value,feature2);
         }
     }
@@ -72,7 +72,7 @@ grid_renderer<T>::grid_renderer(Map const& m, T & pixmap, double scale_factor, u
 
 template <typename T>
 grid_renderer<T>::grid_renderer(Map const& m, request const& req, attributes const& vars, T & pixmap, double scale_factor, unsigned offset_x, unsigned offset_y)
-    : feature_style_processor<grid_renderer>(m, scale_factor),
+    : feature_style_processor<grid_renderer>(m, req, scale_factor),
       pixmap_(pixmap),
       ras_ptr(new grid_rasterizer),
       common_(m, req, vars, offset_x, offset_y, req.width(), req.height(), scale_factor)
@@ -104,6 +104,12 @@ void grid_renderer<T>::end_map_processing(Map const& /*m*/)
     MAPNIK_LOG_DEBUG(grid_renderer) << "grid_renderer: End map processing";
 }
 
+template <typename T>
+double grid_renderer<T>::label_coverage() const
+{
+    return common_.detector_->coverage();
+}
+
 template <typename T>
 void grid_renderer<T>::start_layer_processing(layer const& lay, box2d<double> const& query_extent)
 {
@@ -155,7 +161,7 @@ struct grid_render_marker_visitor
         using renderer_type = agg::renderer_scanline_bin_solid<grid_renderer_base_type>;
         agg::scanline_bin sl;
 
-        grid_rendering_buffer buf(pixmap_.raw_data(), common_.width_, common_.height_, common_.width_);
+        grid_sampled_buffer buf(pixmap_, common_.width_, common_.height_);
         pixfmt_type pixf(buf);
 
         grid_renderer_base_type renb(pixf);
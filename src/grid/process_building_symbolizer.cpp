@@ -62,7 +62,7 @@ void grid_renderer<T>::process(building_symbolizer const& sym,
     using transform_path_type = transform_path_adapter<view_transform, vertex_adapter>;
     agg::scanline_bin sl;
 
-    grid_rendering_buffer buf(pixmap_.raw_data(), common_.width_, common_.height_, common_.width_);
+    grid_sampled_buffer buf(pixmap_, common_.width_, common_.height_);
     pixfmt_type pixf(buf);
 
     grid_renderer_base_type renb(pixf);
@@ -72,8 +72,9 @@ void grid_renderer<T>::process(building_symbolizer const& sym,
 
     double height = get<value_double>(sym, keys::height, feature, common_.vars_, 0.0);
 
+    // every wall is drawn with the feature id, so they go in one pass
     render_building_symbolizer(
-        feature, height,
+        feature, height, true,
         [&](path_type const& faces)
         {
             vertex_adapter va(faces);
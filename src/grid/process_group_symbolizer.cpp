@@ -69,7 +69,7 @@ struct thunk_renderer : render_thunk_list_dispatch
 
     virtual void operator()(vector_marker_render_thunk const& thunk)
     {
-        using buf_type = grid_rendering_buffer;
+        using buf_type = grid_sampled_buffer;
         using pixfmt_type = typename grid_renderer_base_type::pixfmt_type;
         using renderer_type = agg::renderer_scanline_bin_solid<grid_renderer_base_type>;
 
@@ -79,7 +79,7 @@ struct thunk_renderer : render_thunk_list_dispatch
                                                    renderer_type,
                                                    pixfmt_type>;
 
-        buf_type render_buf(pixmap_.raw_data(), common_.width_, common_.height_, common_.width_);
+        buf_type render_buf(pixmap_, common_.width_, common_.height_);
         ras_.reset();
         pixfmt_type pixf(render_buf);
         grid_renderer_base_type renb(pixf);
@@ -97,10 +97,10 @@ struct thunk_renderer : render_thunk_list_dispatch
 
     virtual void operator()(raster_marker_render_thunk const& thunk)
     {
-        using buf_type = grid_rendering_buffer;
+        using buf_type = grid_sampled_buffer;
         using pixfmt_type = typename grid_renderer_base_type::pixfmt_type;
         using renderer_type = agg::renderer_scanline_bin_solid<grid_renderer_base_type>;
-        buf_type render_buf(pixmap_.raw_data(), common_.width_, common_.height_, common_.width_);
+        buf_type render_buf(pixmap_, common_.width_, common_.height_);
         ras_.reset();
         pixfmt_type pixf(render_buf);
         grid_renderer_base_type renb(pixf);
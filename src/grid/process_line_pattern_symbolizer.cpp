@@ -77,7 +77,7 @@ void grid_renderer<T>::process(line_pattern_symbolizer const& sym,
 
     agg::scanline_bin sl;
 
-    grid_rendering_buffer buf(pixmap_.raw_data(), common_.width_, common_.height_, common_.width_);
+    grid_sampled_buffer buf(pixmap_, common_.width_, common_.height_);
     pixfmt_type pixf(buf);
 
     grid_renderer_base_type renb(pixf);
@@ -97,7 +97,7 @@ void grid_renderer<T>::process(line_pattern_symbolizer const& sym,
     box2d<double> clipping_extent = common_.query_extent_;
     if (clip)
     {
-        double padding = (double)(common_.query_extent_.width()/pixmap_.width());
+        double padding = (double)(common_.query_extent_.width()/common_.width_);
         double half_stroke = stroke_width/2.0;
         if (half_stroke > 1)
             padding *= half_stroke;
@@ -133,7 +133,10 @@ void grid_renderer<T>::process(line_pattern_symbolizer const& sym,
     using apply_vertex_converter_type = detail::apply_vertex_converter<vertex_converter_type,grid_rasterizer>;
     using vertex_processor_type = geometry::vertex_processor<apply_vertex_converter_type>;
     apply_vertex_converter_type apply(converter, *ras_ptr);
-    mapnik::util::apply_visitor(vertex_processor_type(apply),feature.get_geometry());
+    if (!converter.clipped_away(feature))
+    {
+        mapnik::util::apply_visitor(vertex_processor_type(apply),static_cast<feature_impl const&>(feature).get_geometry());
+    }
 
     // render id
     ren.color(color_type(feature.id()));
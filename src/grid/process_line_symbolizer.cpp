@@ -58,7 +58,7 @@ void grid_renderer<T>::process(line_symbolizer const& sym,
 
     agg::scanline_bin sl;
 
-    grid_rendering_buffer buf(pixmap_.raw_data(), common_.width_, common_.height_, common_.width_);
+    grid_sampled_buffer buf(pixmap_, common_.width_, common_.height_);
     pixfmt_type pixf(buf);
 
     grid_renderer_base_type renb(pixf);
@@ -84,7 +84,7 @@ void grid_renderer<T>::process(line_symbolizer const& sym,
 
     if (clip)
     {
-        double padding = (double)(common_.query_extent_.width()/pixmap_.width());
+        double padding = (double)(common_.query_extent_.width()/common_.width_);
         double half_stroke = width/2.0;
         if (half_stroke > 1)
             padding *= half_stroke;
@@ -102,7 +102,7 @@ void grid_renderer<T>::process(line_symbolizer const& sym,
     vertex_converter_type converter(clipping_extent,sym,common_.t_,prj_trans,tr,feature,common_.vars_,common_.scale_factor_);
     if (clip)
     {
-        geometry::geometry_types type = geometry::geometry_type(feature.get_geometry());
+        geometry::geometry_types type = feature.geometry_type();
         if (type == geometry::geometry_types::Polygon || type == geometry::geometry_types::MultiPolygon)
             converter.template set<clip_poly_tag>();
         else if (type == geometry::geometry_types::LineString || type == geometry::geometry_types::MultiLineString)
@@ -119,7 +119,10 @@ void grid_renderer<T>::process(line_symbolizer const& sym,
     using apply_vertex_converter_type = detail::apply_vertex_converter<vertex_converter_type, grid_rasterizer>;
     using vertex_processor_type = geometry::vertex_processor<apply_vertex_converter_type>;
     apply_vertex_converter_type apply(converter, *ras_ptr);
-    mapnik::util::apply_visitor(vertex_processor_type(apply),feature.get_geometry());
+    if (!converter.clipped_away(feature))
+    {
+        mapnik::util::apply_visitor(vertex_processor_type(apply),static_cast<feature_impl const&>(feature).get_geometry());
+    }
 
     // render id
     ren.color(color_type(feature.id()));
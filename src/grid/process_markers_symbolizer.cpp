@@ -138,7 +138,7 @@ void grid_renderer<T>::process(markers_symbolizer const& sym,
                                mapnik::feature_impl & feature,
                                proj_transform const& prj_trans)
 {
-    using buf_type = grid_rendering_buffer;
+    using buf_type = grid_sampled_buffer;
     using pixfmt_type = typename grid_renderer_base_type::pixfmt_type;
     using renderer_type = agg::renderer_scanline_bin_solid<grid_renderer_base_type>;
 
@@ -148,7 +148,7 @@ void grid_renderer<T>::process(markers_symbolizer const& sym,
                                                renderer_type,
                                                pixfmt_type>;
 
-    buf_type render_buf(pixmap_.raw_data(), common_.width_, common_.height_, common_.width_);
+    buf_type render_buf(pixmap_, common_.width_, common_.height_);
     ras_ptr->reset();
     box2d<double> clip_box = common_.query_extent_;
 
@@ -59,7 +59,7 @@ void grid_renderer<T>::process(polygon_symbolizer const& sym,
 
     ras_ptr->reset();
 
-    grid_rendering_buffer buf(pixmap_.raw_data(), common_.width_, common_.height_, common_.width_);
+    grid_sampled_buffer buf(pixmap_, common_.width_, common_.height_);
 
     render_polygon_symbolizer<vertex_converter_type>(
       sym, feature, prj_trans, common_, common_.query_extent_, *ras_ptr,
@@ -0,0 +1,515 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/histogram_quantizer.hpp>
+#include <mapnik/executor.hpp>
+#include <mapnik/image_kernels.hpp>
+#ifdef SSE_MATH
+#include <mapnik/sse.hpp>
+#endif
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <exception>
+
+namespace mapnik {
+
+namespace detail {
+
+namespace {
+
+inline std::uint32_t channel_mask(unsigned shift)
+{
+    std::uint32_t m = (0xffu << shift) & 0xffu;
+    return m | (m << 8) | (m << 16) | (m << 24);
+}
+
+}
+
+color_histogram::color_histogram()
+    : table_(std::size_t(1) << min_bits),
+      size_(0),
+      holes_(0),
+      bits_(min_bits),
+      shift_(0),
+      mask_(channel_mask(0)) {}
+
+// requires a table with at least one free slot, an empty slot has count == 0
+std::size_t color_histogram::slot(std::uint32_t key) const
+{
+    std::size_t pos = (key * 2654435761u) >> (32 - bits_);
+    std::size_t const wrap = table_.size() - 1;
+    while (table_[pos].count != 0 && table_[pos].key != key)
+    {
+        pos = (pos + 1) & wrap;
+    }
+    return pos;
+}
+
+void color_histogram::add(std::uint32_t key, std::uint32_t count,
+                          std::uint64_t r, std::uint64_t g, std::uint64_t b, std::uint64_t a)
+{
+    key &= mask_;
+    entry & e = table_[slot(key)];
+    if (e.count == 0)
+    {
+        e.key = key;
+        ++size_;
+    }
+    e.count += count;
+    e.r += r;
+    e.g += g;
+    e.b += b;
+    e.a += a;
+    // keep the load factor under 1/2
+    while (2 * size_ > table_.size())
+    {
+        if (bits_ < max_bits) rehash(bits_ + 1, shift_);
+        else rehash(bits_, shift_ + 1);
+    }
+}
+
+void color_histogram::rehash(unsigned bits, unsigned shift)
+{
+    std::vector<entry> old(std::size_t(1) << bits);
+    old.swap(table_);
+    bits_ = bits;
+    shift_ = shift < max_shift ? shift : max_shift;
+    mask_ = channel_mask(shift_);
+    size_ = 0;
+    for (auto const& e : old)
+    {
+        if (e.count == 0) continue;
+        std::uint32_t key = e.key & mask_;
+        entry & dst = table_[slot(key)];
+        if (dst.count == 0)
+        {
+            dst.key = key;
+            ++size_;
+        }
+        dst.count += e.count;
+        dst.r += e.r;
+        dst.g += e.g;
+        dst.b += e.b;
+        dst.a += e.a;
+    }
+}
+
+void color_histogram::insert(std::uint32_t const* pixels, std::size_t size)
+{
+    std::size_t i = 0;
+    while (i < size)
+    {
+        std::uint32_t val = pixels[i];
+        std::size_t run = i + 1;
+        while (run < size && pixels[run] == val) ++run;
+        std::uint32_t count = static_cast<std::uint32_t>(run - i);
+        i = run;
+        if (val == 0)
+        {
+            holes_ += count;
+            continue;
+        }
+        add(val, count,
+            std::uint64_t(U2RED(val)) * count,
+            std::uint64_t(U2GREEN(val)) * count,
+            std::uint64_t(U2BLUE(val)) * count,
+            std::uint64_t(U2ALPHA(val)) * count);
+    }
+}
+
+void color_histogram::merge(color_histogram const& other)
+{
+    holes_ += other.holes_;
+    if (other.shift_ > shift_) rehash(bits_, other.shift_);
+    for (auto const& e : other.table_)
+    {
+        if (e.count != 0) add(e.key, e.count, e.r, e.g, e.b, e.a);
+    }
+}
+
+color_histogram::entry const* color_histogram::find(std::uint32_t val) const
+{
+    entry const& e = table_[slot(val & mask_)];
+    return e.count != 0 ? &e : nullptr;
+}
+
+namespace {
+
+struct color_point
+{
+    float c[4];
+    std::uint32_t count;
+    std::size_t entry;
+};
+
+struct color_box
+{
+    std::size_t begin;
+    std::size_t end;
+    double error;
+    unsigned axis;
+    float mean[4];
+};
+
+// weighted mean, squared error and widest axis of the points in box
+void measure(color_box & box, std::vector<color_point> const& points)
+{
+    double sum[4] = { 0, 0, 0, 0 };
+    double sum2[4] = { 0, 0, 0, 0 };
+    double weight = 0;
+    for (std::size_t i = box.begin; i < box.end; ++i)
+    {
+        color_point const& p = points[i];
+        for (unsigned k = 0; k < 4; ++k)
+        {
+            sum[k] += double(p.c[k]) * p.count;
+            sum2[k] += double(p.c[k]) * p.c[k] * p.count;
+        }
+        weight += p.count;
+    }
+    box.error = 0;
+    box.axis = 0;
+    double max_error = -1;
+    for (unsigned k = 0; k < 4; ++k)
+    {
+        double error = sum2[k] - sum[k] * sum[k] / weight;
+        box.mean[k] = static_cast<float>(sum[k] / weight);
+        box.error += error;
+        if (error > max_error)
+        {
+            max_error = error;
+            box.axis = k;
+        }
+    }
+    if (box.end - box.begin < 2) box.error = 0;
+}
+
+// splits box along its widest axis where the summed squared error
+// of the two halves is the smallest
+color_box split(color_box & box, std::vector<color_point> & points)
+{
+    unsigned axis = box.axis;
+    std::sort(points.begin() + box.begin, points.begin() + box.end,
+              [axis](color_point const& a, color_point const& b) { return a.c[axis] < b.c[axis]; });
+    double total[4] = { 0, 0, 0, 0 };
+    double weight = 0;
+    for (std::size_t i = box.begin; i < box.end; ++i)
+    {
+        color_point const& p = points[i];
+        for (unsigned k = 0; k < 4; ++k)
+        {
+            total[k] += double(p.c[k]) * p.count;
+        }
+        weight += p.count;
+    }
+    // the squared terms are the same for any split, only the means matter
+    double sum[4] = { 0, 0, 0, 0 };
+    double left = 0;
+    double best = -1;
+    std::size_t mid = box.begin + 1;
+    for (std::size_t i = box.begin; i < box.end - 1; ++i)
+    {
+        color_point const& p = points[i];
+        double gain = 0;
+        double gain_right = 0;
+        left += p.count;
+        for (unsigned k = 0; k < 4; ++k)
+        {
+            sum[k] += double(p.c[k]) * p.count;
+            gain += sum[k] * sum[k];
+            gain_right += (total[k] - sum[k]) * (total[k] - sum[k]);
+        }
+        gain = gain / left + gain_right / (weight - left);
+        if (gain > best && p.c[axis] != points[i + 1].c[axis])
+        {
+            best = gain;
+            mid = i + 1;
+        }
+    }
+    color_box other = box;
+    other.begin = mid;
+    box.end = mid;
+    measure(box, points);
+    measure(other, points);
+    return other;
+}
+
+}
+
+}
+
+histogram_quantizer::histogram_quantizer(unsigned max_colors)
+    : max_colors_(std::max(1u, std::min(max_colors, 256u))),
+      trans_mode_(-1),
+      gamma_(2.0),
+      threads_(1),
+      histogram_(),
+      holes_index_(-1),
+      palette_(),
+      alpha_table_(),
+      color_hashmap_()
+{
+#ifdef USE_DENSE_HASH_MAP
+    color_hashmap_.set_empty_key(0);
+#endif
+}
+
+void histogram_quantizer::set_trans_mode(int trans_mode)
+{
+    trans_mode_ = trans_mode;
+}
+
+void histogram_quantizer::set_gamma(double gamma)
+{
+    if (gamma > 0) gamma_ = gamma;
+}
+
+void histogram_quantizer::set_threads(unsigned threads)
+{
+    threads_ = std::max(1u, threads);
+}
+
+// applies trans_mode, pixels dropped from the palette become 0
+std::uint32_t histogram_quantizer::preprocess(std::uint32_t val) const
+{
+    std::uint32_t a = U2ALPHA(val);
+    switch (trans_mode_)
+    {
+    case 0:
+        return val | 0xff000000;
+    case 1:
+        return a < 127 ? 0 : val | 0xff000000;
+    default:
+        return a < MIN_ALPHA ? 0 : val;
+    }
+}
+
+void histogram_quantizer::preprocess_row(std::uint32_t const* row, std::uint32_t * out, std::size_t width) const
+{
+    std::size_t x = 0;
+#ifdef SSE_MATH
+    __m128i const opaque = _mm_set1_epi32(static_cast<int>(0xff000000));
+    __m128i const threshold = _mm_set1_epi32(trans_mode_ == 1 ? 126 : static_cast<int>(MIN_ALPHA) - 1);
+    for (; x < ROUND_DOWN(width, 4); x += 4)
+    {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<__m128i const*>(row + x));
+        if (trans_mode_ == 0)
+        {
+            px = _mm_or_si128(px, opaque);
+        }
+        else
+        {
+            __m128i keep = _mm_cmpgt_epi32(_mm_srli_epi32(px, 24), threshold);
+            if (trans_mode_ == 1) px = _mm_or_si128(px, opaque);
+            px = _mm_and_si128(px, keep);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), px);
+    }
+#endif
+    for (; x < width; ++x)
+    {
+        out[x] = preprocess(row[x]);
+    }
+}
+
+void histogram_quantizer::insert_rows(std::vector<std::uint32_t const*> const& rows, std::size_t width,
+                                      bool premultiplied)
+{
+    auto insert_band = [&](detail::color_histogram & histogram, std::size_t y0, std::size_t y1)
+    {
+        std::vector<std::uint32_t> buffer(width);
+        std::vector<std::uint32_t> demultiplied(premultiplied ? width : 0);
+        for (std::size_t y = y0; y < y1; ++y)
+        {
+            std::uint32_t const* row = rows[y];
+            if (premultiplied)
+            {
+                std::copy(row, row + width, demultiplied.begin());
+                simd::rgba8().demultiply(demultiplied.data(), width);
+                row = demultiplied.data();
+            }
+            preprocess_row(row, buffer.data(), width);
+            histogram.insert(buffer.data(), width);
+        }
+    };
+    std::size_t height = rows.size();
+    // below this many pixels a thread costs more than it saves
+    std::size_t const min_pixels_per_thread = 512 * 512;
+    std::size_t num_bands = std::min(static_cast<std::size_t>(threads_),
+                                     width * height / min_pixels_per_thread);
+    if (num_bands > 1)
+    {
+        // the first band goes straight into histogram_, the others are merged
+        std::size_t band = (height + num_bands - 1) / num_bands;
+        std::vector<detail::color_histogram> histograms(num_bands - 1);
+        parallel_for(num_bands, num_bands, [&](std::size_t i) {
+            std::size_t y0 = std::min(i * band, height);
+            insert_band(i == 0 ? histogram_ : histograms[i - 1], y0, std::min(y0 + band, height));
+        });
+        for (auto const& histogram : histograms)
+        {
+            histogram_.merge(histogram);
+        }
+        return;
+    }
+    insert_band(histogram_, 0, height);
+}
+
+void histogram_quantizer::create_palette()
+{
+    palette_.clear();
+    alpha_table_.clear();
+    color_hashmap_.clear();
+    holes_index_ = -1;
+
+    // points in gamma corrected space to give dark colors more room
+    float gamma_lut[256];
+    for (unsigned i = 0; i < 256; ++i)
+    {
+        gamma_lut[i] = static_cast<float>(255 * std::pow(i / 255.0, 1 / gamma_));
+    }
+    auto & entries = histogram_.entries();
+    std::vector<detail::color_point> points;
+    points.reserve(histogram_.size());
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        auto const& e = entries[i];
+        if (e.count == 0) continue;
+        detail::color_point p;
+        p.c[0] = gamma_lut[e.r / e.count];
+        p.c[1] = gamma_lut[e.g / e.count];
+        p.c[2] = gamma_lut[e.b / e.count];
+        p.c[3] = static_cast<float>(e.a) / e.count;
+        p.count = e.count;
+        p.entry = i;
+        points.push_back(p);
+    }
+
+    bool has_holes = histogram_.holes() > 0 || points.empty();
+    std::size_t max_boxes = max_colors_ - (has_holes ? 1 : 0);
+    std::vector<detail::color_box> boxes;
+    if (!points.empty() && max_boxes > 0)
+    {
+        detail::color_box box;
+        box.begin = 0;
+        box.end = points.size();
+        detail::measure(box, points);
+        boxes.push_back(box);
+        while (boxes.size() < max_boxes)
+        {
+            auto itr = std::max_element(boxes.begin(), boxes.end(),
+                                        [](detail::color_box const& a, detail::color_box const& b) {
+                                            return a.error < b.error;
+                                        });
+            if (itr->error <= 0) break;
+            detail::color_box other = detail::split(*itr, points);
+            boxes.push_back(other);
+        }
+    }
+
+    std::vector<rgba> colors;
+    colors.reserve(boxes.size() + 1);
+    if (has_holes) colors.emplace_back(0, 0, 0, 0);
+    for (auto const& box : boxes)
+    {
+        auto to_channel = [this](float v) {
+            return static_cast<std::uint8_t>(std::round(255 * std::pow(std::max(0.0f, v) / 255.0, gamma_)));
+        };
+        unsigned a = static_cast<unsigned>(std::round(box.mean[3]));
+        if (a > MAX_ALPHA) a = 255;
+        if (a < MIN_ALPHA) a = 0;
+        colors.emplace_back(to_channel(box.mean[0]), to_channel(box.mean[1]),
+                            to_channel(box.mean[2]), static_cast<std::uint8_t>(a));
+    }
+
+    // colors with a < 255 go first so the png tRNS chunk stays short
+    std::vector<unsigned> remap(colors.size());
+    for (unsigned pass = 0; pass < 2; ++pass)
+    {
+        for (std::size_t i = 0; i < colors.size(); ++i)
+        {
+            if ((colors[i].a < 255) == (pass == 0))
+            {
+                remap[i] = static_cast<unsigned>(palette_.size());
+                palette_.emplace_back(colors[i]);
+                alpha_table_.push_back(colors[i].a);
+            }
+        }
+    }
+    if (has_holes) holes_index_ = static_cast<int>(remap[0]);
+    std::size_t first_box = has_holes ? 1 : 0;
+    for (std::size_t i = 0; i < boxes.size(); ++i)
+    {
+        for (std::size_t j = boxes[i].begin; j < boxes[i].end; ++j)
+        {
+            entries[points[j].entry].index = remap[first_box + i];
+        }
+    }
+}
+
+unsigned char histogram_quantizer::nearest(std::uint32_t val) const
+{
+    int r = U2RED(val);
+    int g = U2GREEN(val);
+    int b = U2BLUE(val);
+    int a = U2ALPHA(val);
+    unsigned char index = 0;
+    int dist = std::numeric_limits<int>::max();
+    for (std::size_t i = 0; i < palette_.size(); ++i)
+    {
+        int dr = palette_[i].r - r;
+        int dg = palette_[i].g - g;
+        int db = palette_[i].b - b;
+        int da = static_cast<int>(alpha_table_[i]) - a;
+        int d = dr * dr + dg * dg + db * db + da * da;
+        if (d < dist)
+        {
+            dist = d;
+            index = static_cast<unsigned char>(i);
+        }
+    }
+    return index;
+}
+
+unsigned char histogram_quantizer::quantize(unsigned val) const
+{
+    if (palette_.empty()) return 0;
+    std::uint32_t pixel = preprocess(val);
+    if (pixel == 0)
+    {
+        return holes_index_ >= 0 ? static_cast<unsigned char>(holes_index_) : nearest(0);
+    }
+    detail::color_histogram::entry const* e = histogram_.find(pixel);
+    if (e) return static_cast<unsigned char>(e->index);
+    // a color the palette was not built from
+    auto itr = color_hashmap_.find(pixel);
+    if (itr != color_hashmap_.end()) return itr->second;
+    unsigned char index = nearest(pixel);
+    color_hashmap_[pixel] = index;
+    return index;
+}
+
+}
@@ -27,6 +27,13 @@
 #include <mapnik/image_impl.hpp>
 #include <mapnik/pixel_types.hpp>
 
+// stl
+#include <new>
+#include <stdexcept>
+#if !defined(_WINDOWS)
+#include <sys/mman.h>
+#endif
+
 namespace mapnik
 {
 
@@ -34,41 +41,61 @@ namespace detail
 {
 
 // BUFFER
-buffer::buffer(std::size_t size)
+namespace {
+
+#if !defined(_WINDOWS)
+constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+std::size_t mapping_size(std::size_t size, image_storage storage)
+{
+    if (storage != image_storage::huge_pages) return size;
+    return (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+}
+#endif
+
+}
+
+buffer::buffer(std::size_t size, image_storage storage)
     : size_(size),
-      data_(static_cast<unsigned char*>(size_ != 0 ? ::operator new(size_) : nullptr)),
-      owns_(true)
-{}
+      data_(nullptr),
+      storage_(storage)
+{
+    allocate();
+}
 
 buffer::buffer(unsigned char* data, std::size_t size)
     : size_(size),
       data_(data),
-      owns_(false)
+      storage_(image_storage::external)
 {}
 
 // move
 buffer::buffer(buffer && rhs) noexcept
 : size_(rhs.size_),
     data_(rhs.data_),
-    owns_(rhs.owns_)
+    storage_(rhs.storage_)
 {
     rhs.size_ = 0;
     rhs.data_ = nullptr;
-    rhs.owns_ = false;
+    rhs.storage_ = image_storage::external;
 }
 // copy
 buffer::buffer(buffer const& rhs)
     : size_(rhs.size_),
-      data_(static_cast<unsigned char*>((rhs.owns_ && size_ != 0) ? ::operator new(size_) : nullptr)),
-      owns_(rhs.owns_)
+      data_(rhs.data_),
+      storage_(rhs.storage_)
 {
-    if (data_) std::copy(rhs.data_, rhs.data_ + rhs.size_, data_);
-    else data_ = rhs.data_;
+    // external buffers are shared, not copied
+    if (storage_ != image_storage::external)
+    {
+        allocate();
+        if (data_) std::copy(rhs.data_, rhs.data_ + rhs.size_, data_);
+    }
 }
 
 buffer::~buffer()
 {
-    if (owns_) ::operator delete(data_);
+    deallocate();
 }
 
 buffer& buffer::operator=(buffer rhs)
@@ -77,11 +104,70 @@ buffer& buffer::operator=(buffer rhs)
     return *this;
 }
 
+void buffer::allocate()
+{
+    data_ = nullptr;
+    if (storage_ == image_storage::external)
+    {
+        throw std::runtime_error("image with external storage constructed without data");
+    }
+#if defined(_WINDOWS)
+    storage_ = image_storage::heap;
+#endif
+    if (size_ == 0) return;
+    if (storage_ == image_storage::heap)
+    {
+        data_ = static_cast<unsigned char*>(::operator new(size_));
+        return;
+    }
+#if !defined(_WINDOWS)
+    std::size_t length = mapping_size(size_, storage_);
+    void * addr = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    if (storage_ == image_storage::huge_pages)
+    {
+        // needs pages reserved by the administrator
+        addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (addr == MAP_FAILED)
+    {
+        addr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) throw std::bad_alloc();
+#if defined(MADV_HUGEPAGE)
+        if (storage_ == image_storage::huge_pages) ::madvise(addr, length, MADV_HUGEPAGE);
+#endif
+    }
+    data_ = static_cast<unsigned char*>(addr);
+#endif
+}
+
+void buffer::deallocate()
+{
+    if (data_ == nullptr) return;
+    switch (storage_)
+    {
+    case image_storage::heap:
+        ::operator delete(data_);
+        break;
+    case image_storage::mapped:
+    case image_storage::huge_pages:
+#if !defined(_WINDOWS)
+        ::munmap(data_, mapping_size(size_, storage_));
+#endif
+        break;
+    case image_storage::external:
+        break;
+    }
+    data_ = nullptr;
+}
+
 void buffer::swap(buffer & rhs)
 {
     std::swap(size_, rhs.size_);
     std::swap(data_, rhs.data_);
-    std::swap(owns_, rhs.owns_);
+    std::swap(storage_, rhs.storage_);
 }
 
 template struct MAPNIK_DECL image_dimensions<65535>;
@@ -227,42 +227,74 @@ MAPNIK_DECL void image_any::set_scaling(double val)
 }
 
 
-MAPNIK_DECL image_any create_image_any(int width,
-                                       int height,
-                                       image_dtype type,
-                                       bool initialize,
-                                       bool premultiplied,
-                                       bool painted)
+namespace detail {
+
+// constructs the image_any of type from the image<T> constructor arguments
+template <typename... Args>
+image_any make_image_any(image_dtype type, Args && ... args)
 {
     switch (type)
     {
     case image_dtype_gray8:
-        return image_any(image_gray8(width, height, initialize, premultiplied, painted));
+        return image_any(image_gray8(std::forward<Args>(args)...));
     case image_dtype_gray8s:
-        return image_any(image_gray8s(width, height, initialize, premultiplied, painted));
+        return image_any(image_gray8s(std::forward<Args>(args)...));
     case image_dtype_gray16:
-        return image_any(image_gray16(width, height, initialize, premultiplied, painted));
+        return image_any(image_gray16(std::forward<Args>(args)...));
     case image_dtype_gray16s:
-        return image_any(image_gray16s(width, height, initialize, premultiplied, painted));
+        return image_any(image_gray16s(std::forward<Args>(args)...));
     case image_dtype_gray32:
-        return image_any(image_gray32(width, height, initialize, premultiplied, painted));
+        return image_any(image_gray32(std::forward<Args>(args)...));
     case image_dtype_gray32s:
-        return image_any(image_gray32s(width, height, initialize, premultiplied, painted));
+        return image_any(image_gray32s(std::forward<Args>(args)...));
     case image_dtype_gray32f:
-        return image_any(image_gray32f(width, height, initialize, premultiplied, painted));
+        return image_any(image_gray32f(std::forward<Args>(args)...));
     case image_dtype_gray64:
-        return image_any(image_gray64(width, height, initialize, premultiplied, painted));
+        return image_any(image_gray64(std::forward<Args>(args)...));
     case image_dtype_gray64s:
-        return image_any(image_gray64s(width, height, initialize, premultiplied, painted));
+        return image_any(image_gray64s(std::forward<Args>(args)...));
     case image_dtype_gray64f:
-        return image_any(image_gray64f(width, height, initialize, premultiplied, painted));
+        return image_any(image_gray64f(std::forward<Args>(args)...));
     case image_dtype_null:
         return image_any(image_null());
     case image_dtype_rgba8:
     case IMAGE_DTYPE_MAX:
     default:
-        return image_any(image_rgba8(width, height, initialize, premultiplied, painted));
+        return image_any(image_rgba8(std::forward<Args>(args)...));
     }
 }
 
+} // namespace detail
+
+MAPNIK_DECL image_any create_image_any(int width,
+                                       int height,
+                                       image_dtype type,
+                                       bool initialize,
+                                       bool premultiplied,
+                                       bool painted)
+{
+    return detail::make_image_any(type, width, height, initialize, premultiplied, painted);
+}
+
+MAPNIK_DECL image_any create_image_any(int width,
+                                       int height,
+                                       image_dtype type,
+                                       image_storage storage,
+                                       bool initialize,
+                                       bool premultiplied,
+                                       bool painted)
+{
+    return detail::make_image_any(type, width, height, storage, initialize, premultiplied, painted);
+}
+
+MAPNIK_DECL image_any create_image_any(int width,
+                                       int height,
+                                       image_dtype type,
+                                       unsigned char* data,
+                                       bool premultiplied,
+                                       bool painted)
+{
+    return detail::make_image_any(type, width, height, data, premultiplied, painted);
+}
+
 } // end mapnik ns
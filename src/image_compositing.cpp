@@ -24,8 +24,12 @@
 #include <mapnik/image_compositing.hpp>
 #include <mapnik/image.hpp>
 #include <mapnik/image_any.hpp>
+#include <mapnik/geometry/box2d.hpp>
 #include <mapnik/safe_cast.hpp>
 #include <mapnik/util/const_rendering_buffer.hpp>
+#ifdef SSE_MATH
+#include <mapnik/sse.hpp>
+#endif
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -44,6 +48,10 @@
 #include "agg_color_rgba.h"
 #pragma GCC diagnostic pop
 
+// stl
+#include <algorithm>
+#include <cstdint>
+
 namespace mapnik
 {
 
@@ -124,11 +132,190 @@ For example, if you generate some pattern with AGG (premultiplied) and would lik
 
 */
 
+namespace detail {
+
+// Common operators get their own row loop instead of going through the
+// per pixel comp_op table. Results are identical to the agg blenders,
+// under SSE_MATH four pixels are blended at a time with 16 bit lanes.
+// Only the low byte of each lane is kept, which is what the agg blenders
+// do when they cast to value_type.
+
+#ifdef SSE_MATH
+// (a * b + 255) >> 8 as used throughout agg_pixfmt_rgba.h
+inline __m128i mul_255(__m128i a, __m128i b)
+{
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(255)), 8);
+}
+
+inline __m128i alpha_16(__m128i v)
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+inline __m128i select_16(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+struct src_over_op
+{
+    using agg_op = agg::comp_op_rgba_src_over<agg::rgba8, agg::order_rgba>;
+#ifdef SSE_MATH
+    static __m128i blend(__m128i d, __m128i s, __m128i cover)
+    {
+        s = mul_255(s, cover);
+        __m128i s1a = _mm_sub_epi16(_mm_set1_epi16(255), alpha_16(s));
+        return _mm_add_epi16(s, mul_255(d, s1a));
+    }
+#endif
+};
+
+struct multiply_op
+{
+    using agg_op = agg::comp_op_rgba_multiply<agg::rgba8, agg::order_rgba>;
+#ifdef SSE_MATH
+    static __m128i blend(__m128i d, __m128i s, __m128i cover)
+    {
+        __m128i const base_mask = _mm_set1_epi16(255);
+        s = mul_255(s, cover);
+        __m128i sa = alpha_16(s);
+        __m128i da = alpha_16(d);
+        __m128i s1a = _mm_sub_epi16(base_mask, sa);
+        __m128i d1a = _mm_sub_epi16(base_mask, da);
+        __m128i color = _mm_add_epi16(_mm_mullo_epi16(s, d), _mm_mullo_epi16(s, d1a));
+        color = _mm_add_epi16(color, _mm_mullo_epi16(d, s1a));
+        color = _mm_srli_epi16(_mm_add_epi16(color, base_mask), 8);
+        __m128i alpha = _mm_sub_epi16(_mm_add_epi16(sa, da), mul_255(sa, da));
+        __m128i result = select_16(_mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0), alpha, color);
+        return select_16(_mm_cmpeq_epi16(sa, _mm_setzero_si128()), d, result);
+    }
+#endif
+};
+
+struct screen_op
+{
+    using agg_op = agg::comp_op_rgba_screen<agg::rgba8, agg::order_rgba>;
+#ifdef SSE_MATH
+    static __m128i blend(__m128i d, __m128i s, __m128i cover)
+    {
+        s = mul_255(s, cover);
+        __m128i result = _mm_sub_epi16(_mm_add_epi16(s, d), mul_255(s, d));
+        return select_16(_mm_cmpeq_epi16(alpha_16(s), _mm_setzero_si128()), d, result);
+    }
+#endif
+};
+
+struct dst_in_op
+{
+    using agg_op = agg::comp_op_rgba_dst_in<agg::rgba8, agg::order_rgba>;
+#ifdef SSE_MATH
+    static __m128i blend(__m128i d, __m128i s, __m128i cover)
+    {
+        __m128i const base_mask = _mm_set1_epi16(255);
+        __m128i sa = _mm_sub_epi16(base_mask, mul_255(cover, _mm_sub_epi16(base_mask, alpha_16(s))));
+        return mul_255(d, sa);
+    }
+#endif
+};
+
+struct dst_out_op
+{
+    using agg_op = agg::comp_op_rgba_dst_out<agg::rgba8, agg::order_rgba>;
+#ifdef SSE_MATH
+    static __m128i blend(__m128i d, __m128i s, __m128i cover)
+    {
+        __m128i s1a = _mm_sub_epi16(_mm_set1_epi16(255), alpha_16(mul_255(s, cover)));
+        // agg rounds with base_shift rather than base_mask here
+        return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(d, s1a), _mm_set1_epi16(8)), 8);
+    }
+#endif
+};
+
+template <typename Op>
+void composite_row(std::uint32_t * dst, std::uint32_t const* src, std::size_t len, unsigned cover)
+{
+    std::size_t x = 0;
+#ifdef SSE_MATH
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const low_byte = _mm_set1_epi16(0xff);
+    __m128i const cover_16 = _mm_set1_epi16(static_cast<short>(cover));
+    for (; x < ROUND_DOWN(len, 4); x += 4)
+    {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + x));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i const*>(dst + x));
+        __m128i lo = Op::blend(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), cover_16);
+        __m128i hi = Op::blend(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), cover_16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x),
+                         _mm_packus_epi16(_mm_and_si128(lo, low_byte), _mm_and_si128(hi, low_byte)));
+    }
+#endif
+    for (; x < len; ++x)
+    {
+        std::uint8_t * p = reinterpret_cast<std::uint8_t*>(dst + x);
+        std::uint8_t const* s = reinterpret_cast<std::uint8_t const*>(src + x);
+        Op::agg_op::blend_pix(p, s[0], s[1], s[2], s[3], cover);
+    }
+}
+
+template <typename Op>
+void composite_rows(image_rgba8 & dst, image_rgba8 const& src, box2d<int> const& src_box,
+                    unsigned cover, int dx, int dy)
+{
+    int x0 = std::max(dx + src_box.minx(), 0);
+    int y0 = std::max(dy + src_box.miny(), 0);
+    int x1 = std::min(dx + src_box.maxx(), static_cast<int>(dst.width()));
+    int y1 = std::min(dy + src_box.maxy(), static_cast<int>(dst.height()));
+    if (x0 >= x1) return;
+    for (int y = y0; y < y1; ++y)
+    {
+        composite_row<Op>(dst.get_row(y) + x0, src.get_row(y - dy) + (x0 - dx), x1 - x0, cover);
+    }
+}
+
+bool composite_direct(image_rgba8 & dst, image_rgba8 const& src, box2d<int> const& src_box,
+                      composite_mode_e mode, unsigned cover, int dx, int dy)
+{
+    switch (mode)
+    {
+    case src_over:
+        composite_rows<src_over_op>(dst, src, src_box, cover, dx, dy);
+        return true;
+    case multiply:
+        composite_rows<multiply_op>(dst, src, src_box, cover, dx, dy);
+        return true;
+    case screen:
+        composite_rows<screen_op>(dst, src, src_box, cover, dx, dy);
+        return true;
+    case dst_in:
+        composite_rows<dst_in_op>(dst, src, src_box, cover, dx, dy);
+        return true;
+    case dst_out:
+        composite_rows<dst_out_op>(dst, src, src_box, cover, dx, dy);
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // end ns
+
 template <>
 MAPNIK_DECL void composite(image_rgba8 & dst, image_rgba8 const& src, composite_mode_e mode,
                float opacity,
                int dx,
                int dy)
+{
+    box2d<int> src_box(0, 0, static_cast<int>(src.width()), static_cast<int>(src.height()));
+    composite(dst, src, src_box, mode, opacity, dx, dy);
+}
+
+MAPNIK_DECL void composite(image_rgba8 & dst, image_rgba8 const& src,
+               box2d<int> const& src_box,
+               composite_mode_e mode,
+               float opacity,
+               int dx,
+               int dy)
 {
     using color = agg::rgba8;
     using order = agg::order_rgba;
@@ -137,11 +324,6 @@ MAPNIK_DECL void composite(image_rgba8 & dst, image_rgba8 const& src, composite_
     using pixfmt_type = agg::pixfmt_custom_blend_rgba<blender_type, agg::rendering_buffer>;
     using renderer_type = agg::renderer_base<pixfmt_type>;
 
-    agg::rendering_buffer dst_buffer(dst.bytes(),safe_cast<unsigned>(dst.width()),safe_cast<unsigned>(dst.height()),safe_cast<int>(dst.row_size()));
-    const_rendering_buffer src_buffer(src);
-    pixfmt_type pixf(dst_buffer);
-    pixf.comp_op(static_cast<agg::comp_op_e>(mode));
-    agg::pixfmt_alpha_blend_rgba<agg::blender_rgba32_pre, const_rendering_buffer, agg::pixel32_type> pixf_mask(src_buffer);
 #ifdef MAPNIK_DEBUG
     if (!src.get_premultiplied())
     {
@@ -152,8 +334,78 @@ MAPNIK_DECL void composite(image_rgba8 & dst, image_rgba8 const& src, composite_
         throw std::runtime_error("DESTINATION MUST BE PREMULTIPLIED FOR COMPOSITING!");
     }
 #endif
+    agg::cover_type cover = safe_cast<agg::cover_type>(255*opacity);
+    if (src_box.width() <= 0 || src_box.height() <= 0)
+    {
+        return;
+    }
+    if (!composite_keeps_opaque(mode)) dst.set_opaque(false);
+    if (&dst != &src && detail::composite_direct(dst, src, src_box, mode, cover, dx, dy))
+    {
+        return;
+    }
+    agg::rendering_buffer dst_buffer(dst.bytes(),safe_cast<unsigned>(dst.width()),safe_cast<unsigned>(dst.height()),safe_cast<int>(dst.row_size()));
+    const_rendering_buffer src_buffer(src);
+    pixfmt_type pixf(dst_buffer);
+    pixf.comp_op(static_cast<agg::comp_op_e>(mode));
+    agg::pixfmt_alpha_blend_rgba<agg::blender_rgba32_pre, const_rendering_buffer, agg::pixel32_type> pixf_mask(src_buffer);
     renderer_type ren(pixf);
-    ren.blend_from(pixf_mask,0,dx,dy,safe_cast<agg::cover_type>(255*opacity));
+    // agg takes the source rectangle with inclusive max corner
+    agg::rect_i src_rect(src_box.minx(), src_box.miny(), src_box.maxx() - 1, src_box.maxy() - 1);
+    ren.blend_from(pixf_mask,&src_rect,dx,dy,cover);
+}
+
+MAPNIK_DECL bool composite_keeps_destination(composite_mode_e mode)
+{
+    switch (mode)
+    {
+    case dst:
+    case src_over:
+    case dst_over:
+    case src_atop:
+    case dst_out:
+    case _xor:
+    case plus:
+    case minus:
+    case multiply:
+    case screen:
+    case darken:
+    case lighten:
+        return true;
+    default:
+        return false;
+    }
+}
+
+MAPNIK_DECL bool composite_keeps_opaque(composite_mode_e mode)
+{
+    switch (mode)
+    {
+    case dst:
+    case src_over:
+    case dst_over:
+    case src_atop:
+    case plus:
+    case multiply:
+    case screen:
+    case overlay:
+    case darken:
+    case lighten:
+    case color_dodge:
+    case color_burn:
+    case hard_light:
+    case soft_light:
+    case difference:
+    case exclusion:
+    case invert:
+    case invert_rgb:
+    case grain_merge:
+    case linear_dodge:
+    case linear_burn:
+        return true;
+    default:
+        return false;
+    }
 }
 
 template <>
@@ -0,0 +1,535 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/image_kernels.hpp>
+
+// stl
+#include <algorithm>
+#ifdef MAPNIK_THREADSAFE
+#include <atomic>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MAPNIK_SIMD_X86 1
+#include <immintrin.h>
+#define MAPNIK_TARGET_SSE2 __attribute__((target("sse2")))
+#define MAPNIK_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define MAPNIK_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace mapnik { namespace simd {
+
+namespace {
+
+// scalar, also the tail of the vector loops
+
+inline void premultiply_pixel(std::uint32_t & p)
+{
+    std::uint32_t a = p >> 24;
+    if (a < 255)
+    {
+        // (c * a + 255) >> 8 is 0 with a == 0, agg's special case
+        std::uint32_t r = ((p & 0xff) * a + 255) >> 8;
+        std::uint32_t g = (((p >> 8) & 0xff) * a + 255) >> 8;
+        std::uint32_t b = (((p >> 16) & 0xff) * a + 255) >> 8;
+        p = (a << 24) | (b << 16) | (g << 8) | r;
+    }
+}
+
+inline void demultiply_pixel(std::uint32_t & p)
+{
+    std::uint32_t a = p >> 24;
+    if (a == 0)
+    {
+        p = 0;
+    }
+    else if (a < 255)
+    {
+        std::uint32_t r = std::min(255u, ((p & 0xff) * 255) / a);
+        std::uint32_t g = std::min(255u, (((p >> 8) & 0xff) * 255) / a);
+        std::uint32_t b = std::min(255u, (((p >> 16) & 0xff) * 255) / a);
+        p = (a << 24) | (b << 16) | (g << 8) | r;
+    }
+}
+
+inline void apply_opacity_pixel(std::uint32_t & p, float opacity)
+{
+    std::uint32_t a = static_cast<std::uint32_t>((p >> 24) * opacity);
+    p = (a << 24) | (p & 0x00ffffff);
+}
+
+void premultiply_scalar(std::uint32_t * pixels, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) premultiply_pixel(pixels[i]);
+}
+
+void demultiply_scalar(std::uint32_t * pixels, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) demultiply_pixel(pixels[i]);
+}
+
+void apply_opacity_scalar(std::uint32_t * pixels, std::size_t count, float opacity)
+{
+    for (std::size_t i = 0; i < count; ++i) apply_opacity_pixel(pixels[i], opacity);
+}
+
+bool all_equal_scalar(std::uint32_t const* pixels, std::size_t count, std::uint32_t value)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (pixels[i] != value) return false;
+    }
+    return true;
+}
+
+void set_color_to_alpha_scalar(std::uint32_t * pixels, std::size_t count, std::uint32_t rgb)
+{
+    rgb &= 0x00ffffff;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if ((pixels[i] & 0x00ffffff) == rgb) pixels[i] = 0;
+    }
+}
+
+rgba8_kernels const scalar_kernels = {
+    isa::scalar, "scalar",
+    premultiply_scalar,
+    demultiply_scalar,
+    apply_opacity_scalar,
+    all_equal_scalar,
+    set_color_to_alpha_scalar
+};
+
+#ifdef MAPNIK_SIMD_X86
+
+// sse2, 4 pixels at a time
+
+MAPNIK_TARGET_SSE2
+inline __m128i premultiply_half_sse2(__m128i px)
+{
+    // px holds two pixels as 16 bit channels
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(px, a), _mm_set1_epi16(255)), 8);
+}
+
+MAPNIK_TARGET_SSE2
+void premultiply_sse2(std::uint32_t * pixels, std::size_t count)
+{
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const alpha_mask = _mm_set1_epi32(static_cast<int>(0xff000000));
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + i));
+        __m128i lo = premultiply_half_sse2(_mm_unpacklo_epi8(v, zero));
+        __m128i hi = premultiply_half_sse2(_mm_unpackhi_epi8(v, zero));
+        __m128i rgb = _mm_andnot_si128(alpha_mask, _mm_packus_epi16(lo, hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i),
+                         _mm_or_si128(rgb, _mm_and_si128(v, alpha_mask)));
+    }
+    premultiply_scalar(pixels + i, count - i);
+}
+
+// c * 255 / a in single precision truncates to the integer quotient:
+// its rounding error (below 2^-16) is less than any non zero remainder (1 / 254)
+MAPNIK_TARGET_SSE2
+inline __m128i demultiply_channel_sse2(__m128i c, __m128 fa)
+{
+    __m128 q = _mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(c), _mm_set1_ps(255.0f)), fa);
+    // NaN and infinity from a == 0 turn into 255 here and are masked out later
+    return _mm_cvttps_epi32(_mm_min_ps(q, _mm_set1_ps(255.0f)));
+}
+
+MAPNIK_TARGET_SSE2
+void demultiply_sse2(std::uint32_t * pixels, std::size_t count)
+{
+    __m128i const mask = _mm_set1_epi32(0xff);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + i));
+        __m128i a = _mm_srli_epi32(v, 24);
+        __m128 fa = _mm_cvtepi32_ps(a);
+        __m128i r = demultiply_channel_sse2(_mm_and_si128(v, mask), fa);
+        __m128i g = demultiply_channel_sse2(_mm_and_si128(_mm_srli_epi32(v, 8), mask), fa);
+        __m128i b = demultiply_channel_sse2(_mm_and_si128(_mm_srli_epi32(v, 16), mask), fa);
+        __m128i out = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+                                   _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+        out = _mm_andnot_si128(_mm_cmpeq_epi32(a, _mm_setzero_si128()), out);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), out);
+    }
+    demultiply_scalar(pixels + i, count - i);
+}
+
+MAPNIK_TARGET_SSE2
+void apply_opacity_sse2(std::uint32_t * pixels, std::size_t count, float opacity)
+{
+    __m128 const op = _mm_set1_ps(opacity);
+    __m128i const rgb_mask = _mm_set1_epi32(0x00ffffff);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + i));
+        __m128i a = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(v, 24)), op));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i),
+                         _mm_or_si128(_mm_and_si128(v, rgb_mask), _mm_slli_epi32(a, 24)));
+    }
+    apply_opacity_scalar(pixels + i, count - i, opacity);
+}
+
+MAPNIK_TARGET_SSE2
+bool all_equal_sse2(std::uint32_t const* pixels, std::size_t count, std::uint32_t value)
+{
+    __m128i const val = _mm_set1_epi32(static_cast<int>(value));
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, val)) != 0xffff) return false;
+    }
+    return all_equal_scalar(pixels + i, count - i, value);
+}
+
+MAPNIK_TARGET_SSE2
+void set_color_to_alpha_sse2(std::uint32_t * pixels, std::size_t count, std::uint32_t rgb)
+{
+    __m128i const rgb_mask = _mm_set1_epi32(0x00ffffff);
+    __m128i const key = _mm_set1_epi32(static_cast<int>(rgb & 0x00ffffff));
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixels + i));
+        __m128i match = _mm_cmpeq_epi32(_mm_and_si128(v, rgb_mask), key);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm_andnot_si128(match, v));
+    }
+    set_color_to_alpha_scalar(pixels + i, count - i, rgb);
+}
+
+rgba8_kernels const sse2_kernels = {
+    isa::sse2, "sse2",
+    premultiply_sse2,
+    demultiply_sse2,
+    apply_opacity_sse2,
+    all_equal_sse2,
+    set_color_to_alpha_sse2
+};
+
+// avx2, 8 pixels at a time, same steps as the sse2 kernels
+
+MAPNIK_TARGET_AVX2
+inline __m256i premultiply_half_avx2(__m256i px)
+{
+    __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(px, a), _mm256_set1_epi16(255)), 8);
+}
+
+MAPNIK_TARGET_AVX2
+void premultiply_avx2(std::uint32_t * pixels, std::size_t count)
+{
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const alpha_mask = _mm256_set1_epi32(static_cast<int>(0xff000000));
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pixels + i));
+        // unpack and pack work within 128 bit lanes, so the pixel order is kept
+        __m256i lo = premultiply_half_avx2(_mm256_unpacklo_epi8(v, zero));
+        __m256i hi = premultiply_half_avx2(_mm256_unpackhi_epi8(v, zero));
+        __m256i rgb = _mm256_andnot_si256(alpha_mask, _mm256_packus_epi16(lo, hi));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i),
+                            _mm256_or_si256(rgb, _mm256_and_si256(v, alpha_mask)));
+    }
+    premultiply_scalar(pixels + i, count - i);
+}
+
+MAPNIK_TARGET_AVX2
+inline __m256i demultiply_channel_avx2(__m256i c, __m256 fa)
+{
+    __m256 q = _mm256_div_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(c), _mm256_set1_ps(255.0f)), fa);
+    return _mm256_cvttps_epi32(_mm256_min_ps(q, _mm256_set1_ps(255.0f)));
+}
+
+MAPNIK_TARGET_AVX2
+void demultiply_avx2(std::uint32_t * pixels, std::size_t count)
+{
+    __m256i const mask = _mm256_set1_epi32(0xff);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pixels + i));
+        __m256i a = _mm256_srli_epi32(v, 24);
+        __m256 fa = _mm256_cvtepi32_ps(a);
+        __m256i r = demultiply_channel_avx2(_mm256_and_si256(v, mask), fa);
+        __m256i g = demultiply_channel_avx2(_mm256_and_si256(_mm256_srli_epi32(v, 8), mask), fa);
+        __m256i b = demultiply_channel_avx2(_mm256_and_si256(_mm256_srli_epi32(v, 16), mask), fa);
+        __m256i out = _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 8)),
+                                      _mm256_or_si256(_mm256_slli_epi32(b, 16), _mm256_slli_epi32(a, 24)));
+        out = _mm256_andnot_si256(_mm256_cmpeq_epi32(a, _mm256_setzero_si256()), out);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), out);
+    }
+    demultiply_scalar(pixels + i, count - i);
+}
+
+MAPNIK_TARGET_AVX2
+void apply_opacity_avx2(std::uint32_t * pixels, std::size_t count, float opacity)
+{
+    __m256 const op = _mm256_set1_ps(opacity);
+    __m256i const rgb_mask = _mm256_set1_epi32(0x00ffffff);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pixels + i));
+        __m256i a = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(v, 24)), op));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i),
+                            _mm256_or_si256(_mm256_and_si256(v, rgb_mask), _mm256_slli_epi32(a, 24)));
+    }
+    apply_opacity_scalar(pixels + i, count - i, opacity);
+}
+
+MAPNIK_TARGET_AVX2
+bool all_equal_avx2(std::uint32_t const* pixels, std::size_t count, std::uint32_t value)
+{
+    __m256i const val = _mm256_set1_epi32(static_cast<int>(value));
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pixels + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(v, val)) != -1) return false;
+    }
+    return all_equal_scalar(pixels + i, count - i, value);
+}
+
+MAPNIK_TARGET_AVX2
+void set_color_to_alpha_avx2(std::uint32_t * pixels, std::size_t count, std::uint32_t rgb)
+{
+    __m256i const rgb_mask = _mm256_set1_epi32(0x00ffffff);
+    __m256i const key = _mm256_set1_epi32(static_cast<int>(rgb & 0x00ffffff));
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pixels + i));
+        __m256i match = _mm256_cmpeq_epi32(_mm256_and_si256(v, rgb_mask), key);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), _mm256_andnot_si256(match, v));
+    }
+    set_color_to_alpha_scalar(pixels + i, count - i, rgb);
+}
+
+rgba8_kernels const avx2_kernels = {
+    isa::avx2, "avx2",
+    premultiply_avx2,
+    demultiply_avx2,
+    apply_opacity_avx2,
+    all_equal_avx2,
+    set_color_to_alpha_avx2
+};
+
+#endif // MAPNIK_SIMD_X86
+
+#ifdef MAPNIK_SIMD_NEON
+
+// neon (aarch64), 4 pixels at a time as 32 bit channels
+
+inline uint32x4_t channel(uint32x4_t v, int shift)
+{
+    return vandq_u32(vshlq_u32(v, vdupq_n_s32(-shift)), vdupq_n_u32(0xff));
+}
+
+inline uint32x4_t pack(uint32x4_t r, uint32x4_t g, uint32x4_t b, uint32x4_t a)
+{
+    return vorrq_u32(vorrq_u32(r, vshlq_n_u32(g, 8)), vorrq_u32(vshlq_n_u32(b, 16), vshlq_n_u32(a, 24)));
+}
+
+inline uint32x4_t premultiply_channel_neon(uint32x4_t c, uint32x4_t a)
+{
+    return vshrq_n_u32(vmlaq_u32(vdupq_n_u32(255), c, a), 8);
+}
+
+void premultiply_neon(std::uint32_t * pixels, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32x4_t v = vld1q_u32(pixels + i);
+        uint32x4_t a = vshrq_n_u32(v, 24);
+        vst1q_u32(pixels + i, pack(premultiply_channel_neon(channel(v, 0), a),
+                                   premultiply_channel_neon(channel(v, 8), a),
+                                   premultiply_channel_neon(channel(v, 16), a), a));
+    }
+    premultiply_scalar(pixels + i, count - i);
+}
+
+inline uint32x4_t demultiply_channel_neon(uint32x4_t c, float32x4_t fa)
+{
+    float32x4_t q = vdivq_f32(vmulq_n_f32(vcvtq_f32_u32(c), 255.0f), fa);
+    return vcvtq_u32_f32(vminq_f32(q, vdupq_n_f32(255.0f)));
+}
+
+void demultiply_neon(std::uint32_t * pixels, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32x4_t v = vld1q_u32(pixels + i);
+        uint32x4_t a = vshrq_n_u32(v, 24);
+        float32x4_t fa = vcvtq_f32_u32(a);
+        uint32x4_t out = pack(demultiply_channel_neon(channel(v, 0), fa),
+                              demultiply_channel_neon(channel(v, 8), fa),
+                              demultiply_channel_neon(channel(v, 16), fa), a);
+        vst1q_u32(pixels + i, vbicq_u32(out, vceqq_u32(a, vdupq_n_u32(0))));
+    }
+    demultiply_scalar(pixels + i, count - i);
+}
+
+void apply_opacity_neon(std::uint32_t * pixels, std::size_t count, float opacity)
+{
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32x4_t v = vld1q_u32(pixels + i);
+        uint32x4_t a = vcvtq_u32_f32(vmulq_n_f32(vcvtq_f32_u32(vshrq_n_u32(v, 24)), opacity));
+        vst1q_u32(pixels + i, vorrq_u32(vandq_u32(v, vdupq_n_u32(0x00ffffff)), vshlq_n_u32(a, 24)));
+    }
+    apply_opacity_scalar(pixels + i, count - i, opacity);
+}
+
+bool all_equal_neon(std::uint32_t const* pixels, std::size_t count, std::uint32_t value)
+{
+    uint32x4_t const val = vdupq_n_u32(value);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        if (vminvq_u32(vceqq_u32(vld1q_u32(pixels + i), val)) == 0) return false;
+    }
+    return all_equal_scalar(pixels + i, count - i, value);
+}
+
+void set_color_to_alpha_neon(std::uint32_t * pixels, std::size_t count, std::uint32_t rgb)
+{
+    uint32x4_t const rgb_mask = vdupq_n_u32(0x00ffffff);
+    uint32x4_t const key = vdupq_n_u32(rgb & 0x00ffffff);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32x4_t v = vld1q_u32(pixels + i);
+        vst1q_u32(pixels + i, vbicq_u32(v, vceqq_u32(vandq_u32(v, rgb_mask), key)));
+    }
+    set_color_to_alpha_scalar(pixels + i, count - i, rgb);
+}
+
+rgba8_kernels const neon_kernels = {
+    isa::neon, "neon",
+    premultiply_neon,
+    demultiply_neon,
+    apply_opacity_neon,
+    all_equal_neon,
+    set_color_to_alpha_neon
+};
+
+#endif // MAPNIK_SIMD_NEON
+
+rgba8_kernels const* best_kernels()
+{
+    if (supported(isa::avx2)) return &rgba8(isa::avx2);
+    if (supported(isa::sse2)) return &rgba8(isa::sse2);
+    if (supported(isa::neon)) return &rgba8(isa::neon);
+    return &scalar_kernels;
+}
+
+#ifdef MAPNIK_THREADSAFE
+std::atomic<rgba8_kernels const*> & active_kernels()
+{
+    static std::atomic<rgba8_kernels const*> active(best_kernels());
+    return active;
+}
+#else
+rgba8_kernels const* & active_kernels()
+{
+    static rgba8_kernels const* active = best_kernels();
+    return active;
+}
+#endif
+
+} // anonymous ns
+
+bool supported(isa id)
+{
+    switch (id)
+    {
+    case isa::scalar:
+        return true;
+#ifdef MAPNIK_SIMD_X86
+    case isa::sse2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case isa::avx2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef MAPNIK_SIMD_NEON
+    case isa::neon:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+rgba8_kernels const& rgba8(isa id)
+{
+    if (supported(id))
+    {
+        switch (id)
+        {
+#ifdef MAPNIK_SIMD_X86
+        case isa::sse2:
+            return sse2_kernels;
+        case isa::avx2:
+            return avx2_kernels;
+#endif
+#ifdef MAPNIK_SIMD_NEON
+        case isa::neon:
+            return neon_kernels;
+#endif
+        default:
+            break;
+        }
+    }
+    return scalar_kernels;
+}
+
+rgba8_kernels const& rgba8()
+{
+    return *active_kernels();
+}
+
+bool select(isa id)
+{
+    if (!supported(id)) return false;
+    active_kernels() = &rgba8(id);
+    return true;
+}
+
+}}
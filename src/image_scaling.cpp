@@ -24,6 +24,7 @@
 #include <mapnik/image.hpp>
 #include <mapnik/image_scaling.hpp>
 #include <mapnik/image_scaling_traits.hpp>
+#include <mapnik/executor.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -49,6 +50,11 @@
 #include "agg_image_filters.h"
 #pragma GCC diagnostic pop
 
+// stl
+#include <algorithm>
+#include <exception>
+#include <vector>
+
 namespace mapnik
 {
 
@@ -99,7 +105,8 @@ boost::optional<std::string> scaling_method_to_string(scaling_method_e scaling_m
 template <typename T>
 void scale_image_agg(T & target, T const& source, scaling_method_e scaling_method,
                      double image_ratio_x, double image_ratio_y, double x_off_f, double y_off_f,
-                     double filter_factor, boost::optional<double> const & nodata_value)
+                     double filter_factor, boost::optional<double> const & nodata_value,
+                     unsigned threads)
 {
     // "the image filters should work namely in the premultiplied color space"
     // http://old.nabble.com/Re:--AGG--Basic-image-transformations-p1110665.html
@@ -114,89 +121,101 @@ void scale_image_agg(T & target, T const& source, scaling_method_e scaling_metho
     using renderer_base_pre = agg::renderer_base<pixfmt_pre>;
     constexpr std::size_t pixel_size = sizeof(pixel_type);
 
-    // define some stuff we'll use soon
-    agg::rasterizer_scanline_aa<> ras;
-    agg::scanline_u8 sl;
-    agg::span_allocator<color_type> sa;
-
     // initialize source AGG buffer
     agg::rendering_buffer rbuf_src(const_cast<unsigned char*>(source.bytes()),
                                    source.width(), source.height(), source.width() * pixel_size);
     pixfmt_pre pixf_src(rbuf_src);
 
-    img_src_type img_src(pixf_src);
-
     // initialize destination AGG buffer (with transparency)
     agg::rendering_buffer rbuf_dst(target.bytes(), target.width(), target.height(), target.width() * pixel_size);
     pixfmt_pre pixf_dst(rbuf_dst);
-    renderer_base_pre rb_dst_pre(pixf_dst);
 
     // create a scaling matrix
     agg::trans_affine img_mtx;
     img_mtx *= agg::trans_affine_translation(x_off_f, y_off_f);
     img_mtx /= agg::trans_affine_scaling(image_ratio_x, image_ratio_y);
 
-    // create a linear interpolator for our scaling matrix
-    interpolator_type interpolator(img_mtx);
-    // draw an anticlockwise polygon to render our image into
-    double scaled_width = target.width();
-    double scaled_height = target.height();
-    ras.reset();
-    ras.move_to_d(0.0, 0.0);
-    ras.line_to_d(scaled_width, 0.0);
-    ras.line_to_d(scaled_width, scaled_height);
-    ras.line_to_d(0.0, scaled_height);
-    if (scaling_method == SCALING_NEAR)
+    // the filter weights only depend on the method, so they are computed
+    // once and shared read-only by every band
+    agg::image_filter_lut filter;
+    if (scaling_method != SCALING_NEAR)
     {
-        using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_filter;
-        span_gen_type sg(img_src, interpolator);
-        agg::render_scanlines_aa(ras, sl, rb_dst_pre, sa, sg);
-    }
-    else
-    {
-        using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_resample_affine;
-        agg::image_filter_lut filter;
         detail::set_scaling_method(filter, scaling_method, filter_factor);
-        boost::optional<typename span_gen_type::value_type> nodata;
-        if (nodata_value)
+    }
+
+    // every destination pixel only depends on its own position, so rows
+    // can be rendered in independent bands without changing the output
+    double scaled_width = target.width();
+    auto render_rows = [&](std::size_t y0, std::size_t y1) {
+        agg::rasterizer_scanline_aa<> ras;
+        agg::scanline_u8 sl;
+        agg::span_allocator<color_type> sa;
+        img_src_type img_src(pixf_src);
+        renderer_base_pre rb_dst_pre(pixf_dst);
+        // create a linear interpolator for our scaling matrix
+        interpolator_type interpolator(img_mtx);
+        // draw an anticlockwise polygon to render our image into
+        ras.reset();
+        ras.move_to_d(0.0, y0);
+        ras.line_to_d(scaled_width, y0);
+        ras.line_to_d(scaled_width, y1);
+        ras.line_to_d(0.0, y1);
+        if (scaling_method == SCALING_NEAR)
         {
-            nodata = nodata_value;
+            using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_filter;
+            span_gen_type sg(img_src, interpolator);
+            agg::render_scanlines_aa(ras, sl, rb_dst_pre, sa, sg);
         }
-        span_gen_type sg(img_src, interpolator, filter, nodata);
-        agg::render_scanlines_aa(ras, sl, rb_dst_pre, sa, sg);
-    }
+        else
+        {
+            using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_resample_affine;
+            boost::optional<typename span_gen_type::value_type> nodata;
+            if (nodata_value)
+            {
+                nodata = nodata_value;
+            }
+            span_gen_type sg(img_src, interpolator, filter, nodata);
+            agg::render_scanlines_aa(ras, sl, rb_dst_pre, sa, sg);
+        }
+    };
+
+    std::size_t height = target.height();
+    // below this many pixels a thread costs more than it saves
+    std::size_t const min_pixels_per_thread = 256 * 256;
+    parallel_bands(height, std::min(static_cast<std::size_t>(threads),
+                                    target.width() * height / min_pixels_per_thread), render_rows);
 }
 
 template MAPNIK_DECL void scale_image_agg(image_rgba8 &, image_rgba8 const&, scaling_method_e,
-                              double, double , double, double , double, boost::optional<double> const &);
+                              double, double , double, double , double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void scale_image_agg(image_gray8 &, image_gray8 const&, scaling_method_e,
-                              double, double , double, double , double, boost::optional<double> const &);
+                              double, double , double, double , double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void scale_image_agg(image_gray8s &, image_gray8s const&, scaling_method_e,
-                              double, double , double, double , double, boost::optional<double> const &);
+                              double, double , double, double , double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void scale_image_agg(image_gray16 &, image_gray16 const&, scaling_method_e,
-                              double, double , double, double , double, boost::optional<double> const &);
+                              double, double , double, double , double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void scale_image_agg(image_gray16s &, image_gray16s const&, scaling_method_e,
-                              double, double , double, double , double, boost::optional<double> const &);
+                              double, double , double, double , double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void scale_image_agg(image_gray32 &, image_gray32 const&, scaling_method_e,
-                              double, double , double, double , double, boost::optional<double> const &);
+                              double, double , double, double , double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void scale_image_agg(image_gray32s &, image_gray32s const&, scaling_method_e,
-                              double, double , double, double , double, boost::optional<double> const &);
+                              double, double , double, double , double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void scale_image_agg(image_gray32f &, image_gray32f const&, scaling_method_e,
-                              double, double , double, double , double, boost::optional<double> const &);
+                              double, double , double, double , double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void scale_image_agg(image_gray64 &, image_gray64 const&, scaling_method_e,
-                              double, double , double, double , double, boost::optional<double> const &);
+                              double, double , double, double , double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void scale_image_agg(image_gray64s &, image_gray64s const&, scaling_method_e,
-                              double, double , double, double , double, boost::optional<double> const &);
+                              double, double , double, double , double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void scale_image_agg(image_gray64f &, image_gray64f const&, scaling_method_e,
-                              double, double , double, double , double, boost::optional<double> const &);
+                              double, double , double, double , double, boost::optional<double> const &, unsigned);
 }
@@ -0,0 +1,241 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/image_tile_cache.hpp>
+#include <mapnik/image_reader.hpp>
+#include <mapnik/query_scheduler.hpp>
+#include <mapnik/debug.hpp>
+#include <mapnik/util/fs.hpp>
+
+// stl
+#include <algorithm>
+#include <cstring>
+
+namespace mapnik
+{
+
+template class singleton<image_tile_cache, CreateStatic>;
+
+constexpr std::size_t image_tile_cache::max_pending;
+
+namespace {
+
+image_tile_cache::image_ptr decode(std::string const& file, std::string const& format,
+                                   unsigned decode_threads)
+{
+    std::unique_ptr<image_reader> reader(get_image_reader(file, format));
+    if (!reader) return image_tile_cache::image_ptr();
+    reader->set_decode_threads(decode_threads);
+    return std::make_shared<image_any const>(reader->read(0, 0, reader->width(), reader->height()));
+}
+
+}
+
+image_tile_cache::image_tile_cache()
+    : entries_(),
+      lru_(),
+      pending_(),
+      max_bytes_(0),
+      num_bytes_(0),
+      hits_(0),
+      misses_(0) {}
+
+void image_tile_cache::set_max_bytes(std::size_t max_bytes)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    max_bytes_ = max_bytes;
+    evict();
+}
+
+std::size_t image_tile_cache::max_bytes() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return max_bytes_;
+}
+
+image_tile_cache::image_ptr image_tile_cache::get(std::string const& file, std::string const& format,
+                                                  unsigned decode_threads)
+{
+    key_type key(file, format, 0, 0);
+    // files that can not be inspected are decoded without caching, failing there
+    if (!util::file_stat(file, std::get<2>(key), std::get<3>(key))) return decode(file, format, decode_threads);
+    image_ptr image = find(key);
+    if (image) return image;
+    // decoded outside the lock, racing threads may each decode the same file
+    image = decode(file, format, decode_threads);
+    if (image) insert(key, image);
+    return image;
+}
+
+void image_tile_cache::prefetch(std::string const& file, std::string const& format,
+                                unsigned decode_threads)
+{
+    if (query_scheduler::instance().threads() == 0) return;
+    key_type key(file, format, 0, 0);
+    if (!util::file_stat(file, std::get<2>(key), std::get<3>(key))) return;
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        if (max_bytes_ == 0 || pending_.size() >= max_pending ||
+            entries_.find(key) != entries_.end() ||
+            !pending_.insert(key).second)
+        {
+            return;
+        }
+    }
+    // the handle is dropped, the decode runs on a worker thread
+    query_scheduler::instance().submit("image_tile_cache", [this, key, decode_threads]() {
+        try
+        {
+            image_ptr image = decode(std::get<0>(key), std::get<1>(key), decode_threads);
+            if (image) insert(key, image);
+        }
+        catch (std::exception const& ex)
+        {
+            MAPNIK_LOG_DEBUG(image_tile_cache) << "image_tile_cache: could not decode "
+                                               << std::get<0>(key) << ": " << ex.what();
+        }
+        {
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::mutex> lock(mutex_);
+#endif
+            pending_.erase(key);
+        }
+        return featureset_ptr();
+    });
+}
+
+image_any image_tile_cache::window(image_any const& image, std::size_t x, std::size_t y,
+                                   std::size_t width, std::size_t height)
+{
+    if (x >= image.width() || y >= image.height()) return image_any();
+    width = std::min(width, image.width() - x);
+    height = std::min(height, image.height() - y);
+    if (width == 0 || height == 0) return image_any();
+    image_any data = create_image_any(static_cast<int>(width), static_cast<int>(height),
+                                      image.get_dtype(), false,
+                                      image.get_premultiplied(), image.painted());
+    data.set_offset(image.get_offset());
+    data.set_scaling(image.get_scaling());
+    std::size_t pixel_size = image.row_size() / image.width();
+    std::size_t row_bytes = width * pixel_size;
+    unsigned char const* src = image.bytes() + y * image.row_size() + x * pixel_size;
+    unsigned char * dst = data.bytes();
+    for (std::size_t row = 0; row < height; ++row)
+    {
+        std::memcpy(dst, src, row_bytes);
+        src += image.row_size();
+        dst += data.row_size();
+    }
+    return data;
+}
+
+std::size_t image_tile_cache::size() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return entries_.size();
+}
+
+std::size_t image_tile_cache::size_bytes() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return num_bytes_;
+}
+
+std::size_t image_tile_cache::hits() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return hits_;
+}
+
+std::size_t image_tile_cache::misses() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return misses_;
+}
+
+void image_tile_cache::clear()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    entries_.clear();
+    lru_.clear();
+    num_bytes_ = 0;
+    hits_ = 0;
+    misses_ = 0;
+}
+
+image_tile_cache::image_ptr image_tile_cache::find(key_type const& key)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    auto itr = entries_.find(key);
+    if (itr == entries_.end())
+    {
+        ++misses_;
+        return image_ptr();
+    }
+    ++hits_;
+    lru_.splice(lru_.begin(), lru_, itr->second.lru);
+    return itr->second.image;
+}
+
+void image_tile_cache::insert(key_type const& key, image_ptr const& image)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    if (image->size() > max_bytes_ || entries_.find(key) != entries_.end()) return;
+    lru_.push_front(key);
+    entries_.emplace(key, entry{image, lru_.begin()});
+    num_bytes_ += image->size();
+    evict();
+}
+
+void image_tile_cache::evict()
+{
+    while (num_bytes_ > max_bytes_ && !lru_.empty())
+    {
+        auto itr = entries_.find(lru_.back());
+        num_bytes_ -= itr->second.image->size();
+        entries_.erase(itr);
+        lru_.pop_back();
+    }
+}
+
+}
@@ -36,6 +36,10 @@
 #include <mapnik/util/variant.hpp>
 #include <mapnik/debug.hpp>
 #include <mapnik/safe_cast.hpp>
+#include <mapnik/trace.hpp>
+#include <mapnik/image_kernels.hpp>
+#include <mapnik/solid_tile_cache.hpp>
+#include <mapnik/executor.hpp>
 #ifdef SSE_MATH
 #include <mapnik/sse.hpp>
 #endif
@@ -52,15 +56,81 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <exception>
+#include <functional>
+#include <vector>
 
 namespace mapnik
 {
 
+namespace {
+
+// key of solid rgba8 images in the solid_tile_cache
+struct solid_key_visitor
+{
+    using key_type = solid_tile_cache::key_type;
+
+    solid_key_visitor(std::string const& type)
+        : type_(type) {}
+
+    boost::optional<key_type> operator() (image_rgba8 const& image) const
+    {
+        return key(image);
+    }
+
+    boost::optional<key_type> operator() (image_view_rgba8 const& image) const
+    {
+        return key(image);
+    }
+
+    template <typename T>
+    boost::optional<key_type> operator() (T const&) const
+    {
+        return boost::none;
+    }
+
+private:
+    template <typename T>
+    boost::optional<key_type> key(T const& image) const
+    {
+        if (image.width() == 0 || image.height() == 0 || !is_solid(image))
+        {
+            return boost::none;
+        }
+        return key_type(type_, image.width(), image.height(),
+                        image.get_row(0)[0], image.get_premultiplied());
+    }
+
+    std::string const& type_;
+};
+
+template <typename T>
+boost::optional<solid_tile_cache::key_type> solid_key(T const& image, std::string const& type)
+{
+    if (solid_tile_cache::instance().max_bytes() == 0) return boost::none;
+    return solid_key_visitor(type)(image);
+}
+
+boost::optional<solid_tile_cache::key_type> solid_key(image_any const& image, std::string const& type)
+{
+    if (solid_tile_cache::instance().max_bytes() == 0) return boost::none;
+    return util::apply_visitor(solid_key_visitor(type), image);
+}
+
+boost::optional<solid_tile_cache::key_type> solid_key(image_view_any const& image, std::string const& type)
+{
+    if (solid_tile_cache::instance().max_bytes() == 0) return boost::none;
+    return util::apply_visitor(solid_key_visitor(type), image);
+}
+
+} // anonymous ns
+
 template <typename T>
 MAPNIK_DECL std::string save_to_string(T const& image,
                                        std::string const& type,
                                        rgba_palette const& palette)
 {
+    trace::scope encode_trace("image", "encode", type);
     std::ostringstream ss(std::ios::out|std::ios::binary);
     save_to_stream(image, ss, type, palette);
     return ss.str();
@@ -70,9 +140,20 @@ template <typename T>
 MAPNIK_DECL std::string save_to_string(T const& image,
                                        std::string const& type)
 {
+    boost::optional<solid_tile_cache::key_type> key = solid_key(image, type);
+    if (key)
+    {
+        if (solid_tile_cache::buffer_ptr buffer = solid_tile_cache::instance().find(*key))
+        {
+            return *buffer;
+        }
+    }
+    trace::scope encode_trace("image", "encode", type);
     std::ostringstream ss(std::ios::out|std::ios::binary);
     save_to_stream(image, ss, type);
-    return ss.str();
+    std::string out = ss.str();
+    if (key) solid_tile_cache::instance().insert(*key, out);
+    return out;
 }
 
 template <typename T>
@@ -306,6 +387,94 @@ MAPNIK_DECL void save_to_stream<image_view_rgba8>(image_view_rgba8 const& image,
     else throw image_writer_exception("Could not write to empty stream" );
 }
 
+template <typename T>
+MAPNIK_DECL void save_to_buffer(T const& image,
+                                std::string & buffer,
+                                std::string const& type)
+{
+    std::string t = type;
+    std::transform(t.begin(), t.end(), t.begin(), ::tolower);
+    boost::optional<solid_tile_cache::key_type> key = solid_key(image, t);
+    if (key)
+    {
+        if (solid_tile_cache::buffer_ptr cached = solid_tile_cache::instance().find(*key))
+        {
+            buffer += *cached;
+            return;
+        }
+    }
+    std::size_t const start = buffer.size();
+    if (boost::algorithm::starts_with(t, "png"))
+    {
+        save_to_png_string(image, buffer, t);
+    }
+    else if (boost::algorithm::starts_with(t, "jpeg"))
+    {
+        save_to_jpeg_string(image, buffer, t);
+    }
+    else if (boost::algorithm::starts_with(t, "webp"))
+    {
+        save_to_webp_string(image, buffer, t);
+    }
+    else
+    {
+        // save_to_string caches solid images itself
+        buffer += save_to_string(image, t);
+        return;
+    }
+    if (key) solid_tile_cache::instance().insert(*key, buffer.substr(start));
+}
+
+template MAPNIK_DECL void save_to_buffer<image_rgba8>(image_rgba8 const&,
+                                                      std::string &,
+                                                      std::string const&);
+
+template MAPNIK_DECL void save_to_buffer<image_view_rgba8>(image_view_rgba8 const&,
+                                                           std::string &,
+                                                           std::string const&);
+
+MAPNIK_DECL std::vector<std::string> save_tiles_to_string(image_rgba8 const& image,
+                                                          std::string const& type,
+                                                          unsigned tile_width,
+                                                          unsigned tile_height,
+                                                          unsigned threads,
+                                                          bool share_palette)
+{
+    if (tile_width == 0 || tile_height == 0)
+    {
+        throw image_writer_exception("invalid tile size");
+    }
+    std::size_t width = image.width();
+    std::size_t height = image.height();
+    std::size_t columns = (width + tile_width - 1) / tile_width;
+    std::size_t num_tiles = columns * ((height + tile_height - 1) / tile_height);
+    std::string t = type;
+    std::transform(t.begin(), t.end(), t.begin(), ::tolower);
+    std::function<void(image_view_rgba8 const&, std::string &)> encode;
+    if (share_palette && boost::algorithm::starts_with(t, "png"))
+    {
+        encode = make_png_tile_encoder(image, t);
+    }
+    if (!encode)
+    {
+        encode = [&t](image_view_rgba8 const& view, std::string & out) {
+            out.clear();
+            save_to_buffer(view, out, t);
+        };
+    }
+
+    std::vector<std::string> buffers(num_tiles);
+    auto encode_tile = [&](std::size_t i) {
+        std::size_t x = (i % columns) * tile_width;
+        std::size_t y = (i / columns) * tile_height;
+        image_view_rgba8 view(x, y, std::min(width - x, std::size_t(tile_width)),
+                              std::min(height - y, std::size_t(tile_height)), image);
+        encode(view, buffers[i]);
+    };
+    parallel_for(num_tiles, threads, encode_tile);
+    return buffers;
+}
+
 template <typename T>
 MAPNIK_DECL void save_to_file(T const& image, std::string const& filename)
 {
@@ -421,6 +590,29 @@ struct is_solid_visitor
         return true;
     }
 
+    bool operator() (image_rgba8 const& data) const
+    {
+        return data.width() == 0 || data.height() == 0 ||
+            simd::rgba8().all_equal(data.data(), data.width() * data.height(), data.data()[0]);
+    }
+
+    bool operator() (image_view_rgba8 const& data) const
+    {
+        if (data.width() > 0 && data.height() > 0)
+        {
+            auto const& kernels = simd::rgba8();
+            std::uint32_t const first_pixel = data.get_row(0)[0];
+            for (std::size_t y = 0; y < data.height(); ++y)
+            {
+                if (!kernels.all_equal(data.get_row(y), data.width(), first_pixel))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
     template <typename T>
     bool operator() (T const & data) const
     {
@@ -489,6 +681,45 @@ template MAPNIK_DECL bool is_solid(image_view_gray64 const&);
 template MAPNIK_DECL bool is_solid(image_view_gray64s const&);
 template MAPNIK_DECL bool is_solid(image_view_gray64f const&);
 
+MAPNIK_DECL box2d<int> painted_extent(image_rgba8 const& image)
+{
+    int width = static_cast<int>(image.width());
+    int height = static_cast<int>(image.height());
+    auto row_painted = [&](int y) {
+        image_rgba8::pixel_type const* row = image.get_row(static_cast<std::size_t>(y));
+        return std::any_of(row, row + width, [](image_rgba8::pixel_type p) { return p != 0; });
+    };
+    int y0 = 0;
+    while (y0 < height && !row_painted(y0)) ++y0;
+    if (y0 == height) return box2d<int>();
+    int y1 = height;
+    while (!row_painted(y1 - 1)) --y1;
+    // only the columns outside the extent found so far need looking at
+    int x0 = width;
+    int x1 = 0;
+    for (int y = y0; y < y1; ++y)
+    {
+        image_rgba8::pixel_type const* row = image.get_row(static_cast<std::size_t>(y));
+        for (int x = 0; x < x0; ++x)
+        {
+            if (row[x] != 0)
+            {
+                x0 = x;
+                break;
+            }
+        }
+        for (int x = width; x > x1 && x > x0; --x)
+        {
+            if (row[x - 1] != 0)
+            {
+                x1 = x;
+                break;
+            }
+        }
+    }
+    return box2d<int>(x0, y0, x1, y1);
+}
+
 namespace detail {
 
 struct premultiply_visitor
@@ -497,9 +728,7 @@ struct premultiply_visitor
     {
         if (!data.get_premultiplied())
         {
-            agg::rendering_buffer buffer(data.bytes(),safe_cast<unsigned>(data.width()),safe_cast<unsigned>(data.height()),safe_cast<int>(data.row_size()));
-            agg::pixfmt_rgba32 pixf(buffer);
-            pixf.premultiply();
+            simd::rgba8().premultiply(data.data(), data.width() * data.height());
             data.set_premultiplied(true);
             return true;
         }
@@ -519,9 +748,7 @@ struct demultiply_visitor
     {
         if (data.get_premultiplied())
         {
-            agg::rendering_buffer buffer(data.bytes(),safe_cast<unsigned>(data.width()),safe_cast<unsigned>(data.height()),safe_cast<int>(data.row_size()));
-            agg::pixfmt_rgba32_pre pixf(buffer);
-            pixf.demultiply();
+            simd::rgba8().demultiply(data.data(), data.width() * data.height());
             data.set_premultiplied(false);
             return true;
         }
@@ -642,21 +869,8 @@ struct visitor_apply_opacity
 
     void operator() (image_rgba8 & data) const
     {
-        using pixel_type = image_rgba8::pixel_type;
-        for (std::size_t y = 0; y < data.height(); ++y)
-        {
-            pixel_type* row_to =  data.get_row(y);
-            for (std::size_t x = 0; x < data.width(); ++x)
-            {
-                pixel_type rgba = row_to[x];
-                pixel_type a = static_cast<pixel_type>(((rgba >> 24u) & 0xff) * opacity_);
-                pixel_type r = rgba & 0xff;
-                pixel_type g = (rgba >> 8u ) & 0xff;
-                pixel_type b = (rgba >> 16u) & 0xff;
-
-                row_to[x] = (a << 24u) | (b << 16u) |  (g << 8u) | (r) ;
-            }
-        }
+        simd::rgba8().apply_opacity(data.data(), data.width() * data.height(), opacity_);
+        data.set_opaque(false);
     }
 
     template <typename T>
@@ -730,6 +944,7 @@ struct visitor_set_grayscale_to_alpha
                 row_from[x] = (a << 24u) | (255 << 16u) |  (255 << 8u) | (255u) ;
             }
         }
+        data.set_opaque(false);
     }
 
     template <typename T>
@@ -766,6 +981,7 @@ struct visitor_set_grayscale_to_alpha_c
                               static_cast<unsigned>(c_.red() );
             }
         }
+        data.set_opaque(false);
     }
 
     template <typename T>
@@ -861,22 +1077,9 @@ struct visitor_set_color_to_alpha
 
     void operator() (image_rgba8 & data) const
     {
-        using pixel_type = image_rgba8::pixel_type;
-        for (std::size_t y = 0; y < data.height(); ++y)
-        {
-            pixel_type* row_from = data.get_row(y);
-            for (std::size_t x = 0; x < data.width(); ++x)
-            {
-                pixel_type rgba = row_from[x];
-                pixel_type r = rgba & 0xff;
-                pixel_type g = (rgba >> 8 ) & 0xff;
-                pixel_type b = (rgba >> 16) & 0xff;
-                if (r == c_.red() && g == c_.green() && b == c_.blue())
-                {
-                    row_from[x] = 0;
-                }
-            }
-        }
+        std::uint32_t rgb = c_.red() | (c_.green() << 8) | (c_.blue() << 16);
+        simd::rgba8().set_color_to_alpha(data.data(), data.width() * data.height(), rgb);
+        data.set_opaque(false);
     }
 
     template <typename T>
@@ -78,8 +78,8 @@ int parse_jpeg_quality(std::string const& params)
 
 }
 
-template <typename T>
-void process_rgba8_jpeg(T const& image, std::string const& type, std::ostream & stream)
+template <typename T, typename Out>
+void process_rgba8_jpeg(T const& image, std::string const& type, Out & stream)
 {
 #if defined(HAVE_JPEG)
     int quality = detail::parse_jpeg_quality(type);
@@ -101,6 +101,17 @@ void jpeg_saver::operator()<image_view_rgba8> (image_view_rgba8 const& image) co
     process_rgba8_jpeg(image, t_, stream_);
 }
 
+template <typename T>
+void save_to_jpeg_string(T const& image, std::string & out, std::string const& type)
+{
+    process_rgba8_jpeg(image, type, out);
+}
+
+template MAPNIK_DECL void save_to_jpeg_string<image_rgba8>(image_rgba8 const&, std::string &,
+                                                           std::string const&);
+template MAPNIK_DECL void save_to_jpeg_string<image_view_rgba8>(image_view_rgba8 const&, std::string &,
+                                                                std::string const&);
+
 template<>
 void jpeg_saver::operator()<image_null> (image_null const& image) const
 {
@@ -44,6 +44,8 @@ extern "C"
 #include <mapnik/util/conversions.hpp>
 
 // stl
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <iostream>
 
@@ -83,13 +85,31 @@ void handle_png_options(std::string const& type,
         }
         else if (key == "m" && val)
         {
-            if (*val == "o") opts.use_hextree = false;
-            else if (*val == "h") opts.use_hextree = true;
+            if (*val == "o") opts.quantizer = PNG_QUANTIZER_OCTREE;
+            else if (*val == "h") opts.quantizer = PNG_QUANTIZER_HEXTREE;
+            else if (*val == "hist") opts.quantizer = PNG_QUANTIZER_HISTOGRAM;
+        }
+        else if (key == "j")
+        {
+            int threads = 0;
+            if (!val || !mapnik::util::string2int(*val, threads) || threads < 1)
+            {
+                throw image_writer_exception("invalid threads parameter: " + to_string(val));
+            }
+            opts.threads = static_cast<unsigned>(threads);
         }
         else if (key == "e" && val && *val == "miniz")
         {
             throw image_writer_exception("miniz support has been removed from Mapnik");
         }
+        else if (key == "e" && val && *val == "libpng")
+        {
+            opts.encoder = PNG_ENCODER_LIBPNG;
+        }
+        else if (key == "e" && val && *val == "deflate")
+        {
+            opts.encoder = PNG_ENCODER_DEFLATE;
+        }
         else if (key == "c")
         {
             set_colors = true;
@@ -221,28 +241,34 @@ void png_saver_pal::operator()<image_view_null> (image_view_null const& image) c
     throw image_writer_exception("null image views not supported for png");
 }
 
-template <typename T>
+template <typename T, typename Out>
 void process_rgba8_png_pal(T const& image,
                           std::string const& t,
-                          std::ostream & stream,
+                          Out & stream,
                           rgba_palette const& pal)
 {
 #if defined(HAVE_PNG)
     png_options opts;
     handle_png_options(t, opts);
+    // known opaque images are written without alpha unless asked for
+    if (opts.trans_mode < 0 && image.opaque()) opts.trans_mode = 0;
     if (pal.valid())
     {
         save_as_png8_pal(stream, image, pal, opts);
     }
     else if (opts.paletted)
     {
-        if (opts.use_hextree)
-        {
-            save_as_png8_hex(stream, image, opts);
-        }
-        else
+        switch (opts.quantizer)
         {
+        case PNG_QUANTIZER_OCTREE:
             save_as_png8_oct(stream, image, opts);
+            break;
+        case PNG_QUANTIZER_HISTOGRAM:
+            save_as_png8_hist(stream, image, opts);
+            break;
+        default:
+            save_as_png8_hex(stream, image, opts);
+            break;
         }
     }
     else
@@ -254,23 +280,29 @@ void process_rgba8_png_pal(T const& image,
 #endif
 }
 
-template <typename T>
+template <typename T, typename Out>
 void process_rgba8_png(T const& image,
                           std::string const& t,
-                          std::ostream & stream)
+                          Out & stream)
 {
 #if defined(HAVE_PNG)
     png_options opts;
     handle_png_options(t, opts);
+    // known opaque images are written without alpha unless asked for
+    if (opts.trans_mode < 0 && image.opaque()) opts.trans_mode = 0;
     if (opts.paletted)
     {
-        if (opts.use_hextree)
-        {
-            save_as_png8_hex(stream, image, opts);
-        }
-        else
+        switch (opts.quantizer)
         {
+        case PNG_QUANTIZER_OCTREE:
             save_as_png8_oct(stream, image, opts);
+            break;
+        case PNG_QUANTIZER_HISTOGRAM:
+            save_as_png8_hist(stream, image, opts);
+            break;
+        default:
+            save_as_png8_hex(stream, image, opts);
+            break;
         }
     }
     else
@@ -306,6 +338,57 @@ void png_saver::operator()<image_view_rgba8> (image_view_rgba8 const& image) con
     process_rgba8_png(image, t_, stream_);
 }
 
+template <typename T>
+void save_to_png_string(T const& image, std::string & out, std::string const& type)
+{
+    std::string t = type;
+    std::transform(t.begin(), t.end(), t.begin(), ::tolower);
+    process_rgba8_png(image, t, out);
+}
+
+template <typename T>
+void save_to_png_string(T const& image, std::string & out, std::string const& type,
+                        rgba_palette const& palette)
+{
+    std::string t = type;
+    std::transform(t.begin(), t.end(), t.begin(), ::tolower);
+    process_rgba8_png_pal(image, t, out, palette);
+}
+
+template MAPNIK_DECL void save_to_png_string<image_rgba8>(image_rgba8 const&, std::string &,
+                                                          std::string const&);
+template MAPNIK_DECL void save_to_png_string<image_view_rgba8>(image_view_rgba8 const&, std::string &,
+                                                               std::string const&);
+template MAPNIK_DECL void save_to_png_string<image_rgba8>(image_rgba8 const&, std::string &,
+                                                          std::string const&, rgba_palette const&);
+template MAPNIK_DECL void save_to_png_string<image_view_rgba8>(image_view_rgba8 const&, std::string &,
+                                                               std::string const&, rgba_palette const&);
+
+std::function<void(image_view_rgba8 const&, std::string &)>
+make_png_tile_encoder(image_rgba8 const& image, std::string const& type)
+{
+#if defined(HAVE_PNG)
+    std::string t = type;
+    std::transform(t.begin(), t.end(), t.begin(), ::tolower);
+    png_options opts;
+    handle_png_options(t, opts);
+    if (!opts.paletted) return nullptr;
+    // every color of the tiles is in the histogram, so quantize() never
+    // touches its cache and the quantizer can be shared between threads
+    auto quantizer = std::make_shared<histogram_quantizer>(opts.colors);
+    quantizer->set_trans_mode(opts.trans_mode);
+    quantizer->set_gamma(opts.gamma);
+    quantizer->set_threads(opts.threads);
+    quantizer->insert(image);
+    quantizer->create_palette();
+    return [quantizer, opts](image_view_rgba8 const& view, std::string & out) {
+        save_as_png8_hist(out, view, *quantizer, opts);
+    };
+#else
+    throw image_writer_exception("png output is not enabled in your build of Mapnik");
+#endif
+}
+
 template <typename T>
 void png_saver::operator() (T const& image) const
 {
@@ -142,6 +142,18 @@ void handle_tiff_options(std::string const& type,
                     }
                 }
             }
+            else if (key == "threads")
+            {
+                if (val && !(*val).empty())
+                {
+                    int threads = 0;
+                    if (!mapnik::util::string2int(*val,threads) || threads < 1)
+                    {
+                        throw image_writer_exception("invalid tiff threads: '" + *val + "'");
+                    }
+                    config.threads = static_cast<unsigned>(threads);
+                }
+            }
             else
             {
                 throw image_writer_exception("unhandled tiff option: " + key);
@@ -299,6 +299,20 @@ void handle_webp_options(std::string const& type,
                     }
                 }
             }
+            else if (key == "thread_level")
+            {
+                if (val && !(*val).empty())
+                {
+                    #if WEBP_ENCODER_ABI_VERSION >= 0x0202 // >= v0.4.0
+                    if (!mapnik::util::string2int(*val,config.thread_level) || config.thread_level < 0 || config.thread_level > 1)
+                    {
+                        throw image_writer_exception("invalid webp thread_level: '" + *val + "'");
+                    }
+                    #else
+                    throw image_writer_exception("your webp version does not support the thread_level option");
+                    #endif
+                }
+            }
             else
             {
                 throw image_writer_exception("unhandled webp option: " + key);
@@ -323,8 +337,8 @@ void webp_saver::operator()<image_view_null> (image_view_null const& image) cons
     throw image_writer_exception("null image views not supported");
 }
 
-template <typename T>
-void process_rgba8_webp(T const& image, std::string const& t, std::ostream & stream)
+template <typename T, typename Out>
+void process_rgba8_webp(T const& image, std::string const& t, Out & stream)
 {
 #if defined(HAVE_WEBP)
     WebPConfig config;
@@ -354,6 +368,17 @@ void webp_saver::operator()<image_view_rgba8> (image_view_rgba8 const& image) co
     process_rgba8_webp(image, t_, stream_);
 }
 
+template <typename T>
+void save_to_webp_string(T const& image, std::string & out, std::string const& type)
+{
+    process_rgba8_webp(image, type, out);
+}
+
+template MAPNIK_DECL void save_to_webp_string<image_rgba8>(image_rgba8 const&, std::string &,
+                                                           std::string const&);
+template MAPNIK_DECL void save_to_webp_string<image_view_rgba8>(image_view_rgba8 const&, std::string &,
+                                                                std::string const&);
+
 template <typename T>
 void webp_saver::operator() (T const& image) const
 {
@@ -32,6 +32,7 @@ extern "C"
 }
 
 // std
+#include <algorithm>
 #include <cstdio>
 #include <memory>
 #include <fstream>
@@ -71,6 +72,7 @@ private:
     input_stream stream_;
     unsigned width_;
     unsigned height_;
+    bool premultiply_;
 public:
     explicit jpeg_reader(std::string const& filename);
     explicit jpeg_reader(char const* data, size_t size);
@@ -79,10 +81,15 @@ public:
     unsigned height() const final;
     boost::optional<box2d<double> > bounding_box() const final;
     inline bool has_alpha() const final { return false; }
+    void set_premultiply(bool premultiply) final { premultiply_ = premultiply; }
     void read(unsigned x,unsigned y,image_rgba8& image) final;
     image_any read(unsigned x, unsigned y, unsigned width, unsigned height) final;
+    unsigned max_reduction() const final { return 8; }
+    image_any read_reduced(unsigned x, unsigned y, unsigned width, unsigned height,
+                           unsigned reduction) final;
 private:
     void init();
+    void decode(unsigned x0, unsigned y0, unsigned reduction, image_rgba8& image);
     static void on_error(j_common_ptr cinfo);
     static void on_error_message(j_common_ptr cinfo);
     static void init_source(j_decompress_ptr cinfo);
@@ -114,7 +121,8 @@ jpeg_reader<T>::jpeg_reader(std::string const& filename)
     : source_(),
       stream_(&source_),
       width_(0),
-      height_(0)
+      height_(0),
+      premultiply_(false)
 {
     source_.open(filename, std::ios_base::in | std::ios_base::binary);
     if (!stream_) throw image_reader_exception("cannot open image file "+ filename);
@@ -126,7 +134,8 @@ jpeg_reader<T>::jpeg_reader(char const* data, size_t size)
     : source_(data, size),
       stream_(&source_),
       width_(0),
-      height_(0)
+      height_(0),
+      premultiply_(false)
 {
     if (!stream_) throw image_reader_exception("cannot open image stream");
     init();
@@ -264,6 +273,18 @@ boost::optional<box2d<double> > jpeg_reader<T>::bounding_box() const
 
 template <typename T>
 void jpeg_reader<T>::read(unsigned x0, unsigned y0, image_rgba8& image)
+{
+    // jpeg pixels are opaque, premultiplied as they are
+    if (premultiply_) image.set_premultiplied(true);
+    decode(x0, y0, 1, image);
+}
+
+// Decodes the window of image's size at x0, y0 of the image reduced by
+// reduction. libjpeg-turbo skips the rows above the window without
+// decoding them and the columns around it at iMCU granularity, and writes
+// rgba straight into the rows of image when the window spans whole rows.
+template <typename T>
+void jpeg_reader<T>::decode(unsigned x0, unsigned y0, unsigned reduction, image_rgba8& image)
 {
     stream_.clear();
     stream_.seekg(0, std::ios_base::beg);
@@ -278,43 +299,72 @@ void jpeg_reader<T>::read(unsigned x0, unsigned y0, image_rgba8& image)
     attach_stream(&cinfo, &stream_);
     int ret = jpeg_read_header(&cinfo, TRUE);
     if (ret != JPEG_HEADER_OK) throw image_reader_exception("JPEG Reader read(): failed to read header");
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = reduction;
+#ifdef JCS_EXTENSIONS
+    // the filler byte is set to 0xff, the layout of image_rgba8 pixels
+    bool rgba = cinfo.jpeg_color_space == JCS_YCbCr || cinfo.jpeg_color_space == JCS_RGB;
+    if (rgba) cinfo.out_color_space = JCS_EXT_RGBX;
+#else
+    bool rgba = false;
+#endif
     jpeg_start_decompress(&cinfo);
-    JSAMPARRAY buffer;
-    int row_stride;
-    unsigned char a,r,g,b;
-    row_stride = cinfo.output_width * cinfo.output_components;
-    buffer = (*cinfo.mem->alloc_sarray) ((j_common_ptr) &cinfo, JPOOL_IMAGE, row_stride, 1);
-
-    unsigned w = std::min(unsigned(image.width()),width_ - x0);
-    unsigned h = std::min(unsigned(image.height()),height_ - y0);
-
-    const std::unique_ptr<unsigned int[]> out_row(new unsigned int[w]);
-    unsigned row = 0;
-    while (cinfo.output_scanline < cinfo.output_height)
+
+    if (x0 >= cinfo.output_width || y0 >= cinfo.output_height) return;
+    unsigned w = std::min(unsigned(image.width()), cinfo.output_width - x0);
+    unsigned h = std::min(unsigned(image.height()), cinfo.output_height - y0);
+    JDIMENSION col0 = x0;
+#if defined(LIBJPEG_TURBO_VERSION_NUMBER) && LIBJPEG_TURBO_VERSION_NUMBER >= 1005000
+    if (w < cinfo.output_width)
     {
+        // fancy upsampling blends the pixels at the edges of the crop, one
+        // iMCU (at most 16 pixels) is kept on both sides of the window
+        JDIMENSION crop_x = x0 > 16 ? x0 - 16 : 0;
+        JDIMENSION crop_width = std::min(x0 + w + 16, unsigned(cinfo.output_width)) - crop_x;
+        // widened to iMCU boundaries, output_width is the cropped width then
+        jpeg_crop_scanline(&cinfo, &crop_x, &crop_width);
+        col0 = x0 - crop_x;
+    }
+    if (y0 > 0) jpeg_skip_scanlines(&cinfo, y0);
+#endif
+    bool direct = rgba && col0 == 0 && w == cinfo.output_width;
+    JSAMPARRAY buffer = (*cinfo.mem->alloc_sarray) ((j_common_ptr) &cinfo, JPOOL_IMAGE,
+                                                    cinfo.output_width * cinfo.output_components, 1);
+    const std::unique_ptr<unsigned int[]> out_row(rgba ? nullptr : new unsigned int[w]);
+    while (cinfo.output_scanline < y0 + h)
+    {
+        unsigned row = cinfo.output_scanline;
+        if (direct && row >= y0)
+        {
+            JSAMPROW dest = reinterpret_cast<JSAMPROW>(image.get_row(row - y0));
+            jpeg_read_scanlines(&cinfo, &dest, 1);
+            continue;
+        }
         jpeg_read_scanlines(&cinfo, buffer, 1);
-        if (row >= y0 && row < y0 + h)
+        if (row < y0) continue;
+        if (rgba)
         {
-            for (unsigned int x = 0; x < w; ++x)
+            image.set_row(row - y0, reinterpret_cast<unsigned int const*>(buffer[0]) + col0, w);
+            continue;
+        }
+        for (unsigned int x = 0; x < w; ++x)
+        {
+            unsigned col = (x + col0) * cinfo.output_components;
+            unsigned char r = buffer[0][col];
+            unsigned char g = r;
+            unsigned char b = r;
+            if (cinfo.output_components > 2)
             {
-                unsigned col = x + x0;
-                a = 255; // alpha not supported in jpg
-                r = buffer[0][cinfo.output_components * col];
-                if (cinfo.output_components > 2)
-                {
-                    g = buffer[0][cinfo.output_components * col + 1];
-                    b = buffer[0][cinfo.output_components * col + 2];
-                } else {
-                    g = r;
-                    b = r;
-                }
-                out_row[x] = color(r, g, b, a).rgba();
+                g = buffer[0][col + 1];
+                b = buffer[0][col + 2];
             }
-            image.set_row(row - y0, out_row.get(), w);
+            out_row[x] = color(r, g, b, 255).rgba(); // alpha not supported in jpg
         }
-        ++row;
+        image.set_row(row - y0, out_row.get(), w);
     }
-    jpeg_finish_decompress(&cinfo);
+    // rows below the window are not decoded
+    if (cinfo.output_scanline == cinfo.output_height) jpeg_finish_decompress(&cinfo);
+    else jpeg_abort_decompress(&cinfo);
 }
 
 template <typename T>
@@ -325,4 +375,17 @@ image_any jpeg_reader<T>::read(unsigned x, unsigned y, unsigned width, unsigned
     return image_any(std::move(data));
 }
 
+template <typename T>
+image_any jpeg_reader<T>::read_reduced(unsigned x, unsigned y, unsigned width, unsigned height,
+                                       unsigned reduction)
+{
+    if (reduction != 1 && reduction != 2 && reduction != 4 && reduction != 8)
+    {
+        throw image_reader_exception("JPEG Reader: unsupported reduction");
+    }
+    image_rgba8 data(width,height, true, true);
+    decode(x, y, reduction, data);
+    return image_any(std::move(data));
+}
+
 }
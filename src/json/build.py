@@ -43,6 +43,8 @@ source = Split(
     mapnik_feature_to_geojson.cpp
     mapnik_geometry_to_geojson.cpp
     extract_bounding_boxes_x3.cpp
+    geojson_stream_reader.cpp
+    geojson_writer.cpp
     """
     )
 
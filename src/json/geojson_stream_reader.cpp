@@ -0,0 +1,212 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/json/geojson_stream_reader.hpp>
+
+// stl
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace mapnik { namespace json {
+
+namespace {
+
+// member names and type values kept while scanning the top-level object
+constexpr std::size_t max_short_string = 32;
+
+}
+
+geojson_stream_reader::geojson_stream_reader(read_function read, std::size_t chunk_size)
+    : read_(std::move(read)),
+      chunk_(std::max(chunk_size, std::size_t(1))) {}
+
+geojson_stream_reader::geojson_stream_reader(std::FILE * file, std::size_t chunk_size)
+    : geojson_stream_reader([file](char * buffer, std::size_t size) {
+                                return std::fread(buffer, 1, size, file);
+                            }, chunk_size) {}
+
+geojson_stream_reader::geojson_stream_reader(char const* start, char const* end, std::size_t chunk_size)
+    : geojson_stream_reader([start, end](char * buffer, std::size_t size) mutable {
+                                std::size_t count = std::min(size, static_cast<std::size_t>(end - start));
+                                std::memcpy(buffer, start, count);
+                                start += count;
+                                return count;
+                            }, chunk_size) {}
+
+bool geojson_stream_reader::fill()
+{
+    if (done_) return false;
+    offset_ += size_;
+    pos_ = 0;
+    size_ = read_(chunk_.data(), chunk_.size());
+    if (size_ == 0) done_ = true;
+    return !done_;
+}
+
+bool geojson_stream_reader::next(std::string & feature)
+{
+    feature.clear();
+    for (;;)
+    {
+        if (pos_ == size_ && !fill())
+        {
+            if (depth_ != 0 || in_string_)
+            {
+                throw std::runtime_error("GeoJSON stream: unexpected end of input");
+            }
+            return false;
+        }
+        // copy the runs of a feature in and out of strings in one go
+        if (capture_ && !in_string_)
+        {
+            char const* start = chunk_.data() + pos_;
+            char const* end = chunk_.data() + size_;
+            char const* itr = std::find_if(start, end, [](char c) {
+                    return c == '"' || c == '{' || c == '}' || c == '[' || c == ']';
+                });
+            feature.append(start, itr);
+            pos_ += static_cast<std::size_t>(itr - start);
+            if (itr == end) continue;
+        }
+        else if (capture_ && in_string_ && !escape_)
+        {
+            char const* start = chunk_.data() + pos_;
+            char const* end = chunk_.data() + size_;
+            char const* itr = std::find_if(start, end, [](char c) { return c == '"' || c == '\\'; });
+            feature.append(start, itr);
+            pos_ += static_cast<std::size_t>(itr - start);
+            if (itr == end) continue;
+        }
+        if (consume(chunk_[pos_++], feature)) return true;
+    }
+}
+
+bool geojson_stream_reader::consume(char c, std::string & feature)
+{
+    if (capture_) feature.push_back(c);
+    else if (capture_top_) top_.push_back(c);
+
+    if (in_string_)
+    {
+        if (escape_) escape_ = false;
+        else if (c == '\\') escape_ = true;
+        else if (c == '"')
+        {
+            in_string_ = false;
+            if (depth_ == 1)
+            {
+                if (!expect_value_) last_string_ = string_;
+                else if (key_ == "type")
+                {
+                    type_ = string_;
+                    // a collection is never handed out whole
+                    if (type_ != "Feature")
+                    {
+                        capture_top_ = false;
+                        std::string().swap(top_);
+                    }
+                }
+            }
+            return false;
+        }
+        if (depth_ == 1 && string_.size() <= max_short_string) string_.push_back(c);
+        return false;
+    }
+
+    switch (c)
+    {
+    case '"':
+        in_string_ = true;
+        string_.clear();
+        break;
+    case ':':
+        if (depth_ == 1)
+        {
+            key_ = last_string_;
+            expect_value_ = true;
+        }
+        break;
+    case ',':
+        if (depth_ == 1) expect_value_ = false;
+        break;
+    case '{':
+    case '[':
+        if (depth_ == 0 && c == '{')
+        {
+            // documents may follow each other, as in a GeoJSON text sequence
+            type_.clear();
+            key_.clear();
+            expect_value_ = false;
+            capture_top_ = true;
+            top_.assign(1, c);
+        }
+        else if (depth_ == 1 && c == '[' && expect_value_ && key_ == "features")
+        {
+            in_features_ = true;
+            capture_top_ = false;
+            std::string().swap(top_);
+        }
+        else if (depth_ == 2 && c == '{' && in_features_)
+        {
+            capture_ = true;
+            feature.assign(1, c);
+        }
+        ++depth_;
+        break;
+    case '}':
+    case ']':
+        if (depth_ == 0)
+        {
+            throw std::runtime_error("GeoJSON stream: unbalanced '" + std::string(1, c) + "'");
+        }
+        --depth_;
+        if (depth_ == 2 && capture_)
+        {
+            capture_ = false;
+            return true;
+        }
+        else if (depth_ == 1 && in_features_)
+        {
+            in_features_ = false;
+        }
+        else if (depth_ == 0 && capture_top_)
+        {
+            capture_top_ = false;
+            if (type_ == "Feature")
+            {
+                feature.swap(top_);
+                std::string().swap(top_);
+                return true;
+            }
+            std::string().swap(top_);
+        }
+        break;
+    default:
+        break;
+    }
+    return false;
+}
+
+}}
@@ -0,0 +1,299 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/json/geojson_writer.hpp>
+#include <mapnik/util/text_sink.hpp>
+#include <mapnik/value.hpp>
+#include <mapnik/value/types.hpp>
+// icu
+#include <unicode/bytestream.h>
+#include <unicode/unistr.h>
+// stl
+#include <cstdint>
+#include <ostream>
+
+namespace mapnik { namespace json {
+
+namespace {
+
+using util::write_number;
+
+template <typename Sink>
+void write_escaped(Sink & sink, char const* data, std::size_t size)
+{
+    static char const hex[] = "0123456789abcdef";
+    char const* run = data;
+    for (char const* end = data + size; data < end; ++data)
+    {
+        unsigned char c = static_cast<unsigned char>(*data);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        sink.write(run, static_cast<std::size_t>(data - run));
+        run = data + 1;
+        switch (c)
+        {
+        case '"': sink.literal("\\\""); break;
+        case '\\': sink.literal("\\\\"); break;
+        case '\b': sink.literal("\\b"); break;
+        case '\f': sink.literal("\\f"); break;
+        case '\n': sink.literal("\\n"); break;
+        case '\r': sink.literal("\\r"); break;
+        case '\t': sink.literal("\\t"); break;
+        default:
+        {
+            char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+            sink.write(escape, sizeof(escape));
+        }
+        }
+    }
+    sink.write(run, static_cast<std::size_t>(data - run));
+}
+
+// escapes the UTF-8 chunks of a unicode string as ICU converts them
+template <typename Sink>
+struct escaping_byte_sink : U_NAMESPACE_QUALIFIER ByteSink
+{
+    explicit escaping_byte_sink(Sink & sink)
+        : sink_(sink) {}
+
+    virtual void Append(const char* data, int32_t n)
+    {
+        write_escaped(sink_, data, static_cast<std::size_t>(n));
+    }
+
+    Sink & sink_;
+};
+
+template <typename Sink>
+void write_point(Sink & sink, geometry::point<double> const& pt)
+{
+    sink.put('[');
+    write_number(sink, pt.x);
+    sink.put(',');
+    write_number(sink, pt.y);
+    sink.put(']');
+}
+
+template <typename Sink, typename Points>
+void write_points(Sink & sink, Points const& points)
+{
+    sink.put('[');
+    bool first = true;
+    for (auto const& pt : points)
+    {
+        if (!first) sink.put(',');
+        first = false;
+        write_point(sink, pt);
+    }
+    sink.put(']');
+}
+
+template <typename Sink>
+void write_rings(Sink & sink, geometry::polygon<double> const& poly)
+{
+    sink.put('[');
+    bool first = true;
+    for (auto const& ring : poly)
+    {
+        if (!first) sink.put(',');
+        first = false;
+        write_points(sink, ring);
+    }
+    sink.put(']');
+}
+
+template <typename Sink>
+struct geometry_writer
+{
+    explicit geometry_writer(Sink & sink)
+        : sink_(sink) {}
+
+    void operator() (geometry::geometry_empty const&) const
+    {
+        sink_.literal("null");
+    }
+
+    void operator() (geometry::point<double> const& pt) const
+    {
+        sink_.literal("{\"type\":\"Point\",\"coordinates\":");
+        write_point(sink_, pt);
+        sink_.put('}');
+    }
+
+    void operator() (geometry::line_string<double> const& line) const
+    {
+        sink_.literal("{\"type\":\"LineString\",\"coordinates\":");
+        write_points(sink_, line);
+        sink_.put('}');
+    }
+
+    void operator() (geometry::polygon<double> const& poly) const
+    {
+        sink_.literal("{\"type\":\"Polygon\",\"coordinates\":");
+        write_rings(sink_, poly);
+        sink_.put('}');
+    }
+
+    void operator() (geometry::multi_point<double> const& multi_pt) const
+    {
+        sink_.literal("{\"type\":\"MultiPoint\",\"coordinates\":");
+        write_points(sink_, multi_pt);
+        sink_.put('}');
+    }
+
+    void operator() (geometry::multi_line_string<double> const& multi_line) const
+    {
+        sink_.literal("{\"type\":\"MultiLineString\",\"coordinates\":[");
+        bool first = true;
+        for (auto const& line : multi_line)
+        {
+            if (!first) sink_.put(',');
+            first = false;
+            write_points(sink_, line);
+        }
+        sink_.literal("]}");
+    }
+
+    void operator() (geometry::multi_polygon<double> const& multi_poly) const
+    {
+        sink_.literal("{\"type\":\"MultiPolygon\",\"coordinates\":[");
+        bool first = true;
+        for (auto const& poly : multi_poly)
+        {
+            if (!first) sink_.put(',');
+            first = false;
+            write_rings(sink_, poly);
+        }
+        sink_.literal("]}");
+    }
+
+    void operator() (geometry::geometry_collection<double> const& collection) const
+    {
+        sink_.literal("{\"type\":\"GeometryCollection\",\"geometries\":[");
+        bool first = true;
+        for (auto const& geom : collection)
+        {
+            if (!first) sink_.put(',');
+            first = false;
+            util::apply_visitor(*this, geom);
+        }
+        sink_.literal("]}");
+    }
+
+    Sink & sink_;
+};
+
+template <typename Sink>
+struct value_writer
+{
+    explicit value_writer(Sink & sink)
+        : sink_(sink) {}
+
+    void operator() (value_null const&) const
+    {
+        sink_.literal("null");
+    }
+
+    void operator() (value_bool val) const
+    {
+        if (val) sink_.literal("true");
+        else sink_.literal("false");
+    }
+
+    void operator() (value_integer val) const
+    {
+        write_number(sink_, static_cast<std::int64_t>(val));
+    }
+
+    void operator() (value_double val) const
+    {
+        write_number(sink_, val);
+    }
+
+    void operator() (value_unicode_string const& val) const
+    {
+        sink_.put('"');
+        escaping_byte_sink<Sink> utf8(sink_);
+        val.toUTF8(utf8);
+        sink_.put('"');
+    }
+
+    Sink & sink_;
+};
+
+template <typename Sink>
+void write_geometry(Sink & sink, geometry::geometry<double> const& geom)
+{
+    util::apply_visitor(geometry_writer<Sink>(sink), geom);
+}
+
+template <typename Sink>
+void write_feature(Sink & sink, feature_impl const& feature)
+{
+    sink.literal("{\"type\":\"Feature\",\"id\":");
+    write_number(sink, static_cast<std::int64_t>(feature.id()));
+    sink.literal(",\"geometry\":");
+    write_geometry(sink, feature.get_geometry());
+    sink.literal(",\"properties\":{");
+    bool first = true;
+    for (auto const& kv : feature.get_context())
+    {
+        value const& val = feature.get(kv.second);
+        if (val.is_null()) continue;
+        if (!first) sink.put(',');
+        first = false;
+        sink.put('"');
+        write_escaped(sink, kv.first.data(), kv.first.size());
+        sink.literal("\":");
+        util::apply_visitor(value_writer<Sink>(sink), val);
+    }
+    sink.literal("}}");
+}
+
+} // anonymous namespace
+
+void write_geojson(std::string & json, geometry::geometry<double> const& geom)
+{
+    util::string_sink sink(json);
+    write_geometry(sink, geom);
+}
+
+void write_geojson(std::ostream & out, geometry::geometry<double> const& geom)
+{
+    util::stream_sink sink(out);
+    write_geometry(sink, geom);
+}
+
+void write_geojson(std::string & json, feature_impl const& feature)
+{
+    util::string_sink sink(json);
+    write_feature(sink, feature);
+}
+
+void write_geojson(std::ostream & out, feature_impl const& feature)
+{
+    util::stream_sink sink(out);
+    write_feature(sink, feature);
+}
+
+}}
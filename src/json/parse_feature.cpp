@@ -40,6 +40,22 @@ void parse_feature(Iterator start, Iterator end, feature_impl& feature, mapnik::
     }
 }
 
+template <typename Iterator>
+void parse_feature(Iterator start, Iterator end, feature_impl& feature, mapnik::transcoder const& tr,
+                   std::set<std::string> const& names)
+{
+    namespace x3 = boost::spirit::x3;
+    using space_type = mapnik::json::grammar::space_type;
+    auto grammar = x3::with<mapnik::json::grammar::properties_tag>(std::ref(names))
+        [x3::with<mapnik::json::grammar::transcoder_tag>(std::ref(tr))
+         [x3::with<mapnik::json::grammar::feature_tag>(std::ref(feature))
+          [ mapnik::json::feature_grammar() ]]];
+    if (!x3::phrase_parse(start, end, grammar, space_type()))
+    {
+        throw std::runtime_error("Can't parser GeoJSON Feature");
+    }
+}
+
 template <typename Iterator>
 void parse_geometry(Iterator start, Iterator end, feature_impl& feature)
 {
@@ -50,10 +66,14 @@ void parse_geometry(Iterator start, Iterator end, feature_impl& feature)
     {
         throw std::runtime_error("Can't parser GeoJSON Geometry");
     }
+    // parsed in place
+    feature.reset_bounds();
 }
 
 using iterator_type = mapnik::json::grammar::iterator_type;
 template void parse_feature<iterator_type>(iterator_type,iterator_type, feature_impl& feature, mapnik::transcoder const& tr);
+template void parse_feature<iterator_type>(iterator_type,iterator_type, feature_impl& feature, mapnik::transcoder const& tr,
+                                           std::set<std::string> const& names);
 template void parse_geometry<iterator_type>(iterator_type,iterator_type, feature_impl& feature);
 
 }}
@@ -31,6 +31,23 @@
 namespace mapnik
 {
 
+static const char * budget_policy_strings[] = {
+    "stop",
+    "sample",
+    "simplify",
+    ""
+};
+
+IMPLEMENT_ENUM( budget_policy_e, budget_policy_strings )
+
+static const char * aggregate_mode_strings[] = {
+    "none",
+    "density",
+    ""
+};
+
+IMPLEMENT_ENUM( aggregate_mode_e, aggregate_mode_strings )
+
 layer::layer(std::string const& _name, std::string const& _srs)
     : name_(_name),
       srs_(_srs),
@@ -40,6 +57,14 @@ layer::layer(std::string const& _name, std::string const& _srs)
       queryable_(false),
       clear_label_cache_(false),
       cache_features_(false),
+      cache_image_(false),
+      geometry_pyramid_(false),
+      maximum_features_(0),
+      maximum_vertices_(0),
+      maximum_render_time_(0.0),
+      budget_policy_(BUDGET_STOP),
+      aggregate_(AGGREGATE_NONE),
+      aggregate_weight_(),
       group_by_(),
       styles_(),
       layers_(),
@@ -59,6 +84,14 @@ layer::layer(layer const& rhs)
       queryable_(rhs.queryable_),
       clear_label_cache_(rhs.clear_label_cache_),
       cache_features_(rhs.cache_features_),
+      cache_image_(rhs.cache_image_),
+      geometry_pyramid_(rhs.geometry_pyramid_),
+      maximum_features_(rhs.maximum_features_),
+      maximum_vertices_(rhs.maximum_vertices_),
+      maximum_render_time_(rhs.maximum_render_time_),
+      budget_policy_(rhs.budget_policy_),
+      aggregate_(rhs.aggregate_),
+      aggregate_weight_(rhs.aggregate_weight_),
       group_by_(rhs.group_by_),
       styles_(rhs.styles_),
       layers_(rhs.layers_),
@@ -78,6 +111,14 @@ layer::layer(layer && rhs)
       queryable_(std::move(rhs.queryable_)),
       clear_label_cache_(std::move(rhs.clear_label_cache_)),
       cache_features_(std::move(rhs.cache_features_)),
+      cache_image_(std::move(rhs.cache_image_)),
+      geometry_pyramid_(std::move(rhs.geometry_pyramid_)),
+      maximum_features_(std::move(rhs.maximum_features_)),
+      maximum_vertices_(std::move(rhs.maximum_vertices_)),
+      maximum_render_time_(std::move(rhs.maximum_render_time_)),
+      budget_policy_(std::move(rhs.budget_policy_)),
+      aggregate_(std::move(rhs.aggregate_)),
+      aggregate_weight_(std::move(rhs.aggregate_weight_)),
       group_by_(std::move(rhs.group_by_)),
       styles_(std::move(rhs.styles_)),
       layers_(std::move(rhs.layers_)),
@@ -99,6 +140,14 @@ layer& layer::operator=(layer rhs)
     std::swap(this->queryable_, rhs.queryable_);
     std::swap(this->clear_label_cache_, rhs.clear_label_cache_);
     std::swap(this->cache_features_, rhs.cache_features_);
+    std::swap(this->cache_image_, rhs.cache_image_);
+    std::swap(this->geometry_pyramid_, rhs.geometry_pyramid_);
+    std::swap(this->maximum_features_, rhs.maximum_features_);
+    std::swap(this->maximum_vertices_, rhs.maximum_vertices_);
+    std::swap(this->maximum_render_time_, rhs.maximum_render_time_);
+    std::swap(this->budget_policy_, rhs.budget_policy_);
+    std::swap(this->aggregate_, rhs.aggregate_);
+    std::swap(this->aggregate_weight_, rhs.aggregate_weight_);
     std::swap(this->group_by_, rhs.group_by_);
     std::swap(this->styles_, rhs.styles_);
     std::swap(this->ds_, rhs.ds_);
@@ -119,6 +168,14 @@ bool layer::operator==(layer const& rhs) const
         (queryable_ == rhs.queryable_) &&
         (clear_label_cache_ == rhs.clear_label_cache_) &&
         (cache_features_ == rhs.cache_features_) &&
+        (cache_image_ == rhs.cache_image_) &&
+        (geometry_pyramid_ == rhs.geometry_pyramid_) &&
+        (maximum_features_ == rhs.maximum_features_) &&
+        (maximum_vertices_ == rhs.maximum_vertices_) &&
+        (maximum_render_time_ == rhs.maximum_render_time_) &&
+        (budget_policy_ == rhs.budget_policy_) &&
+        (aggregate_ == rhs.aggregate_) &&
+        (aggregate_weight_ == rhs.aggregate_weight_) &&
         (group_by_ == rhs.group_by_) &&
         (styles_ == rhs.styles_) &&
         ((ds_ && rhs.ds_) ? *ds_ == *rhs.ds_ : ds_ == rhs.ds_) &&
@@ -180,6 +237,11 @@ std::vector<layer> const& layer::layers() const
     return layers_;
 }
 
+std::vector<layer> & layer::layers()
+{
+    return layers_;
+}
+
 void layer::set_minimum_scale_denominator(double minimum_scale_denom)
 {
     minimum_scale_denom_=minimum_scale_denom;
@@ -291,6 +353,91 @@ bool layer::cache_features() const
     return cache_features_;
 }
 
+void layer::set_cache_image(bool _cache_image)
+{
+    cache_image_ = _cache_image;
+}
+
+bool layer::cache_image() const
+{
+    return cache_image_;
+}
+
+void layer::set_geometry_pyramid(bool _geometry_pyramid)
+{
+    geometry_pyramid_ = _geometry_pyramid;
+}
+
+bool layer::geometry_pyramid() const
+{
+    return geometry_pyramid_;
+}
+
+void layer::set_maximum_features(std::size_t max_features)
+{
+    maximum_features_ = max_features;
+}
+
+std::size_t layer::maximum_features() const
+{
+    return maximum_features_;
+}
+
+void layer::set_maximum_vertices(std::size_t max_vertices)
+{
+    maximum_vertices_ = max_vertices;
+}
+
+std::size_t layer::maximum_vertices() const
+{
+    return maximum_vertices_;
+}
+
+void layer::set_maximum_render_time(double milliseconds)
+{
+    maximum_render_time_ = milliseconds;
+}
+
+double layer::maximum_render_time() const
+{
+    return maximum_render_time_;
+}
+
+void layer::set_budget_policy(budget_policy_e policy)
+{
+    budget_policy_ = policy;
+}
+
+budget_policy_e layer::budget_policy() const
+{
+    return budget_policy_;
+}
+
+bool layer::has_budget() const
+{
+    return maximum_features_ > 0 || maximum_vertices_ > 0 || maximum_render_time_ > 0.0;
+}
+
+void layer::set_aggregate(aggregate_mode_e mode)
+{
+    aggregate_ = mode;
+}
+
+aggregate_mode_e layer::aggregate() const
+{
+    return aggregate_;
+}
+
+void layer::set_aggregate_weight(std::string const& column)
+{
+    aggregate_weight_ = column;
+}
+
+std::string const& layer::aggregate_weight() const
+{
+    return aggregate_weight_;
+}
+
 void layer::set_group_by(std::string const& column)
 {
     group_by_ = column;
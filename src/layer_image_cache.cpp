@@ -0,0 +1,271 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/layer_image_cache.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/symbolizer_hash.hpp>
+#include <mapnik/expression_string.hpp>
+#include <mapnik/value/hash.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/image_filter_types.hpp>
+
+// stl
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mapnik
+{
+
+template class singleton<layer_image_cache, CreateStatic>;
+
+namespace {
+
+inline void hash_combine(std::size_t & seed, std::size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+// whether both images were rendered for the same extent, size, scale
+// factor and offset
+bool same_view(layer_image_cache::key_type const& a, layer_image_cache::key_type const& b)
+{
+    return std::tie(std::get<2>(a), std::get<3>(a), std::get<4>(a), std::get<5>(a),
+                    std::get<6>(a), std::get<7>(a), std::get<8>(a), std::get<9>(a), std::get<10>(a)) ==
+        std::tie(std::get<2>(b), std::get<3>(b), std::get<4>(b), std::get<5>(b),
+                 std::get<6>(b), std::get<7>(b), std::get<8>(b), std::get<9>(b), std::get<10>(b));
+}
+
+// the filters with their arguments, as written to XML
+std::string filters_string(std::vector<filter::filter_type> const& filters)
+{
+    std::string str;
+    std::back_insert_iterator<std::string> sink(str);
+    generate_image_filters(sink, filters);
+    return str;
+}
+
+bool labels_overlap(layer_image_cache::label_boxes const& a, layer_image_cache::label_boxes const& b)
+{
+    for (auto const& box_a : a)
+    {
+        for (auto const& box_b : b)
+        {
+            if (box_a.intersects(box_b)) return true;
+        }
+    }
+    return false;
+}
+
+}
+
+layer_image_cache::layer_image_cache()
+    : entries_(),
+      lru_(),
+      max_bytes_(0),
+      num_bytes_(0) {}
+
+void layer_image_cache::set_max_bytes(std::size_t max_bytes)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    max_bytes_ = max_bytes;
+    evict();
+}
+
+std::size_t layer_image_cache::max_bytes() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return max_bytes_;
+}
+
+layer_image_cache::image_ptr layer_image_cache::find(key_type const& key, label_boxes * labels)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    auto itr = entries_.find(key);
+    if (itr == entries_.end()) return image_ptr();
+    lru_.splice(lru_.begin(), lru_, itr->second.lru);
+    if (labels) *labels = itr->second.labels;
+    return itr->second.image;
+}
+
+void layer_image_cache::insert(key_type const& key, image_ptr const& image, label_boxes labels)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    if (!image || image->size() > max_bytes_) return;
+    auto itr = entries_.find(key);
+    if (itr != entries_.end())
+    {
+        num_bytes_ -= itr->second.image->size();
+        lru_.erase(itr->second.lru);
+        entries_.erase(itr);
+    }
+    lru_.push_front(key);
+    entries_.emplace(key, entry{image, std::move(labels), lru_.begin()});
+    num_bytes_ += image->size();
+    evict();
+}
+
+std::size_t layer_image_cache::invalidate(std::string const& layer_name)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    // keys and labels of dropped images whose neighbours are still to be checked
+    std::vector<std::pair<key_type, label_boxes>> dropped;
+    auto drop = [&](std::map<key_type, entry>::iterator itr)
+    {
+        num_bytes_ -= itr->second.image->size();
+        lru_.erase(itr->second.lru);
+        dropped.emplace_back(itr->first, std::move(itr->second.labels));
+        return entries_.erase(itr);
+    };
+    std::size_t count = 0;
+    for (auto itr = entries_.begin(); itr != entries_.end();)
+    {
+        if (std::get<0>(itr->first) == layer_name)
+        {
+            itr = drop(itr);
+            ++count;
+        }
+        else ++itr;
+    }
+    while (!dropped.empty())
+    {
+        std::pair<key_type, label_boxes> item = std::move(dropped.back());
+        dropped.pop_back();
+        if (item.second.empty()) continue;
+        for (auto itr = entries_.begin(); itr != entries_.end();)
+        {
+            if (same_view(itr->first, item.first) && labels_overlap(itr->second.labels, item.second))
+            {
+                itr = drop(itr);
+                ++count;
+            }
+            else ++itr;
+        }
+    }
+    return count;
+}
+
+void layer_image_cache::evict()
+{
+    while (num_bytes_ > max_bytes_ && !lru_.empty())
+    {
+        auto itr = entries_.find(lru_.back());
+        num_bytes_ -= itr->second.image->size();
+        entries_.erase(itr);
+        lru_.pop_back();
+    }
+}
+
+std::size_t layer_image_cache::size() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return entries_.size();
+}
+
+void layer_image_cache::clear()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    entries_.clear();
+    lru_.clear();
+    num_bytes_ = 0;
+}
+
+std::size_t layer_image_cache::fingerprint(Map const& map, layer const& lay, attributes const& vars)
+{
+    std::hash<std::string> string_hash;
+    std::size_t seed = 0;
+    if (datasource_ptr const& ds = lay.datasource())
+    {
+        hash_combine(seed, std::hash<std::uint64_t>()(ds->id()));
+        for (auto const& kv : ds->params())
+        {
+            boost::optional<std::string> value = ds->params().get<std::string>(kv.first);
+            hash_combine(seed, string_hash(kv.first));
+            hash_combine(seed, value ? string_hash(*value) : 0);
+        }
+    }
+    // the layer is reprojected to the map srs
+    hash_combine(seed, string_hash(map.srs()));
+    hash_combine(seed, string_hash(lay.srs()));
+    hash_combine(seed, lay.comp_op() ? static_cast<std::size_t>(*lay.comp_op()) + 1 : 0);
+    hash_combine(seed, std::hash<double>()(lay.get_opacity()));
+    for (std::string const& style_name : lay.styles())
+    {
+        hash_combine(seed, string_hash(style_name));
+        boost::optional<feature_type_style const&> style = map.find_style(style_name);
+        if (!style) continue;
+        hash_combine(seed, static_cast<std::size_t>(style->get_filter_mode()));
+        hash_combine(seed, style->comp_op() ? static_cast<std::size_t>(*style->comp_op()) + 1 : 0);
+        hash_combine(seed, std::hash<float>()(style->get_opacity()));
+        hash_combine(seed, string_hash(filters_string(style->image_filters())));
+        hash_combine(seed, string_hash(filters_string(style->direct_image_filters())));
+        for (rule const& r : style->get_rules())
+        {
+            hash_combine(seed, std::hash<double>()(r.get_min_scale()));
+            hash_combine(seed, std::hash<double>()(r.get_max_scale()));
+            hash_combine(seed, r.has_else_filter() ? 1 : 0);
+            hash_combine(seed, r.has_also_filter() ? 1 : 0);
+            if (r.get_filter())
+            {
+                hash_combine(seed, string_hash(to_expression_string(*r.get_filter())));
+            }
+            for (symbolizer const& sym : r.get_symbolizers())
+            {
+                hash_combine(seed, util::apply_visitor(symbolizer_hash_visitor(), sym));
+            }
+        }
+    }
+    // the variables are unordered, so their hashes are combined order independently
+    std::size_t vars_seed = 0;
+    for (auto const& kv : vars)
+    {
+        std::size_t h = string_hash(kv.first);
+        hash_combine(h, value_hash(kv.second));
+        vars_seed ^= h;
+    }
+    hash_combine(seed, vars_seed);
+    return seed;
+}
+
+}
@@ -33,6 +33,7 @@
 #include <mapnik/symbolizer_utils.hpp>
 #include <mapnik/feature_type_style.hpp>
 #include <mapnik/layer.hpp>
+#include <mapnik/datasource.hpp>
 #include <mapnik/datasource_cache.hpp>
 #include <mapnik/font_engine_freetype.hpp>
 #include <mapnik/font_set.hpp>
@@ -59,6 +60,7 @@
 #include <mapnik/transform/transform_expression.hpp>
 #include <mapnik/evaluate_global_attributes.hpp>
 #include <mapnik/boolean.hpp>
+#include <mapnik/executor.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -71,6 +73,7 @@
 
 // stl
 #include <algorithm>
+#include <exception>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore_agg.hpp>
@@ -88,7 +91,7 @@ using util::operator"" _case;
 class map_parser : util::noncopyable
 {
 public:
-    map_parser(Map & map, bool strict, std::string const& filename = "") :
+    map_parser(Map & map, bool strict, std::string const& filename = "", Map const* previous = nullptr) :
         strict_(strict),
         filename_(filename),
         font_library_(),
@@ -96,7 +99,10 @@ public:
         font_name_cache_(),
         file_sources_(),
         fontsets_(),
-        xml_base_path_() {}
+        xml_base_path_(),
+        layer_count_(0),
+        pending_datasources_(),
+        previous_(previous) {}
 
     void parse_map(Map & map, xml_node const& node, std::string const& base_path);
 private:
@@ -134,7 +140,9 @@ private:
     void find_unused_nodes_recursive(xml_node const& node, std::string & error_text);
     std::string ensure_relative_to_xml(boost::optional<std::string> const& opt_path);
     void ensure_exists(std::string const& file_path);
+    path_expression_ptr parse_path_cached(xml_node const& node, std::string const& file_path);
     void check_styles(Map const & map);
+    void create_datasources(Map & map, std::size_t first_layer);
     boost::optional<color> get_opt_color_attr(boost::property_tree::ptree const& node,
                                               std::string const& name);
 
@@ -147,6 +155,21 @@ private:
     std::map<std::string,std::string> file_sources_;
     std::map<std::string,font_set> fontsets_;
     std::string xml_base_path_;
+    // datasources are created once all layers are parsed, so that
+    // opening files and connecting to databases can run concurrently
+    struct pending_datasource
+    {
+        std::size_t layer_id;
+        std::string layer_name;
+        xml_node const* node;
+        parameters params;
+        std::shared_ptr<datasource> ds;
+        std::string error;
+    };
+    std::size_t layer_count_;
+    std::vector<pending_datasource> pending_datasources_;
+    // map being reloaded, whose datasources are reused
+    Map const* previous_;
 };
 
 
@@ -174,8 +197,33 @@ void load_map_string(Map & map, std::string const& str, bool strict, std::string
     parser.parse_map(map, tree.root(), base_path);
 }
 
+void reload_map(Map & map, Map const& previous, std::string const& filename, bool strict, std::string base_path)
+{
+    xml_tree tree;
+    tree.set_filename(filename);
+    read_xml(filename, tree.root());
+    map_parser parser(map, strict, filename, &previous);
+    parser.parse_map(map, tree.root(), base_path);
+}
+
+void reload_map_string(Map & map, Map const& previous, std::string const& str, bool strict, std::string base_path)
+{
+    xml_tree tree;
+    if (!base_path.empty())
+    {
+        read_xml_string(str, tree.root(), base_path);
+    }
+    else
+    {
+        read_xml_string(str, tree.root(), map.base_path());
+    }
+    map_parser parser(map, strict, base_path, &previous);
+    parser.parse_map(map, tree.root(), base_path);
+}
+
 void map_parser::parse_map(Map & map, xml_node const& node, std::string const& base_path)
 {
+    std::size_t first_layer = map.layer_count();
     try
     {
         xml_node const& map_node = node.get_child("Map");
@@ -325,6 +373,7 @@ void map_parser::parse_map(Map & map, xml_node const& node, std::string const& b
         }
 
         parse_map_include(map, map_node);
+        create_datasources(map, first_layer);
     }
     catch (node_not_found const&)
     {
@@ -440,6 +489,20 @@ void map_parser::parse_style(Map & map, xml_node const& node)
             style.set_image_filters_inflate(*image_filters_inflate);
         }
 
+        // label scheduling
+        optional<expression_ptr> label_priority = node.get_opt_attr<expression_ptr>("label-priority");
+        if (label_priority) style.set_label_priority(*label_priority);
+
+        optional<double> label_coverage = node.get_opt_attr<double>("label-coverage");
+        if (label_coverage)
+        {
+            if (!(*label_coverage >= 0.0 && *label_coverage <= 1.0))
+            {
+                throw config_error("label-coverage must be between 0 and 1, got " + std::to_string(*label_coverage));
+            }
+            style.set_label_coverage(*label_coverage);
+        }
+
         // image filters
         optional<std::string> filters = node.get_opt_attr<std::string>("image-filters");
         if (filters)
@@ -596,6 +659,8 @@ void map_parser::parse_layer(Parent & parent, xml_node const& node)
             throw mapnik::config_error(ex.what());
         }
         layer lyr(name, srs);
+        // pre-order position, matches create_datasources walk
+        std::size_t layer_id = layer_count_++;
 
 
         if (status)
@@ -653,6 +718,56 @@ void map_parser::parse_layer(Parent & parent, xml_node const& node)
             lyr.set_cache_features(* cache_features);
         }
 
+        optional<mapnik::boolean_type> cache_image =
+            node.get_opt_attr<mapnik::boolean_type>("cache-image");
+        if (cache_image)
+        {
+            lyr.set_cache_image(* cache_image);
+        }
+
+        optional<mapnik::boolean_type> geometry_pyramid =
+            node.get_opt_attr<mapnik::boolean_type>("geometry-pyramid");
+        if (geometry_pyramid)
+        {
+            lyr.set_geometry_pyramid(* geometry_pyramid);
+        }
+
+        optional<unsigned> max_features = node.get_opt_attr<unsigned>("maximum-features");
+        if (max_features)
+        {
+            lyr.set_maximum_features(* max_features);
+        }
+
+        optional<unsigned> max_vertices = node.get_opt_attr<unsigned>("maximum-vertices");
+        if (max_vertices)
+        {
+            lyr.set_maximum_vertices(* max_vertices);
+        }
+
+        optional<double> max_render_time = node.get_opt_attr<double>("maximum-render-time");
+        if (max_render_time)
+        {
+            lyr.set_maximum_render_time(* max_render_time);
+        }
+
+        optional<budget_policy_e> budget_policy = node.get_opt_attr<budget_policy_e>("budget-policy");
+        if (budget_policy)
+        {
+            lyr.set_budget_policy(* budget_policy);
+        }
+
+        optional<aggregate_mode_e> aggregate = node.get_opt_attr<aggregate_mode_e>("aggregate");
+        if (aggregate)
+        {
+            lyr.set_aggregate(* aggregate);
+        }
+
+        optional<std::string> aggregate_weight = node.get_opt_attr<std::string>("aggregate-weight");
+        if (aggregate_weight)
+        {
+            lyr.set_aggregate_weight(* aggregate_weight);
+        }
+
         optional<std::string> group_by =
             node.get_opt_attr<std::string>("group-by");
         if (group_by)
@@ -771,20 +886,7 @@ void map_parser::parse_layer(Parent & parent, xml_node const& node)
                 }
 
                 //now we are ready to create datasource
-                try
-                {
-                    std::shared_ptr<datasource> ds =
-                        datasource_cache::instance().create(params);
-                    lyr.set_datasource(ds);
-                }
-                catch (std::exception const& ex)
-                {
-                    throw config_error(ex.what());
-                }
-                catch (...)
-                {
-                    throw config_error("Unknown exception occurred attempting to create datasoure for layer '" + lyr.name() + "'");
-                }
+                pending_datasources_.push_back({layer_id, name, &node, std::move(params), nullptr, std::string()});
             }
             else if (child.is("Layer"))
             {
@@ -803,6 +905,84 @@ void map_parser::parse_layer(Parent & parent, xml_node const& node)
     }
 }
 
+namespace {
+
+void collect_layers(std::vector<layer> & layers, std::vector<layer*> & output)
+{
+    for (auto & lyr : layers)
+    {
+        output.push_back(&lyr);
+        collect_layers(lyr.layers(), output);
+    }
+}
+
+void collect_datasources(std::vector<layer> const& layers, std::vector<datasource_ptr> & output)
+{
+    for (auto const& lyr : layers)
+    {
+        if (lyr.datasource()) output.push_back(lyr.datasource());
+        collect_datasources(lyr.layers(), output);
+    }
+}
+
+}
+
+void map_parser::create_datasources(Map & map, std::size_t first_layer)
+{
+    if (pending_datasources_.empty()) return;
+    std::vector<datasource_ptr> previous;
+    if (previous_) collect_datasources(previous_->layers(), previous);
+    auto create = [&previous](pending_datasource & pending)
+    {
+        auto itr = std::find_if(previous.begin(), previous.end(),
+                                [&pending](datasource_ptr const& ds) { return ds->params() == pending.params; });
+        if (itr != previous.end())
+        {
+            pending.ds = *itr;
+            return;
+        }
+        try
+        {
+            pending.ds = datasource_cache::instance().create(pending.params);
+        }
+        catch (std::exception const& ex)
+        {
+            pending.error = ex.what();
+        }
+        catch (...)
+        {
+            pending.error = "Unknown exception occurred attempting to create datasoure for layer '" + pending.layer_name + "'";
+        }
+    };
+    // as many at once as the executor has threads for
+    parallel_for(pending_datasources_.size(), pending_datasources_.size(), [&](std::size_t i) {
+        create(pending_datasources_[i]);
+    });
+
+    std::vector<layer*> layers;
+    std::vector<layer> & map_layers = map.layers();
+    for (std::size_t i = first_layer; i < map_layers.size(); ++i)
+    {
+        layers.push_back(&map_layers[i]);
+        collect_layers(map_layers[i].layers(), layers);
+    }
+    // report the first failure in document order, as sequential loading did
+    for (auto & pending : pending_datasources_)
+    {
+        if (!pending.error.empty())
+        {
+            config_error err(pending.error);
+            err.append_context(std::string(" encountered during parsing of layer '") + pending.layer_name + "'", *pending.node);
+            throw err;
+        }
+        if (pending.layer_id < layers.size())
+        {
+            layers[pending.layer_id]->set_datasource(pending.ds);
+        }
+    }
+    pending_datasources_.clear();
+}
+
 void map_parser::parse_rule(feature_type_style & style, xml_node const& node)
 {
     std::string name;
@@ -928,6 +1108,7 @@ void map_parser::parse_symbolizer_base(symbolizer_base &sym, xml_node const& nod
     set_symbolizer_property<symbolizer_base,transform_type>(sym, keys::geometry_transform, node);
     set_symbolizer_property<symbolizer_base,simplify_algorithm_e>(sym, keys::simplify_algorithm, node);
     set_symbolizer_property<symbolizer_base,double>(sym, keys::extend, node);
+    set_symbolizer_property<symbolizer_base,value_bool>(sym, keys::simplify_prefilter, node);
 }
 
 void map_parser::parse_point_symbolizer(rule & rule, xml_node const & node)
@@ -957,7 +1138,7 @@ void map_parser::parse_point_symbolizer(rule & rule, xml_node const & node)
             *file = ensure_relative_to_xml(file);
             std::string filename = *file;
             ensure_exists(filename);
-            put(sym, keys::file, parse_path(filename));
+            put(sym, keys::file, parse_path_cached(node, filename));
         }
 
         rule.append(std::move(sym));
@@ -1035,7 +1216,7 @@ void map_parser::parse_markers_symbolizer(rule & rule, xml_node const& node)
         if (!filename.empty())
         {
             ensure_exists(filename);
-            put(sym,keys::file, parse_path(filename));
+            put(sym,keys::file, parse_path_cached(node, filename));
         }
         set_symbolizer_property<symbolizer_base,double>(sym, keys::opacity, node);
         set_symbolizer_property<symbolizer_base,double>(sym, keys::fill_opacity, node);
@@ -1087,7 +1268,7 @@ void map_parser::parse_line_pattern_symbolizer(rule & rule, xml_node const & nod
         ensure_exists(file);
         line_pattern_symbolizer sym;
         parse_symbolizer_base(sym, node);
-        put(sym, keys::file, parse_path(file));
+        put(sym, keys::file, parse_path_cached(node, file));
         set_symbolizer_property<symbolizer_base,double>(sym, keys::opacity, node);
         set_symbolizer_property<symbolizer_base,double>(sym, keys::offset, node);
         set_symbolizer_property<symbolizer_base,transform_type>(sym, keys::image_transform, node);
@@ -1127,7 +1308,7 @@ void map_parser::parse_polygon_pattern_symbolizer(rule & rule,
         ensure_exists(file);
         polygon_pattern_symbolizer sym;
         parse_symbolizer_base(sym, node);
-        put(sym, keys::file, parse_path(file));
+        put(sym, keys::file, parse_path_cached(node, file));
         set_symbolizer_property<symbolizer_base,double>(sym, keys::opacity, node);
         set_symbolizer_property<symbolizer_base,double>(sym, keys::gamma, node);
         set_symbolizer_property<symbolizer_base,transform_type>(sym, keys::image_transform, node);
@@ -1240,7 +1421,7 @@ void map_parser::parse_shield_symbolizer(rule & rule, xml_node const& node)
 
         file = ensure_relative_to_xml(file);
         ensure_exists(file);
-        put(sym, keys::file , parse_path(file));
+        put(sym, keys::file , parse_path_cached(node, file));
         optional<halo_rasterizer_e> halo_rasterizer_ = node.get_opt_attr<halo_rasterizer_e>("halo-rasterizer");
         if (halo_rasterizer_) put(sym, keys::halo_rasterizer, halo_rasterizer_enum(*halo_rasterizer_));
         rule.append(std::move(sym));
@@ -1674,6 +1855,17 @@ void map_parser::ensure_exists(std::string const& file_path)
     }
 }
 
+path_expression_ptr map_parser::parse_path_cached(xml_node const& node, std::string const& file_path)
+{
+    auto & cache = node.get_tree().path_cache_;
+    auto itr = cache.find(file_path);
+    if (itr == cache.end())
+    {
+        itr = cache.emplace(file_path, parse_path(file_path)).first;
+    }
+    return itr->second;
+}
+
 void map_parser::find_unused_nodes(xml_node const& root)
 {
     std::string error_message;
@@ -285,7 +285,9 @@ std::map<std::string,font_set> & Map::fontsets()
 bool Map::register_fonts(std::string const& dir, bool recurse)
 {
     font_library library;
-    return freetype_engine::instance().register_fonts_impl(dir, library, font_file_mapping_, recurse);
+    bool success = freetype_engine::instance().register_fonts_impl(dir, library, font_file_mapping_, recurse);
+    freetype_engine::instance().save_font_catalog();
+    return success;
 }
 
 bool Map::load_fonts()
@@ -442,6 +444,11 @@ void Map::set_background(color const& c)
     background_ = c;
 }
 
+void Map::reset_background()
+{
+    background_.reset();
+}
+
 boost::optional<std::string> const& Map::background_image() const
 {
     return background_image_;
@@ -692,15 +699,24 @@ view_transform Map::transform() const
 }
 
 featureset_ptr Map::query_point(unsigned index, double x, double y) const
+{
+    return query_points(index, std::vector<coord2d>(1, coord2d(x, y))).front();
+}
+
+std::vector<featureset_ptr> Map::query_points(unsigned index, std::vector<coord2d> const& pts) const
 {
     if (!current_extent_.valid())
     {
         throw std::runtime_error("query_point: map extent is not initialized, you need to set a valid extent before querying");
     }
-    if (!current_extent_.intersects(x,y))
+    for (coord2d const& pt : pts)
     {
-        throw std::runtime_error("query_point: x,y coords do not intersect map extent");
+        if (!current_extent_.intersects(pt.x, pt.y))
+        {
+            throw std::runtime_error("query_point: x,y coords do not intersect map extent");
+        }
     }
+    std::vector<featureset_ptr> result;
     if (index < layers_.size())
     {
         mapnik::layer const& layer = layers_[index];
@@ -710,10 +726,14 @@ featureset_ptr Map::query_point(unsigned index, double x, double y) const
             mapnik::projection dest(srs_);
             mapnik::projection source(layer.srs());
             proj_transform prj_trans(source,dest);
-            double z = 0;
-            if (!prj_trans.equal() && !prj_trans.backward(x,y,z))
+            std::vector<coord2d> layer_pts(pts);
+            for (coord2d & pt : layer_pts)
             {
-                throw std::runtime_error("query_point: could not project x,y into layer srs");
+                double z = 0;
+                if (!prj_trans.equal() && !prj_trans.backward(pt.x,pt.y,z))
+                {
+                    throw std::runtime_error("query_point: could not project x,y into layer srs");
+                }
             }
             // calculate default tolerance
             mapnik::box2d<double> map_ex = current_extent_;
@@ -729,13 +749,22 @@ featureset_ptr Map::query_point(unsigned index, double x, double y) const
                 throw std::runtime_error(s.str());
             }
             double tol = (map_ex.maxx() - map_ex.minx()) / static_cast<double>(width_) * 3;
-            featureset_ptr fs = ds->features_at_point(mapnik::coord2d(x,y), tol);
-            MAPNIK_LOG_DEBUG(map) << "map: Query at point tol=" << tol << "(" << x << "," << y << ")";
-            if (fs)
+            std::vector<featureset_ptr> fs = ds->features_at_points(layer_pts, tol);
+            MAPNIK_LOG_DEBUG(map) << "map: Query at " << layer_pts.size() << " points tol=" << tol;
+            result.reserve(layer_pts.size());
+            for (std::size_t i = 0; i < layer_pts.size(); ++i)
             {
-                return std::make_shared<filter_featureset<hit_test_filter> >(fs,
-                                                                             hit_test_filter(x,y,tol));
+                if (i < fs.size() && fs[i])
+                {
+                    result.push_back(std::make_shared<filter_featureset<hit_test_filter> >(fs[i],
+                                                                                           hit_test_filter(layer_pts[i].x, layer_pts[i].y, tol)));
+                }
+                else
+                {
+                    result.push_back(mapnik::make_invalid_featureset());
+                }
             }
+            return result;
         }
     }
     else
@@ -746,7 +775,8 @@ featureset_ptr Map::query_point(unsigned index, double x, double y) const
         else s << " (map has no layers)";
         throw std::out_of_range(s.str());
     }
-    return mapnik::make_invalid_featureset();
+    result.assign(pts.size(), mapnik::make_invalid_featureset());
+    return result;
 }
 
 featureset_ptr Map::query_map_point(unsigned index, double x, double y) const
@@ -34,52 +34,247 @@
 #include <boost/interprocess/file_mapping.hpp>
 #pragma GCC diagnostic pop
 
+// stl
+#include <algorithm>
+#include <tuple>
+#include <utility>
+#include <vector>
+
 namespace mapnik
 {
 
 template class singleton<mapped_memory_cache, CreateStatic>;
 
+namespace {
+
+std::int64_t ticks()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void advise(boost::interprocess::mapped_region & region, mapped_access access)
+{
+    using boost::interprocess::mapped_region;
+    switch (access)
+    {
+    case mapped_access::sequential:
+        region.advise(mapped_region::advice_sequential);
+        break;
+    case mapped_access::random:
+        region.advise(mapped_region::advice_random);
+        break;
+    case mapped_access::will_need:
+        region.advise(mapped_region::advice_willneed);
+        break;
+    case mapped_access::normal:
+        break;
+    }
+}
+
+}
+
+mapped_memory_cache::entry::entry(mapped_region_ptr const& region_, std::time_t mtime_,
+                                  std::uintmax_t size_, std::int64_t now)
+    : region(region_),
+      mtime(mtime_),
+      size(size_),
+      used(now),
+      checked(now),
+      hits(0) {}
+
+mapped_memory_cache::mapped_memory_cache()
+    : cache_(),
+      max_bytes_(0),
+      check_interval_(0),
+      bytes_(0),
+      hits_(0),
+      misses_(0),
+      evictions_(0),
+      invalidations_(0) {}
+
 void mapped_memory_cache::clear()
 {
 #ifdef MAPNIK_THREADSAFE
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<std::shared_timed_mutex> lock(cache_mutex_);
 #endif
+    for (auto const& item : cache_) hits_ += item.second.hits;
+    bytes_ = 0;
     return cache_.clear();
 }
 
-bool mapped_memory_cache::insert(std::string const& uri, mapped_region_ptr mem)
+void mapped_memory_cache::set_max_bytes(std::size_t max_bytes)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::shared_timed_mutex> lock(cache_mutex_);
+#endif
+    max_bytes_ = max_bytes;
+    evict(std::string());
+}
+
+void mapped_memory_cache::set_check_interval(std::chrono::milliseconds interval)
+{
+    check_interval_ = interval.count();
+}
+
+std::chrono::milliseconds mapped_memory_cache::check_interval() const
+{
+    return std::chrono::milliseconds(check_interval_);
+}
+
+std::size_t mapped_memory_cache::size()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::shared_lock<std::shared_timed_mutex> lock(cache_mutex_);
+#endif
+    return cache_.size();
+}
+
+std::size_t mapped_memory_cache::size_bytes()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::shared_lock<std::shared_timed_mutex> lock(cache_mutex_);
+#endif
+    return bytes_;
+}
+
+std::size_t mapped_memory_cache::hits()
 {
 #ifdef MAPNIK_THREADSAFE
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::shared_lock<std::shared_timed_mutex> lock(cache_mutex_);
 #endif
-    return cache_.emplace(uri,mem).second;
+    std::size_t hits = hits_;
+    for (auto const& item : cache_) hits += item.second.hits;
+    return hits;
+}
+
+// called with the lock held, shared or not
+bool mapped_memory_cache::stale(std::string const& key, entry & e, std::int64_t now)
+{
+    std::int64_t interval = check_interval_;
+    if (interval <= 0) return false;
+    std::int64_t checked = e.checked;
+    // a single thread checks the file, the others keep using the mapping
+    if (now - checked < interval || !e.checked.compare_exchange_strong(checked, now)) return false;
+    std::time_t mtime;
+    std::uintmax_t size;
+    // a removed file stays readable through its mapping
+    if (!mapnik::util::file_stat(key, mtime, size)) return false;
+    return mtime != e.mtime || size != e.size;
 }
 
-boost::optional<mapped_region_ptr> mapped_memory_cache::find(std::string const& uri, bool update_cache)
+// called with the lock held exclusively
+void mapped_memory_cache::erase(std::unordered_map<std::string, entry>::iterator itr)
 {
+    bytes_ -= itr->second.region->get_size();
+    hits_ += itr->second.hits;
+    cache_.erase(itr);
+}
+
+// called with the lock held exclusively, keep is the file just mapped
+void mapped_memory_cache::evict(std::string const& keep)
+{
+    if (max_bytes_ == 0 || bytes_ <= max_bytes_) return;
+    using iterator_type = std::unordered_map<std::string, entry>::iterator;
+    std::vector<std::pair<std::int64_t, iterator_type>> candidates;
+    candidates.reserve(cache_.size());
+    for (auto itr = cache_.begin(); itr != cache_.end(); ++itr)
+    {
+        if (itr->first != keep) candidates.emplace_back(itr->second.used.load(), itr);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](std::pair<std::int64_t, iterator_type> const& lhs,
+                 std::pair<std::int64_t, iterator_type> const& rhs) { return lhs.first < rhs.first; });
+    for (auto const& candidate : candidates)
+    {
+        if (bytes_ <= max_bytes_) break;
+        erase(candidate.second);
+        ++evictions_;
+    }
+}
+
+bool mapped_memory_cache::insert(std::string const& uri, mapped_region_ptr mem)
+{
+    std::time_t mtime = 0;
+    std::uintmax_t size = 0;
+    mapnik::util::file_stat(uri, mtime, size);
 #ifdef MAPNIK_THREADSAFE
-    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<std::shared_timed_mutex> lock(cache_mutex_);
 #endif
+    bool inserted = cache_.emplace(std::piecewise_construct, std::forward_as_tuple(uri),
+                                   std::forward_as_tuple(mem, mtime, size, ticks())).second;
+    if (inserted)
+    {
+        bytes_ += mem->get_size();
+        evict(uri);
+    }
+    return inserted;
+}
 
-    using iterator_type = std::unordered_map<std::string, mapped_region_ptr>::const_iterator;
+boost::optional<mapped_region_ptr> mapped_memory_cache::find(std::string const& uri, bool update_cache,
+                                                             mapped_access access)
+{
+    using iterator_type = std::unordered_map<std::string, entry>::iterator;
     boost::optional<mapped_region_ptr> result;
-    iterator_type itr = cache_.find(uri);
-    if (itr != cache_.end())
+    std::int64_t now = ticks();
+    mapped_region_ptr stale_region;
     {
-        result.reset(itr->second);
-        return result;
+#ifdef MAPNIK_THREADSAFE
+        std::shared_lock<std::shared_timed_mutex> lock(cache_mutex_);
+#endif
+        iterator_type itr = cache_.find(uri);
+        if (itr != cache_.end())
+        {
+            entry & e = itr->second;
+            if (!stale(uri, e, now))
+            {
+                e.used.store(now, std::memory_order_relaxed);
+                e.hits.fetch_add(1, std::memory_order_relaxed);
+                result.reset(e.region);
+                return result;
+            }
+            stale_region = e.region;
+        }
+    }
+    if (stale_region)
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::shared_timed_mutex> lock(cache_mutex_);
+#endif
+        iterator_type itr = cache_.find(uri);
+        // unless another thread remapped it meanwhile
+        if (itr != cache_.end() && itr->second.region == stale_region)
+        {
+            erase(itr);
+            ++invalidations_;
+        }
     }
 
-    if (mapnik::util::exists(uri))
+    ++misses_;
+    std::time_t mtime;
+    std::uintmax_t size;
+    if (mapnik::util::file_stat(uri, mtime, size))
     {
         try
         {
             boost::interprocess::file_mapping mapping(uri.c_str(),boost::interprocess::read_only);
             mapped_region_ptr region(std::make_shared<boost::interprocess::mapped_region>(mapping,boost::interprocess::read_only));
+            advise(*region, access);
             result.reset(region);
             if (update_cache)
             {
-                cache_.emplace(uri, *result);
+#ifdef MAPNIK_THREADSAFE
+                std::lock_guard<std::shared_timed_mutex> lock(cache_mutex_);
+#endif
+                // mapped concurrently by another thread, share the first one
+                auto inserted = cache_.emplace(std::piecewise_construct, std::forward_as_tuple(uri),
+                                               std::forward_as_tuple(region, mtime, size, now));
+                result.reset(inserted.first->second.region);
+                if (inserted.second)
+                {
+                    bytes_ += region->get_size();
+                    evict(uri);
+                }
             }
             return result;
         }
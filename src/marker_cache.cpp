@@ -32,6 +32,13 @@
 #include <mapnik/image_util.hpp>
 #include <mapnik/image_reader.hpp>
 #include <mapnik/util/fs.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/parse_path.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/numa.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -45,13 +52,23 @@
 #include "agg_pixfmt_rgba.h"
 #pragma GCC diagnostic pop
 
+// stl
+#include <functional>
+#include <set>
+
 namespace mapnik
 {
 
 marker_cache::marker_cache()
-    : known_svg_prefix_("shape://"),
+    : max_bytes_(0),
+      misses_(0),
+      known_svg_prefix_("shape://"),
       known_image_prefix_("image://")
 {
+    for (std::size_t i = 0; i < numa::node_count(); ++i)
+    {
+        nodes_.emplace_back(new shard_set());
+    }
     insert_svg("ellipse",
                "<?xml version='1.0' standalone='no'?>"
                "<svg width='100%' height='100%' version='1.1' xmlns='http://www.w3.org/2000/svg'>"
@@ -62,28 +79,48 @@ marker_cache::marker_cache()
                "<svg width='100%' height='100%' version='1.1' xmlns='http://www.w3.org/2000/svg'>"
                "<path fill='#0000FF' stroke='black' stroke-width='.5' d='m 31.698405,7.5302648 -8.910967,-6.0263712 0.594993,4.8210971 -18.9822542,0 0,2.4105482 18.9822542,0 -0.594993,4.8210971 z'/>"
                "</svg>");
-    marker_cache_.emplace("image://square",std::make_shared<mapnik::marker const>(mapnik::marker_rgba8()));
+    insert_marker("image://square", mapnik::marker_rgba8());
 }
 
 marker_cache::~marker_cache() {}
 
+marker_cache::shard & marker_cache::get_shard(std::string const& key)
+{
+    return get_shard(*nodes_[numa::current_node() % nodes_.size()], key);
+}
+
+marker_cache::shard & marker_cache::get_shard(shard_set & node, std::string const& key)
+{
+    return node[std::hash<std::string>()(key) % num_shards];
+}
+
 void marker_cache::clear()
 {
-#ifdef MAPNIK_THREADSAFE
-    std::lock_guard<std::mutex> lock(mutex_);
-#endif
-    auto itr = marker_cache_.begin();
-    while(itr != marker_cache_.end())
+    for (auto & node : nodes_)
     {
-        if (!is_uri(itr->first))
+        for (shard & s : *node)
         {
-           marker_cache_.erase(itr++);
-        }
-        else
-        {
-            ++itr;
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::shared_timed_mutex> lock(s.mutex);
+#endif
+            auto itr = s.entries.begin();
+            while (itr != s.entries.end())
+            {
+                if (!is_uri(itr->first))
+                {
+                    if (!itr->second.pinned) s.lru.erase(itr->second.lru_pos);
+                    s.bytes -= itr->second.bytes;
+                    itr = s.entries.erase(itr);
+                }
+                else
+                {
+                    ++itr;
+                }
+            }
+            s.hits = 0;
         }
     }
+    misses_ = 0;
 }
 
 bool marker_cache::is_svg_uri(std::string const& path)
@@ -109,10 +146,8 @@ bool marker_cache::insert_svg(std::string const& name, std::string const& svg_st
 
 bool marker_cache::insert_marker(std::string const& uri, mapnik::marker && path)
 {
-#ifdef MAPNIK_THREADSAFE
-    std::lock_guard<std::mutex> lock(mutex_);
-#endif
-    return marker_cache_.emplace(uri,std::make_shared<mapnik::marker const>(std::move(path))).second;
+    auto mark = std::make_shared<mapnik::marker const>(std::move(path));
+    return insert(uri, mark) == mark;
 }
 
 namespace detail
@@ -138,8 +173,129 @@ struct visitor_create_marker
     }
 };
 
+struct visitor_marker_bytes
+{
+    std::size_t operator() (marker_rgba8 const& mark) const
+    {
+        return mark.get_data().size();
+    }
+
+    std::size_t operator() (marker_svg const& mark) const
+    {
+        svg_path_ptr data = mark.get_data();
+        if (!data) return 0;
+        return data->source().capacity() * sizeof(svg::svg_path_storage::value_type) +
+            data->attributes().size() * sizeof(svg::path_attributes);
+    }
+
+    std::size_t operator() (marker_null const&) const
+    {
+        return 0;
+    }
+};
+
+inline std::size_t marker_bytes(mapnik::marker const& mark)
+{
+    return sizeof(mapnik::marker) + util::apply_visitor(visitor_marker_bytes(), mark);
+}
+
 } // end detail ns
 
+std::shared_ptr<mapnik::marker const> marker_cache::insert(std::string const& uri,
+                                                           std::shared_ptr<mapnik::marker const> const& mark)
+{
+    shard & s = get_shard(uri);
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::shared_timed_mutex> lock(s.mutex);
+#endif
+    auto itr = s.entries.find(uri);
+    if (itr != s.entries.end())
+    {
+        // loaded concurrently by another thread, keep the first one
+        return itr->second.marker;
+    }
+    entry e { mark, detail::marker_bytes(*mark), is_uri(uri), s.lru.end() };
+    if (!e.pinned) e.lru_pos = s.lru.insert(s.lru.begin(), uri);
+    s.bytes += e.bytes;
+    s.entries.emplace(uri, std::move(e));
+    evict(s);
+    return mark;
+}
+
+void marker_cache::evict(shard & s)
+{
+    std::size_t max_bytes = max_bytes_;
+    if (max_bytes == 0) return;
+    std::size_t shard_budget = max_bytes / num_shards;
+    while (s.bytes > shard_budget && !s.lru.empty())
+    {
+        auto itr = s.entries.find(s.lru.back());
+        s.bytes -= itr->second.bytes;
+        s.entries.erase(itr);
+        s.lru.pop_back();
+    }
+}
+
+void marker_cache::set_max_bytes(std::size_t bytes)
+{
+    max_bytes_ = bytes;
+    for (auto & node : nodes_)
+    {
+        for (shard & s : *node)
+        {
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::shared_timed_mutex> lock(s.mutex);
+#endif
+            evict(s);
+        }
+    }
+}
+
+std::size_t marker_cache::size()
+{
+    std::size_t count = 0;
+    for (auto & node : nodes_)
+    {
+        for (shard & s : *node)
+        {
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::shared_timed_mutex> lock(s.mutex);
+#endif
+            count += s.entries.size();
+        }
+    }
+    return count;
+}
+
+std::size_t marker_cache::size_bytes()
+{
+    std::size_t bytes = 0;
+    for (auto & node : nodes_)
+    {
+        for (shard & s : *node)
+        {
+#ifdef MAPNIK_THREADSAFE
+            std::lock_guard<std::shared_timed_mutex> lock(s.mutex);
+#endif
+            bytes += s.bytes;
+        }
+    }
+    return bytes;
+}
+
+std::size_t marker_cache::hits() const
+{
+    std::size_t count = 0;
+    for (auto const& node : nodes_)
+    {
+        for (shard const& s : *node)
+        {
+            count += s.hits.load(std::memory_order_relaxed);
+        }
+    }
+    return count;
+}
+
 std::shared_ptr<mapnik::marker const> marker_cache::find(std::string const& uri,
                                                          bool update_cache, bool strict)
 {
@@ -148,15 +304,78 @@ std::shared_ptr<mapnik::marker const> marker_cache::find(std::string const& uri,
         return std::make_shared<mapnik::marker const>(mapnik::marker_null());
     }
 
+    shard & s = get_shard(uri);
+    if (max_bytes_ == 0)
+    {
+        // nothing is evicted, the order of use doesn't matter
+#ifdef MAPNIK_THREADSAFE
+        std::shared_lock<std::shared_timed_mutex> lock(s.mutex);
+#endif
+        auto itr = s.entries.find(uri);
+        if (itr != s.entries.end())
+        {
+            s.hits.fetch_add(1, std::memory_order_relaxed);
+            return itr->second.marker;
+        }
+    }
+    else
+    {
 #ifdef MAPNIK_THREADSAFE
-    std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<std::shared_timed_mutex> lock(s.mutex);
 #endif
-    auto itr = marker_cache_.find(uri);
-    if (itr != marker_cache_.end())
+        auto itr = s.entries.find(uri);
+        if (itr != s.entries.end())
+        {
+            s.hits.fetch_add(1, std::memory_order_relaxed);
+            if (!itr->second.pinned)
+            {
+                s.lru.splice(s.lru.begin(), s.lru, itr->second.lru_pos);
+            }
+            return itr->second.marker;
+        }
+    }
+    if (nodes_.size() > 1)
+    {
+        // copied by this thread, so the pixels live on its node
+        if (std::shared_ptr<mapnik::marker const> replica = find_replica(uri))
+        {
+            auto mark = std::make_shared<mapnik::marker const>(*replica);
+            return update_cache ? insert(uri, mark) : mark;
+        }
+    }
+    ++misses_;
+
+    // decode without holding a lock
+    std::shared_ptr<mapnik::marker const> mark = load(uri, strict);
+    if (update_cache && !mark->is<mapnik::marker_null>())
+    {
+        return insert(uri, mark);
+    }
+    return mark;
+}
+
+std::shared_ptr<mapnik::marker const> marker_cache::find_replica(std::string const& uri)
+{
+    shard_set * local = nodes_[numa::current_node() % nodes_.size()].get();
+    for (auto & node : nodes_)
     {
-        return itr->second;
+        if (node.get() == local) continue;
+        shard & s = get_shard(*node, uri);
+#ifdef MAPNIK_THREADSAFE
+        std::shared_lock<std::shared_timed_mutex> lock(s.mutex);
+#endif
+        auto itr = s.entries.find(uri);
+        if (itr != s.entries.end())
+        {
+            s.hits.fetch_add(1, std::memory_order_relaxed);
+            return itr->second.marker;
+        }
     }
+    return std::shared_ptr<mapnik::marker const>();
+}
 
+std::shared_ptr<mapnik::marker const> marker_cache::load(std::string const& uri, bool strict)
+{
     try
     {
         // if uri references a built-in marker
@@ -189,15 +408,8 @@ std::shared_ptr<mapnik::marker const> marker_cache::find(std::string const& uri,
             svg.bounding_rect(&lox, &loy, &hix, &hiy);
             marker_path->set_bounding_box(lox,loy,hix,hiy);
             marker_path->set_dimensions(svg.width(),svg.height());
-            if (update_cache)
-            {
-                auto emplace_result = marker_cache_.emplace(uri,std::make_shared<mapnik::marker const>(mapnik::marker_svg(marker_path)));
-                return emplace_result.first->second;
-            }
-            else
-            {
-                return std::make_shared<mapnik::marker const>(mapnik::marker_svg(marker_path));
-            }
+            marker_path->enable_flattened_paths();
+            return std::make_shared<mapnik::marker const>(mapnik::marker_svg(marker_path));
         }
         // otherwise assume file-based
         else
@@ -229,15 +441,8 @@ std::shared_ptr<mapnik::marker const> marker_cache::find(std::string const& uri,
                 svg.bounding_rect(&lox, &loy, &hix, &hiy);
                 marker_path->set_bounding_box(lox,loy,hix,hiy);
                 marker_path->set_dimensions(svg.width(),svg.height());
-                if (update_cache)
-                {
-                    auto emplace_result = marker_cache_.emplace(uri,std::make_shared<mapnik::marker const>(mapnik::marker_svg(marker_path)));
-                    return emplace_result.first->second;
-                }
-                else
-                {
-                    return std::make_shared<mapnik::marker const>(mapnik::marker_svg(marker_path));
-                }
+                marker_path->enable_flattened_paths();
+                return std::make_shared<mapnik::marker const>(mapnik::marker_svg(marker_path));
             }
             else
             {
@@ -248,21 +453,12 @@ std::shared_ptr<mapnik::marker const> marker_cache::find(std::string const& uri,
                     unsigned width = reader->width();
                     unsigned height = reader->height();
                     BOOST_ASSERT(width > 0 && height > 0);
+                    // markers are premultiplied, the readers that can do it while decoding
+                    reader->set_premultiply(true);
                     image_any im = reader->read(0,0,width,height);
-                    if (update_cache)
-                    {
-                        auto emplace_result = marker_cache_.emplace(uri,
-                                std::make_shared<mapnik::marker const>(
-                                    util::apply_visitor(detail::visitor_create_marker(), im)
-                                ));
-                        return emplace_result.first->second;
-                    }
-                    else
-                    {
-                        return std::make_shared<mapnik::marker const>(
-                            util::apply_visitor(detail::visitor_create_marker(), im)
-                        );
-                    }
+                    return std::make_shared<mapnik::marker const>(
+                        util::apply_visitor(detail::visitor_create_marker(), im)
+                    );
                 }
                 else
                 {
@@ -279,4 +475,65 @@ std::shared_ptr<mapnik::marker const> marker_cache::find(std::string const& uri,
     return std::make_shared<mapnik::marker const>(mapnik::marker_null());
 }
 
+namespace detail
+{
+
+struct collect_marker_files
+{
+    explicit collect_marker_files(std::set<std::string> & files)
+        : files_(files) {}
+
+    template <typename Symbolizer>
+    void operator() (Symbolizer const& sym) const
+    {
+        auto itr = sym.properties.find(keys::file);
+        if (itr == sym.properties.end()) return;
+        symbolizer_base::value_type const& val = itr->second;
+        if (val.template is<std::string>())
+        {
+            files_.insert(val.template get<std::string>());
+        }
+        else if (val.template is<path_expression_ptr>())
+        {
+            path_expression_ptr const& path = val.template get<path_expression_ptr>();
+            if (!path) return;
+            std::string filename;
+            for (path_component const& component : *path)
+            {
+                // skip data driven paths
+                if (!component.is<std::string>()) return;
+                filename += component.get<std::string>();
+            }
+            files_.insert(filename);
+        }
+    }
+
+    std::set<std::string> & files_;
+};
+
+} // end detail ns
+
+std::size_t marker_cache::preload(Map const& map, bool strict)
+{
+    std::set<std::string> files;
+    detail::collect_marker_files collector(files);
+    for (auto const& style : map.styles())
+    {
+        for (rule const& r : style.second.get_rules())
+        {
+            for (symbolizer const& sym : r.get_symbolizers())
+            {
+                util::apply_visitor(collector, sym);
+            }
+        }
+    }
+    std::size_t count = 0;
+    for (std::string const& filename : files)
+    {
+        if (!find(filename, true, strict)->is<mapnik::marker_null>()) ++count;
+    }
+    MAPNIK_LOG_DEBUG(marker_cache) << "marker_cache: Preloaded " << count << " of " << files.size() << " markers";
+    return count;
+}
+
 }
@@ -0,0 +1,266 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/marker_sprite_cache.hpp>
+#include <mapnik/svg/svg_path_attributes.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace mapnik
+{
+
+namespace {
+
+inline void hash_combine(std::size_t & seed, std::size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+inline std::size_t color_hash(agg::rgba8 const& c)
+{
+    return (static_cast<std::size_t>(c.r) << 24) | (static_cast<std::size_t>(c.g) << 16) |
+           (static_cast<std::size_t>(c.b) << 8) | c.a;
+}
+
+inline bool same_color(agg::rgba8 const& a, agg::rgba8 const& b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+constexpr double pi = 3.14159265358979323846;
+
+}
+
+bool marker_sprite_cache::path_style::operator==(path_style const& rhs) const
+{
+    return same_color(fill_color, rhs.fill_color) && fill_opacity == rhs.fill_opacity &&
+        same_color(stroke_color, rhs.stroke_color) && stroke_width == rhs.stroke_width &&
+        stroke_opacity == rhs.stroke_opacity && flags == rhs.flags;
+}
+
+bool marker_sprite_cache::key_type::operator==(key_type const& rhs) const
+{
+    return shape == rhs.shape && style == rhs.style &&
+        angle == rhs.angle && scale == rhs.scale &&
+        phase_x == rhs.phase_x && phase_y == rhs.phase_y &&
+        opacity == rhs.opacity && gamma == rhs.gamma &&
+        gamma_method == rhs.gamma_method;
+}
+
+std::size_t marker_sprite_cache::key_hash::operator()(key_type const& key) const
+{
+    std::hash<double> double_hash;
+    std::size_t seed = std::hash<void const*>()(key.shape);
+    hash_combine(seed, key.style.size());
+    for (path_style const& style : key.style)
+    {
+        hash_combine(seed, color_hash(style.fill_color));
+        hash_combine(seed, double_hash(style.fill_opacity));
+        hash_combine(seed, color_hash(style.stroke_color));
+        hash_combine(seed, double_hash(style.stroke_width));
+        hash_combine(seed, double_hash(style.stroke_opacity));
+        hash_combine(seed, style.flags);
+    }
+    hash_combine(seed, static_cast<std::size_t>(key.angle));
+    hash_combine(seed, static_cast<std::size_t>(key.scale));
+    hash_combine(seed, static_cast<std::size_t>(key.phase_x * phase_steps + key.phase_y));
+    hash_combine(seed, key.opacity);
+    hash_combine(seed, double_hash(key.gamma));
+    hash_combine(seed, static_cast<std::size_t>(key.gamma_method));
+    return seed;
+}
+
+marker_sprite_cache::marker_sprite_cache(std::size_t max_bytes)
+    : entries_(),
+      max_bytes_(max_bytes),
+      num_bytes_(0) {}
+
+void marker_sprite_cache::set_max_bytes(std::size_t max_bytes)
+{
+    max_bytes_ = max_bytes;
+    if (num_bytes_ > max_bytes_)
+    {
+        clear();
+    }
+}
+
+std::size_t marker_sprite_cache::max_bytes() const
+{
+    return max_bytes_;
+}
+
+marker_sprite_cache::sprite const* marker_sprite_cache::find(key_type const& key) const
+{
+    auto itr = entries_.find(key);
+    if (itr == entries_.end())
+    {
+        return nullptr;
+    }
+    return &itr->second.data;
+}
+
+marker_sprite_cache::sprite const& marker_sprite_cache::insert(key_type const& key,
+                                                               svg_path_ptr const& shape,
+                                                               sprite && s)
+{
+    std::size_t bytes = s.image.size();
+    if (num_bytes_ + bytes > max_bytes_)
+    {
+        // sprites are cheap to make again, a full cache usually means
+        // transforms that hardly repeat
+        clear();
+    }
+    auto result = entries_.emplace(key, entry{shape, std::move(s)});
+    if (result.second)
+    {
+        num_bytes_ += bytes;
+    }
+    return result.first->second.data;
+}
+
+std::size_t marker_sprite_cache::size() const
+{
+    return entries_.size();
+}
+
+std::size_t marker_sprite_cache::bytes() const
+{
+    return num_bytes_;
+}
+
+void marker_sprite_cache::clear()
+{
+    entries_.clear();
+    num_bytes_ = 0;
+}
+
+bool marker_sprite_cache::quantize(agg::trans_affine const& tr,
+                                   box2d<double> const& bbox,
+                                   double tolerance,
+                                   key_type & key,
+                                   placement & place)
+{
+    double scale = std::hypot(tr.sx, tr.shy);
+    if (!(scale > 1e-9) || !bbox.valid() || !std::isfinite(tr.tx) || !std::isfinite(tr.ty))
+    {
+        return false;
+    }
+    double angle = std::atan2(tr.shy, tr.sx);
+    int angle_index = static_cast<int>(std::lround(angle / (2.0 * pi) * angle_steps));
+    int scale_index = static_cast<int>(std::lround(std::log2(scale) * scale_steps));
+    double q_angle = angle_index * 2.0 * pi / angle_steps;
+    double q_scale = std::exp2(static_cast<double>(scale_index) / scale_steps);
+    double q_cos = q_scale * std::cos(q_angle);
+    double q_sin = q_scale * std::sin(q_angle);
+
+    // the largest displacement of a bbox corner by the linear part
+    double error = 0.0;
+    double const xs[2] = { bbox.minx(), bbox.maxx() };
+    double const ys[2] = { bbox.miny(), bbox.maxy() };
+    for (double x : xs)
+    {
+        for (double y : ys)
+        {
+            double dx = (tr.sx - q_cos) * x + (tr.shx + q_sin) * y;
+            double dy = (tr.shy - q_sin) * x + (tr.sy - q_cos) * y;
+            error = std::max(error, std::hypot(dx, dy));
+        }
+    }
+
+    double x = std::floor(tr.tx);
+    double y = std::floor(tr.ty);
+    int phase_x = static_cast<int>(std::lround((tr.tx - x) * phase_steps));
+    int phase_y = static_cast<int>(std::lround((tr.ty - y) * phase_steps));
+    double phase_error = std::hypot(tr.tx - x - static_cast<double>(phase_x) / phase_steps,
+                                    tr.ty - y - static_cast<double>(phase_y) / phase_steps);
+    if (error + phase_error > tolerance)
+    {
+        return false;
+    }
+    if (phase_x == phase_steps)
+    {
+        phase_x = 0;
+        x += 1.0;
+    }
+    if (phase_y == phase_steps)
+    {
+        phase_y = 0;
+        y += 1.0;
+    }
+
+    key.angle = (angle_index % angle_steps + angle_steps) % angle_steps;
+    key.scale = scale_index;
+    key.phase_x = phase_x;
+    key.phase_y = phase_y;
+    place.transform = agg::trans_affine(q_cos, q_sin, -q_sin, q_cos,
+                                        static_cast<double>(phase_x) / phase_steps,
+                                        static_cast<double>(phase_y) / phase_steps);
+    place.x = static_cast<int>(x);
+    place.y = static_cast<int>(y);
+    return true;
+}
+
+std::vector<marker_sprite_cache::path_style> marker_sprite_cache::style(svg_attribute_type const& attrs)
+{
+    std::vector<path_style> result;
+    result.reserve(attrs.size());
+    for (unsigned i = 0; i < attrs.size(); ++i)
+    {
+        svg::path_attributes const& attr = attrs[i];
+        result.push_back(path_style{attr.fill_color, attr.fill_opacity,
+                                    attr.stroke_color, attr.stroke_width, attr.stroke_opacity,
+                                    (attr.fill_flag ? 1u : 0u) | (attr.stroke_flag ? 2u : 0u)});
+    }
+    return result;
+}
+
+double marker_sprite_cache::stroke_margin(svg_attribute_type const& attrs)
+{
+    double margin = 0.0;
+    for (unsigned i = 0; i < attrs.size(); ++i)
+    {
+        svg::path_attributes const& attr = attrs[i];
+        if (!attr.stroke_flag || attr.stroke_none)
+        {
+            continue;
+        }
+        double reach = 0.5 * attr.stroke_width * std::sqrt(std::fabs(attr.transform.determinant()));
+        double factor = 1.0;
+        if (attr.line_join == agg::miter_join || attr.line_join == agg::miter_join_revert)
+        {
+            factor = std::max(factor, attr.miter_limit);
+        }
+        if (attr.line_cap == agg::square_cap)
+        {
+            factor = std::max(factor, std::sqrt(2.0));
+        }
+        margin = std::max(margin, reach * factor);
+    }
+    return margin;
+}
+
+}
@@ -26,11 +26,21 @@
 #include <mapnik/geometry/box2d.hpp>
 #include <mapnik/memory_datasource.hpp>
 #include <mapnik/memory_featureset.hpp>
+#include <mapnik/memory_report.hpp>
 #include <mapnik/boolean.hpp>
 #include <mapnik/geometry/envelope.hpp>
+#include <mapnik/geometry/boost_adapters.hpp>
+#include <mapnik/raster.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/geometry/index/rtree.hpp>
+#pragma GCC diagnostic pop
 
 // stl
 #include <algorithm>
+#include <iterator>
+#include <vector>
 
 using mapnik::datasource;
 using mapnik::parameters;
@@ -46,8 +56,7 @@ struct accumulate_extent
 
     void operator() (feature_ptr const& feat)
     {
-        auto const& geom = feat->get_geometry();
-        auto bbox = geometry::envelope(geom);
+        auto bbox = feat->envelope();
         if ( first_ )
         {
             first_ = false;
@@ -63,6 +72,41 @@ struct accumulate_extent
     bool first_;
 };
 
+struct memory_datasource::spatial_index
+{
+    using item_type = std::pair<box2d<double>, std::size_t>;
+    using tree_type = boost::geometry::index::rtree<item_type, boost::geometry::index::linear<16,4>>;
+
+    // packing algorithm
+    explicit spatial_index(std::vector<item_type> const& items)
+        : tree(items.begin(), items.end()) {}
+
+    tree_type tree;
+};
+
+namespace {
+
+// features found through the index, in insertion order
+class memory_index_featureset : public Featureset
+{
+public:
+    explicit memory_index_featureset(std::vector<feature_ptr> && features)
+        : features_(std::move(features)),
+          pos_(features_.begin()) {}
+
+    feature_ptr next()
+    {
+        if (pos_ != features_.end()) return *pos_++;
+        return feature_ptr();
+    }
+
+private:
+    std::vector<feature_ptr> features_;
+    std::vector<feature_ptr>::const_iterator pos_;
+};
+
+}
+
 const char * memory_datasource::name()
 {
     return "memory";
@@ -74,7 +118,8 @@ memory_datasource::memory_datasource(parameters const& _params)
             *params_.get<std::string>("encoding","utf-8")),
       type_(datasource::Vector),
       bbox_check_(*params_.get<boolean_type>("bbox_check", true)),
-      type_set_(false) {}
+      type_set_(false),
+      use_index_(*params_.get<boolean_type>("spatial_index", false)) {}
 
 memory_datasource::~memory_datasource() {}
 
@@ -108,6 +153,7 @@ void memory_datasource::push(feature_ptr feature)
     }
     features_.push_back(feature);
     dirty_extent_ = true;
+    index_.reset();
 }
 
 datasource::datasource_t memory_datasource::type() const
@@ -121,9 +167,73 @@ featureset_ptr memory_datasource::features(const query& q) const
     {
         return mapnik::make_invalid_featureset();
     }
+    if (use_index_ && bbox_check_)
+    {
+        return indexed_features(q.get_bbox());
+    }
     return std::make_shared<memory_featureset>(q.get_bbox(),*this,bbox_check_);
 }
 
+void memory_datasource::build_index() const
+{
+    if (index_) return;
+    std::vector<spatial_index::item_type> items;
+    items.reserve(features_.size());
+    for (std::size_t i = 0; i < features_.size(); ++i)
+    {
+        feature_ptr const& feature = features_[i];
+        box2d<double> feature_box;
+        if (type_ == datasource::Raster)
+        {
+            raster_ptr const& source = feature->get_raster();
+            if (source) feature_box = source->ext_;
+        }
+        else
+        {
+            feature_box = feature->envelope();
+        }
+        if (feature_box.valid()) items.emplace_back(feature_box, i);
+    }
+    index_.reset(new spatial_index(items));
+}
+
+featureset_ptr memory_datasource::indexed_features(box2d<double> const& box) const
+{
+    return indexed_features(std::vector<box2d<double>>(1, box)).front();
+}
+
+std::vector<featureset_ptr> memory_datasource::indexed_features(std::vector<box2d<double>> const& boxes) const
+{
+    std::vector<std::vector<spatial_index::item_type>> hits(boxes.size());
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(index_mutex_);
+#endif
+        build_index();
+        for (std::size_t i = 0; i < boxes.size(); ++i)
+        {
+            index_->tree.query(boost::geometry::index::intersects(boxes[i]), std::back_inserter(hits[i]));
+        }
+    }
+    std::vector<featureset_ptr> result;
+    result.reserve(boxes.size());
+    for (auto & box_hits : hits)
+    {
+        std::sort(box_hits.begin(), box_hits.end(), [](spatial_index::item_type const& a, spatial_index::item_type const& b)
+                  {
+                      return a.second < b.second;
+                  });
+        std::vector<feature_ptr> features;
+        features.reserve(box_hits.size());
+        for (auto const& item : box_hits)
+        {
+            features.push_back(features_[item.second]);
+        }
+        result.push_back(std::make_shared<memory_index_featureset>(std::move(features)));
+    }
+    return result;
+}
+
 
 featureset_ptr memory_datasource::features_at_point(coord2d const& pt, double tol) const
 {
@@ -134,7 +244,43 @@ featureset_ptr memory_datasource::features_at_point(coord2d const& pt, double to
     box2d<double> box = box2d<double>(pt.x, pt.y, pt.x, pt.y);
     box.pad(tol);
     MAPNIK_LOG_DEBUG(memory_datasource) << "memory_datasource: Box=" << box << ", Point x=" << pt.x << ",y=" << pt.y;
-    return std::make_shared<memory_featureset>(box,*this);
+    // point queries come in numbers, they build the index even when
+    // features() scans
+    return indexed_features(box);
+}
+
+std::vector<featureset_ptr> memory_datasource::features_at_points(std::vector<coord2d> const& pts, double tol) const
+{
+    if (features_.empty())
+    {
+        return std::vector<featureset_ptr>(pts.size(), mapnik::make_invalid_featureset());
+    }
+    std::vector<box2d<double>> boxes;
+    boxes.reserve(pts.size());
+    for (coord2d const& pt : pts)
+    {
+        boxes.emplace_back(pt.x, pt.y, pt.x, pt.y);
+        boxes.back().pad(tol);
+    }
+    return indexed_features(boxes);
+}
+
+boost::optional<std::size_t> memory_datasource::estimate_features(query const& q) const
+{
+    if (!bbox_check_ || q.get_bbox().contains(envelope()))
+    {
+        return features_.size();
+    }
+    if (use_index_)
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(index_mutex_);
+#endif
+        build_index();
+        return static_cast<std::size_t>(std::distance(index_->tree.qbegin(boost::geometry::index::intersects(q.get_bbox())),
+                                                      index_->tree.qend()));
+    }
+    return boost::none;
 }
 
 void memory_datasource::set_envelope(box2d<double> const& box)
@@ -170,9 +316,24 @@ size_t memory_datasource::size() const
     return features_.size();
 }
 
+std::size_t memory_datasource::memory_usage() const
+{
+    std::size_t bytes = features_.size() * sizeof(feature_ptr);
+    for (feature_ptr const& feature : features_)
+    {
+        bytes += estimate_memory(*feature);
+    }
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(index_mutex_);
+#endif
+    if (index_) bytes += estimate_tree_memory(index_->tree);
+    return bytes;
+}
+
 void memory_datasource::clear()
 {
     features_.clear();
+    index_.reset();
 }
 
 }
@@ -0,0 +1,270 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/memory_report.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/expression_node.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/render_stats.hpp>
+#include <mapnik/marker_cache.hpp>
+#include <mapnik/mapped_memory_cache.hpp>
+#include <mapnik/image_tile_cache.hpp>
+#include <mapnik/text/glyph_cache.hpp>
+#include <mapnik/font_engine_freetype.hpp>
+
+// stl
+#include <set>
+
+namespace mapnik
+{
+
+namespace {
+
+// a node of a std::map or std::set beyond its value: three links and a color
+constexpr std::size_t tree_node_overhead = 4 * sizeof(void*);
+
+// heap bytes of a string beyond the small buffer most implementations keep
+std::size_t string_memory(std::string const& str)
+{
+    return str.capacity() > 15 ? str.capacity() + 1 : 0;
+}
+
+struct value_memory
+{
+    std::size_t operator()(value_unicode_string const& str) const
+    {
+        return static_cast<std::size_t>(str.getCapacity()) * sizeof(UChar);
+    }
+
+    template <typename T>
+    std::size_t operator()(T const&) const
+    {
+        return 0;
+    }
+};
+
+struct expression_memory
+{
+    std::size_t operator()(value_unicode_string const& str) const
+    {
+        return value_memory()(str);
+    }
+
+    std::size_t operator()(attribute const& attr) const
+    {
+        return string_memory(attr.name());
+    }
+
+    template <typename Tag>
+    std::size_t operator()(unary_node<Tag> const& x) const
+    {
+        return sizeof(x) + node(x.expr);
+    }
+
+    template <typename Tag>
+    std::size_t operator()(binary_node<Tag> const& x) const
+    {
+        return sizeof(x) + node(x.left) + node(x.right);
+    }
+
+    std::size_t operator()(unary_function_call const& x) const
+    {
+        return sizeof(x) + node(x.arg);
+    }
+
+    std::size_t operator()(binary_function_call const& x) const
+    {
+        return sizeof(x) + node(x.arg1) + node(x.arg2);
+    }
+
+    // the compiled pattern is opaque, its source stands in for it
+    std::size_t operator()(regex_match_node const& x) const
+    {
+        return sizeof(x) + node(x.expr) + 4 * x.to_string().size();
+    }
+
+    std::size_t operator()(regex_replace_node const& x) const
+    {
+        return sizeof(x) + node(x.expr) + 4 * x.to_string().size();
+    }
+
+    template <typename T>
+    std::size_t operator()(T const&) const
+    {
+        return 0;
+    }
+
+    std::size_t node(expr_node const& expr) const
+    {
+        return util::apply_visitor(*this, expr);
+    }
+};
+
+std::size_t estimate_memory(expression_ptr const& expr)
+{
+    return expr ? sizeof(expr_node) + expression_memory().node(*expr) : 0;
+}
+
+struct property_memory
+{
+    std::size_t operator()(std::string const& str) const
+    {
+        return string_memory(str);
+    }
+
+    std::size_t operator()(expression_ptr const& expr) const
+    {
+        return estimate_memory(expr);
+    }
+
+    std::size_t operator()(dash_array const& dash) const
+    {
+        return dash.capacity() * sizeof(dash_array::value_type);
+    }
+
+    template <typename T>
+    std::size_t operator()(T const&) const
+    {
+        return 0;
+    }
+};
+
+struct symbolizer_memory
+{
+    template <typename Symbolizer>
+    std::size_t operator()(Symbolizer const& sym) const
+    {
+        std::size_t bytes = 0;
+        for (auto const& prop : sym.properties)
+        {
+            bytes += tree_node_overhead + sizeof(prop)
+                + util::apply_visitor(property_memory(), prop.second);
+        }
+        return bytes;
+    }
+};
+
+std::size_t estimate_memory(feature_type_style const& style)
+{
+    std::size_t bytes = sizeof(style);
+    for (rule const& r : style.get_rules())
+    {
+        bytes += sizeof(r) + string_memory(r.get_name()) + estimate_memory(r.get_filter());
+        bytes += r.get_symbolizers().capacity() * sizeof(symbolizer);
+        for (symbolizer const& sym : r)
+        {
+            bytes += util::apply_visitor(symbolizer_memory(), sym);
+        }
+    }
+    return bytes;
+}
+
+std::size_t estimate_memory(parameters const& params)
+{
+    std::size_t bytes = 0;
+    for (auto const& param : params)
+    {
+        bytes += tree_node_overhead + sizeof(param) + string_memory(param.first);
+        if (param.second.is<std::string>())
+        {
+            bytes += string_memory(param.second.get<std::string>());
+        }
+    }
+    return bytes;
+}
+
+void add_layers(std::vector<layer> const& layers,
+                std::set<datasource const*> & counted,
+                std::vector<memory_usage_entry> & entries)
+{
+    for (layer const& lyr : layers)
+    {
+        std::size_t bytes = sizeof(lyr) + string_memory(lyr.name()) + string_memory(lyr.srs());
+        datasource_ptr ds = lyr.datasource();
+        if (ds && counted.insert(ds.get()).second)
+        {
+            bytes += estimate_memory(ds->params()) + ds->memory_usage();
+        }
+        entries.push_back(memory_usage_entry{lyr.name(), bytes});
+        add_layers(lyr.layers(), counted, entries);
+    }
+}
+
+std::size_t font_memory(freetype_engine::font_memory_cache_type const& cache)
+{
+    std::size_t bytes = 0;
+    for (auto const& item : cache)
+    {
+        bytes += tree_node_overhead + sizeof(item) + string_memory(item.first) + item.second.second;
+    }
+    return bytes;
+}
+
+}
+
+std::size_t estimate_memory(feature_impl const& feature)
+{
+    std::size_t bytes = sizeof(feature_impl)
+        + render_stats::vertex_count(feature.get_geometry()) * sizeof(geometry::point<double>);
+    feature_impl::cont_type const& data = feature.get_data();
+    bytes += data.capacity() * sizeof(value);
+    for (value const& val : data)
+    {
+        bytes += util::apply_visitor(value_memory(), val);
+    }
+    return bytes;
+}
+
+std::size_t memory_report::total() const
+{
+    std::size_t bytes = 0;
+    for (auto const* entries : {&styles, &layers, &caches})
+    {
+        for (memory_usage_entry const& entry : *entries) bytes += entry.bytes;
+    }
+    return bytes;
+}
+
+memory_report make_memory_report(Map const& map)
+{
+    memory_report report;
+    for (auto const& style : map.styles())
+    {
+        report.styles.push_back(memory_usage_entry{style.first, estimate_memory(style.second)});
+    }
+    std::set<datasource const*> counted;
+    add_layers(map.layers(), counted, report.layers);
+    report.caches.push_back(memory_usage_entry{"markers", marker_cache::instance().size_bytes()});
+    report.caches.push_back(memory_usage_entry{"mapped files", mapped_memory_cache::instance().size_bytes()});
+    report.caches.push_back(memory_usage_entry{"map fonts", font_memory(map.get_font_memory_cache())});
+    report.caches.push_back(memory_usage_entry{"fonts", font_memory(freetype_engine::get_cache())});
+    report.caches.push_back(memory_usage_entry{"glyphs", glyph_cache::instance().size_bytes()});
+    report.caches.push_back(memory_usage_entry{"image tiles", image_tile_cache::instance().size_bytes()});
+    return report;
+}
+
+}
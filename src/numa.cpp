@@ -0,0 +1,171 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/numa.hpp>
+
+// stl
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace mapnik { namespace numa {
+
+namespace {
+
+struct topology
+{
+    std::vector<std::vector<unsigned>> node_cpus;
+    std::vector<std::size_t> cpu_node;
+};
+
+#if defined(__linux__)
+// parses a sysfs cpu list, e.g. "0-7,16-23"
+std::vector<unsigned> parse_cpu_list(std::string const& list)
+{
+    std::vector<unsigned> cpus;
+    char const* p = list.c_str();
+    while (*p)
+    {
+        char * end;
+        unsigned long first = std::strtoul(p, &end, 10);
+        if (end == p) break;
+        unsigned long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            last = std::strtoul(p + 1, &end, 10);
+            p = end;
+        }
+        for (unsigned long cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(static_cast<unsigned>(cpu));
+        }
+        if (*p == ',') ++p;
+        else break;
+    }
+    return cpus;
+}
+#endif
+
+topology read_topology()
+{
+    topology topo;
+#if defined(__linux__)
+    char const* forced = std::getenv("MAPNIK_NUMA_NODES");
+    bool single = forced && std::string(forced) == "1";
+    std::vector<unsigned> ids;
+    if (!single)
+    {
+        if (DIR * dir = ::opendir("/sys/devices/system/node"))
+        {
+            while (dirent * entry = ::readdir(dir))
+            {
+                if (std::strncmp(entry->d_name, "node", 4) == 0 &&
+                    entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+                {
+                    ids.push_back(static_cast<unsigned>(std::strtoul(entry->d_name + 4, nullptr, 10)));
+                }
+            }
+            ::closedir(dir);
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    for (unsigned id : ids)
+    {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+        std::string list;
+        if (!std::getline(file, list)) continue;
+        std::vector<unsigned> cpus = parse_cpu_list(list);
+        // memory only nodes run no threads
+        if (cpus.empty()) continue;
+        for (unsigned cpu : cpus)
+        {
+            if (cpu >= topo.cpu_node.size()) topo.cpu_node.resize(cpu + 1, 0);
+            topo.cpu_node[cpu] = topo.node_cpus.size();
+        }
+        topo.node_cpus.push_back(std::move(cpus));
+    }
+#endif
+    if (topo.node_cpus.size() < 2)
+    {
+        topo.node_cpus.clear();
+        topo.cpu_node.clear();
+        topo.node_cpus.emplace_back();
+    }
+    return topo;
+}
+
+topology const& get_topology()
+{
+    static topology const topo = read_topology();
+    return topo;
+}
+
+}
+
+std::size_t node_count()
+{
+    return get_topology().node_cpus.size();
+}
+
+std::size_t current_node()
+{
+    topology const& topo = get_topology();
+    if (topo.node_cpus.size() < 2) return 0;
+#if defined(__linux__)
+    int cpu = ::sched_getcpu();
+    if (cpu >= 0 && static_cast<std::size_t>(cpu) < topo.cpu_node.size())
+    {
+        return topo.cpu_node[cpu];
+    }
+#endif
+    return 0;
+}
+
+bool bind_thread(std::size_t node)
+{
+    topology const& topo = get_topology();
+    if (node >= topo.node_cpus.size() || topo.node_cpus[node].empty()) return false;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned cpu : topo.node_cpus[node])
+    {
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+}}
@@ -0,0 +1,167 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/parse_cache.hpp>
+
+namespace mapnik
+{
+
+template class singleton<parse_cache, CreateStatic>;
+
+constexpr std::size_t parse_cache::default_max_entries;
+
+template <typename Key, typename Value>
+Value parse_cache::table<Key, Value>::find(Key const& key)
+{
+    auto itr = entries.find(key);
+    if (itr == entries.end()) return Value();
+    lru.splice(lru.begin(), lru, itr->second.lru);
+    return itr->second.value;
+}
+
+template <typename Key, typename Value>
+void parse_cache::table<Key, Value>::insert(Key const& key, Value const& value, std::size_t max_entries)
+{
+    if (max_entries == 0) return;
+    auto itr = entries.find(key);
+    if (itr != entries.end())
+    {
+        // parsed concurrently by another thread, keep the first result
+        lru.splice(lru.begin(), lru, itr->second.lru);
+        return;
+    }
+    lru.push_front(key);
+    entries.emplace(key, entry{value, lru.begin()});
+    evict(max_entries);
+}
+
+template <typename Key, typename Value>
+void parse_cache::table<Key, Value>::evict(std::size_t max_entries)
+{
+    while (entries.size() > max_entries)
+    {
+        entries.erase(lru.back());
+        lru.pop_back();
+    }
+}
+
+template <typename Key, typename Value>
+void parse_cache::table<Key, Value>::clear()
+{
+    entries.clear();
+    lru.clear();
+}
+
+parse_cache::parse_cache()
+    : expressions_(),
+      transforms_(),
+      paths_(),
+      max_entries_(default_max_entries) {}
+
+void parse_cache::set_max_entries(std::size_t max_entries)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    max_entries_ = max_entries;
+    expressions_.evict(max_entries_);
+    transforms_.evict(max_entries_);
+    paths_.evict(max_entries_);
+}
+
+std::size_t parse_cache::max_entries() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return max_entries_;
+}
+
+expression_ptr parse_cache::find_expression(std::string const& str)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return expressions_.find(str);
+}
+
+void parse_cache::insert_expression(std::string const& str, expression_ptr const& expr)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    expressions_.insert(str, expr, max_entries_);
+}
+
+transform_list_ptr parse_cache::find_transform(std::string const& str, std::string const& encoding)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return transforms_.find(std::make_pair(encoding, str));
+}
+
+void parse_cache::insert_transform(std::string const& str, std::string const& encoding, transform_list_ptr const& trans)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    transforms_.insert(std::make_pair(encoding, str), trans, max_entries_);
+}
+
+path_expression_ptr parse_cache::find_path(std::string const& str)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return paths_.find(str);
+}
+
+void parse_cache::insert_path(std::string const& str, path_expression_ptr const& path)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    paths_.insert(str, path, max_entries_);
+}
+
+std::size_t parse_cache::size() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return expressions_.entries.size() + transforms_.entries.size() + paths_.entries.size();
+}
+
+void parse_cache::clear()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    expressions_.clear();
+    transforms_.clear();
+    paths_.clear();
+}
+
+}
@@ -27,13 +27,16 @@
 #include <mapnik/value.hpp>
 
 #include <mapnik/path_expression_grammar_x3.hpp>
+#include <mapnik/parse_cache.hpp>
 
 // stl
 #include <stdexcept>
 
 namespace mapnik {
 
-path_expression_ptr parse_path(std::string const& str)
+namespace {
+
+path_expression_ptr parse_path_impl(std::string const& str)
 {
     namespace x3 = boost::spirit::x3;
     auto path = std::make_shared<path_expression>();
@@ -51,6 +54,20 @@ path_expression_ptr parse_path(std::string const& str)
     }
 }
 
+}
+
+path_expression_ptr parse_path(std::string const& str)
+{
+    parse_cache & cache = parse_cache::instance();
+    path_expression_ptr path = cache.find_path(str);
+    if (!path)
+    {
+        path = parse_path_impl(str);
+        cache.insert_path(str, path);
+    }
+    return path;
+}
+
 namespace path_processor_detail
 {
     struct path_visitor_
@@ -67,7 +84,7 @@ namespace path_processor_detail
         void operator() (attribute const& attr) const
         {
             // convert mapnik::value to std::string
-            value const& val = feature_.get(attr.name());
+            value const& val = attr.value<value, feature_impl>(feature_);
             filename_ += val.to_string();
         }
 
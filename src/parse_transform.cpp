@@ -24,13 +24,16 @@
 #include <mapnik/transform/transform_expression_grammar_x3.hpp>
 #include <mapnik/expression_grammar_x3_config.hpp> // transcoder_tag
 #include <mapnik/config_error.hpp>
+#include <mapnik/parse_cache.hpp>
 // stl
 #include <string>
 #include <stdexcept>
 
 namespace mapnik {
 
-transform_list_ptr parse_transform(std::string const& str, std::string const& encoding)
+namespace {
+
+transform_list_ptr parse_transform_impl(std::string const& str, std::string const& encoding)
 {
     using boost::spirit::x3::ascii::space;
     transform_list_ptr trans_list = std::make_shared<transform_list>();
@@ -61,5 +64,19 @@ transform_list_ptr parse_transform(std::string const& str, std::string const& en
     }
 }
 
+}
+
+transform_list_ptr parse_transform(std::string const& str, std::string const& encoding)
+{
+    parse_cache & cache = parse_cache::instance();
+    transform_list_ptr trans_list = cache.find_transform(str, encoding);
+    if (!trans_list)
+    {
+        trans_list = parse_transform_impl(str, encoding);
+        cache.insert_transform(str, encoding, trans_list);
+    }
+    return trans_list;
+}
+
 
 } // namespace mapnik
@@ -23,6 +23,7 @@
 // mapnik
 #include <mapnik/debug.hpp>
 #include <mapnik/image_reader.hpp>
+#include <mapnik/image_kernels.hpp>
 #include <mapnik/util/char_array_buffer.hpp>
 
 extern "C"
@@ -31,6 +32,7 @@ extern "C"
 }
 
 // stl
+#include <algorithm>
 #include <cstring>
 #include <memory>
 #include <fstream>
@@ -67,6 +69,7 @@ private:
     int bit_depth_;
     int color_type_;
     bool has_alpha_;
+    bool premultiply_;
 public:
     explicit png_reader(std::string const& filename);
     png_reader(char const* data, std::size_t size);
@@ -75,6 +78,7 @@ public:
     unsigned height() const final;
     boost::optional<box2d<double> > bounding_box() const final;
     inline bool has_alpha() const final { return has_alpha_; }
+    void set_premultiply(bool premultiply) final { premultiply_ = premultiply; }
     void read(unsigned x,unsigned y,image_rgba8& image) final;
     image_any read(unsigned x, unsigned y, unsigned width, unsigned height) final;
 private:
@@ -97,6 +101,11 @@ image_reader* create_png_reader2(char const * data, std::size_t size)
 
 const bool registered = register_image_reader("png",create_png_reader);
 const bool registered2 = register_image_reader("png", create_png_reader2);
+
+void premultiply_row(image_rgba8 & image, unsigned row, unsigned width)
+{
+    simd::rgba8().premultiply(image.get_row(row), width);
+}
 }
 
 
@@ -130,7 +139,8 @@ png_reader<T>::png_reader(std::string const& filename)
       height_(0),
       bit_depth_(0),
       color_type_(0),
-      has_alpha_(false)
+      has_alpha_(false),
+      premultiply_(false)
 {
     source_.open(filename, std::ios_base::in | std::ios_base::binary);
     if (!source_.is_open()) throw image_reader_exception("PNG reader: cannot open file '"+ filename + "'");
@@ -145,7 +155,8 @@ png_reader<T>::png_reader(char const* data, std::size_t size)
       height_(0),
       bit_depth_(0),
       color_type_(0),
-      has_alpha_(false)
+      has_alpha_(false),
+      premultiply_(false)
 {
     if (!stream_) throw image_reader_exception("PNG reader: cannot open image stream");
     init();
@@ -263,6 +274,10 @@ void png_reader<T>::read(unsigned x0, unsigned y0,image_rgba8& image)
     if (png_get_gAMA(png_ptr, info_ptr, &gamma))
         png_set_gamma(png_ptr, 2.2, gamma);
 
+    // opaque pixels are the same premultiplied, such images are only marked
+    bool premultiply = premultiply_ && has_alpha_;
+    if (premultiply_) image.set_premultiplied(true);
+
     if (x0 == 0 && y0 == 0 && image.width() >= width_ && image.height() >= height_)
     {
 
@@ -274,30 +289,82 @@ void png_reader<T>::read(unsigned x0, unsigned y0,image_rgba8& image)
             // so you don't need to call png_set_interlace_handling()"
         }
         png_read_update_info(png_ptr, info_ptr);
-        // we can read whole image at once
-        // alloc row pointers
-        const std::unique_ptr<png_bytep[]> rows(new png_bytep[height_]);
-        for (unsigned i=0; i<height_; ++i)
-            rows[i] = (png_bytep)image.get_row(i);
-        png_read_image(png_ptr, rows.get());
+        if (premultiply && png_get_interlace_type(png_ptr,info_ptr) != PNG_INTERLACE_ADAM7)
+        {
+            // premultiplied while the row is still in cache
+            for (unsigned i = 0; i < height_; ++i)
+            {
+                png_read_row(png_ptr, reinterpret_cast<png_bytep>(image.get_row(i)), 0);
+                premultiply_row(image, i, width_);
+            }
+        }
+        else
+        {
+            // we can read whole image at once
+            // alloc row pointers
+            const std::unique_ptr<png_bytep[]> rows(new png_bytep[height_]);
+            for (unsigned i=0; i<height_; ++i)
+                rows[i] = (png_bytep)image.get_row(i);
+            png_read_image(png_ptr, rows.get());
+            // interlaced rows are complete after the last pass only
+            if (premultiply)
+            {
+                for (unsigned i = 0; i < height_; ++i) premultiply_row(image, i, width_);
+            }
+        }
     }
     else
     {
+        if (x0 >= width_ || y0 >= height_) return;
+        int passes = png_set_interlace_handling(png_ptr);
         png_read_update_info(png_ptr, info_ptr);
         unsigned w=std::min(unsigned(image.width()),width_ - x0);
         unsigned h=std::min(unsigned(image.height()),height_ - y0);
         unsigned rowbytes=png_get_rowbytes(png_ptr, info_ptr);
+        if (passes > 1)
+        {
+            // every pass adds pixels to the rows of the window, all rows
+            // are read; libpng has no way to skip the others
+            const std::unique_ptr<png_byte[]> rows(new png_byte[rowbytes * (h + 1)]);
+            png_bytep scratch = rows.get() + rowbytes * h;
+            for (int pass = 0; pass < passes; ++pass)
+            {
+                for (unsigned i = 0; i < height_; ++i)
+                {
+                    bool inside = i >= y0 && i < y0 + h;
+                    png_read_row(png_ptr, inside ? rows.get() + rowbytes * (i - y0) : scratch, 0);
+                }
+            }
+            for (unsigned i = 0; i < h; ++i)
+            {
+                image.set_row(i, reinterpret_cast<unsigned*>(rows.get() + rowbytes * i + x0 * 4), w);
+                if (premultiply) premultiply_row(image, i, w);
+            }
+            png_read_end(png_ptr,0);
+            return;
+        }
+        // rows of the window spanning whole image rows are decoded in place
+        bool direct = x0 == 0 && image.width() >= width_;
         const std::unique_ptr<png_byte[]> row(new png_byte[rowbytes]);
         //START read image rows
-        for (unsigned i = 0;i < height_; ++i)
+        for (unsigned i = 0; i < y0 + h; ++i)
         {
+            if (direct && i >= y0)
+            {
+                png_read_row(png_ptr, reinterpret_cast<png_bytep>(image.get_row(i - y0)), 0);
+                if (premultiply) premultiply_row(image, i - y0, w);
+                continue;
+            }
             png_read_row(png_ptr,row.get(),0);
-            if (i >= y0 && i < (y0 + h))
+            if (i >= y0)
             {
                 image.set_row(i-y0,reinterpret_cast<unsigned*>(&row[x0 * 4]),w);
+                if (premultiply) premultiply_row(image, i - y0, w);
             }
         }
         //END
+        // the rows below the window are never decompressed
+        if (y0 + h < height_) return;
     }
     png_read_end(png_ptr,0);
 }
@@ -28,17 +28,49 @@
 #include <mapnik/coord.hpp>
 #include <mapnik/util/is_clockwise.hpp>
 
-#ifdef MAPNIK_USE_PROJ4
+#if defined(MAPNIK_USE_PROJ6)
+// proj
+#include <proj.h>
+#elif defined(MAPNIK_USE_PROJ4)
 // proj4
 #include <proj_api.h>
 #endif
 
 // stl
+#include <cmath>
 #include <vector>
 #include <stdexcept>
 
 namespace mapnik {
 
+#ifdef MAPNIK_USE_PROJ6
+namespace {
+
+// transforms all points in one call, false if any of them failed
+bool transform_generic(void * pipeline, PJ_DIRECTION direction,
+                       double * x, double * y, double * z, int point_count, int offset)
+{
+    if (!pipeline) return false;
+    std::size_t stride = sizeof(double) * static_cast<std::size_t>(offset);
+    std::size_t count = static_cast<std::size_t>(point_count);
+    proj_trans_generic(static_cast<PJ*>(pipeline), direction,
+                       x, stride, count,
+                       y, stride, count,
+                       z, z ? stride : 0, z ? count : 0,
+                       nullptr, 0, 0);
+    for (int i = 0; i < point_count; ++i)
+    {
+        if (x[i * offset] == HUGE_VAL || y[i * offset] == HUGE_VAL)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+#endif
+
 proj_transform::proj_transform(projection const& source,
                                projection const& dest)
     : source_(source),
@@ -75,6 +107,12 @@ proj_transform::proj_transform(projection const& source,
 #ifdef MAPNIK_USE_PROJ4
             source_.init_proj4();
             dest_.init_proj4();
+#ifdef MAPNIK_USE_PROJ6
+            if (!source_.pipeline(dest_))
+            {
+                throw std::runtime_error(std::string("Cannot initialize proj_transform for given projections: '") + source_.params() + "'->'" + dest_.params() + "'");
+            }
+#endif
 #else
             throw std::runtime_error(std::string("Cannot initialize proj_transform for given projections without proj4 support (-DMAPNIK_USE_PROJ4): '") + source_.params() + "'->'" + dest_.params() + "'");
 #endif
@@ -141,14 +179,16 @@ bool proj_transform::forward (double * x, double * y , double * z, int point_cou
 
     if (wgs84_to_merc_)
     {
-        return lonlat2merc(x,y,point_count);
+        return lonlat2merc(x,y,point_count,offset);
     }
     else if (merc_to_wgs84_)
     {
-        return merc2lonlat(x,y,point_count);
+        return merc2lonlat(x,y,point_count,offset);
     }
 
-#ifdef MAPNIK_USE_PROJ4
+#if defined(MAPNIK_USE_PROJ6)
+    return transform_generic(source_.pipeline(dest_), PJ_FWD, x, y, z, point_count, offset);
+#elif defined(MAPNIK_USE_PROJ4)
     if (is_source_longlat_)
     {
         int i;
@@ -165,7 +205,7 @@ bool proj_transform::forward (double * x, double * y , double * z, int point_cou
     }
 
     for(int j=0; j<point_count; j++) {
-        if (x[j] == HUGE_VAL || y[j] == HUGE_VAL)
+        if (x[j*offset] == HUGE_VAL || y[j*offset] == HUGE_VAL)
         {
             return false;
         }
@@ -190,14 +230,16 @@ bool proj_transform::backward (double * x, double * y , double * z, int point_co
 
     if (wgs84_to_merc_)
     {
-        return merc2lonlat(x,y,point_count);
+        return merc2lonlat(x,y,point_count,offset);
     }
     else if (merc_to_wgs84_)
     {
-        return lonlat2merc(x,y,point_count);
+        return lonlat2merc(x,y,point_count,offset);
     }
 
-#ifdef MAPNIK_USE_PROJ4
+#if defined(MAPNIK_USE_PROJ6)
+    return transform_generic(source_.pipeline(dest_), PJ_INV, x, y, z, point_count, offset);
+#elif defined(MAPNIK_USE_PROJ4)
     if (is_dest_longlat_)
     {
         for (int i = 0; i < point_count; ++i)
@@ -215,7 +257,7 @@ bool proj_transform::backward (double * x, double * y , double * z, int point_co
 
     for (int j = 0; j < point_count; ++j)
     {
-        if (x[j] == HUGE_VAL || y[j] == HUGE_VAL)
+        if (x[j * offset] == HUGE_VAL || y[j * offset] == HUGE_VAL)
         {
             return false;
         }
@@ -365,6 +407,8 @@ void envelope_points(std::vector< coord<double,2> > & coords, box2d<double>& env
     }
 }
 
+static_assert(sizeof(coord<double,2>) == 2 * sizeof(double), "coords are transformed as strided doubles");
+
 box2d<double> calculate_bbox(std::vector<coord<double,2> > & points) {
     std::vector<coord<double,2> >::iterator it = points.begin();
     std::vector<coord<double,2> >::iterator it_end = points.end();
@@ -396,12 +440,10 @@ bool proj_transform::backward(box2d<double>& env, int points) const
     std::vector<coord<double,2> > coords;
     envelope_points(coords, env, points);  // this is always clockwise
 
-    double z;
-    for (std::vector<coord<double,2> >::iterator it = coords.begin(); it!=coords.end(); ++it) {
-        z = 0;
-        if (!backward(it->x, it->y, z)) {
-            return false;
-        }
+    // all points in one go, coord<double,2> is a pair of doubles
+    if (!backward(&coords[0].x, &coords[0].y, nullptr, static_cast<int>(coords.size()), 2))
+    {
+        return false;
     }
 
     box2d<double> result = calculate_bbox(coords);
@@ -435,12 +477,10 @@ bool proj_transform::forward(box2d<double>& env, int points) const
     std::vector<coord<double,2> > coords;
     envelope_points(coords, env, points);  // this is always clockwise
 
-    double z;
-    for (std::vector<coord<double,2> >::iterator it = coords.begin(); it!=coords.end(); ++it) {
-        z = 0;
-        if (!forward(it->x, it->y, z)) {
-            return false;
-        }
+    // all points in one go, coord<double,2> is a pair of doubles
+    if (!forward(&coords[0].x, &coords[0].y, nullptr, static_cast<int>(coords.size()), 2))
+    {
+        return false;
     }
 
     box2d<double> result = calculate_bbox(coords);
@@ -28,7 +28,12 @@
 // stl
 #include <stdexcept>
 
-#ifdef MAPNIK_USE_PROJ4
+#if defined(MAPNIK_USE_PROJ6)
+// proj
+#include <proj.h>
+#include <map>
+#include <utility>
+#elif defined(MAPNIK_USE_PROJ4)
 // proj4
 #include <proj_api.h>
  #if defined(MAPNIK_THREADSAFE) && PJ_VERSION < 480
@@ -44,6 +49,102 @@
 
 namespace mapnik {
 
+#ifdef MAPNIK_USE_PROJ6
+namespace {
+
+// proj strings only name a coordinate system when they say so
+std::string crs_definition(std::string const& params)
+{
+    if (!params.empty() && params[0] == '+' && params.find("+type=crs") == std::string::npos)
+    {
+        return params + " +type=crs";
+    }
+    return params;
+}
+
+bool is_geographic_crs(PJ * crs)
+{
+    switch (proj_get_type(crs))
+    {
+    case PJ_TYPE_GEOGRAPHIC_CRS:
+    case PJ_TYPE_GEOGRAPHIC_2D_CRS:
+    case PJ_TYPE_GEOGRAPHIC_3D_CRS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Transformation from source to dest in longitude, latitude order and
+// degrees, as the rest of mapnik expects coordinates. Null on failure.
+PJ * create_pipeline(PJ_CONTEXT * ctx, std::string const& source, std::string const& dest)
+{
+    PJ * pj = proj_create_crs_to_crs(ctx, crs_definition(source).c_str(),
+                                     crs_definition(dest).c_str(), nullptr);
+    if (!pj) return nullptr;
+    PJ * normalized = proj_normalize_for_visualization(ctx, pj);
+    proj_destroy(pj);
+    return normalized;
+}
+
+// PROJ objects belong to the context they were made in and a context
+// must not be used by two threads at once. Every thread keeps a context
+// of its own with the pipelines it made between pairs of projections.
+class thread_pipelines
+{
+public:
+    thread_pipelines()
+        : ctx_(proj_context_create()),
+          pipelines_() {}
+
+    ~thread_pipelines()
+    {
+        for (auto const& item : pipelines_)
+        {
+            if (item.second) proj_destroy(item.second);
+        }
+        proj_context_destroy(ctx_);
+    }
+
+    PJ * get(std::string const& source, std::string const& dest)
+    {
+        auto key = std::make_pair(source, dest);
+        auto itr = pipelines_.find(key);
+        if (itr != pipelines_.end()) return itr->second;
+        PJ * pj = create_pipeline(ctx_, source, dest);
+        pipelines_.emplace(std::move(key), pj);
+        return pj;
+    }
+
+private:
+    PJ_CONTEXT * ctx_;
+    std::map<std::pair<std::string, std::string>, PJ *> pipelines_;
+};
+
+// Transforms between the geographic coordinate system crs is based on,
+// in degrees, and crs.
+void transform_geographic(PJ_CONTEXT * ctx, PJ * crs, std::string const& params,
+                          double & x, double & y, PJ_DIRECTION direction)
+{
+    PJ * geographic = proj_crs_get_geodetic_crs(ctx, crs);
+    PJ * pj = geographic ? proj_create_crs_to_crs_from_pj(ctx, geographic, crs, nullptr, nullptr) : nullptr;
+    PJ * normalized = pj ? proj_normalize_for_visualization(ctx, pj) : nullptr;
+    if (pj) proj_destroy(pj);
+    if (geographic) proj_destroy(geographic);
+    if (!normalized)
+    {
+        throw std::runtime_error("projection: cannot transform with '" + params + "'");
+    }
+    PJ_COORD c = proj_coord(x, y, 0, 0);
+    c = proj_trans(normalized, direction, c);
+    proj_destroy(normalized);
+    x = c.xy.x;
+    y = c.xy.y;
+}
+
+}
+#endif
+
 
 projection::projection(std::string const& params, bool defer_proj_init)
     : params_(params),
@@ -99,7 +200,21 @@ bool projection::operator!=(const projection& other) const
 
 void projection::init_proj4() const
 {
-#ifdef MAPNIK_USE_PROJ4
+#if defined(MAPNIK_USE_PROJ6)
+    if (!proj_)
+    {
+        PJ_CONTEXT * ctx = proj_context_create();
+        PJ * crs = ctx ? proj_create(ctx, crs_definition(params_).c_str()) : nullptr;
+        if (!crs)
+        {
+            if (ctx) proj_context_destroy(ctx);
+            throw proj_init_error(params_);
+        }
+        proj_ctx_ = ctx;
+        proj_ = crs;
+        is_geographic_ = is_geographic_crs(crs);
+    }
+#elif defined(MAPNIK_USE_PROJ4)
     if (!proj_)
     {
 #if PJ_VERSION >= 480
@@ -151,7 +266,13 @@ std::string const& projection::params() const
 
 void projection::forward(double & x, double &y ) const
 {
-#ifdef MAPNIK_USE_PROJ4
+#if defined(MAPNIK_USE_PROJ6)
+    if (!proj_)
+    {
+        throw std::runtime_error("projection::forward not supported unless proj4 is initialized");
+    }
+    transform_geographic(static_cast<PJ_CONTEXT*>(proj_ctx_), static_cast<PJ*>(proj_), params_, x, y, PJ_FWD);
+#elif defined(MAPNIK_USE_PROJ4)
     if (!proj_)
     {
         throw std::runtime_error("projection::forward not supported unless proj4 is initialized");
@@ -177,7 +298,13 @@ void projection::forward(double & x, double &y ) const
 
 void projection::inverse(double & x,double & y) const
 {
-#ifdef MAPNIK_USE_PROJ4
+#if defined(MAPNIK_USE_PROJ6)
+    if (!proj_)
+    {
+        throw std::runtime_error("projection::inverse not supported unless proj4 is initialized");
+    }
+    transform_geographic(static_cast<PJ_CONTEXT*>(proj_ctx_), static_cast<PJ*>(proj_), params_, x, y, PJ_INV);
+#elif defined(MAPNIK_USE_PROJ4)
     if (!proj_)
     {
         throw std::runtime_error("projection::inverse not supported unless proj4 is initialized");
@@ -202,9 +329,33 @@ void projection::inverse(double & x,double & y) const
 #endif
 }
 
+#ifdef MAPNIK_USE_PROJ6
+void * projection::pipeline(projection const& dest) const
+{
+    thread_local thread_pipelines pipelines;
+    return pipelines.get(params_, dest.params_);
+}
+#else
+void * projection::pipeline(projection const&) const
+{
+    return nullptr;
+}
+#endif
+
 projection::~projection()
 {
-#ifdef MAPNIK_USE_PROJ4
+#if defined(MAPNIK_USE_PROJ6)
+    if (proj_)
+    {
+        proj_destroy(static_cast<PJ*>(proj_));
+        proj_ = nullptr;
+    }
+    if (proj_ctx_)
+    {
+        proj_context_destroy(static_cast<PJ_CONTEXT*>(proj_ctx_));
+        proj_ctx_ = nullptr;
+    }
+#elif defined(MAPNIK_USE_PROJ4)
  #if defined(MAPNIK_THREADSAFE) && PJ_VERSION < 480
     std::lock_guard<std::mutex> lock(mutex_);
  #endif
@@ -225,7 +376,14 @@ projection::~projection()
 
 std::string projection::expanded() const
 {
-#ifdef MAPNIK_USE_PROJ4
+#if defined(MAPNIK_USE_PROJ6)
+    if (proj_)
+    {
+        char const* def = proj_as_proj_string(static_cast<PJ_CONTEXT*>(proj_ctx_),
+                                               static_cast<PJ*>(proj_), PJ_PROJ_4, nullptr);
+        if (def) return mapnik::util::trim_copy(def);
+    }
+#elif defined(MAPNIK_USE_PROJ4)
     if (proj_) return mapnik::util::trim_copy(pj_get_def( proj_, 0 ));
 #endif
     return params_;
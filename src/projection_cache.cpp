@@ -0,0 +1,91 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/projection_cache.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+
+// stl
+#include <functional>
+
+namespace mapnik {
+
+projection_cache & projection_cache::instance()
+{
+#ifdef MAPNIK_THREADSAFE
+    static thread_local projection_cache cache;
+#else
+    static projection_cache cache;
+#endif
+    return cache;
+}
+
+projection_cache::projection_cache()
+    : projections_(),
+      transforms_() {}
+
+projection_cache::~projection_cache() {}
+
+std::size_t projection_cache::pair_hash::operator()(std::pair<std::string, std::string> const& key) const
+{
+    std::hash<std::string> hasher;
+    return hasher(key.first) ^ (hasher(key.second) * 31);
+}
+
+projection const& projection_cache::get(std::string const& srs)
+{
+    auto itr = projections_.find(srs);
+    if (itr == projections_.end())
+    {
+        // proj4 is initialized on first use by a proj_transform
+        std::unique_ptr<projection> proj(new projection(srs, true));
+        itr = projections_.emplace(srs, std::move(proj)).first;
+    }
+    return *itr->second;
+}
+
+proj_transform const& projection_cache::get(std::string const& source, std::string const& dest)
+{
+    auto key = std::make_pair(source, dest);
+    auto itr = transforms_.find(key);
+    if (itr == transforms_.end())
+    {
+        std::unique_ptr<proj_transform> trans(new proj_transform(get(source), get(dest)));
+        itr = transforms_.emplace(std::move(key), std::move(trans)).first;
+    }
+    return *itr->second;
+}
+
+std::size_t projection_cache::size() const
+{
+    return projections_.size();
+}
+
+void projection_cache::clear()
+{
+    transforms_.clear();
+    projections_.clear();
+}
+
+}
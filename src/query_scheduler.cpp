@@ -0,0 +1,289 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/query_scheduler.hpp>
+#include <mapnik/executor.hpp>
+
+// stl
+#include <algorithm>
+#include <exception>
+
+namespace mapnik
+{
+
+template class singleton<query_scheduler, CreateStatic>;
+
+namespace detail {
+
+struct query_task
+{
+    enum state_type { pending, running, done, cancelled };
+
+    query_task(std::string const& k, std::function<featureset_ptr()> && f)
+        : key(k),
+          func(std::move(f)),
+          state(pending) {}
+
+    std::string key;
+    std::function<featureset_ptr()> func;
+    featureset_ptr result;
+    std::exception_ptr error;
+    state_type state;
+};
+
+}
+
+query_handle::query_handle(std::shared_ptr<detail::query_task> const& task)
+    : task_(task) {}
+
+bool query_handle::ready() const
+{
+    if (!task_) return false;
+    query_scheduler & scheduler = query_scheduler::instance();
+    std::lock_guard<std::mutex> lock(scheduler.mutex_);
+    return task_->state == detail::query_task::done;
+}
+
+featureset_ptr query_handle::get()
+{
+    if (!task_) return featureset_ptr();
+    query_scheduler & scheduler = query_scheduler::instance();
+    std::unique_lock<std::mutex> lock(scheduler.mutex_);
+    while (task_->state != detail::query_task::done)
+    {
+        if (task_->state == detail::query_task::cancelled)
+        {
+            return featureset_ptr();
+        }
+        if (task_->state == detail::query_task::pending && scheduler.can_start(*task_))
+        {
+            scheduler.start(task_);
+            scheduler.run(task_, lock);
+        }
+        else
+        {
+            scheduler.done_cond_.wait(lock);
+        }
+    }
+    std::shared_ptr<detail::query_task> task = std::move(task_);
+    lock.unlock();
+    if (task->error) std::rethrow_exception(task->error);
+    return std::move(task->result);
+}
+
+void query_handle::cancel()
+{
+    if (!task_) return;
+    query_scheduler & scheduler = query_scheduler::instance();
+    std::unique_lock<std::mutex> lock(scheduler.mutex_);
+    if (task_->state == detail::query_task::pending)
+    {
+        task_->state = detail::query_task::cancelled;
+        task_->func = nullptr;
+        auto & pending = scheduler.pending_;
+        pending.erase(std::remove(pending.begin(), pending.end(), task_), pending.end());
+    }
+    while (task_->state == detail::query_task::running)
+    {
+        scheduler.done_cond_.wait(lock);
+    }
+    // release the featureset while the datasource is known to be alive
+    featureset_ptr result = std::move(task_->result);
+    task_.reset();
+    lock.unlock();
+}
+
+query_scheduler::query_scheduler()
+    : mutex_(),
+      done_cond_(),
+      pending_(),
+      budgets_(),
+      in_flight_(),
+      posted_(0),
+      waiting_(0),
+      slots_(0),
+      stop_(false) {}
+
+query_scheduler::~query_scheduler()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    // posted queries still hold on to this
+    done_cond_.wait(lock, [this] { return posted_ == 0; });
+}
+
+query_handle query_scheduler::submit(std::string const& key, std::function<featureset_ptr()> func)
+{
+    auto task = std::make_shared<detail::query_task>(key, std::move(func));
+    std::unique_lock<std::mutex> lock(mutex_);
+    pending_.push_back(task);
+    dispatch(lock);
+    return query_handle(task);
+}
+
+void query_scheduler::set_budget(std::string const& key, std::size_t max_in_flight)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    budgets_[key] = max_in_flight;
+    // a larger budget may unblock pending queries
+    done_cond_.notify_all();
+    dispatch(lock);
+}
+
+std::size_t query_scheduler::budget(std::string const& key) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto itr = budgets_.find(key);
+    return itr != budgets_.end() ? itr->second : 0;
+}
+
+std::size_t query_scheduler::in_flight(std::string const& key) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto itr = in_flight_.find(key);
+    return itr != in_flight_.end() ? itr->second : 0;
+}
+
+void query_scheduler::reserve_threads(std::size_t count)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::unique_lock<std::mutex> lock(mutex_);
+    slots_ = std::max(slots_, count);
+    dispatch(lock);
+#else
+    (void)count;
+#endif
+}
+
+std::size_t query_scheduler::threads() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::size_t io_threads = get_io_executor()->concurrency();
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::min(slots_, io_threads);
+#else
+    return 0;
+#endif
+}
+
+// requires mutex_
+bool query_scheduler::can_start(detail::query_task const& task) const
+{
+    auto budget = budgets_.find(task.key);
+    if (budget == budgets_.end() || budget->second == 0) return true;
+    auto count = in_flight_.find(task.key);
+    return count == in_flight_.end() || count->second < budget->second;
+}
+
+// requires mutex_
+void query_scheduler::start(task_ptr const& task)
+{
+    task->state = detail::query_task::running;
+    ++in_flight_[task->key];
+    pending_.erase(std::remove(pending_.begin(), pending_.end(), task), pending_.end());
+}
+
+// requires mutex_ held by lock, releases it while the query runs
+void query_scheduler::run(task_ptr const& task, std::unique_lock<std::mutex> & lock)
+{
+    std::function<featureset_ptr()> func = std::move(task->func);
+    lock.unlock();
+    featureset_ptr result;
+    std::exception_ptr error;
+    try
+    {
+        result = func();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    func = nullptr;
+    lock.lock();
+    task->result = std::move(result);
+    task->error = error;
+    task->state = detail::query_task::done;
+    --in_flight_[task->key];
+    done_cond_.notify_all();
+    dispatch(lock);
+}
+
+// requires mutex_ held by lock, releases it while posting
+void query_scheduler::dispatch(std::unique_lock<std::mutex> & lock)
+{
+    // queries block, they go to the I/O executor and never take more of
+    // its threads than it has; without threads they are left for the
+    // callers waiting on them to run
+    std::shared_ptr<executor> ex = get_io_executor();
+    std::size_t slots = std::min(slots_, ex->concurrency());
+    if (stop_ || posted_ >= slots) return;
+    // one executor task per query the budgets let start now; a task
+    // finding its query taken by a waiting caller just returns
+    std::map<std::string, std::size_t> starting;
+    std::size_t startable = 0;
+    for (task_ptr const& task : pending_)
+    {
+        auto budget = budgets_.find(task->key);
+        if (budget != budgets_.end() && budget->second > 0)
+        {
+            auto count = in_flight_.find(task->key);
+            std::size_t running = count != in_flight_.end() ? count->second : 0;
+            std::size_t & started = starting[task->key];
+            if (running + started >= budget->second) continue;
+            ++started;
+        }
+        ++startable;
+    }
+    if (startable <= waiting_) return;
+    std::size_t count = std::min(startable - waiting_, slots - posted_);
+    posted_ += count;
+    waiting_ += count;
+    lock.unlock();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        ex->post([this] { execute(); });
+    }
+    lock.lock();
+}
+
+void query_scheduler::execute()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    --waiting_;
+    if (!stop_)
+    {
+        auto itr = std::find_if(pending_.begin(), pending_.end(),
+                                [this](task_ptr const& task) { return can_start(*task); });
+        if (itr != pending_.end())
+        {
+            task_ptr task = *itr;
+            start(task);
+            run(task, lock);
+        }
+    }
+    --posted_;
+    done_cond_.notify_all();
+    dispatch(lock);
+}
+
+}
@@ -28,10 +28,16 @@
 #include <mapnik/raster.hpp>
 #include <mapnik/raster_colorizer.hpp>
 #include <mapnik/enumeration.hpp>
+#include <mapnik/executor.hpp>
 
 // stl
-#include <limits>
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <type_traits>
+#include <vector>
 
 namespace mapnik
 {
@@ -125,26 +131,63 @@ bool raster_colorizer::add_stop(colorizer_stop const& stop)
 template <typename T>
 void raster_colorizer::colorize(image_rgba8 & out, T const& in,
                                 boost::optional<double> const& nodata,
-                                feature_impl const& f) const
+                                feature_impl const& f,
+                                unsigned threads) const
 {
     using image_type = T;
     using pixel_type = typename image_type::pixel_type;
     // TODO: assuming in/out have the same width/height for now
     std::uint32_t * out_data = out.data();
     pixel_type const* in_data = in.data();
-    int len = out.width() * out.height();
-    for (int i=0; i<len; ++i)
-    {
-        pixel_type val = in_data[i];
+    std::size_t width = out.width();
+    std::size_t height = out.height();
+    std::size_t len = width * height;
+
+    auto pixel_color = [&](pixel_type val) -> std::uint32_t {
         if (nodata && (std::fabs(val - *nodata) < epsilon_))
         {
-            out_data[i] = 0; // rgba(0,0,0,0)
+            return 0; // rgba(0,0,0,0)
         }
-        else
+        return get_color(val);
+    };
+
+    // a color for every value of narrow integer bands, once the image
+    // has more pixels than there are values
+    constexpr bool use_lut = std::is_integral<pixel_type>::value && sizeof(pixel_type) <= 2;
+    std::size_t const lut_size = std::size_t(1) << (8 * sizeof(pixel_type));
+    std::vector<std::uint32_t> lut;
+    if (use_lut && len >= lut_size)
+    {
+        lut.resize(lut_size);
+        for (std::size_t v = 0; v < lut_size; ++v)
         {
-            out_data[i] = get_color(val);
+            pixel_type val = static_cast<pixel_type>(std::numeric_limits<pixel_type>::min() + static_cast<std::int64_t>(v));
+            lut[v] = pixel_color(val);
         }
     }
+
+    auto colorize_rows = [&](std::size_t y0, std::size_t y1) {
+        std::size_t first = y0 * width;
+        std::size_t last = y1 * width;
+        if (!lut.empty())
+        {
+            for (std::size_t i = first; i < last; ++i)
+            {
+                out_data[i] = lut[static_cast<std::int64_t>(in_data[i]) - std::numeric_limits<pixel_type>::min()];
+            }
+        }
+        else
+        {
+            for (std::size_t i = first; i < last; ++i)
+            {
+                out_data[i] = pixel_color(in_data[i]);
+            }
+        }
+    };
+    // below this many pixels a thread costs more than it saves
+    std::size_t const min_pixels_per_thread = 256 * 256;
+    parallel_bands(height, std::min(static_cast<std::size_t>(threads), len / min_pixels_per_thread),
+                   colorize_rows);
 }
 
 inline unsigned interpolate(unsigned start, unsigned end, float fraction)
@@ -162,24 +205,10 @@ unsigned raster_colorizer::get_color(float val) const
         return default_color_.rgba();
     }
 
-    //1 - Find the stop that the val is in
-    int stopIdx = -1;
-    bool foundStopIdx = false;
-
-    for(int i=0; i<stopCount; ++i)
-    {
-        if (val < stops_[i].get_value())
-        {
-            stopIdx = i-1;
-            foundStopIdx = true;
-            break;
-        }
-    }
-
-    if(!foundStopIdx)
-    {
-        stopIdx = stopCount-1;
-    }
+    //1 - Find the stop that the val is in, the last one at or below val
+    auto upper = std::upper_bound(stops_.begin(), stops_.end(), val,
+                                  [](float v, colorizer_stop const& stop) { return v < stop.get_value(); });
+    int stopIdx = static_cast<int>(upper - stops_.begin()) - 1;
 
     //2 - Find the next stop
     int nextStopIdx = stopIdx + 1;
@@ -288,33 +317,33 @@ unsigned raster_colorizer::get_color(float val) const
 
 template void raster_colorizer::colorize(image_rgba8 & out, image_gray8 const& in,
                                 boost::optional<double>const& nodata,
-                                feature_impl const& f) const;
+                                feature_impl const& f, unsigned threads) const;
 template void raster_colorizer::colorize(image_rgba8 & out, image_gray8s const& in,
                                 boost::optional<double>const& nodata,
-                                feature_impl const& f) const;
+                                feature_impl const& f, unsigned threads) const;
 template void raster_colorizer::colorize(image_rgba8 & out, image_gray16 const& in,
                                 boost::optional<double>const& nodata,
-                                feature_impl const& f) const;
+                                feature_impl const& f, unsigned threads) const;
 template void raster_colorizer::colorize(image_rgba8 & out, image_gray16s const& in,
                                 boost::optional<double>const& nodata,
-                                feature_impl const& f) const;
+                                feature_impl const& f, unsigned threads) const;
 template void raster_colorizer::colorize(image_rgba8 & out, image_gray32 const& in,
                                          boost::optional<double>const& nodata,
-                                         feature_impl const& f) const;
+                                         feature_impl const& f, unsigned threads) const;
 template void raster_colorizer::colorize(image_rgba8 & out, image_gray32s const& in,
                                          boost::optional<double>const& nodata,
-                                         feature_impl const& f) const;
+                                         feature_impl const& f, unsigned threads) const;
 template void raster_colorizer::colorize(image_rgba8 & out, image_gray32f const& in,
                                          boost::optional<double>const& nodata,
-                                         feature_impl const& f) const;
+                                         feature_impl const& f, unsigned threads) const;
 template void raster_colorizer::colorize(image_rgba8 & out, image_gray64 const& in,
                                          boost::optional<double>const& nodata,
-                                         feature_impl const& f) const;
+                                         feature_impl const& f, unsigned threads) const;
 template void raster_colorizer::colorize(image_rgba8 & out, image_gray64s const& in,
                                          boost::optional<double>const& nodata,
-                                         feature_impl const& f) const;
+                                         feature_impl const& f, unsigned threads) const;
 template void raster_colorizer::colorize(image_rgba8 & out, image_gray64f const& in,
                                          boost::optional<double>const& nodata,
-                                         feature_impl const& f) const;
+                                         feature_impl const& f, unsigned threads) const;
 
 }
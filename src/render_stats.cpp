@@ -0,0 +1,119 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/render_stats.hpp>
+#include <mapnik/util/variant.hpp>
+
+namespace mapnik
+{
+
+namespace {
+
+struct vertex_counter
+{
+    std::size_t operator() (geometry::geometry_empty const&) const
+    {
+        return 0;
+    }
+
+    std::size_t operator() (geometry::point<double> const&) const
+    {
+        return 1;
+    }
+
+    std::size_t operator() (geometry::line_string<double> const& line) const
+    {
+        return line.size();
+    }
+
+    std::size_t operator() (geometry::polygon<double> const& poly) const
+    {
+        std::size_t count = 0;
+        for (auto const& ring : poly) count += ring.size();
+        return count;
+    }
+
+    std::size_t operator() (geometry::multi_point<double> const& multi_pt) const
+    {
+        return multi_pt.size();
+    }
+
+    std::size_t operator() (geometry::multi_line_string<double> const& multi_line) const
+    {
+        std::size_t count = 0;
+        for (auto const& line : multi_line) count += (*this)(line);
+        return count;
+    }
+
+    std::size_t operator() (geometry::multi_polygon<double> const& multi_poly) const
+    {
+        std::size_t count = 0;
+        for (auto const& poly : multi_poly) count += (*this)(poly);
+        return count;
+    }
+
+    std::size_t operator() (geometry::geometry_collection<double> const& collection) const
+    {
+        std::size_t count = 0;
+        for (auto const& geom : collection) count += util::apply_visitor(*this, geom);
+        return count;
+    }
+};
+
+}
+
+void render_stats::clear()
+{
+    layers.clear();
+    total = duration::zero();
+    allocations = alloc_phase_counters();
+    peak_bytes = 0;
+}
+
+std::size_t render_stats::features() const
+{
+    std::size_t count = 0;
+    for (layer_stats const& lay : layers)
+    {
+        for (style_stats const& style : lay.styles) count += style.features;
+    }
+    return count;
+}
+
+std::size_t render_stats::vertices() const
+{
+    std::size_t count = 0;
+    for (layer_stats const& lay : layers)
+    {
+        for (style_stats const& style : lay.styles) count += style.vertices;
+    }
+    return count;
+}
+
+std::size_t render_stats::vertex_count(geometry::geometry<double> const& geom)
+{
+    return util::apply_visitor(vertex_counter(), geom);
+}
+
+}
@@ -88,6 +88,15 @@ renderer_common::renderer_common(Map const &m, request const &req, attributes co
                                       req.width() + req.buffer_size() ,req.height() + req.buffer_size())))
 {}
 
+renderer_common::renderer_common(Map const &m, request const &req, attributes const& vars, unsigned offset_x, unsigned offset_y,
+                                 unsigned width, unsigned height, double scale_factor,
+                                 detector_ptr detector)
+   : renderer_common(m, width, height, scale_factor,
+                     vars,
+                     view_transform(req.width(),req.height(),req.extent(),offset_x,offset_y),
+                     detector)
+{}
+
 renderer_common::~renderer_common()
 {
     // defined in .cpp to make this destructible elsewhere without
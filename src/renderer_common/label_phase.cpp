@@ -0,0 +1,280 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/renderer_common/label_phase.hpp>
+#include <mapnik/renderer_common.hpp>
+#include <mapnik/label_collision_detector.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/projection_cache.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/text/symbolizer_helpers.hpp>
+#include <mapnik/make_unique.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_trans_affine.h"
+#pragma GCC diagnostic pop
+
+namespace mapnik {
+
+struct label_phase::batch
+{
+    batch(view_transform const& _t,
+          box2d<double> const& _clip_box,
+          proj_transform const& _prj_trans,
+          double _max_coverage,
+          std::vector<candidate> && _candidates)
+        : t(_t),
+          clip_box(_clip_box),
+          prj_trans(_prj_trans),
+          max_coverage(_max_coverage),
+          candidates(std::move(_candidates)) {}
+
+    // copies of the view state when the style ended, the helpers refer
+    // to them
+    view_transform t;
+    box2d<double> clip_box;
+    proj_transform const& prj_trans;
+    double max_coverage;
+    std::vector<candidate> candidates;
+    // aligned with candidates, sized before any helper is made
+    std::vector<agg::trans_affine> transforms;
+    std::vector<std::unique_ptr<text_symbolizer_helper>> helpers;
+    std::vector<placements_list const*> placements;
+};
+
+label_phase::label_phase(renderer_common & common, Map const& m)
+    : common_(common),
+      map_(m),
+      font_library_(),
+      font_manager_(),
+      batches_(),
+      placed_(0)
+#ifdef MAPNIK_THREADSAFE
+      , draw_(nullptr),
+      drawn_(false),
+      stop_(false)
+#endif
+{
+#ifdef MAPNIK_THREADSAFE
+    thread_ = std::thread(&label_phase::run, this);
+#else
+    font_manager_ = std::make_unique<face_manager_freetype>(font_library_,
+                                                            map_.get_font_file_mapping(),
+                                                            map_.get_font_memory_cache());
+#endif
+}
+
+label_phase::~label_phase()
+{
+#ifdef MAPNIK_THREADSAFE
+    if (thread_.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cond_.notify_all();
+        thread_.join();
+    }
+#endif
+}
+
+void label_phase::place(std::vector<candidate> && candidates,
+                        proj_transform const& prj_trans,
+                        double max_coverage)
+{
+    // the layer's transform goes away with the layer, the cached one stays
+    proj_transform const& cached_trans = projection_cache::instance().get(prj_trans.source().params(),
+                                                                          prj_trans.dest().params());
+    // the glyphs are drawn into the map's image, not a style's inflated buffer
+    auto b = std::make_unique<batch>(common_.t_, common_.query_extent_, cached_trans,
+                                     max_coverage, std::move(candidates));
+    b->t.set_offset(0);
+#ifdef MAPNIK_THREADSAFE
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batches_.push_back(std::move(b));
+    }
+    cond_.notify_all();
+#else
+    batches_.push_back(std::move(b));
+    place_batch(*batches_.back());
+    ++placed_;
+#endif
+}
+
+void label_phase::wait()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return placed_ == batches_.size(); });
+    if (error_) std::rethrow_exception(error_);
+#endif
+}
+
+void label_phase::draw(draw_function const& draw)
+{
+#ifdef MAPNIK_THREADSAFE
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        draw_ = &draw;
+        cond_.notify_all();
+        cond_.wait(lock, [this] { return drawn_; });
+    }
+    thread_.join();
+    if (error_) std::rethrow_exception(error_);
+#else
+    draw_batches(draw);
+    batches_.clear();
+#endif
+}
+
+void label_phase::place_batch(batch & b)
+{
+    std::size_t size = b.candidates.size();
+    b.transforms.resize(size);
+    b.helpers.resize(size);
+    b.placements.resize(size, nullptr);
+    label_collision_detector4 & detector = *common_.detector_;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        // once the tile is saturated the remaining labels can't fit
+        if (b.max_coverage < 1.0 && detector.coverage() >= b.max_coverage) break;
+        candidate const& c = b.candidates[i];
+        feature_impl const& feature = *c.feature;
+        agg::trans_affine & tr = b.transforms[i];
+        if (c.sym->is<text_symbolizer>())
+        {
+            text_symbolizer const& sym = c.sym->get<text_symbolizer>();
+            auto transform = get_optional<transform_type>(sym, keys::geometry_transform);
+            if (transform) evaluate_transform(tr, feature, common_.vars_, *transform, common_.scale_factor_);
+            b.helpers[i] = std::make_unique<text_symbolizer_helper>(
+                sym, feature, common_.vars_, b.prj_trans,
+                common_.width_, common_.height_,
+                common_.scale_factor_,
+                b.t, *font_manager_, detector,
+                b.clip_box, tr);
+        }
+        else
+        {
+            shield_symbolizer const& sym = c.sym->get<shield_symbolizer>();
+            auto transform = get_optional<transform_type>(sym, keys::geometry_transform);
+            if (transform) evaluate_transform(tr, feature, common_.vars_, *transform, common_.scale_factor_);
+            b.helpers[i] = std::make_unique<text_symbolizer_helper>(
+                sym, feature, common_.vars_, b.prj_trans,
+                common_.width_, common_.height_,
+                common_.scale_factor_,
+                b.t, *font_manager_, detector,
+                b.clip_box, tr);
+        }
+        b.placements[i] = &b.helpers[i]->get();
+    }
+}
+
+void label_phase::draw_batches(draw_function const& draw)
+{
+    for (auto const& b : batches_)
+    {
+        for (std::size_t i = 0; i < b->placements.size(); ++i)
+        {
+            placements_list const* placements = b->placements[i];
+            if (!placements || placements->empty()) continue;
+            candidate const& c = b->candidates[i];
+            bool shield = c.sym->is<shield_symbolizer>();
+            symbolizer_base const& sym = shield
+                ? static_cast<symbolizer_base const&>(c.sym->get<shield_symbolizer>())
+                : static_cast<symbolizer_base const&>(c.sym->get<text_symbolizer>());
+            draw(placed_label{*c.feature, sym, shield, *placements}, *font_manager_);
+        }
+    }
+}
+
+#ifdef MAPNIK_THREADSAFE
+void label_phase::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    try
+    {
+        font_manager_ = std::make_unique<face_manager_freetype>(font_library_,
+                                                                map_.get_font_file_mapping(),
+                                                                map_.get_font_memory_cache());
+    }
+    catch (...)
+    {
+        error_ = std::current_exception();
+    }
+    while (true)
+    {
+        cond_.wait(lock, [this] { return stop_ || draw_ || placed_ < batches_.size(); });
+        if (!stop_ && placed_ < batches_.size())
+        {
+            batch & b = *batches_[placed_];
+            bool failed = static_cast<bool>(error_);
+            lock.unlock();
+            if (!failed)
+            {
+                try
+                {
+                    place_batch(b);
+                }
+                catch (...)
+                {
+                    lock.lock();
+                    error_ = std::current_exception();
+                    lock.unlock();
+                }
+            }
+            lock.lock();
+            ++placed_;
+            cond_.notify_all();
+            continue;
+        }
+        draw_function const* draw = stop_ ? nullptr : draw_;
+        bool failed = static_cast<bool>(error_);
+        lock.unlock();
+        try
+        {
+            if (draw && !failed) draw_batches(*draw);
+        }
+        catch (...)
+        {
+            lock.lock();
+            error_ = std::current_exception();
+            lock.unlock();
+        }
+        // the fonts, and the glyphs referring to them, go with this thread
+        batches_.clear();
+        font_manager_.reset();
+        lock.lock();
+        drawn_ = true;
+        cond_.notify_all();
+        return;
+    }
+}
+#endif
+
+} // namespace mapnik
@@ -0,0 +1,170 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/renderer_common/layer_buckets.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/attribute_collector.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/geometry/envelope.hpp>
+
+// stl
+#include <set>
+#include <string>
+
+namespace mapnik {
+
+namespace detail {
+
+namespace {
+
+bool bucket_layer(Map const& m,
+                  layer & lay,
+                  std::vector<box2d<double>> const& extents,
+                  double scale_denom,
+                  bool spatial_index,
+                  bucket_list & buckets)
+{
+    datasource_ptr ds = lay.datasource();
+    if (!ds || ds->type() == datasource::Raster || !lay.visible(scale_denom)) return false;
+
+    projection proj0(m.srs(), true);
+    projection proj1(lay.srs(), true);
+    proj_transform prj_trans(proj0, proj1);
+
+    // same padding as feature_style_processor::prepare_layer
+    double buffer_padding = 2.0 * m.scale();
+    boost::optional<int> const& layer_buffer_size = lay.buffer_size();
+    buffer_padding *= layer_buffer_size ? *layer_buffer_size : m.buffer_size();
+
+    std::vector<box2d<double>> query_extents;
+    query_extents.reserve(extents.size());
+    box2d<double> query_ext;
+    for (box2d<double> const& view_ext : extents)
+    {
+        box2d<double> ext(view_ext);
+        ext.width(view_ext.width() + buffer_padding);
+        ext.height(view_ext.height() + buffer_padding);
+        if (m.maximum_extent()) ext.clip(*m.maximum_extent());
+        if (!prj_trans.forward(ext, PROJ_ENVELOPE_POINTS))
+        {
+            // let the renderer query this layer per view
+            return false;
+        }
+        if (query_ext.valid()) query_ext.expand_to_include(ext);
+        else query_ext = ext;
+        query_extents.push_back(ext);
+    }
+
+    std::set<std::string> names;
+    attribute_collector collector(names);
+    for (std::string const& style_name : lay.styles())
+    {
+        boost::optional<feature_type_style const&> style = m.find_style(style_name);
+        if (!style) continue;
+        for (rule const& r : style->get_rules())
+        {
+            if (r.active(scale_denom)) collector(r);
+        }
+    }
+
+    box2d<double> const& map_ext = m.get_current_extent();
+    query::resolution_type res(m.width() / map_ext.width(),
+                               m.height() / map_ext.height());
+    query q(query_ext, res, scale_denom, map_ext);
+    for (std::string const& name : names)
+    {
+        q.add_property_name(name);
+    }
+    if (!lay.group_by().empty())
+    {
+        q.add_property_name(lay.group_by());
+    }
+    q.set_filter_factor(collector.get_filter_factor());
+
+    box2d<double> layer_envelope = ds->envelope();
+    parameters params;
+    params["type"] = "memory";
+    params["spatial_index"] = spatial_index;
+    buckets.clear();
+    buckets.reserve(extents.size());
+    for (std::size_t i = 0; i < extents.size(); ++i)
+    {
+        buckets.push_back(std::make_shared<memory_datasource>(params));
+        buckets.back()->set_envelope(layer_envelope);
+    }
+
+    featureset_ptr features = ds->features(q);
+    if (features)
+    {
+        while (feature_ptr feature = features->next())
+        {
+            box2d<double> bbox = feature->envelope();
+            for (std::size_t i = 0; i < query_extents.size(); ++i)
+            {
+                if (query_extents[i].intersects(bbox))
+                {
+                    buckets[i]->push(feature);
+                }
+            }
+        }
+    }
+    for (auto const& bucket : buckets)
+    {
+        // push() invalidates the extent
+        bucket->set_envelope(layer_envelope);
+    }
+    return true;
+}
+
+}
+
+void bucket_layers(Map const& m,
+                   std::vector<layer> & layers,
+                   std::vector<box2d<double>> const& extents,
+                   double scale_denom,
+                   std::vector<layer_buckets> & result,
+                   bool spatial_index)
+{
+    for (layer & lay : layers)
+    {
+        bucket_list buckets;
+        if (bucket_layer(m, lay, extents, scale_denom, spatial_index, buckets))
+        {
+            result.push_back(layer_buckets{&lay, std::move(buckets)});
+        }
+        bucket_layers(m, lay.layers(), extents, scale_denom, result, spatial_index);
+    }
+}
+
+} // namespace detail
+
+} // namespace mapnik
@@ -0,0 +1,100 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#include <mapnik/renderer_common/line_path_cache.hpp>
+
+namespace mapnik {
+
+line_path_cache::line_path_cache()
+    : retain_(false),
+      started_(),
+      current_(nullptr) {}
+
+void line_path_cache::retain(bool retain)
+{
+    if (retain != retain_) clear();
+    retain_ = retain;
+}
+
+void line_path_cache::start_feature(feature_ptr const& feature)
+{
+    started_ = feature;
+    if (retain_)
+    {
+        auto itr = features_.find(feature.get());
+        current_ = itr != features_.end() ? &itr->second : nullptr;
+    }
+    else
+    {
+        recent_.size = 0;
+        current_ = &recent_;
+    }
+}
+
+void line_path_cache::clear()
+{
+    started_.reset();
+    current_ = nullptr;
+    recent_.size = 0;
+    features_.clear();
+}
+
+line_path const* line_path_cache::find(feature_impl const& feature, line_path_key const& key,
+                                       box2d<double> const& clip_box, bool exact) const
+{
+    if (!current_ || started_.get() != &feature) return nullptr;
+    for (std::size_t i = 0; i < current_->size; ++i)
+    {
+        entry const& e = current_->entries[i];
+        if (!(e.key == key)) continue;
+        // the clip box is only used when clipping
+        if (!key.clip) return &e.path;
+        if (exact ? e.clip_box == clip_box : e.clip_box.contains(clip_box)) return &e.path;
+        return nullptr;
+    }
+    return nullptr;
+}
+
+line_path * line_path_cache::insert(feature_impl const& feature, line_path_key const& key,
+                                    box2d<double> const& clip_box)
+{
+    if (!started_ || started_.get() != &feature) return nullptr;
+    if (!current_)
+    {
+        current_ = &features_[&feature];
+        current_->feature = started_;
+    }
+    std::size_t i = 0;
+    while (i < current_->size && !(current_->entries[i].key == key)) ++i;
+    if (i == current_->size)
+    {
+        if (i == current_->entries.size()) current_->entries.emplace_back();
+        ++current_->size;
+    }
+    entry & e = current_->entries[i];
+    e.key = key;
+    e.clip_box = clip_box;
+    e.path.clear();
+    return &e.path;
+}
+
+} // namespace mapnik
@@ -26,12 +26,91 @@
 #include <mapnik/group/group_layout_manager.hpp>
 #include <mapnik/group/group_symbolizer_helper.hpp>
 #include <mapnik/group/group_symbolizer_properties.hpp>
+#include <mapnik/renderer_common/group_layout_cache.hpp>
 #include <mapnik/renderer_common/render_group_symbolizer.hpp>
 #include <mapnik/renderer_common/render_thunk_extractor.hpp>
 #include <mapnik/util/conversions.hpp>
+#include <mapnik/value/hash.hpp>
 
 namespace mapnik {
 
+bool group_layout_cache::key_type::operator==(key_type const& rhs) const
+{
+    if (rule != rhs.rule || prj_trans != rhs.prj_trans || id != rhs.id ||
+        values.size() != rhs.values.size())
+    {
+        return false;
+    }
+    for (std::size_t i = 0; i < values.size(); ++i)
+    {
+        // 1 and 1.0 lay out differently
+        if (values[i].which() != rhs.values[i].which() || !(values[i] == rhs.values[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t group_layout_cache::key_hash::operator()(key_type const& key) const
+{
+    std::size_t seed = std::hash<void const*>()(key.rule);
+    seed ^= std::hash<void const*>()(key.prj_trans) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= std::hash<value_integer>()(key.id) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    for (auto const& val : key.values)
+    {
+        seed ^= value_hash(val) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+    return seed;
+}
+
+group_layout_cache::group_layout_cache()
+    : layouts_(),
+      virtual_renderer_() {}
+
+group_layout_cache::~group_layout_cache() {}
+
+group_layout_cache::layout_ptr group_layout_cache::find(key_type const& key) const
+{
+    auto itr = layouts_.find(key);
+    if (itr == layouts_.end())
+    {
+        return layout_ptr();
+    }
+    return itr->second;
+}
+
+group_layout_cache::layout_ptr group_layout_cache::insert(key_type && key,
+                                                          box2d<double> const& bounds,
+                                                          render_thunk_list && thunks,
+                                                          feature_ptr const& feature)
+{
+    if (layouts_.size() >= max_entries)
+    {
+        layouts_.clear();
+    }
+    auto entry = std::make_shared<layout>();
+    entry->bounds = bounds;
+    entry->thunks = std::move(thunks);
+    entry->feature = feature;
+    layouts_[std::move(key)] = entry;
+    return entry;
+}
+
+std::size_t group_layout_cache::size() const
+{
+    return layouts_.size();
+}
+
+virtual_renderer_common & group_layout_cache::virtual_renderer(renderer_common const& common)
+{
+    if (!virtual_renderer_)
+    {
+        virtual_renderer_.reset(new virtual_renderer_common(common));
+    }
+    return *virtual_renderer_;
+}
+
 void render_group_symbolizer(group_symbolizer const& sym,
                              feature_impl & feature,
                              attributes const& vars,
@@ -60,13 +139,18 @@ void render_group_symbolizer(group_symbolizer const& sym,
     // along with the group rules that they matched
     std::vector< std::pair<group_rule_ptr, feature_ptr> > matches;
 
-    // create a copied 'virtual' common renderer for processing sub feature symbolizers
-    // create an empty detector for it, so we are sure we won't hit anything
-    virtual_renderer_common virtual_renderer(common);
+    // members already laid out in this render are reused from the cache,
+    // the others are laid out with its 'virtual' common renderer which has
+    // an empty detector of its own, so we are sure we won't hit anything
+    if (!common.group_layouts_)
+    {
+        common.group_layouts_ = std::make_shared<group_layout_cache>();
+    }
+    group_layout_cache & layout_cache = *common.group_layouts_;
 
-    // keep track of which lists of render thunks correspond to
+    // keep track of which layouts correspond to
     // entries in the group_layout_manager.
-    std::list<render_thunk_list> layout_thunks;
+    std::vector<group_layout_cache::layout_ptr> layouts;
 
     // layout manager to store and arrange bboxes of matched features
     group_layout_manager layout_manager(props->get_layout());
@@ -129,21 +213,37 @@ void render_group_symbolizer(group_symbolizer const& sym,
                 // add matched rule and feature to the list of things to draw
                 matches.emplace_back(rule, sub_feature);
 
-                // construct a bounding box around all symbolizers for the matched rule
-                box2d<double> bounds;
-                render_thunk_list thunks;
-                render_thunk_extractor extractor(bounds, thunks, *sub_feature, common.vars_, prj_trans,
-                                                 virtual_renderer, clipping_extent);
-
-                for (auto const& _sym : *rule)
+                // the member looks the same wherever the rule matches the same
+                // column and values
+                group_layout_cache::key_type key;
+                key.rule = rule.get();
+                key.prj_trans = &prj_trans;
+                key.id = sub_feature->id();
+                key.values.reserve(sub_feature->size());
+                for (std::size_t i = 0; i < sub_feature->size(); ++i)
                 {
-                    // TODO: construct layout and obtain bounding box
-                    util::apply_visitor(extractor, _sym);
+                    key.values.push_back(sub_feature->get(i));
+                }
+                group_layout_cache::layout_ptr layout = layout_cache.find(key);
+                if (!layout)
+                {
+                    // construct a bounding box around all symbolizers for the matched rule
+                    box2d<double> bounds;
+                    render_thunk_list thunks;
+                    render_thunk_extractor extractor(bounds, thunks, *sub_feature, common.vars_, prj_trans,
+                                                     layout_cache.virtual_renderer(common), clipping_extent);
+
+                    for (auto const& _sym : *rule)
+                    {
+                        // TODO: construct layout and obtain bounding box
+                        util::apply_visitor(extractor, _sym);
+                    }
+                    layout = layout_cache.insert(std::move(key), bounds, std::move(thunks), sub_feature);
                 }
 
                 // add the bounding box to the layout manager
-                layout_manager.add_member_bound_box(bounds);
-                layout_thunks.emplace_back(std::move(thunks));
+                layout_manager.add_member_bound_box(layout->bounds);
+                layouts.push_back(std::move(layout));
                 break;
             }
         }
@@ -183,11 +283,11 @@ void render_group_symbolizer(group_symbolizer const& sym,
     for (pixel_position const& pos : positions)
     {
         size_t layout_i = 0;
-        for (auto const& thunks : layout_thunks)
+        for (auto const& layout : layouts)
         {
             pixel_position const& offset = layout_manager.offset_at(layout_i);
             pixel_position render_offset = pos + offset;
-            render_thunks.render_list(thunks, render_offset);
+            render_thunks.render_list(layout->thunks, render_offset);
             ++layout_i;
         }
     }
@@ -91,7 +91,7 @@ struct render_marker_symbolizer_visitor
 
         if (clip)
         {
-            geometry::geometry_types type = geometry::geometry_type(feature_.get_geometry());
+            geometry::geometry_types type = feature_.geometry_type();
             switch (type)
             {
                 case geometry::geometry_types::Polygon:
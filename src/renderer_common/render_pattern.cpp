@@ -69,8 +69,62 @@ void render_pattern<image_rgba8>(rasterizer & ras,
                                   renderer_solid,
                                   pixfmt > svg_renderer(svg_path,
                                                         marker.get_data()->attributes());
+    svg_renderer.set_flattened_paths(marker.get_data()->get_flattened_paths());
 
     svg_renderer.render(ras, sl, renb, mtx, opacity, bbox);
 }
 
+constexpr std::size_t pattern_image_cache::max_bytes;
+
+pattern_image_cache & pattern_image_cache::instance()
+{
+#ifdef MAPNIK_THREADSAFE
+    static thread_local pattern_image_cache cache;
+#else
+    static pattern_image_cache cache;
+#endif
+    return cache;
+}
+
+std::size_t pattern_image_cache::size() const
+{
+    return cache_.size();
+}
+
+void pattern_image_cache::clear()
+{
+    cache_.clear();
+    bytes_ = 0;
+}
+
+pattern_image_cache::key_type pattern_image_cache::make_key(marker_ptr const& owner,
+                                                            agg::trans_affine const& tr,
+                                                            double opacity)
+{
+    return key_type(owner.get(), {{ tr.sx, tr.shy, tr.shx, tr.sy, tr.tx, tr.ty, opacity }});
+}
+
+pattern_image_cache::image_ptr pattern_image_cache::find(key_type const& key) const
+{
+    auto itr = cache_.find(key);
+    if (itr == cache_.end()) return image_ptr();
+    return itr->second.image;
+}
+
+pattern_image_cache::image_ptr pattern_image_cache::insert(key_type const& key,
+                                                           marker_ptr const& owner,
+                                                           image_rgba8 && image)
+{
+    std::size_t bytes = image.size();
+    if (bytes_ + bytes > max_bytes) clear();
+    image_ptr result = std::make_shared<image_rgba8 const>(std::move(image));
+    // a single image over the budget is drawn without being kept
+    if (bytes <= max_bytes)
+    {
+        cache_.emplace(key, entry{owner, result});
+        bytes_ += bytes;
+    }
+    return result;
+}
+
 } // namespace mapnik
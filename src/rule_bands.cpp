@@ -0,0 +1,146 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#include <mapnik/rule_bands.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/attribute_collector.hpp>
+#include <mapnik/expression_node.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace mapnik
+{
+
+namespace {
+
+// the 'or' of the if rule filters; features matching none of them are
+// only drawn by else rules
+expression_ptr union_filter(rule_cache const& rules)
+{
+    if (!rules.get_else_rules().empty() || rules.get_if_rules().empty()) return expression_ptr();
+    expression_ptr result;
+    for (rule const* r : rules.get_if_rules())
+    {
+        expression_ptr const& filter = r->get_filter();
+        if (!filter || (filter->is<value_bool>() && filter->get<value_bool>())) return expression_ptr();
+        if (!result)
+        {
+            result = filter;
+        }
+        else
+        {
+            result = std::make_shared<expr_node>(binary_node<tags::logical_or>(*result, *filter));
+        }
+    }
+    return result;
+}
+
+rule_bands::band_ptr make_band(feature_type_style const& style, double scale_denom, attributes const& vars)
+{
+    auto band = std::make_shared<rule_band>();
+    // NaN until a raster symbolizer sets the filter factor
+    attribute_collector collector(band->names, std::numeric_limits<double>::quiet_NaN());
+    for (rule const& r : style.get_rules())
+    {
+        if (r.active(scale_denom))
+        {
+            band->rules.add_rule(r, vars);
+            band->active = true;
+            collector(r);
+        }
+    }
+    if (band->active)
+    {
+        if (style.label_priority())
+        {
+            util::apply_visitor(expression_attributes<std::set<std::string>>(band->names), *style.label_priority());
+        }
+        band->rules.build_index();
+        band->filter = union_filter(band->rules);
+        if (!std::isnan(collector.get_filter_factor()))
+        {
+            band->filter_factor = collector.get_filter_factor();
+        }
+    }
+    band->vars = vars;
+    return band;
+}
+
+}
+
+rule_bands::rule_bands()
+    : mutex_(),
+      ready_(false),
+      first_rule_(nullptr),
+      num_rules_(0),
+      limits_(),
+      bands_() {}
+
+rule_bands::band_ptr rule_bands::get(feature_type_style const& style, double scale_denom, attributes const& vars)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    rules const& style_rules = style.get_rules();
+    if (ready_ && (style_rules.data() != first_rule_ || style_rules.size() != num_rules_))
+    {
+        // rules were added through a reference kept from
+        // get_rules_nonconst(), the bands point into the old ones
+        limits_.clear();
+        bands_.clear();
+        ready_ = false;
+    }
+    if (!ready_)
+    {
+        // the limits rule::active() tests the scale denominator against
+        for (rule const& r : style_rules)
+        {
+            limits_.push_back(r.get_min_scale() - 1e-6);
+            limits_.push_back(r.get_max_scale() + 1e-6);
+        }
+        std::sort(limits_.begin(), limits_.end());
+        limits_.erase(std::unique(limits_.begin(), limits_.end()), limits_.end());
+        bands_.assign(limits_.size() + 1, band_ptr());
+        first_rule_ = style_rules.data();
+        num_rules_ = style_rules.size();
+        ready_ = true;
+    }
+    std::size_t index = static_cast<std::size_t>(std::upper_bound(limits_.begin(), limits_.end(), scale_denom) - limits_.begin());
+    band_ptr & band = bands_[index];
+    if (!band || band->vars != vars)
+    {
+        band = make_band(style, scale_denom, vars);
+    }
+    return band;
+}
+
+void rule_bands::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ready_ = false;
+    limits_.clear();
+    bands_.clear();
+}
+
+}
@@ -0,0 +1,605 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/rule_cache.hpp>
+#include <mapnik/expression_node.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/value.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/evaluate_global_attributes.hpp>
+#include <mapnik/make_unique.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <numeric>
+
+namespace mapnik
+{
+
+namespace {
+
+// literal a keyed rule is dispatched on
+struct index_key
+{
+    bool is_string;
+    value_unicode_string str;
+    value_integer integer;
+};
+
+// Collects the literals of a filter of the form [name] = literal, or of
+// an 'or' chain of such tests against the same attribute. Equality of a
+// string literal only holds for a string value, integer literals (and
+// booleans, and integral doubles, as in value comparison) only hold for
+// arithmetic values of the same numeric value.
+struct equality_collector
+{
+    using result_type = bool;
+
+    equality_collector(std::string & name, std::vector<index_key> & keys)
+        : name_(name), keys_(keys) {}
+
+    bool operator() (binary_node<tags::equal_to> const& x) const
+    {
+        if (x.left.is<attribute>())
+        {
+            return add(x.left.get<attribute>(), x.right);
+        }
+        else if (x.right.is<attribute>())
+        {
+            return add(x.right.get<attribute>(), x.left);
+        }
+        return false;
+    }
+
+    bool operator() (binary_node<tags::logical_or> const& x) const
+    {
+        return util::apply_visitor(*this, x.left) && util::apply_visitor(*this, x.right);
+    }
+
+    template <typename T>
+    bool operator() (T const&) const
+    {
+        return false;
+    }
+
+private:
+    bool add(attribute const& attr, expr_node const& literal) const
+    {
+        if (!name_.empty() && name_ != attr.name()) return false;
+        index_key key{false, value_unicode_string(), 0};
+        if (literal.is<value_unicode_string>())
+        {
+            key.is_string = true;
+            key.str = literal.get<value_unicode_string>();
+        }
+        else if (literal.is<value_integer>())
+        {
+            key.integer = literal.get<value_integer>();
+        }
+        else if (literal.is<value_bool>())
+        {
+            key.integer = literal.get<value_bool>() ? 1 : 0;
+        }
+        else if (literal.is<value_double>())
+        {
+            value_double val = literal.get<value_double>();
+            if (!integral(val)) return false;
+            key.integer = static_cast<value_integer>(val);
+        }
+        else
+        {
+            return false;
+        }
+        name_ = attr.name();
+        keys_.push_back(std::move(key));
+        return true;
+    }
+
+    std::string & name_;
+    std::vector<index_key> & keys_;
+
+public:
+    static bool integral(value_double val)
+    {
+        return std::floor(val) == val &&
+            std::fabs(val) < static_cast<value_double>(std::numeric_limits<value_integer>::max());
+    }
+};
+
+struct keyed_filter
+{
+    std::string name;
+    std::vector<index_key> keys;
+};
+
+void add_unique(rule_cache::rule_indices & indices, std::size_t index)
+{
+    // rules are added in order, 'or' chains may repeat a literal
+    if (indices.empty() || indices.back() != index) indices.push_back(index);
+}
+
+// Numbers an attribute can take for a filter to match: an interval, or a
+// point for an equality test.
+struct numeric_range
+{
+    double lo = -std::numeric_limits<double>::infinity();
+    double hi = std::numeric_limits<double>::infinity();
+    bool lo_open = true;
+    bool hi_open = true;
+
+    bool empty() const
+    {
+        return lo > hi || (lo == hi && (lo_open || hi_open));
+    }
+
+    bool disjoint(numeric_range const& other) const
+    {
+        if (empty() || other.empty()) return true;
+        return hi < other.lo || other.hi < lo ||
+            (hi == other.lo && (hi_open || other.lo_open)) ||
+            (other.hi == lo && (other.hi_open || lo_open));
+    }
+};
+
+// Largest magnitude integer literals may have to be analysed: beyond it
+// integer values compared as doubles round and ranges that look disjoint
+// could both hold.
+constexpr value_double max_exact_integer = 9007199254740992.0; // 2^53
+
+// Narrows a range to a filter of the form [name] op number, or a
+// conjunction of such tests against the same attribute. Values that are
+// not numbers compare false with numbers, so they match no such filter.
+struct range_collector
+{
+    using result_type = bool;
+
+    range_collector(std::string & name, numeric_range & range)
+        : name_(name), range_(range) {}
+
+    bool operator() (binary_node<tags::logical_and> const& x) const
+    {
+        return util::apply_visitor(*this, x.left) && util::apply_visitor(*this, x.right);
+    }
+
+    bool operator() (binary_node<tags::less> const& x) const
+    {
+        return compare(x.left, x.right, true, false);
+    }
+
+    bool operator() (binary_node<tags::less_equal> const& x) const
+    {
+        return compare(x.left, x.right, false, false);
+    }
+
+    bool operator() (binary_node<tags::greater> const& x) const
+    {
+        return compare(x.right, x.left, true, false);
+    }
+
+    bool operator() (binary_node<tags::greater_equal> const& x) const
+    {
+        return compare(x.right, x.left, false, false);
+    }
+
+    bool operator() (binary_node<tags::equal_to> const& x) const
+    {
+        return compare(x.left, x.right, false, true);
+    }
+
+    template <typename T>
+    bool operator() (T const&) const
+    {
+        return false;
+    }
+
+private:
+    // lhs < rhs, or lhs <= rhs unless strict, or lhs = rhs if equal
+    bool compare(expr_node const& lhs, expr_node const& rhs, bool strict, bool equal) const
+    {
+        double num;
+        if (lhs.is<attribute>() && number(rhs, num))
+        {
+            if (!set_name(lhs.get<attribute>())) return false;
+            upper(num, strict);
+            if (equal) lower(num, false);
+            return true;
+        }
+        if (rhs.is<attribute>() && number(lhs, num))
+        {
+            if (!set_name(rhs.get<attribute>())) return false;
+            lower(num, strict);
+            if (equal) upper(num, false);
+            return true;
+        }
+        return false;
+    }
+
+    static bool number(expr_node const& literal, double & num)
+    {
+        if (literal.is<value_integer>())
+        {
+            value_integer val = literal.get<value_integer>();
+            num = static_cast<double>(val);
+            return std::fabs(num) <= max_exact_integer;
+        }
+        if (literal.is<value_double>())
+        {
+            num = literal.get<value_double>();
+            return !std::isnan(num);
+        }
+        return false;
+    }
+
+    bool set_name(attribute const& attr) const
+    {
+        if (!name_.empty() && name_ != attr.name()) return false;
+        name_ = attr.name();
+        return true;
+    }
+
+    void upper(double num, bool open) const
+    {
+        if (num < range_.hi || (num == range_.hi && open))
+        {
+            range_.hi = num;
+            range_.hi_open = open;
+        }
+    }
+
+    void lower(double num, bool open) const
+    {
+        if (num > range_.lo || (num == range_.lo && open))
+        {
+            range_.lo = num;
+            range_.lo_open = open;
+        }
+    }
+
+    std::string & name_;
+    numeric_range & range_;
+};
+
+// what an if rule filter lets through, for telling exclusive rules apart
+struct filter_domain
+{
+    std::string name;
+    std::vector<value_unicode_string> strings;
+    std::vector<numeric_range> ranges;
+
+    bool disjoint(filter_domain const& other) const
+    {
+        for (auto const& str : strings)
+        {
+            if (std::find(other.strings.begin(), other.strings.end(), str) != other.strings.end()) return false;
+        }
+        for (auto const& range : ranges)
+        {
+            for (auto const& other_range : other.ranges)
+            {
+                if (!range.disjoint(other_range)) return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Finds out what the filter lets through from its equality keys, or
+// else from the numeric range it tests. False if neither describes it.
+bool make_domain(expr_node const& filter, keyed_filter const& kf, filter_domain & domain)
+{
+    if (!kf.name.empty())
+    {
+        domain.name = kf.name;
+        for (index_key const& key : kf.keys)
+        {
+            if (key.is_string)
+            {
+                domain.strings.push_back(key.str);
+                continue;
+            }
+            numeric_range point;
+            point.lo = point.hi = static_cast<double>(key.integer);
+            point.lo_open = point.hi_open = false;
+            if (std::fabs(point.lo) > max_exact_integer) return false;
+            domain.ranges.push_back(point);
+        }
+        return true;
+    }
+    numeric_range range;
+    if (!util::apply_visitor(range_collector(domain.name, range), filter)) return false;
+    domain.ranges.push_back(range);
+    return true;
+}
+
+// true if an expression reads feature attributes or the geometry type
+struct feature_dependency
+{
+    using result_type = bool;
+
+    bool operator() (attribute const&) const { return true; }
+    bool operator() (geometry_type_attribute const&) const { return true; }
+
+    template <typename Tag>
+    bool operator() (unary_node<Tag> const& x) const
+    {
+        return util::apply_visitor(*this, x.expr);
+    }
+
+    template <typename Tag>
+    bool operator() (binary_node<Tag> const& x) const
+    {
+        return util::apply_visitor(*this, x.left) || util::apply_visitor(*this, x.right);
+    }
+
+    bool operator() (regex_match_node const& x) const
+    {
+        return util::apply_visitor(*this, x.expr);
+    }
+
+    bool operator() (regex_replace_node const& x) const
+    {
+        return util::apply_visitor(*this, x.expr);
+    }
+
+    bool operator() (unary_function_call const& call) const
+    {
+        return util::apply_visitor(*this, call.arg);
+    }
+
+    bool operator() (binary_function_call const& call) const
+    {
+        return util::apply_visitor(*this, call.arg1) || util::apply_visitor(*this, call.arg2);
+    }
+
+    // literals and global attributes
+    template <typename T>
+    bool operator() (T const&) const { return false; }
+};
+
+struct symbolizer_base_ref
+{
+    template <typename Symbolizer>
+    symbolizer_base const& operator() (Symbolizer const& sym) const { return sym; }
+
+    template <typename Symbolizer>
+    symbolizer_base & operator() (Symbolizer & sym) const { return sym; }
+};
+
+// Evaluates a feature independent expression into the value the property
+// would be read as, false if it is left to be evaluated per feature.
+bool evaluate_property(symbolizer_base::value_type & val, expression_ptr const& expr,
+                       property_types target, attributes const& vars)
+{
+    if (util::apply_visitor(feature_dependency(), *expr)) return false;
+    switch (target)
+    {
+    case property_types::target_bool:
+    case property_types::target_double:
+    case property_types::target_integer:
+    case property_types::target_color:
+    case property_types::target_string:
+        break;
+    default:
+        return false;
+    }
+    try
+    {
+        value result = util::apply_visitor(evaluate_expression<value, attributes>(vars), *expr);
+        switch (target)
+        {
+        case property_types::target_bool:
+            val = result.to_bool();
+            break;
+        case property_types::target_double:
+            val = result.to_double();
+            break;
+        case property_types::target_integer:
+            val = result.to_int();
+            break;
+        case property_types::target_color:
+            // as evaluate_expression_wrapper<color>
+            val = result.is_null() ? color(0, 0, 0, 0) : color(result.to_string());
+            break;
+        default:
+            val = result.to_string();
+            break;
+        }
+    }
+    catch (std::exception const&)
+    {
+        // report it per feature as before
+        return false;
+    }
+    return true;
+}
+
+}
+
+void rule_cache::add_rule(rule const& r, attributes const& vars)
+{
+    std::unique_ptr<rule> evaluated;
+    for (std::size_t i = 0; i < r.get_symbolizers().size(); ++i)
+    {
+        symbolizer_base const& sym = util::apply_visitor(symbolizer_base_ref(), r.get_symbolizers()[i]);
+        for (auto const& prop : sym.properties)
+        {
+            if (!prop.second.is<expression_ptr>()) continue;
+            symbolizer_base::value_type val;
+            if (evaluate_property(val, prop.second.get<expression_ptr>(),
+                                  std::get<2>(get_meta(prop.first)), vars))
+            {
+                if (!evaluated) evaluated = std::make_unique<rule>(r);
+                symbolizer_base & copy = util::apply_visitor(symbolizer_base_ref(), *(evaluated->begin() + i));
+                copy.properties[prop.first] = std::move(val);
+            }
+        }
+    }
+    if (evaluated)
+    {
+        add_rule(*evaluated);
+        origins_.emplace(evaluated.get(), &r);
+        evaluated_rules_.push_back(std::move(evaluated));
+    }
+    else
+    {
+        add_rule(r);
+    }
+}
+
+void rule_cache::build_index()
+{
+    index_key_.reset();
+    string_rules_.clear();
+    integer_rules_.clear();
+    unkeyed_rules_.clear();
+
+    std::vector<keyed_filter> keyed(if_rules_.size());
+    std::map<std::string, std::size_t> counts;
+    for (std::size_t i = 0; i < if_rules_.size(); ++i)
+    {
+        expression_ptr const& filter = if_rules_[i]->get_filter();
+        if (!filter) continue;
+        keyed_filter & kf = keyed[i];
+        equality_collector collector(kf.name, kf.keys);
+        if (util::apply_visitor(collector, *filter))
+        {
+            ++counts[kf.name];
+        }
+        else
+        {
+            kf.name.clear();
+            kf.keys.clear();
+        }
+    }
+
+    matches_.reset(new std::atomic<std::size_t>[if_rules_.size()]);
+    for (std::size_t i = 0; i < if_rules_.size(); ++i) matches_[i] = 0;
+    exclusive_ = if_rules_.size() > 1;
+    std::vector<filter_domain> domains(if_rules_.size());
+    for (std::size_t i = 0; exclusive_ && i < if_rules_.size(); ++i)
+    {
+        expression_ptr const& filter = if_rules_[i]->get_filter();
+        exclusive_ = filter && make_domain(*filter, keyed[i], domains[i]) &&
+            domains[i].name == domains[0].name;
+        for (std::size_t j = 0; exclusive_ && j < i; ++j)
+        {
+            exclusive_ = domains[i].disjoint(domains[j]);
+        }
+    }
+
+    auto best = std::max_element(counts.begin(), counts.end(),
+                                 [](auto const& lhs, auto const& rhs) { return lhs.second < rhs.second; });
+    if (best == counts.end() || best->second < min_indexed_rules) return;
+
+    index_key_ = std::make_unique<attribute>(best->first);
+    for (std::size_t i = 0; i < if_rules_.size(); ++i)
+    {
+        keyed_filter const& kf = keyed[i];
+        if (kf.name != best->first)
+        {
+            unkeyed_rules_.push_back(i);
+            continue;
+        }
+        for (index_key const& key : kf.keys)
+        {
+            if (key.is_string) add_unique(string_rules_[key.str], i);
+            else add_unique(integer_rules_[key.integer], i);
+        }
+    }
+}
+
+void rule_cache::record_matches(std::vector<std::size_t> const& counts) const
+{
+    if (!matches_) return;
+    std::size_t size = std::min(counts.size(), if_rules_.size());
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if (counts[i] > 0) matches_[i].fetch_add(counts[i], std::memory_order_relaxed);
+    }
+}
+
+void rule_cache::evaluation_order(rule_indices & order) const
+{
+    order.resize(if_rules_.size());
+    std::iota(order.begin(), order.end(), std::size_t(0));
+    if (!exclusive_ || !matches_) return;
+    std::vector<std::size_t> seen(if_rules_.size());
+    for (std::size_t i = 0; i < seen.size(); ++i)
+    {
+        seen[i] = matches_[i].load(std::memory_order_relaxed);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&seen](std::size_t lhs, std::size_t rhs) { return seen[lhs] > seen[rhs]; });
+}
+
+std::string rule_cache::index_attribute() const
+{
+    return index_key_ ? index_key_->name() : std::string();
+}
+
+bool rule_cache::select_if_rules(feature_impl const& feature, rule_indices & candidates) const
+{
+    if (!index_key_) return false;
+    value const& val = index_key_->value<value, feature_impl>(feature);
+    rule_indices const* keyed = nullptr;
+    if (val.is<value_unicode_string>())
+    {
+        auto itr = string_rules_.find(val.get<value_unicode_string>());
+        if (itr != string_rules_.end()) keyed = &itr->second;
+    }
+    else if (val.is<value_integer>() || val.is<value_bool>())
+    {
+        auto itr = integer_rules_.find(val.to_int());
+        if (itr != integer_rules_.end()) keyed = &itr->second;
+    }
+    else if (val.is<value_double>())
+    {
+        value_double d = val.get<value_double>();
+        if (equality_collector::integral(d))
+        {
+            auto itr = integer_rules_.find(static_cast<value_integer>(d));
+            if (itr != integer_rules_.end()) keyed = &itr->second;
+        }
+    }
+    candidates.clear();
+    if (keyed)
+    {
+        candidates.reserve(keyed->size() + unkeyed_rules_.size());
+        std::merge(keyed->begin(), keyed->end(),
+                   unkeyed_rules_.begin(), unkeyed_rules_.end(),
+                   std::back_inserter(candidates));
+    }
+    else
+    {
+        candidates.insert(candidates.end(), unkeyed_rules_.begin(), unkeyed_rules_.end());
+    }
+    return true;
+}
+
+constexpr std::size_t rule_cache::min_indexed_rules;
+
+}
@@ -418,6 +418,17 @@ void serialize_style( ptree & map_node, std::string const& name, feature_type_st
         set_attr(style_node, "image-filters-inflate", image_filters_inflate);
     }
 
+    if (style.label_priority())
+    {
+        set_attr(style_node, "label-priority", mapnik::to_expression_string(*style.label_priority()));
+    }
+
+    double label_coverage = style.label_coverage();
+    if (label_coverage != dfl.label_coverage() || explicit_defaults)
+    {
+        set_attr(style_node, "label-coverage", label_coverage);
+    }
+
     boost::optional<composite_mode_e> comp_op = style.comp_op();
     if (comp_op)
     {
@@ -560,6 +571,46 @@ void serialize_layer( ptree & map_node, layer const& lyr, bool explicit_defaults
         set_attr/*<bool>*/( layer_node, "cache-features", lyr.cache_features() );
     }
 
+    if ( lyr.cache_image() || explicit_defaults )
+    {
+        set_attr/*<bool>*/( layer_node, "cache-image", lyr.cache_image() );
+    }
+
+    if ( lyr.geometry_pyramid() || explicit_defaults )
+    {
+        set_attr/*<bool>*/( layer_node, "geometry-pyramid", lyr.geometry_pyramid() );
+    }
+
+    if ( lyr.maximum_features() > 0 || explicit_defaults )
+    {
+        set_attr( layer_node, "maximum-features", lyr.maximum_features() );
+    }
+
+    if ( lyr.maximum_vertices() > 0 || explicit_defaults )
+    {
+        set_attr( layer_node, "maximum-vertices", lyr.maximum_vertices() );
+    }
+
+    if ( lyr.maximum_render_time() > 0.0 || explicit_defaults )
+    {
+        set_attr( layer_node, "maximum-render-time", lyr.maximum_render_time() );
+    }
+
+    if ( lyr.budget_policy() != BUDGET_STOP || explicit_defaults )
+    {
+        set_attr( layer_node, "budget-policy", lyr.budget_policy().as_string() );
+    }
+
+    if ( lyr.aggregate() != AGGREGATE_NONE || explicit_defaults )
+    {
+        set_attr( layer_node, "aggregate", lyr.aggregate().as_string() );
+    }
+
+    if ( lyr.aggregate_weight() != "" || explicit_defaults )
+    {
+        set_attr( layer_node, "aggregate-weight", lyr.aggregate_weight() );
+    }
+
     if ( lyr.group_by() != "" || explicit_defaults )
     {
         set_attr( layer_node, "group-by", lyr.group_by() );
@@ -0,0 +1,116 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/solid_tile_cache.hpp>
+
+namespace mapnik
+{
+
+template class singleton<solid_tile_cache, CreateStatic>;
+
+constexpr std::size_t solid_tile_cache::default_max_bytes;
+
+solid_tile_cache::solid_tile_cache()
+    : entries_(),
+      lru_(),
+      max_bytes_(default_max_bytes),
+      num_bytes_(0) {}
+
+void solid_tile_cache::set_max_bytes(std::size_t max_bytes)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    max_bytes_ = max_bytes;
+    evict();
+}
+
+std::size_t solid_tile_cache::max_bytes() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return max_bytes_;
+}
+
+solid_tile_cache::buffer_ptr solid_tile_cache::find(key_type const& key)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    auto itr = entries_.find(key);
+    if (itr == entries_.end()) return buffer_ptr();
+    lru_.splice(lru_.begin(), lru_, itr->second.lru);
+    return itr->second.buffer;
+}
+
+void solid_tile_cache::insert(key_type const& key, std::string const& buffer)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    if (buffer.size() > max_bytes_) return;
+    auto itr = entries_.find(key);
+    if (itr != entries_.end())
+    {
+        num_bytes_ -= itr->second.buffer->size();
+        lru_.erase(itr->second.lru);
+        entries_.erase(itr);
+    }
+    lru_.push_front(key);
+    entries_.emplace(key, entry{std::make_shared<std::string const>(buffer), lru_.begin()});
+    num_bytes_ += buffer.size();
+    evict();
+}
+
+void solid_tile_cache::evict()
+{
+    while (num_bytes_ > max_bytes_ && !lru_.empty())
+    {
+        auto itr = entries_.find(lru_.back());
+        num_bytes_ -= itr->second.buffer->size();
+        entries_.erase(itr);
+        lru_.pop_back();
+    }
+}
+
+std::size_t solid_tile_cache::size() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return entries_.size();
+}
+
+void solid_tile_cache::clear()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    entries_.clear();
+    lru_.clear();
+    num_bytes_ = 0;
+}
+
+}
@@ -0,0 +1,209 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/sql_filter.hpp>
+#include <mapnik/sql_utils.hpp>
+#include <mapnik/expression_node.hpp>
+#include <mapnik/value.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/optional.hpp>
+#pragma GCC diagnostic pop
+
+// stl
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+namespace mapnik { namespace sql_utils {
+
+namespace {
+
+using condition = boost::optional<std::string>;
+
+// a literal, or a global attribute standing for one
+struct literal_value
+{
+    explicit literal_value(attributes const& vars)
+        : vars_(vars) {}
+
+    boost::optional<value> operator() (value_bool val) const { return value(val); }
+    boost::optional<value> operator() (value_integer val) const { return value(val); }
+    boost::optional<value> operator() (value_double val) const { return value(val); }
+    boost::optional<value> operator() (value_unicode_string const& val) const { return value(val); }
+
+    boost::optional<value> operator() (global_attribute const& attr) const
+    {
+        auto itr = vars_.find(attr.name);
+        if (itr == vars_.end()) return boost::none;
+        return itr->second;
+    }
+
+    template <typename T>
+    boost::optional<value> operator() (T const&) const
+    {
+        return boost::none;
+    }
+
+    attributes const& vars_;
+};
+
+// writes val as an SQL literal comparable with a column of type, if the
+// comparison is the one mapnik makes
+bool write_literal(std::ostream & os, value const& val, unsigned type, bool ordering)
+{
+    if (type == String)
+    {
+        // SQL collations may order strings differently
+        if (ordering || !val.is<value_unicode_string>()) return false;
+        std::string utf8;
+        val.get<value_unicode_string>().toUTF8String(utf8);
+        os << literal(utf8);
+        return true;
+    }
+    if (type == Integer || type == Float || type == Double)
+    {
+        if (val.is<value_integer>())
+        {
+            os << val.get<value_integer>();
+            return true;
+        }
+        if (val.is<value_double>() && std::isfinite(val.get<value_double>()))
+        {
+            os.precision(std::numeric_limits<value_double>::max_digits10);
+            os << val.get<value_double>();
+            return true;
+        }
+    }
+    return false;
+}
+
+struct sql_condition
+{
+    sql_condition(layer_descriptor const& desc, attributes const& vars)
+        : desc_(desc),
+          vars_(vars) {}
+
+    condition operator() (binary_node<tags::logical_and> const& node) const
+    {
+        condition left = util::apply_visitor(*this, node.left);
+        condition right = util::apply_visitor(*this, node.right);
+        if (left && right) return "(" + *left + " AND " + *right + ")";
+        return left ? left : right;
+    }
+
+    condition operator() (binary_node<tags::logical_or> const& node) const
+    {
+        condition left = util::apply_visitor(*this, node.left);
+        if (!left) return boost::none;
+        condition right = util::apply_visitor(*this, node.right);
+        if (!right) return boost::none;
+        return "(" + *left + " OR " + *right + ")";
+    }
+
+    condition operator() (binary_node<tags::equal_to> const& node) const
+    {
+        return compare(node.left, node.right, "=", "=", false);
+    }
+
+    condition operator() (binary_node<tags::not_equal_to> const& node) const
+    {
+        return compare(node.left, node.right, "<>", "<>", false);
+    }
+
+    condition operator() (binary_node<tags::less> const& node) const
+    {
+        return compare(node.left, node.right, "<", ">", true);
+    }
+
+    condition operator() (binary_node<tags::less_equal> const& node) const
+    {
+        return compare(node.left, node.right, "<=", ">=", true);
+    }
+
+    condition operator() (binary_node<tags::greater> const& node) const
+    {
+        return compare(node.left, node.right, ">", "<", true);
+    }
+
+    condition operator() (binary_node<tags::greater_equal> const& node) const
+    {
+        return compare(node.left, node.right, ">=", "<=", true);
+    }
+
+    template <typename T>
+    condition operator() (T const&) const
+    {
+        return boost::none;
+    }
+
+    // [column] op literal, or literal op [column] with the operator
+    // mirrored
+    condition compare(expr_node const& left, expr_node const& right,
+                      char const* op, char const* mirrored, bool ordering) const
+    {
+        if (left.is<attribute>())
+        {
+            return compare(left.get<attribute>().name(), right, op, ordering);
+        }
+        if (right.is<attribute>())
+        {
+            return compare(right.get<attribute>().name(), left, mirrored, ordering);
+        }
+        return boost::none;
+    }
+
+    condition compare(std::string const& column, expr_node const& node,
+                      std::string const& op, bool ordering) const
+    {
+        boost::optional<value> val = util::apply_visitor(literal_value(vars_), node);
+        if (!val) return boost::none;
+        for (attribute_descriptor const& attr : desc_.get_descriptors())
+        {
+            if (attr.get_name() != column) continue;
+            std::ostringstream s;
+            // mapnik tells null apart from any literal
+            bool with_null = op == "<>";
+            if (with_null) s << '(';
+            s << identifier(column) << ' ' << op << ' ';
+            if (!write_literal(s, *val, attr.get_type(), ordering)) return boost::none;
+            if (with_null) s << " OR " << identifier(column) << " IS NULL)";
+            return s.str();
+        }
+        return boost::none;
+    }
+
+    layer_descriptor const& desc_;
+    attributes const& vars_;
+};
+
+} // anonymous namespace
+
+std::string filter_to_sql(expr_node const& filter, layer_descriptor const& desc, attributes const& vars)
+{
+    condition result = util::apply_visitor(sql_condition(desc, vars), filter);
+    return result ? *result : std::string();
+}
+
+}}
@@ -130,7 +130,7 @@ bool svg_renderer<OutputIterator>::process(rule::symbolizers const& syms,
     if (process_path)
     {
         // generate path output for each geometry of the current feature.
-        auto const& geom = feature.get_geometry();
+        auto const& geom = static_cast<feature_impl const&>(feature).get_geometry();
         path_type path;
         path.set_type(static_cast<path_type::types>(mapnik::util::to_ds_type(geom)));
         geometry::to_path(geom, path);
@@ -29,6 +29,7 @@
 #include <mapnik/layer.hpp>
 #include <mapnik/feature_type_style.hpp>
 #include <mapnik/font_set.hpp>
+#include <mapnik/label_collision_detector.hpp>
 
 // stl
 #include <ostream>
@@ -47,7 +48,7 @@ svg_renderer<T>::svg_renderer(Map const& m, T & output_iterator, double scale_fa
 
 template <typename T>
 svg_renderer<T>::svg_renderer(Map const& m, request const& req,  attributes const& vars, T & output_iterator, double scale_factor, unsigned offset_x, unsigned offset_y) :
-    feature_style_processor<svg_renderer>(m, scale_factor),
+    feature_style_processor<svg_renderer>(m, req, scale_factor),
     output_iterator_(output_iterator),
     generator_(output_iterator),
     painted_(false),
@@ -88,6 +89,12 @@ void svg_renderer<T>::end_map_processing(Map const&)
     MAPNIK_LOG_DEBUG(svg_renderer) << "svg_renderer: End map processing";
 }
 
+template <typename T>
+double svg_renderer<T>::label_coverage() const
+{
+    return common_.detector_->coverage();
+}
+
 template <typename T>
 void svg_renderer<T>::start_layer_processing(layer const& lay, box2d<double> const&)
 {
@@ -25,9 +25,219 @@
 #include <mapnik/attribute.hpp>
 #include <mapnik/feature.hpp>
 #include <mapnik/transform/transform_processor.hpp>
+#include <mapnik/expression_node.hpp>
+
+// stl
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace mapnik {
 
+namespace {
+
+// Collects the feature attributes read by the arguments of a transform.
+// Variables and the geometry type are not part of the memo key, a
+// transform that reads them is marked volatile and always evaluated.
+struct transform_inputs
+{
+    std::vector<attribute const*> attrs;
+    bool memoizable = true;
+
+    void operator() (attribute const& attr)
+    {
+        attrs.push_back(&attr);
+    }
+
+    void operator() (global_attribute const&)
+    {
+        memoizable = false;
+    }
+
+    void operator() (geometry_type_attribute const&)
+    {
+        memoizable = false;
+    }
+
+    template <typename Tag>
+    void operator() (unary_node<Tag> const& x)
+    {
+        util::apply_visitor(*this, x.expr);
+    }
+
+    template <typename Tag>
+    void operator() (binary_node<Tag> const& x)
+    {
+        util::apply_visitor(*this, x.left);
+        util::apply_visitor(*this, x.right);
+    }
+
+    void operator() (regex_match_node const& x)
+    {
+        util::apply_visitor(*this, x.expr);
+    }
+
+    void operator() (regex_replace_node const& x)
+    {
+        util::apply_visitor(*this, x.expr);
+    }
+
+    void operator() (unary_function_call const& x)
+    {
+        util::apply_visitor(*this, x.arg);
+    }
+
+    void operator() (binary_function_call const& x)
+    {
+        util::apply_visitor(*this, x.arg1);
+        util::apply_visitor(*this, x.arg2);
+    }
+
+    void operator() (identity_node const&) {}
+
+    void operator() (matrix_node const& x)
+    {
+        util::apply_visitor(*this, x.a_);
+        util::apply_visitor(*this, x.b_);
+        util::apply_visitor(*this, x.c_);
+        util::apply_visitor(*this, x.d_);
+        util::apply_visitor(*this, x.e_);
+        util::apply_visitor(*this, x.f_);
+    }
+
+    void operator() (translate_node const& x)
+    {
+        util::apply_visitor(*this, x.tx_);
+        util::apply_visitor(*this, x.ty_);
+    }
+
+    void operator() (scale_node const& x)
+    {
+        util::apply_visitor(*this, x.sx_);
+        util::apply_visitor(*this, x.sy_);
+    }
+
+    void operator() (rotate_node const& x)
+    {
+        util::apply_visitor(*this, x.angle_);
+        util::apply_visitor(*this, x.cx_);
+        util::apply_visitor(*this, x.cy_);
+    }
+
+    void operator() (skewX_node const& x)
+    {
+        util::apply_visitor(*this, x.angle_);
+    }
+
+    void operator() (skewY_node const& x)
+    {
+        util::apply_visitor(*this, x.angle_);
+    }
+
+    // literals
+    template <typename T>
+    void operator() (T const&) {}
+};
+
+// Affine matrices of the transform lists evaluated on this thread. A list
+// reading no data resolves to one matrix per scale factor; a list reading
+// feature attributes keeps the last few matrices keyed by their values.
+class transform_cache
+{
+    static constexpr std::size_t max_lists = 256;
+    static constexpr std::size_t max_results = 8;
+
+    struct result
+    {
+        double scale_factor;
+        std::vector<value> inputs;
+        agg::trans_affine tr;
+    };
+
+    struct entry
+    {
+        std::weak_ptr<transform_list> list;
+        transform_inputs inputs;
+        std::vector<result> results;
+        std::size_t next = 0;
+    };
+
+public:
+    agg::trans_affine const* find(feature_impl const& feature,
+                                  attributes const& vars,
+                                  transform_list_ptr const& list,
+                                  double scale_factor)
+    {
+        entry & e = lookup(list);
+        if (!e.inputs.memoizable) return nullptr;
+
+        inputs_.clear();
+        for (attribute const* attr : e.inputs.attrs)
+        {
+            inputs_.push_back(attr->value<value, feature_impl>(feature));
+        }
+        for (result const& r : e.results)
+        {
+            if (r.scale_factor == scale_factor && same_inputs(r.inputs, inputs_))
+            {
+                return &r.tr;
+            }
+        }
+
+        agg::trans_affine tr;
+        transform_processor_type::evaluate(tr, feature, vars, *list, scale_factor);
+        if (e.results.size() < max_results)
+        {
+            e.results.push_back(result{scale_factor, inputs_, tr});
+            return &e.results.back().tr;
+        }
+        result & r = e.results[e.next];
+        e.next = (e.next + 1) % max_results;
+        r.scale_factor = scale_factor;
+        r.inputs = inputs_;
+        r.tr = tr;
+        return &r.tr;
+    }
+
+private:
+    entry & lookup(transform_list_ptr const& list)
+    {
+        auto itr = entries_.find(list.get());
+        // an expired owner means the address now belongs to another list
+        if (itr != entries_.end() && !itr->second.list.expired())
+        {
+            return itr->second;
+        }
+        if (itr == entries_.end() && entries_.size() >= max_lists)
+        {
+            entries_.clear();
+        }
+        entry & e = entries_[list.get()];
+        e = entry();
+        e.list = list;
+        for (transform_node const& node : *list)
+        {
+            util::apply_visitor(e.inputs, *node);
+        }
+        return e;
+    }
+
+    static bool same_inputs(std::vector<value> const& lhs, std::vector<value> const& rhs)
+    {
+        for (std::size_t i = 0; i < lhs.size(); ++i)
+        {
+            // value equality converts between types, the key must not
+            if (lhs[i].which() != rhs[i].which() || !(lhs[i] == rhs[i])) return false;
+        }
+        return true;
+    }
+
+    std::unordered_map<transform_list const*, entry> entries_;
+    std::vector<value> inputs_;
+};
+
+}
+
 // START FIXME - move to its own compilation unit
 void evaluate_transform(agg::trans_affine& tr,
                         feature_impl const& feature,
@@ -36,11 +246,65 @@ void evaluate_transform(agg::trans_affine& tr,
 {
     if (trans_expr)
     {
-        transform_processor_type::evaluate(tr, feature, vars, *trans_expr, scale_factor);
+        static thread_local transform_cache cache;
+        agg::trans_affine const* cached = cache.find(feature, vars, trans_expr, scale_factor);
+        if (!cached)
+        {
+            transform_processor_type::evaluate(tr, feature, vars, *trans_expr, scale_factor);
+        }
+        else if (tr.is_identity(0.0))
+        {
+            tr = *cached;
+        }
+        else
+        {
+            tr.multiply(*cached);
+        }
     }
 }
 // END FIXME
 
+namespace {
+
+struct uses_placement_detector_impl
+{
+    bool operator() (point_symbolizer const& sym) const
+    {
+        return !unchecked(sym);
+    }
+
+    bool operator() (markers_symbolizer const& sym) const
+    {
+        return !unchecked(sym);
+    }
+
+    bool operator() (text_symbolizer const&) const { return true; }
+    bool operator() (shield_symbolizer const&) const { return true; }
+    bool operator() (group_symbolizer const&) const { return true; }
+    bool operator() (debug_symbolizer const&) const { return true; }
+
+    template <typename Symbolizer>
+    bool operator() (Symbolizer const&) const
+    {
+        return false;
+    }
+
+private:
+    // expressions count as false
+    static bool unchecked(symbolizer_base const& sym)
+    {
+        return get<value_bool>(sym, keys::allow_overlap, false) &&
+            get<value_bool>(sym, keys::ignore_placement, false);
+    }
+};
+
+}
+
+bool uses_placement_detector(symbolizer const& sym)
+{
+    return util::apply_visitor(uses_placement_detector_impl(), sym);
+}
+
 
 
 } // end of namespace mapnik
@@ -106,6 +106,7 @@ IMPLEMENT_ENUM( pattern_alignment_e, pattern_alignment_strings )
 static const char * halo_rasterizer_strings[] = {
     "full",
     "fast",
+    "sdf",
     ""
 };
 
@@ -159,6 +159,7 @@ static const property_meta_type key_meta[const_max_key] =
     property_meta_type{ "avoid-edges",nullptr, property_types::target_bool },
     property_meta_type{ "font-feature-settings", nullptr, property_types::target_font_feature_settings },
     property_meta_type{ "extend", nullptr, property_types::target_double},
+    property_meta_type{ "simplify-prefilter", nullptr, property_types::target_bool },
 
 };
 
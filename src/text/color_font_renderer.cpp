@@ -149,21 +149,31 @@ void composite_color_glyph<image_rgba8>(image_rgba8 & pixmap,
                            double opacity,
                            composite_mode_e comp_op);
 
-image_rgba8 render_glyph_image(glyph_t const& glyph,
-                               FT_Bitmap const& bitmap,
+image_rgba8 render_glyph_image(FT_Bitmap const& bitmap,
                                agg::trans_affine const& tr,
-                               pixel_position & render_pos)
+                               double angle,
+                               box2d<double> const& bbox,
+                               pixel_position & offset)
 {
-    agg::trans_affine transform(glyph_transform(tr, bitmap.rows, 0, 0, -glyph.rot.angle(), glyph.bbox));
+    agg::trans_affine transform(glyph_transform(tr, bitmap.rows, 0, 0, angle, bbox));
     box2d<double> bitmap_bbox(0, 0, bitmap.width, bitmap.rows);
     bitmap_bbox *= transform;
     image_rgba8 glyph_image(bitmap_bbox.width(), bitmap_bbox.height());
     transform *= agg::trans_affine_translation(-bitmap_bbox.minx(), -bitmap_bbox.miny());
-    render_pos = render_pos +
-                 pixel_position(glyph.pos.x, -glyph.pos.y) +
-                 pixel_position(std::round(bitmap_bbox.minx()), std::round(bitmap_bbox.miny()));
+    offset = pixel_position(std::round(bitmap_bbox.minx()), std::round(bitmap_bbox.miny()));
     composite_color_glyph(glyph_image, bitmap, transform, 1, dst_over);
     return glyph_image;
 }
 
+image_rgba8 render_glyph_image(glyph_t const& glyph,
+                               FT_Bitmap const& bitmap,
+                               agg::trans_affine const& tr,
+                               pixel_position & render_pos)
+{
+    pixel_position offset;
+    image_rgba8 glyph_image(render_glyph_image(bitmap, tr, -glyph.rot.angle(), glyph.bbox, offset));
+    render_pos = render_pos + pixel_position(glyph.pos.x, -glyph.pos.y) + offset;
+    return glyph_image;
+}
+
 } // namespace mapnik
@@ -0,0 +1,146 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/text/distance_field.hpp>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace mapnik
+{
+
+namespace {
+
+constexpr float far_away = 1e20f;
+
+// Squared euclidean distance transform of one row or column, after
+// Felzenszwalb & Huttenlocher: the lower envelope of the parabolas
+// rooted at every sample.
+void distance_transform_1d(float * grid, std::size_t stride, std::size_t length,
+                           std::vector<float> & f, std::vector<float> & z, std::vector<int> & v)
+{
+    f[0] = grid[0];
+    v[0] = 0;
+    z[0] = -far_away;
+    z[1] = far_away;
+    int k = 0;
+    for (int q = 1; q < static_cast<int>(length); ++q)
+    {
+        f[q] = grid[q * stride];
+        float s;
+        do
+        {
+            int r = v[k];
+            s = (f[q] - f[r] + float(q) * q - float(r) * r) / (2.0f * (q - r));
+        }
+        while (s <= z[k] && --k > -1);
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = far_away;
+    }
+    k = 0;
+    for (int q = 0; q < static_cast<int>(length); ++q)
+    {
+        while (z[k + 1] < q) ++k;
+        int r = v[k];
+        grid[q * stride] = f[r] + float(q - r) * (q - r);
+    }
+}
+
+}
+
+glyph_bitmap make_distance_field(glyph_bitmap const& coverage, unsigned spread)
+{
+    glyph_bitmap field;
+    field.left = coverage.left - static_cast<int>(spread);
+    field.top = coverage.top + static_cast<int>(spread);
+    field.width = coverage.width + 2 * spread;
+    field.rows = coverage.rows + 2 * spread;
+    std::size_t width = field.width;
+    std::size_t rows = field.rows;
+
+    // squared distance to the edge, the 50% coverage contour; partly
+    // covered pixels start at their distance to it
+    std::vector<float> grid(width * rows, far_away);
+    for (std::size_t y = 0; y < coverage.rows; ++y)
+    {
+        unsigned char const* src = coverage.buffer.data() + y * coverage.width;
+        float * dst = grid.data() + (y + spread) * width + spread;
+        for (std::size_t x = 0; x < coverage.width; ++x)
+        {
+            if (src[x] == 0) continue;
+            float d = std::max(0.0f, 0.5f - src[x] / 255.0f);
+            dst[x] = d * d;
+        }
+    }
+
+    std::size_t length = std::max(width, rows);
+    std::vector<float> f(length);
+    std::vector<float> z(length + 1);
+    std::vector<int> v(length);
+    for (std::size_t x = 0; x < width; ++x)
+    {
+        distance_transform_1d(grid.data() + x, width, rows, f, z, v);
+    }
+    for (std::size_t y = 0; y < rows; ++y)
+    {
+        distance_transform_1d(grid.data() + y * width, 1, width, f, z, v);
+    }
+
+    field.buffer.resize(width * rows);
+    float scale = 255.0f / spread;
+    for (std::size_t i = 0; i < grid.size(); ++i)
+    {
+        float d = std::sqrt(grid[i]);
+        field.buffer[i] = static_cast<unsigned char>(std::lround(std::max(0.0f, 255.0f - d * scale)));
+    }
+    return field;
+}
+
+unsigned distance_field_spread(double radius)
+{
+    unsigned spread = 4;
+    while (spread < radius + 1.0)
+    {
+        spread *= 2;
+        if (spread > max_distance_field_spread) return 0;
+    }
+    return spread;
+}
+
+std::array<unsigned char, 256> distance_field_halo(unsigned spread, double radius)
+{
+    std::array<unsigned char, 256> halo;
+    for (unsigned value = 0; value < 256; ++value)
+    {
+        double d = spread * (255 - value) / 255.0;
+        double alpha = std::min(1.0, std::max(0.0, radius + 0.5 - d));
+        halo[value] = static_cast<unsigned char>(std::lround(alpha * 255.0));
+    }
+    return halo;
+}
+
+}
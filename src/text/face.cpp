@@ -43,6 +43,13 @@ font_face::font_face(FT_Face face)
 {
 }
 
+font_face::font_face(FT_Face face, std::shared_ptr<void> memory)
+    : face_(face),
+      color_font_(init_color_font()),
+      memory_(std::move(memory))
+{
+}
+
 bool font_face::init_color_font()
 {
     static const uint32_t tag = FT_MAKE_TAG('C', 'B', 'D', 'T');
@@ -62,6 +69,22 @@ bool font_face::set_unscaled_character_sizes()
     return (FT_Set_Char_Size(face_, 0, char_height, 0, 0) == 0);
 }
 
+bool font_face::has_glyph(std::uint32_t codepoint) const
+{
+    std::uint32_t block = codepoint >> 8;
+    auto itr = coverage_.find(block);
+    if (itr == coverage_.end())
+    {
+        std::bitset<256> covered;
+        for (std::uint32_t i = 0; i < 256; ++i)
+        {
+            covered[i] = FT_Get_Char_Index(face_, (block << 8) | i) != 0;
+        }
+        itr = coverage_.emplace(block, covered).first;
+    }
+    return itr->second[codepoint & 0xff];
+}
+
 bool font_face::glyph_dimensions(glyph_info & glyph) const
 {
     FT_Vector pen;
@@ -0,0 +1,158 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/text/glyph_cache.hpp>
+
+// stl
+#include <functional>
+
+namespace mapnik
+{
+
+template class singleton<glyph_cache, CreateStatic>;
+
+namespace {
+
+inline void hash_combine(std::size_t & seed, std::size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+inline std::size_t bitmap_bytes(glyph_bitmap const& bitmap)
+{
+    return sizeof(glyph_bitmap) + bitmap.buffer.size();
+}
+
+}
+
+std::size_t glyph_cache_key_hash::operator()(glyph_cache_key const& key) const
+{
+    std::size_t seed = std::hash<std::string>()(key.face_name);
+    hash_combine(seed, key.glyph_index);
+    hash_combine(seed, static_cast<std::size_t>(key.size));
+    hash_combine(seed, static_cast<std::size_t>(key.xx));
+    hash_combine(seed, static_cast<std::size_t>(key.xy));
+    hash_combine(seed, static_cast<std::size_t>(key.yx));
+    hash_combine(seed, static_cast<std::size_t>(key.yy));
+    hash_combine(seed, static_cast<std::size_t>(key.offset_x));
+    hash_combine(seed, static_cast<std::size_t>(key.offset_y));
+    hash_combine(seed, static_cast<std::size_t>(key.halo_radius));
+    hash_combine(seed, key.distance_spread);
+    return seed;
+}
+
+glyph_cache::glyph_cache()
+    : entries_(),
+      index_(),
+      capacity_(0),
+      size_bytes_(0),
+      hits_(0),
+      misses_(0) {}
+
+glyph_cache::~glyph_cache() {}
+
+glyph_bitmap_ptr glyph_cache::find(glyph_cache_key const& key)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    auto itr = index_.find(key);
+    if (itr == index_.end())
+    {
+        ++misses_;
+        return glyph_bitmap_ptr();
+    }
+    ++hits_;
+    // move to front, most recently used
+    entries_.splice(entries_.begin(), entries_, itr->second);
+    return itr->second->second;
+}
+
+void glyph_cache::insert(glyph_cache_key const& key, glyph_bitmap_ptr const& bitmap)
+{
+    if (!bitmap || !enabled()) return;
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    auto itr = index_.find(key);
+    if (itr != index_.end())
+    {
+        // another thread rendered the same glyph
+        entries_.splice(entries_.begin(), entries_, itr->second);
+        return;
+    }
+    entries_.emplace_front(key, bitmap);
+    index_.emplace(key, entries_.begin());
+    size_bytes_ += bitmap_bytes(*bitmap);
+    evict();
+}
+
+void glyph_cache::evict()
+{
+    while (size_bytes_ > capacity_ && !entries_.empty())
+    {
+        entry_type const& entry = entries_.back();
+        size_bytes_ -= bitmap_bytes(*entry.second);
+        index_.erase(entry.first);
+        entries_.pop_back();
+    }
+}
+
+void glyph_cache::set_capacity(std::size_t bytes)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    capacity_ = bytes;
+    evict();
+}
+
+std::size_t glyph_cache::size() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return entries_.size();
+}
+
+std::size_t glyph_cache::size_bytes() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return size_bytes_;
+}
+
+void glyph_cache::clear()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    entries_.clear();
+    index_.clear();
+    size_bytes_ = 0;
+    hits_ = 0;
+    misses_ = 0;
+}
+
+}
@@ -31,7 +31,9 @@
 #include <mapnik/text/text_properties.hpp>
 #include <mapnik/text/glyph_positions.hpp>
 #include <mapnik/vertex_cache.hpp>
+#include <mapnik/tolerance_iterator.hpp>
 #include <mapnik/util/math.hpp>
+#include <mapnik/trace.hpp>
 
 // stl
 #include <vector>
@@ -101,6 +103,7 @@ placement_finder::placement_finder(feature_impl const& feature,
 
 bool placement_finder::next_position()
 {
+    trace::scope layout_trace("text", "layout");
     if (info_.next())
     {
         // parent layout, has top-level ownership of a new evaluated_format_properties_ptr (TODO is this good enough to stay in scope???)
@@ -154,6 +157,7 @@ text_upright_e placement_finder::simplify_upright(text_upright_e upright, double
 
 bool placement_finder::find_point_placement(pixel_position const& pos)
 {
+    trace::scope placement_trace("text", "point_placement");
     glyph_positions_ptr glyphs = std::make_unique<glyph_positions>();
     std::vector<box2d<double> > bboxes;
 
@@ -242,6 +246,70 @@ bool placement_finder::find_point_placement(pixel_position const& pos)
     return true;
 }
 
+bool placement_finder::find_line_placements(vertex_cache & pp, bool points)
+{
+    trace::scope placement_trace("text", "line_placement");
+    if (!layouts_.line_count()) return true; //TODO
+    pp.reset();
+
+    bool success = false;
+    while (pp.next_subpath())
+    {
+        if (points)
+        {
+            if (pp.length() <= 0.001)
+            {
+                success = find_point_placement(pp.current_position()) || success;
+                continue;
+            }
+        }
+        else
+        {
+            if ((pp.length() < text_props_->minimum_path_length * scale_factor_)
+                ||
+                (pp.length() <= 0.001) // Clipping removed whole geometry
+                ||
+                (pp.length() < layouts_.width()))
+                {
+                    continue;
+                }
+        }
+
+        double spacing = get_spacing(pp.length(), points ? 0. : layouts_.width());
+
+        //horizontal_alignment_e halign = layouts_.back()->horizontal_alignment();
+
+        // halign == H_LEFT -> don't move
+        if (horizontal_alignment_ == H_MIDDLE || horizontal_alignment_ == H_AUTO || horizontal_alignment_ == H_ADJUST)
+        {
+            if (!pp.forward(spacing / 2.0)) continue;
+        }
+        else if (horizontal_alignment_ == H_RIGHT)
+        {
+            if (!pp.forward(pp.length())) continue;
+        }
+
+        if (move_dx_ != 0.0) path_move_dx(pp, move_dx_);
+
+        do
+        {
+            tolerance_iterator tolerance_offset(text_props_->label_position_tolerance * scale_factor_, spacing); //TODO: Handle halign
+            while (tolerance_offset.next())
+            {
+                vertex_cache::scoped_state state(pp);
+                if (pp.move(tolerance_offset.get())
+                    && ((points && find_point_placement(pp.current_position()))
+                        || (!points && single_line_placement(pp, text_props_->upright))))
+                {
+                    success = true;
+                    break;
+                }
+            }
+        } while (pp.forward(spacing));
+    }
+    return success;
+}
+
 bool placement_finder::single_line_placement(vertex_cache &pp, text_upright_e orientation)
 {
     //
@@ -31,6 +31,8 @@
 #include <mapnik/image_util.hpp>
 #include <mapnik/image_any.hpp>
 #include <mapnik/agg_rasterizer.hpp>
+#include <mapnik/text/glyph_cache.hpp>
+#include <mapnik/text/distance_field.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore_agg.hpp>
@@ -47,9 +49,39 @@
 #include "agg_renderer_scanline.h"
 #pragma GCC diagnostic pop
 
+// stl
+#include <algorithm>
+#include <array>
+#include <cmath>
+
 namespace mapnik
 {
 
+namespace {
+
+// picks the bitmap strike of a colour face nearest to size
+void select_color_strike(FT_Face face, double size)
+{
+    if (face->num_fixed_sizes > 0)
+    {
+        int scaled_size = static_cast<int>(size);
+        int best_match = 0;
+        int diff = std::abs(scaled_size - face->available_sizes[0].width);
+        for (int i = 1; i < face->num_fixed_sizes; ++i)
+        {
+            int ndiff = std::abs(scaled_size - face->available_sizes[i].height);
+            if (ndiff < diff)
+            {
+                best_match = i;
+                diff = ndiff;
+            }
+        }
+        FT_Select_Size(face, best_match);
+    }
+}
+
+}
+
 text_renderer::text_renderer (halo_rasterizer_e rasterizer, composite_mode_e comp_op,
                               composite_mode_e halo_comp_op, double scale_factor, stroker_ptr stroker)
     : rasterizer_(rasterizer),
@@ -80,6 +112,10 @@ void text_renderer::prepare_glyphs(glyph_positions const& positions)
 
     glyphs_.clear();
     glyphs_.reserve(positions.size());
+    // distance field halos are drawn from the placement independent
+    // bitmaps too, the cache only decides whether they are kept
+    bool cache_enabled = glyph_cache::instance().enabled();
+    bool use_cache = cache_enabled || rasterizer_ == HALO_RASTERIZER_SDF;
 
     for (auto const& glyph_pos : positions)
     {
@@ -87,25 +123,19 @@ void text_renderer::prepare_glyphs(glyph_positions const& positions)
         FT_Int32 load_flags = FT_LOAD_DEFAULT | FT_LOAD_NO_HINTING;
 
         FT_Face face = glyph.face->get_face();
+        if (glyph.face->is_color() ? cache_enabled : use_cache)
+        {
+            // loaded and rasterized on demand, see cached_bitmap()
+            double size = glyph.format->text_size * scale_factor_;
+            pixel_position pos = glyph_pos.pos + glyph.offset.rotate(glyph_pos.rot);
+            box2d<double> bbox(0, glyph_pos.glyph.ymin(), glyph_pos.glyph.advance(), glyph_pos.glyph.ymax());
+            glyphs_.emplace_back(nullptr, glyph.face.get(), glyph.glyph_index, *glyph.format, pos, glyph_pos.rot, size, bbox);
+            continue;
+        }
         if (glyph.face->is_color())
         {
             load_flags |= FT_LOAD_COLOR ;
-            if (face->num_fixed_sizes > 0)
-            {
-                int scaled_size = static_cast<int>(glyph.format->text_size * scale_factor_);
-                int best_match = 0;
-                int diff = std::abs(scaled_size - face->available_sizes[0].width);
-                for (int i = 1; i < face->num_fixed_sizes; ++i)
-                {
-                    int ndiff = std::abs(scaled_size - face->available_sizes[i].height);
-                    if (ndiff < diff)
-                    {
-                        best_match = i;
-                        diff = ndiff;
-                    }
-                }
-                error = FT_Select_Size(face, best_match);
-            }
+            select_color_strike(face, glyph.format->text_size * scale_factor_);
         }
         else
         {
@@ -129,21 +159,171 @@ void text_renderer::prepare_glyphs(glyph_positions const& positions)
         error = FT_Get_Glyph(face->glyph, &image);
         if (error) continue;
         box2d<double> bbox(0, glyph_pos.glyph.ymin(), glyph_pos.glyph.advance(), glyph_pos.glyph.ymax());
-        glyphs_.emplace_back(image, *glyph.format, pos, glyph_pos.rot, size, bbox);
+        glyphs_.emplace_back(image, glyph.face.get(), glyph.glyph_index, *glyph.format, pos, glyph_pos.rot, size, bbox);
+    }
+}
+
+glyph_bitmap_ptr text_renderer::cached_bitmap(glyph_t const& glyph,
+                                              agg::trans_affine const& tr,
+                                              FT_Vector const& start,
+                                              double stroke_radius,
+                                              int & left,
+                                              int & top,
+                                              unsigned distance_spread) const
+{
+    // The glyph is placed at M * (R * outline + pen) + start. Rasterize
+    // M * R * outline at a quantized subpixel offset and move the bitmap
+    // by whole pixels, so the same bitmap serves every placement.
+    double pen_x = glyph.pos.x * 64.0;
+    double pen_y = glyph.pos.y * 64.0;
+    double dx = tr.sx * pen_x + tr.shx * pen_y + start.x;
+    double dy = tr.shy * pen_x + tr.sy * pen_y + start.y;
+    int const step = glyph_cache::subpixel_step;
+    long ix = static_cast<long>(std::floor(dx / 64.0));
+    long iy = static_cast<long>(std::floor(dy / 64.0));
+    int fx = static_cast<int>(std::lround((dx - ix * 64.0) / step)) * step;
+    int fy = static_cast<int>(std::lround((dy - iy * 64.0) / step)) * step;
+    if (fx >= 64) { ++ix; fx -= 64; }
+    if (fy >= 64) { ++iy; fy -= 64; }
+
+    FT_Matrix matrix;
+    matrix.xx = static_cast<FT_Fixed>((tr.sx * glyph.rot.cos + tr.shx * glyph.rot.sin) * 0x10000L);
+    matrix.xy = static_cast<FT_Fixed>((-tr.sx * glyph.rot.sin + tr.shx * glyph.rot.cos) * 0x10000L);
+    matrix.yx = static_cast<FT_Fixed>((tr.shy * glyph.rot.cos + tr.sy * glyph.rot.sin) * 0x10000L);
+    matrix.yy = static_cast<FT_Fixed>((-tr.shy * glyph.rot.sin + tr.sy * glyph.rot.cos) * 0x10000L);
+
+    FT_Face face = glyph.face->get_face();
+    glyph_cache_key key { glyph.face->family_name() + " " + glyph.face->style_name(),
+                          glyph.glyph_index,
+                          static_cast<long>(glyph.size * 64.0),
+                          matrix.xx, matrix.xy, matrix.yx, matrix.yy,
+                          fx, fy,
+                          static_cast<long>(stroke_radius * 64.0),
+                          distance_spread };
+    glyph_cache & cache = glyph_cache::instance();
+    glyph_bitmap_ptr bitmap = cache.find(key);
+    if (!bitmap && distance_spread > 0)
+    {
+        // built from the coverage bitmap at the same placement
+        int coverage_left, coverage_top;
+        glyph_bitmap_ptr coverage = cached_bitmap(glyph, tr, start, 0.0, coverage_left, coverage_top);
+        if (!coverage) return coverage;
+        bitmap = std::make_shared<glyph_bitmap>(make_distance_field(*coverage, distance_spread));
+        cache.insert(key, bitmap);
+    }
+    if (!bitmap)
+    {
+        glyph.face->set_character_sizes(glyph.size);
+        FT_Vector offset;
+        offset.x = fx;
+        offset.y = fy;
+        FT_Set_Transform(face, &matrix, &offset);
+        if (FT_Load_Glyph(face, glyph.glyph_index, FT_LOAD_DEFAULT | FT_LOAD_NO_HINTING)) return bitmap;
+        FT_Glyph image;
+        if (FT_Get_Glyph(face->glyph, &image)) return bitmap;
+        FT_Error error = 0;
+        if (stroke_radius > 0.0)
+        {
+            stroker_->init(stroke_radius);
+            error = FT_Glyph_Stroke(&image, stroker_->get(), 1);
+        }
+        if (!error)
+        {
+            error = FT_Glyph_To_Bitmap(&image, FT_RENDER_MODE_NORMAL, 0, 1);
+        }
+        if (!error)
+        {
+            FT_BitmapGlyph bit = reinterpret_cast<FT_BitmapGlyph>(image);
+            auto result = std::make_shared<glyph_bitmap>();
+            result->left = bit->left;
+            result->top = bit->top;
+            result->width = bit->bitmap.width;
+            result->rows = bit->bitmap.rows;
+            result->buffer.resize(result->width * result->rows);
+            for (unsigned row = 0; row < result->rows; ++row)
+            {
+                std::copy_n(bit->bitmap.buffer + row * bit->bitmap.pitch,
+                            result->width,
+                            result->buffer.data() + row * result->width);
+            }
+            bitmap = result;
+            cache.insert(key, bitmap);
+        }
+        FT_Done_Glyph(image);
+        if (!bitmap) return bitmap;
+    }
+    left = bitmap->left + static_cast<int>(ix);
+    top = bitmap->top + static_cast<int>(iy);
+    return bitmap;
+}
+
+glyph_bitmap_ptr text_renderer::cached_color_bitmap(glyph_t const& glyph,
+                                                    agg::trans_affine const& tr,
+                                                    pixel_position & render_pos) const
+{
+    // The image only depends on the strike, rotation and transform, its
+    // offset from the pen position is kept with it.
+    FT_Matrix matrix;
+    matrix.xx = static_cast<FT_Fixed>((tr.sx * glyph.rot.cos + tr.shx * glyph.rot.sin) * 0x10000L);
+    matrix.xy = static_cast<FT_Fixed>((-tr.sx * glyph.rot.sin + tr.shx * glyph.rot.cos) * 0x10000L);
+    matrix.yx = static_cast<FT_Fixed>((tr.shy * glyph.rot.cos + tr.sy * glyph.rot.sin) * 0x10000L);
+    matrix.yy = static_cast<FT_Fixed>((-tr.shy * glyph.rot.sin + tr.sy * glyph.rot.cos) * 0x10000L);
+    glyph_cache_key key { glyph.face->family_name() + " " + glyph.face->style_name(),
+                          glyph.glyph_index,
+                          static_cast<long>(glyph.size * 64.0),
+                          matrix.xx, matrix.xy, matrix.yx, matrix.yy,
+                          static_cast<int>(tr.tx * 64.0), static_cast<int>(tr.ty * 64.0),
+                          0, 0 };
+    glyph_cache & cache = glyph_cache::instance();
+    glyph_bitmap_ptr bitmap = cache.find(key);
+    if (!bitmap)
+    {
+        FT_Face face = glyph.face->get_face();
+        select_color_strike(face, glyph.size);
+        FT_Set_Transform(face, nullptr, nullptr);
+        if (FT_Load_Glyph(face, glyph.glyph_index, FT_LOAD_DEFAULT | FT_LOAD_NO_HINTING | FT_LOAD_COLOR)) return bitmap;
+        FT_Glyph image;
+        if (FT_Get_Glyph(face->glyph, &image)) return bitmap;
+        FT_Error error = 0;
+        if (image->format != FT_GLYPH_FORMAT_BITMAP)
+        {
+            error = FT_Glyph_To_Bitmap(&image, FT_RENDER_MODE_NORMAL, 0, 1);
+        }
+        FT_BitmapGlyph bit = reinterpret_cast<FT_BitmapGlyph>(image);
+        if (!error && bit->bitmap.pixel_mode == FT_PIXEL_MODE_BGRA)
+        {
+            pixel_position offset;
+            image_rgba8 glyph_image(render_glyph_image(bit->bitmap, tr, -glyph.rot.angle(), glyph.bbox, offset));
+            auto result = std::make_shared<glyph_bitmap>();
+            result->left = static_cast<int>(offset.x);
+            result->top = static_cast<int>(offset.y);
+            result->width = glyph_image.width();
+            result->rows = glyph_image.height();
+            result->buffer.assign(glyph_image.bytes(), glyph_image.bytes() + glyph_image.size());
+            bitmap = result;
+            cache.insert(key, bitmap);
+        }
+        FT_Done_Glyph(image);
+        if (!bitmap) return bitmap;
     }
+    render_pos = render_pos +
+                 pixel_position(glyph.pos.x, -glyph.pos.y) +
+                 pixel_position(bitmap->left, bitmap->top);
+    return bitmap;
 }
 
 template <typename T>
-void composite_bitmap(T & pixmap, FT_Bitmap *bitmap, unsigned rgba, int x, int y, double opacity, composite_mode_e comp_op)
+void composite_bitmap(T & pixmap, unsigned char const* buffer, unsigned width, unsigned rows,
+                      unsigned rgba, int x, int y, double opacity, composite_mode_e comp_op)
 {
-    int x_max = x + bitmap->width;
-    int y_max = y + bitmap->rows;
+    int x_max = x + width;
+    int y_max = y + rows;
 
     for (int i = x, p = 0; i < x_max; ++i, ++p)
     {
         for (int j = y, q = 0; j < y_max; ++j, ++q)
         {
-            unsigned gray = bitmap->buffer[q * bitmap->width + p];
+            unsigned gray = buffer[q * width + p];
             if (gray)
             {
                 mapnik::composite_pixel(pixmap, comp_op, i, j, rgba, gray, opacity);
@@ -152,6 +332,35 @@ void composite_bitmap(T & pixmap, FT_Bitmap *bitmap, unsigned rgba, int x, int y
     }
 }
 
+// composites a distance field, levels giving the halo coverage of
+// every distance
+template <typename T>
+void composite_distance_field(T & pixmap, glyph_bitmap const& field,
+                              std::array<unsigned char, 256> const& levels,
+                              unsigned rgba, int x, int y, double opacity, composite_mode_e comp_op)
+{
+    int width = field.width;
+    int rows = field.rows;
+    for (int q = 0; q < rows; ++q)
+    {
+        unsigned char const* row = field.buffer.data() + q * width;
+        for (int p = 0; p < width; ++p)
+        {
+            unsigned gray = levels[row[p]];
+            if (gray)
+            {
+                mapnik::composite_pixel(pixmap, comp_op, x + p, y + q, rgba, gray, opacity);
+            }
+        }
+    }
+}
+
+template <typename T>
+void composite_bitmap(T & pixmap, FT_Bitmap *bitmap, unsigned rgba, int x, int y, double opacity, composite_mode_e comp_op)
+{
+    composite_bitmap(pixmap, bitmap->buffer, bitmap->width, bitmap->rows, rgba, x, y, opacity, comp_op);
+}
+
 template <typename T>
 agg_text_renderer<T>::agg_text_renderer (pixmap_type & pixmap,
                                          halo_rasterizer_e rasterizer,
@@ -199,6 +408,9 @@ void agg_text_renderer<T>::render(glyph_positions const& pos)
     unsigned halo_fill = black.rgba();
     double text_opacity = 1.0;
     double halo_opacity = 1.0;
+    std::array<unsigned char, 256> halo_levels;
+    unsigned levels_spread = 0;
+    double levels_radius = 0.0;
 
     for (auto const& glyph : glyphs_)
     {
@@ -207,6 +419,60 @@ void agg_text_renderer<T>::render(glyph_positions const& pos)
         halo_radius = glyph.properties.halo_radius * scale_factor_;
         // make sure we've got reasonable values.
         if (halo_radius <= 0.0 || halo_radius > 1024.0) continue;
+        if (!glyph.image && glyph.face->is_color())
+        {
+            // as for uncached colour glyphs, only the fast rasterizer
+            // draws their halo
+            if (rasterizer_ == HALO_RASTERIZER_FULL) continue;
+            pixel_position render_pos(base_point);
+            glyph_bitmap_ptr bitmap = cached_color_bitmap(glyph, transform_, render_pos);
+            if (!bitmap) continue;
+            const constexpr std::size_t pixel_size = sizeof(image_rgba8::pixel_type);
+            render_halo<pixel_size>(bitmap->buffer.data(),
+                                    bitmap->width, bitmap->rows,
+                                    halo_fill,
+                                    render_pos.x, render_pos.y,
+                                    halo_radius, halo_opacity, halo_comp_op_);
+            continue;
+        }
+        if (!glyph.image)
+        {
+            int left = 0, top = 0;
+            unsigned spread = rasterizer_ == HALO_RASTERIZER_SDF ? distance_field_spread(halo_radius) : 0;
+            if (spread > 0)
+            {
+                glyph_bitmap_ptr field = cached_bitmap(glyph, halo_transform_, start_halo,
+                                                       0.0, left, top, spread);
+                if (!field) continue;
+                if (spread != levels_spread || halo_radius != levels_radius)
+                {
+                    halo_levels = distance_field_halo(spread, halo_radius);
+                    levels_spread = spread;
+                    levels_radius = halo_radius;
+                }
+                composite_distance_field(pixmap_, *field, halo_levels, halo_fill,
+                                         left, height - top, halo_opacity, halo_comp_op_);
+                continue;
+            }
+            // halos too wide for a distance field are stroked
+            bool full = rasterizer_ != HALO_RASTERIZER_FAST;
+            glyph_bitmap_ptr bitmap = cached_bitmap(glyph, halo_transform_, start_halo,
+                                                    full ? halo_radius : 0.0, left, top);
+            if (!bitmap) continue;
+            if (full)
+            {
+                composite_bitmap(pixmap_, bitmap->buffer.data(), bitmap->width, bitmap->rows,
+                                 halo_fill, left, height - top, halo_opacity, halo_comp_op_);
+            }
+            else
+            {
+                render_halo<1>(bitmap->buffer.data(),
+                               bitmap->width, bitmap->rows,
+                               halo_fill, left, height - top,
+                               halo_radius, halo_opacity, halo_comp_op_);
+            }
+            continue;
+        }
         FT_Glyph g;
         error = FT_Glyph_Copy(glyph.image, &g);
         if (!error)
@@ -280,6 +546,31 @@ void agg_text_renderer<T>::render(glyph_positions const& pos)
         fill = glyph.properties.fill.rgba();
         text_opacity = glyph.properties.text_opacity;
 
+        if (!glyph.image && glyph.face->is_color())
+        {
+            pixel_position render_pos(base_point);
+            glyph_bitmap_ptr bitmap = cached_color_bitmap(glyph, transform_, render_pos);
+            if (bitmap)
+            {
+                // wraps the cached pixels, which compositing only reads
+                image_rgba8 const glyph_image(bitmap->width, bitmap->rows,
+                                              const_cast<unsigned char*>(bitmap->buffer.data()), true);
+                composite(pixmap_, glyph_image, comp_op_, text_opacity,
+                          static_cast<int>(render_pos.x), static_cast<int>(render_pos.y));
+            }
+            continue;
+        }
+        if (!glyph.image)
+        {
+            int left = 0, top = 0;
+            glyph_bitmap_ptr bitmap = cached_bitmap(glyph, transform_, start, 0.0, left, top);
+            if (bitmap)
+            {
+                composite_bitmap(pixmap_, bitmap->buffer.data(), bitmap->width, bitmap->rows,
+                                 fill, left, height - top, text_opacity, comp_op_);
+            }
+            continue;
+        }
         FT_Glyph_Transform(glyph.image, &matrix, &start);
         error = 0;
         if ( glyph.image->format != FT_GLYPH_FORMAT_BITMAP )
@@ -345,6 +636,34 @@ void grid_text_renderer<T>::render(glyph_positions const& pos, value_integer fea
     for (auto & glyph : glyphs_)
     {
         halo_radius = glyph.properties.halo_radius * scale_factor_;
+        if (!glyph.image && glyph.face->is_color())
+        {
+            pixel_position render_pos(base_point);
+            glyph_bitmap_ptr bitmap = cached_color_bitmap(glyph, transform_, render_pos);
+            if (bitmap)
+            {
+                const constexpr std::size_t pixel_size = sizeof(image_rgba8::pixel_type);
+                render_halo_id<pixel_size>(bitmap->buffer.data(),
+                                           bitmap->width, bitmap->rows,
+                                           feature_id,
+                                           render_pos.x, render_pos.y,
+                                           static_cast<int>(halo_radius));
+            }
+            continue;
+        }
+        if (!glyph.image)
+        {
+            int left = 0, top = 0;
+            glyph_bitmap_ptr bitmap = cached_bitmap(glyph, halo_transform_, start, 0.0, left, top);
+            if (bitmap)
+            {
+                render_halo_id<1>(bitmap->buffer.data(),
+                                  bitmap->width, bitmap->rows,
+                                  feature_id, left, height - top,
+                                  static_cast<int>(halo_radius));
+            }
+            continue;
+        }
         FT_Glyph_Transform(glyph.image, &halo_matrix, &start);
         error = FT_Glyph_To_Bitmap(&glyph.image, FT_RENDER_MODE_NORMAL, 0, 1);
         if (!error)
@@ -383,7 +702,7 @@ void grid_text_renderer<T>::render(glyph_positions const& pos, value_integer fea
 
 template <typename T>
 template <std::size_t PixelWidth>
-void agg_text_renderer<T>::render_halo(unsigned char *buffer,
+void agg_text_renderer<T>::render_halo(unsigned char const* buffer,
                                        unsigned width,
                                        unsigned height,
                                        unsigned rgba,
@@ -437,7 +756,7 @@ void agg_text_renderer<T>::render_halo(unsigned char *buffer,
 
 template <typename T>
 template <std::size_t PixelWidth>
-void grid_text_renderer<T>::render_halo_id(unsigned char *buffer,
+void grid_text_renderer<T>::render_halo_id(unsigned char const* buffer,
                                            unsigned width,
                                            unsigned height,
                                            mapnik::value_integer feature_id,
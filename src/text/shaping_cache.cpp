@@ -0,0 +1,145 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+// mapnik
+#include <mapnik/text/shaping_cache.hpp>
+
+// stl
+#include <functional>
+
+namespace mapnik
+{
+
+template class singleton<shaping_cache, CreateStatic>;
+
+namespace {
+
+inline void hash_combine(std::size_t & seed, std::size_t value)
+{
+    seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+}
+
+std::size_t shaping_cache_key_hash::operator()(shaping_cache_key const& key) const
+{
+    std::size_t seed = static_cast<std::size_t>(key.text.hashCode());
+    hash_combine(seed, key.first_char);
+    hash_combine(seed, key.last_char);
+    hash_combine(seed, std::hash<double>()(key.scale_factor));
+    for (shaping_format_run const& run : key.runs)
+    {
+        hash_combine(seed, run.start);
+        hash_combine(seed, run.end);
+        hash_combine(seed, std::hash<std::string>()(run.face_name));
+        for (std::string const& name : run.fontset)
+        {
+            hash_combine(seed, std::hash<std::string>()(name));
+        }
+        hash_combine(seed, std::hash<double>()(run.text_size));
+        hash_combine(seed, std::hash<std::string>()(run.features));
+    }
+    return seed;
+}
+
+shaping_cache::shaping_cache()
+    : entries_(),
+      index_(),
+      capacity_(0),
+      hits_(0),
+      misses_(0) {}
+
+shaping_cache::~shaping_cache() {}
+
+shaped_line_ptr shaping_cache::find(shaping_cache_key const& key)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    auto itr = index_.find(key);
+    if (itr == index_.end())
+    {
+        ++misses_;
+        return shaped_line_ptr();
+    }
+    ++hits_;
+    // move to front, most recently used
+    entries_.splice(entries_.begin(), entries_, itr->second);
+    return itr->second->second;
+}
+
+void shaping_cache::insert(shaping_cache_key const& key, shaped_line_ptr const& line)
+{
+    if (!line || !enabled()) return;
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    auto itr = index_.find(key);
+    if (itr != index_.end())
+    {
+        // another thread shaped the same line
+        entries_.splice(entries_.begin(), entries_, itr->second);
+        return;
+    }
+    entries_.emplace_front(key, line);
+    index_.emplace(key, entries_.begin());
+    evict();
+}
+
+void shaping_cache::evict()
+{
+    while (entries_.size() > capacity_)
+    {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+}
+
+void shaping_cache::set_capacity(std::size_t lines)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    capacity_ = lines;
+    evict();
+}
+
+std::size_t shaping_cache::size() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return entries_.size();
+}
+
+void shaping_cache::clear()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    entries_.clear();
+    index_.clear();
+    hits_ = 0;
+    misses_ = 0;
+}
+
+}
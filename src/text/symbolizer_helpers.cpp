@@ -33,6 +33,7 @@
 #include <mapnik/geometry/centroid.hpp>
 #include <mapnik/vertex_processor.hpp>
 #include <mapnik/geom_util.hpp>
+#include <mapnik/renderer_common/interior_position.hpp>
 #include <mapnik/parse_path.hpp>
 #include <mapnik/debug.hpp>
 #include <mapnik/symbolizer.hpp>
@@ -289,8 +290,7 @@ void base_symbolizer_helper::initialize_points() const
             else if (how_placed == INTERIOR_PLACEMENT && type == geometry::geometry_types::Polygon)
             {
                 auto const& poly = mapnik::util::get<geometry::polygon<double> >(geom);
-                geometry::polygon_vertex_adapter<double> va(poly);
-                success = label::interior_position(va, label_x, label_y);
+                success = interior_position(feature_, poly, prj_trans_, t_, label_x, label_y);
             }
             else
             {
@@ -352,38 +352,47 @@ placements_list const& text_symbolizer_helper::get() const
     return finder_.placements();
 }
 
-class apply_line_placement_visitor
+struct vertex_cache_builder
 {
-public:
-    apply_line_placement_visitor(vertex_converter_type & converter,
-                                 placement_finder_adapter<placement_finder> const & adapter)
-        : converter_(converter), adapter_(adapter)
+    template <typename PathT>
+    void add_path(PathT & path) const
     {
+        pp_ = std::make_unique<vertex_cache>(path);
     }
 
-    bool operator()(geometry::line_string<double> const & geo) const
+    mutable vertex_cache_ptr pp_;
+};
+
+class build_line_path_visitor
+{
+public:
+    build_line_path_visitor(vertex_converter_type & converter)
+        : converter_(converter) {}
+
+    vertex_cache_ptr operator()(geometry::line_string<double> const & geo) const
     {
         geometry::line_string_vertex_adapter<double> va(geo);
-        converter_.apply(va, adapter_);
-        return adapter_.status();
+        vertex_cache_builder builder;
+        converter_.apply(va, builder);
+        return std::move(builder.pp_);
     }
 
-    bool operator()(geometry::polygon<double> const & geo) const
+    vertex_cache_ptr operator()(geometry::polygon<double> const & geo) const
     {
         geometry::polygon_vertex_adapter<double> va(geo);
-        converter_.apply(va, adapter_);
-        return adapter_.status();
+        vertex_cache_builder builder;
+        converter_.apply(va, builder);
+        return std::move(builder.pp_);
     }
 
     template <typename T>
-    bool operator()(T const&) const
+    vertex_cache_ptr operator()(T const&) const
     {
-        return false;
+        return vertex_cache_ptr();
     }
 
 private:
     vertex_converter_type & converter_;
-    placement_finder_adapter<placement_finder> const & adapter_;
 };
 
 bool text_symbolizer_helper::next_line_placement() const
@@ -399,9 +408,18 @@ bool text_symbolizer_helper::next_line_placement() const
             continue; //Reexecute size check
         }
 
-        if (mapnik::util::apply_visitor(apply_line_placement_visitor(converter_, adapter_), *geo_itr_))
+        // The converted path is the same for every placement alternative,
+        // so it is only built once per geometry.
+        auto pp_itr = line_paths_.find(&*geo_itr_);
+        if (pp_itr == line_paths_.end())
+        {
+            pp_itr = line_paths_.emplace(&*geo_itr_,
+                mapnik::util::apply_visitor(build_line_path_visitor(converter_), *geo_itr_)).first;
+        }
+        if (pp_itr->second && finder_.find_line_placements(*pp_itr->second, adapter_.points_on_line_))
         {
             //Found a placement
+            line_paths_.erase(pp_itr);
             geo_itr_ = geometries_to_process_.erase(geo_itr_);
             return true;
         }
@@ -27,6 +27,7 @@
 #include <mapnik/feature.hpp>
 #include <mapnik/symbolizer.hpp>
 #include <mapnik/text/harfbuzz_shaper.hpp>
+#include <mapnik/text/shaping_cache.hpp>
 #include <mapnik/make_unique.hpp>
 
 #pragma GCC diagnostic push
@@ -36,6 +37,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <map>
 
 namespace mapnik
 {
@@ -434,9 +436,133 @@ void text_layout::clear()
     child_layout_list_.clear();
 }
 
+namespace {
+
+shaping_cache_key make_shaping_key(text_itemizer const& itemizer, text_line const& line, double scale_factor)
+{
+    shaping_cache_key key;
+    key.text = itemizer.text();
+    key.first_char = line.first_char();
+    key.last_char = line.last_char();
+    key.scale_factor = scale_factor;
+    itemizer.for_each_format_run([&key](unsigned start, unsigned end, evaluated_format_properties_ptr const& format)
+    {
+        if (end <= key.first_char || start >= key.last_char) return;
+        shaping_format_run run;
+        run.start = start;
+        run.end = end;
+        run.face_name = format->face_name;
+        if (format->fontset && format->fontset->size() > 0)
+        {
+            run.fontset = format->fontset->get_face_names();
+        }
+        run.text_size = format->text_size;
+        // hb_feature_t is plain data
+        font_feature_settings const& ff = format->ff_settings;
+        run.features.assign(reinterpret_cast<char const*>(ff.get_features()),
+                            ff.count() * sizeof(font_feature_settings::font_feature));
+        key.runs.push_back(std::move(run));
+    });
+    return key;
+}
+
+shaped_line_ptr make_shaped_line(text_line const& line)
+{
+    auto shaped = std::make_shared<shaped_line>();
+    shaped->max_char_height = line.max_char_height();
+    shaped->glyphs.reserve(line.size());
+    std::map<font_face const*, unsigned> faces;
+    for (glyph_info const& g : line)
+    {
+        auto result = faces.emplace(g.face.get(), static_cast<unsigned>(shaped->faces.size()));
+        if (result.second)
+        {
+            // same naming as freetype_engine::register_font
+            shaped->faces.push_back(g.face->family_name() + " " + g.face->style_name());
+        }
+        shaped->glyphs.push_back(shaped_glyph { g.glyph_index, g.char_index, result.first->second,
+                                                g.unscaled_ymin, g.unscaled_ymax,
+                                                g.unscaled_advance, g.unscaled_line_height,
+                                                g.scale_multiplier, g.offset });
+    }
+    return shaped;
+}
+
+// Returns false, leaving the line untouched, if a face is not available to this renderer.
+bool apply_shaped_line(shaped_line const& shaped,
+                       text_line & line,
+                       text_itemizer const& itemizer,
+                       std::map<unsigned,double> & width_map,
+                       face_manager_freetype & font_manager,
+                       double scale_factor)
+{
+    std::vector<face_ptr> faces;
+    faces.reserve(shaped.faces.size());
+    for (std::string const& name : shaped.faces)
+    {
+        face_ptr face = font_manager.get_face(name);
+        if (!face) return false;
+        faces.push_back(face);
+    }
+    struct format_run
+    {
+        unsigned start;
+        unsigned end;
+        evaluated_format_properties_ptr const* format;
+    };
+    std::vector<format_run> runs;
+    itemizer.for_each_format_run([&runs](unsigned start, unsigned end, evaluated_format_properties_ptr const& format)
+    {
+        runs.push_back(format_run { start, end, &format });
+    });
+    if (runs.empty()) return false;
+
+    line.reserve(shaped.glyphs.size());
+    for (shaped_glyph const& sg : shaped.glyphs)
+    {
+        // the key guarantees identical format runs
+        format_run const* run = &runs.front();
+        for (format_run const& r : runs)
+        {
+            if (r.start <= sg.char_index && r.end > sg.char_index)
+            {
+                run = &r;
+                break;
+            }
+        }
+        glyph_info g(sg.glyph_index, sg.char_index, *run->format);
+        g.face = faces[sg.face];
+        g.unscaled_ymin = sg.unscaled_ymin;
+        g.unscaled_ymax = sg.unscaled_ymax;
+        g.unscaled_advance = sg.unscaled_advance;
+        g.unscaled_line_height = sg.unscaled_line_height;
+        g.scale_multiplier = sg.scale_multiplier;
+        g.offset = sg.offset;
+        width_map[sg.char_index] += g.advance();
+        line.add_glyph(std::move(g), scale_factor);
+    }
+    line.update_max_char_height(shaped.max_char_height);
+    return true;
+}
+
+}
+
 void text_layout::shape_text(text_line & line)
 {
+    shaping_cache & cache = shaping_cache::instance();
+    if (!cache.enabled() || line.first_char() == line.last_char())
+    {
+        harfbuzz_shaper::shape_text(line, itemizer_, width_map_, font_manager_, scale_factor_);
+        return;
+    }
+    shaping_cache_key key = make_shaping_key(itemizer_, line, scale_factor_);
+    shaped_line_ptr shaped = cache.find(key);
+    if (shaped && apply_shaped_line(*shaped, line, itemizer_, width_map_, font_manager_, scale_factor_))
+    {
+        return;
+    }
     harfbuzz_shaper::shape_text(line, itemizer_, width_map_, font_manager_, scale_factor_);
+    cache.insert(key, make_shaped_line(line));
 }
 
 void text_layout::init_auto_alignment()
@@ -24,6 +24,7 @@
 #include <mapnik/debug.hpp>
 #include <mapnik/image_reader.hpp>
 #include <mapnik/util/char_array_buffer.hpp>
+#include <mapnik/executor.hpp>
 extern "C"
 {
 #include <tiffio.h>
@@ -41,6 +42,11 @@ extern "C"
 // stl
 #include <memory>
 #include <fstream>
+#include <algorithm>
+#include <vector>
+#ifdef MAPNIK_THREADSAFE
+#include <atomic>
+#endif
 
 namespace mapnik { namespace detail {
 
@@ -154,6 +160,14 @@ private:
     unsigned compression_;
     bool has_alpha_;
     bool is_tiled_;
+    // in-memory copy of the file, if any, for the decode threads
+    char const* data_;
+    std::size_t data_size_;
+    unsigned decode_threads_;
+    // directories of the overviews, the one reducing by 2 << i at i
+    std::vector<std::uint16_t> overviews_;
+    // directory the fields above describe
+    std::uint16_t directory_;
 
 public:
     enum TiffType {
@@ -170,6 +184,11 @@ public:
     inline bool has_alpha() const final { return has_alpha_; }
     void read(unsigned x,unsigned y,image_rgba8& image) final;
     image_any read(unsigned x, unsigned y, unsigned width, unsigned height) final;
+    void set_decode_threads(unsigned count) final { decode_threads_ = count; }
+    unsigned max_reduction() const final { return 1u << overviews_.size(); }
+    bool has_overviews() const final { return !overviews_.empty(); }
+    image_any read_reduced(unsigned x, unsigned y, unsigned width, unsigned height,
+                           unsigned reduction) final;
     // methods specific to tiff reader
     unsigned bits_per_sample() const { return bps_; }
     unsigned sample_format() const { return sample_format_; }
@@ -184,6 +203,8 @@ private:
     tiff_reader(const tiff_reader&);
     tiff_reader& operator=(const tiff_reader&);
     void init();
+    void read_directory(TIFF* tif);
+    void find_overviews(TIFF* tif);
 
     template <typename ImageData>
     void read_generic(std::size_t x,std::size_t y, ImageData & image);
@@ -197,6 +218,9 @@ private:
     template <typename ImageData>
     image_any read_any_gray(std::size_t x, std::size_t y, std::size_t width, std::size_t height);
 
+    template <typename PixelType, typename Decoder>
+    void decode_blocks(TIFF* tif, std::size_t num_blocks, std::size_t buffer_size, Decoder const& decode);
+
     TIFF* open(std::istream & input);
 };
 
@@ -246,17 +270,24 @@ tiff_reader<T>::tiff_reader(std::string const& filename)
     planar_config_(PLANARCONFIG_CONTIG),
     compression_(COMPRESSION_NONE),
     has_alpha_(false),
-    is_tiled_(false)
+    is_tiled_(false),
+    data_(nullptr),
+    data_size_(0),
+    decode_threads_(1),
+    overviews_(),
+    directory_(0)
 {
 
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
      boost::optional<mapnik::mapped_region_ptr> memory =
-         mapnik::mapped_memory_cache::instance().find(filename,true);
+         mapnik::mapped_memory_cache::instance().find(filename, true, mapnik::mapped_access::random);
 
      if (memory)
      {
          mapped_region_ = *memory;
          stream_.buffer(static_cast<char*>(mapped_region_->get_address()),mapped_region_->get_size());
+         data_ = static_cast<char const*>(mapped_region_->get_address());
+         data_size_ = mapped_region_->get_size();
      }
      else
      {
@@ -287,7 +318,12 @@ tiff_reader<T>::tiff_reader(char const* data, std::size_t size)
       planar_config_(PLANARCONFIG_CONTIG),
       compression_(COMPRESSION_NONE),
       has_alpha_(false),
-      is_tiled_(false)
+      is_tiled_(false),
+      data_(data),
+      data_size_(size),
+      decode_threads_(1),
+      overviews_(),
+      directory_(0)
 {
     if (!stream_) throw image_reader_exception("TIFF reader: cannot open image stream ");
     init();
@@ -304,43 +340,7 @@ void tiff_reader<T>::init()
 
     if (!tif) throw image_reader_exception("Can't open tiff file");
 
-    TIFFGetField(tif,TIFFTAG_BITSPERSAMPLE,&bps_);
-    TIFFGetField(tif,TIFFTAG_SAMPLEFORMAT,&sample_format_);
-    TIFFGetField(tif,TIFFTAG_PHOTOMETRIC,&photometric_);
-    TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &bands_);
-
-    MAPNIK_LOG_DEBUG(tiff_reader) << "bits per sample: " << bps_ ;
-    MAPNIK_LOG_DEBUG(tiff_reader) << "sample format: " << sample_format_ ;
-    MAPNIK_LOG_DEBUG(tiff_reader) << "photometric: " << photometric_ ;
-    MAPNIK_LOG_DEBUG(tiff_reader) << "bands: " << bands_ ;
-
-    TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width_);
-    TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height_);
-
-    TIFFGetField(tif, TIFFTAG_PLANARCONFIG, &planar_config_);
-    TIFFGetField(tif, TIFFTAG_COMPRESSION, &compression_ );
-
-    std::uint16_t orientation;
-    if (TIFFGetField(tif, TIFFTAG_ORIENTATION, &orientation) == 0)
-    {
-        orientation = 1;
-    }
-    MAPNIK_LOG_DEBUG(tiff_reader) << "orientation: " << orientation ;
-    MAPNIK_LOG_DEBUG(tiff_reader) << "planar-config: " << planar_config_ ;
-    is_tiled_ = TIFFIsTiled(tif);
-
-    if (is_tiled_)
-    {
-        TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tile_width_);
-        TIFFGetField(tif, TIFFTAG_TILELENGTH, &tile_height_);
-        MAPNIK_LOG_DEBUG(tiff_reader) << "tiff is tiled";
-        read_method_ = tiled;
-    }
-    else if (TIFFGetField(tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip_) != 0)
-    {
-        MAPNIK_LOG_DEBUG(tiff_reader) << "tiff is stripped";
-        read_method_ = stripped;
-    }
+    read_directory(tif);
     //TIFFTAG_EXTRASAMPLES
     uint16 extrasamples = 0;
     uint16* sampleinfo = nullptr;
@@ -392,6 +392,88 @@ void tiff_reader<T>::init()
             }
         }
     }
+    find_overviews(tif);
+}
+
+template <typename T>
+void tiff_reader<T>::read_directory(TIFF* tif)
+{
+    read_method_ = generic;
+    rows_per_strip_ = 0;
+    tile_width_ = 0;
+    tile_height_ = 0;
+    sample_format_ = SAMPLEFORMAT_UINT;
+    bands_ = 1;
+    planar_config_ = PLANARCONFIG_CONTIG;
+    compression_ = COMPRESSION_NONE;
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+
+    TIFFGetField(tif,TIFFTAG_BITSPERSAMPLE,&bps_);
+    TIFFGetField(tif,TIFFTAG_SAMPLEFORMAT,&sample_format_);
+    TIFFGetField(tif,TIFFTAG_PHOTOMETRIC,&photometric_);
+    TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &bands_);
+
+    MAPNIK_LOG_DEBUG(tiff_reader) << "bits per sample: " << bps_ ;
+    MAPNIK_LOG_DEBUG(tiff_reader) << "sample format: " << sample_format_ ;
+    MAPNIK_LOG_DEBUG(tiff_reader) << "photometric: " << photometric_ ;
+    MAPNIK_LOG_DEBUG(tiff_reader) << "bands: " << bands_ ;
+
+    TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
+    TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
+    width_ = width;
+    height_ = height;
+
+    TIFFGetField(tif, TIFFTAG_PLANARCONFIG, &planar_config_);
+    TIFFGetField(tif, TIFFTAG_COMPRESSION, &compression_ );
+
+    std::uint16_t orientation;
+    if (TIFFGetField(tif, TIFFTAG_ORIENTATION, &orientation) == 0)
+    {
+        orientation = 1;
+    }
+    MAPNIK_LOG_DEBUG(tiff_reader) << "orientation: " << orientation ;
+    MAPNIK_LOG_DEBUG(tiff_reader) << "planar-config: " << planar_config_ ;
+    is_tiled_ = TIFFIsTiled(tif);
+
+    if (is_tiled_)
+    {
+        TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tile_width_);
+        TIFFGetField(tif, TIFFTAG_TILELENGTH, &tile_height_);
+        MAPNIK_LOG_DEBUG(tiff_reader) << "tiff is tiled";
+        read_method_ = tiled;
+    }
+    else if (TIFFGetField(tif, TIFFTAG_ROWSPERSTRIP, &rows_per_strip_) != 0)
+    {
+        MAPNIK_LOG_DEBUG(tiff_reader) << "tiff is stripped";
+        read_method_ = stripped;
+    }
+}
+
+// Reduced resolution images following the full one, as in a cloud
+// optimized GeoTIFF, each half the size of the one before.
+template <typename T>
+void tiff_reader<T>::find_overviews(TIFF* tif)
+{
+    std::uint16_t directory = 0;
+    while (TIFFReadDirectory(tif))
+    {
+        ++directory;
+        std::uint32_t subfile_type = 0;
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        TIFFGetField(tif, TIFFTAG_SUBFILETYPE, &subfile_type);
+        TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
+        if (!(subfile_type & FILETYPE_REDUCEDIMAGE) || (subfile_type & FILETYPE_MASK)) continue;
+        std::size_t reduction = 2 << overviews_.size();
+        if (width == (width_ + reduction - 1) / reduction && height == (height_ + reduction - 1) / reduction)
+        {
+            overviews_.push_back(directory);
+        }
+    }
+    TIFFSetDirectory(tif, 0);
+    MAPNIK_LOG_DEBUG(tiff_reader) << "overviews: " << overviews_.size();
 }
 
 template <typename T>
@@ -692,6 +774,43 @@ image_any tiff_reader<T>::read(unsigned x, unsigned y, unsigned width, unsigned
     return image_any();
 }
 
+template <typename T>
+image_any tiff_reader<T>::read_reduced(unsigned x, unsigned y, unsigned width, unsigned height,
+                                       unsigned reduction)
+{
+    if (reduction == 1) return read(x, y, width, height);
+    std::size_t index = 0;
+    while (index < overviews_.size() && (2u << index) < reduction) ++index;
+    if (index >= overviews_.size() || (2u << index) != reduction)
+    {
+        throw image_reader_exception("TIFF reader: no overview for reduction " + std::to_string(reduction));
+    }
+    // the overview is read as the image while its directory is current
+    TIFF* tif = open(stream_);
+    if (!TIFFSetDirectory(tif, overviews_[index]))
+    {
+        throw image_reader_exception("TIFF reader: cannot read overview");
+    }
+    directory_ = overviews_[index];
+    auto restore = [&] {
+        TIFFSetDirectory(tif, 0);
+        directory_ = 0;
+        read_directory(tif);
+    };
+    try
+    {
+        read_directory(tif);
+        image_any data = read(x, y, width, height);
+        restore();
+        return data;
+    }
+    catch (...)
+    {
+        restore();
+        throw;
+    }
+}
+
 template <typename T>
 template <typename ImageData>
 void tiff_reader<T>::read_generic(std::size_t, std::size_t, ImageData &)
@@ -699,6 +818,73 @@ void tiff_reader<T>::read_generic(std::size_t, std::size_t, ImageData &)
     throw image_reader_exception("tiff_reader: TODO - tiff is not stripped or tiled");
 }
 
+template <typename T>
+template <typename PixelType, typename Decoder>
+void tiff_reader<T>::decode_blocks(TIFF* tif, std::size_t num_blocks, std::size_t buffer_size, Decoder const& decode)
+{
+#ifdef MAPNIK_THREADSAFE
+    // Every thread decodes through its own TIFF handle over the in-memory file,
+    // blocks cover disjoint parts of the image so they are written without locking.
+    // no more handles than the executor has threads to use them
+    std::size_t num_threads = std::min({static_cast<std::size_t>(decode_threads_), num_blocks,
+                                        get_executor()->concurrency() + 1});
+    if (num_threads > 1 && data_ != nullptr)
+    {
+        struct decode_handle
+        {
+            decode_handle(char const* data, std::size_t size)
+                : buffer(data, size),
+                  stream(&buffer) {}
+            util::char_array_buffer buffer;
+            std::istream stream;
+            tiff_ptr tif;
+        };
+        std::vector<std::unique_ptr<decode_handle>> handles;
+        handles.reserve(num_threads - 1);
+        for (std::size_t i = 1; i < num_threads; ++i)
+        {
+            std::unique_ptr<decode_handle> handle(new decode_handle(data_, data_size_));
+            handle->tif = tiff_ptr(TIFFClientOpen("tiff_input_stream", "rcm",
+                                                  reinterpret_cast<thandle_t>(&handle->stream),
+                                                  detail::tiff_read_proc,
+                                                  detail::tiff_write_proc,
+                                                  detail::tiff_seek_proc,
+                                                  detail::tiff_close_proc,
+                                                  detail::tiff_size_proc,
+                                                  detail::tiff_map_proc,
+                                                  detail::tiff_unmap_proc), tiff_closer());
+            if (!handle->tif) break;
+            // on the overview being read
+            if (directory_ != 0 && !TIFFSetDirectory(handle->tif.get(), directory_)) break;
+            handles.push_back(std::move(handle));
+        }
+        if (!handles.empty())
+        {
+            std::atomic<std::size_t> next_block(0);
+            std::atomic<bool> failed(false);
+            auto worker = [&](TIFF* handle) {
+                std::unique_ptr<PixelType[]> buffer(new PixelType[buffer_size]);
+                std::size_t block;
+                while (!failed && (block = next_block++) < num_blocks)
+                {
+                    if (!decode(handle, block, buffer.get())) failed = true;
+                }
+            };
+            // a worker per handle, the calling thread takes the file's own
+            parallel_for(handles.size() + 1, handles.size() + 1, [&](std::size_t i) {
+                worker(i == 0 ? tif : handles[i - 1]->tif.get());
+            });
+            return;
+        }
+    }
+#endif
+    std::unique_ptr<PixelType[]> buffer(new PixelType[buffer_size]);
+    for (std::size_t block = 0; block < num_blocks; ++block)
+    {
+        if (!decode(tif, block, buffer.get())) break;
+    }
+}
+
 template <typename T>
 template <typename ImageData>
 void tiff_reader<T>::read_tiled(std::size_t x0,std::size_t y0, ImageData & image)
@@ -709,7 +895,6 @@ void tiff_reader<T>::read_tiled(std::size_t x0,std::size_t y0, ImageData & image
     if (tif)
     {
         std::uint32_t tile_size = TIFFTileSize(tif);
-        std::unique_ptr<pixel_type[]> tile(new pixel_type[tile_size]);
         std::size_t width = image.width();
         std::size_t height = image.height();
         std::size_t start_y = (y0 / tile_height_) * tile_height_;
@@ -718,48 +903,50 @@ void tiff_reader<T>::read_tiled(std::size_t x0,std::size_t y0, ImageData & image
         std::size_t end_x = ((x0 + width) / tile_width_ + 1) * tile_width_;
         end_y = std::min(end_y, height_);
         end_x = std::min(end_x, width_);
+        if (start_x >= end_x || start_y >= end_y) return;
+        std::size_t tiles_x = (end_x - start_x + tile_width_ - 1) / tile_width_;
+        std::size_t tiles_y = (end_y - start_y + tile_height_ - 1) / tile_height_;
         bool pick_first_band = (bands_ > 1) && (tile_size / (tile_width_ * tile_height_ * sizeof(pixel_type)) == bands_);
-        for (std::size_t y = start_y; y < end_y; y += tile_height_)
-        {
-            std::size_t ty0 = std::max(y0, y) - y;
-            std::size_t ty1 = std::min(height + y0, y + tile_height_) - y;
-
-            for (std::size_t x = start_x; x < end_x; x += tile_width_)
+        auto decode = [&](TIFF* handle, std::size_t index, pixel_type* tile) {
+            std::size_t x = start_x + (index % tiles_x) * tile_width_;
+            std::size_t y = start_y + (index / tiles_x) * tile_height_;
+            if (!detail::tiff_reader_traits<ImageData>::read_tile(handle, x, y, tile, tile_width_, tile_height_))
             {
-                if (!detail::tiff_reader_traits<ImageData>::read_tile(tif, x, y, tile.get(), tile_width_, tile_height_))
-                {
-                    MAPNIK_LOG_DEBUG(tiff_reader) <<  "read_tile(...) failed at " << x << "/" << y << " for " << width_ << "/" << height_ << "\n";
-                    break;
-                }
-                if (pick_first_band)
+                MAPNIK_LOG_DEBUG(tiff_reader) <<  "read_tile(...) failed at " << x << "/" << y << " for " << width_ << "/" << height_ << "\n";
+                return false;
+            }
+            if (pick_first_band)
+            {
+                std::uint32_t size = tile_width_ * tile_height_ * sizeof(pixel_type);
+                for (std::uint32_t n = 0; n < size; ++n)
                 {
-                    std::uint32_t size = tile_width_ * tile_height_ * sizeof(pixel_type);
-                    for (std::uint32_t n = 0; n < size; ++n)
-                    {
-                        tile[n] = tile[n * bands_];
-                    }
+                    tile[n] = tile[n * bands_];
                 }
-                std::size_t tx0 = std::max(x0, x);
-                std::size_t tx1 = std::min(width + x0, x + tile_width_);
-                std::size_t row_index = y + ty0 - y0;
+            }
+            std::size_t ty0 = std::max(y0, y) - y;
+            std::size_t ty1 = std::min(height + y0, y + tile_height_) - y;
+            std::size_t tx0 = std::max(x0, x);
+            std::size_t tx1 = std::min(width + x0, x + tile_width_);
+            std::size_t row_index = y + ty0 - y0;
 
-                if (detail::tiff_reader_traits<ImageData>::reverse)
+            if (detail::tiff_reader_traits<ImageData>::reverse)
+            {
+                for (std::size_t ty = ty0; ty < ty1; ++ty, ++row_index)
                 {
-                    for (std::size_t ty = ty0; ty < ty1; ++ty, ++row_index)
-                    {
-                        // This is in reverse because the TIFFReadRGBATile reads are inverted
-                        image.set_row(row_index, tx0 - x0, tx1 - x0, &tile[(tile_height_ - ty - 1) * tile_width_ + tx0 - x]);
-                    }
+                    // This is in reverse because the TIFFReadRGBATile reads are inverted
+                    image.set_row(row_index, tx0 - x0, tx1 - x0, &tile[(tile_height_ - ty - 1) * tile_width_ + tx0 - x]);
                 }
-                else
+            }
+            else
+            {
+                for (std::size_t ty = ty0; ty < ty1; ++ty, ++row_index)
                 {
-                    for (std::size_t ty = ty0; ty < ty1; ++ty, ++row_index)
-                    {
-                        image.set_row(row_index, tx0 - x0, tx1 - x0, &tile[ty * tile_width_ + tx0 - x]);
-                    }
+                    image.set_row(row_index, tx0 - x0, tx1 - x0, &tile[ty * tile_width_ + tx0 - x]);
                 }
             }
-        }
+            return true;
+        };
+        decode_blocks<pixel_type>(tif, tiles_x * tiles_y, tile_size, decode);
     }
 }
 
@@ -772,26 +959,22 @@ void tiff_reader<T>::read_stripped(std::size_t x0, std::size_t y0, ImageData & i
     if (tif)
     {
         std::uint32_t strip_size = TIFFStripSize(tif);
-        std::unique_ptr<pixel_type[]> strip(new pixel_type[strip_size]);
         std::size_t width = image.width();
         std::size_t height = image.height();
 
         std::size_t start_y = (y0 / rows_per_strip_) * rows_per_strip_;
         std::size_t end_y = std::min(y0 + height, height_);
-        std::size_t tx0, tx1, ty0, ty1;
-        tx0 = x0;
-        tx1 = std::min(width + x0, width_);
-        std::size_t row = 0;
+        if (start_y >= end_y) return;
+        std::size_t num_strips = (end_y - start_y + rows_per_strip_ - 1) / rows_per_strip_;
+        std::size_t tx0 = x0;
+        std::size_t tx1 = std::min(width + x0, width_);
         bool pick_first_band = (bands_ > 1) && (strip_size / (width_ * rows_per_strip_ * sizeof(pixel_type)) == bands_);
-        for (std::size_t y = start_y; y < end_y; y += rows_per_strip_)
-        {
-            ty0 = std::max(y0, y) - y;
-            ty1 = std::min(end_y, y + rows_per_strip_) - y;
-
-            if (!detail::tiff_reader_traits<ImageData>::read_strip(tif, y, rows_per_strip_, width_, strip.get()))
+        auto decode = [&](TIFF* handle, std::size_t index, pixel_type* strip) {
+            std::size_t y = start_y + index * rows_per_strip_;
+            if (!detail::tiff_reader_traits<ImageData>::read_strip(handle, y, rows_per_strip_, width_, strip))
             {
                 MAPNIK_LOG_DEBUG(tiff_reader) << "TIFFRead(Encoded|RGBA)Strip failed at " << y << " for " << width_ << "/" << height_ << "\n";
-                break;
+                return false;
             }
             if (pick_first_band)
             {
@@ -801,6 +984,9 @@ void tiff_reader<T>::read_stripped(std::size_t x0, std::size_t y0, ImageData & i
                     strip[n] = strip[bands_ * n];
                 }
             }
+            std::size_t ty0 = std::max(y0, y) - y;
+            std::size_t ty1 = std::min(end_y, y + rows_per_strip_) - y;
+            std::size_t row = y + ty0 - y0;
 
             if (detail::tiff_reader_traits<ImageData>::reverse)
             {
@@ -818,7 +1004,9 @@ void tiff_reader<T>::read_stripped(std::size_t x0, std::size_t y0, ImageData & i
                     image.set_row(row++, tx0 - x0, tx1 - x0, &strip[ty * width_ + tx0]);
                 }
             }
-        }
+            return true;
+        };
+        decode_blocks<pixel_type>(tif, num_strips, strip_size, decode);
     }
 }
 
@@ -0,0 +1,201 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/trace.hpp>
+
+// stl
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace mapnik { namespace trace {
+
+std::atomic<bool> enabled_flag(false);
+
+namespace {
+
+constexpr std::size_t detail_capacity = 48;
+
+struct event
+{
+    char const* category;
+    char const* name;
+    clock::time_point start;
+    clock::time_point end;
+    char detail[detail_capacity];
+};
+
+struct ring_buffer
+{
+    ring_buffer(std::size_t size, std::size_t thread_id)
+        : events(std::max<std::size_t>(size, 1)),
+          head(0),
+          tid(thread_id) {}
+
+    std::vector<event> events;
+    // number of events recorded, the slot of the next one is head % size
+    std::atomic<std::size_t> head;
+    std::size_t tid;
+};
+
+struct registry
+{
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ring_buffer>> buffers;
+    std::size_t buffer_size = 65536;
+};
+
+registry & get_registry()
+{
+    // never destroyed, threads may record while the process exits
+    static registry * instance = new registry();
+    return *instance;
+}
+
+ring_buffer & thread_buffer()
+{
+    // owned by the registry so that events outlive their thread
+    thread_local ring_buffer * buffer = nullptr;
+    if (!buffer)
+    {
+        registry & reg = get_registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.buffers.push_back(std::make_shared<ring_buffer>(reg.buffer_size, reg.buffers.size() + 1));
+        buffer = reg.buffers.back().get();
+    }
+    return *buffer;
+}
+
+void write_string(std::ostream & out, char const* str)
+{
+    out << '"';
+    for (; *str; ++str)
+    {
+        char c = *str;
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if (static_cast<unsigned char>(c) >= 0x20) out << c;
+    }
+    out << '"';
+}
+
+}
+
+void set_enabled(bool enabled)
+{
+    enabled_flag.store(enabled, std::memory_order_relaxed);
+}
+
+void set_buffer_size(std::size_t events)
+{
+    registry & reg = get_registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.buffer_size = events;
+}
+
+std::size_t buffer_size()
+{
+    registry & reg = get_registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    return reg.buffer_size;
+}
+
+void record(char const* category, char const* name, char const* detail,
+            std::size_t detail_size, clock::time_point start, clock::time_point end)
+{
+    ring_buffer & buffer = thread_buffer();
+    std::size_t head = buffer.head.load(std::memory_order_relaxed);
+    event & e = buffer.events[head % buffer.events.size()];
+    e.category = category;
+    e.name = name;
+    e.start = start;
+    e.end = end;
+    std::size_t size = detail ? std::min(detail_size, detail_capacity - 1) : 0;
+    if (size > 0) std::memcpy(e.detail, detail, size);
+    e.detail[size] = '\0';
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void write_chrome_json(std::ostream & out)
+{
+    std::vector<std::shared_ptr<ring_buffer>> buffers;
+    {
+        registry & reg = get_registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffers = reg.buffers;
+    }
+    clock::time_point origin = clock::time_point::max();
+    for (auto const& buffer : buffers)
+    {
+        std::size_t head = buffer->head.load(std::memory_order_acquire);
+        std::size_t count = std::min(head, buffer->events.size());
+        for (std::size_t i = head - count; i < head; ++i)
+        {
+            origin = std::min(origin, buffer->events[i % buffer->events.size()].start);
+        }
+    }
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (auto const& buffer : buffers)
+    {
+        std::size_t head = buffer->head.load(std::memory_order_acquire);
+        std::size_t count = std::min(head, buffer->events.size());
+        for (std::size_t i = head - count; i < head; ++i)
+        {
+            event const& e = buffer->events[i % buffer->events.size()];
+            using us = std::chrono::duration<double, std::micro>;
+            if (!first) out << ',';
+            first = false;
+            out << "\n{\"name\":";
+            write_string(out, e.name);
+            out << ",\"cat\":";
+            write_string(out, e.category);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << us(e.start - origin).count()
+                << ",\"dur\":" << us(e.end - e.start).count();
+            if (e.detail[0])
+            {
+                out << ",\"args\":{\"detail\":";
+                write_string(out, e.detail);
+                out << '}';
+            }
+            out << '}';
+        }
+    }
+    out << "\n]}\n";
+}
+
+void clear()
+{
+    registry & reg = get_registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (auto const& buffer : reg.buffers)
+    {
+        buffer->head.store(0, std::memory_order_relaxed);
+    }
+}
+
+}}
@@ -27,6 +27,7 @@
 #include <mapnik/geom_util.hpp>
 #include <mapnik/util/noncopyable.hpp>
 #include <mapnik/geometry/correct.hpp>
+#include <algorithm>
 #include <cmath>
 
 namespace mapnik { namespace detail {
@@ -98,9 +99,13 @@ public:
         if (is_empty_)
             return geom;
 
-        // Read the [optional] size information
+        // Read the [optional] size information, the byte count of the rest
+        // of the geometry
         if (has_size_)
-            size_ = read_unsigned_integer();
+        {
+            std::size_t geometry_size = read_unsigned_integer();
+            size_ = std::min(size_, pos_ + geometry_size);
+        }
 
         // Read the [optional] bounding box information
         if (has_bbox_) read_bbox();
@@ -259,14 +264,31 @@ private:
         }
     }
 
+    std::size_t remaining() const
+    {
+        return pos_ < size_ ? size_ - pos_ : 0;
+    }
+
+    // the most points the rest of the twkb can hold, a varint per
+    // coordinate taking at least a byte
+    std::size_t max_points(std::uint64_t count) const
+    {
+        std::size_t dims = 2 + (has_z_ ? 1 : 0) + (has_m_ ? 1 : 0);
+        return static_cast<std::size_t>(std::min<std::uint64_t>(count, remaining() / dims));
+    }
+
+    // the rings are sized from the point count up front and filled in place
     template <typename Ring>
-    void read_coords(Ring & ring, std::size_t num_points)
+    void read_coords(Ring & ring, std::uint64_t count)
     {
-        for (std::size_t i = 0; i < num_points; ++i)
+        std::size_t num_points = max_points(count);
+        ring.resize(num_points);
+        for (auto & pt : ring)
         {
             coord_x_ += read_signed_integer();
             coord_y_ += read_signed_integer();
-            ring.emplace_back( coord_x_ / factor_xy_, coord_y_ / factor_xy_);
+            pt.x = coord_x_ / factor_xy_;
+            pt.y = coord_y_ / factor_xy_;
             // Skip Z and M
             if (has_z_) coord_z_ += read_signed_integer();
             if (has_m_) coord_m_ += read_signed_integer();
@@ -290,10 +312,10 @@ private:
 
         if (num_points > 0)
         {
-            multi_point.reserve(num_points);
-            for (unsigned int i = 0; i < num_points; ++i)
+            multi_point.resize(max_points(num_points));
+            for (auto & pt : multi_point)
             {
-                multi_point.emplace_back(read_point());
+                pt = read_point();
             }
         }
         return multi_point;
@@ -305,7 +327,6 @@ private:
         unsigned int num_points = read_unsigned_integer();
         if (num_points > 0)
         {
-            line.reserve(num_points);
             read_coords<mapnik::geometry::line_string<double>>(line, num_points);
         }
         return line;
@@ -316,7 +337,7 @@ private:
         mapnik::geometry::multi_line_string<double> multi_line;
         unsigned int num_lines = read_unsigned_integer();
         if (has_idlist_) read_idlist(num_lines);
-        multi_line.reserve(num_lines);
+        multi_line.reserve(std::min<std::size_t>(num_lines, remaining()));
         for (unsigned int i = 0; i < num_lines; ++i)
         {
             multi_line.push_back(read_linestring());
@@ -328,14 +349,13 @@ private:
     {
         unsigned int num_rings = read_unsigned_integer();
         mapnik::geometry::polygon<double> poly;
-        poly.reserve(num_rings);
+        poly.reserve(std::min<std::size_t>(num_rings, remaining()));
         for (unsigned int i = 0; i < num_rings; ++i)
         {
             mapnik::geometry::linear_ring<double> ring;
             unsigned int num_points = read_unsigned_integer();
             if (num_points > 0)
             {
-                ring.reserve(num_points);
                 read_coords<mapnik::geometry::linear_ring<double>>(ring, num_points);
             }
             poly.push_back(std::move(ring));
@@ -348,6 +368,7 @@ private:
         mapnik::geometry::multi_polygon<double> multi_poly;
         unsigned int num_polys = read_unsigned_integer();
         if (has_idlist_) read_idlist(num_polys);
+        multi_poly.reserve(std::min<std::size_t>(num_polys, remaining()));
         for (unsigned int i = 0; i < num_polys; ++i)
         {
             multi_poly.push_back(read_polygon());
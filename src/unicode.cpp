@@ -26,6 +26,9 @@
 
 // std
 #include <stdexcept>
+#include <cstring>
+#include <functional>
+#include <vector>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
@@ -34,8 +37,47 @@
 
 namespace mapnik {
 
+namespace {
+
+struct interned_string
+{
+    std::size_t encoding_id = 0;
+    std::string bytes;
+    mapnik::value_unicode_string value;
+};
+
+// direct mapped, a new string replaces the one in its slot
+constexpr std::size_t intern_slots = 1024;
+
+std::vector<interned_string> & intern_table()
+{
+#ifdef MAPNIK_THREADSAFE
+    static thread_local std::vector<interned_string> table(intern_slots);
+#else
+    static std::vector<interned_string> table(intern_slots);
+#endif
+    return table;
+}
+
+inline std::size_t intern_hash(const char* data, std::int32_t length, std::size_t seed)
+{
+    // FNV-1a
+    std::uint64_t hash = 14695981039346656037ULL ^ seed;
+    for (std::int32_t i = 0; i < length; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return static_cast<std::size_t>(hash);
+}
+
+}
+
+constexpr std::int32_t transcoder::max_interned_length;
+
 transcoder::transcoder (std::string const& encoding)
-    : conv_(0)
+    : conv_(0),
+      encoding_id_(0)
 {
     UErrorCode err = U_ZERO_ERROR;
     conv_ = ucnv_open(encoding.c_str(),&err);
@@ -44,9 +86,35 @@ transcoder::transcoder (std::string const& encoding)
         // NOTE: conv_ should be null on error so no need to call ucnv_close
         throw std::runtime_error(std::string("could not create converter for ") + encoding);
     }
+    // aliases ("utf8", "UTF-8") map to the same canonical name
+    encoding_id_ = std::hash<std::string>()(ucnv_getName(conv_, &err)) | 1;
 }
 
 mapnik::value_unicode_string transcoder::transcode(const char* data, std::int32_t length) const
+{
+    if (length < 0)
+    {
+        length = static_cast<std::int32_t>(std::strlen(data));
+    }
+    if (length > max_interned_length)
+    {
+        return convert(data, length);
+    }
+    std::vector<interned_string> & table = intern_table();
+    interned_string & slot = table[intern_hash(data, length, encoding_id_) & (intern_slots - 1)];
+    if (slot.encoding_id == encoding_id_ &&
+        slot.bytes.size() == static_cast<std::size_t>(length) &&
+        std::memcmp(slot.bytes.data(), data, static_cast<std::size_t>(length)) == 0)
+    {
+        return slot.value;
+    }
+    slot.value = convert(data, length);
+    slot.bytes.assign(data, static_cast<std::size_t>(length));
+    slot.encoding_id = encoding_id_;
+    return slot.value;
+}
+
+mapnik::value_unicode_string transcoder::convert(const char* data, std::int32_t length) const
 {
     UErrorCode err = U_ZERO_ERROR;
 
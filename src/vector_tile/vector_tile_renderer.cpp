@@ -0,0 +1,509 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/vector_tile/vector_tile_renderer.hpp>
+#include <mapnik/vector_tile/pbf_writer.hpp>
+#include <mapnik/debug.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/label_collision_detector.hpp>
+#include <mapnik/vertex.hpp>
+#include <mapnik/vertex_converters.hpp>
+#include <mapnik/vertex_processor.hpp>
+#include <mapnik/renderer_common/apply_vertex_converter.hpp>
+#include <mapnik/geometry/geometry_type.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_trans_affine.h"
+#pragma GCC diagnostic pop
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace mapnik
+{
+
+namespace {
+
+// fields and enums of vector_tile.proto, version 2
+enum tile_field : std::uint32_t { tile_layers = 3 };
+enum layer_field : std::uint32_t
+{
+    layer_name = 1,
+    layer_features = 2,
+    layer_keys = 3,
+    layer_values = 4,
+    layer_extent = 5,
+    layer_version = 15
+};
+enum feature_field : std::uint32_t
+{
+    feature_id = 1,
+    feature_tags = 2,
+    feature_type = 3,
+    feature_geometry = 4
+};
+enum value_field : std::uint32_t
+{
+    value_string = 1,
+    value_double_field = 3,
+    value_uint = 5,
+    value_sint = 6,
+    value_bool_field = 7
+};
+enum geom_type : std::uint32_t
+{
+    geom_unknown = 0,
+    geom_point = 1,
+    geom_linestring = 2,
+    geom_polygon = 3
+};
+enum command : std::uint32_t
+{
+    move_to = 1,
+    line_to = 2,
+    close_path = 7
+};
+
+inline std::uint32_t command_integer(command id, std::size_t count)
+{
+    return (id & 0x7) | (static_cast<std::uint32_t>(count) << 3);
+}
+
+// Collects the paths coming out of the vertex converters, quantized to
+// the tile grid with repeated points dropped.
+struct path_collector
+{
+    using coord_type = std::pair<std::int32_t, std::int32_t>;
+    using path_type = std::vector<coord_type>;
+
+    template <typename Path>
+    void add_path(Path & path)
+    {
+        // polygons come one per call, their exterior ring first
+        starts.push_back(paths.size());
+        path.rewind(0);
+        double x, y;
+        unsigned cmd;
+        while ((cmd = path.vertex(&x, &y)) != SEG_END)
+        {
+            if (cmd == SEG_MOVETO) paths.emplace_back();
+            else if (cmd != SEG_LINETO || paths.empty()) continue;
+            coord_type c(static_cast<std::int32_t>(std::lround(x)),
+                         static_cast<std::int32_t>(std::lround(y)));
+            if (paths.back().empty() || paths.back().back() != c)
+            {
+                paths.back().push_back(c);
+            }
+        }
+    }
+
+    std::vector<path_type> paths;
+    std::vector<std::size_t> starts;
+};
+
+// MVT commands of a feature geometry, the cursor moving across all of them
+struct geometry_encoder
+{
+    void move(path_collector::coord_type const& c)
+    {
+        geometry.push_back(pbf_writer_type::zigzag(c.first - x));
+        geometry.push_back(pbf_writer_type::zigzag(c.second - y));
+        x = c.first;
+        y = c.second;
+    }
+
+    template <typename Iterator>
+    void add_path(Iterator begin, Iterator end, bool closed)
+    {
+        geometry.push_back(command_integer(move_to, 1));
+        move(*begin);
+        geometry.push_back(command_integer(line_to, std::distance(begin, end) - 1));
+        for (++begin; begin != end; ++begin) move(*begin);
+        if (closed) geometry.push_back(command_integer(close_path, 1));
+    }
+
+    using pbf_writer_type = vector_tile::pbf_writer;
+    std::vector<std::uint32_t> geometry;
+    std::int32_t x = 0;
+    std::int32_t y = 0;
+};
+
+void encode_points(path_collector const& collector, box2d<double> const& bounds, geometry_encoder & encoder)
+{
+    std::vector<path_collector::coord_type> points;
+    for (auto const& path : collector.paths)
+    {
+        if (path.empty()) continue;
+        if (bounds.contains(path.front().first, path.front().second)) points.push_back(path.front());
+    }
+    if (points.empty()) return;
+    encoder.geometry.push_back(command_integer(move_to, points.size()));
+    for (auto const& pt : points) encoder.move(pt);
+}
+
+void encode_lines(path_collector const& collector, geometry_encoder & encoder)
+{
+    for (auto const& path : collector.paths)
+    {
+        if (path.size() >= 2) encoder.add_path(path.begin(), path.end(), false);
+    }
+}
+
+// twice the area of a ring in tile coordinates, positive when it winds
+// clockwise with y pointing down
+std::int64_t ring_area(path_collector::path_type const& ring)
+{
+    std::int64_t area = 0;
+    for (std::size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+    {
+        area += static_cast<std::int64_t>(ring[j].first) * ring[i].second -
+                static_cast<std::int64_t>(ring[i].first) * ring[j].second;
+    }
+    return area;
+}
+
+void encode_polygons(path_collector & collector, geometry_encoder & encoder)
+{
+    for (std::size_t k = 0; k < collector.starts.size(); ++k)
+    {
+        std::size_t first = collector.starts[k];
+        std::size_t last = k + 1 < collector.starts.size() ? collector.starts[k + 1] : collector.paths.size();
+        for (std::size_t i = first; i < last; ++i)
+        {
+            auto & ring = collector.paths[i];
+            if (ring.size() > 1 && ring.front() == ring.back()) ring.pop_back();
+            std::int64_t area = ring.size() >= 3 ? ring_area(ring) : 0;
+            if (area == 0)
+            {
+                // holes of a polygon whose exterior collapsed go with it
+                if (i == first) break;
+                continue;
+            }
+            // exterior rings have a positive area, interior rings a negative one
+            if ((i == first) != (area > 0)) std::reverse(ring.begin(), ring.end());
+            encoder.add_path(ring.begin(), ring.end(), true);
+        }
+    }
+}
+
+std::string encode_value(value const& val)
+{
+    std::string data;
+    vector_tile::pbf_writer writer(data);
+    if (val.is<value_bool>())
+    {
+        writer.add_bool(value_bool_field, val.get<value_bool>());
+    }
+    else if (val.is<value_integer>())
+    {
+        value_integer i = val.get<value_integer>();
+        if (i >= 0) writer.add_uint(value_uint, static_cast<std::uint64_t>(i));
+        else writer.add_sint(value_sint, i);
+    }
+    else if (val.is<value_double>())
+    {
+        writer.add_double(value_double_field, val.get<value_double>());
+    }
+    else
+    {
+        writer.add_bytes(value_string, val.to_string());
+    }
+    return data;
+}
+
+}
+
+struct vector_tile_renderer::layer_builder
+{
+    explicit layer_builder(std::string const& _name)
+        : name(_name) {}
+
+    std::uint32_t key(std::string const& k)
+    {
+        auto itr = key_index.find(k);
+        if (itr != key_index.end()) return itr->second;
+        std::uint32_t index = static_cast<std::uint32_t>(keys.size());
+        keys.push_back(k);
+        key_index.emplace(k, index);
+        return index;
+    }
+
+    std::uint32_t value(mapnik::value const& val)
+    {
+        std::string encoded = encode_value(val);
+        auto itr = value_index.find(encoded);
+        if (itr != value_index.end()) return itr->second;
+        std::uint32_t index = static_cast<std::uint32_t>(values.size());
+        values.push_back(encoded);
+        value_index.emplace(std::move(encoded), index);
+        return index;
+    }
+
+    void add(feature_impl const& feature, geom_type type, std::vector<std::uint32_t> const& geometry)
+    {
+        std::vector<std::uint32_t> tags;
+        for (auto const& kv : feature)
+        {
+            mapnik::value const& val = std::get<1>(kv);
+            if (val.is_null()) continue;
+            tags.push_back(key(std::get<0>(kv)));
+            tags.push_back(value(val));
+        }
+        std::string data;
+        vector_tile::pbf_writer writer(data);
+        if (feature.id() >= 0) writer.add_uint(feature_id, static_cast<std::uint64_t>(feature.id()));
+        if (!tags.empty()) writer.add_packed_uint(feature_tags, tags);
+        writer.add_uint(feature_type, type);
+        writer.add_packed_uint(feature_geometry, geometry);
+        features.push_back(std::move(data));
+    }
+
+    void write(std::string & output, unsigned extent) const
+    {
+        std::string data;
+        vector_tile::pbf_writer writer(data);
+        writer.add_uint(layer_version, 2);
+        writer.add_bytes(layer_name, name);
+        for (auto const& f : features) writer.add_bytes(layer_features, f);
+        for (auto const& k : keys) writer.add_bytes(layer_keys, k);
+        for (auto const& v : values) writer.add_bytes(layer_values, v);
+        writer.add_uint(layer_extent, extent);
+        vector_tile::pbf_writer(output).add_bytes(tile_layers, data);
+    }
+
+    std::string name;
+    // encoded Feature and Value messages
+    std::vector<std::string> features;
+    std::vector<std::string> keys;
+    std::map<std::string, std::uint32_t> key_index;
+    std::vector<std::string> values;
+    std::map<std::string, std::uint32_t> value_index;
+    // id, type and geometry of the features already written, each is
+    // written once whatever draws it; the geometry tells apart features
+    // of datasources whose ids are not unique
+    std::set<std::tuple<value_integer, int, std::vector<std::uint32_t>>> written;
+    // the clipping extent in tile units
+    box2d<double> bounds;
+};
+
+vector_tile_renderer::vector_tile_renderer(Map const& m, std::string & output, unsigned extent, double scale_factor)
+    : feature_style_processor<vector_tile_renderer>(m, scale_factor),
+      output_(output),
+      extent_(extent),
+      painted_(false),
+      common_(m, attributes(), 0, 0, m.width(), m.height(), scale_factor)
+{}
+
+vector_tile_renderer::vector_tile_renderer(Map const& m, request const& req, attributes const& vars,
+                                           std::string & output, unsigned extent, double scale_factor)
+    : feature_style_processor<vector_tile_renderer>(m, req, scale_factor),
+      output_(output),
+      extent_(extent),
+      painted_(false),
+      common_(m, req, vars, 0, 0, req.width(), req.height(), scale_factor)
+{}
+
+vector_tile_renderer::~vector_tile_renderer() {}
+
+double vector_tile_renderer::label_coverage() const
+{
+    return common_.detector_->coverage();
+}
+
+void vector_tile_renderer::start_layer_processing(layer const& lay, box2d<double> const& query_extent)
+{
+    MAPNIK_LOG_DEBUG(vector_tile_renderer) << "vector_tile_renderer: Start processing layer=" << lay.name();
+
+    common_.query_extent_ = query_extent;
+    boost::optional<box2d<double> > const& maximum_extent = lay.maximum_extent();
+    if (maximum_extent)
+    {
+        common_.query_extent_.clip(*maximum_extent);
+    }
+    layers_.push_back(std::make_unique<layer_builder>(lay.name()));
+    box2d<double> bounds = common_.t_.forward(common_.query_extent_);
+    layers_.back()->bounds.init(bounds.minx() * extent_ / common_.width_,
+                                bounds.miny() * extent_ / common_.height_,
+                                bounds.maxx() * extent_ / common_.width_,
+                                bounds.maxy() * extent_ / common_.height_);
+}
+
+void vector_tile_renderer::end_layer_processing(layer const& lay)
+{
+    MAPNIK_LOG_DEBUG(vector_tile_renderer) << "vector_tile_renderer: End processing layer=" << lay.name();
+
+    if (layers_.empty()) return;
+    if (!layers_.back()->features.empty())
+    {
+        layers_.back()->write(output_, extent_);
+    }
+    layers_.pop_back();
+}
+
+void vector_tile_renderer::add_feature(symbolizer_base const& sym,
+                                       mapnik::feature_impl & feature,
+                                       proj_transform const& prj_trans)
+{
+    if (layers_.empty()) return;
+    layer_builder & builder = *layers_.back();
+
+    geom_type type = geom_unknown;
+    switch (feature.geometry_type())
+    {
+    case geometry::geometry_types::Point:
+    case geometry::geometry_types::MultiPoint:
+        type = geom_point;
+        break;
+    case geometry::geometry_types::LineString:
+    case geometry::geometry_types::MultiLineString:
+        type = geom_linestring;
+        break;
+    case geometry::geometry_types::Polygon:
+    case geometry::geometry_types::MultiPolygon:
+        type = geom_polygon;
+        break;
+    default:
+        // mixed collections have no single tile geometry type
+        return;
+    }
+
+    using vertex_converter_type = vertex_converter<clip_line_tag, clip_poly_tag, transform_tag,
+                                                   simplify_tag, affine_transform_tag>;
+    // from pixels to the tile grid
+    agg::trans_affine tile_tr = agg::trans_affine_scaling(static_cast<double>(extent_) / common_.width_,
+                                                          static_cast<double>(extent_) / common_.height_);
+    vertex_converter_type converter(common_.query_extent_, sym, common_.t_, prj_trans, tile_tr,
+                                    feature, common_.vars_, common_.scale_factor_);
+    if (prj_trans.equal() || prj_trans.is_known())
+    {
+        if (type == geom_polygon) converter.set<clip_poly_tag>();
+        else if (type == geom_linestring) converter.set<clip_line_tag>();
+    }
+    converter.set<transform_tag>();
+    if (get<value_double, keys::simplify_tolerance>(sym, feature, common_.vars_) > 0.0)
+    {
+        converter.set<simplify_tag>();
+    }
+    converter.set<affine_transform_tag>();
+    if (converter.clipped_away(feature)) return;
+
+    path_collector collector;
+    using apply_vertex_converter_type = detail::apply_vertex_converter<vertex_converter_type, path_collector>;
+    using vertex_processor_type = geometry::vertex_processor<apply_vertex_converter_type>;
+    apply_vertex_converter_type apply(converter, collector);
+    mapnik::util::apply_visitor(vertex_processor_type(apply), static_cast<feature_impl const&>(feature).get_geometry());
+
+    geometry_encoder encoder;
+    if (type == geom_point) encode_points(collector, builder.bounds, encoder);
+    else if (type == geom_linestring) encode_lines(collector, encoder);
+    else encode_polygons(collector, encoder);
+    if (encoder.geometry.empty()) return;
+    if (!builder.written.emplace(feature.id(), type, encoder.geometry).second) return;
+
+    builder.add(feature, type, encoder.geometry);
+    painted_ = true;
+}
+
+void vector_tile_renderer::process(point_symbolizer const& sym,
+                                   mapnik::feature_impl & feature,
+                                   proj_transform const& prj_trans)
+{
+    add_feature(sym, feature, prj_trans);
+}
+
+void vector_tile_renderer::process(line_symbolizer const& sym,
+                                   mapnik::feature_impl & feature,
+                                   proj_transform const& prj_trans)
+{
+    add_feature(sym, feature, prj_trans);
+}
+
+void vector_tile_renderer::process(line_pattern_symbolizer const& sym,
+                                   mapnik::feature_impl & feature,
+                                   proj_transform const& prj_trans)
+{
+    add_feature(sym, feature, prj_trans);
+}
+
+void vector_tile_renderer::process(polygon_symbolizer const& sym,
+                                   mapnik::feature_impl & feature,
+                                   proj_transform const& prj_trans)
+{
+    add_feature(sym, feature, prj_trans);
+}
+
+void vector_tile_renderer::process(polygon_pattern_symbolizer const& sym,
+                                   mapnik::feature_impl & feature,
+                                   proj_transform const& prj_trans)
+{
+    add_feature(sym, feature, prj_trans);
+}
+
+void vector_tile_renderer::process(shield_symbolizer const& sym,
+                                   mapnik::feature_impl & feature,
+                                   proj_transform const& prj_trans)
+{
+    add_feature(sym, feature, prj_trans);
+}
+
+void vector_tile_renderer::process(text_symbolizer const& sym,
+                                   mapnik::feature_impl & feature,
+                                   proj_transform const& prj_trans)
+{
+    add_feature(sym, feature, prj_trans);
+}
+
+void vector_tile_renderer::process(building_symbolizer const& sym,
+                                   mapnik::feature_impl & feature,
+                                   proj_transform const& prj_trans)
+{
+    add_feature(sym, feature, prj_trans);
+}
+
+void vector_tile_renderer::process(markers_symbolizer const& sym,
+                                   mapnik::feature_impl & feature,
+                                   proj_transform const& prj_trans)
+{
+    add_feature(sym, feature, prj_trans);
+}
+
+void vector_tile_renderer::process(group_symbolizer const& sym,
+                                   mapnik::feature_impl & feature,
+                                   proj_transform const& prj_trans)
+{
+    add_feature(sym, feature, prj_trans);
+}
+
+}
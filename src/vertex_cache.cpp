@@ -25,6 +25,9 @@
 #include <mapnik/offset_converter.hpp>
 #include <mapnik/make_unique.hpp>
 
+// stl
+#include <algorithm>
+
 namespace mapnik
 {
 
@@ -332,6 +335,23 @@ bool vertex_cache::move_to_distance(double distance)
     return true;
 }
 
+bool vertex_cache::seek(double position)
+{
+    if (position < 0 || position >= current_subpath_->length) return false;
+    // the first segment ending past position, never the starting point
+    segment_vector::iterator itr = std::upper_bound(current_subpath_->vector.begin(),
+                                                    current_subpath_->vector.end(), position,
+                                                    [](double pos, segment const& seg) { return pos < seg.distance; });
+    current_segment_ = itr;
+    segment_starting_point_ = (itr - 1)->pos;
+    position_in_segment_ = position - (itr - 1)->distance;
+    position_ = position;
+    angle_valid_ = false;
+    double factor = position_in_segment_ / itr->length;
+    current_position_ = segment_starting_point_ + (itr->pos - segment_starting_point_) * factor;
+    return true;
+}
+
 void vertex_cache::rewind(unsigned)
 {
     vertex_subpath_ = subpaths_.begin();
@@ -30,6 +30,8 @@
 #include <mapnik/view_transform.hpp>
 #include <mapnik/raster.hpp>
 #include <mapnik/proj_transform.hpp>
+#include <mapnik/warp_mesh_cache.hpp>
+#include <mapnik/executor.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore_agg.hpp>
@@ -48,13 +50,20 @@
 #include "agg_renderer_scanline.h"
 #pragma GCC diagnostic pop
 
+// stl
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <memory>
+#include <vector>
+
 namespace mapnik {
 
 template <typename T>
 MAPNIK_DECL void warp_image (T & target, T const& source, proj_transform const& prj_trans,
                  box2d<double> const& target_ext, box2d<double> const& source_ext,
                  double offset_x, double offset_y, unsigned mesh_size, scaling_method_e scaling_method, double filter_factor,
-                 boost::optional<double> const & nodata_value)
+                 boost::optional<double> const & nodata_value, unsigned threads)
 {
     using image_type = T;
     using pixel_type = typename image_type::pixel_type;
@@ -65,103 +74,107 @@ MAPNIK_DECL void warp_image (T & target, T const& source, proj_transform const&
 
     constexpr std::size_t pixel_size = sizeof(pixel_type);
 
-    view_transform ts(source.width(), source.height(),
-                      source_ext);
     view_transform tt(target.width(), target.height(),
                       target_ext, offset_x, offset_y);
 
-    std::size_t mesh_nx = std::ceil(source.width()/double(mesh_size) + 1);
-    std::size_t mesh_ny = std::ceil(source.height()/double(mesh_size) + 1);
-
-    image_gray64f xs(mesh_nx, mesh_ny, false);
-    image_gray64f ys(mesh_nx, mesh_ny, false);
-
-    // Precalculate reprojected mesh
-    for(std::size_t j = 0; j < mesh_ny; ++j)
-    {
-        for (std::size_t i=0; i<mesh_nx; ++i)
-        {
-            xs(i,j) = std::min(i*mesh_size,source.width());
-            ys(i,j) = std::min(j*mesh_size,source.height());
-            ts.backward(&xs(i,j), &ys(i,j));
-        }
-    }
-    prj_trans.backward(xs.data(), ys.data(), nullptr, mesh_nx*mesh_ny);
+    warp_mesh_ptr mesh = warp_mesh_cache::instance().get(source.width(), source.height(),
+                                                         source_ext, mesh_size, prj_trans);
+    image_gray64f const& xs = mesh->xs;
+    image_gray64f const& ys = mesh->ys;
+    std::size_t mesh_nx = xs.width();
+    std::size_t mesh_ny = xs.height();
 
-    agg::rasterizer_scanline_aa<> rasterizer;
-    agg::scanline_bin scanline;
     agg::rendering_buffer buf(target.bytes(),
                               target.width(),
                               target.height(),
                               target.width() * pixel_size);
-    pixfmt_pre pixf(buf);
-    renderer_base rb(pixf);
-    rasterizer.clip_box(0, 0, target.width(), target.height());
     agg::rendering_buffer buf_tile(
         const_cast<unsigned char*>(source.bytes()),
         source.width(),
         source.height(),
         source.width() * pixel_size);
 
-    pixfmt_pre pixf_tile(buf_tile);
+    // Renders the target rows [y0, y1). Cells are visited in the same
+    // order for every band, so splitting the rows between threads gives
+    // the same pixels as a single pass.
+    auto render_rows = [&](std::size_t y0, std::size_t y1)
+    {
+        agg::rasterizer_scanline_aa<> rasterizer;
+        agg::scanline_bin scanline;
+        pixfmt_pre pixf(buf);
+        renderer_base rb(pixf);
+        rasterizer.clip_box(0, y0, target.width(), y1);
+        pixfmt_pre pixf_tile(buf_tile);
 
-    using img_accessor_type = agg::image_accessor_clone<pixfmt_pre>;
-    img_accessor_type ia(pixf_tile);
+        using img_accessor_type = agg::image_accessor_clone<pixfmt_pre>;
+        img_accessor_type ia(pixf_tile);
 
-    agg::span_allocator<color_type> sa;
-    // Project mesh cells into target interpolating raster inside each one
-    for (std::size_t j = 0; j < mesh_ny - 1; ++j)
-    {
-        for (std::size_t i = 0; i < mesh_nx - 1; ++i)
+        agg::span_allocator<color_type> sa;
+        // Project mesh cells into target interpolating raster inside each one
+        for (std::size_t j = 0; j < mesh_ny - 1; ++j)
         {
-            double polygon[8] = {xs(i,j), ys(i,j),
-                                 xs(i+1,j), ys(i+1,j),
-                                 xs(i+1,j+1), ys(i+1,j+1),
-                                 xs(i,j+1), ys(i,j+1)};
-            tt.forward(polygon+0, polygon+1);
-            tt.forward(polygon+2, polygon+3);
-            tt.forward(polygon+4, polygon+5);
-            tt.forward(polygon+6, polygon+7);
-
-            rasterizer.reset();
-            rasterizer.move_to_d(std::floor(polygon[0]), std::floor(polygon[1]));
-            rasterizer.line_to_d(std::floor(polygon[2]), std::floor(polygon[3]));
-            rasterizer.line_to_d(std::floor(polygon[4]), std::floor(polygon[5]));
-            rasterizer.line_to_d(std::floor(polygon[6]), std::floor(polygon[7]));
-
-            std::size_t x0 = i * mesh_size;
-            std::size_t y0 = j * mesh_size;
-            std::size_t x1 = (i+1) * mesh_size;
-            std::size_t y1 = (j+1) * mesh_size;
-            x1 = std::min(x1, source.width());
-            y1 = std::min(y1, source.height());
-            agg::trans_affine tr(polygon, x0, y0, x1, y1);
-            if (tr.is_valid())
+            for (std::size_t i = 0; i < mesh_nx - 1; ++i)
             {
-                interpolator_type interpolator(tr);
-                if (scaling_method == SCALING_NEAR)
-                {
-                    using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_filter;
-                    span_gen_type sg(ia, interpolator);
-                    agg::render_scanlines_bin(rasterizer, scanline, rb, sa, sg);
-                }
-                else
+                double polygon[8] = {xs(i,j), ys(i,j),
+                                     xs(i+1,j), ys(i+1,j),
+                                     xs(i+1,j+1), ys(i+1,j+1),
+                                     xs(i,j+1), ys(i,j+1)};
+                tt.forward(polygon+0, polygon+1);
+                tt.forward(polygon+2, polygon+3);
+                tt.forward(polygon+4, polygon+5);
+                tt.forward(polygon+6, polygon+7);
+
+                double cell_y0 = std::min(std::min(polygon[1], polygon[3]), std::min(polygon[5], polygon[7]));
+                double cell_y1 = std::max(std::max(polygon[1], polygon[3]), std::max(polygon[5], polygon[7]));
+                // NaN corners are left to the rasterizer as before
+                if (cell_y1 < y0 - 1.0 || cell_y0 > y1 + 1.0) continue;
+
+                rasterizer.reset();
+                rasterizer.move_to_d(std::floor(polygon[0]), std::floor(polygon[1]));
+                rasterizer.line_to_d(std::floor(polygon[2]), std::floor(polygon[3]));
+                rasterizer.line_to_d(std::floor(polygon[4]), std::floor(polygon[5]));
+                rasterizer.line_to_d(std::floor(polygon[6]), std::floor(polygon[7]));
+
+                std::size_t x0 = i * mesh_size;
+                std::size_t sy0 = j * mesh_size;
+                std::size_t x1 = (i+1) * mesh_size;
+                std::size_t sy1 = (j+1) * mesh_size;
+                x1 = std::min(x1, source.width());
+                sy1 = std::min(sy1, source.height());
+                agg::trans_affine tr(polygon, x0, sy0, x1, sy1);
+                if (tr.is_valid())
                 {
-                    using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_resample_affine;
-                    agg::image_filter_lut filter;
-                    detail::set_scaling_method(filter, scaling_method, filter_factor);
-                    boost::optional<typename span_gen_type::value_type> nodata;
-                    if (nodata_value)
+                    interpolator_type interpolator(tr);
+                    if (scaling_method == SCALING_NEAR)
+                    {
+                        using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_filter;
+                        span_gen_type sg(ia, interpolator);
+                        agg::render_scanlines_bin(rasterizer, scanline, rb, sa, sg);
+                    }
+                    else
                     {
-                        nodata = nodata_value;
+                        using span_gen_type = typename detail::agg_scaling_traits<image_type>::span_image_resample_affine;
+                        agg::image_filter_lut filter;
+                        detail::set_scaling_method(filter, scaling_method, filter_factor);
+                        boost::optional<typename span_gen_type::value_type> nodata;
+                        if (nodata_value)
+                        {
+                            nodata = nodata_value;
+                        }
+                        span_gen_type sg(ia, interpolator, filter, nodata);
+                        agg::render_scanlines_bin(rasterizer, scanline, rb, sa, sg);
                     }
-                    span_gen_type sg(ia, interpolator, filter, nodata);
-                    agg::render_scanlines_bin(rasterizer, scanline, rb, sa, sg);
                 }
-            }
 
+            }
         }
-    }
+    };
+
+    std::size_t height = target.height();
+    // below this many pixels a thread costs more than it saves
+    std::size_t const min_pixels_per_thread = 256 * 256;
+    parallel_bands(height, std::min(static_cast<std::size_t>(threads),
+                                    target.width() * height / min_pixels_per_thread), render_rows);
 }
 
 namespace detail {
@@ -171,7 +184,7 @@ struct warp_image_visitor
     warp_image_visitor (raster & target_raster, proj_transform const& prj_trans, box2d<double> const& source_ext,
                         double offset_x, double offset_y, unsigned mesh_size,
                         scaling_method_e scaling_method, double filter_factor,
-                        boost::optional<double> const & nodata_value)
+                        boost::optional<double> const & nodata_value, unsigned threads)
         : target_raster_(target_raster),
           prj_trans_(prj_trans),
           source_ext_(source_ext),
@@ -180,7 +193,8 @@ struct warp_image_visitor
           mesh_size_(mesh_size),
           scaling_method_(scaling_method),
           filter_factor_(filter_factor),
-          nodata_value_(nodata_value)
+          nodata_value_(nodata_value),
+          threads_(threads)
     {}
 
     void operator() (image_null const&) const {}
@@ -194,7 +208,7 @@ struct warp_image_visitor
         {
             image_type & target = util::get<image_type>(target_raster_.data_);
             warp_image (target, source, prj_trans_, target_raster_.ext_, source_ext_,
-                        offset_x_, offset_y_, mesh_size_, scaling_method_, filter_factor_, nodata_value_);
+                        offset_x_, offset_y_, mesh_size_, scaling_method_, filter_factor_, nodata_value_, threads_);
         }
     }
 
@@ -207,6 +221,7 @@ struct warp_image_visitor
     scaling_method_e scaling_method_;
     double filter_factor_;
     boost::optional<double> const & nodata_value_;
+    unsigned threads_;
 };
 
 }
@@ -216,10 +231,11 @@ void reproject_and_scale_raster(raster & target, raster const& source,
                                 double offset_x, double offset_y,
                                 unsigned mesh_size,
                                 scaling_method_e scaling_method,
-                                boost::optional<double> const & nodata_value)
+                                boost::optional<double> const & nodata_value,
+                                unsigned threads)
 {
     detail::warp_image_visitor warper(target, prj_trans, source.ext_, offset_x, offset_y, mesh_size,
-                                      scaling_method, source.get_filter_factor(), nodata_value);
+                                      scaling_method, source.get_filter_factor(), nodata_value, threads);
     util::apply_visitor(warper, source.data_);
 }
 
@@ -238,16 +254,16 @@ void reproject_and_scale_raster(raster & target, raster const& source,
 
 
 template MAPNIK_DECL void warp_image (image_rgba8&, image_rgba8 const&, proj_transform const&,
-                                      box2d<double> const&, box2d<double> const&, double, double, unsigned, scaling_method_e, double, boost::optional<double> const &);
+                                      box2d<double> const&, box2d<double> const&, double, double, unsigned, scaling_method_e, double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void warp_image (image_gray8&, image_gray8 const&, proj_transform const&,
-                                      box2d<double> const&, box2d<double> const&, double, double, unsigned, scaling_method_e, double, boost::optional<double> const &);
+                                      box2d<double> const&, box2d<double> const&, double, double, unsigned, scaling_method_e, double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void warp_image (image_gray16&, image_gray16 const&, proj_transform const&,
-                                      box2d<double> const&, box2d<double> const&, double, double, unsigned, scaling_method_e, double, boost::optional<double> const &);
+                                      box2d<double> const&, box2d<double> const&, double, double, unsigned, scaling_method_e, double, boost::optional<double> const &, unsigned);
 
 template MAPNIK_DECL void warp_image (image_gray32f&, image_gray32f const&, proj_transform const&,
-                                      box2d<double> const&, box2d<double> const&, double, double, unsigned, scaling_method_e, double, boost::optional<double> const &);
+                                      box2d<double> const&, box2d<double> const&, double, double, unsigned, scaling_method_e, double, boost::optional<double> const &, unsigned);
 
 
 }// namespace mapnik
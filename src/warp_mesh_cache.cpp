@@ -0,0 +1,255 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/warp_mesh_cache.hpp>
+#include <mapnik/debug.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/view_transform.hpp>
+
+// stl
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <sstream>
+
+namespace mapnik
+{
+
+template class singleton<warp_mesh_cache, CreateStatic>;
+
+namespace {
+
+const char * mesh_file_magic = "mapnik-warp-mesh-1";
+
+std::string make_key(std::size_t width, std::size_t height,
+                     box2d<double> const& source_ext, unsigned mesh_size,
+                     proj_transform const& prj_trans)
+{
+    std::ostringstream s;
+    s.precision(std::numeric_limits<double>::max_digits10);
+    s << width << ' ' << height << ' ' << mesh_size << ' '
+      << source_ext.minx() << ' ' << source_ext.miny() << ' '
+      << source_ext.maxx() << ' ' << source_ext.maxy() << '\n'
+      << prj_trans.source().params() << '\n'
+      << prj_trans.dest().params();
+    return s.str();
+}
+
+warp_mesh_ptr make_mesh(std::size_t width, std::size_t height,
+                        box2d<double> const& source_ext, unsigned mesh_size,
+                        proj_transform const& prj_trans)
+{
+    view_transform ts(width, height, source_ext);
+    std::size_t mesh_nx = std::ceil(width/double(mesh_size) + 1);
+    std::size_t mesh_ny = std::ceil(height/double(mesh_size) + 1);
+    auto mesh = std::make_shared<warp_mesh>(mesh_nx, mesh_ny);
+    image_gray64f & xs = mesh->xs;
+    image_gray64f & ys = mesh->ys;
+    // Precalculate reprojected mesh
+    for(std::size_t j = 0; j < mesh_ny; ++j)
+    {
+        for (std::size_t i=0; i<mesh_nx; ++i)
+        {
+            xs(i,j) = std::min(i*mesh_size,width);
+            ys(i,j) = std::min(j*mesh_size,height);
+            ts.backward(&xs(i,j), &ys(i,j));
+        }
+    }
+    prj_trans.backward(xs.data(), ys.data(), nullptr, mesh_nx*mesh_ny);
+    return mesh;
+}
+
+}
+
+warp_mesh_cache::warp_mesh_cache()
+    : entries_(),
+      index_(),
+      capacity_(16),
+      directory_() {}
+
+warp_mesh_ptr warp_mesh_cache::get(std::size_t width, std::size_t height,
+                                   box2d<double> const& source_ext, unsigned mesh_size,
+                                   proj_transform const& prj_trans)
+{
+    std::string key = make_key(width, height, source_ext, mesh_size, prj_trans);
+    std::string directory;
+    {
+#ifdef MAPNIK_THREADSAFE
+        std::lock_guard<std::mutex> lock(mutex_);
+#endif
+        auto itr = index_.find(key);
+        if (itr != index_.end())
+        {
+            entries_.splice(entries_.begin(), entries_, itr->second);
+            return itr->second->second;
+        }
+        directory = directory_;
+    }
+    // built outside the lock, racing threads may each build the same mesh
+    warp_mesh_ptr mesh;
+    if (!directory.empty()) mesh = load(directory, key);
+    if (!mesh)
+    {
+        mesh = make_mesh(width, height, source_ext, mesh_size, prj_trans);
+        if (!directory.empty()) store(directory, key, *mesh);
+    }
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    if (capacity_ == 0 || index_.find(key) != index_.end()) return mesh;
+    entries_.emplace_front(key, mesh);
+    index_.emplace(std::move(key), entries_.begin());
+    while (entries_.size() > capacity_)
+    {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+    return mesh;
+}
+
+void warp_mesh_cache::set_capacity(std::size_t capacity)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    capacity_ = capacity;
+    while (entries_.size() > capacity_)
+    {
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+}
+
+std::size_t warp_mesh_cache::capacity() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return capacity_;
+}
+
+std::size_t warp_mesh_cache::size() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return entries_.size();
+}
+
+void warp_mesh_cache::set_directory(std::string const& directory)
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    directory_ = directory;
+}
+
+std::string warp_mesh_cache::directory() const
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    return directory_;
+}
+
+void warp_mesh_cache::clear()
+{
+#ifdef MAPNIK_THREADSAFE
+    std::lock_guard<std::mutex> lock(mutex_);
+#endif
+    index_.clear();
+    entries_.clear();
+}
+
+std::string warp_mesh_cache::filename(std::string const& directory, std::string const& key)
+{
+    std::ostringstream s;
+    s << directory << "/" << std::hex << std::hash<std::string>()(key) << ".mesh";
+    return s.str();
+}
+
+// File layout: magic line, key length and key, mesh width and height,
+// then the x and y planes as native doubles. The stored key guards
+// against hash collisions and files from other transforms.
+warp_mesh_ptr warp_mesh_cache::load(std::string const& directory, std::string const& key)
+{
+    std::ifstream file(filename(directory, key), std::ios::binary);
+    if (!file) return warp_mesh_ptr();
+    std::string magic;
+    std::getline(file, magic);
+    std::size_t key_size = 0, nx = 0, ny = 0;
+    file >> key_size;
+    file.get();
+    if (!file || magic != mesh_file_magic || key_size != key.size()) return warp_mesh_ptr();
+    std::string stored_key(key_size, '\0');
+    file.read(&stored_key[0], key_size);
+    file >> nx >> ny;
+    file.get();
+    if (!file || stored_key != key || nx == 0 || ny == 0) return warp_mesh_ptr();
+    auto mesh = std::make_shared<warp_mesh>(nx, ny);
+    file.read(reinterpret_cast<char*>(mesh->xs.data()), mesh->xs.size());
+    file.read(reinterpret_cast<char*>(mesh->ys.data()), mesh->ys.size());
+    if (!file)
+    {
+        MAPNIK_LOG_DEBUG(warp_mesh_cache) << "warp_mesh_cache: truncated mesh file " << filename(directory, key);
+        return warp_mesh_ptr();
+    }
+    return mesh;
+}
+
+void warp_mesh_cache::store(std::string const& directory, std::string const& key, warp_mesh const& mesh)
+{
+    // written aside and renamed so readers never see a partial file
+    std::string name = filename(directory, key);
+    std::ostringstream tmp;
+    tmp << name << ".tmp" << std::hex << std::chrono::steady_clock::now().time_since_epoch().count()
+        << reinterpret_cast<std::uintptr_t>(&mesh);
+    std::string tmp_name = tmp.str();
+    {
+        std::ofstream file(tmp_name, std::ios::binary | std::ios::trunc);
+        if (!file) return;
+        file << mesh_file_magic << '\n' << key.size() << '\n' << key
+             << mesh.xs.width() << ' ' << mesh.xs.height() << '\n';
+        file.write(reinterpret_cast<char const*>(mesh.xs.data()), mesh.xs.size());
+        file.write(reinterpret_cast<char const*>(mesh.ys.data()), mesh.ys.size());
+        if (!file)
+        {
+            MAPNIK_LOG_DEBUG(warp_mesh_cache) << "warp_mesh_cache: could not write " << tmp_name;
+            std::remove(tmp_name.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp_name.c_str(), name.c_str()) != 0)
+    {
+        std::remove(tmp_name.c_str());
+    }
+}
+
+}
@@ -29,11 +29,43 @@
 #include <mapnik/util/noncopyable.hpp>
 #include <mapnik/geometry/correct.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <type_traits>
 
 namespace mapnik
 {
 
+namespace {
+
+// coordinates are copied straight into the points
+static_assert(sizeof(mapnik::geometry::point<double>) == 2 * sizeof(double) &&
+              std::is_standard_layout<mapnik::geometry::point<double>>::value,
+              "point<double> must be two packed doubles");
+
+inline void byte_swap_doubles(double * values, std::size_t count)
+{
+    // a loop the compiler vectorizes
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, values + i, 8);
+#if defined(__GNUC__)
+        bits = __builtin_bswap64(bits);
+#else
+        bits = ((bits & 0x00000000000000ffULL) << 56) | ((bits & 0x000000000000ff00ULL) << 40) |
+            ((bits & 0x0000000000ff0000ULL) << 24) | ((bits & 0x00000000ff000000ULL) << 8)  |
+            ((bits & 0x000000ff00000000ULL) >> 8)  | ((bits & 0x0000ff0000000000ULL) >> 24) |
+            ((bits & 0x00ff000000000000ULL) >> 40) | ((bits & 0xff00000000000000ULL) >> 56);
+#endif
+        std::memcpy(values + i, &bits, 8);
+    }
+}
+
+}
+
 struct wkb_reader : util::noncopyable
 {
 private:
@@ -245,34 +277,33 @@ private:
         return d;
     }
 
+    // Copies the coordinates in bulk, byte swapped afterwards when needed.
+    // Counts running past the end of the wkb are cut to the points there.
     template <typename Ring, bool Z = false, bool M = false>
-    void read_coords(Ring & ring, std::size_t num_points)
+    void read_coords(Ring & ring, int count)
     {
-        double x,y;
-        if (!needSwap_)
+        constexpr std::size_t stride = 16 + (Z ? 8 : 0) + (M ? 8 : 0);
+        std::size_t available = pos_ < size_ ? (size_ - pos_) / stride : 0;
+        std::size_t num_points = std::min(static_cast<std::size_t>(count), available);
+        if (num_points == 0) return;
+        ring.resize(num_points);
+        char * out = reinterpret_cast<char *>(ring.data());
+        if (stride == 16)
         {
-            for (std::size_t i = 0; i < num_points; ++i)
-            {
-                read_double_ndr(wkb_ + pos_, x);
-                read_double_ndr(wkb_ + pos_ + 8, y);
-                ring.emplace_back(x,y);
-                pos_ += 16; // skip XY
-                if (Z) pos_ += 8;
-                if (M) pos_ += 8;
-            }
+            std::memcpy(out, wkb_ + pos_, num_points * 16);
         }
         else
         {
             for (std::size_t i = 0; i < num_points; ++i)
             {
-                read_double_xdr(wkb_ + pos_, x);
-                read_double_xdr(wkb_ + pos_ + 8, y);
-                ring.emplace_back(x,y);
-                pos_ += 16; // skip XY
-                if (Z) pos_ += 8;
-                if (M) pos_ += 8;
+                std::memcpy(out + i * 16, wkb_ + pos_ + i * stride, 16); // skip Z and M
             }
         }
+        if (needSwap_)
+        {
+            byte_swap_doubles(reinterpret_cast<double *>(out), num_points * 2);
+        }
+        pos_ += num_points * stride;
     }
 
     template <bool Z = false, bool M = false>
@@ -306,7 +337,6 @@ private:
         int num_points = read_integer();
         if (num_points > 0)
         {
-            line.reserve(num_points);
             read_coords<mapnik::geometry::line_string<double>, M, Z>(line, num_points);
         }
         return line;
@@ -338,7 +368,6 @@ private:
             int num_points = read_integer();
             if (num_points > 0)
             {
-                ring.reserve(num_points);
                 read_coords<mapnik::geometry::linear_ring<double>, M, Z>(ring, num_points);
             }
             poly.push_back(std::move(ring));
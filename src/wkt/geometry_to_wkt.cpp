@@ -22,26 +22,20 @@
 
 // mapnik
 #include <mapnik/util/geometry_to_wkt.hpp>
-#include <mapnik/wkt/wkt_generator_grammar.hpp>
-// boost
-#include <boost/spirit/include/karma.hpp>
+#include <mapnik/wkt/wkt_writer.hpp>
 
 namespace mapnik { namespace util {
 
 bool to_wkt(std::string & wkt,  mapnik::geometry::geometry<double> const& geom)
 {
-    using sink_type = std::back_insert_iterator<std::string>;
-    static const mapnik::wkt::wkt_generator_grammar<sink_type, mapnik::geometry::geometry<double>> generator;
-    sink_type sink(wkt);
-    return boost::spirit::karma::generate(sink, generator, geom);
+    mapnik::wkt::write_wkt(wkt, geom);
+    return true;
 }
 
 bool to_wkt(std::string & wkt,  mapnik::geometry::geometry<std::int64_t> const& geom)
 {
-    using sink_type = std::back_insert_iterator<std::string>;
-    static const mapnik::wkt::wkt_generator_grammar<sink_type, mapnik::geometry::geometry<std::int64_t>> generator;
-    sink_type sink(wkt);
-    return boost::spirit::karma::generate(sink, generator, geom);
+    mapnik::wkt::write_wkt(wkt, geom);
+    return true;
 }
 
 }}
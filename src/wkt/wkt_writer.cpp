@@ -0,0 +1,204 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+// mapnik
+#include <mapnik/wkt/wkt_writer.hpp>
+#include <mapnik/util/text_sink.hpp>
+// stl
+#include <ostream>
+
+namespace mapnik { namespace wkt {
+
+namespace {
+
+using util::write_number;
+
+template <typename T>
+bool has_points(geometry::polygon<T> const& poly)
+{
+    for (auto const& ring : poly)
+    {
+        if (!ring.empty()) return true;
+    }
+    return false;
+}
+
+template <typename Sink, typename T>
+void write_point(Sink & sink, geometry::point<T> const& pt)
+{
+    write_number(sink, pt.x);
+    sink.put(' ');
+    write_number(sink, pt.y);
+}
+
+// "(x y,x y,..)", nothing for no points
+template <typename Sink, typename Points>
+void write_points(Sink & sink, Points const& points)
+{
+    if (points.empty()) return;
+    sink.put('(');
+    bool first = true;
+    for (auto const& pt : points)
+    {
+        if (!first) sink.put(',');
+        first = false;
+        write_point(sink, pt);
+    }
+    sink.put(')');
+}
+
+// "((..),(..))" skipping the empty rings, nothing for no points
+template <typename Sink, typename T>
+void write_rings(Sink & sink, geometry::polygon<T> const& poly)
+{
+    sink.put('(');
+    bool first = true;
+    for (auto const& ring : poly)
+    {
+        if (ring.empty()) continue;
+        if (!first) sink.put(',');
+        first = false;
+        write_points(sink, ring);
+    }
+    sink.put(')');
+}
+
+template <typename Sink, typename T>
+struct geometry_writer
+{
+    explicit geometry_writer(Sink & sink)
+        : sink_(sink) {}
+
+    void operator() (geometry::geometry_empty const&) const
+    {
+        sink_.literal("POINT EMPTY");
+    }
+
+    void operator() (geometry::point<T> const& pt) const
+    {
+        sink_.literal("POINT(");
+        write_point(sink_, pt);
+        sink_.put(')');
+    }
+
+    void operator() (geometry::line_string<T> const& line) const
+    {
+        sink_.literal("LINESTRING");
+        if (line.empty()) sink_.literal(" EMPTY");
+        else write_points(sink_, line);
+    }
+
+    void operator() (geometry::polygon<T> const& poly) const
+    {
+        sink_.literal("POLYGON");
+        if (!has_points(poly)) sink_.literal(" EMPTY");
+        else write_rings(sink_, poly);
+    }
+
+    void operator() (geometry::multi_point<T> const& multi_pt) const
+    {
+        sink_.literal("MULTIPOINT");
+        if (multi_pt.empty()) sink_.literal(" EMPTY");
+        else write_points(sink_, multi_pt);
+    }
+
+    void operator() (geometry::multi_line_string<T> const& multi_line) const
+    {
+        sink_.literal("MULTILINESTRING");
+        bool first = true;
+        for (auto const& line : multi_line)
+        {
+            if (line.empty()) continue;
+            sink_.put(first ? '(' : ',');
+            first = false;
+            write_points(sink_, line);
+        }
+        if (first) sink_.literal(" EMPTY");
+        else sink_.put(')');
+    }
+
+    void operator() (geometry::multi_polygon<T> const& multi_poly) const
+    {
+        sink_.literal("MULTIPOLYGON");
+        bool first = true;
+        for (auto const& poly : multi_poly)
+        {
+            if (!has_points(poly)) continue;
+            sink_.put(first ? '(' : ',');
+            first = false;
+            write_rings(sink_, poly);
+        }
+        if (first) sink_.literal(" EMPTY");
+        else sink_.put(')');
+    }
+
+    void operator() (geometry::geometry_collection<T> const& collection) const
+    {
+        sink_.literal("GEOMETRYCOLLECTION");
+        bool first = true;
+        for (auto const& geom : collection)
+        {
+            sink_.put(first ? '(' : ',');
+            first = false;
+            util::apply_visitor(*this, geom);
+        }
+        if (first) sink_.literal(" EMPTY");
+        else sink_.put(')');
+    }
+
+    Sink & sink_;
+};
+
+template <typename Sink, typename T>
+void write_geometry(Sink & sink, geometry::geometry<T> const& geom)
+{
+    util::apply_visitor(geometry_writer<Sink, T>(sink), geom);
+}
+
+} // anonymous namespace
+
+void write_wkt(std::string & wkt, geometry::geometry<double> const& geom)
+{
+    util::string_sink sink(wkt);
+    write_geometry(sink, geom);
+}
+
+void write_wkt(std::ostream & out, geometry::geometry<double> const& geom)
+{
+    util::stream_sink sink(out);
+    write_geometry(sink, geom);
+}
+
+void write_wkt(std::string & wkt, geometry::geometry<std::int64_t> const& geom)
+{
+    util::string_sink sink(wkt);
+    write_geometry(sink, geom);
+}
+
+void write_wkt(std::ostream & out, geometry::geometry<std::int64_t> const& geom)
+{
+    util::stream_sink sink(out);
+    write_geometry(sink, geom);
+}
+
+}}
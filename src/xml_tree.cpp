@@ -30,6 +30,7 @@
 #include <mapnik/color_factory.hpp>
 #include <mapnik/rule.hpp>
 #include <mapnik/feature_type_style.hpp>
+#include <mapnik/layer.hpp>
 #include <mapnik/text/text_properties.hpp>
 #include <mapnik/config_error.hpp>
 #include <mapnik/raster_colorizer.hpp>
@@ -436,6 +437,8 @@ compile_get_opt_attr(direction_e);
 compile_get_opt_attr(halo_rasterizer_e);
 compile_get_opt_attr(expression_ptr);
 compile_get_opt_attr(font_feature_settings);
+compile_get_opt_attr(budget_policy_e);
+compile_get_opt_attr(aggregate_mode_e);
 compile_get_attr(std::string);
 compile_get_attr(filter_mode_e);
 compile_get_attr(point_placement_e);
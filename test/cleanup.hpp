@@ -15,7 +15,9 @@
 #endif
 
 #include <unicode/uclean.h>
-#ifdef MAPNIK_USE_PROJ4
+#if defined(MAPNIK_USE_PROJ6)
+#include <proj.h>
+#elif defined(MAPNIK_USE_PROJ4)
 #include <proj_api.h>
 #endif
 
@@ -47,7 +49,9 @@ inline void run_cleanup()
     // http://icu-project.org/apiref/icu4c/uclean_8h.html#a93f27d0ddc7c196a1da864763f2d8920
     u_cleanup();
 
-#ifdef MAPNIK_USE_PROJ4
+#if defined(MAPNIK_USE_PROJ6)
+    proj_cleanup();
+#elif defined(MAPNIK_USE_PROJ4)
     // http://trac.osgeo.org/proj/ticket/149
  #if PJ_VERSION >= 480
     pj_clear_initcache();
@@ -3,6 +3,8 @@
 
 #include <mapnik/safe_cast.hpp>
 #include <mapnik/color.hpp>
+#include <mapnik/color_factory.hpp>
+#include <mapnik/config_error.hpp>
 #include <mapnik/css_color_grammar_x3.hpp>
 #include <mapnik/css_color_grammar_x3_def.hpp>
 
@@ -247,4 +249,20 @@ TEST_CASE("CSS color") {
         c.demultiply();
         CHECK(c == mapnik::color(100, 148, 236, 127));
     }
+    SECTION("cached parsing")
+    {
+        // more distinct strings than the cache holds, twice over
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (int i = 0; i < 300; ++i)
+            {
+                std::string s = "rgb(" + std::to_string(i % 256) + ",0," + std::to_string(i / 256) + ")";
+                CHECK(mapnik::parse_color_cached(s) == mapnik::parse_color(s));
+            }
+        }
+        CHECK(mapnik::parse_color_cached("salmon") == mapnik::color(250, 128, 114));
+        CHECK(mapnik::parse_color_cached("salmon") == mapnik::color(250, 128, 114));
+        CHECK_THROWS_AS(mapnik::parse_color_cached("no-such-color"), mapnik::config_error);
+        CHECK_THROWS_AS(mapnik::parse_color_cached("no-such-color"), mapnik::config_error);
+    }
 }
@@ -0,0 +1,86 @@
+#include "catch.hpp"
+
+#include <mapnik/async_file_reader.hpp>
+#include <mapnik/query_scheduler.hpp>
+#include <mapnik/util/spatial_index.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string write_file(std::string const& filename, std::size_t size)
+{
+    std::string content;
+    for (std::size_t i = 0; i < size; ++i) content += static_cast<char>('a' + i % 26);
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    out << content;
+    return content;
+}
+
+}
+
+TEST_CASE("async file reader") {
+
+std::string filename("/tmp/mapnik-async-file-reader.txt");
+std::string content = write_file(filename, 1 << 21);
+
+SECTION("reads ranges") {
+    for (std::size_t threads : {0, 2})
+    {
+        mapnik::query_scheduler::instance().reserve_threads(threads);
+        mapnik::async_file_reader reader(filename);
+        REQUIRE(reader.is_open());
+        std::vector<mapnik::async_file_reader::handle> handles;
+        for (std::uint64_t off = 0; off < content.size(); off += 300000)
+        {
+            handles.push_back(reader.read(off, 1000));
+        }
+        std::uint64_t off = 0;
+        for (auto & handle : handles)
+        {
+            CHECK(handle.offset() == off);
+            CHECK(handle.size() == 1000);
+            char const* data = handle.get();
+            REQUIRE(data != nullptr);
+            CHECK(std::string(data, 1000) == content.substr(off, 1000));
+            off += 300000;
+        }
+        // past the end of the file
+        auto handle = reader.read(content.size() - 10, 20);
+        CHECK(handle.get() == nullptr);
+        handle = reader.read(0, 10);
+        handle.cancel();
+        CHECK(!handle.valid());
+    }
+}
+
+SECTION("missing file") {
+    mapnik::async_file_reader reader("/tmp/mapnik-async-file-reader-missing.txt");
+    CHECK(!reader.is_open());
+}
+
+SECTION("reads records in blocks") {
+    mapnik::query_scheduler::instance().reserve_threads(2);
+    std::vector<mapnik::util::index_record> records;
+    for (std::uint64_t off = 0; off + 100 < content.size(); off += 7919)
+    {
+        mapnik::util::index_record record;
+        record.off = off;
+        record.size = 100;
+        records.push_back(record);
+    }
+    mapnik::async_record_reader reader(filename);
+    for (auto itr = records.begin(); itr != records.end(); ++itr)
+    {
+        char const* data = reader.read(itr, records.end());
+        REQUIRE(data != nullptr);
+        CHECK(std::string(data, 100) == content.substr(itr->off, 100));
+    }
+}
+
+std::remove(filename.c_str());
+}
@@ -0,0 +1,83 @@
+#include "catch.hpp"
+
+#include <mapnik/attribute.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+
+namespace {
+
+mapnik::value const& get(mapnik::attribute const& attr, mapnik::feature_impl const& f)
+{
+    return attr.value<mapnik::value, mapnik::feature_impl>(f);
+}
+
+}
+
+TEST_CASE("attribute slots") {
+
+SECTION("context index_of") {
+    mapnik::context_type ctx;
+    ctx.push("a");
+    ctx.push("b");
+    CHECK(ctx.index_of("a") == 0);
+    CHECK(ctx.index_of("b") == 1);
+    CHECK(ctx.index_of("c") == mapnik::context_type::npos);
+    std::uint64_t version = ctx.version();
+    ctx.push("c");
+    CHECK(ctx.version() != version);
+    CHECK(ctx.index_of("c") == 2);
+}
+
+SECTION("attribute follows feature context") {
+    mapnik::transcoder tr("utf8");
+    auto ctx1 = std::make_shared<mapnik::context_type>();
+    ctx1->push("name");
+    ctx1->push("pop");
+    auto ctx2 = std::make_shared<mapnik::context_type>();
+    ctx2->push("pop");
+    mapnik::feature_ptr f1(mapnik::feature_factory::create(ctx1, 1));
+    f1->put("name", tr.transcode("one"));
+    f1->put("pop", mapnik::value_integer(100));
+    mapnik::feature_ptr f2(mapnik::feature_factory::create(ctx2, 2));
+    f2->put("pop", mapnik::value_integer(200));
+
+    mapnik::attribute pop("pop");
+    mapnik::attribute name("name");
+    for (int i = 0; i < 2; ++i)
+    {
+        CHECK(get(pop, *f1) == mapnik::value_integer(100));
+        CHECK(get(pop, *f2) == mapnik::value_integer(200));
+        CHECK(get(name, *f2).is_null());
+    }
+    CHECK(pop.slot(*ctx1) == 1);
+    CHECK(pop.slot(*ctx2) == 0);
+    CHECK(name.slot(*ctx2) == mapnik::context_type::npos);
+
+    // a name added after the slot was cached
+    f2->put_new("name", tr.transcode("two"));
+    CHECK(get(name, *f2) == tr.transcode("two"));
+
+    // slots too large to cache are still found
+    auto wide = std::make_shared<mapnik::context_type>();
+    for (int i = 0; i < 70000; ++i)
+    {
+        wide->push("attr" + std::to_string(i));
+    }
+    wide->push("pop");
+    mapnik::feature_ptr f3(mapnik::feature_factory::create(wide, 3));
+    f3->put("pop", mapnik::value_integer(300));
+    for (int i = 0; i < 2; ++i)
+    {
+        CHECK(get(pop, *f3) == mapnik::value_integer(300));
+        CHECK(get(pop, *f1) == mapnik::value_integer(100));
+    }
+    CHECK(pop.slot(*wide) == 70000);
+
+    // copies do not share the cached slot
+    mapnik::attribute copy(pop);
+    CHECK(copy.name() == "pop");
+    CHECK(get(copy, *f1) == mapnik::value_integer(100));
+}
+
+}
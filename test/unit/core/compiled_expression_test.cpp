@@ -0,0 +1,90 @@
+#include "catch.hpp"
+
+#include <mapnik/expression.hpp>
+#include <mapnik/expression_evaluator.hpp>
+#include <mapnik/compiled_expression.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+mapnik::value_type tree_evaluate(mapnik::feature_impl const& feature,
+                                 mapnik::expression_ptr const& expr,
+                                 mapnik::attributes const& vars)
+{
+    return mapnik::util::apply_visitor(
+        mapnik::evaluate<mapnik::feature_impl, mapnik::value_type, mapnik::attributes>(
+            feature, vars), *expr);
+}
+
+}
+
+TEST_CASE("compiled_expression") {
+
+    mapnik::transcoder tr("utf8");
+    mapnik::attributes vars;
+    vars["zoom"] = mapnik::value_integer(12);
+
+    auto ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("highway");
+    ctx->push("lanes");
+    ctx->push("name");
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    feature->put("highway", tr.transcode("primary"));
+    feature->put("lanes", mapnik::value_integer(3));
+    feature->put("name", tr.transcode("Main Street"));
+
+    // features from another datasource, attributes in a different order
+    auto other_ctx = std::make_shared<mapnik::context_type>();
+    other_ctx->push("lanes");
+    mapnik::feature_ptr other(mapnik::feature_factory::create(other_ctx, 2));
+    other->put("lanes", mapnik::value_integer(1));
+
+    std::vector<std::string> exprs = {
+        "[highway] = 'primary'",
+        "[highway] = 'secondary'",
+        "[lanes] > 2 and [highway] != 'motorway'",
+        "[lanes] * 2 + 1",
+        "-[lanes]",
+        "not [missing]",
+        "[missing] or [lanes] = 3",
+        "[lanes] = 3 or [missing]",
+        "[missing] and [lanes] = 3",
+        "[name].match('Main.*')",
+        "[name].replace('Street','St')",
+        "[lanes] % 2",
+        "@zoom >= 12",
+        "[mapnik::geometry_type] = 1",
+        "[lanes] = 3.0",
+        "[missing] = null",
+        "1 < [lanes]",
+        "min([lanes], 2)",
+        "abs(-[lanes])"
+    };
+
+    SECTION("matches tree evaluation") {
+        for (auto const& str : exprs)
+        {
+            INFO(str);
+            mapnik::expression_ptr expr = mapnik::parse_expression(str);
+            mapnik::compiled_expression compiled(expr);
+            CHECK(compiled.size() > 0);
+            for (auto const& f : { feature, other })
+            {
+                mapnik::value_type expected = tree_evaluate(*f, expr, vars);
+                mapnik::value_type result = compiled.evaluate(*f, vars);
+                CHECK(result.which() == expected.which());
+                CHECK(result.to_string() == expected.to_string());
+            }
+        }
+    }
+
+    SECTION("empty filter matches everything") {
+        mapnik::compiled_expression compiled(mapnik::expression_ptr{});
+        CHECK(compiled.evaluate(*feature, vars).to_bool());
+    }
+}
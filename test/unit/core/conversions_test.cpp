@@ -8,6 +8,10 @@
 #include <iostream>
 #include <unordered_map>
 #include <sstream>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
 
 #if defined(_MSC_VER) && _MSC_VER < 1900
 #include <cstdio>
@@ -309,4 +313,78 @@ SECTION("to string") {
     }
 }
 
+
+SECTION("string to number") {
+
+    using mapnik::util::string2double;
+    using mapnik::util::string2float;
+    using mapnik::util::string2int;
+
+    // the plain decimal forms and the spaced or special ones alike
+    for (std::string const in : { "0", "-0", "1.", ".5", "-.5", "+3.25e+2", "00012.5000", "1E-5",
+                                  "0.1", "-122.41941550000001", "9007199254740993", "1e22", "1e23",
+                                  " 42.5", "42.5 " })
+    {
+        INFO(in);
+        double val = -1;
+        REQUIRE( string2double(in, val) );
+        double expected = std::strtod(in.c_str(), nullptr);
+        CHECK( std::abs(val - expected) <= std::abs(expected) * std::numeric_limits<double>::epsilon() );
+        CHECK( std::signbit(val) == std::signbit(expected) );
+    }
+    double d = 0;
+    CHECK( string2double("0.1", d) );
+    CHECK( d == 0.1 );
+    CHECK( string2double("1.23456789", d) );
+    CHECK( d == 1.23456789 );
+    for (std::string const in : { "", "-", ".", "e5", "1e", "1e+", "1.2.3", "1,5", "0x10", "1 2" })
+    {
+        INFO(in);
+        CHECK( !string2double(in, d) );
+    }
+    float f = 0;
+    CHECK( string2float("0.1", f) );
+    CHECK( f == 0.1f );
+    CHECK( string2float("-3.402823e38", f) );
+    CHECK( f == -3.402823e38f );
+    CHECK( !string2float("1.5x", f) );
+
+    int i = 0;
+    CHECK( string2int("123456789", i) );
+    CHECK( i == 123456789 );
+    CHECK( string2int("-2147483648", i) );
+    CHECK( i == std::numeric_limits<int>::min() );
+    CHECK( string2int(" +7 ", i) );
+    CHECK( i == 7 );
+    CHECK( !string2int("2147483648", i) );
+    CHECK( !string2int("1.5", i) );
+    CHECK( !string2int("", i) );
+    CHECK( !string2int("-", i) );
+    mapnik::value_integer v = 0;
+    CHECK( string2int("-123456789", v) );
+    CHECK( v == -123456789 );
+#ifdef BIGINT
+    CHECK( string2int("9223372036854775807", v) );
+    CHECK( v == std::numeric_limits<mapnik::value_integer>::max() );
+    CHECK( !string2int("9223372036854775808", v) );
+#endif
+}
+
+SECTION("to string matches printf") {
+    // the fixed notation values are formatted without printf, ties included
+    for (double val : { 0.0, -0.0, 1e-4, 9.99999e-5, 0.000099999951, 999999.4, 999999.5, 100000.5,
+                        100001.5, 0.1234565, 123456.789, -2.5e-4, 1e6, 1e-7, 1.5e300,
+                        std::numeric_limits<double>::infinity(), std::numeric_limits<double>::denorm_min() })
+    {
+        char expected[32];
+        std::snprintf(expected, sizeof(expected), "%g", val);
+        std::string out("replaced");
+        mapnik::util::to_string(out, val);
+        CHECK( out == expected );
+    }
+    std::string out("1:");
+    mapnik::util::to_string(out, std::numeric_limits<int>::min());
+    CHECK( out == "1:-2147483648" );
+}
+
 }
@@ -0,0 +1,87 @@
+#include "catch.hpp"
+
+#include <mapnik/datasource_metadata_cache.hpp>
+#include <mapnik/params.hpp>
+
+#include <cstdio>
+
+namespace {
+
+mapnik::datasource_metadata make_metadata()
+{
+    mapnik::datasource_metadata metadata;
+    metadata.encoding = "UTF8";
+    metadata.descriptors.emplace_back("name", mapnik::String);
+    metadata.descriptors.emplace_back("id\nwith newline", mapnik::Integer, true);
+    metadata.extent = mapnik::box2d<double>(-180, -85.0511287798066, 180, 85.0511287798066);
+    metadata.geometry_type = mapnik::datasource_geometry_t::Polygon;
+    metadata.extra["srid"] = "4326";
+    metadata.extra["key_field"] = "";
+    return metadata;
+}
+
+}
+
+TEST_CASE("datasource metadata cache") {
+
+mapnik::datasource_metadata_cache & cache = mapnik::datasource_metadata_cache::instance();
+mapnik::parameters params;
+params["type"] = "postgis";
+params["table"] = "roads";
+params["password"] = "secret";
+std::string key = mapnik::datasource_metadata_cache::make_key(params);
+
+SECTION("keys") {
+    CHECK(key.find("secret") == std::string::npos);
+    mapnik::parameters other(params);
+    other["password"] = "other";
+    CHECK(mapnik::datasource_metadata_cache::make_key(other) == key);
+    other["table"] = "rivers";
+    CHECK(mapnik::datasource_metadata_cache::make_key(other) != key);
+}
+
+SECTION("disabled by default") {
+    CHECK(!cache.enabled());
+    cache.insert(key, make_metadata());
+    CHECK(!cache.find(key, ""));
+    CHECK(cache.size() == 0);
+}
+
+SECTION("stamps") {
+    cache.set_enabled(true);
+    auto metadata = make_metadata();
+    metadata.stamp = "100 1500000000";
+    cache.insert(key, metadata);
+    CHECK(cache.find(key, "100 1500000000"));
+    CHECK(!cache.find(key, "101 1500000000"));
+    cache.clear();
+    cache.set_enabled(false);
+}
+
+SECTION("persisted") {
+    cache.set_enabled(true);
+    cache.insert(key, make_metadata());
+    std::string filename("/tmp/mapnik-datasource-metadata-test");
+    REQUIRE(cache.save(filename));
+    cache.clear();
+    CHECK(!cache.find(key, ""));
+    REQUIRE(cache.load(filename));
+    auto metadata = cache.find(key, "");
+    REQUIRE(metadata);
+    CHECK(metadata->encoding == "UTF8");
+    REQUIRE(metadata->descriptors.size() == 2);
+    CHECK(metadata->descriptors[1].get_name() == "id\nwith newline");
+    CHECK(metadata->descriptors[1].get_type() == mapnik::Integer);
+    CHECK(metadata->descriptors[1].is_primary_key());
+    REQUIRE(metadata->extent);
+    CHECK(metadata->extent->maxy() == 85.0511287798066);
+    CHECK(metadata->geometry_type == mapnik::datasource_geometry_t::Polygon);
+    CHECK(metadata->extra.at("srid") == "4326");
+    CHECK(metadata->extra.at("key_field") == "");
+    CHECK(!cache.load(filename + "-missing"));
+    std::remove(filename.c_str());
+    cache.clear();
+    cache.set_enabled(false);
+}
+
+}
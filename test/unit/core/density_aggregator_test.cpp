@@ -0,0 +1,59 @@
+#include "catch.hpp"
+
+#include <mapnik/density_aggregator.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/raster.hpp>
+#include <mapnik/image_any.hpp>
+
+#include <memory>
+
+namespace {
+
+mapnik::feature_ptr make_point(mapnik::context_ptr const& ctx, double x, double y, double weight)
+{
+    mapnik::feature_ptr feature = mapnik::feature_factory::create(ctx, 1);
+    feature->set_geometry(mapnik::geometry::point<double>(x, y));
+    feature->put("weight", weight);
+    return feature;
+}
+
+}
+
+TEST_CASE("density aggregator") {
+
+    auto ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("weight");
+
+SECTION("counts points per cell") {
+
+    mapnik::density_aggregator aggregator(mapnik::box2d<double>(0, 0, 4, 4), 4, 4, "");
+    aggregator.add(*make_point(ctx, 0.5, 3.5, 2.0));
+    aggregator.add(*make_point(ctx, 0.6, 3.4, 2.0));
+    aggregator.add(*make_point(ctx, 3.5, 0.5, 2.0));
+    // outside the extent
+    aggregator.add(*make_point(ctx, 5.0, 5.0, 2.0));
+    mapnik::feature_ptr feature = aggregator.release();
+    REQUIRE(feature->get_raster());
+    mapnik::raster const& grid = *feature->get_raster();
+    REQUIRE(grid.nodata());
+    REQUIRE(*grid.nodata() == 0.0);
+    auto const& data = mapnik::util::get<mapnik::image_gray32f>(grid.data_);
+    REQUIRE(data.width() == 4);
+    REQUIRE(data.height() == 4);
+    CHECK(data(0, 0) == 2.0f);
+    CHECK(data(3, 3) == 1.0f);
+    CHECK(data(1, 1) == 0.0f);
+}
+
+SECTION("sums weights") {
+
+    mapnik::density_aggregator aggregator(mapnik::box2d<double>(0, 0, 4, 4), 2, 2, "weight");
+    aggregator.add(*make_point(ctx, 1.0, 1.0, 2.5));
+    aggregator.add(*make_point(ctx, 1.5, 1.5, 0.5));
+    mapnik::feature_ptr feature = aggregator.release();
+    auto const& data = mapnik::util::get<mapnik::image_gray32f>(feature->get_raster()->data_);
+    CHECK(data(0, 1) == 3.0f);
+}
+
+}
@@ -0,0 +1,107 @@
+#include "catch.hpp"
+
+#include <mapnik/executor.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// runs every task inside post(), counting them
+class inline_executor : public mapnik::executor
+{
+public:
+    void post(task_type task) override
+    {
+        ++posted;
+        task();
+    }
+
+    std::size_t concurrency() const override
+    {
+        return 3;
+    }
+
+    std::atomic<int> posted{0};
+};
+
+}
+
+TEST_CASE("executor") {
+
+SECTION("parallel_for visits every index once") {
+    for (std::size_t threads : { 1, 2, 8 })
+    {
+        std::vector<std::atomic<int>> visits(1000);
+        for (auto & v : visits) v = 0;
+        mapnik::parallel_for(visits.size(), threads, [&](std::size_t i) { ++visits[i]; });
+        for (auto const& v : visits)
+        {
+            CHECK(v == 1);
+        }
+    }
+    mapnik::parallel_for(0, 4, [](std::size_t) { FAIL("no items"); });
+}
+
+SECTION("parallel_for rethrows") {
+    std::atomic<int> calls(0);
+    CHECK_THROWS_AS(mapnik::parallel_for(100, 4, [&](std::size_t i) {
+        ++calls;
+        if (i == 10) throw std::runtime_error("item 10");
+    }), std::runtime_error);
+    CHECK(calls <= 100);
+}
+
+SECTION("parallel_bands covers the rows") {
+    std::vector<std::atomic<int>> rows(257);
+    for (auto & r : rows) r = 0;
+    mapnik::parallel_bands(rows.size(), 4, [&](std::size_t y0, std::size_t y1) {
+        for (std::size_t y = y0; y < y1; ++y) ++rows[y];
+    });
+    for (auto const& r : rows)
+    {
+        CHECK(r == 1);
+    }
+}
+
+SECTION("nested waits do not deadlock") {
+    std::atomic<int> count(0);
+    mapnik::parallel_for(16, 16, [&](std::size_t) {
+        mapnik::parallel_for(16, 16, [&](std::size_t) { ++count; });
+    });
+    CHECK(count == 256);
+}
+
+SECTION("task groups") {
+    std::atomic<int> count(0);
+    mapnik::task_group group;
+    for (int i = 0; i < 64; ++i)
+    {
+        group.run([&] { ++count; });
+    }
+    group.wait();
+    CHECK(count == 64);
+
+    group.run([] { throw std::runtime_error("task"); });
+    group.run([&] { ++count; });
+    CHECK_THROWS_AS(group.wait(), std::runtime_error);
+    CHECK(count == 65);
+    // the error was reported once
+    group.wait();
+}
+
+SECTION("host executors") {
+    auto host = std::make_shared<inline_executor>();
+    mapnik::set_executor(host);
+    CHECK(mapnik::get_executor() == host);
+    std::atomic<int> count(0);
+    mapnik::parallel_for(100, 4, [&](std::size_t) { ++count; });
+    CHECK(count == 100);
+    // the caller's share is not posted
+    CHECK(host->posted == 3);
+    mapnik::set_executor(nullptr);
+    CHECK(mapnik::get_executor() != host);
+}
+
+}
@@ -206,6 +206,17 @@ TEST_CASE("expressions")
     // 'Québec' =~ m:^Q\S*$:
     TRY_CHECK(eval(" [name].match('^Q\\S*$') ") == true);
     TRY_CHECK(parse_and_dump(" [name].match('^Q\\S*$') ") == "[name].match('^Q\\S*$')");
+    // literal patterns
+    TRY_CHECK(eval(" [name].match('Qué.*') ") == true);
+    TRY_CHECK(eval(" [name].match('.*bec') ") == true);
+    TRY_CHECK(eval(" [name].match('^.*éb.*$') ") == true);
+    TRY_CHECK(eval(" [name].match('.*Montréal.*') ") == false);
+    TRY_CHECK(eval(" [name].match('Qué') ") == false);
+    TRY_CHECK(eval(" [name].match('Qu\\.*') ") == false);
+    TRY_CHECK(eval(" [int].match('12.*') ") == true);
+    TRY_CHECK(parse_and_dump(" [name].match('Qué.*') ") == "[name].match('Qué.*')");
+    TRY_CHECK(eval(" 'a.b.c'.replace('\\.','-') ") == tr.transcode("a-b-c"));
+    TRY_CHECK(eval(" [name].replace('bec','bek') ") == tr.transcode("Québek"));
 
     // string & value concatenation
     // this should evaluate as two strings concatenating
@@ -0,0 +1,81 @@
+#include "catch.hpp"
+
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_arena.hpp>
+#include <mapnik/feature_factory.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+TEST_CASE("feature arena") {
+
+SECTION("features are built in the arena") {
+    auto arena = std::make_shared<mapnik::feature_arena>();
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("name");
+    std::vector<mapnik::feature_ptr> features;
+    for (int i = 0; i < 2000; ++i)
+    {
+        features.push_back(mapnik::feature_factory::create(ctx, i, arena));
+        features.back()->put("name", mapnik::value_integer(i));
+        features.back()->set_geometry(mapnik::geometry::point<double>(i, i));
+    }
+    CHECK(arena->num_blocks() > 1);
+    bool intact = true;
+    bool aligned = true;
+    for (int i = 0; i < 2000; ++i)
+    {
+        intact = intact && features[i]->id() == i && features[i]->get("name") == mapnik::value_integer(i);
+        aligned = aligned && reinterpret_cast<std::uintptr_t>(features[i].get()) % alignof(std::max_align_t) == 0;
+    }
+    CHECK(intact);
+    CHECK(aligned);
+    // the arena outlives its owner while features are alive
+    std::weak_ptr<mapnik::feature_arena> weak = arena;
+    arena.reset();
+    CHECK(!weak.expired());
+    features.clear();
+    CHECK(weak.expired());
+}
+
+SECTION("released blocks are recycled") {
+    auto arena = std::make_shared<mapnik::feature_arena>();
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    // a streaming featureset only keeps the current feature alive
+    mapnik::value_integer sum = 0;
+    for (int i = 0; i < 100000; ++i)
+    {
+        mapnik::feature_ptr feature = mapnik::feature_factory::create(ctx, i, arena);
+        sum += feature->id();
+    }
+    CHECK(sum == mapnik::value_integer(100000) * 99999 / 2);
+    CHECK(arena->num_blocks() <= 2);
+}
+
+SECTION("blocks behind a kept feature are recycled") {
+    auto arena = std::make_shared<mapnik::feature_arena>();
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    // the first feature is kept for the whole query, the others while a
+    // window of the following ones is processed
+    mapnik::feature_ptr first = mapnik::feature_factory::create(ctx, 0, arena);
+    std::deque<mapnik::feature_ptr> window;
+    for (int i = 1; i < 100000; ++i)
+    {
+        window.push_back(mapnik::feature_factory::create(ctx, i, arena));
+        if (window.size() > 100) window.pop_front();
+        if (i == 20000) CHECK(arena->num_blocks() <= 6);
+    }
+    // steady state: the block count does not grow with the features read
+    CHECK(arena->num_blocks() <= 6);
+    CHECK(first->id() == 0);
+}
+
+SECTION("no arena") {
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature = mapnik::feature_factory::create(ctx, 7, mapnik::feature_arena_ptr());
+    CHECK(feature->id() == 7);
+}
+
+}
@@ -0,0 +1,42 @@
+#include "catch.hpp"
+
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+
+TEST_CASE("feature bounds") {
+
+SECTION("envelope and type follow the geometry") {
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    CHECK_FALSE(feature->envelope().valid());
+    CHECK(feature->geometry_type() == mapnik::geometry::geometry_types::Unknown);
+
+    mapnik::geometry::line_string<double> line;
+    line.emplace_back(0, 0);
+    line.emplace_back(10, 5);
+    feature->set_geometry(std::move(line));
+    CHECK(feature->envelope() == mapnik::box2d<double>(0, 0, 10, 5));
+    CHECK(feature->geometry_type() == mapnik::geometry::geometry_types::LineString);
+
+    feature->set_geometry_copy(mapnik::geometry::point<double>(3, 4));
+    CHECK(feature->envelope() == mapnik::box2d<double>(3, 4, 3, 4));
+    CHECK(feature->geometry_type() == mapnik::geometry::geometry_types::Point);
+
+    // changed in place
+    feature->get_geometry().get<mapnik::geometry::point<double>>().x = 7;
+    feature->reset_bounds();
+    CHECK(feature->envelope() == mapnik::box2d<double>(7, 4, 7, 4));
+}
+
+SECTION("datasources may supply the envelope") {
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::multi_point<double> points;
+    points.emplace_back(1, 1);
+    points.emplace_back(2, 3);
+    feature->set_geometry(std::move(points), mapnik::box2d<double>(0, 0, 4, 4));
+    CHECK(feature->envelope() == mapnik::box2d<double>(0, 0, 4, 4));
+    CHECK(feature->geometry_type() == mapnik::geometry::geometry_types::MultiPoint);
+}
+
+}
@@ -0,0 +1,162 @@
+#include "catch.hpp"
+
+#include <mapnik/feature_cache.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/params.hpp>
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/geometry_pyramid.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/util/fs.hpp>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace {
+
+mapnik::feature_cache::features_ptr make_features(std::size_t count)
+{
+    auto ctx = std::make_shared<mapnik::context_type>();
+    auto features = std::make_shared<mapnik::feature_cache::features_type>();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        features->push_back(mapnik::feature_factory::create(ctx, i));
+    }
+    return features;
+}
+
+}
+
+TEST_CASE("feature cache") {
+
+mapnik::feature_cache & cache = mapnik::feature_cache::instance();
+mapnik::parameters params;
+params["type"] = "memory";
+auto ds = std::make_shared<mapnik::memory_datasource>(params);
+mapnik::query q(mapnik::box2d<double>(0, 0, 256, 256));
+
+SECTION("disabled by default") {
+    CHECK(cache.max_features() == 0);
+    cache.insert(ds, q, make_features(1));
+    CHECK(!cache.find(ds, q));
+}
+
+SECTION("find returns inserted features") {
+    cache.set_max_features(10);
+    auto features = make_features(3);
+    cache.insert(ds, q, features);
+    CHECK(cache.find(ds, q) == features);
+    mapnik::query other(mapnik::box2d<double>(256, 0, 512, 256));
+    CHECK(!cache.find(ds, other));
+    mapnik::query with_names(q);
+    with_names.add_property_name("name");
+    CHECK(!cache.find(ds, with_names));
+    cache.clear();
+    cache.set_max_features(0);
+}
+
+SECTION("queries differing in their variables do not share features") {
+    cache.set_max_features(10);
+    mapnik::query tenant_a(q);
+    tenant_a.set_variables({{"tenant", mapnik::value_integer(1)}});
+    mapnik::query tenant_b(q);
+    tenant_b.set_variables({{"tenant", mapnik::value_integer(2)}});
+    mapnik::query tenant_string(q);
+    tenant_string.set_variables({{"tenant", mapnik::value_unicode_string("1")}});
+    auto features = make_features(2);
+    cache.insert(ds, tenant_a, features);
+    CHECK(cache.find(ds, tenant_a) == features);
+    CHECK(!cache.find(ds, tenant_b));
+    CHECK(!cache.find(ds, tenant_string));
+    CHECK(!cache.find(ds, q));
+    cache.clear();
+    cache.set_max_features(0);
+}
+
+SECTION("least recently used entries are evicted") {
+    cache.set_max_features(4);
+    mapnik::query q2(mapnik::box2d<double>(256, 0, 512, 256));
+    mapnik::query q3(mapnik::box2d<double>(512, 0, 768, 256));
+    cache.insert(ds, q, make_features(2));
+    cache.insert(ds, q2, make_features(2));
+    CHECK(cache.find(ds, q));
+    cache.insert(ds, q3, make_features(2));
+    CHECK(cache.find(ds, q));
+    CHECK(!cache.find(ds, q2));
+    CHECK(cache.find(ds, q3));
+    cache.clear();
+    cache.set_max_features(0);
+}
+
+SECTION("entries expire") {
+    cache.set_max_features(10);
+    cache.set_ttl(std::chrono::milliseconds(1));
+    cache.insert(ds, q, make_features(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    CHECK(!cache.find(ds, q));
+    CHECK(cache.size() == 0);
+    cache.set_ttl(std::chrono::milliseconds(0));
+    cache.set_max_features(0);
+}
+
+SECTION("pyramid levels are cached apart from their datasource") {
+    std::string csv_plugin("./plugins/input/csv.input");
+    if (mapnik::util::exists(csv_plugin))
+    {
+        mapnik::parameters csv;
+        csv["type"] = "csv";
+        csv["inline"] = "wkt\n\"LINESTRING(0 0,250 3,500 0,750 3,1000 0)\"\n";
+        mapnik::datasource_ptr lines = mapnik::datasource_cache::instance().create(csv);
+        REQUIRE(lines != nullptr);
+
+        mapnik::Map map(256, 256);
+        mapnik::feature_type_style style;
+        mapnik::rule r;
+        r.append(mapnik::line_symbolizer());
+        style.add_rule(std::move(r));
+        map.insert_style("lines", std::move(style));
+        mapnik::layer lyr("lines");
+        lyr.set_datasource(lines);
+        lyr.add_style("lines");
+        lyr.set_cache_features(true);
+        lyr.set_geometry_pyramid(true);
+        map.add_layer(lyr);
+        map.zoom_to_box(mapnik::box2d<double>(0, -500, 1000, 500));
+
+        cache.set_max_features(10);
+        mapnik::image_rgba8 simplified(256, 256);
+        mapnik::agg_renderer<mapnik::image_rgba8> ren1(map, simplified);
+        ren1.apply();
+        CHECK(cache.size() == 1);
+
+        // the same query without the pyramid reads the datasource itself
+        // rather than the simplified features stored above
+        map.get_layer(0).set_geometry_pyramid(false);
+        mapnik::image_rgba8 full(256, 256);
+        mapnik::agg_renderer<mapnik::image_rgba8> ren2(map, full);
+        ren2.apply();
+        CHECK(cache.size() == 2);
+
+        cache.clear();
+        cache.set_max_features(0);
+        mapnik::geometry_pyramid::instance().clear();
+    }
+}
+
+SECTION("quantize snaps to a power of two grid") {
+    mapnik::box2d<double> box = mapnik::feature_cache::quantize(mapnik::box2d<double>(10, 10, 70, 40));
+    CHECK(box == mapnik::box2d<double>(0, 0, 128, 64));
+    CHECK(mapnik::feature_cache::quantize(mapnik::box2d<double>(12, 12, 72, 42)) == box);
+}
+
+}
@@ -0,0 +1,71 @@
+#include "catch.hpp"
+
+#include <mapnik/util/handle_pool.hpp>
+
+#include <memory>
+
+namespace {
+
+struct counting_closer
+{
+    void operator()(int * handle) const
+    {
+        ++closed;
+        delete handle;
+    }
+    static int closed;
+};
+
+int counting_closer::closed = 0;
+
+using pool_type = mapnik::util::handle_pool<int, counting_closer>;
+
+}
+
+TEST_CASE("handle pool") {
+
+int opened = 0;
+counting_closer::closed = 0;
+auto pool = std::make_shared<pool_type>([&opened]() {
+        return pool_type::handle_type(new int(++opened));
+    }, 1);
+
+SECTION("handles are used by one caller at a time") {
+    auto a = pool->acquire();
+    auto b = pool->acquire();
+    CHECK(opened == 2);
+    CHECK(*a != *b);
+}
+
+SECTION("released handles are reused") {
+    int first = 0;
+    {
+        auto a = pool->acquire();
+        first = *a;
+    }
+    CHECK(pool->idle() == 1);
+    auto b = pool->acquire();
+    CHECK(*b == first);
+    CHECK(opened == 1);
+}
+
+SECTION("surplus handles are closed") {
+    {
+        auto a = pool->acquire();
+        auto b = pool->acquire();
+    }
+    CHECK(pool->idle() == 1);
+    CHECK(counting_closer::closed == 1);
+}
+
+SECTION("handed out handles outlive the pool") {
+    pool->add(pool_type::handle_type(new int(0)));
+    auto a = pool->acquire();
+    CHECK(*a == 0);
+    pool.reset();
+    CHECK(counting_closer::closed == 0);
+    a.reset();
+    CHECK(counting_closer::closed == 1);
+}
+
+}
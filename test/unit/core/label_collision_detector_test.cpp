@@ -0,0 +1,55 @@
+#include "catch.hpp"
+
+#include <mapnik/label_collision_detector.hpp>
+
+TEST_CASE("label occupancy grid") {
+
+mapnik::box2d<double> extent(0, 0, 256, 256);
+
+SECTION("only cells wholly inside a label are marked") {
+    mapnik::label_occupancy_grid grid(extent);
+    grid.insert(mapnik::box2d<double>(4, 4, 20, 20));
+    // the cell from 8 to 16 along x and 0 to 8 along y is only partly covered
+    CHECK_FALSE(grid.occupied(mapnik::box2d<double>(9, 1, 15, 3)));
+    CHECK(grid.occupied(mapnik::box2d<double>(9, 9, 10, 10)));
+    // reaching into the covered cell from outside of it
+    CHECK(grid.occupied(mapnik::box2d<double>(0, 14, 8, 30)));
+    CHECK_FALSE(grid.occupied(mapnik::box2d<double>(30, 30, 40, 40)));
+    grid.clear();
+    CHECK_FALSE(grid.occupied(mapnik::box2d<double>(9, 9, 10, 10)));
+}
+
+SECTION("boxes beyond the extent") {
+    mapnik::label_occupancy_grid grid(extent);
+    grid.insert(mapnik::box2d<double>(-1e9, -1e9, 1e9, 1e9));
+    CHECK(grid.occupied(mapnik::box2d<double>(255, 255, 300, 300)));
+    CHECK_FALSE(grid.occupied(mapnik::box2d<double>(300, 300, 400, 400)));
+}
+
+SECTION("the detector agrees with its index") {
+    mapnik::label_collision_detector4 detector(extent);
+    detector.insert(mapnik::box2d<double>(100, 100, 140, 120));
+    CHECK_FALSE(detector.has_placement(mapnik::box2d<double>(110, 104, 130, 116)));
+    CHECK_FALSE(detector.has_placement(mapnik::box2d<double>(130, 110, 160, 130)));
+    CHECK(detector.has_placement(mapnik::box2d<double>(141, 100, 160, 120)));
+    CHECK_FALSE(detector.has_placement(mapnik::box2d<double>(141, 100, 160, 120), 2.0));
+    detector.clear();
+    CHECK(detector.has_placement(mapnik::box2d<double>(110, 104, 130, 116)));
+}
+
+SECTION("repeat checks only see labels with the same text") {
+    mapnik::label_collision_detector4 detector(extent);
+    mapnik::value_unicode_string main_street("Main Street");
+    mapnik::value_unicode_string side_street("Side Street");
+    detector.insert(mapnik::box2d<double>(100, 100, 140, 110), main_street);
+    mapnik::box2d<double> nearby(160, 100, 200, 110);
+    CHECK_FALSE(detector.has_placement(nearby, 0.0, main_street, 30.0));
+    CHECK(detector.has_placement(nearby, 0.0, side_street, 30.0));
+    CHECK(detector.has_placement(nearby, 0.0, main_street, 10.0));
+    // the margin is still checked against every label
+    CHECK_FALSE(detector.has_placement(mapnik::box2d<double>(120, 105, 130, 115), 0.0, side_street, 30.0));
+    detector.clear();
+    CHECK(detector.has_placement(nearby, 0.0, main_street, 30.0));
+}
+
+}
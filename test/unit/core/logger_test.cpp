@@ -0,0 +1,60 @@
+#include "catch.hpp"
+
+#include <mapnik/debug.hpp>
+
+#include <sstream>
+
+namespace {
+
+int evaluated = 0;
+
+int evaluate()
+{
+    return ++evaluated;
+}
+
+// one call site, so its cached threshold is reused between calls
+void log_error()
+{
+    MAPNIK_LOG_ERROR(logger_test) << "evaluated " << evaluate();
+}
+
+}
+
+TEST_CASE("logger") {
+
+mapnik::logger::severity_type severity = mapnik::logger::get_severity();
+std::ostringstream output;
+std::streambuf * clog_buf = std::clog.rdbuf(output.rdbuf());
+
+SECTION("filtered out messages are not evaluated") {
+    mapnik::logger::set_severity(mapnik::logger::none);
+    evaluated = 0;
+    for (int i = 0; i < 3; ++i) log_error();
+    CHECK(evaluated == 0);
+    CHECK(output.str().empty());
+
+    mapnik::logger::set_severity(mapnik::logger::error);
+    log_error();
+    CHECK(evaluated == 1);
+    CHECK(output.str().find("evaluated 1") != std::string::npos);
+}
+
+SECTION("object thresholds apply to cached call sites") {
+    mapnik::logger::set_severity(mapnik::logger::none);
+    evaluated = 0;
+    log_error();
+    CHECK(evaluated == 0);
+
+    mapnik::logger::set_object_severity("logger_test", mapnik::logger::error);
+    log_error();
+    CHECK(evaluated == 1);
+
+    mapnik::logger::clear_object_severity();
+    log_error();
+    CHECK(evaluated == 1);
+}
+
+std::clog.rdbuf(clog_buf);
+mapnik::logger::set_severity(severity);
+}
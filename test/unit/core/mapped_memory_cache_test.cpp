@@ -0,0 +1,103 @@
+#include "catch.hpp"
+
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+
+#include <mapnik/mapped_memory_cache.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#pragma GCC diagnostic pop
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+void write_file(std::string const& filename, std::size_t size, char c)
+{
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    out << std::string(size, c);
+}
+
+}
+
+TEST_CASE("mapped memory cache") {
+
+mapnik::mapped_memory_cache & cache = mapnik::mapped_memory_cache::instance();
+cache.clear();
+std::string a("/tmp/mapnik-mapped-a.bin");
+std::string b("/tmp/mapnik-mapped-b.bin");
+std::string c("/tmp/mapnik-mapped-c.bin");
+write_file(a, 40000, 'a');
+write_file(b, 40000, 'b');
+write_file(c, 40000, 'c');
+
+SECTION("hits and misses") {
+    std::size_t hits = cache.hits();
+    std::size_t misses = cache.misses();
+    auto first = cache.find(a, true, mapnik::mapped_access::random);
+    REQUIRE(first);
+    auto second = cache.find(a, true);
+    REQUIRE(second);
+    CHECK(*first == *second);
+    CHECK(cache.hits() == hits + 1);
+    CHECK(cache.misses() == misses + 1);
+    CHECK(cache.size() == 1);
+    CHECK(cache.size_bytes() == (*first)->get_size());
+    // not kept without update_cache
+    CHECK(cache.find(b, false));
+    CHECK(cache.size() == 1);
+    CHECK(!cache.find("/tmp/mapnik-mapped-missing.bin", true));
+}
+
+SECTION("least recently used files are evicted over the budget") {
+    cache.set_max_bytes(100000);
+    std::size_t evictions = cache.evictions();
+    auto region_a = cache.find(a, true);
+    REQUIRE(region_a);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    cache.find(b, true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    cache.find(a, true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    cache.find(c, true);
+    CHECK(cache.size() == 2);
+    CHECK(cache.evictions() == evictions + 1);
+    CHECK(cache.size_bytes() <= 100000);
+    // b was dropped, a is still a hit
+    std::size_t misses = cache.misses();
+    cache.find(a, true);
+    CHECK(cache.misses() == misses);
+    // regions in use stay mapped
+    CHECK(static_cast<char const*>((*region_a)->get_address())[0] == 'a');
+    cache.set_max_bytes(0);
+}
+
+SECTION("changed files are remapped") {
+    cache.set_check_interval(std::chrono::milliseconds(1));
+    auto before = cache.find(a, true);
+    REQUIRE(before);
+    std::size_t invalidations = cache.invalidations();
+    write_file(a, 50000, 'x');
+    boost::filesystem::last_write_time(a, std::time(nullptr) + 10);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    auto after = cache.find(a, true);
+    REQUIRE(after);
+    CHECK(cache.invalidations() == invalidations + 1);
+    CHECK((*after)->get_size() == 50000);
+    CHECK(static_cast<char const*>((*after)->get_address())[0] == 'x');
+    cache.set_check_interval(std::chrono::milliseconds(0));
+}
+
+cache.clear();
+std::remove(a.c_str());
+std::remove(b.c_str());
+std::remove(c.c_str());
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include "catch.hpp"
+
+#include <mapnik/marker.hpp>
+#include <mapnik/marker_cache.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/parse_path.hpp>
+
+TEST_CASE("marker_cache") {
+
+SECTION("built-in markers") {
+    mapnik::marker_cache & cache = mapnik::marker_cache::instance();
+    auto square = cache.find("image://square");
+    REQUIRE(square->is<mapnik::marker_rgba8>());
+    auto ellipse = cache.find("shape://ellipse", true);
+    REQUIRE(ellipse->is<mapnik::marker_svg>());
+    // built-in markers survive clear() and any memory budget
+    cache.set_max_bytes(1);
+    cache.clear();
+    CHECK(cache.find("image://square") == square);
+    CHECK(cache.find("shape://ellipse") == ellipse);
+    CHECK(cache.hits() == 2);
+    cache.set_max_bytes(0);
+}
+
+SECTION("memory budget") {
+    mapnik::marker_cache & cache = mapnik::marker_cache::instance();
+    cache.clear();
+    auto first = cache.find("./test/data/svg/rect.svg", true);
+    REQUIRE(first->is<mapnik::marker_svg>());
+    std::size_t bytes = cache.size_bytes();
+    CHECK(cache.misses() == 1);
+    CHECK(cache.find("./test/data/svg/rect.svg", true) == first);
+    CHECK(cache.hits() == 1);
+    // no budget left for file markers
+    cache.set_max_bytes(1);
+    CHECK(cache.size_bytes() < bytes);
+    CHECK(cache.find("./test/data/svg/rect.svg", true) != first);
+    cache.set_max_bytes(0);
+    cache.clear();
+}
+
+SECTION("preload from style") {
+    mapnik::marker_cache & cache = mapnik::marker_cache::instance();
+    cache.clear();
+    mapnik::Map map(256, 256);
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    mapnik::markers_symbolizer static_sym;
+    mapnik::put(static_sym, mapnik::keys::file, mapnik::parse_path("./test/data/svg/rect.svg"));
+    rule.append(std::move(static_sym));
+    mapnik::markers_symbolizer dynamic_sym;
+    mapnik::put(dynamic_sym, mapnik::keys::file, mapnik::parse_path("./test/data/svg/[name].svg"));
+    rule.append(std::move(dynamic_sym));
+    style.add_rule(std::move(rule));
+    map.insert_style("markers", std::move(style));
+    REQUIRE(cache.preload(map) == 1);
+    cache.find("./test/data/svg/rect.svg", true);
+    CHECK(cache.hits() == 1);
+    cache.clear();
+}
+
+}
@@ -0,0 +1,73 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/memory_report.hpp>
+
+#include <memory>
+
+namespace {
+
+mapnik::feature_ptr make_line(mapnik::context_ptr const& ctx, std::size_t points)
+{
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::line_string<double> line;
+    for (std::size_t i = 0; i < points; ++i) line.emplace_back(i, i);
+    feature->set_geometry(std::move(line));
+    feature->put_new("name", mapnik::value_unicode_string("a road"));
+    return feature;
+}
+
+}
+
+TEST_CASE("memory report") {
+
+SECTION("features grow with their vertices") {
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    std::size_t small = mapnik::estimate_memory(*make_line(ctx, 2));
+    std::size_t large = mapnik::estimate_memory(*make_line(ctx, 1002));
+    CHECK(large - small == 1000 * sizeof(mapnik::geometry::point<double>));
+}
+
+SECTION("a map reports its styles, layers and caches") {
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    CHECK(ds->memory_usage() == 0);
+    for (std::size_t i = 0; i < 10; ++i) ds->push(make_line(ctx, 100));
+    CHECK(ds->memory_usage() >= 10 * 100 * sizeof(mapnik::geometry::point<double>));
+
+    mapnik::Map map(256, 256);
+    mapnik::rule r;
+    r.set_filter(mapnik::parse_expression("[name] = 'a road' and [lanes] > 2"));
+    r.append(mapnik::line_symbolizer());
+    mapnik::feature_type_style style;
+    style.add_rule(std::move(r));
+    map.insert_style("roads", std::move(style));
+    mapnik::layer first("first");
+    first.set_datasource(ds);
+    map.add_layer(first);
+    mapnik::layer second("second");
+    second.set_datasource(ds);
+    map.add_layer(second);
+
+    mapnik::memory_report report = mapnik::make_memory_report(map);
+    REQUIRE(report.styles.size() == 1);
+    CHECK(report.styles[0].name == "roads");
+    CHECK(report.styles[0].bytes > sizeof(mapnik::rule));
+    REQUIRE(report.layers.size() == 2);
+    // the shared datasource is counted with the first layer
+    CHECK(report.layers[0].bytes > ds->memory_usage());
+    CHECK(report.layers[1].bytes < ds->memory_usage());
+    CHECK_FALSE(report.caches.empty());
+    CHECK(report.total() >= report.layers[0].bytes + report.layers[1].bytes + report.styles[0].bytes);
+}
+
+}
@@ -0,0 +1,34 @@
+#include "catch.hpp"
+
+#include <mapnik/numa.hpp>
+#include <mapnik/executor.hpp>
+
+#include <atomic>
+
+TEST_CASE("numa") {
+
+SECTION("topology") {
+    std::size_t nodes = mapnik::numa::node_count();
+    CHECK(nodes >= 1);
+    CHECK(mapnik::numa::current_node() < nodes);
+    CHECK(!mapnik::numa::bind_thread(nodes));
+}
+
+SECTION("pinned pools run tasks") {
+    std::atomic<int> count(0);
+    {
+        mapnik::thread_pool_executor pool(4);
+        mapnik::task_group group(std::shared_ptr<mapnik::executor>(&pool, [](mapnik::executor *) {}));
+        for (int i = 0; i < 100; ++i)
+        {
+            group.run([&] {
+                CHECK(mapnik::numa::current_node() < mapnik::numa::node_count());
+                ++count;
+            });
+        }
+        group.wait();
+    }
+    CHECK(count == 100);
+}
+
+}
@@ -0,0 +1,58 @@
+#include "catch.hpp"
+
+#include <mapnik/parse_cache.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/expression_string.hpp>
+#include <mapnik/parse_path.hpp>
+#include <mapnik/transform/parse_transform.hpp>
+
+TEST_CASE("parse cache") {
+
+SECTION("parse functions share their results") {
+    mapnik::parse_cache & cache = mapnik::parse_cache::instance();
+    cache.clear();
+    std::string const filter("([class]='path') and ([oneway]=1)");
+    mapnik::expression_ptr expr = mapnik::parse_expression(filter);
+    CHECK(mapnik::parse_expression(filter) == expr);
+    CHECK(mapnik::to_expression_string(*expr) == "(([class]='path') and ([oneway]=1))");
+    CHECK(cache.find_expression(filter) == expr);
+
+    mapnik::transform_list_ptr trans = mapnik::parse_transform("rotate(45) scale(2)");
+    CHECK(mapnik::parse_transform("rotate(45) scale(2)") == trans);
+    CHECK(mapnik::parse_transform("rotate(45) scale(2)", "latin1") != trans);
+
+    mapnik::path_expression_ptr path = mapnik::parse_path("icons/[name].svg");
+    CHECK(mapnik::parse_path("icons/[name].svg") == path);
+    CHECK(cache.size() == 4);
+
+    // failures are not remembered
+    CHECK_THROWS(mapnik::parse_expression("[class] = "));
+    CHECK_THROWS(mapnik::parse_expression("[class] = "));
+    CHECK(cache.size() == 4);
+    cache.clear();
+    CHECK(mapnik::parse_expression(filter) != expr);
+}
+
+SECTION("lru eviction") {
+    mapnik::parse_cache & cache = mapnik::parse_cache::instance();
+    std::size_t max_entries = cache.max_entries();
+    cache.clear();
+    cache.set_max_entries(2);
+    mapnik::expression_ptr a = mapnik::parse_expression("[a]=1");
+    mapnik::expression_ptr b = mapnik::parse_expression("[b]=1");
+    CHECK(mapnik::parse_expression("[a]=1") == a);
+    mapnik::parse_expression("[c]=1");
+    CHECK(cache.size() == 2);
+    CHECK(cache.find_expression("[a]=1") == a);
+    CHECK_FALSE(cache.find_expression("[b]=1"));
+    // the limit applies to each kind of result
+    mapnik::parse_path("[a].png");
+    CHECK(cache.size() == 3);
+    cache.set_max_entries(0);
+    CHECK(cache.size() == 0);
+    CHECK(mapnik::parse_expression("[a]=1") != a);
+    CHECK(cache.size() == 0);
+    cache.set_max_entries(max_entries);
+}
+
+}
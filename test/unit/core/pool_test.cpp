@@ -0,0 +1,87 @@
+#include "catch.hpp"
+
+#include <mapnik/pool.hpp>
+
+#include <memory>
+#include <thread>
+
+namespace {
+
+struct dummy_connection
+{
+    bool ok = true;
+    bool isOK() const { return ok; }
+};
+
+template <typename T>
+struct dummy_creator
+{
+    T* operator()() const { return new T(); }
+};
+
+using dummy_pool = mapnik::Pool<dummy_connection, dummy_creator>;
+
+}
+
+TEST_CASE("pool") {
+
+SECTION("warm up opens initial size") {
+    dummy_pool pool(dummy_creator<dummy_connection>(), 3, 5);
+    CHECK(pool.size() == 0);
+    pool.warm_up();
+    CHECK(pool.size() == 3);
+    pool.warm_up();
+    CHECK(pool.size() == 3);
+    pool.set_initial_size(4);
+    pool.warm_up();
+    CHECK(pool.size() == 4);
+    CHECK(pool.stats().created == 4);
+}
+
+SECTION("borrow grows up to max size") {
+    dummy_pool pool(dummy_creator<dummy_connection>(), 0, 2);
+    auto a = pool.borrowObject();
+    auto b = pool.borrowObject();
+    auto c = pool.borrowObject();
+    REQUIRE(a);
+    REQUIRE(b);
+    CHECK(a != b);
+    CHECK(!c);
+    mapnik::pool_stats stats = pool.stats();
+    CHECK(stats.size == 2);
+    CHECK(stats.checkouts == 2);
+    CHECK(stats.exhausted == 1);
+    a.reset();
+    CHECK(pool.borrowObject());
+}
+
+SECTION("broken objects are dropped") {
+    dummy_pool pool(dummy_creator<dummy_connection>(), 2, 2);
+    pool.warm_up();
+    {
+        auto a = pool.borrowObject();
+        a->ok = false;
+    }
+    auto b = pool.borrowObject();
+    REQUIRE(b);
+    CHECK(b->isOK());
+    CHECK(pool.size() == 1);
+}
+
+SECTION("threads get their last object back") {
+    dummy_pool pool(dummy_creator<dummy_connection>(), 2, 2);
+    pool.warm_up();
+    std::shared_ptr<dummy_connection> theirs;
+    std::thread([&]() { theirs = pool.borrowObject(); }).join();
+    auto mine = pool.borrowObject();
+    REQUIRE(theirs);
+    REQUIRE(mine);
+    dummy_connection * last = mine.get();
+    theirs.reset();
+    mine.reset();
+    // both objects are free now and ours is the second one
+    CHECK(pool.borrowObject().get() == last);
+    CHECK(pool.stats().affinity_hits == 1);
+}
+
+}
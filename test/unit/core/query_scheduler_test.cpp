@@ -0,0 +1,163 @@
+#include "catch.hpp"
+
+#include <mapnik/query_scheduler.hpp>
+#include <mapnik/featureset.hpp>
+#include <mapnik/executor.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+struct counting_featureset : mapnik::Featureset
+{
+    explicit counting_featureset(int id_) : id(id_) {}
+    mapnik::feature_ptr next() { return mapnik::feature_ptr(); }
+    int id;
+};
+
+// runs every task inside post(), counting them
+class inline_executor : public mapnik::executor
+{
+public:
+    explicit inline_executor(std::size_t threads)
+        : threads_(threads) {}
+
+    void post(task_type task) override
+    {
+        ++posted;
+        task();
+    }
+
+    std::size_t concurrency() const override
+    {
+        return threads_;
+    }
+
+    std::atomic<int> posted{0};
+
+private:
+    std::size_t threads_;
+};
+
+int id_of(mapnik::featureset_ptr const& fs)
+{
+    return static_cast<counting_featureset const&>(*fs).id;
+}
+
+}
+
+TEST_CASE("query scheduler") {
+
+mapnik::query_scheduler & scheduler = mapnik::query_scheduler::instance();
+
+SECTION("get returns the featureset") {
+    std::vector<mapnik::query_handle> handles;
+    for (int i = 0; i < 8; ++i)
+    {
+        handles.push_back(scheduler.submit("test-get", [i]() {
+            return std::make_shared<counting_featureset>(i);
+        }));
+    }
+    for (int i = 0; i < 8; ++i)
+    {
+        REQUIRE(handles[i].valid());
+        mapnik::featureset_ptr fs = handles[i].get();
+        REQUIRE(fs);
+        CHECK(id_of(fs) == i);
+        CHECK(!handles[i].valid());
+    }
+}
+
+SECTION("exceptions are rethrown by get") {
+    mapnik::query_handle handle = scheduler.submit("test-error", []() -> mapnik::featureset_ptr {
+        throw std::runtime_error("query failed");
+    });
+    CHECK_THROWS_AS(handle.get(), std::runtime_error);
+}
+
+SECTION("cancelled queries do not run") {
+    std::atomic<int> runs(0);
+    // keep the workers away from the query by exhausting the budget
+    scheduler.set_budget("test-cancel", 1);
+    std::atomic<bool> release(false);
+    mapnik::query_handle blocker = scheduler.submit("test-cancel", [&]() {
+        while (!release) {}
+        return mapnik::featureset_ptr();
+    });
+    mapnik::query_handle handle = scheduler.submit("test-cancel", [&]() {
+        ++runs;
+        return mapnik::featureset_ptr();
+    });
+    handle.cancel();
+    CHECK(!handle.valid());
+    release = true;
+    blocker.get();
+    CHECK(runs == 0);
+    CHECK(scheduler.in_flight("test-cancel") == 0);
+}
+
+SECTION("budget limits concurrent queries") {
+    scheduler.reserve_threads(4);
+    scheduler.set_budget("test-budget", 2);
+    CHECK(scheduler.budget("test-budget") == 2);
+    std::atomic<int> running(0);
+    std::atomic<int> peak(0);
+    std::vector<mapnik::query_handle> handles;
+    for (int i = 0; i < 16; ++i)
+    {
+        handles.push_back(scheduler.submit("test-budget", [&, i]() {
+            int now = ++running;
+            int seen = peak;
+            while (now > seen && !peak.compare_exchange_weak(seen, now)) {}
+            for (volatile int spin = 0; spin < 100000; ++spin) {}
+            --running;
+            return std::make_shared<counting_featureset>(i);
+        }));
+    }
+    for (int i = 0; i < 16; ++i)
+    {
+        CHECK(id_of(handles[i].get()) == i);
+    }
+    CHECK(peak <= 2);
+    CHECK(scheduler.in_flight("test-budget") == 0);
+}
+
+SECTION("queries run on the I/O executor, never inside submit") {
+    scheduler.reserve_threads(2);
+    auto cpu = std::make_shared<inline_executor>(0);
+    mapnik::set_executor(cpu);
+    std::atomic<int> runs(0);
+    std::vector<mapnik::query_handle> handles;
+    for (int i = 0; i < 4; ++i)
+    {
+        handles.push_back(scheduler.submit("test-io", [&, i]() {
+            ++runs;
+            return std::make_shared<counting_featureset>(i);
+        }));
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        CHECK(id_of(handles[i].get()) == i);
+    }
+    CHECK(cpu->posted == 0);
+
+    // an I/O executor without threads leaves the queries to get()
+    auto io = std::make_shared<inline_executor>(0);
+    mapnik::set_io_executor(io);
+    CHECK(scheduler.threads() == 0);
+    runs = 0;
+    mapnik::query_handle handle = scheduler.submit("test-io", [&]() {
+        ++runs;
+        return std::make_shared<counting_featureset>(7);
+    });
+    CHECK(runs == 0);
+    CHECK(io->posted == 0);
+    CHECK(id_of(handle.get()) == 7);
+    CHECK(runs == 1);
+    mapnik::set_io_executor(nullptr);
+    mapnik::set_executor(nullptr);
+}
+
+}
@@ -0,0 +1,83 @@
+#include "catch.hpp"
+
+#include <mapnik/rule_bands.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/symbolizer.hpp>
+
+namespace {
+
+mapnik::rule make_rule(std::string const& filter, double min_scale, double max_scale)
+{
+    mapnik::rule r;
+    r.set_filter(mapnik::parse_expression(filter));
+    r.set_min_scale(min_scale);
+    r.set_max_scale(max_scale);
+    mapnik::line_symbolizer sym;
+    mapnik::put(sym, mapnik::keys::stroke_width, mapnik::parse_expression("[width]"));
+    r.append(std::move(sym));
+    return r;
+}
+
+}
+
+TEST_CASE("rule bands") {
+
+mapnik::feature_type_style style;
+style.add_rule(make_rule("[a] = 1", 0, 1000));
+style.add_rule(make_rule("[b] = 1", 500, 2000));
+mapnik::attributes vars;
+
+SECTION("bands follow the scale limits of the rules") {
+    auto low = style.rule_band_at(100, vars);
+    CHECK(low->active);
+    CHECK(low->rules.get_if_rules().size() == 1);
+    CHECK(low->names == std::set<std::string>{"a", "width"});
+    CHECK_FALSE(low->filter_factor);
+
+    auto middle = style.rule_band_at(700, vars);
+    CHECK(middle->rules.get_if_rules().size() == 2);
+    CHECK(middle->names == std::set<std::string>{"a", "b", "width"});
+
+    auto high = style.rule_band_at(1500, vars);
+    CHECK(high->rules.get_if_rules().size() == 1);
+    CHECK(high->names == std::set<std::string>{"b", "width"});
+
+    CHECK_FALSE(style.rule_band_at(5000, vars)->active);
+}
+
+SECTION("renders within a band share it") {
+    auto first = style.rule_band_at(600, vars);
+    CHECK(style.rule_band_at(900, vars) == first);
+    CHECK(style.rule_band_at(1200, vars) != first);
+    // other variables make another band
+    mapnik::attributes other;
+    other["zoom"] = mapnik::value_integer(3);
+    auto with_vars = style.rule_band_at(600, other);
+    CHECK(with_vars != first);
+    CHECK(style.rule_band_at(600, other) == with_vars);
+}
+
+SECTION("changing the rules drops the bands") {
+    auto first = style.rule_band_at(100, vars);
+    style.add_rule(make_rule("[c] = 1", 0, 200));
+    auto second = style.rule_band_at(100, vars);
+    CHECK(second != first);
+    CHECK(second->rules.get_if_rules().size() == 2);
+    CHECK(second->names.count("c") == 1);
+}
+
+SECTION("raster symbolizers set the filter factor") {
+    mapnik::feature_type_style raster_style;
+    mapnik::rule r;
+    mapnik::raster_symbolizer sym;
+    mapnik::put(sym, mapnik::keys::filter_factor, 3.0);
+    r.append(std::move(sym));
+    raster_style.add_rule(std::move(r));
+    auto band = raster_style.rule_band_at(100, vars);
+    REQUIRE(band->filter_factor);
+    CHECK(*band->filter_factor == Approx(3.0));
+}
+
+}
@@ -0,0 +1,188 @@
+#include "catch.hpp"
+
+#include <mapnik/rule_cache.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/symbolizer.hpp>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<mapnik::rule> make_rules(std::vector<std::string> const& filters)
+{
+    std::vector<mapnik::rule> rules(filters.size());
+    for (std::size_t i = 0; i < filters.size(); ++i)
+    {
+        rules[i].set_filter(mapnik::parse_expression(filters[i]));
+    }
+    return rules;
+}
+
+mapnik::rule_cache::rule_indices linear_matches(mapnik::rule_cache const& rc, mapnik::feature_impl const& f)
+{
+    mapnik::rule_cache::rule_indices result;
+    for (std::size_t i = 0; i < rc.get_if_filters().size(); ++i)
+    {
+        if (rc.get_if_filters()[i].evaluate(f, mapnik::attributes()).to_bool())
+        {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+}
+
+TEST_CASE("rule_cache") {
+
+SECTION("dispatches on equality cascades") {
+    std::vector<mapnik::rule> rules = make_rules({
+        "[highway] = 'motorway'",
+        "[highway] = 'primary' or 'trunk' = [highway]",
+        "[lanes] > 2",
+        "[highway] = 'secondary'",
+        "[highway] = 5",
+        "[highway] = 'primary'"
+    });
+    mapnik::rule_cache rc;
+    for (auto const& r : rules) rc.add_rule(r);
+    rc.build_index();
+    REQUIRE(rc.indexed());
+    CHECK(rc.index_attribute() == "highway");
+
+    mapnik::transcoder tr("utf8");
+    auto ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("highway");
+    ctx->push("lanes");
+    std::vector<mapnik::value> values = {
+        tr.transcode("primary"), tr.transcode("trunk"), tr.transcode("footway"),
+        mapnik::value_integer(5), mapnik::value_double(5.0), mapnik::value_double(5.5),
+        mapnik::value_bool(true), mapnik::value_null()
+    };
+    for (auto const& val : values)
+    {
+        INFO(val.to_string());
+        mapnik::feature_ptr f(mapnik::feature_factory::create(ctx, 1));
+        f->put("highway", val);
+        f->put("lanes", mapnik::value_integer(3));
+        mapnik::rule_cache::rule_indices candidates;
+        REQUIRE(rc.select_if_rules(*f, candidates));
+        CHECK(candidates == linear_matches(rc, *f));
+    }
+}
+
+SECTION("falls back without enough keyed rules") {
+    std::vector<mapnik::rule> rules = make_rules({
+        "[highway] = 'motorway'",
+        "[highway] = 'primary' and [lanes] > 2",
+        "[lanes] = 1",
+        "[name] = 'x'"
+    });
+    mapnik::rule_cache rc;
+    for (auto const& r : rules) rc.add_rule(r);
+    rc.build_index();
+    CHECK_FALSE(rc.indexed());
+    auto ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr f(mapnik::feature_factory::create(ctx, 1));
+    mapnik::rule_cache::rule_indices candidates;
+    CHECK_FALSE(rc.select_if_rules(*f, candidates));
+}
+
+SECTION("finds exclusive rules") {
+    auto exclusive = [](std::vector<std::string> const& filters)
+    {
+        std::vector<mapnik::rule> rules = make_rules(filters);
+        mapnik::rule_cache rc;
+        for (auto const& r : rules) rc.add_rule(r);
+        rc.build_index();
+        return rc.exclusive();
+    };
+    CHECK(exclusive({"[type] = 'a'", "[type] = 'b' or [type] = 'c'", "[type] = 1", "[type] = 2"}));
+    CHECK(exclusive({"[pop] < 1000", "[pop] >= 1000 and [pop] < 10000", "10000 <= [pop]", "[pop] = 'unknown'"}));
+    CHECK(exclusive({"[pop] > 5", "[pop] = 5", "[pop] < 5"}));
+    CHECK_FALSE(exclusive({"[pop] <= 1000", "[pop] >= 1000"}));
+    CHECK_FALSE(exclusive({"[pop] < 10", "[pop] = 5.0"}));
+    CHECK_FALSE(exclusive({"[type] = 'a'", "[type] = 'b' or [type] = 'a'"}));
+    CHECK_FALSE(exclusive({"[type] = 'a'", "[kind] = 'b'"}));
+    CHECK_FALSE(exclusive({"[type] = 'a'", "[type] != 'a'"}));
+    CHECK_FALSE(exclusive({"[pop] < 10", "[pop] >= 10 or [pop] = 'x'"}));
+    CHECK_FALSE(exclusive({"[type] = 'a'"}));
+}
+
+SECTION("evaluates often matched exclusive rules first") {
+    std::vector<mapnik::rule> rules = make_rules({
+        "[type] = 'a'",
+        "[type] = 'b'",
+        "[type] = 'c'"
+    });
+    mapnik::rule_cache rc;
+    for (auto const& r : rules) rc.add_rule(r);
+    rc.build_index();
+    REQUIRE(rc.exclusive());
+    mapnik::rule_cache::rule_indices order;
+    rc.evaluation_order(order);
+    CHECK(order == mapnik::rule_cache::rule_indices({0, 1, 2}));
+    rc.record_matches({1, 10, 5});
+    rc.evaluation_order(order);
+    CHECK(order == mapnik::rule_cache::rule_indices({1, 2, 0}));
+    rc.record_matches({20, 0, 0});
+    rc.evaluation_order(order);
+    CHECK(order == mapnik::rule_cache::rule_indices({0, 1, 2}));
+
+    // rules that can overlap keep their order
+    std::vector<mapnik::rule> overlapping = make_rules({"[pop] > 10", "[pop] > 100"});
+    mapnik::rule_cache rc2;
+    for (auto const& r : overlapping) rc2.add_rule(r);
+    rc2.build_index();
+    rc2.record_matches({1, 10});
+    rc2.evaluation_order(order);
+    CHECK(order == mapnik::rule_cache::rule_indices({0, 1}));
+}
+
+SECTION("pre-evaluates properties of global attributes") {
+    mapnik::rule global_rule;
+    {
+        mapnik::line_symbolizer sym;
+        mapnik::put(sym, mapnik::keys::stroke_width, mapnik::parse_expression("[@width] * 2"));
+        mapnik::put(sym, mapnik::keys::stroke, mapnik::parse_expression("[@color]"));
+        mapnik::put(sym, mapnik::keys::stroke_opacity, mapnik::parse_expression("[opacity]"));
+        global_rule.append(std::move(sym));
+    }
+    mapnik::rule constant_rule;
+    {
+        mapnik::line_symbolizer sym;
+        mapnik::put(sym, mapnik::keys::stroke_width, 3.0);
+        constant_rule.append(std::move(sym));
+    }
+    mapnik::attributes vars;
+    vars["width"] = mapnik::value_integer(3);
+    vars["color"] = mapnik::value_unicode_string("red");
+    mapnik::rule_cache rc;
+    rc.add_rule(global_rule, vars);
+    rc.add_rule(constant_rule, vars);
+    REQUIRE(rc.get_if_rules().size() == 2);
+    CHECK(rc.num_evaluated_rules() == 1);
+    CHECK(rc.get_if_rules()[1] == &constant_rule);
+
+    mapnik::rule const* evaluated = rc.get_if_rules()[0];
+    REQUIRE(evaluated != &global_rule);
+    auto const& sym = evaluated->get_symbolizers().front().get<mapnik::line_symbolizer>();
+    auto width = sym.properties.find(mapnik::keys::stroke_width);
+    REQUIRE(width->second.is<mapnik::value_double>());
+    CHECK(width->second.get<mapnik::value_double>() == Approx(6.0));
+    auto stroke = sym.properties.find(mapnik::keys::stroke);
+    REQUIRE(stroke->second.is<mapnik::color>());
+    CHECK(stroke->second.get<mapnik::color>() == mapnik::color(255, 0, 0));
+    // feature attributes are still evaluated per feature
+    CHECK(sym.properties.find(mapnik::keys::stroke_opacity)->second.is<mapnik::expression_ptr>());
+    // the original rule is left alone
+    auto const& original = global_rule.get_symbolizers().front().get<mapnik::line_symbolizer>();
+    CHECK(original.properties.find(mapnik::keys::stroke_width)->second.is<mapnik::expression_ptr>());
+}
+
+}
@@ -0,0 +1,45 @@
+#include "catch.hpp"
+
+#include <mapnik/trace.hpp>
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+TEST_CASE("trace") {
+
+SECTION("nothing is recorded while disabled") {
+    mapnik::trace::clear();
+    mapnik::trace::set_enabled(false);
+    {
+        mapnik::trace::scope event("test", "disabled");
+    }
+    std::ostringstream out;
+    mapnik::trace::write_chrome_json(out);
+    CHECK(out.str().find("\"disabled\"") == std::string::npos);
+}
+
+SECTION("events of every thread are dumped as chrome trace json") {
+    mapnik::trace::clear();
+    mapnik::trace::set_enabled(true);
+    {
+        std::string detail("layer \"roads\"");
+        mapnik::trace::scope event("test", "outer", detail);
+        mapnik::trace::scope inner("test", "inner");
+    }
+    std::thread worker([] { mapnik::trace::scope event("test", "worker"); });
+    worker.join();
+    mapnik::trace::set_enabled(false);
+
+    std::ostringstream out;
+    mapnik::trace::write_chrome_json(out);
+    std::string json = out.str();
+    CHECK(json.find("{\"traceEvents\":[") == 0);
+    CHECK(json.find("\"name\":\"outer\",\"cat\":\"test\",\"ph\":\"X\"") != std::string::npos);
+    CHECK(json.find("\"name\":\"inner\"") != std::string::npos);
+    CHECK(json.find("\"name\":\"worker\"") != std::string::npos);
+    CHECK(json.find("\"args\":{\"detail\":\"layer \\\"roads\\\"\"}") != std::string::npos);
+    mapnik::trace::clear();
+}
+
+}
@@ -0,0 +1,40 @@
+#include "catch.hpp"
+
+#include <mapnik/unicode.hpp>
+
+#include <string>
+
+TEST_CASE("transcoder") {
+
+SECTION("interned strings convert like the others") {
+    mapnik::transcoder utf8("utf8");
+    mapnik::transcoder latin1("ISO-8859-1");
+    std::string name("Z\xc3\xbcrich");
+    std::string out;
+    for (int i = 0; i < 2; ++i)
+    {
+        mapnik::value_unicode_string ustr = utf8.transcode(name.c_str());
+        CHECK(ustr.length() == 6);
+        mapnik::to_utf8(ustr, out);
+        CHECK(out == name);
+        ustr = utf8.transcode(name.data(), static_cast<std::int32_t>(name.size()));
+        CHECK(ustr.length() == 6);
+        // the same bytes in another encoding are another string
+        ustr = latin1.transcode(name.c_str());
+        CHECK(ustr.length() == 7);
+        mapnik::to_utf8(ustr, out);
+        CHECK(out == "Z\xc3\x83\xc2\xbcrich");
+    }
+}
+
+SECTION("prefixes and long strings") {
+    mapnik::transcoder utf8("utf8");
+    std::string text(200, 'a');
+    for (std::int32_t length : { 0, 1, 2, 64, 65, 200, 2, 64 })
+    {
+        mapnik::value_unicode_string ustr = utf8.transcode(text.data(), length);
+        CHECK(ustr.length() == length);
+    }
+}
+
+}
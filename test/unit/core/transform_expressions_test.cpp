@@ -2,6 +2,10 @@
 
 #include <mapnik/transform/parse_transform.hpp>
 #include <mapnik/transform/transform_expression.hpp>
+#include <mapnik/transform/transform_processor.hpp>
+#include <mapnik/symbolizer_base.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
 
 namespace {
 
@@ -12,6 +16,11 @@ bool test_transform_expressions(std::string const& in, std::string const& out)
     return mapnik::to_expression_string(*tr_list) == out;
 }
 
+bool same_affine(agg::trans_affine const& lhs, agg::trans_affine const& rhs)
+{
+    return lhs.is_equal(rhs, 1e-9);
+}
+
 }
 
 TEST_CASE("transform-expressions")
@@ -58,3 +67,67 @@ TEST_CASE("transform-expressions")
     CHECK(test_transform_expressions("translate([tx]) rotate([a])", "translate([tx]) rotate([a])"));
     CHECK(test_transform_expressions("rotate(30+@global_value) scale(2*[sx],[sy])", "rotate((30+@global_value)) scale(2*[sx], [sy])"));
 }
+
+TEST_CASE("transform-evaluation-cache")
+{
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("a");
+    ctx->push("tx");
+    mapnik::feature_ptr feature = mapnik::feature_factory::create(ctx, 1);
+    mapnik::attributes vars;
+    vars["offset"] = 4.0;
+
+    auto check = [&](mapnik::transform_list_ptr const& list, agg::trans_affine const& start, double scale_factor)
+    {
+        agg::trans_affine expected(start);
+        mapnik::transform_processor_type::evaluate(expected, *feature, vars, *list, scale_factor);
+        // twice, the second from the cache
+        for (int i = 0; i < 2; ++i)
+        {
+            agg::trans_affine tr(start);
+            mapnik::evaluate_transform(tr, *feature, vars, list, scale_factor);
+            CHECK(same_affine(tr, expected));
+        }
+    };
+
+    SECTION("constant") {
+        auto list = mapnik::parse_transform("translate(10, 20) rotate(30) scale(2, 3) skewX(5)");
+        check(list, agg::trans_affine(), 1.0);
+        check(list, agg::trans_affine(), 2.0);
+        check(list, agg::trans_affine_scaling(1.5), 2.0);
+    }
+
+    SECTION("attribute driven") {
+        auto list = mapnik::parse_transform("rotate([a] * 2) translate(abs([tx]), 1)");
+        for (int i = 0; i < 20; ++i)
+        {
+            feature->put("a", mapnik::value_integer(i % 5));
+            feature->put("tx", -i * 0.5);
+            check(list, agg::trans_affine(), 1.0);
+            check(list, agg::trans_affine_translation(3, 4), 1.5);
+        }
+        // equal values of distinct types are distinct inputs
+        feature->put("a", mapnik::value_unicode_string("2"));
+        check(list, agg::trans_affine(), 1.0);
+        feature->put("a", mapnik::value_double(2.0));
+        check(list, agg::trans_affine(), 1.0);
+    }
+
+    SECTION("variables are always read") {
+        auto list = mapnik::parse_transform("translate(@offset, [tx])");
+        feature->put("tx", 1.0);
+        check(list, agg::trans_affine(), 1.0);
+        vars["offset"] = 8.0;
+        check(list, agg::trans_affine(), 1.0);
+    }
+
+    SECTION("a list replaced at the same address") {
+        agg::trans_affine tr;
+        {
+            auto list = mapnik::parse_transform("scale(2)");
+            mapnik::evaluate_transform(tr, *feature, vars, list, 1.0);
+        }
+        auto list = mapnik::parse_transform("scale(3)");
+        check(list, agg::trans_affine(), 1.0);
+    }
+}
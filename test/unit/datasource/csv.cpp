@@ -842,6 +842,41 @@ TEST_CASE("csv") {
             }
         } // END SECTION
 
+        SECTION("only queried fields are read")
+        {
+            using ustring = mapnik::value_unicode_string;
+            std::string filename = "test/data/csv/leading_zeros.csv";
+            for (auto create_index : { false, true })
+            {
+                // cleanup in the case of a failed previous run
+                if (mapnik::util::exists(filename + ".index"))
+                {
+                    mapnik::util::remove(filename + ".index");
+                }
+                if (create_index)
+                {
+                    int ret = create_disk_index(filename);
+                    int ret_posix = (ret >> 8) & 0x000000ff;
+                    INFO(ret);
+                    INFO(ret_posix);
+                    CHECK(mapnik::util::exists(filename + ".index"));
+                }
+                auto ds = get_csv_ds(filename);
+                mapnik::query query(ds->envelope());
+                query.add_property_name("fips");
+                auto featureset = ds->features(query);
+                auto feature = featureset->next();
+                REQUIRE(bool(feature));
+                CHECK(feature->get("fips") == ustring("001"));
+                CHECK(feature->get("x").is_null());
+                CHECK(feature->get("y").is_null());
+                if (mapnik::util::exists(filename + ".index"))
+                {
+                    mapnik::util::remove(filename + ".index");
+                }
+            }
+        } // END SECTION
+
         SECTION("advanced geometry detection")
         {
             using row = std::pair<std::string, mapnik::datasource_geometry_t>;
@@ -0,0 +1,67 @@
+#include "catch.hpp"
+
+#include "../../../plugins/input/csv/csv_getline.hpp"
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// every record with its stream offset
+std::vector<std::pair<std::string, std::uint64_t>> read_records(std::string const& csv, std::size_t block_size)
+{
+    std::istringstream in(csv);
+    csv_utils::csv_line_reader reader(in, '\n', '"', block_size);
+    std::vector<std::pair<std::string, std::uint64_t>> records;
+    char const* begin;
+    char const* end;
+    while (reader.next(begin, end))
+    {
+        records.emplace_back(std::string(begin, end), reader.offset());
+    }
+    return records;
+}
+
+}
+
+TEST_CASE("csv line reader") {
+
+SECTION("small blocks split records like the default one") {
+    std::string csv = "x,y,name\n"
+                      "0,0,\"a name spanning\nthree\nlines\"\n"
+                      "1,1,a record longer than any of the small blocks below\n"
+                      "\n"
+                      "2,2,\"\"\"quoted\"\" and a comma, inside\"\n"
+                      "3,3,unterminated";
+    auto expected = read_records(csv, 1 << 16);
+    REQUIRE(expected.size() == 6);
+    CHECK(expected[1].first == "0,0,\"a name spanning\nthree\nlines\"");
+    CHECK(expected[3].first.empty());
+    CHECK(expected[5].first == "3,3,unterminated");
+    for (auto const& record : expected)
+    {
+        CHECK(csv.compare(record.second, record.first.size(), record.first) == 0);
+    }
+    for (std::size_t block_size : { 0, 1, 2, 3, 7, 16, 17, 31 })
+    {
+        INFO("block_size " << block_size);
+        CHECK(read_records(csv, block_size) == expected);
+    }
+}
+
+SECTION("a trailing newline ends the last record") {
+    for (std::size_t block_size : { 1, 4, 1 << 16 })
+    {
+        INFO("block_size " << block_size);
+        auto records = read_records("a\nb\n", block_size);
+        REQUIRE(records.size() == 2);
+        CHECK(records[1].first == "b");
+        CHECK(records[1].second == 2);
+        CHECK(read_records("", block_size).empty());
+    }
+}
+
+}
@@ -0,0 +1,219 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#include "catch.hpp"
+
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/util/feature_store.hpp>
+#include <mapnik/util/fs.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+mapnik::geometry::polygon<double> make_square(double x, double y, double size)
+{
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(x, y);
+    ring.emplace_back(x + size, y);
+    ring.emplace_back(x + size, y + size);
+    ring.emplace_back(x, y + size);
+    ring.emplace_back(x, y);
+    poly.push_back(std::move(ring));
+    return poly;
+}
+
+// geometries have no operator==, compare their encodings instead
+std::string encode(mapnik::geometry::geometry<double> const& geom)
+{
+    std::string buffer;
+    mapnik::util::feature_file::encoder enc(buffer);
+    mapnik::util::apply_visitor(enc, geom);
+    return buffer;
+}
+
+std::vector<mapnik::util::feature_file::aligned_block> to_blocks(std::string const& data)
+{
+    std::vector<mapnik::util::feature_file::aligned_block> blocks((data.size() + 15) / 16);
+    std::memcpy(blocks.data(), data.data(), data.size());
+    return blocks;
+}
+
+}
+
+TEST_CASE("feature store") {
+
+SECTION("features round trip") {
+    mapnik::transcoder tr("utf8");
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    std::vector<mapnik::feature_ptr> features;
+    for (int i = 0; i < 100; ++i)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i + 1));
+        feature->put_new("index", mapnik::value_integer(i));
+        feature->put_new("name", tr.transcode(("feature " + std::to_string(i)).c_str()));
+        if (i % 2 == 0) feature->put_new("even", true);
+        if (i % 3 == 0) feature->put_new("third", i / 3.0);
+        if (i % 4 == 0)
+        {
+            mapnik::geometry::multi_polygon<double> multi;
+            multi.push_back(make_square(i, i, 0.5));
+            multi.push_back(make_square(i + 0.5, i + 0.5, 0.5));
+            feature->set_geometry(std::move(multi));
+        }
+        else if (i % 4 == 1)
+        {
+            mapnik::geometry::line_string<double> line;
+            line.emplace_back(i, i);
+            line.emplace_back(i + 1, i + 1);
+            feature->set_geometry(std::move(line));
+        }
+        else if (i % 4 == 2)
+        {
+            feature->set_geometry(mapnik::geometry::point<double>(i + 0.5, i + 0.5));
+        }
+        else
+        {
+            mapnik::geometry::geometry_collection<double> collection;
+            collection.push_back(mapnik::geometry::point<double>(i, i));
+            collection.push_back(make_square(i, i, 1));
+            feature->set_geometry(std::move(collection));
+        }
+        features.push_back(feature);
+    }
+    // an empty geometry is stored but not indexed
+    mapnik::feature_ptr empty(mapnik::feature_factory::create(ctx, 101));
+    features.push_back(empty);
+
+    std::stringstream out(std::ios::in | std::ios::out | std::ios::binary);
+    mapnik::util::feature_store_writer writer(out);
+    for (auto const& feature : features) writer.add(*feature);
+    writer.finish();
+    CHECK(writer.count() == 101);
+
+    std::string data = out.str();
+    auto blocks = to_blocks(data);
+    auto store = std::make_shared<mapnik::util::feature_store>(reinterpret_cast<char const*>(blocks.data()), data.size());
+    CHECK(store->count() == 101);
+    CHECK(store->extent() == mapnik::box2d<double>(0, 0, 100, 100));
+    REQUIRE(store->names().size() == 4);
+
+    std::vector<mapnik::util::index_record> records;
+    store->first(200, records);
+    REQUIRE(records.size() == 101);
+    mapnik::context_ptr read_ctx = store->make_context();
+    bool identical = true;
+    for (std::size_t i = 0; i < records.size(); ++i)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(read_ctx, 0));
+        store->read(records[i], *feature, tr);
+        mapnik::feature_impl const& orig = *features[i];
+        identical = identical && feature->id() == orig.id() &&
+            encode(feature->get_geometry()) == encode(orig.get_geometry()) &&
+            feature->envelope() == orig.envelope();
+        for (auto const& kv : orig)
+        {
+            identical = identical && feature->get(std::get<0>(kv)) == std::get<1>(kv);
+        }
+    }
+    CHECK(identical);
+
+    // spatial queries come back in file order and skip empty geometries
+    auto store_ptr = std::const_pointer_cast<mapnik::util::feature_store const>(store);
+    mapnik::util::feature_store_featureset fs(store_ptr, mapnik::box2d<double>(10.2, 10.2, 20.2, 20.2));
+    std::vector<mapnik::value_integer> ids;
+    while (mapnik::feature_ptr feature = fs.next())
+    {
+        ids.push_back(feature->id());
+        CHECK(feature->get("index") == feature->id() - 1);
+    }
+    std::vector<mapnik::value_integer> expected = { 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21 };
+    CHECK(ids == expected);
+    mapnik::util::feature_store_featureset all(store_ptr, store->extent());
+    std::size_t count = 0;
+    while (all.next()) ++count;
+    CHECK(count == 100);
+}
+
+SECTION("invalid stores are rejected") {
+    std::string data(200, 'x');
+    auto blocks = to_blocks(data);
+    CHECK_THROWS(mapnik::util::feature_store(reinterpret_cast<char const*>(blocks.data()), data.size()));
+
+    std::stringstream out(std::ios::in | std::ios::out | std::ios::binary);
+    {
+        mapnik::util::feature_store_writer writer(out);
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+        feature->set_geometry(mapnik::geometry::point<double>(1, 1));
+        writer.add(*feature);
+        writer.finish();
+    }
+    std::string valid = out.str();
+    auto truncated = to_blocks(valid);
+    CHECK_THROWS(mapnik::util::feature_store(reinterpret_cast<char const*>(truncated.data()), valid.size() / 2));
+}
+
+SECTION("stores are written aside under unique names") {
+    std::string filename = mapnik::util::temp_filename("/tmp/mapnik-feature-store-test");
+    std::string first = mapnik::util::temp_filename(filename);
+    std::string second = mapnik::util::temp_filename(filename);
+    CHECK(first != second);
+    CHECK(mapnik::util::dirname(first) == mapnik::util::dirname(filename));
+    CHECK(first.compare(0, filename.size(), filename) == 0);
+
+    auto leftovers = [&] {
+        auto files = mapnik::util::list_directory(mapnik::util::dirname(filename));
+        std::string prefix = mapnik::util::basename(filename) + ".";
+        return std::count_if(files.begin(), files.end(), [&](std::string const& file) {
+            return mapnik::util::basename(file).compare(0, prefix.size(), prefix) == 0;
+        });
+    };
+
+    mapnik::util::write_feature_store(filename, [](mapnik::util::feature_store_writer & writer) {
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+        feature->set_geometry(mapnik::geometry::point<double>(1, 1));
+        writer.add(*feature);
+    });
+    CHECK(mapnik::util::exists(filename));
+    CHECK(leftovers() == 0);
+
+    // a failed write leaves neither the temporary file nor a new store behind
+    mapnik::util::remove(filename);
+    CHECK_THROWS_AS(mapnik::util::write_feature_store(filename, [](mapnik::util::feature_store_writer &) {
+        throw std::runtime_error("fill failed");
+    }), std::runtime_error);
+    CHECK_FALSE(mapnik::util::exists(filename));
+    CHECK(leftovers() == 0);
+}
+
+}
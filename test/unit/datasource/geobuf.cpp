@@ -228,6 +228,51 @@ TEST_CASE("Geobuf") {
             }
             CHECK(fs->next() == nullptr);
         }
+        SECTION("Features decoded on demand")
+        {
+            auto files =
+                {
+                    "./test/data/geobuf/point.geobuf",
+                    "./test/data/geobuf/multipolygon.geobuf",
+                    "./test/data/geobuf/standalone-feature.geobuf",
+                    "./test/data/geobuf/standalone-geometry.geobuf"
+                };
+            for (auto const& filename : files)
+            {
+                mapnik::parameters params;
+                params["type"] = "geobuf";
+                params["file"] = filename;
+                auto cached = mapnik::datasource_cache::instance().create(params);
+                params["cache_features"] = false;
+                auto ds = mapnik::datasource_cache::instance().create(params);
+                CHECK(ds->envelope() == cached->envelope());
+                CHECK(ds->get_geometry_type() == cached->get_geometry_type());
+                auto const& fields = ds->get_descriptor().get_descriptors();
+                auto const& cached_fields = cached->get_descriptor().get_descriptors();
+                REQUIRE(fields.size() == cached_fields.size());
+                for (std::size_t i = 0; i < fields.size(); ++i)
+                {
+                    CHECK(fields[i].get_name() == cached_fields[i].get_name());
+                    CHECK(fields[i].get_type() == cached_fields[i].get_type());
+                }
+                auto fs0 = all_features(cached);
+                auto fs = all_features(ds);
+                std::size_t count = 0;
+                for (auto f0 = fs0->next(); f0; f0 = fs0->next(), ++count)
+                {
+                    auto f = fs->next();
+                    REQUIRE(f != nullptr);
+                    CHECK(f->envelope() == f0->envelope());
+                    CHECK(f->size() == f0->size());
+                    for (auto const& kv : *f0)
+                    {
+                        CHECK(f->get(std::get<0>(kv)) == std::get<1>(kv));
+                    }
+                }
+                CHECK(count > 0);
+                CHECK(fs->next() == nullptr);
+            }
+        }
         SECTION("GeometryCollection")
         {
             //{"type":"Feature","id":1,"geometry":{"type":"GeometryCollection","geometries":[{"type":"Point","coordinates":[100,0]},{"type":"LineString","coordinates":[[101,0],[102,1]]}]},"properties":{"prop0":"value0","prop1":"{\"this\":\"that\"}"}}
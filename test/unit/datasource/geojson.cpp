@@ -29,6 +29,7 @@
 #include <mapnik/geometry.hpp>
 #include <mapnik/geometry/geometry_type.hpp>
 #include <mapnik/json/geometry_parser.hpp>
+#include <mapnik/json/geojson_stream_reader.hpp>
 #include <mapnik/util/geometry_to_geojson.hpp>
 #include <mapnik/util/fs.hpp>
 #include <cstdlib>
@@ -741,6 +742,196 @@ TEST_CASE("geojson") {
             }
         }
 
+        SECTION("GeoJSON parse_threads")
+        {
+            std::string json = "{\"type\":\"FeatureCollection\",\"features\":[";
+            const mapnik::value_integer num_features = 5000;
+            for (mapnik::value_integer i = 1; i <= num_features; ++i)
+            {
+                if (i > 1) json += ",";
+                json += "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":["
+                    + std::to_string(i % 360 - 180) + "," + std::to_string(i % 180 - 90) + "]},"
+                    + "\"properties\":{\"id\":" + std::to_string(i) + ",\"name\":\"f" + std::to_string(i) + "\"}}";
+            }
+            json += "]}";
+
+            auto read_all = [&](mapnik::value_integer threads)
+            {
+                mapnik::parameters params;
+                params["type"] = "geojson";
+                params["inline"] = json;
+                params["parse_threads"] = threads;
+                auto ds = mapnik::datasource_cache::instance().create(params);
+                REQUIRE(bool(ds));
+                mapnik::query query(ds->envelope());
+                query.add_property_name("id");
+                query.add_property_name("name");
+                std::vector<std::string> result;
+                auto features = ds->features(query);
+                for (auto feature = features->next(); feature; feature = features->next())
+                {
+                    auto const& pt = mapnik::util::get<mapnik::geometry::point<double>>(feature->get_geometry());
+                    result.push_back(std::to_string(feature->id()) + ":"
+                                     + feature->get("id").to_string() + ":" + feature->get("name").to_string() + ":"
+                                     + std::to_string(pt.x) + "," + std::to_string(pt.y));
+                }
+                return result;
+            };
+            std::vector<std::string> expected = read_all(1);
+            CHECK(expected.size() == static_cast<std::size_t>(num_features));
+            CHECK(read_all(4) == expected);
+        }
+
+        SECTION("GeoJSON feature store")
+        {
+            std::string filename("./test/data/json/featurecollection-multipleprops.geojson");
+            // cleanup in the case of a failed previous run
+            if (mapnik::util::exists(filename + ".features"))
+            {
+                mapnik::util::remove(filename + ".features");
+            }
+            auto read_all = [&](bool feature_store)
+            {
+                mapnik::parameters params;
+                params["type"] = "geojson";
+                params["file"] = filename;
+                params["feature_store"] = feature_store;
+                auto ds = mapnik::datasource_cache::instance().create(params);
+                REQUIRE(bool(ds));
+                auto fields = ds->get_descriptor().get_descriptors();
+                std::initializer_list<std::string> names = {"one", "two"};
+                REQUIRE_FIELD_NAMES(fields, names);
+                std::vector<std::string> result;
+                auto features = all_features(ds);
+                for (auto feature = features->next(); feature; feature = features->next())
+                {
+                    std::string geometry;
+                    CHECK(mapnik::util::to_geojson(geometry, feature->get_geometry()));
+                    result.push_back(std::to_string(feature->id()) + ":" + feature->get("one").to_string() + ":"
+                                     + feature->get("two").to_string() + ":" + geometry);
+                }
+                result.push_back(ds->envelope().to_string());
+                return result;
+            };
+            // written on first load, then used instead of the source
+            std::vector<std::string> expected = read_all(true);
+            CHECK(mapnik::util::exists(filename + ".features"));
+            CHECK(read_all(false) == expected);
+            mapnik::util::remove(filename + ".features");
+        }
+
+        SECTION("GeoJSON stream")
+        {
+            auto read_all = [](mapnik::parameters params, bool stream)
+            {
+                params["type"] = "geojson";
+                params["stream"] = stream;
+                auto ds = mapnik::datasource_cache::instance().create(params);
+                REQUIRE(bool(ds));
+                auto fields = ds->get_descriptor().get_descriptors();
+                mapnik::query query(ds->envelope());
+                for (auto const& field : fields)
+                {
+                    query.add_property_name(field.get_name());
+                }
+                std::vector<std::string> result;
+                auto features = ds->features(query);
+                for (auto feature = features->next(); feature; feature = features->next())
+                {
+                    std::string geometry;
+                    CHECK(mapnik::util::to_geojson(geometry, feature->get_geometry()));
+                    std::string line = std::to_string(feature->id()) + ":" + geometry;
+                    for (auto const& field : fields)
+                    {
+                        line += ":" + feature->get(field.get_name()).to_string();
+                    }
+                    result.push_back(line);
+                }
+                result.push_back(ds->envelope().to_string());
+                result.push_back(std::to_string(fields.size()));
+                return result;
+            };
+            for (auto const& filename : { "./test/data/json/featurecollection-multipleprops.geojson",
+                                          "./test/data/json/ordered.json",
+                                          "./test/data/json/feature.json" })
+            {
+                INFO(filename);
+                mapnik::parameters params;
+                params["file"] = filename;
+                CHECK(read_all(params, true) == read_all(params, false));
+            }
+
+            std::string json = "{\"type\":\"FeatureCollection\",\"features\":[";
+            for (int i = 1; i <= 100; ++i)
+            {
+                if (i > 1) json += ",";
+                json += "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":["
+                    + std::to_string(i) + "," + std::to_string(-i) + "]},"
+                    + "\"properties\":{\"name\":\"{[f" + std::to_string(i) + "\\\"]}\"}}";
+            }
+            json += "]}";
+            mapnik::parameters params;
+            params["inline"] = json;
+            auto expected = read_all(params, false);
+            CHECK(expected.size() == 102);
+            CHECK(read_all(params, true) == expected);
+
+            // queries select the features within the box
+            params["type"] = "geojson";
+            params["stream"] = true;
+            auto ds = mapnik::datasource_cache::instance().create(params);
+            mapnik::query query(mapnik::box2d<double>(10.5, -20.5, 20.5, -10.5));
+            CHECK(count_features(ds->features(query)) == 10);
+
+            params["inline"] = "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\"";
+            REQUIRE_THROWS(mapnik::datasource_cache::instance().create(params));
+            params["inline"] = "{\"type\":\"FeatureCollection\",\"features\":[]}";
+            REQUIRE_THROWS(mapnik::datasource_cache::instance().create(params));
+        }
+
+        SECTION("GeoJSON only queried properties are read")
+        {
+            mapnik::parameters params;
+            params["type"] = "geojson";
+            std::string filename("./test/data/json/featurecollection-multipleprops.geojson");
+            params["file"] = filename;
+            // cleanup in the case of a failed previous run
+            if (mapnik::util::exists(filename + ".index"))
+            {
+                mapnik::util::remove(filename + ".index");
+            }
+            for (auto create_index : { true, false })
+            {
+                if (create_index)
+                {
+                    int ret = create_disk_index(filename);
+                    int ret_posix = (ret >> 8) & 0x000000ff;
+                    INFO(ret);
+                    INFO(ret_posix);
+                    CHECK(mapnik::util::exists(filename + ".index"));
+                }
+                params["cache_features"] = false;
+                auto ds = mapnik::datasource_cache::instance().create(params);
+                REQUIRE(bool(ds));
+                std::size_t expected = count_features(all_features(ds));
+                mapnik::query query(ds->envelope());
+                query.add_property_name("one");
+                auto features = ds->features(query);
+                std::size_t count = 0;
+                for (auto feature = features->next(); feature; feature = features->next())
+                {
+                    CHECK(feature->get("two").is_null());
+                    ++count;
+                }
+                CHECK(count == expected);
+                // cleanup
+                if (create_index && mapnik::util::exists(filename + ".index"))
+                {
+                    mapnik::util::remove(filename + ".index");
+                }
+            }
+        }
+
         SECTION("GeoJSON descriptor returns all field names")
         {
             mapnik::parameters params;
@@ -851,3 +1042,55 @@ TEST_CASE("geojson") {
         }
     }
 }
+
+TEST_CASE("geojson_stream_reader")
+{
+    SECTION("features are handed out whatever the chunk size")
+    {
+        std::string const f1 = "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":[1,2]},"
+            "\"properties\":{\"a\":\"}]\\\"[{\"}}";
+        std::string const f2 = "{\"type\":\"Feature\",\"geometry\":null,\"properties\":{}}";
+        std::string const doc = "{\"type\":\"FeatureCollection\",\"bbox\":[1,2,1,2],\"features\":[ " + f1 + " ,\n" + f2
+            + "],\"foreign\":{\"features\":[{\"type\":\"Feature\"}]}}";
+        for (std::size_t chunk_size : { 1, 2, 3, 7, 64, 65536 })
+        {
+            INFO(chunk_size);
+            mapnik::json::geojson_stream_reader reader(doc.data(), doc.data() + doc.size(), chunk_size);
+            std::vector<std::string> features;
+            std::string feature;
+            while (reader.next(feature)) features.push_back(feature);
+            CHECK(feature.empty());
+            REQUIRE(features.size() == 2);
+            CHECK(features[0] == f1);
+            CHECK(features[1] == f2);
+            CHECK(reader.position() == doc.size());
+        }
+    }
+
+    SECTION("top-level features, in sequence")
+    {
+        std::string const doc = "{\"properties\":{\"type\":\"x\"},\"type\":\"Feature\",\"geometry\":null}\n"
+            "{\"type\":\"Point\",\"coordinates\":[1,2]}\n"
+            "{\"type\":\"Feature\",\"geometry\":null}";
+        mapnik::json::geojson_stream_reader reader(doc.data(), doc.data() + doc.size(), 5);
+        std::string feature;
+        REQUIRE(reader.next(feature));
+        CHECK(feature == "{\"properties\":{\"type\":\"x\"},\"type\":\"Feature\",\"geometry\":null}");
+        REQUIRE(reader.next(feature));
+        CHECK(feature == "{\"type\":\"Feature\",\"geometry\":null}");
+        CHECK(!reader.next(feature));
+    }
+
+    SECTION("structural errors throw")
+    {
+        for (std::string const doc : { "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\"}",
+                                       "{\"type\":\"Feature\",\"properties\":{\"a\":\"b}}",
+                                       "{\"type\":\"Feature\"}}" })
+        {
+            INFO(doc);
+            mapnik::json::geojson_stream_reader reader(doc.data(), doc.data() + doc.size());
+            std::string feature;
+            REQUIRE_THROWS(while (reader.next(feature)) {});
+        }
+    }
+}
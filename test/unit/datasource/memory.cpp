@@ -27,6 +27,10 @@
 #include <mapnik/datasource.hpp>
 #include <mapnik/memory_datasource.hpp>
 #include <mapnik/datasource_cache.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/query.hpp>
+
+#include <vector>
 
 
 TEST_CASE("memory datasource") {
@@ -43,4 +47,56 @@ TEST_CASE("memory datasource") {
             CHECK(false); // shouldn't get here
         }
     }
+
+    SECTION("spatial index")
+    {
+        mapnik::parameters params;
+        params["spatial_index"] = true;
+        auto indexed = std::make_shared<mapnik::memory_datasource>(params);
+        auto scanned = std::make_shared<mapnik::memory_datasource>(mapnik::parameters());
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        auto fill = [&](mapnik::value_integer first, mapnik::value_integer last)
+        {
+            for (mapnik::value_integer i = first; i < last; ++i)
+            {
+                mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i));
+                feature->set_geometry(mapnik::geometry::point<double>(i % 100, i / 100));
+                indexed->push(feature);
+                scanned->push(feature);
+            }
+        };
+        auto ids = [](mapnik::featureset_ptr fs)
+        {
+            std::vector<mapnik::value_integer> result;
+            while (auto f = fs->next()) result.push_back(f->id());
+            return result;
+        };
+        fill(0, 5000);
+        mapnik::query q(mapnik::box2d<double>(10.5, 3, 20, 7.5));
+        auto expected = ids(scanned->features(q));
+        CHECK(expected.size() == 50);
+        // same features in insertion order
+        CHECK(ids(indexed->features(q)) == expected);
+        // pushing drops the index
+        fill(5000, 6000);
+        mapnik::query q2(mapnik::box2d<double>(0, 49, 5, 60));
+        expected = ids(scanned->features(q2));
+        CHECK(expected.size() == 66);
+        CHECK(ids(indexed->features(q2)) == expected);
+        CHECK(ids(indexed->features_at_point(mapnik::coord2d(7, 55), 0.5)) == std::vector<mapnik::value_integer>{5507});
+        CHECK(ids(scanned->features_at_point(mapnik::coord2d(7, 55), 0.5)) == std::vector<mapnik::value_integer>{5507});
+        // a batch answers each point as a single query does
+        std::vector<mapnik::coord2d> pts = { mapnik::coord2d(7, 55), mapnik::coord2d(20.5, 3), mapnik::coord2d(-50, -50) };
+        for (auto const& ds : { indexed, scanned })
+        {
+            auto batch = ds->features_at_points(pts, 1.0);
+            REQUIRE(batch.size() == pts.size());
+            for (std::size_t i = 0; i < pts.size(); ++i)
+            {
+                CHECK(ids(batch[i]) == ids(ds->features_at_point(pts[i], 1.0)));
+            }
+            CHECK(ids(batch[1]).size() == 6);
+            CHECK(ids(batch[2]).empty());
+        }
+    }
 }
@@ -0,0 +1,44 @@
+#include "catch.hpp"
+
+#include <mapnik/datasource.hpp>
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/params.hpp>
+#include <mapnik/util/fs.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+TEST_CASE("plugin manifest") {
+
+std::string manifest("/tmp/mapnik-plugin-manifest-test.txt");
+
+SECTION("plugins are registered by name and opened on first use") {
+    {
+        std::ofstream out(manifest.c_str(), std::ios::trunc);
+        out << "# plugins of the test\n"
+            << "\n"
+            << "not-a-plugin-lazy missing/not-a-plugin.input\n"
+            << "/nonexistent/other-lazy-plugin.input\n";
+    }
+    auto & cache = mapnik::datasource_cache::instance();
+    REQUIRE(cache.register_datasource_manifest(manifest));
+    auto names = cache.plugin_names();
+    CHECK(std::find(names.begin(), names.end(), "not-a-plugin-lazy") != names.end());
+    CHECK(std::find(names.begin(), names.end(), "other-lazy-plugin") != names.end());
+
+    mapnik::parameters params;
+    params["type"] = "not-a-plugin-lazy";
+    CHECK_THROWS(cache.create(params));
+    // a plugin failing to load is dropped from the registry
+    names = cache.plugin_names();
+    CHECK(std::find(names.begin(), names.end(), "not-a-plugin-lazy") == names.end());
+    mapnik::util::remove(manifest);
+}
+
+SECTION("missing manifest") {
+    CHECK_FALSE(mapnik::datasource_cache::instance().register_datasource_manifest("/nonexistent/manifest.txt"));
+}
+
+}
@@ -123,6 +123,14 @@ TEST_CASE("postgis") {
             CHECK_THROWS(mapnik::datasource_cache::instance().create(params));
         }
 
+        SECTION("Postgis should throw with unknown 'geometry_encoding'")
+        {
+            mapnik::parameters params(base_params);
+            params["table"] = "test";
+            params["geometry_encoding"] = "geojson";
+            CHECK_THROWS(mapnik::datasource_cache::instance().create(params));
+        }
+
         SECTION("Postgis should throw with invalid metadata query")
         {
             mapnik::parameters params(base_params);
@@ -274,6 +282,72 @@ TEST_CASE("postgis") {
             require_geometry(featureset->next(), 3, mapnik::geometry::geometry_types::GeometryCollection);
         }
 
+        SECTION("Postgis cursorresultest with background_decode")
+        {
+            mapnik::parameters params(base_params);
+            params["table"] = "(SELECT * FROM test) as data";
+            params["cursor_size"] = "2";
+            params["background_decode"] = "true";
+            auto ds = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(ds != nullptr);
+            auto featureset = all_features(ds);
+            CHECK(count_features(featureset) == 8);
+
+            featureset = all_features(ds);
+            require_geometry(featureset->next(), 1, mapnik::geometry::geometry_types::Point);
+            require_geometry(featureset->next(), 1, mapnik::geometry::geometry_types::Point);
+            require_geometry(featureset->next(), 2, mapnik::geometry::geometry_types::MultiPoint);
+            // abandon the featureset while the worker may still be running
+            featureset.reset();
+
+            featureset = all_features(ds);
+            mapnik::feature_ptr feature;
+            while (bool(feature = featureset->next())) {
+                CHECK(feature->size() == 10);
+            }
+        }
+
+        SECTION("Postgis geometry_encoding=twkb")
+        {
+            mapnik::parameters params(base_params);
+            params["table"] = "(SELECT * FROM test) as data";
+            params["geometry_encoding"] = "twkb";
+            auto ds = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(ds != nullptr);
+            auto featureset = all_features(ds);
+            require_geometry(featureset->next(), 1, mapnik::geometry::geometry_types::Point);
+            require_geometry(featureset->next(), 1, mapnik::geometry::geometry_types::Point);
+            require_geometry(featureset->next(), 2, mapnik::geometry::geometry_types::MultiPoint);
+            require_geometry(featureset->next(), 1, mapnik::geometry::geometry_types::LineString);
+            require_geometry(featureset->next(), 2, mapnik::geometry::geometry_types::MultiLineString);
+            require_geometry(featureset->next(), 1, mapnik::geometry::geometry_types::Polygon);
+            require_geometry(featureset->next(), 2, mapnik::geometry::geometry_types::MultiPolygon);
+            require_geometry(featureset->next(), 3, mapnik::geometry::geometry_types::GeometryCollection);
+
+            // point queries fall back to wkb
+            featureset = ds->features_at_point(mapnik::coord2d(1, 1));
+            CHECK(count_features(featureset) > 0);
+        }
+
+        SECTION("Postgis orders features by the group-by attribute")
+        {
+            mapnik::parameters params(base_params);
+            params["table"] = "test";
+            auto ds = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(ds != nullptr);
+            mapnik::query q(ds->envelope());
+            q.add_property_name("gid");
+            q.set_order_by("gid");
+            auto featureset = ds->features(q);
+            REQUIRE(featureset != nullptr);
+            mapnik::feature_ptr feature, prev;
+            while ((bool(feature = featureset->next()))) {
+                if (prev) REQUIRE(prev->get("gid") <= feature->get("gid"));
+                prev = feature;
+            }
+            REQUIRE(prev != nullptr);
+        }
+
         SECTION("Postgis bbox query")
         {
             mapnik::parameters params(base_params);
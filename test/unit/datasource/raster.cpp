@@ -0,0 +1,188 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+#if defined(HAVE_TIFF)
+
+#include "catch.hpp"
+#include "../imaging/tiff_overviews.hpp"
+
+#include <mapnik/datasource.hpp>
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/query.hpp>
+#include <mapnik/raster.hpp>
+#include <mapnik/util/file_io.hpp>
+#include <mapnik/util/fs.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/format.hpp>
+#pragma GCC diagnostic pop
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+// query of the whole extent drawn on a map pixels wide
+mapnik::query map_query(mapnik::box2d<double> const& extent, double pixels)
+{
+    double res = pixels / extent.width();
+    return mapnik::query(extent, mapnik::query::resolution_type(res, res), 1.0);
+}
+
+// the value of the first pixel of every raster, in feature order
+std::vector<int> raster_values(mapnik::featureset_ptr const& fs)
+{
+    std::vector<int> values;
+    REQUIRE(fs != nullptr);
+    while (auto feature = fs->next())
+    {
+        mapnik::raster_ptr const& raster = feature->get_raster();
+        REQUIRE(raster);
+        REQUIRE(raster->data_.is<mapnik::image_gray8>());
+        values.push_back(raster->data_.get<mapnik::image_gray8>()(0, 0));
+    }
+    return values;
+}
+
+// the path tiled_multi_file_policy gives tile x, y of a mosaic side tiles wide
+std::string tile_path(std::string const& base, unsigned z, int x, int y)
+{
+    auto part = [](int v) {
+        return (boost::format("%03d/%03d/%03d") % (v / 1000000) % ((v / 1000) % 1000) % (v % 1000)).str();
+    };
+    return base + "/" + std::to_string(z) + "/" + part(x) + "/" + part(y) + ".tif";
+}
+
+}
+
+TEST_CASE("raster")
+{
+    std::string raster_plugin("./plugins/input/raster.input");
+    if (mapnik::util::exists(raster_plugin))
+    {
+        SECTION("overviews are opt-in")
+        {
+            std::string filename = mapnik::util::temp_filename("/tmp/mapnik-raster-overviews") + ".tif";
+            write_tiff_with_overviews(filename);
+            mapnik::box2d<double> extent(0, 0, 64, 64);
+            mapnik::parameters params;
+            params["type"] = "raster";
+            params["file"] = filename;
+            params["format"] = "tiff";
+            params["extent"] = "0,0,64,64";
+            auto full = mapnik::datasource_cache::instance().create(params);
+            params["overviews"] = true;
+            auto reduced = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(full != nullptr);
+            REQUIRE(reduced != nullptr);
+
+            // without overviews=true the full image is read at any scale
+            CHECK(raster_values(full->features(map_query(extent, 64))) == std::vector<int>{ 10 });
+            CHECK(raster_values(full->features(map_query(extent, 16))) == std::vector<int>{ 10 });
+            // with it the smallest overview still covering a map pixel
+            CHECK(raster_values(reduced->features(map_query(extent, 64))) == std::vector<int>{ 10 });
+            CHECK(raster_values(reduced->features(map_query(extent, 32))) == std::vector<int>{ 20 });
+            CHECK(raster_values(reduced->features(map_query(extent, 20))) == std::vector<int>{ 20 });
+            CHECK(raster_values(reduced->features(map_query(extent, 16))) == std::vector<int>{ 30 });
+            CHECK(raster_values(reduced->features(map_query(extent, 4))) == std::vector<int>{ 30 });
+            mapnik::util::remove(filename);
+        }
+
+        SECTION("pyramid levels of a multi tile mosaic")
+        {
+            // 4x4 tiles of 16 pixels at level 0, 2x2 at 1 and one at 2,
+            // every level filled with a value of its own
+            std::string base = mapnik::util::temp_filename("/tmp/mapnik-raster-pyramid");
+            std::vector<std::string> files;
+            for (unsigned z = 0; z < 3; ++z)
+            {
+                int side = 4 >> z;
+                mapnik::image_gray8 tile(16, 16);
+                mapnik::fill(tile, static_cast<std::uint8_t>(10 * (z + 1)));
+                for (int x = 0; x < side; ++x)
+                {
+                    for (int y = 0; y < side; ++y)
+                    {
+                        std::string path = tile_path(base, z, x, y);
+                        boost::filesystem::create_directories(mapnik::util::dirname(path));
+                        mapnik::save_to_file(tile, path, "tiff");
+                        files.push_back(path);
+                    }
+                }
+            }
+            mapnik::box2d<double> extent(0, 0, 64, 64);
+            mapnik::parameters params;
+            params["type"] = "raster";
+            params["file"] = base + "/${z}/${x}/${y}.tif";
+            params["format"] = "tiff";
+            params["extent"] = "0,0,64,64";
+            params["multi"] = true;
+            params["tile_size"] = mapnik::value_integer(16);
+            params["x_width"] = mapnik::value_integer(4);
+            params["y_width"] = mapnik::value_integer(4);
+            params["levels"] = mapnik::value_integer(3);
+            auto ds = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(ds != nullptr);
+
+            CHECK(raster_values(ds->features(map_query(extent, 64))) == std::vector<int>(16, 10));
+            CHECK(raster_values(ds->features(map_query(extent, 48))) == std::vector<int>(16, 10));
+            CHECK(raster_values(ds->features(map_query(extent, 32))) == std::vector<int>(4, 20));
+            CHECK(raster_values(ds->features(map_query(extent, 16))) == std::vector<int>(1, 30));
+            // never past the coarsest level
+            CHECK(raster_values(ds->features(map_query(extent, 2))) == std::vector<int>(1, 30));
+
+            // without levels the mosaic is level 0 at any scale
+            params["levels"] = mapnik::value_integer(1);
+            auto flat = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(flat != nullptr);
+            CHECK(raster_values(flat->features(map_query(extent, 16))) == std::vector<int>(16, 10));
+            boost::filesystem::remove_all(base);
+        }
+
+        SECTION("decode_threads must be positive")
+        {
+            std::string filename = mapnik::util::temp_filename("/tmp/mapnik-raster-threads") + ".tif";
+            write_tiff_with_overviews(filename);
+            mapnik::parameters params;
+            params["type"] = "raster";
+            params["file"] = filename;
+            params["format"] = "tiff";
+            params["extent"] = "0,0,64,64";
+            params["decode_threads"] = mapnik::value_integer(0);
+            CHECK_THROWS(mapnik::datasource_cache::instance().create(params));
+            params["decode_threads"] = mapnik::value_integer(-4);
+            CHECK_THROWS(mapnik::datasource_cache::instance().create(params));
+            // more threads than cores is clamped, not an error
+            params["decode_threads"] = mapnik::value_integer(100000);
+            CHECK(mapnik::datasource_cache::instance().create(params) != nullptr);
+            mapnik::util::remove(filename);
+        }
+    }
+}
+
+#endif
@@ -26,8 +26,12 @@
 #include <mapnik/datasource_cache.hpp>
 #include <mapnik/mapped_memory_cache.hpp>
 #include <mapnik/util/fs.hpp>
+#include <mapnik/util/file_io.hpp>
+#include <mapnik/util/geometry_to_wkt.hpp>
 #include <cstdlib>
 #include <fstream>
+#include <future>
+#include <vector>
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
 #include <boost/algorithm/string.hpp>
@@ -35,6 +39,26 @@
 
 namespace {
 
+std::vector<mapnik::value_integer> feature_ids(mapnik::featureset_ptr const& fs)
+{
+    std::vector<mapnik::value_integer> ids;
+    while (auto feature = fs->next()) ids.push_back(feature->id());
+    return ids;
+}
+
+// copies the .shp, .shx and .dbf files of base to target
+void copy_shapefile(std::string const& base, std::string const& target)
+{
+    for (auto const& ext : {".shp", ".shx", ".dbf"})
+    {
+        std::ifstream in(base + ext, std::ios::binary);
+        REQUIRE(in);
+        std::ofstream out(target + ext, std::ios::binary | std::ios::trunc);
+        out << in.rdbuf();
+        REQUIRE(out);
+    }
+}
+
 std::size_t count_shapefile_features(std::string const& filename)
 {
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
@@ -66,7 +90,30 @@ std::size_t count_shapefile_features(std::string const& filename)
     return feature_count;
 }
 
-int create_shapefile_index(std::string const& filename, bool index_parts, bool silent = true)
+std::vector<std::string> feature_geometries(std::string const& filename)
+{
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    mapnik::mapped_memory_cache::instance().clear();
+#endif
+    mapnik::parameters params;
+    params["type"] = "shape";
+    params["file"] = filename;
+    auto ds = mapnik::datasource_cache::instance().create(params);
+    REQUIRE(ds != nullptr);
+    auto features = ds->features(mapnik::query(ds->envelope()));
+    REQUIRE(features != nullptr);
+    std::vector<std::string> geometries;
+    while (auto feature = features->next())
+    {
+        std::string wkt;
+        CHECK(mapnik::util::to_wkt(wkt, feature->get_geometry()));
+        geometries.push_back(std::move(wkt));
+    }
+    return geometries;
+}
+
+int create_shapefile_index(std::string const& filename, bool index_parts, bool silent = true,
+                           std::string const& options = "")
 {
     std::string cmd;
     if (std::getenv("DYLD_LIBRARY_PATH") != nullptr)
@@ -76,6 +123,7 @@ int create_shapefile_index(std::string const& filename, bool index_parts, bool s
 
     cmd += "shapeindex ";
     if (index_parts) cmd+= "--index-parts ";
+    cmd += options;
     cmd += filename;
     if (silent)
     {
@@ -184,5 +232,233 @@ TEST_CASE("shapeindex")
                 }
             }
         }
+
+        SECTION("Ring roles")
+        {
+            std::string path = "test/data/shp/boundaries.shp";
+            std::string base = path.substr(0, path.rfind("."));
+            for (bool index_parts : {false, true})
+            {
+                CAPTURE(index_parts);
+                for (auto const& ext : {".index", ".rings"})
+                {
+                    if (mapnik::util::exists(base + ext)) mapnik::util::remove(base + ext);
+                }
+                REQUIRE(create_shapefile_index(path, index_parts) == EXIT_SUCCESS);
+                std::vector<std::string> expected = feature_geometries(path);
+                REQUIRE(create_shapefile_index(path, index_parts, true, "--rings ") == EXIT_SUCCESS);
+                REQUIRE(mapnik::util::exists(base + ".rings"));
+                CHECK(feature_geometries(path) == expected);
+                for (auto const& ext : {".index", ".rings"})
+                {
+                    if (mapnik::util::exists(base + ext)) mapnik::util::remove(base + ext);
+                }
+            }
+        }
+
+        SECTION("Datasource stats")
+        {
+            std::string path = "test/data/shp/boundaries.shp";
+            std::string index_path = path.substr(0, path.rfind(".")) + ".index";
+            for (bool indexed : {false, true})
+            {
+                CAPTURE(indexed);
+                if (mapnik::util::exists(index_path))
+                {
+                    mapnik::util::remove(index_path);
+                }
+                if (indexed)
+                {
+                    REQUIRE(create_shapefile_index(path, false) == EXIT_SUCCESS);
+                }
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+                mapnik::mapped_memory_cache::instance().clear();
+#endif
+                mapnik::parameters params;
+                params["type"] = "shape";
+                params["file"] = path;
+                auto ds = mapnik::datasource_cache::instance().create(params);
+                REQUIRE(ds != nullptr);
+                ds->reset_stats();
+                std::size_t count = feature_ids(ds->features(mapnik::query(ds->envelope()))).size();
+                mapnik::datasource_stats stats = ds->stats();
+                CHECK(stats.queries == 1);
+                CHECK(stats.features == count);
+                CHECK(stats.filtered == 0);
+                CHECK(stats.bytes_read > 0);
+                CHECK((stats.index_nodes > 0) == indexed);
+
+                // a corner of the extent leaves features out
+                mapnik::box2d<double> ext = ds->envelope();
+                mapnik::box2d<double> corner(ext.minx(), ext.miny(),
+                                             ext.minx() + ext.width() / 4, ext.miny() + ext.height() / 4);
+                std::size_t corner_count = feature_ids(ds->features(mapnik::query(corner))).size();
+                mapnik::datasource_stats diff = ds->stats() - stats;
+                CHECK(diff.queries == 1);
+                CHECK(diff.features == corner_count);
+                CHECK(diff.features + diff.filtered <= count);
+                ds->reset_stats();
+                CHECK(ds->stats().queries == 0);
+            }
+            if (mapnik::util::exists(index_path))
+            {
+                mapnik::util::remove(index_path);
+            }
+        }
+
+        SECTION("Batched point queries")
+        {
+            std::string path = "test/data/shp/boundaries.shp";
+            std::string index_path = path.substr(0, path.rfind(".")) + ".index";
+            for (bool indexed : {false, true})
+            {
+                CAPTURE(indexed);
+                if (mapnik::util::exists(index_path))
+                {
+                    mapnik::util::remove(index_path);
+                }
+                if (indexed)
+                {
+                    REQUIRE(create_shapefile_index(path, false) == EXIT_SUCCESS);
+                }
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+                mapnik::mapped_memory_cache::instance().clear();
+#endif
+                mapnik::parameters params;
+                params["type"] = "shape";
+                params["file"] = path;
+                auto ds = mapnik::datasource_cache::instance().create(params);
+                REQUIRE(ds != nullptr);
+                mapnik::box2d<double> ext = ds->envelope();
+                double tol = ext.width() / 100;
+                std::vector<mapnik::coord2d> pts = { ext.center(),
+                                                     mapnik::coord2d(ext.minx(), ext.miny()),
+                                                     mapnik::coord2d(ext.minx() + ext.width() / 3, ext.maxy()),
+                                                     mapnik::coord2d(ext.maxx() + 10 * ext.width(), ext.maxy()) };
+                auto batch = ds->features_at_points(pts, tol);
+                REQUIRE(batch.size() == pts.size());
+                for (std::size_t i = 0; i < pts.size(); ++i)
+                {
+                    CHECK(feature_ids(batch[i]) == feature_ids(ds->features_at_point(pts[i], tol)));
+                }
+                CHECK(feature_ids(batch.back()).empty());
+            }
+            if (mapnik::util::exists(index_path))
+            {
+                mapnik::util::remove(index_path);
+            }
+        }
+
+        SECTION("Pooled readers")
+        {
+            std::string path = "test/data/shp/boundaries.shp";
+            std::string index_path = path.substr(0, path.rfind(".")) + ".index";
+            for (bool indexed : {false, true})
+            {
+                CAPTURE(indexed);
+                if (mapnik::util::exists(index_path))
+                {
+                    mapnik::util::remove(index_path);
+                }
+                if (indexed)
+                {
+                    REQUIRE(create_shapefile_index(path, false) == EXIT_SUCCESS);
+                }
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+                mapnik::mapped_memory_cache::instance().clear();
+#endif
+                mapnik::parameters params;
+                params["type"] = "shape";
+                params["file"] = path;
+                params["pool_size"] = mapnik::value_integer(0);
+                auto fresh = mapnik::datasource_cache::instance().create(params);
+                params["pool_size"] = mapnik::value_integer(1);
+                auto pooled = mapnik::datasource_cache::instance().create(params);
+                REQUIRE(fresh != nullptr);
+                REQUIRE(pooled != nullptr);
+
+                mapnik::box2d<double> ext = pooled->envelope();
+                mapnik::box2d<double> corner(ext.minx(), ext.miny(),
+                                             ext.minx() + ext.width() / 4, ext.miny() + ext.height() / 4);
+                std::vector<mapnik::value_integer> all = feature_ids(fresh->features(mapnik::query(ext)));
+                std::vector<mapnik::value_integer> some = feature_ids(fresh->features(mapnik::query(corner)));
+                REQUIRE(!all.empty());
+                REQUIRE(some.size() < all.size());
+
+                // one reader handed back and forth: reset() has to rewind
+                // the index and drop the read-ahead window of the last query
+                for (int i = 0; i < 3; ++i)
+                {
+                    CHECK(feature_ids(pooled->features(mapnik::query(ext))) == all);
+                    CHECK(feature_ids(pooled->features(mapnik::query(corner))) == some);
+                }
+
+                // interleaved queries each hold a reader of their own
+                auto first = pooled->features(mapnik::query(ext));
+                std::vector<mapnik::value_integer> first_ids;
+                for (std::size_t i = 0; i < all.size() / 2; ++i)
+                {
+                    first_ids.push_back(first->next()->id());
+                }
+                CHECK(feature_ids(pooled->features(mapnik::query(corner))) == some);
+                while (auto feature = first->next()) first_ids.push_back(feature->id());
+                CHECK(first_ids == all);
+                first.reset();
+
+                // and on threads of their own
+                std::vector<std::future<bool>> results;
+                for (int i = 0; i < 8; ++i)
+                {
+                    results.push_back(std::async(std::launch::async, [&, i] {
+                        bool ok = true;
+                        for (int j = 0; j < 10; ++j)
+                        {
+                            if ((i + j) % 2 == 0) ok = ok && feature_ids(pooled->features(mapnik::query(ext))) == all;
+                            else ok = ok && feature_ids(pooled->features(mapnik::query(corner))) == some;
+                        }
+                        return ok;
+                    }));
+                }
+                for (auto & result : results) CHECK(result.get());
+            }
+            if (mapnik::util::exists(index_path))
+            {
+                mapnik::util::remove(index_path);
+            }
+        }
+
+        SECTION("Pooled readers follow a replaced shapefile")
+        {
+            std::string base = mapnik::util::temp_filename("/tmp/mapnik-shape-pool-test");
+            copy_shapefile("test/data/shp/boundaries", base);
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+            mapnik::mapped_memory_cache::instance().clear();
+#endif
+            mapnik::parameters params;
+            params["type"] = "shape";
+            params["file"] = base + ".shp";
+            params["pool_size"] = mapnik::value_integer(2);
+            auto ds = mapnik::datasource_cache::instance().create(params);
+            REQUIRE(ds != nullptr);
+            mapnik::box2d<double> everywhere(-1e9, -1e9, 1e9, 1e9);
+            std::size_t before = feature_ids(ds->features(mapnik::query(everywhere))).size();
+            CHECK(before == count_shapefile_features("test/data/shp/boundaries.shp"));
+
+            // a reader still out keeps reading the files it opened
+            auto pending = ds->features(mapnik::query(everywhere));
+            copy_shapefile("test/data/shp/world_merc", base);
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+            mapnik::mapped_memory_cache::instance().clear();
+#endif
+            std::size_t after = feature_ids(ds->features(mapnik::query(everywhere))).size();
+            CHECK(after == count_shapefile_features("test/data/shp/world_merc.shp"));
+            CHECK(after != before);
+            pending.reset();
+            CHECK(feature_ids(ds->features(mapnik::query(everywhere))).size() == after);
+            for (auto const& ext : {".shp", ".shx", ".dbf"})
+            {
+                mapnik::util::remove(base + ext);
+            }
+        }
     }
 }
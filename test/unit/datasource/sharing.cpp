@@ -0,0 +1,44 @@
+#include "catch.hpp"
+
+#include <mapnik/datasource.hpp>
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/params.hpp>
+#include <mapnik/util/fs.hpp>
+
+#include <string>
+
+TEST_CASE("datasource sharing") {
+
+std::string csv_plugin("./plugins/input/csv.input");
+if (mapnik::util::exists(csv_plugin))
+{
+    SECTION("identical parameters share one datasource while it is held") {
+        auto & cache = mapnik::datasource_cache::instance();
+        cache.set_sharing(true);
+        mapnik::parameters params;
+        params["type"] = "csv";
+        params["inline"] = "x,y\n0,0\n";
+        mapnik::parameters other(params);
+        other["inline"] = "x,y\n1,1\n";
+
+        mapnik::datasource_ptr ds1 = cache.create(params);
+        mapnik::datasource_ptr ds2 = cache.create(params);
+        mapnik::datasource_ptr ds3 = cache.create(other);
+        CHECK(ds1 == ds2);
+        CHECK(ds1 != ds3);
+        CHECK(cache.shared_count() == 2);
+
+        ds1.reset();
+        ds2.reset();
+        CHECK(cache.shared_count() == 1);
+        mapnik::datasource_ptr ds4 = cache.create(params);
+        CHECK(ds4);
+        CHECK(ds4 != ds3);
+
+        cache.set_sharing(false);
+        CHECK(cache.shared_count() == 0);
+        CHECK(cache.create(other) != ds3);
+    }
+}
+
+}
@@ -24,6 +24,13 @@
 
 #include <mapnik/quad_tree.hpp>
 #include <mapnik/util/spatial_index.hpp>
+#include <mapnik/util/packed_spatial_index.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <random>
 
 TEST_CASE("spatial_index")
 {
@@ -84,4 +91,150 @@ TEST_CASE("spatial_index")
         REQUIRE(results[3] == 2);
         REQUIRE(results.size() == 4);
     }
+
+    SECTION("mapnik::util::packed_rtree<T>")
+    {
+        using value_type = std::int32_t;
+        using mapnik::filter_in_box;
+        using index_type = mapnik::util::spatial_index<value_type, filter_in_box, std::istringstream>;
+        mapnik::util::packed_rtree<value_type> tree(4);
+        std::vector<mapnik::box2d<double>> boxes;
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<double> pos(0, 1000);
+        std::uniform_real_distribution<double> size(0, 20);
+        for (value_type i = 0; i < 500; ++i)
+        {
+            double x = pos(gen), y = pos(gen);
+            boxes.emplace_back(x, y, x + size(gen), y + size(gen));
+            tree.insert(i, boxes.back());
+        }
+        REQUIRE(tree.count_items() == 500);
+
+        std::ostringstream out(std::ios::binary);
+        tree.write(out);
+        out.flush();
+        REQUIRE(out.str().substr(0, 12) == "mapnik-rtree");
+
+        std::istringstream in(out.str(), std::ios::binary);
+        REQUIRE(mapnik::util::check_spatial_index(in));
+        in.seekg(0, std::ios::beg);
+        auto box = index_type::bounding_box(in);
+        REQUIRE(box.contains(tree.extent().minx(), tree.extent().miny()));
+        REQUIRE(box.contains(tree.extent().maxx(), tree.extent().maxy()));
+
+        std::vector<mapnik::box2d<double>> queries = {
+            {0, 0, 1000, 1000}, {100, 100, 200, 300}, {500, 500, 500, 500}, {-10, -10, -5, -5}
+        };
+        for (auto const& query_box : queries)
+        {
+            std::vector<value_type> expected;
+            for (value_type i = 0; i < 500; ++i)
+            {
+                if (boxes[i].intersects(query_box)) expected.push_back(i);
+            }
+            std::vector<value_type> results;
+            filter_in_box filter(query_box);
+            index_type::query(filter, in, results);
+            std::sort(results.begin(), results.end());
+            CHECK(results == expected);
+        }
+
+        // query first N elements interface
+        std::vector<value_type> results;
+        filter_in_box filter(box);
+        index_type::query_first_n(filter, in, results, 7);
+        CHECK(results.size() == 7);
+    }
+
+    SECTION("mapnik::util::packed_rtree_writer<T>")
+    {
+        using value_type = std::int32_t;
+        namespace packed_index = mapnik::util::packed_index;
+        std::mt19937 gen(7);
+        std::uniform_real_distribution<double> pos(-50, 50);
+        std::uniform_real_distribution<double> size(0, 5);
+        for (std::size_t num_items : {0, 1, 5, 16, 17, 300})
+        {
+            mapnik::util::packed_rtree<value_type> tree(4);
+            std::vector<std::pair<value_type, mapnik::box2d<float>>> items;
+            for (std::size_t i = 0; i < num_items; ++i)
+            {
+                double x = pos(gen), y = pos(gen);
+                mapnik::box2d<double> box(x, y, x + size(gen), y + size(gen));
+                tree.insert(static_cast<value_type>(i), box);
+                items.emplace_back(static_cast<value_type>(i), packed_index::to_float_box(box));
+            }
+            std::ostringstream expected(std::ios::binary);
+            tree.write(expected);
+
+            // the items in the order write() sorts them, see packed_rtree::write()
+            auto extent = tree.extent();
+            std::stable_sort(items.begin(), items.end(), [&extent](auto const& lhs, auto const& rhs) {
+                return packed_index::hilbert_code(lhs.second, extent) < packed_index::hilbert_code(rhs.second, extent);
+            });
+            std::string filename("/tmp/mapnik-packed-rtree-writer-test.index");
+            {
+                std::ofstream out(filename.c_str(), std::ios::trunc | std::ios::binary);
+                mapnik::util::packed_rtree_writer<value_type, std::ofstream> writer(out, num_items, 4, 7);
+                for (auto const& item : items) writer.push(item.first, item.second);
+                writer.finish();
+                CHECK(writer.count_items() == num_items);
+            }
+            std::ifstream in(filename.c_str(), std::ios::binary);
+            std::string written((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            in.close();
+            std::remove(filename.c_str());
+            CHECK(written == expected.str());
+        }
+    }
+
+    SECTION("mapnik::util::index_record_reader")
+    {
+        std::string filename("/tmp/mapnik-index-record-reader-test.txt");
+        std::string content;
+        std::vector<mapnik::util::index_record> records;
+        std::mt19937 gen(3);
+        std::uniform_int_distribution<std::size_t> size(1, 3000);
+        std::uniform_int_distribution<std::size_t> gap(0, 40000);
+        for (std::size_t i = 0; i < 200; ++i)
+        {
+            content.append(gap(gen), '.');
+            std::size_t n = i == 100 ? 2 * mapnik::util::index_record_reader::max_block : size(gen);
+            records.push_back({content.size(), n, mapnik::box2d<float>()});
+            for (std::size_t j = 0; j < n; ++j) content.push_back(static_cast<char>('a' + (i + j) % 26));
+        }
+        {
+            std::ofstream out(filename.c_str(), std::ios::trunc | std::ios::binary);
+            out << content;
+        }
+        std::unique_ptr<std::FILE, int (*)(std::FILE *)> file(std::fopen(filename.c_str(), "rb"), std::fclose);
+        REQUIRE(file);
+        mapnik::util::index_record_reader reader;
+        for (auto itr = records.begin(); itr != records.end(); ++itr)
+        {
+            char const* data = reader.read(file.get(), itr, records.end());
+            REQUIRE(data != nullptr);
+            CHECK(std::string(data, itr->size) == content.substr(itr->off, itr->size));
+        }
+        // past the end of the file
+        std::vector<mapnik::util::index_record> beyond = {{content.size() - 10, 20, mapnik::box2d<float>()}};
+        mapnik::util::index_record_reader other;
+        CHECK(other.read(file.get(), beyond.begin(), beyond.end()) == nullptr);
+        file.reset();
+        std::remove(filename.c_str());
+    }
+
+    SECTION("empty mapnik::util::packed_rtree<T>")
+    {
+        using value_type = std::int32_t;
+        using mapnik::filter_in_box;
+        mapnik::util::packed_rtree<value_type> tree;
+        std::ostringstream out(std::ios::binary);
+        tree.write(out);
+        std::istringstream in(out.str(), std::ios::binary);
+        std::vector<value_type> results;
+        filter_in_box filter(mapnik::box2d<double>(0, 0, 1, 1));
+        mapnik::util::spatial_index<value_type, filter_in_box, std::istringstream>::query(filter, in, results);
+        CHECK(results.empty());
+    }
 }
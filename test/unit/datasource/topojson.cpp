@@ -118,4 +118,51 @@ TEST_CASE("topojson")
         }
     }
 
+    SECTION("arcs are decoded once and shared")
+    {
+        mapnik::topojson::topology topo;
+        topo.tr = mapnik::topojson::transform{0.5, 2.0, 10.0, 20.0};
+        mapnik::topojson::arc arc0;
+        arc0.coordinates = {{0, 0}, {2, 0}, {0, 1}};
+        mapnik::topojson::arc arc1;
+        arc1.coordinates = {{0, 1}, {-2, 0}, {0, -1}};
+        topo.arcs = {arc0, arc1};
+        mapnik::topojson::polygon poly;
+        poly.rings = {{0, 1}};
+        mapnik::topojson::linestring line;
+        line.rings = {-1};
+        topo.geometries = {poly, line};
+
+        mapnik::topojson::decoded_arcs arcs(topo);
+        REQUIRE(arcs.size() == 2);
+        REQUIRE(arcs.num_points(0) == 3);
+        CHECK(arcs.begin(0)[1].x == 11.0);
+        CHECK(arcs.begin(0)[2].y == 22.0);
+        CHECK(arcs.extent(0) == mapnik::box2d<double>(10, 20, 11, 22));
+        CHECK(arcs.extent(1) == mapnik::box2d<double>(9, 20, 10, 22));
+
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        mapnik::transcoder tr("utf8");
+        mapnik::topojson::bounding_box_visitor bbox_visitor(topo, arcs);
+        for (std::size_t i = 0; i < topo.geometries.size(); ++i)
+        {
+            auto const& geom = topo.geometries[i];
+            mapnik::box2d<double> bbox = mapnik::util::apply_visitor(bbox_visitor, geom);
+            CHECK(bbox == mapnik::util::apply_visitor(mapnik::topojson::bounding_box_visitor(topo), geom));
+            mapnik::feature_ptr shared = mapnik::util::apply_visitor(
+                mapnik::topojson::feature_generator<mapnik::context_ptr>(ctx, tr, topo, arcs, i + 1), geom);
+            mapnik::feature_ptr owned = mapnik::util::apply_visitor(
+                mapnik::topojson::feature_generator<mapnik::context_ptr>(ctx, tr, topo, i + 1), geom);
+            REQUIRE(shared);
+            REQUIRE(owned);
+            CHECK(shared->envelope() == bbox);
+            CHECK(owned->envelope() == bbox);
+        }
+        mapnik::feature_ptr feature = mapnik::util::apply_visitor(
+            mapnik::topojson::feature_generator<mapnik::context_ptr>(ctx, tr, topo, arcs, 1), topo.geometries[0]);
+        auto const& polygon = mapnik::util::get<mapnik::geometry::polygon<double>>(feature->get_geometry());
+        REQUIRE(polygon.size() == 1);
+        // both arcs, closed by correct()
+        CHECK(polygon[0].size() == 7);
+    }
 }
@@ -0,0 +1,67 @@
+#include "catch.hpp"
+
+#include <mapnik/font_engine_freetype.hpp>
+#include <mapnik/map.hpp>
+#include <mapnik/util/fs.hpp>
+#include <mapnik/util/file_io.hpp>
+
+#include <ctime>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+TEST_CASE("font catalog") {
+
+std::string font_file("fonts/dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf");
+// unique per run, so concurrent test runs do not share a catalog
+std::string catalog(mapnik::util::temp_filename("/tmp/mapnik-font-catalog-test"));
+
+SECTION("registration fills the catalog") {
+    if (mapnik::util::exists(catalog)) mapnik::util::remove(catalog);
+    mapnik::freetype_engine::set_font_catalog(catalog);
+    mapnik::Map m(256, 256);
+    REQUIRE(m.register_fonts(font_file));
+    CHECK(m.get_font_file_mapping().count("DejaVu Sans Book") == 1);
+    REQUIRE(mapnik::util::exists(catalog));
+    std::ifstream in(catalog.c_str());
+    std::stringstream content;
+    content << in.rdbuf();
+    CHECK(content.str().find("DejaVu Sans Book") != std::string::npos);
+    mapnik::freetype_engine::set_font_catalog("");
+    mapnik::util::remove(catalog);
+}
+
+SECTION("unchanged files are not opened again") {
+    std::time_t mtime;
+    std::uintmax_t size;
+    REQUIRE(mapnik::util::file_stat(font_file, mtime, size));
+    {
+        std::ofstream out(catalog.c_str(), std::ios::trunc);
+        out << "mapnik-font-catalog 1\n"
+            << font_file << '\t' << mtime << ' ' << size << " 1\n"
+            << "0\tCatalog Face Regular\n";
+    }
+    mapnik::freetype_engine::set_font_catalog(catalog);
+    mapnik::Map m(256, 256);
+    REQUIRE(m.register_fonts(font_file));
+    CHECK(m.get_font_file_mapping().count("Catalog Face Regular") == 1);
+    CHECK(m.get_font_file_mapping().count("DejaVu Sans Book") == 0);
+
+    // a stale entry is refreshed from the file
+    {
+        std::ofstream out(catalog.c_str(), std::ios::trunc);
+        out << "mapnik-font-catalog 1\n"
+            << font_file << '\t' << mtime << ' ' << size + 1 << " 1\n"
+            << "0\tCatalog Face Regular\n";
+    }
+    mapnik::freetype_engine::set_font_catalog(catalog);
+    mapnik::Map m2(256, 256);
+    REQUIRE(m2.register_fonts(font_file));
+    CHECK(m2.get_font_file_mapping().count("Catalog Face Regular") == 0);
+    CHECK(m2.get_font_file_mapping().count("DejaVu Sans Book") == 1);
+    mapnik::freetype_engine::set_font_catalog("");
+    mapnik::util::remove(catalog);
+}
+
+}
@@ -0,0 +1,127 @@
+#include "catch.hpp"
+
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry/interior.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+TEST_CASE("geometry interior") {
+
+SECTION("empty polygon") {
+
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::point<double> pt;
+    REQUIRE(!mapnik::geometry::interior(poly, 0.0, pt));
+}
+
+SECTION("square") {
+
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(0, 0);
+    ring.emplace_back(100, 0);
+    ring.emplace_back(100, 100);
+    ring.emplace_back(0, 100);
+    ring.emplace_back(0, 0);
+    poly.push_back(std::move(ring));
+    mapnik::geometry::point<double> pt;
+    REQUIRE(mapnik::geometry::interior(poly, 1.0, pt));
+    REQUIRE(pt.x == Approx(50.0));
+    REQUIRE(pt.y == Approx(50.0));
+}
+
+SECTION("concave polygon") {
+
+    // an L shape, its centroid lies outside
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(0, 0);
+    ring.emplace_back(100, 0);
+    ring.emplace_back(100, 10);
+    ring.emplace_back(10, 10);
+    ring.emplace_back(10, 100);
+    ring.emplace_back(0, 100);
+    ring.emplace_back(0, 0);
+    poly.push_back(std::move(ring));
+    mapnik::geometry::point<double> pt;
+    REQUIRE(mapnik::geometry::interior(poly, 0.1, pt));
+    REQUIRE(pt.x > 0.0);
+    REQUIRE(pt.y > 0.0);
+    REQUIRE((pt.x < 10.0 || pt.y < 10.0));
+    REQUIRE(std::abs(pt.x - pt.y) < 1.0);
+}
+
+SECTION("polygon with hole") {
+
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> exterior;
+    exterior.emplace_back(0, 0);
+    exterior.emplace_back(100, 0);
+    exterior.emplace_back(100, 100);
+    exterior.emplace_back(0, 100);
+    exterior.emplace_back(0, 0);
+    poly.push_back(std::move(exterior));
+    mapnik::geometry::linear_ring<double> hole;
+    hole.emplace_back(30, 30);
+    hole.emplace_back(30, 70);
+    hole.emplace_back(70, 70);
+    hole.emplace_back(70, 30);
+    hole.emplace_back(30, 30);
+    poly.push_back(std::move(hole));
+    mapnik::geometry::point<double> pt;
+    REQUIRE(mapnik::geometry::interior(poly, 0.1, pt));
+    // outside the hole, about as far from it as from the exterior
+    REQUIRE(!(pt.x > 30.0 && pt.x < 70.0 && pt.y > 30.0 && pt.y < 70.0));
+    REQUIRE(pt.x > 0.0);
+    REQUIRE(pt.x < 100.0);
+    REQUIRE(pt.y > 0.0);
+    REQUIRE(pt.y < 100.0);
+}
+
+SECTION("feature caches interiors until its geometry changes") {
+
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::polygon<double> square;
+    mapnik::geometry::linear_ring<double> exterior;
+    exterior.emplace_back(0, 0);
+    exterior.emplace_back(100, 0);
+    exterior.emplace_back(100, 100);
+    exterior.emplace_back(0, 100);
+    exterior.emplace_back(0, 0);
+    square.push_back(std::move(exterior));
+    feature->set_geometry(std::move(square));
+    mapnik::feature_impl const& reader = *feature;
+    auto const& poly = mapnik::util::get<mapnik::geometry::polygon<double>>(reader.get_geometry());
+
+    // threads sharing the feature all find the same point
+    std::vector<mapnik::geometry::point<double>> points(4);
+    std::vector<std::thread> threads;
+    for (auto & pt : points)
+    {
+        threads.emplace_back([&reader, &poly, &pt] { CHECK(reader.interior(poly, 0.1, pt)); });
+    }
+    for (auto & t : threads) t.join();
+    for (auto const& pt : points)
+    {
+        CHECK(pt.x == points.front().x);
+        CHECK(pt.y == points.front().y);
+    }
+
+    // moved in place through the non-const geometry
+    auto & moved = mapnik::util::get<mapnik::geometry::polygon<double>>(feature->get_geometry());
+    for (auto & p : moved.front())
+    {
+        p.x += 1000;
+    }
+    mapnik::geometry::point<double> pt;
+    REQUIRE(reader.interior(poly, 0.1, pt));
+    CHECK(pt.x > 1000.0);
+    CHECK(pt.x < 1100.0);
+}
+
+}
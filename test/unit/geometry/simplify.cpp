@@ -0,0 +1,58 @@
+#include "catch.hpp"
+
+#include <mapnik/geometry.hpp>
+#include <mapnik/geometry/simplify.hpp>
+
+TEST_CASE("geometry simplify") {
+
+SECTION("point") {
+
+    mapnik::geometry::geometry<double> geom(mapnik::geometry::point<double>(10, 10));
+    auto result = mapnik::geometry::simplify(geom, 5.0);
+    REQUIRE(result.is<mapnik::geometry::point<double>>());
+    auto const& pt = result.get<mapnik::geometry::point<double>>();
+    REQUIRE(pt.x == 10);
+    REQUIRE(pt.y == 10);
+}
+
+SECTION("linestring") {
+
+    mapnik::geometry::line_string<double> line;
+    line.emplace_back(0, 0);
+    line.emplace_back(25, 0.5);
+    line.emplace_back(50, 0);
+    line.emplace_back(50, 50);
+    mapnik::geometry::geometry<double> geom(std::move(line));
+    auto result = mapnik::geometry::simplify(geom, 1.0);
+    REQUIRE(result.is<mapnik::geometry::line_string<double>>());
+    REQUIRE(result.get<mapnik::geometry::line_string<double>>().size() == 3);
+}
+
+SECTION("polygon keeps collapsing rings") {
+
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> exterior;
+    exterior.emplace_back(0, 0);
+    exterior.emplace_back(50, 0);
+    exterior.emplace_back(100, 0);
+    exterior.emplace_back(100, 100);
+    exterior.emplace_back(0, 100);
+    exterior.emplace_back(0, 0);
+    poly.push_back(std::move(exterior));
+    mapnik::geometry::linear_ring<double> hole;
+    hole.emplace_back(10, 10);
+    hole.emplace_back(10, 10.5);
+    hole.emplace_back(11, 11);
+    hole.emplace_back(10.5, 10);
+    hole.emplace_back(10, 10);
+    poly.push_back(std::move(hole));
+    mapnik::geometry::geometry<double> geom(std::move(poly));
+    auto result = mapnik::geometry::simplify(geom, 5.0);
+    REQUIRE(result.is<mapnik::geometry::polygon<double>>());
+    auto const& simplified = result.get<mapnik::geometry::polygon<double>>();
+    REQUIRE(simplified.size() == 2);
+    REQUIRE(simplified[0].size() == 5);
+    REQUIRE(simplified[1].size() == 5);
+}
+
+}
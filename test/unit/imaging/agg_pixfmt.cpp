@@ -0,0 +1,90 @@
+#include "catch.hpp"
+
+#include <mapnik/agg_pixfmt_rgba.hpp>
+#include <mapnik/image.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_rendering_buffer.h"
+#pragma GCC diagnostic pop
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+using blender_type = agg::comp_op_adaptor_rgba_pre<agg::rgba8, agg::order_rgba>;
+using agg_pixfmt = agg::pixfmt_custom_blend_rgba<blender_type, agg::rendering_buffer>;
+using mapnik_pixfmt = mapnik::pixfmt_comp_rgba_pre<blender_type, agg::rendering_buffer>;
+
+template <typename PixFmt>
+mapnik::image_rgba8 draw(mapnik::image_rgba8 im, unsigned comp_op,
+                         std::vector<agg::rgba8> const& colors, std::vector<agg::int8u> const& covers)
+{
+    agg::rendering_buffer buf(im.bytes(), im.width(), im.height(), im.row_size());
+    PixFmt pixf(buf, comp_op);
+    unsigned width = im.width();
+    for (unsigned y = 0; y < im.height(); ++y)
+    {
+        agg::rgba8 const& c = colors[y % colors.size()];
+        switch (y % 4)
+        {
+        case 0:
+            pixf.blend_solid_hspan(1, y, width - 2, c, &covers[y]);
+            break;
+        case 1:
+            pixf.blend_hline(0, y, width - 3, c, covers[y]);
+            break;
+        case 2:
+            pixf.copy_hline(2, y, width - 2, c);
+            break;
+        default:
+            pixf.blend_solid_hspan(0, y, width, c, &covers[0]);
+        }
+    }
+    return im;
+}
+
+}
+
+TEST_CASE("agg pixfmt") {
+
+SECTION("rgba8 spans match the agg blenders") {
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> byte(0, 255);
+    mapnik::image_rgba8 im(37, 64, true, true);
+    for (std::size_t y = 0; y < im.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im.width(); ++x)
+        {
+            agg::rgba8 c(byte(gen), byte(gen), byte(gen), byte(gen));
+            c.premultiply();
+            im(x, y) = c.r | (c.g << 8) | (c.b << 16) | (c.a << 24);
+        }
+    }
+    std::vector<agg::rgba8> colors;
+    for (int i = 0; i < 16; ++i)
+    {
+        agg::rgba8 c(byte(gen), byte(gen), byte(gen), i % 3 == 0 ? 255 : byte(gen));
+        colors.push_back(c.premultiply());
+    }
+    colors.push_back(agg::rgba8(0, 0, 0, 0));
+    std::vector<agg::int8u> covers;
+    for (int i = 0; i < 128; ++i)
+    {
+        int r = byte(gen);
+        // runs of empty and full coverage as left by the rasterizer
+        covers.push_back(i % 16 < 4 ? 0 : (i % 16 < 8 ? 255 : r));
+    }
+    for (unsigned comp_op : { unsigned(agg::comp_op_src_over), unsigned(agg::comp_op_multiply) })
+    {
+        mapnik::image_rgba8 expected = draw<agg_pixfmt>(im, comp_op, colors, covers);
+        mapnik::image_rgba8 actual = draw<mapnik_pixfmt>(im, comp_op, colors, covers);
+        CHECK(std::equal(expected.begin(), expected.end(), actual.begin()));
+        CHECK(!std::equal(expected.begin(), expected.end(), im.begin()));
+    }
+}
+
+}
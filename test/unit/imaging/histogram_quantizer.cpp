@@ -0,0 +1,153 @@
+#include "catch.hpp"
+
+#include <mapnik/image.hpp>
+#include <mapnik/histogram_quantizer.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <set>
+
+namespace {
+
+std::uint32_t pack(unsigned r, unsigned g, unsigned b, unsigned a)
+{
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+mapnik::image_rgba8 random_image(std::size_t width, std::size_t height, std::mt19937 & gen)
+{
+    mapnik::image_rgba8 im(width, height);
+    std::uniform_int_distribution<unsigned> dist(0, 255);
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        for (std::size_t x = 0; x < width; ++x)
+        {
+            im(x, y) = pack(dist(gen), dist(gen), dist(gen), 255);
+        }
+    }
+    return im;
+}
+
+int max_error(mapnik::image_rgba8 const& im, mapnik::histogram_quantizer const& quantizer)
+{
+    int error = 0;
+    for (std::size_t y = 0; y < im.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im.width(); ++x)
+        {
+            std::uint32_t val = im(x, y);
+            unsigned index = quantizer.quantize(val);
+            if (index >= quantizer.palette().size()) return 256;
+            mapnik::rgb const& c = quantizer.palette()[index];
+            error = std::max(error, std::abs(int(c.r) - int(U2RED(val))));
+            error = std::max(error, std::abs(int(c.g) - int(U2GREEN(val))));
+            error = std::max(error, std::abs(int(c.b) - int(U2BLUE(val))));
+        }
+    }
+    return error;
+}
+
+}
+
+TEST_CASE("histogram quantizer") {
+
+SECTION("few colors are kept exactly") {
+    mapnik::image_rgba8 im(64, 64);
+    std::uint32_t colors[] = { pack(255, 0, 0, 255), pack(0, 128, 0, 255),
+                               pack(10, 20, 30, 255), pack(200, 200, 200, 128) };
+    for (std::size_t y = 0; y < im.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im.width(); ++x)
+        {
+            im(x, y) = colors[(x / 8 + y) % 4];
+        }
+    }
+    im(0, 0) = 0;
+    mapnik::histogram_quantizer quantizer(256);
+    quantizer.insert(im);
+    quantizer.create_palette();
+    // four colors and the transparent one
+    REQUIRE(quantizer.palette().size() == 5);
+    auto const& palette = quantizer.palette();
+    auto const& alpha = quantizer.alpha_table();
+    // translucent colors first
+    CHECK(alpha[0] < 255);
+    CHECK(alpha[1] < 255);
+    for (std::uint32_t c : colors)
+    {
+        unsigned index = quantizer.quantize(c);
+        CHECK(palette[index].r == U2RED(c));
+        CHECK(palette[index].g == U2GREEN(c));
+        CHECK(palette[index].b == U2BLUE(c));
+        CHECK(alpha[index] == U2ALPHA(c));
+    }
+    CHECK(alpha[quantizer.quantize(0)] == 0);
+    CHECK(alpha[quantizer.quantize(pack(1, 2, 3, 2))] == 0);
+}
+
+SECTION("palette is limited to max colors") {
+    std::mt19937 gen(7);
+    mapnik::image_rgba8 im = random_image(300, 200, gen);
+    mapnik::histogram_quantizer quantizer(64);
+    quantizer.insert(im);
+    quantizer.create_palette();
+    CHECK(quantizer.palette().size() == 64);
+    CHECK(quantizer.alpha_table().size() == 64);
+    CHECK(max_error(im, quantizer) < 128);
+}
+
+SECTION("trans mode") {
+    mapnik::image_rgba8 im(16, 16);
+    for (std::size_t y = 0; y < im.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im.width(); ++x)
+        {
+            im(x, y) = pack(100, 100, 100, x < 8 ? 64 : 200);
+        }
+    }
+    mapnik::histogram_quantizer opaque(256);
+    opaque.set_trans_mode(0);
+    opaque.insert(im);
+    opaque.create_palette();
+    REQUIRE(opaque.palette().size() == 1);
+    CHECK(opaque.alpha_table()[0] == 255);
+
+    mapnik::histogram_quantizer binary(256);
+    binary.set_trans_mode(1);
+    binary.insert(im);
+    binary.create_palette();
+    REQUIRE(binary.palette().size() == 2);
+    CHECK(binary.alpha_table()[binary.quantize(pack(100, 100, 100, 64))] == 0);
+    CHECK(binary.alpha_table()[binary.quantize(pack(100, 100, 100, 200))] == 255);
+}
+
+SECTION("palette reuse") {
+    std::mt19937 gen(11);
+    mapnik::image_rgba8 metatile = random_image(128, 128, gen);
+    mapnik::histogram_quantizer quantizer(32);
+    quantizer.insert(metatile);
+    quantizer.create_palette();
+    mapnik::image_rgba8 other = random_image(32, 32, gen);
+    CHECK(max_error(other, quantizer) < 160);
+    // queries for unseen colors are repeatable
+    std::uint32_t c = pack(1, 254, 3, 255);
+    CHECK(quantizer.quantize(c) == quantizer.quantize(c));
+}
+
+SECTION("threads") {
+    std::mt19937 gen(3);
+    mapnik::image_rgba8 im = random_image(1024, 768, gen);
+    mapnik::histogram_quantizer single(256);
+    single.insert(im);
+    single.create_palette();
+    mapnik::histogram_quantizer threaded(256);
+    threaded.set_threads(3);
+    threaded.insert(im);
+    threaded.create_palette();
+    CHECK(single.histogram_size() == threaded.histogram_size());
+    CHECK(threaded.palette().size() == 256);
+    CHECK(max_error(im, threaded) < 96);
+}
+
+}
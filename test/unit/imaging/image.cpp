@@ -8,6 +8,8 @@
 #include <mapnik/color.hpp>
 #include <mapnik/image_util.hpp>
 
+#include <vector>
+
 TEST_CASE("image class") {
 
 SECTION("test gray16") {
@@ -389,4 +391,50 @@ SECTION("image::swap")
     }
 }
 
+SECTION("Image storage")
+{
+    for (auto storage : {mapnik::image_storage::heap,
+                         mapnik::image_storage::mapped,
+                         mapnik::image_storage::huge_pages})
+    {
+        mapnik::image_rgba8 im(300, 200, storage);
+        CHECK(im.width() == 300);
+        CHECK(im.height() == 200);
+#if !defined(_WINDOWS)
+        CHECK(im.storage() == storage);
+#endif
+        for (auto const& pixel : im)
+        {
+            REQUIRE(pixel == 0);
+        }
+        im(299, 199) = 0xff00ff00;
+        // copies keep the storage of the original
+        mapnik::image_rgba8 copy(im);
+        CHECK(copy.storage() == im.storage());
+        CHECK(copy.data() != im.data());
+        CHECK(copy(299, 199) == 0xff00ff00);
+        mapnik::image_rgba8 moved(std::move(copy));
+        CHECK(moved(299, 199) == 0xff00ff00);
+    }
+
+    mapnik::image_any any = mapnik::create_image_any(64, 64, mapnik::image_dtype_gray16,
+                                                     mapnik::image_storage::mapped);
+    CHECK(any.get_dtype() == mapnik::image_dtype_gray16);
+    CHECK(any.size() == 64 * 64 * 2);
+
+    // pixels in memory owned by the caller, copies share it
+    std::vector<unsigned char> memory(32 * 16 * 2, 0);
+    mapnik::image_any external = mapnik::create_image_any(32, 16, mapnik::image_dtype_gray16, memory.data());
+    mapnik::image_gray16 & gray = mapnik::util::get<mapnik::image_gray16>(external);
+    CHECK(gray.storage() == mapnik::image_storage::external);
+    CHECK(gray.bytes() == memory.data());
+    CHECK(gray.size() == memory.size());
+    gray(31, 15) = 0x1234;
+    mapnik::image_gray16 shared(gray);
+    CHECK(shared.bytes() == memory.data());
+    CHECK(shared(31, 15) == 0x1234);
+
+    CHECK_THROWS(mapnik::image_rgba8(16, 16, mapnik::image_storage::external));
+} // END SECTION
+
 } // END TEST CASE
@@ -0,0 +1,126 @@
+#include "catch.hpp"
+
+#include <mapnik/image.hpp>
+#include <mapnik/image_compositing.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/geometry/box2d.hpp>
+#include <mapnik/util/const_rendering_buffer.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_rendering_buffer.h"
+#include "agg_renderer_base.h"
+#include "agg_pixfmt_rgba.h"
+#pragma GCC diagnostic pop
+
+#include <cstdint>
+#include <random>
+
+namespace {
+
+mapnik::image_rgba8 random_image(std::size_t width, std::size_t height, std::mt19937 & gen)
+{
+    mapnik::image_rgba8 im(width, height, true, true);
+    std::uniform_int_distribution<int> dist(0, 255);
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        std::uint8_t * row = reinterpret_cast<std::uint8_t *>(im.get_row(y));
+        for (std::size_t x = 0; x < width; ++x)
+        {
+            // premultiplied, with some fully opaque and fully transparent pixels
+            int a = dist(gen);
+            if (a < 32) a = 0;
+            else if (a > 224) a = 255;
+            row[4 * x + 0] = static_cast<std::uint8_t>(dist(gen) * a / 255);
+            row[4 * x + 1] = static_cast<std::uint8_t>(dist(gen) * a / 255);
+            row[4 * x + 2] = static_cast<std::uint8_t>(dist(gen) * a / 255);
+            row[4 * x + 3] = static_cast<std::uint8_t>(a);
+        }
+    }
+    return im;
+}
+
+// compositing through the agg comp_op table
+void agg_composite(mapnik::image_rgba8 & dst, mapnik::image_rgba8 const& src,
+                   mapnik::composite_mode_e mode, float opacity, int dx, int dy)
+{
+    using blender_type = agg::comp_op_adaptor_rgba_pre<agg::rgba8, agg::order_rgba>;
+    using pixfmt_type = agg::pixfmt_custom_blend_rgba<blender_type, agg::rendering_buffer>;
+    using const_rendering_buffer = mapnik::util::rendering_buffer<mapnik::image_rgba8>;
+    agg::rendering_buffer dst_buffer(dst.bytes(), dst.width(), dst.height(), dst.row_size());
+    const_rendering_buffer src_buffer(src);
+    pixfmt_type pixf(dst_buffer);
+    pixf.comp_op(static_cast<agg::comp_op_e>(mode));
+    agg::pixfmt_alpha_blend_rgba<agg::blender_rgba32_pre, const_rendering_buffer, agg::pixel32_type> pixf_mask(src_buffer);
+    agg::renderer_base<pixfmt_type> ren(pixf);
+    ren.blend_from(pixf_mask, 0, dx, dy, static_cast<agg::cover_type>(255 * opacity));
+}
+
+bool identical(mapnik::image_rgba8 const& im1, mapnik::image_rgba8 const& im2)
+{
+    for (std::size_t y = 0; y < im1.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im1.width(); ++x)
+        {
+            if (im1(x, y) != im2(x, y)) return false;
+        }
+    }
+    return true;
+}
+
+}
+
+TEST_CASE("image compositing") {
+
+SECTION("matches agg blenders") {
+    std::mt19937 gen(42);
+    mapnik::image_rgba8 src = random_image(37, 23, gen);
+    mapnik::image_rgba8 dst = random_image(41, 29, gen);
+    mapnik::composite_mode_e modes[] = { mapnik::src_over, mapnik::multiply, mapnik::screen,
+                                         mapnik::dst_in, mapnik::dst_out, mapnik::overlay };
+    float opacities[] = { 1.0f, 0.5f, 0.0f };
+    int offsets[][2] = { {0, 0}, {3, 5}, {-5, 7}, {10, -4}, {50, 0} };
+    for (auto mode : modes)
+    {
+        for (auto opacity : opacities)
+        {
+            for (auto const& offset : offsets)
+            {
+                mapnik::image_rgba8 expected(dst);
+                agg_composite(expected, src, mode, opacity, offset[0], offset[1]);
+                mapnik::image_rgba8 result(dst);
+                mapnik::composite(result, src, mode, opacity, offset[0], offset[1]);
+                INFO("mode " << *mapnik::comp_op_to_string(mode) << " opacity " << opacity
+                     << " offset " << offset[0] << "," << offset[1]);
+                CHECK(identical(expected, result));
+            }
+        }
+    }
+}
+
+SECTION("painted region") {
+    std::mt19937 gen(7);
+    mapnik::image_rgba8 src(40, 30, true, true);
+    CHECK(!mapnik::painted_extent(src).valid());
+    mapnik::image_rgba8 spot = random_image(9, 6, gen);
+    spot(0, 0) = 0xffffffff;
+    spot(8, 5) = 0xffffffff;
+    mapnik::composite(src, spot, mapnik::src, 1.0f, 12, 17);
+    mapnik::box2d<int> painted = mapnik::painted_extent(src);
+    CHECK(painted == mapnik::box2d<int>(12, 17, 21, 23));
+
+    mapnik::image_rgba8 dst = random_image(41, 29, gen);
+    for (int m = mapnik::clear; m <= mapnik::divide; ++m)
+    {
+        auto mode = static_cast<mapnik::composite_mode_e>(m);
+        if (!mapnik::composite_keeps_destination(mode)) continue;
+        mapnik::image_rgba8 expected(dst);
+        mapnik::composite(expected, src, mode, 0.5f, -3, 2);
+        mapnik::image_rgba8 result(dst);
+        mapnik::composite(result, src, painted, mode, 0.5f, -3, 2);
+        INFO("mode " << *mapnik::comp_op_to_string(mode));
+        CHECK(identical(expected, result));
+    }
+}
+
+}
@@ -8,6 +8,7 @@
 #include <mapnik/image_filter.hpp>
 #include <mapnik/image_util.hpp>
 #include <mapnik/image_filter_types.hpp>
+#include "image_filter_reference.hpp"
 // stl
 #include <sstream>
 #include <array>
@@ -521,4 +522,47 @@ SECTION("test color-blind-tritanope") {
 
 } // END SECTION
 
+SECTION("test fused filters match filters applied one by one") {
+
+    mapnik::image_rgba8 im(600,500);
+    mapnik::fill(im,mapnik::color("blue"));
+    for (std::size_t y = 0; y < im.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im.width(); x += 3)
+        {
+            mapnik::set_pixel(im, x, y, mapnik::color((x * 7) % 256, (y * 3) % 256, (x + y) % 256, (x * y) % 256));
+        }
+    }
+    for (std::string str : { "scale-hsla(0.0,0.5,0.0,1.0,0.0,0.5,0.0,0.5) invert colorize-alpha(green,blue) "
+                             "emboss gray color-to-alpha(#102030) color-blind-tritanope invert",
+                             "color-blind-protanope scale-hsla(0.2,0.9,0.1,0.8,0.0,1.0,0.1,0.9) colorize-alpha(red)",
+                             "gray color-blind-deuteranope invert agg-stack-blur(2,2) color-to-alpha(white)" })
+    {
+        INFO(str);
+        std::vector<mapnik::filter::filter_type> filters;
+        REQUIRE(parse_image_filters(str, filters));
+        for (bool premultiplied : { false, true })
+        {
+            INFO("premultiplied " << premultiplied);
+            mapnik::image_rgba8 source(im);
+            if (premultiplied) mapnik::premultiply_alpha(source);
+
+            // the filters as they were before fusing, one pass each
+            mapnik::image_rgba8 expected(source);
+            for (auto const& filter : filters)
+            {
+                mapnik::util::apply_visitor(reference::visitor(expected), filter);
+            }
+            for (unsigned threads : { 1u, 4u })
+            {
+                mapnik::image_rgba8 fused(source);
+                mapnik::filter::apply_filters(fused, filters, 1.0, threads);
+                CHECK(fused.get_premultiplied() == expected.get_premultiplied());
+                CHECK(mapnik::compare(fused, expected, 0.0, true) == 0);
+            }
+        }
+    }
+
+} // END SECTION
+
 } // END TEST CASE
@@ -0,0 +1,393 @@
+#ifndef MAPNIK_UNIT_IMAGE_FILTER_REFERENCE
+#define MAPNIK_UNIT_IMAGE_FILTER_REFERENCE
+
+// The per pixel image filters as they were before they were fused into row
+// functors: each one a full pass over the image, tracking its premultiplied
+// state as it did then. Filters reading neighbouring pixels were not
+// changed and go through filter_visitor.
+
+// mapnik
+#include <mapnik/image.hpp>
+#include <mapnik/image_filter.hpp>
+#include <mapnik/image_filter_types.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/util/hsl.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_color_rgba.h"
+#include "agg_gradient_lut.h"
+#pragma GCC diagnostic pop
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace reference {
+
+using namespace mapnik::filter;
+
+// rgba bytes of pixel x, y
+inline std::uint8_t * pixel(mapnik::image_rgba8 & im, std::size_t x, std::size_t y)
+{
+    return reinterpret_cast<std::uint8_t*>(im.get_row(y) + x);
+}
+
+inline double channel_delta(double source, double match)
+{
+    if (source > match) return (source - match) / (1.0 - match);
+    if (source < match) return (match - source) / match;
+    return (source - match);
+}
+
+inline std::uint8_t apply_alpha_shift(double source, double match, double alpha)
+{
+    source = (((source - match) / alpha) + match) * alpha;
+    return static_cast<std::uint8_t>(std::floor((source * 255.0) + .5));
+}
+
+inline void apply(mapnik::image_rgba8 & src, color_to_alpha const& op)
+{
+    bool premultiplied = src.get_premultiplied();
+    double cr = static_cast<double>(op.color.red()) / 255.0;
+    double cg = static_cast<double>(op.color.green()) / 255.0;
+    double cb = static_cast<double>(op.color.blue()) / 255.0;
+    for (std::size_t y = 0; y < src.height(); ++y)
+    {
+        for (std::size_t x = 0; x < src.width(); ++x)
+        {
+            std::uint8_t * p = pixel(src, x, y);
+            std::uint8_t & r = p[0];
+            std::uint8_t & g = p[1];
+            std::uint8_t & b = p[2];
+            std::uint8_t & a = p[3];
+            double sr = static_cast<double>(r) / 255.0;
+            double sg = static_cast<double>(g) / 255.0;
+            double sb = static_cast<double>(b) / 255.0;
+            double sa = static_cast<double>(a) / 255.0;
+            if (sa <= 0.0)
+            {
+                r = g = b = 0;
+                continue;
+            }
+            else if (premultiplied)
+            {
+                sr /= sa;
+                sg /= sa;
+                sb /= sa;
+            }
+            double xa = std::max(channel_delta(sr, cr), std::max(channel_delta(sg, cg), channel_delta(sb, cb)));
+            if (xa > 0)
+            {
+                r = apply_alpha_shift(sr, cr, xa);
+                g = apply_alpha_shift(sg, cg, xa);
+                b = apply_alpha_shift(sb, cb, xa);
+                xa *= sa;
+                a = static_cast<std::uint8_t>(std::floor((xa * 255.0) + .5));
+                if (r > a) r = a;
+                if (g > a) g = a;
+                if (b > a) b = a;
+            }
+            else
+            {
+                r = g = b = a = 0;
+            }
+        }
+    }
+    mapnik::set_premultiplied_alpha(src, true);
+}
+
+inline void apply(mapnik::image_rgba8 & src, colorize_alpha const& op)
+{
+    std::ptrdiff_t size = op.size();
+    if (size == 1)
+    {
+        mapnik::color const& c = op[0].color;
+        for (std::size_t y = 0; y < src.height(); ++y)
+        {
+            for (std::size_t x = 0; x < src.width(); ++x)
+            {
+                std::uint8_t * p = pixel(src, x, y);
+                std::uint8_t & a = p[3];
+                if (a > 0)
+                {
+                    a = (c.alpha() * a + 255) >> 8;
+                    p[0] = (c.red() * a + 255) >> 8;
+                    p[1] = (c.green() * a + 255) >> 8;
+                    p[2] = (c.blue() * a + 255) >> 8;
+                }
+            }
+        }
+        mapnik::set_premultiplied_alpha(src, true);
+    }
+    else if (size > 1)
+    {
+        agg::gradient_lut<agg::color_interpolator<agg::rgba8> > grad_lut;
+        double step = 1.0 / (size - 1);
+        double offset = 0.0;
+        for (color_stop const& stop : op)
+        {
+            mapnik::color const& c = stop.color;
+            double stop_offset = stop.offset;
+            if (stop_offset == 0)
+            {
+                stop_offset = offset;
+            }
+            grad_lut.add_color(stop_offset, agg::rgba(c.red() / 255.0,
+                                                      c.green() / 255.0,
+                                                      c.blue() / 255.0,
+                                                      c.alpha() / 255.0));
+            offset += step;
+        }
+        if (grad_lut.build_lut())
+        {
+            for (std::size_t y = 0; y < src.height(); ++y)
+            {
+                for (std::size_t x = 0; x < src.width(); ++x)
+                {
+                    std::uint8_t * p = pixel(src, x, y);
+                    std::uint8_t & a = p[3];
+                    if (a > 0)
+                    {
+                        agg::rgba8 c = grad_lut[a];
+                        a = (c.a * a + 255) >> 8;
+                        p[0] = (c.r * a + 255) >> 8;
+                        p[1] = (c.g * a + 255) >> 8;
+                        p[2] = (c.b * a + 255) >> 8;
+                    }
+                }
+            }
+        }
+        mapnik::set_premultiplied_alpha(src, true);
+    }
+}
+
+inline void apply(mapnik::image_rgba8 & src, scale_hsla const& transform)
+{
+    bool tinting = !transform.is_identity();
+    bool set_alpha = !transform.is_alpha_identity();
+    if (!tinting && !set_alpha) return;
+    bool premultiplied = src.get_premultiplied();
+    for (std::size_t y = 0; y < src.height(); ++y)
+    {
+        for (std::size_t x = 0; x < src.width(); ++x)
+        {
+            std::uint8_t * p = pixel(src, x, y);
+            std::uint8_t & r = p[0];
+            std::uint8_t & g = p[1];
+            std::uint8_t & b = p[2];
+            std::uint8_t & a = p[3];
+            double r2 = static_cast<double>(r) / 255.0;
+            double g2 = static_cast<double>(g) / 255.0;
+            double b2 = static_cast<double>(b) / 255.0;
+            double a2 = static_cast<double>(a) / 255.0;
+            if (a2 <= 0.0)
+            {
+                r = g = b = 0;
+                continue;
+            }
+            else if (premultiplied)
+            {
+                r2 /= a2;
+                g2 /= a2;
+                b2 /= a2;
+            }
+            if (set_alpha)
+            {
+                a2 = transform.a0 + (a2 * (transform.a1 - transform.a0));
+                if (a2 <= 0)
+                {
+                    r = g = b = a = 0;
+                    continue;
+                }
+                else if (a2 > 1)
+                {
+                    a2 = 1;
+                    a = 255;
+                }
+                else
+                {
+                    a = static_cast<std::uint8_t>(std::floor((a2 * 255.0) + .5));
+                }
+            }
+            if (tinting)
+            {
+                double h;
+                double s;
+                double l;
+                mapnik::rgb2hsl(r2, g2, b2, h, s, l);
+                double h2 = std::min(1.0, std::max(0.0, transform.h0 + (h * (transform.h1 - transform.h0))));
+                double s2 = std::min(1.0, std::max(0.0, transform.s0 + (s * (transform.s1 - transform.s0))));
+                double l2 = std::min(1.0, std::max(0.0, transform.l0 + (l * (transform.l1 - transform.l0))));
+                mapnik::hsl2rgb(h2, s2, l2, r2, g2, b2);
+            }
+            r2 *= a2;
+            g2 *= a2;
+            b2 *= a2;
+            r = static_cast<std::uint8_t>(std::floor((r2 * 255.0) + .5));
+            g = static_cast<std::uint8_t>(std::floor((g2 * 255.0) + .5));
+            b = static_cast<std::uint8_t>(std::floor((b2 * 255.0) + .5));
+            if (r > a) r = a;
+            if (g > a) g = a;
+            if (b > a) b = a;
+        }
+    }
+    mapnik::set_premultiplied_alpha(src, true);
+}
+
+inline void apply_color_blind(mapnik::image_rgba8 & src, color_blind_filter const& op)
+{
+    double const epsilon = std::numeric_limits<double>::epsilon();
+    bool premultiplied = src.get_premultiplied();
+    for (std::size_t y = 0; y < src.height(); ++y)
+    {
+        for (std::size_t x = 0; x < src.width(); ++x)
+        {
+            std::uint8_t * p = pixel(src, x, y);
+            std::uint8_t & r = p[0];
+            std::uint8_t & g = p[1];
+            std::uint8_t & b = p[2];
+            double dr = static_cast<double>(r) / 255.0;
+            double dg = static_cast<double>(g) / 255.0;
+            double db = static_cast<double>(b) / 255.0;
+            double da = static_cast<double>(p[3]) / 255.0;
+            if (da <= 0.0)
+            {
+                r = g = b = 0;
+                continue;
+            }
+            else if (premultiplied)
+            {
+                dr /= da;
+                dg /= da;
+                db /= da;
+            }
+            double pow_r = std::pow(dr, 2.2);
+            double pow_g = std::pow(dg, 2.2);
+            double pow_b = std::pow(db, 2.2);
+            double X = (0.412424 * pow_r) + (0.357579 * pow_g) + (0.180464 * pow_b);
+            double Y = (0.212656 * pow_r) + (0.715158 * pow_g) + (0.0721856 * pow_b);
+            double Z = (0.0193324 * pow_r) + (0.119193 * pow_g) + (0.950444 * pow_b);
+            double chroma_x = X / (X + Y + Z);
+            double chroma_y = Y / (X + Y + Z);
+            if (std::abs(chroma_x - op.x) < epsilon) continue;
+            double m = (chroma_y - op.y) / (chroma_x - op.x);
+            double yint = chroma_y - chroma_x * m;
+            if (std::abs(m - op.m) < epsilon) continue;
+            double deviate_x = (op.yint - yint) / (m - op.m);
+            double deviate_y = (m * deviate_x) + yint;
+            if (std::abs(deviate_y) < epsilon) deviate_y = epsilon * 2.0;
+            X = deviate_x * Y / deviate_y;
+            Z = (1.0 - (deviate_x + deviate_y)) * Y / deviate_y;
+            double neutral_X = 0.312713 * Y / 0.329016;
+            double neutral_Z = 0.358271 * Y / 0.329016;
+            double diff_X = neutral_X - X;
+            double diff_Z = neutral_Z - Z;
+            double diff_r = diff_X * 3.24071 + diff_Z * -0.498571;
+            double diff_g = diff_X * -0.969258 + diff_Z * 0.0415557;
+            double diff_b = diff_X * 0.0556352 + diff_Z * 1.05707;
+            if (std::abs(diff_r) < epsilon) diff_r = epsilon * 2.0;
+            if (std::abs(diff_g) < epsilon) diff_g = epsilon * 2.0;
+            if (std::abs(diff_b) < epsilon) diff_b = epsilon * 2.0;
+            dr = X * 3.24071 + Y * -1.53726 + Z * -0.498571;
+            dg = X * -0.969258 + Y * 1.87599 + Z * 0.0415557;
+            db = X * 0.0556352 + Y * -0.203996 + Z * 1.05707;
+            double fit_r = ((dr < 0.0 ? 0.0 : 1.0) - dr) / diff_r;
+            double fit_g = ((dg < 0.0 ? 0.0 : 1.0) - dg) / diff_g;
+            double fit_b = ((db < 0.0 ? 0.0 : 1.0) - db) / diff_b;
+            double adjust = std::max((fit_r > 1.0 || fit_r < 0.0) ? 0.0 : fit_r,
+                                     (fit_g > 1.0 || fit_g < 0.0) ? 0.0 : fit_g);
+            adjust = std::max((fit_b > 1.0 || fit_b < 0.0) ? 0.0 : fit_b, adjust);
+            dr = dr + (adjust * diff_r);
+            dg = dg + (adjust * diff_g);
+            db = db + (adjust * diff_b);
+            dr = std::pow(dr, 1.0 / 2.2);
+            dg = std::pow(dg, 1.0 / 2.2);
+            db = std::pow(db, 1.0 / 2.2);
+            dr *= da;
+            dg *= da;
+            db *= da;
+            if (dr < 0.0) dr = 0.0;
+            if (dr > 1.0) dr = 1.0;
+            if (dg < 0.0) dg = 0.0;
+            if (dg > 1.0) dg = 1.0;
+            if (db < 0.0) db = 0.0;
+            if (db > 1.0) db = 1.0;
+            r = static_cast<std::uint8_t>(dr * 255.0);
+            g = static_cast<std::uint8_t>(dg * 255.0);
+            b = static_cast<std::uint8_t>(db * 255.0);
+        }
+    }
+    mapnik::set_premultiplied_alpha(src, true);
+}
+
+inline void apply(mapnik::image_rgba8 & src, color_blind_protanope const& op)
+{
+    apply_color_blind(src, op);
+}
+
+inline void apply(mapnik::image_rgba8 & src, color_blind_deuteranope const& op)
+{
+    apply_color_blind(src, op);
+}
+
+inline void apply(mapnik::image_rgba8 & src, color_blind_tritanope const& op)
+{
+    apply_color_blind(src, op);
+}
+
+inline void apply(mapnik::image_rgba8 & src, gray const&)
+{
+    mapnik::premultiply_alpha(src);
+    for (std::size_t y = 0; y < src.height(); ++y)
+    {
+        for (std::size_t x = 0; x < src.width(); ++x)
+        {
+            std::uint8_t * p = pixel(src, x, y);
+            std::uint8_t v = std::uint8_t((4915 * p[0] + 9667 * p[1] + 1802 * p[2] + 8192) >> 14);
+            p[0] = p[1] = p[2] = v;
+        }
+    }
+}
+
+inline void apply(mapnik::image_rgba8 & src, invert const&)
+{
+    mapnik::premultiply_alpha(src);
+    for (std::size_t y = 0; y < src.height(); ++y)
+    {
+        for (std::size_t x = 0; x < src.width(); ++x)
+        {
+            std::uint8_t * p = pixel(src, x, y);
+            p[0] = p[3] - p[0];
+            p[1] = p[3] - p[1];
+            p[2] = p[3] - p[2];
+        }
+    }
+}
+
+// filters that were not fused
+template <typename Filter>
+void apply(mapnik::image_rgba8 & src, Filter const& filter)
+{
+    filter_visitor<mapnik::image_rgba8>(src)(filter);
+}
+
+struct visitor
+{
+    explicit visitor(mapnik::image_rgba8 & src)
+        : src_(src) {}
+
+    template <typename Filter>
+    void operator()(Filter const& filter) const
+    {
+        apply(src_, filter);
+    }
+
+    mapnik::image_rgba8 & src_;
+};
+
+}
+
+#endif // MAPNIK_UNIT_IMAGE_FILTER_REFERENCE
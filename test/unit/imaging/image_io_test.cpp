@@ -1,6 +1,10 @@
 #include "catch.hpp"
 
+#include <algorithm>
 #include <cstring>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
 #include <mapnik/color.hpp>
 #include <mapnik/image.hpp>
 #include <mapnik/image_reader.hpp>
@@ -23,6 +27,30 @@ inline void make_directory(std::string const& dir) {
 }
 
 namespace {
+
+// takes limit bytes, then fails every write
+struct limited_buf : std::streambuf
+{
+    explicit limited_buf(std::streamsize limit)
+        : left(limit) {}
+
+    std::streamsize xsputn(char const*, std::streamsize n) override
+    {
+        std::streamsize written = std::min(n, left);
+        left -= written;
+        return written;
+    }
+
+    int_type overflow(int_type c) override
+    {
+        if (left == 0) return traits_type::eof();
+        --left;
+        return c;
+    }
+
+    std::streamsize left;
+};
+
 template <typename T>
 void check_tiny_png_image_quantising(T const& im)
 {
@@ -162,6 +190,7 @@ SECTION("image_util : save_to_file/save_to_stream/save_to_string")
     supported_types.push_back(std::make_tuple("png","png32"));
     supported_types.push_back(std::make_tuple("png","png8"));
     supported_types.push_back(std::make_tuple("png","png256"));
+    supported_types.push_back(std::make_tuple("png","png8:m=hist"));
 #endif
 #if defined(HAVE_JPEG)
     supported_types.push_back(std::make_tuple("jpeg","jpeg"));
@@ -190,6 +219,13 @@ SECTION("image_util : save_to_file/save_to_stream/save_to_string")
         std::ostringstream ss;
         mapnik::save_to_stream(im, ss, format);
         CHECK(str.length() == ss.str().length());
+        // buffers are appended to and can be reused
+        std::string buffer("prefix");
+        mapnik::save_to_buffer(im, buffer, format);
+        CHECK(buffer == "prefix" + str);
+        buffer.clear();
+        mapnik::save_to_buffer(im, buffer, format);
+        CHECK(buffer == str);
         // wrap reader in scope to ensure the file handle is
         // released before we try to remove the file
         {
@@ -210,6 +246,30 @@ SECTION("image_util : save_to_file/save_to_stream/save_to_string")
     }
 }
 
+#if defined(HAVE_JPEG)
+SECTION("jpeg writer recovers from a failed write")
+{
+    mapnik::image_rgba8 im(256, 256);
+    for (unsigned y = 0; y < im.height(); ++y)
+    {
+        for (unsigned x = 0; x < im.width(); ++x)
+        {
+            im(x, y) = static_cast<std::uint32_t>(((x * 7) ^ (y * 13) ^ ((x + y) << 16)) | 0xff000000);
+        }
+    }
+    std::string expected = mapnik::save_to_string(im, "jpeg100");
+    REQUIRE(expected.size() > 4096);
+    limited_buf buf(100);
+    std::ostream out(&buf);
+    CHECK_THROWS_AS(mapnik::save_to_stream(im, out, "jpeg100"), mapnik::image_writer_exception);
+    // the thread's compressor was aborted and encodes the next image as before
+    CHECK(mapnik::save_to_string(im, "jpeg100") == expected);
+    std::ostringstream ss;
+    mapnik::save_to_stream(im, ss, "jpeg100");
+    CHECK(ss.str() == expected);
+}
+#endif
+
 SECTION("Quantising small (less than 3 pixel images preserve original colours")
 {
 #if defined(HAVE_PNG)
@@ -0,0 +1,97 @@
+#include "catch.hpp"
+
+// mapnik
+#include <mapnik/image_kernels.hpp>
+
+// stl
+#include <vector>
+#include <cstdint>
+
+namespace {
+
+std::vector<std::uint32_t> all_pixels()
+{
+    std::vector<std::uint32_t> pixels;
+    for (std::uint32_t a = 0; a < 256; ++a)
+    {
+        for (std::uint32_t c = 0; c < 256; ++c)
+        {
+            pixels.push_back((a << 24) | (c << 16) | ((255 - c) << 8) | ((c * 7) & 0xff));
+        }
+    }
+    // an odd count for the tails
+    pixels.push_back(0x7f102030);
+    return pixels;
+}
+
+}
+
+TEST_CASE("image kernels") {
+
+SECTION("scalar kernels match agg") {
+    auto const& scalar = mapnik::simd::rgba8(mapnik::simd::isa::scalar);
+    std::uint32_t pixels[] = { 0x80ff8040, 0x00ffffff, 0xffabcdef, 0x80402010 };
+    scalar.premultiply(pixels, 3);
+    CHECK(pixels[0] == 0x80804020);
+    CHECK(pixels[1] == 0x00000000);
+    CHECK(pixels[2] == 0xffabcdef);
+    scalar.demultiply(pixels + 3, 1);
+    CHECK(pixels[3] == 0x807f3f1f);
+}
+
+SECTION("every supported kernel gives the scalar result") {
+    using mapnik::simd::isa;
+    auto const& scalar = mapnik::simd::rgba8(isa::scalar);
+    std::vector<std::uint32_t> const pixels = all_pixels();
+    for (isa id : { isa::sse2, isa::avx2, isa::neon })
+    {
+        if (!mapnik::simd::supported(id)) continue;
+        auto const& kernels = mapnik::simd::rgba8(id);
+        INFO(kernels.name);
+        CHECK(kernels.id == id);
+
+        auto expected = pixels;
+        auto actual = pixels;
+        scalar.premultiply(expected.data(), expected.size());
+        kernels.premultiply(actual.data(), actual.size());
+        CHECK(expected == actual);
+
+        expected = actual = pixels;
+        scalar.demultiply(expected.data(), expected.size());
+        kernels.demultiply(actual.data(), actual.size());
+        CHECK(expected == actual);
+
+        for (float opacity : { 0.0f, 0.25f, 0.5f, 0.99f, 1.0f })
+        {
+            expected = actual = pixels;
+            scalar.apply_opacity(expected.data(), expected.size(), opacity);
+            kernels.apply_opacity(actual.data(), actual.size(), opacity);
+            CHECK(expected == actual);
+        }
+
+        expected = actual = pixels;
+        scalar.set_color_to_alpha(expected.data(), expected.size(), 0x00ff00);
+        kernels.set_color_to_alpha(actual.data(), actual.size(), 0x00ff00);
+        CHECK(expected == actual);
+
+        std::vector<std::uint32_t> solid(1001, 0x40302010);
+        CHECK(kernels.all_equal(solid.data(), solid.size(), 0x40302010));
+        for (std::size_t i : { std::size_t(0), std::size_t(9), std::size_t(1000) })
+        {
+            auto mixed = solid;
+            mixed[i] = 0;
+            CHECK_FALSE(kernels.all_equal(mixed.data(), mixed.size(), 0x40302010));
+        }
+    }
+}
+
+SECTION("select") {
+    using mapnik::simd::isa;
+    isa const active = mapnik::simd::rgba8().id;
+    CHECK(mapnik::simd::select(isa::scalar));
+    CHECK(mapnik::simd::rgba8().id == isa::scalar);
+    CHECK(mapnik::simd::select(active));
+    CHECK(mapnik::simd::rgba8().id == active);
+}
+
+}
@@ -0,0 +1,86 @@
+#include "catch.hpp"
+
+#include <mapnik/image.hpp>
+#include <mapnik/image_any.hpp>
+#include <mapnik/image_reader.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/util/variant.hpp>
+
+#include <memory>
+#include <string>
+
+namespace {
+
+mapnik::image_rgba8 test_image(std::size_t width, std::size_t height)
+{
+    mapnik::image_rgba8 im(width, height);
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        for (std::size_t x = 0; x < width; ++x)
+        {
+            im(x, y) = (x * 5 % 256) | ((y * 3 % 256) << 8) | ((x * y % 256) << 16) | (0xffu << 24);
+        }
+    }
+    return im;
+}
+
+// whether the windows read match the pixels of a full read
+bool windows_match(std::string const& data, unsigned reduction)
+{
+    std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(data.data(), data.size()));
+    REQUIRE(reader);
+    unsigned width = (reader->width() + reduction - 1) / reduction;
+    unsigned height = (reader->height() + reduction - 1) / reduction;
+    mapnik::image_any full_any = reader->read_reduced(0, 0, width, height, reduction);
+    auto const& full = mapnik::util::get<mapnik::image_rgba8>(full_any);
+    REQUIRE(full.width() == width);
+    REQUIRE(full.height() == height);
+    unsigned windows[][4] = { { 0, 0, width, height }, { 0, height / 3, width, height / 4 },
+                              { width / 5, height / 7, width / 3, height / 2 },
+                              { width - 1, height - 1, 1, 1 }, { 3, 0, width / 9, height } };
+    for (auto const& w : windows)
+    {
+        mapnik::image_any window_any = reader->read_reduced(w[0], w[1], w[2], w[3], reduction);
+        auto const& window = mapnik::util::get<mapnik::image_rgba8>(window_any);
+        for (std::size_t y = 0; y < window.height(); ++y)
+        {
+            for (std::size_t x = 0; x < window.width(); ++x)
+            {
+                if (window(x, y) != full(w[0] + x, w[1] + y)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+}
+
+TEST_CASE("image reader windows") {
+
+SECTION("png windows") {
+#if defined(HAVE_PNG)
+    std::string data = mapnik::save_to_string(test_image(301, 203), "png32");
+    std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(data.data(), data.size()));
+    REQUIRE(reader);
+    CHECK(reader->max_reduction() == 1);
+    CHECK_THROWS(reader->read_reduced(0, 0, 10, 10, 2));
+    CHECK(windows_match(data, 1));
+#endif
+}
+
+SECTION("jpeg windows and reductions") {
+#if defined(HAVE_JPEG)
+    std::string data = mapnik::save_to_string(test_image(301, 203), "jpeg90");
+    std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(data.data(), data.size()));
+    REQUIRE(reader);
+    CHECK(reader->max_reduction() == 8);
+    for (unsigned reduction : { 1u, 2u, 4u, 8u })
+    {
+        INFO("reduction " << reduction);
+        CHECK(windows_match(data, reduction));
+    }
+    CHECK_THROWS(reader->read_reduced(0, 0, 10, 10, 3));
+#endif
+}
+
+}
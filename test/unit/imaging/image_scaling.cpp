@@ -0,0 +1,49 @@
+#include "catch.hpp"
+
+#include <mapnik/image.hpp>
+#include <mapnik/image_scaling.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+template <typename T>
+T scale(T const& source, mapnik::scaling_method_e scaling_method, unsigned threads)
+{
+    T target(700, 500, true, true);
+    mapnik::scale_image_agg(target, source, scaling_method, 700.0 / source.width(), 500.0 / source.height(),
+                            0.0, 0.0, 1.0, boost::optional<double>(), threads);
+    return target;
+}
+
+}
+
+TEST_CASE("scale_image_agg") {
+
+SECTION("split between threads matches a single pass") {
+    mapnik::image_rgba8 source(300, 200);
+    mapnik::image_gray16 gray(300, 200);
+    for (unsigned y = 0; y < source.height(); ++y)
+    {
+        for (unsigned x = 0; x < source.width(); ++x)
+        {
+            source(x, y) = 0xff000000 | ((x & 0xff) << 8) | (y & 0xff);
+            gray(x, y) = static_cast<std::uint16_t>(x * y);
+        }
+    }
+    for (auto scaling_method : { mapnik::SCALING_NEAR, mapnik::SCALING_BILINEAR, mapnik::SCALING_LANCZOS })
+    {
+        mapnik::image_rgba8 expected = scale(source, scaling_method, 1);
+        CHECK(expected(350, 250) != 0);
+        CHECK(expected(699, 499) != 0);
+        mapnik::image_rgba8 threaded = scale(source, scaling_method, 3);
+        CHECK(std::equal(expected.begin(), expected.end(), threaded.begin()));
+
+        mapnik::image_gray16 expected_gray = scale(gray, scaling_method, 1);
+        mapnik::image_gray16 threaded_gray = scale(gray, scaling_method, 3);
+        CHECK(std::equal(expected_gray.begin(), expected_gray.end(), threaded_gray.begin()));
+    }
+}
+
+}
@@ -0,0 +1,82 @@
+#include "catch.hpp"
+
+// mapnik
+#include <mapnik/image.hpp>
+#include <mapnik/image_any.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/image_tile_cache.hpp>
+#include <mapnik/color.hpp>
+#include <mapnik/util/fs.hpp>
+
+// stl
+#include <cstdio>
+
+TEST_CASE("image tile cache") {
+
+SECTION("windows copy the pixels") {
+    mapnik::image_gray16 im(8, 6);
+    for (std::size_t y = 0; y < im.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im.width(); ++x)
+        {
+            im(x, y) = static_cast<std::uint16_t>(y * 100 + x);
+        }
+    }
+    im.set_offset(2.0);
+    mapnik::image_any source(std::move(im));
+    mapnik::image_any window = mapnik::image_tile_cache::window(source, 3, 2, 4, 3);
+    REQUIRE(window.is<mapnik::image_gray16>());
+    CHECK(window.width() == 4);
+    CHECK(window.height() == 3);
+    CHECK(window.get_offset() == 2.0);
+    auto const& data = mapnik::util::get<mapnik::image_gray16>(window);
+    CHECK(data(0, 0) == 203);
+    CHECK(data(3, 2) == 406);
+    // clipped to the source
+    mapnik::image_any edge = mapnik::image_tile_cache::window(source, 6, 4, 4, 4);
+    CHECK(edge.width() == 2);
+    CHECK(edge.height() == 2);
+    CHECK(mapnik::image_tile_cache::window(source, 8, 0, 1, 1).is<mapnik::image_null>());
+}
+
+SECTION("decoded files are kept within the budget") {
+#if defined(HAVE_PNG)
+    mapnik::image_tile_cache & cache = mapnik::image_tile_cache::instance();
+    std::size_t max_bytes = cache.max_bytes();
+    cache.clear();
+    std::string filename("/tmp/mapnik-image-tile-cache-test.png");
+    mapnik::image_rgba8 im(16, 16);
+    mapnik::fill(im, mapnik::color(10, 20, 30));
+    mapnik::save_to_file(im, filename, "png32");
+
+    // no budget, nothing kept
+    CHECK(cache.get(filename, "png"));
+    CHECK(cache.size() == 0);
+
+    cache.set_max_bytes(16 * 16 * 4 * 2);
+    auto first = cache.get(filename, "png");
+    REQUIRE(first);
+    CHECK(first->width() == 16);
+    CHECK(cache.size() == 1);
+    CHECK(cache.size_bytes() == 16 * 16 * 4);
+    CHECK(cache.get(filename, "png") == first);
+    CHECK(cache.hits() == 1);
+
+    // a rewritten file is decoded again
+    mapnik::image_rgba8 larger(16, 24);
+    mapnik::save_to_file(larger, filename, "png32");
+    auto second = cache.get(filename, "png");
+    REQUIRE(second);
+    CHECK(second->height() == 24);
+    CHECK(cache.size() == 1);
+
+    cache.set_max_bytes(0);
+    CHECK(cache.size() == 0);
+    CHECK(cache.size_bytes() == 0);
+    cache.set_max_bytes(max_bytes);
+    cache.clear();
+    std::remove(filename.c_str());
+#endif
+}
+
+}
@@ -0,0 +1,214 @@
+#include "catch.hpp"
+
+#include <mapnik/image.hpp>
+#include <mapnik/image_view.hpp>
+#include <mapnik/image_reader.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/image_util_png.hpp>
+#include <mapnik/util/variant.hpp>
+#if defined(HAVE_PNG)
+#include <mapnik/png_io.hpp>
+#endif
+
+#include <memory>
+#include <string>
+
+namespace {
+
+mapnik::image_rgba8 test_image(std::size_t width, std::size_t height, unsigned colors)
+{
+    mapnik::image_rgba8 im(width, height);
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        for (std::size_t x = 0; x < width; ++x)
+        {
+            unsigned c = (x / 4 + y / 3) % colors;
+            unsigned a = (c % 3 == 0) ? 255 : c * 7 % 256;
+            im(x, y) = (c * 37 % 256) | ((c * 91 % 256) << 8) | ((c * 53 % 256) << 16) | (a << 24);
+        }
+    }
+    return im;
+}
+
+mapnik::image_rgba8 decode(std::string const& str)
+{
+    std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(str.data(), str.size()));
+    REQUIRE(reader);
+    return mapnik::util::get<mapnik::image_rgba8>(reader->read(0, 0, reader->width(), reader->height()));
+}
+
+bool identical(mapnik::image_rgba8 const& im1, mapnik::image_rgba8 const& im2)
+{
+    if (im1.width() != im2.width() || im1.height() != im2.height()) return false;
+    for (std::size_t y = 0; y < im1.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im1.width(); ++x)
+        {
+            if (im1(x, y) != im2(x, y)) return false;
+        }
+    }
+    return true;
+}
+
+}
+
+TEST_CASE("png io") {
+
+SECTION("deflate encoder matches libpng") {
+#if defined(HAVE_PNG)
+    mapnik::image_rgba8 images[] = { test_image(67, 41, 200), test_image(33, 17, 12), test_image(9, 5, 1) };
+    std::string formats[] = { "png32", "png32:t=0", "png32:f=all", "png32:f=paeth:z=9",
+                              "png8", "png8:m=o", "png8:m=hist:f=fast", "png8:t=0" };
+    for (auto const& im : images)
+    {
+        for (auto const& format : formats)
+        {
+            INFO("format " << format << " size " << im.width() << "x" << im.height());
+            std::string expected = mapnik::save_to_string(im, format + ":e=libpng");
+            std::string result;
+            mapnik::save_to_png_string(im, result, format + ":e=deflate");
+            CHECK(identical(decode(expected), decode(result)));
+            std::string streamed = mapnik::save_to_string(im, format + ":e=deflate");
+            CHECK(streamed == result);
+        }
+    }
+#endif
+}
+
+SECTION("premultiplied images are demultiplied while encoding") {
+#if defined(HAVE_PNG)
+    mapnik::image_rgba8 premultiplied = test_image(67, 41, 200);
+    mapnik::premultiply_alpha(premultiplied);
+    mapnik::image_rgba8 demultiplied(premultiplied);
+    mapnik::demultiply_alpha(demultiplied);
+    mapnik::image_view_rgba8 view(3, 5, 40, 30, premultiplied);
+    mapnik::image_view_rgba8 expected_view(3, 5, 40, 30, demultiplied);
+    std::string formats[] = { "png32", "png32:t=0", "png32:f=all", "png8", "png8:m=o", "png8:m=hist" };
+    for (auto const& format : formats)
+    {
+        for (std::string encoder : { ":e=libpng", ":e=deflate" })
+        {
+            INFO("format " << format << encoder);
+            CHECK(mapnik::save_to_string(premultiplied, format + encoder) ==
+                  mapnik::save_to_string(demultiplied, format + encoder));
+            CHECK(mapnik::save_to_string(view, format + encoder) ==
+                  mapnik::save_to_string(expected_view, format + encoder));
+        }
+    }
+    // the image is left alone
+    CHECK(premultiplied.get_premultiplied());
+#endif
+}
+
+SECTION("readers premultiply while decoding") {
+#if defined(HAVE_PNG)
+    std::string str = mapnik::save_to_string(test_image(67, 41, 200), "png32");
+    std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(str.data(), str.size()));
+    REQUIRE(reader);
+    mapnik::image_rgba8 expected = decode(str);
+    mapnik::premultiply_alpha(expected);
+    reader->set_premultiply(true);
+    mapnik::image_rgba8 im = mapnik::util::get<mapnik::image_rgba8>(reader->read(0, 0, 67, 41));
+    CHECK(im.get_premultiplied());
+    CHECK(identical(im, expected));
+    // windows
+    mapnik::image_rgba8 window = mapnik::util::get<mapnik::image_rgba8>(reader->read(5, 7, 30, 20));
+    CHECK(window.get_premultiplied());
+    bool same = true;
+    for (std::size_t y = 0; y < 20; ++y)
+    {
+        for (std::size_t x = 0; x < 30; ++x)
+        {
+            if (window(x, y) != expected(x + 5, y + 7)) same = false;
+        }
+    }
+    CHECK(same);
+    // opaque images are marked only
+    std::string opaque = mapnik::save_to_string(test_image(16, 16, 4), "png32:t=0");
+    reader.reset(mapnik::get_image_reader(opaque.data(), opaque.size()));
+    reader->set_premultiply(true);
+    im = mapnik::util::get<mapnik::image_rgba8>(reader->read(0, 0, 16, 16));
+    CHECK(im.get_premultiplied());
+    CHECK(identical(im, decode(opaque)));
+#endif
+}
+
+SECTION("output is appended to the string") {
+#if defined(HAVE_PNG)
+    mapnik::image_rgba8 im = test_image(16, 16, 4);
+    std::string expected = mapnik::save_to_string(im, "png");
+    std::string out("prefix");
+    mapnik::save_to_png_string(im, out, "png");
+    CHECK(out == "prefix" + expected);
+#endif
+}
+
+SECTION("tiles are encoded in parallel") {
+#if defined(HAVE_PNG)
+    mapnik::image_rgba8 im = test_image(100, 70, 50);
+    std::vector<std::string> tiles = mapnik::save_tiles_to_string(im, "png", 32, 32, 4);
+    REQUIRE(tiles.size() == 12);
+    for (std::size_t i = 0; i < tiles.size(); ++i)
+    {
+        std::size_t x = (i % 4) * 32;
+        std::size_t y = (i / 4) * 32;
+        mapnik::image_view_rgba8 view(x, y, std::min<std::size_t>(32, 100 - x), std::min<std::size_t>(32, 70 - y), im);
+        CHECK(tiles[i] == mapnik::save_to_string(view, "png"));
+    }
+    // one palette for all tiles
+    std::vector<std::string> shared = mapnik::save_tiles_to_string(im, "png8:c=64", 32, 32, 4, true);
+    REQUIRE(shared.size() == 12);
+    CHECK(shared == mapnik::save_tiles_to_string(im, "png8:c=64", 32, 32, 1, true));
+    for (auto const& tile : shared)
+    {
+        CHECK(decode(tile).width() > 0);
+    }
+#endif
+}
+
+SECTION("images are written a band at a time") {
+#if defined(HAVE_PNG)
+    mapnik::image_rgba8 im = test_image(67, 41, 200);
+    for (std::string format : { "png32", "png32:t=0" })
+    {
+        INFO("format " << format);
+        mapnik::png_options opts;
+        opts.trans_mode = format == "png32" ? -1 : 0;
+        std::string banded;
+        mapnik::png_row_writer<std::string> writer(banded, im.width(), im.height(), opts);
+        for (std::size_t y = 0; y < im.height(); y += 16)
+        {
+            std::size_t rows = std::min<std::size_t>(16, im.height() - y);
+            writer.write_rows(mapnik::image_view_rgba8(0, y, im.width(), rows, im));
+        }
+        CHECK(writer.rows_written() == im.height());
+        writer.finish();
+        CHECK(banded == mapnik::save_to_string(im, format + ":e=libpng"));
+    }
+    std::string out;
+    mapnik::png_row_writer<std::string> writer(out, 4, 4, mapnik::png_options());
+    CHECK_THROWS(writer.write_rows(mapnik::image_rgba8(5, 1)));
+    writer.write_rows(mapnik::image_rgba8(4, 3));
+    CHECK_THROWS(writer.finish());
+#endif
+}
+
+SECTION("use_hextree is kept but ignored") {
+#if defined(HAVE_PNG)
+    mapnik::image_rgba8 im = test_image(67, 41, 200);
+    mapnik::png_options opts;
+    CHECK(opts.use_hextree);
+    CHECK(opts.quantizer == mapnik::PNG_QUANTIZER_HEXTREE);
+    std::string with, without;
+    mapnik::png_row_writer<std::string> with_writer(with, im.width(), im.height(), opts);
+    with_writer.write_rows(im);
+    with_writer.finish();
+    opts.use_hextree = false;
+    mapnik::png_row_writer<std::string> without_writer(without, im.width(), im.height(), opts);
+    without_writer.write_rows(im);
+    without_writer.finish();
+    CHECK(with == without);
+#endif
+}
+
+}
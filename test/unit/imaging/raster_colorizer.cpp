@@ -0,0 +1,77 @@
+#include "catch.hpp"
+
+#include <mapnik/raster_colorizer.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/feature.hpp>
+
+#include <cmath>
+
+namespace {
+
+mapnik::raster_colorizer make_colorizer()
+{
+    mapnik::raster_colorizer colorizer(mapnik::COLORIZER_LINEAR, mapnik::color(0, 0, 0, 0));
+    colorizer.add_stop(mapnik::colorizer_stop(-100, mapnik::COLORIZER_LINEAR, mapnik::color(0, 0, 255)));
+    colorizer.add_stop(mapnik::colorizer_stop(0, mapnik::COLORIZER_DISCRETE, mapnik::color(0, 255, 0)));
+    colorizer.add_stop(mapnik::colorizer_stop(50, mapnik::COLORIZER_LINEAR, mapnik::color(255, 255, 0)));
+    colorizer.add_stop(mapnik::colorizer_stop(200, mapnik::COLORIZER_EXACT, mapnik::color(255, 0, 0)));
+    colorizer.add_stop(mapnik::colorizer_stop(1000, mapnik::COLORIZER_LINEAR, mapnik::color(255, 255, 255)));
+    return colorizer;
+}
+
+template <typename T>
+bool colorize_matches_get_color(mapnik::raster_colorizer const& colorizer, T const& in,
+                                boost::optional<double> const& nodata, unsigned threads)
+{
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_impl feature(ctx, 1);
+    mapnik::image_rgba8 out(in.width(), in.height());
+    colorizer.colorize(out, in, nodata, feature, threads);
+    for (std::size_t y = 0; y < in.height(); ++y)
+    {
+        for (std::size_t x = 0; x < in.width(); ++x)
+        {
+            auto val = in(x, y);
+            unsigned expected = (nodata && std::fabs(val - *nodata) < colorizer.get_epsilon()) ? 0 : colorizer.get_color(val);
+            if (out(x, y) != expected) return false;
+        }
+    }
+    return true;
+}
+
+}
+
+TEST_CASE("raster_colorizer") {
+
+SECTION("stops are found by value") {
+    mapnik::raster_colorizer colorizer = make_colorizer();
+    CHECK(colorizer.get_color(-200) == mapnik::color(0, 0, 0, 0).rgba());
+    CHECK(colorizer.get_color(25) == mapnik::color(0, 255, 0).rgba());
+    CHECK(colorizer.get_color(200) == mapnik::color(255, 0, 0).rgba());
+    CHECK(colorizer.get_color(201) == mapnik::color(0, 0, 0, 0).rgba());
+    CHECK(colorizer.get_color(5000) == mapnik::color(255, 255, 255).rgba());
+    CHECK(colorizer.get_color(-50) == mapnik::color(0, 127, 127).rgba());
+}
+
+SECTION("lookup tables and threads give the per pixel colors") {
+    mapnik::raster_colorizer colorizer = make_colorizer();
+    mapnik::image_gray16s dem16(300, 300);
+    mapnik::image_gray8 dem8(300, 300);
+    mapnik::image_gray32f demf(300, 300);
+    for (std::size_t y = 0; y < 300; ++y)
+    {
+        for (std::size_t x = 0; x < 300; ++x)
+        {
+            dem16(x, y) = static_cast<std::int16_t>(x * 5 - y * 2);
+            dem8(x, y) = static_cast<std::uint8_t>(x + y);
+            demf(x, y) = static_cast<float>(x) * 4.5f - static_cast<float>(y);
+        }
+    }
+    boost::optional<double> nodata(-2.0);
+    CHECK(colorize_matches_get_color(colorizer, dem16, nodata, 1));
+    CHECK(colorize_matches_get_color(colorizer, dem16, boost::optional<double>(), 4));
+    CHECK(colorize_matches_get_color(colorizer, dem8, nodata, 1));
+    CHECK(colorize_matches_get_color(colorizer, demf, nodata, 4));
+}
+
+}
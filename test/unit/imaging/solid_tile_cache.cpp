@@ -0,0 +1,64 @@
+#include "catch.hpp"
+
+// mapnik
+#include <mapnik/image.hpp>
+#include <mapnik/image_view.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/solid_tile_cache.hpp>
+#include <mapnik/color.hpp>
+
+TEST_CASE("solid tile cache") {
+
+SECTION("lru eviction") {
+    mapnik::solid_tile_cache & cache = mapnik::solid_tile_cache::instance();
+    std::size_t max_bytes = cache.max_bytes();
+    cache.clear();
+    cache.set_max_bytes(10);
+    mapnik::solid_tile_cache::key_type a("png", 256, 256, 0, false);
+    mapnik::solid_tile_cache::key_type b("png", 256, 256, 1, false);
+    mapnik::solid_tile_cache::key_type c("jpeg", 256, 256, 1, false);
+    cache.insert(a, "aaaa");
+    cache.insert(b, "bbbb");
+    REQUIRE(cache.find(a));
+    CHECK(*cache.find(a) == "aaaa");
+    cache.insert(c, "cccc");
+    CHECK(cache.size() == 2);
+    CHECK(cache.find(a));
+    CHECK_FALSE(cache.find(b));
+    cache.insert(b, "too many bytes");
+    CHECK_FALSE(cache.find(b));
+    cache.set_max_bytes(0);
+    CHECK(cache.size() == 0);
+    cache.set_max_bytes(max_bytes);
+}
+
+SECTION("solid images are encoded once") {
+#if defined(HAVE_PNG)
+    mapnik::solid_tile_cache & cache = mapnik::solid_tile_cache::instance();
+    cache.clear();
+    mapnik::image_rgba8 im(64, 64);
+    mapnik::fill(im, mapnik::color(170, 211, 223));
+    std::string first = mapnik::save_to_string(im, "png8:z=1");
+    CHECK(cache.size() == 1);
+    CHECK(mapnik::save_to_string(im, "png8:z=1") == first);
+    CHECK(cache.size() == 1);
+
+    // a view of the same size and color reuses the buffer
+    mapnik::image_rgba8 large(128, 64);
+    mapnik::fill(large, mapnik::color(170, 211, 223));
+    mapnik::image_view_rgba8 view(64, 0, 64, 64, large);
+    std::string buffer("prefix");
+    mapnik::save_to_buffer(view, buffer, "png8:z=1");
+    CHECK(buffer == "prefix" + first);
+    CHECK(cache.size() == 1);
+
+    // other options, sizes and colors are other entries
+    mapnik::save_to_string(im, "png32");
+    mapnik::set_pixel(im, 3, 3, mapnik::color(0, 0, 0));
+    mapnik::save_to_string(im, "png8:z=1");
+    CHECK(cache.size() == 2);
+    cache.clear();
+#endif
+}
+
+}
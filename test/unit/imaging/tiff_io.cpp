@@ -13,6 +13,7 @@
 #include <mapnik/util/fs.hpp>
 #include <boost/interprocess/streams/bufferstream.hpp>
 #include "../../../src/tiff_reader.cpp"
+#include "tiff_overviews.hpp"
 
 #if defined(MAPNIK_MEMORY_MAPPED_FILE)
 using source_type = boost::interprocess::ibufferstream;
@@ -169,6 +170,47 @@ void test_tiff_reader(std::string const& pattern)
     }
 }
 
+template <typename Image>
+void test_tiff_decode_threads(std::string const& filename)
+{
+    mapnik::util::file file(filename);
+    mapnik::tiff_reader<mapnik::util::char_array_buffer> tiff_reader(file.data().get(), file.size());
+    mapnik::tiff_reader<mapnik::util::char_array_buffer> tiff_reader2(file.data().get(), file.size());
+    tiff_reader2.set_decode_threads(4);
+    auto width = tiff_reader.width();
+    auto height = tiff_reader.height();
+    {
+        // whole image
+        auto im = tiff_reader.read(0, 0, width, height);
+        auto im2 = tiff_reader2.read(0, 0, width, height);
+        REQUIRE(im.is<Image>());
+        REQUIRE(im2.is<Image>());
+        REQUIRE(identical(im.get<Image>(), im2.get<Image>()));
+    }
+    {
+        // portion
+        auto im = tiff_reader.read(11, 13, width - 23, height - 29);
+        auto im2 = tiff_reader2.read(11, 13, width - 23, height - 29);
+        REQUIRE(im2.is<Image>());
+        REQUIRE(identical(im.get<Image>(), im2.get<Image>()));
+    }
+}
+
+bool filled_with(mapnik::image_any const& data, unsigned size, std::uint8_t value)
+{
+    if (!data.is<mapnik::image_gray8>()) return false;
+    auto const& im = data.get<mapnik::image_gray8>();
+    if (im.width() != size || im.height() != size) return false;
+    for (std::size_t y = 0; y < im.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im.width(); ++x)
+        {
+            if (im(x, y) != value) return false;
+        }
+    }
+    return true;
+}
+
 }
 
 TEST_CASE("tiff io")
@@ -183,6 +225,91 @@ TEST_CASE("tiff io")
         test_tiff_reader<mapnik::image_gray8>("tiff_gray");
     }
 
+    SECTION("decode threads")
+    {
+        test_tiff_decode_threads<mapnik::image_rgba8>("./test/data/tiff/scan_512x512_rgb8_tiled.tif");
+        test_tiff_decode_threads<mapnik::image_rgba8>("./test/data/tiff/scan_512x512_rgb8_striped.tif");
+        test_tiff_decode_threads<mapnik::image_gray16>("./test/data/tiff/ndvi_256x256_gray16_striped.tif");
+        test_tiff_decode_threads<mapnik::image_gray32f>("./test/data/tiff/ndvi_256x256_gray32f_tiled.tif");
+    }
+
+    SECTION("encode threads")
+    {
+        mapnik::image_rgba8 im(301, 203);
+        for (std::size_t y = 0; y < im.height(); ++y)
+        {
+            for (std::size_t x = 0; x < im.width(); ++x)
+            {
+                im(x, y) = static_cast<std::uint32_t>(((x * 7) ^ (y * 13) ^ ((x + y) << 16)) | 0xff000000);
+            }
+        }
+        mapnik::image_gray16 gray(130, 97);
+        for (std::size_t y = 0; y < gray.height(); ++y)
+        {
+            for (std::size_t x = 0; x < gray.width(); ++x)
+            {
+                gray(x, y) = static_cast<std::uint16_t>(x * y);
+            }
+        }
+        mapnik::image_any gray_any(std::move(gray));
+        for (std::string format : { "tiff:method=stripped:rows_per_strip=16",
+                                    "tiff:method=stripped:rows_per_strip=7:compression=lzw",
+                                    "tiff:method=tiled:tile_width=64:tile_height=32",
+                                    "tiff:method=tiled:tile_width=32:tile_height=48:compression=none" })
+        {
+            INFO(format);
+            // the same file on any number of threads
+            std::string expected = mapnik::save_to_string(im, format);
+            CHECK(mapnik::save_to_string(im, format + ":threads=4") == expected);
+            CHECK(mapnik::save_to_string(gray_any, format + ":threads=3") == mapnik::save_to_string(gray_any, format));
+            std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(expected.data(), expected.size()));
+            REQUIRE(reader);
+            mapnik::image_any decoded = reader->read(0, 0, reader->width(), reader->height());
+            REQUIRE(decoded.is<mapnik::image_rgba8>());
+            CHECK(identical(decoded.get<mapnik::image_rgba8>(), im));
+        }
+        CHECK_THROWS(mapnik::save_to_string(im, "tiff:threads=0"));
+    }
+
+    SECTION("overviews")
+    {
+        std::string filename = mapnik::util::temp_filename("/tmp/mapnik-tiff-overviews");
+        write_tiff_with_overviews(filename);
+        mapnik::util::file file(filename);
+        mapnik::util::remove(filename);
+        REQUIRE(file.size() > 0);
+        auto data = file.data();
+        mapnik::tiff_reader<mapnik::util::char_array_buffer> tiff_reader(data.get(), file.size());
+        // the directory scan keeps the 32x32 and 16x16 images only
+        CHECK(tiff_reader.width() == 64);
+        CHECK(tiff_reader.height() == 64);
+        CHECK(tiff_reader.has_overviews());
+        CHECK(tiff_reader.max_reduction() == 4);
+
+        CHECK(filled_with(tiff_reader.read(0, 0, 64, 64), 64, 10));
+        CHECK(filled_with(tiff_reader.read_reduced(0, 0, 32, 32, 2), 32, 20));
+        CHECK(filled_with(tiff_reader.read_reduced(0, 0, 16, 16, 4), 16, 30));
+        CHECK(filled_with(tiff_reader.read_reduced(4, 4, 8, 8, 4), 8, 30));
+        CHECK(filled_with(tiff_reader.read_reduced(0, 0, 64, 64, 1), 64, 10));
+        CHECK_THROWS(tiff_reader.read_reduced(0, 0, 8, 8, 8));
+        // the full image is current again after an overview was read
+        CHECK(tiff_reader.width() == 64);
+        CHECK(filled_with(tiff_reader.read(0, 0, 64, 64), 64, 10));
+
+        std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(data.get(), file.size()));
+        REQUIRE(reader);
+        CHECK(reader->has_overviews());
+        CHECK(filled_with(reader->read_reduced(0, 0, 32, 32, 2), 32, 20));
+
+        // files without overviews only read at full size
+        mapnik::image_gray8 plain(64, 64);
+        std::string encoded = mapnik::save_to_string(plain, "tiff");
+        std::unique_ptr<mapnik::image_reader> plain_reader(mapnik::get_image_reader(encoded.data(), encoded.size()));
+        REQUIRE(plain_reader);
+        CHECK_FALSE(plain_reader->has_overviews());
+        CHECK(plain_reader->max_reduction() == 1);
+    }
+
     SECTION("scan rgb8 striped")
     {
         std::string filename("./test/data/tiff/scan_512x512_rgb8_striped.tif");
@@ -0,0 +1,51 @@
+#ifndef MAPNIK_UNIT_TIFF_OVERVIEWS
+#define MAPNIK_UNIT_TIFF_OVERVIEWS
+
+#include "catch.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include <tiffio.h>
+}
+
+namespace {
+
+// A 64x64 gray8 tiff followed by its 32x32 and 16x16 overviews, with a
+// mask and a reduced image of the wrong size between them that are not
+// overviews. Every directory is filled with a value of its own.
+void write_tiff_with_overviews(std::string const& filename)
+{
+    TIFF* tif = TIFFOpen(filename.c_str(), "w");
+    REQUIRE(tif != nullptr);
+    struct directory { std::uint32_t size; std::uint32_t type; std::uint8_t value; };
+    for (directory const& dir : { directory{64, 0, 10},
+                                  directory{32, FILETYPE_REDUCEDIMAGE, 20},
+                                  directory{32, FILETYPE_REDUCEDIMAGE | FILETYPE_MASK, 99},
+                                  directory{20, FILETYPE_REDUCEDIMAGE, 98},
+                                  directory{16, FILETYPE_REDUCEDIMAGE, 30} })
+    {
+        TIFFSetField(tif, TIFFTAG_SUBFILETYPE, dir.type);
+        TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, dir.size);
+        TIFFSetField(tif, TIFFTAG_IMAGELENGTH, dir.size);
+        TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+        TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+        TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+        TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+        TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, 8);
+        std::vector<std::uint8_t> row(dir.size, dir.value);
+        for (std::uint32_t y = 0; y < dir.size; ++y)
+        {
+            REQUIRE(TIFFWriteScanline(tif, row.data(), y, 0) == 1);
+        }
+        REQUIRE(TIFFWriteDirectory(tif));
+    }
+    TIFFClose(tif);
+}
+
+}
+
+#endif // MAPNIK_UNIT_TIFF_OVERVIEWS
@@ -0,0 +1,108 @@
+#include "catch.hpp"
+
+#include <mapnik/warp.hpp>
+#include <mapnik/warp_mesh_cache.hpp>
+#include <mapnik/image.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/util/fs.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/filesystem/operations.hpp>
+#pragma GCC diagnostic pop
+
+#include <algorithm>
+
+namespace {
+
+mapnik::image_rgba8 warp(mapnik::image_rgba8 const& source, mapnik::proj_transform const& prj_trans,
+                         mapnik::box2d<double> const& target_ext, mapnik::box2d<double> const& source_ext,
+                         mapnik::scaling_method_e scaling_method, unsigned threads)
+{
+    mapnik::image_rgba8 target(600, 600, true, true);
+    mapnik::warp_image(target, source, prj_trans, target_ext, source_ext, 0.0, 0.0, 16,
+                       scaling_method, 1.0, boost::optional<double>(), threads);
+    return target;
+}
+
+}
+
+TEST_CASE("warp_image") {
+
+SECTION("split between threads matches a single pass - 4326 to 3857") {
+    mapnik::image_rgba8 source(512, 512);
+    for (unsigned y = 0; y < source.height(); ++y)
+    {
+        for (unsigned x = 0; x < source.width(); ++x)
+        {
+            source(x, y) = 0xff000000 | ((x & 0xff) << 8) | (y & 0xff);
+        }
+    }
+    mapnik::projection proj_3857("+init=epsg:3857");
+    mapnik::projection proj_4326("+init=epsg:4326");
+    // map in mercator, raster in lon/lat
+    mapnik::proj_transform prj_trans(proj_3857, proj_4326);
+    mapnik::box2d<double> source_ext(-20, -60, 20, 60);
+    mapnik::box2d<double> target_ext(source_ext);
+    prj_trans.backward(target_ext);
+
+    for (auto scaling_method : { mapnik::SCALING_NEAR, mapnik::SCALING_BILINEAR })
+    {
+        mapnik::image_rgba8 expected = warp(source, prj_trans, target_ext, source_ext, scaling_method, 1);
+        CHECK(expected(300, 300) != 0);
+        // the second pass reuses the cached mesh
+        mapnik::image_rgba8 again = warp(source, prj_trans, target_ext, source_ext, scaling_method, 1);
+        CHECK(std::equal(expected.begin(), expected.end(), again.begin()));
+        mapnik::image_rgba8 threaded = warp(source, prj_trans, target_ext, source_ext, scaling_method, 4);
+        CHECK(std::equal(expected.begin(), expected.end(), threaded.begin()));
+    }
+}
+
+SECTION("meshes are cached in memory and on disk") {
+    mapnik::projection proj_3857("+init=epsg:3857");
+    mapnik::projection proj_4326("+init=epsg:4326");
+    mapnik::proj_transform prj_trans(proj_3857, proj_4326);
+    mapnik::box2d<double> source_ext(-20, -60, 20, 60);
+    mapnik::warp_mesh_cache & cache = mapnik::warp_mesh_cache::instance();
+    cache.clear();
+    std::size_t capacity = cache.capacity();
+    cache.set_capacity(2);
+
+    mapnik::warp_mesh_ptr mesh = cache.get(100, 200, source_ext, 16, prj_trans);
+    REQUIRE(mesh);
+    CHECK(mesh->xs.width() == 8);
+    CHECK(mesh->xs.height() == 14);
+    CHECK(cache.get(100, 200, source_ext, 16, prj_trans) == mesh);
+    CHECK(cache.get(100, 200, source_ext, 8, prj_trans) != mesh);
+    CHECK(cache.size() == 2);
+    // least recently used goes first
+    cache.get(100, 200, source_ext, 16, prj_trans);
+    cache.get(100, 200, mapnik::box2d<double>(0, 0, 10, 10), 16, prj_trans);
+    CHECK(cache.size() == 2);
+    CHECK(cache.get(100, 200, source_ext, 16, prj_trans) == mesh);
+
+    std::string directory("/tmp/mapnik-tests/warp-mesh");
+    boost::filesystem::create_directories(directory);
+    for (auto const& name : mapnik::util::list_directory(directory))
+    {
+        mapnik::util::remove(name);
+    }
+    cache.set_directory(directory);
+    cache.clear();
+    mapnik::warp_mesh_ptr stored = cache.get(100, 200, source_ext, 16, prj_trans);
+    CHECK(mapnik::util::list_directory(directory).size() == 1);
+    cache.clear();
+    mapnik::warp_mesh_ptr loaded = cache.get(100, 200, source_ext, 16, prj_trans);
+    REQUIRE(loaded);
+    CHECK(loaded != stored);
+    CHECK(std::equal(stored->xs.begin(), stored->xs.end(), loaded->xs.begin()));
+    CHECK(std::equal(stored->ys.begin(), stored->ys.end(), loaded->ys.begin()));
+    CHECK(std::equal(mesh->xs.begin(), mesh->xs.end(), loaded->xs.begin()));
+
+    cache.set_directory("");
+    cache.set_capacity(capacity);
+    cache.clear();
+}
+
+}
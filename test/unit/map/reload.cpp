@@ -0,0 +1,52 @@
+
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/datasource.hpp>
+#include <mapnik/load_map.hpp>
+#include <mapnik/util/fs.hpp>
+
+#include <string>
+
+namespace {
+
+std::string make_map(std::string const& color, std::string const& second_inline)
+{
+    return "<Map>"
+        "<Style name='points'><Rule><DotSymbolizer fill='" + color + "'/></Rule></Style>"
+        "<Layer name='first'><StyleName>points</StyleName>"
+        "<Datasource><Parameter name='type'>csv</Parameter>"
+        "<Parameter name='inline'>x,y\n0,0\n</Parameter></Datasource></Layer>"
+        "<Layer name='second'><StyleName>points</StyleName>"
+        "<Datasource><Parameter name='type'>csv</Parameter>"
+        "<Parameter name='inline'>" + second_inline + "</Parameter></Datasource></Layer>"
+        "</Map>";
+}
+
+}
+
+TEST_CASE("map reload") {
+
+    std::string csv_plugin("./plugins/input/csv.input");
+    if (mapnik::util::exists(csv_plugin))
+    {
+        SECTION("keeps datasources with unchanged parameters")
+        {
+            mapnik::Map running(256, 256);
+            mapnik::load_map_string(running, make_map("red", "x,y\n1,1\n"));
+            REQUIRE(running.layer_count() == 2);
+
+            mapnik::Map reloaded(256, 256);
+            mapnik::reload_map_string(reloaded, running, make_map("blue", "x,y\n2,2\n"));
+            REQUIRE(reloaded.layer_count() == 2);
+            CHECK(reloaded.layers()[0].datasource() == running.layers()[0].datasource());
+            CHECK(reloaded.layers()[1].datasource() != running.layers()[1].datasource());
+            REQUIRE(reloaded.layers()[1].datasource());
+            // the running map is left as it was
+            REQUIRE(running.layers()[1].datasource());
+            CHECK(running.layers()[1].datasource()->envelope().minx() == 1);
+            CHECK(reloaded.layers()[1].datasource()->envelope().minx() == 2);
+        }
+    }
+}
@@ -3,8 +3,18 @@
 #include <mapnik/projection.hpp>
 #include <mapnik/proj_transform.hpp>
 #include <mapnik/geometry/box2d.hpp>
+#include <mapnik/geometry/point.hpp>
+#include <mapnik/view_transform.hpp>
+#include <mapnik/well_known_srs.hpp>
 
-#ifdef MAPNIK_USE_PROJ4
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#ifdef MAPNIK_THREADSAFE
+#include <thread>
+#endif
+
+#if defined(MAPNIK_USE_PROJ4) && !defined(MAPNIK_USE_PROJ6)
 // proj4
 #include <proj_api.h>
 #endif
@@ -13,6 +23,120 @@
 TEST_CASE("projection transform")
 {
 
+SECTION("strided and separate coordinate arrays - 4326 to 3857")
+{
+    mapnik::projection proj_4326("+init=epsg:4326");
+    mapnik::projection proj_3857("+init=epsg:3857");
+    mapnik::proj_transform prj_trans(proj_4326, proj_3857);
+
+    std::vector<mapnik::geometry::point<double>> points;
+    for (int i = 0; i < 37; ++i)
+    {
+        points.emplace_back(-190.0 + i * 10.5, -89.0 + i * 5.0);
+    }
+    std::vector<double> xs, ys;
+    for (auto const& p : points)
+    {
+        xs.push_back(p.x);
+        ys.push_back(p.y);
+    }
+    std::vector<mapnik::geometry::point<double>> expected(points);
+    for (auto & p : expected)
+    {
+        CHECK(prj_trans.forward(p));
+    }
+    std::vector<mapnik::geometry::point<double>> strided(points);
+    CHECK(prj_trans.forward(&strided[0].x, &strided[0].y, nullptr, strided.size(), 2));
+    CHECK(prj_trans.forward(points) == 0);
+    CHECK(prj_trans.forward(xs.data(), ys.data(), nullptr, xs.size(), 1));
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        CHECK(points[i].x == expected[i].x);
+        CHECK(points[i].y == expected[i].y);
+        CHECK(strided[i].x == expected[i].x);
+        CHECK(strided[i].y == expected[i].y);
+        CHECK(xs[i] == expected[i].x);
+        CHECK(ys[i] == expected[i].y);
+    }
+
+    mapnik::view_transform tr(256, 256, mapnik::box2d<double>(-2e7, -2e7, 2e7, 2e7), 3.0, 5.0);
+    tr.set_offset(2);
+    tr.forward(&strided[0].x, &strided[0].y, strided.size(), 2);
+    tr.forward(xs.data(), ys.data(), xs.size());
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        tr.forward(&points[i].x, &points[i].y);
+        CHECK(strided[i].x == points[i].x);
+        CHECK(strided[i].y == points[i].y);
+        CHECK(xs[i] == points[i].x);
+        CHECK(ys[i] == points[i].y);
+    }
+    tr.backward(xs.data(), ys.data(), xs.size());
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        CHECK(xs[i] == Approx(expected[i].x));
+        CHECK(ys[i] == Approx(expected[i].y));
+    }
+}
+
+SECTION("mercator kernels stay within their documented precision")
+{
+    std::vector<double> lon, lat, mx, my;
+    for (int i = 0; i <= 2000; ++i)
+    {
+        lon.push_back(-200.0 + i * 0.2);
+        lat.push_back(-90.0 + i * 0.09);
+        mx.push_back(-2.1e7 + i * 2.1e4);
+        my.push_back(2.1e7 - i * 2.1e4);
+    }
+    auto max_error = [](std::vector<double> const& x, std::vector<double> const& y,
+                        std::vector<double> const& x_exact, std::vector<double> const& y_exact)
+    {
+        double error = 0;
+        for (std::size_t i = 0; i < x.size(); ++i)
+        {
+            error = std::max(error, std::abs(x[i] - x_exact[i]));
+            error = std::max(error, std::abs(y[i] - y_exact[i]));
+        }
+        return error;
+    };
+    std::vector<double> x_exact(lon), y_exact(lat), lon_exact(mx), lat_exact(my);
+    CHECK(mapnik::lonlat2merc_exact(x_exact.data(), y_exact.data(), x_exact.size()));
+    CHECK(mapnik::merc2lonlat_exact(lon_exact.data(), lat_exact.data(), lon_exact.size()));
+
+    // the kernels proj_transform uses
+    std::vector<double> x(lon), y(lat);
+    CHECK(mapnik::lonlat2merc(x.data(), y.data(), x.size()));
+#if defined(SSE_MATH) && defined(SSE_MERCATOR)
+    CHECK(max_error(x, y, x_exact, y_exact) < 5e-8);
+#else
+    // without the opt-in they are the exact ones
+    CHECK(max_error(x, y, x_exact, y_exact) == 0.0);
+#endif
+    // a single point goes through the same kernel as a batch
+    double x0 = lon[1001], y0 = lat[1001];
+    CHECK(mapnik::lonlat2merc(&x0, &y0, 1));
+    CHECK(x0 == x[1001]);
+    CHECK(y0 == y[1001]);
+    x = mx; y = my;
+    CHECK(mapnik::merc2lonlat(x.data(), y.data(), x.size()));
+#if defined(SSE_MATH) && defined(SSE_MERCATOR)
+    CHECK(max_error(x, y, lon_exact, lat_exact) < 1e-13);
+#else
+    CHECK(max_error(x, y, lon_exact, lat_exact) == 0.0);
+#endif
+
+#ifdef SSE_MATH
+    // the SSE2 approximations, built whenever SSE_MATH is
+    x = lon; y = lat;
+    mapnik::detail::merc_batch<mapnik::detail::lonlat2merc>(x.data(), y.data(), x.size(), 1);
+    CHECK(max_error(x, y, x_exact, y_exact) < 5e-8);
+    x = mx; y = my;
+    mapnik::detail::merc_batch<mapnik::detail::merc2lonlat>(x.data(), y.data(), x.size(), 1);
+    CHECK(max_error(x, y, lon_exact, lat_exact) < 1e-13);
+#endif
+}
+
 SECTION("Test bounding box transforms - 4326 to 3857")
 {
     mapnik::projection proj_4326("+init=epsg:4326");
@@ -41,8 +165,52 @@ SECTION("Test bounding box transforms - 4326 to 3857")
 
 }
 
+#if defined(MAPNIK_USE_PROJ4) && defined(MAPNIK_THREADSAFE)
+SECTION("transforms from several threads agree")
+{
+    mapnik::projection proj_4269("+init=epsg:4269");
+    mapnik::projection proj_3857("+init=epsg:3857");
+    mapnik::proj_transform prj_trans(proj_4269, proj_3857);
+    REQUIRE_FALSE(prj_trans.is_known());
+
+    std::vector<mapnik::geometry::point<double>> points;
+    for (int i = 0; i < 100; ++i)
+    {
+        points.emplace_back(-170.0 + 3.4 * i, -80.0 + 1.6 * i);
+    }
+    std::vector<mapnik::geometry::point<double>> expected(points);
+    REQUIRE(prj_trans.forward(expected) == 0);
+
+    std::vector<std::vector<mapnik::geometry::point<double>>> results(4, points);
+    std::vector<unsigned> errors(results.size(), 0);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < results.size(); ++t)
+    {
+        threads.emplace_back([&, t] {
+            for (int round = 0; round < 20; ++round)
+            {
+                std::vector<mapnik::geometry::point<double>> copy(points);
+                errors[t] += prj_trans.forward(copy);
+                errors[t] += prj_trans.backward(copy);
+                errors[t] += prj_trans.forward(copy);
+                results[t] = copy;
+            }
+        });
+    }
+    for (auto & thread : threads) thread.join();
+    for (std::size_t t = 0; t < results.size(); ++t)
+    {
+        CHECK(errors[t] == 0);
+        for (std::size_t i = 0; i < points.size(); ++i)
+        {
+            CHECK(results[t][i].x == Approx(expected[i].x));
+            CHECK(results[t][i].y == Approx(expected[i].y));
+        }
+    }
+}
+#endif
 
-#if defined(MAPNIK_USE_PROJ4) && PJ_VERSION >= 480
+#if defined(MAPNIK_USE_PROJ4) && !defined(MAPNIK_USE_PROJ6) && PJ_VERSION >= 480
 SECTION("test pj_transform failure behavior")
 {
     mapnik::projection proj_4269("+init=epsg:4269");
@@ -0,0 +1,50 @@
+#include "catch.hpp"
+
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/projection_cache.hpp>
+
+#ifdef MAPNIK_THREADSAFE
+#include <thread>
+#endif
+
+TEST_CASE("projection cache") {
+
+SECTION("projections and transforms are reused") {
+    mapnik::projection_cache & cache = mapnik::projection_cache::instance();
+    cache.clear();
+    mapnik::projection const& proj_4326 = cache.get("+init=epsg:4326");
+    mapnik::projection const& proj_3857 = cache.get("+init=epsg:3857");
+    CHECK(&cache.get("+init=epsg:4326") == &proj_4326);
+    CHECK(cache.size() == 2);
+    CHECK(proj_4326.is_geographic());
+    CHECK(!proj_3857.is_geographic());
+
+    mapnik::proj_transform const& trans = cache.get("+init=epsg:4326", "+init=epsg:3857");
+    CHECK(&cache.get("+init=epsg:4326", "+init=epsg:3857") == &trans);
+    CHECK(&trans.source() == &proj_4326);
+    CHECK(&trans.dest() == &proj_3857);
+    CHECK(trans.is_known());
+    CHECK(&cache.get("+init=epsg:3857", "+init=epsg:4326") != &trans);
+    CHECK(cache.size() == 2);
+
+    cache.clear();
+    CHECK(cache.size() == 0);
+}
+
+#ifdef MAPNIK_THREADSAFE
+SECTION("each thread has its own cache") {
+    mapnik::projection_cache & cache = mapnik::projection_cache::instance();
+    mapnik::projection const* proj = &cache.get("+init=epsg:4326");
+    mapnik::projection const* other = nullptr;
+    std::thread t([&other]() {
+        other = &mapnik::projection_cache::instance().get("+init=epsg:4326");
+    });
+    t.join();
+    CHECK(other != nullptr);
+    CHECK(other != proj);
+    cache.clear();
+}
+#endif
+
+}
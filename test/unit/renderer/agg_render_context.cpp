@@ -0,0 +1,141 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/image_filter_types.hpp>
+#include <mapnik/label_collision_detector.hpp>
+
+namespace {
+
+mapnik::Map prepare_map(unsigned width, unsigned height)
+{
+    mapnik::Map map(width, height);
+    map.set_background(mapnik::color(255, 255, 255));
+
+    // a style drawn through a scratch buffer
+    mapnik::feature_type_style buffered;
+    {
+        mapnik::rule rule;
+        mapnik::polygon_symbolizer poly_sym;
+        mapnik::put(poly_sym, mapnik::keys::fill, mapnik::color(255, 0, 0));
+        mapnik::put(poly_sym, mapnik::keys::gamma, 0.5);
+        rule.append(std::move(poly_sym));
+        buffered.add_rule(std::move(rule));
+    }
+    buffered.set_comp_op(mapnik::multiply);
+    buffered.set_opacity(0.7f);
+    map.insert_style("buffered", std::move(buffered));
+
+    // and one through the inflated buffer
+    mapnik::feature_type_style filtered;
+    {
+        mapnik::rule rule;
+        mapnik::line_symbolizer line_sym;
+        mapnik::put(line_sym, mapnik::keys::stroke, mapnik::color(0, 0, 255));
+        mapnik::put(line_sym, mapnik::keys::stroke_width, 3.0);
+        rule.append(std::move(line_sym));
+        filtered.add_rule(std::move(rule));
+    }
+    REQUIRE(mapnik::filter::parse_image_filters("blur", filtered.image_filters()));
+    filtered.set_image_filters_inflate(true);
+    map.insert_style("filtered", std::move(filtered));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(-8, -4);
+    ring.emplace_back(3, -4);
+    ring.emplace_back(5, 4);
+    ring.emplace_back(-8, 2);
+    ring.emplace_back(-8, -4);
+    poly.push_back(std::move(ring));
+    feature->set_geometry(std::move(poly));
+    ds->push(feature);
+
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("buffered");
+    lyr.add_style("filtered");
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-10, -5, 10, 5));
+    return map;
+}
+
+mapnik::image_rgba8 render(mapnik::Map const& map)
+{
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.apply();
+    return im;
+}
+
+mapnik::image_rgba8 render(mapnik::Map const& map, mapnik::agg_render_context<mapnik::image_rgba8> & context)
+{
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im, context);
+    ren.apply();
+    return im;
+}
+
+bool identical(mapnik::image_rgba8 const& im1, mapnik::image_rgba8 const& im2)
+{
+    if (im1.width() != im2.width() || im1.height() != im2.height()) return false;
+    for (std::size_t y = 0; y < im1.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im1.width(); ++x)
+        {
+            if (im1(x, y) != im2(x, y)) return false;
+        }
+    }
+    return true;
+}
+
+}
+
+TEST_CASE("agg_render_context") {
+
+SECTION("renderers sharing a context match fresh renderers") {
+    mapnik::Map map(prepare_map(256, 128));
+    mapnik::Map other(prepare_map(100, 300));
+    mapnik::image_rgba8 expected = render(map);
+    mapnik::image_rgba8 expected_other = render(other);
+
+    mapnik::agg_render_context<mapnik::image_rgba8> context;
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK(identical(render(map, context), expected));
+    }
+    // a different size drops the old buffers
+    CHECK(identical(render(other, context), expected_other));
+    CHECK(identical(render(map, context), expected));
+}
+
+SECTION("placement detector is recycled") {
+    mapnik::agg_render_context<mapnik::image_rgba8> context;
+    mapnik::box2d<double> extent(-10, -10, 266, 266);
+    auto detector = context.detector(extent);
+    detector->insert(mapnik::box2d<double>(0, 0, 10, 10));
+    auto const* ptr = detector.get();
+    // still held, so a new one is made
+    CHECK(context.detector(extent).get() != ptr);
+    detector.reset();
+    auto recycled = context.detector(extent);
+    recycled->insert(mapnik::box2d<double>(0, 0, 10, 10));
+    recycled.reset();
+    recycled = context.detector(extent);
+    CHECK(recycled->has_placement(mapnik::box2d<double>(0, 0, 10, 10)));
+    CHECK(recycled->extent() == extent);
+}
+
+}
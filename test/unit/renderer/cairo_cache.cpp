@@ -0,0 +1,128 @@
+#if defined(HAVE_CAIRO)
+
+#include "catch.hpp"
+
+#include <mapnik/image.hpp>
+#include <mapnik/marker.hpp>
+#include <mapnik/font_engine_freetype.hpp>
+#include <mapnik/text/font_library.hpp>
+#include <mapnik/cairo/cairo_context.hpp>
+
+#include <cstring>
+#include <memory>
+#include <thread>
+
+namespace {
+
+mapnik::image_rgba8 test_image()
+{
+    mapnik::image_rgba8 im(16, 8);
+    for (std::size_t y = 0; y < im.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im.width(); ++x)
+        {
+            im(x, y) = (x * 15) | ((y * 31) << 8) | ((x * y) << 16) | ((255 - x * 8) << 24);
+        }
+    }
+    return im;
+}
+
+// the pixels a pattern's surface holds
+bool same_surface(mapnik::cairo_pattern const& lhs, mapnik::cairo_pattern const& rhs)
+{
+    cairo_surface_t * s1;
+    cairo_surface_t * s2;
+    REQUIRE(cairo_pattern_get_surface(lhs.pattern(), &s1) == CAIRO_STATUS_SUCCESS);
+    REQUIRE(cairo_pattern_get_surface(rhs.pattern(), &s2) == CAIRO_STATUS_SUCCESS);
+    int height = cairo_image_surface_get_height(s1);
+    int stride = cairo_image_surface_get_stride(s1);
+    return cairo_image_surface_get_width(s1) == cairo_image_surface_get_width(s2) &&
+           height == cairo_image_surface_get_height(s2) &&
+           stride == cairo_image_surface_get_stride(s2) &&
+           std::memcmp(cairo_image_surface_get_data(s1), cairo_image_surface_get_data(s2),
+                       static_cast<std::size_t>(height * stride)) == 0;
+}
+
+}
+
+TEST_CASE("cairo caches") {
+
+SECTION("patterns of a marker are made once per thread") {
+    mapnik::cairo_pattern_cache & cache = mapnik::cairo_pattern_cache::instance();
+    cache.clear();
+    mapnik::image_rgba8 im = test_image();
+    auto owner = std::make_shared<mapnik::marker const>(mapnik::marker_rgba8(im));
+
+    auto pattern = cache.get(owner, im, 0.5);
+    REQUIRE(pattern);
+    CHECK(same_surface(*pattern, mapnik::cairo_pattern(im, 0.5)));
+    CHECK(cache.get(owner, im, 0.5) == pattern);
+    CHECK(cache.get(owner, im, 1.0) != pattern);
+
+    // a cached pattern is handed out as a new one would be
+    cairo_matrix_t matrix;
+    cairo_matrix_init_translate(&matrix, 3, 4);
+    pattern->set_matrix(matrix);
+    pattern->set_extend(CAIRO_EXTEND_REPEAT);
+    pattern->set_filter(CAIRO_FILTER_NEAREST);
+    REQUIRE(cache.get(owner, im, 0.5) == pattern);
+    mapnik::cairo_pattern fresh(im, 0.5);
+    cairo_matrix_t fresh_matrix;
+    cairo_pattern_get_matrix(fresh.pattern(), &fresh_matrix);
+    cairo_pattern_get_matrix(pattern->pattern(), &matrix);
+    CHECK(std::memcmp(&matrix, &fresh_matrix, sizeof(matrix)) == 0);
+    CHECK(cairo_pattern_get_extend(pattern->pattern()) == cairo_pattern_get_extend(fresh.pattern()));
+    CHECK(cairo_pattern_get_filter(pattern->pattern()) == cairo_pattern_get_filter(fresh.pattern()));
+
+    // drawn patterns are keyed by their transform and rendered once
+    unsigned renders = 0;
+    auto render = [&]() { ++renders; return im; };
+    agg::trans_affine tr = agg::trans_affine_scaling(2.0);
+    auto drawn = cache.get(owner, tr, 1.0, render);
+    CHECK(cache.get(owner, tr, 1.0, render) == drawn);
+    CHECK(renders == 1);
+    CHECK(cache.get(owner, agg::trans_affine_scaling(3.0), 1.0, render) != drawn);
+    CHECK(renders == 2);
+
+#ifdef MAPNIK_THREADSAFE
+    // patterns are per thread
+    mapnik::cairo_pattern_cache::pattern_ptr other;
+    std::thread([&]() { other = mapnik::cairo_pattern_cache::instance().get(owner, im, 0.5); }).join();
+    REQUIRE(other);
+    CHECK(other != pattern);
+    CHECK(same_surface(*other, *pattern));
+#endif
+
+    cache.clear();
+    CHECK(cache.get(owner, im, 0.5) != pattern);
+    cache.clear();
+}
+
+SECTION("cairo faces are shared by the managers of a thread") {
+    REQUIRE(mapnik::freetype_engine::register_font("fonts/dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf"));
+    mapnik::font_library library;
+    mapnik::face_manager faces(library, mapnik::freetype_engine::get_mapping(), mapnik::freetype_engine::get_cache());
+    mapnik::face_ptr face = faces.get_face("DejaVu Sans Book");
+    REQUIRE(face);
+
+    mapnik::cairo_face_manager first(std::make_shared<mapnik::font_library>());
+    mapnik::cairo_face_manager second(std::make_shared<mapnik::font_library>());
+    mapnik::cairo_face_ptr cairo_face = first.get_face(face);
+    REQUIRE(cairo_face);
+    CHECK(cairo_face->face() != nullptr);
+    CHECK(second.get_face(face) == cairo_face);
+
+#ifdef MAPNIK_THREADSAFE
+    mapnik::cairo_face_ptr other;
+    std::thread([&]() {
+        mapnik::cairo_face_manager manager(std::make_shared<mapnik::font_library>());
+        other = manager.get_face(face);
+    }).join();
+    REQUIRE(other);
+    CHECK(other != cairo_face);
+#endif
+}
+
+}
+
+#endif
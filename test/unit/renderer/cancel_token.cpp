@@ -0,0 +1,101 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/cancel_token.hpp>
+
+TEST_CASE("cancel token") {
+
+SECTION("trips on cancel or deadline") {
+    mapnik::cancel_token token;
+    CHECK_FALSE(token.cancelled());
+    token.cancel();
+    CHECK(token.cancelled());
+
+    mapnik::cancel_token expired(std::chrono::milliseconds(0));
+    CHECK(expired.cancelled());
+
+    mapnik::cancel_token later(std::chrono::hours(1));
+    CHECK_FALSE(later.cancelled());
+    later.set_timeout(std::chrono::milliseconds(-1));
+    CHECK(later.cancelled());
+
+    CHECK_FALSE(mapnik::cancelled(mapnik::cancel_token_ptr()));
+}
+
+mapnik::Map map(256, 256);
+mapnik::feature_type_style style;
+{
+    mapnik::rule rule;
+    mapnik::polygon_symbolizer poly_sym;
+    mapnik::put(poly_sym, mapnik::keys::fill, mapnik::color(255, 0, 0));
+    rule.append(std::move(poly_sym));
+    style.add_rule(std::move(rule));
+}
+map.insert_style("style", std::move(style));
+
+mapnik::parameters params;
+params["type"] = "memory";
+auto ds = std::make_shared<mapnik::memory_datasource>(params);
+mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+mapnik::geometry::polygon<double> poly;
+mapnik::geometry::linear_ring<double> ring;
+ring.emplace_back(-10, -10);
+ring.emplace_back(10, -10);
+ring.emplace_back(10, 10);
+ring.emplace_back(-10, 10);
+ring.emplace_back(-10, -10);
+poly.push_back(std::move(ring));
+feature->set_geometry(std::move(poly));
+ds->push(feature);
+mapnik::layer lyr("layer");
+lyr.set_datasource(ds);
+lyr.add_style("style");
+map.add_layer(lyr);
+map.zoom_to_box(mapnik::box2d<double>(-5, -5, 5, 5));
+
+SECTION("renders everything without a tripped token") {
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.set_cancel_token(std::make_shared<mapnik::cancel_token>());
+    ren.apply();
+    CHECK_FALSE(ren.interrupted());
+    CHECK(ren.painted());
+    CHECK(im(128, 128) != 0);
+}
+
+SECTION("stops a cancelled render") {
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    auto token = std::make_shared<mapnik::cancel_token>();
+    token->cancel();
+    ren.set_cancel_token(token);
+    ren.apply();
+    CHECK(ren.interrupted());
+    CHECK(im(128, 128) == 0);
+
+    // the status is that of the last render
+    ren.set_cancel_token(mapnik::cancel_token_ptr());
+    ren.apply();
+    CHECK_FALSE(ren.interrupted());
+    CHECK(im(128, 128) != 0);
+}
+
+SECTION("stops a render past its deadline") {
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.set_cancel_token(std::make_shared<mapnik::cancel_token>(std::chrono::milliseconds(0)));
+    ren.apply();
+    CHECK(ren.interrupted());
+    CHECK(im(128, 128) == 0);
+}
+
+}
@@ -0,0 +1,87 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/renderer_common/dash_pattern.hpp>
+
+namespace {
+
+mapnik::image_rgba8 render_line(mapnik::line_symbolizer sym, double threshold)
+{
+    mapnik::Map map(64, 64);
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    rule.append(std::move(sym));
+    style.add_rule(std::move(rule));
+    map.insert_style("style", std::move(style));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::line_string<double> line;
+    line.emplace_back(-30.5, 0.5);
+    line.emplace_back(30.5, 0.5);
+    feature->set_geometry(std::move(line));
+    ds->push(feature);
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("style");
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-32, -32, 32, 32));
+
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.set_dash_collapse_threshold(threshold);
+    ren.apply();
+    return im;
+}
+
+}
+
+TEST_CASE("dash pattern") {
+
+SECTION("period and coverage") {
+    mapnik::dash_array dash{{1.0, 3.0}, {2.0, 2.0}};
+    mapnik::dash_pattern pattern(dash);
+    CHECK(pattern.period == Approx(8.0));
+    CHECK(pattern.coverage == Approx(3.0));
+    CHECK(pattern.opacity() == Approx(3.0 / 8.0));
+    CHECK(pattern.collapses(0.1, 1.0));
+    CHECK_FALSE(pattern.collapses(1.0, 1.0));
+    CHECK_FALSE(pattern.collapses(0.1, 0.0));
+}
+
+SECTION("empty pattern never collapses") {
+    mapnik::dash_pattern pattern{mapnik::dash_array()};
+    CHECK_FALSE(pattern.collapses(1.0, 10.0));
+    CHECK(pattern.opacity() == Approx(1.0));
+}
+
+SECTION("sub pixel dashes are drawn as a fainter solid line") {
+    mapnik::line_symbolizer dashed;
+    mapnik::put(dashed, mapnik::keys::stroke_width, 2.0);
+    mapnik::put(dashed, mapnik::keys::stroke_dasharray, mapnik::dash_array{{0.25, 0.25}});
+    mapnik::line_symbolizer solid;
+    mapnik::put(solid, mapnik::keys::stroke_width, 2.0);
+    mapnik::put(solid, mapnik::keys::stroke_opacity, 0.5);
+
+    mapnik::image_rgba8 collapsed = render_line(dashed, 1.0);
+    mapnik::image_rgba8 expected = render_line(solid, 0.0);
+    CHECK(collapsed.get_row(31)[10] != 0);
+    CHECK(std::equal(collapsed.begin(), collapsed.end(), expected.begin()));
+
+    // without a threshold the dashes are still stroked
+    mapnik::image_rgba8 stroked = render_line(dashed, 0.0);
+    CHECK(stroked.get_row(31)[10] != 0);
+}
+
+}
@@ -0,0 +1,143 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/agg_pixfmt_rgba.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_ellipse.h"
+#include "agg_rendering_buffer.h"
+#include "agg_rasterizer_scanline_aa.h"
+#include "agg_scanline_u.h"
+#include "agg_renderer_base.h"
+#include "agg_renderer_scanline.h"
+#pragma GCC diagnostic pop
+
+#include <vector>
+
+namespace {
+
+// a 64x64 map of one unit per pixel, drawing the points as dots
+mapnik::Map prepare_dot_map(std::vector<mapnik::geometry::point<double>> const& points, double width, double height)
+{
+    mapnik::Map map(64, 64);
+    map.set_background(mapnik::color(255, 255, 255));
+
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    mapnik::dot_symbolizer sym;
+    mapnik::put(sym, mapnik::keys::fill, mapnik::color(0, 96, 192));
+    mapnik::put(sym, mapnik::keys::width, width);
+    mapnik::put(sym, mapnik::keys::height, height);
+    rule.append(std::move(sym));
+    style.add_rule(std::move(rule));
+    map.insert_style("dots", std::move(style));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::multi_point<double> multi;
+    for (auto const& pt : points) multi.push_back(pt);
+    feature->set_geometry(std::move(multi));
+    ds->push(feature);
+
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("dots");
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(0, 0, 64, 64));
+    return map;
+}
+
+mapnik::image_rgba8 render(mapnik::Map const& map)
+{
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.apply();
+    return im;
+}
+
+// the dots drawn through the rasterizer one at a time, as before stamps,
+// clipped to the image as the renderer's rasterizer is
+mapnik::image_rgba8 reference(std::vector<mapnik::geometry::point<double>> const& points,
+                              double rx, double ry, bool clip = false)
+{
+    mapnik::image_rgba8 im(64, 64);
+    mapnik::fill(im, mapnik::color(255, 255, 255));
+    agg::rendering_buffer buf(im.bytes(), im.width(), im.height(), im.row_size());
+    using blender_type = agg::comp_op_adaptor_rgba_pre<agg::rgba8, agg::order_rgba>;
+    using pixfmt_comp_type = mapnik::pixfmt_comp_rgba_pre<blender_type, agg::rendering_buffer>;
+    using renderer_base = agg::renderer_base<pixfmt_comp_type>;
+    pixfmt_comp_type pixf(buf);
+    pixf.comp_op(agg::comp_op_src_over);
+    renderer_base renb(pixf);
+    agg::renderer_scanline_aa_solid<renderer_base> ren(renb);
+    ren.color(agg::rgba8_pre(0, 96, 192, 255));
+    agg::rasterizer_scanline_aa<> ras;
+    agg::scanline_u8 sl;
+    if (clip) ras.clip_box(0, 0, 64, 64);
+    for (auto const& pt : points)
+    {
+        agg::ellipse el(pt.x, 64 - pt.y, rx, ry);
+        ras.reset();
+        ras.add_path(el);
+        agg::render_scanlines(ras, sl, ren);
+    }
+    return im;
+}
+
+unsigned count_differences(mapnik::image_rgba8 const& im1, mapnik::image_rgba8 const& im2)
+{
+    unsigned differ = 0;
+    for (std::size_t y = 0; y < im1.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im1.width(); ++x)
+        {
+            if (im1(x, y) != im2(x, y)) ++differ;
+        }
+    }
+    return differ;
+}
+
+}
+
+TEST_CASE("dot_symbolizer") {
+
+// on eighths of a pixel stamps are the dots the rasterizer draws there,
+// including those overlapping each other and the image edges
+std::vector<mapnik::geometry::point<double>> points = {
+    { 10.125, 20.5 }, { 30.875, 40.25 }, { 31.5, 41.0 }, { 50.5, 5.375 }, { 0.25, 63.75 }, { 63.625, 0.0 }
+};
+
+SECTION("stamped dots match rasterized ones") {
+    mapnik::image_rgba8 im = render(prepare_dot_map(points, 5, 3));
+    mapnik::image_rgba8 expected = reference(points, 2.5, 1.5);
+    CHECK(count_differences(im, expected) == 0);
+    // something was drawn
+    CHECK(count_differences(im, reference({}, 2.5, 1.5)) > 0);
+}
+
+SECTION("large dots are still rasterized") {
+    mapnik::image_rgba8 im = render(prepare_dot_map(points, 70, 66));
+    CHECK(count_differences(im, reference(points, 35, 33, true)) == 0);
+}
+
+SECTION("points far off the image are skipped") {
+    std::vector<mapnik::geometry::point<double>> far = points;
+    far.emplace_back(1e12, 1e12);
+    far.emplace_back(-1e12, 32);
+    mapnik::image_rgba8 im = render(prepare_dot_map(far, 5, 3));
+    CHECK(count_differences(im, reference(points, 2.5, 1.5)) == 0);
+}
+
+}
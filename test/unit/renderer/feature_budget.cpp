@@ -0,0 +1,119 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/render_stats.hpp>
+
+namespace {
+
+std::size_t drawn(mapnik::render_stats const& stats)
+{
+    REQUIRE(stats.layers.size() == 1);
+    REQUIRE(stats.layers.front().styles.size() == 1);
+    auto const& symbolizers = stats.layers.front().styles.front().symbolizers;
+    auto itr = symbolizers.find("PolygonSymbolizer");
+    return itr == symbolizers.end() ? 0 : itr->second.count;
+}
+
+}
+
+TEST_CASE("feature budget") {
+
+mapnik::Map map(256, 256);
+mapnik::feature_type_style style;
+{
+    mapnik::rule rule;
+    mapnik::polygon_symbolizer poly_sym;
+    rule.append(std::move(poly_sym));
+    style.add_rule(std::move(rule));
+}
+map.insert_style("style", std::move(style));
+
+mapnik::parameters params;
+params["type"] = "memory";
+params["spatial_index"] = true;
+auto ds = std::make_shared<mapnik::memory_datasource>(params);
+mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+for (int i = 0; i < 10; ++i)
+{
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i));
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(-10 + 2 * i, -1);
+    ring.emplace_back(-9 + 2 * i, -1);
+    ring.emplace_back(-9 + 2 * i, 1);
+    ring.emplace_back(-10 + 2 * i, -1);
+    poly.push_back(std::move(ring));
+    feature->set_geometry(std::move(poly));
+    ds->push(feature);
+}
+mapnik::layer lyr("layer");
+lyr.set_datasource(ds);
+lyr.add_style("style");
+map.zoom_to_box(mapnik::box2d<double>(-10, -5, 10, 5));
+
+SECTION("memory datasource estimates") {
+    CHECK(*ds->estimate_features(mapnik::query(mapnik::box2d<double>(-20, -5, 20, 5))) == 10);
+    CHECK(*ds->estimate_features(mapnik::query(mapnik::box2d<double>(-10, -5, -7.5, 5))) == 2);
+    CHECK(*ds->estimate_features(mapnik::query(mapnik::box2d<double>(50, 50, 60, 60))) == 0);
+}
+
+SECTION("no budget draws everything") {
+    CHECK_FALSE(lyr.has_budget());
+    map.add_layer(lyr);
+    mapnik::render_stats stats;
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.set_stats(&stats);
+    ren.apply();
+    CHECK(drawn(stats) == 10);
+    CHECK_FALSE(stats.layers.front().styles.front().over_budget);
+}
+
+SECTION("stop policy draws up to the limit") {
+    lyr.set_maximum_features(3);
+    CHECK(lyr.has_budget());
+    map.add_layer(lyr);
+    mapnik::render_stats stats;
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.set_stats(&stats);
+    ren.apply();
+    CHECK(drawn(stats) == 3);
+    CHECK(stats.layers.front().styles.front().over_budget);
+}
+
+SECTION("vertex limit") {
+    lyr.set_maximum_vertices(8);
+    map.add_layer(lyr);
+    mapnik::render_stats stats;
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.set_stats(&stats);
+    ren.apply();
+    CHECK(drawn(stats) == 2);
+    CHECK(stats.layers.front().styles.front().over_budget);
+}
+
+SECTION("sample policy spreads the budget over the layer") {
+    lyr.set_maximum_features(3);
+    lyr.set_budget_policy(mapnik::BUDGET_SAMPLE);
+    map.add_layer(lyr);
+    mapnik::render_stats stats;
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.set_stats(&stats);
+    ren.apply();
+    // every 4th of the 10 estimated features
+    CHECK(drawn(stats) == 3);
+    CHECK_FALSE(stats.layers.front().styles.front().over_budget);
+}
+
+}
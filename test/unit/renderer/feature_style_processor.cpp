@@ -13,6 +13,11 @@
 #include <mapnik/value/types.hpp>
 #include <mapnik/symbolizer.hpp>
 #include <mapnik/geometry/geometry_type.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/load_map.hpp>
+
+#include <limits>
+#include <thread>
 
 struct rendering_result
 {
@@ -26,6 +31,7 @@ struct rendering_result
 
     std::vector<mapnik::box2d<double>> layer_query_extents;
     std::vector<mapnik::geometry::geometry<double>> geometries;
+    std::vector<mapnik::value_integer> labels;
 };
 
 class test_renderer : public mapnik::feature_style_processor<test_renderer>
@@ -77,11 +83,22 @@ public:
         result_.geometries.push_back(feature.get_geometry());
     }
 
+    void process(mapnik::text_symbolizer const& sym, mapnik::feature_impl & feature, mapnik::proj_transform const& prj_trans)
+    {
+        result_.labels.push_back(feature.id());
+    }
+
     bool process(mapnik::rule::symbolizers const&, mapnik::feature_impl&, mapnik::proj_transform const& )
     {
         return false;
     }
 
+    // every label covers 30% of the map
+    double label_coverage() const
+    {
+        return 0.3 * result_.labels.size();
+    }
+
     double scale_factor() const
     {
         return 1;
@@ -251,4 +268,318 @@ SECTION("test_renderer - apply_to_layer") {
     REQUIRE(mapnik::geometry::geometry_type(result.geometries[1]) == mapnik::geometry::geometry_types::LineString);
 }
 
+SECTION("test_renderer - parallel layer queries") {
+
+    mapnik::Map map(prepare_map());
+    mapnik::layer lyr2("layer2");
+    lyr2.set_datasource(prepare_datasource());
+    lyr2.add_style("lines");
+    map.add_layer(lyr2);
+
+    rendering_result result;
+    test_renderer renderer(map, result);
+    renderer.set_query_threads(4);
+    REQUIRE(renderer.query_threads() == 4);
+    renderer.apply();
+
+    REQUIRE(renderer.painted());
+
+    REQUIRE(result.start_map_processing == 1);
+    REQUIRE(result.end_map_processing == 1);
+    REQUIRE(result.end_layer_processing == 2);
+    REQUIRE(result.start_style_processing == 2);
+    REQUIRE(result.end_style_processing == 2);
+
+    REQUIRE(result.geometries.size() == 4);
+    for (std::size_t i = 0; i < result.geometries.size(); i += 2)
+    {
+        REQUIRE(mapnik::geometry::geometry_type(result.geometries[i]) == mapnik::geometry::geometry_types::Point);
+        REQUIRE(mapnik::geometry::geometry_type(result.geometries[i + 1]) == mapnik::geometry::geometry_types::LineString);
+    }
+}
+
+SECTION("test_renderer - empty layers are skipped") {
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto datasource = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    for (mapnik::value_integer id : { 1, 2 })
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, id));
+        feature->set_geometry(mapnik::geometry::point<double>(id * 10.0, id * 10.0));
+        datasource->push(feature);
+    }
+
+    mapnik::Map map(prepare_map());
+    mapnik::layer lyr("sparse");
+    lyr.set_datasource(datasource);
+    lyr.add_style("lines");
+    map.add_layer(lyr);
+    // between the points: the layer's envelope overlaps, its query is empty
+    map.zoom_to_box(mapnik::box2d<double>(13, 13, 17, 17));
+
+    {
+        rendering_result result;
+        test_renderer renderer(map, result);
+        renderer.apply();
+        // the line of the first layer crosses the extent
+        REQUIRE(result.end_layer_processing == 1);
+        REQUIRE(result.start_style_processing == 1);
+        REQUIRE(result.geometries.size() == 1);
+    }
+
+    // a style clearing what's below is rendered even without features
+    mapnik::feature_type_style clear_style;
+    mapnik::rule clear_rule;
+    clear_rule.append(mapnik::line_symbolizer());
+    clear_style.add_rule(std::move(clear_rule));
+    clear_style.set_comp_op(mapnik::dst_in);
+    map.insert_style("clear", std::move(clear_style));
+    map.get_layer(1).add_style("clear");
+    {
+        rendering_result result;
+        test_renderer renderer(map, result);
+        renderer.apply();
+        REQUIRE(result.end_layer_processing == 2);
+        REQUIRE(result.start_style_processing == 3);
+        REQUIRE(result.end_style_processing == 3);
+        REQUIRE(result.geometries.size() == 1);
+    }
+}
+
+SECTION("test_renderer - scheduled labels") {
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto datasource = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("rank");
+    for (mapnik::value_integer id : { 1, 2, 3, 4 })
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, id));
+        feature->put("rank", id == 3 ? 10 : id);
+        feature->set_geometry(mapnik::geometry::point<double>(id, id));
+        datasource->push(feature);
+    }
+
+    mapnik::Map map(256, 256);
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    rule.append(mapnik::text_symbolizer());
+    rule.append(mapnik::line_symbolizer());
+    style.add_rule(std::move(rule));
+    style.set_label_priority(mapnik::parse_expression("[rank]"));
+    map.insert_style("labels", std::move(style));
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(datasource);
+    lyr.add_style("labels");
+    map.add_layer(lyr);
+    map.zoom_all();
+
+    {
+        rendering_result result;
+        test_renderer renderer(map, result);
+        renderer.apply();
+        // other symbolizers keep the feature order
+        REQUIRE(result.geometries.size() == 4);
+        REQUIRE(result.labels == std::vector<mapnik::value_integer>({ 3, 4, 2, 1 }));
+    }
+
+    // stop once half of the map is covered
+    map.styles()["labels"].set_label_coverage(0.5);
+    {
+        rendering_result result;
+        test_renderer renderer(map, result);
+        renderer.apply();
+        REQUIRE(result.geometries.size() == 4);
+        REQUIRE(result.labels == std::vector<mapnik::value_integer>({ 3, 4 }));
+    }
+}
+
+SECTION("label coverage is a fraction") {
+
+    mapnik::feature_type_style style;
+    style.set_label_coverage(1.5);
+    CHECK(style.label_coverage() == 1.0);
+    style.set_label_coverage(-0.5);
+    CHECK(style.label_coverage() == 0.0);
+    style.set_label_coverage(std::numeric_limits<double>::quiet_NaN());
+    CHECK(style.label_coverage() == 1.0);
+
+    mapnik::Map map(256, 256);
+    CHECK_THROWS(mapnik::load_map_string(map, "<Map><Style name=\"labels\" label-coverage=\"2\"/></Map>"));
+    CHECK_THROWS(mapnik::load_map_string(map, "<Map><Style name=\"labels\" label-coverage=\"-1\"/></Map>"));
+    mapnik::load_map_string(map, "<Map><Style name=\"labels\" label-coverage=\"0.25\"/></Map>");
+    CHECK(map.styles()["labels"].label_coverage() == 0.25);
+}
+
+SECTION("test_renderer - batched rule evaluation") {
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto datasource = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("n");
+    // spans several batches
+    const mapnik::value_integer num_features = 1000;
+    for (mapnik::value_integer id = 1; id <= num_features; ++id)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, id));
+        feature->put("n", id);
+        feature->set_geometry(mapnik::geometry::point<double>(id, id));
+        datasource->push(feature);
+    }
+
+    mapnik::Map map(256, 256);
+    mapnik::feature_type_style style;
+    for (std::string filter : { "[n] % 3 = 0", "[n] % 2 = 0" })
+    {
+        mapnik::rule rule;
+        rule.set_filter(mapnik::parse_expression(filter));
+        rule.append(mapnik::text_symbolizer());
+        style.add_rule(std::move(rule));
+    }
+    mapnik::rule else_rule;
+    else_rule.set_else(true);
+    else_rule.append(mapnik::line_symbolizer());
+    style.add_rule(std::move(else_rule));
+    map.insert_style("style", std::move(style));
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(datasource);
+    lyr.add_style("style");
+    map.add_layer(lyr);
+    map.zoom_all();
+
+    std::vector<mapnik::value_integer> expected_all;
+    std::vector<mapnik::value_integer> expected_first;
+    std::size_t expected_else = 0;
+    for (mapnik::value_integer id = 1; id <= num_features; ++id)
+    {
+        if (id % 3 == 0) expected_all.push_back(id);
+        if (id % 2 == 0) expected_all.push_back(id);
+        if (id % 3 == 0 || id % 2 == 0) expected_first.push_back(id);
+        else ++expected_else;
+    }
+
+    {
+        rendering_result result;
+        test_renderer renderer(map, result);
+        renderer.apply();
+        CHECK(result.labels == expected_all);
+        CHECK(result.geometries.size() == expected_else);
+    }
+
+    map.styles()["style"].set_filter_mode(mapnik::FILTER_FIRST);
+    {
+        rendering_result result;
+        test_renderer renderer(map, result);
+        renderer.apply();
+        CHECK(result.labels == expected_first);
+        CHECK(result.geometries.size() == expected_else);
+    }
+}
+
+SECTION("test_renderer - one map rendered from several threads at once") {
+
+    mapnik::Map map(256, 256);
+    mapnik::feature_type_style style;
+    for (std::string filter : { "[n] % 5 = 0", "[n] % 3 = 0 and [name] != 'skip'", "[n] > 900" })
+    {
+        mapnik::rule rule;
+        rule.set_filter(mapnik::parse_expression(filter));
+        rule.append(mapnik::text_symbolizer());
+        style.add_rule(std::move(rule));
+    }
+    map.insert_style("style", std::move(style));
+
+    // the attributes lie in other slots of each context, so the filters
+    // bind differently for each layer
+    const mapnik::value_integer num_features = 1000;
+    for (std::string layer_name : { "first", "second" })
+    {
+        mapnik::parameters params;
+        params["type"] = "memory";
+        auto datasource = std::make_shared<mapnik::memory_datasource>(params);
+        mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+        if (layer_name == "first")
+        {
+            ctx->push("n");
+            ctx->push("name");
+        }
+        else
+        {
+            ctx->push("name");
+            ctx->push("other");
+            ctx->push("n");
+        }
+        for (mapnik::value_integer id = 1; id <= num_features; ++id)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, id));
+            feature->put("n", layer_name == "first" ? id : num_features - id);
+            feature->put("name", mapnik::value_unicode_string(id % 7 == 0 ? "skip" : "keep"));
+            feature->set_geometry(mapnik::geometry::point<double>(id, id));
+            datasource->push(feature);
+        }
+        mapnik::layer lyr(layer_name);
+        lyr.set_datasource(datasource);
+        lyr.add_style("style");
+        map.add_layer(lyr);
+    }
+    map.zoom_all();
+
+    rendering_result expected;
+    {
+        test_renderer renderer(map, expected);
+        renderer.apply();
+    }
+    REQUIRE(!expected.labels.empty());
+
+    const std::size_t num_threads = 4;
+    std::vector<std::vector<rendering_result>> results(num_threads, std::vector<rendering_result>(8));
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&map, &results, t]() {
+            for (rendering_result & result : results[t])
+            {
+                test_renderer renderer(map, result);
+                renderer.apply();
+            }
+        });
+    }
+    for (std::thread & thread : threads) thread.join();
+    for (auto const& thread_results : results)
+    {
+        for (rendering_result const& result : thread_results)
+        {
+            CHECK(result.labels == expected.labels);
+        }
+    }
+}
+
+SECTION("test_renderer - rules appended through a kept reference are rendered") {
+
+    mapnik::Map map(prepare_map());
+    mapnik::rules & rules = map.styles()["lines"].get_rules_nonconst();
+    {
+        rendering_result result;
+        test_renderer renderer(map, result);
+        renderer.apply();
+        CHECK(result.geometries.size() == 2);
+    }
+    for (int i = 0; i < 16; ++i)
+    {
+        mapnik::rule rule;
+        rule.append(mapnik::line_symbolizer());
+        rules.push_back(std::move(rule));
+    }
+    {
+        rendering_result result;
+        test_renderer renderer(map, result);
+        renderer.apply();
+        CHECK(result.geometries.size() == 2 * 17);
+    }
+}
+
 }
@@ -0,0 +1,141 @@
+#if defined(GRID_RENDERER)
+
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/grid/grid.hpp>
+#include <mapnik/grid/grid_renderer.hpp>
+
+#include <string>
+
+namespace {
+
+mapnik::geometry::polygon<double> triangle(double x0, double y0, double x1, double y1, double x2, double y2)
+{
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(x0, y0);
+    ring.emplace_back(x1, y1);
+    ring.emplace_back(x2, y2);
+    ring.emplace_back(x0, y0);
+    poly.push_back(std::move(ring));
+    return poly;
+}
+
+// overlapping triangles and a thin line, so spans start and end off the
+// sampled pixels
+mapnik::Map prepare_grid_map()
+{
+    mapnik::Map map(101, 77);
+
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    rule.append(mapnik::polygon_symbolizer());
+    mapnik::line_symbolizer line_sym;
+    mapnik::put(line_sym, mapnik::keys::stroke_width, 1.5);
+    rule.append(std::move(line_sym));
+    style.add_rule(std::move(rule));
+    map.insert_style("style", std::move(style));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("name");
+    ctx->push("kind");
+    mapnik::transcoder tr("utf-8");
+    mapnik::geometry::line_string<double> line;
+    line.emplace_back(-9.7, 8.3);
+    line.emplace_back(9.1, -7.9);
+    mapnik::geometry::geometry<double> geoms[] = {
+        triangle(-9.3, -8.1, 6.7, -4.3, -2.9, 8.7),
+        triangle(-1.1, -9.6, 9.4, 9.2, -7.7, 3.3),
+        line
+    };
+    mapnik::value_integer id = 1;
+    for (auto & geom : geoms)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, id));
+        feature->put("name", tr.transcode(("feature " + std::to_string(id)).c_str()));
+        feature->put("kind", id * 10);
+        feature->set_geometry(std::move(geom));
+        ds->push(feature);
+        ++id;
+    }
+
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("style");
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-10, -10, 10, 10));
+    return map;
+}
+
+}
+
+TEST_CASE("grid_renderer") {
+
+SECTION("reduced grids hold the sampled pixels of the full grid") {
+    mapnik::Map map(prepare_grid_map());
+    mapnik::grid full(map.width(), map.height(), "__id__");
+    mapnik::grid_renderer<mapnik::grid> full_ren(map, full);
+    full_ren.apply();
+    CHECK(full.resolution() == 1);
+    CHECK(full.width() == map.width());
+    CHECK(full.height() == map.height());
+    CHECK(full.painted());
+
+    for (unsigned resolution : { 2, 4, 7 })
+    {
+        INFO("resolution " << resolution);
+        mapnik::grid reduced(map.width(), map.height(), "__id__", resolution);
+        mapnik::grid_renderer<mapnik::grid> ren(map, reduced);
+        ren.apply();
+        REQUIRE(reduced.width() == (map.width() + resolution - 1) / resolution);
+        REQUIRE(reduced.height() == (map.height() + resolution - 1) / resolution);
+        CHECK(reduced.get_feature_keys() == full.get_feature_keys());
+        unsigned differ = 0;
+        unsigned painted = 0;
+        for (std::size_t y = 0; y < reduced.height(); ++y)
+        {
+            for (std::size_t x = 0; x < reduced.width(); ++x)
+            {
+                mapnik::grid::value_type expected = full.data()(x * resolution, y * resolution);
+                if (reduced.data()(x, y) != expected) ++differ;
+                if (expected != mapnik::grid::base_mask) ++painted;
+            }
+        }
+        CHECK(differ == 0);
+        CHECK(painted > 0);
+    }
+}
+
+SECTION("only the requested fields are copied") {
+    mapnik::Map map(prepare_grid_map());
+    mapnik::grid grid(map.width(), map.height(), "__id__");
+    grid.add_field("name");
+    grid.add_field("missing");
+    mapnik::grid_renderer<mapnik::grid> ren(map, grid);
+    ren.apply();
+    REQUIRE(grid.get_grid_features().size() == 3);
+    for (auto const& kv : grid.get_grid_features())
+    {
+        mapnik::feature_ptr const& feature = kv.second;
+        CHECK(feature->has_key("name"));
+        CHECK_FALSE(feature->has_key("kind"));
+        CHECK_FALSE(feature->has_key("missing"));
+        CHECK(feature->get("name").to_string() == "feature " + kv.first);
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,71 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/load_map.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/agg_renderer.hpp>
+
+#include <string>
+
+namespace {
+
+// markers sized by the column index of the group member they draw
+std::size_t painted_pixels(int start_column, int num_columns)
+{
+    mapnik::Map map(256, 256);
+    mapnik::load_map_string(map,
+        "<Map background-color='white'>"
+        "<Style name='group'><Rule>"
+        "<GroupSymbolizer start-column='" + std::to_string(start_column) + "'"
+        " num-columns='" + std::to_string(num_columns) + "' allow-overlap='true'>"
+        "<PairLayout item-margin='40'/>"
+        "<GroupRule><MarkersSymbolizer width='[mapnik::feature_id] * 8'"
+        " height='[mapnik::feature_id] * 8' fill='black' stroke-width='0'"
+        " allow-overlap='true'/></GroupRule>"
+        "</GroupSymbolizer>"
+        "</Rule></Style></Map>");
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    feature->set_geometry(mapnik::geometry::point<double>(0, 0));
+    ds->push(feature);
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("group");
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-10, -10, 10, 10));
+
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.apply();
+    std::size_t count = 0;
+    for (std::size_t y = 0; y < im.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im.width(); ++x)
+        {
+            if (im(x, y) != mapnik::color(255, 255, 255).rgba()) ++count;
+        }
+    }
+    return count;
+}
+
+}
+
+TEST_CASE("group symbolizer") {
+
+SECTION("members reading the feature id are not laid out alike") {
+    std::size_t first = painted_pixels(1, 1);
+    std::size_t second = painted_pixels(2, 1);
+    REQUIRE(first > 0);
+    CHECK(second > first);
+    // with the layout of the first member reused, this would be 2 * first
+    CHECK(painted_pixels(1, 2) == first + second);
+}
+
+}
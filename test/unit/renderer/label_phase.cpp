@@ -0,0 +1,130 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/font_engine_freetype.hpp>
+#include <mapnik/expression.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/text/placements/dummy.hpp>
+#include <mapnik/text/formatting/text.hpp>
+
+namespace {
+
+mapnik::Map prepare_labelled_map()
+{
+    mapnik::Map map(256, 256);
+    map.set_background(mapnik::color(255, 255, 255));
+
+    mapnik::feature_type_style poly_style;
+    mapnik::rule poly_rule;
+    mapnik::polygon_symbolizer poly_sym;
+    mapnik::put(poly_sym, mapnik::keys::fill, mapnik::color(200, 220, 240));
+    poly_rule.append(std::move(poly_sym));
+    poly_style.add_rule(std::move(poly_rule));
+    map.insert_style("polygons", std::move(poly_style));
+
+    mapnik::feature_type_style text_style;
+    mapnik::rule text_rule;
+    mapnik::text_symbolizer text_sym;
+    mapnik::text_placements_ptr placements = std::make_shared<mapnik::text_placements_dummy>();
+    placements->defaults.format_defaults.face_name = "DejaVu Sans Book";
+    placements->defaults.format_defaults.text_size = 12.0;
+    placements->defaults.format_defaults.fill = mapnik::color(0, 0, 0);
+    placements->defaults.format_defaults.halo_radius = 1.0;
+    placements->defaults.set_format_tree(
+        std::make_shared<mapnik::formatting::text_node>(mapnik::parse_expression("[name]")));
+    mapnik::put<mapnik::text_placements_ptr>(text_sym, mapnik::keys::text_placements_, placements);
+    text_rule.append(std::move(text_sym));
+    text_style.add_rule(std::move(text_rule));
+    map.insert_style("labels", std::move(text_style));
+
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("name");
+    mapnik::transcoder tr("utf-8");
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto polys = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::feature_ptr area(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(-8, -8);
+    ring.emplace_back(8, -8);
+    ring.emplace_back(8, 8);
+    ring.emplace_back(-8, 8);
+    ring.emplace_back(-8, -8);
+    poly.push_back(std::move(ring));
+    area->set_geometry(std::move(poly));
+    polys->push(area);
+
+    // enough overlapping points that placement order decides the outcome
+    auto points = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::value_integer id = 1;
+    for (double y = -9; y <= 9; y += 1.5)
+    {
+        for (double x = -9; x <= 9; x += 3)
+        {
+            mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, id));
+            feature->put("name", tr.transcode(("label " + std::to_string(id)).c_str()));
+            feature->set_geometry(mapnik::geometry::point<double>(x, y));
+            points->push(feature);
+            ++id;
+        }
+    }
+
+    mapnik::layer poly_lyr("polygons");
+    poly_lyr.set_datasource(polys);
+    poly_lyr.add_style("polygons");
+    map.add_layer(poly_lyr);
+    mapnik::layer point_lyr("points");
+    point_lyr.set_datasource(points);
+    point_lyr.add_style("labels");
+    map.add_layer(point_lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-10, -10, 10, 10));
+    return map;
+}
+
+}
+
+TEST_CASE("label_phase") {
+
+SECTION("labels placed on their own thread match inline placement") {
+    REQUIRE(mapnik::freetype_engine::register_font("fonts/dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf"));
+    mapnik::Map map(prepare_labelled_map());
+
+    mapnik::image_rgba8 inline_image(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> inline_ren(map, inline_image);
+    CHECK_FALSE(inline_ren.label_phase());
+    inline_ren.apply();
+
+    mapnik::image_rgba8 phased_image(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> phased_ren(map, phased_image);
+    phased_ren.set_label_phase(true);
+    CHECK(phased_ren.label_phase());
+    phased_ren.apply();
+
+    REQUIRE(phased_image.width() == inline_image.width());
+    REQUIRE(phased_image.height() == inline_image.height());
+    unsigned differ = 0;
+    unsigned labelled = 0;
+    for (unsigned y = 0; y < inline_image.height(); ++y)
+    {
+        for (unsigned x = 0; x < inline_image.width(); ++x)
+        {
+            if (phased_image(x, y) != inline_image(x, y)) ++differ;
+            if (inline_image(x, y) == mapnik::color(0, 0, 0).rgba()) ++labelled;
+        }
+    }
+    CHECK(differ == 0);
+    // the comparison is only meaningful if text was drawn
+    CHECK(labelled > 0);
+}
+
+}
@@ -0,0 +1,158 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/layer_image_cache.hpp>
+#include <mapnik/image_filter_types.hpp>
+
+namespace {
+
+mapnik::Map prepare_cached_map()
+{
+    mapnik::Map map(256, 256);
+    map.set_background(mapnik::color(255, 255, 255));
+
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    mapnik::polygon_symbolizer poly_sym;
+    mapnik::put(poly_sym, mapnik::keys::fill, mapnik::color(255, 0, 0));
+    rule.append(std::move(poly_sym));
+    style.add_rule(std::move(rule));
+    map.insert_style("polygons", std::move(style));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(-10, -10);
+    ring.emplace_back(0, -10);
+    ring.emplace_back(0, 10);
+    ring.emplace_back(-10, 10);
+    ring.emplace_back(-10, -10);
+    poly.push_back(std::move(ring));
+    feature->set_geometry(std::move(poly));
+    ds->push(feature);
+
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("polygons");
+    lyr.set_cache_image(true);
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-10, -10, 10, 10));
+    return map;
+}
+
+}
+
+TEST_CASE("layer_image_cache") {
+
+mapnik::layer_image_cache & cache = mapnik::layer_image_cache::instance();
+
+SECTION("disabled without a budget") {
+    mapnik::Map map(prepare_cached_map());
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.apply();
+    CHECK(cache.size() == 0);
+    CHECK(im(64, 128) == mapnik::color(255, 0, 0).rgba());
+}
+
+SECTION("cached images match rendered ones") {
+    cache.set_max_bytes(16 * 1024 * 1024);
+    mapnik::Map map(prepare_cached_map());
+    mapnik::image_rgba8 first(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, first);
+    ren.apply();
+    REQUIRE(cache.size() == 1);
+
+    mapnik::image_rgba8 second(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren2(map, second);
+    ren2.apply();
+    CHECK(cache.size() == 1);
+    CHECK(second(64, 128) == first(64, 128));
+    CHECK(second(192, 128) == first(192, 128));
+    CHECK(second(64, 128) == mapnik::color(255, 0, 0).rgba());
+
+    // a style change yields a new fingerprint
+    mapnik::feature_type_style & style = map.styles().find("polygons")->second;
+    mapnik::symbolizer & sym = *style.get_rules_nonconst()[0].begin();
+    mapnik::put(mapnik::util::get<mapnik::polygon_symbolizer>(sym), mapnik::keys::fill, mapnik::color(0, 0, 255));
+    mapnik::image_rgba8 third(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren3(map, third);
+    ren3.apply();
+    CHECK(cache.size() == 2);
+    CHECK(third(64, 128) == mapnik::color(0, 0, 255).rgba());
+
+    cache.clear();
+    cache.set_max_bytes(0);
+}
+
+SECTION("fingerprints see filter arguments and datasource instances") {
+    mapnik::Map map(prepare_cached_map());
+    mapnik::layer const& lyr = map.layers()[0];
+    mapnik::attributes vars;
+    mapnik::feature_type_style & style = map.styles().find("polygons")->second;
+    REQUIRE(mapnik::filter::parse_image_filters("agg-stack-blur(2,2)", style.image_filters()));
+    std::size_t blur2 = mapnik::layer_image_cache::fingerprint(map, lyr, vars);
+    style.image_filters().clear();
+    REQUIRE(mapnik::filter::parse_image_filters("agg-stack-blur(5,5)", style.image_filters()));
+    std::size_t blur5 = mapnik::layer_image_cache::fingerprint(map, lyr, vars);
+    CHECK(blur2 != blur5);
+    REQUIRE(mapnik::filter::parse_image_filters("agg-stack-blur(2,2)", style.direct_image_filters()));
+    CHECK(mapnik::layer_image_cache::fingerprint(map, lyr, vars) != blur5);
+    style.direct_image_filters().clear();
+    CHECK(mapnik::layer_image_cache::fingerprint(map, lyr, vars) == blur5);
+
+    // a replaced datasource with the same parameters is another one
+    map.layers()[0].set_datasource(std::make_shared<mapnik::memory_datasource>(lyr.datasource()->params()));
+    std::size_t replaced = mapnik::layer_image_cache::fingerprint(map, lyr, vars);
+    CHECK(replaced != blur5);
+
+    // the same layer drawn in another map srs
+    map.set_srs("epsg:3857");
+    CHECK(mapnik::layer_image_cache::fingerprint(map, lyr, vars) != replaced);
+}
+
+SECTION("invalidating a layer drops the images its labels interact with") {
+    cache.set_max_bytes(16 * 1024 * 1024);
+    auto image = std::make_shared<mapnik::image_rgba8 const>(256, 256);
+    auto key = [](std::string const& name, double minx) {
+        return mapnik::layer_image_cache::key_type(name, 1, minx, 0, 10, 10, 256, 256, 1.0, 0, 0);
+    };
+    cache.insert(key("overlay", 0), image, {mapnik::box2d<double>(10, 10, 50, 20)});
+    cache.insert(key("roads", 0), image, {mapnik::box2d<double>(40, 15, 80, 25)});
+    cache.insert(key("places", 0), image, {mapnik::box2d<double>(70, 20, 90, 30)});
+    cache.insert(key("water", 0), image, {mapnik::box2d<double>(200, 200, 220, 210)});
+    // same labels, but another view
+    cache.insert(key("roads", -5), image, {mapnik::box2d<double>(40, 15, 80, 25)});
+    REQUIRE(cache.size() == 5);
+
+    mapnik::layer_image_cache::label_boxes labels;
+    REQUIRE(cache.find(key("roads", 0), &labels));
+    REQUIRE(labels.size() == 1);
+    CHECK(labels[0] == mapnik::box2d<double>(40, 15, 80, 25));
+
+    // roads overlap the overlay, and places overlap roads in turn
+    CHECK(cache.invalidate("overlay") == 3);
+    CHECK(!cache.find(key("overlay", 0)));
+    CHECK(!cache.find(key("roads", 0)));
+    CHECK(!cache.find(key("places", 0)));
+    CHECK(cache.find(key("water", 0)));
+    CHECK(cache.find(key("roads", -5)));
+    CHECK(cache.invalidate("overlay") == 0);
+
+    cache.clear();
+    cache.set_max_bytes(0);
+}
+
+}
@@ -0,0 +1,92 @@
+#include "catch.hpp"
+
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/renderer_common/line_path_cache.hpp>
+
+namespace {
+
+mapnik::line_path_key make_key(double offset)
+{
+    return mapnik::line_path_key{{{1.0, 0.0, 0.0, 1.0, 0.0, 0.0}},
+                                 offset, 0.0, 0.0, mapnik::radial_distance, true, true};
+}
+
+struct square
+{
+    square() : index(0) {}
+    void rewind(unsigned) { index = 0; }
+    unsigned vertex(double * x, double * y)
+    {
+        static double const coords[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+        if (index == 4) return agg::path_cmd_stop;
+        *x = coords[index][0];
+        *y = coords[index][1];
+        return index++ == 0 ? agg::path_cmd_move_to : agg::path_cmd_line_to;
+    }
+    unsigned index;
+};
+
+}
+
+TEST_CASE("line path cache") {
+
+mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+mapnik::feature_ptr feature1(mapnik::feature_factory::create(ctx, 1));
+mapnik::feature_ptr feature2(mapnik::feature_factory::create(ctx, 2));
+mapnik::box2d<double> wide(-10, -10, 10, 10);
+mapnik::box2d<double> narrow(-5, -5, 5, 5);
+
+SECTION("paths replay what was recorded, part by part") {
+    mapnik::line_path path;
+    square s;
+    path.add_path(s);
+    path.add_path(s);
+    std::size_t parts = 0;
+    std::size_t vertices = 0;
+    path.for_each_part([&](mapnik::line_path::part & part) {
+        ++parts;
+        double x, y;
+        part.rewind(0);
+        while (part.vertex(&x, &y) != agg::path_cmd_stop) ++vertices;
+    });
+    CHECK(parts == 2);
+    CHECK(vertices == 8);
+}
+
+SECTION("only the started feature is cached") {
+    mapnik::line_path_cache cache;
+    CHECK(cache.insert(*feature1, make_key(0), wide) == nullptr);
+    cache.start_feature(feature1);
+    CHECK(cache.insert(*feature2, make_key(0), wide) == nullptr);
+    mapnik::line_path * path = cache.insert(*feature1, make_key(0), wide);
+    REQUIRE(path != nullptr);
+    CHECK(cache.find(*feature1, make_key(0), narrow, false) == path);
+    CHECK(cache.find(*feature1, make_key(0), narrow, true) == nullptr);
+    CHECK(cache.find(*feature1, make_key(0), wide, true) == path);
+    CHECK(cache.find(*feature1, make_key(2), narrow, false) == nullptr);
+    cache.start_feature(feature2);
+    CHECK(cache.find(*feature2, make_key(0), narrow, false) == nullptr);
+    cache.start_feature(feature1);
+    CHECK(cache.find(*feature1, make_key(0), narrow, false) == nullptr);
+}
+
+SECTION("retained paths outlive the next feature") {
+    mapnik::line_path_cache cache;
+    cache.retain(true);
+    cache.start_feature(feature1);
+    mapnik::line_path * path = cache.insert(*feature1, make_key(0), narrow);
+    REQUIRE(path != nullptr);
+    cache.start_feature(feature2);
+    CHECK(cache.find(*feature1, make_key(0), narrow, false) == nullptr);
+    cache.start_feature(feature1);
+    CHECK(cache.find(*feature1, make_key(0), narrow, false) == path);
+    // a wider box replaces the narrower one
+    CHECK(cache.find(*feature1, make_key(0), wide, false) == nullptr);
+    CHECK(cache.insert(*feature1, make_key(0), wide) == path);
+    CHECK(cache.find(*feature1, make_key(0), narrow, false) == path);
+    cache.clear();
+    CHECK(cache.find(*feature1, make_key(0), narrow, false) == nullptr);
+}
+
+}
@@ -0,0 +1,193 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/marker_sprite_cache.hpp>
+#include <mapnik/transform/parse_transform.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+mapnik::Map prepare_map(double angle)
+{
+    mapnik::Map map(256, 256);
+    mapnik::feature_type_style style;
+    {
+        mapnik::rule rule;
+        mapnik::markers_symbolizer sym;
+        mapnik::put(sym, mapnik::keys::fill, mapnik::color(200, 40, 40));
+        mapnik::put(sym, mapnik::keys::stroke, mapnik::color(20, 20, 120));
+        mapnik::put(sym, mapnik::keys::width, mapnik::value_double(12.0));
+        mapnik::put(sym, mapnik::keys::height, mapnik::value_double(8.0));
+        mapnik::put(sym, mapnik::keys::allow_overlap, true);
+        if (angle != 0.0)
+        {
+            mapnik::put(sym, mapnik::keys::image_transform,
+                        mapnik::parse_transform("rotate(" + std::to_string(angle) + ")"));
+        }
+        rule.append(std::move(sym));
+        style.add_rule(std::move(rule));
+    }
+    map.insert_style("markers", std::move(style));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    for (int i = 0; i < 64; ++i)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i + 1));
+        feature->set_geometry(mapnik::geometry::point<double>(-9.3 + (i % 8) * 2.37, -9.1 + (i / 8) * 2.41));
+        ds->push(feature);
+    }
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("markers");
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-10, -10, 10, 10));
+    return map;
+}
+
+mapnik::image_rgba8 render(mapnik::Map const& map, double tolerance)
+{
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.set_marker_sprite_tolerance(tolerance);
+    ren.apply();
+    return im;
+}
+
+int max_difference(mapnik::image_rgba8 const& im1, mapnik::image_rgba8 const& im2)
+{
+    int diff = 0;
+    for (std::size_t y = 0; y < im1.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im1.width(); ++x)
+        {
+            std::uint32_t a = im1(x, y);
+            std::uint32_t b = im2(x, y);
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                diff = std::max(diff, std::abs(static_cast<int>((a >> shift) & 0xff) -
+                                               static_cast<int>((b >> shift) & 0xff)));
+            }
+        }
+    }
+    return diff;
+}
+
+}
+
+TEST_CASE("marker_sprite_cache") {
+
+SECTION("quantize") {
+    mapnik::box2d<double> bbox(-6, -4, 6, 4);
+    mapnik::marker_sprite_cache::key_type key;
+    mapnik::marker_sprite_cache::placement place;
+
+    agg::trans_affine tr = agg::trans_affine_rotation(0.3) * agg::trans_affine_translation(10.3, 20.6);
+    REQUIRE(mapnik::marker_sprite_cache::quantize(tr, bbox, 0.25, key, place));
+    CHECK(place.x == 10);
+    CHECK(place.y == 20);
+    CHECK(key.phase_x == 1);
+    CHECK(key.phase_y == 2);
+    CHECK(key.scale == 0);
+
+    // the same rotation and phase elsewhere shares the key
+    mapnik::marker_sprite_cache::key_type other;
+    tr = agg::trans_affine_rotation(0.3) * agg::trans_affine_translation(-40.7, 3.5);
+    REQUIRE(mapnik::marker_sprite_cache::quantize(tr, bbox, 0.25, other, place));
+    CHECK(other == key);
+    CHECK(place.x == -41);
+
+    // offsets snap to the next pixel
+    tr = agg::trans_affine_translation(4.9, 0.0);
+    REQUIRE(mapnik::marker_sprite_cache::quantize(tr, bbox, 0.25, key, place));
+    CHECK(place.x == 5);
+    CHECK(key.phase_x == 0);
+
+    // nor shear nor uneven scale can be drawn from a sprite
+    CHECK(!mapnik::marker_sprite_cache::quantize(agg::trans_affine_skewing(0.3, 0.0), bbox, 0.25, key, place));
+    CHECK(!mapnik::marker_sprite_cache::quantize(agg::trans_affine_scaling(1.0, 1.5), bbox, 0.25, key, place));
+    // a tolerance below the phase error falls back
+    tr = agg::trans_affine_translation(0.125, 0.125);
+    CHECK(!mapnik::marker_sprite_cache::quantize(tr, bbox, 0.1, key, place));
+}
+
+SECTION("budget") {
+    mapnik::marker_sprite_cache cache(1000);
+    mapnik::marker_sprite_cache::key_type key;
+    key.angle = 1;
+    mapnik::marker_sprite_cache::sprite s;
+    s.image = mapnik::image_rgba8(10, 10);
+    cache.insert(key, mapnik::svg_path_ptr(), std::move(s));
+    CHECK(cache.size() == 1);
+    CHECK(cache.bytes() == 400);
+    CHECK(cache.find(key) != nullptr);
+    key.angle = 2;
+    CHECK(cache.find(key) == nullptr);
+
+    s.image = mapnik::image_rgba8(10, 10);
+    cache.insert(key, mapnik::svg_path_ptr(), std::move(s));
+    CHECK(cache.size() == 2);
+    // over budget the sprites are dropped
+    key.angle = 3;
+    s.image = mapnik::image_rgba8(10, 10);
+    cache.insert(key, mapnik::svg_path_ptr(), std::move(s));
+    CHECK(cache.size() == 1);
+    CHECK(cache.bytes() == 400);
+    cache.clear();
+    CHECK(cache.size() == 0);
+}
+
+SECTION("keys compare the whole style") {
+    mapnik::marker_sprite_cache cache;
+    mapnik::marker_sprite_cache::path_style red{agg::rgba8(255, 0, 0, 255), 1.0,
+                                                agg::rgba8(0, 0, 0, 255), 1.0, 1.0, 3u};
+    mapnik::marker_sprite_cache::key_type key;
+    key.style.push_back(red);
+    mapnik::marker_sprite_cache::sprite s;
+    s.image = mapnik::image_rgba8(4, 4);
+    cache.insert(key, mapnik::svg_path_ptr(), std::move(s));
+
+    mapnik::marker_sprite_cache::key_type same;
+    same.style.push_back(red);
+    CHECK(same == key);
+    CHECK(cache.find(same) != nullptr);
+    for (auto change : { +[](mapnik::marker_sprite_cache::path_style & p) { p.fill_color.g = 1; },
+                         +[](mapnik::marker_sprite_cache::path_style & p) { p.stroke_width = 1.5; },
+                         +[](mapnik::marker_sprite_cache::path_style & p) { p.flags = 1u; } })
+    {
+        mapnik::marker_sprite_cache::key_type other(key);
+        change(other.style.front());
+        CHECK_FALSE(other == key);
+        CHECK(cache.find(other) == nullptr);
+    }
+    // the shape's own attributes differ from any override
+    CHECK(cache.find(mapnik::marker_sprite_cache::key_type()) == nullptr);
+}
+
+SECTION("sprites look like vectors") {
+    for (double angle : {0.0, 30.0})
+    {
+        mapnik::Map map(prepare_map(angle));
+        mapnik::image_rgba8 vectors = render(map, 0.0);
+        mapnik::image_rgba8 sprites = render(map, 0.25);
+        CHECK(max_difference(vectors, sprites) <= 64);
+        // no tolerance draws the same image as before
+        CHECK(max_difference(render(map, 0.0), vectors) == 0);
+    }
+}
+
+}
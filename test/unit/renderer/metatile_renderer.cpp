@@ -0,0 +1,91 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/image_view.hpp>
+#include <mapnik/metatile_renderer.hpp>
+
+namespace {
+
+mapnik::Map prepare_metatile_map()
+{
+    mapnik::Map map(512, 256);
+    map.set_background(mapnik::color(255, 255, 255));
+
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    mapnik::polygon_symbolizer poly_sym;
+    mapnik::put(poly_sym, mapnik::keys::fill, mapnik::color(255, 0, 0));
+    rule.append(std::move(poly_sym));
+    style.add_rule(std::move(rule));
+    map.insert_style("polygons", std::move(style));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    // polygon covering the left half of the metatile only
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(-10, -10);
+    ring.emplace_back(-1, -10);
+    ring.emplace_back(-1, 10);
+    ring.emplace_back(-10, 10);
+    ring.emplace_back(-10, -10);
+    poly.push_back(std::move(ring));
+    feature->set_geometry(std::move(poly));
+    ds->push(feature);
+
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("polygons");
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-10, -5, 10, 5));
+    return map;
+}
+
+}
+
+TEST_CASE("metatile_renderer") {
+
+SECTION("invalid grid") {
+    mapnik::Map map(prepare_metatile_map());
+    REQUIRE_THROWS(mapnik::metatile_renderer(map, 3, 1));
+    REQUIRE_THROWS(mapnik::metatile_renderer(map, 0, 1));
+}
+
+SECTION("tiles match metatile slices") {
+    mapnik::Map map(prepare_metatile_map());
+    mapnik::metatile_renderer ren(map, 2, 1);
+    REQUIRE(ren.tile_width() == 256);
+    REQUIRE(ren.tile_height() == 256);
+    REQUIRE(ren.tile_extent(1, 0) == mapnik::box2d<double>(0, -5, 10, 5));
+
+    std::vector<mapnik::image_rgba8> tiles;
+    ren.apply(tiles);
+    REQUIRE(tiles.size() == 2);
+
+    mapnik::image_rgba8 full(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> full_ren(map, full);
+    full_ren.apply();
+
+    for (unsigned col = 0; col < 2; ++col)
+    {
+        mapnik::image_view_rgba8 view(col * 256, 0, 256, 256, full);
+        mapnik::image_rgba8 const& tile = tiles[col];
+        CHECK(tile(128, 128) == view(128, 128));
+        CHECK(tile(10, 10) == view(10, 10));
+    }
+    CHECK(tiles[0](128, 128) == mapnik::color(255, 0, 0).rgba());
+    CHECK(tiles[1](128, 128) == mapnik::color(255, 255, 255).rgba());
+}
+
+}
@@ -0,0 +1,88 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/multiscale_renderer.hpp>
+
+namespace {
+
+mapnik::Map prepare_multiscale_map()
+{
+    mapnik::Map map(256, 256);
+    map.set_background(mapnik::color(255, 255, 255));
+
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    mapnik::line_symbolizer line_sym;
+    mapnik::put(line_sym, mapnik::keys::stroke, mapnik::color(0, 0, 255));
+    mapnik::put(line_sym, mapnik::keys::stroke_width, 4.0);
+    rule.append(std::move(line_sym));
+    style.add_rule(std::move(rule));
+    map.insert_style("lines", std::move(style));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::line_string<double> line;
+    line.emplace_back(-20, 0);
+    line.emplace_back(20, 0);
+    feature->set_geometry(std::move(line));
+    ds->push(feature);
+
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("lines");
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-10, -10, 10, 10));
+    return map;
+}
+
+}
+
+TEST_CASE("multiscale_renderer") {
+
+SECTION("invalid scale factors") {
+    mapnik::Map map(prepare_multiscale_map());
+    REQUIRE_THROWS(mapnik::multiscale_renderer(map, {}));
+    REQUIRE_THROWS(mapnik::multiscale_renderer(map, {1.0, 0.0}));
+}
+
+SECTION("images match maps rendered at each scale factor") {
+    mapnik::Map map(prepare_multiscale_map());
+    mapnik::multiscale_renderer ren(map, {1.0, 2.0});
+    REQUIRE(ren.width(2.0) == 512);
+    REQUIRE(ren.height(2.0) == 512);
+
+    std::vector<mapnik::image_rgba8> images;
+    ren.apply(images);
+    REQUIRE(images.size() == 2);
+    REQUIRE(images[0].width() == 256);
+    REQUIRE(images[1].width() == 512);
+
+    mapnik::Map map2(map);
+    map2.resize(512, 512);
+    map2.zoom_to_box(map.get_current_extent());
+    mapnik::image_rgba8 expected(512, 512);
+    mapnik::agg_renderer<mapnik::image_rgba8> ren2(map2, expected, 2.0);
+    ren2.apply();
+
+    // the line is 4 pixels wide at 1x and 8 at 2x
+    CHECK(images[0](128, 128) == mapnik::color(0, 0, 255).rgba());
+    CHECK(images[0](128, 124) == mapnik::color(255, 255, 255).rgba());
+    CHECK(images[1](256, 253) == mapnik::color(0, 0, 255).rgba());
+    for (unsigned y : {240u, 250u, 253u, 256u, 259u, 270u})
+    {
+        CHECK(images[1](256, y) == expected(256, y));
+    }
+}
+
+}
@@ -0,0 +1,157 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/image_util.hpp>
+#include <mapnik/image_compositing.hpp>
+#include <mapnik/image_reader.hpp>
+
+namespace {
+
+mapnik::feature_type_style polygon_style(mapnik::color const& fill)
+{
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    mapnik::polygon_symbolizer poly_sym;
+    mapnik::put(poly_sym, mapnik::keys::fill, fill);
+    rule.append(std::move(poly_sym));
+    style.add_rule(std::move(rule));
+    return style;
+}
+
+mapnik::Map prepare_map(mapnik::color const& background)
+{
+    mapnik::Map map(256, 256);
+    map.set_background(background);
+
+    map.insert_style("plain", polygon_style(mapnik::color(0, 128, 0, 128)));
+    mapnik::feature_type_style multiplied = polygon_style(mapnik::color(255, 0, 0, 200));
+    multiplied.set_comp_op(mapnik::multiply);
+    map.insert_style("multiplied", std::move(multiplied));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    for (int i = 0; i < 3; ++i)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i + 1));
+        mapnik::geometry::polygon<double> poly;
+        mapnik::geometry::linear_ring<double> ring;
+        double x = -9.0 + i * 5.0;
+        ring.emplace_back(x, -8);
+        ring.emplace_back(x + 7, -8);
+        ring.emplace_back(x + 7, 8 - i * 3);
+        ring.emplace_back(x, 8 - i * 3);
+        ring.emplace_back(x, -8);
+        poly.push_back(std::move(ring));
+        feature->set_geometry(std::move(poly));
+        ds->push(feature);
+    }
+
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("plain");
+    lyr.add_style("multiplied");
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-10, -10, 10, 10));
+    return map;
+}
+
+mapnik::image_rgba8 decode(std::string const& str)
+{
+    std::unique_ptr<mapnik::image_reader> reader(mapnik::get_image_reader(str.data(), str.size()));
+    REQUIRE(reader);
+    mapnik::image_rgba8 im(reader->width(), reader->height());
+    reader->read(0, 0, im);
+    return im;
+}
+
+}
+
+TEST_CASE("opaque renderer") {
+
+SECTION("maps over an opaque background render opaque images") {
+    mapnik::Map map(prepare_map(mapnik::color(242, 239, 233)));
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    CHECK(ren.opaque());
+    ren.apply();
+    CHECK(im.opaque());
+    CHECK(!im.get_premultiplied());
+
+    // an unused style with a comp-op clearing alpha takes the usual path,
+    // drawing the same pixels
+    mapnik::feature_type_style cutout = polygon_style(mapnik::color(0, 0, 0));
+    cutout.set_comp_op(mapnik::dst_out);
+    map.insert_style("cutout", std::move(cutout));
+    mapnik::image_rgba8 expected(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> usual(map, expected);
+    CHECK(!usual.opaque());
+    usual.apply();
+    CHECK(!expected.opaque());
+    CHECK(im == expected);
+    CHECK(im(128, 128) != mapnik::color(242, 239, 233).rgba());
+
+    for (std::string const& format : { "png32", "png8", "webp:lossless=1" })
+    {
+#if !defined(HAVE_WEBP)
+        if (format.find("webp") == 0) continue;
+#endif
+        INFO(format);
+        CHECK(decode(mapnik::save_to_string(im, format)) == decode(mapnik::save_to_string(expected, format)));
+    }
+    // alpha asked for is still written
+    CHECK(decode(mapnik::save_to_string(im, "png32:t=2")) == expected);
+}
+
+SECTION("translucent backgrounds and alpha clearing comp-ops are not opaque") {
+    {
+        mapnik::Map map(prepare_map(mapnik::color(242, 239, 233, 200)));
+        mapnik::image_rgba8 im(map.width(), map.height());
+        mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+        CHECK(!ren.opaque());
+        ren.apply();
+        CHECK(!im.opaque());
+    }
+    {
+        mapnik::Map map(prepare_map(mapnik::color(242, 239, 233)));
+        map.layers()[0].set_comp_op(mapnik::src_in);
+        mapnik::image_rgba8 im(map.width(), map.height());
+        mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+        CHECK(!ren.opaque());
+    }
+    {
+        mapnik::Map map(prepare_map(mapnik::color(242, 239, 233)));
+        mapnik::feature_type_style halo = polygon_style(mapnik::color(0, 0, 0));
+        mapnik::text_symbolizer text_sym;
+        mapnik::put(text_sym, mapnik::keys::halo_comp_op, mapnik::_xor);
+        halo.get_rules_nonconst()[0].append(std::move(text_sym));
+        map.insert_style("halo", std::move(halo));
+        mapnik::image_rgba8 im(map.width(), map.height());
+        mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+        CHECK(!ren.opaque());
+    }
+}
+
+SECTION("changing alpha clears the opaque flag") {
+    mapnik::image_rgba8 im(4, 4);
+    im.set_opaque(true);
+    mapnik::apply_opacity(im, 0.5f);
+    CHECK(!im.opaque());
+    im.set_opaque(true);
+    mapnik::image_rgba8 src(4, 4);
+    mapnik::composite(im, src, mapnik::src_over);
+    CHECK(im.opaque());
+    mapnik::composite(im, src, mapnik::dst_in);
+    CHECK(!im.opaque());
+}
+
+}
@@ -0,0 +1,54 @@
+#include "catch.hpp"
+
+#include <mapnik/marker.hpp>
+#include <mapnik/renderer_common/render_pattern.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_trans_affine.h"
+#pragma GCC diagnostic pop
+
+#include <memory>
+
+TEST_CASE("pattern image cache") {
+
+mapnik::pattern_image_cache & cache = mapnik::pattern_image_cache::instance();
+cache.clear();
+auto owner = std::make_shared<mapnik::marker const>(mapnik::marker_null());
+int renders = 0;
+auto render = [&] {
+    ++renders;
+    mapnik::image_rgba8 image(8, 8);
+    image.set(0xff0000ff);
+    return image;
+};
+
+SECTION("patterns are rasterized once per transform and opacity") {
+    agg::trans_affine tr = agg::trans_affine_scaling(2.0);
+    auto first = cache.get(owner, tr, 1.0, render);
+    REQUIRE(first);
+    CHECK((*first)(7, 7) == 0xff0000ff);
+    auto second = cache.get(owner, tr, 1.0, render);
+    CHECK(first == second);
+    CHECK(renders == 1);
+    cache.get(owner, agg::trans_affine_scaling(1.0), 1.0, render);
+    cache.get(owner, tr, 0.5, render);
+    CHECK(renders == 3);
+    CHECK(cache.size() == 3);
+    // another marker at the same address can't match while entries hold theirs
+    auto other = std::make_shared<mapnik::marker const>(mapnik::marker_null());
+    cache.get(other, tr, 1.0, render);
+    CHECK(renders == 4);
+}
+
+SECTION("images over the budget are not kept") {
+    auto large = cache.get(owner, agg::trans_affine(), 1.0, [] {
+        return mapnik::image_rgba8(4097, 4096);
+    });
+    REQUIRE(large);
+    CHECK(large->width() == 4097);
+    CHECK(cache.size() == 0);
+}
+
+cache.clear();
+}
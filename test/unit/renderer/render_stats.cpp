@@ -0,0 +1,124 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/render_stats.hpp>
+
+TEST_CASE("render stats") {
+
+mapnik::Map map(256, 256);
+mapnik::feature_type_style style;
+{
+    mapnik::rule rule;
+    mapnik::polygon_symbolizer poly_sym;
+    mapnik::put(poly_sym, mapnik::keys::fill, mapnik::color(255, 0, 0));
+    rule.append(std::move(poly_sym));
+    mapnik::line_symbolizer line_sym;
+    rule.append(std::move(line_sym));
+    style.add_rule(std::move(rule));
+}
+map.insert_style("style", std::move(style));
+
+mapnik::parameters params;
+params["type"] = "memory";
+auto ds = std::make_shared<mapnik::memory_datasource>(params);
+mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+for (int i = 0; i < 3; ++i)
+{
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i));
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(-8 + i, -4);
+    ring.emplace_back(3 + i, -4);
+    ring.emplace_back(5 + i, 4);
+    ring.emplace_back(-8 + i, -4);
+    poly.push_back(std::move(ring));
+    feature->set_geometry(std::move(poly));
+    ds->push(feature);
+}
+mapnik::layer lyr("layer");
+lyr.set_datasource(ds);
+lyr.add_style("style");
+lyr.add_style("missing");
+map.add_layer(lyr);
+map.zoom_to_box(mapnik::box2d<double>(-10, -5, 10, 5));
+
+SECTION("layers, styles and symbolizers are accounted for") {
+    mapnik::render_stats stats;
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.set_stats(&stats);
+    ren.apply();
+
+    REQUIRE(stats.layers.size() == 1);
+    mapnik::render_stats::layer_stats const& lstats = stats.layers.front();
+    CHECK(lstats.name == "layer");
+    CHECK_FALSE(lstats.cached);
+    REQUIRE(lstats.styles.size() == 1);
+    mapnik::render_stats::style_stats const& sstats = lstats.styles.front();
+    CHECK(sstats.name == "style");
+    CHECK(sstats.features == 3);
+    CHECK(sstats.vertices == 12);
+    REQUIRE(sstats.symbolizers.count("PolygonSymbolizer") == 1);
+    CHECK(sstats.symbolizers.at("PolygonSymbolizer").count == 3);
+    REQUIRE(sstats.symbolizers.count("LineSymbolizer") == 1);
+    CHECK(sstats.symbolizers.at("LineSymbolizer").count == 3);
+    REQUIRE(sstats.rules.size() == 1);
+    mapnik::render_stats::rule_stats const& rstats = sstats.rules.front();
+    CHECK(rstats.features == 3);
+    CHECK(rstats.vertices == 12);
+    REQUIRE(rstats.symbolizers.size() == 2);
+    CHECK(rstats.symbolizers[0].first == "PolygonSymbolizer");
+    CHECK(rstats.symbolizers[0].second.count == 3);
+    CHECK(rstats.symbolizers[1].first == "LineSymbolizer");
+    CHECK(rstats.symbolizers[1].second.count == 3);
+    CHECK(rstats.time == rstats.symbolizers[0].second.time + rstats.symbolizers[1].second.time);
+    CHECK(stats.features() == 3);
+    CHECK(stats.vertices() == 12);
+    CHECK(stats.total >= lstats.render);
+
+    ren.apply();
+    CHECK(stats.layers.size() == 2);
+    stats.clear();
+    CHECK(stats.layers.empty());
+    CHECK(stats.total == mapnik::render_stats::duration::zero());
+}
+
+SECTION("allocations are counted when built with allocation counting") {
+    mapnik::render_stats stats;
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.set_stats(&stats);
+    ren.apply();
+    std::size_t allocations = 0;
+    for (mapnik::alloc_counters const& counters : stats.allocations)
+    {
+        allocations += counters.allocations;
+    }
+    if (mapnik::alloc_stats::enabled())
+    {
+        CHECK(allocations > 0);
+        CHECK(stats.peak_bytes > 0);
+    }
+    else
+    {
+        CHECK(allocations == 0);
+        CHECK(stats.peak_bytes == 0);
+    }
+}
+
+SECTION("nothing is collected by default") {
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    CHECK(ren.stats() == nullptr);
+    ren.apply();
+}
+
+}
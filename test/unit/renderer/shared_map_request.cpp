@@ -0,0 +1,126 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/request.hpp>
+#include <mapnik/attribute.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/scale_denominator.hpp>
+
+#include <cmath>
+
+namespace {
+
+mapnik::feature_type_style fill_style(mapnik::color const& fill, double max_scale)
+{
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    if (max_scale > 0) rule.set_max_scale(max_scale);
+    mapnik::polygon_symbolizer poly_sym;
+    mapnik::put(poly_sym, mapnik::keys::fill, fill);
+    rule.append(std::move(poly_sym));
+    style.add_rule(std::move(rule));
+    return style;
+}
+
+// red everywhere, blue above a scale denominator between the map's own one
+// and that of a request at half its resolution
+mapnik::Map prepare_shared_map()
+{
+    mapnik::Map map(256, 256);
+    map.set_background(mapnik::color(255, 255, 255));
+    double coarse = mapnik::scale_denominator(20.0 / 256, true);
+    double fine = mapnik::scale_denominator(10.0 / 256, true);
+    map.insert_style("base", fill_style(mapnik::color(255, 0, 0), 0));
+    map.insert_style("detail", fill_style(mapnik::color(0, 0, 255), std::sqrt(coarse * fine)));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(1, -4);
+    ring.emplace_back(8, -4);
+    ring.emplace_back(8, 0);
+    ring.emplace_back(1, 0);
+    ring.emplace_back(1, -4);
+    poly.push_back(std::move(ring));
+    feature->set_geometry(std::move(poly));
+    ds->push(feature);
+
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("base");
+    lyr.add_style("detail");
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-10, -10, 10, 10));
+    return map;
+}
+
+unsigned count_differences(mapnik::image_rgba8 const& im1, mapnik::image_rgba8 const& im2)
+{
+    REQUIRE(im1.width() == im2.width());
+    REQUIRE(im1.height() == im2.height());
+    unsigned differ = 0;
+    for (unsigned y = 0; y < im1.height(); ++y)
+    {
+        for (unsigned x = 0; x < im1.width(); ++x)
+        {
+            if (im1(x, y) != im2(x, y)) ++differ;
+        }
+    }
+    return differ;
+}
+
+}
+
+TEST_CASE("shared map request") {
+
+SECTION("a request built from the map renders like the map") {
+    mapnik::Map const map(prepare_shared_map());
+    mapnik::image_rgba8 expected(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, expected);
+    ren.apply();
+    CHECK(expected(160, 144) == mapnik::color(255, 0, 0).rgba());
+
+    mapnik::request req(map.width(), map.height(), map.get_current_extent());
+    req.set_buffer_size(map.buffer_size());
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> req_ren(map, req, mapnik::attributes(), im);
+    req_ren.apply();
+    CHECK(count_differences(im, expected) == 0);
+}
+
+SECTION("the request's size and extent replace the map's") {
+    mapnik::Map const map(prepare_shared_map());
+    mapnik::box2d<double> extent(2, -3, 7, -0.5);
+    mapnik::request req(128, 64, extent);
+    mapnik::image_rgba8 im(128, 64);
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, req, mapnik::attributes(), im);
+    ren.apply();
+    // the finer scale denominator of the request enables the detail style
+    CHECK(im(64, 32) == mapnik::color(0, 0, 255).rgba());
+
+    mapnik::Map resized(map);
+    resized.resize(128, 64);
+    resized.zoom_to_box(extent);
+    mapnik::image_rgba8 expected(128, 64);
+    mapnik::agg_renderer<mapnik::image_rgba8> resized_ren(resized, expected);
+    resized_ren.apply();
+    CHECK(count_differences(im, expected) == 0);
+
+    // the shared map is left as it was
+    CHECK(map.width() == 256);
+    CHECK(map.height() == 256);
+    CHECK(map.get_current_extent() == mapnik::box2d<double>(-10, -10, 10, 10));
+}
+
+}
@@ -0,0 +1,166 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/strip_renderer.hpp>
+
+#include <algorithm>
+
+namespace {
+
+mapnik::Map prepare_strip_map()
+{
+    mapnik::Map map(256, 256);
+    map.set_background(mapnik::color(255, 255, 255));
+
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    mapnik::polygon_symbolizer poly_sym;
+    mapnik::put(poly_sym, mapnik::keys::fill, mapnik::color(255, 0, 0));
+    rule.append(std::move(poly_sym));
+    style.add_rule(std::move(rule));
+    map.insert_style("polygons", std::move(style));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    // triangle crossing every strip
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(-10, -10);
+    ring.emplace_back(10, -10);
+    ring.emplace_back(-10, 10);
+    ring.emplace_back(-10, -10);
+    poly.push_back(std::move(ring));
+    feature->set_geometry(std::move(poly));
+    ds->push(feature);
+
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("polygons");
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-10, -10, 10, 10));
+    return map;
+}
+
+}
+
+TEST_CASE("strip_renderer") {
+
+SECTION("strips") {
+    mapnik::Map map(prepare_strip_map());
+    REQUIRE_THROWS(mapnik::strip_renderer(map, 0));
+    mapnik::strip_renderer ren(map, 3);
+    CHECK(ren.strips() == 3);
+    CHECK(ren.strip_row(0) == 0);
+    CHECK(ren.strip_row(1) == 85);
+    CHECK(ren.strip_row(3) == 256);
+    mapnik::box2d<double> top = ren.strip_extent(0);
+    CHECK(top.maxy() == Approx(10.0));
+    CHECK(top.miny() == Approx(10.0 - 85 * 20.0 / 256));
+    CHECK(ren.strip_extent(2).miny() == Approx(-10.0));
+    CHECK(mapnik::strip_renderer(map, 1000).strips() == 256);
+}
+
+SECTION("matches a single render") {
+    mapnik::Map map(prepare_strip_map());
+    REQUIRE(mapnik::strip_renderer::splittable(map));
+
+    mapnik::image_rgba8 full(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> full_ren(map, full);
+    full_ren.apply();
+
+    mapnik::image_rgba8 stitched;
+    mapnik::strip_renderer ren(map, 4);
+    ren.apply(stitched);
+    REQUIRE(stitched.width() == full.width());
+    REQUIRE(stitched.height() == full.height());
+    for (unsigned y : {10u, 63u, 64u, 127u, 128u, 200u, 250u})
+    {
+        CHECK(stitched(20, y) == full(20, y));
+        CHECK(stitched(230, y) == full(230, y));
+    }
+    CHECK(stitched(20, 250) == mapnik::color(255, 0, 0).rgba());
+    CHECK(stitched(230, 10) == mapnik::color(255, 255, 255).rgba());
+}
+
+SECTION("labels are split from geometry") {
+    mapnik::polygon_symbolizer poly_sym;
+    CHECK_FALSE(mapnik::uses_placement_detector(poly_sym));
+    mapnik::text_symbolizer text_sym;
+    CHECK(mapnik::uses_placement_detector(text_sym));
+    mapnik::point_symbolizer point_sym;
+    CHECK(mapnik::uses_placement_detector(point_sym));
+    mapnik::put(point_sym, mapnik::keys::allow_overlap, true);
+    mapnik::put(point_sym, mapnik::keys::ignore_placement, true);
+    CHECK_FALSE(mapnik::uses_placement_detector(point_sym));
+
+    mapnik::Map map(prepare_strip_map());
+    map.set_background_image("image.png");
+    CHECK_FALSE(mapnik::strip_renderer::splittable(map));
+}
+
+SECTION("strips are streamed") {
+    mapnik::Map map(prepare_strip_map());
+    // colliding points on a strip edge, drawn in the label pass
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    rule.append(mapnik::point_symbolizer());
+    style.add_rule(std::move(rule));
+    map.insert_style("points", std::move(style));
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    for (double x : { 0.0, 0.1, 5.0 })
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+        feature->set_geometry(mapnik::geometry::point<double>(x, x / 10));
+        ds->push(feature);
+    }
+    mapnik::layer lyr("points");
+    lyr.set_datasource(ds);
+    lyr.add_style("points");
+    map.add_layer(lyr);
+
+    mapnik::image_rgba8 full(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> full_ren(map, full);
+    full_ren.apply();
+
+    mapnik::image_rgba8 stitched(map.width(), map.height());
+    unsigned next_row = 0;
+    mapnik::strip_renderer ren(map, 4);
+    ren.apply([&](mapnik::image_rgba8 const& band, unsigned row) {
+        CHECK(row == next_row);
+        CHECK(band.height() == 64);
+        for (unsigned y = 0; y < band.height(); ++y)
+        {
+            std::copy(band.get_row(y), band.get_row(y) + band.width(), stitched.get_row(row + y));
+        }
+        next_row += band.height();
+    });
+    CHECK(next_row == map.height());
+    unsigned differ = 0;
+    for (unsigned y = 0; y < full.height(); ++y)
+    {
+        for (unsigned x = 0; x < full.width(); ++x)
+        {
+            if (stitched(x, y) != full(x, y)) ++differ;
+        }
+    }
+    CHECK(differ == 0);
+    // the point on the strip edge was drawn in both strips
+    CHECK(stitched(128, 127) == mapnik::color(0, 0, 0).rgba());
+    CHECK(stitched(128, 128) == mapnik::color(0, 0, 0).rgba());
+}
+
+}
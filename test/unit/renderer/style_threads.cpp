@@ -0,0 +1,131 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/image_filter_types.hpp>
+#include <mapnik/agg_renderer.hpp>
+
+namespace {
+
+mapnik::feature_type_style polygon_style(mapnik::color const& fill)
+{
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    mapnik::polygon_symbolizer poly_sym;
+    mapnik::put(poly_sym, mapnik::keys::fill, fill);
+    rule.append(std::move(poly_sym));
+    style.add_rule(std::move(rule));
+    return style;
+}
+
+mapnik::Map prepare_layered_map()
+{
+    mapnik::Map map(256, 256);
+    map.set_background(mapnik::color(255, 255, 255));
+
+    // drawn apart: a comp-op, an opacity with filters, a plain opacity
+    mapnik::feature_type_style multiplied = polygon_style(mapnik::color(255, 0, 0));
+    multiplied.set_comp_op(mapnik::multiply);
+    map.insert_style("multiplied", std::move(multiplied));
+
+    mapnik::feature_type_style blurred;
+    {
+        mapnik::rule rule;
+        mapnik::line_symbolizer line_sym;
+        mapnik::put(line_sym, mapnik::keys::stroke, mapnik::color(0, 0, 255));
+        mapnik::put(line_sym, mapnik::keys::stroke_width, 6.0);
+        rule.append(std::move(line_sym));
+        blurred.add_rule(std::move(rule));
+    }
+    blurred.set_opacity(0.5f);
+    blurred.image_filters().emplace_back(mapnik::filter::agg_stack_blur(2, 2));
+    map.insert_style("blurred", std::move(blurred));
+
+    // drawn in turn, straight into the map
+    map.insert_style("plain", polygon_style(mapnik::color(0, 128, 0, 128)));
+
+    mapnik::feature_type_style faded = polygon_style(mapnik::color(255, 255, 0));
+    faded.set_opacity(0.25f);
+    map.insert_style("faded", std::move(faded));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    for (int i = 0; i < 4; ++i)
+    {
+        mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, i + 1));
+        mapnik::geometry::polygon<double> poly;
+        mapnik::geometry::linear_ring<double> ring;
+        double x = -9.0 + i * 4.0;
+        ring.emplace_back(x, -8);
+        ring.emplace_back(x + 5, -8);
+        ring.emplace_back(x + 5, 8 - i * 3);
+        ring.emplace_back(x, 8 - i * 3);
+        ring.emplace_back(x, -8);
+        poly.push_back(std::move(ring));
+        feature->set_geometry(std::move(poly));
+        ds->push(feature);
+    }
+
+    mapnik::layer lyr("layer");
+    lyr.set_datasource(ds);
+    lyr.add_style("multiplied");
+    lyr.add_style("plain");
+    lyr.add_style("blurred");
+    lyr.add_style("faded");
+    lyr.set_cache_features(true);
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-10, -10, 10, 10));
+    return map;
+}
+
+}
+
+TEST_CASE("style_threads") {
+
+SECTION("concurrent styles match styles rendered in turn") {
+    mapnik::Map map(prepare_layered_map());
+    mapnik::image_rgba8 expected(map.width(), map.height());
+    {
+        mapnik::agg_renderer<mapnik::image_rgba8> ren(map, expected);
+        ren.apply();
+    }
+    for (unsigned threads : { 2u, 4u })
+    {
+        mapnik::image_rgba8 result(map.width(), map.height());
+        mapnik::agg_renderer<mapnik::image_rgba8> ren(map, result);
+        ren.set_style_threads(threads);
+        ren.apply();
+        INFO("threads " << threads);
+        CHECK(result == expected);
+    }
+    CHECK(expected(10, 10) == mapnik::color(255, 255, 255).rgba());
+    CHECK(expected(20, 128) != mapnik::color(255, 255, 255).rgba());
+}
+
+SECTION("styles using the placement detector are not drawn apart") {
+    mapnik::Map map(prepare_layered_map());
+    mapnik::image_rgba8 im(map.width(), map.height());
+    mapnik::agg_renderer<mapnik::image_rgba8> ren(map, im);
+    ren.set_style_threads(4);
+    mapnik::feature_type_style const& multiplied = map.styles().find("multiplied")->second;
+    CHECK(ren.renders_style_apart(multiplied));
+    CHECK(!ren.renders_style_apart(map.styles().find("plain")->second));
+
+    mapnik::feature_type_style markers = polygon_style(mapnik::color(255, 0, 0));
+    markers.set_comp_op(mapnik::multiply);
+    markers.get_rules_nonconst()[0].append(mapnik::markers_symbolizer());
+    CHECK(!ren.renders_style_apart(markers));
+
+    ren.set_style_threads(1);
+    CHECK(!ren.renders_style_apart(multiplied));
+}
+
+}
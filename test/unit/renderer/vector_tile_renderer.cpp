@@ -0,0 +1,111 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/layer.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/memory_datasource.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/vector_tile/vector_tile_renderer.hpp>
+#include <mapnik/vector_tile/pbf_writer.hpp>
+
+#include <string>
+
+namespace {
+
+std::size_t count(std::string const& data, std::string const& bytes)
+{
+    std::size_t n = 0;
+    for (auto pos = data.find(bytes); pos != std::string::npos; pos = data.find(bytes, pos + 1)) ++n;
+    return n;
+}
+
+mapnik::Map prepare_tile_map()
+{
+    mapnik::Map map(256, 256);
+    mapnik::feature_type_style style;
+    mapnik::rule rule;
+    rule.append(mapnik::point_symbolizer());
+    rule.append(mapnik::markers_symbolizer());
+    style.add_rule(std::move(rule));
+    map.insert_style("points", std::move(style));
+
+    mapnik::parameters params;
+    params["type"] = "memory";
+    auto ds = std::make_shared<mapnik::memory_datasource>(params);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("name");
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    feature->put("name", mapnik::value_unicode_string("centre"));
+    feature->set_geometry(mapnik::geometry::point<double>(0, 0));
+    ds->push(feature);
+
+    mapnik::layer lyr("places");
+    lyr.set_datasource(ds);
+    lyr.add_style("points");
+    map.add_layer(lyr);
+    map.zoom_to_box(mapnik::box2d<double>(-128, -128, 128, 128));
+    return map;
+}
+
+}
+
+TEST_CASE("vector_tile_renderer") {
+
+SECTION("pbf encoding") {
+    std::string data;
+    mapnik::vector_tile::pbf_writer writer(data);
+    writer.add_uint(1, 300);
+    CHECK(data == std::string("\x08\xac\x02", 3));
+    CHECK(mapnik::vector_tile::pbf_writer::zigzag(std::int32_t(-1)) == 1u);
+    CHECK(mapnik::vector_tile::pbf_writer::zigzag(std::int32_t(2048)) == 4096u);
+}
+
+SECTION("writes each feature once") {
+    mapnik::Map map(prepare_tile_map());
+    std::string tile;
+    mapnik::vector_tile_renderer ren(map, tile);
+    ren.apply();
+    CHECK(ren.painted());
+    REQUIRE(!tile.empty());
+    // Tile.layers
+    CHECK(tile[0] == '\x1a');
+    CHECK(count(tile, "places") == 1);
+    CHECK(count(tile, "name") == 1);
+    CHECK(count(tile, "centre") == 1);
+    // MoveTo(1) to the centre of a 4096 wide tile
+    CHECK(count(tile, std::string("\x22\x05\x09\x80\x20\x80\x20", 7)) == 1);
+}
+
+SECTION("writes features sharing an id") {
+    mapnik::Map map(prepare_tile_map());
+    auto ds = std::dynamic_pointer_cast<mapnik::memory_datasource>(map.get_layer(0).datasource());
+    REQUIRE(ds);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("name");
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    feature->put("name", mapnik::value_unicode_string("east"));
+    feature->set_geometry(mapnik::geometry::point<double>(64, 0));
+    ds->push(feature);
+    std::string tile;
+    mapnik::vector_tile_renderer ren(map, tile);
+    ren.apply();
+    CHECK(count(tile, "centre") == 1);
+    CHECK(count(tile, "east") == 1);
+    CHECK(count(tile, std::string("\x22\x05\x09\x80\x20\x80\x20", 7)) == 1);
+    // MoveTo(1) to three quarters across
+    CHECK(count(tile, std::string("\x22\x05\x09\x80\x30\x80\x20", 7)) == 1);
+}
+
+SECTION("skips empty layers") {
+    mapnik::Map map(prepare_tile_map());
+    map.zoom_to_box(mapnik::box2d<double>(100, 100, 120, 120));
+    std::string tile;
+    mapnik::vector_tile_renderer ren(map, tile);
+    ren.apply();
+    CHECK(tile.empty());
+}
+
+}
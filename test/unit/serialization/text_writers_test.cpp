@@ -0,0 +1,182 @@
+#include "catch.hpp"
+// mapnik
+#include <mapnik/geometry.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/json/geojson_writer.hpp>
+#include <mapnik/json/geometry_parser.hpp>
+#include <mapnik/wkt/wkt_writer.hpp>
+#include <mapnik/wkt/wkt_factory.hpp>
+#include <mapnik/util/conversions.hpp>
+// stl
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <string>
+
+TEST_CASE("text writers") {
+
+SECTION("shortest doubles")
+{
+    auto shortest = [](double value)
+    {
+        std::string str;
+        mapnik::util::to_shortest_string(str, value);
+        return str;
+    };
+    CHECK(shortest(0) == "0");
+    CHECK(shortest(-0.0) == "0");
+    CHECK(shortest(0.1) == "0.1");
+    CHECK(shortest(-1.5) == "-1.5");
+    CHECK(shortest(100) == "100");
+    CHECK(shortest(-122.41941550000001) == "-122.41941550000001");
+    CHECK(shortest(1e20) == "100000000000000000000");
+    CHECK(shortest(1e21) == "1e21");
+    CHECK(shortest(0.000001) == "0.000001");
+    CHECK(shortest(-0.0000012345678901234567) == "-0.0000012345678901234567");
+    CHECK(shortest(9.99e-7) == "9.99e-7");
+    CHECK(shortest(1e-7) == "1e-7");
+    CHECK(shortest(1.2345e-7) == "1.2345e-7");
+    CHECK(shortest(5e-324) == "5e-324");
+    CHECK(shortest(std::numeric_limits<double>::max()) == "1.7976931348623157e308");
+    CHECK(shortest(std::numeric_limits<double>::infinity()) == "inf");
+    CHECK(shortest(-std::numeric_limits<double>::infinity()) == "-inf");
+    CHECK(shortest(std::numeric_limits<double>::quiet_NaN()) == "nan");
+
+    // every double reads back the same
+    double value = 1.0;
+    for (int i = 0; i < 2000; ++i)
+    {
+        value = value * -1.7 + 1.0 / 3.0;
+        if (i % 100 == 0) value = 1.0 / (i + 7);
+        std::string str = shortest(value);
+        CHECK(str.size() <= mapnik::util::max_shortest_chars);
+        CHECK(std::strtod(str.c_str(), nullptr) == value);
+    }
+}
+
+SECTION("geojson geometries")
+{
+    using namespace mapnik::geometry;
+    auto json = [](geometry<double> const& geom)
+    {
+        std::string str("prefix:");
+        mapnik::json::write_geojson(str, geom);
+        std::ostringstream out;
+        mapnik::json::write_geojson(out, geom);
+        CHECK(str == "prefix:" + out.str());
+        return out.str();
+    };
+
+    CHECK(json(geometry_empty()) == "null");
+    CHECK(json(point<double>(1.5, -0.1)) == "{\"type\":\"Point\",\"coordinates\":[1.5,-0.1]}");
+    line_string<double> line;
+    CHECK(json(line) == "{\"type\":\"LineString\",\"coordinates\":[]}");
+    line.emplace_back(1, 2);
+    line.emplace_back(3, 4);
+    CHECK(json(line) == "{\"type\":\"LineString\",\"coordinates\":[[1,2],[3,4]]}");
+    polygon<double> poly;
+    linear_ring<double> ring;
+    ring.emplace_back(0, 0);
+    ring.emplace_back(1, 0);
+    ring.emplace_back(0, 1);
+    ring.emplace_back(0, 0);
+    poly.push_back(ring);
+    CHECK(json(poly) == "{\"type\":\"Polygon\",\"coordinates\":[[[0,0],[1,0],[0,1],[0,0]]]}");
+    multi_polygon<double> multi_poly;
+    multi_poly.push_back(poly);
+    multi_poly.push_back(poly);
+    CHECK(json(multi_poly) == "{\"type\":\"MultiPolygon\",\"coordinates\":"
+          "[[[[0,0],[1,0],[0,1],[0,0]]],[[[0,0],[1,0],[0,1],[0,0]]]]}");
+    geometry_collection<double> collection;
+    CHECK(json(collection) == "{\"type\":\"GeometryCollection\",\"geometries\":[]}");
+    collection.emplace_back(point<double>(1, 2));
+    collection.emplace_back(line);
+    CHECK(json(collection) == "{\"type\":\"GeometryCollection\",\"geometries\":["
+          "{\"type\":\"Point\",\"coordinates\":[1,2]},"
+          "{\"type\":\"LineString\",\"coordinates\":[[1,2],[3,4]]}]}");
+
+    // round trip
+    std::string in = "{\"type\":\"MultiLineString\",\"coordinates\":[[[-122.41941550000001,37.7749295],[0.1,1e-7]],[]]}";
+    geometry<double> geom;
+    REQUIRE(mapnik::json::from_geojson(in, geom));
+    CHECK(json(geom) == in);
+}
+
+SECTION("geojson features")
+{
+    auto ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("name");
+    ctx->push("count");
+    ctx->push("ratio");
+    ctx->push("flag");
+    ctx->push("empty");
+    ctx->push("say \"hi\"");
+    mapnik::feature_impl feature(ctx, 7);
+    feature.put("name", mapnik::value_unicode_string::fromUTF8("tab\there \"q\" \\ \x01 caf\xc3\xa9"));
+    feature.put("count", mapnik::value_integer(-42));
+    feature.put("ratio", 0.1);
+    feature.put("flag", true);
+    feature.put("say \"hi\"", mapnik::value_integer(1));
+    feature.set_geometry(mapnik::geometry::point<double>(10.5, -3));
+    std::string expected = "{\"type\":\"Feature\",\"id\":7,"
+        "\"geometry\":{\"type\":\"Point\",\"coordinates\":[10.5,-3]},"
+        "\"properties\":{\"count\":-42,\"flag\":true,\"name\":\"tab\\there \\\"q\\\" \\\\ \\u0001 caf\xc3\xa9\","
+        "\"ratio\":0.1,\"say \\\"hi\\\"\":1}}";
+    std::string str;
+    mapnik::json::write_geojson(str, feature);
+    CHECK(str == expected);
+    std::ostringstream out;
+    mapnik::json::write_geojson(out, feature);
+    CHECK(out.str() == expected);
+}
+
+SECTION("wkt")
+{
+    using namespace mapnik::geometry;
+    auto wkt = [](geometry<double> const& geom)
+    {
+        std::string str;
+        mapnik::wkt::write_wkt(str, geom);
+        std::ostringstream out;
+        mapnik::wkt::write_wkt(out, geom);
+        CHECK(str == out.str());
+        return str;
+    };
+    CHECK(wkt(geometry_empty()) == "POINT EMPTY");
+    CHECK(wkt(point<double>(1.5, -0.1)) == "POINT(1.5 -0.1)");
+    CHECK(wkt(line_string<double>()) == "LINESTRING EMPTY");
+    polygon<double> poly;
+    poly.emplace_back();
+    CHECK(wkt(poly) == "POLYGON EMPTY");
+    linear_ring<double> ring;
+    ring.emplace_back(0, 0);
+    ring.emplace_back(1, 0);
+    ring.emplace_back(0, 1);
+    ring.emplace_back(0, 0);
+    poly.push_back(ring);
+    poly.push_back(ring);
+    // empty rings are left out
+    CHECK(wkt(poly) == "POLYGON((0 0,1 0,0 1,0 0),(0 0,1 0,0 1,0 0))");
+    multi_line_string<double> multi_line;
+    multi_line.emplace_back();
+    CHECK(wkt(multi_line) == "MULTILINESTRING EMPTY");
+    geometry_collection<double> collection;
+    CHECK(wkt(collection) == "GEOMETRYCOLLECTION EMPTY");
+    collection.emplace_back(point<double>(1, 2));
+    collection.emplace_back(geometry_empty());
+    CHECK(wkt(collection) == "GEOMETRYCOLLECTION(POINT(1 2),POINT EMPTY)");
+
+    geometry<std::int64_t> int_point = point<std::int64_t>(-5, 1234567890123);
+    std::string str;
+    mapnik::wkt::write_wkt(str, int_point);
+    CHECK(str == "POINT(-5 1234567890123)");
+
+    // round trip
+    std::string in = "MULTIPOINT(-122.41941550000001 37.7749295,0.1 1e-7)";
+    geometry<double> geom;
+    REQUIRE(mapnik::from_wkt(in, geom));
+    CHECK(wkt(geom) == in);
+}
+
+}
@@ -1,6 +1,7 @@
 #include "catch.hpp"
 
 #include <iostream>
+#include <cstring>
 #include <mapnik/wkb.hpp>
 #include <mapnik/geometry/is_valid.hpp>
 #include <mapnik/geometry/is_simple.hpp>
@@ -112,4 +113,53 @@ SECTION("wkb") {
         std::clog << "threw: " << ex.what() << "\n";
     }
 }
+
+SECTION("wkb coordinates in both byte orders") {
+
+    auto put_int = [](std::string & wkb, std::uint32_t value, bool xdr) {
+        for (int i = 0; i < 4; ++i)
+        {
+            wkb.push_back(static_cast<char>(value >> (xdr ? 24 - 8 * i : 8 * i)));
+        }
+    };
+    auto put_double = [](std::string & wkb, double value, bool xdr) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, 8);
+        for (int i = 0; i < 8; ++i)
+        {
+            wkb.push_back(static_cast<char>(bits >> (xdr ? 56 - 8 * i : 8 * i)));
+        }
+    };
+    for (bool xdr : { false, true })
+    {
+        for (std::uint32_t type : { 2u, 1002u, 3002u })
+        {
+            std::size_t extra = type == 2 ? 0 : type == 1002 ? 1 : 2;
+            std::string wkb(1, static_cast<char>(xdr ? 0 : 1));
+            put_int(wkb, type, xdr);
+            put_int(wkb, 3, xdr);
+            for (int i = 0; i < 3; ++i)
+            {
+                put_double(wkb, i + 0.5, xdr);
+                put_double(wkb, -i * 2.0, xdr);
+                for (std::size_t d = 0; d < extra; ++d) put_double(wkb, 99.0, xdr);
+            }
+            mapnik::geometry::geometry<double> geom =
+                mapnik::geometry_utils::from_wkb(wkb.data(), wkb.size(), mapnik::wkbGeneric);
+            REQUIRE(geom.is<mapnik::geometry::line_string<double>>());
+            auto const& line = geom.get<mapnik::geometry::line_string<double>>();
+            REQUIRE(line.size() == 3);
+            for (std::size_t i = 0; i < 3; ++i)
+            {
+                CHECK(line[i].x == i + 0.5);
+                CHECK(line[i].y == -2.0 * i);
+            }
+            // a point count past the end of the blob is cut to the points there
+            std::string truncated = wkb.substr(0, wkb.size() - 4);
+            geom = mapnik::geometry_utils::from_wkb(truncated.data(), truncated.size(), mapnik::wkbGeneric);
+            REQUIRE(geom.is<mapnik::geometry::line_string<double>>());
+            CHECK(geom.get<mapnik::geometry::line_string<double>>().size() == 2);
+        }
+    }
+}
 }
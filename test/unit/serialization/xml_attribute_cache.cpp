@@ -0,0 +1,82 @@
+#include "catch.hpp"
+
+#include <mapnik/map.hpp>
+#include <mapnik/rule.hpp>
+#include <mapnik/feature_type_style.hpp>
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/load_map.hpp>
+#include <mapnik/parse_cache.hpp>
+#include <mapnik/color_factory.hpp>
+#include <mapnik/parse_path.hpp>
+#include <mapnik/xml_tree.hpp>
+#include <mapnik/xml_loader.hpp>
+#include <mapnik/transform/transform_expression.hpp>
+#include <mapnik/attribute.hpp> // needed due to fwd declare in value_types.hpp
+
+#include <string>
+
+TEST_CASE("xml attribute cache") {
+
+SECTION("repeated colors are parsed once per tree") {
+    mapnik::xml_tree tree;
+    REQUIRE_NOTHROW(read_xml_string("<Map>"
+                                    "<A fill='#ff8800'/><B fill='#ff8800'/><C fill='rgba(0,0,255,0.5)'/>"
+                                    "<D fill='not a color'/>"
+                                    "</Map>", tree.root(), ""));
+    mapnik::xml_node const& map = tree.root().get_child("Map");
+    boost::optional<mapnik::color> a = map.get_child("A").get_opt_attr<mapnik::color>("fill");
+    boost::optional<mapnik::color> b = map.get_child("B").get_opt_attr<mapnik::color>("fill");
+    boost::optional<mapnik::color> c = map.get_child("C").get_opt_attr<mapnik::color>("fill");
+    REQUIRE(a);
+    REQUIRE(b);
+    REQUIRE(c);
+    CHECK(*a == mapnik::parse_color("#ff8800"));
+    CHECK(*b == *a);
+    CHECK(*c == mapnik::parse_color("rgba(0,0,255,0.5)"));
+    CHECK(tree.color_cache_.size() == 2);
+    // invalid colors still throw and are not remembered
+    CHECK_THROWS(map.get_child("D").get_opt_attr<mapnik::color>("fill"));
+    CHECK(tree.color_cache_.size() == 2);
+}
+
+SECTION("rules share transforms and paths parsed from the same text") {
+    // without the process wide cache only the tree can share the results
+    mapnik::parse_cache & cache = mapnik::parse_cache::instance();
+    std::size_t max_entries = cache.max_entries();
+    cache.set_max_entries(0);
+    std::string const rule("<Rule>"
+                           "<PolygonSymbolizer fill='#ff8800' geometry-transform='translate(1,2) scale(2)'/>"
+                           "<PointSymbolizer file='icons/[name].png'/>"
+                           "</Rule>");
+    mapnik::Map map(256, 256);
+    mapnik::load_map_string(map, "<Map><Style name='s'>" + rule + rule + "</Style></Map>");
+    cache.set_max_entries(max_entries);
+
+    boost::optional<mapnik::feature_type_style const&> style = map.find_style("s");
+    REQUIRE(style);
+    REQUIRE(style->get_rules().size() == 2);
+    mapnik::rule const& first = style->get_rules()[0];
+    mapnik::rule const& second = style->get_rules()[1];
+    REQUIRE(first.get_symbolizers().size() == 2);
+    REQUIRE(second.get_symbolizers().size() == 2);
+
+    auto const& poly1 = mapnik::util::get<mapnik::polygon_symbolizer>(first.get_symbolizers()[0]);
+    auto const& poly2 = mapnik::util::get<mapnik::polygon_symbolizer>(second.get_symbolizers()[0]);
+    CHECK(mapnik::get<mapnik::color>(poly1, mapnik::keys::fill) == mapnik::parse_color("#ff8800"));
+    CHECK(mapnik::get<mapnik::color>(poly2, mapnik::keys::fill) == mapnik::parse_color("#ff8800"));
+    auto trans1 = mapnik::get<mapnik::transform_type>(poly1, mapnik::keys::geometry_transform);
+    auto trans2 = mapnik::get<mapnik::transform_type>(poly2, mapnik::keys::geometry_transform);
+    REQUIRE(trans1);
+    CHECK(trans1 == trans2);
+    CHECK(mapnik::to_expression_string(*trans1) == "translate(1, 2) scale(2)");
+
+    auto const& point1 = mapnik::util::get<mapnik::point_symbolizer>(first.get_symbolizers()[1]);
+    auto const& point2 = mapnik::util::get<mapnik::point_symbolizer>(second.get_symbolizers()[1]);
+    auto path1 = mapnik::get<mapnik::path_expression_ptr>(point1, mapnik::keys::file);
+    auto path2 = mapnik::get<mapnik::path_expression_ptr>(point2, mapnik::keys::file);
+    REQUIRE(path1);
+    CHECK(path1 == path2);
+    CHECK(mapnik::path_processor_type::to_string(*path1) == "icons/[name].png");
+}
+
+}
@@ -0,0 +1,59 @@
+
+#include "catch.hpp"
+
+#include <mapnik/sql_filter.hpp>
+#include <mapnik/expression.hpp>
+
+namespace {
+
+std::string translate(std::string const& filter, mapnik::attributes const& vars = mapnik::attributes())
+{
+    mapnik::layer_descriptor desc("test", "utf-8");
+    desc.add_descriptor(mapnik::attribute_descriptor("type", mapnik::String));
+    desc.add_descriptor(mapnik::attribute_descriptor("lanes", mapnik::Integer));
+    desc.add_descriptor(mapnik::attribute_descriptor("width", mapnik::Double));
+    desc.add_descriptor(mapnik::attribute_descriptor("oneway", mapnik::Boolean));
+    return mapnik::sql_utils::filter_to_sql(*mapnik::parse_expression(filter), desc, vars);
+}
+
+}
+
+TEST_CASE("sql filter") {
+
+SECTION("comparisons") {
+    CHECK( translate("[type] = 'motorway'") == "\"type\" = 'motorway'" );
+    CHECK( translate("[lanes] >= 2") == "\"lanes\" >= 2" );
+    CHECK( translate("2 < [lanes]") == "\"lanes\" > 2" );
+    CHECK( translate("[width] < 2.5") == "\"width\" < 2.5" );
+    CHECK( translate("[lanes] != 2") == "(\"lanes\" <> 2 OR \"lanes\" IS NULL)" );
+    CHECK( translate("[type] = \"it's\"") == "\"type\" = 'it''s'" );
+}
+
+SECTION("logical") {
+    CHECK( translate("[type] = 'a' or [lanes] > 1") == "(\"type\" = 'a' OR \"lanes\" > 1)" );
+    CHECK( translate("[type] = 'a' and [lanes] > 1") == "(\"type\" = 'a' AND \"lanes\" > 1)" );
+    // an 'and' keeps the side it can test
+    CHECK( translate("[type] = 'a' and [name].match('x')") == "\"type\" = 'a'" );
+    // an 'or' needs both
+    CHECK( translate("[type] = 'a' or [name].match('x')") == "" );
+    CHECK( translate("not ([type] = 'a')") == "" );
+}
+
+SECTION("untranslated") {
+    // unknown columns, mismatched types and string ordering
+    CHECK( translate("[name] = 'a'") == "" );
+    CHECK( translate("[type] = 1") == "" );
+    CHECK( translate("[lanes] = 'a'") == "" );
+    CHECK( translate("[type] < 'm'") == "" );
+    CHECK( translate("[oneway] = true") == "" );
+    CHECK( translate("[lanes] = [width]") == "" );
+}
+
+SECTION("variables") {
+    mapnik::attributes vars;
+    vars["min"] = mapnik::value_integer(3);
+    CHECK( translate("[lanes] >= @min", vars) == "\"lanes\" >= 3" );
+    CHECK( translate("[lanes] >= @max", vars) == "" );
+}
+
+}
@@ -0,0 +1,163 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#include "catch.hpp"
+
+#include <mapnik/image.hpp>
+#include <mapnik/marker.hpp>
+#include <mapnik/svg/svg_parser.hpp>
+#include <mapnik/svg/svg_converter.hpp>
+#include <mapnik/svg/svg_path_adapter.hpp>
+#include <mapnik/svg/svg_renderer_agg.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore_agg.hpp>
+#include "agg_pixfmt_rgba.h"
+#include "agg_renderer_base.h"
+#include "agg_renderer_scanline.h"
+#include "agg_rasterizer_scanline_aa.h"
+#include "agg_scanline_u.h"
+#pragma GCC diagnostic pop
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+char const* curvy_svg =
+    "<?xml version='1.0' standalone='no'?>"
+    "<svg width='40' height='40' version='1.1' xmlns='http://www.w3.org/2000/svg'>"
+    "<path fill='#ff0000' stroke='#0000ff' stroke-width='2' stroke-linejoin='round'"
+    " d='M 2 20 C 2 5 38 5 38 20 Q 20 45 2 20 z'/>"
+    "<circle cx='20' cy='20' r='8' fill='none' stroke='#00ff00' stroke-width='1.5'"
+    " stroke-dasharray='3,2'/>"
+    "</svg>";
+
+void parse(mapnik::svg_storage_type & storage)
+{
+    mapnik::svg::vertex_stl_adapter<mapnik::svg::svg_path_storage> stl_storage(storage.source());
+    mapnik::svg::svg_path_adapter svg_path(stl_storage);
+    mapnik::svg::svg_converter_type svg(svg_path, storage.attributes());
+    mapnik::svg::svg_parser p(svg);
+    p.parse_from_string(curvy_svg);
+    double lox, loy, hix, hiy;
+    svg.bounding_rect(&lox, &loy, &hix, &hiy);
+    storage.set_bounding_box(lox, loy, hix, hiy);
+}
+
+mapnik::image_rgba8 render(mapnik::svg_storage_type & storage, agg::trans_affine const& mtx, bool flattened)
+{
+    using pixfmt = agg::pixfmt_rgba32_pre;
+    using renderer_base = agg::renderer_base<pixfmt>;
+    using renderer_solid = agg::renderer_scanline_aa_solid<renderer_base>;
+    mapnik::image_rgba8 image(160, 160);
+    agg::rendering_buffer buf(image.bytes(), image.width(), image.height(), image.row_size());
+    pixfmt pixf(buf);
+    renderer_base renb(pixf);
+    agg::rasterizer_scanline_aa<> ras;
+    agg::scanline_u8 sl;
+    mapnik::svg::vertex_stl_adapter<mapnik::svg::svg_path_storage> stl_storage(storage.source());
+    mapnik::svg::svg_path_adapter svg_path(stl_storage);
+    mapnik::svg::svg_renderer_agg<mapnik::svg::svg_path_adapter,
+                                  mapnik::svg_attribute_type,
+                                  renderer_solid,
+                                  pixfmt> svg_renderer(svg_path, storage.attributes());
+    if (flattened)
+    {
+        svg_renderer.set_flattened_paths(storage.get_flattened_paths());
+    }
+    svg_renderer.render(ras, sl, renb, mtx, 1.0, storage.bounding_box());
+    return image;
+}
+
+int max_difference(mapnik::image_rgba8 const& im1, mapnik::image_rgba8 const& im2)
+{
+    int diff = 0;
+    for (std::size_t y = 0; y < im1.height(); ++y)
+    {
+        for (std::size_t x = 0; x < im1.width(); ++x)
+        {
+            std::uint32_t a = im1(x, y);
+            std::uint32_t b = im2(x, y);
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                int d = std::abs(static_cast<int>((a >> shift) & 0xff) - static_cast<int>((b >> shift) & 0xff));
+                if (d > diff) diff = d;
+            }
+        }
+    }
+    return diff;
+}
+
+} // anonymous namespace
+
+TEST_CASE("svg flattened paths") {
+
+SECTION("renders like the curve pipelines")
+{
+    mapnik::svg_storage_type storage;
+    parse(storage);
+    CHECK(storage.get_flattened_paths() == nullptr);
+    storage.enable_flattened_paths();
+    REQUIRE(storage.get_flattened_paths() != nullptr);
+
+    for (double scale : { 0.7, 1.0, 3.3 })
+    {
+        agg::trans_affine mtx = agg::trans_affine_scaling(scale);
+        mtx *= agg::trans_affine_translation(10, 10);
+        mapnik::image_rgba8 expected = render(storage, mtx, false);
+        mapnik::image_rgba8 first = render(storage, mtx, true);
+        std::size_t entries = storage.get_flattened_paths()->size();
+        CHECK(entries > 0);
+        mapnik::image_rgba8 second = render(storage, mtx, true);
+        // reused, not flattened again
+        CHECK(storage.get_flattened_paths()->size() == entries);
+        CHECK(max_difference(first, second) == 0);
+        // the scale step only adds vertices along the curves
+        CHECK(max_difference(expected, first) <= 16);
+    }
+}
+
+SECTION("scales sharing a step share vertices")
+{
+    mapnik::svg_storage_type storage;
+    parse(storage);
+    storage.enable_flattened_paths();
+    mapnik::svg::flattened_paths & paths = *storage.get_flattened_paths();
+    mapnik::svg::vertex_stl_adapter<mapnik::svg::svg_path_storage> stl_storage(storage.source());
+    mapnik::svg::svg_path_adapter svg_path(stl_storage);
+    unsigned path_id = storage.attributes()[0].index;
+    auto coarse = paths.curve(svg_path, path_id, 1.0, false);
+    CHECK(paths.curve(svg_path, path_id, 1.0, false) == coarse);
+    CHECK(paths.curve(svg_path, path_id, 0.95, false) == coarse);
+    auto fine = paths.curve(svg_path, path_id, 8.0, false);
+    CHECK(fine != coarse);
+    CHECK(fine->size() > coarse->size());
+    auto outline = paths.stroke(svg_path, storage.attributes()[0], 1.0, true);
+    CHECK(outline != coarse);
+    CHECK(paths.stroke(svg_path, storage.attributes()[0], 1.0, true) == outline);
+    CHECK(paths.size() == 4);
+}
+
+}
@@ -0,0 +1,54 @@
+#include "catch.hpp"
+
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/expression_node.hpp>
+#include <mapnik/renderer_common/compiled_symbolizer.hpp>
+
+TEST_CASE("compiled symbolizer") {
+
+SECTION("constants, defaults and expressions") {
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    ctx->push("width");
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    feature->put("width", mapnik::value_integer(4));
+    mapnik::attributes vars;
+
+    mapnik::line_symbolizer sym;
+    mapnik::put(sym, mapnik::keys::stroke, mapnik::color(0, 0, 255));
+    mapnik::put(sym, mapnik::keys::stroke_width, std::make_shared<mapnik::expr_node>(mapnik::attribute("width")));
+    mapnik::compiled_line_symbolizer props(sym);
+
+    CHECK(props.stroke.is_constant());
+    CHECK(props.stroke.get(*feature, vars) == mapnik::color(0, 0, 255));
+    CHECK(!props.stroke_width.is_constant());
+    CHECK(props.stroke_width.get(*feature, vars) == Approx(4.0));
+    feature->put("width", mapnik::value_integer(1));
+    CHECK(props.stroke_width.get(*feature, vars) == Approx(1.0));
+    // unset properties fall back to their defaults
+    CHECK(props.stroke_opacity.get(*feature, vars) == Approx(1.0));
+    CHECK(props.comp_op.get(*feature, vars) == mapnik::src_over);
+    mapnik::value_bool clip = mapnik::get<mapnik::value_bool, mapnik::keys::clip>(sym, *feature, vars);
+    CHECK(props.clip.get(*feature, vars) == clip);
+    CHECK(!props.has_dasharray);
+    CHECK(!props.geometry_transform);
+}
+
+SECTION("cache is keyed by symbolizer") {
+    mapnik::polygon_symbolizer poly1;
+    mapnik::put(poly1, mapnik::keys::fill_opacity, 0.5);
+    mapnik::polygon_symbolizer poly2;
+    mapnik::line_symbolizer line;
+    mapnik::compiled_symbolizer_cache cache;
+    auto const& props1 = cache.get(poly1);
+    CHECK(&cache.get(poly1) == &props1);
+    CHECK(&cache.get(poly2) != &props1);
+    cache.get(line);
+    CHECK(cache.size() == 3);
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 1));
+    CHECK(props1.fill_opacity.get(*feature, mapnik::attributes()) == Approx(0.5));
+}
+
+}
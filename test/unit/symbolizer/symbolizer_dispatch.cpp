@@ -0,0 +1,102 @@
+#include "catch.hpp"
+
+#include <mapnik/symbolizer.hpp>
+#include <mapnik/symbolizer_dispatch.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/well_known_srs.hpp>
+
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace {
+
+// records every symbolizer type it is handed
+struct recording_processor
+{
+    template <typename Symbolizer>
+    void process(Symbolizer const&, mapnik::feature_impl & feature, mapnik::proj_transform const&)
+    {
+        calls.emplace_back(typeid(Symbolizer).name());
+        ids.push_back(feature.id());
+    }
+
+    std::vector<std::string> calls;
+    std::vector<mapnik::value_integer> ids;
+};
+
+// handles some symbolizer types only, the others are no-ops
+struct partial_processor
+{
+    void process(mapnik::line_symbolizer const&, mapnik::feature_impl &, mapnik::proj_transform const&)
+    {
+        calls.emplace_back("line");
+    }
+
+    void process(mapnik::text_symbolizer const&, mapnik::feature_impl &, mapnik::proj_transform const&)
+    {
+        calls.emplace_back("text");
+    }
+
+    std::vector<std::string> calls;
+};
+
+// one of every symbolizer type, in the variant's order
+std::vector<mapnik::symbolizer> all_symbolizers()
+{
+    return {
+        mapnik::point_symbolizer(), mapnik::line_symbolizer(), mapnik::line_pattern_symbolizer(),
+        mapnik::polygon_symbolizer(), mapnik::polygon_pattern_symbolizer(), mapnik::raster_symbolizer(),
+        mapnik::shield_symbolizer(), mapnik::text_symbolizer(), mapnik::building_symbolizer(),
+        mapnik::markers_symbolizer(), mapnik::group_symbolizer(), mapnik::debug_symbolizer(),
+        mapnik::dot_symbolizer()
+    };
+}
+
+}
+
+TEST_CASE("symbolizer dispatch") {
+
+mapnik::projection proj(mapnik::MAPNIK_LONGLAT_PROJ, true);
+mapnik::proj_transform prj_trans(proj, proj);
+mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, 7));
+std::vector<mapnik::symbolizer> symbolizers = all_symbolizers();
+
+SECTION("entries call what visiting the symbolizer calls") {
+    recording_processor visited;
+    recording_processor called;
+    for (std::size_t i = 0; i < symbolizers.size(); ++i)
+    {
+        REQUIRE(static_cast<std::size_t>(symbolizers[i].which()) == i);
+        mapnik::util::apply_visitor(mapnik::symbolizer_dispatch<recording_processor>(visited, *feature, prj_trans),
+                                    symbolizers[i]);
+        mapnik::symbolizer_entry<recording_processor> entry(symbolizers[i], i);
+        CHECK(entry.sym == &symbolizers[i]);
+        CHECK(entry.position == i);
+        entry(called, *feature, prj_trans);
+    }
+    REQUIRE(visited.calls.size() == symbolizers.size());
+    CHECK(called.calls == visited.calls);
+    CHECK(called.ids == std::vector<mapnik::value_integer>(symbolizers.size(), 7));
+    CHECK(called.calls[1] == typeid(mapnik::line_symbolizer).name());
+    CHECK(called.calls.back() == typeid(mapnik::dot_symbolizer).name());
+}
+
+SECTION("types without a process function are skipped") {
+    partial_processor visited;
+    partial_processor called;
+    for (auto const& sym : symbolizers)
+    {
+        mapnik::util::apply_visitor(mapnik::symbolizer_dispatch<partial_processor>(visited, *feature, prj_trans), sym);
+        mapnik::symbolizer_entry<partial_processor> entry(sym);
+        entry(called, *feature, prj_trans);
+    }
+    CHECK((visited.calls == std::vector<std::string>{ "line", "text" }));
+    CHECK(called.calls == visited.calls);
+}
+
+}
@@ -0,0 +1,62 @@
+#include "catch.hpp"
+#include <mapnik/text/distance_field.hpp>
+
+TEST_CASE("distance_field") {
+
+SECTION("distances grow away from the glyph") {
+    mapnik::glyph_bitmap square;
+    square.left = 2;
+    square.top = 3;
+    square.width = 3;
+    square.rows = 3;
+    square.buffer.resize(9, 255);
+    mapnik::glyph_bitmap field = mapnik::make_distance_field(square, 4);
+    REQUIRE(field.width == 11);
+    REQUIRE(field.rows == 11);
+    CHECK(field.left == -2);
+    CHECK(field.top == 7);
+    auto at = [&](unsigned x, unsigned y) { return field.buffer[y * field.width + x]; };
+    CHECK(at(5, 5) == 255);
+    CHECK(at(6, 6) == 255);
+    CHECK(at(7, 5) == 191);
+    CHECK(at(5, 3) == 191);
+    CHECK(at(8, 5) == 128);
+    CHECK(at(10, 5) == 0);
+    CHECK(at(0, 0) == 0);
+    CHECK(at(7, 7) > at(8, 7));
+}
+
+SECTION("partly covered pixels are nearer the edge") {
+    mapnik::glyph_bitmap line;
+    line.width = 2;
+    line.rows = 1;
+    line.buffer = { 255, 64 };
+    mapnik::glyph_bitmap field = mapnik::make_distance_field(line, 4);
+    unsigned char const* row = field.buffer.data() + 4 * field.width;
+    CHECK(row[4] == 255);
+    CHECK(row[5] < 255);
+    CHECK(row[5] > row[6]);
+}
+
+SECTION("halo coverage") {
+    CHECK(mapnik::distance_field_spread(0.5) == 4);
+    CHECK(mapnik::distance_field_spread(3.0) == 4);
+    CHECK(mapnik::distance_field_spread(3.5) == 8);
+    CHECK(mapnik::distance_field_spread(100.0) == 128);
+    CHECK(mapnik::distance_field_spread(200.0) == 0);
+    auto halo = mapnik::distance_field_halo(4, 2.0);
+    CHECK(halo[255] == 255);
+    CHECK(halo[191] == 255);
+    // two pixels out is half covered
+    CHECK(halo[128] > 100);
+    CHECK(halo[128] < 160);
+    CHECK(halo[96] > 0);
+    CHECK(halo[96] < 255);
+    CHECK(halo[0] == 0);
+    for (unsigned i = 1; i < 256; ++i)
+    {
+        CHECK(halo[i - 1] <= halo[i]);
+    }
+}
+
+}
@@ -0,0 +1,57 @@
+#include "catch.hpp"
+#include <mapnik/text/glyph_cache.hpp>
+
+namespace {
+
+mapnik::glyph_cache_key make_key(unsigned index)
+{
+    return mapnik::glyph_cache_key { "DejaVu Sans Book", index, 12 * 64,
+                                     0x10000L, 0, 0, 0x10000L, 0, 0, 0, 0 };
+}
+
+mapnik::glyph_bitmap_ptr make_bitmap(unsigned size)
+{
+    auto bitmap = std::make_shared<mapnik::glyph_bitmap>();
+    bitmap->width = size;
+    bitmap->rows = size;
+    bitmap->buffer.resize(size * size, 255);
+    return bitmap;
+}
+
+}
+
+TEST_CASE("glyph_cache") {
+
+SECTION("disabled by default") {
+    mapnik::glyph_cache & cache = mapnik::glyph_cache::instance();
+    cache.set_capacity(0);
+    cache.clear();
+    REQUIRE(!cache.enabled());
+    cache.insert(make_key(1), make_bitmap(4));
+    REQUIRE(cache.size() == 0);
+}
+
+SECTION("lru eviction") {
+    mapnik::glyph_cache & cache = mapnik::glyph_cache::instance();
+    cache.clear();
+    std::size_t entry_size = sizeof(mapnik::glyph_bitmap) + 100;
+    cache.set_capacity(2 * entry_size);
+    cache.insert(make_key(1), make_bitmap(10));
+    cache.insert(make_key(2), make_bitmap(10));
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.size_bytes() == 2 * entry_size);
+    // touch 1 so that 2 is evicted next
+    REQUIRE(cache.find(make_key(1)));
+    cache.insert(make_key(3), make_bitmap(10));
+    REQUIRE(cache.size() == 2);
+    CHECK(cache.find(make_key(1)));
+    CHECK(!cache.find(make_key(2)));
+    CHECK(cache.find(make_key(3)));
+    CHECK(cache.hits() == 3);
+    CHECK(cache.misses() == 1);
+    cache.set_capacity(0);
+    CHECK(cache.size() == 0);
+    cache.clear();
+}
+
+}
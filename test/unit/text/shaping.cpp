@@ -2,6 +2,7 @@
 #include <mapnik/text/icu_shaper.hpp>
 #include <mapnik/text/harfbuzz_shaper.hpp>
 #include <mapnik/text/font_library.hpp>
+#include <mapnik/text/face.hpp>
 #include <mapnik/unicode.hpp>
 
 namespace {
@@ -99,3 +100,70 @@ TEST_CASE("shaping")
 
 
 }
+
+TEST_CASE("shaping with fallback faces")
+{
+    REQUIRE(mapnik::freetype_engine::register_font("fonts/dejavu-fonts-ttf-2.37/ttf/DejaVuSerif.ttf"));
+    REQUIRE(mapnik::freetype_engine::register_font("fonts/dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf"));
+    mapnik::font_library fl;
+    mapnik::freetype_engine::font_file_mapping_type font_file_mapping;
+    mapnik::freetype_engine::font_memory_cache_type font_memory_cache;
+    mapnik::face_manager fm(fl, font_file_mapping, font_memory_cache);
+
+    SECTION("coverage bitmaps match the face's character map")
+    {
+        mapnik::face_ptr face = fm.get_face("DejaVu Sans Book");
+        REQUIRE(face);
+        for (std::uint32_t c : { 0x61u, 0x4e00u, 0x5d0u, 0x20u, 0x2d30u, 0x5d1u, 0x10ffffu, 0x431u, 0x4e01u })
+        {
+            INFO("codepoint " << c);
+            CHECK(face->has_glyph(c) == (FT_Get_Char_Index(face->get_face(), c) != 0));
+        }
+        for (std::uint32_t c = 0x580; c < 0x700; ++c)
+        {
+            INFO("codepoint " << c);
+            CHECK(face->has_glyph(c) == (FT_Get_Char_Index(face->get_face(), c) != 0));
+        }
+    }
+
+    SECTION("each character is drawn with the first face covering it")
+    {
+        mapnik::font_set fontset("fontset");
+        fontset.add_face_name("DejaVu Serif Book");
+        fontset.add_face_name("DejaVu Sans Book");
+        mapnik::transcoder tr("utf8");
+        std::map<unsigned,double> width_map;
+        mapnik::text_itemizer itemizer;
+        auto props = std::make_unique<mapnik::detail::evaluated_format_properties>();
+        props->fontset = fontset;
+        props->text_size = 32;
+        // latin and cyrillic in the serif face, tifinagh and hebrew only in
+        // the sans one and han in neither
+        auto ustr = tr.transcode(u8"ab (ⴰ) א 一");
+        itemizer.add_text(ustr, props);
+        mapnik::text_line line(0, ustr.length());
+        mapnik::harfbuzz_shaper::shape_text(line, itemizer, width_map, fm, 1.0);
+
+        std::map<unsigned, std::pair<unsigned, std::string>> glyphs;
+        for (auto const& g : line)
+        {
+            REQUIRE(g.face);
+            glyphs.emplace(g.char_index, std::make_pair(g.glyph_index, g.face->family_name()));
+        }
+        std::pair<unsigned, std::string> expected[] = {
+            { 68, "DejaVu Serif" }, { 69, "DejaVu Serif" }, { 3, "DejaVu Serif" }, { 11, "DejaVu Serif" },
+            { 4641, "DejaVu Sans" }, { 12, "DejaVu Serif" }
+        };
+        for (unsigned i = 0; i < 6; ++i)
+        {
+            INFO("char " << i);
+            REQUIRE(glyphs.count(i) == 1);
+            CHECK(glyphs[i] == expected[i]);
+        }
+        REQUIRE(glyphs.count(7) == 1);
+        CHECK(glyphs[7] == std::make_pair(1319u, std::string("DejaVu Sans")));
+        // characters no face covers keep the first face's missing glyph
+        REQUIRE(glyphs.count(9) == 1);
+        CHECK(glyphs[9] == std::make_pair(0u, std::string("DejaVu Serif")));
+    }
+}
@@ -0,0 +1,76 @@
+#include "catch.hpp"
+#include <mapnik/text/shaping_cache.hpp>
+
+namespace {
+
+mapnik::shaping_cache_key make_key(char const* str)
+{
+    mapnik::shaping_cache_key key;
+    key.text = icu::UnicodeString::fromUTF8(str);
+    key.first_char = 0;
+    key.last_char = key.text.length();
+    key.scale_factor = 1.0;
+    mapnik::shaping_format_run run;
+    run.start = 0;
+    run.end = key.last_char;
+    run.face_name = "DejaVu Sans Book";
+    run.text_size = 10.0;
+    key.runs.push_back(run);
+    return key;
+}
+
+mapnik::shaped_line_ptr make_line()
+{
+    auto line = std::make_shared<mapnik::shaped_line>();
+    line->faces.push_back("DejaVu Sans Book");
+    line->glyphs.push_back(mapnik::shaped_glyph { 42, 0, 0, 0.0, 10.0, 600.0, 1200.0, 0.01, {0.0, 0.0} });
+    return line;
+}
+
+}
+
+TEST_CASE("shaping_cache") {
+
+SECTION("disabled by default") {
+    mapnik::shaping_cache & cache = mapnik::shaping_cache::instance();
+    cache.set_capacity(0);
+    cache.clear();
+    REQUIRE(!cache.enabled());
+    cache.insert(make_key("Main Street"), make_line());
+    REQUIRE(cache.size() == 0);
+}
+
+SECTION("key covers format runs") {
+    mapnik::shaping_cache_key key0 = make_key("Main Street");
+    mapnik::shaping_cache_key key1 = make_key("Main Street");
+    REQUIRE(key0 == key1);
+    REQUIRE(mapnik::shaping_cache_key_hash()(key0) == mapnik::shaping_cache_key_hash()(key1));
+    key1.runs.front().text_size = 12.0;
+    REQUIRE(!(key0 == key1));
+    key1 = make_key("Main Street");
+    key1.last_char = 4;
+    REQUIRE(!(key0 == key1));
+}
+
+SECTION("lru eviction") {
+    mapnik::shaping_cache & cache = mapnik::shaping_cache::instance();
+    cache.clear();
+    cache.set_capacity(2);
+    cache.insert(make_key("Main Street"), make_line());
+    cache.insert(make_key("High Street"), make_line());
+    REQUIRE(cache.size() == 2);
+    // touch the first so that the second is evicted next
+    REQUIRE(cache.find(make_key("Main Street")));
+    cache.insert(make_key("Station Road"), make_line());
+    REQUIRE(cache.size() == 2);
+    CHECK(cache.find(make_key("Main Street")));
+    CHECK(!cache.find(make_key("High Street")));
+    CHECK(cache.find(make_key("Station Road")));
+    CHECK(cache.hits() == 3);
+    CHECK(cache.misses() == 1);
+    cache.set_capacity(0);
+    CHECK(cache.size() == 0);
+    cache.clear();
+}
+
+}
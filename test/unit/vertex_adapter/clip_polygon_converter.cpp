@@ -0,0 +1,124 @@
+#include "catch.hpp"
+
+#include <mapnik/clip_polygon_converter.hpp>
+#include <mapnik/vertex_adapters.hpp>
+#include <mapnik/geometry.hpp>
+
+#include <vector>
+
+namespace {
+
+struct output_ring
+{
+    std::vector<mapnik::geometry::point<double>> points;
+    bool closed = false;
+};
+
+template <typename Path>
+std::vector<output_ring> output(Path & path)
+{
+    std::vector<output_ring> rings;
+    double x, y;
+    unsigned cmd;
+    path.rewind(0);
+    while ((cmd = path.vertex(&x, &y)) != mapnik::SEG_END)
+    {
+        if (cmd == mapnik::SEG_MOVETO) rings.emplace_back();
+        if (cmd == mapnik::SEG_CLOSE) rings.back().closed = true;
+        else rings.back().points.emplace_back(x, y);
+    }
+    return rings;
+}
+
+mapnik::geometry::linear_ring<double> square(double x0, double y0, double x1, double y1)
+{
+    mapnik::geometry::linear_ring<double> ring;
+    ring.emplace_back(x0, y0);
+    ring.emplace_back(x1, y0);
+    ring.emplace_back(x1, y1);
+    ring.emplace_back(x0, y1);
+    ring.emplace_back(x0, y0);
+    return ring;
+}
+
+using clipper_type = mapnik::clip_polygon_converter<mapnik::geometry::polygon_vertex_adapter<double>>;
+
+}
+
+TEST_CASE("clip_polygon_converter") {
+
+SECTION("rings inside are passed on unchanged") {
+    mapnik::geometry::polygon<double> poly;
+    poly.push_back(square(1, 1, 9, 9));
+    poly.push_back(square(3, 3, 4, 4));
+    mapnik::geometry::polygon_vertex_adapter<double> va(poly);
+    clipper_type clipper(va);
+    clipper.clip_box(0, 0, 10, 10);
+    auto rings = output(clipper);
+    REQUIRE(rings.size() == 2);
+    REQUIRE(rings[0].points.size() == 4);
+    CHECK(rings[0].closed);
+    CHECK(rings[0].points[2].x == 9);
+    CHECK(rings[0].points[2].y == 9);
+    CHECK(rings[1].points.size() == 4);
+    // a second rewind gives the same output
+    CHECK(output(clipper).size() == 2);
+}
+
+SECTION("rings outside are dropped") {
+    mapnik::geometry::polygon<double> poly;
+    poly.push_back(square(-20, -20, 20, 20));
+    poly.push_back(square(12, 12, 14, 14));
+    mapnik::geometry::polygon_vertex_adapter<double> va(poly);
+    clipper_type clipper(va);
+    clipper.clip_box(0, 0, 10, 10);
+    auto rings = output(clipper);
+    // the exterior ring covering the box becomes the box
+    REQUIRE(rings.size() == 1);
+    REQUIRE(rings[0].points.size() == 4);
+    for (auto const& pt : rings[0].points)
+    {
+        CHECK((pt.x == 0 || pt.x == 10));
+        CHECK((pt.y == 0 || pt.y == 10));
+    }
+
+    mapnik::geometry::polygon<double> away;
+    away.push_back(square(20, 20, 30, 30));
+    mapnik::geometry::polygon_vertex_adapter<double> va_away(away);
+    clipper_type away_clipper(va_away);
+    away_clipper.clip_box(0, 0, 10, 10);
+    CHECK(output(away_clipper).empty());
+}
+
+SECTION("rings crossing the border are clipped") {
+    mapnik::geometry::polygon<double> poly;
+    mapnik::geometry::linear_ring<double> triangle;
+    triangle.emplace_back(5, 5);
+    triangle.emplace_back(15, 5);
+    triangle.emplace_back(5, 15);
+    triangle.emplace_back(5, 5);
+    poly.push_back(std::move(triangle));
+    mapnik::geometry::polygon_vertex_adapter<double> va(poly);
+    clipper_type clipper(va);
+    clipper.clip_box(0, 0, 10, 10);
+    auto rings = output(clipper);
+    REQUIRE(rings.size() == 1);
+    CHECK(rings[0].closed);
+    // (5 5), (10 5), (10 10), (5 10)
+    REQUIRE(rings[0].points.size() == 4);
+    double area = 0;
+    auto const& pts = rings[0].points;
+    for (std::size_t i = 0; i < pts.size(); ++i)
+    {
+        auto const& a = pts[i];
+        auto const& b = pts[(i + 1) % pts.size()];
+        area += a.x * b.y - b.x * a.y;
+        CHECK(a.x >= 5);
+        CHECK(a.x <= 10);
+        CHECK(a.y >= 5);
+        CHECK(a.y <= 10);
+    }
+    CHECK(area / 2 == Approx(25.0));
+}
+
+}
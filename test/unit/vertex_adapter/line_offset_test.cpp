@@ -145,3 +145,67 @@ SECTION("line") {
     }
 }
 }
+
+TEST_CASE("vertex_cache reuse") {
+
+SECTION("a reset cache walks the path and its offsets again") {
+    fake_path path = {0, 0, 10, 0, 10, 10, 20, 10};
+    mapnik::vertex_cache vc(path);
+    std::vector<mapnik::pixel_position> first, second;
+    for (auto * positions : { &first, &second })
+    {
+        vc.reset();
+        REQUIRE(vc.next_subpath());
+        REQUIRE(vc.length() == Approx(30.0));
+        while (vc.forward(1.5))
+        {
+            positions->push_back(vc.current_position());
+            mapnik::vertex_cache::scoped_state s(vc);
+            mapnik::vertex_cache & off_vc = vc.get_offseted(2.0, 3.0);
+            positions->push_back(off_vc.current_position());
+        }
+        CHECK(!vc.next_subpath());
+    }
+    REQUIRE(first.size() == second.size());
+    CHECK(first.size() > 20);
+    for (std::size_t i = 0; i < first.size(); ++i)
+    {
+        CHECK(first[i].x == second[i].x);
+        CHECK(first[i].y == second[i].y);
+    }
+}
+
+}
+
+TEST_CASE("vertex_cache seek") {
+
+SECTION("seeking a position matches walking there") {
+    fake_path path = {0, 0, 10, 0, 10, 10, 13, 14, 20, 14};
+    mapnik::vertex_cache walked(path), sought(path);
+    walked.reset(); REQUIRE(walked.next_subpath());
+    sought.reset(); REQUIRE(sought.next_subpath());
+    REQUIRE(sought.length() == Approx(32.0));
+    std::size_t count = 0;
+    while (walked.forward(0.7))
+    {
+        double pos = walked.linear_position();
+        REQUIRE(sought.seek(pos));
+        CHECK(sought.linear_position() == Approx(pos));
+        CHECK(sought.current_position().x == Approx(walked.current_position().x));
+        CHECK(sought.current_position().y == Approx(walked.current_position().y));
+        CHECK(sought.current_segment_angle() == Approx(walked.current_segment_angle()));
+        ++count;
+    }
+    CHECK(count == 45);
+    // seeking back and off the path
+    REQUIRE(sought.seek(5.0));
+    CHECK(sought.current_position().x == Approx(5.0));
+    CHECK(sought.current_position().y == Approx(0.0));
+    CHECK(!sought.seek(-1.0));
+    CHECK(!sought.seek(32.0));
+    CHECK(sought.linear_position() == Approx(5.0));
+    REQUIRE(sought.seek(0.0));
+    CHECK(sought.current_position().x == Approx(0.0));
+}
+
+}
@@ -114,4 +114,38 @@ SECTION("polygon closing - epsg 32633") {
     CHECK( y == 0 );
 }
 
+SECTION("pixel filter drops vertices within a cell") {
+    mapnik::geometry::line_string<double> line;
+    line.emplace_back(0.0, 0.0);
+    line.emplace_back(0.01, 0.01);
+    line.emplace_back(0.02, 0.03);
+    line.emplace_back(0.5, 0.5);
+    line.emplace_back(0.51, 0.52);
+    line.emplace_back(10.0, 10.0);
+
+    using va_type = mapnik::geometry::line_string_vertex_adapter<double>;
+    using path_type = mapnik::transform_path_adapter<mapnik::view_transform, va_type>;
+
+    va_type va(line);
+    // one unit per pixel
+    mapnik::box2d<double> extent(0, 0, 100, 100);
+    mapnik::view_transform tr(100, 100, extent);
+    mapnik::projection proj("+init=epsg:4326");
+    mapnik::proj_transform prj_trans(proj, proj);
+    path_type path(tr, va, prj_trans);
+
+    auto count = [&path]() {
+        double x, y;
+        unsigned n = 0;
+        path.rewind(0);
+        while (path.vertex(&x, &y) != mapnik::SEG_END) ++n;
+        return n;
+    };
+    CHECK(count() == 6);
+    path.set_pixel_filter(0.25);
+    CHECK(count() == 3);
+    path.set_pixel_filter(0.0);
+    CHECK(count() == 6);
+}
+
 }
@@ -0,0 +1,76 @@
+#include "catch.hpp"
+
+#include <mapnik/vertex_converters.hpp>
+#include <mapnik/vertex_adapters.hpp>
+#include <mapnik/view_transform.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/symbolizer.hpp>
+
+namespace {
+
+struct output_path
+{
+    template <typename Path>
+    void add_path(Path & path)
+    {
+        double x, y;
+        path.rewind(0);
+        unsigned cmd;
+        while ((cmd = path.vertex(&x, &y)) != mapnik::SEG_END)
+        {
+            if (cmd != mapnik::SEG_CLOSE) points.emplace_back(x, y);
+        }
+    }
+    std::vector<mapnik::geometry::point<double>> points;
+};
+
+using converter_type = mapnik::vertex_converter<mapnik::clip_line_tag, mapnik::transform_tag>;
+
+}
+
+TEST_CASE("vertex_converter") {
+
+SECTION("lines are clipped and rejected in layer coordinates - 4326 to 3857") {
+    mapnik::projection proj_3857("+init=epsg:3857");
+    mapnik::projection proj_4326("+init=epsg:4326");
+    // map in mercator, layer in lon/lat
+    mapnik::proj_transform prj_trans(proj_3857, proj_4326);
+    mapnik::box2d<double> extent(0, 0, 1000000, 1000000);
+    mapnik::view_transform tr(256, 256, extent);
+    mapnik::line_symbolizer sym;
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::feature_impl feature(ctx, 1);
+    agg::trans_affine affine;
+
+    converter_type converter(extent, sym, tr, prj_trans, affine, feature, mapnik::attributes(), 1.0);
+    converter.set<mapnik::transform_tag>();
+
+    mapnik::geometry::line_string<double> outside;
+    outside.emplace_back(100, 50);
+    outside.emplace_back(110, 55);
+    mapnik::geometry::line_string<double> crossing;
+    crossing.emplace_back(-10, 4.5);
+    crossing.emplace_back(20, 4.5);
+
+    // without clipping everything is kept
+    CHECK(!converter.clipped_away(outside));
+    converter.set<mapnik::clip_line_tag>();
+    CHECK(converter.is_set<mapnik::clip_line_tag>());
+    CHECK(converter.clipped_away(outside));
+    CHECK(!converter.clipped_away(crossing));
+
+    output_path out;
+    mapnik::geometry::line_string_vertex_adapter<double> va(crossing);
+    converter.apply(va, out);
+    REQUIRE(out.points.size() == 2);
+    CHECK(out.points[0].x == Approx(0.0));
+    CHECK(out.points[1].x == Approx(256.0));
+    CHECK(out.points[0].y == out.points[1].y);
+    CHECK(out.points[0].y > 0.0);
+    CHECK(out.points[0].y < 256.0);
+}
+
+}
@@ -20,14 +20,33 @@
  *
  *****************************************************************************/
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <iostream>
+#include <numeric>
+#include <mutex>
+#include <sstream>
+#include <system_error>
+#include <thread>
 #include <vector>
 #include <string>
 #include <fstream>
 #include <mapnik/version.hpp>
+#include <mapnik/feature.hpp>
+#include <mapnik/feature_factory.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/json/parse_feature.hpp>
+#include <mapnik/util/feature_store.hpp>
+#include <mapnik/util/file_io.hpp>
 #include <mapnik/util/fs.hpp>
 #include <mapnik/quad_tree.hpp>
+#include <mapnik/timer.hpp>
+#include <mapnik/util/packed_spatial_index.hpp>
 #include <mapnik/util/spatial_index.hpp>
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+#include <mapnik/mapped_memory_cache.hpp>
+#endif
 
 #include "process_csv_file.hpp"
 #include "process_geojson_file_x3.hpp"
@@ -55,22 +74,276 @@ bool is_geojson(std::string const& filename)
         || boost::iends_with(filename,".json");
 }
 
-}}
+// Parses every feature located by the bounding box pass into a
+// <file>.features store, ids follow the order of the source.
+template <typename Boxes>
+void write_geojson_feature_store(std::string const& filename, Boxes const& boxes,
+                                 mapnik::box2d<float> const& bbox, bool use_bbox, std::ostream & log)
+{
+    mapnik::util::file file(filename);
+    if (!file) throw std::runtime_error("could not open " + filename);
+    auto data = file.data();
+    if (!data) throw std::runtime_error("could not read " + filename);
+    mapnik::transcoder tr("utf8");
+    mapnik::context_ptr ctx = std::make_shared<mapnik::context_type>();
+    mapnik::util::write_feature_store(filename + ".features", [&](mapnik::util::feature_store_writer & writer)
+        {
+            mapnik::value_integer id = 1;
+            for (auto const& item : boxes)
+            {
+                mapnik::feature_ptr feature(mapnik::feature_factory::create(ctx, id++));
+                if (use_bbox && !bbox.intersects(std::get<0>(item))) continue;
+                char const* start = data.get() + std::get<1>(item).first;
+                char const* end = start + std::get<1>(item).second;
+                mapnik::json::parse_feature(start, end, *feature, tr);
+                writer.add(*feature);
+            }
+            log << "number features=" << writer.count() << std::endl;
+        });
+}
 
-int main (int argc, char** argv)
+// Rewrites filename with the located features in hilbert order of their
+// boxes and updates boxes to the new layout. What precedes the first and
+// follows the last feature of the file (headers, the end of the collection)
+// stays in place; features found in between without a box (no geometry)
+// follow the sorted ones.
+template <typename Boxes>
+void sort_file(std::string const& filename, Boxes & boxes, mapnik::box2d<float> const& extent, bool csv)
 {
-    //using namespace mapnik;
-    namespace po = boost::program_options;
-    bool verbose = false;
-    bool validate_features = false;
-    unsigned int depth = DEFAULT_DEPTH;
+    if (boxes.size() < 2) return;
+    std::string sorted_name = filename + ".sorted";
+    {
+        std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+        if (!in) throw std::runtime_error("could not open " + filename);
+        in.seekg(0, std::ios::end);
+        std::uint64_t file_size = static_cast<std::uint64_t>(in.tellg());
+        auto read = [&](std::uint64_t off, std::uint64_t size)
+        {
+            std::string bytes(static_cast<std::size_t>(size), '\0');
+            in.seekg(static_cast<std::streamoff>(off));
+            if (size > 0 && !in.read(&bytes[0], static_cast<std::streamsize>(size)))
+            {
+                throw std::runtime_error("could not read " + filename);
+            }
+            return bytes;
+        };
+        auto record_end = [](typename Boxes::value_type const& item)
+        {
+            return std::get<1>(item).first + std::get<1>(item).second;
+        };
+
+        std::vector<std::size_t> order(boxes.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&boxes](std::size_t lhs, std::size_t rhs)
+                  { return std::get<1>(boxes[lhs]).first < std::get<1>(boxes[rhs]).first; });
+        std::uint64_t first = std::get<1>(boxes[order.front()]).first;
+        std::uint64_t last = record_end(boxes[order.back()]);
+        // rows are separated by the file's newline, features by a comma
+        std::string separator = csv ? read(record_end(boxes[order.front()]), 1) : std::string(",\n");
+        std::vector<std::string> leftovers;
+        for (std::size_t i = 0; i + 1 < order.size(); ++i)
+        {
+            std::uint64_t end = record_end(boxes[order[i]]);
+            std::uint64_t next = std::get<1>(boxes[order[i + 1]]).first;
+            if (next <= end) continue;
+            std::string gap = read(end, next - end);
+            char const* blank = csv ? " \t\r\n" : " \t\r\n,";
+            auto begin = gap.find_first_not_of(blank);
+            if (begin == std::string::npos) continue;
+            leftovers.push_back(gap.substr(begin, gap.find_last_not_of(blank) + 1 - begin));
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&boxes, &extent](std::size_t lhs, std::size_t rhs)
+                         {
+                             return mapnik::util::packed_index::hilbert_code(std::get<0>(boxes[lhs]), extent)
+                                 < mapnik::util::packed_index::hilbert_code(std::get<0>(boxes[rhs]), extent);
+                         });
+        std::ofstream out(sorted_name.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!out) throw std::runtime_error("could not write " + sorted_name);
+        out.exceptions(std::ios::failbit | std::ios::badbit);
+        out << read(0, first);
+        std::uint64_t pos = first;
+        Boxes sorted;
+        sorted.reserve(boxes.size());
+        for (std::size_t i : order)
+        {
+            if (!sorted.empty())
+            {
+                out << separator;
+                pos += separator.size();
+            }
+            auto item = boxes[i];
+            out << read(std::get<1>(item).first, std::get<1>(item).second);
+            std::get<1>(item).first = pos;
+            pos += std::get<1>(item).second;
+            sorted.push_back(item);
+        }
+        for (auto const& leftover : leftovers)
+        {
+            out << separator << leftover;
+        }
+        out << read(last, file_size - last);
+        boxes = std::move(sorted);
+    }
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    // the file about to be replaced may be mapped
+    mapnik::mapped_memory_cache::instance().clear();
+#endif
+    if (std::rename(sorted_name.c_str(), filename.c_str()) != 0)
+    {
+        // windows does not rename over existing files
+        mapnik::util::remove(filename);
+        if (std::rename(sorted_name.c_str(), filename.c_str()) != 0)
+        {
+            throw std::runtime_error("could not replace " + filename + " by " + sorted_name);
+        }
+    }
+}
+
+struct index_options
+{
+    unsigned depth = DEFAULT_DEPTH;
     double ratio = DEFAULT_RATIO;
-    std::vector<std::string> files;
     char separator = 0;
     char quote = 0;
     std::string manual_headers;
     mapnik::box2d<float> bbox;
     bool use_bbox = false;
+    bool validate_features = false;
+    bool verbose = false;
+    bool packed = false;
+    bool features = false;
+    bool sort = false;
+    // threads available to one file
+    unsigned jobs = 1;
+};
+
+// Writes <file>.index (and <file>.features when asked for), messages go
+// to log so that files indexed in parallel don't interleave.
+bool index_file(std::string const& filename, index_options const& options, std::ostream & log)
+{
+    using box_type = mapnik::box2d<float>;
+    using item_type = std::pair<box_type, std::pair<std::uint64_t, std::uint64_t>>;
+
+    if (!mapnik::util::exists(filename))
+    {
+        log << "Error : file " << filename << " does not exist" << std::endl;
+        return true;
+    }
+
+    mapnik::timer timer;
+    std::vector<item_type> boxes;
+    box_type extent;
+    if (is_csv(filename))
+    {
+        auto result = process_csv_file(boxes, filename, options.manual_headers, options.separator, options.quote);
+        if (!result.first)
+        {
+            log << "Error: failed to process " << filename << std::endl;
+            return false;
+        }
+        extent = result.second;
+    }
+    else if (is_geojson(filename))
+    {
+        auto result = process_geojson_file_x3(boxes, filename, options.validate_features, options.verbose, options.jobs);
+        if (!result.first)
+        {
+            log << "Error: failed to process " << filename << std::endl;
+            return false;
+        }
+        extent = result.second;
+    }
+    log << "'" << filename << "': " << boxes.size() << " features located in "
+        << timer.wall_clock_elapsed() << "ms" << std::endl;
+
+    if (!extent.valid())
+    {
+        log << "Invalid extent " << extent << std::endl;
+        return false;
+    }
+    if (options.sort)
+    {
+        timer.restart();
+        try
+        {
+            sort_file(filename, boxes, extent, is_csv(filename));
+        }
+        catch (std::exception const& ex)
+        {
+            log << "Error: failed to sort " << filename << ": " << ex.what() << std::endl;
+            return false;
+        }
+        log << "'" << filename << "': features sorted in " << timer.wall_clock_elapsed() << "ms" << std::endl;
+    }
+    timer.restart();
+    auto const& bbox = options.bbox;
+    auto tree_extent = options.use_bbox ? bbox : extent;
+    log << tree_extent << std::endl;
+    mapnik::quad_tree<mapnik::util::index_record, mapnik::box2d<float>> tree(tree_extent, options.depth, options.ratio);
+    mapnik::util::packed_rtree<mapnik::util::index_record> packed_tree;
+    for (auto const& item : boxes)
+    {
+        auto ext_f = std::get<0>(item);
+        if (options.use_bbox && !bbox.intersects(ext_f)) continue;
+        mapnik::util::index_record rec =
+            {std::get<1>(item).first, std::get<1>(item).second, ext_f};
+        if (options.packed) packed_tree.insert(rec, ext_f);
+        else tree.insert(rec, ext_f);
+    }
+
+    std::fstream file((filename + ".index").c_str(),
+                      std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file)
+    {
+        log << "cannot open index file for writing file \""
+            << (filename + ".index") << "\"" << std::endl;
+    }
+    else
+    {
+        file.exceptions(std::ios::failbit | std::ios::badbit);
+        if (options.packed)
+        {
+            log << "number element=" << packed_tree.count_items() << std::endl;
+            packed_tree.write(file);
+        }
+        else
+        {
+            tree.trim();
+            log << "number nodes=" << tree.count() << std::endl;
+            log << "number element=" << tree.count_items() << std::endl;
+            tree.write(file);
+        }
+        file.flush();
+        file.close();
+    }
+    // a feature store written before sorting numbers the features in the old order
+    bool features = options.features || (options.sort && mapnik::util::exists(filename + ".features"));
+    if (features && is_geojson(filename))
+    {
+        try
+        {
+            write_geojson_feature_store(filename, boxes, bbox, options.use_bbox, log);
+        }
+        catch (std::exception const& ex)
+        {
+            log << "Error: failed to write " << filename << ".features: " << ex.what() << std::endl;
+            return false;
+        }
+    }
+    log << "'" << filename << "': index written in " << timer.wall_clock_elapsed() << "ms" << std::endl;
+    return true;
+}
+
+}}
+
+int main (int argc, char** argv)
+{
+    //using namespace mapnik;
+    namespace po = boost::program_options;
+    mapnik::detail::index_options options;
+    unsigned jobs = 1;
+    std::vector<std::string> files;
     po::variables_map vm;
     try
     {
@@ -87,6 +360,10 @@ int main (int argc, char** argv)
             ("files",po::value<std::vector<std::string> >(),"Files to index: file1 file2 ...fileN")
             ("validate-features", "Validate GeoJSON features")
             ("bbox,b", po::value<std::string>(), "Only index features within bounding box: --bbox=minx,miny,maxx,maxy")
+            ("packed", "Write a packed Hilbert R-tree index (not readable by older Mapnik versions)")
+            ("features", "Also write a <file>.features store of parsed GeoJSON features")
+            ("sort", "Rewrite the files with their features in Hilbert order before indexing, so that nearby features are stored together")
+            ("jobs,j", po::value<unsigned int>(), "Number of threads: files are indexed in parallel and GeoJSON features validated in parallel (default 1)")
             ;
 
         po::positional_options_description p;
@@ -110,39 +387,55 @@ int main (int argc, char** argv)
         }
         if (vm.count("verbose"))
         {
-            verbose = true;
+            options.verbose = true;
         }
         if (vm.count("validate-features"))
         {
-            validate_features = true;
+            options.validate_features = true;
+        }
+        if (vm.count("packed"))
+        {
+            options.packed = true;
+        }
+        if (vm.count("features"))
+        {
+            options.features = true;
+        }
+        if (vm.count("sort"))
+        {
+            options.sort = true;
         }
         if (vm.count("depth"))
         {
-            depth = vm["depth"].as<unsigned int>();
+            options.depth = vm["depth"].as<unsigned int>();
         }
         if (vm.count("ratio"))
         {
-            ratio = vm["ratio"].as<double>();
+            options.ratio = vm["ratio"].as<double>();
         }
         if (vm.count("separator"))
         {
-            separator = vm["separator"].as<char>();
+            options.separator = vm["separator"].as<char>();
         }
         if (vm.count("quote"))
         {
-            quote = vm["quote"].as<char>();
+            options.quote = vm["quote"].as<char>();
         }
         if (vm.count("manual-headers"))
         {
-            manual_headers = vm["manual-headers"].as<std::string>();
+            options.manual_headers = vm["manual-headers"].as<std::string>();
+        }
+        if (vm.count("jobs"))
+        {
+            jobs = std::max(1u, vm["jobs"].as<unsigned int>());
         }
         if (vm.count("files"))
         {
             files=vm["files"].as<std::vector<std::string> >();
         }
-        if (vm.count("bbox") && bbox.from_string(vm["bbox"].as<std::string>()))
+        if (vm.count("bbox") && options.bbox.from_string(vm["bbox"].as<std::string>()))
         {
-            use_bbox = true;
+            options.use_bbox = true;
         }
     }
     catch (std::exception const& ex)
@@ -172,84 +465,61 @@ int main (int argc, char** argv)
         return EXIT_FAILURE;
     }
 
-    std::clog << "max tree depth:" << depth << std::endl;
-    std::clog << "split ratio:" << ratio << std::endl;
+    std::clog << "max tree depth:" << options.depth << std::endl;
+    std::clog << "split ratio:" << options.ratio << std::endl;
 
-    using box_type = mapnik::box2d<float>;
-    using item_type = std::pair<box_type, std::pair<std::uint64_t, std::uint64_t>>;
+    // files are spread over the workers, threads left over go to
+    // validating the features of each file
+    std::size_t num_workers = std::min<std::size_t>(jobs, files_to_process.size());
+    options.jobs = std::max<unsigned>(1u, jobs / num_workers);
 
-    for (auto const& filename : files_to_process)
+    mapnik::timer timer;
+    std::mutex log_mutex;
+    std::atomic<std::size_t> next(0);
+    std::atomic<std::size_t> done(0);
+    std::atomic<bool> success(true);
+    auto worker = [&]()
     {
-        if (!mapnik::util::exists(filename))
-        {
-            std::clog << "Error : file " << filename << " does not exist" << std::endl;
-            continue;
-        }
-
-        std::vector<item_type> boxes;
-        box_type extent;
-        if (mapnik::detail::is_csv(filename))
-        {
-            std::clog << "processing '" << filename << "' as CSV\n";
-            auto result = mapnik::detail::process_csv_file(boxes, filename, manual_headers, separator, quote);
-            if (!result.first)
-            {
-                std::clog << "Error: failed to process " << filename << std::endl;
-                return EXIT_FAILURE;
-            }
-            extent = result.second;
-        }
-        else if (mapnik::detail::is_geojson(filename))
+        for (std::size_t i = next++; i < files_to_process.size() && success; i = next++)
         {
-            std::clog << "processing '" << filename << "' as GeoJSON\n";
-            std::pair<bool,mapnik::box2d<float>> result;
-            result = mapnik::detail::process_geojson_file_x3(boxes, filename, validate_features, verbose);
-            if (!result.first)
+            auto const& filename = files_to_process[i];
             {
-                std::clog << "Error: failed to process " << filename << std::endl;
-                return EXIT_FAILURE;
+                std::lock_guard<std::mutex> lock(log_mutex);
+                std::clog << "processing '" << filename << "' as "
+                          << (mapnik::detail::is_csv(filename) ? "CSV" : "GeoJSON") << "\n";
             }
-            extent = result.second;
-        }
-
-        if (extent.valid())
-        {
-            auto tree_extent = use_bbox ? bbox : extent;
-            std::clog << tree_extent << std::endl;
-            mapnik::quad_tree<mapnik::util::index_record, mapnik::box2d<float>> tree(tree_extent, depth, ratio);
-            for (auto const& item : boxes)
+            std::ostringstream log;
+            bool result = false;
+            try
             {
-                auto ext_f = std::get<0>(item);
-                if (use_bbox && !bbox.intersects(ext_f)) continue;
-                mapnik::util::index_record rec =
-                    {std::get<1>(item).first, std::get<1>(item).second, ext_f};
-                tree.insert(rec, ext_f);
+                result = mapnik::detail::index_file(filename, options, log);
             }
-
-            std::fstream file((filename + ".index").c_str(),
-                              std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
-            if (!file)
+            catch (std::exception const& ex)
             {
-                std::clog << "cannot open index file for writing file \""
-                          << (filename + ".index") << "\"" << std::endl;
-            }
-            else
-            {
-                tree.trim();
-                std::clog << "number nodes=" << tree.count() << std::endl;
-                std::clog << "number element=" << tree.count_items() << std::endl;
-                file.exceptions(std::ios::failbit | std::ios::badbit);
-                tree.write(file);
-                file.flush();
-                file.close();
+                log << "Error: failed to index " << filename << ": " << ex.what() << std::endl;
             }
+            if (!result) success = false;
+            std::lock_guard<std::mutex> lock(log_mutex);
+            std::clog << log.str();
+            std::clog << "[" << ++done << "/" << files_to_process.size() << "] done" << std::endl;
         }
-        else
+    };
+    std::vector<std::thread> workers;
+    try
+    {
+        for (std::size_t i = 1; i < num_workers; ++i)
         {
-            std::clog << "Invalid extent " << extent << std::endl;
-            return EXIT_FAILURE;
+            workers.emplace_back(worker);
         }
     }
+    catch (std::system_error const&)
+    {
+        // index the rest on this thread
+    }
+    worker();
+    for (auto & t : workers) t.join();
+    if (!success) return EXIT_FAILURE;
+    std::clog << "indexed " << files_to_process.size() << " file(s) in " << timer.wall_clock_elapsed() << "ms" << std::endl;
     std::clog << "done!" << std::endl;
     return EXIT_SUCCESS;
 }
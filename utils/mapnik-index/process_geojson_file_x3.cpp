@@ -40,6 +40,12 @@
 #include <mapnik/json/positions_grammar_x3.hpp>
 #include <mapnik/json/extract_bounding_boxes_x3.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
+#include <vector>
+
 namespace {
 
 constexpr mapnik::json::well_known_names feature_properties[] = {
@@ -212,19 +218,64 @@ bool validate_geojson_feature(mapnik::json::geojson_value & value, Keys const& k
     return true;
 };
 
+// Validates features [first, last) of boxes, giving up as soon as
+// another range failed. The grammar adds unknown keys to the keys map,
+// so every call gets its own.
+template <typename Boxes>
+bool validate_features_range(char const* start, Boxes const& boxes, std::size_t first, std::size_t last,
+                             std::atomic<bool> const& valid, bool verbose)
+{
+    using namespace boost::spirit;
+    using space_type = mapnik::json::grammar::space_type;
+    auto keys = mapnik::json::get_keys();
+    auto feature_grammar = x3::with<mapnik::json::grammar::keys_tag>(std::ref(keys))
+        [ mapnik::json::geojson_grammar() ];
+    for (std::size_t i = first; i < last && valid; ++i)
+    {
+        auto const& item = boxes[i];
+        if (!item.first.valid()) continue;
+        char const* feat_itr = start + item.second.first;
+        char const* feat_end = feat_itr + item.second.second;
+        mapnik::json::geojson_value feature_value;
+        try
+        {
+            bool result = x3::phrase_parse(feat_itr, feat_end, feature_grammar, space_type(), feature_value);
+            if (!result || feat_itr != feat_end)
+            {
+                if (verbose) std::clog << "Failed to parse: offset=" << item.second.first << " size=" << item.second.second << std::endl;
+                return false;
+            }
+        }
+        catch (x3::expectation_failure<std::string::const_iterator> const& ex)
+        {
+            if (verbose) std::clog << ex.what() << std::endl;
+            return false;
+        }
+        catch (...)
+        {
+            if (verbose) std::clog << "Failed to parse: offset=" << item.second.first << " size=" << item.second.second << std::endl;
+            return false;
+        }
+        if (!validate_geojson_feature(feature_value, keys, verbose))
+        {
+            if (verbose) std::clog << "Failed to validate: [" << std::string(start + item.second.first, feat_end ) << "]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
 using box_type = mapnik::box2d<float>;
 using boxes_type = std::vector<std::pair<box_type, std::pair<std::uint64_t, std::uint64_t>>>;
 using base_iterator_type = char const*;
 
-auto const& geojson_value = mapnik::json::geojson_grammar();
-
 }
 
 namespace mapnik { namespace detail {
 
 
 template <typename T>
-std::pair<bool,typename T::value_type::first_type> process_geojson_file_x3(T & boxes, std::string const& filename, bool validate_features, bool verbose)
+std::pair<bool,typename T::value_type::first_type> process_geojson_file_x3(T & boxes, std::string const& filename, bool validate_features, bool verbose, unsigned jobs)
 {
     using box_type = typename T::value_type::first_type;
     box_type extent;
@@ -274,47 +325,12 @@ std::pair<bool,typename T::value_type::first_type> process_geojson_file_x3(T & b
         return std::make_pair(false, extent);
     }
 
-    using namespace boost::spirit;
-    using space_type = mapnik::json::grammar::space_type;
-    auto keys = mapnik::json::get_keys();
-    auto feature_grammar = x3::with<mapnik::json::grammar::keys_tag>(std::ref(keys))
-        [ geojson_value ];
     for (auto const& item : boxes)
     {
         if (item.first.valid())
         {
             if (!extent.valid()) extent = item.first;
             else extent.expand_to_include(item.first);
-            if (validate_features)
-            {
-                base_iterator_type feat_itr = start + item.second.first;
-                base_iterator_type feat_end = feat_itr + item.second.second;
-                mapnik::json::geojson_value feature_value;
-                try
-                {
-                    bool result = x3::phrase_parse(feat_itr, feat_end, feature_grammar, space_type(), feature_value);
-                    if (!result || feat_itr != feat_end)
-                    {
-                        if (verbose) std::clog << "Failed to parse: offset=" << item.second.first << " size=" << item.second.second << std::endl;
-                        return std::make_pair(false, extent);
-                    }
-                }
-                catch (x3::expectation_failure<std::string::const_iterator> const& ex)
-                {
-                    if (verbose) std::clog << ex.what() << std::endl;
-                    return std::make_pair(false, extent);
-                }
-                catch (...)
-                {
-                    if (verbose) std::clog << "Failed to parse: offset=" << item.second.first << " size=" << item.second.second << std::endl;
-                    return std::make_pair(false, extent);
-                }
-                if (!validate_geojson_feature(feature_value, keys, verbose))
-                {
-                    if (verbose) std::clog << "Failed to validate: [" << std::string(start + item.second.first, feat_end ) << "]" << std::endl;
-                    return std::make_pair(false, extent);
-                }
-            }
         }
         else if (validate_features)
         {
@@ -322,9 +338,36 @@ std::pair<bool,typename T::value_type::first_type> process_geojson_file_x3(T & b
             return std::make_pair(false, extent);
         }
     }
+    if (validate_features)
+    {
+        std::size_t num_threads = std::max(1u, jobs);
+        std::size_t chunk = (boxes.size() + num_threads - 1) / num_threads;
+        std::atomic<bool> valid(true);
+        auto worker = [&](std::size_t first, std::size_t last)
+        {
+            if (!validate_features_range(start, boxes, first, last, valid, verbose)) valid = false;
+        };
+        std::vector<std::thread> workers;
+        std::size_t next = chunk;
+        try
+        {
+            for (; next < boxes.size(); next += chunk)
+            {
+                workers.emplace_back(worker, next, std::min(next + chunk, boxes.size()));
+            }
+        }
+        catch (std::system_error const&)
+        {
+            // validate the rest on this thread
+        }
+        worker(0, std::min(chunk, boxes.size()));
+        if (next < boxes.size()) worker(next, boxes.size());
+        for (auto & t : workers) t.join();
+        if (!valid) return std::make_pair(false, extent);
+    }
     return std::make_pair(true, extent);
 }
 
-template std::pair<bool,box_type> process_geojson_file_x3(boxes_type&, std::string const&, bool, bool);
+template std::pair<bool,box_type> process_geojson_file_x3(boxes_type&, std::string const&, bool, bool, unsigned);
 
 }}
@@ -28,8 +28,9 @@
 
 namespace mapnik { namespace detail {
 
+// Feature validation is spread over `jobs` threads.
 template <typename T>
-std::pair<bool, typename T::value_type::first_type> process_geojson_file_x3(T & boxes, std::string const& filename, bool validate_features, bool verbose);
+std::pair<bool, typename T::value_type::first_type> process_geojson_file_x3(T & boxes, std::string const& filename, bool validate_features, bool verbose, unsigned jobs = 1);
 
 }}
 
@@ -19,7 +19,9 @@ if env['HAS_CAIRO']:
     program_env.Append(CPPDEFINES = '-DHAVE_CAIRO')
 
 boost_program_options = 'boost_program_options%s' % env['BOOST_APPEND']
-libraries = [env['MAPNIK_NAME'],boost_program_options]
+boost_filesystem = 'boost_filesystem%s' % env['BOOST_APPEND']
+boost_system = 'boost_system%s' % env['BOOST_APPEND']
+libraries = [env['MAPNIK_NAME'],boost_program_options,boost_filesystem,boost_system]
 libraries.extend(copy(env['LIBMAPNIK_LIBS']))
 if env['RUNTIME_LINK'] == 'static' and env['PLATFORM'] == 'Linux':
     libraries.append('dl')
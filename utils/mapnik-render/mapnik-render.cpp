@@ -7,14 +7,177 @@
 #include <mapnik/unicode.hpp>
 #include <mapnik/datasource_cache.hpp>
 #include <mapnik/font_engine_freetype.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/well_known_srs.hpp>
+#include <mapnik/timer.hpp>
 
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/program_options.hpp>
+#include <boost/filesystem/convenience.hpp>
 #pragma GCC diagnostic pop
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// A tile of the batch mode: an extent in the map srs and the path it is
+// written to, relative to the output directory.
+struct tile_job
+{
+    mapnik::box2d<double> extent;
+    std::string name;
+    // whether the extent is spherical mercator rather than in the map srs
+    bool mercator;
+};
+
+// z/x/y of the spherical mercator tile grid, y counted from the top
+mapnik::box2d<double> tile_extent(unsigned z, unsigned x, unsigned y)
+{
+    double size = mapnik::EARTH_CIRCUMFERENCE / (1u << z);
+    double minx = -mapnik::MAXEXTENT + x * size;
+    double maxy = mapnik::MAXEXTENT - y * size;
+    return mapnik::box2d<double>(minx, maxy - size, minx + size, maxy);
+}
+
+// Appends the tile of a line: "z/x/y" (or "z x y") or "minx,miny,maxx,maxy"
+// in the map srs. Empty lines and lines starting with '#' are skipped.
+bool parse_tile(std::string line, std::size_t index, std::string const& extension,
+                std::vector<tile_job> & jobs)
+{
+    boost::algorithm::trim(line);
+    if (line.empty() || line[0] == '#') return true;
+    if (line.find(',') != std::string::npos)
+    {
+        mapnik::box2d<double> box;
+        if (!box.from_string(line)) return false;
+        jobs.push_back(tile_job{box, "bbox-" + std::to_string(index) + "." + extension, false});
+        return true;
+    }
+    std::replace(line.begin(), line.end(), '/', ' ');
+    std::istringstream s(line);
+    unsigned z, x, y;
+    if (!(s >> z >> x >> y) || z > 30 || x >= (1u << z) || y >= (1u << z)) return false;
+    jobs.push_back(tile_job{tile_extent(z, x, y),
+                            std::to_string(z) + "/" + std::to_string(x) + "/" + std::to_string(y) + "." + extension,
+                            true});
+    return true;
+}
+
+// "z/x0-x1/y0-y1", both ranges inclusive
+bool parse_range(std::string range, std::string const& extension, std::vector<tile_job> & jobs)
+{
+    std::replace(range.begin(), range.end(), '/', ' ');
+    std::replace(range.begin(), range.end(), '-', ' ');
+    std::istringstream s(range);
+    unsigned z, x0, x1, y0, y1;
+    if (!(s >> z >> x0 >> x1 >> y0 >> y1) || z > 30 ||
+        x0 > x1 || y0 > y1 || x1 >= (1u << z) || y1 >= (1u << z)) return false;
+    for (unsigned x = x0; x <= x1; ++x)
+    {
+        for (unsigned y = y0; y <= y1; ++y)
+        {
+            std::ostringstream line;
+            line << z << '/' << x << '/' << y;
+            parse_tile(line.str(), jobs.size(), extension, jobs);
+        }
+    }
+    return true;
+}
+
+// Renders the jobs over num_threads threads sharing the map. Tiles are
+// written below directory, or encoded and dropped when it is empty.
+// Returns the number of tiles that failed.
+std::size_t render_tiles(mapnik::Map const& map, mapnik::attributes const& vars,
+                         std::vector<tile_job> const& jobs, unsigned tile_size,
+                         double scale_factor, std::string const& format,
+                         std::string const& directory, unsigned num_threads, bool verbose)
+{
+    mapnik::timer timer;
+    std::mutex log_mutex;
+    std::atomic<std::size_t> next(0);
+    std::atomic<std::size_t> failed(0);
+    std::vector<double> elapsed(jobs.size(), 0.0);
+    auto worker = [&]()
+    {
+        mapnik::image_rgba8 im(tile_size, tile_size);
+        for (std::size_t i = next++; i < jobs.size(); i = next++)
+        {
+            tile_job const& job = jobs[i];
+            mapnik::timer tile_timer;
+            try
+            {
+                mapnik::request req(tile_size, tile_size, job.extent);
+                req.set_buffer_size(map.buffer_size());
+                im.set(0);
+                mapnik::agg_renderer<mapnik::image_rgba8> ren(map, req, vars, im, scale_factor, 0, 0);
+                ren.apply();
+                if (directory.empty())
+                {
+                    mapnik::save_to_string(im, format);
+                }
+                else
+                {
+                    boost::filesystem::path path(directory + "/" + job.name);
+                    boost::filesystem::create_directories(path.parent_path());
+                    mapnik::save_to_file(im, path.string(), format);
+                }
+            }
+            catch (std::exception const& ex)
+            {
+                ++failed;
+                std::lock_guard<std::mutex> lock(log_mutex);
+                std::clog << "Error rendering " << job.name << ": " << ex.what() << std::endl;
+            }
+            elapsed[i] = tile_timer.wall_clock_elapsed();
+            if (verbose)
+            {
+                std::lock_guard<std::mutex> lock(log_mutex);
+                std::clog << job.name << " " << elapsed[i] << "ms" << std::endl;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    try
+    {
+        for (unsigned i = 1; i < num_threads; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+    }
+    catch (std::system_error const&)
+    {
+        // render the rest on this thread
+    }
+    worker();
+    for (auto & t : workers) t.join();
+
+    double total = timer.wall_clock_elapsed();
+    std::sort(elapsed.begin(), elapsed.end());
+    auto percentile = [&](double p) {
+        return elapsed.empty() ? 0.0 : elapsed[std::min(elapsed.size() - 1, std::size_t(p * elapsed.size()))];
+    };
+    std::clog << "rendered " << jobs.size() << " tile(s) on " << (workers.size() + 1) << " thread(s) in "
+              << total << "ms: " << (total > 0 ? jobs.size() * 1000.0 / total : 0.0) << " tiles/s, "
+              << "p50 " << percentile(0.5) << "ms, p95 " << percentile(0.95) << "ms, max "
+              << percentile(1.0) << "ms";
+    if (failed > 0) std::clog << ", " << failed << " failed";
+    std::clog << std::endl;
+    return failed;
+}
+
+}
 
 int main (int argc,char** argv)
 {
@@ -42,6 +205,12 @@ int main (int argc,char** argv)
             ("img",po::value<std::string>(),"image to render")
             ("scale-factor",po::value<double>(),"scale factor for rendering")
             ("variables","make map parameters available as render-time variables")
+            ("tiles",po::value<std::string>(),"batch mode: file listing tiles to render, one z/x/y or minx,miny,maxx,maxy per line, - for stdin")
+            ("range",po::value<std::string>(),"batch mode: spherical mercator tiles z/x0-x1/y0-y1 to render")
+            ("output",po::value<std::string>(),"batch mode: directory to write tiles to, tiles are encoded and dropped without it")
+            ("format",po::value<std::string>()->default_value("png"),"batch mode: image format of the tiles")
+            ("tile-size",po::value<unsigned>()->default_value(256),"batch mode: width and height of the tiles")
+            ("threads,j",po::value<unsigned>()->default_value(1),"batch mode: number of threads rendering tiles, sharing the map")
             ;
 
         po::positional_options_description p;
@@ -83,11 +252,45 @@ int main (int argc,char** argv)
             return -1;
         }
 
+        bool batch = vm.count("tiles") || vm.count("range");
+        std::string format = vm["format"].as<std::string>();
+        std::string extension = format.substr(0, format.find_first_of(":0123456789"));
+        std::vector<tile_job> jobs;
+        if (vm.count("tiles"))
+        {
+            std::string tiles = vm["tiles"].as<std::string>();
+            std::ifstream file;
+            if (tiles != "-")
+            {
+                file.open(tiles);
+                if (!file)
+                {
+                    std::clog << "could not open tile list " << tiles << std::endl;
+                    return -1;
+                }
+            }
+            std::istream & in = (tiles == "-") ? std::cin : file;
+            std::string line;
+            for (std::size_t index = 0; std::getline(in, line); ++index)
+            {
+                if (!parse_tile(line, index, extension, jobs))
+                {
+                    std::clog << "invalid tile on line " << (index + 1) << ": " << line << std::endl;
+                    return -1;
+                }
+            }
+        }
+        if (vm.count("range") && !parse_range(vm["range"].as<std::string>(), extension, jobs))
+        {
+            std::clog << "invalid tile range, expected z/x0-x1/y0-y1" << std::endl;
+            return -1;
+        }
+
         if (vm.count("img"))
         {
             img_file=vm["img"].as<std::string>();
         }
-        else
+        else if (!batch)
         {
             std::clog << "please provide an img as second argument!" << std::endl;
             return -1;
@@ -107,10 +310,6 @@ int main (int argc,char** argv)
         mapnik::freetype_engine::register_fonts("./fonts",true);
         mapnik::Map map(600,400);
         mapnik::load_map(map,xml_file,true);
-        map.zoom_all();
-        mapnik::image_rgba8 im(map.width(),map.height());
-        mapnik::request req(map.width(),map.height(),map.get_current_extent());
-        req.set_buffer_size(map.buffer_size());
         mapnik::attributes vars;
         if (params_as_variables)
         {
@@ -135,6 +334,29 @@ int main (int argc,char** argv)
                 }
             }
         }
+        if (batch)
+        {
+            // z/x/y tiles are spherical mercator extents
+            mapnik::projection merc(mapnik::MAPNIK_GMERC_PROJ);
+            mapnik::projection dest(map.srs());
+            mapnik::proj_transform prj_trans(merc, dest);
+            for (auto & job : jobs)
+            {
+                if (job.mercator && !prj_trans.equal())
+                {
+                    prj_trans.forward(job.extent, 16);
+                }
+            }
+            std::string directory = vm.count("output") ? vm["output"].as<std::string>() : std::string();
+            unsigned num_threads = std::max(1u, vm["threads"].as<unsigned>());
+            std::size_t failed = render_tiles(map, vars, jobs, vm["tile-size"].as<unsigned>(), scale_factor,
+                                              format, directory, num_threads, verbose);
+            return failed > 0 ? -1 : 0;
+        }
+        map.zoom_all();
+        mapnik::image_rgba8 im(map.width(),map.height());
+        mapnik::request req(map.width(),map.height(),map.get_current_extent());
+        req.set_buffer_size(map.buffer_size());
         mapnik::agg_renderer<mapnik::image_rgba8> ren(map,req,vars,im,scale_factor,0,0);
         ren.apply();
         mapnik::save_to_file(im,img_file);
@@ -0,0 +1,36 @@
+import os
+import glob
+from copy import copy
+
+Import ('env')
+program_env = env.Clone()
+
+source = Split(
+    """
+    mapnik-style-profile.cpp
+    """
+    )
+
+program_env['CXXFLAGS'] = copy(env['LIBMAPNIK_CXXFLAGS'])
+program_env.Append(CPPDEFINES = env['LIBMAPNIK_DEFINES'])
+
+if env['HAS_CAIRO']:
+    program_env.PrependUnique(CPPPATH=env['CAIRO_CPPPATHS'])
+    program_env.Append(CPPDEFINES = '-DHAVE_CAIRO')
+
+boost_program_options = 'boost_program_options%s' % env['BOOST_APPEND']
+boost_filesystem = 'boost_filesystem%s' % env['BOOST_APPEND']
+boost_system = 'boost_system%s' % env['BOOST_APPEND']
+libraries = [env['MAPNIK_NAME'],boost_program_options,boost_filesystem,boost_system]
+libraries.extend(copy(env['LIBMAPNIK_LIBS']))
+if env['RUNTIME_LINK'] == 'static' and env['PLATFORM'] == 'Linux':
+    libraries.append('dl')
+
+mapnik_style_profile = program_env.Program('mapnik-style-profile', source, LIBS=libraries)
+Depends(mapnik_style_profile, env.subst('../../src/%s' % env['MAPNIK_LIB_NAME']))
+
+if 'uninstall' not in COMMAND_LINE_TARGETS:
+    env.Install(os.path.join(env['INSTALL_PREFIX'],'bin'), mapnik_style_profile)
+    env.Alias('install', os.path.join(env['INSTALL_PREFIX'],'bin'))
+
+env['create_uninstall_target'](env, os.path.join(env['INSTALL_PREFIX'],'bin','mapnik-style-profile'))
@@ -0,0 +1,392 @@
+#include <mapnik/map.hpp>
+#include <mapnik/load_map.hpp>
+#include <mapnik/agg_renderer.hpp>
+#include <mapnik/render_stats.hpp>
+#include <mapnik/version.hpp>
+#include <mapnik/debug.hpp>
+#include <mapnik/unicode.hpp>
+#include <mapnik/datasource_cache.hpp>
+#include <mapnik/font_engine_freetype.hpp>
+#include <mapnik/projection.hpp>
+#include <mapnik/proj_transform.hpp>
+#include <mapnik/well_known_srs.hpp>
+
+#pragma GCC diagnostic push
+#include <mapnik/warning_ignore.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+#pragma GCC diagnostic pop
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct tile_job
+{
+    unsigned z, x, y;
+};
+
+// z/x/y of the spherical mercator tile grid, y counted from the top
+mapnik::box2d<double> tile_extent(unsigned z, unsigned x, unsigned y)
+{
+    double size = mapnik::EARTH_CIRCUMFERENCE / (1u << z);
+    double minx = -mapnik::MAXEXTENT + x * size;
+    double maxy = mapnik::MAXEXTENT - y * size;
+    return mapnik::box2d<double>(minx, maxy - size, minx + size, maxy);
+}
+
+// Appends the tile of a "z/x/y" (or "z x y") line. Empty lines and lines
+// starting with '#' are skipped.
+bool parse_tile(std::string line, std::vector<tile_job> & jobs)
+{
+    boost::algorithm::trim(line);
+    if (line.empty() || line[0] == '#') return true;
+    std::replace(line.begin(), line.end(), '/', ' ');
+    std::istringstream s(line);
+    unsigned z, x, y;
+    if (!(s >> z >> x >> y) || z > 30 || x >= (1u << z) || y >= (1u << z)) return false;
+    jobs.push_back(tile_job{z, x, y});
+    return true;
+}
+
+// "z" or "z0-z1", inclusive
+bool parse_zooms(std::string range, unsigned & z0, unsigned & z1)
+{
+    std::replace(range.begin(), range.end(), '-', ' ');
+    std::istringstream s(range);
+    if (!(s >> z0)) return false;
+    if (!(s >> z1)) z1 = z0;
+    return z0 <= z1 && z1 <= 30;
+}
+
+// Up to count distinct tiles of zoom z drawn at random from those
+// covering extent, all of them when there are no more.
+void sample_tiles(mapnik::box2d<double> const& extent, unsigned z, unsigned count,
+                  std::mt19937 & rng, std::vector<tile_job> & jobs)
+{
+    double size = mapnik::EARTH_CIRCUMFERENCE / (1u << z);
+    double last = (1u << z) - 1;
+    auto clamp = [last](double v) { return static_cast<unsigned>(std::min(last, std::max(0.0, std::floor(v)))); };
+    unsigned x0 = clamp((extent.minx() + mapnik::MAXEXTENT) / size);
+    unsigned x1 = clamp((extent.maxx() + mapnik::MAXEXTENT) / size);
+    unsigned y0 = clamp((mapnik::MAXEXTENT - extent.maxy()) / size);
+    unsigned y1 = clamp((mapnik::MAXEXTENT - extent.miny()) / size);
+    double available = (x1 - x0 + 1.0) * (y1 - y0 + 1.0);
+    if (available <= count)
+    {
+        for (unsigned x = x0; x <= x1; ++x)
+        {
+            for (unsigned y = y0; y <= y1; ++y) jobs.push_back(tile_job{z, x, y});
+        }
+        return;
+    }
+    std::uniform_int_distribution<unsigned> pick_x(x0, x1);
+    std::uniform_int_distribution<unsigned> pick_y(y0, y1);
+    std::set<std::pair<unsigned, unsigned>> picked;
+    while (picked.size() < count)
+    {
+        auto tile = std::make_pair(pick_x(rng), pick_y(rng));
+        if (picked.insert(tile).second) jobs.push_back(tile_job{z, tile.first, tile.second});
+    }
+}
+
+struct cost
+{
+    double ms = 0.0;
+    // features for layers, styles and rules, calls for symbolizers
+    std::size_t count = 0;
+    std::size_t vertices = 0;
+};
+
+using cost_table = std::map<std::string, cost>;
+
+struct zoom_report
+{
+    std::size_t tiles = 0;
+    double ms = 0.0;
+    cost_table layers;
+    cost_table styles;
+    cost_table rules;
+    cost_table symbolizers;
+};
+
+double to_ms(mapnik::render_stats::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void add(cost & c, double ms, std::size_t count, std::size_t vertices)
+{
+    c.ms += ms;
+    c.count += count;
+    c.vertices += vertices;
+}
+
+// Adds the costs of a render to the report of its zoom level.
+void accumulate(mapnik::render_stats const& stats, zoom_report & report)
+{
+    ++report.tiles;
+    report.ms += to_ms(stats.total);
+    for (auto const& lay : stats.layers)
+    {
+        std::size_t layer_features = 0;
+        std::size_t layer_vertices = 0;
+        for (auto const& style : lay.styles)
+        {
+            std::string style_name = lay.name + " / " + style.name;
+            double style_ms = to_ms(style.fetch + style.filter + style.labels + style.compositing);
+            for (auto const& sym : style.symbolizers) style_ms += to_ms(sym.second.time);
+            add(report.styles[style_name], style_ms, style.features, style.vertices);
+            layer_features += style.features;
+            layer_vertices += style.vertices;
+            for (std::size_t i = 0; i < style.rules.size(); ++i)
+            {
+                auto const& rule = style.rules[i];
+                if (rule.features == 0) continue;
+                std::string rule_name = style_name + " / rule " + std::to_string(i + 1);
+                if (!rule.name.empty()) rule_name += " '" + rule.name + "'";
+                add(report.rules[rule_name], to_ms(rule.time), rule.features, rule.vertices);
+                for (std::size_t k = 0; k < rule.symbolizers.size(); ++k)
+                {
+                    auto const& sym = rule.symbolizers[k];
+                    if (sym.second.count == 0) continue;
+                    std::string sym_name = rule_name + " / " + sym.first + " " + std::to_string(k + 1);
+                    add(report.symbolizers[sym_name], to_ms(sym.second.time), sym.second.count, 0);
+                }
+            }
+        }
+        add(report.layers[lay.name], to_ms(lay.query + lay.render + lay.compositing),
+            layer_features, layer_vertices);
+    }
+}
+
+void print_table(std::string const& title, char const* count_name, cost_table const& table,
+                 double total_ms, std::size_t tiles, std::size_t top)
+{
+    std::vector<std::pair<std::string, cost>> rows(table.begin(), table.end());
+    std::stable_sort(rows.begin(), rows.end(),
+                     [](std::pair<std::string, cost> const& lhs, std::pair<std::string, cost> const& rhs)
+                     { return lhs.second.ms > rhs.second.ms; });
+    if (top > 0 && rows.size() > top) rows.resize(top);
+    std::cout << "  " << title << "\n"
+              << "    " << std::setw(12) << "ms/tile" << std::setw(8) << "share"
+              << std::setw(12) << count_name << std::setw(14) << "vertices" << "  name\n";
+    for (auto const& row : rows)
+    {
+        cost const& c = row.second;
+        std::cout << "    " << std::fixed << std::setprecision(3) << std::setw(12) << c.ms / tiles
+                  << std::setprecision(1) << std::setw(7) << (total_ms > 0 ? 100.0 * c.ms / total_ms : 0.0) << "%"
+                  << std::setw(12) << c.count << std::setw(14) << c.vertices
+                  << "  " << row.first << "\n";
+    }
+}
+
+}
+
+int main (int argc,char** argv)
+{
+    namespace po = boost::program_options;
+
+    std::string xml_file;
+    double scale_factor = 1;
+    bool params_as_variables = false;
+    mapnik::logger logger;
+    logger.set_severity(mapnik::logger::error);
+
+    try
+    {
+        po::options_description desc("mapnik-style-profile utility");
+        desc.add_options()
+            ("help,h", "produce usage message")
+            ("version,V","print version string")
+            ("verbose,v","print the time of every tile")
+            ("xml",po::value<std::string>(),"xml map to profile")
+            ("zoom,z",po::value<std::string>(),"zoom level z or range z0-z1 to sample tiles of")
+            ("samples,n",po::value<unsigned>()->default_value(20),"number of tiles sampled per zoom level")
+            ("seed",po::value<unsigned>()->default_value(0),"seed of the tile sampling")
+            ("tiles",po::value<std::string>(),"file listing tiles to render, one z/x/y per line, - for stdin")
+            ("tile-size",po::value<unsigned>()->default_value(256),"width and height of the tiles")
+            ("scale-factor",po::value<double>(),"scale factor for rendering")
+            ("variables","make map parameters available as render-time variables")
+            ("top",po::value<std::size_t>()->default_value(20),"rows reported per table, 0 for all")
+            ;
+
+        po::positional_options_description p;
+        p.add("xml",1);
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(p).run(), vm);
+        po::notify(vm);
+
+        if (vm.count("version"))
+        {
+            std::clog <<"version " << MAPNIK_VERSION_STRING << std::endl;
+            return 1;
+        }
+
+        if (vm.count("help"))
+        {
+            std::clog << desc << std::endl;
+            return 1;
+        }
+
+        bool verbose = vm.count("verbose") > 0;
+
+        if (vm.count("xml"))
+        {
+            xml_file=vm["xml"].as<std::string>();
+        }
+        else
+        {
+            std::clog << "please provide an xml map as first argument!" << std::endl;
+            return -1;
+        }
+
+        std::vector<tile_job> jobs;
+        if (vm.count("tiles"))
+        {
+            std::string tiles = vm["tiles"].as<std::string>();
+            std::ifstream file;
+            if (tiles != "-")
+            {
+                file.open(tiles);
+                if (!file)
+                {
+                    std::clog << "could not open tile list " << tiles << std::endl;
+                    return -1;
+                }
+            }
+            std::istream & in = (tiles == "-") ? std::cin : file;
+            std::string line;
+            for (std::size_t index = 0; std::getline(in, line); ++index)
+            {
+                if (!parse_tile(line, jobs))
+                {
+                    std::clog << "invalid tile on line " << (index + 1) << ": " << line << std::endl;
+                    return -1;
+                }
+            }
+        }
+        unsigned z0 = 0, z1 = 0;
+        bool sample = vm.count("zoom") > 0;
+        if (sample && !parse_zooms(vm["zoom"].as<std::string>(), z0, z1))
+        {
+            std::clog << "invalid zoom, expected z or z0-z1" << std::endl;
+            return -1;
+        }
+        if (!sample && jobs.empty())
+        {
+            std::clog << "please provide --zoom or --tiles" << std::endl;
+            return -1;
+        }
+
+        if (vm.count("scale-factor"))
+        {
+            scale_factor=vm["scale-factor"].as<double>();
+        }
+
+        if (vm.count("variables"))
+        {
+            params_as_variables = true;
+        }
+
+        mapnik::datasource_cache::instance().register_datasources("./plugins/input/");
+        mapnik::freetype_engine::register_fonts("./fonts",true);
+        mapnik::Map map(600,400);
+        mapnik::load_map(map,xml_file,true);
+        mapnik::attributes vars;
+        if (params_as_variables)
+        {
+            mapnik::transcoder tr("utf-8");
+            for (auto const& param : map.get_extra_parameters())
+            {
+                std::string const& name = param.first.substr(1);
+                if (!name.empty())
+                {
+                    if (param.second.is<mapnik::value_integer>())
+                    {
+                        vars[name] = param.second.get<mapnik::value_integer>();
+                    }
+                    else if (param.second.is<mapnik::value_double>())
+                    {
+                        vars[name] = param.second.get<mapnik::value_double>();
+                    }
+                    else if (param.second.is<std::string>())
+                    {
+                        vars[name] = tr.transcode(param.second.get<std::string>().c_str());
+                    }
+                }
+            }
+        }
+
+        // z/x/y tiles are spherical mercator extents
+        mapnik::projection merc(mapnik::MAPNIK_GMERC_PROJ);
+        mapnik::projection dest(map.srs());
+        mapnik::proj_transform prj_trans(merc, dest);
+        if (sample)
+        {
+            // tiles are drawn from those covering the map's data
+            map.zoom_all();
+            mapnik::box2d<double> extent = map.get_current_extent();
+            if (!prj_trans.equal()) prj_trans.backward(extent, 16);
+            std::mt19937 rng(vm["seed"].as<unsigned>());
+            for (unsigned z = z0; z <= z1; ++z)
+            {
+                sample_tiles(extent, z, vm["samples"].as<unsigned>(), rng, jobs);
+            }
+        }
+
+        unsigned tile_size = vm["tile-size"].as<unsigned>();
+        mapnik::image_rgba8 im(tile_size, tile_size);
+        mapnik::render_stats stats;
+        std::map<unsigned, zoom_report> reports;
+        for (tile_job const& job : jobs)
+        {
+            mapnik::box2d<double> extent = tile_extent(job.z, job.x, job.y);
+            if (!prj_trans.equal()) prj_trans.forward(extent, 16);
+            mapnik::request req(tile_size, tile_size, extent);
+            req.set_buffer_size(map.buffer_size());
+            im.set(0);
+            stats.clear();
+            mapnik::agg_renderer<mapnik::image_rgba8> ren(map, req, vars, im, scale_factor, 0, 0);
+            ren.set_stats(&stats);
+            ren.apply();
+            accumulate(stats, reports[job.z]);
+            if (verbose)
+            {
+                std::clog << job.z << "/" << job.x << "/" << job.y << " "
+                          << to_ms(stats.total) << "ms" << std::endl;
+            }
+        }
+
+        std::size_t top = vm["top"].as<std::size_t>();
+        for (auto const& entry : reports)
+        {
+            zoom_report const& report = entry.second;
+            std::cout << "zoom " << entry.first << ": " << report.tiles << " tile(s), "
+                      << std::fixed << std::setprecision(3) << report.ms / report.tiles << "ms/tile\n";
+            print_table("layers", "features", report.layers, report.ms, report.tiles, top);
+            print_table("styles", "features", report.styles, report.ms, report.tiles, top);
+            print_table("rules", "features", report.rules, report.ms, report.tiles, top);
+            print_table("symbolizers", "calls", report.symbolizers, report.ms, report.tiles, top);
+            std::cout << std::endl;
+        }
+    }
+    catch (std::exception const& ex)
+    {
+        std::clog << "Error " << ex.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -23,7 +23,6 @@
 // mapnik
 #include "pgsql2sqlite.hpp"
 #include <mapnik/datasource.hpp>
-#include <mapnik/wkb.hpp>
 #include "connection_manager.hpp"
 
 #pragma GCC diagnostic push
@@ -36,15 +35,16 @@
 
 //stl
 #include <iostream>
-#include <fstream>
 #include <exception>
+#include <vector>
 
 int main ( int argc, char** argv)
 {
 
     namespace po = boost::program_options;
     po::options_description desc("Postgresql/PostGIS to SQLite3 converter\n Options");
-    std::string usage = "usage: pgsql2sqlite --dbname db --table planet_osm_line --file osm.sqlite --query \"select * from planet_osm_line\"";
+    std::string usage = "usage: pgsql2sqlite --dbname db --table planet_osm_line --file osm.sqlite --query \"select * from planet_osm_line\"\n"
+        "       pgsql2sqlite --dbname db --file osm.sqlite --jobs 2 --query planet_osm_line --query planet_osm_polygon";
     try
     {
 
@@ -55,9 +55,10 @@ int main ( int argc, char** argv)
             ("user,u",po::value<std::string>(),"Connect to the database as the specified user.")
             ("dbname,d",po::value<std::string>(),"postgresql database name")
             ("password,P",po::value<std::string>(),"Connect to the database with the specified password.")
-            ("query,q",po::value<std::string>(),"Name of the table/or query to pass to postmaster")
-            ("table,t",po::value<std::string>(),"Name of the output table to create (default: table in query)")
+            ("query,q",po::value<std::vector<std::string>>(),"Name of the table/or query to pass to postmaster, repeat for several tables")
+            ("table,t",po::value<std::vector<std::string>>(),"Name of the output table to create (default: table in query), one per query")
             ("file,f",po::value<std::string>(),"Use this option to specify the name of the file to create.")
+            ("jobs,j",po::value<unsigned int>(),"number of tables exported at once (default 1)")
 
             ;
 
@@ -96,22 +97,31 @@ int main ( int argc, char** argv)
         if (vm.count("user")) user = vm["user"].as<std::string>();
         if (vm.count("password")) password = vm["password"].as<std::string>();
 
-        ConnectionCreator<Connection> creator(host,port,dbname,user,password,connect_timeout);
-        try
+        std::vector<std::string> queries = vm["query"].as<std::vector<std::string>>();
+        std::vector<std::string> tables;
+        if (vm.count("table")) tables = vm["table"].as<std::vector<std::string>>();
+        if (!tables.empty() && tables.size() != queries.size())
         {
-            std::shared_ptr<Connection> conn(creator());
-
-            std::string query = vm["query"].as<std::string>();
-            std::string output_table_name = vm.count("table") ? vm["table"].as<std::string>() : mapnik::sql_utils::table_from_sql(query);
-            std::string output_file = vm["file"].as<std::string>();
+            std::cout << desc << "\n";
+            std::cout << usage << "\n";
+            std::cout << "--table is needed once for every --query\n";
+            return EXIT_FAILURE;
+        }
 
-            std::cout << "output_table : " << output_table_name << "\n";
+        unsigned jobs = 1;
+        if (vm.count("jobs")) jobs = vm["jobs"].as<unsigned int>();
 
-            mapnik::pgsql2sqlite(conn,query,output_table_name,output_file);
+        std::vector<mapnik::pgsql2sqlite_job> exports;
+        for (std::size_t i = 0; i < queries.size(); ++i)
+        {
+            std::string output_table_name = tables.empty() ? mapnik::sql_utils::table_from_sql(queries[i]) : tables[i];
+            exports.push_back(mapnik::pgsql2sqlite_job{queries[i], output_table_name});
         }
-        catch (mapnik::datasource_exception & ex)
+
+        ConnectionCreator<Connection> creator(host,port,dbname,user,password,connect_timeout);
+        if (!mapnik::pgsql2sqlite(creator, exports, vm["file"].as<std::string>(), jobs))
         {
-            std::cerr << ex.what() << "\n";
+            return EXIT_FAILURE;
         }
 
     }
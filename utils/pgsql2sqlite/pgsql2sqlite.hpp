@@ -24,27 +24,31 @@
 
 // mapnik
 #include <mapnik/datasource.hpp>
-#include <mapnik/wkb.hpp>
-#include <mapnik/feature.hpp>
 #include <mapnik/global.hpp>
 #include <mapnik/sql_utils.hpp>
+#include <mapnik/make_unique.hpp>
+#include <mapnik/geometry/box2d.hpp>
 #include <mapnik/util/conversions.hpp>
-#include <mapnik/geometry/is_empty.hpp>
-#include <mapnik/geometry/envelope.hpp>
+#include <mapnik/util/noncopyable.hpp>
 
 #include "connection_manager.hpp"
-#include "cursorresultset.hpp"
-
-#pragma GCC diagnostic push
-#include <mapnik/warning_ignore.hpp>
-#include <boost/algorithm/string.hpp>
-#pragma GCC diagnostic pop
 
 //st
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
 #include <iostream>
-#include <fstream>
 #include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 static std::string numeric2string(const char* buf)
 {
@@ -161,29 +165,353 @@ static std::string numeric2string(const char* buf)
 
 namespace mapnik {
 
+namespace detail {
+
+// Reads the rows of a COPY ... TO STDOUT (FORMAT binary). Fields are in
+// the binary format of their types, as a binary cursor returns them.
 template <typename Connection>
-void pgsql2sqlite(Connection conn,
-                  std::string const& query,
-                  std::string const& output_table_name,
-                  std::string const& output_filename)
+class binary_copy_reader : util::noncopyable
 {
-    namespace sqlite = mapnik::sqlite;
-    sqlite::database db(output_filename);
+    struct field
+    {
+        std::size_t offset;
+        int length;
+    };
+
+public:
+    explicit binary_copy_reader(Connection & conn)
+        : conn_(conn),
+          data_(),
+          pos_(0),
+          fields_(),
+          header_(false) {}
+
+    // Reads the next row, the values of the row before are invalidated.
+    bool next()
+    {
+        data_.erase(0, pos_);
+        pos_ = 0;
+        fields_.clear();
+        if (!header_)
+        {
+            // signature, flags and the length of the header extension
+            static const char signature[] = "PGCOPY\n\377\r\n";
+            need(19);
+            if (data_.compare(0, sizeof(signature), signature, sizeof(signature)) != 0)
+            {
+                throw datasource_exception("pgsql2sqlite: unexpected COPY header");
+            }
+            pos_ = 19 + int4net(data_.data() + 15);
+            need(pos_);
+            header_ = true;
+        }
+        need(pos_ + 2);
+        int count = int2net(data_.data() + pos_);
+        pos_ += 2;
+        if (count < 0)
+        {
+            // the trailer, read what is left of the copy
+            while (conn_.getCopyData(data_)) {}
+            data_.clear();
+            pos_ = 0;
+            return false;
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            need(pos_ + 4);
+            int length = int4net(data_.data() + pos_);
+            pos_ += 4;
+            if (length > 0) need(pos_ + length);
+            fields_.push_back(field{pos_, length});
+            pos_ += std::max(length, 0);
+        }
+        return true;
+    }
 
-    std::shared_ptr<ResultSet> rs = conn->executeQuery("select * from (" + query + ") as query limit 0;");
-    int count = rs->getNumFields();
+    unsigned num_fields() const
+    {
+        return fields_.size();
+    }
 
-    std::ostringstream select_sql;
+    bool is_null(unsigned index) const
+    {
+        return fields_[index].length < 0;
+    }
 
-    select_sql << "select ";
+    int length(unsigned index) const
+    {
+        return fields_[index].length;
+    }
 
-    for (int i=0; i<count; ++i)
+    const char* value(unsigned index) const
     {
-        if (i!=0) select_sql << ",";
-        select_sql << "\"" <<  rs->getFieldName(i) << "\"";
+        return data_.data() + fields_[index].offset;
     }
 
-    select_sql << " from (" << query << ") as query";
+private:
+    void need(std::size_t size)
+    {
+        while (data_.size() < size)
+        {
+            if (!conn_.getCopyData(data_))
+            {
+                throw datasource_exception("pgsql2sqlite: COPY data ends within a row");
+            }
+        }
+    }
+
+    Connection & conn_;
+    std::string data_;
+    std::size_t pos_;
+    std::vector<field> fields_;
+    bool header_;
+};
+
+// Orders the bits of floats as the floats themselves, negative ones included.
+inline std::uint32_t sortable_bits(float val)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+// Position of the center of box on a Z-order curve over all floats. Boxes
+// inserted in that order make a compact R-tree, without knowing the extent
+// of the data first.
+inline std::int64_t zorder_key(box2d<double> const& box)
+{
+    std::uint32_t x = sortable_bits(static_cast<float>(box.center().x));
+    std::uint32_t y = sortable_bits(static_cast<float>(box.center().y));
+    std::uint64_t key = 0;
+    for (int bit = 31; bit >= 0; --bit)
+    {
+        key = (key << 2) | (((y >> bit) & 1u) << 1) | ((x >> bit) & 1u);
+    }
+    return static_cast<std::int64_t>(key ^ 0x8000000000000000ull);
+}
+
+// Rows read from a query, for its output table and for its spatial index.
+struct output_batch
+{
+    std::vector<sqlite::record_type> records;
+    std::vector<sqlite::record_type> boxes;
+};
+
+// Inserts records into a table, as many rows per statement as sqlite
+// takes parameters for, up to 64.
+class batch_insert : util::noncopyable
+{
+public:
+    batch_insert(sqlite::database & db, std::string const& table, unsigned columns)
+        : rows_(std::max(1, std::min(64, db.max_variables() / static_cast<int>(columns)))),
+          many_(db, insert_sql(table, columns, rows_)),
+          one_(db, insert_sql(table, columns, 1)) {}
+
+    bool insert(std::vector<sqlite::record_type> const& records)
+    {
+        auto itr = records.begin();
+        for (; records.end() - itr >= rows_; itr += rows_)
+        {
+            if (!many_.insert_records(itr, itr + rows_)) return false;
+        }
+        for (; itr != records.end(); ++itr)
+        {
+            if (!one_.insert_record(*itr)) return false;
+        }
+        return true;
+    }
+
+private:
+    static std::string insert_sql(std::string const& table, unsigned columns, int rows)
+    {
+        std::string row = "(?";
+        for (unsigned i = 1; i < columns; ++i) row += ",?";
+        row += ")";
+        std::string sql = "insert into " + table + " values " + row;
+        for (int i = 1; i < rows; ++i) sql += "," + row;
+        return sql;
+    }
+
+    int rows_;
+    sqlite::prepared_statement many_;
+    sqlite::prepared_statement one_;
+};
+
+// The output table of a query and its spatial index, made and written on
+// the writer thread. Bounding boxes are kept in a temporary table until
+// the end, then loaded into the R-tree in Z-order.
+class table_output : util::noncopyable
+{
+public:
+    table_output(std::string const& name, std::string const& index_name,
+                 std::string const& create_sql, unsigned columns)
+        : name_(name),
+          index_name_(index_name),
+          boxes_name_("bbox_" + name),
+          create_sql_(create_sql),
+          columns_(columns),
+          written_(0) {}
+
+    void create(sqlite::database & db)
+    {
+        if (!db.execute(create_sql_) ||
+            !db.execute("create temp table " + boxes_name_ +
+                        " (key INTEGER, pkid INTEGER, xmin REAL, xmax REAL, ymin REAL, ymax REAL)"))
+        {
+            throw std::runtime_error("pgsql2sqlite: cannot create " + name_);
+        }
+        records_ = std::make_unique<batch_insert>(db, name_, columns_);
+        boxes_ = std::make_unique<batch_insert>(db, "temp." + boxes_name_, 6);
+    }
+
+    std::size_t write(output_batch const& batch)
+    {
+        if (!records_->insert(batch.records) || !boxes_->insert(batch.boxes))
+        {
+            throw std::runtime_error("pgsql2sqlite: cannot insert into " + name_);
+        }
+        written_ += batch.records.size();
+        return batch.records.size();
+    }
+
+    void finish(sqlite::database & db)
+    {
+        // statements on the temporary table keep it from being dropped
+        records_.reset();
+        boxes_.reset();
+        if (!db.execute("create virtual table " + index_name_ + " using rtree(pkid, xmin, xmax, ymin, ymax)") ||
+            !db.execute("insert into " + index_name_ + " select pkid, xmin, xmax, ymin, ymax from temp." +
+                        boxes_name_ + " order by key") ||
+            !db.execute("drop table temp." + boxes_name_))
+        {
+            throw std::runtime_error("pgsql2sqlite: cannot build " + index_name_);
+        }
+        std::cout << "\r " << name_ << ": " << written_ << " features\n";
+    }
+
+private:
+    std::string name_;
+    std::string index_name_;
+    std::string boxes_name_;
+    std::string create_sql_;
+    unsigned columns_;
+    std::size_t written_;
+    std::unique_ptr<batch_insert> records_;
+    std::unique_ptr<batch_insert> boxes_;
+};
+
+// The one thread using the database. Readers queue tasks, waiting while
+// too many are queued, and the tasks run in the order they were queued.
+class sqlite_writer : util::noncopyable
+{
+public:
+    // returns the number of features written
+    using task = std::function<std::size_t(sqlite::database &)>;
+
+    sqlite_writer(std::string const& filename, std::size_t max_queued)
+        : db_(filename),
+          max_queued_(max_queued),
+          tasks_(),
+          closed_(false),
+          failed_(false) {}
+
+    void push(task t)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return tasks_.size() < max_queued_ || failed_; });
+        if (failed_) throw std::runtime_error("pgsql2sqlite: writing to sqlite failed");
+        tasks_.push_back(std::move(t));
+        not_empty_.notify_one();
+    }
+
+    // no more tasks are coming
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_one();
+    }
+
+    bool failed() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return failed_;
+    }
+
+    // Runs the tasks until closed, committing every commit_features
+    // features, and vacuums the database.
+    void run(std::size_t commit_features)
+    {
+        // a failed export is run again rather than recovered
+        db_.execute("PRAGMA synchronous=OFF;");
+        db_.execute("begin;");
+        std::size_t features = 0;
+        std::size_t uncommitted = 0;
+        for (;;)
+        {
+            task t;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                not_empty_.wait(lock, [this] { return !tasks_.empty() || closed_; });
+                if (tasks_.empty()) break;
+                t = std::move(tasks_.front());
+                tasks_.pop_front();
+                not_full_.notify_all();
+            }
+            try
+            {
+                std::size_t written = t(db_);
+                features += written;
+                uncommitted += written;
+            }
+            catch (std::exception const& ex)
+            {
+                std::cerr << "\n" << ex.what() << "\n";
+                std::lock_guard<std::mutex> lock(mutex_);
+                failed_ = true;
+                tasks_.clear();
+                not_full_.notify_all();
+                return;
+            }
+            if (uncommitted >= commit_features)
+            {
+                db_.execute("commit;begin;");
+                uncommitted = 0;
+            }
+            std::cout << "\r processed " << features << " features";
+            std::cout.flush();
+        }
+        db_.execute("commit;");
+        std::cout << "\r vacuuming";
+        std::cout.flush();
+        db_.execute("VACUUM;");
+    }
+
+private:
+    sqlite::database db_;
+    std::size_t max_queued_;
+    std::deque<task> tasks_;
+    bool closed_;
+    bool failed_;
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+// Copies the rows of query with a geometry into output_table_name, in
+// batches of batch_size rows queued to the writer. Geometries are copied
+// as the WKB PostGIS returns, their bounding boxes are computed by PostGIS.
+template <typename Connection>
+void export_table(Connection & conn,
+                  std::string const& query,
+                  std::string const& output_table_name,
+                  sqlite_writer & writer,
+                  std::size_t batch_size)
+{
+    namespace sqlite = mapnik::sqlite;
+
+    std::shared_ptr<ResultSet> fields = conn.executeQuery("select * from (" + query + ") as query limit 0;");
+    int count = fields->getNumFields();
 
     std::string table_name = mapnik::sql_utils::table_from_sql(query);
 
@@ -194,10 +522,6 @@ void pgsql2sqlite(Connection conn,
         schema_name=table_name.substr(0,idx);
         table_name=table_name.substr(idx+1);
     }
-    else
-    {
-        table_name=table_name.substr(0);
-    }
 
     std::ostringstream geom_col_sql;
     geom_col_sql << "select f_geometry_column,srid,type from geometry_columns ";
@@ -207,7 +531,7 @@ void pgsql2sqlite(Connection conn,
         geom_col_sql <<" and f_table_schema='"<< schema_name <<"'";
     }
 
-    rs = conn->executeQuery(geom_col_sql.str());
+    std::shared_ptr<ResultSet> rs = conn.executeQuery(geom_col_sql.str());
 
     int srid = -1;
     std::string geom_col = "UNKNOWN";
@@ -223,220 +547,247 @@ void pgsql2sqlite(Connection conn,
         geom_type = rs->getValue("type");
     }
 
-    // add AsBinary(<geometry_column>) modifier
-    std::string select_sql_str = select_sql.str();
-    boost::algorithm::replace_all(select_sql_str, "\"" + geom_col + "\"","ST_AsBinary(" + geom_col+") as " + geom_col);
-
-#ifdef MAPNIK_DEBUG
-    std::cout << select_sql_str << "\n";
-#endif
-
-    std::ostringstream cursor_sql;
-    std::string cursor_name("my_cursor");
-
-    cursor_sql << "DECLARE " << cursor_name << " BINARY INSENSITIVE NO SCROLL CURSOR WITH HOLD FOR " << select_sql_str << " FOR READ ONLY";
-    conn->execute(cursor_sql.str());
-
-    std::shared_ptr<CursorResultSet> cursor(new CursorResultSet(conn,cursor_name,10000));
-
-    unsigned num_fields = cursor->getNumFields();
-
-    if (num_fields == 0) return;
-
-    std::string feature_id =  "fid";
-
+    int geom_index = -1;
+    std::vector<int> oids;
+    std::ostringstream select_sql;
     std::ostringstream create_sql;
-    create_sql << "create table if not exists " << output_table_name << " (" << feature_id << " INTEGER PRIMARY KEY AUTOINCREMENT,";
-
-    int geometry_oid = -1;
-
-    std::string output_table_insert_sql = "insert into " + output_table_name + " values (?";
-
-    context_ptr ctx = std::make_shared<context_type>();
+    std::string feature_id =  "fid";
+    create_sql << "create table if not exists " << output_table_name << " (" << feature_id << " INTEGER PRIMARY KEY AUTOINCREMENT";
 
-    for ( unsigned pos = 0; pos < num_fields ; ++pos)
+    select_sql << "select ";
+    for (int pos = 0; pos < count; ++pos)
     {
-        const char* field_name = cursor->getFieldName(pos);
-        ctx->push(field_name);
-
-        if (pos > 0)
+        std::string field_name = fields->getFieldName(pos);
+        int oid = fields->getTypeOID(pos);
+        oids.push_back(oid);
+        if (pos > 0) select_sql << ",";
+        create_sql << ",'" << field_name;
+        if (field_name == geom_col)
         {
-            create_sql << ",";
+            geom_index = pos;
+            select_sql << "ST_AsBinary(\"" << field_name << "\") as \"" << field_name << "\"";
+            create_sql << "' BLOB";
+            continue;
         }
-        output_table_insert_sql +=",?";
-        int oid = cursor->getTypeOID(pos);
-        if (geom_col == cursor->getFieldName(pos))
+        select_sql << "\"" << field_name << "\"";
+        switch (oid)
         {
-            geometry_oid = oid;
-            create_sql << "'" << cursor->getFieldName(pos) << "' BLOB";
-        }
-        else
-        {
-            create_sql << "'" << cursor->getFieldName(pos);
-            switch (oid)
-            {
-            case 20:
-            case 21:
-            case 23:
-                create_sql << "' INTEGER";
-                break;
-            case 700:
-            case 701:
-                create_sql << "' REAL";
-                break;
-            default:
-                create_sql << "' TEXT";
-                break;
-            }
-
+        case 20:
+        case 21:
+        case 23:
+            create_sql << "' INTEGER";
+            break;
+        case 700:
+        case 701:
+            create_sql << "' REAL";
+            break;
+        default:
+            create_sql << "' TEXT";
+            break;
         }
     }
-
     create_sql << ");";
-    output_table_insert_sql +=")";
-
-    std::cout << "client_encoding=" << conn->client_encoding() << "\n";
-    std::cout << "geometry_column=" << geom_col << "(" << geom_type
-              <<  ") srid=" << srid << " oid=" << geometry_oid << "\n";
-
-
-    db.execute("begin;");
-    // output table sql
-    db.execute(create_sql.str());
 
-    // spatial index sql
-    std::string spatial_index_sql = "create virtual table idx_" + output_table_name
-        + "_" + geom_col + " using rtree(pkid, xmin, xmax, ymin, ymax)";
-
-    db.execute(spatial_index_sql);
-
-    //blob_to_hex hex;
-    int pkid = 0;
+    if (geom_index < 0)
+    {
+        throw datasource_exception("pgsql2sqlite: no geometry column '" + geom_col + "' in '" + query + "'");
+    }
 
-    std::string spatial_index_insert_sql = "insert into idx_" + output_table_name +  "_"
-        +  geom_col + " values (?,?,?,?,?)" ;
+    // the bounding box of the geometry, null when it is null or empty
+    select_sql << ",ST_XMin(\"" << geom_col << "\"),ST_XMax(\"" << geom_col << "\")"
+               << ",ST_YMin(\"" << geom_col << "\"),ST_YMax(\"" << geom_col << "\")";
+    select_sql << " from (" << query << ") as query";
 
-    sqlite::prepared_statement spatial_index(db,spatial_index_insert_sql);
+    std::string copy_sql = "COPY (" + select_sql.str() + ") TO STDOUT (FORMAT binary)";
 
 #ifdef MAPNIK_DEBUG
-    std::cout << output_table_insert_sql << "\n";
+    std::cout << copy_sql << "\n";
 #endif
 
-    sqlite::prepared_statement output_table(db,output_table_insert_sql);
+    std::string client_encoding = conn.client_encoding();
+    auto output = std::make_shared<table_output>(output_table_name, "idx_" + output_table_name + "_" + geom_col,
+                                                 create_sql.str(), count + 1);
+    writer.push([=](sqlite::database & db) {
+            std::cout << "\routput_table : " << output_table_name << "\n";
+            std::cout << "client_encoding=" << client_encoding << "\n";
+            std::cout << "geometry_column=" << geom_col << "(" << geom_type
+                      <<  ") srid=" << srid << "\n";
+            output->create(db);
+            return std::size_t(0);
+        });
+
+    if (!conn.startCopy(copy_sql))
+    {
+        throw datasource_exception("pgsql2sqlite: cannot copy '" + query + "'");
+    }
 
-    while (cursor->next())
+    binary_copy_reader<Connection> reader(conn);
+    std::int64_t pkid = 0;
+    output_batch batch;
+    while (reader.next())
     {
         ++pkid;
+        if (reader.num_fields() != unsigned(count + 4))
+        {
+            throw datasource_exception("pgsql2sqlite: unexpected number of fields in COPY data");
+        }
+
+        // rows without a geometry or with an empty one are left out
+        bool empty_geom = false;
+        double box[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            if (reader.is_null(count + i))
+            {
+                empty_geom = true;
+                break;
+            }
+            float8net(box[i], reader.value(count + i));
+        }
+        if (empty_geom) continue;
 
         sqlite::record_type output_rec;
+        output_rec.reserve(count + 1);
         output_rec.push_back(sqlite::value_type(pkid));
-        bool empty_geom = true;
-        const char * buf = 0;
-        for (unsigned pos=0 ; pos < num_fields; ++pos)
+        for (int pos = 0; pos < count; ++pos)
         {
-            if (! cursor->isNull(pos))
+            if (reader.is_null(pos))
             {
-                int size=cursor->getFieldLength(pos);
-                int oid = cursor->getTypeOID(pos);
-                buf=cursor->getValue(pos);
-
-                switch (oid)
-                {
-                case 25:
-                case 1042:
-                case 1043:
-                {
-                    std::string text(buf);
-                    boost::algorithm::replace_all(text,"'","''");
-                    output_rec.push_back(sqlite::value_type(text));
-                    break;
-                }
-                case 23:
-                    output_rec.emplace_back(int4net(buf));
-                    break;
-                case 21:
-                    output_rec.emplace_back(int(int2net(buf)));
-                    break;
-                case 700:
-                {
-                    float val;
-                    float4net(val,buf);
-                    output_rec.emplace_back(double(val));
-                    break;
-                }
-                case 701:
+                output_rec.push_back(sqlite::null_type());
+                continue;
+            }
+            int size = reader.length(pos);
+            const char * buf = reader.value(pos);
+            if (pos == geom_index)
+            {
+                output_rec.push_back(sqlite::blob(buf,size));
+                continue;
+            }
+            switch (oids[pos])
+            {
+            case 25:
+            case 1042:
+            case 1043:
+                output_rec.push_back(sqlite::value_type(std::string(buf, size)));
+                break;
+            case 20:
+                output_rec.emplace_back(std::int64_t(int8net(buf)));
+                break;
+            case 23:
+                output_rec.emplace_back(int4net(buf));
+                break;
+            case 21:
+                output_rec.emplace_back(int(int2net(buf)));
+                break;
+            case 700:
+            {
+                float val;
+                float4net(val,buf);
+                output_rec.emplace_back(double(val));
+                break;
+            }
+            case 701:
+            {
+                double val;
+                float8net(val,buf);
+                output_rec.emplace_back(val);
+                break;
+            }
+            case 1700:
+            {
+                std::string str = numeric2string(buf);
+                double val;
+                if (mapnik::util::string2double(str,val))
                 {
-                    double val;
-                    float8net(val,buf);
                     output_rec.emplace_back(val);
-                    break;
-                }
-                case 1700:
-                {
-                    std::string str = numeric2string(buf);
-                    double val;
-                    if (mapnik::util::string2double(str,val))
-                    {
-                        output_rec.emplace_back(val);
-                    }
-                    break;
                 }
-
-                default:
+                else
                 {
-                    if (oid == geometry_oid)
-                    {
-                        mapnik::feature_impl feat(ctx,pkid);
-                        mapnik::geometry::geometry<double> geom = geometry_utils::from_wkb(buf, size, wkbGeneric);
-                        if (!mapnik::geometry::is_empty(geom))
-                        {
-                            box2d<double> bbox = mapnik::geometry::envelope(geom);
-                            if (bbox.valid())
-                            {
-                                sqlite::record_type rec;
-                                rec.push_back(sqlite::value_type(pkid));
-                                rec.push_back(sqlite::value_type(bbox.minx()));
-                                rec.push_back(sqlite::value_type(bbox.maxx()));
-                                rec.push_back(sqlite::value_type(bbox.miny()));
-                                rec.push_back(sqlite::value_type(bbox.maxy()));
-                                spatial_index.insert_record(rec);
-                                empty_geom = false;
-                            }
-                        }
-                        output_rec.push_back(sqlite::blob(buf,size));
-                    }
-                    else
-                    {
-                        output_rec.push_back(sqlite::null_type());
-                    }
-                    break;
-                }
+                    output_rec.push_back(sqlite::null_type());
                 }
+                break;
             }
-            else
-            {
+            default:
                 output_rec.push_back(sqlite::null_type());
+                break;
             }
         }
+        batch.records.push_back(std::move(output_rec));
 
-        if (!empty_geom) output_table.insert_record(output_rec);
+        box2d<double> bbox(box[0], box[2], box[1], box[3]);
+        sqlite::record_type index_rec;
+        index_rec.reserve(6);
+        index_rec.push_back(sqlite::value_type(zorder_key(bbox)));
+        index_rec.push_back(sqlite::value_type(pkid));
+        for (double val : box) index_rec.push_back(sqlite::value_type(val));
+        batch.boxes.push_back(std::move(index_rec));
 
-        if (pkid % 1000 == 0)
+        if (batch.records.size() >= batch_size)
         {
-            std::cout << "\r processing " << pkid << " features";
-            std::cout.flush();
+            writer.push([output, batch = std::move(batch)](sqlite::database &) {
+                    return output->write(batch);
+                });
+            batch = output_batch();
         }
+    }
+    writer.push([output, batch = std::move(batch)](sqlite::database & db) {
+            std::size_t written = output->write(batch);
+            output->finish(db);
+            return written;
+        });
+}
 
-        if (pkid % 100000 == 0)
-        {
-            db.execute("commit;begin;");
-        }
+}
+
+// An output table and the query filling it.
+struct pgsql2sqlite_job
+{
+    std::string query;
+    std::string output_table_name;
+};
+
+// Exports the jobs into output_filename, up to threads at once, each over
+// a connection of its own. Returns false if any of them failed.
+template <typename Connection>
+bool pgsql2sqlite(ConnectionCreator<Connection> const& creator,
+                  std::vector<pgsql2sqlite_job> const& jobs,
+                  std::string const& output_filename,
+                  unsigned threads)
+{
+    threads = std::max(1u, std::min(threads, static_cast<unsigned>(jobs.size())));
+    // a few batches per reader keep the writer busy
+    detail::sqlite_writer writer(output_filename, 4 * threads);
+    std::thread writing([&writer] { writer.run(100000); });
+
+    std::atomic<std::size_t> next_job(0);
+    std::atomic<bool> ok(true);
+    std::vector<std::thread> readers;
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        readers.emplace_back([&] {
+                std::shared_ptr<Connection> conn;
+                for (std::size_t job = next_job++; job < jobs.size() && !writer.failed(); job = next_job++)
+                {
+                    try
+                    {
+                        if (!conn) conn.reset(creator());
+                        detail::export_table(*conn, jobs[job].query, jobs[job].output_table_name, writer, 10000);
+                    }
+                    catch (std::exception const& ex)
+                    {
+                        ok = false;
+                        std::cerr << "\n" + jobs[job].output_table_name + ": " + ex.what() + "\n";
+                        // a copy cut short leaves the connection unusable
+                        conn.reset();
+                    }
+                }
+            });
     }
-    // commit
-    db.execute("commit;");
-    std::cout << "\r processed " << pkid << " features";
-    db.execute("VACUUM;");
-    std::cout << "\r vacumming";
+    for (std::thread & reader : readers) reader.join();
+    writer.close();
+    writing.join();
     std::cout << "\n Done!" << std::endl;
+    return ok && !writer.failed();
 }
+
 }
@@ -31,7 +31,7 @@ namespace mapnik { namespace sqlite {
         if (res)
         {
             sqlite3_close(db);
-            throw;
+            throw std::runtime_error("cannot open " + name);
         }
 
         db_ = sqlite_db(db,database_closer());
@@ -54,5 +54,10 @@ namespace mapnik { namespace sqlite {
         }
         return true;
     }
+
+    int database::max_variables() const
+    {
+        return sqlite3_limit(db_.get(), SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+    }
     }
 }
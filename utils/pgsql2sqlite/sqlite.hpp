@@ -35,7 +35,9 @@
 #include <cassert>
 #endif
 
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -63,19 +65,20 @@ namespace mapnik {  namespace sqlite {
         database(std::string const& name);
         ~database();
         bool execute(std::string const& sql);
+        // most parameters a statement can have
+        int max_variables() const;
     };
 
     struct null_type {};
     struct blob
     {
         blob(const char* buf, unsigned size)
-            : buf_(buf), size_(size) {}
+            : data_(buf, size) {}
 
-        const char * buf_;
-        unsigned size_;
+        std::string data_;
     };
 
-    using value_type = mapnik::util::variant<int,double,std::string, blob,null_type>;
+    using value_type = mapnik::util::variant<int,std::int64_t,double,std::string, blob,null_type>;
     using record_type = std::vector<value_type>;
 
     class prepared_statement : util::noncopyable
@@ -105,6 +108,16 @@ namespace mapnik {  namespace sqlite {
                 return true;
             }
 
+            bool operator() (std::int64_t val)
+            {
+                if (sqlite3_bind_int64(stmt_, index_ , val ) != SQLITE_OK)
+                {
+                    std::cerr << "cannot bind " << val << "\n";
+                    return false;
+                }
+                return true;
+            }
+
             bool operator() (double val)
             {
                 if (sqlite3_bind_double(stmt_, index_ , val ) != SQLITE_OK)
@@ -127,7 +140,7 @@ namespace mapnik {  namespace sqlite {
 
             bool operator() (blob const& val)
             {
-                if (sqlite3_bind_blob(stmt_, index_, val.buf_, val.size_, SQLITE_STATIC) != SQLITE_OK)
+                if (sqlite3_bind_blob(stmt_, index_, val.data_.data(), val.data_.size(), SQLITE_STATIC) != SQLITE_OK)
                 {
                     std::cerr << "cannot bind BLOB\n";
                     return false;
@@ -147,8 +160,7 @@ namespace mapnik {  namespace sqlite {
             int res = sqlite3_prepare_v2(db_, sql.c_str(),-1, &stmt_,&tail);
             if (res != SQLITE_OK)
             {
-                std::cerr << "ERR:"<< res << "\n";
-                throw;
+                throw std::runtime_error("cannot prepare '" + sql + "': " + sqlite3_errmsg(db_));
             }
         }
 
@@ -163,24 +175,37 @@ namespace mapnik {  namespace sqlite {
 
         bool insert_record(record_type const& rec) const
         {
-#ifdef MAPNIK_DEBUG
-            assert( unsigned(sqlite3_bind_parameter_count(stmt_)) == rec.size());
-#endif
-            record_type::const_iterator itr = rec.begin();
-            record_type::const_iterator end = rec.end();
+            return insert_records(&rec, &rec + 1);
+        }
+
+        // Inserts the records in one go, for a statement inserting as many
+        // rows as there are records.
+        template <typename Iterator>
+        bool insert_records(Iterator begin, Iterator end) const
+        {
             int count = 1;
-            for (; itr!=end;++itr)
+            for (; begin != end; ++begin)
             {
-                binder op(stmt_,count++);
-                if (!util::apply_visitor(op,*itr))
+                for (value_type const& val : *begin)
                 {
-                    return false;
+                    binder op(stmt_,count++);
+                    if (!util::apply_visitor(op,val))
+                    {
+                        sqlite3_reset(stmt_);
+                        return false;
+                    }
                 }
             }
-
-            sqlite3_step(stmt_);
+#ifdef MAPNIK_DEBUG
+            assert(sqlite3_bind_parameter_count(stmt_) == count - 1);
+#endif
+            int res = sqlite3_step(stmt_);
             sqlite3_reset(stmt_);
-
+            if (res != SQLITE_DONE)
+            {
+                std::cerr << "ERR:" << res << " " << sqlite3_errmsg(db_) << "\n";
+                return false;
+            }
             return true;
         }
 
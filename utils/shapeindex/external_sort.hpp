@@ -0,0 +1,298 @@
+/*****************************************************************************
+ *
+ * This file is part of Mapnik (c++ mapping toolkit)
+ *
+ * Copyright (C) 2017 Artem Pavlenko
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *****************************************************************************/
+
+
+#ifndef MAPNIK_UTILS_EXTERNAL_SORT_HPP
+#define MAPNIK_UTILS_EXTERNAL_SORT_HPP
+
+// mapnik
+#include <mapnik/util/fs.hpp>
+#include <mapnik/util/noncopyable.hpp>
+
+// stl
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace mapnik { namespace detail {
+
+// Sorts more records than fit in memory. Records are collected up to
+// max_bytes, then sorted and spilled to run files named after prefix;
+// merge() hands all of them over in order. At most max_fan_in runs are
+// open at a time: with more, groups of them are first merged into longer
+// runs, pass after pass. Records are copied as raw bytes and Less must be
+// a strict total order for the result to be independent of the budget.
+template <typename Record, typename Less>
+class external_sort : util::noncopyable
+{
+public:
+    external_sort(std::string const& prefix, std::size_t max_bytes,
+                  std::size_t max_fan_in = 64, Less less = Less())
+        : prefix_(prefix),
+          max_records_(std::max<std::size_t>(1024, max_bytes / sizeof(Record))),
+          max_fan_in_(std::max<std::size_t>(2, max_fan_in)),
+          less_(less),
+          buffer_(),
+          runs_(),
+          next_run_(0),
+          size_(0)
+    {
+        buffer_.reserve(std::min<std::size_t>(max_records_, 1 << 20));
+    }
+
+    ~external_sort()
+    {
+        // also the runs of a merge pass cut short by an exception
+        for (std::size_t i = 0; i < next_run_; ++i)
+        {
+            mapnik::util::remove(prefix_ + ".sort" + std::to_string(i));
+        }
+    }
+
+    void push(Record const& record)
+    {
+        buffer_.push_back(record);
+        ++size_;
+        if (buffer_.size() == max_records_) spill();
+    }
+
+    std::size_t size() const { return size_; }
+    std::size_t runs() const { return runs_.size(); }
+
+    // calls f with every record, in order
+    template <typename F>
+    void merge(F && f)
+    {
+        std::sort(buffer_.begin(), buffer_.end(), less_);
+        if (runs_.empty())
+        {
+            for (auto const& record : buffer_) f(record);
+            return;
+        }
+        if (!buffer_.empty()) spill();
+        buffer_.clear();
+        buffer_.shrink_to_fit();
+        // consecutive runs are merged, so ties keep going to the earlier run
+        while (runs_.size() > max_fan_in_)
+        {
+            std::vector<run> merged;
+            for (std::size_t first = 0; first < runs_.size(); first += max_fan_in_)
+            {
+                std::size_t last = std::min(first + max_fan_in_, runs_.size());
+                if (last - first == 1)
+                {
+                    merged.push_back(runs_[first]);
+                    continue;
+                }
+                run r { next_run_name(), 0 };
+                run_writer writer(r.filename, max_records_ / 2);
+                merged.push_back(r);
+                merge_runs(first, last, max_records_ / 2, [&](Record const& record) { writer.push(record); });
+                merged.back().count = writer.finish();
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    mapnik::util::remove(runs_[i].filename);
+                }
+            }
+            runs_.swap(merged);
+        }
+        merge_runs(0, runs_.size(), max_records_, f);
+    }
+
+private:
+    struct run
+    {
+        std::string filename;
+        std::size_t count;
+    };
+
+    // merges runs_[first, last) within about buffer_records records
+    template <typename F>
+    void merge_runs(std::size_t first, std::size_t last, std::size_t buffer_records, F && f)
+    {
+        std::vector<std::unique_ptr<run_reader>> readers;
+        std::size_t records_per_run = std::max<std::size_t>(1024, buffer_records / (last - first));
+        for (std::size_t i = first; i < last; ++i)
+        {
+            readers.emplace_back(new run_reader(runs_[i], records_per_run));
+        }
+        // smallest head first, ties go to the earlier run
+        auto greater = [&](std::size_t lhs, std::size_t rhs)
+        {
+            Record const& l = readers[lhs]->head();
+            Record const& r = readers[rhs]->head();
+            if (less_(r, l)) return true;
+            if (less_(l, r)) return false;
+            return lhs > rhs;
+        };
+        std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(greater)> heads(greater);
+        for (std::size_t i = 0; i < readers.size(); ++i)
+        {
+            if (readers[i]->next()) heads.push(i);
+        }
+        while (!heads.empty())
+        {
+            std::size_t i = heads.top();
+            heads.pop();
+            f(readers[i]->head());
+            if (readers[i]->next()) heads.push(i);
+        }
+    }
+
+    class run_reader : util::noncopyable
+    {
+    public:
+        run_reader(run const& r, std::size_t buffer_records)
+            : file_(r.filename.c_str(), std::ios::in | std::ios::binary),
+              remaining_(r.count),
+              buffer_(std::min(buffer_records, r.count)),
+              pos_(0),
+              end_(0)
+        {
+            if (!file_)
+            {
+                throw std::runtime_error("cannot open sort run " + r.filename);
+            }
+        }
+
+        // moves to the next record, false past the last one
+        bool next()
+        {
+            if (++pos_ < end_) return true;
+            if (remaining_ == 0) return false;
+            std::size_t n = std::min(remaining_, buffer_.size());
+            file_.read(reinterpret_cast<char*>(buffer_.data()), static_cast<std::streamsize>(n * sizeof(Record)));
+            if (!file_)
+            {
+                throw std::runtime_error("truncated sort run");
+            }
+            remaining_ -= n;
+            pos_ = 0;
+            end_ = n;
+            return true;
+        }
+
+        Record const& head() const { return buffer_[pos_]; }
+
+    private:
+        std::ifstream file_;
+        std::size_t remaining_;
+        std::vector<Record> buffer_;
+        std::size_t pos_;
+        std::size_t end_;
+    };
+
+    class run_writer : util::noncopyable
+    {
+    public:
+        run_writer(std::string const& filename, std::size_t buffer_records)
+            : filename_(filename),
+              file_(filename.c_str(), std::ios::out | std::ios::trunc | std::ios::binary),
+              buffer_(),
+              count_(0)
+        {
+            if (!file_)
+            {
+                throw std::runtime_error("cannot write sort run " + filename_);
+            }
+            buffer_.reserve(std::max<std::size_t>(1024, buffer_records));
+        }
+
+        void push(Record const& record)
+        {
+            buffer_.push_back(record);
+            if (buffer_.size() == buffer_.capacity()) flush();
+        }
+
+        // the number of records written
+        std::size_t finish()
+        {
+            flush();
+            file_.close();
+            if (!file_)
+            {
+                throw std::runtime_error("cannot write sort run " + filename_);
+            }
+            return count_;
+        }
+
+    private:
+        void flush()
+        {
+            file_.write(reinterpret_cast<char const*>(buffer_.data()),
+                        static_cast<std::streamsize>(buffer_.size() * sizeof(Record)));
+            if (!file_)
+            {
+                throw std::runtime_error("cannot write sort run " + filename_);
+            }
+            count_ += buffer_.size();
+            buffer_.clear();
+        }
+
+        std::string filename_;
+        std::ofstream file_;
+        std::vector<Record> buffer_;
+        std::size_t count_;
+    };
+
+    std::string next_run_name()
+    {
+        return prefix_ + ".sort" + std::to_string(next_run_++);
+    }
+
+    void spill()
+    {
+        std::sort(buffer_.begin(), buffer_.end(), less_);
+        run r { next_run_name(), buffer_.size() };
+        std::ofstream file(r.filename.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("cannot write sort run " + r.filename);
+        }
+        runs_.push_back(r);
+        file.write(reinterpret_cast<char const*>(buffer_.data()),
+                   static_cast<std::streamsize>(buffer_.size() * sizeof(Record)));
+        if (!file)
+        {
+            throw std::runtime_error("cannot write sort run " + r.filename);
+        }
+        buffer_.clear();
+    }
+
+    std::string prefix_;
+    std::size_t max_records_;
+    std::size_t max_fan_in_;
+    Less less_;
+    std::vector<Record> buffer_;
+    std::vector<run> runs_;
+    std::size_t next_run_;
+    std::size_t size_;
+};
+
+}} // namespace mapnik::detail
+
+#endif // MAPNIK_UTILS_EXTERNAL_SORT_HPP
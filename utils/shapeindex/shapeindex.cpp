@@ -19,18 +19,27 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  *
  *****************************************************************************/
-
+#include <atomic>
+#include <cstdio>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <system_error>
+#include <thread>
 #include <vector>
 #include <string>
 #include <mapnik/version.hpp>
 #include <mapnik/util/fs.hpp>
+#include <mapnik/util/file_io.hpp>
 #include <mapnik/quad_tree.hpp>
+#include <mapnik/util/packed_spatial_index.hpp>
 //#include <mapnik/util/spatial_index.hpp>
 #include <mapnik/geometry/envelope.hpp>
 #include "shapefile.hpp"
 #include "shape_io.hpp"
+#include "shape_rings.hpp"
 #include "shape_index_featureset.hpp"
+#include "external_sort.hpp"
 #pragma GCC diagnostic push
 #include <mapnik/warning_ignore.hpp>
 #include <boost/algorithm/string.hpp>
@@ -39,6 +48,453 @@
 
 const int DEFAULT_DEPTH = 8;
 const double DEFAULT_RATIO = 0.55;
+const std::size_t DEFAULT_MEMORY = 1024; // MB
+
+namespace {
+
+using mapnik::box2d;
+using mapnik::detail::node;
+
+// offset and content length of a record, in 16 bit words
+struct shx_record
+{
+    std::int32_t offset;
+    std::int32_t length;
+};
+
+std::vector<shx_record> read_shx(shape_file & shx, int file_length)
+{
+    std::vector<shx_record> records;
+    records.reserve(static_cast<std::size_t>(std::max(0, (file_length - 50) / 4)));
+    int pos = 50;
+    shx.seek(pos * 2);
+    while (shx.is_good() && pos <= file_length - 4)
+    {
+        shx_record record;
+        record.offset = shx.read_xdr_integer();
+        record.length = shx.read_xdr_integer();
+        if (!shx.is_good()) break;
+        records.push_back(record);
+        pos += 4;
+    }
+    return records;
+}
+
+box2d<float> float_box(box2d<double> const& box)
+{
+    return box2d<float>(static_cast<float>(box.minx()), static_cast<float>(box.miny()),
+                        static_cast<float>(box.maxx()), static_cast<float>(box.maxy()));
+}
+
+// Calls f(record, item) for the box of each record in [begin, end), or of
+// each of its parts for polygons and lines with index_parts.
+template <typename F>
+void extract_boxes(shape_file & shp, std::vector<shx_record> const& records,
+                   std::size_t begin, std::size_t end, bool index_parts, bool verbose,
+                   std::ostream & log, F && f)
+{
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        int offset = records[i].offset;
+        box2d<double> item_ext;
+        shp.seek(offset * 2);
+        int record_number = shp.read_xdr_integer();
+        int shp_content_length = shp.read_xdr_integer();
+        if (records[i].length != shp_content_length)
+        {
+            if (verbose)
+            {
+                log << "Content length mismatch for record number " << record_number << std::endl;
+            }
+            continue;
+        }
+        int shape_type = shp.read_ndr_integer();
+
+        if (shape_type == shape_io::shape_null) continue;
+
+        if (shape_type==shape_io::shape_point
+            || shape_type==shape_io::shape_pointm
+            || shape_type == shape_io::shape_pointz)
+        {
+            double x=shp.read_double();
+            double y=shp.read_double();
+            item_ext=box2d<double>(x,y,x,y);
+        }
+        else if (index_parts &&
+                 (shape_type == shape_io::shape_polygon || shape_type == shape_io::shape_polygonm || shape_type == shape_io::shape_polygonz
+                  || shape_type == shape_io::shape_polyline || shape_type == shape_io::shape_polylinem || shape_type == shape_io::shape_polylinez))
+        {
+            shp.read_envelope(item_ext);
+            int num_parts = shp.read_ndr_integer();
+            int num_points = shp.read_ndr_integer();
+            std::vector<int> parts;
+            parts.resize(num_parts);
+            std::for_each(parts.begin(), parts.end(), [&](int & part) { part = shp.read_ndr_integer();});
+            for (int k = 0; k < num_parts; ++k)
+            {
+                int start = parts[k];
+                int end_point;
+                if (k == num_parts - 1) end_point = num_points;
+                else end_point = parts[k + 1];
+
+                mapnik::geometry::linear_ring<double> ring;
+                ring.reserve(end_point - start);
+                for (int j = start; j < end_point; ++j)
+                {
+                    double x = shp.read_double();
+                    double y = shp.read_double();
+                    ring.emplace_back(x, y);
+                }
+                item_ext = mapnik::geometry::envelope(ring);
+                if (item_ext.valid())
+                {
+                    if (verbose)
+                    {
+                        log << "record number " << record_number << " box=" << item_ext << std::endl;
+                    }
+                    f(i, node(offset * 2, start, end_point, float_box(item_ext)));
+                }
+            }
+            item_ext = box2d<double>(); //invalid
+        }
+        else
+        {
+            shp.read_envelope(item_ext);
+        }
+
+        if (item_ext.valid())
+        {
+            if (verbose)
+            {
+                log << "record number " << record_number << " box=" << item_ext << std::endl;
+            }
+            f(i, node(offset * 2, -1, 0, float_box(item_ext)));
+        }
+    }
+}
+
+// Reads the boxes of all records and calls f(record, item) for each of
+// them in record order. Batches of records are spread over jobs threads,
+// each reading through a shape_file of its own.
+template <typename F>
+void for_each_box(std::string const& shp_name, std::vector<shx_record> const& records,
+                  unsigned jobs, bool index_parts, bool verbose, F && f)
+{
+    constexpr std::size_t batch_size = 16384;
+    using item_list = std::vector<std::pair<std::size_t, node>>;
+    std::vector<std::unique_ptr<shape_file>> files;
+    for (unsigned i = 0; i < std::max(1u, jobs); ++i)
+    {
+        files.emplace_back(new shape_file(shp_name));
+        if (!files.back()->is_open())
+        {
+            throw std::runtime_error("cannot open " + shp_name);
+        }
+    }
+    std::size_t num_batches = (records.size() + batch_size - 1) / batch_size;
+    // a few batches per thread and round keep the threads busy while
+    // bounding the items held at a time
+    std::size_t round_size = 4 * files.size();
+    std::vector<item_list> items(round_size);
+    std::vector<std::string> logs(round_size);
+    for (std::size_t round = 0; round < num_batches; round += round_size)
+    {
+        std::size_t round_end = std::min(num_batches, round + round_size);
+        std::atomic<std::size_t> next(round);
+        auto worker = [&](shape_file & shp)
+        {
+            for (std::size_t b = next++; b < round_end; b = next++)
+            {
+                item_list & list = items[b - round];
+                list.clear();
+                std::ostringstream log;
+                extract_boxes(shp, records, b * batch_size, std::min(records.size(), (b + 1) * batch_size),
+                              index_parts, verbose, log,
+                              [&list](std::size_t record, node const& item) { list.emplace_back(record, item); });
+                logs[b - round] = log.str();
+            }
+        };
+        std::vector<std::thread> workers;
+        try
+        {
+            for (std::size_t i = 1; i < files.size() && i < round_end - round; ++i)
+            {
+                workers.emplace_back(worker, std::ref(*files[i]));
+            }
+        }
+        catch (std::system_error const&)
+        {
+            // read the rest on this thread
+        }
+        worker(*files[0]);
+        for (auto & t : workers) t.join();
+        for (std::size_t b = round; b < round_end; ++b)
+        {
+            std::clog << logs[b - round];
+            for (auto const& item : items[b - round]) f(item.first, item.second);
+        }
+    }
+}
+
+// packed index items, in hilbert order then in record order
+struct sort_item
+{
+    std::uint32_t code;
+    std::uint64_t seq;
+    node item;
+};
+
+struct sort_item_less
+{
+    bool operator()(sort_item const& lhs, sort_item const& rhs) const
+    {
+        return lhs.code < rhs.code || (lhs.code == rhs.code && lhs.seq < rhs.seq);
+    }
+};
+
+// records in hilbert order of their boxes, those without a box last
+struct record_key
+{
+    std::uint64_t key;
+    std::uint64_t record;
+};
+
+struct record_key_less
+{
+    bool operator()(record_key const& lhs, record_key const& rhs) const
+    {
+        return lhs.key < rhs.key || (lhs.key == rhs.key && lhs.record < rhs.record);
+    }
+};
+
+void write_int32_xdr(char * data, std::int32_t val)
+{
+    auto u = static_cast<std::uint32_t>(val);
+    data[0] = static_cast<char>((u >> 24) & 0xff);
+    data[1] = static_cast<char>((u >> 16) & 0xff);
+    data[2] = static_cast<char>((u >> 8) & 0xff);
+    data[3] = static_cast<char>(u & 0xff);
+}
+
+void replace_file(std::string const& from, std::string const& to)
+{
+    if (std::rename(from.c_str(), to.c_str()) != 0)
+    {
+        // windows does not rename over existing files
+        mapnik::util::remove(to);
+        if (std::rename(from.c_str(), to.c_str()) != 0)
+        {
+            throw std::runtime_error("cannot replace " + to + " by " + from);
+        }
+    }
+}
+
+// Rewrites the .shp, .shx and .dbf with the records in hilbert order of
+// their boxes, so that the records of nearby shapes are stored together.
+void sort_shapefile(std::string const& shapename, std::vector<shx_record> const& records,
+                    box2d<float> const& extent, unsigned jobs, std::size_t memory, bool verbose)
+{
+    std::string shp_name = shapename + ".shp";
+    std::string shx_name = shapename + ".shx";
+    std::string dbf_name = shapename + ".dbf";
+    constexpr std::uint64_t no_box = std::uint64_t(1) << 32;
+
+    mapnik::detail::external_sort<record_key, record_key_less> sorter(shp_name, memory);
+    std::size_t next = 0;
+    for_each_box(shp_name, records, jobs, false, verbose, [&](std::size_t record, node const& item)
+    {
+        for (; next < record; ++next) sorter.push(record_key { no_box, next });
+        sorter.push(record_key { mapnik::util::packed_index::hilbert_code(item.box, extent), record });
+        next = record + 1;
+    });
+    for (; next < records.size(); ++next) sorter.push(record_key { no_box, next });
+
+    std::ifstream shp_in(shp_name.c_str(), std::ios::in | std::ios::binary);
+    std::ifstream shx_in(shx_name.c_str(), std::ios::in | std::ios::binary);
+    char shp_header[100], shx_header[100];
+    if (!shp_in.read(shp_header, 100) || !shx_in.read(shx_header, 100))
+    {
+        throw std::runtime_error("cannot read the headers of " + shapename);
+    }
+
+    bool has_dbf = mapnik::util::exists(dbf_name);
+    std::ifstream dbf_in;
+    std::vector<char> dbf_header;
+    std::size_t dbf_record_length = 0;
+    std::vector<char> dbf_tail;
+    if (has_dbf)
+    {
+        dbf_in.open(dbf_name.c_str(), std::ios::in | std::ios::binary);
+        char head[32];
+        if (!dbf_in.read(head, 32))
+        {
+            throw std::runtime_error("cannot read the header of " + dbf_name);
+        }
+        std::int32_t num_records;
+        std::int16_t header_length, record_length;
+        mapnik::read_int32_ndr(head + 4, num_records);
+        mapnik::read_int16_ndr(head + 8, header_length);
+        mapnik::read_int16_ndr(head + 10, record_length);
+        if (static_cast<std::size_t>(num_records) != records.size())
+        {
+            throw std::runtime_error(dbf_name + " has " + std::to_string(num_records) + " records, " +
+                                     shx_name + " " + std::to_string(records.size()));
+        }
+        dbf_header.resize(static_cast<std::uint16_t>(header_length));
+        dbf_record_length = static_cast<std::uint16_t>(record_length);
+        dbf_in.seekg(0);
+        dbf_in.read(dbf_header.data(), static_cast<std::streamsize>(dbf_header.size()));
+        // end of file marker
+        dbf_in.seekg(static_cast<std::streamoff>(dbf_header.size() + records.size() * dbf_record_length));
+        dbf_tail.assign(std::istreambuf_iterator<char>(dbf_in), std::istreambuf_iterator<char>());
+        dbf_in.clear();
+    }
+
+    // all three are written before any replaces its original
+    std::string shp_sorted = mapnik::util::temp_filename(shp_name);
+    std::string shx_sorted = mapnik::util::temp_filename(shx_name);
+    std::string dbf_sorted = mapnik::util::temp_filename(dbf_name);
+    try
+    {
+        std::ofstream shp_out(shp_sorted.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        std::ofstream shx_out(shx_sorted.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        std::ofstream dbf_out;
+        shp_out.exceptions(std::ios::failbit | std::ios::badbit);
+        shx_out.exceptions(std::ios::failbit | std::ios::badbit);
+        shp_out.write(shp_header, 100);
+        shx_out.write(shx_header, 100);
+        if (has_dbf)
+        {
+            dbf_out.open(dbf_sorted.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+            dbf_out.exceptions(std::ios::failbit | std::ios::badbit);
+            dbf_out.write(dbf_header.data(), static_cast<std::streamsize>(dbf_header.size()));
+        }
+
+        std::int32_t pos = 50;
+        std::int32_t number = 0;
+        std::vector<char> buffer;
+        sorter.merge([&](record_key const& key)
+        {
+            shx_record const& rec = records[key.record];
+            std::size_t size = 8 + static_cast<std::size_t>(rec.length) * 2;
+            buffer.resize(std::max(size, dbf_record_length));
+            shp_in.seekg(static_cast<std::streamoff>(rec.offset) * 2);
+            if (!shp_in.read(buffer.data(), static_cast<std::streamsize>(size)))
+            {
+                throw std::runtime_error("cannot read record " + std::to_string(key.record + 1) + " of " + shp_name);
+            }
+            write_int32_xdr(buffer.data(), ++number);
+            shp_out.write(buffer.data(), static_cast<std::streamsize>(size));
+            char entry[8];
+            write_int32_xdr(entry, pos);
+            write_int32_xdr(entry + 4, rec.length);
+            shx_out.write(entry, 8);
+            pos += 4 + rec.length;
+            if (has_dbf)
+            {
+                dbf_in.seekg(static_cast<std::streamoff>(dbf_header.size() + key.record * dbf_record_length));
+                if (!dbf_in.read(buffer.data(), static_cast<std::streamsize>(dbf_record_length)))
+                {
+                    throw std::runtime_error("cannot read record " + std::to_string(key.record + 1) + " of " + dbf_name);
+                }
+                dbf_out.write(buffer.data(), static_cast<std::streamsize>(dbf_record_length));
+            }
+        });
+
+        // file lengths in 16 bit words
+        write_int32_xdr(shp_header + 24, pos);
+        write_int32_xdr(shx_header + 24, static_cast<std::int32_t>(50 + 4 * records.size()));
+        shp_out.seekp(0);
+        shp_out.write(shp_header, 100);
+        shx_out.seekp(0);
+        shx_out.write(shx_header, 100);
+        shp_out.close();
+        shx_out.close();
+        shp_in.close();
+        shx_in.close();
+        if (has_dbf)
+        {
+            dbf_out.write(dbf_tail.data(), static_cast<std::streamsize>(dbf_tail.size()));
+            dbf_out.close();
+            dbf_in.close();
+        }
+    }
+    catch (...)
+    {
+        mapnik::util::remove(shp_sorted);
+        mapnik::util::remove(shx_sorted);
+        if (has_dbf) mapnik::util::remove(dbf_sorted);
+        throw;
+    }
+#if defined(MAPNIK_MEMORY_MAPPED_FILE)
+    // drop the mappings of the files about to be replaced
+    mapnik::mapped_memory_cache::instance().clear();
+#endif
+    replace_file(shp_sorted, shp_name);
+    replace_file(shx_sorted, shx_name);
+    if (has_dbf) replace_file(dbf_sorted, dbf_name);
+}
+
+bool is_polygon_type(int shape_type)
+{
+    return shape_type == shape_io::shape_polygon || shape_type == shape_io::shape_polygonm
+        || shape_type == shape_io::shape_polygonz;
+}
+
+// Writes the roles of the rings of all polygon records to a .rings file,
+// see shape_rings.
+void write_rings(std::string const& shapename, std::vector<shx_record> const& records)
+{
+    std::string shp_name = shapename + ".shp";
+    shape_file shp(shp_name);
+    if (!shp.is_open())
+    {
+        throw std::runtime_error("cannot open " + shp_name);
+    }
+    shp.seek(24);
+    int shp_length = shp.read_xdr_integer();
+
+    std::vector<std::uint32_t> first_rings;
+    std::vector<std::uint8_t> flags;
+    first_rings.reserve(records.size());
+    for (shx_record const& rec : records)
+    {
+        first_rings.push_back(static_cast<std::uint32_t>(flags.size()));
+        shp.seek(rec.offset * 2 + 8);
+        if (!is_polygon_type(shp.read_ndr_integer())) continue;
+        box2d<double> ext;
+        shp.read_envelope(ext);
+        int num_parts = shp.read_ndr_integer();
+        int num_points = shp.read_ndr_integer();
+        std::vector<int> parts(num_parts);
+        for (int & part : parts) part = shp.read_ndr_integer();
+        for (int k = 0; k < num_parts; ++k)
+        {
+            int end_point = (k == num_parts - 1) ? num_points : parts[k + 1];
+            mapnik::geometry::linear_ring<double> ring;
+            ring.reserve(end_point - parts[k]);
+            for (int j = parts[k]; j < end_point; ++j)
+            {
+                double x = shp.read_double();
+                double y = shp.read_double();
+                ring.emplace_back(x, y);
+            }
+            flags.push_back(shape_rings::flags(ring, k == 0));
+        }
+    }
+
+    std::string rings_name = shapename + ".rings";
+    std::ofstream file(rings_name.c_str(), std::ios::trunc | std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("cannot open " + rings_name + " for writing");
+    }
+    file.exceptions(std::ios::failbit | std::ios::badbit);
+    shape_rings::write(file, shp_length, first_rings, flags);
+    std::clog << " number rings=" << flags.size() << std::endl;
+}
+
+} // namespace
 
 int main (int argc,char** argv)
 {
@@ -47,8 +503,13 @@ int main (int argc,char** argv)
 
     bool verbose=false;
     bool index_parts = false;
+    bool packed = false;
+    bool sort = false;
+    bool rings = false;
     unsigned int depth = DEFAULT_DEPTH;
     double ratio = DEFAULT_RATIO;
+    unsigned int jobs = 1;
+    std::size_t memory = DEFAULT_MEMORY;
     std::vector<std::string> shape_files;
 
     try
@@ -58,6 +519,11 @@ int main (int argc,char** argv)
             ("help,h", "produce usage message")
             ("version,V","print version string")
             ("index-parts","index individual shape parts (default: no)")
+            ("packed","write a packed Hilbert R-tree index, not readable by older Mapnik versions (default: no)")
+            ("sort","rewrite the .shp, .shx and .dbf in Hilbert order first, so that nearby shapes are stored together (default: no)")
+            ("rings","write the roles of polygon rings to a .rings file, so they are not worked out on every read (default: no)")
+            ("jobs,j", po::value<unsigned int>(), "number of threads reading the shapes (default 1)")
+            ("memory,m", po::value<std::size_t>(), "memory for sorting before spilling to disk, in MB (default 1024)")
             ("verbose,v","verbose output")
             ("depth,d", po::value<unsigned int>(), "max tree depth\n(default 8)")
             ("ratio,r",po::value<double>(),"split ratio (default 0.55)")
@@ -89,6 +555,26 @@ int main (int argc,char** argv)
         {
             index_parts = true;
         }
+        if (vm.count("packed"))
+        {
+            packed = true;
+        }
+        if (vm.count("sort"))
+        {
+            sort = true;
+        }
+        if (vm.count("rings"))
+        {
+            rings = true;
+        }
+        if (vm.count("jobs"))
+        {
+            jobs = std::max(1u, vm["jobs"].as<unsigned int>());
+        }
+        if (vm.count("memory"))
+        {
+            memory = std::max<std::size_t>(1, vm["memory"].as<std::size_t>());
+        }
         if (vm.count("depth"))
         {
             depth = vm["depth"].as<unsigned int>();
@@ -134,167 +620,135 @@ int main (int argc,char** argv)
             std::clog << "Error : shapefile index file (*.shx) " << shxname << " does not exist" << std::endl;
             continue;
         }
-        shape_file shp (shapename_full);
-
-        if (! shp.is_open())
-        {
-            std::clog << "Error : cannot open " << shapename_full << std::endl;
-            continue;
-        }
-
-        shape_file shx (shxname);
-        if (!shx.is_open())
+        std::vector<shx_record> records;
+        int file_length;
+        int shape_type;
+        box2d<double> extent;
         {
-            std::clog << "Error : cannot open " << shxname << std::endl;
-            continue;
-        }
+            shape_file shx (shxname);
+            if (!shx.is_open())
+            {
+                std::clog << "Error : cannot open " << shxname << std::endl;
+                continue;
+            }
 
-        int code = shx.read_xdr_integer(); //file_code == 9994
-        std::clog << code << std::endl;
-        shx.skip(5*4);
+            int code = shx.read_xdr_integer(); //file_code == 9994
+            std::clog << code << std::endl;
+            shx.skip(5*4);
 
-        int file_length=shx.read_xdr_integer();
-        int version=shx.read_ndr_integer();
-        int shape_type=shx.read_ndr_integer();
-        box2d<double> extent;
-        shx.read_envelope(extent);
+            file_length=shx.read_xdr_integer();
+            int version=shx.read_ndr_integer();
+            shape_type=shx.read_ndr_integer();
+            shx.read_envelope(extent);
 
+            std::clog << "length=" << file_length << std::endl;
+            std::clog << "version=" << version << std::endl;
+            std::clog << "type=" << shape_type << std::endl;
+            std::clog << "extent:" << extent << std::endl;
 
-        std::clog << "length=" << file_length << std::endl;
-        std::clog << "version=" << version << std::endl;
-        std::clog << "type=" << shape_type << std::endl;
-        std::clog << "extent:" << extent << std::endl;
+            if (!extent.valid() || std::isnan(extent.width()) || std::isnan(extent.height()))
+            {
+                std::clog << "Invalid extent aborting..." << std::endl;
+                return EXIT_FAILURE;
+            }
+            if (shape_type != shape_io::shape_null)
+            {
+                records = read_shx(shx, file_length);
+            }
+        }
+        mapnik::box2d<float> extent_f = float_box(extent);
+        std::size_t count = 0;
 
-        if (!extent.valid() || std::isnan(extent.width()) || std::isnan(extent.height()))
+        try
         {
-            std::clog << "Invalid extent aborting..." << std::endl;
-            return EXIT_FAILURE;
-        }
-        int pos = 50;
-        shx.seek(pos * 2);
-        mapnik::box2d<float> extent_f { static_cast<float>(extent.minx()),
-                static_cast<float>(extent.miny()),
-                static_cast<float>(extent.maxx()),
-                static_cast<float>(extent.maxy())};
+            if (sort && !records.empty())
+            {
+                std::clog << " sorting " << records.size() << " records" << std::endl;
+                sort_shapefile(shapename, records, extent_f, jobs, memory * 1024 * 1024, verbose);
+                // ring roles of the old record order would pass for the new one
+                if (mapnik::util::exists(shapename + ".rings")) mapnik::util::remove(shapename + ".rings");
+                shape_file shx (shxname);
+                records = read_shx(shx, file_length);
+            }
 
-        mapnik::quad_tree<mapnik::detail::node, mapnik::box2d<float> > tree(extent_f, depth, ratio);
-        int count = 0;
+            if (rings && is_polygon_type(shape_type))
+            {
+                write_rings(shapename, records);
+            }
 
-        if (shape_type != shape_io::shape_null)
-        {
-            while (shx.is_good() && pos <= file_length - 4)
+            std::string index_name = shapename + ".index";
+            if (packed)
             {
-                int offset = shx.read_xdr_integer();
-                int shx_content_length = shx.read_xdr_integer();
-                pos += 4;
-                box2d<double> item_ext;
-                shp.seek(offset * 2);
-                int record_number = shp.read_xdr_integer();
-                int shp_content_length = shp.read_xdr_integer();
-                if (shx_content_length != shp_content_length)
+                // items are ordered along the hilbert curve over the header's
+                // extent in runs of at most memory MB, then merged while the
+                // index is written out
+                mapnik::detail::external_sort<sort_item, sort_item_less> sorter(index_name, memory * 1024 * 1024);
+                for_each_box(shapename_full, records, jobs, index_parts, verbose,
+                             [&](std::size_t, node const& item)
+                             {
+                                 sorter.push(sort_item { mapnik::util::packed_index::hilbert_code(item.box, extent_f),
+                                                         sorter.size(), item });
+                             });
+                count = sorter.size();
+                if (count > 0)
                 {
-                    if (verbose)
+                    std::clog << " number shapes=" << count << std::endl;
+                    if (sorter.runs() > 0)
                     {
-                        std::clog << "Content length mismatch for record number " << record_number << std::endl;
+                        std::clog << " merging " << sorter.runs() << " sorted runs" << std::endl;
                     }
-                    continue;
-                }
-                shape_type = shp.read_ndr_integer();
-
-                if (shape_type == shape_io::shape_null) continue;
-
-                if (shape_type==shape_io::shape_point
-                    || shape_type==shape_io::shape_pointm
-                    || shape_type == shape_io::shape_pointz)
-                {
-                    double x=shp.read_double();
-                    double y=shp.read_double();
-                    item_ext=box2d<double>(x,y,x,y);
-                }
-                else if (index_parts &&
-                         (shape_type == shape_io::shape_polygon || shape_type == shape_io::shape_polygonm || shape_type == shape_io::shape_polygonz
-                          || shape_type == shape_io::shape_polyline || shape_type == shape_io::shape_polylinem || shape_type == shape_io::shape_polylinez))
-                {
-                    shp.read_envelope(item_ext);
-                    int num_parts = shp.read_ndr_integer();
-                    int num_points = shp.read_ndr_integer();
-                    std::vector<int> parts;
-                    parts.resize(num_parts);
-                    std::for_each(parts.begin(), parts.end(), [&](int & part) { part = shp.read_ndr_integer();});
-                    for (int k = 0; k < num_parts; ++k)
+                    std::ofstream file(index_name.c_str(), std::ios::trunc | std::ios::binary);
+                    if (!file)
                     {
-                        int start = parts[k];
-                        int end;
-                        if (k == num_parts - 1) end = num_points;
-                        else end = parts[k + 1];
-
-                        mapnik::geometry::linear_ring<double> ring;
-                        ring.reserve(end - start);
-                        for (int j = start; j < end; ++j)
-                        {
-                            double x = shp.read_double();
-                            double y = shp.read_double();
-                            ring.emplace_back(x, y);
-                        }
-                        item_ext = mapnik::geometry::envelope(ring);
-                        if (item_ext.valid())
-                        {
-                            if (verbose)
-                            {
-                                std::clog << "record number " << record_number << " box=" << item_ext << std::endl;
-                            }
-                            mapnik::box2d<float> ext_f {static_cast<float>(item_ext.minx()),
-                                    static_cast<float>(item_ext.miny()),
-                                    static_cast<float>(item_ext.maxx()),
-                                    static_cast<float>(item_ext.maxy())};
-                            tree.insert(mapnik::detail::node(offset * 2, start, end, std::move(ext_f)), ext_f);
-                            ++count;
-                        }
+                        std::clog << "cannot open index file for writing file \"" << index_name << "\"" << std::endl;
+                    }
+                    else
+                    {
+                        file.exceptions(std::ios::failbit | std::ios::badbit);
+                        mapnik::util::packed_rtree_writer<node, std::ofstream> writer(file, count);
+                        sorter.merge([&writer](sort_item const& entry) { writer.push(entry.item, entry.item.box); });
+                        writer.finish();
+                        file.flush();
+                        file.close();
                     }
-                    item_ext = mapnik::box2d<double>(); //invalid
-                }
-                else
-                {
-                    shp.read_envelope(item_ext);
                 }
-
-                if (item_ext.valid())
+            }
+            else
+            {
+                mapnik::quad_tree<node, mapnik::box2d<float> > tree(extent_f, depth, ratio);
+                for_each_box(shapename_full, records, jobs, index_parts, verbose,
+                             [&](std::size_t, node const& item)
+                             {
+                                 tree.insert(item, item.box);
+                                 ++count;
+                             });
+                if (count > 0)
                 {
-                    if (verbose)
+                    std::clog << " number shapes=" << count << std::endl;
+                    std::ofstream file(index_name.c_str(), std::ios::trunc | std::ios::binary);
+                    if (!file)
                     {
-                        std::clog << "record number " << record_number << " box=" << item_ext << std::endl;
+                        std::clog << "cannot open index file for writing file \"" << index_name << "\"" << std::endl;
+                    }
+                    else
+                    {
+                        file.exceptions(std::ios::failbit | std::ios::badbit);
+                        tree.trim();
+                        std::clog << " number nodes=" << tree.count() << std::endl;
+                        tree.write(file);
+                        file.flush();
+                        file.close();
                     }
-                    mapnik::box2d<float> ext_f {static_cast<float>(item_ext.minx()),
-                            static_cast<float>(item_ext.miny()),
-                            static_cast<float>(item_ext.maxx()),
-                            static_cast<float>(item_ext.maxy())};
-
-                    tree.insert(mapnik::detail::node(offset * 2, -1, 0, std::move(ext_f)), ext_f);
-                    ++count;
                 }
             }
         }
-
-        if (count > 0)
+        catch (std::exception const& ex)
         {
-            std::clog << " number shapes=" << count << std::endl;
-            std::ofstream file((shapename+".index").c_str(), std::ios::trunc | std::ios::binary);
-            if (!file)
-            {
-                std::clog << "cannot open index file for writing file \""
-                          << (shapename+".index") << "\"" << std::endl;
-            }
-            else
-            {
-                tree.trim();
-                std::clog << " number nodes=" << tree.count() << std::endl;
-                file.exceptions(std::ios::failbit | std::ios::badbit);
-                tree.write(file);
-                file.flush();
-                file.close();
-            }
+            std::clog << "Error: failed to index " << filename << ": " << ex.what() << std::endl;
+            return EXIT_FAILURE;
         }
-        else
+
+        if (count == 0)
         {
             std::clog << "Failed to read any features from \"" << filename << "\"" << std::endl;
             return EXIT_FAILURE;